@@ -4,6 +4,9 @@
 #include "window-basic-main.hpp"
 #include "window-basic-main-outputs.hpp"
 
+#include <QTimer>
+
+#include <algorithm>
 #include <functional>
 
 using namespace std;
@@ -25,6 +28,34 @@ extern volatile bool recording_paused;
 extern volatile bool replaybuf_active;
 extern volatile bool virtualcam_active;
 
+enum {
+	STATE_STREAMING = 1 << 0,
+	STATE_RECORDING = 1 << 1,
+	STATE_RECORDING_PAUSED = 1 << 2,
+	STATE_REPLAY_BUFFER = 1 << 3,
+	STATE_VIRTUALCAM = 1 << 4,
+	STATE_STUDIO_MODE = 1 << 5,
+};
+
+/* events that only say that something is different now; only the last one
+ * of a batch matters */
+static bool EventCoalesces(enum obs_frontend_event event)
+{
+	switch (event) {
+	case OBS_FRONTEND_EVENT_SCENE_CHANGED:
+	case OBS_FRONTEND_EVENT_SCENE_LIST_CHANGED:
+	case OBS_FRONTEND_EVENT_TRANSITION_CHANGED:
+	case OBS_FRONTEND_EVENT_TRANSITION_LIST_CHANGED:
+	case OBS_FRONTEND_EVENT_SCENE_COLLECTION_LIST_CHANGED:
+	case OBS_FRONTEND_EVENT_PROFILE_LIST_CHANGED:
+	case OBS_FRONTEND_EVENT_PREVIEW_SCENE_CHANGED:
+	case OBS_FRONTEND_EVENT_TRANSITION_DURATION_CHANGED:
+		return true;
+	default:
+		return false;
+	}
+}
+
 /* ------------------------------------------------------------------------- */
 
 template<typename T> struct OBSStudioCallback {
@@ -55,6 +86,10 @@ struct OBSStudioAPI : obs_frontend_callbacks {
 	vector<OBSStudioCallback<obs_frontend_event_cb>> callbacks;
 	vector<OBSStudioCallback<obs_frontend_save_cb>> saveCallbacks;
 	vector<OBSStudioCallback<obs_frontend_save_cb>> preloadCallbacks;
+	vector<OBSStudioCallback<obs_frontend_event_batch_cb>> batchCallbacks;
+	vector<enum obs_frontend_event> pendingEvents;
+	bool flushQueued = false;
+	volatile long state = 0;
 
 	inline OBSStudioAPI(OBSBasic *main_) : main(main_) {}
 
@@ -573,6 +608,106 @@ struct OBSStudioAPI : obs_frontend_callbacks {
 
 	void obs_frontend_reset_video(void) override { main->ResetVideo(); }
 
+	void obs_frontend_add_event_batch_callback(
+		obs_frontend_event_batch_cb callback,
+		void *private_data) override
+	{
+		size_t idx =
+			GetCallbackIdx(batchCallbacks, callback, private_data);
+		if (idx == (size_t)-1)
+			batchCallbacks.emplace_back(callback, private_data);
+	}
+
+	void obs_frontend_remove_event_batch_callback(
+		obs_frontend_event_batch_cb callback,
+		void *private_data) override
+	{
+		size_t idx =
+			GetCallbackIdx(batchCallbacks, callback, private_data);
+		if (idx == (size_t)-1)
+			return;
+
+		batchCallbacks.erase(batchCallbacks.begin() + idx);
+	}
+
+	void obs_frontend_get_state(struct obs_frontend_state *out) override
+	{
+		long flags = os_atomic_load_long(&state);
+
+		out->streaming = (flags & STATE_STREAMING) != 0;
+		out->recording = (flags & STATE_RECORDING) != 0;
+		out->recording_paused = (flags & STATE_RECORDING_PAUSED) != 0;
+		out->replay_buffer = (flags & STATE_REPLAY_BUFFER) != 0;
+		out->virtualcam = (flags & STATE_VIRTUALCAM) != 0;
+		out->studio_mode = (flags & STATE_STUDIO_MODE) != 0;
+	}
+
+	/* published as one word so that readers on other threads always see
+	 * the state of a single point in time */
+	void UpdateState()
+	{
+		long flags = 0;
+
+		if (os_atomic_load_bool(&streaming_active))
+			flags |= STATE_STREAMING;
+		if (os_atomic_load_bool(&recording_active))
+			flags |= STATE_RECORDING;
+		if (os_atomic_load_bool(&recording_paused))
+			flags |= STATE_RECORDING_PAUSED;
+		if (os_atomic_load_bool(&replaybuf_active))
+			flags |= STATE_REPLAY_BUFFER;
+		if (os_atomic_load_bool(&virtualcam_active))
+			flags |= STATE_VIRTUALCAM;
+		if (main->IsPreviewProgramMode())
+			flags |= STATE_STUDIO_MODE;
+
+		os_atomic_set_long(&state, flags);
+	}
+
+	void FlushEvents()
+	{
+		flushQueued = false;
+
+		if (pendingEvents.empty())
+			return;
+
+		vector<enum obs_frontend_event> events;
+		events.swap(pendingEvents);
+
+		for (size_t i = batchCallbacks.size(); i > 0; i--) {
+			auto cb = batchCallbacks[i - 1];
+			cb.callback(events.data(), events.size(),
+				    cb.private_data);
+		}
+	}
+
+	void QueueEvent(enum obs_frontend_event event)
+	{
+		if (batchCallbacks.empty())
+			return;
+
+		if (EventCoalesces(event)) {
+			auto it = find(pendingEvents.begin(),
+				       pendingEvents.end(), event);
+			if (it != pendingEvents.end())
+				pendingEvents.erase(it);
+		}
+
+		pendingEvents.push_back(event);
+
+		/* the UI loop will not come around again after this one */
+		if (event == OBS_FRONTEND_EVENT_EXIT) {
+			FlushEvents();
+			return;
+		}
+
+		if (!flushQueued) {
+			flushQueued = true;
+			QTimer::singleShot(0, main,
+					   [this]() { FlushEvents(); });
+		}
+	}
+
 	void on_load(obs_data_t *settings) override
 	{
 		for (size_t i = saveCallbacks.size(); i > 0; i--) {
@@ -599,6 +734,8 @@ struct OBSStudioAPI : obs_frontend_callbacks {
 
 	void on_event(enum obs_frontend_event event) override
 	{
+		UpdateState();
+
 		if (main->disableSaving)
 			return;
 
@@ -606,6 +743,8 @@ struct OBSStudioAPI : obs_frontend_callbacks {
 			auto cb = callbacks[i - 1];
 			cb.callback(event, cb.private_data);
 		}
+
+		QueueEvent(event);
 	}
 };
 
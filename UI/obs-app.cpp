@@ -23,6 +23,8 @@
 #include <string>
 #include <sstream>
 #include <mutex>
+#include <atomic>
+#include <thread>
 #include <util/bmem.h>
 #include <util/dstr.hpp>
 #include <util/platform.h>
@@ -94,6 +96,7 @@ bool opt_allow_opengl = false;
 bool opt_always_on_top = false;
 bool opt_disable_high_dpi_scaling = false;
 bool opt_disable_updater = false;
+bool opt_profiler_trace = false;
 string opt_starting_collection;
 string opt_starting_profile;
 string opt_starting_scene;
@@ -231,14 +234,13 @@ QObject *CreateShortcutFilter()
 	});
 }
 
-string CurrentTimeString()
+static string TimeString(chrono::system_clock::time_point tp)
 {
 	using namespace std::chrono;
 
 	struct tm tstruct;
 	char buf[80];
 
-	auto tp = system_clock::now();
 	auto now = system_clock::to_time_t(tp);
 	tstruct = *localtime(&now);
 
@@ -255,6 +257,11 @@ string CurrentTimeString()
 	return buf;
 }
 
+string CurrentTimeString()
+{
+	return TimeString(chrono::system_clock::now());
+}
+
 string CurrentDateTimeString()
 {
 	time_t now = time(0);
@@ -281,10 +288,10 @@ static inline void LogString(fstream &logFile, const char *timeString,
 					  Q_ARG(QString, QString(msg.c_str())));
 }
 
-static inline void LogStringChunk(fstream &logFile, char *str, int log_level)
+static inline void LogStringChunk(fstream &logFile, char *str, int log_level,
+				  string timeString)
 {
 	char *nextLine = str;
-	string timeString = CurrentTimeString();
 	timeString += ": ";
 
 	while (*nextLine) {
@@ -318,10 +325,10 @@ static inline int sum_chars(const char *str)
 	return val;
 }
 
+/* only called from the log thread */
 static inline bool too_many_repeated_entries(fstream &logFile, const char *msg,
 					     const char *output_str)
 {
-	static mutex log_mutex;
 	static const char *last_msg_ptr = nullptr;
 	static int last_char_sum = 0;
 	static char cmp_str[4096];
@@ -329,8 +336,6 @@ static inline bool too_many_repeated_entries(fstream &logFile, const char *msg,
 
 	int new_sum = sum_chars(output_str);
 
-	lock_guard<mutex> guard(log_mutex);
-
 	if (unfiltered_log) {
 		return false;
 	}
@@ -357,9 +362,259 @@ static inline bool too_many_repeated_entries(fstream &logFile, const char *msg,
 	return false;
 }
 
+#ifdef _WIN32
+static void log_to_debugger(const char *str)
+{
+	if (!IsDebuggerPresent())
+		return;
+
+	int wNum = MultiByteToWideChar(CP_UTF8, 0, str, -1, NULL, 0);
+	if (wNum > 1) {
+		static wstring wide_buf;
+		static mutex wide_mutex;
+
+		lock_guard<mutex> lock(wide_mutex);
+		wide_buf.reserve(wNum + 1);
+		wide_buf.resize(wNum - 1);
+		MultiByteToWideChar(CP_UTF8, 0, str, -1, &wide_buf[0], wNum);
+		wide_buf.push_back('\n');
+
+		OutputDebugStringW(wide_buf.c_str());
+	}
+}
+#else
+static void log_to_default_handler(int log_level, const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	def_log_handler(log_level, format, args, nullptr);
+	va_end(args);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Lines that go to the log file are formatted on the thread that logs them
+ * and handed to the log thread through a lock-free list, so that the
+ * graphics, audio and encoder threads never wait on the disk, the console or
+ * the log viewer.
+ *
+ * Threads other than the UI thread can also only log so many lines from the
+ * same call site at a time, so a warning that fires every frame can't flood
+ * the log.  The UI thread is left alone, it logs long listings of modules
+ * and sources from one place at startup.
+ */
+
+#define MAX_QUEUED_LOG_LINES 10000
+#define LOG_SITES 256
+#define LOG_SITE_BURST 50
+#define LOG_SITE_WINDOW_NS 10000000000ULL
+
+struct LogLine {
+	LogLine *next;
+	int level;
+	const char *format;
+	long suppressed;
+	chrono::system_clock::time_point time;
+	string text;
+};
+
+struct LogSite {
+	atomic<uint64_t> key{0};
+	atomic<uint64_t> windowStart{0};
+	atomic<long> count{0};
+	atomic<long> suppressed{0};
+};
+
+static atomic<LogLine *> queued_log_lines{nullptr};
+static atomic<long> num_queued_log_lines{0};
+static atomic<long> dropped_log_lines{0};
+static LogSite log_sites[LOG_SITES];
+
+static os_event_t *log_event = nullptr;
+static thread *log_thread = nullptr;
+static atomic<bool> log_thread_stop{false};
+static thread::id log_ui_thread;
+
+/* call sites that only pass on text formatted elsewhere ("%s") are told
+ * apart by the start of the text, without the numbers in it */
+static uint64_t log_site_key(const char *format, const char *str)
+{
+	const uint64_t prime = 1099511628211ULL;
+	uint64_t key = 14695981039346656037ULL;
+	uintptr_t ptr = reinterpret_cast<uintptr_t>(format);
+
+	key = (key ^ (uint64_t)ptr) * prime;
+
+	if (*format == '%') {
+		for (int i = 0; i < 32 && str[i]; i++) {
+			if (str[i] < '0' || str[i] > '9')
+				key = (key ^ (uint8_t)str[i]) * prime;
+		}
+	}
+
+	return key ? key : 1;
+}
+
+/* returns false if the line is over the limit of its call site, otherwise
+ * sets how many lines of the call site were held back before it */
+static bool log_site_allowed(const char *format, const char *str,
+			     long &suppressed)
+{
+	uint64_t key = log_site_key(format, str);
+	LogSite &site = log_sites[key % LOG_SITES];
+	uint64_t now = os_gettime_ns();
+	uint64_t start = site.windowStart;
+
+	suppressed = 0;
+
+	if (site.key != key || now - start >= LOG_SITE_WINDOW_NS) {
+		if (site.windowStart.compare_exchange_strong(start, now)) {
+			long held = site.suppressed.exchange(0);
+
+			/* a call site that shares the slot took it over */
+			if (site.key.exchange(key) == key)
+				suppressed = held;
+			else
+				dropped_log_lines += held;
+
+			site.count = 0;
+		}
+	}
+
+	if (site.count++ < LOG_SITE_BURST)
+		return true;
+
+	site.suppressed++;
+	return false;
+}
+
+static void queue_log_line(int log_level, const char *format, const char *str)
+{
+	long suppressed = 0;
+
+	if (!unfiltered_log && this_thread::get_id() != log_ui_thread &&
+	    !log_site_allowed(format, str, suppressed))
+		return;
+
+	if (num_queued_log_lines++ >= MAX_QUEUED_LOG_LINES) {
+		num_queued_log_lines--;
+		dropped_log_lines += suppressed + 1;
+		return;
+	}
+
+	LogLine *line = new LogLine;
+	line->level = log_level;
+	line->format = format;
+	line->suppressed = suppressed;
+	line->time = chrono::system_clock::now();
+	line->text = str;
+
+	LogLine *head = queued_log_lines.load(memory_order_relaxed);
+	do {
+		line->next = head;
+	} while (!queued_log_lines.compare_exchange_weak(head, line));
+
+	/* the log thread has taken everything before, so it may be waiting */
+	if (!head)
+		os_event_signal(log_event);
+}
+
+static void write_log_line(fstream &logFile, LogLine *line)
+{
+	const char *str = line->text.c_str();
+
+#ifdef _WIN32
+	log_to_debugger(str);
+#else
+	log_to_default_handler(line->level, "%s", str);
+#endif
+
+	if (too_many_repeated_entries(logFile, line->format, str))
+		return;
+
+	string timeString = TimeString(line->time);
+
+	if (line->suppressed)
+		logFile << timeString << ": Suppressed " << line->suppressed
+			<< " lines similar to the following" << endl;
+
+	LogStringChunk(logFile, &line->text[0], line->level, timeString);
+}
+
+static void write_queued_log_lines(fstream &logFile)
+{
+	LogLine *line = queued_log_lines.exchange(nullptr);
+	LogLine *ordered = nullptr;
+
+	/* the list is newest first */
+	while (line) {
+		LogLine *next = line->next;
+		line->next = ordered;
+		ordered = line;
+		line = next;
+	}
+
+	while (ordered) {
+		LogLine *next = ordered->next;
+		write_log_line(logFile, ordered);
+		delete ordered;
+		num_queued_log_lines--;
+		ordered = next;
+	}
+
+	long dropped = dropped_log_lines.exchange(0);
+	if (dropped)
+		logFile << CurrentTimeString() << ": " << dropped
+			<< " log lines were dropped" << endl;
+}
+
+static void log_thread_loop(fstream *logFile)
+{
+	os_set_thread_name("log writer");
+
+	for (;;) {
+		os_event_wait(log_event);
+
+		bool stop = log_thread_stop;
+		write_queued_log_lines(*logFile);
+		if (stop)
+			break;
+	}
+}
+
+static void start_log_thread(fstream &logFile)
+{
+	if (os_event_init(&log_event, OS_EVENT_TYPE_AUTO) != 0)
+		return;
+
+	/* never destroyed unless stopped, so exiting without stopping it
+	 * doesn't terminate the program */
+	log_ui_thread = this_thread::get_id();
+	log_thread = new thread(log_thread_loop, &logFile);
+}
+
+/* writes out whatever is still queued, called once nothing logs to the file
+ * anymore */
+static void stop_log_thread()
+{
+	if (!log_thread)
+		return;
+
+	log_thread_stop = true;
+	os_event_signal(log_event);
+	log_thread->join();
+	delete log_thread;
+	log_thread = nullptr;
+
+	os_event_destroy(log_event);
+	log_event = nullptr;
+}
+
 static void do_log(int log_level, const char *msg, va_list args, void *param)
 {
-	fstream &logFile = *static_cast<fstream *>(param);
 	char str[4096];
 
 #ifndef _WIN32
@@ -369,38 +624,26 @@ static void do_log(int log_level, const char *msg, va_list args, void *param)
 
 	vsnprintf(str, 4095, msg, args);
 
+	if (log_level <= LOG_INFO || log_verbose) {
+		queue_log_line(log_level, msg, str);
+	} else {
 #ifdef _WIN32
-	if (IsDebuggerPresent()) {
-		int wNum = MultiByteToWideChar(CP_UTF8, 0, str, -1, NULL, 0);
-		if (wNum > 1) {
-			static wstring wide_buf;
-			static mutex wide_mutex;
-
-			lock_guard<mutex> lock(wide_mutex);
-			wide_buf.reserve(wNum + 1);
-			wide_buf.resize(wNum - 1);
-			MultiByteToWideChar(CP_UTF8, 0, str, -1, &wide_buf[0],
-					    wNum);
-			wide_buf.push_back('\n');
-
-			OutputDebugStringW(wide_buf.c_str());
-		}
-	}
+		log_to_debugger(str);
 #else
-	def_log_handler(log_level, msg, args2, nullptr);
-	va_end(args2);
+		def_log_handler(log_level, msg, args2, nullptr);
 #endif
-
-	if (log_level <= LOG_INFO || log_verbose) {
-		if (too_many_repeated_entries(logFile, msg, str))
-			return;
-		LogStringChunk(logFile, str, log_level);
 	}
 
+#ifndef _WIN32
+	va_end(args2);
+#endif
+
 #if defined(_WIN32) && defined(OBS_DEBUGBREAK_ON_ERROR)
 	if (log_level <= LOG_ERROR && IsDebuggerPresent())
 		__debugbreak();
 #endif
+
+	UNUSED_PARAMETER(param);
 }
 
 #define DEFAULT_LANG "en-US"
@@ -415,6 +658,17 @@ bool OBSApp::InitGlobalConfigDefaults()
 				  "Normal");
 	config_set_default_bool(globalConfig, "General", "EnableAutoUpdates",
 				true);
+	config_set_default_bool(globalConfig, "General", "DeferSourceLoading",
+				true);
+	config_set_default_int(globalConfig, "General", "RemuxConcurrency", 2);
+	config_set_default_bool(globalConfig, "General", "RemuxFastStart",
+				false);
+	config_set_default_bool(globalConfig, "General", "IdleRendering",
+				false);
+	config_set_default_uint(globalConfig, "General", "GPUMemoryBudgetMB",
+				0);
+	config_set_default_bool(globalConfig, "General", "CompressImages",
+				false);
 
 #if _WIN32
 	config_set_default_string(globalConfig, "Video", "Renderer",
@@ -484,6 +738,12 @@ bool OBSApp::InitGlobalConfigDefaults()
 	config_set_default_bool(globalConfig, "BasicWindow",
 				"MultiviewDrawAreas", true);
 
+	config_set_default_uint(globalConfig, "BasicWindow",
+				"MultiviewSceneFPS", 0);
+
+	config_set_default_uint(globalConfig, "BasicWindow", "DisplayMaxFPS",
+				0);
+
 #ifdef _WIN32
 	uint32_t winver = GetWindowsVersion();
 
@@ -1874,7 +2134,9 @@ static void create_log_file(fstream &logFile)
 
 	if (logFile.is_open()) {
 		delete_oldest_file(false, "obs-studio/logs");
-		base_set_log_handler(do_log, &logFile);
+		start_log_thread(logFile);
+		if (log_event)
+			base_set_log_handler(do_log, &logFile);
 	} else {
 		blog(LOG_ERROR, "Failed to open log file");
 	}
@@ -1905,31 +2167,65 @@ ProfilerSnapshot GetSnapshot()
 	return ProfilerSnapshot{profile_snapshot_create(), SnapshotRelease};
 }
 
-static void SaveProfilerData(const ProfilerSnapshot &snap)
+/* the profiler data is named after the log of the session */
+static BPtr<char> GetProfilerDataPath(const char *extension)
 {
 	if (currentLogFile.empty())
-		return;
+		return nullptr;
 
 	auto pos = currentLogFile.rfind('.');
 	if (pos == currentLogFile.npos)
-		return;
+		return nullptr;
 
 #define LITERAL_SIZE(x) x, (sizeof(x) - 1)
 	ostringstream dst;
 	dst.write(LITERAL_SIZE("obs-studio/profiler_data/"));
 	dst.write(currentLogFile.c_str(), pos);
-	dst.write(LITERAL_SIZE(".csv.gz"));
+	dst << extension;
 #undef LITERAL_SIZE
 
-	BPtr<char> path = GetConfigPathPtr(dst.str().c_str());
+	return GetConfigPathPtr(dst.str().c_str());
+}
+
+static void SaveProfilerData(const ProfilerSnapshot &snap)
+{
+	BPtr<char> path = GetProfilerDataPath(".csv.gz");
+	if (!path)
+		return;
+
 	if (!profiler_snapshot_dump_csv_gz(snap.get(), path))
 		blog(LOG_WARNING, "Could not save profiler data to '%s'",
 		     static_cast<const char *>(path));
 }
 
+static void SaveProfilerTrace()
+{
+	BPtr<char> path = GetProfilerDataPath(".trace.json");
+	if (!path)
+		return;
+
+	if (!profiler_trace_dump(path))
+		blog(LOG_WARNING, "Could not save timeline trace to '%s'",
+		     static_cast<const char *>(path));
+}
+
+/* about half a minute of the graphics thread at 60 fps */
+#define PROFILER_TRACE_EVENTS 32768
+
+static void StartProfilerTrace()
+{
+	BPtr<char> dir = GetConfigPathPtr("obs-studio/profiler_data");
+	profiler_trace_start(PROFILER_TRACE_EVENTS, dir);
+}
+
 static auto ProfilerFree = [](void *) {
 	profiler_stop();
 
+	if (profiler_trace_active()) {
+		profiler_trace_stop();
+		SaveProfilerTrace();
+	}
+
 	auto snap = GetSnapshot();
 
 	profiler_print(snap.get());
@@ -1964,6 +2260,9 @@ static int run_program(fstream &logFile, int argc, char *argv[])
 	profiler_start();
 	profile_register_root(run_program_init, 0);
 
+	if (opt_profiler_trace)
+		StartProfilerTrace();
+
 	ScopeProfiler prof{run_program_init};
 
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 11, 0))
@@ -2610,8 +2909,26 @@ void ctrlc_handler(int s)
 	main->close();
 }
 
+/* only the pooled allocator tags blocks, the others leave every count 0 */
+static void log_leaked_tag(void *, const char *name, long long allocs,
+			   long long bytes)
+{
+	if (allocs)
+		blog(LOG_INFO, "    %s: %lld (%lld bytes)", name, allocs, bytes);
+}
+
 int main(int argc, char *argv[])
 {
+	/* the allocator can only be swapped before anything is allocated */
+	for (int i = 1; i < argc; i++) {
+		if (arg_is(argv[i], "--pooled-allocator", nullptr)) {
+			struct base_allocator pooled;
+			base_get_pooled_allocator(&pooled);
+			base_set_allocator(&pooled);
+			break;
+		}
+	}
+
 #ifndef _WIN32
 	signal(SIGPIPE, SIG_IGN);
 
@@ -2666,6 +2983,9 @@ int main(int argc, char *argv[])
 		} else if (arg_is(argv[i], "--unfiltered_log", nullptr)) {
 			unfiltered_log = true;
 
+		} else if (arg_is(argv[i], "--profiler-trace", nullptr)) {
+			opt_profiler_trace = true;
+
 		} else if (arg_is(argv[i], "--startstreaming", nullptr)) {
 			opt_start_streaming = true;
 
@@ -2724,8 +3044,11 @@ int main(int argc, char *argv[])
 				"--verbose: Make log more verbose.\n"
 				"--always-on-top: Start in 'always on top' mode.\n\n"
 				"--unfiltered_log: Make log unfiltered.\n\n"
+				"--profiler-trace: Record a timeline trace, saved with the\n"
+				"profiler data on exit and when frames lag or drop.\n\n"
 				"--disable-updater: Disable built-in updater (Windows/Mac only)\n\n"
-				"--disable-high-dpi-scaling: Disable automatic high-DPI scaling\n\n";
+				"--disable-high-dpi-scaling: Disable automatic high-DPI scaling\n\n"
+				"--pooled-allocator: Use the thread-caching memory allocator.\n\n";
 
 #ifdef _WIN32
 			MessageBoxA(NULL, help.c_str(), "Help",
@@ -2767,6 +3090,8 @@ int main(int argc, char *argv[])
 	int ret = run_program(logFile, argc, argv);
 
 	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	bmem_enum_tags(log_leaked_tag, nullptr);
 	base_set_log_handler(nullptr, nullptr);
+	stop_log_thread();
 	return ret;
 }
@@ -309,6 +309,22 @@ void obs_frontend_remove_event_callback(obs_frontend_event_cb callback,
 		c->obs_frontend_remove_event_callback(callback, private_data);
 }
 
+void obs_frontend_add_event_batch_callback(obs_frontend_event_batch_cb callback,
+					   void *private_data)
+{
+	if (callbacks_valid())
+		c->obs_frontend_add_event_batch_callback(callback,
+							 private_data);
+}
+
+void obs_frontend_remove_event_batch_callback(
+	obs_frontend_event_batch_cb callback, void *private_data)
+{
+	if (callbacks_valid())
+		c->obs_frontend_remove_event_batch_callback(callback,
+							    private_data);
+}
+
 obs_output_t *obs_frontend_get_streaming_output(void)
 {
 	return !!callbacks_valid() ? c->obs_frontend_get_streaming_output()
@@ -505,3 +521,11 @@ void obs_frontend_reset_video(void)
 	if (callbacks_valid())
 		c->obs_frontend_reset_video();
 }
+
+void obs_frontend_get_state(struct obs_frontend_state *state)
+{
+	if (callbacks_valid())
+		c->obs_frontend_get_state(state);
+	else
+		memset(state, 0, sizeof(*state));
+}
@@ -74,6 +74,15 @@ obs_frontend_source_list_free(struct obs_frontend_source_list *source_list)
 
 #endif //!SWIG
 
+struct obs_frontend_state {
+	bool streaming;
+	bool recording;
+	bool recording_paused;
+	bool replay_buffer;
+	bool virtualcam;
+	bool studio_mode;
+};
+
 /* ------------------------------------------------------------------------- */
 
 /* NOTE: Functions that return char** string lists are a single allocation of
@@ -134,6 +143,18 @@ EXPORT void obs_frontend_add_event_callback(obs_frontend_event_cb callback,
 EXPORT void obs_frontend_remove_event_callback(obs_frontend_event_cb callback,
 					       void *private_data);
 
+/* called once per UI loop iteration with the events that occurred since the
+ * last call.  repeated "changed" events are coalesced into one. */
+typedef void (*obs_frontend_event_batch_cb)(
+	const enum obs_frontend_event *events, size_t num, void *private_data);
+
+EXPORT void
+obs_frontend_add_event_batch_callback(obs_frontend_event_batch_cb callback,
+				      void *private_data);
+EXPORT void
+obs_frontend_remove_event_batch_callback(obs_frontend_event_batch_cb callback,
+					 void *private_data);
+
 typedef void (*obs_frontend_save_cb)(obs_data_t *save_data, bool saving,
 				     void *private_data);
 
@@ -208,6 +229,9 @@ EXPORT bool obs_frontend_virtualcam_active(void);
 
 EXPORT void obs_frontend_reset_video(void);
 
+/* safe to call from any thread, does not wait on the UI thread */
+EXPORT void obs_frontend_get_state(struct obs_frontend_state *state);
+
 /* ------------------------------------------------------------------------- */
 
 #ifdef __cplusplus
@@ -129,6 +129,14 @@ struct obs_frontend_callbacks {
 	virtual bool obs_frontend_virtualcam_active(void) = 0;
 
 	virtual void obs_frontend_reset_video(void) = 0;
+
+	virtual void obs_frontend_add_event_batch_callback(
+		obs_frontend_event_batch_cb callback, void *private_data) = 0;
+	virtual void obs_frontend_remove_event_batch_callback(
+		obs_frontend_event_batch_cb callback, void *private_data) = 0;
+
+	virtual void
+	obs_frontend_get_state(struct obs_frontend_state *state) = 0;
 };
 
 EXPORT void
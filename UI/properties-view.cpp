@@ -29,6 +29,7 @@
 #include "properties-view.moc.hpp"
 #include "obs-app.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 #include <initializer_list>
 #include <string>
@@ -181,6 +182,7 @@ OBSPropertiesView::OBSPropertiesView(OBSData settings_, void *obj_,
 	  minSize(minSize_)
 {
 	setFrameShape(QFrame::NoFrame);
+	InitUpdateTimer();
 	ReloadProperties();
 }
 
@@ -195,6 +197,7 @@ OBSPropertiesView::OBSPropertiesView(OBSData settings_, const char *type_,
 	  minSize(minSize_)
 {
 	setFrameShape(QFrame::NoFrame);
+	InitUpdateTimer();
 	ReloadProperties();
 }
 
@@ -1516,6 +1519,273 @@ void OBSPropertiesView::SignalChanged()
 	emit Changed();
 }
 
+/* dragging a slider or typing changes a setting many times a second; the
+ * source is only updated this often while that goes on */
+#define UPDATE_INTERVAL_MS 100
+
+void OBSPropertiesView::InitUpdateTimer()
+{
+	updateTimer.setSingleShot(true);
+	updateTimer.setInterval(UPDATE_INTERVAL_MS);
+	connect(&updateTimer, SIGNAL(timeout()), this,
+		SLOT(ApplyPendingUpdate()));
+}
+
+void OBSPropertiesView::ScheduleUpdate(obs_property_t *prop)
+{
+	string name = obs_property_name(prop);
+
+	if (find(pendingModified.begin(), pendingModified.end(), name) ==
+	    pendingModified.end())
+		pendingModified.push_back(name);
+
+	updatePending = true;
+	if (!updateTimer.isActive())
+		updateTimer.start();
+
+	SignalChanged();
+}
+
+void OBSPropertiesView::ApplyPendingUpdate()
+{
+	if (!updatePending)
+		return;
+
+	updateTimer.stop();
+	updatePending = false;
+
+	if (callback && !deferUpdate)
+		callback(obj, settings);
+
+	vector<string> modified = move(pendingModified);
+	pendingModified.clear();
+
+	bool refresh = false;
+	for (const string &name : modified) {
+		obs_property_t *prop =
+			obs_properties_get(properties.get(), name.c_str());
+		if (prop && PropertyModified(prop)) {
+			lastFocused = name;
+			refresh = true;
+		}
+	}
+
+	if (refresh)
+		QMetaObject::invokeMethod(this, "RefreshProperties",
+					  Qt::QueuedConnection);
+}
+
+void OBSPropertiesView::hideEvent(QHideEvent *event)
+{
+	ApplyPendingUpdate();
+	VScrollArea::hideEvent(event);
+}
+
+static inline void AppendState(string &state, const char *str)
+{
+	if (str)
+		state += str;
+	state += '\0';
+}
+
+static inline void AppendState(string &state, long long val)
+{
+	state += to_string(val);
+	state += '\0';
+}
+
+static inline void AppendState(string &state, bool val)
+{
+	state += val ? '1' : '0';
+}
+
+static inline void AppendState(string &state, double val)
+{
+	state.append((const char *)&val, sizeof(val));
+}
+
+static inline void AppendState(string &state,
+			       const media_frames_per_second &fps)
+{
+	AppendState(state, (long long)fps.numerator);
+	AppendState(state, (long long)fps.denominator);
+}
+
+static void AppendListState(string &state, obs_property_t *prop)
+{
+	obs_combo_format format = obs_property_list_format(prop);
+	size_t count = obs_property_list_item_count(prop);
+
+	AppendState(state, (long long)obs_property_list_type(prop));
+	AppendState(state, (long long)format);
+
+	for (size_t i = 0; i < count; i++) {
+		AppendState(state, obs_property_list_item_name(prop, i));
+		AppendState(state, obs_property_list_item_disabled(prop, i));
+
+		if (format == OBS_COMBO_FORMAT_INT)
+			AppendState(state, obs_property_list_item_int(prop, i));
+		else if (format == OBS_COMBO_FORMAT_FLOAT)
+			AppendState(state,
+				    obs_property_list_item_float(prop, i));
+		else if (format == OBS_COMBO_FORMAT_STRING)
+			AppendState(state,
+				    obs_property_list_item_string(prop, i));
+	}
+}
+
+static void AppendEditableListState(string &state, obs_property_t *prop)
+{
+	obs_editable_list_type type = obs_property_editable_list_type(prop);
+
+	AppendState(state, (long long)type);
+	AppendState(state, obs_property_editable_list_filter(prop));
+	AppendState(state, obs_property_editable_list_default_path(prop));
+}
+
+static void AppendFrameRateState(string &state, obs_property_t *prop)
+{
+	size_t count = obs_property_frame_rate_options_count(prop);
+
+	for (size_t i = 0; i < count; i++) {
+		AppendState(state,
+			    obs_property_frame_rate_option_name(prop, i));
+		AppendState(state, obs_property_frame_rate_option_description(
+					   prop, i));
+	}
+
+	count = obs_property_frame_rate_fps_ranges_count(prop);
+	for (size_t i = 0; i < count; i++) {
+		AppendState(state,
+			    obs_property_frame_rate_fps_range_min(prop, i));
+		AppendState(state,
+			    obs_property_frame_rate_fps_range_max(prop, i));
+	}
+}
+
+static void AppendPropertiesState(string &state, obs_properties_t *props)
+{
+	obs_property_t *p = obs_properties_first(props);
+
+	while (p) {
+		obs_property_type type = obs_property_get_type(p);
+
+		AppendState(state, obs_property_name(p));
+		AppendState(state, (long long)type);
+		AppendState(state, obs_property_visible(p));
+		AppendState(state, obs_property_enabled(p));
+		AppendState(state, obs_property_description(p));
+		AppendState(state, obs_property_long_description(p));
+
+		switch (type) {
+		case OBS_PROPERTY_INT:
+			AppendState(state, (long long)obs_property_int_min(p));
+			AppendState(state, (long long)obs_property_int_max(p));
+			AppendState(state, (long long)obs_property_int_step(p));
+			AppendState(state,
+				    (long long)obs_property_int_type(p));
+			AppendState(state, obs_property_int_suffix(p));
+			break;
+		case OBS_PROPERTY_FLOAT:
+			AppendState(state, obs_property_float_min(p));
+			AppendState(state, obs_property_float_max(p));
+			AppendState(state, obs_property_float_step(p));
+			AppendState(state,
+				    (long long)obs_property_float_type(p));
+			AppendState(state, obs_property_float_suffix(p));
+			break;
+		case OBS_PROPERTY_TEXT:
+			AppendState(state,
+				    (long long)obs_property_text_type(p));
+			break;
+		case OBS_PROPERTY_PATH:
+			AppendState(state,
+				    (long long)obs_property_path_type(p));
+			AppendState(state, obs_property_path_filter(p));
+			AppendState(state,
+				    obs_property_path_default_path(p));
+			break;
+		case OBS_PROPERTY_LIST:
+			AppendListState(state, p);
+			break;
+		case OBS_PROPERTY_EDITABLE_LIST:
+			AppendEditableListState(state, p);
+			break;
+		case OBS_PROPERTY_FRAME_RATE:
+			AppendFrameRateState(state, p);
+			break;
+		case OBS_PROPERTY_GROUP:
+			AppendState(state,
+				    (long long)obs_property_group_type(p));
+			AppendPropertiesState(state,
+					      obs_property_group_content(p));
+			break;
+		default:
+			break;
+		}
+
+		obs_property_next(&p);
+	}
+}
+
+static void AppendDefaultsState(string &state, obs_data_t *settings)
+{
+	obs_data_item_t *item = obs_data_first(settings);
+
+	for (; item; obs_data_item_next(&item)) {
+		if (!obs_data_item_has_default_value(item))
+			continue;
+
+		AppendState(state, obs_data_item_get_name(item));
+
+		switch (obs_data_item_gettype(item)) {
+		case OBS_DATA_STRING:
+			AppendState(state,
+				    obs_data_item_get_default_string(item));
+			break;
+		case OBS_DATA_NUMBER:
+			if (obs_data_item_numtype(item) == OBS_DATA_NUM_INT)
+				AppendState(state,
+					obs_data_item_get_default_int(item));
+			else
+				AppendState(state,
+					obs_data_item_get_default_double(item));
+			break;
+		case OBS_DATA_BOOLEAN:
+			AppendState(state,
+				    obs_data_item_get_default_bool(item));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/* everything the widgets are built from: the properties themselves plus the
+ * values shown in them */
+string OBSPropertiesView::GetState()
+{
+	string state;
+
+	AppendPropertiesState(state, properties.get());
+	AppendState(state, obs_data_get_json(settings));
+	AppendDefaultsState(state, settings);
+	return state;
+}
+
+/* plugins return true from their modified callbacks whenever they might have
+ * changed something, so rebuilding the widgets is only worth it if the
+ * properties or settings actually look different afterwards */
+bool OBSPropertiesView::PropertyModified(obs_property_t *prop)
+{
+	string before = GetState();
+
+	if (!obs_property_modified(prop, settings))
+		return false;
+
+	return GetState() != before;
+}
+
 static bool FrameRateChangedVariant(const QVariant &variant,
 				    media_frames_per_second &fps,
 				    obs_data_item_t *&obj,
@@ -1893,17 +2163,21 @@ void WidgetInfo::ControlChanged()
 		break;
 	case OBS_PROPERTY_INT:
 		IntChanged(setting);
-		break;
+		view->ScheduleUpdate(property);
+		return;
 	case OBS_PROPERTY_FLOAT:
 		FloatChanged(setting);
-		break;
+		view->ScheduleUpdate(property);
+		return;
 	case OBS_PROPERTY_TEXT:
 		TextChanged(setting);
-		break;
+		view->ScheduleUpdate(property);
+		return;
 	case OBS_PROPERTY_LIST:
 		ListChanged(setting);
 		break;
 	case OBS_PROPERTY_BUTTON:
+		view->ApplyPendingUpdate();
 		ButtonClicked();
 		return;
 	case OBS_PROPERTY_COLOR:
@@ -1933,12 +2207,14 @@ void WidgetInfo::ControlChanged()
 		break;
 	}
 
+	view->ApplyPendingUpdate();
+
 	if (view->callback && !view->deferUpdate)
 		view->callback(view->obj, view->settings);
 
 	view->SignalChanged();
 
-	if (obs_property_modified(property, view->settings)) {
+	if (view->PropertyModified(property)) {
 		view->lastFocused = setting;
 		QMetaObject::invokeMethod(view, "RefreshProperties",
 					  Qt::QueuedConnection);
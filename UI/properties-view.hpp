@@ -1,9 +1,11 @@
 #pragma once
 
 #include "vertical-scroll-area.hpp"
+#include <QTimer>
 #include <obs.hpp>
 #include <vector>
 #include <memory>
+#include <string>
 
 class QFormLayout;
 class OBSPropertiesView;
@@ -89,6 +91,10 @@ private:
 	QWidget *lastWidget = nullptr;
 	bool deferUpdate;
 
+	QTimer updateTimer;
+	bool updatePending = false;
+	std::vector<std::string> pendingModified;
+
 	QWidget *NewWidget(obs_property_t *prop, QWidget *widget,
 			   const char *signal);
 
@@ -122,10 +128,18 @@ private:
 	void GetScrollPos(int &h, int &v);
 	void SetScrollPos(int h, int v);
 
+	void InitUpdateTimer();
+	void ScheduleUpdate(obs_property_t *prop);
+	bool PropertyModified(obs_property_t *prop);
+	std::string GetState();
+
+	void hideEvent(QHideEvent *event) override;
+
 public slots:
 	void ReloadProperties();
 	void RefreshProperties();
 	void SignalChanged();
+	void ApplyPendingUpdate();
 
 signals:
 	void PropertiesResized();
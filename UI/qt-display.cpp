@@ -1,6 +1,8 @@
 #include "qt-display.hpp"
 #include "qt-wrappers.hpp"
 #include "display-helpers.hpp"
+#include "obs-app.hpp"
+#include <QApplication>
 #include <QWindow>
 #include <QScreen>
 #include <QResizeEvent>
@@ -94,6 +96,7 @@ OBSQTDisplay::OBSQTDisplay(QWidget *parent, Qt::WindowFlags flags)
 			if (obs_get_nix_platform() == OBS_NIX_PLATFORM_WAYLAND)
 				display = nullptr;
 #endif
+			UpdateOccluded();
 			return;
 		}
 
@@ -115,6 +118,7 @@ OBSQTDisplay::OBSQTDisplay(QWidget *parent, Qt::WindowFlags flags)
 
 	connect(windowHandle(), &QWindow::visibleChanged, windowVisible);
 	connect(windowHandle(), &QWindow::screenChanged, screenChanged);
+	windowHandle()->installEventFilter(this);
 
 #ifdef ENABLE_WAYLAND
 	if (obs_get_nix_platform() == OBS_NIX_PLATFORM_WAYLAND)
@@ -163,10 +167,48 @@ void OBSQTDisplay::CreateDisplay(bool force)
 		return;
 
 	display = obs_display_create(&info, backgroundColor);
+	UpdateMaxFPS();
+	UpdateOccluded();
 
 	emit DisplayCreated(this);
 }
 
+bool OBSQTDisplay::eventFilter(QObject *obj, QEvent *event)
+{
+	if (obj == windowHandle() && event->type() == QEvent::Expose)
+		UpdateOccluded();
+
+	return QWidget::eventFilter(obj, event);
+}
+
+/* windows are unexposed when minimized or hidden, and on platforms that
+ * track it, when they are fully covered */
+void OBSQTDisplay::UpdateOccluded()
+{
+	QWindow *handle = windowHandle();
+	bool occluded = !handle || !handle->isExposed() ||
+			window()->isMinimized();
+
+	obs_display_set_occluded(display, occluded);
+}
+
+void OBSQTDisplay::UpdateMaxFPS()
+{
+	uint32_t maxFPS = (uint32_t)config_get_uint(
+		GetGlobalConfig(), "BasicWindow", "DisplayMaxFPS");
+
+	obs_display_set_max_fps(display, maxFPS);
+}
+
+void OBSQTDisplay::UpdateAllMaxFPS()
+{
+	for (QWidget *widget : QApplication::allWidgets()) {
+		OBSQTDisplay *display = qobject_cast<OBSQTDisplay *>(widget);
+		if (display)
+			display->UpdateMaxFPS();
+	}
+}
+
 void OBSQTDisplay::resizeEvent(QResizeEvent *event)
 {
 	QWidget::resizeEvent(event);
@@ -15,6 +15,9 @@ class OBSQTDisplay : public QWidget {
 
 	void resizeEvent(QResizeEvent *event) override;
 	void paintEvent(QPaintEvent *event) override;
+	bool eventFilter(QObject *obj, QEvent *event) override;
+
+	void UpdateOccluded();
 
 signals:
 	void DisplayCreated(OBSQTDisplay *window);
@@ -35,4 +38,7 @@ public:
 	void SetDisplayBackgroundColor(const QColor &color);
 	void UpdateDisplayBackgroundColor();
 	void CreateDisplay(bool force = false);
+
+	void UpdateMaxFPS();
+	static void UpdateAllMaxFPS();
 };
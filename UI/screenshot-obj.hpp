@@ -17,7 +17,6 @@
 
 #include <QObject>
 #include <string>
-#include <thread>
 #include <obs.hpp>
 
 class ScreenshotObj : public QObject {
@@ -26,22 +25,8 @@ class ScreenshotObj : public QObject {
 public:
 	ScreenshotObj(obs_source_t *source);
 	~ScreenshotObj() override;
-	void Screenshot();
-	void Download();
-	void Copy();
-	void MuxAndFinish();
+	void Save(const uint8_t *data, uint32_t linesize, uint32_t cx,
+		  uint32_t cy);
 
-	gs_texrender_t *texrender = nullptr;
-	gs_stagesurf_t *stagesurf = nullptr;
-	OBSWeakSource weakSource;
 	std::string path;
-	QImage image;
-	uint32_t cx;
-	uint32_t cy;
-	std::thread th;
-
-	int stage = 0;
-
-public slots:
-	void Save();
 };
@@ -11,6 +11,7 @@
 #include <obs.h>
 
 #include <string>
+#include <algorithm>
 
 #include <QLabel>
 #include <QLineEdit>
@@ -156,22 +157,10 @@ void SourceTreeItem::paintEvent(QPaintEvent *event)
 
 void SourceTreeItem::DisconnectSignals()
 {
-	sceneRemoveSignal.Disconnect();
-	itemRemoveSignal.Disconnect();
-	selectSignal.Disconnect();
-	deselectSignal.Disconnect();
-	visibleSignal.Disconnect();
-	lockedSignal.Disconnect();
 	renameSignal.Disconnect();
 	removeSignal.Disconnect();
 }
 
-void SourceTreeItem::Clear()
-{
-	DisconnectSignals();
-	sceneitem = nullptr;
-}
-
 void SourceTreeItem::ReconnectSignals()
 {
 	if (!sceneitem)
@@ -181,92 +170,6 @@ void SourceTreeItem::ReconnectSignals()
 
 	/* --------------------------------------------------------- */
 
-	auto removeItem = [](void *data, calldata_t *cd) {
-		SourceTreeItem *this_ =
-			reinterpret_cast<SourceTreeItem *>(data);
-		obs_sceneitem_t *curItem =
-			(obs_sceneitem_t *)calldata_ptr(cd, "item");
-
-		if (curItem == this_->sceneitem) {
-			QMetaObject::invokeMethod(this_->tree, "Remove",
-						  Q_ARG(OBSSceneItem, curItem));
-			curItem = nullptr;
-		}
-		if (!curItem)
-			QMetaObject::invokeMethod(this_, "Clear");
-	};
-
-	auto itemVisible = [](void *data, calldata_t *cd) {
-		SourceTreeItem *this_ =
-			reinterpret_cast<SourceTreeItem *>(data);
-		obs_sceneitem_t *curItem =
-			(obs_sceneitem_t *)calldata_ptr(cd, "item");
-		bool visible = calldata_bool(cd, "visible");
-
-		if (curItem == this_->sceneitem)
-			QMetaObject::invokeMethod(this_, "VisibilityChanged",
-						  Q_ARG(bool, visible));
-	};
-
-	auto itemLocked = [](void *data, calldata_t *cd) {
-		SourceTreeItem *this_ =
-			reinterpret_cast<SourceTreeItem *>(data);
-		obs_sceneitem_t *curItem =
-			(obs_sceneitem_t *)calldata_ptr(cd, "item");
-		bool locked = calldata_bool(cd, "locked");
-
-		if (curItem == this_->sceneitem)
-			QMetaObject::invokeMethod(this_, "LockedChanged",
-						  Q_ARG(bool, locked));
-	};
-
-	auto itemSelect = [](void *data, calldata_t *cd) {
-		SourceTreeItem *this_ =
-			reinterpret_cast<SourceTreeItem *>(data);
-		obs_sceneitem_t *curItem =
-			(obs_sceneitem_t *)calldata_ptr(cd, "item");
-
-		if (curItem == this_->sceneitem)
-			QMetaObject::invokeMethod(this_, "Select");
-	};
-
-	auto itemDeselect = [](void *data, calldata_t *cd) {
-		SourceTreeItem *this_ =
-			reinterpret_cast<SourceTreeItem *>(data);
-		obs_sceneitem_t *curItem =
-			(obs_sceneitem_t *)calldata_ptr(cd, "item");
-
-		if (curItem == this_->sceneitem)
-			QMetaObject::invokeMethod(this_, "Deselect");
-	};
-
-	auto reorderGroup = [](void *data, calldata_t *) {
-		SourceTreeItem *this_ =
-			reinterpret_cast<SourceTreeItem *>(data);
-		QMetaObject::invokeMethod(this_->tree, "ReorderItems");
-	};
-
-	obs_scene_t *scene = obs_sceneitem_get_scene(sceneitem);
-	obs_source_t *sceneSource = obs_scene_get_source(scene);
-	signal_handler_t *signal = obs_source_get_signal_handler(sceneSource);
-
-	sceneRemoveSignal.Connect(signal, "remove", removeItem, this);
-	itemRemoveSignal.Connect(signal, "item_remove", removeItem, this);
-	visibleSignal.Connect(signal, "item_visible", itemVisible, this);
-	lockedSignal.Connect(signal, "item_locked", itemLocked, this);
-	selectSignal.Connect(signal, "item_select", itemSelect, this);
-	deselectSignal.Connect(signal, "item_deselect", itemDeselect, this);
-
-	if (obs_sceneitem_is_group(sceneitem)) {
-		obs_source_t *source = obs_sceneitem_get_source(sceneitem);
-		signal = obs_source_get_signal_handler(source);
-
-		groupReorderSignal.Connect(signal, "reorder", reorderGroup,
-					   this);
-	}
-
-	/* --------------------------------------------------------- */
-
 	auto renamed = [](void *data, calldata_t *cd) {
 		SourceTreeItem *this_ =
 			reinterpret_cast<SourceTreeItem *>(data);
@@ -284,7 +187,7 @@ void SourceTreeItem::ReconnectSignals()
 	};
 
 	obs_source_t *source = obs_sceneitem_get_source(sceneitem);
-	signal = obs_source_get_signal_handler(source);
+	signal_handler_t *signal = obs_source_get_signal_handler(source);
 	renameSignal.Connect(signal, "rename", renamed, this);
 	removeSignal.Connect(signal, "remove", removeSource, this);
 }
@@ -533,18 +436,6 @@ void SourceTreeItem::ExpandClicked(bool checked)
 		tree->GetStm()->CollapseGroup(sceneitem);
 }
 
-void SourceTreeItem::Select()
-{
-	tree->SelectItem(sceneitem, true);
-	OBSBasic::Get()->UpdateContextBarDeferred();
-}
-
-void SourceTreeItem::Deselect()
-{
-	tree->SelectItem(sceneitem, false);
-	OBSBasic::Get()->UpdateContextBarDeferred();
-}
-
 /* ========================================================================= */
 
 void SourceTreeModel::OBSFrontendEvent(enum obs_frontend_event event, void *ptr)
@@ -562,12 +453,116 @@ void SourceTreeModel::OBSFrontendEvent(enum obs_frontend_event event, void *ptr)
 	}
 }
 
+void SourceTreeModel::ConnectSceneSignals(obs_source_t *source, bool group)
+{
+	auto itemRemove = [](void *data, calldata_t *cd) {
+		SourceTreeModel *this_ =
+			reinterpret_cast<SourceTreeModel *>(data);
+		obs_sceneitem_t *item =
+			(obs_sceneitem_t *)calldata_ptr(cd, "item");
+
+		QMetaObject::invokeMethod(this_->st, "Remove",
+					  Q_ARG(OBSSceneItem, item));
+	};
+
+	auto itemVisible = [](void *data, calldata_t *cd) {
+		SourceTreeModel *this_ =
+			reinterpret_cast<SourceTreeModel *>(data);
+		obs_sceneitem_t *item =
+			(obs_sceneitem_t *)calldata_ptr(cd, "item");
+		bool visible = calldata_bool(cd, "visible");
+
+		QMetaObject::invokeMethod(this_->st, "ItemVisibilityChanged",
+					  Q_ARG(OBSSceneItem, item),
+					  Q_ARG(bool, visible));
+	};
+
+	auto itemLocked = [](void *data, calldata_t *cd) {
+		SourceTreeModel *this_ =
+			reinterpret_cast<SourceTreeModel *>(data);
+		obs_sceneitem_t *item =
+			(obs_sceneitem_t *)calldata_ptr(cd, "item");
+		bool locked = calldata_bool(cd, "locked");
+
+		QMetaObject::invokeMethod(this_->st, "ItemLockedChanged",
+					  Q_ARG(OBSSceneItem, item),
+					  Q_ARG(bool, locked));
+	};
+
+	auto itemSelect = [](void *data, calldata_t *cd) {
+		SourceTreeModel *this_ =
+			reinterpret_cast<SourceTreeModel *>(data);
+		obs_sceneitem_t *item =
+			(obs_sceneitem_t *)calldata_ptr(cd, "item");
+
+		QMetaObject::invokeMethod(this_->st, "ItemSelected",
+					  Q_ARG(OBSSceneItem, item),
+					  Q_ARG(bool, true));
+	};
+
+	auto itemDeselect = [](void *data, calldata_t *cd) {
+		SourceTreeModel *this_ =
+			reinterpret_cast<SourceTreeModel *>(data);
+		obs_sceneitem_t *item =
+			(obs_sceneitem_t *)calldata_ptr(cd, "item");
+
+		QMetaObject::invokeMethod(this_->st, "ItemSelected",
+					  Q_ARG(OBSSceneItem, item),
+					  Q_ARG(bool, false));
+	};
+
+	auto reorderGroup = [](void *data, calldata_t *) {
+		SourceTreeModel *this_ =
+			reinterpret_cast<SourceTreeModel *>(data);
+		QMetaObject::invokeMethod(this_->st, "ReorderItems");
+	};
+
+	signal_handler_t *signal = obs_source_get_signal_handler(source);
+
+	sceneSignals.emplace_back();
+	SceneSignals &sig = sceneSignals.back();
+
+	sig.source = source;
+	sig.itemRemove.Connect(signal, "item_remove", itemRemove, this);
+	sig.itemVisible.Connect(signal, "item_visible", itemVisible, this);
+	sig.itemLocked.Connect(signal, "item_locked", itemLocked, this);
+	sig.itemSelect.Connect(signal, "item_select", itemSelect, this);
+	sig.itemDeselect.Connect(signal, "item_deselect", itemDeselect, this);
+
+	if (group)
+		sig.groupReorder.Connect(signal, "reorder", reorderGroup, this);
+}
+
+void SourceTreeModel::ConnectSceneSignals()
+{
+	OBSScene scene = GetCurrentScene();
+
+	sceneSignals.clear();
+	if (!scene)
+		return;
+
+	auto connectGroup = [](obs_scene_t *, obs_sceneitem_t *item,
+			       void *ptr) {
+		SourceTreeModel *this_ =
+			reinterpret_cast<SourceTreeModel *>(ptr);
+
+		if (obs_sceneitem_is_group(item))
+			this_->ConnectSceneSignals(
+				obs_sceneitem_get_source(item), true);
+		return true;
+	};
+
+	ConnectSceneSignals(obs_scene_get_source(scene), false);
+	obs_scene_enum_items(scene, connectGroup, this);
+}
+
 void SourceTreeModel::Clear()
 {
 	beginResetModel();
 	items.clear();
 	endResetModel();
 
+	sceneSignals.clear();
 	hasGroups = false;
 }
 
@@ -603,17 +598,20 @@ void SourceTreeModel::SceneChanged()
 	obs_scene_enum_items(scene, enumItem, &items);
 	endResetModel();
 
+	ConnectSceneSignals();
+
 	UpdateGroupState(false);
 	st->ResetWidgets();
 
+	QItemSelection selection;
 	for (int i = 0; i < items.count(); i++) {
-		bool select = obs_sceneitem_selected(items[i]);
-		QModelIndex index = createIndex(i, 0);
-
-		st->selectionModel()->select(
-			index, select ? QItemSelectionModel::Select
-				      : QItemSelectionModel::Deselect);
+		if (obs_sceneitem_selected(items[i])) {
+			QModelIndex index = createIndex(i, 0);
+			selection.select(index, index);
+		}
 	}
+
+	st->selectionModel()->select(selection, QItemSelectionModel::Select);
 }
 
 /* moves a scene item index (blame linux distros for using older Qt builds) */
@@ -711,8 +709,6 @@ void SourceTreeModel::Add(obs_sceneitem_t *item)
 		beginInsertRows(QModelIndex(), 0, 0);
 		items.insert(0, item);
 		endInsertRows();
-
-		st->UpdateWidget(createIndex(0, 0, nullptr), item);
 	}
 }
 
@@ -752,8 +748,15 @@ void SourceTreeModel::Remove(obs_sceneitem_t *item)
 	items.remove(idx, endIdx - startIdx + 1);
 	endRemoveRows();
 
-	if (is_group)
+	if (is_group) {
+		obs_source_t *source = obs_sceneitem_get_source(item);
+
+		sceneSignals.remove_if([source](const SceneSignals &sig) {
+			return sig.source == source;
+		});
+
 		UpdateGroupState(true);
+	}
 }
 
 OBSSceneItem SourceTreeModel::Get(int idx)
@@ -837,7 +840,7 @@ void SourceTreeModel::AddGroup()
 	items.insert(0, group);
 	endInsertRows();
 
-	st->UpdateWidget(createIndex(0, 0, nullptr), group);
+	ConnectSceneSignals(obs_sceneitem_get_source(group), true);
 	UpdateGroupState(true);
 
 	QMetaObject::invokeMethod(st, "Edit", Qt::QueuedConnection,
@@ -885,6 +888,8 @@ void SourceTreeModel::GroupSelectedItems(QModelIndexList &indices)
 		}
 	}
 
+	ConnectSceneSignals(obs_sceneitem_get_source(item), true);
+
 	hasGroups = true;
 	st->UpdateWidgets(true);
 
@@ -992,6 +997,13 @@ SourceTree::SourceTree(QWidget *parent_) : QListView(parent_)
 
 	setMouseTracking(true);
 
+	connect(stm_, &QAbstractItemModel::rowsInserted, this,
+		&SourceTree::ScheduleVisibleWidgets);
+	connect(stm_, &QAbstractItemModel::rowsRemoved, this,
+		&SourceTree::ScheduleVisibleWidgets);
+	connect(stm_, &QAbstractItemModel::rowsMoved, this,
+		&SourceTree::ScheduleVisibleWidgets);
+
 	UpdateNoSourcesMessage();
 	connect(App(), &OBSApp::StyleChanged, this,
 		&SourceTree::UpdateNoSourcesMessage);
@@ -1014,15 +1026,10 @@ void SourceTree::SetIconsVisible(bool visible)
 
 void SourceTree::ResetWidgets()
 {
-	OBSScene scene = GetCurrentScene();
-
 	SourceTreeModel *stm = GetStm();
 	stm->UpdateGroupState(false);
 
-	for (int i = 0; i < stm->items.count(); i++) {
-		QModelIndex index = stm->createIndex(i, 0, nullptr);
-		setIndexWidget(index, new SourceTreeItem(this, stm->items[i]));
-	}
+	UpdateVisibleWidgets();
 }
 
 void SourceTree::UpdateWidget(const QModelIndex &idx, obs_sceneitem_t *item)
@@ -1035,15 +1042,112 @@ void SourceTree::UpdateWidgets(bool force)
 	SourceTreeModel *stm = GetStm();
 
 	for (int i = 0; i < stm->items.size(); i++) {
-		obs_sceneitem_t *item = stm->items[i];
-		SourceTreeItem *widget = GetItemWidget(i);
+		QModelIndex index = stm->createIndex(i, 0);
+		QWidget *widget = indexWidget(index);
 
-		if (!widget) {
-			UpdateWidget(stm->createIndex(i, 0), item);
-		} else {
-			widget->Update(force);
-		}
+		if (widget)
+			reinterpret_cast<SourceTreeItem *>(widget)->Update(
+				force);
+	}
+
+	UpdateVisibleWidgets();
+}
+
+/* rows only get a widget once they are scrolled into view, so a scene with
+ * hundreds of sources doesn't create hundreds of widgets on every change */
+void SourceTree::UpdateVisibleWidgets()
+{
+	SourceTreeModel *stm = GetStm();
+	int count = stm->items.count();
+
+	widgetsPending = false;
+	if (!count)
+		return;
+
+	QRect rect = viewport()->rect();
+	QModelIndex first = indexAt(rect.topLeft());
+	QModelIndex last = indexAt(rect.bottomLeft());
+
+	/* a few rows past each edge so that scrolling by a step doesn't show
+	 * empty rows */
+	int start = first.isValid() ? first.row() : 0;
+	int end = last.isValid() ? last.row() : count - 1;
+	start = std::max(start - 4, 0);
+	end = std::min(end + 4, count - 1);
+
+	for (int i = start; i <= end; i++) {
+		QModelIndex index = stm->createIndex(i, 0);
+		if (!indexWidget(index))
+			UpdateWidget(index, stm->items[i]);
+	}
+}
+
+void SourceTree::ScheduleVisibleWidgets()
+{
+	if (widgetsPending)
+		return;
+
+	widgetsPending = true;
+	QMetaObject::invokeMethod(this, "UpdateVisibleWidgets",
+				  Qt::QueuedConnection);
+}
+
+SourceTreeItem *SourceTree::GetItemWidget(int idx)
+{
+	SourceTreeModel *stm = GetStm();
+	if (idx < 0 || idx >= stm->items.count())
+		return nullptr;
+
+	QModelIndex index = stm->createIndex(idx, 0);
+	QWidget *widget = indexWidget(index);
+	if (!widget) {
+		UpdateWidget(index, stm->items[idx]);
+		widget = indexWidget(index);
 	}
+
+	return reinterpret_cast<SourceTreeItem *>(widget);
+}
+
+void SourceTree::ItemSelected(OBSSceneItem item, bool select)
+{
+	SelectItem(item, select);
+	OBSBasic::Get()->UpdateContextBarDeferred();
+}
+
+void SourceTree::ItemVisibilityChanged(OBSSceneItem item, bool visible)
+{
+	int idx = GetStm()->items.indexOf(item);
+	if (idx == -1)
+		return;
+
+	QWidget *widget = indexWidget(GetStm()->createIndex(idx, 0));
+	if (widget)
+		reinterpret_cast<SourceTreeItem *>(widget)->VisibilityChanged(
+			visible);
+}
+
+void SourceTree::ItemLockedChanged(OBSSceneItem item, bool locked)
+{
+	int idx = GetStm()->items.indexOf(item);
+	if (idx == -1)
+		return;
+
+	QWidget *widget = indexWidget(GetStm()->createIndex(idx, 0));
+	if (widget)
+		reinterpret_cast<SourceTreeItem *>(widget)->LockedChanged(
+			locked);
+}
+
+void SourceTree::resizeEvent(QResizeEvent *event)
+{
+	QListView::resizeEvent(event);
+	ScheduleVisibleWidgets();
+}
+
+void SourceTree::scrollContentsBy(int dx, int dy)
+{
+	QListView::scrollContentsBy(dx, dy);
+	ScheduleVisibleWidgets();
 }
 
 void SourceTree::SelectItem(obs_sceneitem_t *sceneitem, bool select)
@@ -1417,11 +1521,11 @@ void SourceTree::Edit(int row)
 		return;
 
 	QModelIndex index = stm->createIndex(row, 0);
-	QWidget *widget = indexWidget(index);
-	SourceTreeItem *itemWidget = reinterpret_cast<SourceTreeItem *>(widget);
+	SourceTreeItem *itemWidget = GetItemWidget(row);
 	if (itemWidget->IsEditing())
 		return;
 
+	scrollTo(index);
 	itemWidget->EnterEditMode();
 	edit(index);
 }
@@ -1498,6 +1602,11 @@ bool SourceTree::GroupedItemsSelected() const
 void SourceTree::Remove(OBSSceneItem item)
 {
 	OBSBasic *main = reinterpret_cast<OBSBasic *>(App()->GetMainWindow());
+
+	/* items of collapsed groups have no row */
+	if (GetStm()->items.indexOf(item) == -1)
+		return;
+
 	GetStm()->Remove(item);
 	main->SaveProject();
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <list>
 #include <QList>
 #include <QVector>
 #include <QPointer>
@@ -67,21 +68,12 @@ private:
 
 	SourceTree *tree;
 	OBSSceneItem sceneitem;
-	OBSSignal sceneRemoveSignal;
-	OBSSignal itemRemoveSignal;
-	OBSSignal groupReorderSignal;
-	OBSSignal selectSignal;
-	OBSSignal deselectSignal;
-	OBSSignal visibleSignal;
-	OBSSignal lockedSignal;
 	OBSSignal renameSignal;
 	OBSSignal removeSignal;
 
 	virtual void paintEvent(QPaintEvent *event) override;
 
 private slots:
-	void Clear();
-
 	void EnterEditMode();
 	void ExitEditMode(bool save);
 
@@ -90,9 +82,6 @@ private slots:
 	void Renamed(const QString &name);
 
 	void ExpandClicked(bool checked);
-
-	void Select();
-	void Deselect();
 };
 
 class SourceTreeModel : public QAbstractListModel {
@@ -101,11 +90,27 @@ class SourceTreeModel : public QAbstractListModel {
 	friend class SourceTree;
 	friend class SourceTreeItem;
 
+	/* scene signals are connected once per scene and group rather than
+	 * once per row, the source reference keeps the signal handler alive
+	 * until the connections are dropped */
+	struct SceneSignals {
+		OBSSource source;
+		OBSSignal itemRemove;
+		OBSSignal itemVisible;
+		OBSSignal itemLocked;
+		OBSSignal itemSelect;
+		OBSSignal itemDeselect;
+		OBSSignal groupReorder;
+	};
+
 	SourceTree *st;
 	QVector<OBSSceneItem> items;
+	std::list<SceneSignals> sceneSignals;
 	bool hasGroups = false;
 
 	static void OBSFrontendEvent(enum obs_frontend_event event, void *ptr);
+	void ConnectSceneSignals(obs_source_t *source, bool group);
+	void ConnectSceneSignals();
 	void Clear();
 	void SceneChanged();
 	void ReorderItems();
@@ -149,12 +154,14 @@ class SourceTree : public QListView {
 	QSvgRenderer iconNoSources;
 
 	bool iconsVisible = true;
+	bool widgetsPending = false;
 
 	void UpdateNoSourcesMessage();
 
 	void ResetWidgets();
 	void UpdateWidget(const QModelIndex &idx, obs_sceneitem_t *item);
 	void UpdateWidgets(bool force = false);
+	void ScheduleVisibleWidgets();
 
 	inline SourceTreeModel *GetStm() const
 	{
@@ -162,11 +169,7 @@ class SourceTree : public QListView {
 	}
 
 public:
-	inline SourceTreeItem *GetItemWidget(int idx)
-	{
-		QWidget *widget = indexWidget(GetStm()->createIndex(idx, 0));
-		return reinterpret_cast<SourceTreeItem *>(widget);
-	}
+	SourceTreeItem *GetItemWidget(int idx);
 
 	explicit SourceTree(QWidget *parent = nullptr);
 
@@ -195,12 +198,20 @@ public slots:
 	void AddGroup();
 	void Edit(int idx);
 
+private slots:
+	void UpdateVisibleWidgets();
+	void ItemSelected(OBSSceneItem item, bool select);
+	void ItemVisibilityChanged(OBSSceneItem item, bool visible);
+	void ItemLockedChanged(OBSSceneItem item, bool locked);
+
 protected:
 	virtual void mouseDoubleClickEvent(QMouseEvent *event) override;
 	virtual void dropEvent(QDropEvent *event) override;
 	virtual void mouseMoveEvent(QMouseEvent *event) override;
 	virtual void leaveEvent(QEvent *event) override;
 	virtual void paintEvent(QPaintEvent *event) override;
+	virtual void resizeEvent(QResizeEvent *event) override;
+	virtual void scrollContentsBy(int dx, int dy) override;
 
 	virtual void
 	selectionChanged(const QItemSelection &selected,
@@ -26,16 +26,6 @@ void VolControl::OBSVolumeChanged(void *data, float db)
 	QMetaObject::invokeMethod(volControl, "VolumeChanged");
 }
 
-void VolControl::OBSVolumeLevel(void *data,
-				const float magnitude[MAX_AUDIO_CHANNELS],
-				const float peak[MAX_AUDIO_CHANNELS],
-				const float inputPeak[MAX_AUDIO_CHANNELS])
-{
-	VolControl *volControl = static_cast<VolControl *>(data);
-
-	volControl->volMeter->setLevels(magnitude, peak, inputPeak);
-}
-
 void VolControl::OBSVolumeMuted(void *data, calldata_t *calldata)
 {
 	VolControl *volControl = static_cast<VolControl *>(data);
@@ -248,7 +238,6 @@ VolControl::VolControl(OBSSource source_, bool showConfig, bool vertical)
 	mute->setChecked(muted);
 	mute->setAccessibleName(QTStr("VolControl.Mute").arg(sourceName));
 	obs_fader_add_callback(obs_fader, OBSVolumeChanged, this);
-	obs_volmeter_add_callback(obs_volmeter, OBSVolumeLevel, this);
 
 	signal_handler_connect(obs_source_get_signal_handler(source), "mute",
 			       OBSVolumeMuted, this);
@@ -285,7 +274,6 @@ void VolControl::EnableSlider(bool enable)
 VolControl::~VolControl()
 {
 	obs_fader_remove_callback(obs_fader, OBSVolumeChanged, this);
-	obs_volmeter_remove_callback(obs_volmeter, OBSVolumeLevel, this);
 
 	signal_handler_disconnect(obs_source_get_signal_handler(source), "mute",
 				  OBSVolumeMuted, this);
@@ -530,6 +518,19 @@ void VolumeMeter::wheelEvent(QWheelEvent *event)
 	QApplication::sendEvent(focusProxy(), event);
 }
 
+/* levels are only measured while a meter shows them */
+void VolumeMeter::showEvent(QShowEvent *event)
+{
+	obs_volmeter_set_enabled(obs_volmeter, true);
+	QWidget::showEvent(event);
+}
+
+void VolumeMeter::hideEvent(QHideEvent *event)
+{
+	obs_volmeter_set_enabled(obs_volmeter, false);
+	QWidget::hideEvent(event);
+}
+
 VolumeMeter::VolumeMeter(QWidget *parent, obs_volmeter_t *obs_volmeter,
 			 bool vertical)
 	: QWidget(parent), obs_volmeter(obs_volmeter), vertical(vertical)
@@ -564,6 +565,10 @@ VolumeMeter::VolumeMeter(QWidget *parent, obs_volmeter_t *obs_volmeter,
 	channels = (int)audio_output_get_channels(obs_get_audio());
 
 	handleChannelCofigurationChange();
+
+	// Enabled by showEvent once the meter is visible.
+	obs_volmeter_set_enabled(obs_volmeter, false);
+
 	updateTimerRef = updateTimer.toStrongRef();
 	if (!updateTimerRef) {
 		updateTimerRef = QSharedPointer<VolumeMeterTimer>::create();
@@ -589,6 +594,7 @@ void VolumeMeter::setLevels(const float magnitude[MAX_AUDIO_CHANNELS],
 	QMutexLocker locker(&dataMutex);
 
 	currentLastUpdateTime = ts;
+	idlePainted = false;
 	for (int channelNr = 0; channelNr < MAX_AUDIO_CHANNELS; channelNr++) {
 		currentMagnitude[channelNr] = magnitude[channelNr];
 		currentPeak[channelNr] = peak[channelNr];
@@ -601,6 +607,29 @@ void VolumeMeter::setLevels(const float magnitude[MAX_AUDIO_CHANNELS],
 	calculateBallistics(ts);
 }
 
+/* Reads the levels of the meter if they changed since the last call, and
+ * returns whether the meter needs to be painted again.  A meter keeps being
+ * painted while its levels decay, until it has been painted idle once. */
+bool VolumeMeter::pollLevels()
+{
+	float magnitude[MAX_AUDIO_CHANNELS];
+	float peak[MAX_AUDIO_CHANNELS];
+	float inputPeak[MAX_AUDIO_CHANNELS];
+
+	if (obs_volmeter) {
+		uint64_t ts = obs_volmeter_get_levels(obs_volmeter, magnitude,
+						      peak, inputPeak);
+		if (ts && ts != lastLevelsTime) {
+			lastLevelsTime = ts;
+			setLevels(magnitude, peak, inputPeak);
+			return true;
+		}
+	}
+
+	QMutexLocker locker(&dataMutex);
+	return !idlePainted;
+}
+
 inline void VolumeMeter::resetLevels()
 {
 	currentLastUpdateTime = 0;
@@ -1016,6 +1045,10 @@ void VolumeMeter::paintEvent(QPaintEvent *event)
 	calculateBallistics(ts, timeSinceLastRedraw);
 	bool idle = detectIdle(ts);
 
+	dataMutex.lock();
+	idlePainted = idle;
+	dataMutex.unlock();
+
 	// Draw the ticks in a off-screen buffer when the widget changes size.
 	QSize tickPaintCacheSize;
 	if (vertical)
@@ -1109,6 +1142,8 @@ void VolumeMeterTimer::RemoveVolControl(VolumeMeter *meter)
 
 void VolumeMeterTimer::timerEvent(QTimerEvent *)
 {
-	for (VolumeMeter *meter : volumeMeters)
-		meter->update();
+	for (VolumeMeter *meter : volumeMeters) {
+		if (meter->pollLevels())
+			meter->update();
+	}
 }
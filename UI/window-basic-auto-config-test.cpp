@@ -1,10 +1,11 @@
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 
 #include <QFormLayout>
 
 #include <obs.hpp>
 #include <util/platform.h>
-#include <util/util_uint64.h>
 #include <graphics/vec4.h>
 #include <graphics/graphics.h>
 #include <graphics/math-extra.h>
@@ -99,6 +100,13 @@ public:
 #define TEST_RESULT_SE TEST_STR("Result.StreamingEncoder")
 #define TEST_RESULT_RE TEST_STR("Result.RecordingEncoder")
 
+/* tests are checked on at this interval; a server's bandwidth test ends once
+ * the last BW_STEADY_SAMPLES samples vary by no more than BW_STEADY_PCT */
+#define TEST_SAMPLE_MS 500
+#define BW_STEADY_SAMPLES 6
+#define BW_STEADY_PCT 10
+#define BW_MAX_SAMPLES 20
+
 void AutoConfigTestPage::StartBandwidthStage()
 {
 	ui->progressLabel->setText(QTStr(TEST_BW));
@@ -157,6 +165,29 @@ static inline void string_depad_key(string &key)
 
 const char *FindAudioEncoderFromCodec(const char *type);
 
+struct ThroughputStats {
+	double kbps = 0.0;
+	double jitter = 0.0;
+};
+
+static ThroughputStats GetThroughputStats(const vector<double> &samples)
+{
+	ThroughputStats stats;
+	size_t count = min(samples.size(), (size_t)BW_STEADY_SAMPLES);
+	if (!count)
+		return stats;
+
+	auto begin = samples.end() - count;
+	for (auto it = begin; it != samples.end(); ++it)
+		stats.kbps += *it;
+	stats.kbps /= (double)count;
+
+	for (auto it = begin; it != samples.end(); ++it)
+		stats.jitter += (*it - stats.kbps) * (*it - stats.kbps);
+	stats.jitter = sqrt(stats.jitter / (double)count);
+	return stats;
+}
+
 void AutoConfigTestPage::TestBandwidthThread()
 {
 	bool connected = false;
@@ -398,11 +429,37 @@ void AutoConfigTestPage::TestBandwidthThread()
 			return;
 		}
 
-		/* continue test */
-		int start_bytes = (int)obs_output_get_total_bytes(output);
-		uint64_t t_start = os_gettime_ns();
+		/* continue test, sampling the throughput until it is steady
+		 * instead of always waiting out the longest test time */
+		vector<double> samples;
+		uint64_t last_bytes = obs_output_get_total_bytes(output);
+		uint64_t last_time = os_gettime_ns();
+		ThroughputStats stats;
+
+		while (samples.size() < BW_MAX_SAMPLES) {
+			auto next = chrono::steady_clock::now() +
+				    chrono::milliseconds(TEST_SAMPLE_MS);
+			if (cv.wait_until(ul, next,
+					  [&] { return stopped || cancel; }))
+				break;
+
+			uint64_t bytes = obs_output_get_total_bytes(output);
+			uint64_t time = os_gettime_ns();
+			uint64_t elapsed = max(time - last_time, (uint64_t)1);
+
+			samples.push_back((double)(bytes - last_bytes) * 8.0 *
+					  1000000.0 / (double)elapsed);
+			last_bytes = bytes;
+			last_time = time;
+
+			if (samples.size() < BW_STEADY_SAMPLES)
+				continue;
+
+			stats = GetThroughputStats(samples);
+			if (stats.jitter * 100.0 <= stats.kbps * BW_STEADY_PCT)
+				break;
+		}
 
-		cv.wait_for(ul, chrono::seconds(10));
 		if (stopped)
 			continue;
 		if (cancel) {
@@ -414,23 +471,25 @@ void AutoConfigTestPage::TestBandwidthThread()
 		obs_output_stop(output);
 		cv.wait(ul);
 
-		uint64_t total_time = os_gettime_ns() - t_start;
-		if (total_time == 0)
-			total_time = 1;
+		/* an unsteady connection only counts with what it could
+		 * reliably sustain */
+		stats = GetThroughputStats(samples);
+		int bitrate = (int)max(stats.kbps - stats.jitter, 0.0);
+
+		server.ms = obs_output_get_connect_time_ms(output);
+		blog(LOG_INFO,
+		     "Bandwidth test for %s: %d kbps sustained, "
+		     "%d kbps jitter, %d ms to connect",
+		     server.name.c_str(), (int)stats.kbps, (int)stats.jitter,
+		     server.ms);
 
-		int total_bytes =
-			(int)obs_output_get_total_bytes(output) - start_bytes;
-		uint64_t bitrate = util_mul_div64(
-			total_bytes, 8ULL * 1000000000ULL / 1000ULL,
-			total_time);
 		if (obs_output_get_frames_dropped(output) ||
-		    (int)bitrate < (wiz->startingBitrate * 75 / 100)) {
-			server.bitrate = (int)bitrate * 70 / 100;
+		    bitrate < (wiz->startingBitrate * 75 / 100)) {
+			server.bitrate = bitrate * 70 / 100;
 		} else {
 			server.bitrate = wiz->startingBitrate;
 		}
 
-		server.ms = obs_output_get_connect_time_ms(output);
 		success = true;
 	}
 
@@ -689,7 +748,20 @@ bool AutoConfigTestPage::TestSoftwareEncoding()
 			return false;
 		}
 
-		cv.wait_for(ul, chrono::seconds(5));
+		/* stop early once the resolution has clearly failed */
+		video_t *video = obs_get_video();
+		auto end = chrono::steady_clock::now() + chrono::seconds(5);
+		auto interval = chrono::milliseconds(TEST_SAMPLE_MS);
+		while (!cancel && chrono::steady_clock::now() < end) {
+			auto next = min(end, chrono::steady_clock::now() +
+						     interval);
+			if (cv.wait_until(ul, next, [&] { return cancel; }))
+				break;
+			if (force)
+				continue;
+			if (video_output_get_skipped_frames(video) > 10)
+				break;
+		}
 
 		obs_output_stop(output);
 		cv.wait(ul);
@@ -18,6 +18,47 @@ volatile bool virtualcam_active = false;
 
 #define FTL_PROTOCOL "ftl"
 #define RTMP_PROTOCOL "rtmp"
+#define SRT_PROTOCOL "srt://"
+#define RIST_PROTOCOL "rist://"
+
+/* "fragmented_mp4" and "fragmented_mov" record to a .mp4/.mov file that
+ * stays playable if OBS crashes, so it needs no remux afterwards */
+#define FRAGMENTED_PREFIX "fragmented_"
+
+static inline bool IsFragmentedFormat(const char *format)
+{
+	return strncmp(format, FRAGMENTED_PREFIX,
+		       sizeof(FRAGMENTED_PREFIX) - 1) == 0;
+}
+
+static inline const char *GetFormatExtension(const char *format)
+{
+	return IsFragmentedFormat(format)
+		       ? format + sizeof(FRAGMENTED_PREFIX) - 1
+		       : format;
+}
+
+/* srt:// and rist:// go through the native output when obs-outputs was built
+ * with libsrt/librist, and through the FFmpeg MPEG-TS muxer otherwise */
+static bool IsNativeMpegTsUrl(const char *url)
+{
+	bool srt = astrcmpi_n(url, SRT_PROTOCOL, strlen(SRT_PROTOCOL)) == 0;
+	bool rist = astrcmpi_n(url, RIST_PROTOCOL, strlen(RIST_PROTOCOL)) == 0;
+
+	return (srt || rist) &&
+	       obs_output_get_display_name("mpegts_output") != nullptr;
+}
+
+/* services that ask for the FFmpeg HLS muxer get the native HLS output when
+ * obs-outputs was built with libcurl, it supports partial segments */
+static const char *GetNativeOutputType(const char *type)
+{
+	if (strcmp(type, "ffmpeg_hls_muxer") == 0 &&
+	    obs_output_get_display_name("hls_output") != nullptr)
+		return "hls_output";
+
+	return type;
+}
 
 static void OBSStreamStarting(void *data, calldata_t *params)
 {
@@ -766,10 +807,14 @@ bool SimpleOutput::SetupStreaming(obs_service_t *service)
 		if (url != NULL &&
 		    strncmp(url, FTL_PROTOCOL, strlen(FTL_PROTOCOL)) == 0) {
 			type = "ftl_output";
+		} else if (url != NULL && IsNativeMpegTsUrl(url)) {
+			type = "mpegts_output";
 		} else if (url != NULL && strncmp(url, RTMP_PROTOCOL,
 						  strlen(RTMP_PROTOCOL)) != 0) {
 			type = "ffmpeg_mpegts_muxer";
 		}
+	} else {
+		type = GetNativeOutputType(type);
 	}
 
 	/* XXX: this is messy and disgusting and should be refactored */
@@ -986,6 +1031,7 @@ bool SimpleOutput::ConfigureRecording(bool updateReplayBuffer)
 		config_get_string(main->Config(), "SimpleOutput", "RecFormat");
 	const char *mux = config_get_string(main->Config(), "SimpleOutput",
 					    "MuxerCustom");
+	bool fragmented = IsFragmentedFormat(format);
 	bool noSpace = config_get_bool(main->Config(), "SimpleOutput",
 				       "FileNameWithoutSpace");
 	const char *filenameFormat = config_get_string(main->Config(), "Output",
@@ -1007,12 +1053,14 @@ bool SimpleOutput::ConfigureRecording(bool updateReplayBuffer)
 	obs_data_t *settings = obs_data_create();
 	if (updateReplayBuffer) {
 		f = GetFormatString(filenameFormat, rbPrefix, rbSuffix);
-		strPath = GetOutputFilename(path, ffmpegOutput ? "avi" : format,
+		const char *ext = GetFormatExtension(format);
+
+		strPath = GetOutputFilename(path, ffmpegOutput ? "avi" : ext,
 					    noSpace, overwriteIfExists,
 					    f.c_str());
 		obs_data_set_string(settings, "directory", path);
 		obs_data_set_string(settings, "format", f.c_str());
-		obs_data_set_string(settings, "extension", format);
+		obs_data_set_string(settings, "extension", ext);
 		obs_data_set_bool(settings, "allow_spaces", !noSpace);
 		obs_data_set_int(settings, "max_time_sec", rbTime);
 		obs_data_set_int(settings, "max_size_mb",
@@ -1025,6 +1073,7 @@ bool SimpleOutput::ConfigureRecording(bool updateReplayBuffer)
 					       f.c_str(), ffmpegOutput);
 		obs_data_set_string(settings, ffmpegOutput ? "url" : "path",
 				    strPath.c_str());
+		obs_data_set_bool(settings, "fragmented", fragmented);
 	}
 
 	obs_data_set_string(settings, "muxer_settings", mux);
@@ -1690,10 +1739,14 @@ bool AdvancedOutput::SetupStreaming(obs_service_t *service)
 		if (url != NULL &&
 		    strncmp(url, FTL_PROTOCOL, strlen(FTL_PROTOCOL)) == 0) {
 			type = "ftl_output";
+		} else if (url != NULL && IsNativeMpegTsUrl(url)) {
+			type = "mpegts_output";
 		} else if (url != NULL && strncmp(url, RTMP_PROTOCOL,
 						  strlen(RTMP_PROTOCOL)) != 0) {
 			type = "ffmpeg_mpegts_muxer";
 		}
+	} else {
+		type = GetNativeOutputType(type);
 	}
 
 	/* XXX: this is messy and disgusting and should be refactored */
@@ -1834,6 +1887,7 @@ bool AdvancedOutput::StartRecording()
 	const char *path;
 	const char *recFormat;
 	const char *filenameFormat;
+	bool fragmented = false;
 	bool noSpace = false;
 	bool overwriteIfExists = false;
 
@@ -1857,6 +1911,7 @@ bool AdvancedOutput::StartRecording()
 		recFormat = config_get_string(main->Config(), "AdvOut",
 					      ffmpegRecording ? "FFExtension"
 							      : "RecFormat");
+		fragmented = !ffmpegRecording && IsFragmentedFormat(recFormat);
 		filenameFormat = config_get_string(main->Config(), "Output",
 						   "FilenameFormatting");
 		overwriteIfExists = config_get_bool(main->Config(), "Output",
@@ -1874,6 +1929,8 @@ bool AdvancedOutput::StartRecording()
 		obs_data_t *settings = obs_data_create();
 		obs_data_set_string(settings, ffmpegRecording ? "url" : "path",
 				    strPath.c_str());
+		if (!ffmpegRecording)
+			obs_data_set_bool(settings, "fragmented", fragmented);
 
 		obs_output_update(fileOutput, settings);
 
@@ -1927,6 +1984,7 @@ bool AdvancedOutput::StartReplayBuffer()
 		recFormat = config_get_string(main->Config(), "AdvOut",
 					      ffmpegRecording ? "FFExtension"
 							      : "RecFormat");
+		recFormat = GetFormatExtension(recFormat);
 		filenameFormat = config_get_string(main->Config(), "Output",
 						   "FilenameFormatting");
 		overwriteIfExists = config_get_bool(main->Config(), "Output",
@@ -2031,8 +2089,11 @@ BasicOutputHandler::GetRecordingFilename(const char *path, const char *ext,
 					 bool noSpace, bool overwrite,
 					 const char *format, bool ffmpeg)
 {
-	bool remux = !ffmpeg && SetupAutoRemux(ext);
-	string dst = GetOutputFilename(path, ext, noSpace, overwrite, format);
+	/* fragmented files are never remuxed, they are fine as they are */
+	bool remux = !ffmpeg && !IsFragmentedFormat(ext) &&
+		     SetupAutoRemux(ext);
+	string dst = GetOutputFilename(path, GetFormatExtension(ext), noSpace,
+				       overwrite, format);
 	lastRecordingPath = remux ? dst : "";
 	return dst;
 }
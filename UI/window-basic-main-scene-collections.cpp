@@ -271,6 +271,7 @@ void OBSBasic::on_actionRenameSceneCollection_triggered()
 	oldFile.insert(0, path);
 	oldFile += ".json";
 	os_unlink(oldFile.c_str());
+	os_unlink((oldFile + ".bin").c_str());
 	oldFile += ".bak";
 	os_unlink(oldFile.c_str());
 
@@ -332,10 +333,11 @@ void OBSBasic::on_actionRemoveSceneCollection_triggered()
 	oldFile.insert(0, path);
 	oldFile += ".json";
 	os_unlink(oldFile.c_str());
+	os_unlink((oldFile + ".bin").c_str());
 	oldFile += ".bak";
 	os_unlink(oldFile.c_str());
 
-	Load(newPath.c_str());
+	Load(newPath.c_str(), true);
 	RefreshSceneCollections();
 
 	const char *newFile = config_get_string(App()->GlobalConfig(), "Basic",
@@ -417,7 +419,7 @@ void OBSBasic::ChangeSceneCollection()
 
 	SaveProjectNow();
 
-	Load(fileName.c_str());
+	Load(fileName.c_str(), true);
 	RefreshSceneCollections();
 
 	const char *newName = config_get_string(App()->GlobalConfig(), "Basic",
@@ -434,6 +434,11 @@ void OBSBasic::TransitionToScene(OBSSource source, bool force,
 
 		EnableTransitionWidgets(false);
 
+		obs_transition_enable_freeze_outgoing(
+			transition,
+			config_get_bool(GetGlobalConfig(), "BasicWindow",
+					"TransitionFreezeOutgoing"));
+
 		bool success = obs_transition_start(transition, mode, duration,
 						    source);
 
@@ -719,6 +724,22 @@ template<typename T> static T GetOBSRef(QListWidgetItem *item)
 	return item->data(static_cast<int>(QtDataRole::OBSRef)).value<T>();
 }
 
+/* the scene in the preview is the one most likely to go live next, so its
+ * sources get to prepare before the transition activates them */
+void OBSBasic::SetWarmScene(OBSSource scene)
+{
+	OBSSource actualWarmScene = OBSGetStrongRef(warmScene);
+	if (actualWarmScene == scene)
+		return;
+
+	if (actualWarmScene)
+		obs_source_dec_warm(actualWarmScene);
+
+	warmScene = nullptr;
+	if (scene && obs_source_inc_warm(scene))
+		warmScene = OBSGetWeakRef(scene);
+}
+
 void OBSBasic::SetCurrentScene(OBSSource scene, bool force)
 {
 	if (!IsPreviewProgramMode()) {
@@ -732,6 +753,8 @@ void OBSBasic::SetCurrentScene(OBSSource scene, bool force)
 				obs_source_dec_showing(actualLastScene);
 			lastScene = OBSGetWeakRef(scene);
 		}
+
+		SetWarmScene(scene);
 	}
 
 	if (obs_scene_get_source(GetCurrentScene()) != scene) {
@@ -1468,6 +1491,8 @@ void OBSBasic::SetPreviewProgramMode(bool enabled)
 			lastScene = nullptr;
 		}
 
+		SetWarmScene(nullptr);
+
 		programScene = nullptr;
 		swapScene = nullptr;
 
@@ -62,6 +62,10 @@
 #include "media-controls.hpp"
 #include <fstream>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <thread>
 
 #ifdef _WIN32
 #include "win-update/win-update.hpp"
@@ -677,8 +681,14 @@ void OBSBasic::Save(const char *file)
 		obs_data_release(moduleObj);
 	}
 
-	if (!obs_data_save_json_safe(saveData, file, "tmp", "bak"))
+	if (!obs_data_save_json_safe(saveData, file, "tmp", "bak")) {
 		blog(LOG_ERROR, "Could not save scene data to %s", file);
+	} else {
+		/* faster to load than the json, used for as long as it is
+		 * newer than the json */
+		string binFile = string(file) + ".bin";
+		obs_data_save_binary_file(saveData, binFile.c_str());
+	}
 
 	obs_data_release(saveData);
 	obs_data_array_release(sceneOrder);
@@ -907,11 +917,129 @@ void OBSBasic::LogScenes()
 	blog(LOG_INFO, "------------------------------------------------");
 }
 
-void OBSBasic::Load(const char *file)
+static obs_data_t *LoadSceneCollectionData(const char *file)
+{
+	string binFile = string(file) + ".bin";
+	QFileInfo jsonInfo(QT_UTF8(file));
+	QFileInfo binInfo(QT_UTF8(binFile.c_str()));
+
+	if (jsonInfo.exists() && binInfo.exists() &&
+	    binInfo.lastModified() >= jsonInfo.lastModified()) {
+		obs_data_t *data =
+			obs_data_create_from_binary_file(binFile.c_str());
+		if (data)
+			return data;
+	}
+
+	return obs_data_create_from_json_file_safe(file, "bak");
+}
+
+static void MarkUsedSources(unordered_map<string, OBSData> &scenes,
+			    unordered_set<string> &used, const char *name)
+{
+	if (!name || !*name || !used.insert(name).second)
+		return;
+
+	auto it = scenes.find(name);
+	if (it == scenes.end())
+		return;
+
+	obs_data_t *settings = obs_data_get_obj(it->second, "settings");
+	obs_data_array_t *items = obs_data_get_array(settings, "items");
+	size_t count = obs_data_array_count(items);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(items, i);
+		const char *name = obs_data_get_string(item, "name");
+		MarkUsedSources(scenes, used, name);
+		obs_data_release(item);
+	}
+
+	obs_data_array_release(items);
+	obs_data_release(settings);
+}
+
+/* the sources that the current scenes need right away, other inputs are
+ * only created once they are shown */
+static unordered_set<string> GetStartupSources(obs_data_array_t *sources,
+					       const char *sceneName,
+					       const char *programSceneName)
 {
+	unordered_map<string, OBSData> scenes;
+	unordered_set<string> used;
+	size_t count = obs_data_array_count(sources);
+
+	for (size_t i = 0; i < count; i++) {
+		OBSData source = obs_data_array_item(sources, i);
+		obs_data_release(source);
+
+		const char *id = obs_data_get_string(source, "id");
+		if (strcmp(id, "scene") == 0 || strcmp(id, "group") == 0)
+			scenes[obs_data_get_string(source, "name")] = source;
+	}
+
+	MarkUsedSources(scenes, used, sceneName);
+	MarkUsedSources(scenes, used, programSceneName);
+	return used;
+}
+
+struct LoadSourcesData {
+	vector<OBSSource> sources;
+	unordered_set<string> used;
+};
+
+/* checking for missing files means a stat per referenced path, which can
+ * take a long time each on network shares, so the sources are checked on a
+ * few threads at once */
+#define MISSING_FILES_THREADS 8
+
+static obs_missing_files_t *GetMissingFiles(const vector<OBSSource> &sources)
+{
+	vector<obs_missing_files_t *> results(sources.size());
+	atomic<size_t> next(0);
+
+	auto check = [&]() {
+		size_t i;
+		while ((i = next++) < sources.size())
+			results[i] = obs_source_get_missing_files(sources[i]);
+	};
+
+	size_t count = min(sources.size(), (size_t)MISSING_FILES_THREADS);
+	vector<thread> threads;
+	for (size_t i = 1; i < count; i++)
+		threads.emplace_back(check);
+	check();
+	for (thread &t : threads)
+		t.join();
+
+	/* keep the order the sources were loaded in */
+	obs_missing_files_t *files = obs_missing_files_create();
+	for (obs_missing_files_t *sf : results) {
+		obs_missing_files_append(files, sf);
+		obs_missing_files_destroy(sf);
+	}
+	return files;
+}
+
+void OBSBasic::Load(const char *file, bool switching)
+{
+	obs_data_t *data = nullptr;
+
 	disableSaving++;
 
-	obs_data_t *data = obs_data_create_from_json_file_safe(file, "bak");
+	/* big collections take a while to parse, so when switching to another
+	 * one, read it without blocking the window.  the old collection stays
+	 * in place until then, and its program scene stays in the outputs
+	 * until the new one replaces it */
+	if (switching) {
+		ui->sceneCollectionMenu->setEnabled(false);
+		ExecuteFuncSafeBlock(
+			[&]() { data = LoadSceneCollectionData(file); });
+		ui->sceneCollectionMenu->setEnabled(true);
+	} else {
+		data = LoadSceneCollectionData(file);
+	}
+
 	if (!data) {
 		disableSaving--;
 		blog(LOG_INFO, "No scene file found, creating default scene");
@@ -920,7 +1048,7 @@ void OBSBasic::Load(const char *file)
 		return;
 	}
 
-	ClearSceneData();
+	ClearSceneData(switching);
 	InitDefaultTransitions();
 	ClearContextBar();
 
@@ -985,19 +1113,28 @@ void OBSBasic::Load(const char *file)
 		obs_data_array_push_back_array(sources, groups);
 	}
 
-	obs_missing_files_t *files = obs_missing_files_create();
+	LoadSourcesData loadData;
 
-	auto cb = [](void *private_data, obs_source_t *source) {
-		obs_missing_files_t *f = (obs_missing_files_t *)private_data;
-		obs_missing_files_t *sf = obs_source_get_missing_files(source);
+	if (config_get_bool(App()->GlobalConfig(), "General",
+			    "DeferSourceLoading"))
+		loadData.used =
+			GetStartupSources(sources, sceneName, programSceneName);
 
-		obs_missing_files_append(f, sf);
-		obs_missing_files_destroy(sf);
+	auto cb = [](void *private_data, obs_source_t *source) {
+		LoadSourcesData *d = (LoadSourcesData *)private_data;
+		d->sources.emplace_back(source);
+	};
 
-		UNUSED_PARAMETER(source);
+	auto deferCb = [](void *private_data, obs_data_t *source_data) {
+		LoadSourcesData *d = (LoadSourcesData *)private_data;
+		const char *name = obs_data_get_string(source_data, "name");
+		return !d->used.empty() && d->used.find(name) == d->used.end();
 	};
 
-	obs_load_sources(sources, cb, files);
+	obs_load_sources_deferred(sources, cb, deferCb, &loadData);
+
+	obs_missing_files_t *files = GetMissingFiles(loadData.sources);
+	loadData.sources.clear();
 
 	if (transitions)
 		LoadTransitions(transitions);
@@ -3197,6 +3334,16 @@ void OBSBasic::ToggleHideMixer()
 	}
 }
 
+void OBSBasic::ToggleLowRenderPriority()
+{
+	OBSSceneItem item = GetCurrentSceneItem();
+	OBSSource source = obs_sceneitem_get_source(item);
+	uint32_t flags = obs_source_get_flags(source);
+
+	obs_source_set_flags(source,
+			     flags ^ OBS_SOURCE_FLAG_LOW_RENDER_PRIORITY);
+}
+
 void OBSBasic::MixerRenameSource()
 {
 	QAction *action = reinterpret_cast<QAction *>(sender());
@@ -3962,6 +4109,10 @@ static inline enum video_format GetVideoFormatFromName(const char *name)
 		return VIDEO_FORMAT_NV12;
 	else if (astrcmpi(name, "I444") == 0)
 		return VIDEO_FORMAT_I444;
+	else if (astrcmpi(name, "I010") == 0)
+		return VIDEO_FORMAT_I010;
+	else if (astrcmpi(name, "P010") == 0)
+		return VIDEO_FORMAT_P010;
 #if 0 //currently unsupported
 	else if (astrcmpi(name, "YVYU") == 0)
 		return VIDEO_FORMAT_YVYU;
@@ -4078,6 +4229,29 @@ int OBSBasic::ResetVideo()
 	if (ret == OBS_VIDEO_SUCCESS) {
 		OBSBasicStats::InitializeValues();
 		OBSProjector::UpdateMultiviewProjectors();
+
+		/* only affects sources marked as low render priority */
+		obs_set_render_budget_ns(obs_get_frame_interval_ns());
+
+		/* pauses rendering while minimized with no output running */
+		obs_set_idle_rendering(config_get_bool(
+			GetGlobalConfig(), "General", "IdleRendering"));
+
+		/* sources not drawn lately give up VRAM over the budget */
+		obs_set_gpu_memory_budget(
+			config_get_uint(GetGlobalConfig(), "General",
+					"GPUMemoryBudgetMB") *
+			1024 * 1024);
+
+		/* compressed images are cached on disk, so the backgrounds
+		 * of a collection are only compressed once */
+		char imageCache[512];
+		bool compress = config_get_bool(GetGlobalConfig(), "General",
+						"CompressImages");
+		if (GetConfigPath(imageCache, sizeof(imageCache),
+				  "obs-studio/image_cache") <= 0)
+			imageCache[0] = 0;
+		obs_image_cache_set_compression(compress, imageCache);
 	}
 
 	return ret;
@@ -4231,7 +4405,7 @@ void OBSBasic::ClearProjectors()
 	projectors.clear();
 }
 
-void OBSBasic::ClearSceneData()
+void OBSBasic::ClearSceneData(bool keepProgram)
 {
 	disableSaving++;
 
@@ -4245,9 +4419,10 @@ void OBSBasic::ClearSceneData()
 
 	ClearProjectors();
 
-	for (int i = 0; i < MAX_CHANNELS; i++)
+	for (int i = keepProgram ? 1 : 0; i < MAX_CHANNELS; i++)
 		obs_set_output_source(i, nullptr);
 
+	SetWarmScene(nullptr);
 	lastScene = nullptr;
 	swapScene = nullptr;
 	programScene = nullptr;
@@ -5056,6 +5231,16 @@ void OBSBasic::CreateSourcePopupMenu(int idx, bool preview)
 			actionHideMixer->setChecked(SourceMixerHidden(source));
 		}
 
+		if ((flags & OBS_SOURCE_VIDEO) != 0) {
+			QAction *actionLowPriority = popup.addAction(
+				QTStr("LowRenderPriority"), this,
+				SLOT(ToggleLowRenderPriority()));
+			actionLowPriority->setCheckable(true);
+			actionLowPriority->setChecked(
+				(obs_source_get_flags(source) &
+				 OBS_SOURCE_FLAG_LOW_RENDER_PRIORITY) != 0);
+		}
+
 		if (isAsyncVideo) {
 			deinterlaceMenu = new QMenu(QTStr("Deinterlacing"));
 			popup.addMenu(
@@ -8060,19 +8245,17 @@ void OBSBasic::ColorChange()
 
 SourceTreeItem *OBSBasic::GetItemWidgetFromSceneItem(obs_sceneitem_t *sceneItem)
 {
-	int i = 0;
-	SourceTreeItem *treeItem = ui->sources->GetItemWidget(i);
-	OBSSceneItem item = ui->sources->Get(i);
 	int64_t id = obs_sceneitem_get_id(sceneItem);
-	while (treeItem && obs_sceneitem_get_id(item) != id) {
-		i++;
-		treeItem = ui->sources->GetItemWidget(i);
-		item = ui->sources->Get(i);
-	}
-	if (treeItem)
-		return treeItem;
 
-	return nullptr;
+	/* only the matching row needs a widget, rows that are scrolled out of
+	 * view don't have one until they are shown */
+	for (int i = 0;; i++) {
+		OBSSceneItem item = ui->sources->Get(i);
+		if (!item)
+			return nullptr;
+		if (obs_sceneitem_get_id(item) == id)
+			return ui->sources->GetItemWidget(i);
+	}
 }
 
 void OBSBasic::on_autoConfigure_triggered()
@@ -309,7 +309,7 @@ private:
 	void UploadLog(const char *subdir, const char *file, const bool crash);
 
 	void Save(const char *file);
-	void Load(const char *file);
+	void Load(const char *file, bool switching = false);
 
 	void InitHotkeys();
 	void CreateHotkeys();
@@ -352,7 +352,7 @@ private:
 			      int aBitrate);
 
 	void CloseDialogs();
-	void ClearSceneData();
+	void ClearSceneData(bool keepProgram = false);
 	void ClearProjectors();
 
 	void Nudge(int dist, MoveDir dir);
@@ -431,6 +431,7 @@ private:
 	void SetPreviewProgramMode(bool enabled);
 	void ResizeProgram(uint32_t cx, uint32_t cy);
 	void SetCurrentScene(obs_scene_t *scene, bool force = false);
+	void SetWarmScene(OBSSource scene);
 	static void RenderProgram(void *data, uint32_t cx, uint32_t cy);
 
 	std::vector<QuickTransition> quickTransitions;
@@ -439,6 +440,7 @@ private:
 	OBSWeakSource lastScene;
 	OBSWeakSource swapScene;
 	OBSWeakSource programScene;
+	OBSWeakSource warmScene;
 	bool editPropertiesMode = false;
 	bool sceneDuplicationMode = true;
 	bool swapScenesMode = true;
@@ -646,6 +648,7 @@ private slots:
 	void HideAudioControl();
 	void UnhideAllAudioControls();
 	void ToggleHideMixer();
+	void ToggleLowRenderPriority();
 
 	void MixerRenameSource();
 
@@ -340,6 +340,8 @@ void OBSBasicProperties::on_buttonBox_clicked(QAbstractButton *button)
 {
 	QDialogButtonBox::ButtonRole val = buttonBox->buttonRole(button);
 
+	view->ApplyPendingUpdate();
+
 	if (val == QDialogButtonBox::AcceptRole) {
 		acceptClicked = true;
 		close();
@@ -408,14 +408,17 @@ OBSBasicSettings::OBSBasicSettings(QWidget *parent)
 	HookWidget(ui->overflowHide,         CHECK_CHANGED,  GENERAL_CHANGED);
 	HookWidget(ui->overflowAlwaysVisible,CHECK_CHANGED,  GENERAL_CHANGED);
 	HookWidget(ui->overflowSelectionHide,CHECK_CHANGED,  GENERAL_CHANGED);
+	HookWidget(ui->displayMaxFPS,        SCROLL_CHANGED, GENERAL_CHANGED);
 	HookWidget(ui->automaticSearch,      CHECK_CHANGED,  GENERAL_CHANGED);
 	HookWidget(ui->doubleClickSwitch,    CHECK_CHANGED,  GENERAL_CHANGED);
 	HookWidget(ui->studioPortraitLayout, CHECK_CHANGED,  GENERAL_CHANGED);
 	HookWidget(ui->prevProgLabelToggle,  CHECK_CHANGED,  GENERAL_CHANGED);
+	HookWidget(ui->freezeOutgoingScene,  CHECK_CHANGED,  GENERAL_CHANGED);
 	HookWidget(ui->multiviewMouseSwitch, CHECK_CHANGED,  GENERAL_CHANGED);
 	HookWidget(ui->multiviewDrawNames,   CHECK_CHANGED,  GENERAL_CHANGED);
 	HookWidget(ui->multiviewDrawAreas,   CHECK_CHANGED,  GENERAL_CHANGED);
 	HookWidget(ui->multiviewLayout,      COMBO_CHANGED,  GENERAL_CHANGED);
+	HookWidget(ui->multiviewSceneFPS,    SCROLL_CHANGED, GENERAL_CHANGED);
 	HookWidget(ui->service,              COMBO_CHANGED,  STREAM1_CHANGED);
 	HookWidget(ui->server,               COMBO_CHANGED,  STREAM1_CHANGED);
 	HookWidget(ui->customServer,         EDIT_CHANGED,   STREAM1_CHANGED);
@@ -1310,6 +1313,10 @@ void OBSBasicSettings::LoadGeneralSettings()
 		GetGlobalConfig(), "BasicWindow", "OverflowSelectionHidden");
 	ui->overflowSelectionHide->setChecked(overflowSelectionHide);
 
+	int displayMaxFPS = (int)config_get_uint(
+		GetGlobalConfig(), "BasicWindow", "DisplayMaxFPS");
+	ui->displayMaxFPS->setValue(displayMaxFPS);
+
 	bool automaticSearch = config_get_bool(GetGlobalConfig(), "General",
 					       "AutomaticCollectionSearch");
 	ui->automaticSearch->setChecked(automaticSearch);
@@ -1326,6 +1333,10 @@ void OBSBasicSettings::LoadGeneralSettings()
 					      "StudioModeLabels");
 	ui->prevProgLabelToggle->setChecked(prevProgLabels);
 
+	bool freezeOutgoingScene = config_get_bool(
+		GetGlobalConfig(), "BasicWindow", "TransitionFreezeOutgoing");
+	ui->freezeOutgoingScene->setChecked(freezeOutgoingScene);
+
 	bool multiviewMouseSwitch = config_get_bool(
 		GetGlobalConfig(), "BasicWindow", "MultiviewMouseSwitch");
 	ui->multiviewMouseSwitch->setChecked(multiviewMouseSwitch);
@@ -1357,6 +1368,10 @@ void OBSBasicSettings::LoadGeneralSettings()
 	ui->multiviewLayout->setCurrentIndex(config_get_int(
 		GetGlobalConfig(), "BasicWindow", "MultiviewLayout"));
 
+	int multiviewSceneFPS = (int)config_get_uint(
+		GetGlobalConfig(), "BasicWindow", "MultiviewSceneFPS");
+	ui->multiviewSceneFPS->setValue(multiviewSceneFPS);
+
 	prevLangIndex = ui->language->currentIndex();
 
 	if (obs_video_active())
@@ -1824,7 +1839,7 @@ OBSBasicSettings::CreateEncoderPropertyView(const char *encoder,
 		if (ret > 0) {
 			obs_data_t *data = obs_data_create_from_json_file_safe(
 				encoderJsonPath, "bak");
-			obs_data_apply(settings, data);
+			obs_data_apply_move(settings, data);
 			obs_data_release(data);
 		}
 	}
@@ -3012,6 +3027,11 @@ void OBSBasicSettings::SaveGeneralSettings()
 		config_set_bool(GetGlobalConfig(), "BasicWindow",
 				"OverflowSelectionHidden",
 				ui->overflowSelectionHide->isChecked());
+	if (WidgetChanged(ui->displayMaxFPS)) {
+		config_set_uint(GetGlobalConfig(), "BasicWindow",
+				"DisplayMaxFPS", ui->displayMaxFPS->value());
+		OBSQTDisplay::UpdateAllMaxFPS();
+	}
 	if (WidgetChanged(ui->doubleClickSwitch))
 		config_set_bool(GetGlobalConfig(), "BasicWindow",
 				"TransitionOnDoubleClick",
@@ -3104,6 +3124,11 @@ void OBSBasicSettings::SaveGeneralSettings()
 		main->ResetUI();
 	}
 
+	if (WidgetChanged(ui->freezeOutgoingScene))
+		config_set_bool(GetGlobalConfig(), "BasicWindow",
+				"TransitionFreezeOutgoing",
+				ui->freezeOutgoingScene->isChecked());
+
 	bool multiviewChanged = false;
 	if (WidgetChanged(ui->multiviewMouseSwitch)) {
 		config_set_bool(GetGlobalConfig(), "BasicWindow",
@@ -3133,6 +3158,13 @@ void OBSBasicSettings::SaveGeneralSettings()
 		multiviewChanged = true;
 	}
 
+	if (WidgetChanged(ui->multiviewSceneFPS)) {
+		config_set_uint(GetGlobalConfig(), "BasicWindow",
+				"MultiviewSceneFPS",
+				ui->multiviewSceneFPS->value());
+		multiviewChanged = true;
+	}
+
 	if (multiviewChanged)
 		OBSProjector::UpdateMultiviewProjectors();
 }
@@ -3664,8 +3696,8 @@ void OBSBasicSettings::SaveSettings()
 	if (videoChanged || advancedChanged)
 		main->ResetVideo();
 
-	config_save_safe(main->Config(), "tmp", nullptr);
-	config_save_safe(GetGlobalConfig(), "tmp", nullptr);
+	config_save_safe_async(main->Config(), "tmp", nullptr);
+	config_save_safe_async(GetGlobalConfig(), "tmp", nullptr);
 	main->SaveProject();
 
 	if (Changed()) {
@@ -4625,7 +4657,7 @@ void OBSBasicSettings::AdvReplayBufferChanged()
 		if (ret > 0) {
 			obs_data_t *data = obs_data_create_from_json_file_safe(
 				encoderJsonPath, "bak");
-			obs_data_apply(settings, data);
+			obs_data_apply_move(settings, data);
 			obs_data_release(data);
 		}
 	}
@@ -12,11 +12,17 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGridLayout>
+#include <QPainter>
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #define TIMER_INTERVAL 2000
 #define REC_TIME_LEFT_INTERVAL 30000
+#define SOURCE_ROWS 10
+#define MEMORY_ROWS 5
+#define BITRATE_HISTORY (300000 / TIMER_INTERVAL)
 
 void OBSBasicStats::OBSFrontendEvent(enum obs_frontend_event event, void *ptr)
 {
@@ -80,6 +86,7 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 	hddSpace = new QLabel(this);
 	recordTimeLeft = new QLabel(this);
 	memUsage = new QLabel(this);
+	audioBuffering = new QLabel(this);
 
 	QString str = MakeTimeLeftText(99999, 59);
 	int textWidth = recordTimeLeft->fontMetrics().boundingRect(str).width();
@@ -89,6 +96,7 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 	newStat("HDDSpaceAvailable", hddSpace, 0);
 	newStat("DiskFullIn", recordTimeLeft, 0);
 	newStat("MemoryUsage", memUsage, 0);
+	newStat("AudioBuffering", audioBuffering, 0);
 
 	fps = new QLabel(this);
 	renderTime = new QLabel(this);
@@ -106,6 +114,80 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 	newStat("MissedFrames", missedFrames, 2);
 	newStat("SkippedFrames", skippedFrames, 2);
 
+	gpuTime = new QLabel(this);
+	newStat("GPUTimeToRender", gpuTime, 2);
+
+	renderTimePercentiles = new QLabel(this);
+	newStat("RenderTimePercentiles", renderTimePercentiles, 2);
+
+	renderTimeGraph = new StatsGraph(this);
+	renderTimeGraph->setMinimumHeight(60);
+	renderTimeGraph->setToolTip(QTStr("Basic.Stats.RenderTimeGraph"));
+
+	/* --------------------------------------------- */
+
+	QGridLayout *sourceLayout = new QGridLayout();
+
+	int col = 0;
+	auto addSourceCol = [&](const char *loc) {
+		QLabel *label = new QLabel(QTStr(loc), this);
+		label->setStyleSheet("font-weight: bold");
+		sourceLayout->addWidget(label, 0, col++);
+	};
+
+	addSourceCol("Basic.Stats.Sources");
+	addSourceCol("Basic.Stats.Sources.Tick");
+	addSourceCol("Basic.Stats.Sources.Render");
+	addSourceCol("Basic.Stats.Sources.Audio");
+	addSourceCol("Basic.Stats.Sources.GPU");
+	addSourceCol("Basic.Stats.Sources.Skipped");
+
+	for (int i = 0; i < SOURCE_ROWS; i++) {
+		SourceLabels sl;
+		sl.name = new QLabel(this);
+		sl.tick = new QLabel(this);
+		sl.render = new QLabel(this);
+		sl.audio = new QLabel(this);
+		sl.gpu = new QLabel(this);
+		sl.skipped = new QLabel(this);
+
+		col = 0;
+		sourceLayout->addWidget(sl.name, i + 1, col++);
+		sourceLayout->addWidget(sl.tick, i + 1, col++);
+		sourceLayout->addWidget(sl.render, i + 1, col++);
+		sourceLayout->addWidget(sl.audio, i + 1, col++);
+		sourceLayout->addWidget(sl.gpu, i + 1, col++);
+		sourceLayout->addWidget(sl.skipped, i + 1, col++);
+		sourceLabels.push_back(sl);
+	}
+
+	/* --------------------------------------------- */
+
+	QGridLayout *memoryLayout = new QGridLayout();
+
+	col = 0;
+	auto addMemoryCol = [&](const char *loc) {
+		QLabel *label = new QLabel(QTStr(loc), this);
+		label->setStyleSheet("font-weight: bold");
+		memoryLayout->addWidget(label, 0, col++);
+	};
+
+	addMemoryCol("Basic.Stats.Memory");
+	addMemoryCol("Basic.Stats.Memory.System");
+	addMemoryCol("Basic.Stats.Memory.GPU");
+
+	for (int i = 0; i < MEMORY_ROWS; i++) {
+		MemoryLabels ml;
+		ml.name = new QLabel(this);
+		ml.system = new QLabel(this);
+		ml.gpu = new QLabel(this);
+
+		memoryLayout->addWidget(ml.name, i + 1, 0);
+		memoryLayout->addWidget(ml.system, i + 1, 1);
+		memoryLayout->addWidget(ml.gpu, i + 1, 2);
+		memoryLabels.push_back(ml);
+	}
+
 	/* --------------------------------------------- */
 	QPushButton *closeButton = nullptr;
 	if (closeable)
@@ -119,7 +201,7 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 
 	/* --------------------------------------------- */
 
-	int col = 0;
+	col = 0;
 	auto addOutputCol = [&](const char *loc) {
 		QLabel *label = new QLabel(QTStr(loc), this);
 		label->setStyleSheet("font-weight: bold");
@@ -131,6 +213,8 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 	addOutputCol("Basic.Stats.DroppedFrames");
 	addOutputCol("Basic.Stats.MegabytesSent");
 	addOutputCol("Basic.Stats.Bitrate");
+	addOutputCol("Basic.Stats.Details");
+	addOutputCol("Basic.Stats.BitrateHistory");
 
 	/* --------------------------------------------- */
 
@@ -153,6 +237,9 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 	/* --------------------------------------------- */
 
 	mainLayout->addLayout(topLayout);
+	mainLayout->addWidget(renderTimeGraph);
+	mainLayout->addLayout(sourceLayout);
+	mainLayout->addLayout(memoryLayout);
 	mainLayout->addWidget(scrollArea);
 	mainLayout->addLayout(buttonLayout);
 	setLayout(mainLayout);
@@ -167,7 +254,7 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 	shortcutFilter = CreateShortcutFilter();
 	installEventFilter(shortcutFilter);
 
-	resize(800, 280);
+	resize(800, 400);
 
 	setWindowTitle(QTStr("Basic.Stats"));
 #ifdef __APPLE__
@@ -223,7 +310,7 @@ void OBSBasicStats::closeEvent(QCloseEvent *event)
 	if (isVisible()) {
 		config_set_string(main->Config(), "Stats", "geometry",
 				  saveGeometry().toBase64().constData());
-		config_save_safe(main->Config(), "tmp", nullptr);
+		config_save_safe_async(main->Config(), "tmp", nullptr);
 	}
 
 	QWidget::closeEvent(event);
@@ -232,6 +319,7 @@ void OBSBasicStats::closeEvent(QCloseEvent *event)
 OBSBasicStats::~OBSBasicStats()
 {
 	obs_frontend_remove_event_callback(OBSFrontendEvent, this);
+	HoldGPUTiming(false);
 
 	delete shortcutFilter;
 	os_cpu_usage_info_destroy(cpu_info);
@@ -245,6 +333,8 @@ void OBSBasicStats::AddOutputLabels(QString name)
 	ol.droppedFrames = new QLabel(this);
 	ol.megabytesSent = new QLabel(this);
 	ol.bitrate = new QLabel(this);
+	ol.details = new QLabel(this);
+	ol.bitrateGraph = new StatsGraph(this);
 
 	int newPointSize = ol.status->font().pointSize();
 	newPointSize *= 13;
@@ -260,6 +350,8 @@ void OBSBasicStats::AddOutputLabels(QString name)
 	outputLayout->addWidget(ol.droppedFrames, row, col++);
 	outputLayout->addWidget(ol.megabytesSent, row, col++);
 	outputLayout->addWidget(ol.bitrate, row, col++);
+	outputLayout->addWidget(ol.details, row, col++);
+	outputLayout->addWidget(ol.bitrateGraph, row, col++);
 	outputLabels.push_back(ol);
 }
 
@@ -291,6 +383,11 @@ void OBSBasicStats::Update()
 	obs_output_release(strOutput);
 	obs_output_release(recOutput);
 
+	UpdateGPU();
+	UpdateSources();
+	UpdateMemory();
+	UpdateRenderTimes();
+
 	if (!strOutput && !recOutput)
 		return;
 
@@ -355,6 +452,13 @@ void OBSBasicStats::Update()
 
 	/* ------------------ */
 
+	num = (long double)obs_get_audio_buffering_ns() / 1000000.0l;
+
+	str = QString::number(num, 'f', 0) + QStringLiteral(" ms");
+	audioBuffering->setText(str);
+
+	/* ------------------ */
+
 	num = (long double)obs_get_average_frame_time_ns() / 1000000.0l;
 
 	str = QString::number(num, 'f', 1) + QStringLiteral(" ms");
@@ -477,6 +581,338 @@ void OBSBasicStats::RecordingTimeLeft()
 	recordTimeLeft->setMinimumWidth(recordTimeLeft->width());
 }
 
+/* GPU timing is enabled while any stats window is visible */
+static int gpu_timing_holds = 0;
+
+void OBSBasicStats::HoldGPUTiming(bool hold)
+{
+	if (hold == gpuTimingHeld)
+		return;
+
+	gpuTimingHeld = hold;
+	if (hold ? gpu_timing_holds++ == 0 : --gpu_timing_holds == 0)
+		obs_set_gpu_timing_enabled(hold);
+}
+
+struct SourcePerf {
+	std::string name;
+	struct obs_source_perf_stats stats;
+	uint64_t cost;
+};
+
+typedef std::vector<SourcePerf> SourcePerfList;
+
+static void EnumPerfFilter(obs_source_t *parent, obs_source_t *filter,
+			   void *param)
+{
+	SourcePerfList &list = *reinterpret_cast<SourcePerfList *>(param);
+	const char *parentName = obs_source_get_name(parent);
+	const char *filterName = obs_source_get_name(filter);
+
+	if (!parentName || !filterName)
+		return;
+
+	SourcePerf perf = {};
+	perf.name = parentName;
+	perf.name += ": ";
+	perf.name += filterName;
+	obs_source_get_perf_stats(filter, &perf.stats);
+	list.push_back(perf);
+}
+
+static bool EnumPerfSource(void *param, obs_source_t *source)
+{
+	SourcePerfList &list = *reinterpret_cast<SourcePerfList *>(param);
+	const char *name = obs_source_get_name(source);
+
+	if (name) {
+		SourcePerf perf = {};
+		perf.name = name;
+		obs_source_get_perf_stats(source, &perf.stats);
+		list.push_back(perf);
+	}
+
+	obs_source_enum_filters(source, EnumPerfFilter, param);
+	return true;
+}
+
+static QString MakeFrameTimeText(uint64_t ns, uint64_t frames)
+{
+	long double ms = (long double)ns / (long double)frames / 1000000.0l;
+	return QString::number(ms, 'f', 2) + QStringLiteral(" ms");
+}
+
+void OBSBasicStats::UpdateGPU()
+{
+	if (!obs_gpu_timing_enabled()) {
+		gpuTime->setText(QTStr("Basic.Stats.GPUTimeUnavailable"));
+		gpuTime->setToolTip(QString());
+		return;
+	}
+
+	QString tooltip;
+
+	for (size_t i = 0; i < OBS_GPU_STAGE_COUNT; i++) {
+		enum obs_gpu_stage stage = (enum obs_gpu_stage)i;
+		struct obs_gpu_stage_stats &last = lastGPUStages[i];
+		struct obs_gpu_stage_stats cur;
+
+		obs_get_gpu_stage_stats(stage, &cur);
+
+		/* the statistics are reset whenever timing is enabled */
+		if (cur.count < last.count)
+			last = {};
+
+		uint64_t count = cur.count - last.count;
+		uint64_t ns = cur.total_ns - last.total_ns;
+		last = cur;
+
+		QString text = count ? MakeFrameTimeText(ns, count)
+				     : QStringLiteral("-");
+
+		if (stage == OBS_GPU_STAGE_RENDER_VIDEO) {
+			gpuTime->setText(text);
+		} else if (count) {
+			if (!tooltip.isEmpty())
+				tooltip += "\n";
+			tooltip += QT_UTF8(obs_gpu_stage_name(stage));
+			tooltip += QStringLiteral(": ") + text;
+		}
+	}
+
+	gpuTime->setToolTip(tooltip);
+}
+
+static inline uint64_t PerfDelta(uint64_t cur, uint64_t last)
+{
+	return cur > last ? cur - last : 0;
+}
+
+/* shows the sources and filters that cost the most since the last update,
+ * per rendered frame */
+void OBSBasicStats::UpdateSources()
+{
+	SourcePerfList list;
+	obs_enum_scenes(EnumPerfSource, &list);
+	obs_enum_sources(EnumPerfSource, &list);
+
+	uint64_t curFrames = obs_get_total_frames();
+	uint64_t curGPUFrames = obs_get_gpu_timed_frames();
+	uint64_t frames = PerfDelta(curFrames, lastSourceFrames);
+	uint64_t gpuFrames = PerfDelta(curGPUFrames, lastGPUFrames);
+	bool gpu = obs_gpu_timing_enabled() && gpuFrames;
+	std::map<std::string, obs_source_perf_stats> curStats;
+
+	lastSourceFrames = curFrames;
+	lastGPUFrames = curGPUFrames;
+
+	for (SourcePerf &perf : list) {
+		struct obs_source_perf_stats &stats = perf.stats;
+		auto it = lastSourceStats.find(perf.name);
+		curStats[perf.name] = stats;
+
+		/* sources added since the last update have no baseline */
+		if (it == lastSourceStats.end()) {
+			stats = {};
+			continue;
+		}
+
+		const struct obs_source_perf_stats &last = it->second;
+		stats.tick_ns = PerfDelta(stats.tick_ns, last.tick_ns);
+		stats.render_ns = PerfDelta(stats.render_ns, last.render_ns);
+		stats.audio_ns = PerfDelta(stats.audio_ns, last.audio_ns);
+		stats.gpu_ns = PerfDelta(stats.gpu_ns, last.gpu_ns);
+		stats.skipped_renders =
+			PerfDelta(stats.skipped_renders, last.skipped_renders);
+
+		perf.cost = stats.tick_ns + stats.render_ns + stats.audio_ns;
+		if (gpu)
+			perf.cost += stats.gpu_ns * frames / gpuFrames;
+	}
+
+	lastSourceStats.swap(curStats);
+
+	std::sort(list.begin(), list.end(),
+		  [](const SourcePerf &a, const SourcePerf &b) {
+			  return a.cost > b.cost;
+		  });
+
+	for (int i = 0; i < sourceLabels.size(); i++) {
+		SourceLabels &sl = sourceLabels[i];
+		bool valid = frames && (size_t)i < list.size() &&
+			     list[i].cost;
+
+		if (!valid) {
+			sl.name->setText(QString());
+			sl.tick->setText(QString());
+			sl.render->setText(QString());
+			sl.audio->setText(QString());
+			sl.gpu->setText(QString());
+			sl.skipped->setText(QString());
+			continue;
+		}
+
+		const struct obs_source_perf_stats &stats = list[i].stats;
+		sl.name->setText(QT_UTF8(list[i].name.c_str()));
+		sl.tick->setText(MakeFrameTimeText(stats.tick_ns, frames));
+		sl.render->setText(MakeFrameTimeText(stats.render_ns, frames));
+		sl.audio->setText(MakeFrameTimeText(stats.audio_ns, frames));
+		sl.gpu->setText(gpu ? MakeFrameTimeText(stats.gpu_ns, gpuFrames)
+				    : QStringLiteral("-"));
+		sl.skipped->setText(QString::number(stats.skipped_renders));
+	}
+}
+
+struct MemoryUse {
+	std::string name;
+	uint64_t system;
+	uint64_t gpu;
+};
+
+typedef std::vector<MemoryUse> MemoryUseList;
+
+static void AddSourceMemory(MemoryUseList &list, obs_source_t *source,
+			    std::string name)
+{
+	struct obs_memory_usage usage;
+	obs_source_get_memory_usage(source, &usage);
+	list.push_back({name, usage.system_bytes, usage.gpu_bytes});
+}
+
+static void EnumMemoryFilter(obs_source_t *parent, obs_source_t *filter,
+			     void *param)
+{
+	MemoryUseList &list = *reinterpret_cast<MemoryUseList *>(param);
+	const char *parentName = obs_source_get_name(parent);
+	const char *filterName = obs_source_get_name(filter);
+
+	if (parentName && filterName)
+		AddSourceMemory(list, filter,
+				std::string(parentName) + ": " + filterName);
+}
+
+static bool EnumMemorySource(void *param, obs_source_t *source)
+{
+	MemoryUseList &list = *reinterpret_cast<MemoryUseList *>(param);
+	const char *name = obs_source_get_name(source);
+
+	if (name)
+		AddSourceMemory(list, source, name);
+
+	obs_source_enum_filters(source, EnumMemoryFilter, param);
+	return true;
+}
+
+static bool EnumMemoryOutput(void *param, obs_output_t *output)
+{
+	MemoryUseList &list = *reinterpret_cast<MemoryUseList *>(param);
+	const char *name = obs_output_get_name(output);
+
+	if (name)
+		list.push_back({name, obs_output_get_memory_usage(output), 0});
+	return true;
+}
+
+static bool EnumMemoryEncoder(void *param, obs_encoder_t *encoder)
+{
+	MemoryUseList &list = *reinterpret_cast<MemoryUseList *>(param);
+	const char *name = obs_encoder_get_name(encoder);
+
+	if (name) {
+		uint64_t bytes = obs_encoder_get_memory_usage(encoder);
+		list.push_back({name, bytes, 0});
+	}
+	return true;
+}
+
+static QString MakeMegabytesText(uint64_t bytes)
+{
+	long double mb = (long double)bytes / (1024.0l * 1024.0l);
+	return QString::number(mb, 'f', 1) + QStringLiteral(" MB");
+}
+
+/* shows what holds the most memory, to find sources, filters, outputs or
+ * encoders that buffer more than they should */
+void OBSBasicStats::UpdateMemory()
+{
+	MemoryUseList list;
+	obs_enum_scenes(EnumMemorySource, &list);
+	obs_enum_sources(EnumMemorySource, &list);
+	obs_enum_outputs(EnumMemoryOutput, &list);
+	obs_enum_encoders(EnumMemoryEncoder, &list);
+
+	std::sort(list.begin(), list.end(),
+		  [](const MemoryUse &a, const MemoryUse &b) {
+			  return a.system + a.gpu > b.system + b.gpu;
+		  });
+
+	for (int i = 0; i < memoryLabels.size(); i++) {
+		MemoryLabels &ml = memoryLabels[i];
+		bool valid = (size_t)i < list.size() &&
+			     list[i].system + list[i].gpu;
+
+		if (!valid) {
+			ml.name->setText(QString());
+			ml.system->setText(QString());
+			ml.gpu->setText(QString());
+			continue;
+		}
+
+		ml.name->setText(QT_UTF8(list[i].name.c_str()));
+		ml.system->setText(MakeMegabytesText(list[i].system));
+		ml.gpu->setText(MakeMegabytesText(list[i].gpu));
+	}
+}
+
+/* the render time of every recent frame, read from the telemetry the
+ * graphics thread records */
+void OBSBasicStats::UpdateRenderTimes()
+{
+	std::vector<obs_telemetry_sample> samples(OBS_TELEMETRY_SAMPLES);
+	samples.resize(obs_get_telemetry(OBS_TELEMETRY_VIDEO, samples.data(),
+					 samples.size()));
+
+	struct obs_video_info ovi = {};
+	obs_get_video_info(&ovi);
+
+	double frameTime = ovi.fps_num ? (double)ovi.fps_den * 1000.0 /
+						 (double)ovi.fps_num
+				       : 0.0;
+
+	std::vector<double> times;
+	times.reserve(samples.size());
+	for (const obs_telemetry_sample &sample : samples)
+		times.push_back((double)sample.duration_ns / 1000000.0);
+
+	renderTimeGraph->SetValues(times, OBS_TELEMETRY_SAMPLES, frameTime);
+
+	if (times.empty()) {
+		renderTimePercentiles->setText(QStringLiteral("-"));
+		setThemeID(renderTimePercentiles, "");
+		return;
+	}
+
+	std::sort(times.begin(), times.end());
+
+	auto percentile = [&](size_t p) {
+		return times[(times.size() - 1) * p / 100];
+	};
+
+	double p99 = percentile(99);
+	QString str = QString("%1 / %2 / %3 ms")
+			      .arg(QString::number(percentile(50), 'f', 1),
+				   QString::number(percentile(95), 'f', 1),
+				   QString::number(p99, 'f', 1));
+	renderTimePercentiles->setText(str);
+
+	if (p99 > frameTime)
+		setThemeID(renderTimePercentiles, "error");
+	else if (p99 > frameTime * 0.75)
+		setThemeID(renderTimePercentiles, "warning");
+	else
+		setThemeID(renderTimePercentiles, "");
+}
+
 void OBSBasicStats::Reset()
 {
 	timer.start();
@@ -546,6 +982,18 @@ void OBSBasicStats::OutputLabels::Update(obs_output_t *output, bool rec)
 		QString("%1 MB").arg(QString::number(num, 'f', 1)));
 	bitrate->setText(QString("%1 kb/s").arg(QString::number(kbps, 'f', 0)));
 
+	if (active) {
+		bitrateHistory.push_back((double)kbps);
+		if (bitrateHistory.size() > BITRATE_HISTORY)
+			bitrateHistory.pop_front();
+	} else {
+		bitrateHistory.clear();
+	}
+
+	std::vector<double> history(bitrateHistory.begin(),
+				    bitrateHistory.end());
+	bitrateGraph->SetValues(std::move(history), BITRATE_HISTORY);
+
 	if (!rec) {
 		int total = output ? obs_output_get_total_frames(output) : 0;
 		int dropped = output ? obs_output_get_frames_dropped(output)
@@ -574,14 +1022,100 @@ void OBSBasicStats::OutputLabels::Update(obs_output_t *output, bool rec)
 			setThemeID(droppedFrames, "warning");
 		else
 			setThemeID(droppedFrames, "");
+
+		UpdateLink(output);
+	} else {
+		UpdateWriter(output);
 	}
 
 	lastBytesSent = bytesSent;
 	lastBytesSentTime = curTime;
 }
 
+/* outputs that know about their transport (SRT/RIST) report latency,
+ * retransmits and loss through the get_transport_stats procedure */
+void OBSBasicStats::OutputLabels::UpdateLink(obs_output_t *output)
+{
+	proc_handler_t *ph = output ? obs_output_get_proc_handler(output)
+				    : nullptr;
+	calldata_t cd = {};
+
+	if (!ph || !proc_handler_call(ph, "get_transport_stats", &cd) ||
+	    !calldata_bool(&cd, "active")) {
+		details->setText("");
+		setThemeID(details, "");
+		calldata_free(&cd);
+		return;
+	}
+
+	long long sent = calldata_int(&cd, "packets_sent");
+	long long lost = calldata_int(&cd, "packets_lost");
+	long long retransmitted = calldata_int(&cd, "packets_retransmitted");
+	long double loss =
+		sent ? (long double)lost / (long double)sent * 100.0l : 0.0l;
+
+	QString str =
+		QTStr("Basic.Stats.Link.Format")
+			.arg(QString::number(calldata_float(&cd, "rtt_ms"),
+					     'f', 0),
+			     QString::number(calldata_int(&cd, "latency_ms")),
+			     QString::number(loss, 'f', 2),
+			     QString::number(retransmitted));
+	details->setText(str);
+
+	if (loss > 5.0l)
+		setThemeID(details, "error");
+	else if (loss > 1.0l)
+		setThemeID(details, "warning");
+	else
+		setThemeID(details, "");
+
+	calldata_free(&cd);
+}
+
+/* file outputs that write behind report how far the disk has fallen behind
+ * through the get_writer_stats procedure */
+void OBSBasicStats::OutputLabels::UpdateWriter(obs_output_t *output)
+{
+	proc_handler_t *ph = output ? obs_output_get_proc_handler(output)
+				    : nullptr;
+	calldata_t cd = {};
+
+	if (!ph || !obs_output_active(output) ||
+	    !proc_handler_call(ph, "get_writer_stats", &cd) ||
+	    !calldata_int(&cd, "num_blocks")) {
+		details->setText("");
+		setThemeID(details, "");
+		calldata_free(&cd);
+		return;
+	}
+
+	long long queued = calldata_int(&cd, "queued");
+	long long numBlocks = calldata_int(&cd, "num_blocks");
+	long long stalls = calldata_int(&cd, "stalls");
+
+	QString str = QTStr("Basic.Stats.Writer.Format")
+			      .arg(QString::number(queued),
+				   QString::number(numBlocks),
+				   QString::number(calldata_float(&cd,
+								  "stall_ms"),
+						   'f', 0));
+	details->setText(str);
+
+	if (stalls && queued == numBlocks)
+		setThemeID(details, "error");
+	else if (stalls)
+		setThemeID(details, "warning");
+	else
+		setThemeID(details, "");
+
+	calldata_free(&cd);
+}
+
 void OBSBasicStats::OutputLabels::Reset(obs_output_t *output)
 {
+	bitrateHistory.clear();
+
 	if (!output)
 		return;
 
@@ -591,10 +1125,79 @@ void OBSBasicStats::OutputLabels::Reset(obs_output_t *output)
 
 void OBSBasicStats::showEvent(QShowEvent *)
 {
+	HoldGPUTiming(true);
 	timer.start(TIMER_INTERVAL);
 }
 
 void OBSBasicStats::hideEvent(QHideEvent *)
 {
 	timer.stop();
+	HoldGPUTiming(false);
+}
+
+/* ------------------------------------------------------------------------- */
+
+StatsGraph::StatsGraph(QWidget *parent) : QWidget(parent)
+{
+	setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
+}
+
+void StatsGraph::SetValues(std::vector<double> values_, size_t capacity_,
+			   double reference_)
+{
+	values = std::move(values_);
+	capacity = std::max(capacity_, values.size());
+	reference = reference_;
+	update();
+}
+
+QSize StatsGraph::sizeHint() const
+{
+	return QSize(120, 30);
+}
+
+void StatsGraph::paintEvent(QPaintEvent *)
+{
+	QPainter painter(this);
+	QRectF area = QRectF(rect()).adjusted(1.0, 1.0, -1.0, -1.0);
+
+	painter.setPen(palette().color(QPalette::Mid));
+	painter.drawRect(area);
+
+	double max = reference;
+	for (double value : values)
+		max = std::max(max, value);
+
+	if (values.size() < 2 || max <= 0.0)
+		return;
+
+	/* leave some room above the highest value */
+	max *= 1.1;
+
+	auto y = [&](double value) {
+		return area.bottom() - area.height() * value / max;
+	};
+
+	painter.setRenderHint(QPainter::Antialiasing);
+
+	if (reference > 0.0) {
+		QPen pen(palette().color(QPalette::Mid));
+		pen.setStyle(Qt::DashLine);
+		painter.setPen(pen);
+		painter.drawLine(QPointF(area.left(), y(reference)),
+				 QPointF(area.right(), y(reference)));
+	}
+
+	/* the newest value is always at the right edge */
+	double step = area.width() / (double)(capacity - 1);
+	double x = area.right() - step * (double)(values.size() - 1);
+	QPolygonF line;
+
+	for (double value : values) {
+		line << QPointF(x, y(value));
+		x += step;
+	}
+
+	painter.setPen(palette().color(QPalette::Highlight));
+	painter.drawPolyline(line);
 }
@@ -9,9 +9,33 @@
 #include <QLabel>
 #include <QList>
 
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
 class QGridLayout;
 class QCloseEvent;
 
+/* plots the last values of something over time, scaled to fit, with a dashed
+ * line at the reference value if there is one */
+class StatsGraph : public QWidget {
+	std::vector<double> values;
+	size_t capacity = 0;
+	double reference = 0.0;
+
+public:
+	StatsGraph(QWidget *parent = nullptr);
+
+	void SetValues(std::vector<double> values, size_t capacity,
+		       double reference = 0.0);
+
+	virtual QSize sizeHint() const override;
+
+protected:
+	virtual void paintEvent(QPaintEvent *event) override;
+};
+
 class OBSBasicStats : public QWidget {
 	Q_OBJECT
 
@@ -20,13 +44,43 @@ class OBSBasicStats : public QWidget {
 	QLabel *hddSpace = nullptr;
 	QLabel *recordTimeLeft = nullptr;
 	QLabel *memUsage = nullptr;
+	QLabel *audioBuffering = nullptr;
 
 	QLabel *renderTime = nullptr;
 	QLabel *skippedFrames = nullptr;
 	QLabel *missedFrames = nullptr;
+	QLabel *gpuTime = nullptr;
+	QLabel *renderTimePercentiles = nullptr;
+	StatsGraph *renderTimeGraph = nullptr;
 
 	QGridLayout *outputLayout = nullptr;
 
+	struct SourceLabels {
+		QPointer<QLabel> name;
+		QPointer<QLabel> tick;
+		QPointer<QLabel> render;
+		QPointer<QLabel> audio;
+		QPointer<QLabel> gpu;
+		QPointer<QLabel> skipped;
+	};
+
+	QList<SourceLabels> sourceLabels;
+
+	struct MemoryLabels {
+		QPointer<QLabel> name;
+		QPointer<QLabel> system;
+		QPointer<QLabel> gpu;
+	};
+
+	QList<MemoryLabels> memoryLabels;
+	bool gpuTimingHeld = false;
+
+	/* totals of the previous update, to show the cost since then */
+	struct obs_gpu_stage_stats lastGPUStages[OBS_GPU_STAGE_COUNT] = {};
+	std::map<std::string, obs_source_perf_stats> lastSourceStats;
+	uint64_t lastSourceFrames = 0;
+	uint64_t lastGPUFrames = 0;
+
 	os_cpu_usage_info_t *cpu_info = nullptr;
 
 	QTimer timer;
@@ -40,6 +94,10 @@ class OBSBasicStats : public QWidget {
 		QPointer<QLabel> droppedFrames;
 		QPointer<QLabel> megabytesSent;
 		QPointer<QLabel> bitrate;
+		QPointer<QLabel> details;
+		QPointer<StatsGraph> bitrateGraph;
+
+		std::deque<double> bitrateHistory;
 
 		uint64_t lastBytesSent = 0;
 		uint64_t lastBytesSentTime = 0;
@@ -48,6 +106,8 @@ class OBSBasicStats : public QWidget {
 		int first_dropped = 0;
 
 		void Update(obs_output_t *output, bool rec);
+		void UpdateLink(obs_output_t *output);
+		void UpdateWriter(obs_output_t *output);
 		void Reset(obs_output_t *output);
 
 		long double kbps = 0.0l;
@@ -57,6 +117,11 @@ class OBSBasicStats : public QWidget {
 
 	void AddOutputLabels(QString name);
 	void Update();
+	void UpdateGPU();
+	void UpdateSources();
+	void UpdateMemory();
+	void UpdateRenderTimes();
+	void HoldGPUTiming(bool hold);
 
 	virtual void closeEvent(QCloseEvent *event) override;
 
@@ -3,6 +3,8 @@
 #include <QMouseEvent>
 #include <QMenu>
 #include <QScreen>
+#include <graphics/vec4.h>
+#include <util/platform.h>
 #include "obs-app.hpp"
 #include "window-basic-main.hpp"
 #include "display-helpers.hpp"
@@ -16,6 +18,7 @@ static bool updatingMultiview = false, drawLabel, drawSafeArea, mouseSwitching,
 	    transitionOnDoubleClick;
 static MultiviewLayout multiviewLayout;
 static size_t maxSrcs, numSrcs;
+static uint64_t sceneInterval;
 
 OBSProjector::OBSProjector(QWidget *widget, obs_source_t *source_, int monitor,
 			   ProjectorType type_)
@@ -166,6 +169,8 @@ OBSProjector::~OBSProjector()
 		gs_vertexbuffer_destroy(leftLine);
 		gs_vertexbuffer_destroy(topLine);
 		gs_vertexbuffer_destroy(rightLine);
+		for (SceneTile &tile : sceneTiles)
+			gs_texrender_destroy(tile.render);
 		obs_leave_graphics();
 	}
 
@@ -258,6 +263,35 @@ static inline uint32_t labelOffset(obs_source_t *label, uint32_t cx)
 	return (cx / 2) - w;
 }
 
+/* whether the main texture currently shows nothing but the given scene */
+static bool MainTextureShows(obs_source_t *scene)
+{
+	obs_source_t *output = obs_get_output_source(0);
+	bool shows = false;
+
+	if (!scene || !output) {
+		obs_source_release(output);
+		return false;
+	}
+
+	if (obs_source_get_type(output) == OBS_SOURCE_TYPE_TRANSITION) {
+		obs_source_t *a = obs_transition_get_source(
+			output, OBS_TRANSITION_SOURCE_A);
+		obs_source_t *b = obs_transition_get_source(
+			output, OBS_TRANSITION_SOURCE_B);
+
+		shows = a == scene && !b;
+
+		obs_source_release(a);
+		obs_source_release(b);
+	} else {
+		shows = output == scene;
+	}
+
+	obs_source_release(output);
+	return shows;
+}
+
 static inline void startRegion(int vX, int vY, int vCX, int vCY, float oL,
 			       float oR, float oT, float oB)
 {
@@ -273,6 +307,68 @@ static inline void endRegion()
 	gs_projection_pop();
 }
 
+/* scenes whose output can't have changed are drawn from their last render
+ * instead of being rendered again, and scenes that are neither in preview nor
+ * program are rendered again at most at the scene refresh rate */
+bool OBSProjector::DrawCachedScene(size_t i, obs_source_t *src, uint32_t cx,
+				   uint32_t cy, bool live)
+{
+	uint64_t version = 0;
+	uint64_t ts = os_gettime_ns();
+	bool limited = !live && sceneInterval;
+	bool versioned = obs_source_get_video_version(src, &version);
+
+	if (!cx || !cy || (!versioned && !limited))
+		return false;
+
+	if (sceneTiles.size() <= i)
+		sceneTiles.resize(i + 1);
+
+	SceneTile &tile = sceneTiles[i];
+	if (!tile.render)
+		tile.render = gs_texrender_create(GS_BGRA, GS_ZS_NONE);
+
+	bool unchanged = versioned && tile.version == version;
+	bool recent = limited && ts - tile.renderTime < sceneInterval;
+	bool current = tile.valid && (unchanged || recent) && tile.cx == cx &&
+		       tile.cy == cy &&
+		       obs_weak_source_references_source(tile.source, src);
+
+	if (!current) {
+		tile.valid = false;
+
+		gs_texrender_reset(tile.render);
+		if (!gs_texrender_begin(tile.render, cx, cy))
+			return false;
+
+		struct vec4 clearColor;
+		vec4_zero(&clearColor);
+		gs_clear(GS_CLEAR_COLOR, &clearColor, 0.0f, 0);
+		gs_ortho(0.0f, fw, 0.0f, fh, -100.0f, 100.0f);
+
+		obs_source_video_render(src);
+		gs_texrender_end(tile.render);
+
+		tile.source = OBSGetWeakRef(src);
+		tile.version = version;
+		tile.renderTime = ts;
+		tile.cx = cx;
+		tile.cy = cy;
+		tile.valid = true;
+	}
+
+	gs_texture_t *tex = gs_texrender_get_texture(tile.render);
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+	while (gs_effect_loop(effect, "Draw"))
+		obs_source_draw(tex, 0, 0, uint32_t(fw), uint32_t(fh), false);
+	gs_blend_state_pop();
+
+	return true;
+}
+
 void OBSProjector::OBSRenderMultiview(void *data, uint32_t cx, uint32_t cy)
 {
 	OBSProjector *window = (OBSProjector *)data;
@@ -293,6 +389,7 @@ void OBSProjector::OBSRenderMultiview(void *data, uint32_t cx, uint32_t cy)
 	OBSSource previewSrc = main->GetCurrentSceneSource();
 	OBSSource programSrc = main->GetProgramSource();
 	bool studioMode = main->IsPreviewProgramMode();
+	bool programIsMain = MainTextureShows(programSrc);
 
 	auto renderVB = [&](gs_vertbuffer_t *vb, int cx, int cy,
 			    uint32_t colorVal) {
@@ -486,12 +583,20 @@ void OBSProjector::OBSRenderMultiview(void *data, uint32_t cx, uint32_t cy)
 
 		/* ----------- */
 
-		// Render the source
+		// Render the source, the program scene is already in the main
+		// texture unless a transition is in progress
+		bool live = src == programSrc || src == previewSrc;
+
 		gs_matrix_push();
 		gs_matrix_translate3f(window->siX, window->siY, 0.0f);
 		gs_matrix_scale3f(window->siScaleX, window->siScaleY, 1.0f);
 		setRegion(window->siX, window->siY, window->siCX, window->siCY);
-		obs_source_video_render(src);
+		if (programIsMain && src == programSrc)
+			obs_render_main_texture();
+		else if (!window->DrawCachedScene(
+				 i, src, uint32_t(window->siCX * scale),
+				 uint32_t(window->siCY * scale), live))
+			obs_source_video_render(src);
 		endRegion();
 		gs_matrix_pop();
 
@@ -928,6 +1033,10 @@ void OBSProjector::UpdateMultiview()
 	transitionOnDoubleClick = config_get_bool(
 		GetGlobalConfig(), "BasicWindow", "TransitionOnDoubleClick");
 
+	uint64_t sceneFPS = config_get_uint(GetGlobalConfig(), "BasicWindow",
+					    "MultiviewSceneFPS");
+	sceneInterval = sceneFPS ? 1000000000ULL / sceneFPS : 0;
+
 	switch (multiviewLayout) {
 	case MultiviewLayout::HORIZONTAL_TOP_24_SCENES:
 		pvwprgCX = fw / 3;
@@ -42,6 +42,22 @@ private:
 	ProjectorType type = ProjectorType::Source;
 	std::vector<OBSWeakSource> multiviewScenes;
 	std::vector<OBSSource> multiviewLabels;
+
+	/* last render of each scene of the multiview, only used by the
+	 * graphics thread */
+	struct SceneTile {
+		gs_texrender_t *render = nullptr;
+		OBSWeakSource source;
+		uint64_t version = 0;
+		uint64_t renderTime = 0;
+		uint32_t cx = 0;
+		uint32_t cy = 0;
+		bool valid = false;
+	};
+
+	std::vector<SceneTile> sceneTiles;
+	bool DrawCachedScene(size_t i, obs_source_t *src, uint32_t cx,
+			     uint32_t cy, bool live);
 	gs_vertbuffer_t *actionSafeMargin = nullptr;
 	gs_vertbuffer_t *graphicsSafeMargin = nullptr;
 	gs_vertbuffer_t *fourByThreeSafeMargin = nullptr;
@@ -544,11 +544,15 @@ bool RemuxQueueModel::canClearFinished() const
 	return canClearFinished;
 }
 
-void RemuxQueueModel::beginProcessing()
+int RemuxQueueModel::beginProcessing()
 {
+	int pending = 0;
+
 	for (RemuxQueueEntry &entry : queue)
-		if (entry.state == RemuxEntryState::Ready)
+		if (entry.state == RemuxEntryState::Ready) {
 			entry.state = RemuxEntryState::Pending;
+			pending++;
+		}
 
 	// Signal that the insertion point no longer exists.
 	beginRemoveRows(QModelIndex(), queue.length(), queue.length());
@@ -558,6 +562,8 @@ void RemuxQueueModel::beginProcessing()
 
 	emit dataChanged(index(0, RemuxEntryColumn::State),
 			 index(queue.length(), RemuxEntryColumn::State));
+
+	return pending;
 }
 
 void RemuxQueueModel::endProcessing()
@@ -605,11 +611,14 @@ bool RemuxQueueModel::beginNextEntry(QString &inputPath, QString &outputPath)
 	return anyStarted;
 }
 
-void RemuxQueueModel::finishEntry(bool success)
+void RemuxQueueModel::finishEntry(const QString &inputPath, bool success)
 {
+	// Rows can be cleared while jobs run, so the entry is looked up by
+	// its path rather than remembered by row.
 	for (int row = 0; row < queue.length(); row++) {
 		RemuxQueueEntry &entry = queue[row];
-		if (entry.state == RemuxEntryState::InProgress) {
+		if (entry.state == RemuxEntryState::InProgress &&
+		    entry.sourcePath == inputPath) {
 			if (success)
 				entry.state = RemuxEntryState::Complete;
 			else
@@ -631,7 +640,6 @@ void RemuxQueueModel::finishEntry(bool success)
 OBSRemux::OBSRemux(const char *path, QWidget *parent, bool autoRemux_)
 	: QDialog(parent),
 	  queueModel(new RemuxQueueModel),
-	  worker(new RemuxWorker()),
 	  ui(new Ui::OBSRemux),
 	  recPath(path),
 	  autoRemux(autoRemux_)
@@ -691,17 +699,35 @@ OBSRemux::OBSRemux(const char *path, QWidget *parent, bool autoRemux_)
 	connect(ui->buttonBox->button(QDialogButtonBox::Close),
 		SIGNAL(clicked()), this, SLOT(close()));
 
-	worker->moveToThread(&remuxer);
-	remuxer.start();
-
-	//gcc-4.8 can't use QPointer<RemuxWorker> below
-	RemuxWorker *worker_ = worker;
-	connect(worker_, &RemuxWorker::updateProgress, this,
-		&OBSRemux::updateProgress);
-	connect(&remuxer, &QThread::finished, worker_, &QObject::deleteLater);
-	connect(worker_, &RemuxWorker::remuxFinished, this,
-		&OBSRemux::remuxFinished);
-	connect(this, &OBSRemux::remux, worker_, &RemuxWorker::remux);
+	// Remuxing is mostly I/O, so only a few jobs are run at once to
+	// avoid thrashing the disk.
+	int concurrency = (int)config_get_int(GetGlobalConfig(), "General",
+					      "RemuxConcurrency");
+	if (autoRemux || concurrency < 1)
+		concurrency = 1;
+	else if (concurrency > 16)
+		concurrency = 16;
+
+	bool fastStart = config_get_bool(GetGlobalConfig(), "General",
+					 "RemuxFastStart");
+
+	for (int i = 0; i < concurrency; i++) {
+		RemuxThread *slot = new RemuxThread;
+		workers.emplace_back(slot);
+
+		//gcc-4.8 can't use QPointer<RemuxWorker> below
+		RemuxWorker *worker_ = new RemuxWorker(fastStart);
+		slot->worker = worker_;
+		worker_->moveToThread(&slot->thread);
+		slot->thread.start();
+
+		connect(worker_, &RemuxWorker::updateProgress, this,
+			&OBSRemux::updateProgress);
+		connect(&slot->thread, &QThread::finished, worker_,
+			&QObject::deleteLater);
+		connect(worker_, &RemuxWorker::remuxFinished, this,
+			&OBSRemux::remuxFinished);
+	}
 
 	// Guessing the GCC bug mentioned above would also affect
 	// QPointer<RemuxQueueModel>? Unsure.
@@ -718,15 +744,32 @@ OBSRemux::OBSRemux(const char *path, QWidget *parent, bool autoRemux_)
 				  Q_ARG(const QModelIndex &, index));
 }
 
+bool OBSRemux::isRemuxing() const
+{
+	for (const auto &slot : workers)
+		if (slot->busy)
+			return true;
+	return false;
+}
+
+OBSRemux::RemuxThread *OBSRemux::findThread(QObject *worker)
+{
+	for (auto &slot : workers)
+		if (slot->worker == worker)
+			return slot.get();
+	return nullptr;
+}
+
 bool OBSRemux::stopRemux()
 {
-	if (!worker->isWorking)
+	if (!isRemuxing())
 		return true;
 
-	// By locking the worker thread's mutex, we ensure that its
-	// update poll will be blocked as long as we're in here with
+	// By locking the worker threads' mutexes, we ensure that their
+	// update polls will be blocked as long as we're in here with
 	// the popup open.
-	QMutexLocker lock(&worker->updateMutex);
+	for (auto &slot : workers)
+		slot->worker->updateMutex.lock();
 
 	bool exit = false;
 
@@ -738,20 +781,28 @@ bool OBSRemux::stopRemux()
 	}
 
 	if (exit) {
-		// Inform the worker it should no longer be
-		// working. It will interrupt accordingly in
-		// its next update callback.
-		worker->isWorking = false;
+		// Inform the workers they should no longer be
+		// working. They will interrupt accordingly in
+		// their next update callback, and no further
+		// entries are started.
+		for (auto &slot : workers)
+			slot->worker->isWorking = false;
+		stopping = true;
 	}
 
+	for (auto &slot : workers)
+		slot->worker->updateMutex.unlock();
+
 	return exit;
 }
 
 OBSRemux::~OBSRemux()
 {
 	stopRemux();
-	remuxer.quit();
-	remuxer.wait();
+	for (auto &slot : workers) {
+		slot->thread.quit();
+		slot->thread.wait();
+	}
 }
 
 void OBSRemux::rowCountChanged(const QModelIndex &, int, int)
@@ -819,13 +870,13 @@ void OBSRemux::dropEvent(QDropEvent *ev)
 
 void OBSRemux::dragEnterEvent(QDragEnterEvent *ev)
 {
-	if (ev->mimeData()->hasUrls() && !worker->isWorking)
+	if (ev->mimeData()->hasUrls() && !isRemuxing())
 		ev->accept();
 }
 
 void OBSRemux::beginRemux()
 {
-	if (worker->isWorking) {
+	if (isRemuxing()) {
 		stopRemux();
 		return;
 	}
@@ -850,7 +901,9 @@ void OBSRemux::beginRemux()
 		return;
 
 	// Set all jobs to "pending" first.
-	queueModel->beginProcessing();
+	batchTotal = queueModel->beginProcessing();
+	batchDone = 0;
+	stopping = false;
 
 	ui->progressBar->setVisible(true);
 	ui->buttonBox->button(QDialogButtonBox::Ok)
@@ -863,19 +916,42 @@ void OBSRemux::beginRemux()
 void OBSRemux::AutoRemux(QString inFile, QString outFile)
 {
 	if (inFile != "" && outFile != "" && autoRemux) {
-		emit remux(inFile, outFile);
+		batchTotal = 1;
+		batchDone = 0;
+		startJob(*workers[0], inFile, outFile);
 		autoRemuxFile = inFile;
 	}
 }
 
+void OBSRemux::startJob(RemuxThread &slot, const QString &source,
+			const QString &target)
+{
+	slot.sourcePath = source;
+	slot.busy = true;
+	slot.progress = 0.0f;
+	slot.worker->lastProgress = 0.f;
+
+	QMetaObject::invokeMethod(slot.worker, "remux", Qt::QueuedConnection,
+				  Q_ARG(const QString &, source),
+				  Q_ARG(const QString &, target));
+}
+
 void OBSRemux::remuxNextEntry()
 {
-	worker->lastProgress = 0.f;
+	for (auto &slot : workers) {
+		if (stopping)
+			break;
+		if (slot->busy)
+			continue;
 
-	QString inputPath, outputPath;
-	if (queueModel->beginNextEntry(inputPath, outputPath)) {
-		emit remux(inputPath, outputPath);
-	} else {
+		QString inputPath, outputPath;
+		if (!queueModel->beginNextEntry(inputPath, outputPath))
+			break;
+
+		startJob(*slot, inputPath, outputPath);
+	}
+
+	if (!isRemuxing()) {
 		queueModel->autoRemux = autoRemux;
 		queueModel->endProcessing();
 
@@ -916,14 +992,38 @@ void OBSRemux::reject()
 
 void OBSRemux::updateProgress(float percent)
 {
-	ui->progressBar->setValue(percent * 10);
+	RemuxThread *slot = findThread(sender());
+	if (!slot || !slot->busy)
+		return;
+
+	slot->progress = percent;
+
+	// The bar shows the whole batch, the finished jobs plus the
+	// progress of the ones that are still running.
+	float total = (float)batchDone * 100.0f;
+	for (const auto &other : workers)
+		if (other->busy)
+			total += other->progress;
+
+	if (batchTotal > 0)
+		total /= (float)batchTotal;
+
+	ui->progressBar->setValue(total * 10);
 }
 
 void OBSRemux::remuxFinished(bool success)
 {
 	ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(true);
 
-	queueModel->finishEntry(success);
+	RemuxThread *slot = findThread(sender());
+	if (slot) {
+		queueModel->finishEntry(slot->sourcePath, success);
+		slot->busy = false;
+		slot->progress = 0.0f;
+		slot->sourcePath.clear();
+	}
+
+	batchDone++;
 
 	if (autoRemux && autoRemuxFile != "") {
 		QTimer::singleShot(3000, this, SLOT(close()));
@@ -977,6 +1077,7 @@ void RemuxWorker::remux(const QString &source, const QString &target)
 	if (media_remux_job_create(&mr_job, QT_TO_UTF8(source),
 				   QT_TO_UTF8(target))) {
 
+		media_remux_job_set_fast_start(mr_job, fastStart);
 		success = media_remux_job_process(mr_job, callback, this);
 
 		media_remux_job_destroy(mr_job);
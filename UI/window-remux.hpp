@@ -23,6 +23,7 @@
 #include <QThread>
 #include <QStyledItemDelegate>
 #include <memory>
+#include <vector>
 #include "ui_OBSRemux.h"
 
 #include <media-io/media-remux.h>
@@ -46,8 +47,20 @@ class OBSRemux : public QDialog {
 	Q_OBJECT
 
 	QPointer<RemuxQueueModel> queueModel;
-	QThread remuxer;
-	QPointer<RemuxWorker> worker;
+
+	/* jobs run on several workers at once, each one on its own thread */
+	struct RemuxThread {
+		QThread thread;
+		QPointer<RemuxWorker> worker;
+		QString sourcePath;
+		bool busy = false;
+		float progress = 0.0f;
+	};
+	std::vector<std::unique_ptr<RemuxThread>> workers;
+
+	bool stopping = false;
+	int batchTotal = 0;
+	int batchDone = 0;
 
 	std::unique_ptr<Ui::OBSRemux> ui;
 
@@ -73,6 +86,10 @@ protected:
 	virtual void dragEnterEvent(QDragEnterEvent *ev) override;
 
 	void remuxNextEntry();
+	void startJob(RemuxThread &slot, const QString &source,
+		      const QString &target);
+	RemuxThread *findThread(QObject *worker);
+	bool isRemuxing() const;
 
 private slots:
 	void rowCountChanged(const QModelIndex &parent, int first, int last);
@@ -84,9 +101,6 @@ public slots:
 	bool stopRemux();
 	void clearFinished();
 	void clearAll();
-
-signals:
-	void remux(const QString &source, const QString &target);
 };
 
 class RemuxQueueModel : public QAbstractTableModel {
@@ -110,10 +124,10 @@ public:
 
 	QFileInfoList checkForOverwrites() const;
 	bool checkForErrors() const;
-	void beginProcessing();
+	int beginProcessing();
 	void endProcessing();
 	bool beginNextEntry(QString &inputPath, QString &outputPath);
-	void finishEntry(bool success);
+	void finishEntry(const QString &inputPath, bool success);
 	bool canClearFinished() const;
 	void clearFinished();
 	void clearAll();
@@ -142,11 +156,15 @@ class RemuxWorker : public QObject {
 	QMutex updateMutex;
 
 	bool isWorking;
+	bool fastStart;
 
 	float lastProgress;
 	void UpdateProgress(float percent);
 
-	explicit RemuxWorker() : isWorking(false) {}
+	explicit RemuxWorker(bool fastStart_)
+		: isWorking(false), fastStart(fastStart_)
+	{
+	}
 	virtual ~RemuxWorker(){};
 
 private slots:
@@ -0,0 +1,51 @@
+# Once done these will be defined:
+#
+#  GIO_FOUND
+#  GIO_INCLUDE_DIRS
+#  GIO_LIBRARIES
+
+find_package(PkgConfig QUIET)
+if (PKG_CONFIG_FOUND)
+	pkg_check_modules(_GIO QUIET gio-2.0 gio-unix-2.0)
+endif()
+
+find_path(GIO_INCLUDE_DIR
+	NAMES gio/gio.h
+	HINTS
+		${_GIO_INCLUDE_DIRS}
+	PATHS
+		/usr/include /usr/local/include /opt/local/include
+	PATH_SUFFIXES
+		glib-2.0)
+
+find_library(GIO_LIB
+	NAMES gio-2.0
+	HINTS
+		${_GIO_LIBRARY_DIRS}
+	PATHS
+		/usr/lib /usr/local/lib /opt/local/lib)
+
+find_library(GOBJECT_LIB
+	NAMES gobject-2.0
+	HINTS
+		${_GIO_LIBRARY_DIRS}
+	PATHS
+		/usr/lib /usr/local/lib /opt/local/lib)
+
+find_library(GLIB_LIB
+	NAMES glib-2.0
+	HINTS
+		${_GIO_LIBRARY_DIRS}
+	PATHS
+		/usr/lib /usr/local/lib /opt/local/lib)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Gio DEFAULT_MSG GIO_LIB GOBJECT_LIB
+	GLIB_LIB GIO_INCLUDE_DIR)
+mark_as_advanced(GIO_INCLUDE_DIR GIO_LIB GOBJECT_LIB GLIB_LIB)
+
+if(GIO_FOUND)
+	# glibconfig.h and gio/gunixfdlist.h live outside of glib-2.0
+	set(GIO_INCLUDE_DIRS ${GIO_INCLUDE_DIR} ${_GIO_INCLUDE_DIRS})
+	set(GIO_LIBRARIES ${GIO_LIB} ${GOBJECT_LIB} ${GLIB_LIB})
+endif()
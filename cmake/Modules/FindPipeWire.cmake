@@ -0,0 +1,45 @@
+# Once done these will be defined:
+#
+#  PIPEWIRE_FOUND
+#  PIPEWIRE_INCLUDE_DIRS
+#  PIPEWIRE_LIBRARIES
+
+find_package(PkgConfig QUIET)
+if (PKG_CONFIG_FOUND)
+	pkg_check_modules(_PIPEWIRE QUIET libpipewire-0.3 libspa-0.2)
+endif()
+
+find_path(PIPEWIRE_INCLUDE_DIR
+	NAMES pipewire/pipewire.h
+	HINTS
+		${_PIPEWIRE_INCLUDE_DIRS}
+	PATHS
+		/usr/include /usr/local/include /opt/local/include
+	PATH_SUFFIXES
+		pipewire-0.3)
+
+find_path(SPA_INCLUDE_DIR
+	NAMES spa/param/props.h
+	HINTS
+		${_PIPEWIRE_INCLUDE_DIRS}
+	PATHS
+		/usr/include /usr/local/include /opt/local/include
+	PATH_SUFFIXES
+		spa-0.2)
+
+find_library(PIPEWIRE_LIB
+	NAMES pipewire-0.3
+	HINTS
+		${_PIPEWIRE_LIBRARY_DIRS}
+	PATHS
+		/usr/lib /usr/local/lib /opt/local/lib)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(PipeWire DEFAULT_MSG PIPEWIRE_LIB
+	PIPEWIRE_INCLUDE_DIR SPA_INCLUDE_DIR)
+mark_as_advanced(PIPEWIRE_INCLUDE_DIR SPA_INCLUDE_DIR PIPEWIRE_LIB)
+
+if(PIPEWIRE_FOUND)
+	set(PIPEWIRE_INCLUDE_DIRS ${PIPEWIRE_INCLUDE_DIR} ${SPA_INCLUDE_DIR})
+	set(PIPEWIRE_LIBRARIES ${PIPEWIRE_LIB})
+endif()
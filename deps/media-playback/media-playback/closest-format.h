@@ -53,6 +53,8 @@ static enum AVPixelFormat closest_format(enum AVPixelFormat fmt)
 
 	case AV_PIX_FMT_NV12:
 	case AV_PIX_FMT_NV21:
+	case AV_PIX_FMT_P010LE:
+	case AV_PIX_FMT_P016LE:
 		return AV_PIX_FMT_NV12;
 
 	case AV_PIX_FMT_YUV420P:
@@ -47,20 +47,40 @@ static bool has_hw_type(AVCodec *c, enum AVHWDeviceType type,
 	return false;
 }
 
+/* Opening a hardware device takes a while, and doing it for every file
+ * delays each file change and reconnect, so devices are shared by all
+ * decoders until mp_media_free_hw_devices is called. */
+#define NUM_HW_TYPES (sizeof(hw_priority) / sizeof(hw_priority[0]))
+
+static pthread_mutex_t hw_device_mutex = PTHREAD_MUTEX_INITIALIZER;
+static AVBufferRef *hw_devices[NUM_HW_TYPES];
+
+static AVBufferRef *get_hw_device(size_t type_idx)
+{
+	AVBufferRef *hw_ctx = NULL;
+
+	pthread_mutex_lock(&hw_device_mutex);
+
+	if (!hw_devices[type_idx])
+		av_hwdevice_ctx_create(&hw_devices[type_idx],
+				       hw_priority[type_idx], NULL, NULL, 0);
+	if (hw_devices[type_idx])
+		hw_ctx = av_buffer_ref(hw_devices[type_idx]);
+
+	pthread_mutex_unlock(&hw_device_mutex);
+	return hw_ctx;
+}
+
 static void init_hw_decoder(struct mp_decode *d, AVCodecContext *c)
 {
-	enum AVHWDeviceType *priority = hw_priority;
 	AVBufferRef *hw_ctx = NULL;
 
-	while (*priority != AV_HWDEVICE_TYPE_NONE) {
-		if (has_hw_type(d->codec, *priority, &d->hw_format)) {
-			int ret = av_hwdevice_ctx_create(&hw_ctx, *priority,
-							 NULL, NULL, 0);
-			if (ret == 0)
+	for (size_t i = 0; hw_priority[i] != AV_HWDEVICE_TYPE_NONE; i++) {
+		if (has_hw_type(d->codec, hw_priority[i], &d->hw_format)) {
+			hw_ctx = get_hw_device(i);
+			if (hw_ctx)
 				break;
 		}
-
-		priority++;
 	}
 
 	if (hw_ctx) {
@@ -72,6 +92,16 @@ static void init_hw_decoder(struct mp_decode *d, AVCodecContext *c)
 }
 #endif
 
+void mp_media_free_hw_devices(void)
+{
+#ifdef USE_NEW_HARDWARE_CODEC_METHOD
+	pthread_mutex_lock(&hw_device_mutex);
+	for (size_t i = 0; i < NUM_HW_TYPES; i++)
+		av_buffer_unref(&hw_devices[i]);
+	pthread_mutex_unlock(&hw_device_mutex);
+#endif
+}
+
 static int mp_open_codec(struct mp_decode *d, bool hw)
 {
 	AVCodecContext *c;
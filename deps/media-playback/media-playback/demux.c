@@ -0,0 +1,414 @@
+/*
+ * Copyright (c) 2017 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <util/platform.h>
+#include "media.h"
+
+#define MIN_QUEUE_NS 2000000000LL
+#define MAX_QUEUE_PACKETS 20000
+#define STOP_POLL_MS 50
+
+static const AVRational ns_q = {1, 1000000000};
+
+struct demux_packet {
+	AVPacket pkt;
+	int64_t ts_ns;
+	bool discontinuity;
+};
+
+static inline bool demux_stopping(mp_media_t *m)
+{
+	bool stop;
+
+	pthread_mutex_lock(&m->mutex);
+	stop = m->demux.stop || m->kill;
+	pthread_mutex_unlock(&m->mutex);
+
+	return stop;
+}
+
+static bool demux_sleep(mp_media_t *m, int ms)
+{
+	while (ms > 0) {
+		if (demux_stopping(m))
+			return false;
+
+		os_sleep_ms(ms < STOP_POLL_MS ? ms : STOP_POLL_MS);
+		ms -= STOP_POLL_MS;
+	}
+
+	return !demux_stopping(m);
+}
+
+/* assumes demux mutex */
+static inline int64_t queued_ns(struct mp_demux *d)
+{
+	struct demux_packet *front, *back;
+
+	if (!d->packets.size)
+		return 0;
+
+	front = circlebuf_data(&d->packets, 0);
+	back = circlebuf_data(&d->packets,
+			      d->packets.size - sizeof(struct demux_packet));
+	return back->ts_ns - front->ts_ns;
+}
+
+static bool queue_full(mp_media_t *m)
+{
+	struct mp_demux *d = &m->demux;
+	int64_t max_ns = m->jitter_ns * 4;
+	bool full;
+
+	if (max_ns < MIN_QUEUE_NS)
+		max_ns = MIN_QUEUE_NS;
+
+	pthread_mutex_lock(&d->mutex);
+	full = queued_ns(d) > max_ns ||
+	       d->packets.size / sizeof(struct demux_packet) >=
+		       MAX_QUEUE_PACKETS;
+	pthread_mutex_unlock(&d->mutex);
+
+	return full;
+}
+
+static void set_error(struct mp_demux *d, int error)
+{
+	pthread_mutex_lock(&d->mutex);
+	d->error = error;
+	pthread_mutex_unlock(&d->mutex);
+	os_event_signal(d->event);
+}
+
+static inline int64_t packet_ts(const AVPacket *pkt)
+{
+	return pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+}
+
+static bool streams_compatible(AVStream *a, AVStream *b)
+{
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 40, 101)
+	const AVCodecParameters *pa = a->codecpar;
+	const AVCodecParameters *pb = b->codecpar;
+#else
+	const AVCodecContext *pa = a->codec;
+	const AVCodecContext *pb = b->codec;
+#endif
+
+	if (pa->codec_type != pb->codec_type || pa->codec_id != pb->codec_id)
+		return false;
+	if (pa->codec_type == AVMEDIA_TYPE_VIDEO)
+		return pa->width == pb->width && pa->height == pb->height;
+	return pa->sample_rate == pb->sample_rate &&
+	       pa->channels == pb->channels;
+}
+
+/* returns -1 if the stream is not needed, -2 if it cannot be found */
+static int map_stream(AVFormatContext *fmt, bool used, AVStream *old)
+{
+	if (!used)
+		return -1;
+
+	for (unsigned int i = 0; i < fmt->nb_streams; i++) {
+		if (streams_compatible(fmt->streams[i], old))
+			return (int)i;
+	}
+
+	return -2;
+}
+
+/* assumes demux thread */
+static void close_input(mp_media_t *m)
+{
+	struct mp_demux *d = &m->demux;
+
+	/* the original input stays with the media, it is still referenced
+	 * by the decoders' streams */
+	if (d->fmt != m->fmt)
+		avformat_close_input(&d->fmt);
+	d->fmt = NULL;
+}
+
+/* reopens the input and feeds the existing decoders from it, so that the
+ * last frame stays on screen and nothing has to be reinitialized.  fails
+ * (and leaves the reconnect to the media's owner) if the stream changed in
+ * a way the decoders cannot follow */
+static bool demux_reconnect(mp_media_t *m)
+{
+	struct mp_demux *d = &m->demux;
+	AVFormatContext *fmt = NULL;
+	int video_index, audio_index;
+
+	blog(LOG_INFO, "MP: Lost connection to '%s', reconnecting", m->path);
+
+	while (!fmt) {
+		if (!demux_sleep(m, m->reconnect_delay_ms))
+			return false;
+		fmt = mp_media_open_input(m);
+	}
+
+	video_index = map_stream(fmt, m->has_video, m->v.stream);
+	audio_index = map_stream(fmt, m->has_audio, m->a.stream);
+
+	if (video_index == -2 || audio_index == -2) {
+		blog(LOG_WARNING,
+		     "MP: Streams of '%s' changed after reconnecting, "
+		     "reopening media",
+		     m->path);
+		avformat_close_input(&fmt);
+		return false;
+	}
+
+	close_input(m);
+	d->fmt = fmt;
+	d->video_index = video_index;
+	d->audio_index = audio_index;
+	d->discontinuity = true;
+
+	blog(LOG_INFO, "MP: Reconnected to '%s'", m->path);
+	return true;
+}
+
+/* maps the packet onto the stream of the original input it belongs to, in
+ * that stream's time base, and continues the timeline across reconnects */
+static AVStream *translate_packet(mp_media_t *m, AVPacket *pkt)
+{
+	struct mp_demux *d = &m->demux;
+	AVStream *stream;
+	int64_t offset;
+
+	if (pkt->stream_index == d->video_index)
+		stream = m->v.stream;
+	else if (pkt->stream_index == d->audio_index)
+		stream = m->a.stream;
+	else
+		return NULL;
+
+	av_packet_rescale_ts(pkt, d->fmt->streams[pkt->stream_index]->time_base,
+			     stream->time_base);
+	pkt->stream_index = stream->index;
+
+	if (d->discontinuity && packet_ts(pkt) != AV_NOPTS_VALUE)
+		d->offset_ns = d->last_end_ns -
+			       av_rescale_q(packet_ts(pkt), stream->time_base,
+					    ns_q);
+
+	if (d->offset_ns) {
+		offset = av_rescale_q(d->offset_ns, ns_q, stream->time_base);
+		if (pkt->pts != AV_NOPTS_VALUE)
+			pkt->pts += offset;
+		if (pkt->dts != AV_NOPTS_VALUE)
+			pkt->dts += offset;
+	}
+
+	return stream;
+}
+
+static void push_packet(mp_media_t *m, AVPacket *pkt)
+{
+	struct mp_demux *d = &m->demux;
+	struct demux_packet packet = {0};
+	AVStream *stream = translate_packet(m, pkt);
+
+	if (!stream || !pkt->size) {
+		av_packet_unref(pkt);
+		return;
+	}
+
+	if (packet_ts(pkt) != AV_NOPTS_VALUE) {
+		int64_t end_ns;
+
+		packet.ts_ns = av_rescale_q(packet_ts(pkt), stream->time_base,
+					    ns_q);
+		end_ns = packet.ts_ns +
+			 av_rescale_q(pkt->duration, stream->time_base, ns_q);
+		if (end_ns > d->last_end_ns)
+			d->last_end_ns = end_ns;
+	} else {
+		packet.ts_ns = d->last_end_ns;
+	}
+
+	packet.pkt = *pkt;
+	packet.discontinuity = d->discontinuity;
+	d->discontinuity = false;
+
+	pthread_mutex_lock(&d->mutex);
+	circlebuf_push_back(&d->packets, &packet, sizeof(packet));
+	pthread_mutex_unlock(&d->mutex);
+	os_event_signal(d->event);
+}
+
+static void *mp_demux_thread(void *opaque)
+{
+	mp_media_t *m = opaque;
+	struct mp_demux *d = &m->demux;
+
+	os_set_thread_name("mp_demux_thread");
+
+	while (!demux_stopping(m)) {
+		AVPacket pkt;
+		int ret;
+
+		if (queue_full(m)) {
+			os_sleep_ms(10);
+			continue;
+		}
+
+		av_init_packet(&pkt);
+		ret = av_read_frame(d->fmt, &pkt);
+
+		/* interrupted by a stop, which either ends playback or kills
+		 * this thread */
+		if (ret == AVERROR_EXIT) {
+			os_sleep_ms(10);
+			continue;
+		}
+
+		/* inputs with a known duration (files over http etc.) end
+		 * normally */
+		if (ret == AVERROR_EOF && d->fmt->duration != AV_NOPTS_VALUE) {
+			set_error(d, ret);
+			break;
+		}
+
+		if (ret < 0) {
+			if (ret != AVERROR_EOF)
+				blog(LOG_WARNING,
+				     "MP: av_read_frame failed: %s (%d)",
+				     av_err2str(ret), ret);
+
+			if (!demux_reconnect(m)) {
+				set_error(d, ret);
+				break;
+			}
+			continue;
+		}
+
+		push_packet(m, &pkt);
+	}
+
+	close_input(m);
+	return NULL;
+}
+
+bool mp_demux_start(mp_media_t *m)
+{
+	struct mp_demux *d = &m->demux;
+
+	if (pthread_mutex_init(&d->mutex, NULL) != 0)
+		return false;
+	if (os_event_init(&d->event, OS_EVENT_TYPE_AUTO) != 0) {
+		pthread_mutex_destroy(&d->mutex);
+		return false;
+	}
+
+	d->fmt = m->fmt;
+	d->video_index = m->has_video ? m->v.stream->index : -1;
+	d->audio_index = m->has_audio ? m->a.stream->index : -1;
+	d->buffering = true;
+
+	if (pthread_create(&d->thread, NULL, mp_demux_thread, m) != 0) {
+		blog(LOG_WARNING, "MP: Could not create demux thread");
+		os_event_destroy(d->event);
+		pthread_mutex_destroy(&d->mutex);
+		memset(d, 0, sizeof(*d));
+		return false;
+	}
+
+	d->thread_valid = true;
+	return true;
+}
+
+void mp_demux_free(mp_media_t *m)
+{
+	struct mp_demux *d = &m->demux;
+
+	if (!d->thread_valid)
+		return;
+
+	pthread_mutex_lock(&m->mutex);
+	d->stop = true;
+	pthread_mutex_unlock(&m->mutex);
+
+	pthread_join(d->thread, NULL);
+
+	while (d->packets.size) {
+		struct demux_packet packet;
+		circlebuf_pop_front(&d->packets, &packet, sizeof(packet));
+		av_packet_unref(&packet.pkt);
+	}
+
+	circlebuf_free(&d->packets);
+	os_event_destroy(d->event);
+	pthread_mutex_destroy(&d->mutex);
+	memset(d, 0, sizeof(*d));
+}
+
+/* same contract as av_read_frame; waits until the jitter buffer is filled
+ * whenever it runs dry, and flags the media to resynchronize its clock
+ * once playback can continue */
+int mp_demux_next_packet(mp_media_t *m, AVPacket *pkt)
+{
+	struct mp_demux *d = &m->demux;
+	struct demux_packet packet;
+
+	for (;;) {
+		bool stop, drained;
+		int error;
+
+		pthread_mutex_lock(&m->mutex);
+		stop = m->kill || m->stopping;
+		pthread_mutex_unlock(&m->mutex);
+
+		if (stop)
+			return AVERROR_EXIT;
+
+		pthread_mutex_lock(&d->mutex);
+		error = d->error;
+
+		if (d->packets.size &&
+		    (!d->buffering || error || queued_ns(d) >= m->jitter_ns)) {
+			circlebuf_pop_front(&d->packets, &packet,
+					    sizeof(packet));
+			if (d->buffering) {
+				d->buffering = false;
+				d->resync = true;
+			}
+			pthread_mutex_unlock(&d->mutex);
+			break;
+		}
+
+		drained = !d->packets.size;
+		if (drained && !error && !d->buffering) {
+			blog(LOG_DEBUG, "MP: Buffer of '%s' ran dry, "
+					"rebuffering",
+			     m->path);
+			d->buffering = true;
+		}
+		pthread_mutex_unlock(&d->mutex);
+
+		if (drained && error)
+			return error;
+
+		os_event_timedwait(d->event, 10);
+	}
+
+	if (packet.discontinuity)
+		d->resync = true;
+
+	*pkt = packet.pkt;
+	return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2017 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <util/circlebuf.h>
+#include <util/threading.h>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#pragma warning(disable : 4204)
+#endif
+
+#include <libavformat/avformat.h>
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+struct mp_media;
+
+/*
+ * Network inputs with a jitter buffer are read on their own thread, so that
+ * a slow or bursty connection never holds up decoding and A/V scheduling.
+ * Playback only starts (or resumes after running dry) once the buffer holds
+ * the requested duration.  If the connection is lost, the demux thread
+ * reopens the input itself and carries on feeding the existing decoders, so
+ * that the last frame stays up and nothing has to be reinitialized.
+ */
+struct mp_demux {
+	pthread_t thread;
+	bool thread_valid;
+
+	pthread_mutex_t mutex;
+	os_event_t *event;
+	struct circlebuf packets;
+	int error;
+	bool buffering;
+
+	/* set under the media mutex, see interrupt_callback */
+	bool stop;
+
+	/* media thread only */
+	bool resync;
+
+	/* demux thread only */
+	AVFormatContext *fmt;
+	int video_index;
+	int audio_index;
+	int64_t offset_ns;
+	int64_t last_end_ns;
+	bool discontinuity;
+};
+
+extern bool mp_demux_start(struct mp_media *media);
+extern void mp_demux_free(struct mp_media *media);
+
+extern int mp_demux_next_packet(struct mp_media *media, AVPacket *pkt);
+
+/* implemented in media.c, shared with the initial open */
+extern AVFormatContext *mp_media_open_input(struct mp_media *media);
+
+#ifdef __cplusplus
+}
+#endif
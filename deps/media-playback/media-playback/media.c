@@ -149,7 +149,9 @@ static int mp_media_next_packet(mp_media_t *media)
 	av_init_packet(&pkt);
 	new_pkt = pkt;
 
-	int ret = av_read_frame(media->fmt, &pkt);
+	int ret = media->demux.thread_valid
+			  ? mp_demux_next_packet(media, &pkt)
+			  : av_read_frame(media->fmt, &pkt);
 	if (ret < 0) {
 		if (ret != AVERROR_EOF && ret != AVERROR_EXIT)
 			blog(LOG_WARNING, "MP: av_read_frame failed: %s (%d)",
@@ -212,9 +214,11 @@ static bool mp_media_init_scaling(mp_media_t *m)
 	int range = get_sws_range(m->v.decoder->color_range);
 	const int *coeff = sws_getCoefficients(space);
 
+	/* with hardware decoding the decoder's format is the surface type,
+	 * the frames themselves have already been transferred */
 	m->swscale = sws_getCachedContext(NULL, m->v.decoder->width,
 					  m->v.decoder->height,
-					  m->v.decoder->pix_fmt,
+					  m->v.frame->format,
 					  m->v.decoder->width,
 					  m->v.decoder->height, m->scale_format,
 					  SWS_POINT, NULL, NULL, NULL);
@@ -237,6 +241,50 @@ static bool mp_media_init_scaling(mp_media_t *m)
 	return true;
 }
 
+static inline bool is_p010(int format)
+{
+	return format == AV_PIX_FMT_P010LE || format == AV_PIX_FMT_P016LE;
+}
+
+/* P010/P016 (what hardware decoders produce for 10-bit content) is NV12 with
+ * 16-bit samples, so dropping the low byte of each sample is all that is
+ * needed and is far cheaper than going through swscale */
+static bool mp_media_init_p010(mp_media_t *m)
+{
+	int ret = av_image_alloc(m->scale_pic, m->scale_linesizes,
+				 m->v.decoder->width, m->v.decoder->height,
+				 AV_PIX_FMT_NV12, 32);
+	if (ret < 0) {
+		blog(LOG_WARNING, "MP: Failed to create scale pic data");
+		return false;
+	}
+
+	m->fast_p010 = true;
+	return true;
+}
+
+static void mp_media_convert_p010(mp_media_t *m, const AVFrame *f)
+{
+	const int chroma_h = (f->height + 1) / 2;
+	const int chroma_w = (f->width + 1) / 2 * 2;
+
+	for (int plane = 0; plane < 2; plane++) {
+		const int rows = plane ? chroma_h : f->height;
+		const int samples = plane ? chroma_w : f->width;
+
+		for (int y = 0; y < rows; y++) {
+			const uint8_t *row =
+				f->data[plane] + (ptrdiff_t)f->linesize[plane] * y;
+			const uint16_t *src = (const uint16_t *)row;
+			uint8_t *dst = m->scale_pic[plane] +
+				       (ptrdiff_t)m->scale_linesizes[plane] * y;
+
+			for (int x = 0; x < samples; x++)
+				dst[x] = (uint8_t)(src[x] >> 8);
+		}
+	}
+}
+
 static bool mp_media_prepare_frames(mp_media_t *m)
 {
 	bool actively_seeking = m->seek_next_ts && m->pause;
@@ -261,10 +309,14 @@ static bool mp_media_prepare_frames(mp_media_t *m)
 			return false;
 	}
 
-	if (m->has_video && m->v.frame_ready && !m->swscale) {
+	if (m->has_video && m->v.frame_ready && !m->swscale &&
+	    !m->fast_p010) {
 		m->scale_format = closest_format(m->v.frame->format);
 		if (m->scale_format != m->v.frame->format) {
-			if (!mp_media_init_scaling(m)) {
+			if (is_p010(m->v.frame->format)) {
+				if (!mp_media_init_p010(m))
+					return false;
+			} else if (!mp_media_init_scaling(m)) {
 				return false;
 			}
 		}
@@ -371,6 +423,14 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 			frame->linesize[i] = abs(m->scale_linesizes[i]);
 		}
 
+	} else if (m->fast_p010) {
+		mp_media_convert_p010(m, f);
+
+		for (size_t i = 0; i < 4; i++) {
+			frame->data[i] = m->scale_pic[i];
+			frame->linesize[i] = m->scale_linesizes[i];
+		}
+
 	} else {
 		flip = f->linesize[0] < 0 && f->linesize[1] == 0;
 
@@ -518,15 +578,18 @@ static bool mp_media_reset(mp_media_t *m)
 	if (!mp_media_prepare_frames(m))
 		return false;
 
+	/* the clock is set up below either way */
+	m->demux.resync = false;
+
 	if (active) {
 		if (!m->play_sys_ts)
-			m->play_sys_ts = (int64_t)os_gettime_ns();
+			m->play_sys_ts = (int64_t)obs_get_clock_ns();
 		m->start_ts = m->next_pts_ns = mp_media_get_next_min_pts(m);
 		if (m->next_ns)
 			m->next_ns += offset;
 	} else {
 		m->start_ts = m->next_pts_ns = mp_media_get_next_min_pts(m);
-		m->play_sys_ts = (int64_t)os_gettime_ns();
+		m->play_sys_ts = (int64_t)obs_get_clock_ns();
 		m->next_ns = 0;
 	}
 
@@ -544,16 +607,16 @@ static inline bool mp_media_sleepto(mp_media_t *m)
 	bool timeout = false;
 
 	if (!m->next_ns) {
-		m->next_ns = os_gettime_ns();
+		m->next_ns = obs_get_clock_ns();
 	} else {
-		uint64_t t = os_gettime_ns();
+		uint64_t t = obs_get_clock_ns();
 		const uint64_t timeout_ns = 200000000;
 
 		if (m->next_ns > t && (m->next_ns - t) > timeout_ns) {
-			os_sleepto_ns(t + timeout_ns);
+			obs_sleepto_clock_ns(t + timeout_ns);
 			timeout = true;
 		} else {
-			os_sleepto_ns(m->next_ns);
+			obs_sleepto_clock_ns(m->next_ns);
 		}
 	}
 
@@ -591,7 +654,7 @@ static int interrupt_callback(void *data)
 
 	if ((ts - m->interrupt_poll_ts) > 20000000) {
 		pthread_mutex_lock(&m->mutex);
-		stop = m->kill || m->stopping;
+		stop = m->kill || m->stopping || m->demux.stop;
 		pthread_mutex_unlock(&m->mutex);
 
 		m->interrupt_poll_ts = ts;
@@ -600,9 +663,10 @@ static int interrupt_callback(void *data)
 	return stop;
 }
 
-static bool init_avformat(mp_media_t *m)
+AVFormatContext *mp_media_open_input(mp_media_t *m)
 {
 	AVInputFormat *format = NULL;
+	AVFormatContext *fmt;
 
 	if (m->format_name && *m->format_name) {
 		format = av_find_input_format(m->format_name);
@@ -617,17 +681,17 @@ static bool init_avformat(mp_media_t *m)
 	if (m->buffering && !m->is_local_file)
 		av_dict_set_int(&opts, "buffer_size", m->buffering, 0);
 
-	m->fmt = avformat_alloc_context();
+	fmt = avformat_alloc_context();
 	if (m->buffering == 0) {
-		m->fmt->flags |= AVFMT_FLAG_NOBUFFER;
+		fmt->flags |= AVFMT_FLAG_NOBUFFER;
 	}
 	if (!m->is_local_file) {
 		av_dict_set(&opts, "stimeout", "30000000", 0);
-		m->fmt->interrupt_callback.callback = interrupt_callback;
-		m->fmt->interrupt_callback.opaque = m;
+		fmt->interrupt_callback.callback = interrupt_callback;
+		fmt->interrupt_callback.opaque = m;
 	}
 
-	int ret = avformat_open_input(&m->fmt, m->path, format,
+	int ret = avformat_open_input(&fmt, m->path, format,
 				      opts ? &opts : NULL);
 	av_dict_free(&opts);
 
@@ -635,15 +699,25 @@ static bool init_avformat(mp_media_t *m)
 		if (!m->reconnecting)
 			blog(LOG_WARNING, "MP: Failed to open media: '%s'",
 			     m->path);
-		return false;
+		return NULL;
 	}
 
-	if (avformat_find_stream_info(m->fmt, NULL) < 0) {
+	if (avformat_find_stream_info(fmt, NULL) < 0) {
 		blog(LOG_WARNING, "MP: Failed to find stream info for '%s'",
 		     m->path);
-		return false;
+		avformat_close_input(&fmt);
+		return NULL;
 	}
 
+	return fmt;
+}
+
+static bool init_avformat(mp_media_t *m)
+{
+	m->fmt = mp_media_open_input(m);
+	if (!m->fmt)
+		return false;
+
 	m->reconnecting = false;
 	m->has_video = mp_decode_init(m, AVMEDIA_TYPE_VIDEO, m->hw);
 	m->has_audio = mp_decode_init(m, AVMEDIA_TYPE_AUDIO, m->hw);
@@ -662,7 +736,7 @@ static bool init_avformat(mp_media_t *m)
 static void reset_ts(mp_media_t *m)
 {
 	m->base_ts += mp_media_get_base_pts(m);
-	m->play_sys_ts = (int64_t)os_gettime_ns();
+	m->play_sys_ts = (int64_t)obs_get_clock_ns();
 	m->start_ts = m->next_pts_ns = mp_media_get_next_min_pts(m);
 	m->next_ns = 0;
 }
@@ -674,6 +748,9 @@ static inline bool mp_media_thread(mp_media_t *m)
 	if (!init_avformat(m)) {
 		return false;
 	}
+	if (!m->is_local_file && m->jitter_ns > 0 && !mp_demux_start(m)) {
+		return false;
+	}
 	if (!mp_media_reset(m)) {
 		return false;
 	}
@@ -748,6 +825,13 @@ static inline bool mp_media_thread(mp_media_t *m)
 				continue;
 
 			mp_media_calc_next_ns(m);
+
+			/* the jitter buffer was refilled or the input was
+			 * reconnected, playback continues from here */
+			if (m->demux.resync) {
+				m->demux.resync = false;
+				reset_ts(m);
+			}
 		}
 	}
 
@@ -757,8 +841,11 @@ static inline bool mp_media_thread(mp_media_t *m)
 static void *mp_media_thread_start(void *opaque)
 {
 	mp_media_t *m = opaque;
+	bool success = mp_media_thread(m);
+
+	mp_demux_free(m);
 
-	if (!mp_media_thread(m)) {
+	if (!success) {
 		if (m->stop_cb) {
 			m->stop_cb(m->opaque);
 		}
@@ -806,6 +893,10 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	media->buffering = info->buffering;
 	media->speed = info->speed;
 	media->is_local_file = info->is_local_file;
+	media->jitter_ns = (int64_t)info->jitter_buffer_ms * 1000000;
+	media->reconnect_delay_ms = info->reconnect_delay_ms > 0
+					    ? info->reconnect_delay_ms
+					    : 1000;
 
 	if (!info->is_local_file || media->speed < 1 || media->speed > 200)
 		media->speed = 100;
@@ -822,7 +913,7 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	}
 
 	if (!base_sys_ts)
-		base_sys_ts = (int64_t)os_gettime_ns();
+		base_sys_ts = (int64_t)obs_get_clock_ns();
 
 	if (!mp_media_init_internal(media, info)) {
 		mp_media_free(media);
@@ -851,6 +942,7 @@ void mp_media_free(mp_media_t *media)
 
 	mp_media_stop(media);
 	mp_kill_thread(media);
+	mp_demux_free(media);
 	mp_decode_free(&media->v);
 	mp_decode_free(&media->a);
 	avformat_close_input(&media->fmt);
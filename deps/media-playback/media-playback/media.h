@@ -18,6 +18,7 @@
 
 #include <obs.h>
 #include "decode.h"
+#include "demux.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -61,9 +62,13 @@ struct mp_media {
 	struct SwsContext *swscale;
 	int scale_linesizes[4];
 	uint8_t *scale_pic[4];
+	bool fast_p010;
 
 	struct mp_decode v;
 	struct mp_decode a;
+	struct mp_demux demux;
+	int64_t jitter_ns;
+	int reconnect_delay_ms;
 	bool is_local_file;
 	bool reconnecting;
 	bool has_video;
@@ -117,6 +122,8 @@ struct mp_media_info {
 	const char *path;
 	const char *format;
 	int buffering;
+	int jitter_buffer_ms;
+	int reconnect_delay_ms;
 	int speed;
 	enum video_range_type force_range;
 	bool hardware_decoding;
@@ -133,6 +140,9 @@ extern void mp_media_play_pause(mp_media_t *media, bool pause);
 extern int64_t mp_get_current_time(mp_media_t *m);
 extern void mp_media_seek_to(mp_media_t *m, int64_t pos);
 
+/* releases the hardware devices shared by all decoders */
+extern void mp_media_free_hw_devices(void);
+
 /* #define DETAILED_DEBUG_INFO */
 
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
@@ -78,11 +78,50 @@ static inline void get_callback_from_table_(lua_State *script, int idx,
 #define get_callback_from_table(script, idx, name, p_reg_idx) \
 	get_callback_from_table_(script, idx, name, p_reg_idx, __FUNCTION__)
 
+/* SWIG finds a type by comparing its name against every type it knows, so
+ * each type name is only looked up once.  all scripts share the same SWIG
+ * module, and the names are string literals, so comparing the pointers is
+ * enough */
+#define SWIG_TYPE_CACHE_SIZE 64
+
+static struct {
+	const char *name;
+	swig_type_info *info;
+} swig_type_cache[SWIG_TYPE_CACHE_SIZE];
+static size_t swig_types_cached = 0;
+static pthread_mutex_t swig_type_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static swig_type_info *get_swig_type(lua_State *script, const char *type)
+{
+	swig_type_info *info = NULL;
+
+	pthread_mutex_lock(&swig_type_mutex);
+
+	for (size_t i = 0; i < swig_types_cached; i++) {
+		if (swig_type_cache[i].name == type) {
+			info = swig_type_cache[i].info;
+			break;
+		}
+	}
+
+	if (!info) {
+		info = SWIG_TypeQuery(script, type);
+		if (info && swig_types_cached < SWIG_TYPE_CACHE_SIZE) {
+			swig_type_cache[swig_types_cached].name = type;
+			swig_type_cache[swig_types_cached].info = info;
+			swig_types_cached++;
+		}
+	}
+
+	pthread_mutex_unlock(&swig_type_mutex);
+	return info;
+}
+
 bool ls_get_libobs_obj_(lua_State *script, const char *type, int lua_idx,
 			void *libobs_out, const char *id, const char *func,
 			int line)
 {
-	swig_type_info *info = SWIG_TypeQuery(script, type);
+	swig_type_info *info = get_swig_type(script, type);
 	if (info == NULL) {
 		warn("%s:%d: SWIG could not find type: %s%s%s", func, line,
 		     id ? id : "", id ? "::" : "", type);
@@ -108,7 +147,7 @@ bool ls_push_libobs_obj_(lua_State *script, const char *type, void *libobs_in,
 			 bool ownership, const char *id, const char *func,
 			 int line)
 {
-	swig_type_info *info = SWIG_TypeQuery(script, type);
+	swig_type_info *info = get_swig_type(script, type);
 	if (info == NULL) {
 		warn("%s:%d: SWIG could not find type: %s%s%s", func, line,
 		     id ? id : "", id ? "::" : "", type);
@@ -63,10 +63,39 @@ struct python_obs_callback *cur_python_cb = NULL;
 
 /* -------------------------------------------- */
 
+/* SWIG finds a type by comparing its name against every type it knows, so
+ * each type name is only looked up once.  the names are string literals, so
+ * comparing the pointers is enough */
+#define SWIG_TYPE_CACHE_SIZE 64
+
+static struct {
+	const char *name;
+	swig_type_info *info;
+} swig_type_cache[SWIG_TYPE_CACHE_SIZE];
+static size_t swig_types_cached = 0;
+
+/* expects python to be locked */
+static swig_type_info *get_swig_type(const char *type)
+{
+	for (size_t i = 0; i < swig_types_cached; i++) {
+		if (swig_type_cache[i].name == type)
+			return swig_type_cache[i].info;
+	}
+
+	swig_type_info *info = SWIG_TypeQuery(type);
+	if (info && swig_types_cached < SWIG_TYPE_CACHE_SIZE) {
+		swig_type_cache[swig_types_cached].name = type;
+		swig_type_cache[swig_types_cached].info = info;
+		swig_types_cached++;
+	}
+
+	return info;
+}
+
 bool py_to_libobs_(const char *type, PyObject *py_in, void *libobs_out,
 		   const char *id, const char *func, int line)
 {
-	swig_type_info *info = SWIG_TypeQuery(type);
+	swig_type_info *info = get_swig_type(type);
 	if (info == NULL) {
 		warn("%s:%d: SWIG could not find type: %s%s%s", func, line,
 		     id ? id : "", id ? "::" : "", type);
@@ -88,7 +117,7 @@ bool libobs_to_py_(const char *type, void *libobs_in, bool ownership,
 		   PyObject **py_out, const char *id, const char *func,
 		   int line)
 {
-	swig_type_info *info = SWIG_TypeQuery(type);
+	swig_type_info *info = get_swig_type(type);
 	if (info == NULL) {
 		warn("%s:%d: SWIG could not find type: %s%s%s", func, line,
 		     id ? id : "", id ? "::" : "", type);
@@ -1488,6 +1517,11 @@ static void python_tick(void *param, float seconds)
 	bool valid;
 	uint64_t ts = obs_get_video_frame_time();
 
+	/* the GIL is taken at most once per frame, and only if there is
+	 * something to call */
+	PyGILState_STATE gstate = PyGILState_UNLOCKED;
+	bool locked = false;
+
 	pthread_mutex_lock(&tick_mutex);
 	valid = !!first_tick_script;
 	pthread_mutex_unlock(&tick_mutex);
@@ -1496,7 +1530,8 @@ static void python_tick(void *param, float seconds)
 	/* process script_tick calls         */
 
 	if (valid) {
-		lock_python();
+		gstate = PyGILState_Ensure();
+		locked = true;
 
 		PyObject *args = Py_BuildValue("(f)", seconds);
 
@@ -1518,8 +1553,6 @@ static void python_tick(void *param, float seconds)
 		pthread_mutex_unlock(&tick_mutex);
 
 		Py_XDECREF(args);
-
-		unlock_python();
 	}
 
 	/* --------------------------------- */
@@ -1537,10 +1570,12 @@ static void python_tick(void *param, float seconds)
 			uint64_t elapsed = ts - timer->last_ts;
 
 			if (elapsed >= timer->interval) {
-				lock_python();
-				timer_call(&cb->base);
-				unlock_python();
+				if (!locked) {
+					gstate = PyGILState_Ensure();
+					locked = true;
+				}
 
+				timer_call(&cb->base);
 				timer->last_ts += timer->interval;
 			}
 		}
@@ -1549,6 +1584,9 @@ static void python_tick(void *param, float seconds)
 	}
 	pthread_mutex_unlock(&timer_mutex);
 
+	if (locked)
+		PyGILState_Release(gstate);
+
 	UNUSED_PARAMETER(param);
 }
 
@@ -1723,6 +1761,7 @@ void obs_python_unload(void)
 	pthread_mutex_destroy(&tick_mutex);
 	pthread_mutex_destroy(&timer_mutex);
 	dstr_free(&cur_py_log_chunk);
+	swig_types_cached = 0;
 
 	python_loaded_at_all = false;
 }
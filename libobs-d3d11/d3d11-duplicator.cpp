@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include "d3d11-subsystem.hpp"
+#include <algorithm>
 #include <unordered_map>
 
 static inline bool get_monitor(gs_device_t *device, int monitor_idx,
@@ -51,6 +52,13 @@ void gs_duplicator::Start()
 	hr = output1->DuplicateOutput(device->device, duplicator.Assign());
 	if (FAILED(hr))
 		throw HRError("Failed to duplicate output", hr);
+
+	DXGI_OUTDUPL_DESC desc;
+	duplicator->GetDesc(&desc);
+	rotation = desc.Rotation;
+
+	/* the texture may have been lost with the device */
+	full_copy = true;
 }
 
 gs_duplicator::gs_duplicator(gs_device_t *device_, int monitor_idx)
@@ -58,7 +66,10 @@ gs_duplicator::gs_duplicator(gs_device_t *device_, int monitor_idx)
 	  texture(nullptr),
 	  idx(monitor_idx),
 	  refs(1),
-	  updated(false)
+	  updated(false),
+	  rotation(DXGI_MODE_ROTATION_IDENTITY),
+	  full_copy(true),
+	  frame_serial(0)
 {
 	Start();
 }
@@ -209,7 +220,73 @@ EXPORT void gs_duplicator_destroy(gs_duplicator_t *duplicator)
 	}
 }
 
-static inline void copy_texture(gs_duplicator_t *d, ID3D11Texture2D *tex)
+static inline void copy_rect(gs_duplicator_t *d, ID3D11Texture2D *tex,
+			     const RECT &rect)
+{
+	const UINT width = d->texture->width;
+	const UINT height = d->texture->height;
+	D3D11_BOX box;
+
+	box.left = (UINT)std::clamp<LONG>(rect.left, 0, width);
+	box.top = (UINT)std::clamp<LONG>(rect.top, 0, height);
+	box.right = (UINT)std::clamp<LONG>(rect.right, 0, width);
+	box.bottom = (UINT)std::clamp<LONG>(rect.bottom, 0, height);
+	box.front = 0;
+	box.back = 1;
+
+	if (box.left >= box.right || box.top >= box.bottom)
+		return;
+
+	d->device->context->CopySubresourceRegion(d->texture->texture, 0,
+						  box.left, box.top, 0, tex, 0,
+						  &box);
+}
+
+/* copies the moved and dirty regions of the frame, in the order the
+ * duplication reports them, returns false if the whole frame has to be
+ * copied instead */
+static bool copy_frame_regions(gs_duplicator_t *d, ID3D11Texture2D *tex,
+			       const DXGI_OUTDUPL_FRAME_INFO &info)
+{
+	UINT move_size = 0;
+	UINT dirty_size = 0;
+	HRESULT hr;
+
+	if (info.TotalMetadataBufferSize == 0)
+		return false;
+	if (d->metadata.size() < info.TotalMetadataBufferSize)
+		d->metadata.resize(info.TotalMetadataBufferSize);
+
+	BYTE *data = d->metadata.data();
+	const UINT size = (UINT)d->metadata.size();
+
+	hr = d->duplicator->GetFrameMoveRects(
+		size, (DXGI_OUTDUPL_MOVE_RECT *)data, &move_size);
+	if (FAILED(hr))
+		return false;
+
+	hr = d->duplicator->GetFrameDirtyRects(
+		size - move_size, (RECT *)(data + move_size), &dirty_size);
+	if (FAILED(hr))
+		return false;
+
+	const DXGI_OUTDUPL_MOVE_RECT *moves = (DXGI_OUTDUPL_MOVE_RECT *)data;
+	const RECT *dirty = (RECT *)(data + move_size);
+	const UINT moves_num = move_size / sizeof(*moves);
+	const UINT dirty_num = dirty_size / sizeof(*dirty);
+
+	/* the acquired image already contains the moved pixels at their
+	 * destinations, so moves are copied like dirty rects */
+	for (UINT i = 0; i < moves_num; i++)
+		copy_rect(d, tex, moves[i].DestinationRect);
+	for (UINT i = 0; i < dirty_num; i++)
+		copy_rect(d, tex, dirty[i]);
+
+	return true;
+}
+
+static inline void copy_texture(gs_duplicator_t *d, ID3D11Texture2D *tex,
+				const DXGI_OUTDUPL_FRAME_INFO &info)
 {
 	D3D11_TEXTURE2D_DESC desc;
 	tex->GetDesc(&desc);
@@ -221,10 +298,24 @@ static inline void copy_texture(gs_duplicator_t *d, ID3D11Texture2D *tex)
 		d->texture = (gs_texture_2d *)gs_texture_create(
 			desc.Width, desc.Height,
 			ConvertDXGITextureFormat(desc.Format), 1, nullptr, 0);
+		d->full_copy = true;
 	}
 
-	if (!!d->texture)
+	if (!d->texture)
+		return;
+
+	/* dirty rects of rotated outputs are in desktop coordinates, those
+	 * frames are copied whole */
+	const bool unrotated =
+		d->rotation == DXGI_MODE_ROTATION_IDENTITY ||
+		d->rotation == DXGI_MODE_ROTATION_UNSPECIFIED;
+
+	if (d->full_copy || !unrotated || !copy_frame_regions(d, tex, info)) {
 		d->device->context->CopyResource(d->texture->texture, tex);
+		d->full_copy = false;
+	}
+
+	d->frame_serial++;
 }
 
 EXPORT bool gs_duplicator_update_frame(gs_duplicator_t *d)
@@ -267,7 +358,9 @@ EXPORT bool gs_duplicator_update_frame(gs_duplicator_t *d)
 		return true;
 	}
 
-	copy_texture(d, tex);
+	/* frames that only update the mouse leave the image unchanged */
+	if (info.LastPresentTime.QuadPart != 0)
+		copy_texture(d, tex, info);
 	d->duplicator->ReleaseFrame();
 	d->updated = true;
 	return true;
@@ -277,4 +370,9 @@ EXPORT gs_texture_t *gs_duplicator_get_texture(gs_duplicator_t *duplicator)
 {
 	return duplicator->texture;
 }
+
+EXPORT uint64_t gs_duplicator_get_frame_serial(gs_duplicator_t *duplicator)
+{
+	return duplicator->frame_serial;
+}
 }
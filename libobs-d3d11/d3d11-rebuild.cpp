@@ -184,6 +184,18 @@ void gs_texture_2d::RebuildNV12_UV(ID3D11Device *dev)
 		InitRenderTargets();
 }
 
+void gs_upload_context::Rebuild(ID3D11Device *dev)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	/* uploads fail, and are made on the graphics thread instead, if the
+	 * new device cannot create a deferred context */
+	HRESULT hr = dev->CreateDeferredContext(0, context.Assign());
+	if (FAILED(hr))
+		blog(LOG_WARNING, "Failed to rebuild upload context (%08lX)",
+		     hr);
+}
+
 void gs_zstencil_buffer::Rebuild(ID3D11Device *dev)
 {
 	HRESULT hr;
@@ -232,6 +244,8 @@ void gs_vertex_shader::Rebuild(ID3D11Device *dev)
 			throw HRError("Failed to create constant buffer", hr);
 	}
 
+	constantsDirty = true;
+
 	for (gs_shader_param &param : params) {
 		param.nextSampler = nullptr;
 		param.curValue.clear();
@@ -253,6 +267,8 @@ void gs_pixel_shader::Rebuild(ID3D11Device *dev)
 			throw HRError("Failed to create constant buffer", hr);
 	}
 
+	constantsDirty = true;
+
 	for (gs_shader_param &param : params) {
 		param.nextSampler = nullptr;
 		param.curValue.clear();
@@ -456,6 +472,9 @@ try {
 		case gs_type::gs_texture_3d:
 			((gs_texture_3d *)obj)->Release();
 			break;
+		case gs_type::gs_upload_context:
+			((gs_upload_context *)obj)->Release();
+			break;
 		}
 
 		obj = obj->next;
@@ -542,6 +561,9 @@ try {
 		case gs_type::gs_texture_3d:
 			((gs_texture_3d *)obj)->Rebuild(dev);
 			break;
+		case gs_type::gs_upload_context:
+			((gs_upload_context *)obj)->Rebuild(dev);
+			break;
 		}
 
 		obj = obj->next;
@@ -137,6 +137,10 @@ void gs_shader::BuildConstantBuffer()
 		gs_shader_param &param = params[i];
 		size_t size = 0;
 
+		param.shader = this;
+		if (param.type == GS_SHADER_PARAM_TEXTURE)
+			textureParams.push_back(i);
+
 		switch (param.type) {
 		case GS_SHADER_PARAM_BOOL:
 		case GS_SHADER_PARAM_INT:
@@ -196,10 +200,31 @@ void gs_shader::BuildConstantBuffer()
 			throw HRError("Failed to create constant buffer", hr);
 	}
 
+	constData.reserve(constantSize);
+
 	for (size_t i = 0; i < params.size(); i++)
 		gs_shader_set_default(&params[i]);
 }
 
+bool gs_shader::LoadCachedShader(const char *tag, uint64_t hash,
+				 ID3D10Blob **shader)
+{
+	void *cached;
+	size_t size;
+
+	if (!device->d3dCreateBlob)
+		return false;
+	if (!gs_shader_cache_load(tag, hash, &cached, &size))
+		return false;
+
+	HRESULT hr = device->d3dCreateBlob(size, shader);
+	if (SUCCEEDED(hr))
+		memcpy((*shader)->GetBufferPointer(), cached, size);
+
+	bfree(cached);
+	return SUCCEEDED(hr);
+}
+
 void gs_shader::Compile(const char *shaderString, const char *file,
 			const char *target, ID3D10Blob **shader)
 {
@@ -209,10 +234,19 @@ void gs_shader::Compile(const char *shaderString, const char *file,
 	if (!shaderString)
 		throw "No shader string specified";
 
-	hr = device->d3dCompile(shaderString, strlen(shaderString), file, NULL,
-				NULL, "main", target,
-				D3D10_SHADER_OPTIMIZATION_LEVEL1, 0, shader,
-				errorsBlob.Assign());
+	/* bytecode only depends on the compiler, so that is all the key
+	 * needs besides the source and target */
+	const size_t len = strlen(shaderString);
+	const uint64_t hash = gs_shader_cache_hash(0, shaderString, len);
+	string tag = "d3d11 " + device->d3dCompilerName + " " + target +
+		     " " + to_string(D3D10_SHADER_OPTIMIZATION_LEVEL1);
+
+	if (LoadCachedShader(tag.c_str(), hash, shader))
+		return;
+
+	hr = device->d3dCompile(shaderString, len, file, NULL, NULL, "main",
+				target, D3D10_SHADER_OPTIMIZATION_LEVEL1, 0,
+				shader, errorsBlob.Assign());
 	if (FAILED(hr)) {
 		if (errorsBlob != NULL && errorsBlob->GetBufferSize())
 			throw ShaderError(errorsBlob, hr);
@@ -220,6 +254,9 @@ void gs_shader::Compile(const char *shaderString, const char *file,
 			throw HRError("Failed to compile shader", hr);
 	}
 
+	gs_shader_cache_store(tag.c_str(), hash, (*shader)->GetBufferPointer(),
+			      (*shader)->GetBufferSize());
+
 #ifdef DISASSEMBLE_SHADERS
 	ComPtr<ID3D10Blob> asmBlob;
 
@@ -238,63 +275,63 @@ void gs_shader::Compile(const char *shaderString, const char *file,
 #endif
 }
 
-inline void gs_shader::UpdateParam(vector<uint8_t> &constData,
-				   gs_shader_param &param, bool &upload)
+inline void gs_shader::UpdateParam(gs_shader_param &param)
 {
-	if (param.type != GS_SHADER_PARAM_TEXTURE) {
-		if (!param.curValue.size())
-			throw "Not all shader parameters were set";
+	if (!param.curValue.size())
+		throw "Not all shader parameters were set";
 
-		/* padding in case the constant needs to start at a new
-		 * register */
-		if (param.pos > constData.size()) {
-			uint8_t zero = 0;
+	/* padding in case the constant needs to start at a new register */
+	if (param.pos > constData.size()) {
+		uint8_t zero = 0;
 
-			constData.insert(constData.end(),
-					 param.pos - constData.size(), zero);
-		}
+		constData.insert(constData.end(), param.pos - constData.size(),
+				 zero);
+	}
 
-		constData.insert(constData.end(), param.curValue.begin(),
-				 param.curValue.end());
+	constData.insert(constData.end(), param.curValue.begin(),
+			 param.curValue.end());
+}
 
-		if (param.changed) {
-			upload = true;
-			param.changed = false;
-		}
+inline void gs_shader::LoadTextureParam(gs_shader_param &param)
+{
+	if (param.curValue.size() != sizeof(struct gs_shader_texture))
+		return;
 
-	} else if (param.curValue.size() == sizeof(struct gs_shader_texture)) {
-		struct gs_shader_texture shader_tex;
-		memcpy(&shader_tex, param.curValue.data(), sizeof(shader_tex));
-		if (shader_tex.srgb)
-			device_load_texture_srgb(device, shader_tex.tex,
-						 param.textureID);
-		else
-			device_load_texture(device, shader_tex.tex,
-					    param.textureID);
-
-		if (param.nextSampler) {
-			ID3D11SamplerState *state = param.nextSampler->state;
-			device->context->PSSetSamplers(param.textureID, 1,
-						       &state);
-			param.nextSampler = nullptr;
-		}
+	struct gs_shader_texture shader_tex;
+	memcpy(&shader_tex, param.curValue.data(), sizeof(shader_tex));
+	if (shader_tex.srgb)
+		device_load_texture_srgb(device, shader_tex.tex,
+					 param.textureID);
+	else
+		device_load_texture(device, shader_tex.tex, param.textureID);
+
+	if (param.nextSampler) {
+		ID3D11SamplerState *state = param.nextSampler->state;
+		device->context->PSSetSamplers(param.textureID, 1, &state);
+		param.nextSampler = nullptr;
 	}
 }
 
 void gs_shader::UploadParams()
 {
-	vector<uint8_t> constData;
-	bool upload = false;
+	for (size_t idx : textureParams)
+		LoadTextureParam(params[idx]);
 
-	constData.reserve(constantSize);
+	/* identical consecutive draws leave the constant buffer alone */
+	if (!constantsDirty)
+		return;
 
-	for (size_t i = 0; i < params.size(); i++)
-		UpdateParam(constData, params[i], upload);
+	constData.clear();
+
+	for (gs_shader_param &param : params) {
+		if (param.type != GS_SHADER_PARAM_TEXTURE)
+			UpdateParam(param);
+	}
 
 	if (constData.size() != constantSize)
 		throw "Invalid constant data size given to shader";
 
-	if (upload) {
+	if (constantSize) {
 		D3D11_MAPPED_SUBRESOURCE map;
 		HRESULT hr;
 
@@ -306,6 +343,8 @@ void gs_shader::UploadParams()
 		memcpy(map.pData, constData.data(), constData.size());
 		device->context->Unmap(constants, 0);
 	}
+
+	constantsDirty = false;
 }
 
 void gs_shader_destroy(gs_shader_t *shader)
@@ -375,7 +414,8 @@ static inline void shader_setval_inline(gs_shader_param *param,
 
 	if (size_changed || memcmp(param->curValue.data(), data, size) != 0) {
 		memcpy(param->curValue.data(), data, size);
-		param->changed = true;
+		if (param->type != GS_SHADER_PARAM_TEXTURE && param->shader)
+			param->shader->constantsDirty = true;
 	}
 }
 
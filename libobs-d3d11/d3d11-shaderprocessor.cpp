@@ -156,8 +156,7 @@ gs_shader_param::gs_shader_param(shader_var &var, uint32_t &texCounter)
 	: name(var.name),
 	  type(get_shader_param_type(var.type)),
 	  textureID(texCounter),
-	  arrayCount(var.array_count),
-	  changed(false)
+	  arrayCount(var.array_count)
 {
 	defaultValue.resize(var.default_val.num);
 	memcpy(defaultValue.data(), var.default_val.array, var.default_val.num);
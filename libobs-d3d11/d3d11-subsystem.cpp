@@ -73,7 +73,21 @@ gs_obj::~gs_obj()
 		next->prev_next = prev_next;
 }
 
-static inline void make_swap_desc(DXGI_SWAP_CHAIN_DESC &desc,
+static inline bool flip_format_supported(DXGI_FORMAT format)
+{
+	switch (format) {
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static inline void make_swap_desc(gs_device *device,
+				  DXGI_SWAP_CHAIN_DESC &desc,
 				  const gs_init_data *data)
 {
 	memset(&desc, 0, sizeof(desc));
@@ -85,6 +99,18 @@ static inline void make_swap_desc(DXGI_SWAP_CHAIN_DESC &desc,
 	desc.OutputWindow = (HWND)data->window.hwnd;
 	desc.SampleDesc.Count = 1;
 	desc.Windowed = true;
+
+	/* flip model keeps presents of a display from stalling the graphics
+	 * thread behind the compositor, and needs at least two buffers */
+	if (device->flipSupported &&
+	    flip_format_supported(desc.BufferDesc.Format)) {
+		if (desc.BufferCount < 2)
+			desc.BufferCount = 2;
+		desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+		desc.Flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+		if (device->tearingSupported)
+			desc.Flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+	}
 }
 
 void gs_swap_chain::InitTarget(uint32_t cx, uint32_t cy)
@@ -154,7 +180,8 @@ void gs_swap_chain::Resize(uint32_t cx, uint32_t cy)
 			cy = clientRect.bottom;
 	}
 
-	hr = swap->ResizeBuffers(numBuffers, cx, cy, DXGI_FORMAT_UNKNOWN, 0);
+	hr = swap->ResizeBuffers(swapDesc.BufferCount, cx, cy,
+				 DXGI_FORMAT_UNKNOWN, swapDesc.Flags);
 	if (FAILED(hr))
 		throw HRError("Failed to resize swap buffers", hr);
 
@@ -162,8 +189,24 @@ void gs_swap_chain::Resize(uint32_t cx, uint32_t cy)
 	InitZStencilBuffer(cx, cy);
 }
 
+void gs_swap_chain::InitFrameLatency()
+{
+	if (!(swapDesc.Flags &
+	      DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT))
+		return;
+
+	ComQIPtr<IDXGISwapChain2> swap2(swap);
+	if (!swap2)
+		return;
+
+	swap2->SetMaximumFrameLatency(1);
+	frameLatencyWaitable = swap2->GetFrameLatencyWaitableObject();
+}
+
 void gs_swap_chain::Init()
 {
+	InitFrameLatency();
+
 	target.device = device;
 	target.isRenderTarget = true;
 	target.format = initData.format;
@@ -188,9 +231,19 @@ gs_swap_chain::gs_swap_chain(gs_device *device, const gs_init_data *data)
 {
 	HRESULT hr;
 
-	make_swap_desc(swapDesc, data);
+	make_swap_desc(device, swapDesc, data);
 	hr = device->factory->CreateSwapChain(device->device, &swapDesc,
 					      swap.Assign());
+	if (FAILED(hr) && IsFlipModel()) {
+		blog(LOG_WARNING, "Failed to create flip model swap chain "
+				  "(0x%08lX), falling back to blt model",
+		     hr);
+		swapDesc.BufferCount = data->num_backbuffers;
+		swapDesc.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+		swapDesc.Flags = 0;
+		hr = device->factory->CreateSwapChain(device->device, &swapDesc,
+						      swap.Assign());
+	}
 	if (FAILED(hr))
 		throw HRError("Failed to create swap chain", hr);
 
@@ -212,12 +265,15 @@ void gs_device::InitCompiler()
 		if (module) {
 			d3dCompile = (pD3DCompile)GetProcAddress(module,
 								 "D3DCompile");
+			d3dCreateBlob = (pD3DCreateBlobFunc)GetProcAddress(
+				module, "D3DCreateBlob");
 
 #ifdef DISASSEMBLE_SHADERS
 			d3dDisassemble = (pD3DDisassemble)GetProcAddress(
 				module, "D3DDisassemble");
 #endif
 			if (d3dCompile) {
+				d3dCompilerName = d3dcompiler;
 				return;
 			}
 
@@ -245,6 +301,18 @@ void gs_device::InitFactory(uint32_t adapterIdx)
 	hr = factory->EnumAdapters1(adapterIdx, &adapter);
 	if (FAILED(hr))
 		throw UnsupportedHWError("Failed to enumerate DXGIAdapter", hr);
+
+	/* flip model for child windows needs Windows 10 */
+	ComQIPtr<IDXGIFactory5> factory5(factory);
+	if (GetWinVer() >= 0xA00 && factory5) {
+		BOOL tearing = FALSE;
+
+		flipSupported = true;
+		hr = factory5->CheckFeatureSupport(
+			DXGI_FEATURE_PRESENT_ALLOW_TEARING, &tearing,
+			sizeof(tearing));
+		tearingSupported = SUCCEEDED(hr) && tearing;
+	}
 }
 
 const static D3D_FEATURE_LEVEL featureLevels[] = {
@@ -1790,6 +1858,16 @@ void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
 
 		device->CopyTex(dst->texture, 0, 0, src, 0, 0, 0, 0);
 
+		/* event query lets the caller poll for copy completion
+		 * instead of stalling in Map */
+		if (!dst->query) {
+			D3D11_QUERY_DESC qd = {};
+			qd.Query = D3D11_QUERY_EVENT;
+			device->device->CreateQuery(&qd, dst->query.Assign());
+		}
+		if (dst->query)
+			device->context->End(dst->query);
+
 	} catch (const char *error) {
 		blog(LOG_ERROR, "device_copy_texture (D3D11): %s", error);
 	}
@@ -1927,11 +2005,21 @@ void device_present(gs_device_t *device)
 	HRESULT hr;
 
 	if (device->curSwapChain) {
-		hr = device->curSwapChain->swap->Present(0, 0);
+		gs_swap_chain *swap = device->curSwapChain;
+		UINT flags = (swap->swapDesc.Flags &
+			      DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING)
+				     ? DXGI_PRESENT_ALLOW_TEARING
+				     : 0;
+
+		hr = swap->swap->Present(0, flags);
 		if (hr == DXGI_ERROR_DEVICE_REMOVED ||
 		    hr == DXGI_ERROR_DEVICE_RESET) {
 			device->RebuildDevice();
 		}
+
+		/* flip model unbinds the back buffer on present */
+		if (swap->IsFlipModel())
+			device->curFramebufferInvalidate = true;
 	} else {
 		blog(LOG_WARNING, "device_present (D3D11): No active swap");
 	}
@@ -2387,6 +2475,25 @@ void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 	stagesurf->device->context->Unmap(stagesurf->texture, 0);
 }
 
+bool gs_swapchain_ready(gs_swapchain_t *swapchain)
+{
+	if (!swapchain->frameLatencyWaitable)
+		return true;
+
+	return WaitForSingleObject(swapchain->frameLatencyWaitable, 0) ==
+	       WAIT_OBJECT_0;
+}
+
+bool gs_stagesurface_ready(gs_stagesurf_t *stagesurf)
+{
+	if (!stagesurf->query)
+		return false;
+
+	HRESULT hr = stagesurf->device->context->GetData(
+		stagesurf->query, nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH);
+	return hr == S_OK;
+}
+
 void gs_zstencil_destroy(gs_zstencil_t *zstencil)
 {
 	delete zstencil;
@@ -2586,6 +2693,22 @@ bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
 	return succeeded;
 }
 
+bool gs_timer_ready(gs_timer_t *timer)
+{
+	/* timestamps complete in order, so the end implies the begin */
+	HRESULT hr = timer->device->context->GetData(
+		timer->query_end, nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH);
+	return hr == S_OK;
+}
+
+bool gs_timer_range_ready(gs_timer_range_t *range)
+{
+	HRESULT hr = range->device->context->GetData(
+		range->query_disjoint, nullptr, 0,
+		D3D11_ASYNC_GETDATA_DONOTFLUSH);
+	return hr == S_OK;
+}
+
 gs_timer::gs_timer(gs_device_t *device) : gs_obj(device, gs_type::gs_timer)
 {
 	Rebuild(device->device);
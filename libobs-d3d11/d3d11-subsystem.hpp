@@ -23,10 +23,12 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
 
 #include <windows.h>
 #include <dxgi.h>
 #include <dxgi1_2.h>
+#include <dxgi1_5.h>
 #include <d3d11_1.h>
 #include <d3dcompiler.h>
 
@@ -106,6 +108,8 @@ static inline DXGI_FORMAT ConvertGSTextureFormatResource(gs_color_format format)
 		return DXGI_FORMAT_B8G8R8X8_UNORM;
 	case GS_BGRA_UNORM:
 		return DXGI_FORMAT_B8G8R8A8_UNORM;
+	case GS_RG16:
+		return DXGI_FORMAT_R16G16_UNORM;
 	}
 
 	return DXGI_FORMAT_UNKNOWN;
@@ -161,6 +165,8 @@ static inline gs_color_format ConvertDXGITextureFormat(DXGI_FORMAT format)
 		return GS_RGBA16;
 	case DXGI_FORMAT_R16_UNORM:
 		return GS_R16;
+	case DXGI_FORMAT_R16G16_UNORM:
+		return GS_RG16;
 	case DXGI_FORMAT_R16G16B16A16_FLOAT:
 		return GS_RGBA16F;
 	case DXGI_FORMAT_R32G32B32A32_FLOAT:
@@ -336,6 +342,7 @@ enum class gs_type {
 	gs_timer,
 	gs_timer_range,
 	gs_texture_3d,
+	gs_upload_context,
 };
 
 struct gs_obj {
@@ -621,6 +628,7 @@ struct gs_zstencil_buffer : gs_obj {
 
 struct gs_stage_surface : gs_obj {
 	ComPtr<ID3D11Texture2D> texture;
+	ComPtr<ID3D11Query> query;
 	D3D11_TEXTURE2D_DESC td = {};
 
 	uint32_t width, height;
@@ -629,7 +637,11 @@ struct gs_stage_surface : gs_obj {
 
 	void Rebuild(ID3D11Device *dev);
 
-	inline void Release() { texture.Release(); }
+	inline void Release()
+	{
+		texture.Release();
+		query.Release();
+	}
 
 	gs_stage_surface(gs_device_t *device, uint32_t width, uint32_t height,
 			 gs_color_format colorFormat);
@@ -661,7 +673,7 @@ struct gs_shader_param {
 
 	vector<uint8_t> curValue;
 	vector<uint8_t> defaultValue;
-	bool changed;
+	gs_shader_t *shader = nullptr;
 
 	gs_shader_param(shader_var &var, uint32_t &texCounter);
 };
@@ -682,14 +694,22 @@ struct gs_shader : gs_obj {
 	ComPtr<ID3D11Buffer> constants;
 	size_t constantSize;
 
+	/* packed copy of the constant buffer, only rebuilt and uploaded
+	 * after a parameter value actually changed */
+	vector<uint8_t> constData;
+	vector<size_t> textureParams;
+	bool constantsDirty = true;
+
 	D3D11_BUFFER_DESC bd = {};
 	vector<uint8_t> data;
 
-	inline void UpdateParam(vector<uint8_t> &constData,
-				gs_shader_param &param, bool &upload);
+	inline void UpdateParam(gs_shader_param &param);
+	inline void LoadTextureParam(gs_shader_param &param);
 	void UploadParams();
 
 	void BuildConstantBuffer();
+	bool LoadCachedShader(const char *tag, uint64_t hash,
+			      ID3D10Blob **shader);
 	void Compile(const char *shaderStr, const char *file,
 		     const char *target, ID3D10Blob **shader);
 
@@ -761,6 +781,13 @@ struct gs_duplicator : gs_obj {
 	long refs;
 	bool updated;
 
+	/* dirty and move rects of the acquired frame are only copied once the
+	 * texture holds a complete image of an unrotated output */
+	DXGI_MODE_ROTATION rotation;
+	bool full_copy;
+	std::vector<BYTE> metadata;
+	uint64_t frame_serial;
+
 	void Start();
 
 	inline void Release() { duplicator.Release(); }
@@ -769,6 +796,27 @@ struct gs_duplicator : gs_obj {
 	~gs_duplicator();
 };
 
+/* deferred context recording texture uploads on another thread, the
+ * recorded command list is executed on the immediate context */
+struct gs_upload_context : gs_obj {
+	ComPtr<ID3D11DeviceContext> context;
+	ComPtr<ID3D11CommandList> commands;
+	std::mutex mutex;
+	bool recorded = false;
+
+	void Rebuild(ID3D11Device *dev);
+
+	inline void Release()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		commands.Release();
+		context.Release();
+		recorded = false;
+	}
+
+	gs_upload_context(gs_device_t *device);
+};
+
 struct gs_pixel_shader : gs_shader {
 	ComPtr<ID3D11PixelShader> shader;
 	vector<unique_ptr<ShaderSampler>> samplers;
@@ -800,25 +848,45 @@ struct gs_swap_chain : gs_obj {
 	gs_init_data initData;
 	DXGI_SWAP_CHAIN_DESC swapDesc = {};
 
+	/* flip model swap chains signal this once they can take another
+	 * frame without Present blocking */
+	HANDLE frameLatencyWaitable = nullptr;
+
 	gs_texture_2d target;
 	gs_zstencil_buffer zs;
 	ComPtr<IDXGISwapChain> swap;
 
 	void InitTarget(uint32_t cx, uint32_t cy);
 	void InitZStencilBuffer(uint32_t cx, uint32_t cy);
+	void InitFrameLatency();
 	void Resize(uint32_t cx, uint32_t cy);
 	void Init();
 
 	void Rebuild(ID3D11Device *dev);
 
+	inline bool IsFlipModel() const
+	{
+		return swapDesc.SwapEffect == DXGI_SWAP_EFFECT_FLIP_DISCARD;
+	}
+
 	inline void Release()
 	{
+		if (frameLatencyWaitable) {
+			CloseHandle(frameLatencyWaitable);
+			frameLatencyWaitable = nullptr;
+		}
+
 		target.Release();
 		zs.Release();
 		swap.Release();
 	}
 
 	gs_swap_chain(gs_device *device, const gs_init_data *data);
+	inline ~gs_swap_chain()
+	{
+		if (frameLatencyWaitable)
+			CloseHandle(frameLatencyWaitable);
+	}
 };
 
 struct BlendState {
@@ -949,6 +1017,8 @@ struct mat4float {
 	float mat[16];
 };
 
+typedef HRESULT(WINAPI *pD3DCreateBlobFunc)(SIZE_T size, ID3D10Blob **blob);
+
 struct gs_device {
 	ComPtr<IDXGIFactory1> factory;
 	ComPtr<IDXGIAdapter1> adapter;
@@ -956,6 +1026,8 @@ struct gs_device {
 	ComPtr<ID3D11DeviceContext> context;
 	uint32_t adpIdx = 0;
 	bool nv12Supported = false;
+	bool flipSupported = false;
+	bool tearingSupported = false;
 
 	gs_texture_2d *curRenderTarget = nullptr;
 	gs_zstencil_buffer *curZStencilBuffer = nullptr;
@@ -988,6 +1060,8 @@ struct gs_device {
 	D3D11_PRIMITIVE_TOPOLOGY curToplogy;
 
 	pD3DCompile d3dCompile = nullptr;
+	pD3DCreateBlobFunc d3dCreateBlob = nullptr;
+	string d3dCompilerName;
 #ifdef DISASSEMBLE_SHADERS
 	pD3DDisassemble d3dDisassemble = nullptr;
 #endif
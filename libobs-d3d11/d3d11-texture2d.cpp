@@ -31,6 +31,10 @@ void gs_texture_2d::InitSRD(vector<D3D11_SUBRESOURCE_DATA> &srd)
 
 	rowSizeBytes /= 8;
 
+	/* the rows of compressed formats are rows of 4x4 blocks */
+	if (gs_is_compressed_format(format))
+		rowSizeBytes *= 4;
+
 	for (size_t i = 0; i < textures; i++) {
 		uint32_t newRowSize = rowSizeBytes;
 		uint32_t newTexSize = texSizeBytes;
@@ -0,0 +1,112 @@
+#include "d3d11-subsystem.hpp"
+
+gs_upload_context::gs_upload_context(gs_device_t *device)
+	: gs_obj(device, gs_type::gs_upload_context)
+{
+	HRESULT hr = device->device->CreateDeferredContext(0, context.Assign());
+	if (FAILED(hr))
+		throw HRError("Failed to create deferred context", hr);
+}
+
+extern "C" {
+
+EXPORT gs_upload_context_t *device_upload_context_create(gs_device_t *device)
+{
+	try {
+		return new gs_upload_context(device);
+
+	} catch (const HRError &error) {
+		blog(LOG_DEBUG, "device_upload_context_create: %s (%08lX)",
+		     error.str, error.hr);
+		return nullptr;
+	}
+}
+
+EXPORT void gs_upload_context_destroy(gs_upload_context_t *context)
+{
+	delete context;
+}
+
+static void copy_rows(uint8_t *ptr, uint32_t linesize_out, const uint8_t *data,
+		      uint32_t linesize, uint32_t height)
+{
+	const uint32_t row_copy = (linesize < linesize_out) ? linesize
+							    : linesize_out;
+
+	if (linesize == linesize_out) {
+		memcpy(ptr, data, (size_t)row_copy * height);
+		return;
+	}
+
+	for (uint32_t y = 0; y < height; y++) {
+		memcpy(ptr, data, row_copy);
+		ptr += linesize_out;
+		data += linesize;
+	}
+}
+
+EXPORT bool gs_upload_context_set_image(gs_upload_context_t *context,
+					gs_texture_t *tex, const uint8_t *data,
+					uint32_t linesize)
+{
+	if (tex->type != GS_TEXTURE_2D)
+		return false;
+
+	gs_texture_2d *tex2d = static_cast<gs_texture_2d *>(tex);
+	if (!tex2d->isDynamic)
+		return false;
+
+	std::lock_guard<std::mutex> lock(context->mutex);
+	if (!context->context || !tex2d->texture)
+		return false;
+
+	D3D11_MAPPED_SUBRESOURCE map;
+	HRESULT hr = context->context->Map(tex2d->texture, 0,
+					   D3D11_MAP_WRITE_DISCARD, 0, &map);
+	if (FAILED(hr))
+		return false;
+
+	copy_rows((uint8_t *)map.pData, map.RowPitch, data, linesize,
+		  tex2d->height);
+
+	context->context->Unmap(tex2d->texture, 0);
+	context->recorded = true;
+	return true;
+}
+
+EXPORT bool gs_upload_context_finish(gs_upload_context_t *context)
+{
+	ComPtr<ID3D11CommandList> commands;
+
+	std::lock_guard<std::mutex> lock(context->mutex);
+	if (!context->context || !context->recorded)
+		return false;
+
+	context->recorded = false;
+
+	HRESULT hr = context->context->FinishCommandList(FALSE,
+							 commands.Assign());
+	if (FAILED(hr))
+		return false;
+
+	/* every upload covers whole textures, so a newer list that was never
+	 * executed makes the older one redundant */
+	context->commands = commands;
+	return true;
+}
+
+EXPORT void gs_upload_context_submit(gs_upload_context_t *context)
+{
+	ComPtr<ID3D11CommandList> commands;
+
+	{
+		std::lock_guard<std::mutex> lock(context->mutex);
+		commands = context->commands;
+		context->commands.Release();
+	}
+
+	/* restore the state, the device caches what it last set */
+	if (commands)
+		context->device->context->ExecuteCommandList(commands, TRUE);
+}
+}
@@ -19,6 +19,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <glad/glad_egl.h>
 
@@ -136,6 +137,7 @@ static inline enum gs_color_format gs_format_to_drm_format(uint32_t drm_format)
 	case GS_R16F:
 	case GS_RGBA16:
 	case GS_RG16F:
+	case GS_RG16:
 	case GS_R32F:
 	case GS_RG32F:
 	case GS_RGBA32F:
@@ -285,6 +287,65 @@ gl_egl_create_dmabuf_image(EGLDisplay egl_display, unsigned int width,
 	return texture;
 }
 
+static bool dmabuf_modifiers_supported(EGLDisplay egl_display)
+{
+	const char *extensions = eglQueryString(egl_display, EGL_EXTENSIONS);
+
+	return extensions &&
+	       strstr(extensions, "EGL_EXT_image_dma_buf_import_modifiers") &&
+	       eglQueryDmaBufModifiersEXT;
+}
+
+bool gl_egl_query_dmabuf_modifiers(EGLDisplay egl_display,
+				   enum gs_color_format color_format,
+				   uint64_t **modifiers, size_t *n_modifiers)
+{
+	EGLuint64KHR *egl_modifiers;
+	EGLBoolean *external_only;
+	uint32_t drm_format;
+	size_t count = 0;
+	EGLint n;
+
+	drm_format = gs_format_to_drm_format(color_format);
+	if (drm_format == DRM_FORMAT_INVALID ||
+	    !dmabuf_modifiers_supported(egl_display))
+		return false;
+
+	if (!eglQueryDmaBufModifiersEXT(egl_display, drm_format, 0, NULL, NULL,
+					&n)) {
+		blog(LOG_ERROR, "Cannot query the number of modifiers: %s",
+		     gl_egl_error_to_string(eglGetError()));
+		return false;
+	}
+
+	if (n <= 0)
+		return true;
+
+	egl_modifiers = bmalloc(n * sizeof(EGLuint64KHR));
+	external_only = bmalloc(n * sizeof(EGLBoolean));
+
+	if (!eglQueryDmaBufModifiersEXT(egl_display, drm_format, n,
+					egl_modifiers, external_only, &n)) {
+		blog(LOG_ERROR, "Cannot query modifiers: %s",
+		     gl_egl_error_to_string(eglGetError()));
+		bfree(egl_modifiers);
+		bfree(external_only);
+		return false;
+	}
+
+	/* external-only modifiers can't be bound to GL_TEXTURE_2D */
+	for (EGLint i = 0; i < n; i++) {
+		if (!external_only[i])
+			egl_modifiers[count++] = egl_modifiers[i];
+	}
+
+	bfree(external_only);
+
+	*modifiers = (uint64_t *)egl_modifiers;
+	*n_modifiers = count;
+	return true;
+}
+
 const char *gl_egl_error_to_string(EGLint error_number)
 {
 	switch (error_number) {
@@ -134,3 +134,15 @@ extern struct gs_texture *device_texture_create_from_dmabuf(
 		device, width, height, color_format, n_planes, fds, strides,
 		offsets, modifiers);
 }
+
+extern bool device_query_dmabuf_modifiers(gs_device_t *device,
+					  enum gs_color_format color_format,
+					  uint64_t **modifiers,
+					  size_t *n_modifiers)
+{
+	if (!gl_vtable->device_query_dmabuf_modifiers)
+		return false;
+
+	return gl_vtable->device_query_dmabuf_modifiers(
+		device, color_format, modifiers, n_modifiers);
+}
@@ -59,4 +59,9 @@ struct gl_winsys_vtable {
 		enum gs_color_format color_format, uint32_t n_planes,
 		const int *fds, const uint32_t *strides,
 		const uint32_t *offsets, const uint64_t *modifiers);
+
+	bool (*device_query_dmabuf_modifiers)(gs_device_t *device,
+					      enum gs_color_format color_format,
+					      uint64_t **modifiers,
+					      size_t *n_modifiers);
 };
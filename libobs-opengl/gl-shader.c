@@ -78,10 +78,10 @@ static bool gl_add_param(struct gs_shader *shader, struct shader_var *var,
 	if (param.type == GS_SHADER_PARAM_TEXTURE) {
 		param.sampler_id = var->gl_sampler_id;
 		param.texture_id = (*texture_id)++;
-	} else {
-		param.changed = true;
 	}
 
+	param.generation = 1;
+
 	da_move(param.def_value, var->default_val);
 	da_copy(param.cur_value, param.def_value);
 
@@ -201,6 +201,9 @@ static bool gl_shader_init(struct gs_shader *shader,
 	if (!gl_success("glCreateShader") || !shader->obj)
 		return false;
 
+	shader->source_hash = gs_shader_cache_hash(0, glsp->gl_string.array,
+						   glsp->gl_string.len);
+
 	glShaderSource(shader->obj, 1, (const GLchar **)&glsp->gl_string.array,
 		       0);
 	if (!gl_success("glShaderSource"))
@@ -393,20 +396,31 @@ void gs_shader_get_param_info(const gs_sparam_t *param,
 	info->name = param->name;
 }
 
+static inline void shader_setval_inline(gs_sparam_t *param, const void *data,
+					size_t size)
+{
+	if (param->cur_value.num == size &&
+	    memcmp(param->cur_value.array, data, size) == 0)
+		return;
+
+	da_copy_array(param->cur_value, data, size);
+	param->generation++;
+}
+
 void gs_shader_set_bool(gs_sparam_t *param, bool val)
 {
 	int int_val = val;
-	da_copy_array(param->cur_value, &int_val, sizeof(int_val));
+	shader_setval_inline(param, &int_val, sizeof(int_val));
 }
 
 void gs_shader_set_float(gs_sparam_t *param, float val)
 {
-	da_copy_array(param->cur_value, &val, sizeof(val));
+	shader_setval_inline(param, &val, sizeof(val));
 }
 
 void gs_shader_set_int(gs_sparam_t *param, int val)
 {
-	da_copy_array(param->cur_value, &val, sizeof(val));
+	shader_setval_inline(param, &val, sizeof(val));
 }
 
 void gs_shader_set_matrix3(gs_sparam_t *param, const struct matrix3 *val)
@@ -414,27 +428,27 @@ void gs_shader_set_matrix3(gs_sparam_t *param, const struct matrix3 *val)
 	struct matrix4 mat;
 	matrix4_from_matrix3(&mat, val);
 
-	da_copy_array(param->cur_value, &mat, sizeof(mat));
+	shader_setval_inline(param, &mat, sizeof(mat));
 }
 
 void gs_shader_set_matrix4(gs_sparam_t *param, const struct matrix4 *val)
 {
-	da_copy_array(param->cur_value, val, sizeof(*val));
+	shader_setval_inline(param, val, sizeof(*val));
 }
 
 void gs_shader_set_vec2(gs_sparam_t *param, const struct vec2 *val)
 {
-	da_copy_array(param->cur_value, val->ptr, sizeof(*val));
+	shader_setval_inline(param, val->ptr, sizeof(*val));
 }
 
 void gs_shader_set_vec3(gs_sparam_t *param, const struct vec3 *val)
 {
-	da_copy_array(param->cur_value, val->ptr, sizeof(*val));
+	shader_setval_inline(param, val->ptr, sizeof(*val));
 }
 
 void gs_shader_set_vec4(gs_sparam_t *param, const struct vec4 *val)
 {
-	da_copy_array(param->cur_value, val->ptr, sizeof(*val));
+	shader_setval_inline(param, val->ptr, sizeof(*val));
 }
 
 void gs_shader_set_texture(gs_sparam_t *param, gs_texture_t *val)
@@ -462,6 +476,14 @@ static void program_set_param_data(struct gs_program *program,
 {
 	void *array = pp->param->cur_value.array;
 
+	/* uniforms keep their values per program, so only upload the ones
+	 * that changed since this program last used them */
+	if (pp->param->type != GS_SHADER_PARAM_TEXTURE) {
+		if (pp->generation == pp->param->generation)
+			return;
+		pp->generation = pp->param->generation;
+	}
+
 	if (pp->param->type == GS_SHADER_PARAM_BOOL ||
 	    pp->param->type == GS_SHADER_PARAM_INT) {
 		if (validate_param(pp, sizeof(int))) {
@@ -608,6 +630,7 @@ static bool assign_program_param(struct gs_program *program,
 	}
 
 	info.param = param;
+	info.generation = 0;
 	da_push_back(program->params, &info);
 	return true;
 }
@@ -634,22 +657,90 @@ static inline bool assign_program_params(struct gs_program *program)
 	return true;
 }
 
-struct gs_program *gs_program_create(struct gs_device *device)
+static inline uint64_t program_cache_hash(struct gs_program *program)
 {
-	struct gs_program *program = bzalloc(sizeof(*program));
-	int linked = false;
+	uint64_t hash = 0;
 
-	program->device = device;
-	program->vertex_shader = device->cur_vertex_shader;
-	program->pixel_shader = device->cur_pixel_shader;
+	hash = gs_shader_cache_hash(hash, &program->vertex_shader->source_hash,
+				    sizeof(uint64_t));
+	hash = gs_shader_cache_hash(hash, &program->pixel_shader->source_hash,
+				    sizeof(uint64_t));
+	return hash;
+}
 
-	program->obj = glCreateProgram();
-	if (!gl_success("glCreateProgram"))
-		goto error_detach_neither;
+/* cached binaries are stored as the binary format followed by the binary */
+static bool program_load_binary(struct gs_program *program)
+{
+	const char *tag = program->device->program_cache_tag;
+	GLint linked = GL_FALSE;
+	uint8_t *data;
+	size_t size;
+
+	if (!tag)
+		return false;
+	if (!gs_shader_cache_load(tag, program_cache_hash(program),
+				  (void **)&data, &size))
+		return false;
+
+	if (size > sizeof(GLenum)) {
+		GLenum format;
+		memcpy(&format, data, sizeof(format));
+
+		glProgramBinary(program->obj, format, data + sizeof(format),
+				(GLsizei)(size - sizeof(format)));
+		if (gl_success("glProgramBinary"))
+			glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
+	}
+
+	bfree(data);
+
+	/* drivers reject binaries from other versions, which simply means
+	 * linking from source again */
+	return linked == GL_TRUE;
+}
+
+static void program_store_binary(struct gs_program *program)
+{
+	const char *tag = program->device->program_cache_tag;
+	GLint length = 0;
+	GLsizei written = 0;
+	GLenum format = 0;
+	uint8_t *data;
+
+	if (!tag)
+		return;
+
+	glGetProgramiv(program->obj, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (!gl_success("glGetProgramiv") || length <= 0)
+		return;
+
+	data = bmalloc(sizeof(format) + length);
+	glGetProgramBinary(program->obj, length, &written, &format,
+			   data + sizeof(format));
+
+	if (gl_success("glGetProgramBinary") && written > 0) {
+		memcpy(data, &format, sizeof(format));
+		gs_shader_cache_store(tag, program_cache_hash(program), data,
+				      sizeof(format) + written);
+	}
+
+	bfree(data);
+}
+
+static bool program_link(struct gs_program *program)
+{
+	int linked = false;
+
+	if (program->device->program_cache_tag) {
+		glProgramParameteri(program->obj,
+				    GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+				    GL_TRUE);
+		gl_success("glProgramParameteri");
+	}
 
 	glAttachShader(program->obj, program->vertex_shader->obj);
 	if (!gl_success("glAttachShader (vertex)"))
-		goto error_detach_neither;
+		return false;
 
 	glAttachShader(program->obj, program->pixel_shader->obj);
 	if (!gl_success("glAttachShader (pixel)"))
@@ -668,24 +759,14 @@ struct gs_program *gs_program_create(struct gs_device *device)
 		goto error;
 	}
 
-	if (!assign_program_attribs(program))
-		goto error;
-	if (!assign_program_params(program))
-		goto error;
-
 	glDetachShader(program->obj, program->vertex_shader->obj);
 	gl_success("glDetachShader (vertex)");
 
 	glDetachShader(program->obj, program->pixel_shader->obj);
 	gl_success("glDetachShader (pixel)");
 
-	program->next = device->first_program;
-	program->prev_next = &device->first_program;
-	device->first_program = program;
-	if (program->next)
-		program->next->prev_next = &program->next;
-
-	return program;
+	program_store_binary(program);
+	return true;
 
 error:
 	glDetachShader(program->obj, program->pixel_shader->obj);
@@ -694,8 +775,38 @@ error:
 error_detach_vertex:
 	glDetachShader(program->obj, program->vertex_shader->obj);
 	gl_success("glDetachShader (vertex)");
+	return false;
+}
+
+struct gs_program *gs_program_create(struct gs_device *device)
+{
+	struct gs_program *program = bzalloc(sizeof(*program));
+
+	program->device = device;
+	program->vertex_shader = device->cur_vertex_shader;
+	program->pixel_shader = device->cur_pixel_shader;
+
+	program->obj = glCreateProgram();
+	if (!gl_success("glCreateProgram"))
+		goto error;
+
+	if (!program_load_binary(program) && !program_link(program))
+		goto error;
+
+	if (!assign_program_attribs(program))
+		goto error;
+	if (!assign_program_params(program))
+		goto error;
 
-error_detach_neither:
+	program->next = device->first_program;
+	program->prev_next = &device->first_program;
+	device->first_program = program;
+	if (program->next)
+		program->next->prev_next = &program->next;
+
+	return program;
+
+error:
 	gs_program_destroy(program);
 	return NULL;
 }
@@ -784,7 +895,7 @@ void gs_shader_set_val(gs_sparam_t *param, const void *val, size_t size)
 		gs_shader_set_texture(param, shader_tex.tex);
 		param->srgb = shader_tex.srgb;
 	} else {
-		da_copy_array(param->cur_value, val, size);
+		shader_setval_inline(param, val, size);
 	}
 }
 
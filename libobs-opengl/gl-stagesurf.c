@@ -66,9 +66,28 @@ gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
 	return surf;
 }
 
+static inline void clear_fence(struct gs_stage_surface *surf)
+{
+	if (surf->fence) {
+		glDeleteSync(surf->fence);
+		surf->fence = NULL;
+	}
+}
+
+/* fence after the pack so readiness can be polled without mapping */
+static inline void insert_fence(struct gs_stage_surface *surf)
+{
+	clear_fence(surf);
+
+	surf->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	gl_success("glFenceSync");
+}
+
 void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
 {
 	if (stagesurf) {
+		clear_fence(stagesurf);
+
 		if (stagesurf->pack_buffer)
 			gl_delete_buffers(1, &stagesurf->pack_buffer);
 
@@ -142,6 +161,7 @@ void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
 	if (!gl_success("glReadPixels"))
 		goto failed_unbind_all;
 
+	insert_fence(dst);
 	success = true;
 
 failed_unbind_all:
@@ -175,6 +195,8 @@ void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
 	if (!gl_success("glGetTexImage"))
 		goto failed;
 
+	insert_fence(dst);
+
 	gl_bind_texture(GL_TEXTURE_2D, 0);
 	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
 	return;
@@ -235,3 +257,15 @@ void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 
 	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
 }
+
+bool gs_stagesurface_ready(gs_stagesurf_t *stagesurf)
+{
+	GLenum status;
+
+	if (!stagesurf->fence)
+		return false;
+
+	status = glClientWaitSync(stagesurf->fence, 0, 0);
+	return status == GL_ALREADY_SIGNALED ||
+	       status == GL_CONDITION_SATISFIED;
+}
@@ -16,6 +16,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <util/dstr.h>
 #include <graphics/matrix3.h>
 #include "gl-subsystem.h"
 
@@ -153,6 +154,9 @@ static bool gl_init_extensions(struct gs_device *device)
 	else
 		device->copy_type = COPY_TYPE_FBO_BLIT;
 
+	device->persistent_uploads = GLAD_GL_VERSION_4_4 ||
+				     GLAD_GL_ARB_buffer_storage;
+
 	return true;
 }
 
@@ -216,6 +220,24 @@ const char *device_preprocessor_name(void)
 	return "_OPENGL";
 }
 
+static void gl_init_program_cache(struct gs_device *device, const char *vendor,
+				  const char *renderer, const char *version)
+{
+	GLint formats = 0;
+
+	if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+		return;
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (!gl_success("glGetIntegerv") || formats <= 0)
+		return;
+
+	/* program binaries are only valid for the exact same driver */
+	struct dstr tag = {0};
+	dstr_printf(&tag, "gl %s %s %s", vendor, renderer, version);
+	device->program_cache_tag = tag.array;
+}
+
 int device_create(gs_device_t **p_device, uint32_t adapter)
 {
 	struct gs_device *device = bzalloc(sizeof(struct gs_device));
@@ -248,6 +270,8 @@ int device_create(gs_device_t **p_device, uint32_t adapter)
 	     "language %s",
 	     glVersion, glShadingLanguage);
 
+	gl_init_program_cache(device, glVendor, glRenderer, glVersion);
+
 	gl_enable(GL_CULL_FACE);
 	gl_gen_vertex_arrays(1, &device->empty_vao);
 
@@ -289,15 +313,59 @@ void device_destroy(gs_device_t *device)
 		while (device->first_program)
 			gs_program_destroy(device->first_program);
 
+		gl_texture_pool_free(device);
 		samplerstate_release(device->raw_load_sampler);
 		gl_delete_vertex_arrays(1, &device->empty_vao);
 
 		da_free(device->proj_stack);
+		bfree(device->program_cache_tag);
 		gl_platform_destroy(device->plat);
 		bfree(device);
 	}
 }
 
+#define MAX_POOLED_TEXTURES 8
+
+/* sources recreate their dynamic textures whenever their frame size or
+ * format changes, which tends to alternate between the same few sizes */
+struct gs_texture_2d *gl_texture_pool_take(gs_device_t *device,
+					   uint32_t width, uint32_t height,
+					   enum gs_color_format format)
+{
+	for (size_t i = device->texture_pool.num; i > 0; i--) {
+		struct gs_texture_2d *tex = device->texture_pool.array[i - 1];
+
+		if (tex->width == width && tex->height == height &&
+		    tex->base.format == format) {
+			da_erase(device->texture_pool, i - 1);
+			return tex;
+		}
+	}
+
+	return NULL;
+}
+
+bool gl_texture_pool_add(gs_device_t *device, struct gs_texture_2d *tex)
+{
+	if (!device)
+		return false;
+
+	if (device->texture_pool.num == MAX_POOLED_TEXTURES) {
+		gl_texture_2d_free(device->texture_pool.array[0]);
+		da_erase(device->texture_pool, 0);
+	}
+
+	da_push_back(device->texture_pool, &tex);
+	return true;
+}
+
+void gl_texture_pool_free(gs_device_t *device)
+{
+	for (size_t i = 0; i < device->texture_pool.num; i++)
+		gl_texture_2d_free(device->texture_pool.array[i]);
+	da_free(device->texture_pool);
+}
+
 gs_swapchain_t *device_swapchain_create(gs_device_t *device,
 					const struct gs_init_data *info)
 {
@@ -1562,3 +1630,19 @@ bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
 	*frequency = 1000000000;
 	return true;
 }
+
+bool gs_timer_ready(gs_timer_t *timer)
+{
+	GLint available = 0;
+
+	/* timestamps complete in order, so the end implies the begin */
+	glGetQueryObjectiv(timer->queries[1], GL_QUERY_RESULT_AVAILABLE,
+			   &available);
+	return gl_success("glGetQueryObjectiv") && available;
+}
+
+bool gs_timer_range_ready(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+	return true;
+}
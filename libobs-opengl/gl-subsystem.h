@@ -77,6 +77,8 @@ static inline GLenum convert_gs_format(enum gs_color_format format)
 		return GL_BGRA;
 	case GS_BGRA_UNORM:
 		return GL_BGRA;
+	case GS_RG16:
+		return GL_RG;
 	case GS_UNKNOWN:
 		return 0;
 	}
@@ -129,6 +131,8 @@ static inline GLenum convert_gs_internal_format(enum gs_color_format format)
 		return GL_RGB;
 	case GS_BGRA_UNORM:
 		return GL_RGBA;
+	case GS_RG16:
+		return GL_RG16;
 	case GS_UNKNOWN:
 		return 0;
 	}
@@ -150,7 +154,7 @@ static inline GLenum get_gl_format_type(enum gs_color_format format)
 	case GS_BGRA:
 		return GL_UNSIGNED_BYTE;
 	case GS_R10G10B10A2:
-		return GL_UNSIGNED_INT_10_10_10_2;
+		return GL_UNSIGNED_INT_2_10_10_10_REV;
 	case GS_RGBA16:
 		return GL_UNSIGNED_SHORT;
 	case GS_R16:
@@ -181,6 +185,8 @@ static inline GLenum get_gl_format_type(enum gs_color_format format)
 		return GL_UNSIGNED_BYTE;
 	case GS_BGRA_UNORM:
 		return GL_UNSIGNED_BYTE;
+	case GS_RG16:
+		return GL_UNSIGNED_SHORT;
 	case GS_UNKNOWN:
 		return 0;
 	}
@@ -433,7 +439,10 @@ struct gs_shader_param {
 
 	DARRAY(uint8_t) cur_value;
 	DARRAY(uint8_t) def_value;
-	bool changed;
+
+	/* bumped each time cur_value changes, so every program using the
+	 * shader can tell whether its uniform is already up to date */
+	uint32_t generation;
 };
 
 enum attrib_type {
@@ -455,6 +464,7 @@ struct gs_shader {
 	gs_device_t *device;
 	enum gs_shader_type type;
 	GLuint obj;
+	uint64_t source_hash;
 
 	struct gs_shader_param *viewproj;
 	struct gs_shader_param *world;
@@ -467,6 +477,7 @@ struct gs_shader {
 struct program_param {
 	GLint obj;
 	struct gs_shader_param *param;
+	uint32_t generation;
 };
 
 struct gs_program {
@@ -537,13 +548,26 @@ struct gs_texture {
 	struct fbo_info *fbo;
 };
 
+#define GL_UPLOAD_BUFFERS 3
+
+/* pixel unpack buffer of a dynamic texture, written by the CPU while the
+ * previous uploads are still being copied by the GPU */
+struct gl_upload_buffer {
+	GLuint buffer;
+	uint8_t *ptr; /* persistent mapping, if supported */
+	GLsync fence;
+};
+
 struct gs_texture_2d {
 	struct gs_texture base;
 
 	uint32_t width;
 	uint32_t height;
 	bool gen_mipmaps;
-	GLuint unpack_buffer;
+
+	struct gl_upload_buffer uploads[GL_UPLOAD_BUFFERS];
+	GLsizeiptr upload_size;
+	size_t cur_upload;
 };
 
 struct gs_texture_3d {
@@ -574,6 +598,7 @@ struct gs_stage_surface {
 	GLint gl_internal_format;
 	GLenum gl_type;
 	GLuint pack_buffer;
+	GLsync fence;
 };
 
 struct gs_zstencil_buffer {
@@ -631,6 +656,10 @@ struct gs_device {
 
 	struct gs_program *first_program;
 
+	/* identifies the driver for cached program binaries, NULL if the
+	 * driver can't save and reload them */
+	char *program_cache_tag;
+
 	enum gs_cull_mode cur_cull_mode;
 	struct gs_rect cur_viewport;
 
@@ -641,11 +670,27 @@ struct gs_device {
 	DARRAY(struct matrix4) proj_stack;
 
 	struct fbo_info *cur_fbo;
+
+	/* GL_ARB_buffer_storage, texture uploads use persistent mappings */
+	bool persistent_uploads;
+
+	/* destroyed dynamic textures kept for reuse by new textures of the
+	 * same size and format */
+	DARRAY(struct gs_texture_2d *) texture_pool;
 };
 
 extern struct fbo_info *get_fbo(gs_texture_t *tex, uint32_t width,
 				uint32_t height);
 
+extern void gl_texture_2d_free(struct gs_texture_2d *tex);
+extern struct gs_texture_2d *gl_texture_pool_take(gs_device_t *device,
+						  uint32_t width,
+						  uint32_t height,
+						  enum gs_color_format format);
+extern bool gl_texture_pool_add(gs_device_t *device,
+				struct gs_texture_2d *tex);
+extern void gl_texture_pool_free(gs_device_t *device);
+
 extern void gl_update(gs_device_t *device);
 extern void gl_clear_context(gs_device_t *device);
 
@@ -45,18 +45,10 @@ static bool upload_texture_2d(struct gs_texture_2d *tex, const uint8_t **data)
 	return success;
 }
 
-static bool create_pixel_unpack_buffer(struct gs_texture_2d *tex)
+static GLsizeiptr get_upload_size(const struct gs_texture_2d *tex)
 {
-	GLsizeiptr size;
-	bool success = true;
-
-	if (!gl_gen_buffers(1, &tex->unpack_buffer))
-		return false;
+	GLsizeiptr size = tex->width * gs_get_format_bpp(tex->base.format);
 
-	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex->unpack_buffer))
-		return false;
-
-	size = tex->width * gs_get_format_bpp(tex->base.format);
 	if (!gs_is_compressed_format(tex->base.format)) {
 		size /= 8;
 		size = (size + 3) & 0xFFFFFFFC;
@@ -66,9 +58,41 @@ static bool create_pixel_unpack_buffer(struct gs_texture_2d *tex)
 		size /= 8;
 	}
 
-	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, 0, GL_DYNAMIC_DRAW);
-	if (!gl_success("glBufferData"))
-		success = false;
+	return size;
+}
+
+static bool create_upload_buffer(struct gs_texture_2d *tex,
+				 struct gl_upload_buffer *upload)
+{
+	const GLbitfield persistent_flags =
+		GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	bool success = true;
+
+	if (!gl_gen_buffers(1, &upload->buffer))
+		return false;
+
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, upload->buffer))
+		return false;
+
+	if (tex->base.device->persistent_uploads) {
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, tex->upload_size, NULL,
+				persistent_flags);
+		if (!gl_success("glBufferStorage"))
+			success = false;
+
+		if (success) {
+			upload->ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+						       0, tex->upload_size,
+						       persistent_flags);
+			if (!gl_success("glMapBufferRange") || !upload->ptr)
+				success = false;
+		}
+	} else {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, tex->upload_size, 0,
+			     GL_STREAM_DRAW);
+		if (!gl_success("glBufferData"))
+			success = false;
+	}
 
 	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0))
 		success = false;
@@ -76,13 +100,76 @@ static bool create_pixel_unpack_buffer(struct gs_texture_2d *tex)
 	return success;
 }
 
+static bool create_pixel_unpack_buffers(struct gs_texture_2d *tex)
+{
+	tex->upload_size = get_upload_size(tex);
+
+	for (size_t i = 0; i < GL_UPLOAD_BUFFERS; i++) {
+		if (!create_upload_buffer(tex, &tex->uploads[i]))
+			return false;
+	}
+
+	return true;
+}
+
+static void wait_upload_fence(struct gl_upload_buffer *upload)
+{
+	GLenum ret;
+
+	if (!upload->fence)
+		return;
+
+	do {
+		ret = glClientWaitSync(upload->fence,
+				       GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	} while (ret == GL_TIMEOUT_EXPIRED);
+
+	if (ret == GL_WAIT_FAILED)
+		gl_success("glClientWaitSync");
+
+	glDeleteSync(upload->fence);
+	upload->fence = NULL;
+}
+
+static void free_pixel_unpack_buffers(struct gs_texture_2d *tex)
+{
+	for (size_t i = 0; i < GL_UPLOAD_BUFFERS; i++) {
+		struct gl_upload_buffer *upload = &tex->uploads[i];
+
+		if (upload->fence) {
+			glDeleteSync(upload->fence);
+			upload->fence = NULL;
+		}
+		if (upload->buffer) {
+			/* deleting a buffer also releases its mapping */
+			gl_delete_buffers(1, &upload->buffer);
+			upload->buffer = 0;
+			upload->ptr = NULL;
+		}
+	}
+}
+
 gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
 				    uint32_t height,
 				    enum gs_color_format color_format,
 				    uint32_t levels, const uint8_t **data,
 				    uint32_t flags)
 {
-	struct gs_texture_2d *tex = bzalloc(sizeof(struct gs_texture_2d));
+	struct gs_texture_2d *tex;
+
+	/* only plain dynamic textures are pooled, see gs_texture_destroy */
+	if (flags == GS_DYNAMIC && levels == 1) {
+		tex = gl_texture_pool_take(device, width, height, color_format);
+		if (tex) {
+			if (data && !upload_texture_2d(tex, data)) {
+				gl_texture_2d_free(tex);
+				goto fail_pooled;
+			}
+			return (gs_texture_t *)tex;
+		}
+	}
+
+	tex = bzalloc(sizeof(struct gs_texture_2d));
 	tex->base.device = device;
 	tex->base.type = GS_TEXTURE_2D;
 	tex->base.format = color_format;
@@ -102,7 +189,7 @@ gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
 		goto fail;
 
 	if (!tex->base.is_dummy) {
-		if (tex->base.is_dynamic && !create_pixel_unpack_buffer(tex))
+		if (tex->base.is_dynamic && !create_pixel_unpack_buffers(tex))
 			goto fail;
 		if (!upload_texture_2d(tex, data))
 			goto fail;
@@ -130,7 +217,8 @@ gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
 	return (gs_texture_t *)tex;
 
 fail:
-	gs_texture_destroy((gs_texture_t *)tex);
+	gl_texture_2d_free(tex);
+fail_pooled:
 	blog(LOG_ERROR, "device_texture_create (GL) failed");
 	return NULL;
 }
@@ -143,20 +231,14 @@ static inline bool is_texture_2d(const gs_texture_t *tex, const char *func)
 	return is_tex2d;
 }
 
-void gs_texture_destroy(gs_texture_t *tex)
+static void texture_free(gs_texture_t *tex)
 {
-	if (!tex)
-		return;
-
 	if (tex->cur_sampler)
 		gs_samplerstate_destroy(tex->cur_sampler);
 
 	if (!tex->is_dummy && tex->is_dynamic) {
 		if (tex->type == GS_TEXTURE_2D) {
-			struct gs_texture_2d *tex2d =
-				(struct gs_texture_2d *)tex;
-			if (tex2d->unpack_buffer)
-				gl_delete_buffers(1, &tex2d->unpack_buffer);
+			free_pixel_unpack_buffers((struct gs_texture_2d *)tex);
 		} else if (tex->type == GS_TEXTURE_3D) {
 			struct gs_texture_3d *tex3d =
 				(struct gs_texture_3d *)tex;
@@ -174,6 +256,38 @@ void gs_texture_destroy(gs_texture_t *tex)
 	bfree(tex);
 }
 
+void gl_texture_2d_free(struct gs_texture_2d *tex)
+{
+	if (tex)
+		texture_free(&tex->base);
+}
+
+static inline bool is_poolable(const gs_texture_t *tex)
+{
+	return tex->type == GS_TEXTURE_2D && tex->is_dynamic &&
+	       !tex->is_dummy && !tex->is_render_target && !tex->gen_mipmaps &&
+	       tex->levels == 1 && tex->texture;
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	if (!tex)
+		return;
+
+	if (is_poolable(tex)) {
+		if (tex->cur_sampler) {
+			gs_samplerstate_destroy(tex->cur_sampler);
+			tex->cur_sampler = NULL;
+		}
+
+		if (gl_texture_pool_add(tex->device,
+					(struct gs_texture_2d *)tex))
+			return;
+	}
+
+	texture_free(tex);
+}
+
 uint32_t gs_texture_get_width(const gs_texture_t *tex)
 {
 	const struct gs_texture_2d *tex2d = (const struct gs_texture_2d *)tex;
@@ -200,6 +314,7 @@ enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
 bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
 {
 	struct gs_texture_2d *tex2d = (struct gs_texture_2d *)tex;
+	struct gl_upload_buffer *upload;
 
 	if (!is_texture_2d(tex, "gs_texture_map"))
 		goto fail;
@@ -209,20 +324,33 @@ bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
 		goto fail;
 	}
 
-	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex2d->unpack_buffer))
-		goto fail;
+	/* the oldest buffer of the ring, normally long since consumed */
+	upload = &tex2d->uploads[tex2d->cur_upload];
+	wait_upload_fence(upload);
 
-	*ptr = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
-	if (!gl_success("glMapBuffer"))
-		goto fail;
+	if (upload->ptr) {
+		*ptr = upload->ptr;
+	} else {
+		if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, upload->buffer))
+			goto fail;
 
-	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		*ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+					tex2d->upload_size,
+					GL_MAP_WRITE_BIT |
+						GL_MAP_INVALIDATE_BUFFER_BIT |
+						GL_MAP_UNSYNCHRONIZED_BIT);
+		if (!gl_success("glMapBufferRange") || !*ptr)
+			goto fail;
+
+		gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
 
 	*linesize = tex2d->width * gs_get_format_bpp(tex->format) / 8;
 	*linesize = (*linesize + 3) & 0xFFFFFFFC;
 	return true;
 
 fail:
+	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
 	blog(LOG_ERROR, "gs_texture_map (GL) failed");
 	return false;
 }
@@ -230,24 +358,34 @@ fail:
 void gs_texture_unmap(gs_texture_t *tex)
 {
 	struct gs_texture_2d *tex2d = (struct gs_texture_2d *)tex;
+	struct gl_upload_buffer *upload;
+
 	if (!is_texture_2d(tex, "gs_texture_unmap"))
 		goto failed;
 
-	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex2d->unpack_buffer))
-		goto failed;
+	upload = &tex2d->uploads[tex2d->cur_upload];
+	tex2d->cur_upload = (tex2d->cur_upload + 1) % GL_UPLOAD_BUFFERS;
 
-	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
-	if (!gl_success("glUnmapBuffer"))
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, upload->buffer))
 		goto failed;
 
+	if (!upload->ptr) {
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		if (!gl_success("glUnmapBuffer"))
+			goto failed;
+	}
+
 	if (!gl_bind_texture(GL_TEXTURE_2D, tex2d->base.texture))
 		goto failed;
 
-	glTexImage2D(GL_TEXTURE_2D, 0, tex->gl_internal_format, tex2d->width,
-		     tex2d->height, 0, tex->gl_format, tex->gl_type, 0);
-	if (!gl_success("glTexImage2D"))
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tex2d->width, tex2d->height,
+			tex->gl_format, tex->gl_type, 0);
+	if (!gl_success("glTexSubImage2D"))
 		goto failed;
 
+	/* the buffer may be written again once the copy has completed */
+	upload->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
 	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
 	gl_bind_texture(GL_TEXTURE_2D, 0);
 	return;
@@ -258,6 +396,51 @@ failed:
 	blog(LOG_ERROR, "gs_texture_unmap (GL) failed");
 }
 
+bool gs_texture_set_subimage(gs_texture_t *tex, uint32_t x, uint32_t y,
+			     uint32_t width, uint32_t height,
+			     const uint8_t *data, uint32_t linesize)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d *)tex;
+	uint32_t bytes_per_pixel;
+	bool success;
+
+	if (!is_texture_2d(tex, "gs_texture_set_subimage"))
+		goto fail;
+
+	bytes_per_pixel = gs_get_format_bpp(tex->format) / 8;
+	if (gs_is_compressed_format(tex->format) || !bytes_per_pixel ||
+	    linesize % bytes_per_pixel) {
+		blog(LOG_ERROR, "Unsupported format or line size");
+		goto fail;
+	}
+
+	if (x + width > tex2d->width || y + height > tex2d->height) {
+		blog(LOG_ERROR, "Region outside of the texture");
+		goto fail;
+	}
+
+	if (!gl_bind_texture(GL_TEXTURE_2D, tex2d->base.texture))
+		goto fail;
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / bytes_per_pixel);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, tex->gl_format,
+			tex->gl_type, data);
+	success = gl_success("glTexSubImage2D");
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	gl_bind_texture(GL_TEXTURE_2D, 0);
+
+	if (success)
+		return true;
+
+fail:
+	blog(LOG_ERROR, "gs_texture_set_subimage (GL) failed");
+	return false;
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	if (tex->type == GS_TEXTURE_3D)
@@ -334,6 +334,16 @@ static struct gs_texture *gl_wayland_egl_device_texture_create_from_dmabuf(
 					  offsets, modifiers);
 }
 
+static bool gl_wayland_egl_device_query_dmabuf_modifiers(
+	gs_device_t *device, enum gs_color_format color_format,
+	uint64_t **modifiers, size_t *n_modifiers)
+{
+	struct gl_platform *plat = device->plat;
+
+	return gl_egl_query_dmabuf_modifiers(plat->display, color_format,
+					     modifiers, n_modifiers);
+}
+
 static const struct gl_winsys_vtable egl_wayland_winsys_vtable = {
 	.windowinfo_create = gl_wayland_egl_windowinfo_create,
 	.windowinfo_destroy = gl_wayland_egl_windowinfo_destroy,
@@ -351,6 +361,8 @@ static const struct gl_winsys_vtable egl_wayland_winsys_vtable = {
 	.device_present = gl_wayland_egl_device_present,
 	.device_texture_create_from_dmabuf =
 		gl_wayland_egl_device_texture_create_from_dmabuf,
+	.device_query_dmabuf_modifiers =
+		gl_wayland_egl_device_query_dmabuf_modifiers,
 };
 
 const struct gl_winsys_vtable *gl_wayland_egl_get_winsys_vtable(void)
@@ -648,6 +648,16 @@ static struct gs_texture *gl_x11_egl_device_texture_create_from_dmabuf(
 					  offsets, modifiers);
 }
 
+static bool gl_x11_egl_device_query_dmabuf_modifiers(
+	gs_device_t *device, enum gs_color_format color_format,
+	uint64_t **modifiers, size_t *n_modifiers)
+{
+	struct gl_platform *plat = device->plat;
+
+	return gl_egl_query_dmabuf_modifiers(plat->edisplay, color_format,
+					     modifiers, n_modifiers);
+}
+
 static const struct gl_winsys_vtable egl_x11_winsys_vtable = {
 	.windowinfo_create = gl_x11_egl_windowinfo_create,
 	.windowinfo_destroy = gl_x11_egl_windowinfo_destroy,
@@ -665,6 +675,8 @@ static const struct gl_winsys_vtable egl_x11_winsys_vtable = {
 	.device_present = gl_x11_egl_device_present,
 	.device_texture_create_from_dmabuf =
 		gl_x11_egl_device_texture_create_from_dmabuf,
+	.device_query_dmabuf_modifiers =
+		gl_x11_egl_device_query_dmabuf_modifiers,
 };
 
 const struct gl_winsys_vtable *gl_x11_egl_get_winsys_vtable(void)
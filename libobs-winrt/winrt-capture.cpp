@@ -107,6 +107,10 @@ static bool get_client_box(HWND window, uint32_t width, uint32_t height,
 	return client_box_available;
 }
 
+/* one buffer for the frame being drawn, one for the newest frame not drawn
+ * yet, and one for the capture to write the next frame into */
+#define FRAME_POOL_SIZE 3
+
 struct winrt_capture {
 	HWND window;
 	bool client_area;
@@ -131,6 +135,18 @@ struct winrt_capture {
 	winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool::
 		FrameArrived_revoker frame_arrived;
 
+	/* newest frame that was not rendered yet, frames replaced before the
+	 * next render go back to the pool without being copied */
+	winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame pending_frame{
+		nullptr};
+
+	/* frame drawn from directly, kept until a newer one is rendered */
+	winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame held_frame{
+		nullptr};
+	gs_texture_t *held_texture;
+
+	uint32_t texture_x;
+	uint32_t texture_y;
 	uint32_t texture_width;
 	uint32_t texture_height;
 	D3D11_BOX client_box;
@@ -151,11 +167,87 @@ struct winrt_capture {
 	{
 		obs_enter_graphics();
 
-		const winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame
+		winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame
 			frame = sender.TryGetNextFrame();
+		if (!frame) {
+			obs_leave_graphics();
+			return;
+		}
+
 		const winrt::Windows::Graphics::SizeInt32 frame_content_size =
 			frame.ContentSize();
 
+		if (pending_frame)
+			pending_frame.Close();
+		pending_frame = frame;
+
+		if (frame_content_size.Width != last_size.Width ||
+		    frame_content_size.Height != last_size.Height) {
+			frame_pool.Recreate(
+				device,
+				winrt::Windows::Graphics::DirectX::
+					DirectXPixelFormat::B8G8R8A8UIntNormalized,
+				FRAME_POOL_SIZE, frame_content_size);
+
+			last_size = frame_content_size;
+		}
+
+		obs_leave_graphics();
+	}
+
+	void release_frames()
+	{
+		if (pending_frame) {
+			pending_frame.Close();
+			pending_frame = nullptr;
+		}
+
+		if (held_frame) {
+			held_frame.Close();
+			held_frame = nullptr;
+		}
+
+		gs_texture_destroy(held_texture);
+		held_texture = nullptr;
+	}
+
+	void copy_frame(ID3D11Texture2D *frame_surface)
+	{
+		if (texture) {
+			if (texture_width != gs_texture_get_width(texture) ||
+			    texture_height != gs_texture_get_height(texture)) {
+				gs_texture_destroy(texture);
+				texture = nullptr;
+			}
+		}
+
+		if (!texture) {
+			texture = gs_texture_create(texture_width,
+						    texture_height, GS_BGRA, 1,
+						    NULL, 0);
+		}
+
+		if (client_area) {
+			context->CopySubresourceRegion(
+				(ID3D11Texture2D *)gs_texture_get_obj(texture),
+				0, 0, 0, 0, frame_surface, 0, &client_box);
+		} else {
+			context->CopyResource(
+				(ID3D11Texture2D *)gs_texture_get_obj(texture),
+				frame_surface);
+		}
+	}
+
+	/* called from render, so only the frame actually shown is used */
+	void update_frame()
+	{
+		if (!pending_frame)
+			return;
+
+		winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame
+			frame = pending_frame;
+		pending_frame = nullptr;
+
 		winrt::com_ptr<ID3D11Texture2D> frame_surface =
 			GetDXGIInterfaceFromObject<ID3D11Texture2D>(
 				frame.Surface());
@@ -164,64 +256,41 @@ struct winrt_capture {
 		D3D11_TEXTURE2D_DESC desc;
 		frame_surface->GetDesc(&desc);
 
-		if (!client_area || get_client_box(window, desc.Width,
+		/* keep showing the last frame while the client area is not
+		 * available, e.g. while the window is minimized */
+		if (client_area && !get_client_box(window, desc.Width,
 						   desc.Height, &client_box)) {
-			if (client_area) {
-				texture_width =
-					client_box.right - client_box.left;
-				texture_height =
-					client_box.bottom - client_box.top;
-			} else {
-				texture_width = desc.Width;
-				texture_height = desc.Height;
-			}
-
-			if (texture) {
-				if (texture_width !=
-					    gs_texture_get_width(texture) ||
-				    texture_height !=
-					    gs_texture_get_height(texture)) {
-					gs_texture_destroy(texture);
-					texture = nullptr;
-				}
-			}
-
-			if (!texture) {
-				texture = gs_texture_create(texture_width,
-							    texture_height,
-							    GS_BGRA, 1, NULL,
-							    0);
-			}
-
-			if (client_area) {
-				context->CopySubresourceRegion(
-					(ID3D11Texture2D *)gs_texture_get_obj(
-						texture),
-					0, 0, 0, 0, frame_surface.get(), 0,
-					&client_box);
-			} else {
-				/* if they gave an SRV, we could avoid this copy */
-				context->CopyResource(
-					(ID3D11Texture2D *)gs_texture_get_obj(
-						texture),
-					frame_surface.get());
-			}
+			frame.Close();
+			return;
+		}
 
-			texture_written = true;
+		if (client_area) {
+			texture_x = client_box.left;
+			texture_y = client_box.top;
+			texture_width = client_box.right - client_box.left;
+			texture_height = client_box.bottom - client_box.top;
+		} else {
+			texture_x = 0;
+			texture_y = 0;
+			texture_width = desc.Width;
+			texture_height = desc.Height;
 		}
 
-		if (frame_content_size.Width != last_size.Width ||
-		    frame_content_size.Height != last_size.Height) {
-			frame_pool.Recreate(
-				device,
-				winrt::Windows::Graphics::DirectX::
-					DirectXPixelFormat::B8G8R8A8UIntNormalized,
-				2, frame_content_size);
+		gs_texture_t *wrapped = nullptr;
+		if ((desc.BindFlags & D3D11_BIND_SHADER_RESOURCE) != 0)
+			wrapped = gs_texture_wrap_obj(frame_surface.get());
 
-			last_size = frame_content_size;
+		release_frames();
+
+		if (wrapped) {
+			held_frame = frame;
+			held_texture = wrapped;
+		} else {
+			copy_frame(frame_surface.get());
+			frame.Close();
 		}
 
-		obs_leave_graphics();
+		texture_written = true;
 	}
 };
 
@@ -233,6 +302,7 @@ static void winrt_capture_device_loss_release(void *data)
 	capture->active = FALSE;
 
 	capture->frame_arrived.revoke();
+	capture->release_frames();
 
 	try {
 		capture->frame_pool.Close();
@@ -358,7 +428,7 @@ static void winrt_capture_device_loss_rebuild(void *device_void, void *data)
 				device,
 				winrt::Windows::Graphics::DirectX::
 					DirectXPixelFormat::B8G8R8A8UIntNormalized,
-				2, capture->last_size);
+				FRAME_POOL_SIZE, capture->last_size);
 	const winrt::Windows::Graphics::Capture::GraphicsCaptureSession session =
 		frame_pool.CreateCaptureSession(item);
 
@@ -439,7 +509,7 @@ try {
 				device,
 				winrt::Windows::Graphics::DirectX::
 					DirectXPixelFormat::B8G8R8A8UIntNormalized,
-				2, size);
+				FRAME_POOL_SIZE, size);
 	const winrt::Windows::Graphics::Capture::GraphicsCaptureSession session =
 		frame_pool.CreateCaptureSession(item);
 
@@ -528,14 +598,15 @@ extern "C" EXPORT void winrt_capture_free(struct winrt_capture *capture)
 			previous->next = current->next;
 		}
 
+		capture->frame_arrived.revoke();
+		capture->closed.revoke();
+
 		obs_enter_graphics();
 		gs_unregister_loss_callbacks(capture);
+		capture->release_frames();
 		gs_texture_destroy(capture->texture);
 		obs_leave_graphics();
 
-		capture->frame_arrived.revoke();
-		capture->closed.revoke();
-
 		try {
 			capture->frame_pool.Close();
 		} catch (winrt::hresult_error &err) {
@@ -566,7 +637,9 @@ extern "C" EXPORT void winrt_capture_free(struct winrt_capture *capture)
 
 static void draw_texture(struct winrt_capture *capture, gs_effect_t *effect)
 {
-	gs_texture_t *const texture = capture->texture;
+	gs_texture_t *const texture = capture->held_texture
+					      ? capture->held_texture
+					      : capture->texture;
 	gs_technique_t *tech = gs_effect_get_technique(effect, "Draw");
 	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
 	size_t passes;
@@ -584,7 +657,14 @@ static void draw_texture(struct winrt_capture *capture, gs_effect_t *effect)
 	passes = gs_technique_begin(tech);
 	for (size_t i = 0; i < passes; i++) {
 		if (gs_technique_begin_pass(tech, i)) {
-			gs_draw_sprite(texture, 0, 0, 0);
+			if (capture->held_texture)
+				gs_draw_sprite_subregion(
+					texture, 0, capture->texture_x,
+					capture->texture_y,
+					capture->texture_width,
+					capture->texture_height);
+			else
+				gs_draw_sprite(texture, 0, 0, 0);
 
 			gs_technique_end_pass(tech);
 		}
@@ -613,6 +693,8 @@ extern "C" EXPORT void winrt_capture_show_cursor(struct winrt_capture *capture,
 extern "C" EXPORT void winrt_capture_render(struct winrt_capture *capture,
 					    gs_effect_t *effect)
 {
+	capture->update_frame();
+
 	if (capture->texture_written)
 		draw_texture(capture, effect);
 }
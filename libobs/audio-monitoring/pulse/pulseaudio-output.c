@@ -1,13 +1,34 @@
 #include "obs-internal.h"
+#include "media-io/audio-mixing.h"
 #include "pulseaudio-wrapper.h"
 
-#define PULSE_DATA(voidptr) struct audio_monitor *data = voidptr;
 #define blog(level, msg, ...) blog(level, "pulse-am: " msg, ##__VA_ARGS__)
 
-struct audio_monitor {
-	obs_source_t *source;
-	pa_stream *stream;
+/*
+ * Monitored sources do not get a stream each.  Every monitoring device has
+ * one bus with a single stream and resampler, and the sources monitored on
+ * it queue their audio there as planar float at the output rate.  Whenever
+ * the stream wants data, the queued audio is mixed in chunks, converted once
+ * and written.
+ *
+ * A source only joins the mix once it has a full chunk queued, and drops out
+ * again when it runs dry, so a source delivering late does not cut up the
+ * others.  Queued audio beyond MAX_QUEUED_MS is dropped, which keeps the
+ * monitoring latency bounded when a source delivers faster than the device
+ * plays.
+ */
+
+#define CHUNK_MS 10
+#define MAX_QUEUED_MS 100
+#define TARGET_LATENCY_MS 25
+#define MAX_LATENCY_MS 250
+
+struct monitor_bus {
+	char *id;
 	char *device;
+	long refs;
+
+	pa_stream *stream;
 	pa_buffer_attr attr;
 	enum speaker_layout speakers;
 	pa_sample_format_t format;
@@ -18,16 +39,33 @@ struct audio_monitor {
 	uint_fast32_t packets;
 	uint_fast64_t frames;
 
-	struct circlebuf new_data;
 	audio_resampler_t *resampler;
-	size_t buffer_size;
-	size_t bytesRemaining;
-	size_t bytes_per_channel;
+	size_t obs_channels;
+	size_t chunk_frames;
+	size_t max_queued;
+	float *mix[MAX_AUDIO_CHANNELS];
+	float *scratch;
+
+	/* written by the stream callbacks, which must not wait for mutex */
+	pthread_mutex_t request_mutex;
+	size_t bytes_requested;
+
+	pthread_mutex_t mutex;
+	DARRAY(struct audio_monitor *) inputs;
+};
 
+struct audio_monitor {
+	obs_source_t *source;
+	struct monitor_bus *bus;
+	struct circlebuf queued[MAX_AUDIO_CHANNELS];
+	bool mixing;
 	bool ignore;
-	pthread_mutex_t playback_mutex;
 };
 
+static pthread_mutex_t buses_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct monitor_bus *) buses;
+
+
 static enum speaker_layout
 pulseaudio_channels_to_obs_speakers(uint_fast32_t channels)
 {
@@ -125,77 +163,105 @@ static pa_channel_map pulseaudio_channel_map(enum speaker_layout layout)
 	return ret;
 }
 
-static void process_byte(void *p, size_t frames, size_t channels, float vol)
-{
-	register char *cur = (char *)p;
-	register char *end = cur + frames * channels;
 
-	while (cur < end)
-		*(cur++) *= vol;
-}
+/* ------------------------------------------------------------------------- */
 
-static void process_short(void *p, size_t frames, size_t channels, float vol)
+static inline size_t queued_frames(const struct audio_monitor *monitor)
 {
-	register short *cur = (short *)p;
-	register short *end = cur + frames * channels;
-
-	while (cur < end)
-		*(cur++) *= vol;
+	return monitor->queued[0].size / sizeof(float);
 }
 
-static void process_float(void *p, size_t frames, size_t channels, float vol)
+/* assumes the bus mutex */
+static bool bus_ready(const struct monitor_bus *bus)
 {
-	register float *cur = (float *)p;
-	register float *end = cur + frames * channels;
+	for (size_t i = 0; i < bus->inputs.num; i++) {
+		const struct audio_monitor *monitor = bus->inputs.array[i];
+		if (monitor->mixing &&
+		    queued_frames(monitor) >= bus->chunk_frames)
+			return true;
+	}
 
-	while (cur < end)
-		*(cur++) *= vol;
+	return false;
 }
 
-void process_volume(const struct audio_monitor *monitor, float vol,
-		    uint8_t *const *resample_data, uint32_t resample_frames)
+/* assumes the bus mutex */
+static void bus_mix_chunk(struct monitor_bus *bus)
 {
-	switch (monitor->bytes_per_channel) {
-	case 1:
-		process_byte(resample_data[0], resample_frames,
-			     monitor->channels, vol);
-		break;
-	case 2:
-		process_short(resample_data[0], resample_frames,
-			      monitor->channels, vol);
-		break;
-	default:
-		process_float(resample_data[0], resample_frames,
-			      monitor->channels, vol);
-		break;
+	size_t chunk = bus->chunk_frames;
+
+	memset(bus->mix[0], 0, chunk * bus->obs_channels * sizeof(float));
+
+	for (size_t i = 0; i < bus->inputs.num; i++) {
+		struct audio_monitor *monitor = bus->inputs.array[i];
+		float vol = monitor->source->user_volume;
+		size_t frames;
+
+		if (!monitor->mixing)
+			continue;
+
+		frames = queued_frames(monitor);
+		if (frames < chunk)
+			monitor->mixing = false;
+		else
+			frames = chunk;
+
+		for (size_t ch = 0; ch < bus->obs_channels; ch++) {
+			circlebuf_pop_front(&monitor->queued[ch], bus->scratch,
+					    frames * sizeof(float));
+
+			if (close_float(vol, 1.0f, EPSILON))
+				audio_mix_add(bus->mix[ch], bus->scratch,
+					      frames);
+			else
+				audio_mix_add_gain(bus->mix[ch], bus->scratch,
+						   vol, frames);
+		}
 	}
 }
 
-static void do_stream_write(void *param)
+static size_t take_requested(struct monitor_bus *bus, size_t written)
 {
-	PULSE_DATA(param);
-	uint8_t *buffer = NULL;
+	size_t requested;
 
-	while (data->new_data.size >= data->buffer_size &&
-	       data->bytesRemaining > 0) {
-		size_t bytesToFill = data->buffer_size;
+	pthread_mutex_lock(&bus->request_mutex);
+	if (written > bus->bytes_requested)
+		written = bus->bytes_requested;
+	bus->bytes_requested -= written;
+	requested = bus->bytes_requested;
+	pthread_mutex_unlock(&bus->request_mutex);
 
-		if (bytesToFill > data->bytesRemaining)
-			bytesToFill = data->bytesRemaining;
+	return requested;
+}
 
-		pulseaudio_lock();
-		pa_stream_begin_write(data->stream, (void **)&buffer,
-				      &bytesToFill);
-		pulseaudio_unlock();
+/* assumes the bus mutex */
+static void bus_write(struct monitor_bus *bus)
+{
+	size_t requested = take_requested(bus, 0);
+
+	while (requested > 0 && bus_ready(bus)) {
+		uint8_t *resample_data[MAX_AV_PLANES];
+		uint32_t resample_frames;
+		uint64_t ts_offset;
+		size_t bytes;
 
-		circlebuf_pop_front(&data->new_data, buffer, bytesToFill);
+		bus_mix_chunk(bus);
+
+		if (!audio_resampler_resample(
+			    bus->resampler, resample_data, &resample_frames,
+			    &ts_offset, (const uint8_t *const *)bus->mix,
+			    (uint32_t)bus->chunk_frames))
+			break;
+
+		bytes = bus->bytes_per_frame * resample_frames;
 
 		pulseaudio_lock();
-		pa_stream_write(data->stream, buffer, bytesToFill, NULL, 0LL,
+		pa_stream_write(bus->stream, resample_data[0], bytes, NULL, 0LL,
 				PA_SEEK_RELATIVE);
 		pulseaudio_unlock();
 
-		data->bytesRemaining -= bytesToFill;
+		bus->packets++;
+		bus->frames += resample_frames;
+		requested = take_requested(bus, bytes);
 	}
 }
 
@@ -203,71 +269,63 @@ static void on_audio_playback(void *param, obs_source_t *source,
 			      const struct audio_data *audio_data, bool muted)
 {
 	struct audio_monitor *monitor = param;
-	float vol = source->user_volume;
-	size_t bytes;
-
-	uint8_t *resample_data[MAX_AV_PLANES];
-	uint32_t resample_frames;
-	uint64_t ts_offset;
-	bool success;
-
-	if (pthread_mutex_trylock(&monitor->playback_mutex) != 0)
-		return;
+	struct monitor_bus *bus = monitor->bus;
+	size_t bytes = audio_data->frames * sizeof(float);
+	size_t max_bytes = bus->max_queued * sizeof(float);
 
 	if (os_atomic_load_long(&source->activate_refs) == 0)
-		goto unlock;
+		return;
 
-	success = audio_resampler_resample(
-		monitor->resampler, resample_data, &resample_frames, &ts_offset,
-		(const uint8_t *const *)audio_data->data,
-		(uint32_t)audio_data->frames);
+	pthread_mutex_lock(&bus->mutex);
 
-	if (!success)
-		goto unlock;
+	for (size_t ch = 0; ch < bus->obs_channels; ch++) {
+		struct circlebuf *queued = &monitor->queued[ch];
 
-	bytes = monitor->bytes_per_frame * resample_frames;
+		if (muted)
+			circlebuf_push_back_zero(queued, bytes);
+		else
+			circlebuf_push_back(queued, audio_data->data[ch],
+					    bytes);
 
-	if (muted) {
-		memset(resample_data[0], 0, bytes);
-	} else {
-		if (!close_float(vol, 1.0f, EPSILON)) {
-			process_volume(monitor, vol, resample_data,
-				       resample_frames);
-		}
+		if (queued->size > max_bytes)
+			circlebuf_pop_front(queued, NULL,
+					    queued->size - max_bytes);
 	}
 
-	circlebuf_push_back(&monitor->new_data, resample_data[0], bytes);
-	monitor->packets++;
-	monitor->frames += resample_frames;
+	if (!monitor->mixing && queued_frames(monitor) >= bus->chunk_frames)
+		monitor->mixing = true;
 
-unlock:
-	pthread_mutex_unlock(&monitor->playback_mutex);
-	do_stream_write(param);
+	bus_write(bus);
+	pthread_mutex_unlock(&bus->mutex);
 }
 
 static void pulseaudio_stream_write(pa_stream *p, size_t nbytes, void *userdata)
 {
 	UNUSED_PARAMETER(p);
-	PULSE_DATA(userdata);
+	struct monitor_bus *bus = userdata;
 
-	pthread_mutex_lock(&data->playback_mutex);
-	data->bytesRemaining += nbytes;
-	pthread_mutex_unlock(&data->playback_mutex);
+	pthread_mutex_lock(&bus->request_mutex);
+	bus->bytes_requested += nbytes;
+	pthread_mutex_unlock(&bus->request_mutex);
 
 	pulseaudio_signal(0);
 }
 
+/* runs on the mainloop thread, which is the only one touching attr after
+ * the stream is connected */
 static void pulseaudio_underflow(pa_stream *p, void *userdata)
 {
-	UNUSED_PARAMETER(p);
-	PULSE_DATA(userdata);
+	struct monitor_bus *bus = userdata;
+	uint32_t max_length = (uint32_t)pa_usec_to_bytes(
+		MAX_LATENCY_MS * 1000, pa_stream_get_sample_spec(p));
 
-	pthread_mutex_lock(&data->playback_mutex);
-	if (obs_source_active(data->source))
-		data->attr.tlength = (data->attr.tlength * 3) / 2;
+	if (bus->attr.tlength < max_length) {
+		bus->attr.tlength = (bus->attr.tlength * 3) / 2;
+		if (bus->attr.tlength > max_length)
+			bus->attr.tlength = max_length;
 
-	pa_stream_set_buffer_attr(data->stream, &data->attr, NULL, NULL);
-	pthread_mutex_unlock(&data->playback_mutex);
+		pa_stream_set_buffer_attr(bus->stream, &bus->attr, NULL, NULL);
+	}
 
 	pulseaudio_signal(0);
 }
@@ -288,10 +346,10 @@ static void pulseaudio_source_info(pa_context *c, const pa_source_info *i,
 				   int eol, void *userdata)
 {
 	UNUSED_PARAMETER(c);
-	PULSE_DATA(userdata);
+	struct monitor_bus *bus = userdata;
 	// An error occurred
 	if (eol < 0) {
-		data->format = PA_SAMPLE_INVALID;
+		bus->format = PA_SAMPLE_INVALID;
 		goto skip;
 	}
 	// Terminating call for multi instance callbacks
@@ -323,199 +381,287 @@ static void pulseaudio_source_info(pa_context *c, const pa_source_info *i,
 		     i->sample_spec.channels, channels);
 	}
 
-	data->format = format;
-	data->samples_per_sec = i->sample_spec.rate;
-	data->channels = channels;
+	bus->format = format;
+	bus->samples_per_sec = i->sample_spec.rate;
+	bus->channels = channels;
 skip:
 	pulseaudio_signal(0);
 }
 
-static void pulseaudio_stop_playback(struct audio_monitor *monitor)
+static void pulseaudio_stop_playback(struct monitor_bus *bus)
 {
-	if (monitor->stream) {
+	if (bus->stream) {
 		/* Stop the stream */
 		pulseaudio_lock();
-		pa_stream_disconnect(monitor->stream);
+		pa_stream_disconnect(bus->stream);
 		pulseaudio_unlock();
 
 		/* Remove the callbacks, to ensure we no longer try to do anything
 		 * with this stream object */
-		pulseaudio_write_callback(monitor->stream, NULL, NULL);
-		pulseaudio_set_underflow_callback(monitor->stream, NULL, NULL);
+		pulseaudio_write_callback(bus->stream, NULL, NULL);
+		pulseaudio_set_underflow_callback(bus->stream, NULL, NULL);
 
 		/* Unreference the stream and drop it. PA will free it when it can. */
 		pulseaudio_lock();
-		pa_stream_unref(monitor->stream);
+		pa_stream_unref(bus->stream);
 		pulseaudio_unlock();
-		monitor->stream = NULL;
+		bus->stream = NULL;
 	}
 
-	blog(LOG_INFO, "Stopped Monitoring in '%s'", monitor->device);
+	blog(LOG_INFO, "Stopped Monitoring in '%s'", bus->device);
 	blog(LOG_INFO,
 	     "Got %" PRIuFAST32 " packets with %" PRIuFAST64 " frames",
-	     monitor->packets, monitor->frames);
+	     bus->packets, bus->frames);
 
-	monitor->packets = 0;
-	monitor->frames = 0;
+	bus->packets = 0;
+	bus->frames = 0;
 }
 
-static bool audio_monitor_init(struct audio_monitor *monitor,
-			       obs_source_t *source)
+static bool bus_init(struct monitor_bus *bus)
 {
-	pthread_mutex_init_value(&monitor->playback_mutex);
-
-	monitor->source = source;
-
-	const char *id = obs->audio.monitoring_device_id;
-	if (!id)
-		return false;
-
-	if (source->info.output_flags & OBS_SOURCE_DO_NOT_SELF_MONITOR) {
-		obs_data_t *s = obs_source_get_settings(source);
-		const char *s_dev_id = obs_data_get_string(s, "device_id");
-		bool match = devices_match(s_dev_id, id);
-		obs_data_release(s);
-
-		if (match) {
-			monitor->ignore = true;
-			blog(LOG_INFO, "Prevented feedback-loop in '%s'",
-			     s_dev_id);
-			return true;
-		}
-	}
-
-	pulseaudio_init();
+	const struct audio_output_info *info =
+		audio_output_get_info(obs->audio.audio);
 
-	if (strcmp(id, "default") == 0)
-		get_default_id(&monitor->device);
+	if (strcmp(bus->id, "default") == 0)
+		get_default_id(&bus->device);
 	else
-		monitor->device = bstrdup(id);
+		bus->device = bstrdup(bus->id);
 
-	if (!monitor->device)
+	if (!bus->device)
 		return false;
 
-	if (pulseaudio_get_server_info(pulseaudio_server_info,
-				       (void *)monitor) < 0) {
+	if (pulseaudio_get_server_info(pulseaudio_server_info, (void *)bus) <
+	    0) {
 		blog(LOG_ERROR, "Unable to get server info !");
 		return false;
 	}
 
-	if (pulseaudio_get_source_info(pulseaudio_source_info, monitor->device,
-				       (void *)monitor) < 0) {
+	if (pulseaudio_get_source_info(pulseaudio_source_info, bus->device,
+				       (void *)bus) < 0) {
 		blog(LOG_ERROR, "Unable to get source info !");
 		return false;
 	}
-	if (monitor->format == PA_SAMPLE_INVALID) {
+	if (bus->format == PA_SAMPLE_INVALID) {
 		blog(LOG_ERROR,
 		     "An error occurred while getting the source info!");
 		return false;
 	}
 
 	pa_sample_spec spec;
-	spec.format = monitor->format;
-	spec.rate = (uint32_t)monitor->samples_per_sec;
-	spec.channels = monitor->channels;
+	spec.format = bus->format;
+	spec.rate = (uint32_t)bus->samples_per_sec;
+	spec.channels = bus->channels;
 
 	if (!pa_sample_spec_valid(&spec)) {
 		blog(LOG_ERROR, "Sample spec is not valid");
 		return false;
 	}
 
-	const struct audio_output_info *info =
-		audio_output_get_info(obs->audio.audio);
-
 	struct resample_info from = {.samples_per_sec = info->samples_per_sec,
 				     .speakers = info->speakers,
 				     .format = AUDIO_FORMAT_FLOAT_PLANAR};
 	struct resample_info to = {
-		.samples_per_sec = (uint32_t)monitor->samples_per_sec,
-		.speakers =
-			pulseaudio_channels_to_obs_speakers(monitor->channels),
-		.format = pulseaudio_to_obs_audio_format(monitor->format)};
+		.samples_per_sec = (uint32_t)bus->samples_per_sec,
+		.speakers = pulseaudio_channels_to_obs_speakers(bus->channels),
+		.format = pulseaudio_to_obs_audio_format(bus->format)};
 
-	monitor->resampler = audio_resampler_create(&to, &from);
-	if (!monitor->resampler) {
+	bus->resampler = audio_resampler_create(&to, &from);
+	if (!bus->resampler) {
 		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
 		     "Failed to create resampler");
 		return false;
 	}
 
-	monitor->bytes_per_channel = get_audio_bytes_per_channel(
-		pulseaudio_to_obs_audio_format(monitor->format));
-	monitor->speakers = pulseaudio_channels_to_obs_speakers(spec.channels);
-	monitor->bytes_per_frame = pa_frame_size(&spec);
+	bus->obs_channels = get_audio_channels(info->speakers);
+	bus->chunk_frames = info->samples_per_sec * CHUNK_MS / 1000;
+	bus->max_queued = info->samples_per_sec * MAX_QUEUED_MS / 1000;
+
+	/* one block for the mix planes, then the scratch plane */
+	bus->mix[0] = bmalloc(bus->chunk_frames * (bus->obs_channels + 1) *
+			      sizeof(float));
+	for (size_t ch = 1; ch < bus->obs_channels; ch++)
+		bus->mix[ch] = bus->mix[ch - 1] + bus->chunk_frames;
+	bus->scratch = bus->mix[0] + bus->chunk_frames * bus->obs_channels;
+
+	bus->speakers = pulseaudio_channels_to_obs_speakers(spec.channels);
+	bus->bytes_per_frame = pa_frame_size(&spec);
 
-	pa_channel_map channel_map = pulseaudio_channel_map(monitor->speakers);
+	pa_channel_map channel_map = pulseaudio_channel_map(bus->speakers);
 
-	monitor->stream = pulseaudio_stream_new(
-		obs_source_get_name(monitor->source), &spec, &channel_map);
-	if (!monitor->stream) {
+	bus->stream = pulseaudio_stream_new("OBS Audio Monitor", &spec,
+					    &channel_map);
+	if (!bus->stream) {
 		blog(LOG_ERROR, "Unable to create stream");
 		return false;
 	}
 
-	monitor->attr.fragsize = (uint32_t)-1;
-	monitor->attr.maxlength = (uint32_t)-1;
-	monitor->attr.minreq = (uint32_t)-1;
-	monitor->attr.prebuf = (uint32_t)-1;
-	monitor->attr.tlength = pa_usec_to_bytes(25000, &spec);
-
-	monitor->buffer_size =
-		monitor->bytes_per_frame * pa_usec_to_bytes(5000, &spec);
+	bus->attr.fragsize = (uint32_t)-1;
+	bus->attr.maxlength = (uint32_t)-1;
+	bus->attr.minreq = (uint32_t)-1;
+	bus->attr.prebuf = (uint32_t)-1;
+	bus->attr.tlength =
+		(uint32_t)pa_usec_to_bytes(TARGET_LATENCY_MS * 1000, &spec);
 
 	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
 				  PA_STREAM_AUTO_TIMING_UPDATE;
 
-	if (pthread_mutex_init(&monitor->playback_mutex, NULL) != 0) {
-		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
-		     "Failed to init mutex");
-		return false;
-	}
+	pulseaudio_write_callback(bus->stream, pulseaudio_stream_write,
+				  (void *)bus);
+	pulseaudio_set_underflow_callback(bus->stream, pulseaudio_underflow,
+					  (void *)bus);
 
-	int_fast32_t ret = pulseaudio_connect_playback(
-		monitor->stream, monitor->device, &monitor->attr, flags);
+	int_fast32_t ret = pulseaudio_connect_playback(bus->stream, bus->device,
+						       &bus->attr, flags);
 	if (ret < 0) {
-		pulseaudio_stop_playback(monitor);
+		pulseaudio_stop_playback(bus);
 		blog(LOG_ERROR, "Unable to connect to stream");
 		return false;
 	}
 
-	blog(LOG_INFO, "Started Monitoring in '%s'", monitor->device);
+	blog(LOG_INFO, "Started Monitoring in '%s'", bus->device);
 	return true;
 }
 
+static void bus_free(struct monitor_bus *bus)
+{
+	if (bus->stream)
+		pulseaudio_stop_playback(bus);
+	pulseaudio_unref();
+
+	audio_resampler_destroy(bus->resampler);
+	da_free(bus->inputs);
+	pthread_mutex_destroy(&bus->mutex);
+	pthread_mutex_destroy(&bus->request_mutex);
+	bfree(bus->mix[0]);
+	bfree(bus->device);
+	bfree(bus->id);
+	bfree(bus);
+}
+
+static struct monitor_bus *bus_acquire(const char *id)
+{
+	struct monitor_bus *bus = NULL;
+
+	pthread_mutex_lock(&buses_mutex);
+
+	for (size_t i = 0; i < buses.num; i++) {
+		if (strcmp(buses.array[i]->id, id) == 0) {
+			bus = buses.array[i];
+			bus->refs++;
+			goto unlock;
+		}
+	}
+
+	bus = bzalloc(sizeof(*bus));
+	bus->id = bstrdup(id);
+	bus->refs = 1;
+	pthread_mutex_init_value(&bus->mutex);
+	pthread_mutex_init_value(&bus->request_mutex);
+	pulseaudio_init();
+
+	if (pthread_mutex_init(&bus->mutex, NULL) != 0 ||
+	    pthread_mutex_init(&bus->request_mutex, NULL) != 0) {
+		blog(LOG_WARNING, "%s: %s", __FUNCTION__,
+		     "Failed to init mutex");
+		bus_free(bus);
+		bus = NULL;
+		goto unlock;
+	}
+
+	if (!bus_init(bus)) {
+		bus_free(bus);
+		bus = NULL;
+		goto unlock;
+	}
+
+	da_push_back(buses, &bus);
+
+unlock:
+	pthread_mutex_unlock(&buses_mutex);
+	return bus;
+}
+
+static void bus_release(struct monitor_bus *bus)
+{
+	bool destroy;
+
+	pthread_mutex_lock(&buses_mutex);
+	destroy = --bus->refs == 0;
+	if (destroy) {
+		da_erase_item(buses, &bus);
+		if (!buses.num)
+			da_free(buses);
+	}
+	pthread_mutex_unlock(&buses_mutex);
+
+	if (destroy)
+		bus_free(bus);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool audio_monitor_init(struct audio_monitor *monitor,
+			       obs_source_t *source)
+{
+	monitor->source = source;
+
+	const char *id = obs->audio.monitoring_device_id;
+	if (!id)
+		return false;
+
+	if (source->info.output_flags & OBS_SOURCE_DO_NOT_SELF_MONITOR) {
+		obs_data_t *s = obs_source_get_settings(source);
+		const char *s_dev_id = obs_data_get_string(s, "device_id");
+		bool match = devices_match(s_dev_id, id);
+		obs_data_release(s);
+
+		if (match) {
+			monitor->ignore = true;
+			blog(LOG_INFO, "Prevented feedback-loop in '%s'",
+			     s_dev_id);
+			return true;
+		}
+	}
+
+	monitor->bus = bus_acquire(id);
+	return monitor->bus != NULL;
+}
+
 static void audio_monitor_init_final(struct audio_monitor *monitor)
 {
+	struct monitor_bus *bus = monitor->bus;
+
 	if (monitor->ignore)
 		return;
 
+	pthread_mutex_lock(&bus->mutex);
+	da_push_back(bus->inputs, &monitor);
+	pthread_mutex_unlock(&bus->mutex);
+
 	obs_source_add_audio_capture_callback(monitor->source,
 					      on_audio_playback, monitor);
-
-	pulseaudio_write_callback(monitor->stream, pulseaudio_stream_write,
-				  (void *)monitor);
-
-	pulseaudio_set_underflow_callback(monitor->stream, pulseaudio_underflow,
-					  (void *)monitor);
 }
 
 static inline void audio_monitor_free(struct audio_monitor *monitor)
 {
-	if (monitor->ignore)
+	struct monitor_bus *bus = monitor->bus;
+
+	if (monitor->ignore || !bus)
 		return;
 
 	if (monitor->source)
 		obs_source_remove_audio_capture_callback(
 			monitor->source, on_audio_playback, monitor);
 
-	audio_resampler_destroy(monitor->resampler);
-	circlebuf_free(&monitor->new_data);
+	pthread_mutex_lock(&bus->mutex);
+	da_erase_item(bus->inputs, &monitor);
+	pthread_mutex_unlock(&bus->mutex);
 
-	if (monitor->stream)
-		pulseaudio_stop_playback(monitor);
-	pulseaudio_unref();
+	for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++)
+		circlebuf_free(&monitor->queued[ch]);
 
-	bfree(monitor->device);
+	bus_release(bus);
+	monitor->bus = NULL;
 }
 
 struct audio_monitor *audio_monitor_create(obs_source_t *source)
@@ -543,18 +689,17 @@ fail:
 void audio_monitor_reset(struct audio_monitor *monitor)
 {
 	struct audio_monitor new_monitor = {0};
-	bool success;
-	audio_monitor_free(monitor);
+	obs_source_t *source = monitor->source;
 
-	pthread_mutex_lock(&monitor->playback_mutex);
-	success = audio_monitor_init(&new_monitor, monitor->source);
-	pthread_mutex_unlock(&monitor->playback_mutex);
+	audio_monitor_free(monitor);
 
-	if (success) {
+	if (audio_monitor_init(&new_monitor, source)) {
 		*monitor = new_monitor;
 		audio_monitor_init_final(monitor);
 	} else {
 		audio_monitor_free(&new_monitor);
+		memset(monitor, 0, sizeof(*monitor));
+		monitor->source = source;
 	}
 }
 
@@ -18,6 +18,7 @@
 
 #include "../util/bmem.h"
 #include "../util/base.h"
+#include "../util/threading.h"
 
 #include "calldata.h"
 
@@ -65,8 +66,11 @@ static inline const char *cd_serialize_string(uint8_t **pos)
 	return (size != 0) ? str : NULL;
 }
 
+/* the stored name sizes are compared first, so that the names of most other
+ * parameters are never looked at */
 static bool cd_getparam(const calldata_t *data, const char *name, uint8_t **pos)
 {
+	const size_t name_len = strlen(name) + 1;
 	size_t name_size;
 
 	if (!data->size)
@@ -80,7 +84,8 @@ static bool cd_getparam(const calldata_t *data, const char *name, uint8_t **pos)
 		size_t param_size;
 
 		*pos += name_size;
-		if (strcmp(param_name, name) == 0)
+		if (name_size == name_len &&
+		    memcmp(param_name, name, name_len) == 0)
 			return true;
 
 		param_size = cd_serialize_size(pos);
@@ -115,6 +120,26 @@ static inline void cd_copy_data(uint8_t **pos, const void *in, size_t size)
 	}
 }
 
+static pthread_once_t calldata_tag_once = PTHREAD_ONCE_INIT;
+static int calldata_tag = 0;
+
+static void register_calldata_tag(void)
+{
+	calldata_tag = bmem_register_tag("calldata");
+}
+
+/* the stacks are tagged apart from the rest of the thread's blocks */
+static uint8_t *cd_alloc(uint8_t *stack, size_t capacity)
+{
+	int prev_tag;
+
+	pthread_once(&calldata_tag_once, register_calldata_tag);
+	prev_tag = bmem_set_thread_tag(calldata_tag);
+	stack = brealloc(stack, capacity);
+	bmem_set_thread_tag(prev_tag);
+	return stack;
+}
+
 static inline void cd_set_first_param(calldata_t *data, const char *name,
 				      const void *in, size_t size)
 {
@@ -129,7 +154,7 @@ static inline void cd_set_first_param(calldata_t *data, const char *name,
 		capacity = 128;
 
 	data->capacity = capacity;
-	data->stack = bmalloc(capacity);
+	data->stack = cd_alloc(NULL, capacity);
 
 	pos = data->stack;
 	cd_copy_string(&pos, name, name_len);
@@ -145,7 +170,7 @@ static inline bool cd_ensure_capacity(calldata_t *data, uint8_t **pos,
 
 	if (new_size < data->capacity)
 		return true;
-	if (data->fixed) {
+	if (data->fixed && !data->growable) {
 		blog(LOG_ERROR, "Tried to go above fixed calldata stack size!");
 		return false;
 	}
@@ -156,7 +181,17 @@ static inline bool cd_ensure_capacity(calldata_t *data, uint8_t **pos,
 	if (new_capacity < new_size)
 		new_capacity = new_size;
 
-	data->stack = brealloc(data->stack, new_capacity);
+	if (data->fixed) {
+		uint8_t *stack = cd_alloc(NULL, new_capacity);
+		memcpy(stack, data->stack, data->size);
+
+		data->stack = stack;
+		data->fixed = false;
+		data->growable = false;
+	} else {
+		data->stack = cd_alloc(data->stack, new_capacity);
+	}
+
 	data->capacity = new_capacity;
 
 	*pos = data->stack + offset;
@@ -234,6 +269,56 @@ void calldata_set_data(calldata_t *data, const char *name, const void *in,
 	}
 }
 
+size_t calldata_add_data(calldata_t *data, const char *name, const void *in,
+			 size_t size)
+{
+	uint8_t *pos;
+	size_t name_len;
+
+	if (!data || !name || !*name)
+		return CALLDATA_INVALID;
+
+	name_len = strlen(name) + 1;
+
+	if (!data->fixed && !data->stack) {
+		cd_set_first_param(data, name, in, size);
+		return sizeof(size_t) + name_len;
+	}
+
+	/* the stack always ends with the terminating size */
+	pos = data->stack + data->size - sizeof(size_t);
+	if (!cd_ensure_capacity(data, &pos,
+				data->size + name_len + size +
+					sizeof(size_t) * 2))
+		return CALLDATA_INVALID;
+
+	data->size += name_len + size + sizeof(size_t) * 2;
+
+	cd_copy_string(&pos, name, name_len);
+	cd_copy_data(&pos, in, size);
+	memset(pos, 0, sizeof(size_t));
+
+	return pos - data->stack - size - sizeof(size_t);
+}
+
+bool calldata_get_data_at(const calldata_t *data, size_t pos, void *out,
+			  size_t size)
+{
+	size_t data_size;
+
+	if (!data || pos == CALLDATA_INVALID ||
+	    pos + sizeof(size_t) > data->size)
+		return false;
+
+	memcpy(&data_size, data->stack + pos, sizeof(size_t));
+	if (data_size != size ||
+	    pos + sizeof(size_t) + size > data->size)
+		return false;
+
+	memcpy(out, data->stack + pos + sizeof(size_t), size);
+	return true;
+}
+
 bool calldata_get_string(const calldata_t *data, const char *name,
 			 const char **str)
 {
@@ -48,6 +48,7 @@ struct calldata {
 	size_t size;     /* size of the stack, in bytes */
 	size_t capacity; /* capacity of the stack, in bytes */
 	bool fixed;      /* fixed size (using call stack) */
+	bool growable;   /* moves to the heap once the call stack is full */
 };
 
 typedef struct calldata calldata_t;
@@ -65,10 +66,20 @@ static inline void calldata_init_fixed(struct calldata *data, uint8_t *stack,
 	data->stack = stack;
 	data->capacity = size;
 	data->fixed = true;
+	data->growable = false;
 	data->size = 0;
 	calldata_clear(data);
 }
 
+/* like calldata_init_fixed, but parameters that don't fit the call stack move
+ * the data to the heap instead of failing; calldata_free must be called */
+static inline void calldata_init_stack(struct calldata *data, uint8_t *stack,
+				       size_t size)
+{
+	calldata_init_fixed(data, stack, size);
+	data->growable = true;
+}
+
 static inline void calldata_free(struct calldata *data)
 {
 	if (!data->fixed)
@@ -80,6 +91,21 @@ EXPORT bool calldata_get_data(const calldata_t *data, const char *name,
 EXPORT void calldata_set_data(calldata_t *data, const char *name,
 			      const void *in, size_t new_size);
 
+/*
+ * Position based access
+ *
+ *   calldata_add_* append a parameter that is not set yet without searching
+ * for it, and return its position for getting it again without a search.
+ * A position stays valid until a parameter before it changes size.
+ */
+
+#define CALLDATA_INVALID ((size_t)-1)
+
+EXPORT size_t calldata_add_data(calldata_t *data, const char *name,
+				const void *in, size_t size);
+EXPORT bool calldata_get_data_at(const calldata_t *data, size_t pos,
+				 void *out, size_t size);
+
 static inline void calldata_clear(struct calldata *data)
 {
 	if (data->stack) {
@@ -204,6 +230,67 @@ static inline void calldata_set_string(calldata_t *data, const char *name,
 		calldata_set_data(data, name, NULL, 0);
 }
 
+/* ------------------------------------------------------------------------- */
+
+static inline size_t calldata_add_int(calldata_t *data, const char *name,
+				      long long val)
+{
+	return calldata_add_data(data, name, &val, sizeof(val));
+}
+
+static inline size_t calldata_add_float(calldata_t *data, const char *name,
+					double val)
+{
+	return calldata_add_data(data, name, &val, sizeof(val));
+}
+
+static inline size_t calldata_add_bool(calldata_t *data, const char *name,
+				       bool val)
+{
+	return calldata_add_data(data, name, &val, sizeof(val));
+}
+
+static inline size_t calldata_add_ptr(calldata_t *data, const char *name,
+				      void *ptr)
+{
+	return calldata_add_data(data, name, &ptr, sizeof(ptr));
+}
+
+static inline size_t calldata_add_string(calldata_t *data, const char *name,
+					 const char *str)
+{
+	return str ? calldata_add_data(data, name, str, strlen(str) + 1)
+		   : calldata_add_data(data, name, NULL, 0);
+}
+
+static inline long long calldata_int_at(const calldata_t *data, size_t pos)
+{
+	long long val = 0;
+	calldata_get_data_at(data, pos, &val, sizeof(val));
+	return val;
+}
+
+static inline double calldata_float_at(const calldata_t *data, size_t pos)
+{
+	double val = 0.0;
+	calldata_get_data_at(data, pos, &val, sizeof(val));
+	return val;
+}
+
+static inline bool calldata_bool_at(const calldata_t *data, size_t pos)
+{
+	bool val = false;
+	calldata_get_data_at(data, pos, &val, sizeof(val));
+	return val;
+}
+
+static inline void *calldata_ptr_at(const calldata_t *data, size_t pos)
+{
+	void *val = NULL;
+	calldata_get_data_at(data, pos, &val, sizeof(val));
+	return val;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,70 +16,124 @@
 
 #include "../util/darray.h"
 #include "../util/threading.h"
+#include "../util/platform.h"
 
 #include "decl.h"
 #include "signal.h"
 
+/*
+ * Signals are emitted without taking any locks: the callbacks of a signal are
+ * an immutable list that is replaced as a whole when a callback is connected
+ * or disconnected.  Emitters announce themselves in one of two reader
+ * counters before loading the list, which lets a replaced list be freed (and
+ * a disconnect return) once every emission that may still be using it has
+ * finished.
+ */
+
 struct signal_callback {
 	signal_callback_t callback;
 	void *data;
-	bool remove;
+	volatile bool remove;
 	bool keep_ref;
 };
 
+struct signal_callbacks {
+	size_t num;
+	struct signal_callback *array;
+};
+
 struct signal_info {
 	struct decl_info func;
-	DARRAY(struct signal_callback) callbacks;
+
+	struct signal_callbacks *volatile callbacks;
+	DARRAY(struct signal_callbacks *) retired;
 	pthread_mutex_t mutex;
-	bool signalling;
 
-	struct signal_info *next;
+	/* emissions count themselves in the reader counter of the current
+	 * phase; waiting for the readers flips the phase twice */
+	volatile long phase;
+	volatile long readers[2];
+	pthread_mutex_t sync_mutex;
+
+	struct signal_info *volatile next;
 };
 
-static inline struct signal_info *signal_info_create(struct decl_info *info)
+/* emissions in progress on the current thread, innermost first */
+struct signal_emission {
+	struct signal_info *sig;
+	struct signal_callbacks *callbacks;
+	long remove_refs;
+	struct signal_emission *prev;
+};
+
+static THREAD_LOCAL struct signal_emission *current_emission = NULL;
+
+static inline struct signal_callbacks *
+load_callbacks(struct signal_info *sig)
 {
-	pthread_mutexattr_t attr;
-	struct signal_info *si;
+	return os_atomic_load_ptr((void *const volatile *)&sig->callbacks);
+}
 
-	if (pthread_mutexattr_init(&attr) != 0)
-		return NULL;
-	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
-		return NULL;
+static inline struct signal_info *load_signal(struct signal_info *volatile *p)
+{
+	return os_atomic_load_ptr((void *const volatile *)p);
+}
+
+static inline void store_signal(struct signal_info *volatile *p,
+				struct signal_info *sig)
+{
+	os_atomic_exchange_ptr((void *volatile *)p, sig);
+}
 
-	si = bmalloc(sizeof(struct signal_info));
+static inline struct signal_info *signal_info_create(struct decl_info *info)
+{
+	struct signal_info *si;
 
+	si = bzalloc(sizeof(struct signal_info));
 	si->func = *info;
-	si->next = NULL;
-	si->signalling = false;
-	da_init(si->callbacks);
 
-	if (pthread_mutex_init(&si->mutex, &attr) != 0) {
+	if (pthread_mutex_init(&si->mutex, NULL) != 0) {
 		blog(LOG_ERROR, "Could not create signal");
-
-		decl_info_free(&si->func);
-		bfree(si);
-		return NULL;
+		goto fail;
+	}
+	if (pthread_mutex_init(&si->sync_mutex, NULL) != 0) {
+		blog(LOG_ERROR, "Could not create signal");
+		pthread_mutex_destroy(&si->mutex);
+		goto fail;
 	}
 
 	return si;
+
+fail:
+	decl_info_free(&si->func);
+	bfree(si);
+	return NULL;
 }
 
 static inline void signal_info_destroy(struct signal_info *si)
 {
 	if (si) {
+		for (size_t i = 0; i < si->retired.num; i++)
+			bfree(si->retired.array[i]);
+
+		pthread_mutex_destroy(&si->sync_mutex);
 		pthread_mutex_destroy(&si->mutex);
 		decl_info_free(&si->func);
-		da_free(si->callbacks);
+		da_free(si->retired);
+		bfree(si->callbacks);
 		bfree(si);
 	}
 }
 
-static inline size_t signal_get_callback_idx(struct signal_info *si,
-					     signal_callback_t callback,
-					     void *data)
+static inline size_t
+signal_get_callback_idx(const struct signal_callbacks *callbacks,
+			signal_callback_t callback, void *data)
 {
-	for (size_t i = 0; i < si->callbacks.num; i++) {
-		struct signal_callback *sc = si->callbacks.array + i;
+	if (!callbacks)
+		return DARRAY_INVALID;
+
+	for (size_t i = 0; i < callbacks->num; i++) {
+		struct signal_callback *sc = callbacks->array + i;
 
 		if (sc->callback == callback && sc->data == data)
 			return i;
@@ -88,6 +142,158 @@ static inline size_t signal_get_callback_idx(struct signal_info *si,
 	return DARRAY_INVALID;
 }
 
+/* copies the callbacks with the callback at idx left out (DARRAY_INVALID to
+ * keep all of them) and room for one more at the end */
+static struct signal_callbacks *
+copy_callbacks(const struct signal_callbacks *callbacks, size_t skip,
+	       size_t extra)
+{
+	struct signal_callbacks *copy;
+	size_t num = 0;
+
+	if (callbacks)
+		num = callbacks->num - (skip != DARRAY_INVALID ? 1 : 0);
+	if (!num && !extra)
+		return NULL;
+
+	copy = bmalloc(sizeof(struct signal_callbacks) +
+		       (num + extra) * sizeof(struct signal_callback));
+	copy->array = (struct signal_callback *)(copy + 1);
+	copy->num = 0;
+
+	for (size_t i = 0; callbacks && i < callbacks->num; i++) {
+		const struct signal_callback *cb = callbacks->array + i;
+		struct signal_callback *dst;
+
+		if (i == skip)
+			continue;
+
+		dst = copy->array + copy->num++;
+		dst->callback = cb->callback;
+		dst->data = cb->data;
+		dst->remove = false;
+		dst->keep_ref = cb->keep_ref;
+	}
+
+	return copy;
+}
+
+static inline bool emitting_signal(struct signal_info *sig)
+{
+	for (struct signal_emission *emission = current_emission; emission;
+	     emission = emission->prev) {
+		if (emission->sig == sig)
+			return true;
+	}
+
+	return false;
+}
+
+static inline bool no_readers(struct signal_info *sig)
+{
+	return !os_atomic_load_long(&sig->readers[0]) &&
+	       !os_atomic_load_long(&sig->readers[1]);
+}
+
+/* publishes the new callbacks.  the old list is freed right away if no
+ * emission is in progress, otherwise by the next wait for the readers.
+ * assumes mutex */
+static void replace_callbacks(struct signal_info *sig,
+			      struct signal_callbacks *callbacks)
+{
+	struct signal_callbacks *old = os_atomic_exchange_ptr(
+		(void *volatile *)&sig->callbacks, callbacks);
+
+	if (old)
+		da_push_back(sig->retired, &old);
+
+	if (sig->retired.num && no_readers(sig)) {
+		for (size_t i = 0; i < sig->retired.num; i++)
+			bfree(sig->retired.array[i]);
+		da_resize(sig->retired, 0);
+	}
+}
+
+/* waits until every emission that started before the call has finished, and
+ * frees the lists they may have been using.  must not be called while the
+ * current thread is emitting the signal */
+static void wait_for_readers(struct signal_info *sig)
+{
+	DARRAY(struct signal_callbacks *) retired;
+
+	da_init(retired);
+
+	pthread_mutex_lock(&sig->mutex);
+	da_move(retired, sig->retired);
+	pthread_mutex_unlock(&sig->mutex);
+
+	pthread_mutex_lock(&sig->sync_mutex);
+
+	for (int i = 0; i < 2; i++) {
+		long phase = (os_atomic_inc_long(&sig->phase) - 1) & 1;
+
+		while (os_atomic_load_long(&sig->readers[phase]))
+			os_sleep_ms(1);
+	}
+
+	pthread_mutex_unlock(&sig->sync_mutex);
+
+	for (size_t i = 0; i < retired.num; i++)
+		bfree(retired.array[i]);
+	da_free(retired);
+}
+
+/* marks the callback in the emissions of the current thread, so that they
+ * don't call it after it has been disconnected.  returns the innermost of
+ * those emissions */
+static struct signal_emission *
+remove_from_emissions(struct signal_info *sig, signal_callback_t callback,
+		      void *data)
+{
+	struct signal_emission *innermost = NULL;
+
+	for (struct signal_emission *emission = current_emission; emission;
+	     emission = emission->prev) {
+		size_t idx;
+
+		if (emission->sig != sig)
+			continue;
+		if (!innermost)
+			innermost = emission;
+
+		idx = signal_get_callback_idx(emission->callbacks, callback,
+					      data);
+		if (idx != DARRAY_INVALID)
+			os_atomic_store_bool(
+				&emission->callbacks->array[idx].remove, true);
+	}
+
+	return innermost;
+}
+
+/* returns true if the callback was connected, and whether it held a
+ * reference to the handler */
+static bool remove_callback(struct signal_info *sig,
+			    signal_callback_t callback, void *data,
+			    bool *keep_ref)
+{
+	struct signal_callbacks *callbacks;
+	size_t idx;
+
+	pthread_mutex_lock(&sig->mutex);
+
+	callbacks = load_callbacks(sig);
+	idx = signal_get_callback_idx(callbacks, callback, data);
+	if (idx != DARRAY_INVALID) {
+		*keep_ref = callbacks->array[idx].keep_ref;
+		replace_callbacks(sig, copy_callbacks(callbacks, idx, 0));
+	}
+
+	pthread_mutex_unlock(&sig->mutex);
+
+	return idx != DARRAY_INVALID;
+}
+
 struct global_callback_info {
 	global_signal_callback_t callback;
 	void *data;
@@ -96,27 +302,30 @@ struct global_callback_info {
 };
 
 struct signal_handler {
-	struct signal_info *first;
+	struct signal_info *volatile first;
 	pthread_mutex_t mutex;
 	volatile long refs;
 
 	DARRAY(struct global_callback_info) global_callbacks;
 	pthread_mutex_t global_callbacks_mutex;
+	volatile long num_global_callbacks;
 };
 
+/* signals are only ever appended, so the list can be searched without the
+ * handler mutex */
 static struct signal_info *getsignal(signal_handler_t *handler,
 				     const char *name,
 				     struct signal_info **p_last)
 {
 	struct signal_info *signal, *last = NULL;
 
-	signal = handler->first;
+	signal = load_signal(&handler->first);
 	while (signal != NULL) {
 		if (strcmp(signal->func.name, name) == 0)
 			break;
 
 		last = signal;
-		signal = signal->next;
+		signal = load_signal(&signal->next);
 	}
 
 	if (p_last)
@@ -196,10 +405,12 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 		success = false;
 	} else {
 		sig = signal_info_create(&func);
-		if (!last)
-			handler->first = sig;
+		if (!sig)
+			success = false;
+		else if (!last)
+			store_signal(&handler->first, sig);
 		else
-			last->next = sig;
+			store_signal(&last->next, sig);
 	}
 
 	pthread_mutex_unlock(&handler->mutex);
@@ -212,17 +423,15 @@ static void signal_handler_connect_internal(signal_handler_t *handler,
 					    signal_callback_t callback,
 					    void *data, bool keep_ref)
 {
-	struct signal_info *sig, *last;
+	struct signal_info *sig;
+	struct signal_callbacks *callbacks;
 	struct signal_callback cb_data = {callback, data, false, keep_ref};
 	size_t idx;
 
 	if (!handler)
 		return;
 
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, signal, &last);
-	pthread_mutex_unlock(&handler->mutex);
-
+	sig = getsignal(handler, signal, NULL);
 	if (!sig) {
 		blog(LOG_WARNING,
 		     "signal_handler_connect: "
@@ -238,9 +447,14 @@ static void signal_handler_connect_internal(signal_handler_t *handler,
 	if (keep_ref)
 		os_atomic_inc_long(&handler->refs);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (keep_ref || idx == DARRAY_INVALID)
-		da_push_back(sig->callbacks, &cb_data);
+	callbacks = load_callbacks(sig);
+	idx = signal_get_callback_idx(callbacks, callback, data);
+	if (keep_ref || idx == DARRAY_INVALID) {
+		struct signal_callbacks *copy =
+			copy_callbacks(callbacks, DARRAY_INVALID, 1);
+		copy->array[copy->num++] = cb_data;
+		replace_callbacks(sig, copy);
+	}
 
 	pthread_mutex_unlock(&sig->mutex);
 }
@@ -257,44 +471,35 @@ void signal_handler_connect_ref(signal_handler_t *handler, const char *signal,
 	signal_handler_connect_internal(handler, signal, callback, data, true);
 }
 
-static inline struct signal_info *getsignal_locked(signal_handler_t *handler,
-						   const char *name)
+static inline struct signal_info *lookup_signal(signal_handler_t *handler,
+						const char *name)
 {
-	struct signal_info *sig;
-
-	if (!handler)
-		return NULL;
-
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, name, NULL);
-	pthread_mutex_unlock(&handler->mutex);
-
-	return sig;
+	return handler ? getsignal(handler, name, NULL) : NULL;
 }
 
 void signal_handler_disconnect(signal_handler_t *handler, const char *signal,
 			       signal_callback_t callback, void *data)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
+	struct signal_info *sig = lookup_signal(handler, signal);
 	bool keep_ref = false;
-	size_t idx;
 
 	if (!sig)
 		return;
+	if (!remove_callback(sig, callback, data, &keep_ref))
+		return;
 
-	pthread_mutex_lock(&sig->mutex);
-
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx != DARRAY_INVALID) {
-		if (sig->signalling) {
-			sig->callbacks.array[idx].remove = true;
-		} else {
-			keep_ref = sig->callbacks.array[idx].keep_ref;
-			da_erase(sig->callbacks, idx);
-		}
+	/* emissions of the signal further up the stack can't be waited for,
+	 * they skip the callback instead, and the handler reference is only
+	 * released once they are done */
+	if (emitting_signal(sig)) {
+		struct signal_emission *emission =
+			remove_from_emissions(sig, callback, data);
+		if (keep_ref)
+			emission->remove_refs++;
+		return;
 	}
 
-	pthread_mutex_unlock(&sig->mutex);
+	wait_for_readers(sig);
 
 	if (keep_ref && os_atomic_dec_long(&handler->refs) == 0) {
 		signal_handler_actually_destroy(handler);
@@ -306,47 +511,71 @@ static THREAD_LOCAL struct global_callback_info *current_global_cb = NULL;
 
 void signal_handler_remove_current(void)
 {
-	if (current_signal_cb)
-		current_signal_cb->remove = true;
-	else if (current_global_cb)
-		current_global_cb->remove = true;
-}
+	if (current_signal_cb) {
+		struct signal_callback *cb = current_signal_cb;
+		struct signal_emission *emission = current_emission;
+		bool keep_ref = false;
 
-void signal_handler_signal(signal_handler_t *handler, const char *signal,
-			   calldata_t *params)
-{
-	struct signal_info *sig = getsignal_locked(handler, signal);
-	long remove_refs = 0;
+		if (os_atomic_exchange_bool(&cb->remove, true))
+			return;
 
-	if (!sig)
-		return;
+		if (remove_callback(emission->sig, cb->callback, cb->data,
+				    &keep_ref) &&
+		    keep_ref)
+			emission->remove_refs++;
 
-	pthread_mutex_lock(&sig->mutex);
-	sig->signalling = true;
+	} else if (current_global_cb) {
+		current_global_cb->remove = true;
+	}
+}
 
-	for (size_t i = 0; i < sig->callbacks.num; i++) {
-		struct signal_callback *cb = sig->callbacks.array + i;
-		if (!cb->remove) {
+static long emit_callbacks(struct signal_info *sig, calldata_t *params)
+{
+	struct global_callback_info *prev_global_cb = current_global_cb;
+	struct signal_callback *prev_signal_cb = current_signal_cb;
+	struct signal_emission emission = {0};
+	struct signal_callbacks *callbacks;
+	long phase;
+
+	if (!load_callbacks(sig))
+		return 0;
+
+	phase = os_atomic_load_long(&sig->phase) & 1;
+	os_atomic_inc_long(&sig->readers[phase]);
+
+	callbacks = load_callbacks(sig);
+	emission.sig = sig;
+	emission.callbacks = callbacks;
+	emission.prev = current_emission;
+	current_emission = &emission;
+	current_global_cb = NULL;
+
+	for (size_t i = 0; callbacks && i < callbacks->num; i++) {
+		struct signal_callback *cb = callbacks->array + i;
+		if (!os_atomic_load_bool(&cb->remove)) {
 			current_signal_cb = cb;
 			cb->callback(cb->data, params);
-			current_signal_cb = NULL;
 		}
 	}
 
-	for (size_t i = sig->callbacks.num; i > 0; i--) {
-		struct signal_callback *cb = sig->callbacks.array + i - 1;
-		if (cb->remove) {
-			if (cb->keep_ref)
-				remove_refs++;
+	current_signal_cb = prev_signal_cb;
+	current_global_cb = prev_global_cb;
+	current_emission = emission.prev;
 
-			da_erase(sig->callbacks, i - 1);
-		}
-	}
+	os_atomic_dec_long(&sig->readers[phase]);
+	return emission.remove_refs;
+}
 
-	sig->signalling = false;
-	pthread_mutex_unlock(&sig->mutex);
+static void emit_global(signal_handler_t *handler, const char *signal,
+			calldata_t *params)
+{
+	struct signal_callback *prev_signal_cb = current_signal_cb;
+
+	if (!os_atomic_load_long(&handler->num_global_callbacks))
+		return;
 
 	pthread_mutex_lock(&handler->global_callbacks_mutex);
+	current_signal_cb = NULL;
 
 	if (handler->global_callbacks.num) {
 		for (size_t i = 0; i < handler->global_callbacks.num; i++) {
@@ -354,10 +583,13 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal,
 				handler->global_callbacks.array + i;
 
 			if (!cb->remove) {
+				struct global_callback_info *prev =
+					current_global_cb;
+
 				cb->signaling++;
 				current_global_cb = cb;
 				cb->callback(cb->data, signal, params);
-				current_global_cb = NULL;
+				current_global_cb = prev;
 				cb->signaling--;
 			}
 		}
@@ -369,15 +601,41 @@ void signal_handler_signal(signal_handler_t *handler, const char *signal,
 			if (cb->remove && !cb->signaling)
 				da_erase(handler->global_callbacks, i - 1);
 		}
+
+		os_atomic_store_long(&handler->num_global_callbacks,
+				     (long)handler->global_callbacks.num);
 	}
 
+	current_signal_cb = prev_signal_cb;
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+}
 
-	if (remove_refs) {
-		os_atomic_set_long(&handler->refs,
-				   os_atomic_load_long(&handler->refs) -
-					   remove_refs);
-	}
+void signal_handler_signal_handle(signal_handler_t *handler,
+				  signal_handle_t *handle, calldata_t *params)
+{
+	long remove_refs;
+
+	if (!handler || !handle)
+		return;
+
+	remove_refs = emit_callbacks(handle, params);
+	emit_global(handler, handle->func.name, params);
+
+	while (remove_refs--)
+		os_atomic_dec_long(&handler->refs);
+}
+
+void signal_handler_signal(signal_handler_t *handler, const char *signal,
+			   calldata_t *params)
+{
+	signal_handler_signal_handle(handler, lookup_signal(handler, signal),
+				     params);
+}
+
+signal_handle_t *signal_handler_get_handle(signal_handler_t *handler,
+					   const char *signal)
+{
+	return lookup_signal(handler, signal);
 }
 
 void signal_handler_connect_global(signal_handler_t *handler,
@@ -396,6 +654,9 @@ void signal_handler_connect_global(signal_handler_t *handler,
 	if (idx == DARRAY_INVALID)
 		da_push_back(handler->global_callbacks, &cb_data);
 
+	os_atomic_store_long(&handler->num_global_callbacks,
+			     (long)handler->global_callbacks.num);
+
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 }
 
@@ -422,5 +683,8 @@ void signal_handler_disconnect_global(signal_handler_t *handler,
 			da_erase(handler->global_callbacks, idx);
 	}
 
+	os_atomic_store_long(&handler->num_global_callbacks,
+			     (long)handler->global_callbacks.num);
+
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 }
@@ -33,6 +33,7 @@ extern "C" {
 
 struct signal_handler;
 typedef struct signal_handler signal_handler_t;
+typedef struct signal_info signal_handle_t;
 typedef void (*global_signal_callback_t)(void *, const char *, calldata_t *);
 typedef void (*signal_callback_t)(void *, calldata_t *);
 
@@ -78,6 +79,17 @@ EXPORT void signal_handler_remove_current(void);
 EXPORT void signal_handler_signal(signal_handler_t *handler, const char *signal,
 				  calldata_t *params);
 
+/*
+ * Handles refer to a signal of a handler directly, so that frequently emitted
+ * signals don't have to be looked up by name.  A handle stays valid for as
+ * long as the handler it was taken from.
+ */
+EXPORT signal_handle_t *signal_handler_get_handle(signal_handler_t *handler,
+						  const char *signal);
+EXPORT void signal_handler_signal_handle(signal_handler_t *handler,
+					 signal_handle_t *handle,
+					 calldata_t *params);
+
 #ifdef __cplusplus
 }
 #endif
@@ -177,6 +177,10 @@ EXPORT gs_texture_t *device_texture_create_from_dmabuf(
 	enum gs_color_format color_format, uint32_t n_planes, const int *fds,
 	const uint32_t *strides, const uint32_t *offsets,
 	const uint64_t *modifiers);
+EXPORT bool device_query_dmabuf_modifiers(gs_device_t *device,
+					  enum gs_color_format color_format,
+					  uint64_t **modifiers,
+					  size_t *n_modifiers);
 
 #endif
 
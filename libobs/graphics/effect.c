@@ -23,6 +23,10 @@
 
 void gs_effect_actually_destroy(gs_effect_t *effect)
 {
+	graphics_t *graphics = effect->graphics;
+	if (graphics && graphics->sprite_batch.effect == effect)
+		sprite_batch_flush(graphics);
+
 	effect_free(effect);
 	bfree(effect);
 }
@@ -116,6 +116,7 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(device_projection_pop);
 
 	GRAPHICS_IMPORT(gs_swapchain_destroy);
+	GRAPHICS_IMPORT_OPTIONAL(gs_swapchain_ready);
 
 	GRAPHICS_IMPORT(gs_texture_destroy);
 	GRAPHICS_IMPORT(gs_texture_get_width);
@@ -123,6 +124,7 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(gs_texture_get_color_format);
 	GRAPHICS_IMPORT(gs_texture_map);
 	GRAPHICS_IMPORT(gs_texture_unmap);
+	GRAPHICS_IMPORT_OPTIONAL(gs_texture_set_subimage);
 	GRAPHICS_IMPORT_OPTIONAL(gs_texture_is_rect);
 	GRAPHICS_IMPORT(gs_texture_get_obj);
 
@@ -142,6 +144,7 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(gs_stagesurface_get_color_format);
 	GRAPHICS_IMPORT(gs_stagesurface_map);
 	GRAPHICS_IMPORT(gs_stagesurface_unmap);
+	GRAPHICS_IMPORT_OPTIONAL(gs_stagesurface_ready);
 
 	GRAPHICS_IMPORT(gs_zstencil_destroy);
 
@@ -167,6 +170,8 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(gs_timer_range_begin);
 	GRAPHICS_IMPORT(gs_timer_range_end);
 	GRAPHICS_IMPORT(gs_timer_range_get_data);
+	GRAPHICS_IMPORT_OPTIONAL(gs_timer_ready);
+	GRAPHICS_IMPORT_OPTIONAL(gs_timer_range_ready);
 
 	GRAPHICS_IMPORT(gs_shader_destroy);
 	GRAPHICS_IMPORT(gs_shader_get_num_params);
@@ -189,6 +194,11 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(gs_shader_set_next_sampler);
 
 	GRAPHICS_IMPORT_OPTIONAL(device_nv12_available);
+	GRAPHICS_IMPORT_OPTIONAL(device_upload_context_create);
+	GRAPHICS_IMPORT_OPTIONAL(gs_upload_context_destroy);
+	GRAPHICS_IMPORT_OPTIONAL(gs_upload_context_set_image);
+	GRAPHICS_IMPORT_OPTIONAL(gs_upload_context_finish);
+	GRAPHICS_IMPORT_OPTIONAL(gs_upload_context_submit);
 
 	GRAPHICS_IMPORT(device_debug_marker_begin);
 	GRAPHICS_IMPORT(device_debug_marker_end);
@@ -210,6 +220,7 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT_OPTIONAL(gs_duplicator_destroy);
 	GRAPHICS_IMPORT_OPTIONAL(gs_duplicator_update_frame);
 	GRAPHICS_IMPORT_OPTIONAL(gs_duplicator_get_texture);
+	GRAPHICS_IMPORT_OPTIONAL(gs_duplicator_get_frame_serial);
 	GRAPHICS_IMPORT_OPTIONAL(device_texture_create_gdi);
 	GRAPHICS_IMPORT_OPTIONAL(gs_texture_get_dc);
 	GRAPHICS_IMPORT_OPTIONAL(gs_texture_release_dc);
@@ -224,6 +235,7 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT_OPTIONAL(device_unregister_loss_callbacks);
 #elif __linux__
 	GRAPHICS_IMPORT(device_texture_create_from_dmabuf);
+	GRAPHICS_IMPORT_OPTIONAL(device_query_dmabuf_modifiers);
 #endif
 
 	return success;
@@ -22,6 +22,7 @@
 #include "graphics.h"
 #include "matrix3.h"
 #include "matrix4.h"
+#include "vec2.h"
 
 struct gs_exports {
 	const char *(*device_get_name)(void);
@@ -172,6 +173,7 @@ struct gs_exports {
 	void (*device_projection_pop)(gs_device_t *device);
 
 	void (*gs_swapchain_destroy)(gs_swapchain_t *swapchain);
+	bool (*gs_swapchain_ready)(gs_swapchain_t *swapchain);
 
 	void (*gs_texture_destroy)(gs_texture_t *tex);
 	uint32_t (*gs_texture_get_width)(const gs_texture_t *tex);
@@ -181,6 +183,10 @@ struct gs_exports {
 	bool (*gs_texture_map)(gs_texture_t *tex, uint8_t **ptr,
 			       uint32_t *linesize);
 	void (*gs_texture_unmap)(gs_texture_t *tex);
+	bool (*gs_texture_set_subimage)(gs_texture_t *tex, uint32_t x,
+					uint32_t y, uint32_t width,
+					uint32_t height, const uint8_t *data,
+					uint32_t linesize);
 	bool (*gs_texture_is_rect)(const gs_texture_t *tex);
 	void *(*gs_texture_get_obj)(const gs_texture_t *tex);
 
@@ -204,6 +210,7 @@ struct gs_exports {
 	bool (*gs_stagesurface_map)(gs_stagesurf_t *stagesurf, uint8_t **data,
 				    uint32_t *linesize);
 	void (*gs_stagesurface_unmap)(gs_stagesurf_t *stagesurf);
+	bool (*gs_stagesurface_ready)(gs_stagesurf_t *stagesurf);
 
 	void (*gs_zstencil_destroy)(gs_zstencil_t *zstencil);
 
@@ -235,6 +242,8 @@ struct gs_exports {
 	bool (*gs_timer_range_end)(gs_timer_range_t *range);
 	bool (*gs_timer_range_get_data)(gs_timer_range_t *range, bool *disjoint,
 					uint64_t *frequency);
+	bool (*gs_timer_ready)(gs_timer_t *timer);
+	bool (*gs_timer_range_ready)(gs_timer_range_t *range);
 
 	void (*gs_shader_destroy)(gs_shader_t *shader);
 	int (*gs_shader_get_num_params)(const gs_shader_t *shader);
@@ -265,6 +274,16 @@ struct gs_exports {
 
 	bool (*device_nv12_available)(gs_device_t *device);
 
+	gs_upload_context_t *(*device_upload_context_create)(
+		gs_device_t *device);
+	void (*gs_upload_context_destroy)(gs_upload_context_t *context);
+	bool (*gs_upload_context_set_image)(gs_upload_context_t *context,
+					    gs_texture_t *tex,
+					    const uint8_t *data,
+					    uint32_t linesize);
+	bool (*gs_upload_context_finish)(gs_upload_context_t *context);
+	void (*gs_upload_context_submit)(gs_upload_context_t *context);
+
 	void (*device_debug_marker_begin)(gs_device_t *device,
 					  const char *markername,
 					  const float color[4]);
@@ -296,6 +315,7 @@ struct gs_exports {
 
 	bool (*gs_duplicator_update_frame)(gs_duplicator_t *duplicator);
 	gs_texture_t *(*gs_duplicator_get_texture)(gs_duplicator_t *duplicator);
+	uint64_t (*gs_duplicator_get_frame_serial)(gs_duplicator_t *duplicator);
 
 	gs_texture_t *(*device_texture_create_gdi)(gs_device_t *device,
 						   uint32_t width,
@@ -331,6 +351,10 @@ struct gs_exports {
 		enum gs_color_format color_format, uint32_t n_planes,
 		const int *fds, const uint32_t *strides,
 		const uint32_t *offsets, const uint64_t *modifiers);
+	bool (*device_query_dmabuf_modifiers)(gs_device_t *device,
+					      enum gs_color_format color_format,
+					      uint64_t **modifiers,
+					      size_t *n_modifiers);
 #endif
 };
 
@@ -342,6 +366,43 @@ struct blend_state {
 	enum gs_blend_type dest_a;
 };
 
+/* sprites drawn between gs_sprite_batch_begin/end with identical effect and
+ * blend state are collected and drawn together, transformed on the CPU */
+struct gs_sprite_batch {
+	long depth;
+	bool flushing;
+	size_t num;
+
+	gs_effect_t *effect;
+	gs_technique_t *tech;
+	size_t pass;
+	struct blend_state blend;
+	bool srgb;
+	DARRAY(uint8_t) params;
+	DARRAY(uint8_t) scratch;
+
+	/* a lone sprite is drawn exactly as it would have been unbatched */
+	struct matrix4 first_matrix;
+	struct vec3 first_points[4];
+	struct vec2 first_uvs[4];
+
+	DARRAY(struct vec3) points;
+	DARRAY(struct vec2) uvs;
+	gs_vertbuffer_t *vb;
+	size_t vb_sprites;
+};
+
+/* render target released by a texrender, kept for reuse by any other
+ * texrender of the same size and formats */
+struct gs_render_target {
+	gs_texture_t *tex;
+	gs_zstencil_t *zs;
+	uint32_t cx, cy;
+	enum gs_color_format format;
+	enum gs_zstencil_format zsformat;
+	uint64_t released_frame;
+};
+
 struct graphics_subsystem {
 	void *module;
 	gs_device_t *device;
@@ -368,11 +429,34 @@ struct graphics_subsystem {
 	pthread_mutex_t effect_mutex;
 	struct gs_effect *first_effect;
 
+	char *shader_cache_path;
+
 	pthread_mutex_t mutex;
 	volatile long ref;
 
 	struct blend_state cur_blend_state;
 	DARRAY(struct blend_state) blend_state_stack;
 
+	struct gs_sprite_batch sprite_batch;
+
+	DARRAY(struct gs_render_target) target_pool;
+	uint64_t frame_count;
+
 	bool linear_srgb;
 };
+
+extern bool sprite_batch_add(graphics_t *graphics, struct gs_vb_data *data);
+extern void sprite_batch_flush_internal(graphics_t *graphics);
+extern void sprite_batch_free(graphics_t *graphics);
+
+/* frees the pooled render targets that have not been reused for a while, or
+ * all of them */
+extern void render_target_pool_trim(graphics_t *graphics, bool all);
+
+/* called before anything that changes state a pending batch depends on, or
+ * that must be ordered after its draws */
+static inline void sprite_batch_flush(graphics_t *graphics)
+{
+	if (graphics->sprite_batch.num && !graphics->sprite_batch.flushing)
+		sprite_batch_flush_internal(graphics);
+}
@@ -228,6 +228,8 @@ void gs_destroy(graphics_t *graphics)
 			effect = next;
 		}
 
+		sprite_batch_free(graphics);
+		render_target_pool_trim(graphics, true);
 		graphics->exports.gs_vertexbuffer_destroy(
 			graphics->sprite_buffer);
 		graphics->exports.gs_vertexbuffer_destroy(
@@ -239,6 +241,7 @@ void gs_destroy(graphics_t *graphics)
 
 	pthread_mutex_destroy(&graphics->mutex);
 	pthread_mutex_destroy(&graphics->effect_mutex);
+	bfree(graphics->shader_cache_path);
 	da_free(graphics->matrix_stack);
 	da_free(graphics->viewport_stack);
 	da_free(graphics->blend_state_stack);
@@ -275,6 +278,7 @@ void gs_leave_context(void)
 		if (!os_atomic_dec_long(&thread_graphics->ref)) {
 			graphics_t *graphics = thread_graphics;
 
+			sprite_batch_flush(graphics);
 			graphics->exports.device_leave_context(
 				graphics->device);
 			pthread_mutex_unlock(&graphics->mutex);
@@ -1035,6 +1039,9 @@ void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 	else
 		build_sprite_norm(data, fcx, fcy, flip);
 
+	if (sprite_batch_add(graphics, data))
+		return;
+
 	gs_vertexbuffer_flush(graphics->sprite_buffer);
 	gs_load_vertexbuffer(graphics->sprite_buffer);
 	gs_load_indexbuffer(NULL);
@@ -1063,6 +1070,9 @@ void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip, uint32_t sub_x,
 	build_subsprite_norm(data, (float)sub_x, (float)sub_y, (float)sub_cx,
 			     (float)sub_cy, fcx, fcy, flip);
 
+	if (sprite_batch_add(graphics, data))
+		return;
+
 	gs_vertexbuffer_flush(graphics->sprite_buffer);
 	gs_load_vertexbuffer(graphics->sprite_buffer);
 	gs_load_indexbuffer(NULL);
@@ -1291,6 +1301,7 @@ void gs_resize(uint32_t x, uint32_t y)
 	if (!gs_valid("gs_resize"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_resize(graphics->device, x, y);
 }
 
@@ -1380,6 +1391,24 @@ gs_texture_t *gs_texture_create_from_dmabuf(unsigned int width,
 		strides, offsets, modifiers);
 }
 
+bool gs_query_dmabuf_modifiers(enum gs_color_format color_format,
+			       uint64_t **modifiers, size_t *n_modifiers)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p2("gs_query_dmabuf_modifiers", modifiers, n_modifiers))
+		return false;
+
+	*modifiers = NULL;
+	*n_modifiers = 0;
+
+	if (!graphics->exports.device_query_dmabuf_modifiers)
+		return false;
+
+	return graphics->exports.device_query_dmabuf_modifiers(
+		graphics->device, color_format, modifiers, n_modifiers);
+}
+
 #endif
 
 gs_texture_t *gs_cubetexture_create(uint32_t size,
@@ -1595,6 +1624,7 @@ void gs_load_vertexbuffer(gs_vertbuffer_t *vertbuffer)
 	if (!gs_valid("gs_load_vertexbuffer"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_load_vertexbuffer(graphics->device,
 						   vertbuffer);
 }
@@ -1606,6 +1636,7 @@ void gs_load_indexbuffer(gs_indexbuffer_t *indexbuffer)
 	if (!gs_valid("gs_load_indexbuffer"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_load_indexbuffer(graphics->device,
 						  indexbuffer);
 }
@@ -1617,6 +1648,7 @@ void gs_load_texture(gs_texture_t *tex, int unit)
 	if (!gs_valid("gs_load_texture"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_load_texture(graphics->device, tex, unit);
 }
 
@@ -1627,6 +1659,7 @@ void gs_load_samplerstate(gs_samplerstate_t *samplerstate, int unit)
 	if (!gs_valid("gs_load_samplerstate"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_load_samplerstate(graphics->device,
 						   samplerstate, unit);
 }
@@ -1660,6 +1693,7 @@ void gs_load_default_samplerstate(bool b_3d, int unit)
 	if (!gs_valid("gs_load_default_samplerstate"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_load_default_samplerstate(graphics->device,
 							   b_3d, unit);
 }
@@ -1711,6 +1745,7 @@ void gs_set_render_target(gs_texture_t *tex, gs_zstencil_t *zstencil)
 	if (!gs_valid("gs_set_render_target"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_set_render_target(graphics->device, tex,
 						   zstencil);
 }
@@ -1723,6 +1758,7 @@ void gs_set_cube_render_target(gs_texture_t *cubetex, int side,
 	if (!gs_valid("gs_set_cube_render_target"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_set_cube_render_target(
 		graphics->device, cubetex, side, zstencil);
 }
@@ -1778,6 +1814,7 @@ void gs_copy_texture(gs_texture_t *dst, gs_texture_t *src)
 	if (!gs_valid_p2("gs_copy_texture", dst, src))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_copy_texture(graphics->device, dst, src);
 }
 
@@ -1790,6 +1827,7 @@ void gs_copy_texture_region(gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
 	if (!gs_valid_p("gs_copy_texture_region", dst))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_copy_texture_region(graphics->device, dst,
 						     dst_x, dst_y, src, src_x,
 						     src_y, src_w, src_h);
@@ -1802,6 +1840,7 @@ void gs_stage_texture(gs_stagesurf_t *dst, gs_texture_t *src)
 	if (!gs_valid("gs_stage_texture"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_stage_texture(graphics->device, dst, src);
 }
 
@@ -1812,6 +1851,9 @@ void gs_begin_frame(void)
 	if (!gs_valid("gs_begin_frame"))
 		return;
 
+	sprite_batch_flush(graphics);
+	graphics->frame_count++;
+	render_target_pool_trim(graphics, false);
 	graphics->exports.device_begin_frame(graphics->device);
 }
 
@@ -1822,6 +1864,7 @@ void gs_begin_scene(void)
 	if (!gs_valid("gs_begin_scene"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_begin_scene(graphics->device);
 }
 
@@ -1833,6 +1876,7 @@ void gs_draw(enum gs_draw_mode draw_mode, uint32_t start_vert,
 	if (!gs_valid("gs_draw"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_draw(graphics->device, draw_mode, start_vert,
 				      num_verts);
 }
@@ -1844,6 +1888,7 @@ void gs_end_scene(void)
 	if (!gs_valid("gs_end_scene"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_end_scene(graphics->device);
 }
 
@@ -1854,6 +1899,7 @@ void gs_load_swapchain(gs_swapchain_t *swapchain)
 	if (!gs_valid("gs_load_swapchain"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_load_swapchain(graphics->device, swapchain);
 }
 
@@ -1865,6 +1911,7 @@ void gs_clear(uint32_t clear_flags, const struct vec4 *color, float depth,
 	if (!gs_valid("gs_clear"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_clear(graphics->device, clear_flags, color,
 				       depth, stencil);
 }
@@ -1876,6 +1923,7 @@ void gs_present(void)
 	if (!gs_valid("gs_present"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_present(graphics->device);
 }
 
@@ -1886,6 +1934,7 @@ void gs_flush(void)
 	if (!gs_valid("gs_flush"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_flush(graphics->device);
 }
 
@@ -1896,6 +1945,7 @@ void gs_set_cull_mode(enum gs_cull_mode mode)
 	if (!gs_valid("gs_set_cull_mode"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_set_cull_mode(graphics->device, mode);
 }
 
@@ -1927,6 +1977,7 @@ void gs_enable_depth_test(bool enable)
 	if (!gs_valid("gs_enable_depth_test"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_enable_depth_test(graphics->device, enable);
 }
 
@@ -1937,6 +1988,7 @@ void gs_enable_stencil_test(bool enable)
 	if (!gs_valid("gs_enable_stencil_test"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_enable_stencil_test(graphics->device, enable);
 }
 
@@ -1947,6 +1999,7 @@ void gs_enable_stencil_write(bool enable)
 	if (!gs_valid("gs_enable_stencil_write"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_enable_stencil_write(graphics->device, enable);
 }
 
@@ -1957,6 +2010,7 @@ void gs_enable_color(bool red, bool green, bool blue, bool alpha)
 	if (!gs_valid("gs_enable_color"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_enable_color(graphics->device, red, green,
 					      blue, alpha);
 }
@@ -2000,6 +2054,7 @@ void gs_depth_function(enum gs_depth_test test)
 	if (!gs_valid("gs_depth_function"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_depth_function(graphics->device, test);
 }
 
@@ -2010,6 +2065,7 @@ void gs_stencil_function(enum gs_stencil_side side, enum gs_depth_test test)
 	if (!gs_valid("gs_stencil_function"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_stencil_function(graphics->device, side, test);
 }
 
@@ -2021,6 +2077,7 @@ void gs_stencil_op(enum gs_stencil_side side, enum gs_stencil_op_type fail,
 	if (!gs_valid("gs_stencil_op"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_stencil_op(graphics->device, side, fail, zfail,
 					    zpass);
 }
@@ -2032,6 +2089,7 @@ void gs_set_viewport(int x, int y, int width, int height)
 	if (!gs_valid("gs_set_viewport"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_set_viewport(graphics->device, x, y, width,
 					      height);
 }
@@ -2053,6 +2111,7 @@ void gs_set_scissor_rect(const struct gs_rect *rect)
 	if (!gs_valid("gs_set_scissor_rect"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_set_scissor_rect(graphics->device, rect);
 }
 
@@ -2064,6 +2123,7 @@ void gs_ortho(float left, float right, float top, float bottom, float znear,
 	if (!gs_valid("gs_ortho"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_ortho(graphics->device, left, right, top,
 				       bottom, znear, zfar);
 }
@@ -2076,6 +2136,7 @@ void gs_frustum(float left, float right, float top, float bottom, float znear,
 	if (!gs_valid("gs_frustum"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_frustum(graphics->device, left, right, top,
 					 bottom, znear, zfar);
 }
@@ -2087,6 +2148,7 @@ void gs_projection_push(void)
 	if (!gs_valid("gs_projection_push"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_projection_push(graphics->device);
 }
 
@@ -2097,6 +2159,7 @@ void gs_projection_pop(void)
 	if (!gs_valid("gs_projection_pop"))
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.device_projection_pop(graphics->device);
 }
 
@@ -2112,6 +2175,19 @@ void gs_swapchain_destroy(gs_swapchain_t *swapchain)
 	graphics->exports.gs_swapchain_destroy(swapchain);
 }
 
+bool gs_swapchain_ready(gs_swapchain_t *swapchain)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_swapchain_ready", swapchain))
+		return false;
+
+	if (!graphics->exports.gs_swapchain_ready)
+		return true;
+
+	return graphics->exports.gs_swapchain_ready(swapchain);
+}
+
 void gs_shader_destroy(gs_shader_t *shader)
 {
 	graphics_t *graphics = thread_graphics;
@@ -2314,6 +2390,7 @@ void gs_texture_destroy(gs_texture_t *tex)
 	if (!tex)
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.gs_texture_destroy(tex);
 }
 
@@ -2354,6 +2431,7 @@ bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
 	if (!gs_valid_p3("gs_texture_map", tex, ptr, linesize))
 		return false;
 
+	sprite_batch_flush(graphics);
 	return graphics->exports.gs_texture_map(tex, ptr, linesize);
 }
 
@@ -2367,6 +2445,23 @@ void gs_texture_unmap(gs_texture_t *tex)
 	graphics->exports.gs_texture_unmap(tex);
 }
 
+bool gs_texture_set_subimage(gs_texture_t *tex, uint32_t x, uint32_t y,
+			     uint32_t width, uint32_t height,
+			     const uint8_t *data, uint32_t linesize)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p2("gs_texture_set_subimage", tex, data))
+		return false;
+	if (!graphics->exports.gs_texture_set_subimage)
+		return false;
+
+	sprite_batch_flush(graphics);
+	return graphics->exports.gs_texture_set_subimage(tex, x, y, width,
+							 height, data,
+							 linesize);
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	graphics_t *graphics = thread_graphics;
@@ -2399,6 +2494,7 @@ void gs_cubetexture_destroy(gs_texture_t *cubetex)
 	if (!cubetex)
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.gs_cubetexture_destroy(cubetex);
 }
 
@@ -2432,6 +2528,7 @@ void gs_voltexture_destroy(gs_texture_t *voltex)
 	if (!voltex)
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.gs_voltexture_destroy(voltex);
 }
 
@@ -2539,6 +2636,19 @@ void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
 	graphics->exports.gs_stagesurface_unmap(stagesurf);
 }
 
+bool gs_stagesurface_ready(gs_stagesurf_t *stagesurf)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_stagesurface_ready", stagesurf))
+		return false;
+
+	if (!graphics->exports.gs_stagesurface_ready)
+		return false;
+
+	return graphics->exports.gs_stagesurface_ready(stagesurf);
+}
+
 void gs_zstencil_destroy(gs_zstencil_t *zstencil)
 {
 	if (!gs_valid("gs_zstencil_destroy"))
@@ -2556,6 +2666,7 @@ void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate)
 	if (!samplerstate)
 		return;
 
+	sprite_batch_flush(thread_graphics);
 	thread_graphics->exports.gs_samplerstate_destroy(samplerstate);
 }
 
@@ -2671,6 +2782,7 @@ void gs_timer_begin(gs_timer_t *timer)
 	if (!timer)
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.gs_timer_begin(timer);
 }
 
@@ -2683,6 +2795,7 @@ void gs_timer_end(gs_timer_t *timer)
 	if (!timer)
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.gs_timer_end(timer);
 }
 
@@ -2715,6 +2828,7 @@ void gs_timer_range_begin(gs_timer_range_t *range)
 	if (!range)
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.gs_timer_range_begin(range);
 }
 
@@ -2727,6 +2841,7 @@ void gs_timer_range_end(gs_timer_range_t *range)
 	if (!range)
 		return;
 
+	sprite_batch_flush(graphics);
 	graphics->exports.gs_timer_range_end(range);
 }
 
@@ -2740,6 +2855,32 @@ bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
 								frequency);
 }
 
+bool gs_timer_ready(gs_timer_t *timer)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_timer_ready", timer))
+		return false;
+
+	if (!graphics->exports.gs_timer_ready)
+		return false;
+
+	return graphics->exports.gs_timer_ready(timer);
+}
+
+bool gs_timer_range_ready(gs_timer_range_t *range)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_timer_range_ready", range))
+		return false;
+
+	if (!graphics->exports.gs_timer_range_ready)
+		return false;
+
+	return graphics->exports.gs_timer_range_ready(range);
+}
+
 bool gs_nv12_available(void)
 {
 	if (!gs_valid("gs_nv12_available"))
@@ -2752,6 +2893,77 @@ bool gs_nv12_available(void)
 		thread_graphics->device);
 }
 
+struct gs_uploader {
+	/* the worker calling gs_uploader_set_image has no graphics context */
+	struct gs_exports *exports;
+	gs_upload_context_t *context;
+};
+
+gs_uploader_t *gs_uploader_create(void)
+{
+	graphics_t *graphics = thread_graphics;
+	gs_upload_context_t *context;
+	struct gs_uploader *uploader;
+
+	if (!gs_valid("gs_uploader_create"))
+		return NULL;
+	if (!graphics->exports.device_upload_context_create ||
+	    !graphics->exports.gs_upload_context_destroy ||
+	    !graphics->exports.gs_upload_context_set_image ||
+	    !graphics->exports.gs_upload_context_finish ||
+	    !graphics->exports.gs_upload_context_submit)
+		return NULL;
+
+	context = graphics->exports.device_upload_context_create(
+		graphics->device);
+	if (!context)
+		return NULL;
+
+	uploader = bzalloc(sizeof(struct gs_uploader));
+	uploader->exports = &graphics->exports;
+	uploader->context = context;
+	return uploader;
+}
+
+void gs_uploader_destroy(gs_uploader_t *uploader)
+{
+	if (!gs_valid("gs_uploader_destroy"))
+		return;
+	if (!uploader)
+		return;
+
+	uploader->exports->gs_upload_context_destroy(uploader->context);
+	bfree(uploader);
+}
+
+bool gs_uploader_set_image(gs_uploader_t *uploader, gs_texture_t *tex,
+			   const uint8_t *data, uint32_t linesize)
+{
+	if (!uploader || !tex || !data)
+		return false;
+
+	return uploader->exports->gs_upload_context_set_image(
+		uploader->context, tex, data, linesize);
+}
+
+bool gs_uploader_finish(gs_uploader_t *uploader)
+{
+	if (!uploader)
+		return false;
+
+	return uploader->exports->gs_upload_context_finish(uploader->context);
+}
+
+void gs_uploader_submit(gs_uploader_t *uploader)
+{
+	if (!gs_valid("gs_uploader_submit"))
+		return;
+	if (!uploader)
+		return;
+
+	uploader->exports->gs_upload_context_submit(uploader->context);
+}
+
 void gs_debug_marker_begin(const float color[4], const char *markername)
 {
 	if (!gs_valid("gs_debug_marker_begin"))
@@ -2813,6 +3025,8 @@ bool gs_texture_rebind_iosurface(gs_texture_t *texture, void *iosurf)
 
 	if (!gs_valid_p("gs_texture_rebind_iosurface", texture))
 		return false;
+
+	sprite_batch_flush(graphics);
 	if (!graphics->exports.gs_texture_rebind_iosurface)
 		return false;
 
@@ -2907,6 +3121,8 @@ bool gs_duplicator_update_frame(gs_duplicator_t *duplicator)
 {
 	if (!gs_valid_p("gs_duplicator_update_frame", duplicator))
 		return false;
+
+	sprite_batch_flush(thread_graphics);
 	if (!thread_graphics->exports.gs_duplicator_update_frame)
 		return false;
 
@@ -2923,6 +3139,17 @@ gs_texture_t *gs_duplicator_get_texture(gs_duplicator_t *duplicator)
 	return thread_graphics->exports.gs_duplicator_get_texture(duplicator);
 }
 
+uint64_t gs_duplicator_get_frame_serial(gs_duplicator_t *duplicator)
+{
+	if (!gs_valid_p("gs_duplicator_get_frame_serial", duplicator))
+		return 0;
+	if (!thread_graphics->exports.gs_duplicator_get_frame_serial)
+		return 0;
+
+	return thread_graphics->exports.gs_duplicator_get_frame_serial(
+		duplicator);
+}
+
 /** creates a windows GDI-lockable texture */
 gs_texture_t *gs_texture_create_gdi(uint32_t width, uint32_t height)
 {
@@ -2942,6 +3169,7 @@ void *gs_texture_get_dc(gs_texture_t *gdi_tex)
 	if (!gs_valid_p("gs_texture_release_dc", gdi_tex))
 		return NULL;
 
+	sprite_batch_flush(thread_graphics);
 	if (thread_graphics->exports.gs_texture_get_dc)
 		return thread_graphics->exports.gs_texture_get_dc(gdi_tex);
 	return NULL;
@@ -2997,6 +3225,7 @@ int gs_texture_acquire_sync(gs_texture_t *tex, uint64_t key, uint32_t ms)
 	if (!gs_valid("gs_texture_acquire_sync"))
 		return -1;
 
+	sprite_batch_flush(graphics);
 	if (graphics->exports.device_texture_acquire_sync)
 		return graphics->exports.device_texture_acquire_sync(tex, key,
 								     ms);
@@ -3009,6 +3238,7 @@ int gs_texture_release_sync(gs_texture_t *tex, uint64_t key)
 	if (!gs_valid("gs_texture_release_sync"))
 		return -1;
 
+	sprite_batch_flush(graphics);
 	if (graphics->exports.device_texture_release_sync)
 		return graphics->exports.device_texture_release_sync(tex, key);
 	return -1;
@@ -3097,4 +3327,5 @@ void gs_unregister_loss_callbacks(void *data)
 			graphics->device, data);
 }
 
+
 #endif
@@ -76,6 +76,7 @@ enum gs_color_format {
 	GS_RGBA_UNORM,
 	GS_BGRX_UNORM,
 	GS_BGRA_UNORM,
+	GS_RG16,
 };
 
 enum gs_zstencil_format {
@@ -449,6 +450,15 @@ EXPORT void gs_effect_set_color(gs_eparam_t *param, uint32_t argb);
 
 EXPORT gs_texrender_t *gs_texrender_create(enum gs_color_format format,
 					   enum gs_zstencil_format zsformat);
+/**
+ * Creates a texrender that is rendered again every frame its texture is
+ * used in, like the input of a filter.  Once a frame passes without it
+ * being rendered, gs_texrender_reset gives its render target back to be
+ * reused by other texrenders of the same size and formats.
+ */
+EXPORT gs_texrender_t *
+gs_texrender_create_transient(enum gs_color_format format,
+			      enum gs_zstencil_format zsformat);
 EXPORT void gs_texrender_destroy(gs_texrender_t *texrender);
 EXPORT bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx,
 			       uint32_t cy);
@@ -517,6 +527,22 @@ EXPORT void gs_leave_context(void);
 EXPORT graphics_t *gs_get_context(void);
 EXPORT void *gs_get_device_obj(void);
 
+/**
+ * Persistent cache of compiled shaders, used by the graphics modules to skip
+ * compiling or linking shaders they have already built once.  Entries are
+ * keyed by a hash of the shader source plus a tag naming everything else the
+ * result depends on (compiler, driver version, target), so a new driver or
+ * changed shader simply misses the cache.  A NULL path disables the cache.
+ */
+EXPORT void gs_set_shader_cache_path(const char *path);
+EXPORT uint64_t gs_shader_cache_hash(uint64_t hash, const void *data,
+				     size_t size);
+/** Returns the cached data, which must be freed with bfree */
+EXPORT bool gs_shader_cache_load(const char *tag, uint64_t hash, void **data,
+				 size_t *size);
+EXPORT void gs_shader_cache_store(const char *tag, uint64_t hash,
+				  const void *data, size_t size);
+
 EXPORT void gs_matrix_push(void);
 EXPORT void gs_matrix_pop(void);
 EXPORT void gs_matrix_identity(void);
@@ -581,6 +607,16 @@ EXPORT void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
 				     uint32_t x, uint32_t y, uint32_t cx,
 				     uint32_t cy);
 
+/**
+ * Between these calls, consecutive sprites drawn with the same effect pass,
+ * parameter values and blend state are combined into a single draw.  Any
+ * other draw or change of render target, viewport, projection or texture
+ * contents draws the pending sprites first, so results are unchanged.  Calls
+ * can be nested; the batch is drawn when the outermost one ends.
+ */
+EXPORT void gs_sprite_batch_begin(void);
+EXPORT void gs_sprite_batch_end(void);
+
 EXPORT void gs_draw_cube_backdrop(gs_texture_t *cubetex, const struct quat *rot,
 				  float left, float right, float top,
 				  float bottom, float znear);
@@ -742,6 +778,14 @@ EXPORT void gs_projection_pop(void);
 
 EXPORT void gs_swapchain_destroy(gs_swapchain_t *swapchain);
 
+/**
+ * Returns true if the next present to this swap chain will not block.  With
+ * a swap chain that cannot tell, it always returns true.  A true result must
+ * be followed by rendering and presenting a frame, as it may use up the
+ * swap chain's signal that it is ready.
+ */
+EXPORT bool gs_swapchain_ready(gs_swapchain_t *swapchain);
+
 EXPORT void gs_texture_destroy(gs_texture_t *tex);
 EXPORT uint32_t gs_texture_get_width(const gs_texture_t *tex);
 EXPORT uint32_t gs_texture_get_height(const gs_texture_t *tex);
@@ -750,6 +794,13 @@ gs_texture_get_color_format(const gs_texture_t *tex);
 EXPORT bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr,
 			   uint32_t *linesize);
 EXPORT void gs_texture_unmap(gs_texture_t *tex);
+/** uploads a region of a 2D texture, leaving the rest of it as it is.
+ * returns false if the region couldn't be uploaded or the graphics backend
+ * doesn't support it (currently only GL does), in which case the whole
+ * texture has to be set instead */
+EXPORT bool gs_texture_set_subimage(gs_texture_t *tex, uint32_t x, uint32_t y,
+				    uint32_t width, uint32_t height,
+				    const uint8_t *data, uint32_t linesize);
 /** special-case function (GL only) - specifies whether the texture is a
  * GL_TEXTURE_RECTANGLE type, which doesn't use normalized texture
  * coordinates, doesn't support mipmapping, and requires address clamping */
@@ -781,6 +832,13 @@ EXPORT bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 				uint32_t *linesize);
 EXPORT void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf);
 
+/**
+ * Returns true if the last gs_stage_texture into this surface has finished
+ * on the GPU, meaning gs_stagesurface_map will not block.  Returns false
+ * while the copy is still in flight, or if the backend cannot tell.
+ */
+EXPORT bool gs_stagesurface_ready(gs_stagesurf_t *stagesurf);
+
 EXPORT void gs_zstencil_destroy(gs_zstencil_t *zstencil);
 
 EXPORT void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate);
@@ -812,8 +870,48 @@ EXPORT void gs_timer_range_end(gs_timer_range_t *range);
 EXPORT bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
 				    uint64_t *frequency);
 
+/**
+ * Returns true if the results of the timer or range are available, meaning
+ * gs_timer_get_data or gs_timer_range_get_data will not block.  Returns
+ * false while they are still in flight, or if the backend cannot tell.
+ */
+EXPORT bool gs_timer_ready(gs_timer_t *timer);
+EXPORT bool gs_timer_range_ready(gs_timer_range_t *range);
+
 EXPORT bool gs_nv12_available(void);
 
+struct gs_upload_context;
+typedef struct gs_upload_context gs_upload_context_t;
+struct gs_uploader;
+typedef struct gs_uploader gs_uploader_t;
+
+/**
+ * Creates an uploader, which records texture uploads on another thread for
+ * the graphics thread to execute later.  Returns NULL if the device cannot
+ * record commands outside of the graphics thread.
+ */
+EXPORT gs_uploader_t *gs_uploader_create(void);
+EXPORT void gs_uploader_destroy(gs_uploader_t *uploader);
+
+/**
+ * Records an upload of a whole dynamic texture.  Does not require the
+ * graphics context and may be called from any thread, but from only one
+ * thread at a time.  Nothing is uploaded until gs_uploader_finish and
+ * gs_uploader_submit are called.
+ */
+EXPORT bool gs_uploader_set_image(gs_uploader_t *uploader, gs_texture_t *tex,
+				  const uint8_t *data, uint32_t linesize);
+
+/**
+ * Completes the uploads recorded since the last call, replacing any that
+ * were completed but not yet submitted.  Same threading as
+ * gs_uploader_set_image.
+ */
+EXPORT bool gs_uploader_finish(gs_uploader_t *uploader);
+
+/** Executes the completed uploads on the graphics thread */
+EXPORT void gs_uploader_submit(gs_uploader_t *uploader);
+
 #define GS_USE_DEBUG_MARKERS 0
 #if GS_USE_DEBUG_MARKERS
 static const float GS_DEBUG_COLOR_DEFAULT[] = {0.5f, 0.5f, 0.5f, 1.0f};
@@ -840,6 +938,8 @@ EXPORT void gs_debug_marker_begin_format(const float color[4],
 					 const char *format, ...);
 EXPORT void gs_debug_marker_end(void);
 
+#define GS_INVALID_HANDLE (uint32_t) - 1
+
 #ifdef __APPLE__
 
 /** platform specific function for creating (GL_TEXTURE_RECTANGLE) textures
@@ -874,6 +974,10 @@ EXPORT void gs_duplicator_destroy(gs_duplicator_t *duplicator);
 EXPORT bool gs_duplicator_update_frame(gs_duplicator_t *duplicator);
 EXPORT gs_texture_t *gs_duplicator_get_texture(gs_duplicator_t *duplicator);
 
+/** increments whenever the image of the duplicator's texture changes */
+EXPORT uint64_t
+gs_duplicator_get_frame_serial(gs_duplicator_t *duplicator);
+
 /** creates a windows GDI-lockable texture */
 EXPORT gs_texture_t *gs_texture_create_gdi(uint32_t width, uint32_t height);
 
@@ -883,7 +987,6 @@ EXPORT void gs_texture_release_dc(gs_texture_t *gdi_tex);
 /** creates a windows shared texture from a texture handle */
 EXPORT gs_texture_t *gs_texture_open_shared(uint32_t handle);
 
-#define GS_INVALID_HANDLE (uint32_t) - 1
 EXPORT uint32_t gs_texture_get_shared_handle(gs_texture_t *tex);
 
 EXPORT gs_texture_t *gs_texture_wrap_obj(void *obj);
@@ -922,6 +1025,14 @@ gs_texture_create_from_dmabuf(unsigned int width, unsigned int height,
 			      const uint32_t *strides, const uint32_t *offsets,
 			      const uint64_t *modifiers);
 
+/* returns the DRM format modifiers with which dmabufs of the format can be
+ * imported, in an array to be freed with bfree.  returns false if the
+ * graphics backend can't tell; buffers without an explicit modifier may
+ * still import */
+EXPORT bool gs_query_dmabuf_modifiers(enum gs_color_format color_format,
+				      uint64_t **modifiers,
+				      size_t *n_modifiers);
+
 #endif
 
 /* inline functions used by modules */
@@ -971,6 +1082,8 @@ static inline uint32_t gs_get_format_bpp(enum gs_color_format format)
 		return 32;
 	case GS_BGRA_UNORM:
 		return 32;
+	case GS_RG16:
+		return 32;
 	case GS_UNKNOWN:
 		return 0;
 	}
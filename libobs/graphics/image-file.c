@@ -18,6 +18,7 @@
 #include "image-file.h"
 #include "../util/base.h"
 #include "../util/platform.h"
+#include "../util/threading.h"
 
 #define blog(level, format, ...) \
 	blog(level, "%s: " format, __FUNCTION__, __VA_ARGS__)
@@ -70,8 +71,238 @@ static inline void *alloc_mem(gs_image_file_t *image, uint64_t *mem_usage,
 	return bzalloc(size);
 }
 
+/* ------------------------------------------------------------------------- */
+
+#define MIN_STREAM_FRAMES 3
+#define MAX_STREAM_FRAMES 16
+
+/*
+ * Frames are decoded in playback order by a thread, which stays at most
+ * num_frames ahead of the frame being shown.  Sequence numbers count frames
+ * across loops, frame seq is stored in slot seq % num_frames.
+ */
+struct gs_image_stream {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	os_event_t *wake;
+	bool stop;
+
+	size_t frame_size;
+	uint32_t num_frames;
+	uint8_t **frames;
+	uint64_t *frame_seq;
+
+	uint64_t decode_seq;
+	uint64_t want_seq;
+	uint64_t shown_seq;
+
+	uint64_t decoded_frames;
+	uint64_t total_decode_ns;
+	uint64_t max_decode_ns;
+	uint64_t late_frames;
+};
+
+static void add_decode_time(struct gs_image_stream *stream, uint64_t ns)
+{
+	stream->decoded_frames++;
+	stream->total_decode_ns += ns;
+	if (ns > stream->max_decode_ns)
+		stream->max_decode_ns = ns;
+}
+
+static void *stream_thread(void *data)
+{
+	gs_image_file_t *image = data;
+	struct gs_image_stream *stream = image->stream;
+
+	os_set_thread_name("image-file: gif decode");
+
+	for (;;) {
+		uint64_t seq;
+		bool ahead, stop;
+
+		pthread_mutex_lock(&stream->mutex);
+		seq = stream->decode_seq;
+		ahead = seq >= stream->want_seq + stream->num_frames;
+		stop = stream->stop;
+		pthread_mutex_unlock(&stream->mutex);
+
+		if (stop)
+			break;
+		if (ahead) {
+			os_event_wait(stream->wake);
+			continue;
+		}
+
+		unsigned int frame = (unsigned int)(seq % image->gif.frame_count);
+		uint64_t start = os_gettime_ns();
+		gif_result result = gif_decode_frame(&image->gif, frame);
+		uint64_t ns = os_gettime_ns() - start;
+
+		pthread_mutex_lock(&stream->mutex);
+		uint32_t slot = (uint32_t)(seq % stream->num_frames);
+		if (result == GIF_OK)
+			memcpy(stream->frames[slot], image->gif.frame_image,
+			       stream->frame_size);
+		stream->frame_seq[slot] = seq;
+		stream->decode_seq++;
+		add_decode_time(stream, ns);
+		pthread_mutex_unlock(&stream->mutex);
+	}
+
+	return NULL;
+}
+
+static bool init_stream(gs_image_file_t *image, uint64_t mem_limit,
+			uint64_t *mem_usage)
+{
+	struct gs_image_stream *stream;
+	size_t frame_size = (size_t)image->gif.width * image->gif.height * 4;
+	uint64_t num_frames = mem_limit / frame_size;
+
+	if (num_frames < MIN_STREAM_FRAMES)
+		num_frames = MIN_STREAM_FRAMES;
+	if (num_frames > MAX_STREAM_FRAMES)
+		num_frames = MAX_STREAM_FRAMES;
+	if (num_frames > image->gif.frame_count)
+		num_frames = image->gif.frame_count;
+
+	stream = bzalloc(sizeof(struct gs_image_stream));
+	stream->frame_size = frame_size;
+	stream->num_frames = (uint32_t)num_frames;
+	stream->frames = bzalloc(sizeof(uint8_t *) * stream->num_frames);
+	stream->frame_seq = bzalloc(sizeof(uint64_t) * stream->num_frames);
+
+	for (uint32_t i = 0; i < stream->num_frames; i++) {
+		stream->frames[i] = alloc_mem(image, mem_usage, frame_size);
+		stream->frame_seq[i] = UINT64_MAX;
+	}
+
+	pthread_mutex_init_value(&stream->mutex);
+	if (pthread_mutex_init(&stream->mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&stream->wake, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	/* the first frame is always ready for gs_image_file_init_texture */
+	uint64_t start = os_gettime_ns();
+	gif_decode_frame(&image->gif, 0);
+	add_decode_time(stream, os_gettime_ns() - start);
+
+	memcpy(stream->frames[0], image->gif.frame_image, frame_size);
+	stream->frame_seq[0] = 0;
+	stream->decode_seq = 1;
+
+	image->stream = stream;
+	if (pthread_create(&stream->thread, NULL, stream_thread, image) != 0) {
+		image->stream = NULL;
+		goto fail;
+	}
+
+	return true;
+
+fail:
+	os_event_destroy(stream->wake);
+	pthread_mutex_destroy(&stream->mutex);
+	for (uint32_t i = 0; i < stream->num_frames; i++)
+		bfree(stream->frames[i]);
+	bfree(stream->frames);
+	bfree(stream->frame_seq);
+	bfree(stream);
+	return false;
+}
+
+static void free_stream(gs_image_file_t *image)
+{
+	struct gs_image_stream *stream = image->stream;
+
+	pthread_mutex_lock(&stream->mutex);
+	stream->stop = true;
+	pthread_mutex_unlock(&stream->mutex);
+
+	os_event_signal(stream->wake);
+	pthread_join(stream->thread, NULL);
+
+	if (stream->decoded_frames)
+		blog(LOG_DEBUG,
+		     "%" PRIu64 " frames decoded, %.2f ms average, "
+		     "%.2f ms max, %" PRIu64 " late",
+		     stream->decoded_frames,
+		     (double)stream->total_decode_ns /
+			     (double)stream->decoded_frames / 1000000.0,
+		     (double)stream->max_decode_ns / 1000000.0,
+		     stream->late_frames);
+
+	os_event_destroy(stream->wake);
+	pthread_mutex_destroy(&stream->mutex);
+	for (uint32_t i = 0; i < stream->num_frames; i++)
+		bfree(stream->frames[i]);
+	bfree(stream->frames);
+	bfree(stream->frame_seq);
+	bfree(stream);
+	image->stream = NULL;
+}
+
+/* advances the wanted frame by however many frames playback moved on */
+static void stream_set_frame(gs_image_file_t *image, int new_frame)
+{
+	struct gs_image_stream *stream = image->stream;
+	unsigned int count = image->gif.frame_count;
+	unsigned int delta =
+		((unsigned int)new_frame + count - (unsigned int)image->cur_frame) %
+		count;
+
+	pthread_mutex_lock(&stream->mutex);
+	stream->want_seq += delta;
+	pthread_mutex_unlock(&stream->mutex);
+
+	os_event_signal(stream->wake);
+	image->cur_frame = new_frame;
+}
+
+static inline bool stream_frame_ready(struct gs_image_stream *stream)
+{
+	uint32_t slot = (uint32_t)(stream->want_seq % stream->num_frames);
+	return stream->frame_seq[slot] == stream->want_seq;
+}
+
+static bool stream_pending(gs_image_file_t *image)
+{
+	struct gs_image_stream *stream = image->stream;
+	bool pending;
+
+	pthread_mutex_lock(&stream->mutex);
+	pending = stream->shown_seq != stream->want_seq &&
+		  stream_frame_ready(stream);
+	pthread_mutex_unlock(&stream->mutex);
+
+	return pending;
+}
+
+static void stream_update_texture(gs_image_file_t *image)
+{
+	struct gs_image_stream *stream = image->stream;
+
+	pthread_mutex_lock(&stream->mutex);
+
+	if (stream_frame_ready(stream)) {
+		uint32_t slot =
+			(uint32_t)(stream->want_seq % stream->num_frames);
+		gs_texture_set_image(image->texture, stream->frames[slot],
+				     image->gif.width * 4, false);
+		stream->shown_seq = stream->want_seq;
+
+	} else if (stream->shown_seq != stream->want_seq) {
+		/* keeps showing the previous frame until the tick after the
+		 * decoder catches up */
+		stream->late_frames++;
+	}
+
+	pthread_mutex_unlock(&stream->mutex);
+}
+
 static bool init_animated_gif(gs_image_file_t *image, const char *path,
-			      uint64_t *mem_usage)
+			      uint64_t *mem_usage, uint64_t mem_limit)
 {
 	bool is_animated_gif = true;
 	gif_result result;
@@ -132,7 +363,27 @@ static bool init_animated_gif(gs_image_file_t *image, const char *path,
 	}
 
 	image->is_animated_gif = (image->gif.frame_count > 1 && result >= 0);
-	if (image->is_animated_gif) {
+	if (image->is_animated_gif && mem_limit && max_size > mem_limit) {
+		if (!init_stream(image, mem_limit, mem_usage)) {
+			blog(LOG_WARNING, "Failed to start decoding '%s'",
+			     path);
+			goto fail;
+		}
+
+		blog(LOG_DEBUG,
+		     "Streaming '%s', %u of %u frames kept in memory", path,
+		     image->stream->num_frames, image->gif.frame_count);
+
+		image->cx = (uint32_t)image->gif.width;
+		image->cy = (uint32_t)image->gif.height;
+		image->format = GS_RGBA;
+
+		if (mem_usage) {
+			*mem_usage += image->cx * image->cy * 4;
+			*mem_usage += size;
+		}
+
+	} else if (image->is_animated_gif) {
 		gif_decode_frame(&image->gif, 0);
 
 		image->animation_frame_cache =
@@ -180,7 +431,8 @@ not_animated:
 }
 
 static void gs_image_file_init_internal(gs_image_file_t *image,
-					const char *file, uint64_t *mem_usage)
+					const char *file, uint64_t *mem_usage,
+					uint64_t mem_limit)
 {
 	size_t len;
 
@@ -195,7 +447,7 @@ static void gs_image_file_init_internal(gs_image_file_t *image,
 	len = strlen(file);
 
 	if (len > 4 && strcmp(file + len - 4, ".gif") == 0) {
-		if (init_animated_gif(image, file, mem_usage))
+		if (init_animated_gif(image, file, mem_usage, mem_limit))
 			return;
 	}
 
@@ -216,7 +468,8 @@ static void gs_image_file_init_internal(gs_image_file_t *image,
 
 void gs_image_file_init(gs_image_file_t *image, const char *file)
 {
-	gs_image_file_init_internal(image, file, NULL);
+	gs_image_file_init_internal(image, file, NULL,
+				    GS_IMAGE_FILE_DEFAULT_MEM_LIMIT);
 }
 
 void gs_image_file_free(gs_image_file_t *image)
@@ -224,6 +477,9 @@ void gs_image_file_free(gs_image_file_t *image)
 	if (!image)
 		return;
 
+	if (image->stream)
+		free_stream(image);
+
 	if (image->loaded) {
 		if (image->is_animated_gif) {
 			gif_finalise(&image->gif);
@@ -241,7 +497,34 @@ void gs_image_file_free(gs_image_file_t *image)
 
 void gs_image_file2_init(gs_image_file2_t *if2, const char *file)
 {
-	gs_image_file_init_internal(&if2->image, file, &if2->mem_usage);
+	gs_image_file_init_internal(&if2->image, file, &if2->mem_usage,
+				    GS_IMAGE_FILE_DEFAULT_MEM_LIMIT);
+}
+
+void gs_image_file2_init_mem_limit(gs_image_file2_t *if2, const char *file,
+				   uint64_t mem_limit)
+{
+	gs_image_file_init_internal(&if2->image, file, &if2->mem_usage,
+				    mem_limit);
+}
+
+void gs_image_file_get_decode_stats(gs_image_file_t *image,
+				    struct gs_image_decode_stats *stats)
+{
+	struct gs_image_stream *stream = image ? image->stream : NULL;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!stream)
+		return;
+
+	pthread_mutex_lock(&stream->mutex);
+	stats->streaming = true;
+	stats->buffered_frames = stream->num_frames;
+	stats->decoded_frames = stream->decoded_frames;
+	stats->total_decode_ns = stream->total_decode_ns;
+	stats->max_decode_ns = stream->max_decode_ns;
+	stats->late_frames = stream->late_frames;
+	pthread_mutex_unlock(&stream->mutex);
 }
 
 void gs_image_file_init_texture(gs_image_file_t *image)
@@ -249,7 +532,18 @@ void gs_image_file_init_texture(gs_image_file_t *image)
 	if (!image->loaded)
 		return;
 
-	if (image->is_animated_gif) {
+	if (image->stream) {
+		struct gs_image_stream *stream = image->stream;
+
+		pthread_mutex_lock(&stream->mutex);
+		uint32_t slot =
+			(uint32_t)(stream->shown_seq % stream->num_frames);
+		image->texture = gs_texture_create(
+			image->cx, image->cy, image->format, 1,
+			(const uint8_t **)&stream->frames[slot], GS_DYNAMIC);
+		pthread_mutex_unlock(&stream->mutex);
+
+	} else if (image->is_animated_gif) {
 		image->texture = gs_texture_create(
 			image->cx, image->cy, image->format, 1,
 			(const uint8_t **)&image->gif.frame_image, GS_DYNAMIC);
@@ -346,12 +640,15 @@ bool gs_image_file_tick(gs_image_file_t *image, uint64_t elapsed_time_ns)
 			calculate_new_frame(image, elapsed_time_ns, loops);
 
 		if (new_frame != image->cur_frame) {
-			decode_new_frame(image, new_frame);
+			if (image->stream)
+				stream_set_frame(image, new_frame);
+			else
+				decode_new_frame(image, new_frame);
 			return true;
 		}
 	}
 
-	return false;
+	return image->stream && stream_pending(image);
 }
 
 void gs_image_file_update_texture(gs_image_file_t *image)
@@ -359,6 +656,11 @@ void gs_image_file_update_texture(gs_image_file_t *image)
 	if (!image->is_animated_gif || !image->loaded)
 		return;
 
+	if (image->stream) {
+		stream_update_texture(image);
+		return;
+	}
+
 	if (!image->animation_frame_cache[image->cur_frame])
 		decode_new_frame(image, image->cur_frame);
 
@@ -24,6 +24,12 @@
 extern "C" {
 #endif
 
+/* animated images whose decoded frames would take more memory than this are
+ * streamed instead of being cached in full */
+#define GS_IMAGE_FILE_DEFAULT_MEM_LIMIT (256ULL * 1024ULL * 1024ULL)
+
+struct gs_image_stream;
+
 struct gs_image_file {
 	gs_texture_t *texture;
 	enum gs_color_format format;
@@ -42,6 +48,10 @@ struct gs_image_file {
 	int cur_loop;
 	int last_decoded_frame;
 
+	/* set when frames are decoded ahead on a thread into a small ring
+	 * rather than all being kept in animation_frame_cache */
+	struct gs_image_stream *stream;
+
 	uint8_t *texture_data;
 	gif_bitmap_callback_vt bitmap_callbacks;
 };
@@ -64,6 +74,25 @@ EXPORT void gs_image_file_update_texture(gs_image_file_t *image);
 
 EXPORT void gs_image_file2_init(gs_image_file2_t *if2, const char *file);
 
+/** Like gs_image_file2_init, but animated images whose decoded frames exceed
+ * mem_limit bytes are decoded on demand, keeping the frames held in memory
+ * within the limit.  0 always caches every frame. */
+EXPORT void gs_image_file2_init_mem_limit(gs_image_file2_t *if2,
+					  const char *file, uint64_t mem_limit);
+
+struct gs_image_decode_stats {
+	bool streaming;
+	uint32_t buffered_frames;
+	uint64_t decoded_frames;
+	uint64_t total_decode_ns;
+	uint64_t max_decode_ns;
+	/* frames that were not decoded yet when they were due */
+	uint64_t late_frames;
+};
+
+EXPORT void gs_image_file_get_decode_stats(gs_image_file_t *image,
+					   struct gs_image_decode_stats *stats);
+
 static void gs_image_file2_free(gs_image_file2_t *if2)
 {
 	gs_image_file_free(&if2->image);
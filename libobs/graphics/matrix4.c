@@ -57,87 +57,84 @@ void matrix4_from_axisang(struct matrix4 *dst, const struct axisang *aa)
 	matrix4_from_quat(dst, &q);
 }
 
+/* each row of the product is the rows of m weighted by the entries of v */
+static inline __m128 mul_row(const struct vec4 *v, const struct matrix4 *m)
+{
+	__m128 r = _mm_mul_ps(_mm_set1_ps(v->x), m->x.m);
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v->y), m->y.m));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v->z), m->z.m));
+	return _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v->w), m->t.m));
+}
+
 void matrix4_mul(struct matrix4 *dst, const struct matrix4 *m1,
 		 const struct matrix4 *m2)
 {
-	const struct vec4 *m1v = (const struct vec4 *)m1;
-	const float *m2f = (const float *)m2;
-	struct vec4 out[4];
-	int i, j;
-
-	for (i = 0; i < 4; i++) {
-		for (j = 0; j < 4; j++) {
-			struct vec4 temp;
-			vec4_set(&temp, m2f[j], m2f[j + 4], m2f[j + 8],
-				 m2f[j + 12]);
-			out[i].ptr[j] = vec4_dot(&m1v[i], &temp);
-		}
-	}
-
-	matrix4_copy(dst, (struct matrix4 *)out);
+	__m128 x = mul_row(&m1->x, m2);
+	__m128 y = mul_row(&m1->y, m2);
+	__m128 z = mul_row(&m1->z, m2);
+	__m128 t = mul_row(&m1->t, m2);
+
+	dst->x.m = x;
+	dst->y.m = y;
+	dst->z.m = z;
+	dst->t.m = t;
 }
 
-static inline void get_3x3_submatrix(float *dst, const struct matrix4 *m, int i,
-				     int j)
+/* 2x2 minors of the upper (s) and lower (c) two rows, which the
+ * determinant and every cofactor are made of */
+struct minors {
+	float s[6];
+	float c[6];
+};
+
+static inline void get_minors(struct minors *mn, const float *a)
 {
-	const float *mf = (const float *)m;
-	int ti, tj, idst, jdst;
-
-	for (ti = 0; ti < 4; ti++) {
-		if (ti < i)
-			idst = ti;
-		else if (ti > i)
-			idst = ti - 1;
-		else
-			continue;
-
-		for (tj = 0; tj < 4; tj++) {
-			if (tj < j)
-				jdst = tj;
-			else if (tj > j)
-				jdst = tj - 1;
-			else
-				continue;
-
-			dst[(idst * 3) + jdst] = mf[(ti * 4) + tj];
-		}
-	}
+	mn->s[0] = a[0] * a[5] - a[4] * a[1];
+	mn->s[1] = a[0] * a[6] - a[4] * a[2];
+	mn->s[2] = a[0] * a[7] - a[4] * a[3];
+	mn->s[3] = a[1] * a[6] - a[5] * a[2];
+	mn->s[4] = a[1] * a[7] - a[5] * a[3];
+	mn->s[5] = a[2] * a[7] - a[6] * a[3];
+
+	mn->c[0] = a[8] * a[13] - a[12] * a[9];
+	mn->c[1] = a[8] * a[14] - a[12] * a[10];
+	mn->c[2] = a[8] * a[15] - a[12] * a[11];
+	mn->c[3] = a[9] * a[14] - a[13] * a[10];
+	mn->c[4] = a[9] * a[15] - a[13] * a[11];
+	mn->c[5] = a[10] * a[15] - a[14] * a[11];
 }
 
-static inline float get_3x3_determinant(const float *m)
+static inline float minors_determinant(const struct minors *mn)
 {
-	return (m[0] * ((m[4] * m[8]) - (m[7] * m[5]))) -
-	       (m[1] * ((m[3] * m[8]) - (m[6] * m[5]))) +
-	       (m[2] * ((m[3] * m[7]) - (m[6] * m[4])));
+	return mn->s[0] * mn->c[5] - mn->s[1] * mn->c[4] +
+	       mn->s[2] * mn->c[3] + mn->s[3] * mn->c[2] -
+	       mn->s[4] * mn->c[1] + mn->s[5] * mn->c[0];
 }
 
 float matrix4_determinant(const struct matrix4 *m)
 {
-	const float *mf = (const float *)m;
-	float det, result = 0.0f, i = 1.0f;
-	float m3x3[9];
-	int n;
-
-	for (n = 0; n < 4; n++, i = -i) { // NOLINT(clang-tidy-cert-flp30-c)
-		get_3x3_submatrix(m3x3, m, 0, n);
+	struct minors mn;
+	get_minors(&mn, (const float *)m);
+	return minors_determinant(&mn);
+}
 
-		det = get_3x3_determinant(m3x3);
-		result += mf[n] * det * i;
-	}
+/* translations and scales only touch a few entries of the matrix they are
+ * applied to, so they are applied directly instead of multiplied */
 
-	return result;
+static inline __m128 translate_row(const struct vec4 *row, __m128 v)
+{
+	return _mm_add_ps(row->m, _mm_mul_ps(_mm_set1_ps(row->w), v));
 }
 
 void matrix4_translate3v(struct matrix4 *dst, const struct matrix4 *m,
 			 const struct vec3 *v)
 {
-	struct matrix4 temp;
-	vec4_set(&temp.x, 1.0f, 0.0f, 0.0f, 0.0f);
-	vec4_set(&temp.y, 0.0f, 1.0f, 0.0f, 0.0f);
-	vec4_set(&temp.z, 0.0f, 0.0f, 1.0f, 0.0f);
-	vec4_from_vec3(&temp.t, v);
+	__m128 vt = _mm_set_ps(0.0f, v->z, v->y, v->x);
 
-	matrix4_mul(dst, m, &temp);
+	dst->x.m = translate_row(&m->x, vt);
+	dst->y.m = translate_row(&m->y, vt);
+	dst->z.m = translate_row(&m->z, vt);
+	dst->t.m = translate_row(&m->t, vt);
 }
 
 void matrix4_translate4v(struct matrix4 *dst, const struct matrix4 *m,
@@ -171,24 +168,25 @@ void matrix4_rotate_aa(struct matrix4 *dst, const struct matrix4 *m,
 void matrix4_scale(struct matrix4 *dst, const struct matrix4 *m,
 		   const struct vec3 *v)
 {
-	struct matrix4 temp;
-	vec4_set(&temp.x, v->x, 0.0f, 0.0f, 0.0f);
-	vec4_set(&temp.y, 0.0f, v->y, 0.0f, 0.0f);
-	vec4_set(&temp.z, 0.0f, 0.0f, v->z, 0.0f);
-	vec4_set(&temp.t, 0.0f, 0.0f, 0.0f, 1.0f);
-	matrix4_mul(dst, m, &temp);
+	__m128 vs = _mm_set_ps(1.0f, v->z, v->y, v->x);
+
+	dst->x.m = _mm_mul_ps(m->x.m, vs);
+	dst->y.m = _mm_mul_ps(m->y.m, vs);
+	dst->z.m = _mm_mul_ps(m->z.m, vs);
+	dst->t.m = _mm_mul_ps(m->t.m, vs);
 }
 
 void matrix4_translate3v_i(struct matrix4 *dst, const struct vec3 *v,
 			   const struct matrix4 *m)
 {
-	struct matrix4 temp;
-	vec4_set(&temp.x, 1.0f, 0.0f, 0.0f, 0.0f);
-	vec4_set(&temp.y, 0.0f, 1.0f, 0.0f, 0.0f);
-	vec4_set(&temp.z, 0.0f, 0.0f, 1.0f, 0.0f);
-	vec4_from_vec3(&temp.t, v);
+	__m128 t = _mm_mul_ps(_mm_set1_ps(v->x), m->x.m);
+	t = _mm_add_ps(t, _mm_mul_ps(_mm_set1_ps(v->y), m->y.m));
+	t = _mm_add_ps(t, _mm_mul_ps(_mm_set1_ps(v->z), m->z.m));
 
-	matrix4_mul(dst, &temp, m);
+	dst->x.m = m->x.m;
+	dst->y.m = m->y.m;
+	dst->z.m = m->z.m;
+	dst->t.m = _mm_add_ps(t, m->t.m);
 }
 
 void matrix4_translate4v_i(struct matrix4 *dst, const struct vec4 *v,
@@ -222,41 +220,54 @@ void matrix4_rotate_aa_i(struct matrix4 *dst, const struct axisang *aa,
 void matrix4_scale_i(struct matrix4 *dst, const struct vec3 *v,
 		     const struct matrix4 *m)
 {
-	struct matrix4 temp;
-	vec4_set(&temp.x, v->x, 0.0f, 0.0f, 0.0f);
-	vec4_set(&temp.y, 0.0f, v->y, 0.0f, 0.0f);
-	vec4_set(&temp.z, 0.0f, 0.0f, v->z, 0.0f);
-	vec4_set(&temp.t, 0.0f, 0.0f, 0.0f, 1.0f);
-	matrix4_mul(dst, &temp, m);
+	dst->x.m = _mm_mul_ps(_mm_set1_ps(v->x), m->x.m);
+	dst->y.m = _mm_mul_ps(_mm_set1_ps(v->y), m->y.m);
+	dst->z.m = _mm_mul_ps(_mm_set1_ps(v->z), m->z.m);
+	dst->t.m = m->t.m;
 }
 
 bool matrix4_inv(struct matrix4 *dst, const struct matrix4 *m)
 {
-	struct vec4 *dstv;
+	const float *a = (const float *)m;
+	const float *s, *c;
+	struct minors mn;
+	float b[16];
 	float det;
-	float m3x3[9];
-	int i, j, sign;
 
-	if (dst == m) {
-		struct matrix4 temp = *m;
-		return matrix4_inv(dst, &temp);
-	}
-
-	dstv = (struct vec4 *)dst;
-	det = matrix4_determinant(m);
+	get_minors(&mn, a);
+	det = minors_determinant(&mn);
 
 	if (fabs(det) < 0.0005f)
 		return false;
 
-	for (i = 0; i < 4; i++) {
-		for (j = 0; j < 4; j++) {
-			sign = 1 - ((i + j) % 2) * 2;
-			get_3x3_submatrix(m3x3, m, i, j);
-			dstv[j].ptr[i] =
-				get_3x3_determinant(m3x3) * (float)sign / det;
-		}
-	}
-
+	s = mn.s;
+	c = mn.c;
+
+	b[0] = a[5] * c[5] - a[6] * c[4] + a[7] * c[3];
+	b[1] = -a[1] * c[5] + a[2] * c[4] - a[3] * c[3];
+	b[2] = a[13] * s[5] - a[14] * s[4] + a[15] * s[3];
+	b[3] = -a[9] * s[5] + a[10] * s[4] - a[11] * s[3];
+
+	b[4] = -a[4] * c[5] + a[6] * c[2] - a[7] * c[1];
+	b[5] = a[0] * c[5] - a[2] * c[2] + a[3] * c[1];
+	b[6] = -a[12] * s[5] + a[14] * s[2] - a[15] * s[1];
+	b[7] = a[8] * s[5] - a[10] * s[2] + a[11] * s[1];
+
+	b[8] = a[4] * c[4] - a[5] * c[2] + a[7] * c[0];
+	b[9] = -a[0] * c[4] + a[1] * c[2] - a[3] * c[0];
+	b[10] = a[12] * s[4] - a[13] * s[2] + a[15] * s[0];
+	b[11] = -a[8] * s[4] + a[9] * s[2] - a[11] * s[0];
+
+	b[12] = -a[4] * c[3] + a[5] * c[1] - a[6] * c[0];
+	b[13] = a[0] * c[3] - a[1] * c[1] + a[2] * c[0];
+	b[14] = -a[12] * s[3] + a[13] * s[1] - a[14] * s[0];
+	b[15] = a[8] * s[3] - a[9] * s[1] + a[10] * s[0];
+
+	__m128 inv_det = _mm_set1_ps(1.0f / det);
+	dst->x.m = _mm_mul_ps(_mm_loadu_ps(b), inv_det);
+	dst->y.m = _mm_mul_ps(_mm_loadu_ps(b + 4), inv_det);
+	dst->z.m = _mm_mul_ps(_mm_loadu_ps(b + 8), inv_det);
+	dst->t.m = _mm_mul_ps(_mm_loadu_ps(b + 12), inv_det);
 	return true;
 }
 
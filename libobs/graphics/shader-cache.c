@@ -0,0 +1,192 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../util/bmem.h"
+#include "../util/crc32.h"
+#include "../util/dstr.h"
+#include "../util/platform.h"
+#include "graphics-internal.h"
+
+/*
+ * Each entry is a single file named after the hash of its tag and source
+ * hash.  The tag and source hash are stored in the file as well and compared
+ * on load, so a file name collision can only ever result in a miss.
+ */
+
+#define CACHE_MAGIC "OBSSHC01"
+#define CACHE_MAGIC_SIZE 8
+#define CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+struct cache_header {
+	char magic[CACHE_MAGIC_SIZE];
+	uint64_t hash;
+	uint32_t tag_size;
+	uint32_t data_size;
+	uint32_t data_crc;
+	uint32_t reserved;
+};
+
+uint64_t gs_shader_cache_hash(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	if (!hash)
+		hash = FNV_OFFSET_BASIS;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+void gs_set_shader_cache_path(const char *path)
+{
+	graphics_t *graphics = gs_get_context();
+	if (!graphics)
+		return;
+
+	bfree(graphics->shader_cache_path);
+	graphics->shader_cache_path = NULL;
+
+	if (path && *path) {
+		if (os_mkdirs(path) == MKDIR_ERROR) {
+			blog(LOG_WARNING,
+			     "Failed to create shader cache directory '%s', "
+			     "shader cache disabled",
+			     path);
+			return;
+		}
+
+		graphics->shader_cache_path = bstrdup(path);
+	}
+}
+
+static bool get_entry_path(struct dstr *path, const char *tag, uint64_t hash)
+{
+	graphics_t *graphics = gs_get_context();
+	if (!graphics || !graphics->shader_cache_path)
+		return false;
+
+	uint64_t name = gs_shader_cache_hash(hash, tag, strlen(tag));
+
+	dstr_printf(path, "%s/%016" PRIx64 ".bin",
+		    graphics->shader_cache_path, name);
+	return true;
+}
+
+static bool read_entry(FILE *f, const char *tag, uint64_t hash, void **data,
+		       size_t *size)
+{
+	size_t tag_size = strlen(tag);
+	struct cache_header header;
+	bool success = false;
+	char *file_tag;
+	uint8_t *buf;
+
+	if (fread(&header, 1, sizeof(header), f) != sizeof(header))
+		return false;
+	if (memcmp(header.magic, CACHE_MAGIC, CACHE_MAGIC_SIZE) != 0)
+		return false;
+	if (header.hash != hash || header.tag_size != tag_size)
+		return false;
+	if (!header.data_size || header.data_size > CACHE_MAX_SIZE)
+		return false;
+
+	file_tag = bmalloc(tag_size + 1);
+	if (fread(file_tag, 1, tag_size, f) == tag_size &&
+	    memcmp(file_tag, tag, tag_size) == 0)
+		success = true;
+	bfree(file_tag);
+
+	if (!success)
+		return false;
+
+	buf = bmalloc(header.data_size);
+	if (fread(buf, 1, header.data_size, f) != header.data_size ||
+	    calc_crc32(0, buf, header.data_size) != header.data_crc) {
+		bfree(buf);
+		return false;
+	}
+
+	*data = buf;
+	*size = header.data_size;
+	return true;
+}
+
+bool gs_shader_cache_load(const char *tag, uint64_t hash, void **data,
+			  size_t *size)
+{
+	struct dstr path = {0};
+	bool success = false;
+	FILE *f;
+
+	if (!tag || !data || !size)
+		return false;
+	if (!get_entry_path(&path, tag, hash))
+		return false;
+
+	f = os_fopen(path.array, "rb");
+	if (f) {
+		success = read_entry(f, tag, hash, data, size);
+		fclose(f);
+
+		if (!success)
+			blog(LOG_DEBUG, "Discarding stale shader cache entry "
+					"'%s'",
+			     path.array);
+	}
+
+	dstr_free(&path);
+	return success;
+}
+
+void gs_shader_cache_store(const char *tag, uint64_t hash, const void *data,
+			   size_t size)
+{
+	struct dstr path = {0};
+	struct dstr temp = {0};
+	struct cache_header header = {0};
+	bool success;
+	FILE *f;
+
+	if (!tag || !data || !size || size > CACHE_MAX_SIZE)
+		return;
+	if (!get_entry_path(&path, tag, hash))
+		return;
+
+	memcpy(header.magic, CACHE_MAGIC, CACHE_MAGIC_SIZE);
+	header.hash = hash;
+	header.tag_size = (uint32_t)strlen(tag);
+	header.data_size = (uint32_t)size;
+	header.data_crc = calc_crc32(0, data, size);
+
+	/* written under a temporary name first so that a crash or another
+	 * instance can never see a partially written entry */
+	dstr_copy_dstr(&temp, &path);
+	dstr_cat(&temp, ".tmp");
+
+	f = os_fopen(temp.array, "wb");
+	if (!f)
+		goto exit;
+
+	success = fwrite(&header, 1, sizeof(header), f) == sizeof(header) &&
+		  fwrite(tag, 1, header.tag_size, f) == header.tag_size &&
+		  fwrite(data, 1, size, f) == size;
+	success = fclose(f) == 0 && success;
+
+	if (!success || os_rename(temp.array, path.array) != 0) {
+		blog(LOG_DEBUG, "Failed to write shader cache entry '%s'",
+		     path.array);
+		os_unlink(temp.array);
+	}
+
+exit:
+	dstr_free(&path);
+	dstr_free(&temp);
+}
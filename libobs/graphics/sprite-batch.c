@@ -0,0 +1,346 @@
+#include <string.h>
+
+#include "../util/bmem.h"
+#include "effect.h"
+#include "graphics-internal.h"
+
+/*
+ * Sprites are only ever queued while every piece of state they were drawn
+ * with is either captured here (effect pass, parameter values, blend state,
+ * framebuffer sRGB) or is guaranteed to draw the batch before it changes
+ * (everything else, see the sprite_batch_flush calls in graphics.c).
+ *
+ * libobs-graphics has no instancing, so queued sprites are transformed on
+ * the CPU and drawn as a single triangle list with an identity world matrix.
+ */
+
+#define MAX_BATCH_SPRITES 1024
+#define MIN_VB_SPRITES 16
+
+struct saved_param {
+	struct darray cur_val;
+	bool changed;
+	gs_samplerstate_t *next_sampler;
+};
+
+void gs_sprite_batch_begin(void)
+{
+	graphics_t *graphics = gs_get_context();
+	if (!graphics)
+		return;
+
+	graphics->sprite_batch.depth++;
+}
+
+void gs_sprite_batch_end(void)
+{
+	graphics_t *graphics = gs_get_context();
+	if (!graphics || !graphics->sprite_batch.depth)
+		return;
+
+	if (--graphics->sprite_batch.depth == 0)
+		sprite_batch_flush(graphics);
+}
+
+static inline bool matrix_is_affine(const struct matrix4 *m)
+{
+	return m->x.w == 0.0f && m->y.w == 0.0f && m->z.w == 0.0f &&
+	       m->t.w == 1.0f;
+}
+
+static inline bool blend_state_equal(const struct blend_state *a,
+				     const struct blend_state *b)
+{
+	return a->enabled == b->enabled && a->src_c == b->src_c &&
+	       a->dest_c == b->dest_c && a->src_a == b->src_a &&
+	       a->dest_a == b->dest_a;
+}
+
+/* every effect parameter as size, value and sampler override */
+static void snapshot_params(struct gs_sprite_batch *batch, gs_effect_t *effect)
+{
+	da_resize(batch->scratch, 0);
+
+	for (size_t i = 0; i < effect->params.num; i++) {
+		struct gs_effect_param *param = effect->params.array + i;
+		uint32_t size = (uint32_t)param->cur_val.num;
+
+		da_push_back_array(batch->scratch, (uint8_t *)&size,
+				   sizeof(size));
+		da_push_back_array(batch->scratch, param->cur_val.array, size);
+		da_push_back_array(batch->scratch,
+				   (uint8_t *)&param->next_sampler,
+				   sizeof(param->next_sampler));
+	}
+}
+
+static inline size_t pass_index(gs_effect_t *effect)
+{
+	return (size_t)(effect->cur_pass - effect->cur_technique->passes.array);
+}
+
+static bool batch_matches(struct gs_sprite_batch *batch, gs_effect_t *effect,
+			  const struct blend_state *blend, bool srgb)
+{
+	return batch->effect == effect &&
+	       batch->tech == effect->cur_technique &&
+	       batch->pass == pass_index(effect) &&
+	       blend_state_equal(&batch->blend, blend) && batch->srgb == srgb &&
+	       batch->params.num == batch->scratch.num &&
+	       memcmp(batch->params.array, batch->scratch.array,
+		      batch->params.num) == 0;
+}
+
+bool sprite_batch_add(graphics_t *graphics, struct gs_vb_data *data)
+{
+	struct gs_sprite_batch *batch = &graphics->sprite_batch;
+	gs_effect_t *effect = graphics->cur_effect;
+	struct vec2 *tvarray = data->tvarray[0].array;
+	struct vec3 points[4];
+	struct vec2 uvs[4];
+	struct matrix4 mat;
+	bool srgb;
+
+	if (!batch->depth || batch->flushing)
+		return false;
+
+	/* a flush below may draw through the same sprite buffer */
+	memcpy(points, data->points, sizeof(points));
+	memcpy(uvs, tvarray, sizeof(uvs));
+	gs_matrix_get(&mat);
+
+	if (!effect || !effect->cur_technique || !effect->cur_pass ||
+	    !matrix_is_affine(&mat)) {
+		if (batch->num) {
+			sprite_batch_flush(graphics);
+			memcpy(data->points, points, sizeof(points));
+			memcpy(tvarray, uvs, sizeof(uvs));
+		}
+		return false;
+	}
+
+	srgb = gs_framebuffer_srgb_enabled();
+	snapshot_params(batch, effect);
+
+	if (batch->num &&
+	    (batch->num == MAX_BATCH_SPRITES ||
+	     !batch_matches(batch, effect, &graphics->cur_blend_state, srgb)))
+		sprite_batch_flush(graphics);
+
+	if (!batch->num) {
+		struct darray swap = batch->params.da;
+		batch->params.da = batch->scratch.da;
+		batch->scratch.da = swap;
+
+		batch->effect = effect;
+		batch->tech = effect->cur_technique;
+		batch->pass = pass_index(effect);
+		batch->blend = graphics->cur_blend_state;
+		batch->srgb = srgb;
+
+		batch->first_matrix = mat;
+		memcpy(batch->first_points, points, sizeof(points));
+		memcpy(batch->first_uvs, uvs, sizeof(uvs));
+
+		da_resize(batch->points, 0);
+		da_resize(batch->uvs, 0);
+	}
+
+	/* the sprite strip 0 1 2 3 as the list 0 1 2, 2 1 3 */
+	static const int order[6] = {0, 1, 2, 2, 1, 3};
+	for (size_t i = 0; i < 6; i++) {
+		struct vec3 *point = da_push_back_new(batch->points);
+		vec3_transform(point, points + order[i], &mat);
+		da_push_back(batch->uvs, uvs + order[i]);
+	}
+
+	batch->num++;
+	return true;
+}
+
+static bool ensure_vertbuffer(struct gs_sprite_batch *batch)
+{
+	struct gs_vb_data *vbd;
+	size_t sprites = batch->vb_sprites ? batch->vb_sprites : MIN_VB_SPRITES;
+
+	while (sprites < batch->num)
+		sprites *= 2;
+	if (batch->vb && sprites == batch->vb_sprites)
+		return true;
+
+	gs_vertexbuffer_destroy(batch->vb);
+
+	vbd = gs_vbdata_create();
+	vbd->num = sprites * 6;
+	vbd->points = bzalloc(sizeof(struct vec3) * vbd->num);
+	vbd->num_tex = 1;
+	vbd->tvarray = bzalloc(sizeof(struct gs_tvertarray));
+	vbd->tvarray[0].width = 2;
+	vbd->tvarray[0].array = bzalloc(sizeof(struct vec2) * vbd->num);
+
+	batch->vb = gs_vertexbuffer_create(vbd, GS_DYNAMIC);
+	batch->vb_sprites = batch->vb ? sprites : 0;
+	return batch->vb != NULL;
+}
+
+static void draw_single(graphics_t *graphics)
+{
+	struct gs_sprite_batch *batch = &graphics->sprite_batch;
+	struct gs_vb_data *data = gs_vertexbuffer_get_data(
+		graphics->sprite_buffer);
+
+	memcpy(data->points, batch->first_points, sizeof(batch->first_points));
+	memcpy(data->tvarray[0].array, batch->first_uvs,
+	       sizeof(batch->first_uvs));
+
+	gs_vertexbuffer_flush(graphics->sprite_buffer);
+	gs_load_vertexbuffer(graphics->sprite_buffer);
+	gs_load_indexbuffer(NULL);
+
+	gs_matrix_push();
+	gs_matrix_set(&batch->first_matrix);
+	gs_draw(GS_TRISTRIP, 0, 0);
+	gs_matrix_pop();
+}
+
+static void draw_batch(graphics_t *graphics)
+{
+	struct gs_sprite_batch *batch = &graphics->sprite_batch;
+	struct gs_vb_data *data;
+	size_t num_verts = batch->num * 6;
+
+	if (!ensure_vertbuffer(batch))
+		return;
+
+	data = gs_vertexbuffer_get_data(batch->vb);
+	memcpy(data->points, batch->points.array,
+	       sizeof(struct vec3) * num_verts);
+	memcpy(data->tvarray[0].array, batch->uvs.array,
+	       sizeof(struct vec2) * num_verts);
+
+	gs_vertexbuffer_flush(batch->vb);
+	gs_load_vertexbuffer(batch->vb);
+	gs_load_indexbuffer(NULL);
+
+	gs_matrix_push();
+	gs_matrix_identity();
+	gs_draw(GS_TRIS, 0, (uint32_t)num_verts);
+	gs_matrix_pop();
+}
+
+static void load_params(struct gs_sprite_batch *batch, gs_effect_t *effect)
+{
+	const uint8_t *pos = batch->params.array;
+
+	for (size_t i = 0; i < effect->params.num; i++) {
+		struct gs_effect_param *param = effect->params.array + i;
+		uint32_t size;
+
+		memcpy(&size, pos, sizeof(size));
+		pos += sizeof(size);
+
+		da_init(param->cur_val);
+		da_push_back_array(param->cur_val, pos, size);
+		pos += size;
+
+		memcpy(&param->next_sampler, pos, sizeof(param->next_sampler));
+		pos += sizeof(param->next_sampler);
+
+		param->changed = true;
+	}
+}
+
+static void mark_pass_params(struct darray *shaderparams)
+{
+	struct pass_shaderparam *params = shaderparams->array;
+
+	for (size_t i = 0; i < shaderparams->num; i++)
+		params[i].eparam->changed = true;
+}
+
+void sprite_batch_flush_internal(graphics_t *graphics)
+{
+	struct gs_sprite_batch *batch = &graphics->sprite_batch;
+	gs_effect_t *effect = batch->effect;
+	gs_technique_t *tech = batch->tech;
+	struct gs_effect_param *params = effect->params.array;
+	size_t num_params = effect->params.num;
+	struct saved_param *saved;
+
+	/* state of whatever the caller is in the middle of */
+	gs_effect_t *prev_effect = graphics->cur_effect;
+	struct gs_effect_technique *prev_tech = effect->cur_technique;
+	struct gs_effect_pass *prev_pass = effect->cur_pass;
+	gs_shader_t *prev_vs = gs_get_vertex_shader();
+	gs_shader_t *prev_ps = gs_get_pixel_shader();
+	struct blend_state prev_blend = graphics->cur_blend_state;
+	bool prev_srgb = gs_framebuffer_srgb_enabled();
+
+	batch->flushing = true;
+
+	saved = bmalloc(sizeof(*saved) * (num_params ? num_params : 1));
+	for (size_t i = 0; i < num_params; i++) {
+		saved[i].cur_val = params[i].cur_val.da;
+		saved[i].changed = params[i].changed;
+		saved[i].next_sampler = params[i].next_sampler;
+	}
+
+	load_params(batch, effect);
+
+	gs_enable_blending(batch->blend.enabled);
+	gs_blend_function_separate(batch->blend.src_c, batch->blend.dest_c,
+				   batch->blend.src_a, batch->blend.dest_a);
+	gs_enable_framebuffer_srgb(batch->srgb);
+
+	gs_technique_begin(tech);
+	if (gs_technique_begin_pass(tech, batch->pass)) {
+		if (batch->num == 1)
+			draw_single(graphics);
+		else
+			draw_batch(graphics);
+		gs_technique_end_pass(tech);
+	}
+	gs_technique_end(tech);
+
+	/* gs_technique_end frees the replayed values */
+	for (size_t i = 0; i < num_params; i++) {
+		params[i].cur_val.da = saved[i].cur_val;
+		params[i].changed = saved[i].changed;
+		params[i].next_sampler = saved[i].next_sampler;
+	}
+	bfree(saved);
+
+	effect->cur_technique = prev_tech;
+	effect->cur_pass = prev_pass;
+	graphics->cur_effect = prev_effect;
+	gs_load_vertexshader(prev_vs);
+	gs_load_pixelshader(prev_ps);
+
+	gs_enable_blending(prev_blend.enabled);
+	gs_blend_function_separate(prev_blend.src_c, prev_blend.dest_c,
+				   prev_blend.src_a, prev_blend.dest_a);
+	gs_enable_framebuffer_srgb(prev_srgb);
+
+	/* the shaders now hold the replayed values rather than the ones the
+	 * interrupted pass uploaded */
+	if (prev_effect == effect && prev_pass) {
+		mark_pass_params(&prev_pass->vertshader_params.da);
+		mark_pass_params(&prev_pass->pixelshader_params.da);
+		gs_effect_update_params(effect);
+	}
+
+	batch->num = 0;
+	batch->flushing = false;
+}
+
+void sprite_batch_free(graphics_t *graphics)
+{
+	struct gs_sprite_batch *batch = &graphics->sprite_batch;
+
+	gs_vertexbuffer_destroy(batch->vb);
+	da_free(batch->params);
+	da_free(batch->scratch);
+	da_free(batch->points);
+	da_free(batch->uvs);
+	memset(batch, 0, sizeof(*batch));
+}
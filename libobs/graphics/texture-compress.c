@@ -0,0 +1,295 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "texture-compress.h"
+
+/*
+ * A fast block encoder rather than an exhaustive one: the end points of each
+ * 4x4 block are the corners of the bounding box of its colors, inset a little
+ * and flipped along the channels that fall while red rises, then every pixel
+ * takes the closest of the interpolated colors.  Alpha works the same way on
+ * a single channel.  The images are encoded once, in the background.
+ */
+
+typedef uint8_t block_t[16][4];
+
+static inline bool is_bgr(enum gs_color_format format)
+{
+	return format == GS_BGRA || format == GS_BGRX;
+}
+
+bool gs_can_compress_texture(enum gs_color_format format, uint32_t cx,
+			     uint32_t cy)
+{
+	if (format != GS_RGBA && format != GS_BGRA && format != GS_BGRX)
+		return false;
+
+	/* compressed textures are made of whole blocks */
+	return cx && cy && (cx % 4) == 0 && (cy % 4) == 0;
+}
+
+enum gs_color_format gs_get_compressed_format(const uint8_t *data,
+					      uint32_t linesize,
+					      enum gs_color_format format,
+					      uint32_t cx, uint32_t cy)
+{
+	if (format == GS_BGRX)
+		return GS_DXT1;
+
+	for (uint32_t y = 0; y < cy; y++) {
+		const uint8_t *row = data + (size_t)y * linesize;
+
+		for (uint32_t x = 0; x < cx; x++) {
+			if (row[x * 4 + 3] != 255)
+				return GS_DXT5;
+		}
+	}
+
+	return GS_DXT1;
+}
+
+size_t gs_get_compressed_size(enum gs_color_format format, uint32_t cx,
+			      uint32_t cy)
+{
+	size_t blocks = (size_t)((cx + 3) / 4) * ((cy + 3) / 4);
+
+	switch (format) {
+	case GS_DXT1:
+		return blocks * 8;
+	case GS_DXT3:
+	case GS_DXT5:
+		return blocks * 16;
+	default:
+		return 0;
+	}
+}
+
+/* loads a block as RGBA */
+static void load_block(block_t block, const uint8_t *data, uint32_t linesize,
+		       enum gs_color_format format)
+{
+	bool bgr = is_bgr(format);
+
+	for (int y = 0; y < 4; y++) {
+		const uint8_t *row = data + (size_t)y * linesize;
+
+		for (int x = 0; x < 4; x++) {
+			const uint8_t *src = row + x * 4;
+			uint8_t *px = block[y * 4 + x];
+
+			px[0] = bgr ? src[2] : src[0];
+			px[1] = src[1];
+			px[2] = bgr ? src[0] : src[2];
+			px[3] = format == GS_BGRX ? 255 : src[3];
+		}
+	}
+}
+
+static inline uint16_t pack_565(const int *c)
+{
+	return (uint16_t)(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) |
+			  (c[2] >> 3));
+}
+
+static inline void unpack_565(uint16_t v, int *c)
+{
+	int r = (v >> 11) & 31;
+	int g = (v >> 5) & 63;
+	int b = v & 31;
+
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+static inline void put_le16(uint8_t *out, uint16_t v)
+{
+	out[0] = (uint8_t)v;
+	out[1] = (uint8_t)(v >> 8);
+}
+
+static void get_color_end_points(const block_t block, int *max, int *min)
+{
+	int mean[3] = {0, 0, 0};
+	int cov_g = 0, cov_b = 0;
+
+	for (int c = 0; c < 3; c++) {
+		min[c] = 255;
+		max[c] = 0;
+	}
+
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 3; c++) {
+			int v = block[i][c];
+			mean[c] += v;
+			if (v < min[c])
+				min[c] = v;
+			if (v > max[c])
+				max[c] = v;
+		}
+	}
+
+	for (int c = 0; c < 3; c++)
+		mean[c] /= 16;
+
+	for (int i = 0; i < 16; i++) {
+		int r = block[i][0] - mean[0];
+		cov_g += r * (block[i][1] - mean[1]);
+		cov_b += r * (block[i][2] - mean[2]);
+	}
+
+	/* the box is inset by a sixteenth of its size, which lowers the
+	 * error of the interpolated colors */
+	for (int c = 0; c < 3; c++) {
+		int inset = (max[c] - min[c]) / 16;
+		max[c] -= inset;
+		min[c] += inset;
+	}
+
+	if (cov_g < 0) {
+		int tmp = max[1];
+		max[1] = min[1];
+		min[1] = tmp;
+	}
+	if (cov_b < 0) {
+		int tmp = max[2];
+		max[2] = min[2];
+		min[2] = tmp;
+	}
+}
+
+static void encode_color_block(uint8_t *out, const block_t block)
+{
+	int max[3], min[3];
+	int palette[4][3];
+	uint16_t c0, c1;
+	uint32_t indices = 0;
+
+	get_color_end_points(block, max, min);
+	c0 = pack_565(max);
+	c1 = pack_565(min);
+
+	/* the first end point has to be the larger one, or DXT1 would treat
+	 * the block as having transparent pixels */
+	if (c0 < c1) {
+		uint16_t tmp = c0;
+		c0 = c1;
+		c1 = tmp;
+	}
+
+	put_le16(out, c0);
+	put_le16(out + 2, c1);
+
+	if (c0 == c1) {
+		memset(out + 4, 0, 4);
+		return;
+	}
+
+	unpack_565(c0, palette[0]);
+	unpack_565(c1, palette[1]);
+	for (int c = 0; c < 3; c++) {
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	for (int i = 0; i < 16; i++) {
+		int best = 0;
+		int best_dist = 0x7FFFFFFF;
+
+		for (int p = 0; p < 4; p++) {
+			int dist = 0;
+			for (int c = 0; c < 3; c++) {
+				int d = block[i][c] - palette[p][c];
+				dist += d * d;
+			}
+			if (dist < best_dist) {
+				best_dist = dist;
+				best = p;
+			}
+		}
+
+		indices |= (uint32_t)best << (i * 2);
+	}
+
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (uint8_t)(indices >> (i * 8));
+}
+
+static void encode_alpha_block(uint8_t *out, const block_t block)
+{
+	int a0 = 0, a1 = 255;
+	int palette[8];
+	uint64_t indices = 0;
+
+	for (int i = 0; i < 16; i++) {
+		int a = block[i][3];
+		if (a > a0)
+			a0 = a;
+		if (a < a1)
+			a1 = a;
+	}
+
+	out[0] = (uint8_t)a0;
+	out[1] = (uint8_t)a1;
+
+	if (a0 == a1) {
+		memset(out + 2, 0, 6);
+		return;
+	}
+
+	/* eight interpolated values, as the first end point is larger */
+	palette[0] = a0;
+	palette[1] = a1;
+	for (int i = 1; i < 7; i++)
+		palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+
+	for (int i = 0; i < 16; i++) {
+		int best = 0;
+		int best_dist = 256;
+
+		for (int p = 0; p < 8; p++) {
+			int dist = abs(block[i][3] - palette[p]);
+			if (dist < best_dist) {
+				best_dist = dist;
+				best = p;
+			}
+		}
+
+		indices |= (uint64_t)best << (i * 3);
+	}
+
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (uint8_t)(indices >> (i * 8));
+}
+
+bool gs_compress_texture_data(uint8_t *out, enum gs_color_format out_format,
+			      const uint8_t *data, uint32_t linesize,
+			      enum gs_color_format format, uint32_t cx,
+			      uint32_t cy)
+{
+	bool alpha = out_format == GS_DXT5;
+	block_t block;
+
+	if (!out || !data || (out_format != GS_DXT1 && !alpha))
+		return false;
+	if (!gs_can_compress_texture(format, cx, cy))
+		return false;
+
+	for (uint32_t y = 0; y < cy; y += 4) {
+		const uint8_t *row = data + (size_t)y * linesize;
+
+		for (uint32_t x = 0; x < cx; x += 4) {
+			load_block(block, row + x * 4, linesize, format);
+
+			if (alpha) {
+				encode_alpha_block(out, block);
+				out += 8;
+			}
+
+			encode_color_block(out, block);
+			out += 8;
+		}
+	}
+
+	return true;
+}
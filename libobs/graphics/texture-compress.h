@@ -0,0 +1,44 @@
+#pragma once
+
+#include "graphics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Block compression of static images on the CPU, for textures that are
+ * uploaded once and only sampled afterwards.  DXT1 (BC1) takes an eighth and
+ * DXT5 (BC3) a quarter of the memory of 32-bit pixels.
+ */
+
+/** Returns true if cx by cy pixels of format can be compressed */
+EXPORT bool gs_can_compress_texture(enum gs_color_format format, uint32_t cx,
+				    uint32_t cy);
+
+/**
+ * Returns GS_DXT1 for pixels that are fully opaque, where the alpha channel
+ * does not need to be kept, and GS_DXT5 otherwise
+ */
+EXPORT enum gs_color_format
+gs_get_compressed_format(const uint8_t *data, uint32_t linesize,
+			 enum gs_color_format format, uint32_t cx, uint32_t cy);
+
+/** Returns the size in bytes of a cx by cy texture of a compressed format */
+EXPORT size_t gs_get_compressed_size(enum gs_color_format format, uint32_t cx,
+				     uint32_t cy);
+
+/**
+ * Compresses GS_RGBA, GS_BGRA or GS_BGRX pixels to out_format, GS_DXT1 or
+ * GS_DXT5.  out has to hold gs_get_compressed_size() bytes.  Returns false if
+ * the pixels cannot be compressed, see gs_can_compress_texture().
+ */
+EXPORT bool gs_compress_texture_data(uint8_t *out,
+				     enum gs_color_format out_format,
+				     const uint8_t *data, uint32_t linesize,
+				     enum gs_color_format format, uint32_t cx,
+				     uint32_t cy);
+
+#ifdef __cplusplus
+}
+#endif
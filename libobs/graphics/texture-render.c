@@ -21,7 +21,18 @@
  */
 
 #include <assert.h>
-#include "graphics.h"
+#include "graphics-internal.h"
+
+/*
+ * Render targets a texrender no longer needs, because it was resized,
+ * destroyed or is transient and went unused for a frame, are kept in a pool
+ * of the graphics subsystem and handed to the next texrender that asks for
+ * the same size and formats instead of being recreated.  Targets that have
+ * not been reused for MAX_IDLE_FRAMES are freed.
+ */
+
+#define MAX_IDLE_FRAMES 120
+#define MAX_POOLED_TARGETS 32
 
 struct gs_texture_render {
 	gs_texture_t *target, *prev_target;
@@ -33,8 +44,92 @@ struct gs_texture_render {
 	enum gs_zstencil_format zsformat;
 
 	bool rendered;
+	bool transient;
 };
 
+static void destroy_target(struct gs_render_target *rt)
+{
+	gs_texture_destroy(rt->tex);
+	gs_zstencil_destroy(rt->zs);
+}
+
+void render_target_pool_trim(graphics_t *graphics, bool all)
+{
+	size_t i = 0;
+
+	while (i < graphics->target_pool.num) {
+		struct gs_render_target *rt = &graphics->target_pool.array[i];
+
+		if (all ||
+		    graphics->frame_count - rt->released_frame >
+			    MAX_IDLE_FRAMES) {
+			destroy_target(rt);
+			da_erase(graphics->target_pool, i);
+		} else {
+			i++;
+		}
+	}
+
+	if (all)
+		da_free(graphics->target_pool);
+}
+
+static void release_target(gs_texrender_t *texrender)
+{
+	graphics_t *graphics = gs_get_context();
+	struct gs_render_target rt = {
+		.tex = texrender->target,
+		.zs = texrender->zs,
+		.cx = texrender->cx,
+		.cy = texrender->cy,
+		.format = texrender->format,
+		.zsformat = texrender->zsformat,
+	};
+
+	texrender->target = NULL;
+	texrender->zs = NULL;
+	texrender->cx = 0;
+	texrender->cy = 0;
+
+	if (!rt.tex)
+		return;
+	if (!graphics) {
+		destroy_target(&rt);
+		return;
+	}
+
+	if (graphics->target_pool.num == MAX_POOLED_TARGETS) {
+		destroy_target(&graphics->target_pool.array[0]);
+		da_erase(graphics->target_pool, 0);
+	}
+
+	rt.released_frame = graphics->frame_count;
+	da_push_back(graphics->target_pool, &rt);
+}
+
+/* the most recently released targets are the most likely to still be in
+ * video memory, so they are reused first */
+static bool acquire_target(gs_texrender_t *texrender)
+{
+	graphics_t *graphics = gs_get_context();
+	size_t i = graphics ? graphics->target_pool.num : 0;
+
+	while (i-- > 0) {
+		struct gs_render_target *rt = &graphics->target_pool.array[i];
+
+		if (rt->cx == texrender->cx && rt->cy == texrender->cy &&
+		    rt->format == texrender->format &&
+		    rt->zsformat == texrender->zsformat) {
+			texrender->target = rt->tex;
+			texrender->zs = rt->zs;
+			da_erase(graphics->target_pool, i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
 gs_texrender_t *gs_texrender_create(enum gs_color_format format,
 				    enum gs_zstencil_format zsformat)
 {
@@ -46,11 +141,18 @@ gs_texrender_t *gs_texrender_create(enum gs_color_format format,
 	return texrender;
 }
 
+gs_texrender_t *gs_texrender_create_transient(enum gs_color_format format,
+					      enum gs_zstencil_format zsformat)
+{
+	gs_texrender_t *texrender = gs_texrender_create(format, zsformat);
+	texrender->transient = true;
+	return texrender;
+}
+
 void gs_texrender_destroy(gs_texrender_t *texrender)
 {
 	if (texrender) {
-		gs_texture_destroy(texrender->target);
-		gs_zstencil_destroy(texrender->zs);
+		release_target(texrender);
 		bfree(texrender);
 	}
 }
@@ -61,14 +163,14 @@ static bool texrender_resetbuffer(gs_texrender_t *texrender, uint32_t cx,
 	if (!texrender)
 		return false;
 
-	gs_texture_destroy(texrender->target);
-	gs_zstencil_destroy(texrender->zs);
+	release_target(texrender);
 
-	texrender->target = NULL;
-	texrender->zs = NULL;
 	texrender->cx = cx;
 	texrender->cy = cy;
 
+	if (acquire_target(texrender))
+		return true;
+
 	texrender->target = gs_texture_create(cx, cy, texrender->format, 1,
 					      NULL, GS_RENDER_TARGET);
 	if (!texrender->target)
@@ -132,8 +234,12 @@ void gs_texrender_end(gs_texrender_t *texrender)
 
 void gs_texrender_reset(gs_texrender_t *texrender)
 {
-	if (texrender)
-		texrender->rendered = false;
+	if (!texrender)
+		return;
+
+	if (texrender->transient && !texrender->rendered)
+		release_target(texrender);
+	texrender->rendered = false;
 }
 
 gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender)
@@ -27,8 +27,12 @@
 
 #include "audio-io.h"
 #include "audio-resampler.h"
+#include "audio-mixing.h"
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
+extern bool obs_offline_rendering_active(void);
+extern uint64_t obs_get_clock_ns(void);
+extern bool obs_sleepto_clock_ns(uint64_t time_ns);
 
 /* #define DEBUG_AUDIO */
 
@@ -37,21 +41,29 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 		int invalid = 0; \
 	} while (0)
 
-struct audio_input {
+/* inputs of a mix that convert to the same format share one resampler, which
+ * runs once per mix to produce the output of all of them */
+struct mix_resampler {
 	struct audio_convert_info conversion;
 	audio_resampler_t *resampler;
+	size_t refs;
+
+	bool resampled;
+	bool success;
+	struct audio_data data;
+};
+
+struct audio_input {
+	struct audio_convert_info conversion;
+	bool resample;
 
 	audio_output_callback_t callback;
 	void *param;
 };
 
-static inline void audio_input_free(struct audio_input *input)
-{
-	audio_resampler_destroy(input->resampler);
-}
-
 struct audio_mix {
 	DARRAY(struct audio_input) inputs;
+	DARRAY(struct mix_resampler) resamplers;
 	float buffer[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
 };
 
@@ -68,35 +80,81 @@ struct audio_output {
 
 	audio_input_callback_t input_cb;
 	void *input_param;
+	volatile long catch_up_ticks;
+	volatile long long clock_deviation_ppb;
 	pthread_mutex_t input_mutex;
 	struct audio_mix mixes[MAX_AUDIO_MIXES];
 };
 
 /* ------------------------------------------------------------------------- */
 
-static bool resample_audio_output(struct audio_input *input,
+static inline bool conversion_equal(const struct audio_convert_info *a,
+				    const struct audio_convert_info *b)
+{
+	return a->format == b->format && a->speakers == b->speakers &&
+	       a->samples_per_sec == b->samples_per_sec;
+}
+
+static struct mix_resampler *
+find_resampler(struct audio_mix *mix, const struct audio_convert_info *conv)
+{
+	for (size_t i = 0; i < mix->resamplers.num; i++) {
+		struct mix_resampler *rs = mix->resamplers.array + i;
+		if (conversion_equal(&rs->conversion, conv))
+			return rs;
+	}
+
+	return NULL;
+}
+
+static inline void audio_input_free(struct audio_input *input,
+				    struct audio_mix *mix)
+{
+	struct mix_resampler *rs;
+
+	if (!input->resample)
+		return;
+
+	rs = find_resampler(mix, &input->conversion);
+	if (rs && --rs->refs == 0) {
+		audio_resampler_destroy(rs->resampler);
+		da_erase(mix->resamplers, rs - mix->resamplers.array);
+	}
+}
+
+static bool resample_audio_output(struct audio_mix *mix,
+				  struct audio_input *input,
 				  struct audio_data *data)
 {
-	bool success = true;
+	struct mix_resampler *rs;
+
+	if (!input->resample)
+		return true;
+
+	rs = find_resampler(mix, &input->conversion);
+	if (!rs)
+		return false;
 
-	if (input->resampler) {
+	if (!rs->resampled) {
 		uint8_t *output[MAX_AV_PLANES];
-		uint32_t frames;
-		uint64_t offset;
+		uint32_t frames = 0;
+		uint64_t offset = 0;
 
 		memset(output, 0, sizeof(output));
 
-		success = audio_resampler_resample(
-			input->resampler, output, &frames, &offset,
+		rs->success = audio_resampler_resample(
+			rs->resampler, output, &frames, &offset,
 			(const uint8_t *const *)data->data, data->frames);
 
 		for (size_t i = 0; i < MAX_AV_PLANES; i++)
-			data->data[i] = output[i];
-		data->frames = frames;
-		data->timestamp -= offset;
+			rs->data.data[i] = output[i];
+		rs->data.frames = frames;
+		rs->data.timestamp = data->timestamp - offset;
+		rs->resampled = true;
 	}
 
-	return success;
+	*data = rs->data;
+	return rs->success;
 }
 
 static inline void do_audio_output(struct audio_output *audio, size_t mix_idx,
@@ -107,6 +165,9 @@ static inline void do_audio_output(struct audio_output *audio, size_t mix_idx,
 
 	pthread_mutex_lock(&audio->input_mutex);
 
+	for (size_t i = 0; i < mix->resamplers.num; i++)
+		mix->resamplers.array[i].resampled = false;
+
 	for (size_t i = mix->inputs.num; i > 0; i--) {
 		struct audio_input *input = mix->inputs.array + (i - 1);
 
@@ -115,7 +176,7 @@ static inline void do_audio_output(struct audio_output *audio, size_t mix_idx,
 		data.frames = frames;
 		data.timestamp = timestamp;
 
-		if (resample_audio_output(input, &data))
+		if (resample_audio_output(mix, input, &data))
 			input->callback(input->param, mix_idx, &data);
 	}
 
@@ -133,17 +194,8 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 		if (!mix->inputs.num)
 			continue;
 
-		for (size_t plane = 0; plane < audio->planes; plane++) {
-			float *mix_data = mix->buffer[plane];
-			float *mix_end = &mix_data[float_size];
-
-			while (mix_data < mix_end) {
-				float val = *mix_data;
-				val = (val > 1.0f) ? 1.0f : val;
-				val = (val < -1.0f) ? -1.0f : val;
-				*(mix_data++) = val;
-			}
-		}
+		for (size_t plane = 0; plane < audio->planes; plane++)
+			audio_mix_clamp(mix->buffer[plane], float_size);
 	}
 }
 
@@ -195,18 +247,31 @@ static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
 }
 
+/* the system time that passes while the master clock advances by ns */
+static inline uint64_t follow_clock(uint64_t ns, long long deviation_ppb)
+{
+	if (!deviation_ppb)
+		return ns;
+
+	return util_mul_div64(ns, 1000000000ULL,
+			      (uint64_t)(1000000000LL + deviation_ppb));
+}
+
 static void *audio_thread(void *param)
 {
 	struct audio_output *audio = param;
 	size_t rate = audio->info.samples_per_sec;
 	uint64_t samples = 0;
-	uint64_t start_time = os_gettime_ns();
+	uint64_t start_time = obs_get_clock_ns();
 	uint64_t prev_time = start_time;
 	uint64_t audio_time = prev_time;
-	uint32_t audio_wait_time = (uint32_t)(
-		audio_frames_to_ns(rate, AUDIO_OUTPUT_FRAMES) / 1000000);
+	long long deviation = 0;
+	bool offline = obs_offline_rendering_active();
+	void *mmcss;
 
 	os_set_thread_name("audio-io: audio thread");
+	bmem_set_thread_tag(bmem_register_tag("audio"));
+	mmcss = os_thread_begin_mmcss("Pro Audio");
 
 	const char *audio_thread_name =
 		profile_store_name(obs_get_profiler_name_store(),
@@ -214,26 +279,57 @@ static void *audio_thread(void *param)
 
 	while (os_event_try(audio->stop_event) == EAGAIN) {
 		uint64_t cur_time;
+		long long new_deviation;
+
+		/* the system clock and the offline clock can be far apart */
+		if (offline != obs_offline_rendering_active()) {
+			offline = !offline;
+			start_time = audio_time = prev_time =
+				obs_get_clock_ns();
+			samples = 0;
+		}
 
-		os_sleep_ms(audio_wait_time);
+		/* wake up when the next tick is due rather than after a fixed
+		 * wait, which drifts by however late each wake-up was */
+		obs_sleepto_clock_ns(audio_time);
 
 		profile_start(audio_thread_name);
 
-		cur_time = os_gettime_ns();
+		/* the ticks are counted again from the current one when the
+		 * rate of the clock changes */
+		new_deviation =
+			os_atomic_load_long_long(&audio->clock_deviation_ppb);
+		if (new_deviation != deviation) {
+			deviation = new_deviation;
+			start_time = audio_time;
+			samples = 0;
+		}
+
+		cur_time = obs_get_clock_ns();
 		while (audio_time <= cur_time) {
 			samples += AUDIO_OUTPUT_FRAMES;
-			audio_time =
-				start_time + audio_frames_to_ns(rate, samples);
+
+			uint64_t elapsed = audio_frames_to_ns(rate, samples);
+			audio_time = start_time +
+				     follow_clock(elapsed, deviation);
 
 			input_and_output(audio, audio_time, prev_time);
 			prev_time = audio_time;
 		}
 
+		/* ticks the input asked to output ahead of time, with an
+		 * empty time range */
+		while (os_atomic_load_long(&audio->catch_up_ticks) > 0) {
+			os_atomic_dec_long(&audio->catch_up_ticks);
+			input_and_output(audio, prev_time, prev_time);
+		}
+
 		profile_end(audio_thread_name);
 
 		profile_reenable_thread();
 	}
 
+	os_thread_end_mmcss(mmcss);
 	return NULL;
 }
 
@@ -255,31 +351,46 @@ static size_t audio_get_input_idx(const audio_t *audio, size_t mix_idx,
 }
 
 static inline bool audio_input_init(struct audio_input *input,
-				    struct audio_output *audio)
+				    struct audio_output *audio,
+				    struct audio_mix *mix)
 {
-	if (input->conversion.format != audio->info.format ||
-	    input->conversion.samples_per_sec != audio->info.samples_per_sec ||
-	    input->conversion.speakers != audio->info.speakers) {
-		struct resample_info from = {
-			.format = audio->info.format,
-			.samples_per_sec = audio->info.samples_per_sec,
-			.speakers = audio->info.speakers};
-
-		struct resample_info to = {
-			.format = input->conversion.format,
-			.samples_per_sec = input->conversion.samples_per_sec,
-			.speakers = input->conversion.speakers};
-
-		input->resampler = audio_resampler_create(&to, &from);
-		if (!input->resampler) {
-			blog(LOG_ERROR, "audio_input_init: Failed to "
-					"create resampler");
-			return false;
-		}
-	} else {
-		input->resampler = NULL;
+	struct mix_resampler *rs;
+
+	input->resample =
+		input->conversion.format != audio->info.format ||
+		input->conversion.samples_per_sec !=
+			audio->info.samples_per_sec ||
+		input->conversion.speakers != audio->info.speakers;
+	if (!input->resample)
+		return true;
+
+	rs = find_resampler(mix, &input->conversion);
+	if (rs) {
+		rs->refs++;
+		return true;
+	}
+
+	struct resample_info from = {
+		.format = audio->info.format,
+		.samples_per_sec = audio->info.samples_per_sec,
+		.speakers = audio->info.speakers};
+
+	struct resample_info to = {
+		.format = input->conversion.format,
+		.samples_per_sec = input->conversion.samples_per_sec,
+		.speakers = input->conversion.speakers};
+
+	audio_resampler_t *resampler = audio_resampler_create(&to, &from);
+	if (!resampler) {
+		blog(LOG_ERROR, "audio_input_init: Failed to "
+				"create resampler");
+		return false;
 	}
 
+	rs = da_push_back_new(mix->resamplers);
+	rs->conversion = input->conversion;
+	rs->resampler = resampler;
+	rs->refs = 1;
 	return true;
 }
 
@@ -317,7 +428,7 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 			input.conversion.samples_per_sec =
 				audio->info.samples_per_sec;
 
-		success = audio_input_init(&input, audio);
+		success = audio_input_init(&input, audio, mix);
 		if (success)
 			da_push_back(mix->inputs, &input);
 	}
@@ -338,7 +449,7 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 	size_t idx = audio_get_input_idx(audio, mix_idx, callback, param);
 	if (idx != DARRAY_INVALID) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
-		audio_input_free(mix->inputs.array + idx);
+		audio_input_free(mix->inputs.array + idx, mix);
 		da_erase(mix->inputs, idx);
 	}
 
@@ -408,9 +519,10 @@ void audio_output_close(audio_t *audio)
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		for (size_t i = 0; i < mix->inputs.num; i++)
-			audio_input_free(mix->inputs.array + i);
+			audio_input_free(mix->inputs.array + i, mix);
 
 		da_free(mix->inputs);
+		da_free(mix->resamplers);
 	}
 
 	os_event_destroy(audio->stop_event);
@@ -422,6 +534,19 @@ const struct audio_output_info *audio_output_get_info(const audio_t *audio)
 	return audio ? &audio->info : NULL;
 }
 
+void audio_output_catch_up(audio_t *audio, uint32_t ticks)
+{
+	if (audio)
+		os_atomic_store_long(&audio->catch_up_ticks, (long)ticks);
+}
+
+void audio_output_set_clock_deviation(audio_t *audio, long long deviation_ppb)
+{
+	if (audio)
+		os_atomic_store_long_long(&audio->clock_deviation_ppb,
+					  deviation_ppb);
+}
+
 bool audio_output_active(const audio_t *audio)
 {
 	if (!audio)
@@ -456,3 +581,19 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 {
 	return audio ? audio->info.samples_per_sec : 0;
 }
+
+bool audio_output_set_thread_affinity(audio_t *audio, const char *cpus)
+{
+	if (!audio || !audio->initialized)
+		return false;
+
+	return os_set_thread_affinity(audio->thread, cpus);
+}
+
+bool audio_output_set_thread_realtime(audio_t *audio, int priority)
+{
+	if (!audio || !audio->initialized)
+		return false;
+
+	return os_set_thread_realtime(audio->thread, priority);
+}
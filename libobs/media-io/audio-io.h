@@ -220,6 +220,20 @@ EXPORT void audio_output_disconnect(audio_t *video, size_t mix_idx,
 				    audio_output_callback_t callback,
 				    void *param);
 
+/**
+ * Makes the audio thread call the input callback for the given number of
+ * additional ticks as soon as possible, with start_ts equal to end_ts.  The
+ * input uses this to output audio it has buffered ahead of real time.
+ */
+EXPORT void audio_output_catch_up(audio_t *audio, uint32_t ticks);
+
+/**
+ * Makes the ticks follow a clock that runs faster than the system clock by
+ * deviation_ppb parts per billion, or slower if it's negative.
+ */
+EXPORT void audio_output_set_clock_deviation(audio_t *audio,
+					     long long deviation_ppb);
+
 EXPORT bool audio_output_active(const audio_t *audio);
 
 EXPORT size_t audio_output_get_block_size(const audio_t *audio);
@@ -229,6 +243,13 @@ EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
 EXPORT const struct audio_output_info *
 audio_output_get_info(const audio_t *audio);
 
+/* restricts the audio thread to a list of CPUs, see os_set_thread_affinity */
+EXPORT bool audio_output_set_thread_affinity(audio_t *audio, const char *cpus);
+
+/* switches the audio thread to a real-time priority, or back to the default
+ * policy for 0, see os_set_thread_realtime */
+EXPORT bool audio_output_set_thread_realtime(audio_t *audio, int priority);
+
 #ifdef __cplusplus
 }
 #endif
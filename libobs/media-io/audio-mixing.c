@@ -0,0 +1,122 @@
+#include "audio-mixing.h"
+#include "../util/sse-intrin.h"
+
+/* Each kernel handles 8 samples per iteration and finishes the remainder
+ * with scalar code.  On ARM the intrinsics are mapped to NEON by simde. */
+
+void audio_mix_add(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 d0 = _mm_loadu_ps(dst + i);
+		__m128 d1 = _mm_loadu_ps(dst + i + 4);
+
+		d0 = _mm_add_ps(d0, _mm_loadu_ps(src + i));
+		d1 = _mm_add_ps(d1, _mm_loadu_ps(src + i + 4));
+
+		_mm_storeu_ps(dst + i, d0);
+		_mm_storeu_ps(dst + i + 4, d1);
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+void audio_mix_add_gain(float *dst, const float *src, float gain,
+			size_t count)
+{
+	const __m128 g = _mm_set1_ps(gain);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 d0 = _mm_loadu_ps(dst + i);
+		__m128 d1 = _mm_loadu_ps(dst + i + 4);
+
+		d0 = _mm_add_ps(d0, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+		d1 = _mm_add_ps(d1, _mm_mul_ps(_mm_loadu_ps(src + i + 4), g));
+
+		_mm_storeu_ps(dst + i, d0);
+		_mm_storeu_ps(dst + i + 4, d1);
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i] * gain;
+}
+
+void audio_mix_add_mul(float *dst, const float *src, const float *gain,
+		       size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 d0 = _mm_loadu_ps(dst + i);
+		__m128 d1 = _mm_loadu_ps(dst + i + 4);
+		__m128 s0 = _mm_mul_ps(_mm_loadu_ps(src + i),
+				       _mm_loadu_ps(gain + i));
+		__m128 s1 = _mm_mul_ps(_mm_loadu_ps(src + i + 4),
+				       _mm_loadu_ps(gain + i + 4));
+
+		_mm_storeu_ps(dst + i, _mm_add_ps(d0, s0));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(d1, s1));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i] * gain[i];
+}
+
+void audio_mix_scale(float *data, float gain, size_t count)
+{
+	const __m128 g = _mm_set1_ps(gain);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), g));
+		_mm_storeu_ps(data + i + 4,
+			      _mm_mul_ps(_mm_loadu_ps(data + i + 4), g));
+	}
+
+	for (; i < count; i++)
+		data[i] *= gain;
+}
+
+void audio_mix_mul(float *data, const float *gain, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i),
+						   _mm_loadu_ps(gain + i)));
+		_mm_storeu_ps(data + i + 4,
+			      _mm_mul_ps(_mm_loadu_ps(data + i + 4),
+					 _mm_loadu_ps(gain + i + 4)));
+	}
+
+	for (; i < count; i++)
+		data[i] *= gain[i];
+}
+
+void audio_mix_clamp(float *data, size_t count)
+{
+	const __m128 max_val = _mm_set1_ps(1.0f);
+	const __m128 min_val = _mm_set1_ps(-1.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 d0 = _mm_loadu_ps(data + i);
+		__m128 d1 = _mm_loadu_ps(data + i + 4);
+
+		d0 = _mm_max_ps(_mm_min_ps(d0, max_val), min_val);
+		d1 = _mm_max_ps(_mm_min_ps(d1, max_val), min_val);
+
+		_mm_storeu_ps(data + i, d0);
+		_mm_storeu_ps(data + i + 4, d1);
+	}
+
+	for (; i < count; i++) {
+		float val = data[i];
+		val = (val > 1.0f) ? 1.0f : val;
+		val = (val < -1.0f) ? -1.0f : val;
+		data[i] = val;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Vectorized kernels for planar float audio, shared by the audio mixer,
+ * scenes and sources.  Buffers do not need any particular alignment, and
+ * dst/src must not overlap.
+ */
+
+/** dst[i] += src[i] */
+EXPORT void audio_mix_add(float *dst, const float *src, size_t count);
+
+/** dst[i] += src[i] * gain */
+EXPORT void audio_mix_add_gain(float *dst, const float *src, float gain,
+			       size_t count);
+
+/** dst[i] += src[i] * gain[i] */
+EXPORT void audio_mix_add_mul(float *dst, const float *src, const float *gain,
+			      size_t count);
+
+/** data[i] *= gain */
+EXPORT void audio_mix_scale(float *data, float gain, size_t count);
+
+/** data[i] *= gain[i] */
+EXPORT void audio_mix_mul(float *data, const float *gain, size_t count);
+
+/** Clamps every sample to [-1.0, 1.0] */
+EXPORT void audio_mix_clamp(float *data, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,231 @@
+#include <math.h>
+
+#include "audio-repack.h"
+#include "../util/sse-intrin.h"
+
+/* The vector loops handle whole groups of samples and finish the remainder
+ * with scalar code.  On ARM the intrinsics are mapped to NEON by simde. */
+
+void audio_interleave_float(float *dst, const float *const *src,
+			    size_t channels, size_t frames)
+{
+	if (channels == 2) {
+		const float *left = src[0];
+		const float *right = src[1];
+		size_t i = 0;
+
+		for (; i + 4 <= frames; i += 4) {
+			__m128 l = _mm_loadu_ps(left + i);
+			__m128 r = _mm_loadu_ps(right + i);
+
+			_mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(l, r));
+			_mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(l, r));
+		}
+
+		for (; i < frames; i++) {
+			dst[i * 2] = left[i];
+			dst[i * 2 + 1] = right[i];
+		}
+		return;
+	}
+
+	for (size_t c = 0; c < channels; c++) {
+		const float *plane = src[c];
+		float *out = dst + c;
+
+		for (size_t i = 0; i < frames; i++)
+			out[i * channels] = plane[i];
+	}
+}
+
+void audio_deinterleave_float(float *const *dst, const float *src,
+			      size_t channels, size_t frames)
+{
+	if (channels == 2) {
+		float *left = dst[0];
+		float *right = dst[1];
+		size_t i = 0;
+
+		for (; i + 4 <= frames; i += 4) {
+			__m128 a = _mm_loadu_ps(src + i * 2);
+			__m128 b = _mm_loadu_ps(src + i * 2 + 4);
+
+			__m128 l =
+				_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 r =
+				_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+			_mm_storeu_ps(left + i, l);
+			_mm_storeu_ps(right + i, r);
+		}
+
+		for (; i < frames; i++) {
+			left[i] = src[i * 2];
+			right[i] = src[i * 2 + 1];
+		}
+		return;
+	}
+
+	for (size_t c = 0; c < channels; c++) {
+		const float *in = src + c;
+		float *plane = dst[c];
+
+		for (size_t i = 0; i < frames; i++)
+			plane[i] = in[i * channels];
+	}
+}
+
+static inline float clamp_sample(float val)
+{
+	val = (val > 1.0f) ? 1.0f : val;
+	val = (val < -1.0f) ? -1.0f : val;
+	return val;
+}
+
+void audio_float_to_s16(int16_t *dst, const float *src, size_t count)
+{
+	const __m128 max_val = _mm_set1_ps(1.0f);
+	const __m128 min_val = _mm_set1_ps(-1.0f);
+	const __m128 scale = _mm_set1_ps(32768.0f);
+	size_t i = 0;
+
+	/* 1.0 scales to 32768, which the saturating pack clips to 32767 */
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_loadu_ps(src + i);
+		__m128 b = _mm_loadu_ps(src + i + 4);
+
+		a = _mm_max_ps(_mm_min_ps(a, max_val), min_val);
+		b = _mm_max_ps(_mm_min_ps(b, max_val), min_val);
+
+		__m128i ia = _mm_cvtps_epi32(_mm_mul_ps(a, scale));
+		__m128i ib = _mm_cvtps_epi32(_mm_mul_ps(b, scale));
+
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_packs_epi32(ia, ib));
+	}
+
+	for (; i < count; i++) {
+		long val = lrintf(clamp_sample(src[i]) * 32768.0f);
+		dst[i] = (int16_t)(val > 32767 ? 32767 : val);
+	}
+}
+
+void audio_s16_to_float(float *dst, const int16_t *src, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+
+		/* widen to 32 bits with the sign by shifting the high half */
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(dst + i + 4,
+			      _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+
+	for (; i < count; i++)
+		dst[i] = (float)src[i] * (1.0f / 32768.0f);
+}
+
+/* the largest float below 2^31, as 2^31 itself overflows the conversion */
+#define S32_MAX_FLOAT 2147483520.0f
+
+void audio_float_to_s32(int32_t *dst, const float *src, size_t count)
+{
+	const __m128 max_val = _mm_set1_ps(S32_MAX_FLOAT);
+	const __m128 min_val = _mm_set1_ps(-2147483648.0f);
+	const __m128 scale = _mm_set1_ps(2147483648.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+
+		a = _mm_max_ps(_mm_min_ps(a, max_val), min_val);
+		b = _mm_max_ps(_mm_min_ps(b, max_val), min_val);
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_cvtps_epi32(a));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), _mm_cvtps_epi32(b));
+	}
+
+	for (; i < count; i++) {
+		float val = src[i] * 2147483648.0f;
+		val = (val > S32_MAX_FLOAT) ? S32_MAX_FLOAT : val;
+		val = (val < -2147483648.0f) ? -2147483648.0f : val;
+		dst[i] = (int32_t)lrintf(val);
+	}
+}
+
+void audio_s32_to_float(float *dst, const int32_t *src, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + i + 4));
+
+		_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+		_mm_storeu_ps(dst + i + 4,
+			      _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+	}
+
+	for (; i < count; i++)
+		dst[i] = (float)src[i] * (1.0f / 2147483648.0f);
+}
+
+/* returns 1 for a map that keeps the leading channels in order, 2 if it also
+ * swaps the center and LFE channels, and 0 for anything else */
+static int remap_8ch_type(size_t dst_channels, const uint8_t *map)
+{
+	bool swap = dst_channels >= 4 && map[2] == 3 && map[3] == 2;
+
+	for (size_t c = 0; c < dst_channels; c++) {
+		if (swap && (c == 2 || c == 3))
+			continue;
+		if (map[c] != c)
+			return 0;
+	}
+
+	return swap ? 2 : 1;
+}
+
+static inline void remap_frame_s16(int16_t *dst, size_t dst_channels,
+				   const int16_t *src, const uint8_t *map)
+{
+	for (size_t c = 0; c < dst_channels; c++)
+		dst[c] = src[map[c]];
+}
+
+void audio_remap_s16(int16_t *dst, size_t dst_channels, const int16_t *src,
+		     size_t src_channels, const uint8_t *map, size_t frames)
+{
+	size_t i = 0;
+
+	if (src_channels == 8 && dst_channels <= 8 && frames) {
+		int type = remap_8ch_type(dst_channels, map);
+
+		/* a whole source frame is stored at once, and the channels
+		 * past dst_channels are overwritten by the next frame, so the
+		 * last frame is left to the scalar loop */
+		for (; type && i + 1 < frames; i++) {
+			__m128i frame = _mm_loadu_si128(
+				(const __m128i *)(src + i * 8));
+
+			if (type == 2)
+				frame = _mm_shufflelo_epi16(
+					frame, _MM_SHUFFLE(2, 3, 1, 0));
+
+			_mm_storeu_si128((__m128i *)(dst + i * dst_channels),
+					 frame);
+		}
+	}
+
+	for (; i < frames; i++)
+		remap_frame_s16(dst + i * dst_channels, dst_channels,
+				src + i * src_channels, map);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Vectorized kernels for converting between planar and interleaved audio,
+ * between sample formats, and for remapping the channels of interleaved
+ * audio.  Buffers do not need any particular alignment, and dst/src must not
+ * overlap.
+ *
+ * Float samples are expected in [-1.0, 1.0], and are clamped when converted
+ * to integers.
+ */
+
+/** Interleaves the planes of src into dst */
+EXPORT void audio_interleave_float(float *dst, const float *const *src,
+				   size_t channels, size_t frames);
+
+/** Splits the interleaved frames of src into the planes of dst */
+EXPORT void audio_deinterleave_float(float *const *dst, const float *src,
+				     size_t channels, size_t frames);
+
+EXPORT void audio_float_to_s16(int16_t *dst, const float *src, size_t count);
+EXPORT void audio_s16_to_float(float *dst, const int16_t *src, size_t count);
+EXPORT void audio_float_to_s32(int32_t *dst, const float *src, size_t count);
+EXPORT void audio_s32_to_float(float *dst, const int32_t *src, size_t count);
+
+/**
+ * Remaps interleaved 16-bit frames, channel c of each dst frame is taken from
+ * channel map[c] of the src frame.
+ *
+ * Frames of 8 channels, the channel count of SDI and HDMI capture cards, that
+ * only drop trailing channels or swap the center and LFE channels have a fast
+ * path.
+ */
+EXPORT void audio_remap_s16(int16_t *dst, size_t dst_channels,
+			    const int16_t *src, size_t src_channels,
+			    const uint8_t *map, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -16,14 +16,25 @@
 ******************************************************************************/
 
 #include "../util/bmem.h"
+#include "../util/sse-intrin.h"
 #include "audio-resampler.h"
 #include "audio-io.h"
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 
+/* conversions between float formats of the same rate and layout, which only
+ * change how the channels are laid out, are done without swresample */
+enum direct_conversion {
+	DIRECT_NONE,
+	DIRECT_COPY,
+	DIRECT_INTERLEAVE,
+	DIRECT_DEINTERLEAVE,
+};
+
 struct audio_resampler {
 	struct SwrContext *context;
+	enum direct_conversion direct;
 	bool opened;
 
 	uint32_t input_freq;
@@ -91,6 +102,26 @@ static inline uint64_t convert_speaker_layout(enum speaker_layout layout)
 	return 0;
 }
 
+static enum direct_conversion
+get_direct_conversion(const struct resample_info *dst,
+		      const struct resample_info *src)
+{
+	const bool src_float = src->format == AUDIO_FORMAT_FLOAT ||
+			       src->format == AUDIO_FORMAT_FLOAT_PLANAR;
+	const bool dst_float = dst->format == AUDIO_FORMAT_FLOAT ||
+			       dst->format == AUDIO_FORMAT_FLOAT_PLANAR;
+
+	if (!src_float || !dst_float ||
+	    src->samples_per_sec != dst->samples_per_sec ||
+	    src->speakers != dst->speakers || src->speakers == SPEAKERS_UNKNOWN)
+		return DIRECT_NONE;
+
+	if (src->format == dst->format)
+		return DIRECT_COPY;
+	return is_audio_planar(src->format) ? DIRECT_INTERLEAVE
+					    : DIRECT_DEINTERLEAVE;
+}
+
 audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 					  const struct resample_info *src)
 {
@@ -108,6 +139,10 @@ audio_resampler_t *audio_resampler_create(const struct resample_info *dst,
 	rs->output_format = convert_audio_format(dst->format);
 	rs->output_planes = is_audio_planar(dst->format) ? rs->output_ch : 1;
 
+	rs->direct = get_direct_conversion(dst, src);
+	if (rs->direct != DIRECT_NONE)
+		return rs;
+
 	rs->context = swr_alloc_set_opts(NULL, rs->output_layout,
 					 rs->output_format,
 					 dst->samples_per_sec, rs->input_layout,
@@ -160,6 +195,94 @@ void audio_resampler_destroy(audio_resampler_t *rs)
 	}
 }
 
+static void interleave(float *dst, const float *const *src, uint32_t ch,
+		       uint32_t frames)
+{
+	uint32_t i = 0;
+
+	if (ch == 2) {
+		const float *l = src[0];
+		const float *r = src[1];
+
+		for (; i + 4 <= frames; i += 4) {
+			__m128 a = _mm_loadu_ps(l + i);
+			__m128 b = _mm_loadu_ps(r + i);
+			_mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(a, b));
+			_mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(a, b));
+		}
+	}
+
+	for (; i < frames; i++) {
+		for (uint32_t c = 0; c < ch; c++)
+			dst[i * ch + c] = src[c][i];
+	}
+}
+
+static void deinterleave(float *const *dst, const float *src, uint32_t ch,
+			 uint32_t frames)
+{
+	uint32_t i = 0;
+
+	if (ch == 2) {
+		float *l = dst[0];
+		float *r = dst[1];
+
+		/* 0x88 and 0xdd select the even and odd floats of a, b */
+		for (; i + 4 <= frames; i += 4) {
+			__m128 a = _mm_loadu_ps(src + i * 2);
+			__m128 b = _mm_loadu_ps(src + i * 2 + 4);
+			_mm_storeu_ps(l + i, _mm_shuffle_ps(a, b, 0x88));
+			_mm_storeu_ps(r + i, _mm_shuffle_ps(a, b, 0xdd));
+		}
+	}
+
+	for (; i < frames; i++) {
+		for (uint32_t c = 0; c < ch; c++)
+			dst[c][i] = src[i * ch + c];
+	}
+}
+
+static void resize_output_buffer(struct audio_resampler *rs, int frames)
+{
+	if (frames <= rs->output_size)
+		return;
+
+	if (rs->output_buffer[0])
+		av_freep(&rs->output_buffer[0]);
+
+	av_samples_alloc(rs->output_buffer, NULL, rs->output_ch, frames,
+			 rs->output_format, 0);
+
+	rs->output_size = frames;
+}
+
+static bool resample_direct(struct audio_resampler *rs, uint8_t *output[],
+			    const uint8_t *const input[], uint32_t in_frames)
+{
+	if (rs->direct == DIRECT_COPY) {
+		for (uint32_t i = 0; i < rs->output_planes; i++)
+			output[i] = (uint8_t *)input[i];
+		return true;
+	}
+
+	resize_output_buffer(rs, (int)in_frames);
+	if (!rs->output_buffer[0])
+		return false;
+
+	if (rs->direct == DIRECT_INTERLEAVE)
+		interleave((float *)rs->output_buffer[0],
+			   (const float *const *)input, rs->output_ch,
+			   in_frames);
+	else
+		deinterleave((float *const *)rs->output_buffer,
+			     (const float *)input[0], rs->output_ch,
+			     in_frames);
+
+	for (uint32_t i = 0; i < rs->output_planes; i++)
+		output[i] = rs->output_buffer[i];
+	return true;
+}
+
 bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
 			      uint32_t *out_frames, uint64_t *ts_offset,
 			      const uint8_t *const input[], uint32_t in_frames)
@@ -167,6 +290,12 @@ bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
 	if (!rs)
 		return false;
 
+	if (rs->direct != DIRECT_NONE) {
+		*ts_offset = 0;
+		*out_frames = in_frames;
+		return resample_direct(rs, output, input, in_frames);
+	}
+
 	struct SwrContext *context = rs->context;
 	int ret;
 
@@ -179,15 +308,7 @@ bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
 	*ts_offset = (uint64_t)swr_get_delay(context, 1000000000);
 
 	/* resize the buffer if bigger */
-	if (estimated > rs->output_size) {
-		if (rs->output_buffer[0])
-			av_freep(&rs->output_buffer[0]);
-
-		av_samples_alloc(rs->output_buffer, NULL, rs->output_ch,
-				 estimated, rs->output_format, 0);
-
-		rs->output_size = estimated;
-	}
+	resize_output_buffer(rs, estimated);
 
 	ret = swr_convert(context, rs->output_buffer, rs->output_size,
 			  (const uint8_t **)input, in_frames);
@@ -17,7 +17,22 @@
 
 #include "format-conversion.h"
 
+#include "../util/platform.h"
+
+/* AVX2 kernels are compiled with a function-level target so the rest of
+ * libobs does not need to be built with AVX2 enabled.  x86-64 always has
+ * native SSE2; elsewhere the SSE2 kernels are routed to NEON by simde. */
+#if defined(_M_X64) || defined(__x86_64__)
+#define FORMAT_CONVERSION_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define AVX2_FUNC
+#else
+#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+#else
 #include "../util/sse-intrin.h"
+#endif
 
 /* ...surprisingly, if I don't use a macro to force inlining, it causes the
  * CPU usage to boost by a tremendous amount in debug builds. */
@@ -90,9 +105,15 @@ static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
 	return a < b ? a : b;
 }
 
-void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
-			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
-			   const uint32_t out_linesize[])
+/* ------------------------------------------------------------------------- */
+/* SSE2 (and NEON through simde) kernels                                     */
+
+static inline void compress_uyvx_to_i420_sse2(const uint8_t *input,
+					      uint32_t in_linesize,
+					      uint32_t start_y, uint32_t end_y,
+					      uint32_t start_x,
+					      uint8_t *output[],
+					      const uint32_t out_linesize[])
 {
 	uint8_t *lum_plane = output[0];
 	uint8_t *u_plane = output[1];
@@ -109,7 +130,7 @@ void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
 		uint32_t lum_y_pos = y * out_linesize[0];
 		uint32_t x;
 
-		for (x = 0; x < width; x += 4) {
+		for (x = start_x; x < width; x += 4) {
 			const uint8_t *img = input + y_pos + x * 4;
 			uint32_t lum_pos0 = lum_y_pos + x;
 			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
@@ -127,9 +148,12 @@ void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
 	}
 }
 
-void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
-			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
-			   const uint32_t out_linesize[])
+static inline void compress_uyvx_to_nv12_sse2(const uint8_t *input,
+					      uint32_t in_linesize,
+					      uint32_t start_y, uint32_t end_y,
+					      uint32_t start_x,
+					      uint8_t *output[],
+					      const uint32_t out_linesize[])
 {
 	uint8_t *lum_plane = output[0];
 	uint8_t *chroma_plane = output[1];
@@ -145,7 +169,7 @@ void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
 		uint32_t lum_y_pos = y * out_linesize[0];
 		uint32_t x;
 
-		for (x = 0; x < width; x += 4) {
+		for (x = start_x; x < width; x += 4) {
 			const uint8_t *img = input + y_pos + x * 4;
 			uint32_t lum_pos0 = lum_y_pos + x;
 			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
@@ -162,9 +186,12 @@ void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
 	}
 }
 
-void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize,
-			  uint32_t start_y, uint32_t end_y, uint8_t *output[],
-			  const uint32_t out_linesize[])
+static inline void convert_uyvx_to_i444_sse2(const uint8_t *input,
+					     uint32_t in_linesize,
+					     uint32_t start_y, uint32_t end_y,
+					     uint32_t start_x,
+					     uint8_t *output[],
+					     const uint32_t out_linesize[])
 {
 	uint8_t *lum_plane = output[0];
 	uint8_t *u_plane = output[1];
@@ -181,7 +208,7 @@ void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize,
 		uint32_t lum_y_pos = y * out_linesize[0];
 		uint32_t x;
 
-		for (x = 0; x < width; x += 4) {
+		for (x = start_x; x < width; x += 4) {
 			const uint8_t *img = input + y_pos + x * 4;
 			uint32_t lum_pos0 = lum_y_pos + x;
 			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
@@ -200,9 +227,35 @@ void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize,
 	}
 }
 
-void decompress_420(const uint8_t *const input[], const uint32_t in_linesize[],
-		    uint32_t start_y, uint32_t end_y, uint8_t *output,
-		    uint32_t out_linesize)
+/* expands 8 luma samples and 4 shared 16-bit chroma values (already in
+ * output byte order) into 8 packed 32-bit pixels */
+#define unpack_row_sse2(out, lum8, chroma16, lum_shift, chroma_shift)         \
+	do {                                                                   \
+		__m128i zero = _mm_setzero_si128();                            \
+		__m128i lum16 = _mm_unpacklo_epi8(lum8, zero);                 \
+		__m128i ch_dup = _mm_unpacklo_epi16(chroma16, chroma16);       \
+		__m128i px0 = _mm_or_si128(                                    \
+			_mm_slli_epi32(_mm_unpacklo_epi16(lum16, zero),        \
+				       lum_shift),                             \
+			_mm_slli_epi32(_mm_unpacklo_epi16(ch_dup, zero),       \
+				       chroma_shift));                         \
+		__m128i px1 = _mm_or_si128(                                    \
+			_mm_slli_epi32(_mm_unpackhi_epi16(lum16, zero),        \
+				       lum_shift),                             \
+			_mm_slli_epi32(_mm_unpackhi_epi16(ch_dup, zero),       \
+				       chroma_shift));                         \
+		_mm_storeu_si128((__m128i *)(out), px0);                       \
+		_mm_storeu_si128((__m128i *)(out) + 1, px1);                   \
+	} while (false)
+
+/* The decompress kernels are bound by memory bandwidth; AVX2 versions
+ * measured no faster than these, so they are used on every CPU. */
+
+static inline void decompress_420_sse2(const uint8_t *const input[],
+				       const uint32_t in_linesize[],
+				       uint32_t start_y, uint32_t end_y,
+				       uint32_t start_x, uint8_t *output,
+				       uint32_t out_linesize)
 {
 	uint32_t start_y_d2 = start_y / 2;
 	uint32_t width_d2 = in_linesize[0] / 2;
@@ -212,31 +265,48 @@ void decompress_420(const uint8_t *const input[], const uint32_t in_linesize[],
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
 		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
-		register const uint8_t *lum0, *lum1;
-		register uint32_t *output0, *output1;
-		uint32_t x;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x = start_x;
 
 		lum0 = input[0] + y * 2 * in_linesize[0];
 		lum1 = lum0 + in_linesize[0];
 		output0 = (uint32_t *)(output + y * 2 * out_linesize);
 		output1 = (uint32_t *)((uint8_t *)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
-			uint32_t out;
-			out = (*(chroma0++) << 8) | *(chroma1++);
+		for (; x + 4 <= width_d2; x += 4) {
+			__m128i c0 = _mm_cvtsi32_si128(
+				*(const int32_t *)(chroma0 + x));
+			__m128i c1 = _mm_cvtsi32_si128(
+				*(const int32_t *)(chroma1 + x));
+			__m128i chroma = _mm_unpacklo_epi8(c1, c0);
 
-			*(output0++) = (*(lum0++) << 16) | out;
-			*(output0++) = (*(lum0++) << 16) | out;
+			__m128i l0 = _mm_loadl_epi64(
+				(const __m128i *)(lum0 + x * 2));
+			__m128i l1 = _mm_loadl_epi64(
+				(const __m128i *)(lum1 + x * 2));
 
-			*(output1++) = (*(lum1++) << 16) | out;
-			*(output1++) = (*(lum1++) << 16) | out;
+			unpack_row_sse2(output0 + x * 2, l0, chroma, 16, 0);
+			unpack_row_sse2(output1 + x * 2, l1, chroma, 16, 0);
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t out = (chroma0[x] << 8) | chroma1[x];
+
+			output0[x * 2] = (lum0[x * 2] << 16) | out;
+			output0[x * 2 + 1] = (lum0[x * 2 + 1] << 16) | out;
+
+			output1[x * 2] = (lum1[x * 2] << 16) | out;
+			output1[x * 2 + 1] = (lum1[x * 2 + 1] << 16) | out;
 		}
 	}
 }
 
-void decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[],
-		     uint32_t start_y, uint32_t end_y, uint8_t *output,
-		     uint32_t out_linesize)
+static inline void decompress_nv12_sse2(const uint8_t *const input[],
+					const uint32_t in_linesize[],
+					uint32_t start_y, uint32_t end_y,
+					uint32_t start_x, uint8_t *output,
+					uint32_t out_linesize)
 {
 	uint32_t start_y_d2 = start_y / 2;
 	uint32_t width_d2 = min_uint32(in_linesize[0], out_linesize) / 2;
@@ -245,9 +315,9 @@ void decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[],
 
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint16_t *chroma;
-		register const uint8_t *lum0, *lum1;
-		register uint32_t *output0, *output1;
-		uint32_t x;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x = start_x;
 
 		chroma = (const uint16_t *)(input[1] + y * in_linesize[1]);
 		lum0 = input[0] + y * 2 * in_linesize[0];
@@ -255,64 +325,348 @@ void decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[],
 		output0 = (uint32_t *)(output + y * 2 * out_linesize);
 		output1 = (uint32_t *)((uint8_t *)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
-			uint32_t out = *(chroma++) << 8;
+		for (; x + 4 <= width_d2; x += 4) {
+			__m128i uv = _mm_loadl_epi64(
+				(const __m128i *)(chroma + x));
+
+			__m128i l0 = _mm_loadl_epi64(
+				(const __m128i *)(lum0 + x * 2));
+			__m128i l1 = _mm_loadl_epi64(
+				(const __m128i *)(lum1 + x * 2));
+
+			unpack_row_sse2(output0 + x * 2, l0, uv, 0, 8);
+			unpack_row_sse2(output1 + x * 2, l1, uv, 0, 8);
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t out = chroma[x] << 8;
 
-			*(output0++) = *(lum0++) | out;
-			*(output0++) = *(lum0++) | out;
+			output0[x * 2] = lum0[x * 2] | out;
+			output0[x * 2 + 1] = lum0[x * 2 + 1] | out;
 
-			*(output1++) = *(lum1++) | out;
-			*(output1++) = *(lum1++) | out;
+			output1[x * 2] = lum1[x * 2] | out;
+			output1[x * 2 + 1] = lum1[x * 2 + 1] | out;
 		}
 	}
 }
 
-void decompress_422(const uint8_t *input, uint32_t in_linesize,
-		    uint32_t start_y, uint32_t end_y, uint8_t *output,
-		    uint32_t out_linesize, bool leading_lum)
+static FORCE_INLINE uint32_t expand_422_leading(uint32_t dw)
+{
+	return (dw & 0xFFFFFF00) | (uint8_t)(dw >> 16);
+}
+
+static FORCE_INLINE uint32_t expand_422(uint32_t dw)
+{
+	return (dw & 0xFFFF00FF) | ((dw >> 16) & 0xFF00);
+}
+
+static inline void decompress_422_sse2(const uint8_t *input,
+				       uint32_t in_linesize, uint32_t start_y,
+				       uint32_t end_y, uint32_t start_x,
+				       uint8_t *output, uint32_t out_linesize,
+				       bool leading_lum)
 {
 	uint32_t width_d2 = min_uint32(in_linesize, out_linesize) / 2;
 	uint32_t y;
 
-	register const uint32_t *input32;
-	register const uint32_t *input32_end;
-	register uint32_t *output32;
+	const __m128i keep_mask = _mm_set1_epi32(leading_lum ? 0xFFFFFF00
+							     : 0xFFFF00FF);
+	const __m128i lum_mask = _mm_set1_epi32(leading_lum ? 0x000000FF
+							    : 0x0000FF00);
+
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32 =
+			(const uint32_t *)(input + y * in_linesize);
+		uint32_t *output32 = (uint32_t *)(output + y * out_linesize);
+		uint32_t x = start_x;
+
+		for (; x + 4 <= width_d2; x += 4) {
+			__m128i dw = _mm_loadu_si128(
+				(const __m128i *)(input32 + x));
+			__m128i dup = _mm_or_si128(
+				_mm_and_si128(dw, keep_mask),
+				_mm_and_si128(_mm_srli_epi32(dw, 16),
+					      lum_mask));
+
+			_mm_storeu_si128((__m128i *)(output32 + x * 2),
+					 _mm_unpacklo_epi32(dw, dup));
+			_mm_storeu_si128((__m128i *)(output32 + x * 2 + 4),
+					 _mm_unpackhi_epi32(dw, dup));
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t dw = input32[x];
+
+			output32[x * 2] = dw;
+			output32[x * 2 + 1] = leading_lum
+						      ? expand_422_leading(dw)
+						      : expand_422(dw);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* AVX2 kernels                                                              */
+
+#ifdef FORMAT_CONVERSION_AVX2
+
+/* packs the selected byte of 8 pixels from two rows into 8 bytes per row */
+static FORCE_INLINE AVX2_FUNC void
+pack_rows_avx2(uint8_t *plane, uint32_t pos0, uint32_t pos1, __m256i line1,
+	       __m256i line2, __m256i mask, int shift)
+{
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	__m256i l1 = _mm256_srli_epi32(_mm256_and_si256(line1, mask), shift);
+	__m256i l2 = _mm256_srli_epi32(_mm256_and_si256(line2, mask), shift);
+	__m256i val = _mm256_packs_epi32(l1, l2);
+	__m128i rows;
+
+	/* dwords 0/4 hold row 1, dwords 1/5 hold row 2 */
+	val = _mm256_packus_epi16(val, val);
+	rows = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(val, order));
+
+	_mm_storel_epi64((__m128i *)(plane + pos0), rows);
+	_mm_storel_epi64((__m128i *)(plane + pos1), _mm_srli_si128(rows, 8));
+}
 
-	if (leading_lum) {
-		for (y = start_y; y < end_y; y++) {
-			input32 = (const uint32_t *)(input + y * in_linesize);
-			input32_end = input32 + width_d2;
-			output32 = (uint32_t *)(output + y * out_linesize);
+/* averages the chroma of each 2x2 block; the low dword of each 128-bit lane
+ * of the result holds U/V for two output samples */
+static FORCE_INLINE AVX2_FUNC __m256i average_chroma_avx2(__m256i line1,
+							 __m256i line2,
+							 __m256i uv_mask)
+{
+	__m256i add_val = _mm256_add_epi16(_mm256_and_si256(line1, uv_mask),
+					   _mm256_and_si256(line2, uv_mask));
+	__m256i avg_val = _mm256_add_epi16(
+		add_val,
+		_mm256_shuffle_epi32(add_val, _MM_SHUFFLE(2, 3, 0, 1)));
+	avg_val = _mm256_srli_epi16(avg_val, 2);
+	return _mm256_shuffle_epi32(avg_val, _MM_SHUFFLE(3, 1, 2, 0));
+}
 
-			while (input32 < input32_end) {
-				register uint32_t dw = *input32;
+static AVX2_FUNC void compress_uyvx_to_i420_avx2(
+	const uint8_t *input, uint32_t in_linesize, uint32_t start_y,
+	uint32_t end_y, uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane = output[0];
+	uint8_t *u_plane = output[1];
+	uint8_t *v_plane = output[2];
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t avx_width = width & ~7;
+	uint32_t y;
 
-				output32[0] = dw;
-				dw &= 0xFFFFFF00;
-				dw |= (uint8_t)(dw >> 16);
-				output32[1] = dw;
+	const __m256i lum_mask = _mm256_set1_epi32(0x0000FF00);
+	const __m256i uv_mask = _mm256_set1_epi16(0x00FF);
+	const __m256i order = _mm256_setr_epi32(0, 4, 0, 4, 0, 4, 0, 4);
+	const __m128i split =
+		_mm_setr_epi8(0, 2, 4, 6, 1, 3, 5, 7, 8, 10, 12, 14, 9, 11, 13,
+			      15);
 
-				output32 += 2;
-				input32++;
-			}
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos = y * in_linesize;
+		uint32_t chroma_y_pos = (y >> 1) * out_linesize[1];
+		uint32_t lum_y_pos = y * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < avx_width; x += 8) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+			uint32_t chroma_pos = chroma_y_pos + (x >> 1);
+
+			__m256i line1 =
+				_mm256_loadu_si256((const __m256i *)img);
+			__m256i line2 = _mm256_loadu_si256(
+				(const __m256i *)(img + in_linesize));
+
+			pack_rows_avx2(lum_plane, lum_pos0, lum_pos1, line1,
+				       line2, lum_mask, 8);
+
+			__m256i avg = average_chroma_avx2(line1, line2,
+							  uv_mask);
+			avg = _mm256_packus_epi16(avg, avg);
+			avg = _mm256_permutevar8x32_epi32(avg, order);
+
+			/* U0 V0 U1 V1 U2 V2 U3 V3 -> U0..U3 V0..V3 */
+			__m128i uv = _mm_shuffle_epi8(
+				_mm256_castsi256_si128(avg), split);
+
+			*(uint32_t *)(u_plane + chroma_pos) =
+				(uint32_t)_mm_cvtsi128_si32(uv);
+			*(uint32_t *)(v_plane + chroma_pos) =
+				(uint32_t)_mm_cvtsi128_si32(
+					_mm_srli_si128(uv, 4));
 		}
-	} else {
-		for (y = start_y; y < end_y; y++) {
-			input32 = (const uint32_t *)(input + y * in_linesize);
-			input32_end = input32 + width_d2;
-			output32 = (uint32_t *)(output + y * out_linesize);
-
-			while (input32 < input32_end) {
-				register uint32_t dw = *input32;
-
-				output32[0] = dw;
-				dw &= 0xFFFF00FF;
-				dw |= (dw >> 16) & 0xFF00;
-				output32[1] = dw;
-
-				output32 += 2;
-				input32++;
-			}
+	}
+
+	if (avx_width < width)
+		compress_uyvx_to_i420_sse2(input, in_linesize, start_y, end_y,
+					   avx_width, output, out_linesize);
+}
+
+static AVX2_FUNC void compress_uyvx_to_nv12_avx2(
+	const uint8_t *input, uint32_t in_linesize, uint32_t start_y,
+	uint32_t end_y, uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane = output[0];
+	uint8_t *chroma_plane = output[1];
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t avx_width = width & ~7;
+	uint32_t y;
+
+	const __m256i lum_mask = _mm256_set1_epi32(0x0000FF00);
+	const __m256i uv_mask = _mm256_set1_epi16(0x00FF);
+	const __m256i order = _mm256_setr_epi32(0, 4, 0, 4, 0, 4, 0, 4);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos = y * in_linesize;
+		uint32_t chroma_y_pos = (y >> 1) * out_linesize[1];
+		uint32_t lum_y_pos = y * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < avx_width; x += 8) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+
+			__m256i line1 =
+				_mm256_loadu_si256((const __m256i *)img);
+			__m256i line2 = _mm256_loadu_si256(
+				(const __m256i *)(img + in_linesize));
+
+			pack_rows_avx2(lum_plane, lum_pos0, lum_pos1, line1,
+				       line2, lum_mask, 8);
+
+			__m256i avg = average_chroma_avx2(line1, line2,
+							  uv_mask);
+			avg = _mm256_packus_epi16(avg, avg);
+			avg = _mm256_permutevar8x32_epi32(avg, order);
+
+			_mm_storel_epi64(
+				(__m128i *)(chroma_plane + chroma_y_pos + x),
+				_mm256_castsi256_si128(avg));
 		}
 	}
+
+	if (avx_width < width)
+		compress_uyvx_to_nv12_sse2(input, in_linesize, start_y, end_y,
+					   avx_width, output, out_linesize);
+}
+
+static AVX2_FUNC void convert_uyvx_to_i444_avx2(
+	const uint8_t *input, uint32_t in_linesize, uint32_t start_y,
+	uint32_t end_y, uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane = output[0];
+	uint8_t *u_plane = output[1];
+	uint8_t *v_plane = output[2];
+	uint32_t width = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t avx_width = width & ~7;
+	uint32_t y;
+
+	const __m256i lum_mask = _mm256_set1_epi32(0x0000FF00);
+	const __m256i u_mask = _mm256_set1_epi32(0x000000FF);
+	const __m256i v_mask = _mm256_set1_epi32(0x00FF0000);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos = y * in_linesize;
+		uint32_t lum_y_pos = y * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < avx_width; x += 8) {
+			const uint8_t *img = input + y_pos + x * 4;
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint32_t lum_pos1 = lum_pos0 + out_linesize[0];
+
+			__m256i line1 =
+				_mm256_loadu_si256((const __m256i *)img);
+			__m256i line2 = _mm256_loadu_si256(
+				(const __m256i *)(img + in_linesize));
+
+			pack_rows_avx2(lum_plane, lum_pos0, lum_pos1, line1,
+				       line2, lum_mask, 8);
+			pack_rows_avx2(u_plane, lum_pos0, lum_pos1, line1,
+				       line2, u_mask, 0);
+			pack_rows_avx2(v_plane, lum_pos0, lum_pos1, line1,
+				       line2, v_mask, 16);
+		}
+	}
+
+	if (avx_width < width)
+		convert_uyvx_to_i444_sse2(input, in_linesize, start_y, end_y,
+					  avx_width, output, out_linesize);
+}
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Runtime dispatch                                                          */
+
+void compress_uyvx_to_i420(const uint8_t *input, uint32_t in_linesize,
+			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			   const uint32_t out_linesize[])
+{
+#ifdef FORMAT_CONVERSION_AVX2
+	if (os_cpu_has_avx2()) {
+		compress_uyvx_to_i420_avx2(input, in_linesize, start_y, end_y,
+					   output, out_linesize);
+		return;
+	}
+#endif
+	compress_uyvx_to_i420_sse2(input, in_linesize, start_y, end_y, 0,
+				   output, out_linesize);
+}
+
+void compress_uyvx_to_nv12(const uint8_t *input, uint32_t in_linesize,
+			   uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			   const uint32_t out_linesize[])
+{
+#ifdef FORMAT_CONVERSION_AVX2
+	if (os_cpu_has_avx2()) {
+		compress_uyvx_to_nv12_avx2(input, in_linesize, start_y, end_y,
+					   output, out_linesize);
+		return;
+	}
+#endif
+	compress_uyvx_to_nv12_sse2(input, in_linesize, start_y, end_y, 0,
+				   output, out_linesize);
+}
+
+void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize,
+			  uint32_t start_y, uint32_t end_y, uint8_t *output[],
+			  const uint32_t out_linesize[])
+{
+#ifdef FORMAT_CONVERSION_AVX2
+	if (os_cpu_has_avx2()) {
+		convert_uyvx_to_i444_avx2(input, in_linesize, start_y, end_y,
+					  output, out_linesize);
+		return;
+	}
+#endif
+	convert_uyvx_to_i444_sse2(input, in_linesize, start_y, end_y, 0,
+				  output, out_linesize);
+}
+
+void decompress_420(const uint8_t *const input[], const uint32_t in_linesize[],
+		    uint32_t start_y, uint32_t end_y, uint8_t *output,
+		    uint32_t out_linesize)
+{
+	decompress_420_sse2(input, in_linesize, start_y, end_y, 0, output,
+			    out_linesize);
+}
+
+void decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[],
+		     uint32_t start_y, uint32_t end_y, uint8_t *output,
+		     uint32_t out_linesize)
+{
+	decompress_nv12_sse2(input, in_linesize, start_y, end_y, 0, output,
+			     out_linesize);
+}
+
+void decompress_422(const uint8_t *input, uint32_t in_linesize,
+		    uint32_t start_y, uint32_t end_y, uint8_t *output,
+		    uint32_t out_linesize, bool leading_lum)
+{
+	decompress_422_sse2(input, in_linesize, start_y, end_y, 0, output,
+			    out_linesize, leading_lum);
 }
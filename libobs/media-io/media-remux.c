@@ -32,11 +32,101 @@
 #define CODEC_FLAG_GLOBAL_H CODEC_FLAG_GLOBAL_HEADER
 #endif
 
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+#define AVIO_WRITE_BUF const uint8_t
+#else
+#define AVIO_WRITE_BUF uint8_t
+#endif
+
+/* files are read and written through AVIO buffers this large instead of
+ * the 32 KiB libavformat uses by default, which keeps the number of I/O
+ * calls low when a few remuxes run at once.  the FILE streams themselves
+ * are unbuffered so that everything the muxer has flushed is on disk when
+ * fast start reopens the output */
+#define REMUX_IO_BUFFER_SIZE (4 * 1024 * 1024)
+
 struct media_remux_job {
 	int64_t in_size;
 	AVFormatContext *ifmt_ctx, *ofmt_ctx;
+
+	FILE *in_file, *out_file;
+	AVIOContext *in_io, *out_io;
+	bool fast_start;
 };
 
+static int read_file(void *opaque, uint8_t *buf, int buf_size)
+{
+	size_t size = fread(buf, 1, buf_size, opaque);
+	if (!size)
+		return feof((FILE *)opaque) ? AVERROR_EOF : AVERROR(EIO);
+	return (int)size;
+}
+
+static int write_file(void *opaque, AVIO_WRITE_BUF *buf, int buf_size)
+{
+	size_t size = fwrite(buf, 1, buf_size, opaque);
+	return size == (size_t)buf_size ? buf_size : AVERROR(EIO);
+}
+
+static int64_t seek_file(void *opaque, int64_t offset, int whence)
+{
+	FILE *file = opaque;
+
+	if (whence == AVSEEK_SIZE) {
+		int64_t pos = os_ftelli64(file);
+		int64_t size;
+
+		if (os_fseeki64(file, 0, SEEK_END) != 0)
+			return AVERROR(EIO);
+		size = os_ftelli64(file);
+		os_fseeki64(file, pos, SEEK_SET);
+		return size;
+	}
+
+	if (os_fseeki64(file, offset, whence & ~AVSEEK_FORCE) != 0)
+		return AVERROR(EIO);
+	return os_ftelli64(file);
+}
+
+static AVIOContext *open_file_io(FILE **file, const char *path, bool write)
+{
+	AVIOContext *io;
+	uint8_t *buf;
+
+	*file = os_fopen(path, write ? "wb" : "rb");
+	if (!*file)
+		return NULL;
+
+	setvbuf(*file, NULL, _IONBF, 0);
+
+	buf = av_malloc(REMUX_IO_BUFFER_SIZE);
+	io = buf ? avio_alloc_context(buf, REMUX_IO_BUFFER_SIZE, write, *file,
+				      write ? NULL : read_file,
+				      write ? write_file : NULL, seek_file)
+		 : NULL;
+	if (!io) {
+		av_free(buf);
+		fclose(*file);
+		*file = NULL;
+	}
+
+	return io;
+}
+
+static void close_file_io(FILE **file, AVIOContext **io)
+{
+	if (*io) {
+		if ((*io)->write_flag)
+			avio_flush(*io);
+		av_freep(&(*io)->buffer);
+		av_freep(io);
+	}
+	if (*file) {
+		fclose(*file);
+		*file = NULL;
+	}
+}
+
 static inline void init_size(media_remux_job_t job, const char *in_filename)
 {
 #ifdef _MSC_VER
@@ -51,7 +141,22 @@ static inline void init_size(media_remux_job_t job, const char *in_filename)
 
 static inline bool init_input(media_remux_job_t job, const char *in_filename)
 {
-	int ret = avformat_open_input(&job->ifmt_ctx, in_filename, NULL, NULL);
+	int ret;
+
+	/* anything that can't be opened as a plain file is left to
+	 * libavformat's own I/O */
+	job->in_io = open_file_io(&job->in_file, in_filename, false);
+	if (job->in_io) {
+		job->ifmt_ctx = avformat_alloc_context();
+		if (!job->ifmt_ctx) {
+			blog(LOG_ERROR, "media_remux: Could not allocate input "
+					"context");
+			return false;
+		}
+		job->ifmt_ctx->pb = job->in_io;
+	}
+
+	ret = avformat_open_input(&job->ifmt_ctx, in_filename, NULL, NULL);
 	if (ret < 0) {
 		blog(LOG_ERROR, "media_remux: Could not open input file '%s'",
 		     in_filename);
@@ -126,6 +231,12 @@ static inline bool init_output(media_remux_job_t job, const char *out_filename)
 #endif
 
 	if (!(job->ofmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+		job->out_io = open_file_io(&job->out_file, out_filename, true);
+		if (job->out_io) {
+			job->ofmt_ctx->pb = job->out_io;
+			return true;
+		}
+
 		ret = avio_open(&job->ofmt_ctx->pb, out_filename,
 				AVIO_FLAG_WRITE);
 		if (ret < 0) {
@@ -240,13 +351,19 @@ static inline int process_packets(media_remux_job_t job,
 bool media_remux_job_process(media_remux_job_t job,
 			     media_remux_progress_callback callback, void *data)
 {
+	AVDictionary *options = NULL;
 	int ret;
 	bool success = false;
 
 	if (!job)
 		return success;
 
-	ret = avformat_write_header(job->ofmt_ctx, NULL);
+	/* other muxers leave the option unused */
+	if (job->fast_start)
+		av_dict_set(&options, "movflags", "+faststart", 0);
+
+	ret = avformat_write_header(job->ofmt_ctx, &options);
+	av_dict_free(&options);
 	if (ret < 0) {
 		blog(LOG_ERROR, "media_remux: Error opening output file: %s",
 		     av_err2str(ret));
@@ -272,15 +389,27 @@ bool media_remux_job_process(media_remux_job_t job,
 	return success;
 }
 
+void media_remux_job_set_fast_start(media_remux_job_t job, bool fast_start)
+{
+	if (job)
+		job->fast_start = fast_start;
+}
+
 void media_remux_job_destroy(media_remux_job_t job)
 {
 	if (!job)
 		return;
 
 	avformat_close_input(&job->ifmt_ctx);
+	close_file_io(&job->in_file, &job->in_io);
 
-	if (job->ofmt_ctx && !(job->ofmt_ctx->oformat->flags & AVFMT_NOFILE))
+	if (job->out_io) {
+		job->ofmt_ctx->pb = NULL;
+		close_file_io(&job->out_file, &job->out_io);
+	} else if (job->ofmt_ctx &&
+		   !(job->ofmt_ctx->oformat->flags & AVFMT_NOFILE)) {
 		avio_close(job->ofmt_ctx->pb);
+	}
 
 	avformat_free_context(job->ofmt_ctx);
 
@@ -34,6 +34,15 @@ EXPORT bool media_remux_job_create(media_remux_job_t *job,
 EXPORT bool media_remux_job_process(media_remux_job_t job,
 				    media_remux_progress_callback callback,
 				    void *data);
+
+/**
+ * Writes the index of MP4/MOV output at the front of the file so it can be
+ * played before it has been fully read.  libavformat moves the media data
+ * once at the end, the input is still only read once.
+ */
+EXPORT void media_remux_job_set_fast_start(media_remux_job_t job,
+					   bool fast_start);
+
 EXPORT void media_remux_job_destroy(media_remux_job_t job);
 
 #ifdef __cplusplus
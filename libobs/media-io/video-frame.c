@@ -15,13 +15,15 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include "../util/threading.h"
 #include "video-frame.h"
 
 #define ALIGN_SIZE(size, align) size = (((size) + (align - 1)) & (~(align - 1)))
 
 /* messy code alarm */
-void video_frame_init(struct video_frame *frame, enum video_format format,
-		      uint32_t width, uint32_t height)
+void video_frame_init_alloc(struct video_frame *frame,
+			    enum video_format format, uint32_t width,
+			    uint32_t height, void *(*alloc)(size_t size))
 {
 	size_t size;
 	size_t offsets[MAX_AV_PLANES];
@@ -46,7 +48,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[1] = size;
 		size += (width / 2) * (height / 2);
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size);
 		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
 		frame->data[2] = (uint8_t *)frame->data[0] + offsets[1];
 		frame->linesize[0] = width;
@@ -60,16 +62,45 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[0] = size;
 		size += (width / 2) * (height / 2) * 2;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size);
 		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
 		frame->linesize[0] = width;
 		frame->linesize[1] = width;
 		break;
 
+	case VIDEO_FORMAT_I010:
+		size = width * height * 2;
+		ALIGN_SIZE(size, alignment);
+		offsets[0] = size;
+		size += (width / 2) * (height / 2) * 2;
+		ALIGN_SIZE(size, alignment);
+		offsets[1] = size;
+		size += (width / 2) * (height / 2) * 2;
+		ALIGN_SIZE(size, alignment);
+		frame->data[0] = alloc(size);
+		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
+		frame->data[2] = (uint8_t *)frame->data[0] + offsets[1];
+		frame->linesize[0] = width * 2;
+		frame->linesize[1] = width;
+		frame->linesize[2] = width;
+		break;
+
+	case VIDEO_FORMAT_P010:
+		size = width * height * 2;
+		ALIGN_SIZE(size, alignment);
+		offsets[0] = size;
+		size += (width / 2) * (height / 2) * 4;
+		ALIGN_SIZE(size, alignment);
+		frame->data[0] = alloc(size);
+		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
+		frame->linesize[0] = width * 2;
+		frame->linesize[1] = width * 2;
+		break;
+
 	case VIDEO_FORMAT_Y800:
 		size = width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size);
 		frame->linesize[0] = width;
 		break;
 
@@ -78,7 +109,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	case VIDEO_FORMAT_UYVY:
 		size = width * height * 2;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size);
 		frame->linesize[0] = width * 2;
 		break;
 
@@ -88,14 +119,22 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	case VIDEO_FORMAT_AYUV:
 		size = width * height * 4;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size);
 		frame->linesize[0] = width * 4;
 		break;
 
+	case VIDEO_FORMAT_V210:
+		/* rows are padded to whole 48 pixel groups of 128 bytes */
+		frame->linesize[0] = (width + 47) / 48 * 128;
+		size = frame->linesize[0] * height;
+		ALIGN_SIZE(size, alignment);
+		frame->data[0] = alloc(size);
+		break;
+
 	case VIDEO_FORMAT_I444:
 		size = width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size * 3);
+		frame->data[0] = alloc(size * 3);
 		frame->data[1] = (uint8_t *)frame->data[0] + size;
 		frame->data[2] = (uint8_t *)frame->data[1] + size;
 		frame->linesize[0] = width;
@@ -106,7 +145,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	case VIDEO_FORMAT_BGR3:
 		size = width * height * 3;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size);
 		frame->linesize[0] = width * 3;
 		break;
 
@@ -119,7 +158,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[1] = size;
 		size += (width / 2) * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size);
 		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
 		frame->data[2] = (uint8_t *)frame->data[0] + offsets[1];
 		frame->linesize[0] = width;
@@ -139,7 +178,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[2] = size;
 		size += width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size);
 		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
 		frame->data[2] = (uint8_t *)frame->data[0] + offsets[1];
 		frame->data[3] = (uint8_t *)frame->data[0] + offsets[2];
@@ -161,7 +200,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[2] = size;
 		size += width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size);
 		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
 		frame->data[2] = (uint8_t *)frame->data[0] + offsets[1];
 		frame->data[3] = (uint8_t *)frame->data[0] + offsets[2];
@@ -183,7 +222,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 		offsets[2] = size;
 		size += width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
+		frame->data[0] = alloc(size);
 		frame->data[1] = (uint8_t *)frame->data[0] + offsets[0];
 		frame->data[2] = (uint8_t *)frame->data[0] + offsets[1];
 		frame->data[3] = (uint8_t *)frame->data[0] + offsets[2];
@@ -195,6 +234,50 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	}
 }
 
+static pthread_once_t frames_tag_once = PTHREAD_ONCE_INIT;
+static int frames_tag = 0;
+
+static void register_frames_tag(void)
+{
+	frames_tag = bmem_register_tag("frames");
+}
+
+void video_frame_init(struct video_frame *frame, enum video_format format,
+		      uint32_t width, uint32_t height)
+{
+	int prev_tag;
+
+	pthread_once(&frames_tag_once, register_frames_tag);
+	prev_tag = bmem_set_thread_tag(frames_tag);
+	video_frame_init_alloc(frame, format, width, height, bmalloc);
+	bmem_set_thread_tag(prev_tag);
+}
+
+/* frames that refer to memory of someone else, such as a mapped staging
+ * surface, can have wider lines than the frames allocated here */
+static inline void copy_plane(struct video_frame *dst,
+			      const struct video_frame *src, int plane,
+			      uint32_t rows)
+{
+	uint32_t dst_linesize = dst->linesize[plane];
+	uint32_t src_linesize = src->linesize[plane];
+	const uint8_t *in = src->data[plane];
+	uint8_t *out = dst->data[plane];
+
+	if (dst_linesize == src_linesize) {
+		memcpy(out, in, (size_t)src_linesize * rows);
+		return;
+	}
+
+	size_t width = dst_linesize < src_linesize ? dst_linesize
+						   : src_linesize;
+	for (uint32_t y = 0; y < rows; y++) {
+		memcpy(out, in, width);
+		out += dst_linesize;
+		in += src_linesize;
+	}
+}
+
 void video_frame_copy(struct video_frame *dst, const struct video_frame *src,
 		      enum video_format format, uint32_t cy)
 {
@@ -203,14 +286,16 @@ void video_frame_copy(struct video_frame *dst, const struct video_frame *src,
 		return;
 
 	case VIDEO_FORMAT_I420:
-		memcpy(dst->data[0], src->data[0], src->linesize[0] * cy);
-		memcpy(dst->data[1], src->data[1], src->linesize[1] * cy / 2);
-		memcpy(dst->data[2], src->data[2], src->linesize[2] * cy / 2);
+	case VIDEO_FORMAT_I010:
+		copy_plane(dst, src, 0, cy);
+		copy_plane(dst, src, 1, cy / 2);
+		copy_plane(dst, src, 2, cy / 2);
 		break;
 
 	case VIDEO_FORMAT_NV12:
-		memcpy(dst->data[0], src->data[0], src->linesize[0] * cy);
-		memcpy(dst->data[1], src->data[1], src->linesize[1] * cy / 2);
+	case VIDEO_FORMAT_P010:
+		copy_plane(dst, src, 0, cy);
+		copy_plane(dst, src, 1, cy / 2);
 		break;
 
 	case VIDEO_FORMAT_Y800:
@@ -222,29 +307,30 @@ void video_frame_copy(struct video_frame *dst, const struct video_frame *src,
 	case VIDEO_FORMAT_BGRX:
 	case VIDEO_FORMAT_BGR3:
 	case VIDEO_FORMAT_AYUV:
-		memcpy(dst->data[0], src->data[0], src->linesize[0] * cy);
+	case VIDEO_FORMAT_V210:
+		copy_plane(dst, src, 0, cy);
 		break;
 
 	case VIDEO_FORMAT_I444:
 	case VIDEO_FORMAT_I422:
-		memcpy(dst->data[0], src->data[0], src->linesize[0] * cy);
-		memcpy(dst->data[1], src->data[1], src->linesize[1] * cy);
-		memcpy(dst->data[2], src->data[2], src->linesize[2] * cy);
+		copy_plane(dst, src, 0, cy);
+		copy_plane(dst, src, 1, cy);
+		copy_plane(dst, src, 2, cy);
 		break;
 
 	case VIDEO_FORMAT_I40A:
-		memcpy(dst->data[0], src->data[0], src->linesize[0] * cy);
-		memcpy(dst->data[1], src->data[1], src->linesize[1] * cy / 2);
-		memcpy(dst->data[2], src->data[2], src->linesize[2] * cy / 2);
-		memcpy(dst->data[3], src->data[3], src->linesize[3] * cy);
+		copy_plane(dst, src, 0, cy);
+		copy_plane(dst, src, 1, cy / 2);
+		copy_plane(dst, src, 2, cy / 2);
+		copy_plane(dst, src, 3, cy);
 		break;
 
 	case VIDEO_FORMAT_I42A:
 	case VIDEO_FORMAT_YUVA:
-		memcpy(dst->data[0], src->data[0], src->linesize[0] * cy);
-		memcpy(dst->data[1], src->data[1], src->linesize[1] * cy);
-		memcpy(dst->data[2], src->data[2], src->linesize[2] * cy);
-		memcpy(dst->data[3], src->data[3], src->linesize[3] * cy);
+		copy_plane(dst, src, 0, cy);
+		copy_plane(dst, src, 1, cy);
+		copy_plane(dst, src, 2, cy);
+		copy_plane(dst, src, 3, cy);
 		break;
 	}
 }
@@ -29,6 +29,12 @@ EXPORT void video_frame_init(struct video_frame *frame,
 			     enum video_format format, uint32_t width,
 			     uint32_t height);
 
+/* same as video_frame_init, but allocates the plane data with a custom
+ * allocator; the planes share a single allocation starting at data[0] */
+EXPORT void video_frame_init_alloc(struct video_frame *frame,
+				   enum video_format format, uint32_t width,
+				   uint32_t height, void *(*alloc)(size_t size));
+
 static inline void video_frame_free(struct video_frame *frame)
 {
 	if (frame) {
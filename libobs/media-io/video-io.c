@@ -31,31 +31,71 @@
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
-#define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
+#define MAX_QUEUED_FRAMES 2
 
 struct cached_frame_info {
 	struct video_data frame;
 	int skipped;
 	int count;
+
+	/* held by the output thread until the frame has been dispatched, and
+	 * by every input queue the frame was pushed to */
+	long refs;
+
+	/* the memory of the entry, while the frame may refer to memory of the
+	 * caller until release is called */
+	struct video_frame buffer;
+	void (*release)(void *param);
+	void *release_param;
+};
+
+struct scaled_frame {
+	struct video_frame frame;
+	volatile long refs;
+};
+
+/* inputs of the same size and format, such as a stream and a recording
+ * sharing settings, share one scaler so that each frame is only scaled once */
+struct video_conversion {
+	struct video_scale_info info;
+	video_scaler_t *scaler;
+	DARRAY(struct scaled_frame *) frames;
+	struct scaled_frame *cur;
+	long inputs;
+};
+
+struct queued_frame {
+	struct video_data frame;
+	int count;
+
+	struct cached_frame_info *cached;
+	struct scaled_frame *scaled;
 };
 
 struct video_input {
+	struct video_output *video;
 	struct video_scale_info conversion;
-	video_scaler_t *scaler;
-	struct video_frame frame[MAX_CONVERT_BUFFERS];
-	int cur_frame;
+	struct video_conversion *converter;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
-};
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
+	/* every input is fed from its own thread, so a slow consumer only
+	 * repeats its own frames instead of holding up all other inputs */
+	pthread_t thread;
+	os_sem_t *update_semaphore;
+	pthread_mutex_t queue_mutex;
+	struct queued_frame queue[MAX_QUEUED_FRAMES];
+	struct video_frame copies[MAX_QUEUED_FRAMES];
+	size_t queue_start;
+	size_t queued;
+	volatile bool stop;
+	bool detached;
+
+	volatile long skipped_frames;
+	volatile long total_frames;
+};
 
 struct video_output {
 	struct video_output_info info;
@@ -72,11 +112,14 @@ struct video_output {
 	bool initialized;
 
 	pthread_mutex_t input_mutex;
-	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_input *) inputs;
+	DARRAY(struct video_conversion *) conversions;
+	volatile long input_threads;
 
 	size_t available_frames;
 	size_t first_added;
 	size_t last_added;
+	size_t first_held;
 	struct cached_frame_info cache[MAX_CACHE_SIZE];
 
 	volatile bool raw_active;
@@ -85,40 +128,264 @@ struct video_output {
 
 /* ------------------------------------------------------------------------- */
 
-static inline bool scale_video_output(struct video_input *input,
-				      struct video_data *data)
+/* cache entries are written in order, so they can only be handed back to the
+ * graphics thread in order as well, even if a newer entry was released by all
+ * of its inputs first */
+static void release_cached_frame(struct video_output *video,
+				 struct cached_frame_info *frame_info)
 {
-	bool success = true;
+	void (*release[MAX_CACHE_SIZE])(void *);
+	void *release_param[MAX_CACHE_SIZE];
+	size_t num_released = 0;
 
-	if (input->scaler) {
-		struct video_frame *frame;
+	pthread_mutex_lock(&video->data_mutex);
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+	frame_info->refs--;
 
-		frame = &input->frame[input->cur_frame];
+	while (video->available_frames < video->info.cache_size &&
+	       video->cache[video->first_held].refs == 0) {
+		struct cached_frame_info *held =
+			&video->cache[video->first_held];
 
-		success = video_scaler_scale(input->scaler, frame->data,
-					     frame->linesize,
-					     (const uint8_t *const *)data->data,
-					     data->linesize);
+		/* taken while locked, the graphics thread may reuse the
+		 * entry for its next held frame as soon as it's unlocked */
+		if (held->release) {
+			release[num_released] = held->release;
+			release_param[num_released++] = held->release_param;
+			held->release = NULL;
+		}
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i] = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
-		} else {
-			blog(LOG_WARNING, "video-io: Could not scale frame!");
+		if (++video->first_held == video->info.cache_size)
+			video->first_held = 0;
+
+		if (++video->available_frames == video->info.cache_size)
+			video->last_added = video->first_added;
+	}
+
+	pthread_mutex_unlock(&video->data_mutex);
+
+	for (size_t i = 0; i < num_released; i++)
+		release[i](release_param[i]);
+}
+
+static inline void release_queued_frame(struct video_output *video,
+					struct queued_frame *queued)
+{
+	if (queued->cached)
+		release_cached_frame(video, queued->cached);
+	if (queued->scaled)
+		os_atomic_dec_long(&queued->scaled->refs);
+}
+
+static inline bool same_conversion(const struct video_scale_info *a,
+				   const struct video_scale_info *b)
+{
+	return a->format == b->format && a->width == b->width &&
+	       a->height == b->height && a->range == b->range &&
+	       a->colorspace == b->colorspace;
+}
+
+static struct video_conversion *
+get_conversion(struct video_output *video, const struct video_scale_info *info)
+{
+	struct video_conversion *conv;
+
+	for (size_t i = 0; i < video->conversions.num; i++) {
+		conv = video->conversions.array[i];
+
+		if (same_conversion(&conv->info, info)) {
+			conv->inputs++;
+			return conv;
 		}
 	}
 
-	return success;
+	struct video_scale_info from = {.format = video->info.format,
+					.width = video->info.width,
+					.height = video->info.height,
+					.range = video->info.range,
+					.colorspace = video->info.colorspace};
+
+	conv = bzalloc(sizeof(*conv));
+	conv->info = *info;
+	conv->inputs = 1;
+
+	int ret = video_scaler_create(&conv->scaler, info, &from,
+				      VIDEO_SCALE_FAST_BILINEAR);
+	if (ret != VIDEO_SCALER_SUCCESS) {
+		if (ret == VIDEO_SCALER_BAD_CONVERSION)
+			blog(LOG_ERROR, "video_input_init: Bad "
+					"scale conversion type");
+		else
+			blog(LOG_ERROR, "video_input_init: Failed to "
+					"create scaler");
+
+		bfree(conv);
+		return NULL;
+	}
+
+	da_push_back(video->conversions, &conv);
+	return conv;
+}
+
+static void release_conversion(struct video_output *video,
+			       struct video_conversion *conv)
+{
+	if (--conv->inputs > 0)
+		return;
+
+	da_erase_item(video->conversions, &conv);
+
+	for (size_t i = 0; i < conv->frames.num; i++) {
+		video_frame_free(&conv->frames.array[i]->frame);
+		bfree(conv->frames.array[i]);
+	}
+
+	da_free(conv->frames);
+	video_scaler_destroy(conv->scaler);
+	bfree(conv);
+}
+
+/* scales the current frame once for every input using the conversion, into a
+ * buffer that none of the input queues still refer to */
+static struct scaled_frame *scale_frame(struct video_conversion *conv,
+					const struct video_data *data)
+{
+	struct scaled_frame *scaled = NULL;
+
+	if (conv->cur)
+		return conv->cur;
+
+	for (size_t i = 0; i < conv->frames.num; i++) {
+		if (!os_atomic_load_long(&conv->frames.array[i]->refs)) {
+			scaled = conv->frames.array[i];
+			break;
+		}
+	}
+
+	if (!scaled) {
+		scaled = bzalloc(sizeof(*scaled));
+		video_frame_init(&scaled->frame, conv->info.format,
+				 conv->info.width, conv->info.height);
+		da_push_back(conv->frames, &scaled);
+	}
+
+	if (!video_scaler_scale(conv->scaler, scaled->frame.data,
+				scaled->frame.linesize,
+				(const uint8_t *const *)data->data,
+				data->linesize)) {
+		blog(LOG_WARNING, "video-io: Could not scale frame!");
+		return NULL;
+	}
+
+	conv->cur = scaled;
+	return scaled;
+}
+
+/* a lagging input delivers its last queued frame over and over, so it is
+ * copied out of the frame cache rather than keeping the cache entry held and
+ * running the cache out of frames for every other input */
+static void copy_cached_frame(struct video_output *video,
+			      struct video_input *input, size_t idx)
+{
+	struct queued_frame *queued = &input->queue[idx];
+	struct video_frame *copy = &input->copies[idx];
+
+	if (!copy->data[0])
+		video_frame_init(copy, video->info.format, video->info.width,
+				 video->info.height);
+
+	video_frame_copy(copy, (const struct video_frame *)&queued->frame,
+			 video->info.format, video->info.height);
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		queued->frame.data[i] = copy->data[i];
+		queued->frame.linesize[i] = copy->linesize[i];
+	}
+
+	release_cached_frame(video, queued->cached);
+	queued->cached = NULL;
+}
+
+/* when the queue of an input is full the last queued frame is repeated, the
+ * same way the frame cache repeats frames, so that consumers keep receiving a
+ * constant frame rate */
+static bool repeat_if_full(struct video_output *video,
+			   struct video_input *input)
+{
+	bool full;
+
+	pthread_mutex_lock(&input->queue_mutex);
+
+	full = input->queued == MAX_QUEUED_FRAMES;
+	if (full) {
+		size_t last = (input->queue_start + input->queued - 1) %
+			      MAX_QUEUED_FRAMES;
+
+		input->queue[last].count++;
+		if (input->queue[last].cached)
+			copy_cached_frame(video, input, last);
+	}
+
+	pthread_mutex_unlock(&input->queue_mutex);
+
+	if (full)
+		os_atomic_inc_long(&input->skipped_frames);
+	return full;
+}
+
+static void push_frame(struct video_input *input,
+		       const struct queued_frame *queued)
+{
+	pthread_mutex_lock(&input->queue_mutex);
+
+	size_t idx = (input->queue_start + input->queued) % MAX_QUEUED_FRAMES;
+	input->queue[idx] = *queued;
+	input->queued++;
+
+	pthread_mutex_unlock(&input->queue_mutex);
+
+	os_sem_post(input->update_semaphore);
+}
+
+static inline bool dispatch_frame(struct video_output *video,
+				  struct video_input *input,
+				  struct cached_frame_info *frame_info)
+{
+	struct queued_frame queued = {.frame = frame_info->frame, .count = 1};
+
+	os_atomic_inc_long(&input->total_frames);
+
+	if (repeat_if_full(video, input))
+		return false;
+
+	if (input->converter) {
+		queued.scaled = scale_frame(input->converter, &queued.frame);
+		if (!queued.scaled)
+			return true;
+
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			queued.frame.data[i] = queued.scaled->frame.data[i];
+			queued.frame.linesize[i] =
+				queued.scaled->frame.linesize[i];
+		}
+
+		os_atomic_inc_long(&queued.scaled->refs);
+	} else {
+		queued.cached = frame_info;
+
+		pthread_mutex_lock(&video->data_mutex);
+		frame_info->refs++;
+		pthread_mutex_unlock(&video->data_mutex);
+	}
+
+	push_frame(input, &queued);
+	return true;
 }
 
 static inline bool video_output_cur_frame(struct video_output *video)
 {
 	struct cached_frame_info *frame_info;
+	bool input_skipped = false;
 	bool complete;
 	bool skipped;
 
@@ -134,12 +401,14 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	pthread_mutex_lock(&video->input_mutex);
 
+	for (size_t i = 0; i < video->conversions.num; i++)
+		video->conversions.array[i]->cur = NULL;
+
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
-		struct video_data frame = frame_info->frame;
+		struct video_input *input = video->inputs.array[i];
 
-		if (scale_video_output(input, &frame))
-			input->callback(input->param, &frame);
+		if (!dispatch_frame(video, input, frame_info))
+			input_skipped = true;
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -156,11 +425,15 @@ static inline bool video_output_cur_frame(struct video_output *video)
 		if (++video->first_added == video->info.cache_size)
 			video->first_added = 0;
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
+		release_cached_frame(video, frame_info);
 	} else if (skipped) {
 		--frame_info->skipped;
+		input_skipped = true;
+	}
+
+	if (input_skipped) {
 		os_atomic_inc_long(&video->skipped_frames);
+		profiler_trace_trigger("skipped frame");
 	}
 
 	pthread_mutex_unlock(&video->data_mutex);
@@ -175,6 +448,7 @@ static void *video_thread(void *param)
 	struct video_output *video = param;
 
 	os_set_thread_name("video-io: video thread");
+	bmem_set_thread_tag(bmem_register_tag("video output"));
 
 	const char *video_thread_name =
 		profile_store_name(obs_get_profiler_name_store(),
@@ -198,6 +472,130 @@ static void *video_thread(void *param)
 	return NULL;
 }
 
+static void video_input_free(struct video_output *video,
+			     struct video_input *input)
+{
+	for (size_t i = 0; i < input->queued; i++) {
+		size_t idx = (input->queue_start + i) % MAX_QUEUED_FRAMES;
+		release_queued_frame(video, &input->queue[idx]);
+	}
+
+	if (input->converter) {
+		pthread_mutex_lock(&video->input_mutex);
+		release_conversion(video, input->converter);
+		pthread_mutex_unlock(&video->input_mutex);
+	}
+
+	for (size_t i = 0; i < MAX_QUEUED_FRAMES; i++)
+		video_frame_free(&input->copies[i]);
+
+	os_sem_destroy(input->update_semaphore);
+	pthread_mutex_destroy(&input->queue_mutex);
+	bfree(input);
+}
+
+/* delivers the queued frames of an input, repeating them as many times as
+ * the output thread asked for */
+static inline void video_input_cur_frame(struct video_input *input)
+{
+	struct video_output *video = input->video;
+	struct queued_frame *queued;
+	struct queued_frame done = {0};
+	struct video_data frame;
+	bool complete;
+
+	pthread_mutex_lock(&input->queue_mutex);
+	frame = input->queue[input->queue_start].frame;
+	pthread_mutex_unlock(&input->queue_mutex);
+
+	do {
+		input->callback(input->param, &frame);
+
+		pthread_mutex_lock(&input->queue_mutex);
+
+		queued = &input->queue[input->queue_start];
+		queued->frame.timestamp += video->frame_time;
+		frame = queued->frame;
+		complete = --queued->count == 0;
+
+		if (complete) {
+			done = *queued;
+			input->queue_start =
+				(input->queue_start + 1) % MAX_QUEUED_FRAMES;
+			input->queued--;
+		}
+
+		pthread_mutex_unlock(&input->queue_mutex);
+
+	} while (!complete && !input->stop);
+
+	if (complete)
+		release_queued_frame(video, &done);
+}
+
+static void *video_input_thread(void *param)
+{
+	struct video_input *input = param;
+	struct video_output *video = input->video;
+
+	os_set_thread_name("video-io: input thread");
+
+	const char *input_thread_name =
+		profile_store_name(obs_get_profiler_name_store(),
+				   "video_input_thread(%s)", video->info.name);
+
+	while (os_sem_wait(input->update_semaphore) == 0) {
+		if (input->stop)
+			break;
+
+		profile_start(input_thread_name);
+		video_input_cur_frame(input);
+		profile_end(input_thread_name);
+
+		profile_reenable_thread();
+	}
+
+	if (input->detached) {
+		video_input_free(video, input);
+		os_atomic_dec_long(&video->input_threads);
+	}
+
+	return NULL;
+}
+
+static void log_input_skipped(const struct video_input *input)
+{
+	long skipped = os_atomic_load_long(&input->skipped_frames);
+	long total = os_atomic_load_long(&input->total_frames);
+
+	if (skipped && total)
+		blog(LOG_INFO,
+		     "Video input disconnected, number of frames repeated "
+		     "due to input lag: %ld/%ld (%0.1f%%)",
+		     skipped, total, (double)skipped / (double)total * 100.0);
+}
+
+static void video_input_stop(struct video_output *video,
+			     struct video_input *input)
+{
+	log_input_skipped(input);
+
+	input->stop = true;
+	os_sem_post(input->update_semaphore);
+
+	/* encoders disconnect from their own callback when encoding fails,
+	 * the thread cleans up after itself once the callback returns */
+	if (pthread_equal(pthread_self(), input->thread)) {
+		input->detached = true;
+		pthread_detach(input->thread);
+		return;
+	}
+
+	pthread_join(input->thread, NULL);
+	video_input_free(video, input);
+	os_atomic_dec_long(&video->input_threads);
+}
+
 /* ------------------------------------------------------------------------- */
 
 static inline bool valid_video_params(const struct video_output_info *info)
@@ -206,17 +604,25 @@ static inline bool valid_video_params(const struct video_output_info *info)
 	       info->fps_num != 0;
 }
 
+static inline void use_buffer(struct cached_frame_info *cfi)
+{
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		cfi->frame.data[i] = cfi->buffer.data[i];
+		cfi->frame.linesize[i] = cfi->buffer.linesize[i];
+	}
+}
+
 static inline void init_cache(struct video_output *video)
 {
 	if (video->info.cache_size > MAX_CACHE_SIZE)
 		video->info.cache_size = MAX_CACHE_SIZE;
 
 	for (size_t i = 0; i < video->info.cache_size; i++) {
-		struct video_frame *frame;
-		frame = (struct video_frame *)&video->cache[i];
+		struct cached_frame_info *cfi = &video->cache[i];
 
-		video_frame_init(frame, video->info.format, video->info.width,
-				 video->info.height);
+		video_frame_init(&cfi->buffer, video->info.format,
+				 video->info.width, video->info.height);
+		use_buffer(cfi);
 	}
 
 	video->available_frames = video->info.cache_size;
@@ -271,11 +677,21 @@ void video_output_close(video_t *video)
 	video_output_stop(video);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_stop(video, video->inputs.array[i]);
 	da_free(video->inputs);
 
-	for (size_t i = 0; i < video->info.cache_size; i++)
-		video_frame_free((struct video_frame *)&video->cache[i]);
+	while (os_atomic_load_long(&video->input_threads) > 0)
+		os_sleep_ms(1);
+
+	da_free(video->conversions);
+
+	for (size_t i = 0; i < video->info.cache_size; i++) {
+		struct cached_frame_info *cfi = &video->cache[i];
+
+		if (cfi->release)
+			cfi->release(cfi->release_param);
+		video_frame_free(&cfi->buffer);
+	}
 
 	os_sem_destroy(video->update_semaphore);
 	pthread_mutex_destroy(&video->data_mutex);
@@ -289,7 +705,7 @@ static size_t video_get_input_idx(const video_t *video,
 				  void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -303,35 +719,31 @@ static inline bool video_input_init(struct video_input *input,
 	if (input->conversion.width != video->info.width ||
 	    input->conversion.height != video->info.height ||
 	    input->conversion.format != video->info.format) {
-		struct video_scale_info from = {.format = video->info.format,
-						.width = video->info.width,
-						.height = video->info.height,
-						.range = video->info.range,
-						.colorspace =
-							video->info.colorspace};
-
-		int ret = video_scaler_create(&input->scaler,
-					      &input->conversion, &from,
-					      VIDEO_SCALE_FAST_BILINEAR);
-		if (ret != VIDEO_SCALER_SUCCESS) {
-			if (ret == VIDEO_SCALER_BAD_CONVERSION)
-				blog(LOG_ERROR, "video_input_init: Bad "
-						"scale conversion type");
-			else
-				blog(LOG_ERROR, "video_input_init: Failed to "
-						"create scaler");
-
+		input->converter = get_conversion(video, &input->conversion);
+		if (!input->converter)
 			return false;
-		}
-
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					 input->conversion.format,
-					 input->conversion.width,
-					 input->conversion.height);
 	}
 
+	if (pthread_mutex_init(&input->queue_mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&input->update_semaphore, 0) != 0)
+		goto fail_sem;
+	if (pthread_create(&input->thread, NULL, video_input_thread, input) !=
+	    0)
+		goto fail_thread;
+
+	os_atomic_inc_long(&video->input_threads);
 	return true;
+
+fail_thread:
+	os_sem_destroy(input->update_semaphore);
+fail_sem:
+	pthread_mutex_destroy(&input->queue_mutex);
+fail:
+	blog(LOG_ERROR, "video_input_init: Failed to create input thread");
+	if (input->converter)
+		release_conversion(video, input->converter);
+	return false;
 }
 
 static inline void reset_frames(video_t *video)
@@ -352,26 +764,26 @@ bool video_output_connect(
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(*input));
 
-		input.callback = callback;
-		input.param = param;
+		input->video = video;
+		input->callback = callback;
+		input->param = param;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format = video->info.format;
-			input.conversion.width = video->info.width;
-			input.conversion.height = video->info.height;
+			input->conversion.format = video->info.format;
+			input->conversion.width = video->info.width;
+			input->conversion.height = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
+		success = video_input_init(input, video);
 		if (success) {
 			if (video->inputs.num == 0) {
 				if (!os_atomic_load_long(&video->gpu_refs)) {
@@ -380,6 +792,8 @@ bool video_output_connect(
 				os_atomic_set_bool(&video->raw_active, true);
 			}
 			da_push_back(video->inputs, &input);
+		} else {
+			bfree(input);
 		}
 	}
 
@@ -417,8 +831,9 @@ void video_output_disconnect(video_t *video,
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array + idx);
+		struct video_input *input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
+		video_input_stop(video, input);
 
 		if (video->inputs.num == 0) {
 			os_atomic_set_bool(&video->raw_active, false);
@@ -443,41 +858,90 @@ const struct video_output_info *video_output_get_info(const video_t *video)
 	return video ? &video->info : NULL;
 }
 
+/* assumes data_mutex */
+static struct cached_frame_info *lock_frame(struct video_output *video,
+					    int count, uint64_t timestamp)
+{
+	struct cached_frame_info *cfi;
+
+	if (video->available_frames == 0) {
+		cfi = &video->cache[video->last_added];
+
+		/* all entries were dispatched already and are only held by
+		 * input queues, so the newest one has to be dispatched again */
+		if (cfi->count == 0) {
+			video->first_added = video->last_added;
+			cfi->refs++;
+			os_sem_post(video->update_semaphore);
+		}
+
+		cfi->count += count;
+		cfi->skipped += count;
+		return NULL;
+	}
+
+	if (video->available_frames != video->info.cache_size) {
+		if (++video->last_added == video->info.cache_size)
+			video->last_added = 0;
+	}
+
+	cfi = &video->cache[video->last_added];
+	cfi->frame.timestamp = timestamp;
+	cfi->count = count;
+	cfi->skipped = 0;
+	cfi->refs = 1;
+	return cfi;
+}
+
 bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 			     int count, uint64_t timestamp)
 {
 	struct cached_frame_info *cfi;
-	bool locked;
 
 	if (!video)
 		return false;
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
-		video->cache[video->last_added].skipped += count;
-		locked = false;
+	cfi = lock_frame(video, count, timestamp);
+	if (cfi) {
+		use_buffer(cfi);
+		memcpy(frame, &cfi->frame, sizeof(*frame));
+	}
 
-	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
-		}
+	pthread_mutex_unlock(&video->data_mutex);
 
-		cfi = &video->cache[video->last_added];
-		cfi->frame.timestamp = timestamp;
-		cfi->count = count;
-		cfi->skipped = 0;
+	return cfi != NULL;
+}
 
-		memcpy(frame, &cfi->frame, sizeof(*frame));
+void video_output_send_external_frame(video_t *video,
+				      const struct video_data *frame,
+				      int count, void (*release)(void *param),
+				      void *param)
+{
+	struct cached_frame_info *cfi = NULL;
+
+	if (video) {
+		pthread_mutex_lock(&video->data_mutex);
+
+		cfi = lock_frame(video, count, frame->timestamp);
+		if (cfi) {
+			memcpy(cfi->frame.data, frame->data,
+			       sizeof(cfi->frame.data));
+			memcpy(cfi->frame.linesize, frame->linesize,
+			       sizeof(cfi->frame.linesize));
+			cfi->release = release;
+			cfi->release_param = param;
+
+			video->available_frames--;
+			os_sem_post(video->update_semaphore);
+		}
 
-		locked = true;
+		pthread_mutex_unlock(&video->data_mutex);
 	}
 
-	pthread_mutex_unlock(&video->data_mutex);
-
-	return locked;
+	if (!cfi && release)
+		release(param);
 }
 
 void video_output_unlock_frame(video_t *video)
@@ -554,6 +1018,27 @@ uint32_t video_output_get_total_frames(const video_t *video)
 	return (uint32_t)os_atomic_load_long(&video->total_frames);
 }
 
+size_t video_output_get_queued_frames(video_t *video)
+{
+	size_t queued;
+
+	if (!video)
+		return 0;
+
+	pthread_mutex_lock(&video->data_mutex);
+	queued = video->info.cache_size - video->available_frames;
+	pthread_mutex_unlock(&video->data_mutex);
+	return queued;
+}
+
+bool video_output_set_thread_affinity(video_t *video, const char *cpus)
+{
+	if (!video || !video->initialized)
+		return false;
+
+	return os_set_thread_affinity(video->thread, cpus);
+}
+
 /* Note: These four functions below are a very slight bit of a hack.  If the
  * texture encoder thread is active while the raw encoder thread is active, the
  * total frame count will just be doubled while they're both active.  Which is
@@ -68,6 +68,15 @@ enum video_format {
 
 	/* packed 4:4:4 with alpha */
 	VIDEO_FORMAT_AYUV,
+
+	/* packed 4:2:2 10-bit, six pixels in every 16 bytes */
+	VIDEO_FORMAT_V210,
+
+	/* planar 4:2:0 10-bit, in the low bits of 16-bit samples */
+	VIDEO_FORMAT_I010,
+
+	/* two-plane 4:2:0 10-bit, in the high bits of 16-bit samples */
+	VIDEO_FORMAT_P010,
 };
 
 enum video_colorspace {
@@ -117,6 +126,9 @@ static inline bool format_is_yuv(enum video_format format)
 	case VIDEO_FORMAT_I42A:
 	case VIDEO_FORMAT_YUVA:
 	case VIDEO_FORMAT_AYUV:
+	case VIDEO_FORMAT_V210:
+	case VIDEO_FORMAT_I010:
+	case VIDEO_FORMAT_P010:
 		return true;
 	case VIDEO_FORMAT_NONE:
 	case VIDEO_FORMAT_RGBA:
@@ -165,6 +177,12 @@ static inline const char *get_video_format_name(enum video_format format)
 		return "YUVA";
 	case VIDEO_FORMAT_AYUV:
 		return "AYUV";
+	case VIDEO_FORMAT_V210:
+		return "V210";
+	case VIDEO_FORMAT_I010:
+		return "I010";
+	case VIDEO_FORMAT_P010:
+		return "P010";
 	case VIDEO_FORMAT_NONE:;
 	}
 
@@ -233,6 +251,8 @@ EXPORT bool video_format_get_parameters(enum video_colorspace color_space,
 EXPORT int video_output_open(video_t **video, struct video_output_info *info);
 EXPORT void video_output_close(video_t *video);
 
+/* every connection receives its frames on its own thread, connections that
+ * fall behind have their last frame repeated instead of delaying the others */
 EXPORT bool
 video_output_connect(video_t *video, const struct video_scale_info *conversion,
 		     void (*callback)(void *param, struct video_data *frame),
@@ -249,6 +269,21 @@ video_output_get_info(const video_t *video);
 EXPORT bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 				    int count, uint64_t timestamp);
 EXPORT void video_output_unlock_frame(video_t *video);
+
+/**
+ * Outputs a frame that refers to memory of the caller, such as a mapped
+ * staging surface, rather than copying it into a frame of the output.  The
+ * memory has to stay valid until release is called with param, from any
+ * thread, once no input refers to the frame any more or the output is
+ * closed.  release is called right away if the previous frame was repeated
+ * instead because the outputs are behind.  The lines of the planes can be
+ * wider than the frame.
+ */
+EXPORT void video_output_send_external_frame(video_t *video,
+					     const struct video_data *frame,
+					     int count,
+					     void (*release)(void *param),
+					     void *param);
 EXPORT uint64_t video_output_get_frame_time(const video_t *video);
 EXPORT void video_output_stop(video_t *video);
 EXPORT bool video_output_stopped(video_t *video);
@@ -260,6 +295,13 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
+/** Returns how many rendered frames are still waiting to be output */
+EXPORT size_t video_output_get_queued_frames(video_t *video);
+
+/* restricts the thread that dispatches frames to the connected inputs to a
+ * list of CPUs, see os_set_thread_affinity.  the threads of the inputs
+ * themselves are left alone, as they run the encoders */
+EXPORT bool video_output_set_thread_affinity(video_t *video, const char *cpus);
 
 extern void video_output_inc_texture_encoders(video_t *video);
 extern void video_output_dec_texture_encoders(video_t *video);
@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "util/sse-intrin.h"
 
 #include "util/threading.h"
+#include "util/platform.h"
 #include "util/bmem.h"
 #include "media-io/audio-math.h"
 #include "obs.h"
@@ -36,6 +37,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define CLAMP(x, min, max) ((x) < min ? min : ((x) > max ? max : (x)))
 
+/* frames of audio each meter can queue for the meter thread (~170 ms at
+ * 48 kHz), and the longest the thread sleeps between draining the queues */
+#define METER_RING_FRAMES 8192
+#define METER_RING_MASK (METER_RING_FRAMES - 1)
+#define METER_MAX_SLEEP_MS 50
+
 typedef float (*obs_fader_conversion_t)(const float val);
 
 struct fader_cb {
@@ -78,6 +85,29 @@ struct obs_volmeter {
 
 	float magnitude[MAX_AUDIO_CHANNELS];
 	float peak[MAX_AUDIO_CHANNELS];
+
+	/* the last emitted levels in dB, for obs_volmeter_get_levels */
+	float level_magnitude[MAX_AUDIO_CHANNELS];
+	float level_peak[MAX_AUDIO_CHANNELS];
+	float level_input_peak[MAX_AUDIO_CHANNELS];
+	uint64_t level_ts;
+
+	/* levels computed on the meter thread rather than in the capture
+	 * callback; the callback only copies the audio into the ring */
+	volatile bool decoupled;
+	volatile bool enabled;
+	volatile bool muted;
+	volatile long nr_channels;
+	float *ring;
+	size_t ring_channels;
+	volatile long ring_head;
+	volatile long ring_tail;
+
+	/* levels since the last signal, for the meter thread */
+	float acc_peak[MAX_AUDIO_CHANNELS];
+	float acc_sum[MAX_AUDIO_CHANNELS];
+	size_t acc_frames;
+	uint64_t next_update_ns;
 };
 
 static float cubic_def_to_db(const float def)
@@ -486,6 +516,24 @@ static void volmeter_process_peak(obs_volmeter_t *volmeter,
 	}
 }
 
+static float get_sum_of_squares(const float *samples, size_t nr_samples)
+{
+	__m128 sum4 = _mm_setzero_ps();
+	float sum4_mem[4];
+	float sum = 0.0f;
+	size_t i = 0;
+
+	for (; (i + 3) < nr_samples; i += 4) {
+		__m128 work = _mm_loadu_ps(&samples[i]);
+		sum4 = _mm_add_ps(sum4, _mm_mul_ps(work, work));
+	}
+	for (; i < nr_samples; i++)
+		sum += samples[i] * samples[i];
+
+	_mm_storeu_ps(sum4_mem, sum4);
+	return sum + sum4_mem[0] + sum4_mem[1] + sum4_mem[2] + sum4_mem[3];
+}
+
 static void volmeter_process_magnitude(obs_volmeter_t *volmeter,
 				       const struct audio_data *data,
 				       int nr_channels)
@@ -499,12 +547,9 @@ static void volmeter_process_magnitude(obs_volmeter_t *volmeter,
 			continue;
 		}
 
-		float sum = 0.0;
-		for (size_t i = 0; i < nr_samples; i++) {
-			float sample = samples[i];
-			sum += sample * sample;
-		}
-		volmeter->magnitude[channel_nr] = sqrtf(sum / nr_samples);
+		volmeter->magnitude[channel_nr] =
+			sqrtf(get_sum_of_squares(samples, nr_samples) /
+			      nr_samples);
 
 		channel_nr++;
 	}
@@ -519,41 +564,302 @@ static void volmeter_process_audio_data(obs_volmeter_t *volmeter,
 	volmeter_process_magnitude(volmeter, data, nr_channels);
 }
 
-static void volmeter_source_data_received(void *vptr, obs_source_t *source,
-					  const struct audio_data *data,
-					  bool muted)
+static void volmeter_emit_levels(struct obs_volmeter *volmeter,
+				 const float *magnitude_mul,
+				 const float *peak_mul, bool muted)
 {
-	struct obs_volmeter *volmeter = (struct obs_volmeter *)vptr;
 	float mul;
 	float magnitude[MAX_AUDIO_CHANNELS];
 	float peak[MAX_AUDIO_CHANNELS];
 	float input_peak[MAX_AUDIO_CHANNELS];
 
-	pthread_mutex_lock(&volmeter->mutex);
-
-	volmeter_process_audio_data(volmeter, data);
-
 	// Adjust magnitude/peak based on the volume level set by the user.
 	// And convert to dB.
+	pthread_mutex_lock(&volmeter->mutex);
 	mul = muted ? 0.0f : db_to_mul(volmeter->cur_db);
+
 	for (int channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS;
 	     channel_nr++) {
 		magnitude[channel_nr] =
-			mul_to_db(volmeter->magnitude[channel_nr] * mul);
-		peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr] * mul);
+			mul_to_db(magnitude_mul[channel_nr] * mul);
+		peak[channel_nr] = mul_to_db(peak_mul[channel_nr] * mul);
 
 		/* The input-peak is NOT adjusted with volume, so that the user
 		 * can check the input-gain. */
-		input_peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr]);
+		input_peak[channel_nr] = mul_to_db(peak_mul[channel_nr]);
 	}
 
+	memcpy(volmeter->level_magnitude, magnitude, sizeof(magnitude));
+	memcpy(volmeter->level_peak, peak, sizeof(peak));
+	memcpy(volmeter->level_input_peak, input_peak, sizeof(input_peak));
+	volmeter->level_ts = os_gettime_ns();
 	pthread_mutex_unlock(&volmeter->mutex);
 
 	signal_levels_updated(volmeter, magnitude, peak, input_peak);
+}
+
+/* called from the audio thread; single producer of the ring */
+static void volmeter_queue_audio(struct obs_volmeter *volmeter,
+				 const struct audio_data *data, bool muted)
+{
+	const long head = volmeter->ring_head;
+	const long tail = os_atomic_load_long(&volmeter->ring_tail);
+	size_t space = (size_t)((tail - head - 1) & METER_RING_MASK);
+	size_t frames = data->frames < space ? data->frames : space;
+	size_t first = METER_RING_FRAMES - (size_t)head;
+
+	if (first > frames)
+		first = frames;
+
+	/* the meter thread drains the ring far more often than it can fill
+	 * up, frames that do not fit are only missing from the levels */
+	for (size_t c = 0; c < volmeter->ring_channels; c++) {
+		float *ring = volmeter->ring + c * METER_RING_FRAMES;
+		const float *src = (const float *)data->data[c];
+
+		if (src) {
+			memcpy(ring + head, src, first * sizeof(float));
+			memcpy(ring, src + first,
+			       (frames - first) * sizeof(float));
+		} else {
+			memset(ring + head, 0, first * sizeof(float));
+			memset(ring, 0, (frames - first) * sizeof(float));
+		}
+	}
+
+	os_atomic_store_long(&volmeter->nr_channels,
+			     get_nr_channels_from_audio_data(data));
+	os_atomic_store_bool(&volmeter->muted, muted);
+	os_atomic_store_long(&volmeter->ring_head,
+			     (head + (long)frames) & METER_RING_MASK);
+}
+
+static void volmeter_source_data_received(void *vptr, obs_source_t *source,
+					  const struct audio_data *data,
+					  bool muted)
+{
+	struct obs_volmeter *volmeter = (struct obs_volmeter *)vptr;
+	float magnitude[MAX_AUDIO_CHANNELS];
+	float peak[MAX_AUDIO_CHANNELS];
+
+	if (!os_atomic_load_bool(&volmeter->enabled))
+		return;
+
+	if (os_atomic_load_bool(&volmeter->decoupled)) {
+		volmeter_queue_audio(volmeter, data, muted);
+		return;
+	}
+
+	pthread_mutex_lock(&volmeter->mutex);
+	volmeter_process_audio_data(volmeter, data);
+	memcpy(magnitude, volmeter->magnitude, sizeof(magnitude));
+	memcpy(peak, volmeter->peak, sizeof(peak));
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	volmeter_emit_levels(volmeter, magnitude, peak, muted);
 
 	UNUSED_PARAMETER(source);
 }
 
+/* copies the queued audio into scratch in multiples of 4 frames, as the peak
+ * meters expect; a remainder stays queued for the next pass */
+static size_t volmeter_drain(struct obs_volmeter *volmeter, float *scratch,
+			     struct audio_data *data)
+{
+	const long head = os_atomic_load_long(&volmeter->ring_head);
+	const long tail = volmeter->ring_tail;
+	size_t frames = (size_t)((head - tail) & METER_RING_MASK) & ~(size_t)3;
+	size_t first = METER_RING_FRAMES - (size_t)tail;
+	const size_t nr_channels =
+		(size_t)os_atomic_load_long(&volmeter->nr_channels);
+
+	if (!frames || !os_atomic_load_bool(&volmeter->enabled))
+		goto skip;
+
+	if (first > frames)
+		first = frames;
+
+	memset(data, 0, sizeof(*data));
+	data->frames = (uint32_t)frames;
+
+	for (size_t c = 0; c < volmeter->ring_channels; c++) {
+		const float *ring = volmeter->ring + c * METER_RING_FRAMES;
+		float *dst = scratch + c * METER_RING_FRAMES;
+
+		if (c >= nr_channels)
+			break;
+
+		memcpy(dst, ring + tail, first * sizeof(float));
+		memcpy(dst + first, ring, (frames - first) * sizeof(float));
+		data->data[c] = (uint8_t *)dst;
+	}
+
+skip:
+	os_atomic_store_long(&volmeter->ring_tail,
+			     (tail + (long)frames) & METER_RING_MASK);
+	return os_atomic_load_bool(&volmeter->enabled) ? frames : 0;
+}
+
+/* returns the time of the next update of the meter */
+static uint64_t volmeter_tick(struct obs_volmeter *volmeter, float *scratch,
+			      uint64_t now)
+{
+	float magnitude[MAX_AUDIO_CHANNELS];
+	struct audio_data data;
+	size_t frames = volmeter_drain(volmeter, scratch, &data);
+	uint64_t next_update;
+
+	pthread_mutex_lock(&volmeter->mutex);
+
+	if (frames) {
+		volmeter_process_audio_data(volmeter, &data);
+
+		for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++) {
+			const float mag = volmeter->magnitude[c];
+			volmeter->acc_peak[c] =
+				fmaxf(volmeter->acc_peak[c], volmeter->peak[c]);
+			volmeter->acc_sum[c] += mag * mag * (float)frames;
+		}
+		volmeter->acc_frames += frames;
+	}
+
+	if (now < volmeter->next_update_ns || !volmeter->acc_frames) {
+		next_update = volmeter->next_update_ns;
+		pthread_mutex_unlock(&volmeter->mutex);
+		return next_update;
+	}
+
+	float peak[MAX_AUDIO_CHANNELS];
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++) {
+		magnitude[c] = sqrtf(volmeter->acc_sum[c] /
+				     (float)volmeter->acc_frames);
+		peak[c] = volmeter->acc_peak[c];
+		volmeter->acc_peak[c] = 0.0f;
+		volmeter->acc_sum[c] = 0.0f;
+	}
+	volmeter->acc_frames = 0;
+	volmeter->next_update_ns = now + volmeter->update_ms * 1000000ULL;
+	next_update = volmeter->next_update_ns;
+
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	volmeter_emit_levels(volmeter, magnitude, peak,
+			     os_atomic_load_bool(&volmeter->muted));
+	return next_update;
+}
+
+static void *meter_thread(void *param)
+{
+	struct obs_meter_service *service = param;
+	unsigned long sleep_ms = METER_MAX_SLEEP_MS;
+
+	os_set_thread_name("libobs: volume meters");
+
+	while (os_event_timedwait(service->stop_event, sleep_ms) == ETIMEDOUT) {
+		uint64_t now = os_gettime_ns();
+		uint64_t next = now + METER_MAX_SLEEP_MS * 1000000ULL;
+
+		pthread_mutex_lock(&service->mutex);
+		for (size_t i = 0; i < service->meters.num; i++) {
+			uint64_t meter_next = volmeter_tick(
+				service->meters.array[i], service->scratch,
+				now);
+			if (meter_next > now && meter_next < next)
+				next = meter_next;
+		}
+		pthread_mutex_unlock(&service->mutex);
+
+		sleep_ms = (unsigned long)((next - now) / 1000000ULL);
+		if (!sleep_ms)
+			sleep_ms = 1;
+	}
+
+	return NULL;
+}
+
+bool obs_meter_service_init(struct obs_meter_service *service)
+{
+	memset(service, 0, sizeof(*service));
+	pthread_mutex_init_value(&service->mutex);
+
+	if (pthread_mutex_init(&service->mutex, NULL) != 0)
+		return false;
+	if (os_event_init(&service->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+
+	service->scratch = bmalloc(MAX_AUDIO_CHANNELS * METER_RING_FRAMES *
+				   sizeof(float));
+
+	if (pthread_create(&service->thread, NULL, meter_thread, service) != 0)
+		goto fail;
+
+	service->thread_active = true;
+	return true;
+
+fail:
+	obs_meter_service_free(service);
+	return false;
+}
+
+void obs_meter_service_free(struct obs_meter_service *service)
+{
+	if (service->thread_active) {
+		os_event_signal(service->stop_event);
+		pthread_join(service->thread, NULL);
+	}
+
+	/* meters that remain compute their levels in the capture callback
+	 * from now on */
+	pthread_mutex_lock(&service->mutex);
+	for (size_t i = 0; i < service->meters.num; i++)
+		os_atomic_store_bool(&service->meters.array[i]->decoupled,
+				     false);
+	da_free(service->meters);
+	service->thread_active = false;
+	pthread_mutex_unlock(&service->mutex);
+
+	pthread_mutex_destroy(&service->mutex);
+	os_event_destroy(service->stop_event);
+	bfree(service->scratch);
+	memset(service, 0, sizeof(*service));
+}
+
+static void volmeter_decouple(struct obs_volmeter *volmeter)
+{
+	struct obs_meter_service *service;
+
+	if (!obs || !obs->audio.audio)
+		return;
+
+	service = &obs->audio.meters;
+
+	pthread_mutex_lock(&service->mutex);
+	if (service->thread_active) {
+		volmeter->ring_channels =
+			audio_output_get_channels(obs->audio.audio);
+		volmeter->ring = bmalloc(volmeter->ring_channels *
+					 METER_RING_FRAMES * sizeof(float));
+		da_push_back(service->meters, &volmeter);
+		os_atomic_store_bool(&volmeter->decoupled, true);
+	}
+	pthread_mutex_unlock(&service->mutex);
+}
+
+static void volmeter_recouple(struct obs_volmeter *volmeter)
+{
+	struct obs_meter_service *service;
+
+	if (!os_atomic_load_bool(&volmeter->decoupled))
+		return;
+
+	service = &obs->audio.meters;
+
+	pthread_mutex_lock(&service->mutex);
+	da_erase_item(service->meters, &volmeter);
+	os_atomic_store_bool(&volmeter->decoupled, false);
+	pthread_mutex_unlock(&service->mutex);
+}
+
 obs_fader_t *obs_fader_create(enum obs_fader_type type)
 {
 	struct obs_fader *fader = bzalloc(sizeof(struct obs_fader));
@@ -782,8 +1088,10 @@ obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 		goto fail;
 
 	volmeter->type = type;
+	volmeter->enabled = true;
 
 	obs_volmeter_set_update_interval(volmeter, 50);
+	volmeter_decouple(volmeter);
 
 	return volmeter;
 fail:
@@ -797,10 +1105,12 @@ void obs_volmeter_destroy(obs_volmeter_t *volmeter)
 		return;
 
 	obs_volmeter_detach_source(volmeter);
+	volmeter_recouple(volmeter);
 	da_free(volmeter->callbacks);
 	pthread_mutex_destroy(&volmeter->callback_mutex);
 	pthread_mutex_destroy(&volmeter->mutex);
 
+	bfree(volmeter->ring);
 	bfree(volmeter);
 }
 
@@ -877,6 +1187,21 @@ void obs_volmeter_set_update_interval(obs_volmeter_t *volmeter,
 	pthread_mutex_unlock(&volmeter->mutex);
 }
 
+void obs_volmeter_set_enabled(obs_volmeter_t *volmeter, bool enabled)
+{
+	if (!obs_ptr_valid(volmeter, "obs_volmeter_set_enabled"))
+		return;
+
+	os_atomic_store_bool(&volmeter->enabled, enabled);
+}
+
+bool obs_volmeter_enabled(obs_volmeter_t *volmeter)
+{
+	return obs_ptr_valid(volmeter, "obs_volmeter_enabled")
+		       ? os_atomic_load_bool(&volmeter->enabled)
+		       : false;
+}
+
 unsigned int obs_volmeter_get_update_interval(obs_volmeter_t *volmeter)
 {
 	if (!volmeter)
@@ -889,6 +1214,31 @@ unsigned int obs_volmeter_get_update_interval(obs_volmeter_t *volmeter)
 	return interval;
 }
 
+uint64_t obs_volmeter_get_levels(obs_volmeter_t *volmeter,
+				 float magnitude[MAX_AUDIO_CHANNELS],
+				 float peak[MAX_AUDIO_CHANNELS],
+				 float input_peak[MAX_AUDIO_CHANNELS])
+{
+	uint64_t ts;
+
+	if (!obs_ptr_valid(volmeter, "obs_volmeter_get_levels"))
+		return 0;
+
+	pthread_mutex_lock(&volmeter->mutex);
+	ts = volmeter->level_ts;
+	if (ts) {
+		memcpy(magnitude, volmeter->level_magnitude,
+		       sizeof(volmeter->level_magnitude));
+		memcpy(peak, volmeter->level_peak,
+		       sizeof(volmeter->level_peak));
+		memcpy(input_peak, volmeter->level_input_peak,
+		       sizeof(volmeter->level_input_peak));
+	}
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	return ts;
+}
+
 int obs_volmeter_get_nr_channels(obs_volmeter_t *volmeter)
 {
 	int source_nr_audio_channels;
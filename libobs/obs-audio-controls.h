@@ -252,6 +252,23 @@ obs_volmeter_set_peak_meter_type(obs_volmeter_t *volmeter,
 EXPORT void obs_volmeter_set_update_interval(obs_volmeter_t *volmeter,
 					     const unsigned int ms);
 
+/**
+ * @brief Enable or disable the volume meter
+ * @param volmeter pointer to the volume meter object
+ * @param enabled false to stop measuring levels, e.g. while no meter is shown
+ *
+ * A disabled volume meter stays attached to its source but does not process
+ * audio or emit the levels_updated signal.  Volume meters are enabled when
+ * created.
+ */
+EXPORT void obs_volmeter_set_enabled(obs_volmeter_t *volmeter, bool enabled);
+
+/**
+ * @brief Get whether the volume meter is enabled
+ * @param volmeter pointer to the volume meter object
+ */
+EXPORT bool obs_volmeter_enabled(obs_volmeter_t *volmeter);
+
 /**
  * @brief Get the update interval currently used for the volume meter
  * @param volmeter pointer to the volume meter object
@@ -265,6 +282,24 @@ EXPORT unsigned int obs_volmeter_get_update_interval(obs_volmeter_t *volmeter);
  */
 EXPORT int obs_volmeter_get_nr_channels(obs_volmeter_t *volmeter);
 
+/**
+ * @brief Get the levels the volume meter emitted last
+ * @param volmeter pointer to the volume meter object
+ * @param magnitude receives the magnitude of each channel in dB
+ * @param peak receives the peak of each channel in dB
+ * @param input_peak receives the peak of each channel before the volume of
+ *        the source is applied, in dB
+ * @return the time the levels were emitted at, or 0 if there were none yet,
+ *         in which case the arrays are left untouched
+ *
+ * This lets a user interface read any number of meters from one timer at its
+ * own redraw rate, instead of handling a callback per meter and update.
+ */
+EXPORT uint64_t obs_volmeter_get_levels(obs_volmeter_t *volmeter,
+					float magnitude[MAX_AUDIO_CHANNELS],
+					float peak[MAX_AUDIO_CHANNELS],
+					float input_peak[MAX_AUDIO_CHANNELS]);
+
 typedef void (*obs_volmeter_updated_t)(
 	void *param, const float magnitude[MAX_AUDIO_CHANNELS],
 	const float peak[MAX_AUDIO_CHANNELS],
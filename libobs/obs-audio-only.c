@@ -0,0 +1,168 @@
+#include "graphics/image-file.h"
+#include "media-io/video-frame.h"
+#include "media-io/video-scaler.h"
+#include "obs-internal.h"
+
+/*
+ * Audio-only mode has no graphics context and no mixes.  Outputs that need a
+ * video track get cover_video instead, which repeats a single NV12 frame: the
+ * cover image is decoded and converted once, after which each frame is a
+ * plain copy and encoders see identical input that costs next to nothing to
+ * encode.
+ */
+
+static enum video_format get_image_format(enum gs_color_format format)
+{
+	switch (format) {
+	case GS_BGRA:
+		return VIDEO_FORMAT_BGRA;
+	case GS_BGRX:
+		return VIDEO_FORMAT_BGRX;
+	case GS_RGBA:
+		return VIDEO_FORMAT_RGBA;
+	default:
+		return VIDEO_FORMAT_NONE;
+	}
+}
+
+static void fill_black(struct obs_core_video *video)
+{
+	const struct obs_video_info *ovi = &video->cover_ovi;
+	size_t luma = (size_t)ovi->output_width * ovi->output_height;
+
+	memset(video->cover_frame, ovi->range == VIDEO_RANGE_FULL ? 0 : 16,
+	       luma);
+	memset(video->cover_frame + luma, 128, luma / 2);
+}
+
+static bool convert_image(struct obs_core_video *video, gs_image_file_t *image)
+{
+	const struct obs_video_info *ovi = &video->cover_ovi;
+	struct video_scale_info src = {0};
+	struct video_scale_info dst = {0};
+	video_scaler_t *scaler;
+	uint8_t *output[2];
+	uint32_t out_linesize[2];
+	const uint8_t *input[1] = {image->texture_data};
+	const uint32_t in_linesize[1] = {image->cx * 4};
+	bool success;
+
+	src.format = get_image_format(image->format);
+	src.width = image->cx;
+	src.height = image->cy;
+	src.range = VIDEO_RANGE_FULL;
+	src.colorspace = ovi->colorspace;
+
+	if (src.format == VIDEO_FORMAT_NONE)
+		return false;
+
+	dst.format = VIDEO_FORMAT_NV12;
+	dst.width = ovi->output_width;
+	dst.height = ovi->output_height;
+	dst.range = ovi->range;
+	dst.colorspace = ovi->colorspace;
+
+	if (video_scaler_create(&scaler, &dst, &src, VIDEO_SCALE_BICUBIC) !=
+	    VIDEO_SCALER_SUCCESS)
+		return false;
+
+	output[0] = video->cover_frame;
+	output[1] = video->cover_frame + (size_t)dst.width * dst.height;
+	out_linesize[0] = dst.width;
+	out_linesize[1] = dst.width;
+
+	success = video_scaler_scale(scaler, output, out_linesize, input,
+				     in_linesize);
+	video_scaler_destroy(scaler);
+	return success;
+}
+
+static bool load_cover_image(struct obs_core_video *video, const char *path)
+{
+	gs_image_file_t image;
+	bool success = false;
+
+	gs_image_file_init(&image, path);
+
+	/* animated gifs only keep decoded frames in their own cache */
+	if (image.loaded && image.texture_data)
+		success = convert_image(video, &image);
+	if (image.loaded && !success)
+		blog(LOG_WARNING, "Could not use '%s' as cover image", path);
+
+	gs_image_file_free(&image);
+	return success;
+}
+
+int obs_init_cover_video(const struct obs_video_info *ovi,
+			 const char *image_path)
+{
+	struct obs_core_video *video = &obs->video;
+	struct video_output_info vi = {0};
+	size_t size;
+	int errorcode;
+
+	vi.name = "audio-only video";
+	vi.format = VIDEO_FORMAT_NV12;
+	vi.fps_num = ovi->fps_num;
+	vi.fps_den = ovi->fps_den;
+	vi.width = ovi->output_width;
+	vi.height = ovi->output_height;
+	vi.range = ovi->range;
+	vi.colorspace = ovi->colorspace;
+	vi.cache_size = 6;
+
+	errorcode = video_output_open(&video->cover_video, &vi);
+	if (errorcode != VIDEO_OUTPUT_SUCCESS) {
+		blog(LOG_ERROR, "Could not open audio-only video output");
+		return errorcode == VIDEO_OUTPUT_INVALIDPARAM
+			       ? OBS_VIDEO_INVALID_PARAM
+			       : OBS_VIDEO_FAIL;
+	}
+
+	video->cover_ovi = *ovi;
+	video->cover_ovi.output_format = VIDEO_FORMAT_NV12;
+	video->cover_ovi.gpu_conversion = false;
+
+	size = (size_t)ovi->output_width * ovi->output_height;
+	video->cover_frame = bmalloc(size + size / 2);
+
+	if (!image_path || !*image_path ||
+	    !load_cover_image(video, image_path))
+		fill_black(video);
+
+	return OBS_VIDEO_SUCCESS;
+}
+
+void obs_free_cover_video(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	video_output_close(video->cover_video);
+	video->cover_video = NULL;
+
+	bfree(video->cover_frame);
+	video->cover_frame = NULL;
+}
+
+void obs_output_cover_frame(uint64_t timestamp)
+{
+	struct obs_core_video *video = &obs->video;
+	const struct obs_video_info *ovi = &video->cover_ovi;
+	size_t luma = (size_t)ovi->output_width * ovi->output_height;
+	struct video_frame frame;
+
+	if (!video_output_lock_frame(video->cover_video, &frame, 1, timestamp))
+		return;
+
+	for (uint32_t y = 0; y < ovi->output_height; y++)
+		memcpy(frame.data[0] + y * frame.linesize[0],
+		       video->cover_frame + y * ovi->output_width,
+		       ovi->output_width);
+	for (uint32_t y = 0; y < ovi->output_height / 2; y++)
+		memcpy(frame.data[1] + y * frame.linesize[1],
+		       video->cover_frame + luma + y * ovi->output_width,
+		       ovi->output_width);
+
+	video_output_unlock_frame(video->cover_video);
+}
@@ -0,0 +1,78 @@
+#include "util/platform.h"
+#include "obs-internal.h"
+
+/* same scheme as the tick pool: each task claims the next source until the
+ * list is drained */
+static void run_tasks(struct obs_audio_pool *pool)
+{
+	const long count = (long)pool->sources.num;
+
+	for (;;) {
+		long idx = os_atomic_inc_long(&pool->next_source) - 1;
+		if (idx >= count)
+			break;
+
+		pool->task(pool->sources.array[idx], pool->param);
+	}
+}
+
+static void audio_task(void *param)
+{
+	run_tasks(param);
+}
+
+bool obs_audio_pool_init(struct obs_audio_pool *pool)
+{
+	memset(pool, 0, sizeof(*pool));
+
+	pool->num_threads = obs_get_pool_threads();
+	if (!pool->num_threads)
+		return true;
+
+	pool->group = obs_task_group_create();
+	if (!pool->group) {
+		pool->num_threads = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void obs_audio_pool_free(struct obs_audio_pool *pool)
+{
+	obs_task_group_destroy(pool->group);
+
+	da_free(pool->sources);
+	memset(pool, 0, sizeof(*pool));
+}
+
+/* calls task for every queued source and returns once all tasks have
+ * finished; the caller empties the list */
+void obs_audio_pool_run(struct obs_audio_pool *pool,
+			void (*task)(obs_source_t *source, void *param),
+			void *param)
+{
+	size_t count = pool->sources.num;
+	size_t helpers = 0;
+
+	if (!count)
+		return;
+
+	pool->task = task;
+	pool->param = param;
+	os_atomic_store_long(&pool->next_source, 0);
+
+	/* the audio thread takes a share of the work too */
+	if (count > 1)
+		helpers = count - 1 < pool->num_threads ? count - 1
+							: pool->num_threads;
+
+	for (size_t i = 0; i < helpers; i++)
+		obs_task_group_queue(pool->group, OBS_TASK_PRIORITY_HIGH,
+				     audio_task, pool);
+
+	run_tasks(pool);
+
+	if (helpers)
+		obs_task_group_wait(pool->group);
+}
@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include "obs-internal.h"
 #include "util/util_uint64.h"
+#include "media-io/audio-mixing.h"
 
 struct ts_info {
 	uint64_t start;
@@ -28,6 +29,19 @@ struct ts_info {
 #define DEBUG_LAGGED_AUDIO 0
 #define MAX_BUFFERING_TICKS 45
 
+/* a source that makes the buffering grow beyond the isolation threshold this
+ * many times within the period is isolated: its late audio is dropped instead
+ * of buffering more for it, until it has been on time for the stable period */
+#define ISOLATE_BUFFERING_TICKS 10
+#define LATE_EVENTS_TO_ISOLATE 3
+#define LATE_EVENT_PERIOD 60000000000ULL
+#define SOURCE_STABLE_PERIOD 30000000000ULL
+
+/* buffering is reduced once all sources had more than the spare ticks of
+ * audio ready for the whole period */
+#define BUFFERING_STABLE_PERIOD 30000000000ULL
+#define BUFFERING_SPARE_TICKS 2
+
 static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
 	struct obs_core_audio *audio = p;
@@ -67,16 +81,10 @@ static inline void mix_audio(struct audio_output_data *mixes,
 
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
 		for (size_t ch = 0; ch < channels; ch++) {
-			register float *mix = mixes[mix_idx].data[ch];
-			register float *aud =
-				source->audio_output_buf[mix_idx][ch];
-			register float *end;
+			float *mix = mixes[mix_idx].data[ch];
+			float *aud = source->audio_output_buf[mix_idx][ch];
 
-			mix += start_point;
-			end = aud + total_floats;
-
-			while (aud < end)
-				*(mix++) += *(aud++);
+			audio_mix_add(mix + start_point, aud, total_floats);
 		}
 	}
 }
@@ -291,10 +299,41 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	source->audio_ts = ts->end;
 }
 
+static inline void reset_headroom(struct obs_core_audio *audio, uint64_t ts)
+{
+	audio->min_headroom_ticks = MAX_BUFFERING_TICKS;
+	audio->headroom_since = ts;
+}
+
+/* returns true if the source keeps making the buffering grow and is isolated
+ * instead */
+static bool isolate_late_source(obs_source_t *source, uint64_t ts)
+{
+	if (!source->audio_late_events ||
+	    ts - source->audio_late_since > LATE_EVENT_PERIOD) {
+		source->audio_late_events = 0;
+		source->audio_late_since = ts;
+	}
+
+	if (++source->audio_late_events < LATE_EVENTS_TO_ISOLATE)
+		return false;
+
+	blog(LOG_WARNING,
+	     "Source '%s' audio keeps arriving late, dropping its late "
+	     "audio instead of adding audio buffering",
+	     obs_source_get_name(source));
+
+	source->audio_isolated = true;
+	source->audio_on_time_since = ts;
+	return true;
+}
+
 static void add_audio_buffering(struct obs_core_audio *audio,
 				size_t sample_rate, struct ts_info *ts,
-				uint64_t min_ts, const char *buffering_name)
+				uint64_t min_ts, obs_source_t *source)
 {
+	const char *buffering_name = source ? obs_source_get_name(source)
+					    : NULL;
 	struct ts_info new_ts;
 	uint64_t offset;
 	uint64_t frames;
@@ -305,13 +344,20 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS)
 		return;
 
-	if (!audio->buffering_wait_ticks)
-		audio->buffered_ts = ts->start;
-
 	offset = ts->start - min_ts;
 	frames = ns_to_audio_frames(sample_rate, offset);
 	ticks = (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
 
+	if (source &&
+	    audio->total_buffering_ticks + ticks > ISOLATE_BUFFERING_TICKS &&
+	    isolate_late_source(source, ts->start))
+		return;
+
+	reset_headroom(audio, ts->start);
+
+	if (!audio->buffering_wait_ticks)
+		audio->buffered_ts = ts->start;
+
 	audio->total_buffering_ticks += ticks;
 
 	if (audio->total_buffering_ticks >= MAX_BUFFERING_TICKS) {
@@ -329,6 +375,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	     "audio buffering is now %d milliseconds"
 	     " (source: %s)\n",
 	     (int)ms, (int)total_ms, buffering_name);
+	profiler_trace_trigger("audio buffering increase");
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG,
 	     "min_ts (%" PRIu64 ") < start timestamp "
@@ -394,21 +441,21 @@ static bool audio_buffer_insuffient(struct obs_source *source,
 	return false;
 }
 
-static inline const char *find_min_ts(struct obs_core_data *data,
-				      uint64_t *min_ts)
+static inline obs_source_t *find_min_ts(struct obs_core_data *data,
+					uint64_t *min_ts)
 {
 	obs_source_t *buffering_source = NULL;
 	struct obs_source *source = data->first_audio_source;
 	while (source) {
-		if (!source->audio_pending && source->audio_ts &&
-		    source->audio_ts < *min_ts) {
+		if (!source->audio_pending && !source->audio_isolated &&
+		    source->audio_ts && source->audio_ts < *min_ts) {
 			*min_ts = source->audio_ts;
 			buffering_source = source;
 		}
 
 		source = (struct obs_source *)source->next_audio_source;
 	}
-	return buffering_source ? obs_source_get_name(buffering_source) : NULL;
+	return buffering_source;
 }
 
 static inline bool mark_invalid_sources(struct obs_core_data *data,
@@ -426,13 +473,85 @@ static inline bool mark_invalid_sources(struct obs_core_data *data,
 	return recalculate;
 }
 
-static inline const char *calc_min_ts(struct obs_core_data *data,
-				      size_t sample_rate, uint64_t *min_ts)
+static inline obs_source_t *calc_min_ts(struct obs_core_data *data,
+					size_t sample_rate, uint64_t *min_ts)
 {
-	const char *buffering_name = find_min_ts(data, min_ts);
+	obs_source_t *buffering_source = find_min_ts(data, min_ts);
 	if (mark_invalid_sources(data, sample_rate, *min_ts))
-		buffering_name = find_min_ts(data, min_ts);
-	return buffering_name;
+		buffering_source = find_min_ts(data, min_ts);
+	return buffering_source;
+}
+
+/* tracks how much audio the source has ready beyond the mixed window, and
+ * whether an isolated source has become stable again; assumes audio_buf_mutex
+ * is held */
+static void update_headroom(struct obs_core_audio *audio, obs_source_t *source,
+			    size_t sample_rate, const struct ts_info *ts)
+{
+	const uint64_t tick_ns =
+		audio_frames_to_ns(sample_rate, AUDIO_OUTPUT_FRAMES);
+	uint64_t end;
+	int ticks;
+
+	if (source->info.audio_render || source->audio_pending ||
+	    !source->audio_ts)
+		return;
+
+	end = source->audio_ts +
+	      audio_frames_to_ns(sample_rate, source->audio_input_buf[0].size /
+						      sizeof(float));
+	ticks = end > ts->end ? (int)((end - ts->end) / tick_ns) : 0;
+
+	if (source->audio_isolated) {
+		if (end < ts->end) {
+			source->audio_on_time_since = ts->end;
+		} else if (ts->end - source->audio_on_time_since >
+			   SOURCE_STABLE_PERIOD) {
+			blog(LOG_INFO, "Source '%s' audio is on time again",
+			     obs_source_get_name(source));
+			source->audio_isolated = false;
+			source->audio_late_events = 0;
+		}
+		return;
+	}
+
+	if (ticks < audio->min_headroom_ticks)
+		audio->min_headroom_ticks = ticks;
+}
+
+/* once every source has had audio ready further ahead than needed for a
+ * while, the audio thread outputs the surplus ticks early */
+static void reduce_audio_buffering(struct obs_core_audio *audio,
+				   size_t sample_rate, uint64_t ts)
+{
+	int ticks;
+
+	if (audio->buffering_wait_ticks || !audio->total_buffering_ticks) {
+		reset_headroom(audio, ts);
+		return;
+	}
+
+	if (ts - audio->headroom_since < BUFFERING_STABLE_PERIOD)
+		return;
+
+	ticks = audio->min_headroom_ticks - BUFFERING_SPARE_TICKS;
+	if (ticks > audio->total_buffering_ticks)
+		ticks = audio->total_buffering_ticks;
+
+	if (ticks > 0) {
+		size_t ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
+		size_t total_ms = (audio->total_buffering_ticks - ticks) *
+				  AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
+
+		blog(LOG_INFO,
+		     "removing %d milliseconds of audio buffering, total "
+		     "audio buffering is now %d milliseconds",
+		     (int)ms, (int)total_ms);
+
+		audio_output_catch_up(audio->audio, (uint32_t)ticks);
+	}
+
+	reset_headroom(audio, ts);
 }
 
 static inline void release_audio_sources(struct obs_core_audio *audio)
@@ -441,6 +560,76 @@ static inline void release_audio_sources(struct obs_core_audio *audio)
 		obs_source_release(audio->render_order.array[i]);
 }
 
+struct render_params {
+	uint32_t mixers;
+	size_t channels;
+	size_t sample_rate;
+	size_t size;
+};
+
+static void filter_task(obs_source_t *source, void *param)
+{
+	obs_source_filter_queued_audio(source);
+	UNUSED_PARAMETER(param);
+}
+
+/* filters the audio the sources have queued since the last tick, each source
+ * on whichever worker gets to it first */
+static void filter_queued_audio(struct obs_core_data *data,
+				struct obs_audio_pool *pool)
+{
+	struct obs_source *source;
+
+	pthread_mutex_lock(&data->audio_sources_mutex);
+
+	source = data->first_audio_source;
+	while (source) {
+		if (obs_source_audio_queued(source)) {
+			obs_source_t *s = obs_source_get_ref(source);
+			if (s)
+				da_push_back(pool->sources, &s);
+		}
+		source = (struct obs_source *)source->next_audio_source;
+	}
+
+	pthread_mutex_unlock(&data->audio_sources_mutex);
+
+	obs_audio_pool_run(pool, filter_task, NULL);
+
+	for (size_t i = 0; i < pool->sources.num; i++)
+		obs_source_release(pool->sources.array[i]);
+	da_resize(pool->sources, 0);
+}
+
+static void render_task(obs_source_t *source, void *param)
+{
+	struct render_params *p = param;
+	obs_source_audio_render(source, p->mixers, p->channels, p->sample_rate,
+				p->size);
+}
+
+/* sources without audio_render only read their own buffers, so they can all
+ * be rendered at once ahead of the sources that mix them */
+static inline bool is_leaf(obs_source_t *source)
+{
+	return !source->info.audio_render;
+}
+
+static void render_leaves(struct obs_core_audio *audio,
+			  struct render_params *params)
+{
+	struct obs_audio_pool *pool = &audio->pool;
+
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+		if (is_leaf(source))
+			da_push_back(pool->sources, &source);
+	}
+
+	obs_audio_pool_run(pool, render_task, params);
+	da_resize(pool->sources, 0);
+}
+
 bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 		    uint64_t *out_ts, uint32_t mixers,
 		    struct audio_output_data *mixes)
@@ -454,10 +643,32 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	size_t audio_size;
 	uint64_t min_ts;
 
+	/* an empty range outputs a tick that is already buffered, see
+	 * reduce_audio_buffering */
+	const bool catch_up = start_ts_in == end_ts_in;
+
+	if (catch_up &&
+	    (!audio->buffered_timestamps.size || audio->buffering_wait_ticks))
+		return false;
+
+	uint64_t mix_start = os_gettime_ns();
+
 	da_resize(audio->render_order, 0);
 	da_resize(audio->root_nodes, 0);
 
-	circlebuf_push_back(&audio->buffered_timestamps, &ts, sizeof(ts));
+	audio_output_set_clock_deviation(
+		audio->audio,
+		os_atomic_load_long_long(&obs->master_clock.deviation_ppb));
+
+	if (!catch_up) {
+		uint64_t now = os_gettime_ns();
+		if (now > start_ts_in)
+			obs_histogram_observe(&audio->tick_latency_hist,
+					      now - start_ts_in);
+
+		circlebuf_push_back(&audio->buffered_timestamps, &ts,
+				    sizeof(ts));
+	}
 	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
@@ -467,6 +678,10 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	blog(LOG_DEBUG, "ts %llu-%llu", ts.start, ts.end);
 #endif
 
+	/* ------------------------------------------------ */
+	/* run the filters of queued source audio */
+	filter_queued_audio(data, &audio->pool);
+
 	/* ------------------------------------------------ */
 	/* build audio render order
 	 * NOTE: these are source channels, not audio channels */
@@ -493,14 +708,23 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	/* ------------------------------------------------ */
 	/* render audio data */
+	struct render_params params = {mixers, channels, sample_rate,
+				       audio_size};
+	const bool parallel = audio->pool.num_threads != 0;
+
+	if (parallel)
+		render_leaves(audio, &params);
+
 	for (size_t i = 0; i < audio->render_order.num; i++) {
 		obs_source_t *source = audio->render_order.array[i];
-		obs_source_audio_render(source, mixers, channels, sample_rate,
-					audio_size);
+		if (!parallel || !is_leaf(source))
+			obs_source_audio_render(source, mixers, channels,
+						sample_rate, audio_size);
 
 		/* if a source has gone backward in time and we can no
 		 * longer buffer, drop some or all of its audio */
-		if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS &&
+		if ((audio->total_buffering_ticks == MAX_BUFFERING_TICKS ||
+		     source->audio_isolated) &&
 		    source->audio_ts < ts.start) {
 			if (source->info.audio_render) {
 				blog(LOG_DEBUG,
@@ -534,14 +758,15 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	/* ------------------------------------------------ */
 	/* get minimum audio timestamp */
 	pthread_mutex_lock(&data->audio_sources_mutex);
-	const char *buffering_name = calc_min_ts(data, sample_rate, &min_ts);
+	obs_source_t *buffering_source =
+		calc_min_ts(data, sample_rate, &min_ts);
 	pthread_mutex_unlock(&data->audio_sources_mutex);
 
 	/* ------------------------------------------------ */
 	/* if a source has gone backward in time, buffer */
 	if (min_ts < ts.start)
 		add_audio_buffering(audio, sample_rate, &ts, min_ts,
-				    buffering_name);
+				    buffering_source);
 
 	/* ------------------------------------------------ */
 	/* mix audio */
@@ -569,6 +794,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	source = data->first_audio_source;
 	while (source) {
 		pthread_mutex_lock(&source->audio_buf_mutex);
+		update_headroom(audio, source, sample_rate, &ts);
 		discard_audio(audio, source, channels, sample_rate, &ts);
 		pthread_mutex_unlock(&source->audio_buf_mutex);
 
@@ -583,8 +809,20 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	circlebuf_pop_front(&audio->buffered_timestamps, NULL, sizeof(ts));
 
+	if (catch_up)
+		audio->total_buffering_ticks--;
+	else
+		reduce_audio_buffering(audio, sample_rate, ts.start);
+
 	*out_ts = ts.start;
 
+	struct obs_telemetry_sample sample = {
+		.timestamp = os_gettime_ns(),
+		.queued = (uint32_t)audio->total_buffering_ticks,
+	};
+	sample.duration_ns = sample.timestamp - mix_start;
+	obs_telemetry_push(&audio->telemetry, &sample);
+
 	if (audio->buffering_wait_ticks) {
 		audio->buffering_wait_ticks--;
 		return false;
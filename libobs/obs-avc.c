@@ -17,6 +17,7 @@
 
 #include "obs.h"
 #include "obs-avc.h"
+#include "obs-internal.h"
 #include "util/array-serializer.h"
 
 bool obs_avc_keyframe(const uint8_t *data, size_t size)
@@ -135,18 +136,28 @@ void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 {
 	struct array_output_data output;
 	struct serializer s;
-	long ref = 1;
+
+	/* every output fed by the same encoder parses the same packet, so
+	 * only the first one has to convert it */
+	if (src->encoder && src->data &&
+	    obs_encoder_get_cached_avc_packet(src->encoder, src, avc_packet))
+		return;
 
 	array_output_serializer_init(&s, &output);
 	*avc_packet = *src;
 
-	serialize(&s, &ref, sizeof(ref));
 	serialize_avc_data(&s, src->data, src->size, &avc_packet->keyframe,
 			   &avc_packet->priority);
 
-	avc_packet->data = output.bytes.array + sizeof(ref);
-	avc_packet->size = output.bytes.num - sizeof(ref);
+	avc_packet->data = obs_packet_pool_alloc(output.bytes.num);
+	avc_packet->size = output.bytes.num;
 	avc_packet->drop_priority = get_drop_priority(avc_packet->priority);
+	memcpy(avc_packet->data, output.bytes.array, output.bytes.num);
+
+	array_output_serializer_free(&output);
+
+	if (src->encoder && src->data)
+		obs_encoder_cache_avc_packet(src->encoder, src, avc_packet);
 }
 
 static inline bool has_start_code(const uint8_t *data)
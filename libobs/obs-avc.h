@@ -49,6 +49,8 @@ enum { OBS_NAL_PRIORITY_DISPOSABLE = 0,
 EXPORT bool obs_avc_keyframe(const uint8_t *data, size_t size);
 EXPORT const uint8_t *obs_avc_find_startcode(const uint8_t *p,
 					     const uint8_t *end);
+/* converts to length prefixed NAL units; a packet from an encoder is only
+ * converted once, however many outputs parse it */
 EXPORT void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 				 const struct encoder_packet *src);
 EXPORT size_t obs_parse_avc_header(uint8_t **header, const uint8_t *data,
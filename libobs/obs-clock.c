@@ -0,0 +1,228 @@
+#include <math.h>
+
+#include "obs-internal.h"
+#include "util/util_uint64.h"
+
+/*
+ * The master clock is only ever compared to the system clock through pairs
+ * of samples.  The offset between the two clocks of each pair is the true
+ * offset plus however long the sample was delayed, by the scheduler for a
+ * polled clock or by the capture pipeline for a source.  Those delays are
+ * never negative, so the smallest offset of a window of samples is close to
+ * the true one, and the drift of the smallest offsets from one window to the
+ * next gives the rate of the clock without the jitter of single samples.
+ */
+
+#define CLOCK_WINDOW_NS 5000000000ULL
+
+/* a clock this far off the system clock jumped rather than drifted */
+#define CLOCK_MAX_DEVIATION 0.001
+
+bool obs_master_clock_init(struct obs_master_clock *clock)
+{
+	if (pthread_mutex_init(&clock->mutex, NULL) != 0)
+		return false;
+
+	clock->initialized = true;
+	return true;
+}
+
+void obs_master_clock_free(struct obs_master_clock *clock)
+{
+	if (!clock->initialized)
+		return;
+
+	pthread_mutex_destroy(&clock->mutex);
+	clock->initialized = false;
+}
+
+static void reset_clock(struct obs_master_clock *clock)
+{
+	if (clock->source)
+		os_atomic_set_bool(&clock->source->master_clock, false);
+
+	clock->get_time = NULL;
+	clock->param = NULL;
+	clock->source = NULL;
+
+	clock->window_valid = false;
+	clock->prev_valid = false;
+	clock->locked = false;
+	clock->deviation = 0.0;
+	os_atomic_store_long_long(&clock->deviation_ppb, 0);
+}
+
+static inline bool offset_below(uint64_t offset, uint64_t ref)
+{
+	return (int64_t)(offset - ref) < 0;
+}
+
+static void update_deviation(struct obs_master_clock *clock)
+{
+	uint64_t span = clock->window_min_sys - clock->prev_sys;
+	int64_t drift = (int64_t)(clock->window_offset - clock->prev_offset);
+	double measured;
+
+	/* the smallest offsets of two windows can fall right next to each
+	 * other, which says nothing about the rate */
+	if (span < CLOCK_WINDOW_NS / 2)
+		return;
+
+	/* the offset shrinks when the master clock runs faster */
+	measured = -(double)drift / (double)span;
+
+	if (fabs(measured) > CLOCK_MAX_DEVIATION) {
+		blog(LOG_WARNING, "Master clock jumped, measuring it again");
+		clock->prev_valid = false;
+		clock->locked = false;
+		return;
+	}
+
+	if (clock->locked) {
+		clock->deviation += (measured - clock->deviation) / 4.0;
+	} else {
+		clock->deviation = measured;
+		clock->locked = true;
+		blog(LOG_INFO, "Following master clock, %+.1f ppm",
+		     measured * 1e6);
+	}
+
+	os_atomic_store_long_long(&clock->deviation_ppb,
+				  (long long)(clock->deviation * 1e9));
+}
+
+static void add_sample(struct obs_master_clock *clock, uint64_t ext,
+		       uint64_t sys)
+{
+	uint64_t offset = sys - ext;
+
+	if (!clock->window_valid) {
+		clock->window_start = sys;
+		clock->window_offset = offset;
+		clock->window_min_sys = sys;
+		clock->window_valid = true;
+		return;
+	}
+
+	if (offset_below(offset, clock->window_offset)) {
+		clock->window_offset = offset;
+		clock->window_min_sys = sys;
+	}
+
+	if (sys - clock->window_start < CLOCK_WINDOW_NS)
+		return;
+
+	if (clock->prev_valid)
+		update_deviation(clock);
+
+	clock->prev_offset = clock->window_offset;
+	clock->prev_sys = clock->window_min_sys;
+	clock->prev_valid = true;
+
+	clock->window_start = sys;
+	clock->window_offset = offset;
+	clock->window_min_sys = sys;
+}
+
+/* the interval in system time that lasts interval_ns on the master clock */
+static inline uint64_t scale_interval(uint64_t interval_ns, long long ppb)
+{
+	return util_mul_div64(interval_ns, 1000000000ULL,
+			      (uint64_t)(1000000000LL + ppb));
+}
+
+uint64_t obs_master_clock_interval(uint64_t interval_ns)
+{
+	struct obs_master_clock *clock = &obs->master_clock;
+	long long ppb;
+
+	pthread_mutex_lock(&clock->mutex);
+	if (clock->get_time) {
+		/* system time is read last so that it doesn't include the
+		 * time it took to poll the clock */
+		uint64_t ext = clock->get_time(clock->param);
+		add_sample(clock, ext, os_gettime_ns());
+	}
+	pthread_mutex_unlock(&clock->mutex);
+
+	ppb = os_atomic_load_long_long(&clock->deviation_ppb);
+	return ppb ? scale_interval(interval_ns, ppb) : interval_ns;
+}
+
+void obs_master_clock_sample_source(obs_source_t *source, uint64_t timestamp)
+{
+	struct obs_master_clock *clock = &obs->master_clock;
+	uint64_t sys = os_gettime_ns();
+
+	pthread_mutex_lock(&clock->mutex);
+	if (clock->source == source)
+		add_sample(clock, timestamp, sys);
+	pthread_mutex_unlock(&clock->mutex);
+}
+
+void obs_master_clock_remove_source(obs_source_t *source)
+{
+	struct obs_master_clock *clock = &obs->master_clock;
+
+	pthread_mutex_lock(&clock->mutex);
+	if (clock->source == source)
+		reset_clock(clock);
+	pthread_mutex_unlock(&clock->mutex);
+}
+
+void obs_set_master_clock(obs_clock_get_time_t get_time, void *param)
+{
+	struct obs_master_clock *clock;
+
+	if (!obs)
+		return;
+
+	clock = &obs->master_clock;
+
+	pthread_mutex_lock(&clock->mutex);
+	reset_clock(clock);
+	clock->get_time = get_time;
+	clock->param = param;
+	pthread_mutex_unlock(&clock->mutex);
+}
+
+void obs_set_master_clock_source(obs_source_t *source)
+{
+	struct obs_master_clock *clock;
+
+	if (!obs)
+		return;
+	if (source && !obs_source_valid(source, "obs_set_master_clock_source"))
+		return;
+
+	clock = &obs->master_clock;
+
+	pthread_mutex_lock(&clock->mutex);
+	reset_clock(clock);
+	if (source && (source->info.output_flags & OBS_SOURCE_ASYNC_VIDEO) ==
+			      OBS_SOURCE_ASYNC_VIDEO) {
+		clock->source = source;
+		os_atomic_set_bool(&source->master_clock, true);
+	}
+	pthread_mutex_unlock(&clock->mutex);
+}
+
+void obs_reset_master_clock(void)
+{
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&obs->master_clock.mutex);
+	reset_clock(&obs->master_clock);
+	pthread_mutex_unlock(&obs->master_clock.mutex);
+}
+
+double obs_get_master_clock_deviation(void)
+{
+	if (!obs)
+		return 0.0;
+
+	return (double)os_atomic_load_long_long(
+		       &obs->master_clock.deviation_ppb) /
+	       1000.0;
+}
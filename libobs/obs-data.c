@@ -32,6 +32,9 @@ struct obs_data_item {
 	volatile long ref;
 	struct obs_data *parent;
 	struct obs_data_item *next;
+	/* the pointer that points to this item, NULL once detached */
+	struct obs_data_item **prev_next;
+	uint32_t hash;
 	enum obs_data_type type;
 	size_t name_len;
 	size_t data_len;
@@ -46,6 +49,13 @@ struct obs_data {
 	volatile long ref;
 	char *json;
 	struct obs_data_item *first_item;
+	struct obs_data_item *last_item;
+	size_t num_items;
+
+	/* items by name (linear probing), built once the object has enough
+	 * items for the list to be slow to search */
+	struct obs_data_item **index;
+	size_t index_size;
 };
 
 struct obs_data_array {
@@ -64,6 +74,14 @@ struct obs_data_number {
 /* ------------------------------------------------------------------------- */
 /* Item structure, designed to be one allocation only */
 
+static inline uint32_t name_hash(const char *str, size_t len)
+{
+	uint32_t hash = 2166136261U;
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ (uint8_t)str[i]) * 16777619U;
+	return hash;
+}
+
 static inline size_t get_align_size(size_t size)
 {
 	const size_t alignment = base_get_alignment();
@@ -281,6 +299,7 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 	item->capacity = total_size;
 	item->type = type;
 	item->name_len = name_size;
+	item->hash = name_hash(name, strlen(name));
 	item->ref = 1;
 
 	if (default_data) {
@@ -302,45 +321,202 @@ static struct obs_data_item *obs_data_item_create(const char *name,
 	return item;
 }
 
-static struct obs_data_item **get_item_prev_next(struct obs_data *data,
-						 struct obs_data_item *current)
+/* ------------------------------------------------------------------------- */
+/* Name index */
+
+#define INDEX_MIN_ITEMS 16
+
+static inline size_t index_mask(const struct obs_data *data)
 {
-	if (!current || !data)
-		return NULL;
+	return data->index_size - 1;
+}
 
-	struct obs_data_item **prev_next = &data->first_item;
-	struct obs_data_item *item = data->first_item;
+static void index_insert(struct obs_data *data, struct obs_data_item *item)
+{
+	size_t slot = item->hash & index_mask(data);
 
-	while (item) {
-		if (item == current)
-			return prev_next;
+	while (data->index[slot])
+		slot = (slot + 1) & index_mask(data);
+	data->index[slot] = item;
+}
 
-		prev_next = &item->next;
-		item = item->next;
+static void index_build(struct obs_data *data)
+{
+	size_t size = INDEX_MIN_ITEMS * 2;
+
+	while (size < data->num_items * 2)
+		size *= 2;
+
+	bfree(data->index);
+	data->index = bzalloc(size * sizeof(struct obs_data_item *));
+	data->index_size = size;
+
+	for (struct obs_data_item *item = data->first_item; item;
+	     item = item->next)
+		index_insert(data, item);
+}
+
+/* call after the item has been linked */
+static inline void index_add(struct obs_data *data, struct obs_data_item *item)
+{
+	if (data->num_items * 2 > data->index_size) {
+		if (data->num_items >= INDEX_MIN_ITEMS)
+			index_build(data);
+	} else {
+		index_insert(data, item);
+	}
+}
+
+static size_t index_find_slot(struct obs_data *data, uint32_t hash,
+			      const struct obs_data_item *item)
+{
+	size_t slot = hash & index_mask(data);
+
+	while (data->index[slot]) {
+		if (data->index[slot] == item)
+			return slot;
+		slot = (slot + 1) & index_mask(data);
+	}
+
+	return (size_t)-1;
+}
+
+static void index_remove(struct obs_data *data, struct obs_data_item *item)
+{
+	size_t mask = index_mask(data);
+	size_t slot = index_find_slot(data, item->hash, item);
+	size_t next = slot;
+
+	if (slot == (size_t)-1)
+		return;
+
+	/* shifts back the items that can no longer be found past the gap */
+	for (;;) {
+		struct obs_data_item *cur;
+		size_t home;
+
+		next = (next + 1) & mask;
+		cur = data->index[next];
+		if (!cur)
+			break;
+
+		home = cur->hash & mask;
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			data->index[slot] = cur;
+			slot = next;
+		}
+	}
+
+	data->index[slot] = NULL;
+}
+
+static struct obs_data_item *index_get(struct obs_data *data, const char *name)
+{
+	uint32_t hash = name_hash(name, strlen(name));
+	size_t slot = hash & index_mask(data);
+	struct obs_data_item *item;
+
+	while ((item = data->index[slot]) != NULL) {
+		if (item->hash == hash &&
+		    strcmp(get_item_name(item), name) == 0)
+			return item;
+		slot = (slot + 1) & index_mask(data);
 	}
 
 	return NULL;
 }
 
-static inline void obs_data_item_detach(struct obs_data_item *item)
+/* ------------------------------------------------------------------------- */
+/* Item list */
+
+static inline struct obs_data_item *
+prev_item(struct obs_data *data, struct obs_data_item **prev_next)
 {
-	struct obs_data_item **prev_next =
-		get_item_prev_next(item->parent, item);
+	if (prev_next == &data->first_item)
+		return NULL;
 
-	if (prev_next) {
-		*prev_next = item->next;
-		item->next = NULL;
+	return (struct obs_data_item *)((uint8_t *)prev_next -
+					offsetof(struct obs_data_item, next));
+}
+
+static void link_item(struct obs_data *data, struct obs_data_item **prev_next,
+		      struct obs_data_item *item)
+{
+	item->parent = data;
+	item->next = *prev_next;
+	item->prev_next = prev_next;
+
+	if (item->next)
+		item->next->prev_next = &item->next;
+	else
+		data->last_item = item;
+
+	*prev_next = item;
+	data->num_items++;
+	index_add(data, item);
+}
+
+/* keeps the items sorted by name */
+static void insert_item(struct obs_data *data, struct obs_data_item *item)
+{
+	const char *name = get_item_name(item);
+	struct obs_data_item **prev_next = &data->first_item;
+
+	/* items are mostly added in order, from files for example */
+	if (data->last_item &&
+	    strcmp(get_item_name(data->last_item), name) < 0) {
+		prev_next = &data->last_item->next;
+	} else {
+		while (*prev_next &&
+		       strcmp(get_item_name(*prev_next), name) < 0)
+			prev_next = &(*prev_next)->next;
 	}
+
+	link_item(data, prev_next, item);
+}
+
+static inline void obs_data_item_detach(struct obs_data_item *item)
+{
+	struct obs_data *data = item->parent;
+
+	if (!item->prev_next)
+		return;
+
+	*item->prev_next = item->next;
+	if (item->next)
+		item->next->prev_next = item->prev_next;
+	else
+		data->last_item = prev_item(data, item->prev_next);
+
+	if (data->index)
+		index_remove(data, item);
+	data->num_items--;
+
+	item->next = NULL;
+	item->prev_next = NULL;
 }
 
+/* the item has been moved by brealloc, old_ptr is no longer valid */
 static inline void obs_data_item_reattach(struct obs_data_item *old_ptr,
 					  struct obs_data_item *new_ptr)
 {
-	struct obs_data_item **prev_next =
-		get_item_prev_next(new_ptr->parent, old_ptr);
+	struct obs_data *data = new_ptr->parent;
+	size_t slot;
+
+	if (!new_ptr->prev_next)
+		return;
 
-	if (prev_next)
-		*prev_next = new_ptr;
+	*new_ptr->prev_next = new_ptr;
+	if (new_ptr->next)
+		new_ptr->next->prev_next = &new_ptr->next;
+	else
+		data->last_item = new_ptr;
+
+	if (data->index) {
+		slot = index_find_slot(data, new_ptr->hash, old_ptr);
+		if (slot != (size_t)-1)
+			data->index[slot] = new_ptr;
+	}
 }
 
 static struct obs_data_item *
@@ -706,8 +882,14 @@ static inline void obs_data_destroy(struct obs_data *data)
 {
 	struct obs_data_item *item = data->first_item;
 
+	bfree(data->index);
+
+	/* items that are still referenced elsewhere outlive their parent */
 	while (item) {
 		struct obs_data_item *next = item->next;
+		item->next = NULL;
+		item->prev_next = NULL;
+		item->parent = NULL;
 		obs_data_item_release(&item);
 		item = next;
 	}
@@ -767,10 +949,485 @@ bool obs_data_save_json_safe(obs_data_t *data, const char *file,
 	return false;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Binary format
+ *
+ *   A compact alternative to JSON for large files that are read often, such
+ * as scene collections, made to be read with a single read of the file and
+ * no parsing.  Names and string values are stored once in a string table at
+ * the end of the file and referenced by index:
+ *
+ *     [header]
+ *     [object   root]
+ *     [uint32_t string_offsets[num_strings + 1]]
+ *     [char[]   strings, each null terminated]
+ *
+ *   An object is a uint32_t item count followed by the items, each a uint32_t
+ * name index, a uint8_t type and the value: a string index, an int64_t, a
+ * double, a uint8_t bool, an object, or an array (a uint32_t count followed
+ * by that many objects).  Items are stored in the order obs_data keeps them,
+ * so reading them back only has to append.  Numbers are stored in the byte
+ * order of the machine that wrote the file; files from a machine with a
+ * different byte order fail the magic check.
+ *
+ *   Only user values are stored, same as in JSON.
+ */
+
+#define BIN_MAGIC 0x4453424FU /* "OBSD" in little endian */
+#define BIN_VERSION 1
+
+enum bin_type {
+	BIN_STRING = 1,
+	BIN_INT,
+	BIN_DOUBLE,
+	BIN_BOOL,
+	BIN_OBJECT,
+	BIN_ARRAY,
+};
+
+struct bin_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t file_size;
+	uint64_t strings_offset;
+	uint32_t num_strings;
+	uint32_t reserved;
+};
+
+struct bin_string {
+	const char *str;
+	size_t len;
+	uint32_t idx;
+};
+
+struct bin_writer {
+	struct darray buf; /* uint8_t */
+	DARRAY(struct bin_string) strings;
+
+	/* open addressing table of indices + 1 into strings */
+	uint32_t *table;
+	size_t table_size;
+};
+
+static inline void bin_write(struct bin_writer *w, const void *data,
+			     size_t size)
+{
+	darray_push_back_array(1, &w->buf, data, size);
+}
+
+static void bin_grow_table(struct bin_writer *w)
+{
+	size_t size = w->table_size ? w->table_size * 2 : 1024;
+
+	bfree(w->table);
+	w->table = bzalloc(size * sizeof(uint32_t));
+	w->table_size = size;
+
+	for (size_t i = 0; i < w->strings.num; i++) {
+		struct bin_string *bs = w->strings.array + i;
+		size_t slot = name_hash(bs->str, bs->len) & (size - 1);
+
+		while (w->table[slot])
+			slot = (slot + 1) & (size - 1);
+		w->table[slot] = (uint32_t)i + 1;
+	}
+}
+
+/* the strings belong to the data being written, which outlives the writer */
+static uint32_t bin_string_idx(struct bin_writer *w, const char *str)
+{
+	size_t len = strlen(str);
+	size_t slot;
+	struct bin_string *bs;
+
+	if ((w->strings.num + 1) * 2 > w->table_size)
+		bin_grow_table(w);
+
+	slot = name_hash(str, len) & (w->table_size - 1);
+	while (w->table[slot]) {
+		bs = w->strings.array + w->table[slot] - 1;
+		if (bs->len == len && memcmp(bs->str, str, len) == 0)
+			return bs->idx;
+		slot = (slot + 1) & (w->table_size - 1);
+	}
+
+	bs = da_push_back_new(w->strings);
+	bs->str = str;
+	bs->len = len;
+	bs->idx = (uint32_t)(w->strings.num - 1);
+	w->table[slot] = bs->idx + 1;
+	return bs->idx;
+}
+
+static inline void bin_write_u32(struct bin_writer *w, uint32_t val)
+{
+	bin_write(w, &val, sizeof(val));
+}
+
+static inline void bin_write_item_header(struct bin_writer *w,
+					 const char *name, uint8_t type)
+{
+	bin_write_u32(w, bin_string_idx(w, name));
+	bin_write(w, &type, sizeof(type));
+}
+
+static void bin_write_obj(struct bin_writer *w, obs_data_t *data)
+{
+	size_t count_pos = w->buf.num;
+	uint32_t count = 0;
+
+	bin_write_u32(w, 0);
+
+	for (struct obs_data_item *item = data ? data->first_item : NULL; item;
+	     item = item->next) {
+		const char *name = get_item_name(item);
+
+		if (!obs_data_item_has_user_value(item))
+			continue;
+
+		if (item->type == OBS_DATA_STRING) {
+			const char *str = get_item_data(item);
+			bin_write_item_header(w, name, BIN_STRING);
+			bin_write_u32(w, bin_string_idx(w, str));
+
+		} else if (item->type == OBS_DATA_NUMBER) {
+			struct obs_data_number *num = get_item_data(item);
+
+			if (num->type == OBS_DATA_NUM_INT) {
+				int64_t val = num->int_val;
+				bin_write_item_header(w, name, BIN_INT);
+				bin_write(w, &val, sizeof(val));
+			} else {
+				double val = num->double_val;
+				bin_write_item_header(w, name, BIN_DOUBLE);
+				bin_write(w, &val, sizeof(val));
+			}
+
+		} else if (item->type == OBS_DATA_BOOLEAN) {
+			uint8_t val = *(bool *)get_item_data(item);
+			bin_write_item_header(w, name, BIN_BOOL);
+			bin_write(w, &val, sizeof(val));
+
+		} else if (item->type == OBS_DATA_OBJECT) {
+			bin_write_item_header(w, name, BIN_OBJECT);
+			bin_write_obj(w, get_item_obj(item));
+
+		} else if (item->type == OBS_DATA_ARRAY) {
+			obs_data_array_t *array = get_item_array(item);
+			size_t num = array ? array->objects.num : 0;
+
+			bin_write_item_header(w, name, BIN_ARRAY);
+			bin_write_u32(w, (uint32_t)num);
+			for (size_t i = 0; i < num; i++)
+				bin_write_obj(w, array->objects.array[i]);
+
+		} else {
+			continue;
+		}
+
+		count++;
+	}
+
+	memcpy((uint8_t *)w->buf.array + count_pos, &count, sizeof(count));
+}
+
+static void bin_write_strings(struct bin_writer *w)
+{
+	uint32_t offset = 0;
+
+	for (size_t i = 0; i < w->strings.num; i++) {
+		bin_write_u32(w, offset);
+		offset += (uint32_t)w->strings.array[i].len + 1;
+	}
+	bin_write_u32(w, offset);
+
+	for (size_t i = 0; i < w->strings.num; i++)
+		bin_write(w, w->strings.array[i].str,
+			  w->strings.array[i].len + 1);
+}
+
+bool obs_data_save_binary_file(obs_data_t *data, const char *file)
+{
+	struct bin_writer w = {0};
+	struct bin_header header = {0};
+	struct dstr temp = {0};
+	bool success = false;
+	FILE *f;
+
+	if (!data || !file)
+		return false;
+
+	bin_write(&w, &header, sizeof(header));
+	bin_write_obj(&w, data);
+
+	header.magic = BIN_MAGIC;
+	header.version = BIN_VERSION;
+	header.strings_offset = w.buf.num;
+	header.num_strings = (uint32_t)w.strings.num;
+
+	bin_write_strings(&w);
+
+	header.file_size = w.buf.num;
+	memcpy(w.buf.array, &header, sizeof(header));
+
+	/* written next to the file first so that a crash never leaves a
+	 * truncated file behind */
+	dstr_printf(&temp, "%s.tmp", file);
+	f = os_fopen(temp.array, "wb");
+	if (f) {
+		success = fwrite(w.buf.array, 1, w.buf.num, f) == w.buf.num;
+		success = fclose(f) == 0 && success;
+	}
+
+	if (success && os_safe_replace(file, temp.array, NULL) != 0)
+		success = false;
+	if (!success)
+		blog(LOG_ERROR, "obs-data.c: [obs_data_save_binary_file] "
+				"Failed to write '%s'",
+		     file);
+
+	dstr_free(&temp);
+	da_free(w.strings);
+	darray_free(&w.buf);
+	bfree(w.table);
+	return success;
+}
+
+struct bin_reader {
+	const uint8_t *pos;
+	const uint8_t *end;
+	const char *strings;
+	const uint32_t *offsets;
+	uint32_t num_strings;
+	int depth;
+};
+
+static inline bool bin_read(struct bin_reader *r, void *out, size_t size)
+{
+	if ((size_t)(r->end - r->pos) < size)
+		return false;
+
+	memcpy(out, r->pos, size);
+	r->pos += size;
+	return true;
+}
+
+static inline const char *bin_read_string(struct bin_reader *r)
+{
+	uint32_t idx, offset;
+
+	if (!bin_read(r, &idx, sizeof(idx)) || idx >= r->num_strings)
+		return NULL;
+
+	memcpy(&offset, r->offsets + idx, sizeof(offset));
+	return r->strings + offset;
+}
+
+static inline void set_item(struct obs_data *data, obs_data_item_t **item,
+			    const char *name, const void *ptr, size_t size,
+			    enum obs_data_type type);
+
+/* items come in the order obs_data keeps them in, so they are appended
+ * directly unless the file says otherwise */
+static void bin_add_item(obs_data_t *data, const char *name, const void *ptr,
+			 size_t size, enum obs_data_type type)
+{
+	struct obs_data_item *item;
+
+	if (data->last_item &&
+	    strcmp(get_item_name(data->last_item), name) >= 0) {
+		set_item(data, NULL, name, ptr, size, type);
+		return;
+	}
+
+	item = obs_data_item_create(name, ptr, size, type, false, false);
+	link_item(data, data->last_item ? &data->last_item->next
+					: &data->first_item,
+		  item);
+}
+
+#define MAX_BIN_DEPTH 64
+
+static bool bin_read_obj(struct bin_reader *r, obs_data_t *data)
+{
+	uint32_t count;
+	bool success = true;
+
+	if (++r->depth > MAX_BIN_DEPTH || !bin_read(r, &count, sizeof(count)))
+		return false;
+
+	for (uint32_t i = 0; success && i < count; i++) {
+		const char *name = bin_read_string(r);
+		struct obs_data_number num;
+		uint8_t type;
+
+		if (!name || !*name || !bin_read(r, &type, sizeof(type)))
+			return false;
+
+		if (type == BIN_STRING) {
+			const char *str = bin_read_string(r);
+			if (!str)
+				return false;
+			bin_add_item(data, name, str, strlen(str) + 1,
+				     OBS_DATA_STRING);
+
+		} else if (type == BIN_INT || type == BIN_DOUBLE) {
+			int64_t int_val;
+			double double_val;
+
+			if (type == BIN_INT) {
+				if (!bin_read(r, &int_val, sizeof(int_val)))
+					return false;
+				num.type = OBS_DATA_NUM_INT;
+				num.int_val = int_val;
+			} else {
+				if (!bin_read(r, &double_val,
+					      sizeof(double_val)))
+					return false;
+				num.type = OBS_DATA_NUM_DOUBLE;
+				num.double_val = double_val;
+			}
+
+			bin_add_item(data, name, &num, sizeof(num),
+				     OBS_DATA_NUMBER);
+
+		} else if (type == BIN_BOOL) {
+			uint8_t val;
+			bool b;
+
+			if (!bin_read(r, &val, sizeof(val)))
+				return false;
+
+			b = val != 0;
+			bin_add_item(data, name, &b, sizeof(b),
+				     OBS_DATA_BOOLEAN);
+
+		} else if (type == BIN_OBJECT) {
+			obs_data_t *obj = obs_data_create();
+
+			success = bin_read_obj(r, obj);
+			bin_add_item(data, name, &obj, sizeof(obj),
+				     OBS_DATA_OBJECT);
+			obs_data_release(obj);
+
+		} else if (type == BIN_ARRAY) {
+			obs_data_array_t *array = obs_data_array_create();
+			uint32_t num_objs;
+
+			success = bin_read(r, &num_objs, sizeof(num_objs));
+
+			for (uint32_t j = 0; success && j < num_objs; j++) {
+				obs_data_t *obj = obs_data_create();
+				success = bin_read_obj(r, obj);
+				da_push_back(array->objects, &obj);
+			}
+
+			bin_add_item(data, name, &array, sizeof(array),
+				     OBS_DATA_ARRAY);
+			obs_data_array_release(array);
+
+		} else {
+			return false;
+		}
+	}
+
+	r->depth--;
+	return success;
+}
+
+static obs_data_t *bin_parse(const uint8_t *buf, size_t size)
+{
+	struct bin_header header;
+	struct bin_reader r = {0};
+	const uint8_t *strings;
+	size_t table_size, strings_size;
+	uint32_t last_offset;
+	obs_data_t *data;
+
+	if (size < sizeof(header))
+		return NULL;
+
+	memcpy(&header, buf, sizeof(header));
+	if (header.magic != BIN_MAGIC || header.version != BIN_VERSION ||
+	    header.file_size != size || header.strings_offset > size ||
+	    header.strings_offset < sizeof(header))
+		return NULL;
+
+	/* the offset table, followed by the strings it points into, which
+	 * all have to be terminated */
+	table_size = ((size_t)header.num_strings + 1) * sizeof(uint32_t);
+	if (size - header.strings_offset < table_size)
+		return NULL;
+
+	strings = buf + header.strings_offset + table_size;
+	strings_size = size - header.strings_offset - table_size;
+
+	r.offsets = (const uint32_t *)(buf + header.strings_offset);
+	memcpy(&last_offset, r.offsets + header.num_strings,
+	       sizeof(last_offset));
+	if (last_offset != strings_size ||
+	    (strings_size && strings[strings_size - 1] != 0))
+		return NULL;
+
+	for (uint32_t i = 0; i < header.num_strings; i++) {
+		uint32_t offset;
+		memcpy(&offset, r.offsets + i, sizeof(offset));
+		if (offset >= strings_size)
+			return NULL;
+	}
+
+	r.pos = buf + sizeof(header);
+	r.end = buf + header.strings_offset;
+	r.strings = (const char *)strings;
+	r.num_strings = header.num_strings;
+
+	data = obs_data_create();
+	if (!bin_read_obj(&r, data)) {
+		obs_data_release(data);
+		return NULL;
+	}
+
+	return data;
+}
+
+obs_data_t *obs_data_create_from_binary_file(const char *file)
+{
+	obs_data_t *data = NULL;
+	uint8_t *buf = NULL;
+	int64_t size;
+	FILE *f;
+
+	if (!file)
+		return NULL;
+
+	f = os_fopen(file, "rb");
+	if (!f)
+		return NULL;
+
+	size = os_fgetsize(f);
+	if (size > 0 && (uint64_t)size <= SIZE_MAX) {
+		buf = bmalloc((size_t)size);
+		if (fread(buf, 1, (size_t)size, f) == (size_t)size)
+			data = bin_parse(buf, (size_t)size);
+	}
+
+	fclose(f);
+	bfree(buf);
+
+	if (!data)
+		blog(LOG_WARNING,
+		     "obs-data.c: [obs_data_create_from_binary_file] "
+		     "'%s' is not a valid binary data file",
+		     file);
+	return data;
+}
+
 static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 {
 	if (!data)
 		return NULL;
+	if (data->index)
+		return index_get(data, name);
 
 	struct obs_data_item *item = data->first_item;
 
@@ -794,31 +1451,7 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item,
 	if ((!item || (item && !*item)) && data) {
 		new_item = obs_data_item_create(name, ptr, size, type,
 						default_data, autoselect_data);
-
-		obs_data_item_t *prev = obs_data_first(data);
-		obs_data_item_t *next = obs_data_first(data);
-		obs_data_item_next(&next);
-		for (; prev && next;
-		     obs_data_item_next(&prev), obs_data_item_next(&next)) {
-			if (strcmp(get_item_name(next), name) > 0)
-				break;
-		}
-
-		new_item->parent = data;
-		if (prev && strcmp(get_item_name(prev), name) < 0) {
-			prev->next = new_item;
-			new_item->next = next;
-
-		} else {
-			data->first_item = new_item;
-			new_item->next = prev;
-		}
-
-		if (!prev)
-			data->first_item = new_item;
-
-		obs_data_item_release(&prev);
-		obs_data_item_release(&next);
+		insert_item(data, new_item);
 
 	} else if (default_data) {
 		obs_data_item_set_default_data(item, ptr, size, type);
@@ -1011,6 +1644,50 @@ void obs_data_clear(obs_data_t *target)
 	}
 }
 
+static void move_item(struct obs_data *data, struct obs_data_item *item)
+{
+	const char *name = get_item_name(item);
+	void *ptr = get_item_data(item);
+	struct obs_data_item *existing;
+
+	if (!item->data_size)
+		return;
+
+	/* like copy_item, empty objects and arrays aren't applied */
+	if ((item->type == OBS_DATA_OBJECT || item->type == OBS_DATA_ARRAY) &&
+	    !*(void **)ptr)
+		return;
+
+	existing = get_item(data, name);
+
+	/* an item with nothing but a user value that no one else holds on to
+	 * can change parents as it is */
+	if (!existing && !item->default_size && !item->autoselect_size &&
+	    os_atomic_load_long(&item->ref) == 1) {
+		obs_data_item_detach(item);
+		insert_item(data, item);
+		return;
+	}
+
+	/* objects and arrays are shared before the source lets go of them */
+	set_item(data, existing ? &existing : NULL, name, ptr, item->data_size,
+		 item->type);
+	clear_item(item);
+}
+
+void obs_data_apply_move(obs_data_t *target, obs_data_t *apply_data)
+{
+	struct obs_data_item *item, *next;
+
+	if (!target || !apply_data || target == apply_data)
+		return;
+
+	for (item = apply_data->first_item; item; item = next) {
+		next = item->next;
+		move_item(target, item);
+	}
+}
+
 typedef void (*set_item_t)(obs_data_t *, obs_data_item_t **, const char *,
 			   const void *, size_t, enum obs_data_type);
 
@@ -75,8 +75,18 @@ EXPORT bool obs_data_save_json_safe(obs_data_t *data, const char *file,
 				    const char *temp_ext,
 				    const char *backup_ext);
 
+EXPORT obs_data_t *obs_data_create_from_binary_file(const char *file);
+EXPORT bool obs_data_save_binary_file(obs_data_t *data, const char *file);
+
 EXPORT void obs_data_apply(obs_data_t *target, obs_data_t *apply_data);
 
+/**
+ * Same as obs_data_apply, but moves the values instead of copying them:
+ * objects and arrays are handed over rather than copied deeply, and
+ * apply_data is left without user values.
+ */
+EXPORT void obs_data_apply_move(obs_data_t *target, obs_data_t *apply_data);
+
 EXPORT void obs_data_erase(obs_data_t *data, const char *name);
 EXPORT void obs_data_clear(obs_data_t *data);
 
@@ -70,6 +70,7 @@ obs_display_t *obs_display_create(const struct gs_init_data *graphics_data,
 		if (display->next)
 			display->next->prev_next = &display->next;
 		pthread_mutex_unlock(&obs->data.displays_mutex);
+		obs_video_wake();
 	}
 
 	gs_leave_context();
@@ -183,12 +184,48 @@ static inline void render_display_end()
 	gs_end_scene();
 }
 
+/* whether a display with a frame rate limit is due for its next frame */
+static bool frame_due(struct obs_display *display)
+{
+	const uint64_t frame_interval = obs->video.video_frame_interval_ns;
+	const uint64_t now = obs->video.video_time;
+	uint32_t max_fps = display->max_fps;
+	uint64_t interval;
+
+	if (!max_fps)
+		return true;
+
+	interval = 1000000000ULL / max_fps;
+	if (interval <= frame_interval)
+		return true;
+
+	/* half a frame of slack keeps the rate steady despite rounding */
+	if (display->next_render_time > now + frame_interval / 2)
+		return false;
+
+	/* restarts the schedule after a pause instead of catching up */
+	if (display->next_render_time + interval > now)
+		display->next_render_time += interval;
+	else
+		display->next_render_time = now + interval;
+	return true;
+}
+
 void render_display(struct obs_display *display)
 {
 	uint32_t cx, cy;
 	bool size_changed;
 
-	if (!display || !display->enabled)
+	if (!display || !display->enabled || display->occluded)
+		return;
+
+	/* a resize is shown right away, whatever the frame rate limit */
+	if (!frame_due(display) && !display->size_changed)
+		return;
+
+	/* a display the compositor is not ready for is skipped this frame
+	 * instead of stalling the graphics thread in its present */
+	if (!gs_swapchain_ready(display->swap))
 		return;
 
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_DISPLAY, "obs_display");
@@ -230,8 +267,12 @@ void render_display(struct obs_display *display)
 
 void obs_display_set_enabled(obs_display_t *display, bool enable)
 {
-	if (display)
-		display->enabled = enable;
+	if (!display)
+		return;
+
+	display->enabled = enable;
+	if (enable)
+		obs_video_wake();
 }
 
 bool obs_display_enabled(obs_display_t *display)
@@ -239,6 +280,32 @@ bool obs_display_enabled(obs_display_t *display)
 	return display ? display->enabled : false;
 }
 
+void obs_display_set_occluded(obs_display_t *display, bool occluded)
+{
+	if (!display)
+		return;
+
+	display->occluded = occluded;
+	if (!occluded)
+		obs_video_wake();
+}
+
+bool obs_display_occluded(obs_display_t *display)
+{
+	return display ? display->occluded : false;
+}
+
+void obs_display_set_max_fps(obs_display_t *display, uint32_t max_fps)
+{
+	if (display)
+		display->max_fps = max_fps;
+}
+
+uint32_t obs_display_get_max_fps(obs_display_t *display)
+{
+	return display ? display->max_fps : 0;
+}
+
 void obs_display_set_background_color(obs_display_t *display, uint32_t color)
 {
 	if (display)
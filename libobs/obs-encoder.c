@@ -23,7 +23,7 @@
 #define set_encoder_active(encoder, val) \
 	os_atomic_set_bool(&encoder->active, val)
 
-struct obs_encoder_info *find_encoder(const char *id)
+static struct obs_encoder_info *find_loaded_encoder(const char *id)
 {
 	for (size_t i = 0; i < obs->encoder_types.num; i++) {
 		struct obs_encoder_info *info = obs->encoder_types.array + i;
@@ -35,6 +35,15 @@ struct obs_encoder_info *find_encoder(const char *id)
 	return NULL;
 }
 
+struct obs_encoder_info *find_encoder(const char *id)
+{
+	struct obs_encoder_info *info = find_loaded_encoder(id);
+
+	if (!info && obs_load_module_for_type(id))
+		info = find_loaded_encoder(id);
+	return info;
+}
+
 const char *obs_encoder_get_display_name(const char *id)
 {
 	struct obs_encoder_info *ei = find_encoder(id);
@@ -50,6 +59,8 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 	pthread_mutex_init_value(&encoder->callbacks_mutex);
 	pthread_mutex_init_value(&encoder->outputs_mutex);
 	pthread_mutex_init_value(&encoder->pause.mutex);
+	pthread_mutex_init_value(&encoder->avc_cache_mutex);
+	pthread_mutex_init_value(&encoder->audio_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -66,6 +77,12 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 		return false;
 	if (pthread_mutex_init(&encoder->pause.mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&encoder->avc_cache_mutex, NULL) != 0)
+		return false;
+	if (pthread_mutex_init(&encoder->audio_mutex, NULL) != 0)
+		return false;
+	if (os_event_init(&encoder->audio_event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
 
 	if (encoder->orig_info.get_defaults) {
 		encoder->orig_info.get_defaults(encoder->context.settings);
@@ -115,7 +132,8 @@ create_encoder(const char *id, enum obs_encoder_type type, const char *name,
 	encoder->control->encoder = encoder;
 
 	obs_context_data_insert(&encoder->context, &obs->data.encoders_mutex,
-				&obs->data.first_encoder);
+				&obs->data.first_encoder,
+				&obs->data.encoder_index);
 
 	blog(LOG_DEBUG, "encoder '%s' (%s) created", name, id);
 	return encoder;
@@ -143,6 +161,9 @@ obs_encoder_t *obs_audio_encoder_create(const char *id, const char *name,
 
 static void receive_video(void *param, struct video_data *frame);
 static void receive_audio(void *param, size_t mix_idx, struct audio_data *data);
+static void start_audio_thread(struct obs_encoder *encoder);
+static void stop_audio_thread(struct obs_encoder *encoder);
+static void join_audio_thread(struct obs_encoder *encoder);
 
 static inline void get_audio_info(const struct obs_encoder *encoder,
 				  struct audio_convert_info *info)
@@ -176,8 +197,11 @@ static inline void get_video_info(struct obs_encoder *encoder,
 	if (encoder->info.get_video_info)
 		encoder->info.get_video_info(encoder->context.data, info);
 
-	if (info->width != voi->width || info->height != voi->height)
-		obs_encoder_set_scaled_size(encoder, info->width, info->height);
+	/* set directly, this also runs while rescaling an active encoder */
+	if (info->width != voi->width || info->height != voi->height) {
+		encoder->scaled_width = info->width;
+		encoder->scaled_height = info->height;
+	}
 }
 
 static inline bool has_scaling(const struct obs_encoder *encoder)
@@ -190,10 +214,82 @@ static inline bool has_scaling(const struct obs_encoder *encoder)
 		video_height != encoder->scaled_height);
 }
 
+static bool video_tex_active(const struct obs_core_video_mix *video,
+			     enum video_format format)
+{
+#ifdef _WIN32
+	/* only NV12 has shared textures on windows */
+	return format == VIDEO_FORMAT_NV12 && video->using_nv12_tex;
+#else
+	if (format != VIDEO_FORMAT_NV12 && format != VIDEO_FORMAT_P010)
+		return false;
+
+	/* there are no shared NV12 textures outside of windows, the Y and
+	 * UV planes of the GPU conversion are handed over as separate
+	 * textures instead */
+	return video->gpu_conversion && video->ovi.output_format == format;
+#endif
+}
+
 static inline bool gpu_encode_available(const struct obs_encoder *encoder)
 {
-	return (encoder->info.caps & OBS_ENCODER_CAP_PASS_TEXTURE) != 0 &&
-	       obs->video.using_nv12_tex;
+	struct obs_core_video_mix *video = get_mix_for_video(encoder->media);
+	if (!video)
+		return false;
+	if ((encoder->info.caps & OBS_ENCODER_CAP_PASS_TEXTURE) == 0)
+		return false;
+
+#ifndef _WIN32
+	/* only encode_texture2 can receive textures without shared handles,
+	 * and there is no GPU-side scaling for texture encoders */
+	if (!encoder->info.encode_texture2 || has_scaling(encoder))
+		return false;
+#endif
+
+	return video_tex_active(video, video->ovi.output_format);
+}
+
+bool obs_encoder_video_tex_active(const obs_encoder_t *encoder,
+				  enum video_format format)
+{
+	struct obs_core_video_mix *video;
+
+	if (!obs_encoder_valid(encoder, "obs_encoder_video_tex_active"))
+		return false;
+	if (encoder->info.type != OBS_ENCODER_VIDEO)
+		return false;
+
+	video = get_mix_for_video(encoder->media ? encoder->media
+						 : obs_get_video());
+	if (!video)
+		return false;
+
+	return video_tex_active(video, format);
+}
+
+static void connect_raw_video(struct obs_encoder *encoder,
+			      const struct video_scale_info *info)
+{
+	video_t *video = encoder->media;
+
+	if (has_scaling(encoder))
+		encoder->scaled_video =
+			obs_get_scaled_video(video, info->width, info->height);
+	if (encoder->scaled_video)
+		video = encoder->scaled_video;
+
+	start_raw_video(video, info, receive_video, encoder);
+}
+
+static void disconnect_raw_video(struct obs_encoder *encoder)
+{
+	if (encoder->scaled_video) {
+		stop_raw_video(encoder->scaled_video, receive_video, encoder);
+		obs_release_scaled_video(encoder->scaled_video);
+		encoder->scaled_video = NULL;
+	} else {
+		stop_raw_video(encoder->media, receive_video, encoder);
+	}
 }
 
 static void add_connection(struct obs_encoder *encoder)
@@ -202,18 +298,17 @@ static void add_connection(struct obs_encoder *encoder)
 		struct audio_convert_info audio_info = {0};
 		get_audio_info(encoder, &audio_info);
 
+		start_audio_thread(encoder);
 		audio_output_connect(encoder->media, encoder->mixer_idx,
 				     &audio_info, receive_audio, encoder);
 	} else {
 		struct video_scale_info info = {0};
 		get_video_info(encoder, &info);
 
-		if (gpu_encode_available(encoder)) {
+		if (gpu_encode_available(encoder))
 			start_gpu_encode(encoder);
-		} else {
-			start_raw_video(encoder->media, &info, receive_video,
-					encoder);
-		}
+		else
+			connect_raw_video(encoder, &info);
 	}
 
 	set_encoder_active(encoder, true);
@@ -224,12 +319,12 @@ static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
 		audio_output_disconnect(encoder->media, encoder->mixer_idx,
 					receive_audio, encoder);
+		stop_audio_thread(encoder);
 	} else {
-		if (gpu_encode_available(encoder)) {
+		if (gpu_encode_available(encoder))
 			stop_gpu_encode(encoder);
-		} else {
-			stop_raw_video(encoder->media, receive_video, encoder);
-		}
+		else
+			disconnect_raw_video(encoder);
 	}
 
 	/* obs_encoder_shutdown locks init_mutex, so don't call it on encode
@@ -265,11 +360,19 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		blog(LOG_DEBUG, "encoder '%s' destroyed",
 		     encoder->context.name);
 
+		join_audio_thread(encoder);
 		free_audio_buffers(encoder);
 
 		if (encoder->context.data)
 			encoder->info.destroy(encoder->context.data);
 		da_free(encoder->callbacks);
+		da_free(encoder->last_headers);
+		if (encoder->avc_cache_src)
+			obs_packet_pool_release(encoder->avc_cache_src);
+		obs_encoder_packet_release(&encoder->avc_cache);
+		pthread_mutex_destroy(&encoder->avc_cache_mutex);
+		pthread_mutex_destroy(&encoder->audio_mutex);
+		os_event_destroy(encoder->audio_event);
 		pthread_mutex_destroy(&encoder->init_mutex);
 		pthread_mutex_destroy(&encoder->callbacks_mutex);
 		pthread_mutex_destroy(&encoder->outputs_mutex);
@@ -460,11 +563,15 @@ static inline bool obs_encoder_initialize_internal(obs_encoder_t *encoder)
 	obs_encoder_shutdown(encoder);
 
 	if (encoder->orig_info.create) {
+		bmem_account_t *prev_account =
+			bmem_set_thread_account(encoder->context.mem_account);
+
 		can_reroute = true;
 		encoder->info = encoder->orig_info;
 		encoder->context.data = encoder->orig_info.create(
 			encoder->context.settings, encoder);
 		can_reroute = false;
+		bmem_set_thread_account(prev_account);
 	}
 	if (!encoder->context.data)
 		return false;
@@ -576,10 +683,16 @@ static inline void obs_encoder_start_internal(
 
 	if (first) {
 		os_atomic_set_bool(&encoder->paused, false);
+		os_atomic_set_bool(&encoder->keyframe_requested, false);
+		da_resize(encoder->last_headers, 0);
 		pause_reset(&encoder->pause);
 
 		encoder->cur_pts = 0;
 		add_connection(encoder);
+
+	} else if (idx == DARRAY_INVALID) {
+		/* outputs discard packets until the first keyframe */
+		obs_encoder_request_keyframe(encoder);
 	}
 }
 
@@ -668,12 +781,44 @@ enum obs_encoder_type obs_encoder_get_type(const obs_encoder_t *encoder)
 		       : OBS_ENCODER_AUDIO;
 }
 
+uint64_t obs_encoder_get_memory_usage(const obs_encoder_t *encoder)
+{
+	return obs_encoder_valid(encoder, "obs_encoder_get_memory_usage")
+		       ? obs_context_data_memory_usage(&encoder->context)
+		       : 0;
+}
+
 enum obs_encoder_type obs_get_encoder_type(const char *id)
 {
 	struct obs_encoder_info *info = find_encoder(id);
 	return info ? info->type : OBS_ENCODER_AUDIO;
 }
 
+/* frames stop arriving while the encoder reconfigures itself for the new
+ * size in its update callback, so it is free to reopen there */
+static void rescale_active(struct obs_encoder *encoder, uint32_t width,
+			   uint32_t height)
+{
+	struct video_scale_info info = {0};
+
+	disconnect_raw_video(encoder);
+
+	encoder->scaled_width = width;
+	encoder->scaled_height = height;
+
+	if (encoder->info.update &&
+	    !encoder->info.update(encoder->context.data,
+				  encoder->context.settings))
+		blog(LOG_WARNING, "encoder '%s': Failed to change resolution",
+		     encoder->context.name);
+
+	get_video_info(encoder, &info);
+	connect_raw_video(encoder, &info);
+
+	blog(LOG_INFO, "encoder '%s': resolution changed to %ux%u",
+	     encoder->context.name, info.width, info.height);
+}
+
 void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 				 uint32_t height)
 {
@@ -687,10 +832,21 @@ void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 		return;
 	}
 	if (encoder_active(encoder)) {
-		blog(LOG_WARNING,
-		     "encoder '%s': Cannot set the scaled "
-		     "resolution while the encoder is active",
-		     obs_encoder_get_name(encoder));
+		bool dyn = (encoder->info.caps &
+			    OBS_ENCODER_CAP_DYN_RESOLUTION) != 0;
+
+		if (!dyn || gpu_encode_available(encoder)) {
+			blog(LOG_WARNING,
+			     "encoder '%s': Cannot set the scaled "
+			     "resolution while the encoder is active",
+			     obs_encoder_get_name(encoder));
+			return;
+		}
+
+		pthread_mutex_lock(&encoder->init_mutex);
+		if (encoder_active(encoder))
+			rescale_active(encoder, width, height);
+		pthread_mutex_unlock(&encoder->init_mutex);
 		return;
 	}
 
@@ -856,7 +1012,6 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 				    struct encoder_packet *packet)
 {
 	struct encoder_packet first_packet;
-	DARRAY(uint8_t) data;
 	uint8_t *sei;
 	size_t size;
 
@@ -864,25 +1019,22 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 	if (!packet->keyframe)
 		return;
 
-	da_init(data);
-
 	if (!get_sei(encoder, &sei, &size) || !sei || !size) {
 		cb->new_packet(cb->param, packet);
 		cb->sent_first_packet = true;
 		return;
 	}
 
-	da_push_back_array(data, sei, size);
-	da_push_back_array(data, packet->data, packet->size);
-
 	first_packet = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
+	first_packet.data = obs_packet_pool_alloc(size + packet->size);
+	first_packet.size = size + packet->size;
+	memcpy(first_packet.data, sei, size);
+	memcpy(first_packet.data + size, packet->data, packet->size);
 
 	cb->new_packet(cb->param, &first_packet);
 	cb->sent_first_packet = true;
 
-	da_free(data);
+	obs_encoder_packet_release(&first_packet);
 }
 
 static inline void send_packet(struct obs_encoder *encoder,
@@ -919,6 +1071,29 @@ void full_stop(struct obs_encoder *encoder)
 	}
 }
 
+static void check_headers(struct obs_encoder *encoder,
+			  struct encoder_packet *pkt)
+{
+	uint8_t *headers;
+	size_t size;
+
+	if (!encoder->info.get_extra_data ||
+	    !encoder->info.get_extra_data(encoder->context.data, &headers,
+					  &size))
+		return;
+	if (size == encoder->last_headers.num &&
+	    memcmp(headers, encoder->last_headers.array, size) == 0)
+		return;
+
+	/* the first headers are the ones outputs start with */
+	pkt->headers_changed = encoder->last_headers.num != 0;
+	da_copy_array(encoder->last_headers, headers, size);
+
+	if (pkt->headers_changed)
+		blog(LOG_DEBUG, "encoder '%s': headers changed",
+		     encoder->context.name);
+}
+
 void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 			     bool received, struct encoder_packet *pkt)
 {
@@ -930,6 +1105,9 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 	}
 
 	if (received) {
+		if (pkt->type == OBS_ENCODER_VIDEO && pkt->keyframe)
+			check_headers(encoder, pkt);
+
 		if (!encoder->first_received) {
 			encoder->offset_usec = packet_dts_usec(pkt);
 			encoder->first_received = true;
@@ -945,15 +1123,30 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success,
 		pkt->sys_dts_usec += encoder->pause.ts_offset / 1000;
 		pthread_mutex_unlock(&encoder->pause.mutex);
 
+		/* sys_dts_usec is on the os_gettime_ns clock the frame was
+		 * captured on, so this is the full capture to packet time */
+		int64_t latency_usec =
+			(int64_t)(os_gettime_ns() / 1000) - pkt->sys_dts_usec;
+		if (latency_usec > 0)
+			obs_histogram_observe(&encoder->latency_hist,
+					      (uint64_t)latency_usec * 1000);
+
+		/* copy the encoder's data once; every callback then shares
+		 * this instance and takes its own reference if it keeps it */
+		struct encoder_packet shared;
+		obs_encoder_packet_create_instance(&shared, pkt);
+
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
 		for (size_t i = encoder->callbacks.num; i > 0; i--) {
 			struct encoder_callback *cb;
 			cb = encoder->callbacks.array + (i - 1);
-			send_packet(encoder, cb, pkt);
+			send_packet(encoder, cb, &shared);
 		}
 
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+		obs_encoder_packet_release(&shared);
 	}
 }
 
@@ -967,6 +1160,8 @@ bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame)
 					   "encode(%s)", encoder->context.name);
 
 	struct encoder_packet pkt = {0};
+	bmem_account_t *prev_account;
+	int prev_tag;
 	bool received = false;
 	bool success;
 
@@ -974,11 +1169,20 @@ bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame)
 	pkt.timebase_den = encoder->timebase_den;
 	pkt.encoder = encoder;
 
+	/* packets copied for the outputs are charged to the encoder */
+	prev_account = bmem_set_thread_account(encoder->context.mem_account);
+	prev_tag = bmem_set_thread_tag(obs->encoder_mem_tag);
+
+	uint64_t encode_start = os_gettime_ns();
 	profile_start(encoder->profile_encoder_encode_name);
 	success = encoder->info.encode(encoder->context.data, frame, &pkt,
 				       &received);
 	profile_end(encoder->profile_encoder_encode_name);
+	obs_histogram_observe(&encoder->encode_hist,
+			      os_gettime_ns() - encode_start);
 	send_off_encoder_packet(encoder, success, received, &pkt);
+	bmem_set_thread_tag(prev_tag);
+	bmem_set_thread_account(prev_account);
 
 	profile_end(do_encode_name);
 
@@ -1156,6 +1360,24 @@ fail:
 	return success;
 }
 
+/* takes the next whole frame out of the input buffer */
+static bool pop_audio_frame(struct obs_encoder *encoder)
+{
+	bool popped = false;
+
+	pthread_mutex_lock(&encoder->audio_mutex);
+	if (encoder->audio_input_buffer[0].size >= encoder->framesize_bytes) {
+		for (size_t i = 0; i < encoder->planes; i++)
+			circlebuf_pop_front(&encoder->audio_input_buffer[i],
+					    encoder->audio_output_buffer[i],
+					    encoder->framesize_bytes);
+		popped = true;
+	}
+	pthread_mutex_unlock(&encoder->audio_mutex);
+
+	return popped;
+}
+
 static bool send_audio_data(struct obs_encoder *encoder)
 {
 	struct encoder_frame enc_frame;
@@ -1163,10 +1385,6 @@ static bool send_audio_data(struct obs_encoder *encoder)
 	memset(&enc_frame, 0, sizeof(struct encoder_frame));
 
 	for (size_t i = 0; i < encoder->planes; i++) {
-		circlebuf_pop_front(&encoder->audio_input_buffer[i],
-				    encoder->audio_output_buffer[i],
-				    encoder->framesize_bytes);
-
 		enc_frame.data[i] = encoder->audio_output_buffer[i];
 		enc_frame.linesize[i] = (uint32_t)encoder->framesize_bytes;
 	}
@@ -1260,6 +1478,9 @@ static void receive_audio(void *param, size_t mix_idx, struct audio_data *in)
 
 	struct obs_encoder *encoder = param;
 	struct audio_data audio = *in;
+	bool frame_ready;
+
+	pthread_mutex_lock(&encoder->audio_mutex);
 
 	if (!encoder->first_received) {
 		encoder->first_raw_ts = audio.timestamp;
@@ -1267,16 +1488,25 @@ static void receive_audio(void *param, size_t mix_idx, struct audio_data *in)
 		clear_audio(encoder);
 	}
 
-	if (audio_pause_check(&encoder->pause, &audio, encoder->samplerate))
+	if (audio_pause_check(&encoder->pause, &audio, encoder->samplerate)) {
+		pthread_mutex_unlock(&encoder->audio_mutex);
 		goto end;
+	}
 
-	if (!buffer_audio(encoder, &audio))
-		goto end;
+	frame_ready = buffer_audio(encoder, &audio) &&
+		      encoder->audio_input_buffer[0].size >=
+			      encoder->framesize_bytes;
 
-	while (encoder->audio_input_buffer[0].size >=
-	       encoder->framesize_bytes) {
-		if (!send_audio_data(encoder)) {
-			break;
+	pthread_mutex_unlock(&encoder->audio_mutex);
+
+	/* the encode thread takes every frame that is ready when it wakes,
+	 * so a tick that completes several frames only wakes it once */
+	if (frame_ready && encoder->audio_thread_active) {
+		os_event_signal(encoder->audio_event);
+	} else if (frame_ready) {
+		while (pop_audio_frame(encoder)) {
+			if (!send_audio_data(encoder))
+				break;
 		}
 	}
 
@@ -1286,6 +1516,69 @@ end:
 	profile_end(receive_audio_name);
 }
 
+static void *audio_encode_thread(void *param)
+{
+	struct obs_encoder *encoder = param;
+
+	os_set_thread_name("libobs: audio encode");
+
+	while (os_event_wait(encoder->audio_event) == 0) {
+		if (os_atomic_load_bool(&encoder->audio_thread_stop))
+			break;
+
+		while (!os_atomic_load_bool(&encoder->audio_thread_stop) &&
+		       pop_audio_frame(encoder)) {
+			if (!send_audio_data(encoder))
+				break;
+		}
+	}
+
+	return NULL;
+}
+
+static void join_audio_thread(struct obs_encoder *encoder)
+{
+	if (!encoder->audio_thread_active)
+		return;
+
+	os_atomic_set_bool(&encoder->audio_thread_stop, true);
+	os_event_signal(encoder->audio_event);
+	pthread_join(encoder->audio_thread, NULL);
+	encoder->audio_thread_active = false;
+}
+
+static void start_audio_thread(struct obs_encoder *encoder)
+{
+	/* a thread that stopped itself after an encode error is only joined
+	 * here or on destroy */
+	join_audio_thread(encoder);
+
+	os_atomic_set_bool(&encoder->audio_thread_stop, false);
+	os_event_reset(encoder->audio_event);
+
+	encoder->audio_thread_active =
+		pthread_create(&encoder->audio_thread, NULL,
+			       audio_encode_thread, encoder) == 0;
+	if (!encoder->audio_thread_active)
+		blog(LOG_WARNING,
+		     "encoder '%s': no audio encode thread, encoding on the "
+		     "audio thread",
+		     encoder->context.name);
+}
+
+static void stop_audio_thread(struct obs_encoder *encoder)
+{
+	/* full_stop runs on the encode thread when an encode fails, and a
+	 * thread can't join itself */
+	if (encoder->audio_thread_active &&
+	    pthread_equal(pthread_self(), encoder->audio_thread)) {
+		os_atomic_set_bool(&encoder->audio_thread_stop, true);
+		return;
+	}
+
+	join_audio_thread(encoder);
+}
+
 void obs_encoder_add_output(struct obs_encoder *encoder,
 			    struct obs_output *output)
 {
@@ -1311,12 +1604,11 @@ void obs_encoder_remove_output(struct obs_encoder *encoder,
 void obs_encoder_packet_create_instance(struct encoder_packet *dst,
 					const struct encoder_packet *src)
 {
-	long *p_refs;
+	size_t headroom = src->type == OBS_ENCODER_VIDEO ? PACKET_SEI_HEADROOM
+							 : 0;
 
 	*dst = *src;
-	p_refs = bmalloc(src->size + sizeof(long));
-	dst->data = (void *)(p_refs + 1);
-	*p_refs = 1;
+	dst->data = obs_packet_pool_alloc(src->size + headroom);
 	memcpy(dst->data, src->data, src->size);
 }
 
@@ -1339,10 +1631,8 @@ void obs_encoder_packet_ref(struct encoder_packet *dst,
 	if (!src)
 		return;
 
-	if (src->data) {
-		long *p_refs = ((long *)src->data) - 1;
-		os_atomic_inc_long(p_refs);
-	}
+	if (src->data)
+		obs_packet_pool_addref(src->data);
 
 	*dst = *src;
 }
@@ -1352,15 +1642,55 @@ void obs_encoder_packet_release(struct encoder_packet *pkt)
 	if (!pkt)
 		return;
 
-	if (pkt->data) {
-		long *p_refs = ((long *)pkt->data) - 1;
-		if (os_atomic_dec_long(p_refs) == 0)
-			bfree(p_refs);
-	}
+	if (pkt->data)
+		obs_packet_pool_release(pkt->data);
 
 	memset(pkt, 0, sizeof(struct encoder_packet));
 }
 
+bool obs_encoder_get_cached_avc_packet(obs_encoder_t *encoder,
+				       const struct encoder_packet *src,
+				       struct encoder_packet *avc_packet)
+{
+	bool found;
+
+	pthread_mutex_lock(&encoder->avc_cache_mutex);
+
+	found = encoder->avc_cache_src && encoder->avc_cache_src == src->data;
+	if (found) {
+		/* timestamps may have been offset by the output, so only the
+		 * converted data and what was parsed from it is taken */
+		*avc_packet = *src;
+		avc_packet->data = encoder->avc_cache.data;
+		avc_packet->size = encoder->avc_cache.size;
+		avc_packet->keyframe = encoder->avc_cache.keyframe;
+		avc_packet->priority = encoder->avc_cache.priority;
+		avc_packet->drop_priority = encoder->avc_cache.drop_priority;
+		obs_packet_pool_addref(avc_packet->data);
+	}
+
+	pthread_mutex_unlock(&encoder->avc_cache_mutex);
+	return found;
+}
+
+void obs_encoder_cache_avc_packet(obs_encoder_t *encoder,
+				  const struct encoder_packet *src,
+				  const struct encoder_packet *avc_packet)
+{
+	pthread_mutex_lock(&encoder->avc_cache_mutex);
+
+	if (encoder->avc_cache_src)
+		obs_packet_pool_release(encoder->avc_cache_src);
+	obs_encoder_packet_release(&encoder->avc_cache);
+
+	encoder->avc_cache_src = src->data;
+	obs_packet_pool_addref(encoder->avc_cache_src);
+	obs_encoder_packet_ref(&encoder->avc_cache,
+			       (struct encoder_packet *)avc_packet);
+
+	pthread_mutex_unlock(&encoder->avc_cache_mutex);
+}
+
 void obs_encoder_set_preferred_video_format(obs_encoder_t *encoder,
 					    enum video_format format)
 {
@@ -1474,6 +1804,52 @@ uint32_t obs_get_encoder_caps(const char *encoder_id)
 	return info ? info->caps : 0;
 }
 
+bool obs_encoder_get_caption_sei(obs_encoder_t *encoder, int64_t pts,
+				 obs_encoder_sei_cb callback, void *param)
+{
+	bool sent = false;
+	double frame_timestamp;
+
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_caption_sei"))
+		return false;
+	if (!obs_ptr_valid(callback, "obs_encoder_get_caption_sei"))
+		return false;
+	if ((encoder->info.caps & OBS_ENCODER_CAP_CAPTIONS) == 0)
+		return false;
+
+	/* the same time base outputs use for captions they add themselves */
+	frame_timestamp = (double)(pts * encoder->timebase_num) /
+			  (double)encoder->timebase_den;
+
+	pthread_mutex_lock(&encoder->outputs_mutex);
+	for (size_t i = 0; i < encoder->outputs.num; i++)
+		sent |= obs_output_get_encoder_captions(
+			encoder->outputs.array[i], frame_timestamp, callback,
+			param);
+	pthread_mutex_unlock(&encoder->outputs_mutex);
+
+	return sent;
+}
+
+void obs_encoder_request_keyframe(obs_encoder_t *encoder)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_request_keyframe"))
+		return;
+	if ((encoder->info.caps & OBS_ENCODER_CAP_KEYFRAME_REQUEST) == 0)
+		return;
+
+	os_atomic_set_bool(&encoder->keyframe_requested, true);
+}
+
+bool obs_encoder_keyframe_requested(obs_encoder_t *encoder)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_keyframe_requested"))
+		return false;
+
+	return os_atomic_load_bool(&encoder->keyframe_requested) &&
+	       os_atomic_exchange_bool(&encoder->keyframe_requested, false);
+}
+
 uint32_t obs_encoder_get_caps(const obs_encoder_t *encoder)
 {
 	return obs_encoder_valid(encoder, "obs_encoder_get_caps")
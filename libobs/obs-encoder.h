@@ -33,6 +33,12 @@ extern "C" {
 #define OBS_ENCODER_CAP_PASS_TEXTURE (1 << 1)
 #define OBS_ENCODER_CAP_DYN_BITRATE (1 << 2)
 #define OBS_ENCODER_CAP_INTERNAL (1 << 3)
+/** The encoder embeds captions through obs_encoder_get_caption_sei */
+#define OBS_ENCODER_CAP_CAPTIONS (1 << 4)
+/** The encoder forces keyframes through obs_encoder_keyframe_requested */
+#define OBS_ENCODER_CAP_KEYFRAME_REQUEST (1 << 5)
+/** The scaled size can change while active, see obs_encoder_set_scaled_size */
+#define OBS_ENCODER_CAP_DYN_RESOLUTION (1 << 6)
 
 /** Specifies the encoder type */
 enum obs_encoder_type {
@@ -40,6 +46,15 @@ enum obs_encoder_type {
 	OBS_ENCODER_VIDEO  /**< The encoder provides a video codec */
 };
 
+/** Encoder input texture (used with encode_texture2) */
+struct encoder_texture {
+	/** Shared texture handle, or GS_INVALID_HANDLE if not available */
+	uint32_t handle;
+
+	/** Plane textures, NULL terminated */
+	gs_texture_t *tex[4];
+};
+
 /** Encoder output packet */
 struct encoder_packet {
 	uint8_t *data; /**< Packet data */
@@ -85,6 +100,13 @@ struct encoder_packet {
 
 	/** Encoder from which the track originated from */
 	obs_encoder_t *encoder;
+
+	/**
+	 * Set on the first keyframe after the headers of the encoder
+	 * (obs_encoder_get_extra_data) changed while it was active.  Outputs
+	 * that send the headers separately send the new ones before it.
+	 */
+	bool headers_changed;
 };
 
 /** Encoder input frame */
@@ -262,6 +284,32 @@ struct obs_encoder_info {
 			       uint64_t lock_key, uint64_t *next_key,
 			       struct encoder_packet *packet,
 			       bool *received_packet);
+
+	/**
+	 * Encodes a frame straight from GPU textures.  Unlike encode_texture
+	 * this does not rely on keyed-mutex shared handles, so it is also
+	 * used on platforms without them.  The textures are only valid for
+	 * the duration of the call, and the encoder must enter the graphics
+	 * context itself before accessing them.
+	 *
+	 * @param       data             Data associated with this encoder
+	 *                               context
+	 * @param       texture          Textures of the frame (Y and UV planes
+	 *                               for NV12) and the shared handle if the
+	 *                               platform has one
+	 * @param       pts              Presentation timestamp of the frame
+	 * @param       lock_key         Keyed mutex key (Windows only)
+	 * @param[out]  next_key         Next keyed mutex key (Windows only)
+	 * @param[out]  packet           Destination packet
+	 * @param[out]  received_packet  Set to true if a packet was received,
+	 *                               false otherwise
+	 * @return                       true if successful, false otherwise
+	 */
+	bool (*encode_texture2)(void *data, struct encoder_texture *texture,
+				int64_t pts, uint64_t lock_key,
+				uint64_t *next_key,
+				struct encoder_packet *packet,
+				bool *received_packet);
 };
 
 EXPORT void obs_register_encoder_s(const struct obs_encoder_info *info,
@@ -0,0 +1,250 @@
+#include <inttypes.h>
+
+#include "util/platform.h"
+#include "obs-internal.h"
+
+/*
+ * Shared allocator for the plane data of async video frames.
+ *
+ * Blocks are rounded up to size classes (four per power of two, so at most
+ * 25% is wasted) and kept on per-class free lists when released, which lets
+ * a block freed by one source or format be picked up by another.  Cached
+ * blocks that sit unused for too long, or that would push the arena past its
+ * limit, are handed back to the OS.
+ */
+
+#define ARENA_HEADER_SIZE 64
+#define ARENA_MIN_SHIFT 16
+#define ARENA_IDLE_NS (30ULL * 1000000000ULL)
+#define ARENA_DEFAULT_LIMIT (1024ULL * 1024ULL * 1024ULL)
+
+struct arena_block {
+	size_t size;
+	int size_class;
+	uint64_t free_time;
+};
+
+static const char *arena_map_name = "obs_frame_arena_map";
+
+static inline size_t class_size(int size_class)
+{
+	size_t base = (size_t)1 << (ARENA_MIN_SHIFT + size_class / 4);
+	return base + (base / 4) * (size_class % 4);
+}
+
+static int get_size_class(size_t size)
+{
+	for (int i = 0; i < ARENA_NUM_CLASSES; i++) {
+		if (size <= class_size(i))
+			return i;
+	}
+
+	return -1;
+}
+
+static inline void *block_data(struct arena_block *block)
+{
+	return (uint8_t *)block + ARENA_HEADER_SIZE;
+}
+
+static inline struct arena_block *data_block(void *data)
+{
+	return (struct arena_block *)((uint8_t *)data - ARENA_HEADER_SIZE);
+}
+
+/* assumes mutex */
+static void unmap_block(struct obs_frame_arena *arena,
+			struct arena_block *block)
+{
+	arena->bytes_mapped -= block->size;
+	arena->unmapped++;
+	os_large_free(block, block->size);
+}
+
+/* assumes mutex */
+static void trim_idle_blocks(struct obs_frame_arena *arena, uint64_t now)
+{
+	for (int i = 0; i < ARENA_NUM_CLASSES; i++) {
+		/* the oldest blocks are at the start of each list */
+		while (arena->free_blocks[i].num) {
+			struct arena_block *block =
+				arena->free_blocks[i].array[0];
+			if (now - block->free_time < ARENA_IDLE_NS)
+				break;
+
+			da_erase(arena->free_blocks[i], 0);
+			arena->bytes_cached -= block->size;
+			unmap_block(arena, block);
+		}
+	}
+}
+
+/* releases cached blocks, largest first, until the arena fits within the
+ * limit with `size` more bytes.  assumes mutex */
+static void trim_to_limit(struct obs_frame_arena *arena, size_t size)
+{
+	for (int i = ARENA_NUM_CLASSES; i > 0; i--) {
+		while (arena->bytes_mapped + size > arena->limit &&
+		       arena->free_blocks[i - 1].num) {
+			struct arena_block *block =
+				arena->free_blocks[i - 1].array[0];
+
+			da_erase(arena->free_blocks[i - 1], 0);
+			arena->bytes_cached -= block->size;
+			unmap_block(arena, block);
+		}
+	}
+}
+
+bool obs_frame_arena_init(struct obs_frame_arena *arena)
+{
+	memset(arena, 0, sizeof(*arena));
+	arena->limit = ARENA_DEFAULT_LIMIT;
+	return pthread_mutex_init(&arena->mutex, NULL) == 0;
+}
+
+void obs_frame_arena_free(struct obs_frame_arena *arena)
+{
+	if (arena->allocations) {
+		blog(LOG_INFO,
+		     "Video frame arena: %" PRIu64 " allocations, "
+		     "%" PRIu64 " reused, %" PRIu64 " blocks mapped, "
+		     "%" PRIu64 " over limit",
+		     arena->allocations, arena->reused, arena->mapped,
+		     arena->over_limit);
+	}
+
+	if (arena->bytes_mapped != arena->bytes_cached)
+		blog(LOG_WARNING,
+		     "Video frame arena: %" PRIu64 " bytes still in use",
+		     (uint64_t)(arena->bytes_mapped - arena->bytes_cached));
+
+	for (int i = 0; i < ARENA_NUM_CLASSES; i++) {
+		for (size_t j = 0; j < arena->free_blocks[i].num; j++) {
+			struct arena_block *block =
+				arena->free_blocks[i].array[j];
+			os_large_free(block, block->size);
+		}
+		da_free(arena->free_blocks[i]);
+	}
+
+	pthread_mutex_destroy(&arena->mutex);
+	memset(arena, 0, sizeof(*arena));
+}
+
+void *obs_frame_arena_alloc(size_t size)
+{
+	struct obs_frame_arena *arena = &obs->frame_arena;
+	struct arena_block *block = NULL;
+	int size_class = get_size_class(size);
+	size_t block_size;
+
+	pthread_mutex_lock(&arena->mutex);
+	arena->allocations++;
+
+	if (size_class >= 0 && arena->free_blocks[size_class].num) {
+		size_t idx = arena->free_blocks[size_class].num - 1;
+		block = arena->free_blocks[size_class].array[idx];
+		da_pop_back(arena->free_blocks[size_class]);
+
+		arena->bytes_cached -= block->size;
+		arena->reused++;
+		pthread_mutex_unlock(&arena->mutex);
+		return block_data(block);
+	}
+
+	block_size = (size_class >= 0 ? class_size(size_class) : size) +
+		     ARENA_HEADER_SIZE;
+
+	trim_to_limit(arena, block_size);
+	if (arena->bytes_mapped + block_size > arena->limit)
+		arena->over_limit++;
+
+	arena->bytes_mapped += block_size;
+	arena->mapped++;
+	pthread_mutex_unlock(&arena->mutex);
+
+	/* mapping and first touching new pages is the expensive part, so let
+	 * it show up in the profiler */
+	profile_start(arena_map_name);
+	block = os_large_alloc(block_size);
+	profile_end(arena_map_name);
+
+	if (!block) {
+		/* same behavior as bmalloc when out of memory */
+		os_breakpoint();
+		bcrash("Out of memory while trying to allocate %lu bytes",
+		       (unsigned long)block_size);
+	}
+
+	block->size = block_size;
+	block->size_class = size_class;
+	return block_data(block);
+}
+
+void obs_frame_arena_release(void *ptr)
+{
+	struct obs_frame_arena *arena = &obs->frame_arena;
+	struct arena_block *block;
+	uint64_t now;
+
+	if (!ptr)
+		return;
+
+	block = data_block(ptr);
+	now = os_gettime_ns();
+
+	pthread_mutex_lock(&arena->mutex);
+
+	if (block->size_class < 0 || arena->bytes_mapped > arena->limit) {
+		unmap_block(arena, block);
+	} else {
+		block->free_time = now;
+		da_push_back(arena->free_blocks[block->size_class], &block);
+		arena->bytes_cached += block->size;
+	}
+
+	trim_idle_blocks(arena, now);
+
+	pthread_mutex_unlock(&arena->mutex);
+}
+
+void obs_set_frame_arena_limit(uint64_t bytes)
+{
+	struct obs_frame_arena *arena;
+
+	if (!obs)
+		return;
+
+	arena = &obs->frame_arena;
+
+	pthread_mutex_lock(&arena->mutex);
+	arena->limit = (size_t)bytes;
+	trim_to_limit(arena, 0);
+	pthread_mutex_unlock(&arena->mutex);
+}
+
+void obs_get_frame_arena_stats(struct obs_frame_arena_stats *stats)
+{
+	struct obs_frame_arena *arena;
+
+	if (!obs_ptr_valid(stats, "obs_get_frame_arena_stats"))
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!obs)
+		return;
+
+	arena = &obs->frame_arena;
+
+	pthread_mutex_lock(&arena->mutex);
+	stats->allocations = arena->allocations;
+	stats->reused = arena->reused;
+	stats->mapped = arena->mapped;
+	stats->unmapped = arena->unmapped;
+	stats->over_limit = arena->over_limit;
+	stats->bytes_in_use = arena->bytes_mapped - arena->bytes_cached;
+	stats->bytes_cached = arena->bytes_cached;
+	stats->bytes_limit = arena->limit;
+	pthread_mutex_unlock(&arena->mutex);
+}
@@ -0,0 +1,171 @@
+#include "util/shmem.h"
+#include "obs-frame-export.h"
+#include "obs-internal.h"
+
+/*
+ * Exports the program output to other processes through shared memory.
+ *
+ * Frames come from a raw video connection, so the video-io thread copies
+ * each one into the ring once no matter how many processes read it.  Sizes
+ * other than the output size are taken from a GPU scaled canvas when the
+ * size allows it, otherwise video-io scales them.
+ */
+
+#define DEFAULT_FRAMES 3
+
+struct obs_frame_export {
+	os_shmem_t *shm;
+	struct obs_frame_export_header *header;
+	uint8_t *frames;
+
+	video_t *video;
+	video_t *scaled_video;
+
+	uint32_t divisor;
+	uint64_t received;
+	volatile long long exported;
+};
+
+static void copy_plane(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src,
+		       uint32_t src_linesize, uint32_t rows)
+{
+	if (dst_linesize == src_linesize) {
+		memcpy(dst, src, (size_t)dst_linesize * rows);
+		return;
+	}
+
+	for (uint32_t y = 0; y < rows; y++) {
+		memcpy(dst, src, dst_linesize);
+		dst += dst_linesize;
+		src += src_linesize;
+	}
+}
+
+static void receive_frame(void *param, struct video_data *frame)
+{
+	struct obs_frame_export *fe = param;
+	struct obs_frame_export_header *header = fe->header;
+	struct obs_frame_export_slot *slot;
+	uint8_t *dst;
+	long long n;
+	size_t idx;
+
+	if (fe->received++ % fe->divisor != 0)
+		return;
+
+	n = fe->exported + 1;
+	idx = (size_t)(n % header->num_frames);
+	slot = &header->slots[idx];
+	dst = fe->frames + idx * header->frame_size;
+
+	os_atomic_store_long_long(&slot->sequence, n * 2 - 1);
+
+	copy_plane(dst + header->plane_offset[0], header->linesize[0],
+		   frame->data[0], frame->linesize[0], header->height);
+	copy_plane(dst + header->plane_offset[1], header->linesize[1],
+		   frame->data[1], frame->linesize[1], header->height / 2);
+	slot->timestamp = frame->timestamp;
+
+	os_atomic_store_long_long(&slot->sequence, n * 2);
+	os_atomic_store_long_long(&header->latest, n);
+	os_atomic_store_long_long(&fe->exported, n);
+}
+
+static void init_header(struct obs_frame_export_header *header,
+			const struct video_output_info *voi, uint32_t width,
+			uint32_t height, uint32_t num_frames, uint32_t divisor)
+{
+	header->magic = OBS_FRAME_EXPORT_MAGIC;
+	header->version = OBS_FRAME_EXPORT_VERSION;
+	header->header_size = (sizeof(*header) + 63) & ~63;
+	header->num_frames = num_frames;
+	header->width = width;
+	header->height = height;
+	header->fps_num = voi->fps_num;
+	header->fps_den = voi->fps_den * divisor;
+	header->linesize[0] = width;
+	header->linesize[1] = width;
+	header->plane_offset[0] = 0;
+	header->plane_offset[1] = width * height;
+	header->frame_size = (uint64_t)width * height + width * (height / 2);
+}
+
+obs_frame_export_t *
+obs_frame_export_create(const char *name,
+			const struct obs_frame_export_info *info)
+{
+	struct obs_core_video_mix *main_mix = obs->video.main_mix;
+	const struct video_output_info *voi;
+	struct obs_frame_export_header header = {0};
+	struct video_scale_info conversion = {0};
+	struct obs_frame_export *fe;
+	uint32_t width, height, num_frames, divisor;
+
+	if (!obs_ptr_valid(name, "obs_frame_export_create"))
+		return NULL;
+	if (!main_mix)
+		return NULL;
+
+	voi = video_output_get_info(main_mix->video);
+
+	/* NV12 chroma is subsampled in both directions */
+	width = (info && info->width ? info->width : voi->width) & ~1;
+	height = (info && info->height ? info->height : voi->height) & ~1;
+	num_frames = info && info->num_frames ? info->num_frames
+					      : DEFAULT_FRAMES;
+	divisor = info && info->frame_divisor ? info->frame_divisor : 1;
+
+	if (!width || !height)
+		return NULL;
+	if (num_frames > OBS_FRAME_EXPORT_MAX_FRAMES)
+		num_frames = OBS_FRAME_EXPORT_MAX_FRAMES;
+
+	init_header(&header, voi, width, height, num_frames, divisor);
+
+	fe = bzalloc(sizeof(struct obs_frame_export));
+	fe->divisor = divisor;
+	fe->shm = os_shmem_create(name, header.header_size +
+						header.frame_size * num_frames);
+	if (!fe->shm) {
+		blog(LOG_WARNING,
+		     "obs_frame_export_create: Failed to create '%s'", name);
+		bfree(fe);
+		return NULL;
+	}
+
+	fe->header = os_shmem_data(fe->shm);
+	*fe->header = header;
+	fe->frames = (uint8_t *)fe->header + header.header_size;
+
+	if (width != voi->width || height != voi->height)
+		fe->scaled_video =
+			obs_get_scaled_video(main_mix->video, width, height);
+	fe->video = fe->scaled_video ? fe->scaled_video : main_mix->video;
+
+	conversion.format = VIDEO_FORMAT_NV12;
+	conversion.width = width;
+	conversion.height = height;
+	conversion.range = voi->range;
+	conversion.colorspace = voi->colorspace;
+	start_raw_video(fe->video, &conversion, receive_frame, fe);
+
+	blog(LOG_INFO, "Exporting %ux%u frames to '%s'%s", width, height, name,
+	     fe->scaled_video ? " (GPU scaled)" : "");
+	return fe;
+}
+
+void obs_frame_export_destroy(obs_frame_export_t *fe)
+{
+	if (!fe)
+		return;
+
+	stop_raw_video(fe->video, receive_frame, fe);
+	obs_release_scaled_video(fe->scaled_video);
+	os_shmem_destroy(fe->shm);
+	bfree(fe);
+}
+
+uint64_t obs_frame_export_get_frames(const obs_frame_export_t *fe)
+{
+	return fe ? (uint64_t)os_atomic_load_long_long(&fe->exported) : 0;
+}
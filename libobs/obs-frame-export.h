@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Layout of the shared memory ring published by obs_frame_export_create.
+ * This header has no other libobs dependencies so that external processes
+ * can include it on its own.
+ *
+ * The region starts with an obs_frame_export_header, followed by num_frames
+ * NV12 frames of frame_size bytes each, starting at header_size.
+ *
+ * Frames are numbered from 1.  Frame n is written to slot n % num_frames,
+ * whose sequence is 2 * n - 1 while it is written and 2 * n once it is
+ * complete, after which latest is set to n.  To read a frame, load latest,
+ * check that the slot's sequence is 2 * latest, copy what is needed and then
+ * check the sequence again: if it changed, the frame was overwritten while
+ * it was copied and has to be discarded.
+ */
+
+#define OBS_FRAME_EXPORT_MAGIC 0x4F465845
+#define OBS_FRAME_EXPORT_VERSION 1
+#define OBS_FRAME_EXPORT_MAX_FRAMES 16
+
+struct obs_frame_export_slot {
+	volatile long long sequence;
+	/* video frame time of the frame in nanoseconds */
+	uint64_t timestamp;
+};
+
+struct obs_frame_export_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t num_frames;
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t fps_num;
+	uint32_t fps_den;
+
+	/* luma plane first, then the interleaved chroma plane */
+	uint32_t linesize[2];
+	uint32_t plane_offset[2];
+	uint64_t frame_size;
+
+	/* number of the newest complete frame, 0 until the first one */
+	volatile long long latest;
+
+	struct obs_frame_export_slot slots[OBS_FRAME_EXPORT_MAX_FRAMES];
+};
@@ -0,0 +1,277 @@
+#include <inttypes.h>
+
+#include "obs-internal.h"
+
+/*
+ * Keeps track of the GPU memory held by sources and evicts what has not been
+ * drawn lately once the total goes over the budget.
+ *
+ * Owners report the size of each resource and touch it whenever it is drawn.
+ * Eviction runs on the graphics thread, inside the graphics context, and
+ * picks resources that have not been drawn for a second: lower priorities
+ * first, least recently drawn first within a priority.  The owner frees the
+ * memory in its evict callback and loads it again the next time it is
+ * needed.
+ *
+ * The graphics context is always entered before the mutex is taken, which
+ * lets owners report sizes while creating textures and destroy resources
+ * from any thread without waiting on a running eviction in the wrong order.
+ */
+
+struct obs_gpu_resource {
+	/* only compared, owners destroy their resources before going away */
+	const obs_source_t *owner;
+	enum obs_gpu_priority priority;
+	obs_gpu_evict_cb evict;
+	void *param;
+
+	uint64_t bytes;
+	volatile long long last_use;
+	bool evicted;
+};
+
+static inline struct obs_gpu_memory *get_manager(void)
+{
+	return obs && obs->gpu_memory.initialized ? &obs->gpu_memory : NULL;
+}
+
+obs_gpu_resource_t *obs_gpu_resource_create(const obs_source_t *owner,
+					    enum obs_gpu_priority priority,
+					    obs_gpu_evict_cb evict, void *param)
+{
+	struct obs_gpu_memory *gm = get_manager();
+	struct obs_gpu_resource *res;
+
+	if (!gm || !obs_ptr_valid(evict, "obs_gpu_resource_create"))
+		return NULL;
+
+	res = bzalloc(sizeof(struct obs_gpu_resource));
+	res->owner = owner;
+	res->priority = priority;
+	res->evict = evict;
+	res->param = param;
+	res->last_use = os_atomic_load_long_long(&gm->frame);
+
+	pthread_mutex_lock(&gm->mutex);
+	da_push_back(gm->resources, &res);
+	pthread_mutex_unlock(&gm->mutex);
+	return res;
+}
+
+void obs_gpu_resource_destroy(obs_gpu_resource_t *res)
+{
+	struct obs_gpu_memory *gm = get_manager();
+
+	if (!gm || !res)
+		return;
+
+	pthread_mutex_lock(&gm->mutex);
+	gm->bytes -= res->bytes;
+	da_erase_item(gm->resources, &res);
+	pthread_mutex_unlock(&gm->mutex);
+
+	bfree(res);
+}
+
+void obs_gpu_resource_set_size(obs_gpu_resource_t *res, uint64_t bytes)
+{
+	struct obs_gpu_memory *gm = get_manager();
+
+	if (!gm || !res)
+		return;
+
+	pthread_mutex_lock(&gm->mutex);
+	gm->bytes += bytes - res->bytes;
+	res->bytes = bytes;
+	if (bytes) {
+		res->evicted = false;
+		res->last_use = os_atomic_load_long_long(&gm->frame);
+	}
+	pthread_mutex_unlock(&gm->mutex);
+}
+
+void obs_gpu_resource_touch(obs_gpu_resource_t *res)
+{
+	struct obs_gpu_memory *gm = get_manager();
+
+	if (gm && res)
+		os_atomic_store_long_long(
+			&res->last_use, os_atomic_load_long_long(&gm->frame));
+}
+
+bool obs_gpu_resource_evicted(const obs_gpu_resource_t *res)
+{
+	struct obs_gpu_memory *gm = get_manager();
+	bool evicted;
+
+	if (!gm || !res)
+		return false;
+
+	pthread_mutex_lock(&gm->mutex);
+	evicted = res->evicted;
+	pthread_mutex_unlock(&gm->mutex);
+	return evicted;
+}
+
+/* assumes mutex */
+static struct obs_gpu_resource *find_victim(struct obs_gpu_memory *gm,
+					    long long idle_before)
+{
+	struct obs_gpu_resource *victim = NULL;
+
+	for (size_t i = 0; i < gm->resources.num; i++) {
+		struct obs_gpu_resource *res = gm->resources.array[i];
+		long long last_use = os_atomic_load_long_long(&res->last_use);
+
+		if (!res->bytes || last_use >= idle_before)
+			continue;
+		if (victim && (res->priority > victim->priority ||
+			       (res->priority == victim->priority &&
+				last_use >= victim->last_use)))
+			continue;
+
+		victim = res;
+	}
+
+	return victim;
+}
+
+void obs_gpu_memory_tick(void)
+{
+	struct obs_gpu_memory *gm = get_manager();
+	uint64_t interval = obs->video.video_frame_interval_ns;
+	long long frame, idle_before;
+	uint64_t budget, freed = 0;
+	size_t count = 0;
+	bool over;
+
+	if (!gm)
+		return;
+
+	frame = os_atomic_add_long_long(&gm->frame, 1);
+	budget = (uint64_t)os_atomic_load_long_long(&gm->budget);
+	if (!budget)
+		return;
+
+	pthread_mutex_lock(&gm->mutex);
+	over = gm->bytes > budget;
+	pthread_mutex_unlock(&gm->mutex);
+	if (!over)
+		return;
+
+	/* anything drawn within the last second is in use */
+	idle_before = frame - (long long)(interval ? 1000000000ULL / interval
+						   : 60);
+
+	obs_enter_graphics();
+	pthread_mutex_lock(&gm->mutex);
+
+	while (gm->bytes > budget) {
+		struct obs_gpu_resource *res = find_victim(gm, idle_before);
+		if (!res)
+			break;
+
+		freed += res->bytes;
+		count++;
+
+		gm->bytes -= res->bytes;
+		res->bytes = 0;
+		res->evicted = true;
+		res->evict(res->param);
+	}
+
+	over = gm->bytes > budget;
+	pthread_mutex_unlock(&gm->mutex);
+	obs_leave_graphics();
+
+	if (count)
+		blog(LOG_DEBUG,
+		     "GPU memory: evicted %zu resources (%" PRIu64 " bytes)",
+		     count, freed);
+
+	if (over && !gm->over_budget)
+		blog(LOG_WARNING, "GPU memory: resources in use exceed the "
+				  "budget, nothing more can be evicted");
+	gm->over_budget = over;
+}
+
+void obs_set_gpu_memory_budget(uint64_t bytes)
+{
+	struct obs_gpu_memory *gm = get_manager();
+
+	if (gm)
+		os_atomic_store_long_long(&gm->budget, (long long)bytes);
+}
+
+uint64_t obs_get_gpu_memory_budget(void)
+{
+	struct obs_gpu_memory *gm = get_manager();
+	return gm ? (uint64_t)os_atomic_load_long_long(&gm->budget) : 0;
+}
+
+uint64_t obs_get_gpu_memory_usage(void)
+{
+	struct obs_gpu_memory *gm = get_manager();
+	uint64_t bytes;
+
+	if (!gm)
+		return 0;
+
+	pthread_mutex_lock(&gm->mutex);
+	bytes = gm->bytes;
+	pthread_mutex_unlock(&gm->mutex);
+	return bytes;
+}
+
+uint64_t obs_source_get_gpu_memory_usage(const obs_source_t *source)
+{
+	struct obs_gpu_memory *gm = get_manager();
+	uint64_t bytes = 0;
+
+	if (!gm || !obs_source_valid(source, "obs_source_get_gpu_memory_usage"))
+		return 0;
+
+	pthread_mutex_lock(&gm->mutex);
+	for (size_t i = 0; i < gm->resources.num; i++) {
+		struct obs_gpu_resource *res = gm->resources.array[i];
+		if (res->owner == source)
+			bytes += res->bytes;
+	}
+	pthread_mutex_unlock(&gm->mutex);
+	return bytes;
+}
+
+bool obs_gpu_memory_init(struct obs_gpu_memory *gm)
+{
+	pthread_mutexattr_t attr;
+
+	memset(gm, 0, sizeof(*gm));
+
+	/* owners report sizes from their evict callbacks */
+	if (pthread_mutexattr_init(&attr) != 0)
+		return false;
+	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
+		return false;
+	if (pthread_mutex_init(&gm->mutex, &attr) != 0)
+		return false;
+
+	gm->initialized = true;
+	return true;
+}
+
+void obs_gpu_memory_free(struct obs_gpu_memory *gm)
+{
+	if (!gm->initialized)
+		return;
+
+	if (gm->resources.num)
+		blog(LOG_WARNING, "GPU memory: %zu resources were remaining",
+		     gm->resources.num);
+
+	for (size_t i = 0; i < gm->resources.num; i++)
+		bfree(gm->resources.array[i]);
+
+	da_free(gm->resources);
+	pthread_mutex_destroy(&gm->mutex);
+	gm->initialized = false;
+}
@@ -0,0 +1,348 @@
+#include "obs-internal.h"
+
+/*
+ * GPU time of the main canvas' render stages, measured with timer queries.
+ *
+ * Each frame that is timed uses one of a few sets of queries, and the results
+ * of earlier frames are read at the start of every frame once the GPU has
+ * made them available, so the graphics thread never waits for the GPU.  If
+ * all sets are still in flight, the frame is not timed.
+ *
+ * Sources (and filters) rendered in a timed frame get a timer of their own,
+ * which includes the time of their filters and, for scenes and transitions,
+ * of the sources they render.
+ */
+
+/* limits the queries of a frame in very large collections */
+#define MAX_SOURCE_TIMERS 1024
+
+static const char *stage_names[OBS_GPU_STAGE_COUNT] = {
+	"render_video",
+	"render_main_texture",
+	"render_output_texture",
+	"render_convert_texture",
+	"output_gpu_encoders",
+	"stage_output_texture",
+};
+
+static void release_sources(struct obs_gpu_timer_frame *frame)
+{
+	for (size_t i = 0; i < frame->sources.num; i++)
+		obs_weak_source_release(frame->sources.array[i]);
+	da_resize(frame->sources, 0);
+}
+
+static void destroy_frame(struct obs_gpu_timer_frame *frame)
+{
+	release_sources(frame);
+	da_free(frame->sources);
+
+	for (size_t i = 0; i < frame->source_timers.num; i++)
+		gs_timer_destroy(frame->source_timers.array[i]);
+	da_free(frame->source_timers);
+
+	gs_timer_range_destroy(frame->range);
+	for (size_t i = 0; i < OBS_GPU_STAGE_COUNT; i++)
+		gs_timer_destroy(frame->timers[i]);
+
+	memset(frame, 0, sizeof(*frame));
+}
+
+static bool create_frame(struct obs_gpu_timer_frame *frame)
+{
+	frame->range = gs_timer_range_create();
+	if (!frame->range)
+		return false;
+
+	for (size_t i = 0; i < OBS_GPU_STAGE_COUNT; i++) {
+		frame->timers[i] = gs_timer_create();
+		if (!frame->timers[i])
+			return false;
+	}
+
+	return true;
+}
+
+static void add_sample(struct obs_gpu_timing *timing, size_t stage,
+		       uint64_t ns)
+{
+	struct obs_gpu_stage_counters *counters = timing->stages + stage;
+
+	os_atomic_add_long_long(&counters->count, 1);
+	os_atomic_add_long_long(&counters->total_ns, (long long)ns);
+
+	/* only the graphics thread writes the maximum */
+	if ((long long)ns > os_atomic_load_long_long(&counters->max_ns))
+		os_atomic_store_long_long(&counters->max_ns, (long long)ns);
+
+	obs_histogram_observe(&timing->hist[stage], ns);
+}
+
+static void collect_sources(struct obs_gpu_timing *timing,
+			    struct obs_gpu_timer_frame *frame,
+			    uint64_t frequency)
+{
+	for (size_t i = 0; i < frame->sources.num; i++) {
+		obs_weak_source_t *weak = frame->sources.array[i];
+		obs_source_t *source;
+		uint64_t ticks;
+
+		if (!gs_timer_get_data(frame->source_timers.array[i], &ticks))
+			continue;
+
+		source = obs_weak_source_get_source(weak);
+		if (!source)
+			continue;
+
+		os_atomic_add_long_long(
+			&source->gpu_time_ns,
+			(long long)util_mul_div64(ticks, 1000000000ULL,
+						  frequency));
+		obs_source_release(source);
+	}
+
+	os_atomic_add_long_long(&timing->source_frames, 1);
+}
+
+/* returns false if the results are not available yet */
+static bool collect_frame(struct obs_gpu_timing *timing,
+			  struct obs_gpu_timer_frame *frame)
+{
+	uint64_t frequency = 0;
+	bool disjoint = false;
+
+	/* the get_data functions of the backends block until the results
+	 * are in, so they are only called once the last query is done */
+	if (!gs_timer_ready(frame->timers[OBS_GPU_STAGE_RENDER_VIDEO]) ||
+	    !gs_timer_range_ready(frame->range))
+		return false;
+
+	frame->pending = false;
+
+	/* the timestamps of the frame can't be compared if disjoint */
+	if (gs_timer_range_get_data(frame->range, &disjoint, &frequency) &&
+	    !disjoint && frequency)
+		collect_sources(timing, frame, frequency);
+
+	release_sources(frame);
+
+	if (disjoint || !frequency)
+		return true;
+
+	for (size_t i = 0; i < OBS_GPU_STAGE_COUNT; i++) {
+		uint64_t ticks;
+
+		if ((frame->used & (1 << i)) == 0)
+			continue;
+		if (!gs_timer_get_data(frame->timers[i], &ticks))
+			continue;
+
+		add_sample(timing, i,
+			   util_mul_div64(ticks, 1000000000ULL, frequency));
+	}
+
+	return true;
+}
+
+static void collect_frames(struct obs_gpu_timing *timing)
+{
+	/* oldest first, and later frames can't be ready before it */
+	for (size_t i = 1; i <= OBS_GPU_TIMER_FRAMES; i++) {
+		size_t idx = (timing->cur_frame + i) % OBS_GPU_TIMER_FRAMES;
+		struct obs_gpu_timer_frame *frame = timing->frames + idx;
+
+		if (frame->pending && !collect_frame(timing, frame))
+			break;
+	}
+}
+
+static bool prepare_frame(struct obs_gpu_timing *timing,
+			  struct obs_gpu_timer_frame *frame)
+{
+	if (frame->range)
+		return true;
+
+	if (!create_frame(frame)) {
+		blog(LOG_WARNING, "GPU timing is not supported by the "
+				  "graphics backend");
+		destroy_frame(frame);
+		timing->unsupported = true;
+		os_atomic_store_bool(&timing->enabled, false);
+		return false;
+	}
+
+	return true;
+}
+
+/* called by the graphics thread with the graphics context entered, returns
+ * true if the frame is timed */
+bool obs_gpu_timing_begin_frame(void)
+{
+	struct obs_gpu_timing *timing = &obs->video.gpu_timing;
+	struct obs_gpu_timer_frame *frame;
+
+	if (!os_atomic_load_bool(&timing->enabled)) {
+		/* results from before timing was disabled are stale */
+		for (size_t i = 0; i < OBS_GPU_TIMER_FRAMES; i++) {
+			timing->frames[i].pending = false;
+			release_sources(timing->frames + i);
+		}
+		return false;
+	}
+
+	collect_frames(timing);
+
+	frame = timing->frames + timing->cur_frame;
+	if (frame->pending || !prepare_frame(timing, frame))
+		return false;
+
+	frame->used = 0;
+	timing->active = frame;
+	gs_timer_range_begin(frame->range);
+	return true;
+}
+
+void obs_gpu_timing_end_frame(void)
+{
+	struct obs_gpu_timing *timing = &obs->video.gpu_timing;
+	struct obs_gpu_timer_frame *frame = timing->active;
+
+	if (!frame)
+		return;
+
+	gs_timer_range_end(frame->range);
+	frame->pending = true;
+	timing->active = NULL;
+	timing->cur_frame = (timing->cur_frame + 1) % OBS_GPU_TIMER_FRAMES;
+}
+
+void obs_gpu_timing_begin(enum obs_gpu_stage stage)
+{
+	struct obs_gpu_timer_frame *frame = obs->video.gpu_timing.active;
+
+	if (frame) {
+		gs_timer_begin(frame->timers[stage]);
+		frame->used |= 1 << stage;
+	}
+}
+
+void obs_gpu_timing_end(enum obs_gpu_stage stage)
+{
+	struct obs_gpu_timer_frame *frame = obs->video.gpu_timing.active;
+
+	if (frame)
+		gs_timer_end(frame->timers[stage]);
+}
+
+/* returns NULL if the frame is not timed */
+gs_timer_t *obs_gpu_timing_begin_source(obs_source_t *source)
+{
+	struct obs_gpu_timer_frame *frame = obs->video.gpu_timing.active;
+	obs_weak_source_t *weak;
+	gs_timer_t *timer;
+	size_t idx;
+
+	if (!frame || frame->sources.num == MAX_SOURCE_TIMERS)
+		return NULL;
+
+	idx = frame->sources.num;
+	if (idx == frame->source_timers.num) {
+		timer = gs_timer_create();
+		if (!timer)
+			return NULL;
+		da_push_back(frame->source_timers, &timer);
+	}
+
+	timer = frame->source_timers.array[idx];
+	weak = obs_source_get_weak_source(source);
+	da_push_back(frame->sources, &weak);
+
+	gs_timer_begin(timer);
+	return timer;
+}
+
+void obs_gpu_timing_end_source(gs_timer_t *timer)
+{
+	if (timer)
+		gs_timer_end(timer);
+}
+
+/* assumes the graphics context */
+void obs_gpu_timing_free(void)
+{
+	struct obs_gpu_timing *timing = &obs->video.gpu_timing;
+
+	for (size_t i = 0; i < OBS_GPU_TIMER_FRAMES; i++)
+		destroy_frame(timing->frames + i);
+
+	timing->active = NULL;
+	timing->cur_frame = 0;
+	timing->unsupported = false;
+}
+
+void obs_set_gpu_timing_enabled(bool enable)
+{
+	struct obs_gpu_timing *timing;
+
+	if (!obs)
+		return;
+
+	timing = &obs->video.gpu_timing;
+	if (enable && timing->unsupported) {
+		blog(LOG_WARNING, "GPU timing is not supported by the "
+				  "graphics backend");
+		return;
+	}
+
+	for (size_t i = 0; enable && i < OBS_GPU_STAGE_COUNT; i++) {
+		struct obs_gpu_stage_counters *counters = timing->stages + i;
+
+		os_atomic_store_long_long(&counters->count, 0);
+		os_atomic_store_long_long(&counters->total_ns, 0);
+		os_atomic_store_long_long(&counters->max_ns, 0);
+	}
+
+	os_atomic_store_bool(&timing->enabled, enable);
+}
+
+bool obs_gpu_timing_enabled(void)
+{
+	return obs ? os_atomic_load_bool(&obs->video.gpu_timing.enabled)
+		   : false;
+}
+
+void obs_get_gpu_stage_stats(enum obs_gpu_stage stage,
+			     struct obs_gpu_stage_stats *stats)
+{
+	struct obs_gpu_stage_counters *counters;
+
+	if (!stats)
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!obs || (size_t)stage >= OBS_GPU_STAGE_COUNT)
+		return;
+
+	counters = obs->video.gpu_timing.stages + stage;
+	stats->count = (uint64_t)os_atomic_load_long_long(&counters->count);
+	stats->total_ns =
+		(uint64_t)os_atomic_load_long_long(&counters->total_ns);
+	stats->max_ns = (uint64_t)os_atomic_load_long_long(&counters->max_ns);
+}
+
+const char *obs_gpu_stage_name(enum obs_gpu_stage stage)
+{
+	if ((size_t)stage >= OBS_GPU_STAGE_COUNT)
+		return NULL;
+
+	return stage_names[stage];
+}
+
+uint64_t obs_get_gpu_timed_frames(void)
+{
+	if (!obs)
+		return 0;
+
+	return (uint64_t)os_atomic_load_long_long(
+		&obs->video.gpu_timing.source_frames);
+}
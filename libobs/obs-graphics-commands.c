@@ -0,0 +1,194 @@
+#include "util/threading.h"
+#include "obs-internal.h"
+
+/*
+ * Commands are pushed on an intrusive multiple producer, single consumer
+ * queue that only needs an atomic exchange to push, so recording a command
+ * never waits for the graphics thread.  The graphics thread pops them once
+ * per frame, after sources are ticked, and runs them in one graphics
+ * context.  A pop can briefly miss a command whose push is still in
+ * progress, which then runs on the next frame.
+ *
+ * Pushes hold the queue's mutex only to check that a graphics thread is
+ * still popping, which stop_video clears before the last drain, so no
+ * command is left behind once the thread is gone.
+ */
+
+struct obs_graphics_future {
+	volatile long refs;
+	os_event_t *event;
+	volatile bool done;
+};
+
+extern THREAD_LOCAL bool is_graphics_thread;
+
+bool obs_graphics_commands_init(struct obs_graphics_command_queue *queue)
+{
+	queue->stub.next = NULL;
+	queue->head = &queue->stub;
+	queue->tail = &queue->stub;
+	queue->active = false;
+
+	pthread_mutex_init_value(&queue->mutex);
+	return pthread_mutex_init(&queue->mutex, NULL) == 0;
+}
+
+/* runs what is left, which only commands pushed before the queue was
+ * deactivated can be */
+void obs_graphics_commands_free(struct obs_graphics_command_queue *queue)
+{
+	obs_graphics_commands_set_active(queue, false);
+	obs_execute_graphics_commands();
+	pthread_mutex_destroy(&queue->mutex);
+}
+
+void obs_graphics_commands_set_active(struct obs_graphics_command_queue *queue,
+				      bool active)
+{
+	pthread_mutex_lock(&queue->mutex);
+	queue->active = active;
+	pthread_mutex_unlock(&queue->mutex);
+}
+
+static void push_command(struct obs_graphics_command_queue *queue,
+			 struct obs_graphics_command *cmd)
+{
+	struct obs_graphics_command *prev;
+
+	cmd->next = NULL;
+	prev = os_atomic_exchange_ptr((void *volatile *)&queue->head, cmd);
+	os_atomic_exchange_ptr((void *volatile *)&prev->next, cmd);
+}
+
+static struct obs_graphics_command *
+pop_command(struct obs_graphics_command_queue *queue)
+{
+	struct obs_graphics_command *tail = queue->tail;
+	struct obs_graphics_command *next =
+		os_atomic_load_ptr((void *const volatile *)&tail->next);
+
+	if (tail == &queue->stub) {
+		if (!next)
+			return NULL;
+		queue->tail = next;
+		tail = next;
+		next = os_atomic_load_ptr((void *const volatile *)&next->next);
+	}
+
+	if (next) {
+		queue->tail = next;
+		return tail;
+	}
+
+	/* a producer has swapped the head but not linked it yet */
+	if (tail != os_atomic_load_ptr((void *const volatile *)&queue->head))
+		return NULL;
+
+	push_command(queue, &queue->stub);
+
+	next = os_atomic_load_ptr((void *const volatile *)&tail->next);
+	if (next) {
+		queue->tail = next;
+		return tail;
+	}
+
+	return NULL;
+}
+
+static void complete_future(obs_graphics_future_t *future)
+{
+	if (!future)
+		return;
+
+	os_atomic_set_bool(&future->done, true);
+	os_event_signal(future->event);
+	obs_graphics_future_release(future);
+}
+
+static obs_graphics_future_t *create_future(void)
+{
+	obs_graphics_future_t *future = bzalloc(sizeof(*future));
+
+	if (os_event_init(&future->event, OS_EVENT_TYPE_MANUAL) != 0) {
+		bfree(future);
+		return NULL;
+	}
+
+	/* one reference for the caller, one for the queued command */
+	future->refs = 2;
+	return future;
+}
+
+void obs_execute_graphics_commands(void)
+{
+	struct obs_graphics_command_queue *queue = &obs->video.commands;
+	struct obs_graphics_command *cmd = pop_command(queue);
+
+	if (!cmd)
+		return;
+
+	obs_enter_graphics();
+
+	do {
+		cmd->task(cmd->param);
+		complete_future(cmd->future);
+		bfree(cmd);
+	} while ((cmd = pop_command(queue)));
+
+	obs_leave_graphics();
+}
+
+void obs_queue_graphics_command(obs_task_t task, void *param,
+				obs_graphics_future_t **future)
+{
+	struct obs_graphics_command_queue *queue = &obs->video.commands;
+	struct obs_graphics_command *cmd;
+	bool queued;
+
+	if (!obs_ptr_valid(task, "obs_queue_graphics_command"))
+		return;
+
+	cmd = bzalloc(sizeof(*cmd));
+	cmd->task = task;
+	cmd->param = param;
+	cmd->future = future ? create_future() : NULL;
+
+	if (future)
+		*future = cmd->future;
+
+	/* runs right away when nothing would pop it */
+	pthread_mutex_lock(&queue->mutex);
+	queued = queue->active && !is_graphics_thread &&
+		 (!future || cmd->future);
+	if (queued)
+		push_command(queue, cmd);
+	pthread_mutex_unlock(&queue->mutex);
+
+	if (!queued) {
+		obs_enter_graphics();
+		task(param);
+		obs_leave_graphics();
+
+		complete_future(cmd->future);
+		bfree(cmd);
+	}
+}
+
+bool obs_graphics_future_done(const obs_graphics_future_t *future)
+{
+	return !future || os_atomic_load_bool(&future->done);
+}
+
+void obs_graphics_future_wait(obs_graphics_future_t *future)
+{
+	if (future)
+		os_event_wait(future->event);
+}
+
+void obs_graphics_future_release(obs_graphics_future_t *future)
+{
+	if (future && os_atomic_dec_long(&future->refs) == 0) {
+		os_event_destroy(future->event);
+		bfree(future);
+	}
+}
@@ -0,0 +1,175 @@
+#include "obs.h"
+#include "obs-avc.h"
+#include "obs-hevc.h"
+#include "obs-internal.h"
+#include "util/array-serializer.h"
+
+static inline int get_nal_type(const uint8_t *nal)
+{
+	return (nal[0] >> 1) & 0x3F;
+}
+
+static inline bool is_irap(int type)
+{
+	return type >= OBS_HEVC_NAL_BLA_W_LP &&
+	       type <= OBS_HEVC_NAL_RSV_IRAP_23;
+}
+
+static inline bool is_vcl(int type)
+{
+	return type <= OBS_HEVC_NAL_RSV_IRAP_23;
+}
+
+bool obs_hevc_keyframe(const uint8_t *data, size_t size)
+{
+	const uint8_t *nal_start, *nal_end;
+	const uint8_t *end = data + size;
+	int type;
+
+	nal_start = obs_avc_find_startcode(data, end);
+	while (true) {
+		while (nal_start < end && !*(nal_start++))
+			;
+
+		if (nal_start == end)
+			break;
+
+		type = get_nal_type(nal_start);
+
+		if (is_vcl(type))
+			return is_irap(type);
+
+		nal_end = obs_avc_find_startcode(nal_start, end);
+		nal_start = nal_end;
+	}
+
+	return false;
+}
+
+/* even VCL types below 16 are sub-layer non-reference pictures, which nothing
+ * else is predicted from */
+static int get_priority(int type)
+{
+	if (is_irap(type))
+		return OBS_NAL_PRIORITY_HIGHEST;
+	if (type <= OBS_HEVC_NAL_RSV_VCL_N14 && (type & 1) == 0)
+		return OBS_NAL_PRIORITY_DISPOSABLE;
+	return OBS_NAL_PRIORITY_HIGH;
+}
+
+static void serialize_hevc_data(struct serializer *s, const uint8_t *data,
+				size_t size, bool *is_keyframe, int *priority)
+{
+	const uint8_t *nal_start, *nal_end;
+	const uint8_t *end = data + size;
+	int type;
+
+	nal_start = obs_avc_find_startcode(data, end);
+	while (true) {
+		while (nal_start < end && !*(nal_start++))
+			;
+
+		if (nal_start == end)
+			break;
+
+		type = get_nal_type(nal_start);
+
+		if (is_vcl(type)) {
+			if (is_keyframe)
+				*is_keyframe = is_irap(type);
+			if (priority)
+				*priority = get_priority(type);
+		}
+
+		nal_end = obs_avc_find_startcode(nal_start, end);
+		s_wb32(s, (uint32_t)(nal_end - nal_start));
+		s_write(s, nal_start, nal_end - nal_start);
+		nal_start = nal_end;
+	}
+}
+
+void obs_parse_hevc_packet(struct encoder_packet *hevc_packet,
+			   const struct encoder_packet *src)
+{
+	struct array_output_data output;
+	struct serializer s;
+
+	/* the converted packet cache of the encoder isn't specific to AVC,
+	 * an encoder only ever produces one codec */
+	if (src->encoder && src->data &&
+	    obs_encoder_get_cached_avc_packet(src->encoder, src, hevc_packet))
+		return;
+
+	array_output_serializer_init(&s, &output);
+	*hevc_packet = *src;
+
+	serialize_hevc_data(&s, src->data, src->size, &hevc_packet->keyframe,
+			    &hevc_packet->priority);
+
+	hevc_packet->data = obs_packet_pool_alloc(output.bytes.num);
+	hevc_packet->size = output.bytes.num;
+	hevc_packet->drop_priority = hevc_packet->priority;
+	memcpy(hevc_packet->data, output.bytes.array, output.bytes.num);
+
+	array_output_serializer_free(&output);
+
+	if (src->encoder && src->data)
+		obs_encoder_cache_avc_packet(src->encoder, src, hevc_packet);
+}
+
+void obs_extract_hevc_headers(const uint8_t *packet, size_t size,
+			      uint8_t **new_packet_data,
+			      size_t *new_packet_size, uint8_t **header_data,
+			      size_t *header_size, uint8_t **sei_data,
+			      size_t *sei_size)
+{
+	DARRAY(uint8_t) new_packet;
+	DARRAY(uint8_t) header;
+	DARRAY(uint8_t) sei;
+	const uint8_t *nal_start, *nal_end, *nal_codestart;
+	const uint8_t *end = packet + size;
+	int type;
+
+	da_init(new_packet);
+	da_init(header);
+	da_init(sei);
+
+	nal_start = obs_avc_find_startcode(packet, end);
+	nal_end = NULL;
+	while (nal_end != end) {
+		nal_codestart = nal_start;
+
+		while (nal_start < end && !*(nal_start++))
+			;
+
+		if (nal_start == end)
+			break;
+
+		type = get_nal_type(nal_start);
+
+		nal_end = obs_avc_find_startcode(nal_start, end);
+		if (!nal_end)
+			nal_end = end;
+
+		if (type == OBS_HEVC_NAL_VPS || type == OBS_HEVC_NAL_SPS ||
+		    type == OBS_HEVC_NAL_PPS) {
+			da_push_back_array(header, nal_codestart,
+					   nal_end - nal_codestart);
+		} else if (type == OBS_HEVC_NAL_SEI_PREFIX) {
+			da_push_back_array(sei, nal_codestart,
+					   nal_end - nal_codestart);
+		} else {
+			da_push_back_array(new_packet, nal_codestart,
+					   nal_end - nal_codestart);
+		}
+
+		nal_start = nal_end;
+	}
+
+	*new_packet_data = new_packet.array;
+	*new_packet_size = new_packet.num;
+	*header_data = header.array;
+	*header_size = header.num;
+	*sei_data = sei.array;
+	*sei_size = sei.num;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct encoder_packet;
+
+enum { OBS_HEVC_NAL_TRAIL_N = 0,
+       OBS_HEVC_NAL_TRAIL_R = 1,
+       OBS_HEVC_NAL_RSV_VCL_N14 = 14,
+       OBS_HEVC_NAL_BLA_W_LP = 16,
+       OBS_HEVC_NAL_IDR_W_RADL = 19,
+       OBS_HEVC_NAL_IDR_N_LP = 20,
+       OBS_HEVC_NAL_CRA_NUT = 21,
+       OBS_HEVC_NAL_RSV_IRAP_23 = 23,
+       OBS_HEVC_NAL_VPS = 32,
+       OBS_HEVC_NAL_SPS = 33,
+       OBS_HEVC_NAL_PPS = 34,
+       OBS_HEVC_NAL_AUD = 35,
+       OBS_HEVC_NAL_EOS_NUT = 36,
+       OBS_HEVC_NAL_EOB_NUT = 37,
+       OBS_HEVC_NAL_FD_NUT = 38,
+       OBS_HEVC_NAL_SEI_PREFIX = 39,
+       OBS_HEVC_NAL_SEI_SUFFIX = 40,
+};
+
+/* Helpers for parsing HEVC NAL units.  Start codes are the same as in AVC, so
+ * obs_avc_find_startcode is used to split packets. */
+
+EXPORT bool obs_hevc_keyframe(const uint8_t *data, size_t size);
+/* converts to length prefixed NAL units, the priority of the packet is
+ * derived from the NAL type as HEVC has no nal_ref_idc */
+EXPORT void obs_parse_hevc_packet(struct encoder_packet *hevc_packet,
+				  const struct encoder_packet *src);
+/* splits the VPS/SPS/PPS and the SEI NAL units off the first packet of an
+ * encoder, all in annex B form */
+EXPORT void obs_extract_hevc_headers(const uint8_t *packet, size_t size,
+				     uint8_t **new_packet_data,
+				     size_t *new_packet_size,
+				     uint8_t **header_data, size_t *header_size,
+				     uint8_t **sei_data, size_t *sei_size);
+
+#ifdef __cplusplus
+}
+#endif
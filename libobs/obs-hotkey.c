@@ -644,6 +644,7 @@ static inline void create_binding(obs_hotkey_t *hotkey,
 	binding->key = combo;
 	binding->hotkey_id = hotkey->id;
 	binding->hotkey = hotkey;
+	obs->hotkeys.bindings_changed = true;
 }
 
 static inline void load_binding(obs_hotkey_t *hotkey, obs_data_t *data)
@@ -993,6 +994,7 @@ static inline void remove_bindings(obs_hotkey_id id)
 			release_pressed_binding(binding);
 
 		da_erase(obs->hotkeys.bindings, idx);
+		obs->hotkeys.bindings_changed = true;
 	}
 }
 
@@ -1307,6 +1309,7 @@ void obs_hotkey_inject_event(obs_key_combination_t hotkey, bool pressed)
 		obs->hotkeys.strict_modifiers,
 	};
 	enum_bindings(inject_hotkey, &event);
+	obs->hotkeys.bindings_changed = true;
 	unlock();
 }
 
@@ -1316,6 +1319,7 @@ void obs_hotkey_enable_background_press(bool enable)
 		return;
 
 	obs->hotkeys.thread_disable_press = !enable;
+	obs->hotkeys.bindings_changed = true;
 	unlock();
 }
 
@@ -1325,6 +1329,7 @@ void obs_hotkey_enable_strict_modifiers(bool enable)
 		return;
 
 	obs->hotkeys.strict_modifiers = enable;
+	obs->hotkeys.bindings_changed = true;
 	unlock();
 }
 
@@ -1332,8 +1337,24 @@ struct obs_query_hotkeys_helper {
 	uint32_t modifiers;
 	bool no_press;
 	bool strict_modifiers;
+	const uint8_t *key_states;
 };
 
+/* states of the keys queried by a poll; each key is only asked of the
+ * platform once however many bindings use it */
+enum key_state {
+	KEY_UNKNOWN,
+	KEY_UP,
+	KEY_DOWN,
+};
+
+static inline bool query_key(uint8_t *states, obs_key_t key)
+{
+	if (states[key] == KEY_UNKNOWN)
+		states[key] = is_pressed(key) ? KEY_DOWN : KEY_UP;
+	return states[key] == KEY_DOWN;
+}
+
 static inline bool query_hotkey(void *data, size_t idx,
 				obs_hotkey_binding_t *binding)
 {
@@ -1341,28 +1362,61 @@ static inline bool query_hotkey(void *data, size_t idx,
 
 	struct obs_query_hotkeys_helper *param =
 		(struct obs_query_hotkeys_helper *)data;
+	obs_key_t key = binding->key.key;
+	bool pressed = key > OBS_KEY_NONE && key < OBS_KEY_LAST_VALUE &&
+		       param->key_states[key] == KEY_DOWN;
+	bool was_pressed = binding->pressed;
+	bool modifiers_matched = binding->modifiers_match;
+
 	handle_binding(binding, param->modifiers, param->no_press,
-		       param->strict_modifiers, NULL);
+		       param->strict_modifiers, &pressed);
+
+	/* bindings can take more than one poll to settle, for example when
+	 * the key was pressed before its modifiers */
+	if (binding->pressed != was_pressed ||
+	    binding->modifiers_match != modifiers_matched)
+		obs->hotkeys.bindings_changed = true;
 
 	return true;
 }
 
 static inline void query_hotkeys()
 {
+	struct obs_core_hotkeys *hotkeys = &obs->hotkeys;
+	uint8_t states[OBS_KEY_LAST_VALUE] = {0};
 	uint32_t modifiers = 0;
-	if (is_pressed(OBS_KEY_SHIFT))
+
+	if (query_key(states, OBS_KEY_SHIFT))
 		modifiers |= INTERACT_SHIFT_KEY;
-	if (is_pressed(OBS_KEY_CONTROL))
+	if (query_key(states, OBS_KEY_CONTROL))
 		modifiers |= INTERACT_CONTROL_KEY;
-	if (is_pressed(OBS_KEY_ALT))
+	if (query_key(states, OBS_KEY_ALT))
 		modifiers |= INTERACT_ALT_KEY;
-	if (is_pressed(OBS_KEY_META))
+	if (query_key(states, OBS_KEY_META))
 		modifiers |= INTERACT_COMMAND_KEY;
 
+	for (size_t i = 0; i < hotkeys->bindings.num; i++) {
+		obs_key_t key = hotkeys->bindings.array[i].key.key;
+		if (key > OBS_KEY_NONE && key < OBS_KEY_LAST_VALUE)
+			query_key(states, key);
+	}
+
+	/* handling the bindings again with the same input would change
+	 * nothing once they have settled */
+	if (!hotkeys->bindings_changed &&
+	    modifiers == hotkeys->last_modifiers &&
+	    memcmp(states, hotkeys->key_states, sizeof(states)) == 0)
+		return;
+
+	memcpy(hotkeys->key_states, states, sizeof(states));
+	hotkeys->last_modifiers = modifiers;
+	hotkeys->bindings_changed = false;
+
 	struct obs_query_hotkeys_helper param = {
 		modifiers,
-		obs->hotkeys.thread_disable_press,
-		obs->hotkeys.strict_modifiers,
+		hotkeys->thread_disable_press,
+		hotkeys->strict_modifiers,
+		states,
 	};
 	enum_bindings(query_hotkey, &param);
 }
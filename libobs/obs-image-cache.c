@@ -0,0 +1,635 @@
+#include <inttypes.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "graphics/texture-compress.h"
+#include "util/platform.h"
+#include "util/dstr.h"
+#include "obs-internal.h"
+
+/*
+ * Shared cache of decoded still images.
+ *
+ * Files are decoded on the task pool, which needs no graphics context, then
+ * turned into a texture by the first render that wants them.  Images are shared by path and modification time, and ones without
+ * references are kept until the cache exceeds its limit so that re-showing an
+ * image (or cycling a slideshow) does not decode it again.  Evicted images
+ * keep their size, which lets the slideshow lay itself out without holding
+ * every file in memory.
+ *
+ * With compression enabled, images whose size is a multiple of the block size
+ * are block compressed after decoding, still on the task pool, which takes
+ * their memory down to an eighth (opaque) or a quarter (with alpha).  The
+ * compressed data is also written to the disk cache, if there is one, and
+ * read back instead of decoding and compressing again, as long as the file
+ * has not been modified since.
+ *
+ * The cache lock may be taken inside the graphics context, but the graphics
+ * context is never entered while it is held.
+ */
+
+#define IMAGE_CACHE_DEFAULT_LIMIT (512ULL * 1024ULL * 1024ULL)
+
+struct obs_image {
+	char *path;
+	time_t mtime;
+	long refs;
+	uint64_t last_use;
+
+	bool queued;
+	bool loaded;
+	bool failed;
+	bool stale;
+
+	enum gs_color_format format;
+	uint32_t cx, cy;
+	uint8_t *data;
+	gs_texture_t *texture;
+	uint64_t bytes;
+};
+
+typedef DARRAY(gs_texture_t *) texture_list_t;
+
+static time_t get_mtime(const char *path)
+{
+	struct stat st;
+	if (os_stat(path, &st) != 0)
+		return -1;
+	return st.st_mtime;
+}
+
+static inline struct obs_image_cache *get_cache(void)
+{
+	return obs && obs->image_cache.initialized ? &obs->image_cache : NULL;
+}
+
+static void destroy_textures(texture_list_t *textures)
+{
+	if (!textures->num)
+		return;
+
+	obs_enter_graphics();
+	for (size_t i = 0; i < textures->num; i++)
+		gs_texture_destroy(textures->array[i]);
+	obs_leave_graphics();
+
+	da_free((*textures));
+}
+
+/* assumes mutex */
+static void drop_pixels(struct obs_image_cache *cache, struct obs_image *image,
+			texture_list_t *textures)
+{
+	if (image->texture)
+		da_push_back((*textures), &image->texture);
+
+	bfree(image->data);
+	image->data = NULL;
+	image->texture = NULL;
+	image->loaded = false;
+
+	cache->bytes -= image->bytes;
+	image->bytes = 0;
+}
+
+/* assumes mutex */
+static void remove_image(struct obs_image_cache *cache, struct obs_image *image,
+			 texture_list_t *textures)
+{
+	drop_pixels(cache, image, textures);
+	da_erase_item(cache->queue, &image);
+	da_erase_item(cache->images, &image);
+	bfree(image->path);
+	bfree(image);
+}
+
+/* assumes mutex */
+static void evict(struct obs_image_cache *cache, texture_list_t *textures)
+{
+	while (cache->bytes > cache->limit) {
+		struct obs_image *oldest = NULL;
+
+		for (size_t i = 0; i < cache->images.num; i++) {
+			struct obs_image *image = cache->images.array[i];
+			if (image->refs || !image->bytes)
+				continue;
+			if (!oldest || image->last_use < oldest->last_use)
+				oldest = image;
+		}
+
+		if (!oldest)
+			break;
+
+		drop_pixels(cache, oldest, textures);
+	}
+}
+
+#define DISK_CACHE_MAGIC 0x5843424F /* "OBCX" */
+#define DISK_CACHE_VERSION 1
+
+struct disk_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	int64_t mtime;
+	uint32_t cx;
+	uint32_t cy;
+	uint32_t format;
+	uint32_t path_len;
+};
+
+static void get_disk_cache_file(struct dstr *file, const char *disk_path,
+				const char *path)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	while (*path)
+		hash = (hash ^ (uint8_t)*path++) * 1099511628211ULL;
+
+	dstr_printf(file, "%s/%016" PRIx64 ".tex", disk_path, hash);
+}
+
+static uint8_t *read_disk_cache(const char *disk_path, const char *path,
+				time_t mtime, enum gs_color_format *format,
+				uint32_t *cx, uint32_t *cy)
+{
+	struct disk_cache_header header;
+	struct dstr file = {0};
+	size_t path_len = strlen(path);
+	uint8_t *data = NULL;
+	char *cached_path = NULL;
+	size_t size;
+	FILE *f;
+
+	get_disk_cache_file(&file, disk_path, path);
+	f = os_fopen(file.array, "rb");
+	dstr_free(&file);
+	if (!f)
+		return NULL;
+
+	if (fread(&header, sizeof(header), 1, f) != 1)
+		goto fail;
+	if (header.magic != DISK_CACHE_MAGIC ||
+	    header.version != DISK_CACHE_VERSION ||
+	    header.mtime != (int64_t)mtime || header.path_len != path_len)
+		goto fail;
+	if (header.format != GS_DXT1 && header.format != GS_DXT5)
+		goto fail;
+
+	/* files of different paths can share a name */
+	cached_path = bmalloc(path_len);
+	if (fread(cached_path, 1, path_len, f) != path_len ||
+	    memcmp(cached_path, path, path_len) != 0)
+		goto fail;
+
+	size = gs_get_compressed_size(header.format, header.cx, header.cy);
+	if (!size ||
+	    os_fgetsize(f) != (int64_t)(sizeof(header) + path_len + size))
+		goto fail;
+
+	data = bmalloc(size);
+	if (fread(data, 1, size, f) != size) {
+		bfree(data);
+		data = NULL;
+		goto fail;
+	}
+
+	*format = (enum gs_color_format)header.format;
+	*cx = header.cx;
+	*cy = header.cy;
+
+fail:
+	bfree(cached_path);
+	fclose(f);
+	return data;
+}
+
+static void write_disk_cache(const char *disk_path, const char *path,
+			     time_t mtime, enum gs_color_format format,
+			     uint32_t cx, uint32_t cy, const uint8_t *data)
+{
+	struct disk_cache_header header = {0};
+	size_t size = gs_get_compressed_size(format, cx, cy);
+	struct dstr file = {0};
+	struct dstr temp = {0};
+	bool success;
+	FILE *f;
+
+	header.magic = DISK_CACHE_MAGIC;
+	header.version = DISK_CACHE_VERSION;
+	header.mtime = (int64_t)mtime;
+	header.cx = cx;
+	header.cy = cy;
+	header.format = (uint32_t)format;
+	header.path_len = (uint32_t)strlen(path);
+
+	os_mkdirs(disk_path);
+	get_disk_cache_file(&file, disk_path, path);
+	dstr_copy_dstr(&temp, &file);
+	dstr_cat(&temp, ".tmp");
+
+	f = os_fopen(temp.array, "wb");
+	if (!f) {
+		blog(LOG_WARNING, "Image cache: could not write '%s'",
+		     temp.array);
+		goto free;
+	}
+
+	success = fwrite(&header, sizeof(header), 1, f) == 1 &&
+		  fwrite(path, 1, header.path_len, f) == header.path_len &&
+		  fwrite(data, 1, size, f) == size;
+	fclose(f);
+
+	if (!success || os_safe_replace(file.array, temp.array, NULL) != 0)
+		os_unlink(temp.array);
+
+free:
+	dstr_free(&file);
+	dstr_free(&temp);
+}
+
+/* frees the decoded pixels if they could be compressed */
+static uint8_t *compress_image(uint8_t *data, enum gs_color_format *format,
+			       uint32_t cx, uint32_t cy)
+{
+	enum gs_color_format out_format;
+	uint8_t *out;
+
+	if (!gs_can_compress_texture(*format, cx, cy))
+		return data;
+
+	out_format = gs_get_compressed_format(data, cx * 4, *format, cx, cy);
+	out = bmalloc(gs_get_compressed_size(out_format, cx, cy));
+	gs_compress_texture_data(out, out_format, data, cx * 4, *format, cx,
+				 cy);
+
+	bfree(data);
+	*format = out_format;
+	return out;
+}
+
+static uint8_t *load_image_data(const char *path, time_t mtime, bool compress,
+				const char *disk_path,
+				enum gs_color_format *format, uint32_t *cx,
+				uint32_t *cy)
+{
+	uint8_t *data = NULL;
+
+	if (compress && disk_path)
+		data = read_disk_cache(disk_path, path, mtime, format, cx, cy);
+	if (data)
+		return data;
+
+	data = gs_create_texture_file_data(path, format, cx, cy);
+	if (!data || !compress)
+		return data;
+
+	data = compress_image(data, format, *cx, *cy);
+	if (disk_path && gs_is_compressed_format(*format))
+		write_disk_cache(disk_path, path, mtime, *format, *cx, *cy,
+				 data);
+	return data;
+}
+
+/* every queued image queues one task, which decodes whichever image is at
+ * the front of the queue by then, so urgent images go first */
+static void image_decode_task(void *param)
+{
+	struct obs_image_cache *cache = param;
+	texture_list_t textures = {0};
+	struct obs_image *image;
+	enum gs_color_format format;
+	uint32_t cx = 0, cy = 0;
+	char *disk_path;
+	uint8_t *data;
+	time_t mtime;
+	bool compress;
+	char *path;
+
+	pthread_mutex_lock(&cache->mutex);
+	if (cache->stop || !cache->queue.num) {
+		pthread_mutex_unlock(&cache->mutex);
+		return;
+	}
+
+	/* held so the image cannot be removed while decoding */
+	image = cache->queue.array[0];
+	image->refs++;
+	da_erase(cache->queue, 0);
+	path = bstrdup(image->path);
+	mtime = image->mtime;
+	compress = cache->compress;
+	disk_path = bstrdup(cache->disk_path);
+	pthread_mutex_unlock(&cache->mutex);
+
+	data = load_image_data(path, mtime, compress, disk_path, &format, &cx,
+			       &cy);
+
+	pthread_mutex_lock(&cache->mutex);
+	image->queued = false;
+	image->loaded = true;
+	image->failed = !data;
+
+	if (data) {
+		image->data = data;
+		image->format = format;
+		image->cx = cx;
+		image->cy = cy;
+		image->bytes =
+			(uint64_t)cx * cy * gs_get_format_bpp(format) / 8;
+		cache->bytes += image->bytes;
+	}
+
+	if (--image->refs == 0 && image->stale)
+		remove_image(cache, image, &textures);
+	else
+		evict(cache, &textures);
+	pthread_mutex_unlock(&cache->mutex);
+
+	if (!data)
+		blog(LOG_WARNING, "Failed to decode image '%s'", path);
+
+	bfree(path);
+	bfree(disk_path);
+	destroy_textures(&textures);
+}
+
+/* assumes mutex */
+static void queue_image(struct obs_image_cache *cache, struct obs_image *image,
+			bool urgent)
+{
+	if (image->queued) {
+		if (urgent) {
+			da_erase_item(cache->queue, &image);
+			da_insert(cache->queue, 0, &image);
+		}
+		return;
+	}
+
+	image->queued = true;
+	image->failed = false;
+
+	if (urgent)
+		da_insert(cache->queue, 0, &image);
+	else
+		da_push_back(cache->queue, &image);
+	obs_task_group_queue(cache->group, OBS_TASK_PRIORITY_LOW,
+			     image_decode_task, cache);
+}
+
+/* assumes mutex */
+static struct obs_image *find_image(struct obs_image_cache *cache,
+				    const char *path, time_t mtime,
+				    texture_list_t *textures)
+{
+	struct obs_image *found = NULL;
+
+	for (size_t i = cache->images.num; i > 0; i--) {
+		struct obs_image *image = cache->images.array[i - 1];
+		if (strcmp(image->path, path) != 0)
+			continue;
+
+		if (image->mtime == mtime) {
+			found = image;
+		} else if (!image->refs) {
+			remove_image(cache, image, textures);
+		} else {
+			image->stale = true;
+		}
+	}
+
+	if (!found) {
+		found = bzalloc(sizeof(struct obs_image));
+		found->path = bstrdup(path);
+		found->mtime = mtime;
+		da_push_back(cache->images, &found);
+	}
+
+	return found;
+}
+
+static struct obs_image *lookup(const char *path, bool ref)
+{
+	struct obs_image_cache *cache = get_cache();
+	texture_list_t textures = {0};
+	struct obs_image *image;
+	time_t mtime;
+
+	if (!cache || !path || !*path)
+		return NULL;
+
+	mtime = get_mtime(path);
+
+	pthread_mutex_lock(&cache->mutex);
+	image = find_image(cache, path, mtime, &textures);
+	if (ref) {
+		image->refs++;
+		image->last_use = ++cache->last_use;
+	}
+
+	if (!image->loaded)
+		queue_image(cache, image, ref);
+	pthread_mutex_unlock(&cache->mutex);
+
+	destroy_textures(&textures);
+	return image;
+}
+
+obs_image_t *obs_image_cache_get(const char *path)
+{
+	return lookup(path, true);
+}
+
+void obs_image_cache_prefetch(const char *path)
+{
+	lookup(path, false);
+}
+
+void obs_image_release(obs_image_t *image)
+{
+	struct obs_image_cache *cache = get_cache();
+	texture_list_t textures = {0};
+
+	if (!cache || !image)
+		return;
+
+	pthread_mutex_lock(&cache->mutex);
+	if (--image->refs == 0) {
+		if (image->stale)
+			remove_image(cache, image, &textures);
+		else if (image->texture && obs_get_gpu_memory_budget())
+			/* with a budget, VRAM is only counted while sources
+			 * hold the image */
+			drop_pixels(cache, image, &textures);
+		else
+			evict(cache, &textures);
+	}
+	pthread_mutex_unlock(&cache->mutex);
+
+	destroy_textures(&textures);
+}
+
+bool obs_image_cache_get_size(const char *path, uint32_t *cx, uint32_t *cy)
+{
+	struct obs_image_cache *cache = get_cache();
+	bool found = false;
+
+	if (!cache || !path)
+		return false;
+
+	pthread_mutex_lock(&cache->mutex);
+	for (size_t i = cache->images.num; i > 0; i--) {
+		struct obs_image *image = cache->images.array[i - 1];
+		if ((image->cx || image->failed) &&
+		    strcmp(image->path, path) == 0) {
+			*cx = image->cx;
+			*cy = image->cy;
+			found = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&cache->mutex);
+
+	return found;
+}
+
+void obs_image_cache_set_limit(uint64_t bytes)
+{
+	struct obs_image_cache *cache = get_cache();
+	texture_list_t textures = {0};
+
+	if (!cache)
+		return;
+
+	pthread_mutex_lock(&cache->mutex);
+	cache->limit = bytes;
+	evict(cache, &textures);
+	pthread_mutex_unlock(&cache->mutex);
+
+	destroy_textures(&textures);
+}
+
+void obs_image_cache_set_compression(bool enabled, const char *disk_path)
+{
+	struct obs_image_cache *cache = get_cache();
+
+	if (!cache)
+		return;
+
+	pthread_mutex_lock(&cache->mutex);
+	cache->compress = enabled;
+	bfree(cache->disk_path);
+	cache->disk_path = disk_path && *disk_path ? bstrdup(disk_path) : NULL;
+	pthread_mutex_unlock(&cache->mutex);
+}
+
+#define IMAGE_GETTER(type, name, expr, def)                    \
+	type obs_image_##name(const obs_image_t *image)        \
+	{                                                      \
+		struct obs_image_cache *cache = get_cache();   \
+		type val;                                      \
+		if (!cache || !image)                          \
+			return def;                            \
+		pthread_mutex_lock(&cache->mutex);             \
+		val = (expr);                                  \
+		pthread_mutex_unlock(&cache->mutex);           \
+		return val;                                    \
+	}
+
+IMAGE_GETTER(bool, loaded, image->loaded || image->failed, false)
+IMAGE_GETTER(bool, failed, image->failed, false)
+IMAGE_GETTER(uint32_t, get_width, image->cx, 0)
+IMAGE_GETTER(uint32_t, get_height, image->cy, 0)
+IMAGE_GETTER(uint64_t, get_memory_usage, image->bytes, 0)
+
+#undef IMAGE_GETTER
+
+gs_texture_t *obs_image_get_texture(obs_image_t *image)
+{
+	struct obs_image_cache *cache = get_cache();
+	gs_texture_t *tex;
+
+	if (!cache || !image)
+		return NULL;
+
+	pthread_mutex_lock(&cache->mutex);
+
+	if (!image->texture && image->data) {
+		image->texture = gs_texture_create(
+			image->cx, image->cy, image->format, 1,
+			(const uint8_t **)&image->data, 0);
+
+		/* the texture is immutable, the pixels are not needed again,
+		 * and compressed pixels that the renderer does not support
+		 * cannot be used at all */
+		if (image->texture ||
+		    gs_is_compressed_format(image->format)) {
+			bfree(image->data);
+			image->data = NULL;
+		}
+
+		if (!image->texture && !image->data) {
+			blog(LOG_WARNING,
+			     "Image cache: could not create a compressed "
+			     "texture for '%s'",
+			     image->path);
+			cache->bytes -= image->bytes;
+			image->bytes = 0;
+			image->failed = true;
+		}
+	}
+
+	image->last_use = ++cache->last_use;
+	tex = image->texture;
+
+	pthread_mutex_unlock(&cache->mutex);
+	return tex;
+}
+
+bool obs_image_cache_init(struct obs_image_cache *cache)
+{
+	memset(cache, 0, sizeof(*cache));
+
+	if (pthread_mutex_init(&cache->mutex, NULL) != 0)
+		return false;
+
+	cache->group = obs_task_group_create();
+	if (!cache->group) {
+		pthread_mutex_destroy(&cache->mutex);
+		return false;
+	}
+
+	cache->limit = IMAGE_CACHE_DEFAULT_LIMIT;
+	cache->initialized = true;
+	return true;
+}
+
+void obs_image_cache_free(struct obs_image_cache *cache)
+{
+	texture_list_t textures = {0};
+
+	if (!cache->initialized)
+		return;
+
+	pthread_mutex_lock(&cache->mutex);
+	cache->stop = true;
+	pthread_mutex_unlock(&cache->mutex);
+
+	obs_task_group_cancel(cache->group);
+	obs_task_group_destroy(cache->group);
+
+	if (cache->images.num)
+		blog(LOG_DEBUG, "Image cache: %zu images (%" PRIu64
+				" bytes) freed at shutdown",
+		     cache->images.num, cache->bytes);
+
+	while (cache->images.num)
+		remove_image(cache, cache->images.array[cache->images.num - 1],
+			     &textures);
+	destroy_textures(&textures);
+
+	da_free(cache->images);
+	da_free(cache->queue);
+	bfree(cache->disk_path);
+	pthread_mutex_destroy(&cache->mutex);
+	cache->initialized = false;
+}
@@ -20,6 +20,7 @@
 #include "util/c99defs.h"
 #include "util/darray.h"
 #include "util/circlebuf.h"
+#include "util/spsc-ring.h"
 #include "util/dstr.h"
 #include "util/threading.h"
 #include "util/platform.h"
@@ -38,7 +39,9 @@
 
 #include <caption/caption.h>
 
-#define NUM_TEXTURES 2
+#define NUM_TEXTURES 4
+#define MIN_READBACK_DEPTH 2
+#define READBACK_SHRINK_FRAMES 300
 #define NUM_CHANNELS 3
 #define MICROSECOND_DEN 1000000
 #define NUM_ENCODE_TEXTURES 3
@@ -102,12 +105,21 @@ struct obs_module {
 	const char *(*name)(void);
 	const char *(*description)(void);
 	const char *(*author)(void);
+	uint32_t (*load_flags)(void);
+	const char *const *(*types)(void);
+
+	/* loaded once one of its types is looked up */
+	volatile bool deferred;
 
 	struct obs_module *next;
 };
 
 extern void free_module(struct obs_module *mod);
 
+/* loads the deferred module that provides the type, if there is one.
+ * returns true if a module was loaded */
+extern bool obs_load_module_for_type(const char *id);
+
 struct obs_module_path {
 	char *bin;
 	char *data;
@@ -205,6 +217,9 @@ extern void obs_view_free(struct obs_view *view);
 struct obs_display {
 	bool size_changed;
 	bool enabled;
+	bool occluded;
+	uint32_t max_fps;
+	uint64_t next_render_time;
 	uint32_t cx, cy;
 	uint32_t background_color;
 	gs_swapchain_t *swap;
@@ -243,32 +258,52 @@ struct obs_task_info {
 	void *param;
 };
 
-struct obs_core_video {
-	graphics_t *graphics;
+#define NUM_HELD_FRAMES 4
+
+/* staging surfaces whose mapping was handed to the video output instead of
+ * being copied, until the output releases them */
+struct obs_held_frame {
+	gs_stagesurf_t *surfaces[NUM_CHANNELS];
+	volatile bool released;
+	bool held;
+};
+
+struct obs_core_video_mix {
+	struct obs_view *view;
+
 	gs_stagesurf_t *copy_surfaces[NUM_TEXTURES][NUM_CHANNELS];
 	gs_texture_t *render_texture;
 	gs_texture_t *output_texture;
 	gs_texture_t *convert_textures[NUM_CHANNELS];
 	bool texture_rendered;
-	bool textures_copied[NUM_TEXTURES];
 	bool texture_converted;
 	bool using_nv12_tex;
 	struct circlebuf vframe_info_buffer;
 	struct circlebuf vframe_info_buffer_gpu;
-	gs_effect_t *default_effect;
-	gs_effect_t *default_rect_effect;
-	gs_effect_t *opaque_effect;
-	gs_effect_t *solid_effect;
-	gs_effect_t *repeat_effect;
-	gs_effect_t *conversion_effect;
-	gs_effect_t *bicubic_effect;
-	gs_effect_t *lanczos_effect;
-	gs_effect_t *area_effect;
-	gs_effect_t *bilinear_lowres_effect;
-	gs_effect_t *premultiplied_alpha_effect;
-	gs_samplerstate_t *point_sampler;
 	gs_stagesurf_t *mapped_surfaces[NUM_CHANNELS];
-	int cur_texture;
+
+	/* staging ring: frames are only mapped once their copy has finished,
+	 * unless readback_depth frames are already in flight */
+	int staged_head;
+	int staged_count;
+	int readback_depth;
+	int readback_fast_frames;
+
+	/* with pipelined output, the copy of the frame mapped last, which keeps
+	 * it mapped until the group is done */
+	obs_task_group_t *output_group;
+	struct video_data output_data;
+	int output_count;
+	struct obs_held_frame *output_held;
+
+	/* frames the video output still reads from their staging surfaces,
+	 * and the sets of surfaces that took their place in the ring, created
+	 * once they are first needed */
+	struct obs_held_frame held_frames[NUM_HELD_FRAMES];
+
+	/* splits line by line copies of large planes across the task pool */
+	obs_task_group_t *copy_group;
+
 	long raw_active;
 	long gpu_encoder_active;
 	pthread_mutex_t gpu_encoder_mutex;
@@ -281,15 +316,12 @@ struct obs_core_video {
 	bool gpu_encode_thread_initialized;
 	volatile bool gpu_encode_stop;
 
-	uint64_t video_time;
-	uint64_t video_frame_interval_ns;
-	uint64_t video_avg_frame_time_ns;
-	double video_fps;
 	video_t *video;
-	pthread_t video_thread;
-	uint32_t total_frames;
-	uint32_t lagged_frames;
-	bool thread_initialized;
+
+	/* per-tick state, only touched by the graphics thread */
+	bool raw_was_active;
+	bool gpu_was_active;
+	bool was_active;
 
 	bool gpu_conversion;
 	const char *conversion_techs[NUM_CHANNELS];
@@ -303,6 +335,243 @@ struct obs_core_video {
 	float color_matrix[16];
 	enum obs_scale_type scale_type;
 
+	struct obs_video_info ovi;
+
+	/* set for canvases that only rescale the render texture of another
+	 * canvas, shared by every encoder using the same size */
+	struct obs_core_video_mix *source_mix;
+	long scaled_refs;
+};
+
+extern int obs_init_video_mix(struct obs_core_video_mix *video,
+			      struct obs_view *view,
+			      const struct obs_video_info *ovi);
+extern void obs_free_video_mix(struct obs_core_video_mix *video);
+extern bool obs_create_copy_surfaces(struct obs_core_video_mix *video,
+				     gs_stagesurf_t **surfaces);
+extern struct obs_core_video_mix *get_mix_for_video(video_t *v);
+
+/* returns a canvas that scales the output of video to width x height on the
+ * GPU, or NULL if it has to be scaled on the CPU instead.  must be released
+ * with obs_release_scaled_video */
+extern video_t *obs_get_scaled_video(video_t *video, uint32_t width,
+				     uint32_t height);
+extern void obs_release_scaled_video(video_t *scaled);
+
+/* lock-free duration histogram exported by obs_get_openmetrics; bucket i
+ * counts durations up to 250us << i, the last bucket everything above */
+#define OBS_HISTOGRAM_BUCKETS 14
+
+struct obs_histogram {
+	volatile long long buckets[OBS_HISTOGRAM_BUCKETS + 1];
+	volatile long long sum_ns;
+};
+
+extern void obs_histogram_observe(struct obs_histogram *hist, uint64_t ns);
+
+/* written by one thread only, see obs_get_telemetry */
+struct obs_telemetry_ring {
+	struct obs_telemetry_sample samples[OBS_TELEMETRY_SAMPLES];
+	volatile long long written;
+};
+
+extern void obs_telemetry_push(struct obs_telemetry_ring *ring,
+			       const struct obs_telemetry_sample *sample);
+
+/* see obs-task-pool.c */
+struct obs_pool_task {
+	obs_task_t task;
+	void *param;
+	struct obs_task_group *group;
+};
+
+struct obs_task_worker {
+	struct obs_task_pool *pool;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	struct circlebuf tasks;
+};
+
+#define OBS_TASK_PRIORITIES 3
+
+struct obs_task_pool {
+	struct obs_task_worker *workers;
+	size_t num_workers;
+
+	pthread_mutex_t mutex;
+	struct circlebuf queues[OBS_TASK_PRIORITIES];
+	os_sem_t *sem;
+	volatile bool stop;
+	bool initialized;
+};
+
+extern bool obs_task_pool_init(struct obs_task_pool *pool);
+extern void obs_task_pool_free(struct obs_task_pool *pool);
+
+/* runs the sources flagged with OBS_SOURCE_PARALLEL_TICK on the task pool;
+ * the graphics thread fills the source list, runs a share of the ticks itself
+ * and waits for the rest before it renders */
+struct obs_tick_pool {
+	obs_task_group_t *group;
+	size_t num_threads;
+
+	DARRAY(struct obs_source *) sources;
+	float seconds;
+	volatile long next_source;
+};
+
+extern bool obs_tick_pool_init(struct obs_tick_pool *pool);
+extern void obs_tick_pool_free(struct obs_tick_pool *pool);
+extern void obs_tick_pool_run(struct obs_tick_pool *pool, float seconds);
+
+struct obs_fused_effect {
+	char *key;
+	/* NULL if the combined code failed to compile */
+	gs_effect_t *effect;
+};
+
+extern void obs_free_fused_effects(void);
+
+#define OBS_GPU_TIMER_FRAMES 4
+
+struct obs_gpu_timer_frame {
+	gs_timer_range_t *range;
+	gs_timer_t *timers[OBS_GPU_STAGE_COUNT];
+	uint32_t used;
+	bool pending;
+
+	/* timers of the sources rendered in the frame, kept between frames,
+	 * and the source each of the first sources.num timers was used by */
+	DARRAY(gs_timer_t *) source_timers;
+	DARRAY(obs_weak_source_t *) sources;
+};
+
+struct obs_gpu_stage_counters {
+	volatile long long count;
+	volatile long long total_ns;
+	volatile long long max_ns;
+};
+
+/* the timers are only used on the graphics thread, the counters and
+ * histograms are read by any thread */
+struct obs_gpu_timing {
+	volatile bool enabled;
+	bool unsupported;
+
+	struct obs_gpu_timer_frame frames[OBS_GPU_TIMER_FRAMES];
+	struct obs_gpu_timer_frame *active;
+	size_t cur_frame;
+
+	struct obs_gpu_stage_counters stages[OBS_GPU_STAGE_COUNT];
+	struct obs_histogram hist[OBS_GPU_STAGE_COUNT];
+
+	/* frames whose source times have been added to the sources, never
+	 * reset, like the times of the sources */
+	volatile long long source_frames;
+};
+
+extern bool obs_gpu_timing_begin_frame(void);
+extern void obs_gpu_timing_end_frame(void);
+extern void obs_gpu_timing_begin(enum obs_gpu_stage stage);
+extern void obs_gpu_timing_end(enum obs_gpu_stage stage);
+extern gs_timer_t *obs_gpu_timing_begin_source(obs_source_t *source);
+extern void obs_gpu_timing_end_source(gs_timer_t *timer);
+extern void obs_gpu_timing_free(void);
+
+struct obs_graphics_command {
+	struct obs_graphics_command *volatile next;
+	obs_task_t task;
+	void *param;
+	obs_graphics_future_t *future;
+};
+
+/* pushed to from any thread, popped only by the graphics thread */
+struct obs_graphics_command_queue {
+	struct obs_graphics_command *volatile head;
+	struct obs_graphics_command *tail;
+	struct obs_graphics_command stub;
+
+	/* commands are only pushed while a graphics thread pops them */
+	pthread_mutex_t mutex;
+	bool active;
+};
+
+struct obs_core_video {
+	graphics_t *graphics;
+	gs_effect_t *default_effect;
+	gs_effect_t *default_rect_effect;
+	gs_effect_t *opaque_effect;
+	gs_effect_t *solid_effect;
+	gs_effect_t *repeat_effect;
+	gs_effect_t *conversion_effect;
+	gs_effect_t *bicubic_effect;
+	gs_effect_t *lanczos_effect;
+	gs_effect_t *area_effect;
+	gs_effect_t *bilinear_lowres_effect;
+	gs_effect_t *premultiplied_alpha_effect;
+	gs_samplerstate_t *point_sampler;
+
+	/* the main canvas is always mixes.array[0] while video is active;
+	 * additional canvases are attached through obs_view_add2 */
+	struct obs_core_video_mix *main_mix;
+	pthread_mutex_t mixes_mutex;
+	DARRAY(struct obs_core_video_mix *) mixes;
+
+	uint64_t video_time;
+	uint64_t video_frame_interval_ns;
+	uint64_t video_avg_frame_time_ns;
+	double video_fps;
+
+	/* low priority sources are skipped in displays while over budget,
+	 * only the budget itself is accessed outside the graphics thread */
+	volatile long long render_budget_ns;
+	bool render_budget_exceeded;
+	uint32_t render_budget_calm_frames;
+	bool rendering_displays;
+
+	/* frames are copied to the video outputs on the task pool while the
+	 * graphics thread moves on to the next frame */
+	volatile bool pipelined_output;
+
+	/* with idle_rendering enabled, sources are only ticked at a low rate
+	 * and nothing is rendered while no output or display uses video;
+	 * idle_event wakes the graphics thread when one starts */
+	volatile bool idle_rendering;
+	volatile bool idle;
+	os_event_t *idle_event;
+
+	/* graphics thread only, whether the last frame was rendered offline */
+	bool rendering_offline;
+
+	/* audio-only mode, where there are no mixes and the video thread only
+	 * ticks sources and repeats a still frame on cover_video */
+	video_t *cover_video;
+	struct obs_video_info cover_ovi;
+	uint8_t *cover_frame;
+
+	pthread_t video_thread;
+	uint32_t total_frames;
+	uint32_t lagged_frames;
+	/* counts graphics ticks, what sources render is memoized per tick */
+	uint64_t render_frame;
+	bool thread_initialized;
+
+	struct obs_tick_pool tick_pool;
+
+	struct obs_histogram frame_time_hist;
+	struct obs_histogram tick_hist;
+	struct obs_histogram output_frame_hist;
+	struct obs_histogram render_displays_hist;
+	struct obs_histogram sleep_jitter_hist;
+	struct obs_telemetry_ring telemetry;
+	uint32_t telemetry_skipped;
+
+	struct obs_gpu_timing gpu_timing;
+
+	/* incremented when the device is rebuilt and render targets lose
+	 * their contents */
+	volatile long device_rebuilds;
+
 	gs_texture_t *transparent_texture;
 
 	gs_effect_t *deinterlace_discard_effect;
@@ -314,16 +583,56 @@ struct obs_core_video {
 	gs_effect_t *deinterlace_yadif_effect;
 	gs_effect_t *deinterlace_yadif_2x_effect;
 
-	struct obs_video_info ovi;
+	/* graphics thread only */
+	DARRAY(struct obs_fused_effect) fused_effects;
 
 	pthread_mutex_t task_mutex;
 	struct circlebuf tasks;
+
+	struct obs_graphics_command_queue commands;
 };
 
 struct audio_monitor;
 
+/* runs the queued audio filters of each source and renders the sources that
+ * do not mix other sources on the task pool, with the audio thread taking a
+ * share of the work before it mixes */
+struct obs_audio_pool {
+	obs_task_group_t *group;
+	size_t num_threads;
+
+	DARRAY(struct obs_source *) sources;
+	void (*task)(struct obs_source *source, void *param);
+	void *param;
+	volatile long next_source;
+};
+
+extern bool obs_audio_pool_init(struct obs_audio_pool *pool);
+extern void obs_audio_pool_free(struct obs_audio_pool *pool);
+extern void obs_audio_pool_run(struct obs_audio_pool *pool,
+			       void (*task)(struct obs_source *source,
+					    void *param),
+			       void *param);
+
+/* thread that computes the levels of the volume meters from the audio their
+ * capture callbacks queue, see obs-audio-controls.c */
+struct obs_meter_service {
+	pthread_t thread;
+	bool thread_active;
+	os_event_t *stop_event;
+
+	pthread_mutex_t mutex;
+	DARRAY(struct obs_volmeter *) meters;
+	float *scratch;
+};
+
+extern bool obs_meter_service_init(struct obs_meter_service *service);
+extern void obs_meter_service_free(struct obs_meter_service *service);
+
 struct obs_core_audio {
 	audio_t *audio;
+	struct obs_audio_pool pool;
+	struct obs_meter_service meters;
 
 	DARRAY(struct obs_source *) render_order;
 	DARRAY(struct obs_source *) root_nodes;
@@ -333,8 +642,17 @@ struct obs_core_audio {
 	int buffering_wait_ticks;
 	int total_buffering_ticks;
 
+	/* smallest number of ticks of audio the sources had ready beyond the
+	 * mixed window since headroom_since, for reducing the buffering */
+	int min_headroom_ticks;
+	uint64_t headroom_since;
+
 	float user_volume;
 
+	/* how long after the start of each tick the audio thread got to it */
+	struct obs_histogram tick_latency_hist;
+	struct obs_telemetry_ring telemetry;
+
 	pthread_mutex_t monitoring_mutex;
 	DARRAY(struct audio_monitor *) monitors;
 	char *monitoring_device_name;
@@ -342,6 +660,17 @@ struct obs_core_audio {
 };
 
 /* user sources, output channels, and displays */
+/* hashes the contexts of a list by name so they can be looked up without
+ * walking the list, private contexts are not indexed */
+struct obs_context_index {
+	struct obs_context_data **buckets;
+	size_t num_buckets;
+	size_t count;
+};
+
+/* enough for a couple of busy scenes */
+#define DEFAULT_WARM_SOURCE_LIMIT 64
+
 struct obs_core_data {
 	struct obs_source *first_source;
 	struct obs_source *first_audio_source;
@@ -355,6 +684,11 @@ struct obs_core_data {
 	pthread_mutex_t outputs_mutex;
 	pthread_mutex_t encoders_mutex;
 	pthread_mutex_t services_mutex;
+
+	struct obs_context_index source_index;
+	struct obs_context_index output_index;
+	struct obs_context_index encoder_index;
+	struct obs_context_index service_index;
 	pthread_mutex_t audio_sources_mutex;
 	pthread_mutex_t draw_callbacks_mutex;
 	DARRAY(struct draw_callback) draw_callbacks;
@@ -366,6 +700,11 @@ struct obs_core_data {
 
 	obs_data_t *private_data;
 
+	/* sources with warm references and the most there may be, see
+	 * obs_source_inc_warm */
+	volatile long warm_sources;
+	volatile long warm_source_limit;
+
 	volatile bool valid;
 };
 
@@ -385,6 +724,14 @@ struct obs_core_hotkeys {
 	bool reroute_hotkeys;
 	DARRAY(obs_hotkey_binding_t) bindings;
 
+	/* key states seen by the last poll of the hotkey thread, which only
+	 * goes through the bindings again once one of them changes, or when
+	 * bindings_changed is set because a binding or the way they are
+	 * handled changed since */
+	uint8_t key_states[OBS_KEY_LAST_VALUE];
+	uint32_t last_modifiers;
+	bool bindings_changed;
+
 	obs_hotkey_callback_router_func router_func;
 	void *router_func_data;
 
@@ -404,6 +751,164 @@ struct obs_core_hotkeys {
 	char *sceneitem_hide;
 };
 
+/* size classes of the frame arena, from 64 KiB up to 2 GiB */
+#define ARENA_NUM_CLASSES 60
+
+struct obs_frame_arena {
+	pthread_mutex_t mutex;
+	DARRAY(struct arena_block *) free_blocks[ARENA_NUM_CLASSES];
+
+	size_t limit;
+	size_t bytes_mapped;
+	size_t bytes_cached;
+
+	uint64_t allocations;
+	uint64_t reused;
+	uint64_t mapped;
+	uint64_t unmapped;
+	uint64_t over_limit;
+};
+
+extern bool obs_frame_arena_init(struct obs_frame_arena *arena);
+extern void obs_frame_arena_free(struct obs_frame_arena *arena);
+extern void *obs_frame_arena_alloc(size_t size);
+extern void obs_frame_arena_release(void *ptr);
+
+/* power of two size classes of the packet pool, from 256 bytes to 16 MiB */
+#define PACKET_POOL_CLASSES 17
+
+struct obs_packet_pool {
+	pthread_mutex_t mutex;
+	struct packet_block *free_blocks[PACKET_POOL_CLASSES];
+	size_t free_count[PACKET_POOL_CLASSES];
+
+	size_t bytes_in_use;
+	size_t bytes_cached;
+
+	uint64_t allocations;
+	uint64_t reused;
+	volatile long long refs;
+
+	/* bmem tag of the packet blocks */
+	int mem_tag;
+
+	bool initialized;
+};
+
+extern bool obs_packet_pool_init(struct obs_packet_pool *pool);
+extern void obs_packet_pool_free(struct obs_packet_pool *pool);
+
+/* returns a buffer for packet data with a reference count of one; encoder
+ * packets with data from here can be shared with obs_encoder_packet_ref */
+extern uint8_t *obs_packet_pool_alloc(size_t size);
+extern void obs_packet_pool_addref(uint8_t *data);
+extern void obs_packet_pool_release(uint8_t *data);
+
+/* the number of bytes a buffer can hold, which is usually more than was
+ * asked for, and whether the caller holds its only reference.  a unique
+ * buffer with room to spare can be grown in place */
+extern size_t obs_packet_pool_capacity(const uint8_t *data);
+extern bool obs_packet_pool_unique(const uint8_t *data);
+
+/* spare room left after video packet data so a caption SEI usually fits */
+#define PACKET_SEI_HEADROOM 256
+
+struct obs_image_cache {
+	pthread_mutex_t mutex;
+	DARRAY(struct obs_image *) images;
+	DARRAY(struct obs_image *) queue;
+
+	obs_task_group_t *group;
+	bool stop;
+
+	uint64_t limit;
+	uint64_t bytes;
+	uint64_t last_use;
+
+	bool compress;
+	char *disk_path;
+
+	bool initialized;
+};
+
+extern bool obs_image_cache_init(struct obs_image_cache *cache);
+extern void obs_image_cache_free(struct obs_image_cache *cache);
+
+/* see obs-gpu-memory.c */
+struct obs_gpu_memory {
+	pthread_mutex_t mutex;
+	DARRAY(struct obs_gpu_resource *) resources;
+	uint64_t bytes;
+
+	volatile long long budget;
+	volatile long long frame;
+
+	/* graphics thread only, for warning once per overrun */
+	bool over_budget;
+	bool initialized;
+};
+
+extern bool obs_gpu_memory_init(struct obs_gpu_memory *gm);
+extern void obs_gpu_memory_free(struct obs_gpu_memory *gm);
+extern void obs_gpu_memory_tick(void);
+
+/* see obs-clock.c, the deviation is how much faster the master clock runs
+ * than the system clock, in parts per billion */
+struct obs_master_clock {
+	pthread_mutex_t mutex;
+	obs_clock_get_time_t get_time;
+	void *param;
+	struct obs_source *source;
+
+	uint64_t window_start;
+	uint64_t window_offset;
+	uint64_t window_min_sys;
+	bool window_valid;
+
+	uint64_t prev_offset;
+	uint64_t prev_sys;
+	bool prev_valid;
+
+	double deviation;
+	bool locked;
+	volatile long long deviation_ppb;
+
+	bool initialized;
+};
+
+extern bool obs_master_clock_init(struct obs_master_clock *clock);
+extern void obs_master_clock_free(struct obs_master_clock *clock);
+
+/* polls a master clock that has a callback and returns a frame interval
+ * adjusted to its rate, called by the graphics thread once per frame */
+extern uint64_t obs_master_clock_interval(uint64_t interval_ns);
+extern void obs_master_clock_sample_source(struct obs_source *source,
+					   uint64_t timestamp);
+extern void obs_master_clock_remove_source(struct obs_source *source);
+
+struct clock_sleeper;
+
+/* see obs-offline.c, the time is the video time while offline rendering */
+struct obs_offline_clock {
+	pthread_mutex_t mutex;
+	volatile bool active;
+	volatile long long time;
+
+	DARRAY(struct clock_sleeper *) sleepers;
+	long awake;
+	long generation;
+	os_event_t *idle_event;
+
+	bool initialized;
+};
+
+extern bool obs_offline_clock_init(struct obs_offline_clock *clock);
+extern void obs_offline_clock_free(struct obs_offline_clock *clock);
+
+/* moves the offline clock to the next frame and waits for the threads that
+ * were due to sleep again, called by the graphics thread */
+extern void obs_offline_clock_advance(uint64_t time);
+
 struct obs_core {
 	struct obs_module *first_module;
 	DARRAY(struct obs_module_path) module_paths;
@@ -423,9 +928,14 @@ struct obs_core {
 
 	char *locale;
 	char *module_config_path;
+	char *thread_affinity;
+	bool realtime_threads;
 	bool name_store_owned;
 	profiler_name_store_t *name_store;
 
+	/* bmem tag of the blocks encoders allocate while encoding */
+	int encoder_mem_tag;
+
 	/* segmented into multiple sub-structures to keep things a bit more
 	 * clean and organized */
 	struct obs_core_video video;
@@ -433,6 +943,14 @@ struct obs_core {
 	struct obs_core_data data;
 	struct obs_core_hotkeys hotkeys;
 
+	struct obs_task_pool task_pool;
+	struct obs_frame_arena frame_arena;
+	struct obs_packet_pool packet_pool;
+	struct obs_image_cache image_cache;
+	struct obs_gpu_memory gpu_memory;
+	struct obs_master_clock master_clock;
+	struct obs_offline_clock offline_clock;
+
 	obs_task_handler_t ui_task_handler;
 };
 
@@ -444,14 +962,18 @@ struct obs_graphics_context {
 	uint64_t frame_time_total_ns;
 	uint64_t fps_total_ns;
 	uint32_t fps_total_frames;
-#ifdef _WIN32
-	bool gpu_was_active;
-#endif
-	bool raw_was_active;
-	bool was_active;
 	const char *video_thread_name;
 };
 
+extern bool
+obs_graphics_commands_init(struct obs_graphics_command_queue *queue);
+extern void
+obs_graphics_commands_free(struct obs_graphics_command_queue *queue);
+extern void
+obs_graphics_commands_set_active(struct obs_graphics_command_queue *queue,
+				 bool active);
+extern void obs_execute_graphics_commands(void);
+
 extern void *obs_graphics_thread(void *param);
 extern bool obs_graphics_thread_loop(struct obs_graphics_context *context);
 #ifdef __APPLE__
@@ -460,6 +982,13 @@ extern bool
 obs_graphics_thread_loop_autorelease(struct obs_graphics_context *context);
 #endif
 
+extern void *obs_audio_only_thread(void *param);
+extern void obs_video_wake(void);
+extern int obs_init_cover_video(const struct obs_video_info *ovi,
+				const char *image_path);
+extern void obs_free_cover_video(void);
+extern void obs_output_cover_frame(uint64_t timestamp);
+
 extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
 
 extern bool audio_callback(void *param, uint64_t start_ts_in,
@@ -497,6 +1026,14 @@ struct obs_context_data {
 	struct obs_context_data *next;
 	struct obs_context_data **prev_next;
 
+	/* chain of the name index of the list, assumes its mutex */
+	struct obs_context_index *index;
+	struct obs_context_data *hash_next;
+	uint32_t name_hash;
+
+	/* memory allocated in the callbacks of the context */
+	bmem_account_t *mem_account;
+
 	bool private;
 };
 
@@ -507,12 +1044,20 @@ extern bool obs_context_data_init(struct obs_context_data *context,
 extern void obs_context_data_free(struct obs_context_data *context);
 
 extern void obs_context_data_insert(struct obs_context_data *context,
-				    pthread_mutex_t *mutex, void *first);
+				    pthread_mutex_t *mutex, void *first,
+				    struct obs_context_index *index);
 extern void obs_context_data_remove(struct obs_context_data *context);
 
 extern void obs_context_data_setname(struct obs_context_data *context,
 				     const char *name);
 
+static inline uint64_t
+obs_context_data_memory_usage(const struct obs_context_data *context)
+{
+	long long bytes = bmem_account_get_bytes(context->mem_account);
+	return bytes > 0 ? (uint64_t)bytes : 0;
+}
+
 /* ------------------------------------------------------------------------- */
 /* ref-counting  */
 
@@ -560,7 +1105,6 @@ static inline bool obs_weak_ref_get_ref(struct obs_weak_ref *ref)
 struct async_frame {
 	struct obs_source_frame *frame;
 	long unused_count;
-	bool used;
 };
 
 enum audio_action_type {
@@ -594,6 +1138,23 @@ struct caption_cb_info {
 	void *param;
 };
 
+/* only ever written by one thread at a time, so the additions don't need to
+ * be atomic, only the individual loads and stores */
+struct obs_source_perf_counter {
+	volatile long long count;
+	volatile long long total_ns;
+};
+
+static inline void obs_source_perf_add(struct obs_source_perf_counter *counter,
+				       uint64_t ns)
+{
+	long long count = os_atomic_load_long_long(&counter->count);
+	long long total = os_atomic_load_long_long(&counter->total_ns);
+
+	os_atomic_store_long_long(&counter->count, count + 1);
+	os_atomic_store_long_long(&counter->total_ns, total + (long long)ns);
+}
+
 struct obs_source {
 	struct obs_context_data context;
 	struct obs_source_info info;
@@ -610,12 +1171,40 @@ struct obs_source {
 	/* signals to call the source update in the video thread */
 	long defer_update_count;
 
+	/* incremented whenever the video output of the source (or of one of
+	 * its filters) may have changed, used to cache rendered items */
+	volatile long content_version;
+
+	/* scene items showing the source render it at most this often and
+	 * composite their last render in between, 0 if unlimited */
+	double max_render_fps;
+
+	/* graphics thread only: the size hint passed to the source and the
+	 * largest size scene items drew it at since the last tick */
+	uint32_t size_hint_cx;
+	uint32_t size_hint_cy;
+	uint32_t next_size_hint_cx;
+	uint32_t next_size_hint_cy;
+	float size_hint_unused;
+
+	/* GPU time of the source in frames timed by obs_gpu_timing */
+	volatile long long gpu_time_ns;
+
+	/* CPU time of the callbacks, see obs_source_get_perf_stats */
+	struct obs_source_perf_counter perf_tick;
+	struct obs_source_perf_counter perf_render;
+	struct obs_source_perf_counter perf_audio;
+	volatile long long skipped_renders;
+
 	/* ensures show/hide are only called once */
 	volatile long show_refs;
 
 	/* ensures activate/deactivate are only called once */
 	volatile long activate_refs;
 
+	/* ensures warm/cool are only called once, see obs_source_inc_warm */
+	volatile long warm_refs;
+
 	/* used to indicate that the source has been removed and all
 	 * references to it should be released (not exactly how I would prefer
 	 * to handle things but it's the best option) */
@@ -623,6 +1212,14 @@ struct obs_source {
 
 	bool active;
 	bool showing;
+	bool warm;
+
+	/* creation waits for the source to be shown or activated for the
+	 * first time, see obs_load_sources_deferred */
+	volatile bool create_deferred;
+	volatile bool create_queued;
+	volatile bool create_claimed;
+	bool load_pending;
 
 	/* used to temporarily disable sources if needed */
 	bool enabled;
@@ -641,6 +1238,8 @@ struct obs_source {
 	/* audio */
 	bool audio_failed;
 	bool audio_pending;
+	/* output of the last tick was zeroed by the volume stage */
+	bool audio_silent;
 	bool pending_stop;
 	bool audio_active;
 	bool user_muted;
@@ -650,6 +1249,13 @@ struct obs_source {
 	uint64_t audio_ts;
 	struct circlebuf audio_input_buf[MAX_AUDIO_CHANNELS];
 	size_t last_audio_input_buf_size;
+
+	/* adaptive audio buffering (audio thread only, see obs-audio.c) */
+	bool audio_isolated;
+	int audio_late_events;
+	uint64_t audio_late_since;
+	uint64_t audio_on_time_since;
+
 	DARRAY(struct audio_action) audio_actions;
 	float *audio_output_buf[MAX_AUDIO_MIXES][MAX_AUDIO_CHANNELS];
 	float *audio_mix_buf[MAX_AUDIO_CHANNELS];
@@ -662,9 +1268,16 @@ struct obs_source {
 	DARRAY(struct audio_cb_info) audio_cb_list;
 	struct obs_audio_data audio_data;
 	size_t audio_storage_size;
+
+	/* resampled audio waiting for the audio thread to filter it, assumes
+	 * audio_mutex */
+	struct circlebuf audio_filter_queue;
+	struct obs_audio_data audio_filter_data;
+	size_t audio_filter_storage_size;
 	uint32_t audio_mixers;
 	float user_volume;
 	float volume;
+	signal_handle_t *volume_signal;
 	int64_t sync_offset;
 	int64_t last_sync_offset;
 	float balance;
@@ -674,6 +1287,12 @@ struct obs_source {
 	gs_texrender_t *async_texrender;
 	struct obs_source_frame *cur_async_frame;
 	bool async_gpu_conversion;
+	bool async_direct_draw;
+	bool async_texrender_dirty;
+	bool async_texrender_needed;
+	float async_color_matrix[16];
+	float async_color_range_min[3];
+	float async_color_range_max[3];
 	enum video_format async_format;
 	bool async_full_range;
 	enum video_format async_cache_format;
@@ -686,10 +1305,31 @@ struct obs_source {
 	bool async_update_texture;
 	bool async_unbuffered;
 	bool async_decoupled;
+	struct obs_async_upload *async_upload;
 	struct obs_source_frame *async_preload_frame;
+
+	/* frames are handed from the thread outputting them to the graphics
+	 * thread through async_queue, and come back through async_free once
+	 * they have been rendered.  async_cache holds the unused frames and
+	 * belongs to the outputting side, which async_output_mutex
+	 * serializes.  async_frames and the current frames belong to the
+	 * graphics side, guarded by async_mutex. */
+	struct spsc_ring async_queue;
+	struct spsc_ring async_free;
 	DARRAY(struct async_frame) async_cache;
 	DARRAY(struct obs_source_frame *) async_frames;
+	pthread_mutex_t async_output_mutex;
 	pthread_mutex_t async_mutex;
+	volatile bool async_flush;
+
+	/* set while the frame timestamps drive the master clock, only a hint
+	 * for the output path, the clock itself holds the source under its
+	 * mutex */
+	volatile bool master_clock;
+	volatile long async_frames_output;
+	volatile long async_frames_dropped;
+	volatile long async_flushes;
+	volatile long async_contended;
 	uint32_t async_width;
 	uint32_t async_height;
 	uint32_t async_cache_width;
@@ -712,6 +1352,12 @@ struct obs_source {
 	bool deinterlace_top_first;
 	bool deinterlace_rendered;
 
+	/* deinterlaced field, reused until the textures or the field change */
+	gs_texrender_t *deinterlace_texrender;
+	bool deinterlace_dirty;
+	bool deinterlace_frame2;
+	bool deinterlace_linear_srgb;
+
 	/* filters */
 	struct obs_source *filter_parent;
 	struct obs_source *filter_target;
@@ -721,6 +1367,15 @@ struct obs_source {
 	enum obs_allow_direct_render allow_direct;
 	bool rendering_filter;
 
+	/* output of sources drawn more than once a frame, which later draws
+	 * of the frame reuse */
+	gs_texrender_t *memo_texrender;
+	uint64_t memo_frame;
+	uint64_t memo_draw_frame;
+	uint32_t memo_draws;
+	bool memo_wanted;
+	bool memo_rendering;
+
 	/* sources specific hotkeys */
 	obs_hotkey_pair_id mute_unmute_key;
 	obs_hotkey_id push_to_mute_key;
@@ -757,6 +1412,11 @@ struct obs_source {
 	uint32_t transition_cy;
 	uint32_t transition_fixed_duration;
 	bool transition_use_fixed_duration;
+	bool transition_freeze_outgoing;
+	/* start time of the transition whose outgoing source is frozen in
+	 * transition_texrender[0], only used by the graphics thread */
+	uint64_t transition_frozen_time;
+	obs_source_t *transition_prewarm;
 	enum obs_transition_mode transition_mode;
 	enum obs_transition_scale_type transition_scale_type;
 	struct matrix4 transition_matrices[2];
@@ -792,6 +1452,11 @@ extern obs_source_t *obs_source_create_set_last_ver(const char *id,
 						    obs_data_t *settings,
 						    obs_data_t *hotkey_data,
 						    uint32_t last_obs_ver);
+extern obs_source_t *obs_source_create_deferred(const char *id,
+						const char *name,
+						obs_data_t *settings,
+						obs_data_t *hotkey_data,
+						uint32_t last_obs_ver);
 extern void obs_source_destroy(struct obs_source *source);
 
 enum view_type {
@@ -807,7 +1472,7 @@ static inline void obs_source_dosignal(struct obs_source *source,
 	uint8_t stack[128];
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
-	calldata_set_ptr(&data, "source", source);
+	calldata_add_ptr(&data, "source", source);
 	if (signal_obs && !source->context.private)
 		signal_handler_signal(obs->signals, signal_obs, &data);
 	if (signal_source)
@@ -846,12 +1511,42 @@ convert_video_format(enum video_format format)
 extern void obs_source_activate(obs_source_t *source, enum view_type type);
 extern void obs_source_deactivate(obs_source_t *source, enum view_type type);
 extern void obs_source_video_tick(obs_source_t *source, float seconds);
+extern void obs_source_call_video_tick(obs_source_t *source, float seconds);
+extern bool obs_source_video_tick_deferred(obs_source_t *source,
+					   float seconds);
+extern bool obs_source_get_content_version(obs_source_t *source,
+					   long *version);
+extern void obs_source_add_size_hint(obs_source_t *source, uint32_t cx,
+				     uint32_t cy);
+
+/* FNV-1a over the bytes of values, for versions made up of several values */
+#define OBS_VERSION_INIT 0xcbf29ce484222325ULL
+#define OBS_VERSION_MIX(hash, val) \
+	obs_version_mix(hash, &(val), sizeof(val))
+
+static inline uint64_t obs_version_mix(uint64_t hash, const void *data,
+				       size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+extern bool obs_scene_get_video_version(obs_scene_t *scene,
+					uint64_t *version);
 extern float obs_source_get_target_volume(obs_source_t *source,
 					  obs_source_t *target);
 
 extern void obs_source_audio_render(obs_source_t *source, uint32_t mixers,
 				    size_t channels, size_t sample_rate,
 				    size_t size);
+extern bool obs_source_audio_queued(obs_source_t *source);
+extern void obs_source_filter_queued_audio(obs_source_t *source);
 
 extern void add_alignment(struct vec2 *v, uint32_t align, int cx, int cy);
 
@@ -866,15 +1561,32 @@ extern bool update_async_textures(struct obs_source *source,
 				  gs_texrender_t *texrender);
 extern bool set_async_texture_size(struct obs_source *source,
 				   const struct obs_source_frame *frame);
+extern void finish_async_texrender(struct obs_source *source);
+extern bool obs_source_draw_async_subregion(obs_source_t *source, uint32_t x,
+					    uint32_t y, uint32_t cx,
+					    uint32_t cy);
 extern void remove_async_frame(obs_source_t *source,
 			       struct obs_source_frame *frame);
 
+extern void async_upload_start(obs_source_t *source);
+extern void async_upload_wait(obs_source_t *source);
+extern bool async_upload_finish(obs_source_t *source,
+				const struct obs_source_frame *frame,
+				gs_texture_t *tex[MAX_AV_PLANES]);
+extern void async_upload_free(obs_source_t *source);
+
 extern void set_deinterlace_texture_size(obs_source_t *source);
 extern void deinterlace_process_last_frame(obs_source_t *source,
 					   uint64_t sys_time);
 extern void deinterlace_update_async_video(obs_source_t *source);
 extern void deinterlace_render(obs_source_t *s);
 
+extern void obs_source_render_filter_input(obs_source_t *filter,
+					   obs_source_t *target,
+					   enum gs_color_format format,
+					   uint32_t cx, uint32_t cy);
+extern bool obs_source_render_fused_filters(obs_source_t *filter);
+
 /* ------------------------------------------------------------------------- */
 /* outputs  */
 
@@ -888,6 +1600,31 @@ struct delay_data {
 	enum delay_msg msg;
 	uint64_t ts;
 	struct encoder_packet packet;
+
+	/* packets written to delay storage keep everything but their data,
+	 * which is read back from the segment when they are sent */
+	bool stored;
+	uint32_t segment;
+	uint64_t offset;
+};
+
+/* a file that packets of the delay storage are appended to, deleted once
+ * every packet in it has been sent */
+struct delay_segment {
+	uint32_t id;
+	char *path;
+	FILE *write;
+	FILE *read;
+	uint64_t size;
+	uint64_t read_pos;
+	size_t packets;
+};
+
+/* seq is the order packets were received in, which breaks ties between
+ * audio packets with the same dts */
+struct interleaved_packet {
+	struct encoder_packet packet;
+	uint64_t seq;
 };
 
 typedef void (*encoded_callback_t)(void *data, struct encoder_packet *packet);
@@ -937,13 +1674,18 @@ struct obs_output {
 	pthread_t end_data_capture_thread;
 	os_event_t *stopping_event;
 	pthread_mutex_t interleaved_mutex;
-	DARRAY(struct encoder_packet) interleaved_packets;
+	/* packets waiting to be interleaved, index 0 is the video track and
+	 * index i + 1 audio track i */
+	struct circlebuf interleaved_tracks[MAX_AUDIO_MIXES + 1];
+	uint64_t interleaved_seq;
 	int stop_code;
 
 	int reconnect_retry_sec;
 	int reconnect_retry_max;
 	int reconnect_retries;
 	int reconnect_retry_cur_sec;
+	unsigned long reconnect_wait_ms;
+	bool fast_reconnect;
 	pthread_t reconnect_thread;
 	os_event_t *reconnect_stop_event;
 	volatile bool reconnecting;
@@ -995,6 +1737,10 @@ struct obs_output {
 	encoded_callback_t delay_callback;
 	struct circlebuf delay_data; /* struct delay_data */
 	pthread_mutex_t delay_mutex;
+	char *delay_storage_path;
+	DARRAY(struct delay_segment) delay_segments;
+	uint32_t delay_next_segment;
+	bool delay_storage_failed;
 	uint32_t delay_sec;
 	uint32_t delay_flags;
 	uint32_t delay_cur_flags;
@@ -1003,8 +1749,6 @@ struct obs_output {
 	volatile bool delay_capturing;
 
 	char *last_error_message;
-
-	float audio_data[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
 };
 
 static inline void do_output_signal(struct obs_output *output,
@@ -1029,6 +1773,13 @@ extern const struct obs_output_info *find_output(const char *id);
 extern void obs_output_remove_encoder(struct obs_output *output,
 				      struct obs_encoder *encoder);
 
+/* passes the messages of the caption SEI due at frame_timestamp to callback,
+ * for encoders that embed the captions */
+extern bool obs_output_get_encoder_captions(struct obs_output *output,
+					    double frame_timestamp,
+					    obs_encoder_sei_cb callback,
+					    void *param);
+
 extern void
 obs_encoder_packet_create_instance(struct encoder_packet *dst,
 				   const struct encoder_packet *src);
@@ -1070,10 +1821,18 @@ struct obs_encoder {
 	uint32_t scaled_height;
 	enum video_format preferred_format;
 
+	/* GPU-scaled canvas raw frames are received from while active */
+	video_t *scaled_video;
+
 	volatile bool active;
 	volatile bool paused;
+	volatile bool keyframe_requested;
 	bool initialized;
 
+	/* the headers of the last keyframe, to flag packets after a
+	 * reconfiguration changed them.  only used by the encode thread */
+	DARRAY(uint8_t) last_headers;
+
 	/* indicates ownership of the info.id buffer */
 	bool owns_info_id;
 
@@ -1085,6 +1844,15 @@ struct obs_encoder {
 	struct circlebuf audio_input_buffer[MAX_AV_PLANES];
 	uint8_t *audio_output_buffer[MAX_AV_PLANES];
 
+	/* audio encoders encode on a thread of their own so the audio thread
+	 * only has to buffer; audio_mutex guards audio_input_buffer, which
+	 * both threads use */
+	pthread_mutex_t audio_mutex;
+	os_event_t *audio_event;
+	pthread_t audio_thread;
+	bool audio_thread_active;
+	volatile bool audio_thread_stop;
+
 	/* if a video encoder is paired with an audio encoder, make it start
 	 * up at the specific timestamp.  if this is the audio encoder,
 	 * wait_for_video makes it wait until it's ready to sync up with
@@ -1110,7 +1878,17 @@ struct obs_encoder {
 	struct pause_data pause;
 
 	const char *profile_encoder_encode_name;
+	struct obs_histogram encode_hist;
+	struct obs_histogram latency_hist;
 	char *last_error_message;
+
+	/* the last packet converted by obs_parse_avc_packet, so outputs
+	 * sharing this encoder don't each convert their own copy.  a
+	 * reference to the source data is held so its address can't be
+	 * reused while cached */
+	pthread_mutex_t avc_cache_mutex;
+	uint8_t *avc_cache_src;
+	struct encoder_packet avc_cache;
 };
 
 extern struct obs_encoder_info *find_encoder(const char *id);
@@ -1127,6 +1905,14 @@ extern void obs_encoder_stop(obs_encoder_t *encoder,
 						struct encoder_packet *packet),
 			     void *param);
 
+extern bool obs_encoder_get_cached_avc_packet(obs_encoder_t *encoder,
+					      const struct encoder_packet *src,
+					      struct encoder_packet *avc_packet);
+extern void
+obs_encoder_cache_avc_packet(obs_encoder_t *encoder,
+			     const struct encoder_packet *src,
+			     const struct encoder_packet *avc_packet);
+
 extern void obs_encoder_add_output(struct obs_encoder *encoder,
 				   struct obs_output *output);
 extern void obs_encoder_remove_output(struct obs_encoder *encoder,
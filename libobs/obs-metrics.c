@@ -0,0 +1,496 @@
+#include <inttypes.h>
+
+#include "util/dstr.h"
+#include "obs-internal.h"
+
+/*
+ * Runtime metrics in the OpenMetrics text format.
+ *
+ * The hot paths only ever touch the histograms, with two atomic adds per
+ * sample and no locks.  Everything else is read from the counters libobs
+ * already keeps at the moment the metrics are requested, so nothing here runs
+ * unless something is actually scraping.
+ */
+
+#define BUCKET_BASE_NS 250000ULL
+
+void obs_histogram_observe(struct obs_histogram *hist, uint64_t ns)
+{
+	int i = 0;
+
+	while (i < OBS_HISTOGRAM_BUCKETS && ns > (BUCKET_BASE_NS << i))
+		i++;
+
+	os_atomic_add_long_long(&hist->buckets[i], 1);
+	os_atomic_add_long_long(&hist->sum_ns, (long long)ns);
+}
+
+struct hist_snapshot {
+	uint64_t buckets[OBS_HISTOGRAM_BUCKETS + 1];
+	uint64_t sum_ns;
+};
+
+static void snapshot_histogram(struct hist_snapshot *snap,
+			       const struct obs_histogram *hist)
+{
+	for (size_t i = 0; i <= OBS_HISTOGRAM_BUCKETS; i++)
+		snap->buckets[i] =
+			(uint64_t)os_atomic_load_long_long(&hist->buckets[i]);
+	snap->sum_ns = (uint64_t)os_atomic_load_long_long(&hist->sum_ns);
+}
+
+/* label values may contain anything the user typed as a name */
+static void cat_label_value(struct dstr *out, const char *value)
+{
+	for (const char *c = value ? value : ""; *c; c++) {
+		if (*c == '\\')
+			dstr_cat(out, "\\\\");
+		else if (*c == '"')
+			dstr_cat(out, "\\\"");
+		else if (*c == '\n')
+			dstr_cat(out, "\\n");
+		else
+			dstr_cat_ch(out, *c);
+	}
+}
+
+static void cat_family(struct dstr *out, const char *name, const char *type,
+		       const char *help)
+{
+	dstr_catf(out, "# TYPE %s %s\n# HELP %s %s\n", name, type, name, help);
+}
+
+static void cat_labels(struct dstr *out, const char *label, const char *value)
+{
+	if (!label)
+		return;
+
+	dstr_catf(out, "{%s=\"", label);
+	cat_label_value(out, value);
+	dstr_cat(out, "\"}");
+}
+
+static void cat_sample_u64(struct dstr *out, const char *name,
+			   const char *label, const char *value, uint64_t val)
+{
+	dstr_cat(out, name);
+	cat_labels(out, label, value);
+	dstr_catf(out, " %" PRIu64 "\n", val);
+}
+
+static void cat_sample_double(struct dstr *out, const char *name,
+			      const char *label, const char *value, double val)
+{
+	dstr_cat(out, name);
+	cat_labels(out, label, value);
+	dstr_catf(out, " %g\n", val);
+}
+
+static void cat_histogram(struct dstr *out, const char *name,
+			  const char *label, const char *value,
+			  const struct hist_snapshot *snap)
+{
+	uint64_t count = 0;
+
+	for (size_t i = 0; i <= OBS_HISTOGRAM_BUCKETS; i++) {
+		count += snap->buckets[i];
+
+		dstr_catf(out, "%s_bucket{", name);
+		if (label) {
+			dstr_catf(out, "%s=\"", label);
+			cat_label_value(out, value);
+			dstr_cat(out, "\",");
+		}
+
+		if (i < OBS_HISTOGRAM_BUCKETS)
+			dstr_catf(out, "le=\"%g\"",
+				  (double)(BUCKET_BASE_NS << i) / 1e9);
+		else
+			dstr_cat(out, "le=\"+Inf\"");
+
+		dstr_catf(out, "} %" PRIu64 "\n", count);
+	}
+
+	dstr_catf(out, "%s_count", name);
+	cat_labels(out, label, value);
+	dstr_catf(out, " %" PRIu64 "\n", count);
+
+	dstr_catf(out, "%s_sum", name);
+	cat_labels(out, label, value);
+	dstr_catf(out, " %g\n", (double)snap->sum_ns / 1e9);
+}
+
+static void cat_plain_histogram(struct dstr *out, const char *name,
+				const char *help,
+				const struct obs_histogram *hist)
+{
+	struct hist_snapshot snap;
+
+	snapshot_histogram(&snap, hist);
+	cat_family(out, name, "histogram", help);
+	cat_histogram(out, name, NULL, NULL, &snap);
+}
+
+static void cat_video_metrics(struct dstr *out)
+{
+	struct obs_core_video *video = &obs->video;
+	video_t *main_video = obs_get_video();
+
+	cat_family(out, "obs_video_frames", "counter",
+		   "Frames rendered by the graphics thread.");
+	cat_sample_u64(out, "obs_video_frames_total", NULL, NULL,
+		       video->total_frames);
+
+	cat_family(out, "obs_video_lagged_frames", "counter",
+		   "Frames missed because rendering took too long.");
+	cat_sample_u64(out, "obs_video_lagged_frames_total", NULL, NULL,
+		       video->lagged_frames);
+
+	if (main_video) {
+		cat_family(out, "obs_video_output_frames", "counter",
+			   "Frames sent to video outputs.");
+		cat_sample_u64(out, "obs_video_output_frames_total", NULL,
+			       NULL, video_output_get_total_frames(main_video));
+
+		cat_family(out, "obs_video_skipped_frames", "counter",
+			   "Frames skipped because encoding lagged behind.");
+		cat_sample_u64(out, "obs_video_skipped_frames_total", NULL,
+			       NULL,
+			       video_output_get_skipped_frames(main_video));
+	}
+
+	cat_family(out, "obs_master_clock_deviation_ppm", "gauge",
+		   "Rate of the master clock relative to the system clock.");
+	cat_sample_double(out, "obs_master_clock_deviation_ppm", NULL, NULL,
+			  obs_get_master_clock_deviation());
+
+	cat_plain_histogram(out, "obs_video_frame_time_seconds",
+			    "Time the graphics thread spent per frame.",
+			    &video->frame_time_hist);
+	cat_plain_histogram(out, "obs_video_tick_seconds",
+			    "Time spent ticking sources per frame.",
+			    &video->tick_hist);
+	cat_plain_histogram(out, "obs_video_output_frame_seconds",
+			    "Time spent rendering and staging output frames.",
+			    &video->output_frame_hist);
+	cat_plain_histogram(out, "obs_video_render_displays_seconds",
+			    "Time spent rendering preview displays per frame.",
+			    &video->render_displays_hist);
+	cat_plain_histogram(out, "obs_video_sleep_jitter_seconds",
+			    "How late the graphics thread woke up for frames.",
+			    &video->sleep_jitter_hist);
+}
+
+static void cat_gpu_metrics(struct dstr *out)
+{
+	struct obs_gpu_timing *timing = &obs->video.gpu_timing;
+	const char *name = "obs_video_gpu_stage_seconds";
+	struct hist_snapshot snaps[OBS_GPU_STAGE_COUNT];
+	uint64_t samples = 0;
+
+	for (size_t i = 0; i < OBS_GPU_STAGE_COUNT; i++) {
+		snapshot_histogram(&snaps[i], &timing->hist[i]);
+		for (size_t j = 0; j <= OBS_HISTOGRAM_BUCKETS; j++)
+			samples += snaps[i].buckets[j];
+	}
+
+	/* nothing to report unless GPU timing has been enabled */
+	if (!samples)
+		return;
+
+	cat_family(out, name, "histogram",
+		   "GPU time of the main canvas' render stages per frame.");
+	for (size_t i = 0; i < OBS_GPU_STAGE_COUNT; i++)
+		cat_histogram(out, name, "stage", obs_gpu_stage_name(i),
+			      &snaps[i]);
+}
+
+static void cat_audio_metrics(struct dstr *out)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	int ticks = audio->total_buffering_ticks;
+	uint32_t sample_rate;
+
+	if (!audio->audio)
+		return;
+
+	sample_rate = audio_output_get_sample_rate(audio->audio);
+
+	cat_family(out, "obs_audio_buffering_ticks", "gauge",
+		   "Audio ticks of buffering added to keep sources in sync.");
+	cat_sample_u64(out, "obs_audio_buffering_ticks", NULL, NULL,
+		       (uint64_t)ticks);
+
+	cat_family(out, "obs_audio_buffering_seconds", "gauge",
+		   "Audio latency added to keep sources in sync.");
+	cat_sample_double(out, "obs_audio_buffering_seconds", NULL, NULL,
+			  sample_rate ? (double)ticks * AUDIO_OUTPUT_FRAMES /
+						(double)sample_rate
+				      : 0.0);
+
+	cat_plain_histogram(out, "obs_audio_tick_latency_seconds",
+			    "Delay of audio ticks behind their start time.",
+			    &audio->tick_latency_hist);
+}
+
+static void cat_arena_metrics(struct dstr *out)
+{
+	struct obs_frame_arena_stats stats;
+
+	obs_get_frame_arena_stats(&stats);
+
+	cat_family(out, "obs_frame_arena_allocations", "counter",
+		   "Async video frame buffers allocated.");
+	cat_sample_u64(out, "obs_frame_arena_allocations_total", NULL, NULL,
+		       stats.allocations);
+
+	cat_family(out, "obs_frame_arena_reused", "counter",
+		   "Async video frame buffers served from the free lists.");
+	cat_sample_u64(out, "obs_frame_arena_reused_total", NULL, NULL,
+		       stats.reused);
+
+	cat_family(out, "obs_frame_arena_bytes_in_use", "gauge",
+		   "Bytes of async video frame buffers in use.");
+	cat_sample_u64(out, "obs_frame_arena_bytes_in_use", NULL, NULL,
+		       stats.bytes_in_use);
+
+	cat_family(out, "obs_frame_arena_bytes_cached", "gauge",
+		   "Bytes of freed async video frame buffers kept for reuse.");
+	cat_sample_u64(out, "obs_frame_arena_bytes_cached", NULL, NULL,
+		       stats.bytes_cached);
+}
+
+static void cat_packet_pool_metrics(struct dstr *out)
+{
+	struct obs_packet_pool_stats stats;
+
+	obs_get_packet_pool_stats(&stats);
+
+	cat_family(out, "obs_packet_pool_allocations", "counter",
+		   "Encoded packet buffers allocated.");
+	cat_sample_u64(out, "obs_packet_pool_allocations_total", NULL, NULL,
+		       stats.allocations);
+
+	cat_family(out, "obs_packet_pool_reused", "counter",
+		   "Encoded packet buffers served from the free lists.");
+	cat_sample_u64(out, "obs_packet_pool_reused_total", NULL, NULL,
+		       stats.reused);
+
+	cat_family(out, "obs_packet_pool_shared_refs", "counter",
+		   "Encoded packets shared by reference instead of copied.");
+	cat_sample_u64(out, "obs_packet_pool_shared_refs_total", NULL, NULL,
+		       stats.shared_refs);
+
+	cat_family(out, "obs_packet_pool_bytes_in_use", "gauge",
+		   "Bytes of encoded packet buffers in use.");
+	cat_sample_u64(out, "obs_packet_pool_bytes_in_use", NULL, NULL,
+		       stats.bytes_in_use);
+}
+
+struct output_metrics {
+	char *name;
+	bool active;
+	uint64_t frames;
+	uint64_t dropped;
+	uint64_t bytes;
+	float congestion;
+};
+
+static void cat_output_metrics(struct dstr *out)
+{
+	DARRAY(obs_output_t *) outputs;
+	DARRAY(struct output_metrics) metrics;
+	struct obs_core_data *data = &obs->data;
+
+	da_init(outputs);
+	da_init(metrics);
+
+	/* output callbacks may take their own locks, so only collect
+	 * references while the list is locked */
+	pthread_mutex_lock(&data->outputs_mutex);
+	for (struct obs_output *output = data->first_output; output;
+	     output = (struct obs_output *)output->context.next) {
+		obs_output_t *ref = obs_output_get_ref(output);
+		if (ref)
+			da_push_back(outputs, &ref);
+	}
+	pthread_mutex_unlock(&data->outputs_mutex);
+
+	for (size_t i = 0; i < outputs.num; i++) {
+		obs_output_t *output = outputs.array[i];
+		struct output_metrics *m = da_push_back_new(metrics);
+		int frames = obs_output_get_total_frames(output);
+		int dropped = obs_output_get_frames_dropped(output);
+
+		m->name = bstrdup(obs_output_get_name(output));
+		m->active = obs_output_active(output);
+		m->frames = frames > 0 ? (uint64_t)frames : 0;
+		m->dropped = dropped > 0 ? (uint64_t)dropped : 0;
+		m->bytes = obs_output_get_total_bytes(output);
+		m->congestion = obs_output_get_congestion(output);
+
+		obs_output_release(output);
+	}
+	da_free(outputs);
+
+	if (metrics.num) {
+		cat_family(out, "obs_output_active", "gauge",
+			   "Whether the output is currently running.");
+		for (size_t i = 0; i < metrics.num; i++)
+			cat_sample_u64(out, "obs_output_active", "output",
+				       metrics.array[i].name,
+				       metrics.array[i].active);
+
+		cat_family(out, "obs_output_frames", "counter",
+			   "Video frames sent by the output.");
+		for (size_t i = 0; i < metrics.num; i++)
+			cat_sample_u64(out, "obs_output_frames_total",
+				       "output", metrics.array[i].name,
+				       metrics.array[i].frames);
+
+		cat_family(out, "obs_output_dropped_frames", "counter",
+			   "Video frames dropped by the output.");
+		for (size_t i = 0; i < metrics.num; i++)
+			cat_sample_u64(out, "obs_output_dropped_frames_total",
+				       "output", metrics.array[i].name,
+				       metrics.array[i].dropped);
+
+		cat_family(out, "obs_output_bytes", "counter",
+			   "Bytes sent by the output.");
+		for (size_t i = 0; i < metrics.num; i++)
+			cat_sample_u64(out, "obs_output_bytes_total", "output",
+				       metrics.array[i].name,
+				       metrics.array[i].bytes);
+
+		cat_family(out, "obs_output_congestion", "gauge",
+			   "Network congestion reported by the output, 0 to 1.");
+		for (size_t i = 0; i < metrics.num; i++)
+			cat_sample_double(out, "obs_output_congestion",
+					  "output", metrics.array[i].name,
+					  metrics.array[i].congestion);
+	}
+
+	for (size_t i = 0; i < metrics.num; i++)
+		bfree(metrics.array[i].name);
+	da_free(metrics);
+}
+
+struct encoder_metrics {
+	char *name;
+	struct hist_snapshot encode;
+	struct hist_snapshot latency;
+};
+
+static void cat_encoder_metrics(struct dstr *out)
+{
+	DARRAY(struct encoder_metrics) metrics;
+	struct obs_core_data *data = &obs->data;
+
+	da_init(metrics);
+
+	pthread_mutex_lock(&data->encoders_mutex);
+	for (struct obs_encoder *encoder = data->first_encoder; encoder;
+	     encoder = (struct obs_encoder *)encoder->context.next) {
+		struct encoder_metrics *m = da_push_back_new(metrics);
+
+		m->name = bstrdup(encoder->context.name);
+		snapshot_histogram(&m->encode, &encoder->encode_hist);
+		snapshot_histogram(&m->latency, &encoder->latency_hist);
+	}
+	pthread_mutex_unlock(&data->encoders_mutex);
+
+	if (metrics.num) {
+		cat_family(out, "obs_encoder_encode_seconds", "histogram",
+			   "Time spent in the encoder per submitted frame.");
+		for (size_t i = 0; i < metrics.num; i++)
+			cat_histogram(out, "obs_encoder_encode_seconds",
+				      "encoder", metrics.array[i].name,
+				      &metrics.array[i].encode);
+
+		cat_family(out, "obs_encoder_latency_seconds", "histogram",
+			   "Time from frame capture to its encoded packet.");
+		for (size_t i = 0; i < metrics.num; i++)
+			cat_histogram(out, "obs_encoder_latency_seconds",
+				      "encoder", metrics.array[i].name,
+				      &metrics.array[i].latency);
+	}
+
+	for (size_t i = 0; i < metrics.num; i++)
+		bfree(metrics.array[i].name);
+	da_free(metrics);
+}
+
+char *obs_get_openmetrics(void)
+{
+	struct dstr out = {0};
+
+	if (!obs)
+		return NULL;
+
+	dstr_reserve(&out, 8192);
+
+	cat_video_metrics(&out);
+	cat_gpu_metrics(&out);
+	cat_audio_metrics(&out);
+	cat_arena_metrics(&out);
+	cat_packet_pool_metrics(&out);
+	cat_output_metrics(&out);
+	cat_encoder_metrics(&out);
+
+	dstr_cat(&out, "# EOF\n");
+	return out.array;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void obs_telemetry_push(struct obs_telemetry_ring *ring,
+			const struct obs_telemetry_sample *sample)
+{
+	long long written = os_atomic_load_long_long(&ring->written);
+
+	ring->samples[written % OBS_TELEMETRY_SAMPLES] = *sample;
+	os_atomic_store_long_long(&ring->written, written + 1);
+}
+
+/* the slot after the newest sample may be getting overwritten while it is
+ * copied, so only the samples that are still intact once the copy is done are
+ * returned */
+size_t obs_get_telemetry(enum obs_telemetry_channel channel,
+			 struct obs_telemetry_sample *samples, size_t count)
+{
+	struct obs_telemetry_ring *ring;
+	long long written, first, oldest_intact;
+
+	if (!obs || !samples)
+		return 0;
+
+	if (channel == OBS_TELEMETRY_VIDEO)
+		ring = &obs->video.telemetry;
+	else if (channel == OBS_TELEMETRY_AUDIO)
+		ring = &obs->audio.telemetry;
+	else
+		return 0;
+
+	written = os_atomic_load_long_long(&ring->written);
+	if (count > OBS_TELEMETRY_SAMPLES - 1)
+		count = OBS_TELEMETRY_SAMPLES - 1;
+	if ((long long)count > written)
+		count = (size_t)written;
+
+	first = written - (long long)count;
+	for (size_t i = 0; i < count; i++) {
+		long long idx = (first + (long long)i) % OBS_TELEMETRY_SAMPLES;
+		samples[i] = ring->samples[idx];
+	}
+
+	written = os_atomic_load_long_long(&ring->written);
+	oldest_intact = written - OBS_TELEMETRY_SAMPLES + 1;
+	if (first >= oldest_intact)
+		return count;
+	if (first + (long long)count <= oldest_intact)
+		return 0;
+
+	size_t lost = (size_t)(oldest_intact - first);
+	memmove(samples, samples + lost, (count - lost) * sizeof(*samples));
+	return count - lost;
+}
@@ -24,6 +24,8 @@
 
 extern const char *get_module_extension(void);
 
+static volatile long num_deferred = 0;
+
 static inline int req_func_not_found(const char *name, const char *path)
 {
 	blog(LOG_DEBUG,
@@ -56,6 +58,8 @@ static int load_module_exports(struct obs_module *mod, const char *path)
 	mod->description = os_dlsym(mod->module, "obs_module_description");
 	mod->author = os_dlsym(mod->module, "obs_module_author");
 	mod->get_string = os_dlsym(mod->module, "obs_module_get_string");
+	mod->load_flags = os_dlsym(mod->module, "obs_module_load_flags");
+	mod->types = os_dlsym(mod->module, "obs_module_types");
 	return MODULE_SUCCESS;
 }
 
@@ -156,6 +160,8 @@ bool obs_init_module(obs_module_t *module)
 		return false;
 	if (module->loaded)
 		return true;
+	if (os_atomic_exchange_bool(&module->deferred, false))
+		os_atomic_dec_long(&num_deferred);
 
 	const char *profile_name =
 		profile_store_name(obs_get_profiler_name_store(),
@@ -176,7 +182,8 @@ void obs_log_loaded_modules(void)
 	blog(LOG_INFO, "  Loaded Modules:");
 
 	for (obs_module_t *mod = obs->first_module; !!mod; mod = mod->next)
-		blog(LOG_INFO, "    %s", mod->file);
+		blog(LOG_INFO, "    %s%s", mod->file,
+		     os_atomic_load_bool(&mod->deferred) ? " (deferred)" : "");
 }
 
 const char *obs_get_module_file_name(obs_module_t *module)
@@ -274,8 +281,47 @@ void obs_add_module_path(const char *bin, const char *data)
 	da_push_back(obs->module_paths, &omp);
 }
 
+/*
+ * Modules are opened one after the other, then the ones that declare that
+ * their load function is safe to call from any thread are loaded in
+ * parallel, and then the rest are loaded on the calling thread in the order
+ * they were found.  Modules that declare the types they provide can wait to
+ * be loaded until one of those types is first looked up.
+ */
+
+#define MAX_LOAD_THREADS 4
+
+struct module_load_queue {
+	DARRAY(obs_module_t *) modules;
+	volatile long next;
+};
+
+struct load_all_data {
+	struct module_load_queue parallel;
+	DARRAY(obs_module_t *) serial;
+};
+
+static bool post_load_done = false;
+
+static inline uint32_t get_load_flags(obs_module_t *module)
+{
+	return module->load_flags ? module->load_flags() : 0;
+}
+
+static inline bool can_defer(obs_module_t *module)
+{
+	const char *const *types;
+
+	if ((get_load_flags(module) & OBS_MODULE_LOAD_DEFERRED) == 0)
+		return false;
+
+	types = module->types ? module->types() : NULL;
+	return types && *types;
+}
+
 static void load_all_callback(void *param, const struct obs_module_info *info)
 {
+	struct load_all_data *data = param;
 	obs_module_t *module;
 
 	if (!os_is_obs_plugin(info->bin_path))
@@ -289,33 +335,177 @@ static void load_all_callback(void *param, const struct obs_module_info *info)
 		return;
 	}
 
-	obs_init_module(module);
+	if (can_defer(module)) {
+		blog(LOG_DEBUG, "Deferring load of module '%s'", module->file);
+		module->deferred = true;
+		os_atomic_inc_long(&num_deferred);
+	} else if (get_load_flags(module) & OBS_MODULE_LOAD_THREAD_SAFE) {
+		da_push_back(data->parallel.modules, &module);
+	} else {
+		da_push_back(data->serial, &module);
+	}
+}
+
+static void load_queued_modules(struct module_load_queue *queue)
+{
+	const long count = (long)queue->modules.num;
+
+	for (;;) {
+		long idx = os_atomic_inc_long(&queue->next) - 1;
+		if (idx >= count)
+			break;
+
+		obs_init_module(queue->modules.array[idx]);
+	}
+}
+
+static const char *module_load_thread_name = "obs_load_all_modules: worker";
 
-	UNUSED_PARAMETER(param);
+static void *module_load_thread(void *param)
+{
+	os_set_thread_name("libobs: module loader");
+
+	profile_start(module_load_thread_name);
+	load_queued_modules(param);
+	profile_end(module_load_thread_name);
+	return NULL;
+}
+
+static void load_parallel(struct module_load_queue *queue)
+{
+	pthread_t threads[MAX_LOAD_THREADS];
+	size_t num_threads = 0;
+	int cores = os_get_logical_cores();
+	size_t max_threads = cores > 1 ? (size_t)cores - 1 : 0;
+
+	if (max_threads > MAX_LOAD_THREADS)
+		max_threads = MAX_LOAD_THREADS;
+	if (max_threads > queue->modules.num - 1)
+		max_threads = queue->modules.num - 1;
+
+	for (size_t i = 0; i < max_threads; i++) {
+		if (pthread_create(&threads[num_threads], NULL,
+				   module_load_thread, queue) != 0)
+			break;
+		num_threads++;
+	}
+
+	/* the calling thread takes its share too */
+	load_queued_modules(queue);
+
+	for (size_t i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
 }
 
 static const char *obs_load_all_modules_name = "obs_load_all_modules";
+static const char *open_modules_name = "open modules";
+static const char *load_parallel_name = "load thread-safe modules";
+static const char *load_serial_name = "load modules";
 #ifdef _WIN32
 static const char *reset_win32_symbol_paths_name = "reset_win32_symbol_paths";
 #endif
 
 void obs_load_all_modules(void)
 {
+	struct load_all_data data = {0};
+
 	profile_start(obs_load_all_modules_name);
-	obs_find_modules(load_all_callback, NULL);
+
+	profile_start(open_modules_name);
+	obs_find_modules(load_all_callback, &data);
+	profile_end(open_modules_name);
+
+	if (data.parallel.modules.num) {
+		profile_start(load_parallel_name);
+		load_parallel(&data.parallel);
+		profile_end(load_parallel_name);
+	}
+
+	profile_start(load_serial_name);
+	for (size_t i = 0; i < data.serial.num; i++)
+		obs_init_module(data.serial.array[i]);
+	profile_end(load_serial_name);
+
 #ifdef _WIN32
 	profile_start(reset_win32_symbol_paths_name);
 	reset_win32_symbol_paths();
 	profile_end(reset_win32_symbol_paths_name);
 #endif
 	profile_end(obs_load_all_modules_name);
+
+	da_free(data.parallel.modules);
+	da_free(data.serial);
 }
 
 void obs_post_load_modules(void)
 {
 	for (obs_module_t *mod = obs->first_module; !!mod; mod = mod->next)
-		if (mod->post_load)
+		if (mod->post_load && !os_atomic_load_bool(&mod->deferred))
 			mod->post_load();
+
+	post_load_done = true;
+}
+
+static const char *load_deferred_name = "load deferred module";
+
+static void load_deferred(obs_module_t *module, const char *reason)
+{
+	/* whoever clears the flag loads it */
+	if (!os_atomic_exchange_bool(&module->deferred, false))
+		return;
+
+	os_atomic_dec_long(&num_deferred);
+	blog(LOG_INFO, "Loading deferred module '%s' (%s)", module->file,
+	     reason);
+
+	profile_start(load_deferred_name);
+	if (obs_init_module(module) && post_load_done && module->post_load)
+		module->post_load();
+	profile_end(load_deferred_name);
+}
+
+/* versioned ids of sources are "<id>_v<version>" */
+static bool module_has_type(obs_module_t *module, const char *id)
+{
+	const char *const *types = module->types();
+
+	for (; types && *types; types++) {
+		size_t len = strlen(*types);
+
+		if (strncmp(id, *types, len) != 0)
+			continue;
+		if (!id[len] || (id[len] == '_' && id[len + 1] == 'v'))
+			return true;
+	}
+
+	return false;
+}
+
+static THREAD_LOCAL bool registering = false;
+
+bool obs_load_module_for_type(const char *id)
+{
+	if (!id || registering || !os_atomic_load_long(&num_deferred))
+		return false;
+
+	for (obs_module_t *mod = obs->first_module; !!mod; mod = mod->next) {
+		if (os_atomic_load_bool(&mod->deferred) &&
+		    module_has_type(mod, id)) {
+			load_deferred(mod, id);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void obs_load_deferred_modules(void)
+{
+	if (!obs || registering || !os_atomic_load_long(&num_deferred))
+		return;
+
+	for (obs_module_t *mod = obs->first_module; !!mod; mod = mod->next)
+		load_deferred(mod, "all types requested");
 }
 
 static inline void make_data_dir(struct dstr *parsed_data_dir,
@@ -607,7 +797,23 @@ cleanup:
 #define service_warn(format, ...) \
 	blog(LOG_WARNING, "obs_register_service: " format, ##__VA_ARGS__)
 
-void obs_register_source_s(const struct obs_source_info *info, size_t size)
+/* modules may be loaded in parallel, registration is done one at a time.
+ * lookups of a type during registration never load deferred modules */
+static pthread_mutex_t register_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void lock_registration(void)
+{
+	pthread_mutex_lock(&register_mutex);
+	registering = true;
+}
+
+static inline void unlock_registration(void)
+{
+	registering = false;
+	pthread_mutex_unlock(&register_mutex);
+}
+
+static void register_source(const struct obs_source_info *info, size_t size)
 {
 	struct obs_source_info data = {0};
 	struct darray *array = NULL;
@@ -713,7 +919,7 @@ error:
 	HANDLE_ERROR(size, obs_source_info, info);
 }
 
-void obs_register_output_s(const struct obs_output_info *info, size_t size)
+static void register_output(const struct obs_output_info *info, size_t size)
 {
 	if (find_output(info->id)) {
 		output_warn("Output id '%s' already exists!  "
@@ -756,7 +962,7 @@ error:
 	HANDLE_ERROR(size, obs_output_info, info);
 }
 
-void obs_register_encoder_s(const struct obs_encoder_info *info, size_t size)
+static void register_encoder(const struct obs_encoder_info *info, size_t size)
 {
 	if (find_encoder(info->id)) {
 		encoder_warn("Encoder id '%s' already exists!  "
@@ -771,9 +977,16 @@ void obs_register_encoder_s(const struct obs_encoder_info *info, size_t size)
 	CHECK_REQUIRED_VAL_(info, create, obs_register_encoder);
 	CHECK_REQUIRED_VAL_(info, destroy, obs_register_encoder);
 
-	if ((info->caps & OBS_ENCODER_CAP_PASS_TEXTURE) != 0)
-		CHECK_REQUIRED_VAL_(info, encode_texture, obs_register_encoder);
-	else
+	if ((info->caps & OBS_ENCODER_CAP_PASS_TEXTURE) != 0) {
+		bool has_texture2 =
+			offsetof(struct obs_encoder_info, encode_texture2) +
+					sizeof(info->encode_texture2) <=
+				size &&
+			info->encode_texture2;
+		if (!has_texture2)
+			CHECK_REQUIRED_VAL_(info, encode_texture,
+					    obs_register_encoder);
+	} else
 		CHECK_REQUIRED_VAL_(info, encode, obs_register_encoder);
 
 	if (info->type == OBS_ENCODER_AUDIO)
@@ -787,7 +1000,7 @@ error:
 	HANDLE_ERROR(size, obs_encoder_info, info);
 }
 
-void obs_register_service_s(const struct obs_service_info *info, size_t size)
+static void register_service(const struct obs_service_info *info, size_t size)
 {
 	if (find_service(info->id)) {
 		service_warn("Service id '%s' already exists!  "
@@ -810,7 +1023,7 @@ error:
 	HANDLE_ERROR(size, obs_service_info, info);
 }
 
-void obs_register_modal_ui_s(const struct obs_modal_ui *info, size_t size)
+static void register_modal_ui(const struct obs_modal_ui *info, size_t size)
 {
 #define CHECK_REQUIRED_VAL_(info, val, func) \
 	CHECK_REQUIRED_VAL(struct obs_modal_ui, info, val, func)
@@ -826,7 +1039,8 @@ error:
 	HANDLE_ERROR(size, obs_modal_ui, info);
 }
 
-void obs_register_modeless_ui_s(const struct obs_modeless_ui *info, size_t size)
+static void register_modeless_ui(const struct obs_modeless_ui *info,
+				 size_t size)
 {
 #define CHECK_REQUIRED_VAL_(info, val, func) \
 	CHECK_REQUIRED_VAL(struct obs_modeless_ui, info, val, func)
@@ -842,3 +1056,45 @@ void obs_register_modeless_ui_s(const struct obs_modeless_ui *info, size_t size)
 error:
 	HANDLE_ERROR(size, obs_modeless_ui, info);
 }
+
+void obs_register_source_s(const struct obs_source_info *info, size_t size)
+{
+	lock_registration();
+	register_source(info, size);
+	unlock_registration();
+}
+
+void obs_register_output_s(const struct obs_output_info *info, size_t size)
+{
+	lock_registration();
+	register_output(info, size);
+	unlock_registration();
+}
+
+void obs_register_encoder_s(const struct obs_encoder_info *info, size_t size)
+{
+	lock_registration();
+	register_encoder(info, size);
+	unlock_registration();
+}
+
+void obs_register_service_s(const struct obs_service_info *info, size_t size)
+{
+	lock_registration();
+	register_service(info, size);
+	unlock_registration();
+}
+
+void obs_register_modal_ui_s(const struct obs_modal_ui *info, size_t size)
+{
+	lock_registration();
+	register_modal_ui(info, size);
+	unlock_registration();
+}
+
+void obs_register_modeless_ui_s(const struct obs_modeless_ui *info, size_t size)
+{
+	lock_registration();
+	register_modeless_ui(info, size);
+	unlock_registration();
+}
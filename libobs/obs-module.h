@@ -100,6 +100,30 @@ MODULE_EXPORT void obs_module_unload(void);
 /** Optional: Called when all modules have finished loading */
 MODULE_EXPORT void obs_module_post_load(void);
 
+/** obs_module_load only registers types or does other work that is safe on
+ * any thread, and can be called alongside the loading of other modules */
+#define OBS_MODULE_LOAD_THREAD_SAFE (1 << 0)
+
+/** The module does not need to be loaded until one of the types listed by
+ * obs_module_types is needed */
+#define OBS_MODULE_LOAD_DEFERRED (1 << 1)
+
+/** Optional: Returns OBS_MODULE_LOAD_* flags for how the module can be
+ * loaded by obs_load_all_modules */
+MODULE_EXPORT uint32_t obs_module_load_flags(void);
+
+/**
+ * Optional: Returns a NULL terminated list of the ids of the sources,
+ * outputs, encoders and services the module registers, which is required
+ * for OBS_MODULE_LOAD_DEFERRED.  Sources are listed by their unversioned id.
+ */
+MODULE_EXPORT const char *const *obs_module_types(void);
+
+/** Optional: Use this macro in a module to declare its load flags */
+#define OBS_MODULE_LOAD_FLAGS(flags)                           \
+	MODULE_EXPORT uint32_t obs_module_load_flags(void);    \
+	uint32_t obs_module_load_flags(void) { return flags; }
+
 /** Called to set the current locale data for the module.  */
 MODULE_EXPORT void obs_module_set_locale(const char *locale);
 
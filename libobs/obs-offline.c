@@ -0,0 +1,202 @@
+#include "util/platform.h"
+#include "obs-internal.h"
+
+/*
+ * In offline mode the time of the frames the graphics thread renders is the
+ * clock of everything that paces itself with obs_get_clock_ns and
+ * obs_sleepto_clock_ns, the audio thread and media sources among them.  The
+ * graphics thread advances it by one frame interval as soon as the outputs
+ * can take another frame.  Threads sleeping on the clock that become due are
+ * woken, and the graphics thread waits for them to sleep again before it
+ * renders the frame, so their data for a frame is always there in time no
+ * matter how fast frames are rendered.
+ */
+
+/* a woken thread that doesn't sleep on the clock again within this time,
+ * such as a paused media source, is no longer waited for */
+#define MAX_WAKE_WAIT_MS 100
+
+struct clock_sleeper {
+	uint64_t deadline;
+	os_event_t *event;
+	long generation;
+};
+
+/* generation of the clock when this thread was woken, 0 while asleep */
+static THREAD_LOCAL long awake_generation = 0;
+
+bool obs_offline_clock_init(struct obs_offline_clock *clock)
+{
+	if (pthread_mutex_init(&clock->mutex, NULL) != 0)
+		return false;
+	if (os_event_init(&clock->idle_event, OS_EVENT_TYPE_AUTO) != 0) {
+		pthread_mutex_destroy(&clock->mutex);
+		return false;
+	}
+
+	clock->generation = 1;
+	clock->initialized = true;
+	return true;
+}
+
+void obs_offline_clock_free(struct obs_offline_clock *clock)
+{
+	if (!clock->initialized)
+		return;
+
+	os_event_destroy(clock->idle_event);
+	pthread_mutex_destroy(&clock->mutex);
+	da_free(clock->sleepers);
+	clock->initialized = false;
+}
+
+/* assumes the clock mutex */
+static void wake_sleepers(struct obs_offline_clock *clock, uint64_t time,
+			  long generation)
+{
+	for (size_t i = clock->sleepers.num; i > 0; i--) {
+		struct clock_sleeper *sleeper = clock->sleepers.array[i - 1];
+
+		if (sleeper->deadline > time)
+			continue;
+
+		/* the sleeper is on the stack of its thread, which returns
+		 * once it's signaled */
+		sleeper->generation = generation;
+		if (generation)
+			clock->awake++;
+		da_erase(clock->sleepers, i - 1);
+		os_event_signal(sleeper->event);
+	}
+}
+
+/* assumes the clock mutex */
+static inline void set_asleep(struct obs_offline_clock *clock)
+{
+	if (awake_generation == clock->generation) {
+		if (--clock->awake == 0)
+			os_event_signal(clock->idle_event);
+	}
+	awake_generation = 0;
+}
+
+void obs_offline_clock_advance(uint64_t time)
+{
+	struct obs_offline_clock *clock = &obs->offline_clock;
+	long awake;
+
+	pthread_mutex_lock(&clock->mutex);
+	os_atomic_store_long_long(&clock->time, (long long)time);
+	wake_sleepers(clock, time, clock->generation);
+	awake = clock->awake;
+	pthread_mutex_unlock(&clock->mutex);
+
+	while (awake) {
+		bool timed_out = os_event_timedwait(clock->idle_event,
+						    MAX_WAKE_WAIT_MS) ==
+				 ETIMEDOUT;
+
+		pthread_mutex_lock(&clock->mutex);
+		if (timed_out && clock->awake) {
+			blog(LOG_DEBUG, "Offline clock: %ld thread(s) did not "
+					"sleep again, not waiting for them",
+			     clock->awake);
+			clock->generation++;
+			clock->awake = 0;
+		}
+		awake = clock->awake;
+		pthread_mutex_unlock(&clock->mutex);
+	}
+}
+
+bool obs_set_offline_rendering(bool enable)
+{
+	struct obs_offline_clock *clock;
+
+	if (!obs)
+		return false;
+
+	if (obs_video_active()) {
+		blog(LOG_WARNING, "obs_set_offline_rendering: Cannot switch "
+				  "while outputs are active");
+		return false;
+	}
+
+	clock = &obs->offline_clock;
+
+	pthread_mutex_lock(&clock->mutex);
+
+	if (enable != clock->active) {
+		if (enable) {
+			os_atomic_store_long_long(
+				&clock->time, (long long)obs->video.video_time);
+		} else {
+			wake_sleepers(clock, UINT64_MAX, 0);
+			clock->generation++;
+			clock->awake = 0;
+		}
+
+		os_atomic_set_bool(&clock->active, enable);
+		blog(LOG_INFO, "Offline rendering %s",
+		     enable ? "enabled" : "disabled");
+	}
+
+	pthread_mutex_unlock(&clock->mutex);
+	return true;
+}
+
+bool obs_offline_rendering_active(void)
+{
+	return obs && os_atomic_load_bool(&obs->offline_clock.active);
+}
+
+uint64_t obs_get_clock_ns(void)
+{
+	if (obs_offline_rendering_active())
+		return (uint64_t)os_atomic_load_long_long(
+			&obs->offline_clock.time);
+
+	return os_gettime_ns();
+}
+
+bool obs_sleepto_clock_ns(uint64_t time_ns)
+{
+	struct obs_offline_clock *clock;
+	struct clock_sleeper sleeper = {time_ns, NULL, 0};
+	struct clock_sleeper *p = &sleeper;
+
+	if (!obs_offline_rendering_active())
+		return os_sleepto_ns(time_ns);
+
+	clock = &obs->offline_clock;
+
+	pthread_mutex_lock(&clock->mutex);
+	set_asleep(clock);
+
+	if (!clock->active) {
+		pthread_mutex_unlock(&clock->mutex);
+		return os_sleepto_ns(time_ns);
+	}
+
+	/* already due, keeps running as part of the current frame */
+	if ((uint64_t)clock->time >= time_ns) {
+		clock->awake++;
+		awake_generation = clock->generation;
+		pthread_mutex_unlock(&clock->mutex);
+		return false;
+	}
+
+	if (os_event_init(&sleeper.event, OS_EVENT_TYPE_MANUAL) != 0) {
+		pthread_mutex_unlock(&clock->mutex);
+		return false;
+	}
+
+	da_push_back(clock->sleepers, &p);
+	pthread_mutex_unlock(&clock->mutex);
+
+	os_event_wait(sleeper.event);
+	os_event_destroy(sleeper.event);
+
+	awake_generation = sleeper.generation;
+	return true;
+}
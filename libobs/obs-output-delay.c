@@ -16,8 +16,18 @@
 ******************************************************************************/
 
 #include <inttypes.h>
+#include "util/dstr.h"
+#include "util/platform.h"
 #include "obs-internal.h"
 
+/* segments are only deleted once all of their packets are sent, so smaller
+ * segments return the space sooner at the cost of more files */
+#define DELAY_SEGMENT_SIZE (64 * 1024 * 1024)
+
+/* packets are written and read back in order, so large stdio buffers make
+ * the file access sequential and read ahead of the packets being sent */
+#define DELAY_IO_BUFFER_SIZE (1024 * 1024)
+
 static inline bool delay_active(const struct obs_output *output)
 {
 	return os_atomic_load_bool(&output->delay_active);
@@ -28,6 +38,205 @@ static inline bool delay_capturing(const struct obs_output *output)
 	return os_atomic_load_bool(&output->delay_capturing);
 }
 
+/* ------------------------------------------------------------------------- */
+/* delay storage, only accessed with the delay mutex held */
+
+static void free_segment(struct delay_segment *seg)
+{
+	if (seg->write)
+		fclose(seg->write);
+	if (seg->read)
+		fclose(seg->read);
+	if (seg->path) {
+		os_unlink(seg->path);
+		bfree(seg->path);
+	}
+}
+
+static struct delay_segment *find_segment(struct obs_output *output,
+					  uint32_t id)
+{
+	for (size_t i = 0; i < output->delay_segments.num; i++) {
+		struct delay_segment *seg = output->delay_segments.array + i;
+		if (seg->id == id)
+			return seg;
+	}
+
+	return NULL;
+}
+
+static struct delay_segment *new_segment(struct obs_output *output)
+{
+	struct delay_segment seg = {0};
+	struct dstr path = {0};
+
+	seg.id = output->delay_next_segment++;
+
+	dstr_printf(&path, "%s/obs-delay-%p-%" PRIu32 ".bin",
+		    output->delay_storage_path, output, seg.id);
+
+	seg.write = os_fopen(path.array, "wb");
+	if (!seg.write) {
+		blog(LOG_WARNING,
+		     "Output '%s': Failed to create delay segment '%s'",
+		     output->context.name, path.array);
+		dstr_free(&path);
+		return NULL;
+	}
+
+	setvbuf(seg.write, NULL, _IOFBF, DELAY_IO_BUFFER_SIZE);
+	seg.path = path.array;
+
+	struct delay_segment *added = da_push_back_new(output->delay_segments);
+	*added = seg;
+	return added;
+}
+
+static struct delay_segment *write_segment(struct obs_output *output,
+					   size_t size)
+{
+	struct delay_segment *seg = da_end(output->delay_segments);
+
+	if (seg && seg->write &&
+	    (!seg->size || seg->size + size <= DELAY_SEGMENT_SIZE))
+		return seg;
+
+	/* the previous segment is complete, it's only read from here on */
+	if (seg && seg->write) {
+		fclose(seg->write);
+		seg->write = NULL;
+
+		if (!seg->packets) {
+			free_segment(seg);
+			da_pop_back(output->delay_segments);
+		}
+	}
+
+	return new_segment(output);
+}
+
+static void storage_failed(struct obs_output *output)
+{
+	if (!output->delay_storage_failed)
+		blog(LOG_WARNING,
+		     "Output '%s': Failed to write to the delay storage, "
+		     "delayed packets are kept in memory",
+		     output->context.name);
+
+	output->delay_storage_failed = true;
+}
+
+/* moves the data of a packet from memory to the storage */
+static void store_packet(struct obs_output *output, struct delay_data *dd)
+{
+	struct delay_segment *seg;
+
+	if (!output->delay_storage_path || output->delay_storage_failed)
+		return;
+
+	seg = write_segment(output, dd->packet.size);
+	if (!seg) {
+		storage_failed(output);
+		return;
+	}
+
+	if (fwrite(dd->packet.data, 1, dd->packet.size, seg->write) !=
+	    dd->packet.size) {
+		storage_failed(output);
+		return;
+	}
+
+	dd->stored = true;
+	dd->segment = seg->id;
+	dd->offset = seg->size;
+	seg->size += dd->packet.size;
+	seg->packets++;
+
+	obs_packet_pool_release(dd->packet.data);
+	dd->packet.data = NULL;
+}
+
+static void remove_segment_packet(struct obs_output *output,
+				  struct delay_segment *seg)
+{
+	if (--seg->packets || seg->write)
+		return;
+
+	free_segment(seg);
+	da_erase(output->delay_segments,
+		 (size_t)(seg - output->delay_segments.array));
+}
+
+/* reads the data of a stored packet back into memory */
+static bool load_packet(struct obs_output *output, struct delay_data *dd)
+{
+	struct delay_segment *seg = find_segment(output, dd->segment);
+	bool success = false;
+
+	if (!seg)
+		return false;
+
+	if (seg->write)
+		fflush(seg->write);
+
+	if (!seg->read) {
+		seg->read = os_fopen(seg->path, "rb");
+		if (seg->read)
+			setvbuf(seg->read, NULL, _IOFBF, DELAY_IO_BUFFER_SIZE);
+		seg->read_pos = 0;
+	}
+
+	if (seg->read) {
+		/* the segment may have grown since the last read hit its end */
+		clearerr(seg->read);
+
+		if (seg->read_pos != dd->offset) {
+			os_fseeki64(seg->read, (int64_t)dd->offset, SEEK_SET);
+			seg->read_pos = dd->offset;
+		}
+
+		dd->packet.data = obs_packet_pool_alloc(dd->packet.size);
+		success = fread(dd->packet.data, 1, dd->packet.size,
+				seg->read) == dd->packet.size;
+		seg->read_pos += dd->packet.size;
+	}
+
+	if (!success) {
+		blog(LOG_WARNING,
+		     "Output '%s': Failed to read a packet from the delay "
+		     "storage",
+		     output->context.name);
+		if (dd->packet.data)
+			obs_packet_pool_release(dd->packet.data);
+		dd->packet.data = NULL;
+	}
+
+	dd->stored = false;
+	remove_segment_packet(output, seg);
+	return success;
+}
+
+static void release_stored_packet(struct obs_output *output,
+				  struct delay_data *dd)
+{
+	struct delay_segment *seg = find_segment(output, dd->segment);
+
+	dd->stored = false;
+	if (seg)
+		remove_segment_packet(output, seg);
+}
+
+static void free_delay_storage(struct obs_output *output)
+{
+	for (size_t i = 0; i < output->delay_segments.num; i++)
+		free_segment(output->delay_segments.array + i);
+	da_free(output->delay_segments);
+
+	output->delay_storage_failed = false;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline void push_packet(struct obs_output *output,
 			       struct encoder_packet *packet, uint64_t t)
 {
@@ -35,9 +244,10 @@ static inline void push_packet(struct obs_output *output,
 
 	dd.msg = DELAY_MSG_PACKET;
 	dd.ts = t;
-	obs_encoder_packet_create_instance(&dd.packet, packet);
+	obs_encoder_packet_ref(&dd.packet, packet);
 
 	pthread_mutex_lock(&output->delay_mutex);
+	store_packet(output, &dd);
 	circlebuf_push_back(&output->delay_data, &dd, sizeof(dd));
 	pthread_mutex_unlock(&output->delay_mutex);
 }
@@ -47,6 +257,8 @@ static inline void process_delay_data(struct obs_output *output,
 {
 	switch (dd->msg) {
 	case DELAY_MSG_PACKET:
+		if (!dd->packet.data)
+			break;
 		if (!delay_active(output) || !delay_capturing(output))
 			obs_encoder_packet_release(&dd->packet);
 		else
@@ -65,12 +277,17 @@ void obs_output_cleanup_delay(obs_output_t *output)
 {
 	struct delay_data dd;
 
+	pthread_mutex_lock(&output->delay_mutex);
 	while (output->delay_data.size) {
 		circlebuf_pop_front(&output->delay_data, &dd, sizeof(dd));
+		if (dd.stored)
+			release_stored_packet(output, &dd);
 		if (dd.msg == DELAY_MSG_PACKET) {
 			obs_encoder_packet_release(&dd.packet);
 		}
 	}
+	free_delay_storage(output);
+	pthread_mutex_unlock(&output->delay_mutex);
 
 	output->active_delay_ns = 0;
 	os_atomic_set_long(&output->delay_restart_refs, 0);
@@ -99,6 +316,8 @@ static inline bool pop_packet(struct obs_output *output, uint64_t t)
 		} else if (elapsed_time > output->active_delay_ns) {
 			circlebuf_pop_front(&output->delay_data, NULL,
 					    sizeof(dd));
+			if (dd.stored)
+				load_packet(output, &dd);
 			popped = true;
 		}
 	}
@@ -212,3 +431,15 @@ uint32_t obs_output_get_active_delay(const obs_output_t *output)
 		       ? (uint32_t)(output->active_delay_ns / 1000000000ULL)
 		       : 0;
 }
+
+void obs_output_set_delay_storage(obs_output_t *output, const char *path)
+{
+	if (!obs_output_valid(output, "obs_output_set_delay_storage"))
+		return;
+
+	pthread_mutex_lock(&output->delay_mutex);
+	bfree(output->delay_storage_path);
+	output->delay_storage_path = path && *path ? bstrdup(path) : NULL;
+	output->delay_storage_failed = false;
+	pthread_mutex_unlock(&output->delay_mutex);
+}
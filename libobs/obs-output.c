@@ -54,7 +54,7 @@ static inline bool data_capture_ending(const struct obs_output *output)
 	return os_atomic_load_bool(&output->end_data_capture_thread_active);
 }
 
-const struct obs_output_info *find_output(const char *id)
+static const struct obs_output_info *find_loaded_output(const char *id)
 {
 	size_t i;
 	for (i = 0; i < obs->output_types.num; i++)
@@ -64,6 +64,15 @@ const struct obs_output_info *find_output(const char *id)
 	return NULL;
 }
 
+const struct obs_output_info *find_output(const char *id)
+{
+	const struct obs_output_info *info = find_loaded_output(id);
+
+	if (!info && obs_load_module_for_type(id))
+		info = find_loaded_output(id);
+	return info;
+}
+
 const char *obs_output_get_display_name(const char *id)
 {
 	const struct obs_output_info *info = find_output(id);
@@ -149,11 +158,17 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 	output->control->output = output;
 
 	obs_context_data_insert(&output->context, &obs->data.outputs_mutex,
-				&obs->data.first_output);
+				&obs->data.first_output,
+				&obs->data.output_index);
+
+	if (info) {
+		bmem_account_t *prev_account =
+			bmem_set_thread_account(output->context.mem_account);
 
-	if (info)
 		output->context.data =
 			info->create(output->context.settings, output);
+		bmem_set_thread_account(prev_account);
+	}
 	if (!output->context.data)
 		blog(LOG_ERROR, "Failed to create output '%s'!", name);
 
@@ -167,10 +182,16 @@ fail:
 
 static inline void free_packets(struct obs_output *output)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_encoder_packet_release(output->interleaved_packets.array +
-					   i);
-	da_free(output->interleaved_packets);
+	for (size_t i = 0; i < MAX_AUDIO_MIXES + 1; i++) {
+		struct circlebuf *track = &output->interleaved_tracks[i];
+		struct interleaved_packet packet;
+
+		while (track->size) {
+			circlebuf_pop_front(track, &packet, sizeof(packet));
+			obs_encoder_packet_release(&packet.packet);
+		}
+		circlebuf_free(track);
+	}
 }
 
 static inline void clear_audio_buffers(obs_output_t *output)
@@ -221,6 +242,8 @@ void obs_output_destroy(obs_output_t *output)
 		pthread_mutex_destroy(&output->pause.mutex);
 		pthread_mutex_destroy(&output->caption_mutex);
 		pthread_mutex_destroy(&output->interleaved_mutex);
+		obs_output_cleanup_delay(output);
+		bfree(output->delay_storage_path);
 		pthread_mutex_destroy(&output->delay_mutex);
 		os_event_destroy(output->reconnect_stop_event);
 		obs_context_data_free(&output->context);
@@ -252,8 +275,13 @@ bool obs_output_actual_start(obs_output_t *output)
 		output->last_error_message = NULL;
 	}
 
-	if (output->context.data)
+	if (output->context.data) {
+		bmem_account_t *prev_account =
+			bmem_set_thread_account(output->context.mem_account);
+
 		success = output->info.start(output->context.data);
+		bmem_set_thread_account(prev_account);
+	}
 
 	if (success && output->video) {
 		output->starting_frame_count =
@@ -925,6 +953,14 @@ void obs_output_set_reconnect_settings(obs_output_t *output, int retry_count,
 	output->reconnect_retry_sec = retry_sec;
 }
 
+void obs_output_set_fast_reconnect(obs_output_t *output, bool enable)
+{
+	if (!obs_output_valid(output, "obs_output_set_fast_reconnect"))
+		return;
+
+	output->fast_reconnect = enable;
+}
+
 uint64_t obs_output_get_total_bytes(const obs_output_t *output)
 {
 	if (!obs_output_valid(output, "obs_output_get_total_bytes"))
@@ -938,6 +974,13 @@ uint64_t obs_output_get_total_bytes(const obs_output_t *output)
 	return output->info.get_total_bytes(output->context.data);
 }
 
+uint64_t obs_output_get_memory_usage(const obs_output_t *output)
+{
+	return obs_output_valid(output, "obs_output_get_memory_usage")
+		       ? obs_context_data_memory_usage(&output->context)
+		       : 0;
+}
+
 int obs_output_get_frames_dropped(const obs_output_t *output)
 {
 	if (!obs_output_valid(output, "obs_output_get_frames_dropped"))
@@ -1206,43 +1249,28 @@ static inline bool has_higher_opposing_ts(struct obs_output *output,
 
 static const uint8_t nal_start[4] = {0, 0, 0, 1};
 
-static bool add_caption(struct obs_output *output, struct encoder_packet *out)
+/* renders the captions that are waiting into sei, caption data from sources
+ * before caption text */
+static bool build_caption_sei(struct obs_output *output, sei_t *sei)
 {
-	struct encoder_packet backup = *out;
-	sei_t sei;
-	uint8_t *data;
-	size_t size;
-	long ref = 1;
-
-	DARRAY(uint8_t) out_data;
-
-	if (out->priority > 1)
-		return false;
-
-	sei_init(&sei, 0.0);
-
-	da_init(out_data);
-	da_push_back_array(out_data, &ref, sizeof(ref));
-	da_push_back_array(out_data, out->data, out->size);
-
 	if (output->caption_data.size > 0) {
+		uint8_t caption_buf[3];
 
 		cea708_t cea708;
 		cea708_init(&cea708, 0); // set up a new popon frame
-		void *caption_buf = bzalloc(3 * sizeof(uint8_t));
 
 		while (output->caption_data.size > 0) {
 			circlebuf_pop_front(&output->caption_data, caption_buf,
-					    3 * sizeof(uint8_t));
+					    sizeof(caption_buf));
 
-			if ((((uint8_t *)caption_buf)[0] & 0x3) != 0) {
+			if ((caption_buf[0] & 0x3) != 0) {
 				// only send cea 608
 				continue;
 			}
 
-			uint16_t captionData = ((uint8_t *)caption_buf)[1];
+			uint16_t captionData = caption_buf[1];
 			captionData = captionData << 8;
-			captionData += ((uint8_t *)caption_buf)[2];
+			captionData += caption_buf[2];
 
 			// padding
 			if (captionData == 0x8080) {
@@ -1257,96 +1285,267 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 				continue;
 			}
 
-			cea708_add_cc_data(&cea708, 1,
-					   ((uint8_t *)caption_buf)[0] & 0x3,
+			cea708_add_cc_data(&cea708, 1, caption_buf[0] & 0x3,
 					   captionData);
 		}
 
-		bfree(caption_buf);
+		sei_init(sei, 0.0);
 
 		sei_message_t *msg =
 			sei_message_new(sei_type_user_data_registered_itu_t_t35,
 					0, CEA608_MAX_SIZE);
 		msg->size = cea708_render(&cea708, sei_message_data(msg),
 					  sei_message_size(msg));
-		sei_message_append(&sei, msg);
+		sei_message_append(sei, msg);
+		return true;
+
 	} else if (output->caption_head) {
 		caption_frame_t cf;
 		caption_frame_init(&cf);
 		caption_frame_from_text(&cf, &output->caption_head->text[0]);
 
-		sei_from_caption_frame(&sei, &cf);
+		sei_from_caption_frame(sei, &cf);
 
 		struct caption_text *next = output->caption_head->next;
 		bfree(output->caption_head);
 		output->caption_head = next;
+		if (!next)
+			output->caption_tail = NULL;
+		return true;
 	}
 
-	data = malloc(sei_render_size(&sei));
-	size = sei_render(&sei, data);
-	/* TODO SEI should come after AUD/SPS/PPS, but before any VCL */
-	da_push_back_array(out_data, nal_start, 4);
-	da_push_back_array(out_data, data, size);
-	free(data);
+	return false;
+}
 
-	obs_encoder_packet_release(out);
+double last_caption_timestamp = 0;
 
-	*out = backup;
-	out->data = (uint8_t *)out_data.array + sizeof(ref);
-	out->size = out_data.num - sizeof(ref);
+/* passes an SEI for each kind of caption that is due at frame_timestamp to
+ * send_sei, caption_mutex must be held */
+static void send_due_captions(struct obs_output *output, double frame_timestamp,
+			      void (*send_sei)(void *param, sei_t *sei),
+			      void *param)
+{
+	sei_t sei;
 
-	sei_free(&sei);
+	if (output->caption_head &&
+	    output->caption_timestamp <= frame_timestamp) {
+		blog(LOG_DEBUG, "Sending caption: %f \"%s\"", frame_timestamp,
+		     &output->caption_head->text[0]);
 
-	return true;
+		double display_duration =
+			output->caption_head->display_duration;
+
+		if (build_caption_sei(output, &sei)) {
+			send_sei(param, &sei);
+			sei_free(&sei);
+			output->caption_timestamp =
+				frame_timestamp + display_duration;
+		}
+	}
+
+	if (output->caption_data.size > 0 &&
+	    last_caption_timestamp < frame_timestamp) {
+		last_caption_timestamp = frame_timestamp;
+
+		if (build_caption_sei(output, &sei)) {
+			send_sei(param, &sei);
+			sei_free(&sei);
+		}
+	}
 }
 
-double last_caption_timestamp = 0;
+/* appends the SEI to the packet.  it's written in place if this output holds
+ * the only reference to the packet data and there's room left after it,
+ * otherwise the packet is copied once */
+static void append_caption_sei(void *param, sei_t *sei)
+{
+	struct encoder_packet *out = param;
+	size_t max_size = out->size + sizeof(nal_start) + sei_render_size(sei);
+	uint8_t *data = out->data;
 
-static inline void send_interleaved(struct obs_output *output)
+	if (!obs_packet_pool_unique(data) ||
+	    obs_packet_pool_capacity(data) < max_size) {
+		data = obs_packet_pool_alloc(max_size);
+		memcpy(data, out->data, out->size);
+		obs_packet_pool_release(out->data);
+		out->data = data;
+	}
+
+	/* TODO SEI should come after AUD/SPS/PPS, but before any VCL */
+	memcpy(data + out->size, nal_start, sizeof(nal_start));
+	out->size += sizeof(nal_start);
+	out->size += sei_render(sei, data + out->size);
+}
+
+static inline bool can_add_captions(const struct encoder_packet *out)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	if (out->priority > 1)
+		return false;
 
-	/* do not send an interleaved packet if there's no packet of the
-	 * opposing type of a higher timestamp in the interleave buffer.
-	 * this ensures that the timestamps are monotonic */
-	if (!has_higher_opposing_ts(output, &out))
+	/* encoders that embed the captions themselves already did */
+	if (out->encoder &&
+	    (out->encoder->info.caps & OBS_ENCODER_CAP_CAPTIONS) != 0)
+		return false;
+
+	/* the caption SEI is written as an AVC NAL unit */
+	return !out->encoder ||
+	       strcmp(obs_encoder_get_codec(out->encoder), "h264") == 0;
+}
+
+static void add_captions(struct obs_output *output, struct encoder_packet *out)
+{
+	if (!can_add_captions(out))
 		return;
 
-	da_erase(output->interleaved_packets, 0);
+	pthread_mutex_lock(&output->caption_mutex);
 
-	if (out.type == OBS_ENCODER_VIDEO) {
-		output->total_frames++;
+	double frame_timestamp =
+		(out->pts * out->timebase_num) / (double)out->timebase_den;
+	send_due_captions(output, frame_timestamp, append_caption_sei, out);
 
-		pthread_mutex_lock(&output->caption_mutex);
+	pthread_mutex_unlock(&output->caption_mutex);
+}
 
-		double frame_timestamp =
-			(out.pts * out.timebase_num) / (double)out.timebase_den;
+struct caption_sei_forward {
+	obs_encoder_sei_cb callback;
+	void *param;
+	bool sent;
+};
 
-		if (output->caption_head &&
-		    output->caption_timestamp <= frame_timestamp) {
-			blog(LOG_DEBUG, "Sending caption: %f \"%s\"",
-			     frame_timestamp, &output->caption_head->text[0]);
+static void forward_caption_sei(void *param, sei_t *sei)
+{
+	struct caption_sei_forward *forward = param;
 
-			double display_duration =
-				output->caption_head->display_duration;
+	for (sei_message_t *msg = sei_message_head(sei); msg;
+	     msg = sei_message_next(msg))
+		forward->callback(forward->param, (int)sei_message_type(msg),
+				  sei_message_data(msg), sei_message_size(msg));
 
-			if (add_caption(output, &out)) {
-				output->caption_timestamp =
-					frame_timestamp + display_duration;
-			}
-		}
+	forward->sent = true;
+}
 
-		if (output->caption_data.size > 0) {
-			if (last_caption_timestamp < frame_timestamp) {
-				last_caption_timestamp = frame_timestamp;
-				add_caption(output, &out);
-			}
+bool obs_output_get_encoder_captions(struct obs_output *output,
+				     double frame_timestamp,
+				     obs_encoder_sei_cb callback, void *param)
+{
+	struct caption_sei_forward forward = {callback, param, false};
+
+	pthread_mutex_lock(&output->caption_mutex);
+	send_due_captions(output, frame_timestamp, forward_caption_sei,
+			  &forward);
+	pthread_mutex_unlock(&output->caption_mutex);
+
+	return forward.sent;
+}
+
+/* ------------------------------------------------------------------------- */
+/* interleaving
+ *
+ * Every track keeps its packets in a queue of its own.  Encoders output
+ * packets in dts order, so the queues only ever grow at the back, and the
+ * next packet to send is the lowest of the queue fronts.  Packets are sorted
+ * by dts, then video before audio, then in the order they were received,
+ * which is the order a single sorted list of all the packets would have. */
+
+#define INTERLEAVED_TRACKS (MAX_AUDIO_MIXES + 1)
+
+static inline struct circlebuf *packet_track(struct obs_output *output,
+					     enum obs_encoder_type type,
+					     size_t audio_idx)
+{
+	return &output->interleaved_tracks[type == OBS_ENCODER_VIDEO
+						   ? 0
+						   : audio_idx + 1];
+}
+
+static inline size_t track_count(const struct circlebuf *track)
+{
+	return track->size / sizeof(struct interleaved_packet);
+}
+
+static inline struct interleaved_packet *track_packet(struct circlebuf *track,
+						      size_t idx)
+{
+	return circlebuf_data(track, idx * sizeof(struct interleaved_packet));
+}
+
+static inline struct interleaved_packet *track_front(struct circlebuf *track)
+{
+	return track->size ? track_packet(track, 0) : NULL;
+}
+
+static inline struct interleaved_packet *track_back(struct circlebuf *track)
+{
+	size_t count = track_count(track);
+	return count ? track_packet(track, count - 1) : NULL;
+}
+
+static inline bool packet_before(const struct interleaved_packet *a,
+				 const struct interleaved_packet *b)
+{
+	if (a->packet.dts_usec != b->packet.dts_usec)
+		return a->packet.dts_usec < b->packet.dts_usec;
+	if (a->packet.type != b->packet.type)
+		return a->packet.type == OBS_ENCODER_VIDEO;
+	return a->seq < b->seq;
+}
+
+/* returns the track with the packet that is sent next */
+static struct circlebuf *first_track(struct obs_output *output)
+{
+	struct interleaved_packet *first = NULL;
+	struct circlebuf *found = NULL;
+
+	/* with at most one video and six audio tracks, scanning the fronts is
+	 * cheaper than maintaining a heap */
+	for (size_t i = 0; i < INTERLEAVED_TRACKS; i++) {
+		struct circlebuf *track = &output->interleaved_tracks[i];
+		struct interleaved_packet *packet = track_front(track);
+
+		if (packet && (!first || packet_before(packet, first))) {
+			first = packet;
+			found = track;
 		}
+	}
+
+	return found;
+}
+
+static inline void release_front(struct circlebuf *track)
+{
+	struct interleaved_packet packet;
+
+	circlebuf_pop_front(track, &packet, sizeof(packet));
+	obs_encoder_packet_release(&packet.packet);
+}
+
+static inline void send_interleaved(struct obs_output *output)
+{
+	struct circlebuf *track = first_track(output);
+	struct interleaved_packet packet;
+	struct encoder_packet out;
+	bmem_account_t *prev_account;
+
+	if (!track)
+		return;
+
+	/* do not send an interleaved packet if there's no packet of the
+	 * opposing type of a higher timestamp in the interleave buffer.
+	 * this ensures that the timestamps are monotonic */
+	if (!has_higher_opposing_ts(output, &track_front(track)->packet))
+		return;
+
+	circlebuf_pop_front(track, &packet, sizeof(packet));
+	out = packet.packet;
 
-		pthread_mutex_unlock(&output->caption_mutex);
+	if (out.type == OBS_ENCODER_VIDEO) {
+		output->total_frames++;
+		add_captions(output, &out);
 	}
 
+	prev_account = bmem_set_thread_account(output->context.mem_account);
 	output->info.encoded_packet(output->context.data, &out);
+	bmem_set_thread_account(prev_account);
 	obs_encoder_packet_release(&out);
 }
 
@@ -1364,184 +1563,197 @@ static inline void set_higher_ts(struct obs_output *output,
 
 static inline struct encoder_packet *
 find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx);
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type,
-				      size_t audio_idx);
+		       size_t audio_idx)
+{
+	struct interleaved_packet *packet =
+		track_front(packet_track(output, type, audio_idx));
+	return packet ? &packet->packet : NULL;
+}
 
-/* gets the point where audio and video are closest together */
-static size_t get_interleaved_start_idx(struct obs_output *output)
+static inline struct encoder_packet *
+find_last_packet_type(struct obs_output *output, enum obs_encoder_type type,
+		      size_t audio_idx)
+{
+	struct interleaved_packet *packet =
+		track_back(packet_track(output, type, audio_idx));
+	return packet ? &packet->packet : NULL;
+}
+
+/* returns the packet of a track with the dts closest to dts_usec, the
+ * earlier one of two that are equally close */
+static struct interleaved_packet *closest_packet(struct circlebuf *track,
+						 int64_t dts_usec)
 {
+	size_t count = track_count(track);
+	size_t lo = 0;
+	size_t hi = count;
+
+	if (!count)
+		return NULL;
+
+	/* first packet at or after dts_usec */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (track_packet(track, mid)->packet.dts_usec < dts_usec)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == count)
+		return track_packet(track, count - 1);
+	if (lo == 0)
+		return track_packet(track, 0);
+
+	struct interleaved_packet *before = track_packet(track, lo - 1);
+	struct interleaved_packet *after = track_packet(track, lo);
+
+	if (llabs(after->packet.dts_usec - dts_usec) <
+	    llabs(before->packet.dts_usec - dts_usec))
+		return after;
+	return before;
+}
+
+/* gets the point where audio and video are closest together, the packet
+ * everything before is discarded */
+static struct interleaved_packet
+get_interleaved_start(struct obs_output *output)
+{
+	struct interleaved_packet *video =
+		track_front(packet_track(output, OBS_ENCODER_VIDEO, 0));
+	struct interleaved_packet *closest = NULL;
 	int64_t closest_diff = 0x7FFFFFFFFFFFFFFFLL;
-	struct encoder_packet *first_video =
-		find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
-	size_t video_idx = DARRAY_INVALID;
-	size_t idx = 0;
-
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		struct circlebuf *track =
+			packet_track(output, OBS_ENCODER_AUDIO, i);
+		struct interleaved_packet *audio;
 		int64_t diff;
 
-		if (packet->type != OBS_ENCODER_AUDIO) {
-			if (packet == first_video)
-				video_idx = i;
+		audio = closest_packet(track, video->packet.dts_usec);
+		if (!audio)
 			continue;
-		}
 
-		diff = llabs(packet->dts_usec - first_video->dts_usec);
-		if (diff < closest_diff) {
+		diff = llabs(audio->packet.dts_usec - video->packet.dts_usec);
+		if (diff < closest_diff ||
+		    (diff == closest_diff && packet_before(audio, closest))) {
 			closest_diff = diff;
-			idx = i;
+			closest = audio;
 		}
 	}
 
-	return video_idx < idx ? video_idx : idx;
+	return closest && packet_before(closest, video) ? *closest : *video;
+}
+
+/* discards the packets sorted before start, and start itself if inclusive */
+static void discard_before(struct obs_output *output,
+			   const struct interleaved_packet *start,
+			   bool inclusive)
+{
+	for (size_t i = 0; i < INTERLEAVED_TRACKS; i++) {
+		struct circlebuf *track = &output->interleaved_tracks[i];
+		struct interleaved_packet *packet;
+
+		while ((packet = track_front(track)) != NULL) {
+			if (!packet_before(packet, start) &&
+			    !(inclusive && packet->seq == start->seq))
+				break;
+
+			release_front(track);
+		}
+	}
 }
 
-static int prune_premature_packets(struct obs_output *output)
+/* returns false if a track is empty, otherwise sets prune if the first
+ * video packet is too far away from audio and everything up to the last
+ * track front has to be discarded */
+static bool prune_premature_packets(struct obs_output *output,
+				    struct interleaved_packet *prune_to,
+				    bool *prune)
 {
 	size_t audio_mixes = num_audio_mixes(output);
-	struct encoder_packet *video;
-	int video_idx;
-	int max_idx;
+	struct interleaved_packet *video;
+	struct interleaved_packet *last;
 	int64_t duration_usec;
 	int64_t max_diff = 0;
 	int64_t diff = 0;
 
-	video_idx = find_first_packet_type_idx(output, OBS_ENCODER_VIDEO, 0);
-	if (video_idx == -1) {
+	video = track_front(packet_track(output, OBS_ENCODER_VIDEO, 0));
+	if (!video) {
 		output->received_video = false;
-		return -1;
+		return false;
 	}
 
-	max_idx = video_idx;
-	video = &output->interleaved_packets.array[video_idx];
-	duration_usec = video->timebase_num * 1000000LL / video->timebase_den;
+	last = video;
+	duration_usec = video->packet.timebase_num * 1000000LL /
+			video->packet.timebase_den;
 
 	for (size_t i = 0; i < audio_mixes; i++) {
-		struct encoder_packet *audio;
-		int audio_idx;
+		struct interleaved_packet *audio;
 
-		audio_idx = find_first_packet_type_idx(output,
-						       OBS_ENCODER_AUDIO, i);
-		if (audio_idx == -1) {
+		audio = track_front(packet_track(output, OBS_ENCODER_AUDIO, i));
+		if (!audio) {
 			output->received_audio = false;
-			return -1;
+			return false;
 		}
 
-		audio = &output->interleaved_packets.array[audio_idx];
-		if (audio_idx > max_idx)
-			max_idx = audio_idx;
+		if (packet_before(last, audio))
+			last = audio;
 
-		diff = audio->dts_usec - video->dts_usec;
+		diff = audio->packet.dts_usec - video->packet.dts_usec;
 		if (diff > max_diff)
 			max_diff = diff;
 	}
 
-	return diff > duration_usec ? max_idx + 1 : 0;
-}
-
-static void discard_to_idx(struct obs_output *output, size_t idx)
-{
-	for (size_t i = 0; i < idx; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		obs_encoder_packet_release(packet);
-	}
-
-	da_erase_range(output->interleaved_packets, 0, idx);
+	*prune = diff > duration_usec;
+	*prune_to = *last;
+	return true;
 }
 
 #define DEBUG_STARTING_PACKETS 0
 
-static bool prune_interleaved_packets(struct obs_output *output)
-{
-	size_t start_idx = 0;
-	int prune_start = prune_premature_packets(output);
-
 #if DEBUG_STARTING_PACKETS == 1
-	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune_start);
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		blog(LOG_DEBUG, "packet: %s %d, ts: %lld, pruned = %s",
-		     packet->type == OBS_ENCODER_AUDIO ? "audio" : "video",
-		     (int)packet->track_idx, packet->dts_usec,
-		     (int)i < prune_start ? "true" : "false");
-	}
-#endif
-
-	/* prunes the first video packet if it's too far away from audio */
-	if (prune_start == -1)
-		return false;
-	else if (prune_start != 0)
-		start_idx = (size_t)prune_start;
-	else
-		start_idx = get_interleaved_start_idx(output);
-
-	if (start_idx)
-		discard_to_idx(output, start_idx);
-
-	return true;
-}
-
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type,
-				      size_t audio_idx)
-{
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
-
-			return (int)i;
+static void log_interleaved_packets(struct obs_output *output)
+{
+	for (size_t i = 0; i < INTERLEAVED_TRACKS; i++) {
+		struct circlebuf *track = &output->interleaved_tracks[i];
+
+		for (size_t j = 0; j < track_count(track); j++) {
+			struct encoder_packet *packet =
+				&track_packet(track, j)->packet;
+			blog(LOG_DEBUG, "packet: %s %d, ts: %lld",
+			     packet->type == OBS_ENCODER_AUDIO ? "audio"
+							       : "video",
+			     (int)packet->track_idx, packet->dts_usec);
 		}
 	}
-
-	return -1;
 }
+#endif
 
-static int find_last_packet_type_idx(struct obs_output *output,
-				     enum obs_encoder_type type,
-				     size_t audio_idx)
+static bool prune_interleaved_packets(struct obs_output *output)
 {
-	for (size_t i = output->interleaved_packets.num; i > 0; i--) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i - 1];
+	struct interleaved_packet prune_to;
+	bool prune = false;
 
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
-
-			return (int)(i - 1);
-		}
-	}
+	if (!prune_premature_packets(output, &prune_to, &prune))
+		return false;
 
-	return -1;
-}
+#if DEBUG_STARTING_PACKETS == 1
+	blog(LOG_DEBUG, "--------- Pruning! %s ---------",
+	     prune ? "premature" : "to start");
+	log_interleaved_packets(output);
+#endif
 
-static inline struct encoder_packet *
-find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx)
-{
-	int idx = find_first_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
+	/* prunes the first video packet if it's too far away from audio */
+	if (prune) {
+		discard_before(output, &prune_to, true);
+	} else {
+		struct interleaved_packet start =
+			get_interleaved_start(output);
+		discard_before(output, &start, false);
+	}
 
-static inline struct encoder_packet *
-find_last_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		      size_t audio_idx)
-{
-	int idx = find_last_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
+	return true;
 }
 
 static bool get_audio_and_video_packets(struct obs_output *output,
@@ -1574,7 +1786,7 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	struct encoder_packet *audio[MAX_AUDIO_MIXES];
 	struct encoder_packet *last_audio[MAX_AUDIO_MIXES];
 	size_t audio_mixes = num_audio_mixes(output);
-	size_t start_idx;
+	struct interleaved_packet start;
 
 	if (!get_audio_and_video_packets(output, &video, audio, audio_mixes))
 		return false;
@@ -1592,13 +1804,10 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	}
 
 	/* clear out excess starting audio if it hasn't been already */
-	start_idx = get_interleaved_start_idx(output);
-	if (start_idx) {
-		discard_to_idx(output, start_idx);
-		if (!get_audio_and_video_packets(output, &video, audio,
-						 audio_mixes))
-			return false;
-	}
+	start = get_interleaved_start(output);
+	discard_before(output, &start, false);
+	if (!get_audio_and_video_packets(output, &video, audio, audio_mixes))
+		return false;
 
 	/* get new offsets */
 	output->video_offset = video->pts;
@@ -1620,11 +1829,15 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	output->highest_audio_ts -= audio[0]->dts_usec;
 	output->highest_video_ts -= video->dts_usec;
 
-	/* apply new offsets to all existing packet DTS/PTS values */
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		apply_interleaved_packet_offset(output, packet);
+	/* apply new offsets to all existing packet DTS/PTS values.  the
+	 * offset is the same for all packets of a track, so the tracks stay
+	 * sorted */
+	for (size_t i = 0; i < INTERLEAVED_TRACKS; i++) {
+		struct circlebuf *track = &output->interleaved_tracks[i];
+
+		for (size_t j = 0; j < track_count(track); j++)
+			apply_interleaved_packet_offset(
+				output, &track_packet(track, j)->packet);
 	}
 
 	return true;
@@ -1633,51 +1846,34 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 static inline void insert_interleaved_packet(struct obs_output *output,
 					     struct encoder_packet *out)
 {
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
-
-		if (out->dts_usec == cur_packet->dts_usec &&
-		    out->type == OBS_ENCODER_VIDEO) {
-			break;
-		} else if (out->dts_usec < cur_packet->dts_usec) {
-			break;
-		}
-	}
-
-	da_insert(output->interleaved_packets, idx, out);
-}
-
-static void resort_interleaved_packets(struct obs_output *output)
-{
-	DARRAY(struct encoder_packet) old_array;
+	struct circlebuf *track =
+		packet_track(output, out->type, out->track_idx);
+	struct interleaved_packet packet = {*out, output->interleaved_seq++};
+	size_t idx = track_count(track);
 
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0,
-	       sizeof(output->interleaved_packets));
+	circlebuf_push_back(track, &packet, sizeof(packet));
 
-	for (size_t i = 0; i < old_array.num; i++)
-		insert_interleaved_packet(output, &old_array.array[i]);
-
-	da_free(old_array);
+	/* encoders output packets in dts order, this is only a fallback to
+	 * keep the track sorted if one doesn't */
+	while (idx > 0 &&
+	       track_packet(track, idx - 1)->packet.dts_usec > out->dts_usec) {
+		*track_packet(track, idx) = *track_packet(track, idx - 1);
+		*track_packet(track, idx - 1) = packet;
+		idx--;
+	}
 }
 
 static void discard_unused_audio_packets(struct obs_output *output,
 					 int64_t dts_usec)
 {
-	size_t idx = 0;
+	for (size_t i = 0; i < INTERLEAVED_TRACKS; i++) {
+		struct circlebuf *track = &output->interleaved_tracks[i];
+		struct interleaved_packet *packet;
 
-	for (; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *p =
-			&output->interleaved_packets.array[idx];
-
-		if (p->dts_usec >= dts_usec)
-			break;
+		while ((packet = track_front(track)) != NULL &&
+		       packet->packet.dts_usec < dts_usec)
+			release_front(track);
 	}
-
-	if (idx)
-		discard_to_idx(output, idx);
 }
 
 static void interleave_packets(void *data, struct encoder_packet *packet)
@@ -1707,10 +1903,12 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 
 	was_started = output->received_audio && output->received_video;
 
+	/* packets from the encoder are shared between its outputs, so only
+	 * take a reference instead of copying the data */
 	if (output->active_delay_ns)
 		out = *packet;
 	else
-		obs_encoder_packet_create_instance(&out, packet);
+		obs_encoder_packet_ref(&out, packet);
 
 	if (was_started)
 		apply_interleaved_packet_offset(output, &out);
@@ -1725,10 +1923,8 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->received_audio && output->received_video) {
 		if (!was_started) {
 			if (prune_interleaved_packets(output)) {
-				if (initialize_interleaved_packets(output)) {
-					resort_interleaved_packets(output);
+				if (initialize_interleaved_packets(output))
 					send_interleaved(output);
-				}
 			}
 		} else {
 			send_interleaved(output);
@@ -1743,10 +1939,15 @@ static void default_encoded_callback(void *param, struct encoder_packet *packet)
 	struct obs_output *output = param;
 
 	if (data_active(output)) {
+		bmem_account_t *prev_account;
+
 		if (packet->type == OBS_ENCODER_AUDIO)
 			packet->track_idx = get_track_index(output, packet);
 
+		prev_account =
+			bmem_set_thread_account(output->context.mem_account);
 		output->info.encoded_packet(output->context.data, packet);
+		bmem_set_thread_account(prev_account);
 
 		if (packet->type == OBS_ENCODER_VIDEO)
 			output->total_frames++;
@@ -1763,8 +1964,13 @@ static void default_raw_video_callback(void *param, struct video_data *frame)
 	if (video_pause_check(&output->pause, frame->timestamp))
 		return;
 
-	if (data_active(output))
+	if (data_active(output)) {
+		bmem_account_t *prev_account =
+			bmem_set_thread_account(output->context.mem_account);
+
 		output->info.raw_video(output->context.data, frame);
+		bmem_set_thread_account(prev_account);
+	}
 	output->total_frames++;
 }
 
@@ -1837,12 +2043,12 @@ static void default_raw_audio_callback(void *param, size_t mix_idx,
 	/* -------------- */
 
 	while (output->audio_buffer[mix_idx][0].size > frame_size_bytes) {
-		for (size_t i = 0; i < output->planes; i++) {
-			circlebuf_pop_front(&output->audio_buffer[mix_idx][i],
-					    output->audio_data[i],
-					    frame_size_bytes);
-			out.data[i] = (uint8_t *)output->audio_data[i];
-		}
+		/* the frame is handed to the output straight from the buffer,
+		 * which is only popped once the output is done with it */
+		for (size_t i = 0; i < output->planes; i++)
+			out.data[i] = circlebuf_peek_contiguous(
+				&output->audio_buffer[mix_idx][i],
+				frame_size_bytes);
 
 		out.frames = AUDIO_OUTPUT_FRAMES;
 		out.timestamp = output->audio_start_ts +
@@ -1860,6 +2066,10 @@ static void default_raw_audio_callback(void *param, size_t mix_idx,
 						&out);
 		else
 			output->info.raw_audio(output->context.data, &out);
+
+		for (size_t i = 0; i < output->planes; i++)
+			circlebuf_pop_front(&output->audio_buffer[mix_idx][i],
+					    NULL, frame_size_bytes);
 	}
 }
 
@@ -1967,7 +2177,7 @@ static inline void signal_reconnect(struct obs_output *output)
 
 	calldata_init_fixed(&params, stack, sizeof(stack));
 	calldata_set_int(&params, "timeout_sec",
-			 output->reconnect_retry_cur_sec);
+			 output->reconnect_wait_ms / 1000);
 	calldata_set_ptr(&params, "output", output);
 	signal_handler_signal(output->context.signals, "reconnect", &params);
 }
@@ -2349,7 +2559,7 @@ void obs_output_end_data_capture(obs_output_t *output)
 static void *reconnect_thread(void *param)
 {
 	struct obs_output *output = param;
-	unsigned long ms = output->reconnect_retry_cur_sec * 1000;
+	unsigned long ms = output->reconnect_wait_ms;
 
 	output->reconnect_thread_active = true;
 
@@ -2390,12 +2600,20 @@ static void output_reconnect(struct obs_output *output)
 		os_event_reset(output->reconnect_stop_event);
 	}
 
-	if (output->reconnect_retries) {
+	/* with fast reconnect the first retry is immediate and the waits
+	 * start from the second one */
+	if (output->reconnect_retries > (output->fast_reconnect ? 1 : 0)) {
 		output->reconnect_retry_cur_sec *= 2;
 		if (output->reconnect_retry_cur_sec > MAX_RETRY_SEC)
 			output->reconnect_retry_cur_sec = MAX_RETRY_SEC;
 	}
 
+	if (output->fast_reconnect && !output->reconnect_retries)
+		output->reconnect_wait_ms = 0;
+	else
+		output->reconnect_wait_ms =
+			(unsigned long)output->reconnect_retry_cur_sec * 1000;
+
 	output->reconnect_retries++;
 
 	output->stop_code = OBS_OUTPUT_DISCONNECTED;
@@ -2405,8 +2623,8 @@ static void output_reconnect(struct obs_output *output)
 		blog(LOG_WARNING, "Failed to create reconnect thread");
 		os_atomic_set_bool(&output->reconnecting, false);
 	} else {
-		blog(LOG_INFO, "Output '%s':  Reconnecting in %d seconds..",
-		     output->context.name, output->reconnect_retry_sec);
+		blog(LOG_INFO, "Output '%s':  Reconnecting in %lu seconds..",
+		     output->context.name, output->reconnect_wait_ms / 1000);
 
 		signal_reconnect(output);
 	}
@@ -2558,6 +2776,32 @@ static struct caption_text *caption_text_new(const char *text, size_t bytes,
 	return next;
 }
 
+void obs_output_update_caption_text(obs_output_t *output, const char *text,
+				    double display_duration)
+{
+	if (!obs_output_valid(output, "obs_output_update_caption_text"))
+		return;
+	if (!active(output))
+		return;
+
+	pthread_mutex_lock(&output->caption_mutex);
+
+	/* only the latest text of everything that hasn't been sent yet is
+	 * shown, and it's shown on the next frame */
+	while (output->caption_head) {
+		struct caption_text *next = output->caption_head->next;
+		bfree(output->caption_head);
+		output->caption_head = next;
+	}
+
+	output->caption_tail = caption_text_new(text, strlen(text), NULL,
+						&output->caption_head,
+						display_duration);
+	output->caption_timestamp = 0;
+
+	pthread_mutex_unlock(&output->caption_mutex);
+}
+
 void obs_output_output_caption_text1(obs_output_t *output, const char *text)
 {
 	if (!obs_output_valid(output, "obs_output_output_caption_text1"))
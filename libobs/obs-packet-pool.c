@@ -0,0 +1,210 @@
+#include <inttypes.h>
+
+#include "obs-internal.h"
+
+/*
+ * Reference counted buffers for encoded packet data.
+ *
+ * Every encoded packet is copied once into one of these buffers and then
+ * shared by reference between all outputs the encoder feeds.  Released
+ * buffers are kept on per-size free lists (one per power of two) so that the
+ * steady stream of similarly sized packets stops hitting the allocator.
+ */
+
+#define PACKET_HEADER_SIZE 32
+#define PACKET_MIN_SHIFT 8
+#define MAX_CACHED_PER_CLASS 32
+#define MAX_CACHED_BYTES (32 * 1024 * 1024)
+
+struct packet_block {
+	struct packet_block *next;
+	size_t size;
+	int size_class;
+	bool pooled;
+	volatile long refs;
+};
+
+static inline size_t class_size(int size_class)
+{
+	return (size_t)1 << (PACKET_MIN_SHIFT + size_class);
+}
+
+static int get_size_class(size_t size)
+{
+	for (int i = 0; i < PACKET_POOL_CLASSES; i++) {
+		if (size <= class_size(i))
+			return i;
+	}
+
+	return -1;
+}
+
+static inline uint8_t *block_data(struct packet_block *block)
+{
+	return (uint8_t *)block + PACKET_HEADER_SIZE;
+}
+
+static inline struct packet_block *data_block(uint8_t *data)
+{
+	return (struct packet_block *)(data - PACKET_HEADER_SIZE);
+}
+
+static inline const struct packet_block *const_data_block(const uint8_t *data)
+{
+	return (const struct packet_block *)(data - PACKET_HEADER_SIZE);
+}
+
+bool obs_packet_pool_init(struct obs_packet_pool *pool)
+{
+	memset(pool, 0, sizeof(*pool));
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		return false;
+
+	pool->mem_tag = bmem_register_tag("packets");
+	pool->initialized = true;
+	return true;
+}
+
+void obs_packet_pool_free(struct obs_packet_pool *pool)
+{
+	if (!pool->initialized)
+		return;
+
+	if (pool->allocations) {
+		blog(LOG_INFO,
+		     "Encoder packet pool: %" PRIu64 " allocations, "
+		     "%" PRIu64 " reused, %" PRIu64 " shared references",
+		     pool->allocations, pool->reused,
+		     (uint64_t)os_atomic_load_long_long(&pool->refs));
+	}
+
+	for (int i = 0; i < PACKET_POOL_CLASSES; i++) {
+		struct packet_block *block = pool->free_blocks[i];
+		while (block) {
+			struct packet_block *next = block->next;
+			bfree(block);
+			block = next;
+		}
+	}
+
+	pthread_mutex_destroy(&pool->mutex);
+	memset(pool, 0, sizeof(*pool));
+}
+
+static inline struct obs_packet_pool *get_pool(void)
+{
+	return obs && obs->packet_pool.initialized ? &obs->packet_pool : NULL;
+}
+
+uint8_t *obs_packet_pool_alloc(size_t size)
+{
+	struct obs_packet_pool *pool = get_pool();
+	struct packet_block *block = NULL;
+	int size_class = get_size_class(size);
+	size_t block_size = size_class >= 0 ? class_size(size_class) : size;
+
+	if (pool) {
+		pthread_mutex_lock(&pool->mutex);
+		pool->allocations++;
+
+		if (size_class >= 0 && pool->free_blocks[size_class]) {
+			block = pool->free_blocks[size_class];
+			pool->free_blocks[size_class] = block->next;
+			pool->free_count[size_class]--;
+			pool->bytes_cached -= block->size;
+			pool->reused++;
+		}
+
+		pool->bytes_in_use += block_size;
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	if (!block) {
+		int prev_tag = bmem_set_thread_tag(pool ? pool->mem_tag : 0);
+		block = bmalloc(PACKET_HEADER_SIZE + block_size);
+		bmem_set_thread_tag(prev_tag);
+
+		block->size = block_size;
+		block->size_class = size_class;
+		block->pooled = pool != NULL;
+	}
+
+	block->next = NULL;
+	block->refs = 1;
+	return block_data(block);
+}
+
+void obs_packet_pool_addref(uint8_t *data)
+{
+	struct obs_packet_pool *pool = get_pool();
+
+	os_atomic_inc_long(&data_block(data)->refs);
+	if (pool)
+		os_atomic_add_long_long(&pool->refs, 1);
+}
+
+void obs_packet_pool_release(uint8_t *data)
+{
+	struct packet_block *block = data_block(data);
+	struct obs_packet_pool *pool;
+	int size_class;
+
+	if (os_atomic_dec_long(&block->refs) != 0)
+		return;
+
+	/* buffers allocated before the pool existed are not accounted for */
+	pool = block->pooled ? get_pool() : NULL;
+	size_class = block->size_class;
+
+	if (pool) {
+		pthread_mutex_lock(&pool->mutex);
+		pool->bytes_in_use -= block->size;
+
+		if (size_class >= 0 &&
+		    pool->free_count[size_class] < MAX_CACHED_PER_CLASS &&
+		    pool->bytes_cached + block->size <= MAX_CACHED_BYTES) {
+			block->next = pool->free_blocks[size_class];
+			pool->free_blocks[size_class] = block;
+			pool->free_count[size_class]++;
+			pool->bytes_cached += block->size;
+			block = NULL;
+		}
+
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	bfree(block);
+}
+
+size_t obs_packet_pool_capacity(const uint8_t *data)
+{
+	return const_data_block(data)->size;
+}
+
+bool obs_packet_pool_unique(const uint8_t *data)
+{
+	return const_data_block(data)->refs == 1;
+}
+
+void obs_get_packet_pool_stats(struct obs_packet_pool_stats *stats)
+{
+	struct obs_packet_pool *pool;
+
+	if (!obs_ptr_valid(stats, "obs_get_packet_pool_stats"))
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+
+	pool = get_pool();
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	stats->allocations = pool->allocations;
+	stats->reused = pool->reused;
+	stats->bytes_in_use = pool->bytes_in_use;
+	stats->bytes_cached = pool->bytes_cached;
+	pthread_mutex_unlock(&pool->mutex);
+
+	stats->shared_refs = (uint64_t)os_atomic_load_long_long(&pool->refs);
+}
@@ -19,6 +19,7 @@
 #include "util/threading.h"
 #include "util/util_uint64.h"
 #include "graphics/math-defs.h"
+#include "media-io/audio-mixing.h"
 #include "obs-scene.h"
 #include "obs-internal.h"
 
@@ -65,7 +66,7 @@ static inline void signal_item_remove(struct obs_scene_item *item)
 	uint8_t stack[128];
 
 	calldata_init_fixed(&params, stack, sizeof(stack));
-	calldata_set_ptr(&params, "item", item);
+	calldata_add_ptr(&params, "item", item);
 
 	signal_parent(item->parent, "item_remove", &params);
 }
@@ -97,6 +98,8 @@ static void *scene_create(obs_data_t *settings, struct obs_source *source)
 
 	signal_handler_add_array(obs_source_get_signal_handler(source),
 				 obs_scene_signals);
+	scene->transform_signal = signal_handler_get_handle(
+		obs_source_get_signal_handler(source), "item_transform");
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		goto fail;
@@ -153,9 +156,9 @@ static inline void remove_without_release(struct obs_scene_item *item)
 static void remove_all_items(struct obs_scene *scene)
 {
 	struct obs_scene_item *item;
-	DARRAY(struct obs_scene_item *) items;
+	DARRAY_INLINE(struct obs_scene_item *, 32) items;
 
-	da_init(items);
+	da_inline_init(items);
 
 	full_lock(scene);
 
@@ -166,14 +169,14 @@ static void remove_all_items(struct obs_scene *scene)
 		item = item->next;
 
 		remove_without_release(del_item);
-		da_push_back(items, &del_item);
+		da_inline_push_back(items, &del_item);
 	}
 
 	full_unlock(scene);
 
 	for (size_t i = 0; i < items.num; i++)
 		obs_sceneitem_release(items.array[i]);
-	da_free(items);
+	da_inline_free(items);
 }
 
 static void scene_destroy(void *data)
@@ -335,6 +338,39 @@ static inline uint32_t calc_cy(const struct obs_scene_item *item,
 	return (crop_cy > height) ? 2 : (height - crop_cy);
 }
 
+/* exact for multiples of 90 degrees, so that such items stay pixel aligned */
+static void get_rotation(float rot, float *sin_rot, float *cos_rot)
+{
+	static const float quadrant_sin[4] = {0.0f, 1.0f, 0.0f, -1.0f};
+	float quadrants = rot / 90.0f;
+
+	if (quadrants == floorf(quadrants) && fabsf(quadrants) < 1e6f) {
+		int q = (int)fmodf(quadrants, 4.0f);
+		if (q < 0)
+			q += 4;
+		*sin_rot = quadrant_sin[q];
+		*cos_rot = quadrant_sin[(q + 1) % 4];
+	} else {
+		*sin_rot = sinf(RAD(rot));
+		*cos_rot = cosf(RAD(rot));
+	}
+}
+
+/* the product of scaling by scale, translating by -origin, rotating around
+ * z and translating by pos, built directly instead of multiplied out */
+static void make_item_transform(struct matrix4 *dst, const struct vec2 *scale,
+				const struct vec2 *origin,
+				const struct vec2 *pos, float sin_rot,
+				float cos_rot)
+{
+	vec4_set(&dst->x, scale->x * cos_rot, scale->x * sin_rot, 0.0f, 0.0f);
+	vec4_set(&dst->y, -scale->y * sin_rot, scale->y * cos_rot, 0.0f, 0.0f);
+	vec4_set(&dst->z, 0.0f, 0.0f, 1.0f, 0.0f);
+	vec4_set(&dst->t, pos->x - origin->x * cos_rot + origin->y * sin_rot,
+		 pos->y - origin->x * sin_rot - origin->y * cos_rot, 0.0f,
+		 1.0f);
+}
+
 static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 {
 	uint32_t width;
@@ -346,10 +382,14 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 	struct vec2 scale;
 	struct calldata params;
 	uint8_t stack[128];
+	float sin_rot, cos_rot;
 
 	if (os_atomic_load_long(&item->defer_update) > 0)
 		return;
 
+	/* crop or size may have changed */
+	item->cache_valid = false;
+
 	width = obs_source_get_width(item->source);
 	height = obs_source_get_height(item->source);
 	cx = calc_cx(item, width);
@@ -375,17 +415,15 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 
 	add_alignment(&origin, item->align, (int)cx, (int)cy);
 
-	matrix4_identity(&item->draw_transform);
-	matrix4_scale3f(&item->draw_transform, &item->draw_transform, scale.x,
-			scale.y, 1.0f);
-	matrix4_translate3f(&item->draw_transform, &item->draw_transform,
-			    -origin.x, -origin.y, 0.0f);
-	matrix4_rotate_aa4f(&item->draw_transform, &item->draw_transform, 0.0f,
-			    0.0f, 1.0f, RAD(item->rot));
-	matrix4_translate3f(&item->draw_transform, &item->draw_transform,
-			    item->pos.x, item->pos.y, 0.0f);
+	get_rotation(item->rot, &sin_rot, &cos_rot);
+	make_item_transform(&item->draw_transform, &scale, &origin, &item->pos,
+			    sin_rot, cos_rot);
 
 	item->output_scale = scale;
+	item->size_hint_cx =
+		(uint32_t)((float)item->last_width * fabsf(scale.x) + 0.5f);
+	item->size_hint_cy =
+		(uint32_t)((float)item->last_height * fabsf(scale.y) + 0.5f);
 
 	/* ----------------------- */
 
@@ -400,21 +438,16 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 
 	add_alignment(&base_origin, item->align, (int)scale.x, (int)scale.y);
 
-	matrix4_identity(&item->box_transform);
-	matrix4_scale3f(&item->box_transform, &item->box_transform, scale.x,
-			scale.y, 1.0f);
-	matrix4_translate3f(&item->box_transform, &item->box_transform,
-			    -base_origin.x, -base_origin.y, 0.0f);
-	matrix4_rotate_aa4f(&item->box_transform, &item->box_transform, 0.0f,
-			    0.0f, 1.0f, RAD(item->rot));
-	matrix4_translate3f(&item->box_transform, &item->box_transform,
-			    item->pos.x, item->pos.y, 0.0f);
+	make_item_transform(&item->box_transform, &scale, &base_origin,
+			    &item->pos, sin_rot, cos_rot);
 
 	/* ----------------------- */
 
 	calldata_init_fixed(&params, stack, sizeof(stack));
-	calldata_set_ptr(&params, "item", item);
-	signal_parent(item->parent, "item_transform", &params);
+	calldata_add_ptr(&params, "item", item);
+	calldata_add_ptr(&params, "scene", item->parent);
+	signal_handler_signal_handle(item->parent->source->context.signals,
+				     item->parent->transform_signal, &params);
 
 	if (!update_tex)
 		return;
@@ -423,6 +456,8 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 		obs_enter_graphics();
 		gs_texrender_destroy(item->item_render);
 		item->item_render = NULL;
+		item->gpu_bytes = 0;
+		obs_gpu_resource_set_size(item->gpu_resource, 0);
 		obs_leave_graphics();
 
 	} else if (!item->item_render && item_texture_enabled(item)) {
@@ -457,26 +492,79 @@ static inline bool item_is_scene(const struct obs_scene_item *item)
 	return item->source && item->source->info.type == OBS_SOURCE_TYPE_SCENE;
 }
 
+static inline bool item_size_hint_enabled(const struct obs_scene_item *item)
+{
+	return item->source && (item->source->info.output_flags &
+				OBS_SOURCE_SIZE_HINT) != 0;
+}
+
+static inline bool item_cache_enabled(const struct obs_scene_item *item)
+{
+	return item->source && (item->source->info.output_flags &
+				OBS_SOURCE_CACHEABLE_VIDEO) != 0;
+}
+
+/* returns the minimum time between renders of the item's source, 0 if it
+ * renders every frame */
+static inline uint64_t item_render_interval(const struct obs_scene_item *item)
+{
+	double fps = item->max_render_fps;
+
+	if (item->source && item->source->max_render_fps > 0.0 &&
+	    (fps <= 0.0 || item->source->max_render_fps < fps))
+		fps = item->source->max_render_fps;
+
+	return fps > 0.0 ? (uint64_t)(1000000000.0 / fps) : 0;
+}
+
 static inline bool item_texture_enabled(const struct obs_scene_item *item)
 {
 	return crop_enabled(&item->crop) || scale_filter_enabled(item) ||
-	       (item_is_scene(item) && !item->is_group);
+	       (item_is_scene(item) && !item->is_group) ||
+	       item_cache_enabled(item) || item_render_interval(item) != 0;
 }
 
-static void render_item_texture(struct obs_scene_item *item)
+static inline bool item_cache_current(const struct obs_scene_item *item,
+				      long version, long rebuilds, uint32_t cx,
+				      uint32_t cy)
 {
-	gs_texture_t *tex = gs_texrender_get_texture(item->item_render);
-	if (!tex) {
-		return;
-	}
+	return item->cache_valid && item->cache_version == version &&
+	       item->cache_rebuilds == rebuilds && item->cache_cx == cx &&
+	       item->cache_cy == cy;
+}
 
-	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_ITEM_TEXTURE,
-			      "render_item_texture");
+/* the last render is reused until the interval has passed, counted from the
+ * middle of the frame so a 30 fps limit at 60 fps renders every other one */
+static inline bool item_render_throttled(const struct obs_scene_item *item,
+					 long rebuilds, uint32_t cx,
+					 uint32_t cy)
+{
+	uint64_t interval = item_render_interval(item);
+	uint64_t half_frame = obs->video.video_frame_interval_ns / 2;
+
+	return interval && item->cache_render_ts &&
+	       item->cache_rebuilds == rebuilds && item->cache_cx == cx &&
+	       item->cache_cy == cy &&
+	       obs->video.video_time - item->cache_render_ts + half_frame <
+		       interval;
+}
+
+/* items that are drawn straight from their source's texture when there is
+ * one, rather than rendered to a texture of their own first */
+static inline bool item_direct_enabled(const struct obs_scene_item *item)
+{
+	return !item_is_scene(item) && !item_cache_enabled(item) &&
+	       !item_render_interval(item);
+}
 
+/* selects the effect that draws a texture of the given size with the item's
+ * scale filter */
+static gs_effect_t *select_scale_effect(struct obs_scene_item *item,
+					uint32_t cx, uint32_t cy,
+					const char **tech_name)
+{
 	gs_effect_t *effect = obs->video.default_effect;
 	enum obs_scale_type type = item->scale_filter;
-	uint32_t cx = gs_texture_get_width(tex);
-	uint32_t cy = gs_texture_get_height(tex);
 	const char *tech = "Draw";
 
 	if (type != OBS_SCALE_DISABLE) {
@@ -524,6 +612,25 @@ static void render_item_texture(struct obs_scene_item *item)
 		}
 	}
 
+	*tech_name = tech;
+	return effect;
+}
+
+static void render_item_texture(struct obs_scene_item *item)
+{
+	gs_texture_t *tex = gs_texrender_get_texture(item->item_render);
+	if (!tex) {
+		return;
+	}
+
+	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_ITEM_TEXTURE,
+			      "render_item_texture");
+
+	const char *tech;
+	gs_effect_t *effect = select_scale_effect(
+		item, gs_texture_get_width(tex), gs_texture_get_height(tex),
+		&tech);
+
 	gs_blend_state_push();
 	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
 
@@ -535,11 +642,97 @@ static void render_item_texture(struct obs_scene_item *item)
 	GS_DEBUG_MARKER_END();
 }
 
+static void draw_texture_subregion(gs_texture_t *tex, bool flip, uint32_t x,
+				   uint32_t y, uint32_t cx, uint32_t cy)
+{
+	gs_effect_t *effect = gs_get_effect();
+	const bool linear_srgb = gs_get_linear_srgb();
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+
+	gs_enable_framebuffer_srgb(linear_srgb);
+	if (linear_srgb)
+		gs_effect_set_texture_srgb(image, tex);
+	else
+		gs_effect_set_texture(image, tex);
+
+	gs_draw_sprite_subregion(tex, flip ? GS_FLIP_V : 0, x, y, cx, cy);
+	gs_enable_framebuffer_srgb(previous);
+}
+
+/* draws the cropped part of the source without rendering it to a texture
+ * first, returns false if the source can't be drawn that way */
+static bool render_item_direct(struct obs_scene_item *item, uint32_t width,
+			       uint32_t height)
+{
+	uint32_t cx = calc_cx(item, width);
+	uint32_t cy = calc_cy(item, height);
+	uint32_t x = (uint32_t)item->crop.left;
+	uint32_t y;
+	gs_texture_t *tex;
+	bool flip;
+
+	if (!cx || !cy)
+		return false;
+
+	tex = obs_source_get_texture(item->source, &flip);
+	y = (uint32_t)(flip ? item->crop.bottom : item->crop.top);
+
+	if (tex) {
+		const char *tech;
+		gs_effect_t *effect = select_scale_effect(item, width, height,
+							  &tech);
+
+		/* the source's texture has straight alpha, unlike the item's
+		 * own, so it's drawn with the blending the source gets */
+		GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_ITEM_TEXTURE,
+				      "render_item_direct");
+		while (gs_effect_loop(effect, tech))
+			draw_texture_subregion(tex, flip, x, y, cx, cy);
+		GS_DEBUG_MARKER_END();
+		return true;
+	}
+
+	/* frames converted while drawing can't be scaled by another effect */
+	return item->scale_filter == OBS_SCALE_DISABLE &&
+	       obs_source_draw_async_subregion(item->source, x, y, cx, cy);
+}
+
+static inline void update_item_gpu_size(struct obs_scene_item *item,
+					uint32_t cx, uint32_t cy)
+{
+	uint64_t bytes = (uint64_t)cx * cy * 4;
+
+	if (item->gpu_bytes != bytes) {
+		item->gpu_bytes = bytes;
+		obs_gpu_resource_set_size(item->gpu_resource, bytes);
+	}
+}
+
+/* the texture is rendered again the next time the item is drawn */
+static void sceneitem_evict(void *param)
+{
+	struct obs_scene_item *item = param;
+
+	if (!item->item_render)
+		return;
+
+	gs_texrender_destroy(item->item_render);
+	item->item_render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	item->gpu_bytes = 0;
+	item->cache_valid = false;
+	item->cache_render_ts = 0;
+}
+
 static inline void render_item(struct obs_scene_item *item)
 {
 	GS_DEBUG_MARKER_BEGIN_FORMAT(GS_DEBUG_COLOR_ITEM, "Item: %s",
 				     obs_source_get_name(item->source));
 
+	if (item_size_hint_enabled(item))
+		obs_source_add_size_hint(item->source, item->size_hint_cx,
+					 item->size_hint_cy);
+
 	if (item->item_render) {
 		uint32_t width = obs_source_get_width(item->source);
 		uint32_t height = obs_source_get_height(item->source);
@@ -548,10 +741,40 @@ static inline void render_item(struct obs_scene_item *item)
 			goto cleanup;
 		}
 
+		if (item_direct_enabled(item)) {
+			const bool previous = gs_set_linear_srgb(true);
+			bool drawn;
+
+			gs_matrix_push();
+			gs_matrix_mul(&item->draw_transform);
+			drawn = render_item_direct(item, width, height);
+			gs_matrix_pop();
+			gs_set_linear_srgb(previous);
+
+			if (drawn) {
+				/* the item's own texture isn't needed while
+				 * the source can be drawn directly */
+				if (gs_texrender_get_texture(item->item_render))
+					sceneitem_evict(item);
+				goto cleanup;
+			}
+		}
+
 		uint32_t cx = calc_cx(item, width);
 		uint32_t cy = calc_cy(item, height);
 
-		if (cx && cy && gs_texrender_begin(item->item_render, cx, cy)) {
+		long rebuilds = os_atomic_load_long(&obs->video.device_rebuilds);
+		long version = 0;
+		bool cacheable =
+			obs_source_get_content_version(item->source, &version);
+
+		if (cacheable &&
+		    item_cache_current(item, version, rebuilds, cx, cy)) {
+			/* nothing changed, composite the cached texture */
+		} else if (item_render_throttled(item, rebuilds, cx, cy)) {
+			/* rendered recently enough for its rate limit */
+		} else if (cx && cy &&
+			   gs_texrender_begin(item->item_render, cx, cy)) {
 			float cx_scale = (float)width / (float)cx;
 			float cy_scale = (float)height / (float)cy;
 			struct vec4 clear_color;
@@ -568,6 +791,14 @@ static inline void render_item(struct obs_scene_item *item)
 			obs_source_video_render(item->source);
 
 			gs_texrender_end(item->item_render);
+			update_item_gpu_size(item, cx, cy);
+
+			item->cache_valid = cacheable;
+			item->cache_version = version;
+			item->cache_rebuilds = rebuilds;
+			item->cache_cx = cx;
+			item->cache_cy = cy;
+			item->cache_render_ts = obs->video.video_time;
 		}
 	}
 
@@ -575,6 +806,7 @@ static inline void render_item(struct obs_scene_item *item)
 	gs_matrix_push();
 	gs_matrix_mul(&item->draw_transform);
 	if (item->item_render) {
+		obs_gpu_resource_touch(item->gpu_resource);
 		render_item_texture(item);
 	} else {
 		obs_source_video_render(item->source);
@@ -640,6 +872,10 @@ update_transforms_and_prune_sources(obs_scene_t *scene,
 
 			update_item_transform(item, true);
 			rebuild_group = true;
+
+		} else if (!item->item_render != !item_texture_enabled(item)) {
+			/* the render rate limit of the source changed */
+			update_item_transform(item, true);
 		}
 
 		item = item->next;
@@ -649,6 +885,50 @@ update_transforms_and_prune_sources(obs_scene_t *scene,
 		resize_group(group_sceneitem);
 }
 
+/* mixes everything about the items that affects the output of the scene,
+ * false if an item can change without it or has changes pending */
+bool obs_scene_get_video_version(obs_scene_t *scene, uint64_t *version)
+{
+	struct obs_scene_item *item;
+	uint64_t hash = OBS_VERSION_INIT;
+	bool cacheable = true;
+
+	video_lock(scene);
+
+	hash = OBS_VERSION_MIX(hash, scene->cx);
+	hash = OBS_VERSION_MIX(hash, scene->cy);
+
+	for (item = scene->first_item; item; item = item->next) {
+		uint64_t source_version;
+
+		hash = OBS_VERSION_MIX(hash, item);
+		hash = OBS_VERSION_MIX(hash, item->user_visible);
+
+		if (!item->user_visible ||
+		    (item->source->info.output_flags & OBS_SOURCE_VIDEO) == 0)
+			continue;
+
+		if (obs_source_removed(item->source) ||
+		    os_atomic_load_bool(&item->update_transform) ||
+		    source_size_changed(item) ||
+		    !obs_source_get_video_version(item->source,
+						  &source_version)) {
+			cacheable = false;
+			break;
+		}
+
+		hash = OBS_VERSION_MIX(hash, source_version);
+		hash = OBS_VERSION_MIX(hash, item->crop);
+		hash = OBS_VERSION_MIX(hash, item->scale_filter);
+		hash = OBS_VERSION_MIX(hash, item->draw_transform);
+	}
+
+	video_unlock(scene);
+
+	*version = hash;
+	return cacheable;
+}
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	DARRAY(struct obs_scene_item *) remove_items;
@@ -666,6 +946,7 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 
 	gs_blend_state_push();
 	gs_reset_blend_state();
+	gs_sprite_batch_begin();
 
 	item = scene->first_item;
 	while (item) {
@@ -675,6 +956,7 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 		item = item->next;
 	}
 
+	gs_sprite_batch_end();
 	gs_blend_state_pop();
 
 	video_unlock(scene);
@@ -776,6 +1058,8 @@ static void scene_load_item(struct obs_scene *scene, obs_data_t *item_data)
 	item->crop.right = (uint32_t)obs_data_get_int(item_data, "crop_right");
 	item->crop.bottom =
 		(uint32_t)obs_data_get_int(item_data, "crop_bottom");
+	item->max_render_fps =
+		obs_data_get_double(item_data, "max_render_fps");
 
 	scale_filter_str = obs_data_get_string(item_data, "scale_filter");
 	item->scale_filter = OBS_SCALE_DISABLE;
@@ -797,6 +1081,8 @@ static void scene_load_item(struct obs_scene *scene, obs_data_t *item_data)
 		obs_enter_graphics();
 		gs_texrender_destroy(item->item_render);
 		item->item_render = NULL;
+		item->gpu_bytes = 0;
+		obs_gpu_resource_set_size(item->gpu_resource, 0);
 		obs_leave_graphics();
 
 	} else if (!item->item_render && item_texture_enabled(item)) {
@@ -872,6 +1158,9 @@ static void scene_save_item(obs_data_array_t *array,
 	obs_data_set_int(item_data, "crop_top", (int)item->crop.top);
 	obs_data_set_int(item_data, "crop_right", (int)item->crop.right);
 	obs_data_set_int(item_data, "crop_bottom", (int)item->crop.bottom);
+	if (item->max_render_fps > 0.0)
+		obs_data_set_double(item_data, "max_render_fps",
+				    item->max_render_fps);
 	obs_data_set_int(item_data, "id", item->id);
 	obs_data_set_bool(item_data, "group_item_backup", !!backup_group);
 
@@ -944,20 +1233,42 @@ static void scene_save(void *data, obs_data_t *settings)
 static uint32_t scene_getwidth(void *data)
 {
 	obs_scene_t *scene = data;
-	return scene->custom_size ? scene->cx : obs->video.base_width;
+	struct obs_core_video_mix *mix = obs->video.main_mix;
+
+	if (scene->custom_size)
+		return scene->cx;
+	return mix ? mix->base_width : 0;
 }
 
 static uint32_t scene_getheight(void *data)
 {
 	obs_scene_t *scene = data;
-	return scene->custom_size ? scene->cy : obs->video.base_height;
+	struct obs_core_video_mix *mix = obs->video.main_mix;
+
+	if (scene->custom_size)
+		return scene->cy;
+	return mix ? mix->base_height : 0;
+}
+
+static inline void fill_item_gain(float *buf, uint64_t *frame_num,
+				  uint64_t end, bool visible, bool *seen)
+{
+	if (*frame_num >= end)
+		return;
+
+	seen[visible] = true;
+	for (; *frame_num < end; (*frame_num)++)
+		buf[*frame_num] = visible ? 1.0f : 0.0f;
 }
 
-static void apply_scene_item_audio_actions(struct obs_scene_item *item,
+/* returns true if the gain written to buf varies over the tick, otherwise
+ * the whole tick follows the final visibility of the item */
+static bool apply_scene_item_audio_actions(struct obs_scene_item *item,
 					   float *buf, uint64_t ts,
 					   size_t sample_rate)
 {
 	bool cur_visible = item->visible;
+	bool seen[2] = {false, false};
 	uint64_t frame_num = 0;
 	size_t deref_count = 0;
 
@@ -983,18 +1294,16 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 		if (!item->visible)
 			deref_count++;
 
-		if (buf && new_frame_num > frame_num) {
-			for (; frame_num < new_frame_num; frame_num++)
-				buf[frame_num] = cur_visible ? 1.0f : 0.0f;
-		}
+		if (buf)
+			fill_item_gain(buf, &frame_num, new_frame_num,
+				       cur_visible, seen);
 
 		cur_visible = item->visible;
 	}
 
-	if (buf) {
-		for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
-			buf[frame_num] = cur_visible ? 1.0f : 0.0f;
-	}
+	if (buf)
+		fill_item_gain(buf, &frame_num, AUDIO_OUTPUT_FRAMES,
+			       cur_visible, seen);
 
 	pthread_mutex_unlock(&item->actions_mutex);
 
@@ -1004,6 +1313,8 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 						       item->source);
 		}
 	}
+
+	return seen[0] && seen[1];
 }
 
 static bool apply_scene_item_volume(struct obs_scene_item *item, float *buf,
@@ -1024,44 +1335,30 @@ static bool apply_scene_item_volume(struct obs_scene_item *item, float *buf,
 		uint64_t duration = util_mul_div64(AUDIO_OUTPUT_FRAMES,
 						   1000000000ULL, sample_rate);
 
-		if (!ts || action.timestamp < (ts + duration)) {
-			apply_scene_item_audio_actions(item, buf, ts,
-						       sample_rate);
-			return true;
-		}
+		if (!ts || action.timestamp < (ts + duration))
+			return apply_scene_item_audio_actions(item, buf, ts,
+							      sample_rate);
 	}
 
 	return false;
 }
 
-static void process_all_audio_actions(struct obs_scene_item *item,
-				      size_t sample_rate)
+static inline void process_all_audio_actions(struct obs_scene_item *item,
+					     size_t sample_rate)
 {
-	while (apply_scene_item_volume(item, NULL, 0, sample_rate))
-		;
+	apply_scene_item_audio_actions(item, NULL, 0, sample_rate);
 }
 
-static void mix_audio_with_buf(float *p_out, float *p_in, float *buf_in,
-			       size_t pos, size_t count)
+static inline void mix_audio_with_buf(float *p_out, float *p_in,
+				      float *buf_in, size_t pos, size_t count)
 {
-	register float *out = p_out;
-	register float *buf = buf_in + pos;
-	register float *in = p_in + pos;
-	register float *end = in + count;
-
-	while (in < end)
-		*(out++) += *(in++) * *(buf++);
+	audio_mix_add_mul(p_out, p_in + pos, buf_in + pos, count);
 }
 
 static inline void mix_audio(float *p_out, float *p_in, size_t pos,
 			     size_t count)
 {
-	register float *out = p_out;
-	register float *in = p_in + pos;
-	register float *end = in + count;
-
-	while (in < end)
-		*(out++) += *(in++);
+	audio_mix_add(p_out, p_in + pos, count);
 }
 
 static bool scene_audio_render(void *data, uint64_t *ts_out,
@@ -1106,13 +1403,18 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 	item = scene->first_item;
 	while (item) {
 		uint64_t source_ts;
+		uint32_t item_mixers;
 		size_t pos, count;
 		bool apply_buf;
 
 		apply_buf = apply_scene_item_volume(item, buf, timestamp,
 						    sample_rate);
 
-		if (obs_source_audio_pending(item->source)) {
+		/* nothing to add for hidden items or for sources whose volume
+		 * stage already zeroed their output */
+		if ((!apply_buf && !item->visible) ||
+		    obs_source_audio_pending(item->source) ||
+		    item->source->audio_silent) {
 			item = item->next;
 			continue;
 		}
@@ -1127,14 +1429,15 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 						 source_ts - timestamp);
 		count = AUDIO_OUTPUT_FRAMES - pos;
 
-		if (!apply_buf && !item->visible) {
-			item = item->next;
-			continue;
-		}
+		/* mixes a source does not output are left zeroed, except for
+		 * submix sources, which only fill the first one */
+		item_mixers = mixers;
+		if ((item->source->info.output_flags & OBS_SOURCE_SUBMIX) == 0)
+			item_mixers &= item->source->audio_mixers;
 
 		obs_source_get_audio_mix(item->source, &child_audio);
 		for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
-			if ((mixers & (1 << mix)) == 0)
+			if ((item_mixers & (1 << mix)) == 0)
 				continue;
 
 			for (size_t ch = 0; ch < channels; ch++) {
@@ -1277,6 +1580,7 @@ static inline void duplicate_item_data(struct obs_scene_item *dst,
 	dst->last_height = src->last_height;
 	dst->output_scale = src->output_scale;
 	dst->scale_filter = src->scale_filter;
+	dst->max_render_fps = src->max_render_fps;
 	dst->box_transform = src->box_transform;
 	dst->box_scale = src->box_scale;
 	dst->draw_transform = src->draw_transform;
@@ -1319,12 +1623,12 @@ obs_scene_t *obs_scene_duplicate(obs_scene_t *scene, const char *name,
 {
 	bool make_unique = ((int)type & (1 << 0)) != 0;
 	bool make_private = ((int)type & (1 << 1)) != 0;
-	DARRAY(struct obs_scene_item *) items;
+	DARRAY_INLINE(struct obs_scene_item *, 32) items;
 	struct obs_scene *new_scene;
 	struct obs_scene_item *item;
 	struct obs_source *source;
 
-	da_init(items);
+	da_inline_init(items);
 
 	if (!obs_ptr_valid(scene, "obs_scene_duplicate"))
 		return NULL;
@@ -1335,7 +1639,7 @@ obs_scene_t *obs_scene_duplicate(obs_scene_t *scene, const char *name,
 
 	item = scene->first_item;
 	while (item) {
-		da_push_back(items, &item);
+		da_inline_push_back(items, &item);
 		obs_sceneitem_addref(item);
 		item = item->next;
 	}
@@ -1385,7 +1689,7 @@ obs_scene_t *obs_scene_duplicate(obs_scene_t *scene, const char *name,
 	if (new_scene->is_group)
 		resize_scene(new_scene);
 
-	da_free(items);
+	da_inline_free(items);
 	return new_scene;
 }
 
@@ -1584,10 +1888,11 @@ static void init_hotkeys(obs_scene_t *scene, obs_sceneitem_t *item,
 	struct dstr show_desc = {0};
 	struct dstr hide_desc = {0};
 
-	dstr_copy(&show, "libobs.show_scene_item.%1");
-	dstr_replace(&show, "%1", name);
-	dstr_copy(&hide, "libobs.hide_scene_item.%1");
-	dstr_replace(&hide, "%1", name);
+	if (!name)
+		name = "";
+
+	dstr_printf(&show, "libobs.show_scene_item.%s", name);
+	dstr_printf(&hide, "libobs.hide_scene_item.%s", name);
 
 	dstr_copy(&show_desc, obs->hotkeys.sceneitem_show);
 	dstr_replace(&show_desc, "%1", name);
@@ -1613,10 +1918,11 @@ static void sceneitem_rename_hotkey(const obs_sceneitem_t *scene_item,
 	struct dstr show_desc = {0};
 	struct dstr hide_desc = {0};
 
-	dstr_copy(&show, "libobs.show_scene_item.%1");
-	dstr_replace(&show, "%1", new_name);
-	dstr_copy(&hide, "libobs.hide_scene_item.%1");
-	dstr_replace(&hide, "%1", new_name);
+	if (!new_name)
+		new_name = "";
+
+	dstr_printf(&show, "libobs.show_scene_item.%s", new_name);
+	dstr_printf(&hide, "libobs.hide_scene_item.%s", new_name);
 
 	obs_hotkey_pair_set_names(scene_item->toggle_visibility, show.array,
 				  hide.array);
@@ -1696,6 +2002,8 @@ static obs_sceneitem_t *obs_scene_add_internal(obs_scene_t *scene,
 	vec2_set(&item->scale, 1.0f, 1.0f);
 	matrix4_identity(&item->draw_transform);
 	matrix4_identity(&item->box_transform);
+	item->gpu_resource = obs_gpu_resource_create(
+		source, OBS_GPU_PRIORITY_LOW, sceneitem_evict, item);
 
 	obs_source_addref(source);
 
@@ -1755,8 +2063,8 @@ obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source)
 		return NULL;
 
 	calldata_init_fixed(&params, stack, sizeof(stack));
-	calldata_set_ptr(&params, "scene", scene);
-	calldata_set_ptr(&params, "item", item);
+	calldata_add_ptr(&params, "scene", scene);
+	calldata_add_ptr(&params, "item", item);
 	signal_handler_signal(scene->source->context.signals, "item_add",
 			      &params);
 	return item;
@@ -1765,6 +2073,9 @@ obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source)
 static void obs_sceneitem_destroy(obs_sceneitem_t *item)
 {
 	if (item) {
+		/* waits for an eviction of the item that is in progress */
+		obs_gpu_resource_destroy(item->gpu_resource);
+
 		if (item->item_render) {
 			obs_enter_graphics();
 			gs_texrender_destroy(item->item_render);
@@ -1843,7 +2154,7 @@ obs_source_t *obs_sceneitem_get_source(const obs_sceneitem_t *item)
 static void signal_parent(obs_scene_t *parent, const char *command,
 			  calldata_t *params)
 {
-	calldata_set_ptr(params, "scene", parent);
+	calldata_add_ptr(params, "scene", parent);
 	signal_handler_signal(parent->source->context.signals, command, params);
 }
 
@@ -1859,7 +2170,7 @@ void obs_sceneitem_select(obs_sceneitem_t *item, bool select)
 	item->selected = select;
 
 	calldata_init_fixed(&params, stack, sizeof(stack));
-	calldata_set_ptr(&params, "item", item);
+	calldata_add_ptr(&params, "item", item);
 
 	signal_parent(item->parent, command, &params);
 }
@@ -1869,9 +2180,15 @@ bool obs_sceneitem_selected(const obs_sceneitem_t *item)
 	return item ? item->selected : false;
 }
 
+static inline bool transforms_deferred(const struct obs_scene_item *item)
+{
+	return !item->parent || item->parent->is_group ||
+	       os_atomic_load_long(&item->parent->defer_transforms) > 0;
+}
+
 #define do_update_transform(item)                                          \
 	do {                                                               \
-		if (!item->parent || item->parent->is_group)               \
+		if (transforms_deferred(item))                             \
 			os_atomic_set_bool(&item->update_transform, true); \
 		else                                                       \
 			update_item_transform(item, false);                \
@@ -2157,8 +2474,8 @@ bool obs_sceneitem_set_visible(obs_sceneitem_t *item, bool visible)
 	item->user_visible = visible;
 
 	calldata_init_fixed(&cd, stack, sizeof(stack));
-	calldata_set_ptr(&cd, "item", item);
-	calldata_set_bool(&cd, "visible", visible);
+	calldata_add_ptr(&cd, "item", item);
+	calldata_add_bool(&cd, "visible", visible);
 
 	signal_parent(item->parent, "item_visible", &cd);
 
@@ -2194,8 +2511,8 @@ bool obs_sceneitem_set_locked(obs_sceneitem_t *item, bool lock)
 	item->locked = lock;
 
 	calldata_init_fixed(&cd, stack, sizeof(stack));
-	calldata_set_ptr(&cd, "item", item);
-	calldata_set_bool(&cd, "locked", lock);
+	calldata_add_ptr(&cd, "item", item);
+	calldata_add_bool(&cd, "locked", lock);
 
 	signal_parent(item->parent, "item_locked", &cd);
 
@@ -2343,6 +2660,23 @@ enum obs_scale_type obs_sceneitem_get_scale_filter(obs_sceneitem_t *item)
 		       : OBS_SCALE_DISABLE;
 }
 
+void obs_sceneitem_set_max_render_fps(obs_sceneitem_t *item, double fps)
+{
+	if (!obs_ptr_valid(item, "obs_sceneitem_set_max_render_fps"))
+		return;
+
+	item->max_render_fps = fps > 0.0 ? fps : 0.0;
+
+	os_atomic_set_bool(&item->update_transform, true);
+}
+
+double obs_sceneitem_get_max_render_fps(const obs_sceneitem_t *item)
+{
+	return obs_ptr_valid(item, "obs_sceneitem_get_max_render_fps")
+		       ? item->max_render_fps
+		       : 0.0;
+}
+
 void obs_sceneitem_defer_update_begin(obs_sceneitem_t *item)
 {
 	if (!obs_ptr_valid(item, "obs_sceneitem_defer_update_begin"))
@@ -2360,6 +2694,25 @@ void obs_sceneitem_defer_update_end(obs_sceneitem_t *item)
 		do_update_transform(item);
 }
 
+void obs_scene_defer_transforms_begin(obs_scene_t *scene)
+{
+	if (!obs_ptr_valid(scene, "obs_scene_defer_transforms_begin"))
+		return;
+
+	os_atomic_inc_long(&scene->defer_transforms);
+}
+
+void obs_scene_defer_transforms_end(obs_scene_t *scene)
+{
+	if (!obs_ptr_valid(scene, "obs_scene_defer_transforms_end"))
+		return;
+
+	/* the marked items are updated by the next video tick, in the same
+	 * pass as grouped items, so items changed by several batches within
+	 * a frame are still only updated and signaled once */
+	os_atomic_dec_long(&scene->defer_transforms);
+}
+
 void obs_sceneitem_defer_group_resize_begin(obs_sceneitem_t *item)
 {
 	if (!obs_ptr_valid(item, "obs_sceneitem_defer_group_resize_begin"))
@@ -50,6 +50,23 @@ struct obs_scene_item {
 	gs_texrender_t *item_render;
 	struct obs_sceneitem_crop crop;
 
+	/* item_render still holds the output of a cacheable source */
+	bool cache_valid;
+	long cache_version;
+	long cache_rebuilds;
+	uint32_t cache_cx;
+	uint32_t cache_cy;
+
+	/* VRAM of item_render, which is released when the item has not been
+	 * drawn for a while and the GPU memory budget is exceeded */
+	obs_gpu_resource_t *gpu_resource;
+	uint64_t gpu_bytes;
+
+	/* frame time of the last render into item_render, used to limit how
+	 * often the source is rendered when a maximum render rate is set */
+	double max_render_fps;
+	uint64_t cache_render_ts;
+
 	struct vec2 pos;
 	struct vec2 scale;
 	float rot;
@@ -63,6 +80,11 @@ struct obs_scene_item {
 	struct vec2 output_scale;
 	enum obs_scale_type scale_filter;
 
+	/* size of the whole uncropped source on the canvas, passed to
+	 * sources with the OBS_SOURCE_SIZE_HINT flag */
+	uint32_t size_hint_cx;
+	uint32_t size_hint_cy;
+
 	struct matrix4 box_transform;
 	struct vec2 box_scale;
 	struct matrix4 draw_transform;
@@ -93,6 +115,12 @@ struct obs_scene {
 
 	int64_t id_counter;
 
+	signal_handle_t *transform_signal;
+
+	/* while above zero, item transform changes are left to the next
+	 * video tick */
+	volatile long defer_transforms;
+
 	pthread_mutex_t video_mutex;
 	pthread_mutex_t audio_mutex;
 	struct obs_scene_item *first_item;
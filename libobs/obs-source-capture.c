@@ -0,0 +1,253 @@
+#include "util/platform.h"
+#include "obs-internal.h"
+
+/*
+ * Renders a source into a texture on one tick, stages it on the next one and
+ * maps it once the copy has finished on the GPU.  The callback then runs on
+ * the task pool with the mapped pixels while the graphics thread carries on,
+ * and the surface is unmapped on the first tick after the callback returns.
+ */
+
+/* maps anyway after this many ticks when the backend can't report progress */
+#define MAX_STAGE_TICKS 2
+
+enum capture_stage {
+	CAPTURE_RENDER,
+	CAPTURE_STAGE,
+	CAPTURE_MAP,
+	CAPTURE_CALLBACK,
+};
+
+struct capture_request {
+	obs_weak_source_t *weak_source;
+	bool main_texture;
+	uint32_t base_cx;
+	uint32_t base_cy;
+	uint32_t cx;
+	uint32_t cy;
+
+	obs_source_capture_cb callback;
+	void *param;
+
+	gs_texrender_t *texrender;
+	gs_stagesurf_t *stagesurf;
+	enum capture_stage stage;
+	int stage_ticks;
+
+	uint8_t *data;
+	uint32_t linesize;
+
+	pthread_mutex_t callback_mutex;
+	bool canceled;
+	volatile bool done;
+};
+
+static pthread_mutex_t requests_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct capture_request *) requests;
+
+static void capture_tick(void *param, float seconds);
+
+static void free_request(struct capture_request *req)
+{
+	pthread_mutex_lock(&requests_mutex);
+	da_erase_item(requests, &req);
+	if (!requests.num)
+		da_free(requests);
+	pthread_mutex_unlock(&requests_mutex);
+
+	obs_remove_tick_callback(capture_tick, req);
+
+	obs_enter_graphics();
+	if (req->data)
+		gs_stagesurface_unmap(req->stagesurf);
+	gs_stagesurface_destroy(req->stagesurf);
+	gs_texrender_destroy(req->texrender);
+	obs_leave_graphics();
+
+	obs_weak_source_release(req->weak_source);
+	pthread_mutex_destroy(&req->callback_mutex);
+	bfree(req);
+}
+
+static void run_callback(struct capture_request *req, const uint8_t *data,
+			 uint32_t linesize)
+{
+	pthread_mutex_lock(&req->callback_mutex);
+	if (!req->canceled)
+		req->callback(req->param, data, linesize, req->cx, req->cy);
+	pthread_mutex_unlock(&req->callback_mutex);
+}
+
+static void capture_task(void *param)
+{
+	struct capture_request *req = param;
+
+	run_callback(req, req->data, req->linesize);
+	os_atomic_set_bool(&req->done, true);
+}
+
+static bool render_request(struct capture_request *req)
+{
+	obs_source_t *source = NULL;
+	struct vec4 zero;
+
+	if (!req->main_texture) {
+		source = obs_weak_source_get_source(req->weak_source);
+		if (!source)
+			return false;
+	}
+
+	req->texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	req->stagesurf = gs_stagesurface_create(req->cx, req->cy, GS_RGBA);
+
+	if (!req->texrender || !req->stagesurf ||
+	    !gs_texrender_begin(req->texrender, req->cx, req->cy)) {
+		obs_source_release(source);
+		return false;
+	}
+
+	vec4_zero(&zero);
+	gs_clear(GS_CLEAR_COLOR, &zero, 0.0f, 0);
+	gs_ortho(0.0f, (float)req->base_cx, 0.0f, (float)req->base_cy, -100.0f,
+		 100.0f);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (source) {
+		obs_source_inc_showing(source);
+		obs_source_video_render(source);
+		obs_source_dec_showing(source);
+	} else {
+		obs_render_main_texture();
+	}
+
+	gs_blend_state_pop();
+	gs_texrender_end(req->texrender);
+
+	obs_source_release(source);
+	return true;
+}
+
+/* returns false once the request has failed */
+static bool capture_stage(struct capture_request *req)
+{
+	switch (req->stage) {
+	case CAPTURE_RENDER:
+		if (!render_request(req))
+			return false;
+		req->stage = CAPTURE_STAGE;
+		break;
+
+	case CAPTURE_STAGE:
+		gs_stage_texture(req->stagesurf,
+				 gs_texrender_get_texture(req->texrender));
+		req->stage = CAPTURE_MAP;
+		break;
+
+	case CAPTURE_MAP:
+		if (!gs_stagesurface_ready(req->stagesurf) &&
+		    ++req->stage_ticks < MAX_STAGE_TICKS)
+			break;
+		if (!gs_stagesurface_map(req->stagesurf, &req->data,
+					 &req->linesize)) {
+			req->data = NULL;
+			return false;
+		}
+
+		req->stage = CAPTURE_CALLBACK;
+		obs_queue_pool_task(OBS_TASK_PRIORITY_LOW, capture_task, req);
+		break;
+
+	case CAPTURE_CALLBACK:
+		break;
+	}
+
+	return true;
+}
+
+static void capture_tick(void *param, float seconds)
+{
+	struct capture_request *req = param;
+	bool success;
+
+	if (req->stage == CAPTURE_CALLBACK) {
+		if (os_atomic_load_bool(&req->done))
+			free_request(req);
+		return;
+	}
+
+	obs_enter_graphics();
+	success = capture_stage(req);
+	obs_leave_graphics();
+
+	if (!success) {
+		blog(LOG_WARNING, "obs_source_capture_async: Capture failed");
+		run_callback(req, NULL, 0);
+		free_request(req);
+	}
+
+	UNUSED_PARAMETER(seconds);
+}
+
+bool obs_source_capture_async(obs_source_t *source, uint32_t width,
+			      uint32_t height, obs_source_capture_cb callback,
+			      void *param)
+{
+	struct capture_request *req;
+	uint32_t base_cx, base_cy;
+
+	if (!callback)
+		return false;
+
+	if (source) {
+		base_cx = obs_source_get_base_width(source);
+		base_cy = obs_source_get_base_height(source);
+	} else {
+		struct obs_video_info ovi;
+		if (!obs_get_video_info(&ovi))
+			return false;
+
+		base_cx = ovi.base_width;
+		base_cy = ovi.base_height;
+	}
+
+	if (!base_cx || !base_cy)
+		return false;
+
+	req = bzalloc(sizeof(struct capture_request));
+	req->weak_source = source ? obs_source_get_weak_source(source) : NULL;
+	req->main_texture = !source;
+	req->base_cx = base_cx;
+	req->base_cy = base_cy;
+	req->cx = width ? width : base_cx;
+	req->cy = height ? height : base_cy;
+	req->callback = callback;
+	req->param = param;
+	pthread_mutex_init(&req->callback_mutex, NULL);
+
+	pthread_mutex_lock(&requests_mutex);
+	da_push_back(requests, &req);
+	pthread_mutex_unlock(&requests_mutex);
+
+	obs_add_tick_callback(capture_tick, req);
+	return true;
+}
+
+void obs_source_capture_cancel(obs_source_capture_cb callback, void *param)
+{
+	pthread_mutex_lock(&requests_mutex);
+
+	for (size_t i = 0; i < requests.num; i++) {
+		struct capture_request *req = requests.array[i];
+
+		if (req->callback == callback && req->param == param) {
+			/* waits for a callback that is already running */
+			pthread_mutex_lock(&req->callback_mutex);
+			req->canceled = true;
+			pthread_mutex_unlock(&req->callback_mutex);
+		}
+	}
+
+	pthread_mutex_unlock(&requests_mutex);
+}
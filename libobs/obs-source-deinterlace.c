@@ -169,7 +169,7 @@ static inline void deinterlace_get_closest_frames(obs_source_t *s,
 	if (!s->async_frames.num)
 		return;
 
-	info = video_output_get_info(obs->video.video);
+	info = video_output_get_info(obs_get_video());
 	half_interval = (uint64_t)info->fps_den * 500000000ULL /
 			(uint64_t)info->fps_num;
 
@@ -308,6 +308,8 @@ void deinterlace_update_async_video(obs_source_t *source)
 			source->async_prev_texrender = source->async_texrender;
 			source->async_texrender = prev;
 		}
+
+		source->deinterlace_dirty = true;
 	}
 }
 
@@ -365,11 +367,12 @@ static bool deinterlace_linear_required(enum obs_deinterlace_mode mode)
 	return false;
 }
 
-void deinterlace_render(obs_source_t *s)
+static void deinterlace_render_field(obs_source_t *s, gs_texture_t *cur_tex,
+				     gs_texture_t *prev_tex, bool linear_srgb,
+				     bool second_field)
 {
 	gs_effect_t *effect = s->deinterlace_effect;
 
-	uint64_t frame2_ts;
 	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
 	gs_eparam_t *prev =
 		gs_effect_get_param_by_name(effect, "previous_image");
@@ -379,6 +382,78 @@ void deinterlace_render(obs_source_t *s)
 		gs_effect_get_param_by_name(effect, "dimensions");
 	struct vec2 size = {(float)s->async_width, (float)s->async_height};
 
+	if (linear_srgb) {
+		gs_effect_set_texture_srgb(image, cur_tex);
+		gs_effect_set_texture_srgb(prev, prev_tex);
+	} else {
+		gs_effect_set_texture(image, cur_tex);
+		gs_effect_set_texture(prev, prev_tex);
+	}
+
+	gs_effect_set_int(field, s->deinterlace_top_first);
+	gs_effect_set_vec2(dimensions, &size);
+	gs_effect_set_bool(frame2, second_field);
+
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(NULL, s->async_flip ? GS_FLIP_V : 0,
+			       s->async_width, s->async_height);
+}
+
+/* the deinterlaced field is rendered once and then redrawn by every view
+ * showing the source, until new textures arrive or the 2x modes switch to
+ * the other field */
+static bool deinterlace_update_field(obs_source_t *s, gs_texture_t *cur_tex,
+				     gs_texture_t *prev_tex, bool linear_srgb,
+				     bool second_field)
+{
+	const uint32_t cx = s->async_width;
+	const uint32_t cy = s->async_height;
+	bool success = false;
+
+	if (!s->deinterlace_texrender) {
+		s->deinterlace_texrender =
+			gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		s->deinterlace_dirty = true;
+	}
+
+	if (!s->deinterlace_dirty && s->deinterlace_frame2 == second_field &&
+	    s->deinterlace_linear_srgb == linear_srgb &&
+	    gs_texrender_get_texture(s->deinterlace_texrender))
+		return true;
+
+	gs_texrender_reset(s->deinterlace_texrender);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (gs_texrender_begin(s->deinterlace_texrender, cx, cy)) {
+		const bool previous = gs_framebuffer_srgb_enabled();
+		gs_enable_framebuffer_srgb(linear_srgb);
+
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+		deinterlace_render_field(s, cur_tex, prev_tex, linear_srgb,
+					 second_field);
+
+		gs_enable_framebuffer_srgb(previous);
+		gs_texrender_end(s->deinterlace_texrender);
+		success = true;
+	}
+
+	gs_blend_state_pop();
+
+	s->deinterlace_dirty = !success;
+	s->deinterlace_frame2 = second_field;
+	s->deinterlace_linear_srgb = linear_srgb;
+	return success;
+}
+
+void deinterlace_render(obs_source_t *s)
+{
+	gs_effect_t *effect = obs->video.default_effect;
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+	gs_texture_t *tex;
+	uint64_t frame2_ts;
+
 	gs_texture_t *cur_tex =
 		s->async_texrender
 			? gs_texrender_get_texture(s->async_texrender)
@@ -395,28 +470,25 @@ void deinterlace_render(obs_source_t *s)
 		gs_get_linear_srgb() ||
 		deinterlace_linear_required(s->deinterlace_mode);
 
-	const bool previous = gs_framebuffer_srgb_enabled();
-	gs_enable_framebuffer_srgb(linear_srgb);
+	frame2_ts = s->deinterlace_frame_ts + s->deinterlace_offset +
+		    s->deinterlace_half_duration - TWOX_TOLERANCE;
 
-	if (linear_srgb) {
-		gs_effect_set_texture_srgb(image, cur_tex);
-		gs_effect_set_texture_srgb(prev, prev_tex);
-	} else {
-		gs_effect_set_texture(image, cur_tex);
-		gs_effect_set_texture(prev, prev_tex);
-	}
+	if (!deinterlace_update_field(s, cur_tex, prev_tex, linear_srgb,
+				      obs->video.video_time >= frame2_ts))
+		return;
 
-	gs_effect_set_int(field, s->deinterlace_top_first);
-	gs_effect_set_vec2(dimensions, &size);
+	tex = gs_texrender_get_texture(s->deinterlace_texrender);
 
-	frame2_ts = s->deinterlace_frame_ts + s->deinterlace_offset +
-		    s->deinterlace_half_duration - TWOX_TOLERANCE;
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(linear_srgb);
 
-	gs_effect_set_bool(frame2, obs->video.video_time >= frame2_ts);
+	if (linear_srgb)
+		gs_effect_set_texture_srgb(image, tex);
+	else
+		gs_effect_set_texture(image, tex);
 
 	while (gs_effect_loop(effect, "Draw"))
-		gs_draw_sprite(NULL, s->async_flip ? GS_FLIP_V : 0,
-			       s->async_width, s->async_height);
+		gs_draw_sprite(tex, 0, s->async_width, s->async_height);
 
 	gs_enable_framebuffer_srgb(previous);
 }
@@ -426,12 +498,16 @@ static void enable_deinterlacing(obs_source_t *source,
 {
 	obs_enter_graphics();
 
+	/* deinterlacing reads the converted texture */
+	finish_async_texrender(source);
+
 	if (source->async_format != VIDEO_FORMAT_NONE &&
 	    source->async_width != 0 && source->async_height != 0)
 		set_deinterlace_texture_size(source);
 
 	source->deinterlace_mode = mode;
 	source->deinterlace_effect = get_effect(mode);
+	source->deinterlace_dirty = true;
 
 	pthread_mutex_lock(&source->async_mutex);
 	if (source->prev_async_frame) {
@@ -450,11 +526,13 @@ static void disable_deinterlacing(obs_source_t *source)
 	gs_texture_destroy(source->async_prev_textures[1]);
 	gs_texture_destroy(source->async_prev_textures[2]);
 	gs_texrender_destroy(source->async_prev_texrender);
+	gs_texrender_destroy(source->deinterlace_texrender);
 	source->deinterlace_mode = OBS_DEINTERLACE_MODE_DISABLE;
 	source->async_prev_textures[0] = NULL;
 	source->async_prev_textures[1] = NULL;
 	source->async_prev_textures[2] = NULL;
 	source->async_prev_texrender = NULL;
+	source->deinterlace_texrender = NULL;
 	obs_leave_graphics();
 }
 
@@ -474,6 +552,7 @@ void obs_source_set_deinterlace_mode(obs_source_t *source,
 		obs_enter_graphics();
 		source->deinterlace_mode = mode;
 		source->deinterlace_effect = get_effect(mode);
+		source->deinterlace_dirty = true;
 		obs_leave_graphics();
 	}
 }
@@ -494,6 +573,7 @@ void obs_source_set_deinterlace_field_order(
 
 	source->deinterlace_top_first = field_order ==
 					OBS_DEINTERLACE_FIELD_ORDER_TOP;
+	source->deinterlace_dirty = true;
 }
 
 enum obs_deinterlace_field_order
@@ -0,0 +1,329 @@
+#include <string.h>
+
+#include "util/dstr.h"
+#include "obs-internal.h"
+
+/*
+ * Adjacent filters of a source that describe themselves as per-pixel shader
+ * functions (see struct obs_filter_fusion) are drawn with a single generated
+ * effect: the input of the innermost filter is rendered to texture once and
+ * every filter's function is applied to it in the same pass, instead of each
+ * filter rendering its input to its own full-size render target.
+ *
+ * Generated effects are shared by all sources with the same chain of filter
+ * types, and code that fails to compile is remembered so that the chain
+ * falls back to rendering each filter separately.
+ */
+
+#define MAX_FUSED_FILTERS 8
+#define MAX_FUSED_EFFECTS 32
+
+struct fused_filter {
+	obs_source_t *filter;
+	struct obs_filter_fusion fusion;
+};
+
+struct obs_fusion_pass {
+	gs_effect_t *effect;
+	struct dstr name;
+	size_t prefix_len;
+};
+
+static const char *fusion_header =
+	"uniform float4x4 ViewProj;\n"
+	"uniform texture2d image;\n"
+	"\n"
+	"sampler_state fusion_sampler {\n"
+	"\tFilter   = Linear;\n"
+	"\tAddressU = Clamp;\n"
+	"\tAddressV = Clamp;\n"
+	"};\n"
+	"\n"
+	"struct FusionData {\n"
+	"\tfloat4 pos : POSITION;\n"
+	"\tfloat2 uv  : TEXCOORD0;\n"
+	"};\n"
+	"\n"
+	"FusionData VSFusion(FusionData v_in)\n"
+	"{\n"
+	"\tFusionData v_out;\n"
+	"\tv_out.pos = mul(float4(v_in.pos.xyz, 1.0), ViewProj);\n"
+	"\tv_out.uv  = v_in.uv;\n"
+	"\treturn v_out;\n"
+	"}\n"
+	"\n";
+
+static const char *fusion_footer =
+	"\treturn rgba;\n"
+	"}\n"
+	"\n"
+	"technique Draw\n"
+	"{\n"
+	"\tpass\n"
+	"\t{\n"
+	"\t\tvertex_shader = VSFusion(v_in);\n"
+	"\t\tpixel_shader  = PSFusion(v_in);\n"
+	"\t}\n"
+	"}\n";
+
+static inline uint32_t srgb_flag(const struct fused_filter *entry)
+{
+	return entry->fusion.flags & OBS_FUSION_LINEAR_SRGB;
+}
+
+static inline bool can_fuse(obs_source_t *filter)
+{
+	const struct obs_source_info *info = &filter->info;
+	return info->filter_get_fusion && info->filter_fusion_render &&
+	       !info->get_width && !info->get_height;
+}
+
+/* collects the filters from the outermost inwards, the returned input is
+ * the source the innermost of them is applied to */
+static size_t collect_filters(obs_source_t *filter, struct fused_filter *run,
+			      obs_source_t **input)
+{
+	size_t num = 0;
+
+	while (filter->filter_parent && num < MAX_FUSED_FILTERS) {
+		struct fused_filter *entry = run + num;
+
+		/* skipped when rendered, same as here */
+		if (!filter->enabled || !filter->context.data) {
+			filter = filter->filter_target;
+			continue;
+		}
+
+		if (!can_fuse(filter))
+			break;
+
+		memset(&entry->fusion, 0, sizeof(entry->fusion));
+		if (!filter->info.filter_get_fusion(filter->context.data,
+						    &entry->fusion) ||
+		    !entry->fusion.code)
+			break;
+		if (num && srgb_flag(entry) != srgb_flag(run))
+			break;
+
+		entry->filter = filter;
+		filter = filter->filter_target;
+		num++;
+
+		if (entry->fusion.flags & OBS_FUSION_SAMPLES_INPUT)
+			break;
+	}
+
+	*input = filter;
+	return num;
+}
+
+static inline void cat_prefix(struct dstr *str, size_t idx)
+{
+	dstr_catf(str, "fuse%d_", (int)idx);
+}
+
+/* the filters are applied from the innermost (idx 0) outwards */
+static void build_effect_string(struct dstr *str, struct fused_filter *run,
+				size_t num)
+{
+	dstr_copy(str, fusion_header);
+
+	for (size_t idx = 0; idx < num; idx++) {
+		const char *code = run[num - idx - 1].fusion.code;
+		const char *pos;
+
+		while ((pos = strchr(code, '$')) != NULL) {
+			dstr_ncat(str, code, pos - code);
+			cat_prefix(str, idx);
+			code = pos + 1;
+		}
+
+		dstr_cat(str, code);
+		dstr_cat(str, "\n\n");
+	}
+
+	dstr_cat(str, "float4 PSFusion(FusionData v_in) : TARGET\n"
+		      "{\n"
+		      "\tfloat4 rgba = image.Sample(fusion_sampler, "
+		      "v_in.uv);\n");
+
+	for (size_t idx = 0; idx < num; idx++) {
+		dstr_cat(str, "\trgba = ");
+		cat_prefix(str, idx);
+		dstr_cat(str, "process(rgba, v_in.uv);\n");
+	}
+
+	dstr_cat(str, fusion_footer);
+}
+
+static gs_effect_t *get_fused_effect(struct fused_filter *run, size_t num)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_fused_effect *entry;
+	struct dstr key = {0};
+	char *error = NULL;
+
+	build_effect_string(&key, run, num);
+
+	for (size_t i = 0; i < video->fused_effects.num; i++) {
+		entry = video->fused_effects.array + i;
+		if (strcmp(entry->key, key.array) == 0) {
+			dstr_free(&key);
+			return entry->effect;
+		}
+	}
+
+	if (video->fused_effects.num == MAX_FUSED_EFFECTS) {
+		entry = video->fused_effects.array;
+		gs_effect_destroy(entry->effect);
+		bfree(entry->key);
+		da_erase(video->fused_effects, 0);
+	}
+
+	entry = da_push_back_new(video->fused_effects);
+	entry->key = key.array;
+	entry->effect = gs_effect_create(key.array, "fused-filters", &error);
+
+	if (!entry->effect)
+		blog(LOG_WARNING,
+		     "Failed to fuse filters of '%s', rendering them "
+		     "separately: %s",
+		     obs_source_get_name(run[0].filter->filter_parent),
+		     error ? error : "(unknown error)");
+
+	bfree(error);
+	return entry->effect;
+}
+
+static inline bool can_draw_direct(obs_source_t *input, obs_source_t *parent)
+{
+	uint32_t flags = parent->info.output_flags;
+	return input == parent && (flags & OBS_SOURCE_CUSTOM_DRAW) == 0 &&
+	       (flags & OBS_SOURCE_ASYNC) == 0;
+}
+
+static void draw_direct(obs_source_t *input, gs_effect_t *effect)
+{
+	gs_technique_t *tech = gs_effect_get_technique(effect, "Draw");
+	size_t passes = gs_technique_begin(tech);
+
+	for (size_t i = 0; i < passes; i++) {
+		gs_technique_begin_pass(tech, i);
+		obs_source_video_render(input);
+		gs_technique_end_pass(tech);
+	}
+	gs_technique_end(tech);
+}
+
+static void draw_texture(gs_texture_t *tex, gs_effect_t *effect, bool srgb)
+{
+	gs_technique_t *tech = gs_effect_get_technique(effect, "Draw");
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+	const bool previous = gs_framebuffer_srgb_enabled();
+	size_t passes;
+
+	gs_enable_framebuffer_srgb(srgb);
+
+	if (srgb)
+		gs_effect_set_texture_srgb(image, tex);
+	else
+		gs_effect_set_texture(image, tex);
+
+	passes = gs_technique_begin(tech);
+	for (size_t i = 0; i < passes; i++) {
+		gs_technique_begin_pass(tech, i);
+		gs_draw_sprite(tex, 0, 0, 0);
+		gs_technique_end_pass(tech);
+	}
+	gs_technique_end(tech);
+
+	gs_enable_framebuffer_srgb(previous);
+}
+
+static void set_params(struct fused_filter *run, size_t num,
+		       gs_effect_t *effect)
+{
+	struct obs_fusion_pass pass = {0};
+	pass.effect = effect;
+
+	for (size_t idx = 0; idx < num; idx++) {
+		obs_source_t *filter = run[num - idx - 1].filter;
+
+		dstr_resize(&pass.name, 0);
+		cat_prefix(&pass.name, idx);
+		pass.prefix_len = pass.name.len;
+
+		filter->info.filter_fusion_render(filter->context.data, &pass);
+	}
+
+	dstr_free(&pass.name);
+}
+
+bool obs_source_render_fused_filters(obs_source_t *filter)
+{
+	struct fused_filter run[MAX_FUSED_FILTERS];
+	obs_source_t *parent = filter->filter_parent;
+	obs_source_t *input;
+	gs_effect_t *effect;
+	uint32_t cx, cy;
+	bool srgb;
+	size_t num;
+
+	num = collect_filters(filter, run, &input);
+	if (num < 2 || !input)
+		return false;
+
+	effect = get_fused_effect(run, num);
+	if (!effect)
+		return false;
+
+	srgb = srgb_flag(run) != 0;
+	if (!srgb)
+		srgb = gs_get_linear_srgb();
+
+	if (can_draw_direct(input, parent)) {
+		const bool previous = gs_set_linear_srgb(srgb);
+		set_params(run, num, effect);
+		draw_direct(input, effect);
+		gs_set_linear_srgb(previous);
+		return true;
+	}
+
+	cx = obs_source_get_base_width(input);
+	cy = obs_source_get_base_height(input);
+	if (!cx || !cy)
+		return true;
+
+	obs_source_render_filter_input(filter, input, GS_RGBA, cx, cy);
+
+	gs_texture_t *tex = gs_texrender_get_texture(filter->filter_texrender);
+	if (tex) {
+		set_params(run, num, effect);
+		draw_texture(tex, effect, srgb);
+	}
+
+	return true;
+}
+
+gs_eparam_t *obs_fusion_pass_get_param(obs_fusion_pass_t *pass,
+				       const char *name)
+{
+	if (!pass || !name)
+		return NULL;
+
+	dstr_resize(&pass->name, pass->prefix_len);
+	dstr_cat(&pass->name, name);
+	return gs_effect_get_param_by_name(pass->effect, pass->name.array);
+}
+
+void obs_free_fused_effects(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < video->fused_effects.num; i++) {
+		gs_effect_destroy(video->fused_effects.array[i].effect);
+		bfree(video->fused_effects.array[i].key);
+	}
+
+	da_free(video->fused_effects);
+}
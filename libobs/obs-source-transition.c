@@ -53,9 +53,9 @@ bool obs_transition_init(obs_source_t *transition)
 
 	transition->transition_alignment = OBS_ALIGN_LEFT | OBS_ALIGN_TOP;
 	transition->transition_texrender[0] =
-		gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		gs_texrender_create_transient(GS_RGBA, GS_ZS_NONE);
 	transition->transition_texrender[1] =
-		gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		gs_texrender_create_transient(GS_RGBA, GS_ZS_NONE);
 	transition->transition_source_active[0] = true;
 
 	return transition->transition_texrender[0] != NULL &&
@@ -97,6 +97,8 @@ void obs_transition_clear(obs_source_t *transition)
 			obs_source_remove_active_child(transition, s[i]);
 		obs_source_release(s[i]);
 	}
+
+	obs_transition_prewarm(transition, NULL);
 }
 
 void add_alignment(struct vec2 *v, uint32_t align, int cx, int cy);
@@ -224,7 +226,10 @@ void obs_transition_tick(obs_source_t *transition, float t)
 	}
 
 	if (trylock_textures(transition) == 0) {
-		gs_texrender_reset(transition->transition_texrender[0]);
+		if (!transition->transitioning_video)
+			transition->transition_frozen_time = 0;
+		if (!transition->transition_frozen_time)
+			gs_texrender_reset(transition->transition_texrender[0]);
 		gs_texrender_reset(transition->transition_texrender[1]);
 		unlock_textures(transition);
 	}
@@ -367,6 +372,7 @@ bool obs_transition_start(obs_source_t *transition,
 	bool same_as_source;
 	bool same_as_dest;
 	bool same_mode;
+	bool prewarmed;
 
 	if (!transition_valid(transition, "obs_transition_start"))
 		return false;
@@ -409,6 +415,13 @@ bool obs_transition_start(obs_source_t *transition,
 		transition->transitioning_audio = true;
 	}
 
+	/* dest is active now, so it no longer needs to be shown for it */
+	lock_transition(transition);
+	prewarmed = dest && transition->transition_prewarm == dest;
+	unlock_transition(transition);
+	if (prewarmed)
+		obs_transition_prewarm(transition, NULL);
+
 	obs_source_dosignal(transition, "source_transition_start",
 			    "transition_start");
 
@@ -625,6 +638,7 @@ void obs_transition_load(obs_source_t *tr, obs_data_t *data)
 
 struct transition_state {
 	obs_source_t *s[2];
+	uint64_t start_time;
 	bool transitioning_video;
 	bool transitioning_audio;
 };
@@ -637,6 +651,7 @@ static inline void copy_transition_state(obs_source_t *transition,
 	obs_source_addref(state->s[0]);
 	obs_source_addref(state->s[1]);
 
+	state->start_time = transition->transition_start_time;
 	state->transitioning_video = transition->transitioning_video;
 	state->transitioning_audio = transition->transitioning_audio;
 }
@@ -755,10 +770,19 @@ void obs_transition_video_render(obs_source_t *transition,
 		gs_texture_t *tex[2];
 		uint32_t cx;
 		uint32_t cy;
+		bool frozen = transition->transition_frozen_time ==
+			      state.start_time;
+
+		/* frozen by a previous transition, which tick did not reset */
+		if (transition->transition_frozen_time && !frozen) {
+			gs_texrender_reset(transition->transition_texrender[0]);
+			transition->transition_frozen_time = 0;
+		}
 
 		for (size_t i = 0; i < 2; i++) {
 			if (state.s[i]) {
-				render_child(transition, state.s[i], i);
+				if (i > 0 || !frozen)
+					render_child(transition, state.s[i], i);
 				tex[i] = get_texture(transition, i);
 				if (!tex[i])
 					tex[i] = obs->video.transparent_texture;
@@ -767,6 +791,10 @@ void obs_transition_video_render(obs_source_t *transition,
 			}
 		}
 
+		if (transition->transition_freeze_outgoing && state.s[0] &&
+		    get_texture(transition, 0))
+			transition->transition_frozen_time = state.start_time;
+
 		cx = get_cx(transition);
 		cy = get_cy(transition);
 		if (cx && cy) {
@@ -1034,6 +1062,46 @@ bool obs_transition_fixed(obs_source_t *transition)
 		       : false;
 }
 
+void obs_transition_enable_freeze_outgoing(obs_source_t *transition,
+					   bool enable)
+{
+	if (!transition_valid(transition,
+			      "obs_transition_enable_freeze_outgoing"))
+		return;
+
+	transition->transition_freeze_outgoing = enable;
+}
+
+bool obs_transition_freeze_outgoing(obs_source_t *transition)
+{
+	return transition_valid(transition, "obs_transition_freeze_outgoing")
+		       ? transition->transition_freeze_outgoing
+		       : false;
+}
+
+void obs_transition_prewarm(obs_source_t *transition, obs_source_t *source)
+{
+	obs_source_t *old;
+
+	if (!transition_valid(transition, "obs_transition_prewarm"))
+		return;
+
+	if (source) {
+		obs_source_addref(source);
+		obs_source_inc_showing(source);
+	}
+
+	lock_transition(transition);
+	old = transition->transition_prewarm;
+	transition->transition_prewarm = source;
+	unlock_transition(transition);
+
+	if (old) {
+		obs_source_dec_showing(old);
+		obs_source_release(old);
+	}
+}
+
 static inline obs_source_t *
 copy_source_state(obs_source_t *tr_dest, obs_source_t *tr_source, size_t idx)
 {
@@ -1092,6 +1160,9 @@ void obs_transition_swap_end(obs_source_t *tr_dest, obs_source_t *tr_source)
 		tr_source->transition_texrender[i] = dest;
 	}
 
+	tr_dest->transition_frozen_time = 0;
+	tr_source->transition_frozen_time = 0;
+
 	unlock_textures(tr_dest);
 	unlock_textures(tr_source);
 }
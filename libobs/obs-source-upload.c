@@ -0,0 +1,268 @@
+#include "util/threading.h"
+#include "util/platform.h"
+#include "obs-internal.h"
+
+/*
+ * Copies the planes of the current async frame into the source's textures on
+ * a thread of its own, so that the graphics thread only has to execute the
+ * recorded uploads when the frame is drawn.  This depends on the graphics
+ * backend being able to record texture updates without the graphics context
+ * (see gs_uploader_create); otherwise the source uploads as usual.
+ *
+ * Jobs are started by the video tick and finished by the next render of the
+ * source.  The frame and textures a job uses are not changed until the job is
+ * done: async_tick waits for it before replacing the current frame or
+ * resizing the textures.
+ */
+
+struct obs_async_upload {
+	pthread_t thread;
+	os_sem_t *sem;
+	os_event_t *done;
+	gs_uploader_t *uploader;
+	bool stop;
+
+	/* only touched by the worker between sem and done */
+	struct obs_source_frame *frame;
+	gs_texture_t *textures[MAX_AV_PLANES];
+	bool success;
+
+	bool in_flight;
+};
+
+static void *async_upload_thread(void *param)
+{
+	struct obs_async_upload *upload = param;
+
+	os_set_thread_name("obs: async upload");
+
+	while (os_sem_wait(upload->sem) == 0) {
+		struct obs_source_frame *frame = upload->frame;
+		bool success = true;
+
+		if (upload->stop)
+			break;
+
+		for (size_t c = 0; c < MAX_AV_PLANES; c++) {
+			if (upload->textures[c] &&
+			    !gs_uploader_set_image(upload->uploader,
+						   upload->textures[c],
+						   frame->data[c],
+						   frame->linesize[c]))
+				success = false;
+		}
+
+		if (!gs_uploader_finish(upload->uploader))
+			success = false;
+
+		upload->success = success;
+		os_event_signal(upload->done);
+	}
+
+	return NULL;
+}
+
+static struct obs_async_upload *async_upload_create(obs_source_t *source)
+{
+	struct obs_async_upload *upload;
+	gs_uploader_t *uploader;
+
+	obs_enter_graphics();
+	uploader = gs_uploader_create();
+	obs_leave_graphics();
+
+	if (!uploader) {
+		blog(LOG_DEBUG,
+		     "Source '%s': async upload is not supported by the "
+		     "graphics backend",
+		     obs_source_get_name(source));
+		return NULL;
+	}
+
+	upload = bzalloc(sizeof(struct obs_async_upload));
+	upload->uploader = uploader;
+
+	if (os_sem_init(&upload->sem, 0) != 0)
+		goto fail;
+	if (os_event_init(&upload->done, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+	if (pthread_create(&upload->thread, NULL, async_upload_thread,
+			   upload) != 0)
+		goto fail;
+
+	return upload;
+
+fail:
+	blog(LOG_WARNING, "Source '%s': failed to start async upload thread",
+	     obs_source_get_name(source));
+	os_event_destroy(upload->done);
+	os_sem_destroy(upload->sem);
+	obs_enter_graphics();
+	gs_uploader_destroy(uploader);
+	obs_leave_graphics();
+	bfree(upload);
+	return NULL;
+}
+
+/* assumes mutex */
+static void wait_for_job(struct obs_async_upload *upload)
+{
+	if (upload->in_flight) {
+		os_event_wait(upload->done);
+		upload->in_flight = false;
+		upload->frame = NULL;
+	}
+}
+
+static void async_upload_destroy(struct obs_async_upload *upload)
+{
+	wait_for_job(upload);
+
+	upload->stop = true;
+	os_sem_post(upload->sem);
+	pthread_join(upload->thread, NULL);
+
+	obs_enter_graphics();
+	gs_uploader_destroy(upload->uploader);
+	obs_leave_graphics();
+
+	os_event_destroy(upload->done);
+	os_sem_destroy(upload->sem);
+	bfree(upload);
+}
+
+static struct obs_async_upload *take_upload(obs_source_t *source)
+{
+	struct obs_async_upload *upload;
+
+	/* the render path uses the upload with the graphics context entered
+	 * and then the async mutex, so it is unpublished the same way */
+	obs_enter_graphics();
+	pthread_mutex_lock(&source->async_mutex);
+	upload = source->async_upload;
+	source->async_upload = NULL;
+	pthread_mutex_unlock(&source->async_mutex);
+	obs_leave_graphics();
+
+	return upload;
+}
+
+void async_upload_free(obs_source_t *source)
+{
+	struct obs_async_upload *upload = take_upload(source);
+	if (upload)
+		async_upload_destroy(upload);
+}
+
+static bool filters_use_frames(obs_source_t *source)
+{
+	bool used = false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t *filter = source->filters.array[i];
+		if (filter->enabled && filter->info.filter_video) {
+			used = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return used;
+}
+
+void async_upload_wait(obs_source_t *source)
+{
+	pthread_mutex_lock(&source->async_mutex);
+	if (source->async_upload)
+		wait_for_job(source->async_upload);
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
+void async_upload_start(obs_source_t *source)
+{
+	struct obs_async_upload *upload;
+
+	/* async filters may replace the frame before it is uploaded */
+	if (!source->async_upload || !source->async_gpu_conversion ||
+	    source->deinterlace_mode != OBS_DEINTERLACE_MODE_DISABLE ||
+	    filters_use_frames(source))
+		return;
+
+	pthread_mutex_lock(&source->async_mutex);
+	upload = source->async_upload;
+
+	if (upload && !upload->in_flight && source->cur_async_frame &&
+	    source->async_update_texture) {
+		upload->frame = source->cur_async_frame;
+		memcpy(upload->textures, source->async_textures,
+		       sizeof(upload->textures));
+		upload->in_flight = true;
+		os_sem_post(upload->sem);
+	}
+
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
+bool async_upload_finish(obs_source_t *source,
+			 const struct obs_source_frame *frame,
+			 gs_texture_t *tex[MAX_AV_PLANES])
+{
+	struct obs_async_upload *upload;
+	bool success = false;
+
+	if (tex != source->async_textures)
+		return false;
+
+	pthread_mutex_lock(&source->async_mutex);
+	upload = source->async_upload;
+
+	if (upload && upload->in_flight && upload->frame == frame) {
+		wait_for_job(upload);
+		success = upload->success;
+		if (success)
+			gs_uploader_submit(upload->uploader);
+	}
+
+	pthread_mutex_unlock(&source->async_mutex);
+	return success;
+}
+
+void obs_source_set_async_upload(obs_source_t *source, bool enable)
+{
+	struct obs_async_upload *upload = NULL;
+
+	if (!obs_source_valid(source, "obs_source_set_async_upload"))
+		return;
+	if ((source->info.output_flags & OBS_SOURCE_ASYNC) == 0)
+		return;
+
+	if (!enable) {
+		async_upload_free(source);
+		return;
+	}
+
+	if (source->async_upload)
+		return;
+
+	upload = async_upload_create(source);
+	if (!upload)
+		return;
+
+	pthread_mutex_lock(&source->async_mutex);
+	if (!source->async_upload) {
+		source->async_upload = upload;
+		upload = NULL;
+	}
+	pthread_mutex_unlock(&source->async_mutex);
+
+	if (upload)
+		async_upload_destroy(upload);
+}
+
+bool obs_source_async_upload(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_async_upload")
+		       ? source->async_upload != NULL
+		       : false;
+}
@@ -21,6 +21,7 @@
 #include "media-io/format-conversion.h"
 #include "media-io/video-frame.h"
 #include "media-io/audio-io.h"
+#include "media-io/audio-mixing.h"
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/util_uint64.h"
@@ -31,6 +32,11 @@
 #include "obs.h"
 #include "obs-internal.h"
 
+/* frames queued for the graphics thread before the backlog is dropped */
+#define MAX_ASYNC_FRAMES 30
+/* frames in flight that can be handed back for reuse */
+#define MAX_FREE_ASYNC_FRAMES 128
+
 static bool filter_compatible(obs_source_t *source, obs_source_t *filter);
 
 static inline bool data_valid(const struct obs_source *source, const char *f)
@@ -43,7 +49,7 @@ static inline bool deinterlacing_enabled(const struct obs_source *source)
 	return source->deinterlace_mode != OBS_DEINTERLACE_MODE_DISABLE;
 }
 
-struct obs_source_info *get_source_info(const char *id)
+static struct obs_source_info *find_source_info(const char *id)
 {
 	for (size_t i = 0; i < obs->source_types.num; i++) {
 		struct obs_source_info *info = &obs->source_types.array[i];
@@ -54,8 +60,17 @@ struct obs_source_info *get_source_info(const char *id)
 	return NULL;
 }
 
-struct obs_source_info *get_source_info2(const char *unversioned_id,
-					 uint32_t ver)
+struct obs_source_info *get_source_info(const char *id)
+{
+	struct obs_source_info *info = find_source_info(id);
+
+	if (!info && obs_load_module_for_type(id))
+		info = find_source_info(id);
+	return info;
+}
+
+static struct obs_source_info *find_source_info2(const char *unversioned_id,
+						 uint32_t ver)
 {
 	for (size_t i = 0; i < obs->source_types.num; i++) {
 		struct obs_source_info *info = &obs->source_types.array[i];
@@ -67,6 +82,16 @@ struct obs_source_info *get_source_info2(const char *unversioned_id,
 	return NULL;
 }
 
+struct obs_source_info *get_source_info2(const char *unversioned_id,
+					 uint32_t ver)
+{
+	struct obs_source_info *info = find_source_info2(unversioned_id, ver);
+
+	if (!info && obs_load_module_for_type(unversioned_id))
+		info = find_source_info2(unversioned_id, ver);
+	return info;
+}
+
 static const char *source_signals[] = {
 	"void destroy(ptr source)",
 	"void remove(ptr source)",
@@ -115,8 +140,12 @@ bool obs_source_init_context(struct obs_source *source, obs_data_t *settings,
 				   settings, name, hotkey_data, private))
 		return false;
 
-	return signal_handler_add_array(source->context.signals,
-					source_signals);
+	if (!signal_handler_add_array(source->context.signals, source_signals))
+		return false;
+
+	source->volume_signal =
+		signal_handler_get_handle(source->context.signals, "volume");
+	return true;
 }
 
 const char *obs_source_get_display_name(const char *id)
@@ -181,6 +210,7 @@ static bool obs_source_init(struct obs_source *source)
 	source->audio_active = true;
 	pthread_mutex_init_value(&source->filter_mutex);
 	pthread_mutex_init_value(&source->async_mutex);
+	pthread_mutex_init_value(&source->async_output_mutex);
 	pthread_mutex_init_value(&source->audio_mutex);
 	pthread_mutex_init_value(&source->audio_buf_mutex);
 	pthread_mutex_init_value(&source->audio_cb_mutex);
@@ -202,9 +232,16 @@ static bool obs_source_init(struct obs_source *source)
 		return false;
 	if (pthread_mutex_init(&source->async_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&source->async_output_mutex, NULL) != 0)
+		return false;
 	if (pthread_mutex_init(&source->caption_cb_mutex, NULL) != 0)
 		return false;
 
+	if (source->info.output_flags & OBS_SOURCE_ASYNC) {
+		spsc_ring_init(&source->async_queue, MAX_ASYNC_FRAMES);
+		spsc_ring_init(&source->async_free, MAX_FREE_ASYNC_FRAMES);
+	}
+
 	if (is_audio_source(source) || is_composite_source(source))
 		allocate_audio_output_buffer(source);
 	if (source->info.audio_mix)
@@ -240,7 +277,8 @@ static void obs_source_init_finalize(struct obs_source *source)
 	}
 
 	obs_context_data_insert(&source->context, &obs->data.sources_mutex,
-				&obs->data.first_source);
+				&obs->data.first_source,
+				&obs->data.source_index);
 }
 
 static bool obs_source_hotkey_mute(void *data, obs_hotkey_pair_id id,
@@ -276,7 +314,7 @@ static bool obs_source_hotkey_unmute(void *data, obs_hotkey_pair_id id,
 static void obs_source_hotkey_push_to_mute(void *data, obs_hotkey_id id,
 					   obs_hotkey_t *key, bool pressed)
 {
-	struct audio_action action = {.timestamp = os_gettime_ns(),
+	struct audio_action action = {.timestamp = obs_get_clock_ns(),
 				      .type = AUDIO_ACTION_PTM,
 				      .set = pressed};
 
@@ -295,7 +333,7 @@ static void obs_source_hotkey_push_to_mute(void *data, obs_hotkey_id id,
 static void obs_source_hotkey_push_to_talk(void *data, obs_hotkey_id id,
 					   obs_hotkey_t *key, bool pressed)
 {
-	struct audio_action action = {.timestamp = os_gettime_ns(),
+	struct audio_action action = {.timestamp = obs_get_clock_ns(),
 				      .type = AUDIO_ACTION_PTT,
 				      .set = pressed};
 
@@ -337,7 +375,7 @@ static void obs_source_init_audio_hotkeys(struct obs_source *source)
 static obs_source_t *
 obs_source_create_internal(const char *id, const char *name,
 			   obs_data_t *settings, obs_data_t *hotkey_data,
-			   bool private, uint32_t last_obs_ver)
+			   bool private, uint32_t last_obs_ver, bool deferred)
 {
 	struct obs_source *source = bzalloc(sizeof(struct obs_source));
 
@@ -385,16 +423,24 @@ obs_source_create_internal(const char *id, const char *name,
 	if (!private)
 		obs_source_init_audio_hotkeys(source);
 
+	/* only inputs can wait to be created, anything else may be needed by
+	 * the sources that use it right away */
+	if (deferred && (!info || !info->create ||
+			 info->type != OBS_SOURCE_TYPE_INPUT || private))
+		deferred = false;
+
 	/* allow the source to be created even if creation fails so that the
 	 * user's data doesn't become lost */
-	if (info && info->create)
+	if (deferred)
+		source->create_deferred = true;
+	else if (info && info->create)
 		source->context.data =
 			info->create(source->context.settings, source);
-	if ((!info || info->create) && !source->context.data)
+	if ((!info || info->create) && !deferred && !source->context.data)
 		blog(LOG_ERROR, "Failed to create source '%s'!", name);
 
-	blog(LOG_DEBUG, "%ssource '%s' (%s) created", private ? "private " : "",
-	     name, id);
+	blog(LOG_DEBUG, "%ssource '%s' (%s) %s", private ? "private " : "",
+	     name, id, deferred ? "loaded, creation deferred" : "created");
 
 	source->flags = source->default_flags;
 	source->enabled = true;
@@ -416,14 +462,14 @@ obs_source_t *obs_source_create(const char *id, const char *name,
 				obs_data_t *settings, obs_data_t *hotkey_data)
 {
 	return obs_source_create_internal(id, name, settings, hotkey_data,
-					  false, LIBOBS_API_VER);
+					  false, LIBOBS_API_VER, false);
 }
 
 obs_source_t *obs_source_create_private(const char *id, const char *name,
 					obs_data_t *settings)
 {
 	return obs_source_create_internal(id, name, settings, NULL, true,
-					  LIBOBS_API_VER);
+					  LIBOBS_API_VER, false);
 }
 
 obs_source_t *obs_source_create_set_last_ver(const char *id, const char *name,
@@ -432,7 +478,69 @@ obs_source_t *obs_source_create_set_last_ver(const char *id, const char *name,
 					     uint32_t last_obs_ver)
 {
 	return obs_source_create_internal(id, name, settings, hotkey_data,
-					  false, last_obs_ver);
+					  false, last_obs_ver, false);
+}
+
+obs_source_t *obs_source_create_deferred(const char *id, const char *name,
+					 obs_data_t *settings,
+					 obs_data_t *hotkey_data,
+					 uint32_t last_obs_ver)
+{
+	return obs_source_create_internal(id, name, settings, hotkey_data,
+					  false, last_obs_ver, true);
+}
+
+static void load_source(obs_source_t *source)
+{
+	if (source->info.load)
+		source->info.load(source->context.data,
+				  source->context.settings);
+
+	obs_source_dosignal(source, "source_load", "load");
+}
+
+void obs_source_instantiate(obs_source_t *source)
+{
+	bmem_account_t *prev_account;
+	void *data;
+
+	if (!obs_source_valid(source, "obs_source_instantiate"))
+		return;
+	if (!os_atomic_load_bool(&source->create_deferred) || source->removed)
+		return;
+	if (os_atomic_exchange_bool(&source->create_claimed, true))
+		return;
+
+	/* the settings are current when created, pending updates would only
+	 * repeat them */
+	os_atomic_store_long(&source->defer_update_count, 0);
+
+	prev_account = bmem_set_thread_account(source->context.mem_account);
+	data = source->info.create(source->context.settings, source);
+	bmem_set_thread_account(prev_account);
+	if (!data)
+		blog(LOG_ERROR, "Failed to create source '%s'!",
+		     obs_source_get_name(source));
+	else
+		blog(LOG_DEBUG, "source '%s' (%s) created on first use",
+		     obs_source_get_name(source), source->info.id);
+
+	os_atomic_exchange_ptr(&source->context.data, data);
+
+	if (data && source->load_pending)
+		load_source(source);
+	source->load_pending = false;
+
+	/* show/activate are held back by the video tick until now */
+	os_atomic_store_bool(&source->create_deferred, false);
+	os_atomic_inc_long(&source->content_version);
+}
+
+bool obs_source_deferred(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_deferred")
+		       ? os_atomic_load_bool(&source->create_deferred)
+		       : false;
 }
 
 static char *get_new_filter_name(obs_source_t *dst, const char *name)
@@ -603,15 +711,78 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 	}
 }
 
+/* frames of the async cache keep their planes in the shared frame arena */
+static struct obs_source_frame *async_frame_create(enum video_format format,
+						   uint32_t width,
+						   uint32_t height)
+{
+	struct obs_source_frame *frame = bzalloc(sizeof(*frame));
+	struct video_frame vid_frame;
+
+	video_frame_init_alloc(&vid_frame, format, width, height,
+			       obs_frame_arena_alloc);
+	frame->format = format;
+	frame->width = width;
+	frame->height = height;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame->data[i] = vid_frame.data[i];
+		frame->linesize[i] = vid_frame.linesize[i];
+	}
+
+	return frame;
+}
+
+static void async_frame_destroy(struct obs_source_frame *frame)
+{
+	if (frame) {
+		obs_frame_arena_release(frame->data[0]);
+		bfree(frame);
+	}
+}
+
+struct obs_source_frame *
+obs_source_frame_create_pooled(enum video_format format, uint32_t width,
+			       uint32_t height)
+{
+	struct obs_source_frame *frame =
+		async_frame_create(format, width, height);
+	frame->refs = 1;
+	return frame;
+}
+
 static inline void obs_source_frame_decref(struct obs_source_frame *frame)
 {
 	if (os_atomic_dec_long(&frame->refs) == 0)
-		obs_source_frame_destroy(frame);
+		async_frame_destroy(frame);
 }
 
 static bool obs_source_filter_remove_refless(obs_source_t *source,
 					     obs_source_t *filter);
 
+static void free_async_frames(obs_source_t *source)
+{
+	struct obs_source_frame *frame;
+
+	for (size_t i = 0; i < source->async_cache.num; i++)
+		obs_source_frame_decref(source->async_cache.array[i].frame);
+	for (size_t i = 0; i < source->async_frames.num; i++)
+		obs_source_frame_decref(source->async_frames.array[i]);
+
+	while ((frame = spsc_ring_pop(&source->async_queue)) != NULL)
+		obs_source_frame_decref(frame);
+	while ((frame = spsc_ring_pop(&source->async_free)) != NULL)
+		obs_source_frame_decref(frame);
+
+	if (source->cur_async_frame)
+		obs_source_frame_decref(source->cur_async_frame);
+	if (source->prev_async_frame)
+		obs_source_frame_decref(source->prev_async_frame);
+
+	spsc_ring_free(&source->async_queue);
+	spsc_ring_free(&source->async_free);
+}
+
 void obs_source_destroy(struct obs_source *source)
 {
 	size_t i;
@@ -634,6 +805,9 @@ void obs_source_destroy(struct obs_source *source)
 	if (source->filter_parent)
 		obs_source_filter_remove_refless(source->filter_parent, source);
 
+	if (source->master_clock)
+		obs_master_clock_remove_source(source);
+
 	while (source->filters.num)
 		obs_source_filter_remove(source, source->filters.array[0]);
 
@@ -644,6 +818,11 @@ void obs_source_destroy(struct obs_source *source)
 
 	obs_source_dosignal(source, "source_destroy", "destroy");
 
+	/* whoever warmed the source let go of it without cooling it, it no
+	 * longer counts against the limit */
+	if (os_atomic_load_long(&source->warm_refs) > 0)
+		os_atomic_dec_long(&obs->data.warm_sources);
+
 	if (source->context.data) {
 		source->info.destroy(source->context.data);
 		source->context.data = NULL;
@@ -655,24 +834,30 @@ void obs_source_destroy(struct obs_source *source)
 	obs_hotkey_unregister(source->push_to_mute_key);
 	obs_hotkey_pair_unregister(source->mute_unmute_key);
 
-	for (i = 0; i < source->async_cache.num; i++)
-		obs_source_frame_decref(source->async_cache.array[i].frame);
+	async_upload_free(source);
+	free_async_frames(source);
 
 	gs_enter_context(obs->video.graphics);
 	if (source->async_texrender)
 		gs_texrender_destroy(source->async_texrender);
 	if (source->async_prev_texrender)
 		gs_texrender_destroy(source->async_prev_texrender);
+	if (source->deinterlace_texrender)
+		gs_texrender_destroy(source->deinterlace_texrender);
 	for (size_t c = 0; c < MAX_AV_PLANES; c++) {
 		gs_texture_destroy(source->async_textures[c]);
 		gs_texture_destroy(source->async_prev_textures[c]);
 	}
 	if (source->filter_texrender)
 		gs_texrender_destroy(source->filter_texrender);
+	gs_texrender_destroy(source->memo_texrender);
 	gs_leave_context();
 
-	for (i = 0; i < MAX_AV_PLANES; i++)
+	for (i = 0; i < MAX_AV_PLANES; i++) {
 		bfree(source->audio_data.data[i]);
+		bfree(source->audio_filter_data.data[i]);
+	}
+	circlebuf_free(&source->audio_filter_queue);
 	for (i = 0; i < MAX_AUDIO_CHANNELS; i++)
 		circlebuf_free(&source->audio_input_buf[i]);
 	audio_resampler_destroy(source->resampler);
@@ -697,6 +882,7 @@ void obs_source_destroy(struct obs_source *source)
 	pthread_mutex_destroy(&source->audio_mutex);
 	pthread_mutex_destroy(&source->caption_cb_mutex);
 	pthread_mutex_destroy(&source->async_mutex);
+	pthread_mutex_destroy(&source->async_output_mutex);
 	obs_data_release(source->private_settings);
 	obs_context_data_free(&source->context);
 
@@ -874,12 +1060,15 @@ bool obs_is_source_configurable(const char *id)
 
 bool obs_source_configurable(const obs_source_t *source)
 {
-	return data_valid(source, "obs_source_configurable") &&
+	return (obs_source_deferred(source) ||
+		data_valid(source, "obs_source_configurable")) &&
 	       (source->info.get_properties || source->info.get_properties2);
 }
 
 obs_properties_t *obs_source_properties(const obs_source_t *source)
 {
+	if (obs_source_deferred(source))
+		obs_source_instantiate((obs_source_t *)source);
 	if (!data_valid(source, "obs_source_properties"))
 		return NULL;
 
@@ -913,14 +1102,30 @@ uint32_t obs_get_source_output_flags(const char *id)
 	return info ? info->output_flags : 0;
 }
 
+static inline void bump_content_version(obs_source_t *source)
+{
+	obs_source_t *parent = source->filter_parent;
+
+	os_atomic_inc_long(&source->content_version);
+
+	/* filter output is part of the output of the source it filters */
+	if (parent)
+		os_atomic_inc_long(&parent->content_version);
+}
+
 static void obs_source_deferred_update(obs_source_t *source)
 {
 	if (source->context.data && source->info.update) {
 		long count = os_atomic_load_long(&source->defer_update_count);
+		bmem_account_t *prev_account =
+			bmem_set_thread_account(source->context.mem_account);
+
 		source->info.update(source->context.data,
 				    source->context.settings);
+		bmem_set_thread_account(prev_account);
 		os_atomic_compare_swap_long(&source->defer_update_count, count,
 					    0);
+		bump_content_version(source);
 	}
 }
 
@@ -935,9 +1140,111 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 	if (source->info.output_flags & OBS_SOURCE_VIDEO) {
 		os_atomic_inc_long(&source->defer_update_count);
 	} else if (source->context.data && source->info.update) {
+		bmem_account_t *prev_account =
+			bmem_set_thread_account(source->context.mem_account);
+
 		source->info.update(source->context.data,
 				    source->context.settings);
+		bmem_set_thread_account(prev_account);
+	}
+}
+
+void obs_source_content_changed(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_content_changed"))
+		return;
+
+	bump_content_version(source);
+}
+
+static bool filters_cacheable(obs_source_t *source)
+{
+	bool cacheable = true;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t *filter = source->filters.array[i];
+		if (filter->enabled && (filter->info.output_flags &
+					OBS_SOURCE_CACHEABLE_VIDEO) == 0) {
+			cacheable = false;
+			break;
+		}
 	}
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return cacheable;
+}
+
+/* returns false if the output of the source or one of its enabled filters
+ * can change without the content version changing */
+bool obs_source_get_content_version(obs_source_t *source, long *version)
+{
+	if ((source->info.output_flags & OBS_SOURCE_CACHEABLE_VIDEO) == 0)
+		return false;
+
+	*version = os_atomic_load_long(&source->content_version);
+	return filters_cacheable(source);
+}
+
+bool obs_source_get_video_version(obs_source_t *source, uint64_t *version)
+{
+	uint64_t content;
+	long source_version;
+	long rebuilds;
+
+	if (!obs_source_valid(source, "obs_source_get_video_version") ||
+	    !obs_ptr_valid(version, "obs_source_get_video_version"))
+		return false;
+
+	if (source->info.type == OBS_SOURCE_TYPE_SCENE) {
+		/* scenes are versioned by their items, the content version
+		 * only covers changes to their filters */
+		if (!source->context.data || !filters_cacheable(source) ||
+		    !obs_scene_get_video_version(source->context.data,
+						 &content))
+			return false;
+
+		source_version = os_atomic_load_long(&source->content_version);
+		content = OBS_VERSION_MIX(content, source_version);
+	} else {
+		if (!obs_source_get_content_version(source, &source_version))
+			return false;
+		content = OBS_VERSION_MIX(OBS_VERSION_INIT, source_version);
+	}
+
+	/* cached renders are lost when the device is rebuilt */
+	rebuilds = os_atomic_load_long(&obs->video.device_rebuilds);
+	content = OBS_VERSION_MIX(content, rebuilds);
+	*version = OBS_VERSION_MIX(content, source->enabled);
+	return true;
+}
+
+void obs_source_set_max_render_fps(obs_source_t *source, double fps)
+{
+	if (!obs_source_valid(source, "obs_source_set_max_render_fps"))
+		return;
+
+	source->max_render_fps = fps > 0.0 ? fps : 0.0;
+}
+
+double obs_source_get_max_render_fps(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_max_render_fps")
+		       ? source->max_render_fps
+		       : 0.0;
+}
+
+bool obs_source_get_size_hint(const obs_source_t *source, uint32_t *cx,
+			      uint32_t *cy)
+{
+	if (!obs_source_valid(source, "obs_source_get_size_hint"))
+		return false;
+
+	if (cx)
+		*cx = source->size_hint_cx;
+	if (cy)
+		*cy = source->size_hint_cy;
+	return source->size_hint_cx && source->size_hint_cy;
 }
 
 void obs_source_update_properties(obs_source_t *source)
@@ -1034,6 +1341,18 @@ static void deactivate_source(obs_source_t *source)
 	obs_source_dosignal(source, "source_deactivate", "deactivate");
 }
 
+static void warm_source(obs_source_t *source)
+{
+	if (source->context.data && source->info.warm)
+		source->info.warm(source->context.data);
+}
+
+static void cool_source(obs_source_t *source)
+{
+	if (source->context.data && source->info.cool)
+		source->info.cool(source->context.data);
+}
+
 static void show_source(obs_source_t *source)
 {
 	if (source->context.data && source->info.show)
@@ -1066,6 +1385,35 @@ static void deactivate_tree(obs_source_t *parent, obs_source_t *child,
 	UNUSED_PARAMETER(param);
 }
 
+static void warm_tree(obs_source_t *parent, obs_source_t *child, void *param)
+{
+	if (os_atomic_inc_long(&child->warm_refs) == 1)
+		os_atomic_inc_long(&obs->data.warm_sources);
+
+	UNUSED_PARAMETER(parent);
+	UNUSED_PARAMETER(param);
+}
+
+static void cool_tree(obs_source_t *parent, obs_source_t *child, void *param)
+{
+	if (os_atomic_dec_long(&child->warm_refs) == 0)
+		os_atomic_dec_long(&obs->data.warm_sources);
+
+	UNUSED_PARAMETER(parent);
+	UNUSED_PARAMETER(param);
+}
+
+static void count_cold_tree(obs_source_t *parent, obs_source_t *child,
+			    void *param)
+{
+	long *count = param;
+
+	if (!os_atomic_load_long(&child->warm_refs))
+		(*count)++;
+
+	UNUSED_PARAMETER(parent);
+}
+
 static void show_tree(obs_source_t *parent, obs_source_t *child, void *param)
 {
 	os_atomic_inc_long(&child->show_refs);
@@ -1120,12 +1468,38 @@ static inline struct obs_source_frame *get_closest_frame(obs_source_t *source,
 bool set_async_texture_size(struct obs_source *source,
 			    const struct obs_source_frame *frame);
 
+/* moves newly output frames to async_frames, assumes async_mutex */
+static void drain_async_queue(obs_source_t *source)
+{
+	struct obs_source_frame *frame;
+
+	while ((frame = spsc_ring_pop(&source->async_queue)) != NULL)
+		da_push_back(source->async_frames, &frame);
+
+	/* frames piled up (or the queue overflowed), so timing is off; drop
+	 * the backlog and resync on the next frame */
+	if (os_atomic_set_bool(&source->async_flush, false) ||
+	    source->async_frames.num >= MAX_ASYNC_FRAMES) {
+		for (size_t i = 0; i < source->async_frames.num; i++)
+			remove_async_frame(source, source->async_frames.array[i]);
+
+		da_resize(source->async_frames, 0);
+		source->last_frame_ts = 0;
+		os_atomic_inc_long(&source->async_flushes);
+	}
+}
+
 static void async_tick(obs_source_t *source)
 {
 	uint64_t sys_time = obs->video.video_time;
 
+	/* an unfinished upload still reads the current frame */
+	async_upload_wait(source);
+
 	pthread_mutex_lock(&source->async_mutex);
 
+	drain_async_queue(source);
+
 	if (deinterlacing_enabled(source)) {
 		deinterlace_process_last_frame(source, sys_time);
 	} else {
@@ -1143,15 +1517,74 @@ static void async_tick(obs_source_t *source)
 	if (source->cur_async_frame)
 		source->async_update_texture =
 			set_async_texture_size(source, source->cur_async_frame);
+
+	async_upload_start(source);
 }
 
-void obs_source_video_tick(obs_source_t *source, float seconds)
+static void instantiate_task(void *param)
 {
-	bool now_showing, now_active;
+	obs_source_t *source = param;
+	obs_source_instantiate(source);
+	obs_source_release(source);
+}
 
-	if (!obs_source_valid(source, "obs_source_video_tick"))
+/* sources are created on the UI thread if there is one, same as when they
+ * are created by the frontend */
+static void queue_instantiation(obs_source_t *source)
+{
+	enum obs_task_type type = obs->ui_task_handler ? OBS_TASK_UI
+						       : OBS_TASK_GRAPHICS;
+
+	if (os_atomic_exchange_bool(&source->create_queued, true))
+		return;
+
+	obs_source_addref(source);
+	obs_queue_task(type, instantiate_task, source, false);
+}
+
+/* sources drawn only by displays with a lower frame rate miss hints on some
+ * frames, so the hint is only dropped after this long without one */
+#define SIZE_HINT_TIMEOUT 1.0f
+
+void obs_source_add_size_hint(obs_source_t *source, uint32_t cx, uint32_t cy)
+{
+	if (cx > source->next_size_hint_cx)
+		source->next_size_hint_cx = cx;
+	if (cy > source->next_size_hint_cy)
+		source->next_size_hint_cy = cy;
+}
+
+static void update_size_hint(obs_source_t *source, float seconds)
+{
+	uint32_t cx = source->next_size_hint_cx;
+	uint32_t cy = source->next_size_hint_cy;
+
+	source->next_size_hint_cx = 0;
+	source->next_size_hint_cy = 0;
+
+	if (cx && cy) {
+		source->size_hint_unused = 0.0f;
+	} else {
+		source->size_hint_unused += seconds;
+		if (source->size_hint_unused < SIZE_HINT_TIMEOUT)
+			return;
+		cx = cy = 0;
+	}
+
+	if (cx == source->size_hint_cx && cy == source->size_hint_cy)
 		return;
 
+	source->size_hint_cx = cx;
+	source->size_hint_cy = cy;
+
+	if (source->context.data && source->info.set_size_hint)
+		source->info.set_size_hint(source->context.data, cx, cy);
+}
+
+static void source_video_tick_state(obs_source_t *source, float seconds)
+{
+	bool now_showing, now_active, now_warm;
+
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_tick(source, seconds);
 
@@ -1161,9 +1594,23 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 	if (os_atomic_load_long(&source->defer_update_count) > 0)
 		obs_source_deferred_update(source);
 
+	if ((source->info.output_flags & OBS_SOURCE_SIZE_HINT) != 0)
+		update_size_hint(source, seconds);
+
 	/* reset the filter render texture information once every frame */
 	if (source->filter_texrender)
 		gs_texrender_reset(source->filter_texrender);
+	if (source->memo_texrender)
+		gs_texrender_reset(source->memo_texrender);
+
+	/* a source that is waiting to be created is shown and activated
+	 * once it exists */
+	if (os_atomic_load_bool(&source->create_deferred)) {
+		if (source->show_refs || source->activate_refs ||
+		    source->warm_refs)
+			queue_instantiation(source);
+		goto finish;
+	}
 
 	/* call show/hide if the reference changed */
 	now_showing = !!source->show_refs;
@@ -1213,13 +1660,64 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 		source->active = now_active;
 	}
 
-	if (source->context.data && source->info.video_tick)
-		source->info.video_tick(source->context.data, seconds);
+	/* call warm/cool if the state changed, sources stop being warm once
+	 * they are active */
+	now_warm = source->warm_refs && !source->activate_refs;
+	if (now_warm != source->warm) {
+		if (now_warm)
+			warm_source(source);
+		else
+			cool_source(source);
 
+		source->warm = now_warm;
+	}
+
+finish:
 	source->async_rendered = false;
 	source->deinterlace_rendered = false;
 }
 
+void obs_source_video_tick(obs_source_t *source, float seconds)
+{
+	if (!obs_source_valid(source, "obs_source_video_tick"))
+		return;
+
+	source_video_tick_state(source, seconds);
+
+	if (source->context.data && source->info.video_tick)
+		obs_source_call_video_tick(source, seconds);
+}
+
+void obs_source_call_video_tick(obs_source_t *source, float seconds)
+{
+	uint64_t start = os_gettime_ns();
+	bmem_account_t *prev_account =
+		bmem_set_thread_account(source->context.mem_account);
+
+	source->info.video_tick(source->context.data, seconds);
+	bmem_set_thread_account(prev_account);
+	obs_source_perf_add(&source->perf_tick, os_gettime_ns() - start);
+}
+
+/* performs the per-frame state updates on the graphics thread, and returns
+ * true if the source's own tick callback is left for the tick pool */
+bool obs_source_video_tick_deferred(obs_source_t *source, float seconds)
+{
+	if (!obs_source_valid(source, "obs_source_video_tick_deferred"))
+		return false;
+
+	source_video_tick_state(source, seconds);
+
+	if (!source->context.data || !source->info.video_tick)
+		return false;
+
+	if ((source->info.output_flags & OBS_SOURCE_PARALLEL_TICK) != 0)
+		return true;
+
+	obs_source_call_video_tick(source, seconds);
+	return false;
+}
+
 /* unless the value is 3+ hours worth of frames, this won't overflow */
 static inline uint64_t conv_frames_to_time(const size_t sample_rate,
 					   const size_t frames)
@@ -1379,13 +1877,15 @@ static inline bool source_muted(obs_source_t *source, uint64_t os_time)
 	       (source->push_to_talk_enabled && !push_to_talk_active);
 }
 
+/* os_time is when the source output the audio, which is earlier than now if
+ * its filters were run by the audio thread */
 static void source_output_audio_data(obs_source_t *source,
-				     const struct audio_data *data)
+				     const struct audio_data *data,
+				     uint64_t os_time)
 {
 	size_t sample_rate = audio_output_get_sample_rate(obs->audio.audio);
 	struct audio_data in = *data;
 	uint64_t diff;
-	uint64_t os_time = os_gettime_ns();
 	int64_t sync_offset;
 	bool using_direct_ts = false;
 	bool push_back = false;
@@ -1483,6 +1983,7 @@ enum convert_type {
 	CONVERT_800,
 	CONVERT_RGB_LIMITED,
 	CONVERT_BGR3,
+	CONVERT_V210,
 };
 
 static inline enum convert_type get_convert_type(enum video_format format,
@@ -1526,6 +2027,14 @@ static inline enum convert_type get_convert_type(enum video_format format,
 
 	case VIDEO_FORMAT_AYUV:
 		return CONVERT_444_A_PACK;
+
+	case VIDEO_FORMAT_V210:
+		return CONVERT_V210;
+
+	case VIDEO_FORMAT_I010:
+	case VIDEO_FORMAT_P010:
+		/* only produced by the video output for now */
+		break;
 	}
 
 	return CONVERT_NONE;
@@ -1703,6 +2212,18 @@ static inline bool set_bgr3_sizes(struct obs_source *source,
 	return true;
 }
 
+/* each 10-bit texel holds three components, so a group of six pixels takes
+ * four texels and the shader picks the pixel's components out of them */
+static inline bool set_v210_sizes(struct obs_source *source,
+				  const struct obs_source_frame *frame)
+{
+	source->async_convert_width[0] = (frame->width + 47) / 48 * 32;
+	source->async_convert_height[0] = frame->height;
+	source->async_texture_formats[0] = GS_R10G10B10A2;
+	source->async_channel_count = 1;
+	return true;
+}
+
 static inline bool init_gpu_conversion(struct obs_source *source,
 				       const struct obs_source_frame *frame)
 {
@@ -1743,6 +2264,9 @@ static inline bool init_gpu_conversion(struct obs_source *source,
 	case CONVERT_444_A_PACK:
 		return set_packed444_alpha_sizes(source, frame);
 
+	case CONVERT_V210:
+		return set_v210_sizes(source, frame);
+
 	case CONVERT_NONE:
 		assert(false && "No conversion requested");
 		break;
@@ -1750,6 +2274,29 @@ static inline bool init_gpu_conversion(struct obs_source *source,
 	return false;
 }
 
+/* planar formats that can be sampled and converted while drawing, without
+ * first converting the whole frame into async_texrender */
+static const char *select_draw_technique(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_I422:
+	case VIDEO_FORMAT_I444:
+		return "Planar_Draw";
+
+	case VIDEO_FORMAT_I40A:
+	case VIDEO_FORMAT_I42A:
+	case VIDEO_FORMAT_YUVA:
+		return "PlanarA_Draw";
+
+	case VIDEO_FORMAT_NV12:
+		return "NV12_Draw";
+
+	default:
+		return NULL;
+	}
+}
+
 bool set_async_texture_size(struct obs_source *source,
 			    const struct obs_source_frame *frame)
 {
@@ -1785,6 +2332,10 @@ bool set_async_texture_size(struct obs_source *source,
 	const bool async_gpu_conversion = (cur != CONVERT_NONE) &&
 					  init_gpu_conversion(source, frame);
 	source->async_gpu_conversion = async_gpu_conversion;
+	source->async_direct_draw =
+		async_gpu_conversion &&
+		select_draw_technique(frame->format) != NULL;
+	source->async_texrender_dirty = false;
 	if (async_gpu_conversion) {
 		source->async_texrender =
 			gs_texrender_create(format, GS_ZS_NONE);
@@ -1825,6 +2376,7 @@ static void upload_raw_frame(gs_texture_t *tex[MAX_AV_PLANES],
 	case CONVERT_422_A:
 	case CONVERT_444_A:
 	case CONVERT_444_A_PACK:
+	case CONVERT_V210:
 		for (size_t c = 0; c < MAX_AV_PLANES; c++) {
 			if (tex[c])
 				gs_texture_set_image(tex[c], frame->data[c],
@@ -1881,6 +2433,13 @@ static const char *select_conversion_technique(enum video_format format,
 	case VIDEO_FORMAT_AYUV:
 		return "AYUV_Reverse";
 
+	case VIDEO_FORMAT_V210:
+		return "V210_Reverse";
+
+	case VIDEO_FORMAT_I010:
+	case VIDEO_FORMAT_P010:
+		break;
+
 	case VIDEO_FORMAT_BGRA:
 	case VIDEO_FORMAT_BGRX:
 	case VIDEO_FORMAT_RGBA:
@@ -1906,23 +2465,68 @@ static inline void set_eparami(gs_effect_t *effect, const char *name, int val)
 	gs_effect_set_int(param, val);
 }
 
-static bool update_async_texrender(struct obs_source *source,
-				   const struct obs_source_frame *frame,
-				   gs_texture_t *tex[MAX_AV_PLANES],
-				   gs_texrender_t *texrender)
+static void set_conversion_params(struct obs_source *source,
+				  gs_effect_t *conv,
+				  gs_texture_t *tex[MAX_AV_PLANES])
+{
+	uint32_t cx = source->async_width;
+	uint32_t cy = source->async_height;
+	const float *matrix = source->async_color_matrix;
+
+	if (tex[0])
+		gs_effect_set_texture(
+			gs_effect_get_param_by_name(conv, "image"), tex[0]);
+	if (tex[1])
+		gs_effect_set_texture(
+			gs_effect_get_param_by_name(conv, "image1"), tex[1]);
+	if (tex[2])
+		gs_effect_set_texture(
+			gs_effect_get_param_by_name(conv, "image2"), tex[2]);
+	if (tex[3])
+		gs_effect_set_texture(
+			gs_effect_get_param_by_name(conv, "image3"), tex[3]);
+	set_eparam(conv, "width", (float)cx);
+	set_eparam(conv, "height", (float)cy);
+	set_eparam(conv, "width_d2", (float)cx * 0.5f);
+	set_eparam(conv, "height_d2", (float)cy * 0.5f);
+	set_eparam(conv, "width_x2_i", 0.5f / (float)cx);
+
+	struct vec4 vec0, vec1, vec2;
+	vec4_set(&vec0, matrix[0], matrix[1], matrix[2], matrix[3]);
+	vec4_set(&vec1, matrix[4], matrix[5], matrix[6], matrix[7]);
+	vec4_set(&vec2, matrix[8], matrix[9], matrix[10], matrix[11]);
+	gs_effect_set_vec4(gs_effect_get_param_by_name(conv, "color_vec0"),
+			   &vec0);
+	gs_effect_set_vec4(gs_effect_get_param_by_name(conv, "color_vec1"),
+			   &vec1);
+	gs_effect_set_vec4(gs_effect_get_param_by_name(conv, "color_vec2"),
+			   &vec2);
+	if (!source->async_full_range) {
+		gs_eparam_t *min_param =
+			gs_effect_get_param_by_name(conv, "color_range_min");
+		gs_effect_set_val(min_param, source->async_color_range_min,
+				  sizeof(float) * 3);
+		gs_eparam_t *max_param =
+			gs_effect_get_param_by_name(conv, "color_range_max");
+		gs_effect_set_val(max_param, source->async_color_range_max,
+				  sizeof(float) * 3);
+	}
+}
+
+static bool convert_async_texrender(struct obs_source *source,
+				    gs_texture_t *tex[MAX_AV_PLANES],
+				    gs_texrender_t *texrender)
 {
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_CONVERT_FORMAT, "Convert Format");
 
 	gs_texrender_reset(texrender);
 
-	upload_raw_frame(tex, frame);
-
 	uint32_t cx = source->async_width;
 	uint32_t cy = source->async_height;
 
 	gs_effect_t *conv = obs->video.conversion_effect;
-	const char *tech_name =
-		select_conversion_technique(frame->format, frame->full_range);
+	const char *tech_name = select_conversion_technique(
+		source->async_format, source->async_full_range);
 	gs_technique_t *tech = gs_effect_get_technique(conv, tech_name);
 
 	const bool success = gs_texrender_begin(texrender, cx, cy);
@@ -1933,52 +2537,7 @@ static bool update_async_texrender(struct obs_source *source,
 		gs_technique_begin(tech);
 		gs_technique_begin_pass(tech, 0);
 
-		if (tex[0])
-			gs_effect_set_texture(
-				gs_effect_get_param_by_name(conv, "image"),
-				tex[0]);
-		if (tex[1])
-			gs_effect_set_texture(
-				gs_effect_get_param_by_name(conv, "image1"),
-				tex[1]);
-		if (tex[2])
-			gs_effect_set_texture(
-				gs_effect_get_param_by_name(conv, "image2"),
-				tex[2]);
-		if (tex[3])
-			gs_effect_set_texture(
-				gs_effect_get_param_by_name(conv, "image3"),
-				tex[3]);
-		set_eparam(conv, "width", (float)cx);
-		set_eparam(conv, "height", (float)cy);
-		set_eparam(conv, "width_d2", (float)cx * 0.5f);
-		set_eparam(conv, "height_d2", (float)cy * 0.5f);
-		set_eparam(conv, "width_x2_i", 0.5f / (float)cx);
-
-		struct vec4 vec0, vec1, vec2;
-		vec4_set(&vec0, frame->color_matrix[0], frame->color_matrix[1],
-			 frame->color_matrix[2], frame->color_matrix[3]);
-		vec4_set(&vec1, frame->color_matrix[4], frame->color_matrix[5],
-			 frame->color_matrix[6], frame->color_matrix[7]);
-		vec4_set(&vec2, frame->color_matrix[8], frame->color_matrix[9],
-			 frame->color_matrix[10], frame->color_matrix[11]);
-		gs_effect_set_vec4(
-			gs_effect_get_param_by_name(conv, "color_vec0"), &vec0);
-		gs_effect_set_vec4(
-			gs_effect_get_param_by_name(conv, "color_vec1"), &vec1);
-		gs_effect_set_vec4(
-			gs_effect_get_param_by_name(conv, "color_vec2"), &vec2);
-		if (!frame->full_range) {
-			gs_eparam_t *min_param = gs_effect_get_param_by_name(
-				conv, "color_range_min");
-			gs_effect_set_val(min_param, frame->color_range_min,
-					  sizeof(float) * 3);
-			gs_eparam_t *max_param = gs_effect_get_param_by_name(
-				conv, "color_range_max");
-			gs_effect_set_val(max_param, frame->color_range_max,
-					  sizeof(float) * 3);
-		}
-
+		set_conversion_params(source, conv, tex);
 		gs_draw(GS_TRIS, 0, 3);
 
 		gs_technique_end_pass(tech);
@@ -1993,6 +2552,51 @@ static bool update_async_texrender(struct obs_source *source,
 	return success;
 }
 
+/* frames that are only ever drawn straight into the scene are converted
+ * while drawing; the conversion into async_texrender is deferred until
+ * something needs the texture itself */
+static inline bool can_defer_conversion(const struct obs_source *source,
+					gs_texrender_t *texrender)
+{
+	return source->async_direct_draw && !source->async_texrender_needed &&
+	       texrender == source->async_texrender &&
+	       !deinterlacing_enabled(source);
+}
+
+static bool update_async_texrender(struct obs_source *source,
+				   const struct obs_source_frame *frame,
+				   gs_texture_t *tex[MAX_AV_PLANES],
+				   gs_texrender_t *texrender)
+{
+	if (!async_upload_finish(source, frame, tex))
+		upload_raw_frame(tex, frame);
+
+	memcpy(source->async_color_matrix, frame->color_matrix,
+	       sizeof(source->async_color_matrix));
+	memcpy(source->async_color_range_min, frame->color_range_min,
+	       sizeof(source->async_color_range_min));
+	memcpy(source->async_color_range_max, frame->color_range_max,
+	       sizeof(source->async_color_range_max));
+
+	if (can_defer_conversion(source, texrender)) {
+		source->async_texrender_dirty = true;
+		return true;
+	}
+
+	source->async_texrender_dirty = false;
+	return convert_async_texrender(source, tex, texrender);
+}
+
+void finish_async_texrender(struct obs_source *source)
+{
+	if (!source->async_texrender_dirty)
+		return;
+
+	source->async_texrender_dirty = false;
+	convert_async_texrender(source, source->async_textures,
+				source->async_texrender);
+}
+
 bool update_async_texture(struct obs_source *source,
 			  const struct obs_source_frame *frame,
 			  gs_texture_t *tex, gs_texrender_t *texrender)
@@ -2010,6 +2614,7 @@ bool update_async_textures(struct obs_source *source,
 	enum convert_type type;
 
 	source->async_flip = frame->flip;
+	source->deinterlace_dirty = true;
 
 	if (source->async_gpu_conversion && texrender)
 		return update_async_texrender(source, frame, tex, texrender);
@@ -2032,6 +2637,8 @@ static inline void obs_source_draw_texture(struct obs_source *source,
 
 	if (source->async_texrender)
 		tex = gs_texrender_get_texture(source->async_texrender);
+	if (!tex)
+		return;
 
 	param = gs_effect_get_param_by_name(effect, "image");
 
@@ -2051,12 +2658,56 @@ static inline void obs_source_draw_texture(struct obs_source *source,
 	gs_enable_framebuffer_srgb(previous);
 }
 
+/* draws the whole frame without a texture, or the given part of it */
+static void draw_async_planes(struct obs_source *source,
+			      const struct gs_rect *sub)
+{
+	gs_effect_t *conv = obs->video.conversion_effect;
+	const char *tech_name = select_draw_technique(source->async_format);
+	gs_technique_t *tech = gs_effect_get_technique(conv, tech_name);
+
+	const bool linear_srgb = gs_get_linear_srgb();
+
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(linear_srgb);
+
+	gs_technique_begin(tech);
+	gs_technique_begin_pass(tech, 0);
+
+	set_conversion_params(source, conv, source->async_textures);
+	gs_effect_set_bool(gs_effect_get_param_by_name(conv, "linear_output"),
+			   linear_srgb);
+
+	if (sub)
+		gs_draw_sprite_subregion(source->async_textures[0],
+					 source->async_flip ? GS_FLIP_V : 0,
+					 sub->x, sub->y, sub->cx, sub->cy);
+	else
+		gs_draw_sprite(NULL, source->async_flip ? GS_FLIP_V : 0,
+			       source->async_width, source->async_height);
+
+	gs_technique_end_pass(tech);
+	gs_technique_end(tech);
+
+	gs_enable_framebuffer_srgb(previous);
+}
+
 static void obs_source_draw_async_texture(struct obs_source *source)
 {
 	gs_effect_t *effect = gs_get_effect();
 	bool def_draw = (!effect);
 	gs_technique_t *tech = NULL;
 
+	if (def_draw && source->async_texrender_dirty) {
+		draw_async_planes(source, NULL);
+		return;
+	}
+
+	/* the texture cannot be converted in the middle of someone else's
+	 * effect, convert every frame from now on */
+	if (source->async_texrender_dirty)
+		source->async_texrender_needed = true;
+
 	if (def_draw) {
 		effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
 		tech = gs_effect_get_technique(effect, "Draw");
@@ -2200,12 +2851,16 @@ static inline void obs_source_main_render(obs_source_t *source)
 	bool custom_draw = (flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
 	bool default_effect = !source->filter_parent &&
 			      source->filters.num == 0 && !custom_draw;
+	bmem_account_t *prev_account =
+		bmem_set_thread_account(source->context.mem_account);
 
 	if (default_effect)
 		obs_source_default_render(source);
 	else if (source->context.data)
 		source->info.video_render(source->context.data,
 					  custom_draw ? NULL : gs_get_effect());
+
+	bmem_set_thread_account(prev_account);
 }
 
 static bool ready_async_frame(obs_source_t *source, uint64_t sys_time);
@@ -2226,61 +2881,325 @@ static const char *get_type_format(enum obs_source_type type)
 		return "[Unknown]: %s";
 	}
 }
-#endif
+#endif
+
+/* low priority sources are left out of displays while the frames are over
+ * the render budget */
+static inline bool skip_over_budget(const obs_source_t *source)
+{
+	return obs->video.render_budget_exceeded &&
+	       obs->video.rendering_displays && !source->rendering_filter &&
+	       (source->flags & OBS_SOURCE_FLAG_LOW_RENDER_PRIORITY) != 0;
+}
+
+static inline void render_video(obs_source_t *source)
+{
+	gs_timer_t *timer;
+	uint64_t start;
+
+	if (source->info.type != OBS_SOURCE_TYPE_FILTER &&
+	    (source->info.output_flags & OBS_SOURCE_VIDEO) == 0) {
+		if (source->filter_parent)
+			obs_source_skip_video_filter(source);
+		return;
+	}
+
+	if (source->info.type == OBS_SOURCE_TYPE_INPUT &&
+	    (source->info.output_flags & OBS_SOURCE_ASYNC) != 0 &&
+	    !source->rendering_filter) {
+		if (deinterlacing_enabled(source))
+			deinterlace_update_async_video(source);
+		obs_source_update_async_video(source);
+	}
+
+	if (!source->context.data || !source->enabled) {
+		if (source->filter_parent)
+			obs_source_skip_video_filter(source);
+		return;
+	}
+
+	if (skip_over_budget(source)) {
+		os_atomic_store_long_long(
+			&source->skipped_renders,
+			os_atomic_load_long_long(&source->skipped_renders) + 1);
+		if (source->filter_parent)
+			obs_source_skip_video_filter(source);
+		return;
+	}
+
+	GS_DEBUG_MARKER_BEGIN_FORMAT(GS_DEBUG_COLOR_SOURCE,
+				     get_type_format(source->info.type),
+				     obs_source_get_name(source));
+
+	/* the source rendered by its own filters is part of their time */
+	start = os_gettime_ns();
+	timer = source->rendering_filter ? NULL
+					 : obs_gpu_timing_begin_source(source);
+
+	if (source->filters.num && !source->rendering_filter)
+		obs_source_render_filters(source);
+
+	else if (source->info.video_render) {
+		if (!source->filter_parent ||
+		    !obs_source_render_fused_filters(source))
+			obs_source_main_render(source);
+
+	} else if (source->filter_target)
+		obs_source_video_render(source->filter_target);
+
+	else if (deinterlacing_enabled(source))
+		deinterlace_render(source);
+
+	else
+		obs_source_render_async_video(source);
+
+	obs_gpu_timing_end_source(timer);
+	if (!source->rendering_filter)
+		obs_source_perf_add(&source->perf_render,
+				    os_gettime_ns() - start);
+
+	GS_DEBUG_MARKER_END();
+}
+
+static inline void render_filter_tex(gs_texture_t *tex, gs_effect_t *effect,
+				     uint32_t width, uint32_t height,
+				     const char *tech_name);
+
+/* only filtered sources and scenes cost more to render than to draw from a
+ * texture, and only outside of an effect is the texture drawn the same way
+ * the source would draw itself */
+static inline bool can_memoize(const obs_source_t *source)
+{
+	if (source->filter_parent || source->rendering_filter ||
+	    source->memo_rendering || !source->context.data ||
+	    !source->enabled)
+		return false;
+	if ((source->info.output_flags & OBS_SOURCE_VIDEO) == 0)
+		return false;
+	if (!source->filters.num &&
+	    source->info.type != OBS_SOURCE_TYPE_SCENE)
+		return false;
+
+	return gs_get_effect() == NULL;
+}
+
+/* sources drawn more than once in the previous frame are memoized */
+static bool count_memo_draw(obs_source_t *source)
+{
+	uint64_t frame = obs->video.render_frame;
+
+	if (source->memo_draw_frame != frame) {
+		source->memo_wanted = source->memo_draws > 1 &&
+				      source->memo_draw_frame + 1 == frame;
+		source->memo_draw_frame = frame;
+		source->memo_draws = 0;
+	}
+
+	source->memo_draws++;
+	return source->memo_wanted;
+}
+
+static bool render_memo(obs_source_t *source, uint32_t cx, uint32_t cy)
+{
+	bool success = false;
+
+	if (!source->memo_texrender)
+		source->memo_texrender =
+			gs_texrender_create_transient(GS_RGBA, GS_ZS_NONE);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (gs_texrender_begin(source->memo_texrender, cx, cy)) {
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+		source->memo_rendering = true;
+		render_video(source);
+		source->memo_rendering = false;
+
+		gs_texrender_end(source->memo_texrender);
+		success = true;
+	}
+
+	gs_blend_state_pop();
+	return success;
+}
+
+static bool render_video_memoized(obs_source_t *source)
+{
+	uint64_t frame = obs->video.render_frame;
+	uint32_t cx, cy;
+	gs_texture_t *tex;
+
+	if (!can_memoize(source) || !count_memo_draw(source))
+		return false;
+
+	cx = obs_source_get_width(source);
+	cy = obs_source_get_height(source);
+	if (!cx || !cy)
+		return false;
+
+	if (source->memo_frame != frame) {
+		if (!render_memo(source, cx, cy))
+			return false;
+		source->memo_frame = frame;
+	}
+
+	tex = gs_texrender_get_texture(source->memo_texrender);
+	if (!tex)
+		return false;
+
+	/* scenes blend their items themselves, so without filters after them
+	 * their memo holds premultiplied color, like scene item textures */
+	const bool premultiplied = source->info.type == OBS_SOURCE_TYPE_SCENE &&
+				   !source->filters.num;
+	if (premultiplied) {
+		gs_blend_state_push();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+	}
+
+	render_filter_tex(tex, obs->video.default_effect, cx, cy, "Draw");
+
+	if (premultiplied)
+		gs_blend_state_pop();
+	return true;
+}
+
+void obs_source_video_render(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_video_render"))
+		return;
+
+	obs_source_addref(source);
+	if (!render_video_memoized(source))
+		render_video(source);
+	obs_source_release(source);
+}
+
+/* async sources without filters draw straight from their frame, updated
+ * the way render_video updates it */
+static bool async_direct_ready(obs_source_t *source)
+{
+	if (source->info.type != OBS_SOURCE_TYPE_INPUT ||
+	    (source->info.output_flags & OBS_SOURCE_ASYNC) == 0)
+		return false;
+	if (deinterlacing_enabled(source))
+		return false;
+
+	obs_source_update_async_video(source);
+	return source->async_active && source->async_textures[0] &&
+	       !source->async_rotation;
+}
+
+gs_texture_t *obs_source_get_texture(obs_source_t *source, bool *flip)
+{
+	gs_texture_t *tex = NULL;
+
+	if (flip)
+		*flip = false;
+	if (!obs_source_valid(source, "obs_source_get_texture"))
+		return NULL;
+	if (source->filters.num || !source->context.data || !source->enabled)
+		return NULL;
+
+	if (source->info.video_get_texture) {
+		tex = source->info.video_get_texture(source->context.data);
+
+	} else if (async_direct_ready(source)) {
+		gs_texrender_t *texrender = source->async_texrender;
+
+		/* frames converted while drawing have no texture of their own */
+		if (source->async_texrender_dirty)
+			return NULL;
+
+		tex = texrender ? gs_texrender_get_texture(texrender)
+				: source->async_textures[0];
+		if (flip)
+			*flip = source->async_flip;
+	}
+
+	if (tex &&
+	    (gs_texture_get_width(tex) != obs_source_get_width(source) ||
+	     gs_texture_get_height(tex) != obs_source_get_height(source)))
+		return NULL;
+
+	return tex;
+}
 
-static inline void render_video(obs_source_t *source)
+/* draws part of a frame that is converted while drawing, like a cropped
+ * scene item, without converting the rest of it */
+bool obs_source_draw_async_subregion(obs_source_t *source, uint32_t x,
+				     uint32_t y, uint32_t cx, uint32_t cy)
 {
-	if (source->info.type != OBS_SOURCE_TYPE_FILTER &&
-	    (source->info.output_flags & OBS_SOURCE_VIDEO) == 0) {
-		if (source->filter_parent)
-			obs_source_skip_video_filter(source);
-		return;
-	}
-
-	if (source->info.type == OBS_SOURCE_TYPE_INPUT &&
-	    (source->info.output_flags & OBS_SOURCE_ASYNC) != 0 &&
-	    !source->rendering_filter) {
-		if (deinterlacing_enabled(source))
-			deinterlace_update_async_video(source);
-		obs_source_update_async_video(source);
-	}
+	struct gs_rect sub = {(int)x, (int)y, (int)cx, (int)cy};
 
-	if (!source->context.data || !source->enabled) {
-		if (source->filter_parent)
-			obs_source_skip_video_filter(source);
-		return;
-	}
+	if (source->filters.num || !source->context.data || !source->enabled)
+		return false;
+	if (!async_direct_ready(source) || !source->async_texrender_dirty ||
+	    gs_get_effect())
+		return false;
 
-	GS_DEBUG_MARKER_BEGIN_FORMAT(GS_DEBUG_COLOR_SOURCE,
-				     get_type_format(source->info.type),
-				     obs_source_get_name(source));
+	/* the region is mapped through the first plane, packed formats store
+	 * it at a different size than the frame */
+	if (gs_texture_get_width(source->async_textures[0]) !=
+		    source->async_width ||
+	    gs_texture_get_height(source->async_textures[0]) !=
+		    source->async_height)
+		return false;
 
-	if (source->filters.num && !source->rendering_filter)
-		obs_source_render_filters(source);
+	draw_async_planes(source, &sub);
+	return true;
+}
 
-	else if (source->info.video_render)
-		obs_source_main_render(source);
+uint64_t obs_source_get_gpu_time_ns(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_gpu_time_ns")
+		       ? (uint64_t)os_atomic_load_long_long(
+				 &source->gpu_time_ns)
+		       : 0;
+}
 
-	else if (source->filter_target)
-		obs_source_video_render(source->filter_target);
+static inline uint64_t load_perf(const volatile long long *val)
+{
+	return (uint64_t)os_atomic_load_long_long(val);
+}
 
-	else if (deinterlacing_enabled(source))
-		deinterlace_render(source);
+void obs_source_get_perf_stats(const obs_source_t *source,
+			       struct obs_source_perf_stats *stats)
+{
+	if (!stats)
+		return;
 
-	else
-		obs_source_render_async_video(source);
+	memset(stats, 0, sizeof(*stats));
+	if (!obs_source_valid(source, "obs_source_get_perf_stats"))
+		return;
 
-	GS_DEBUG_MARKER_END();
+	stats->tick_count = load_perf(&source->perf_tick.count);
+	stats->tick_ns = load_perf(&source->perf_tick.total_ns);
+	stats->render_count = load_perf(&source->perf_render.count);
+	stats->render_ns = load_perf(&source->perf_render.total_ns);
+	stats->audio_count = load_perf(&source->perf_audio.count);
+	stats->audio_ns = load_perf(&source->perf_audio.total_ns);
+	stats->gpu_ns = load_perf(&source->gpu_time_ns);
+	stats->skipped_renders = load_perf(&source->skipped_renders);
 }
 
-void obs_source_video_render(obs_source_t *source)
+void obs_source_get_memory_usage(const obs_source_t *source,
+				 struct obs_memory_usage *usage)
 {
-	if (!obs_source_valid(source, "obs_source_video_render"))
+	if (!obs_ptr_valid(usage, "obs_source_get_memory_usage"))
 		return;
 
-	obs_source_addref(source);
-	render_video(source);
-	obs_source_release(source);
+	memset(usage, 0, sizeof(*usage));
+	if (!obs_source_valid(source, "obs_source_get_memory_usage"))
+		return;
+
+	usage->system_bytes = obs_context_data_memory_usage(&source->context);
+	usage->gpu_bytes = obs_source_get_gpu_memory_usage(source);
 }
 
 static inline uint32_t get_async_width(const obs_source_t *source)
@@ -2458,9 +3377,11 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	bump_content_version(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
-	calldata_set_ptr(&cd, "source", source);
-	calldata_set_ptr(&cd, "filter", filter);
+	calldata_add_ptr(&cd, "source", source);
+	calldata_add_ptr(&cd, "filter", filter);
 
 	signal_handler_signal(source->context.signals, "filter_add", &cd);
 
@@ -2492,9 +3413,11 @@ static bool obs_source_filter_remove_refless(obs_source_t *source,
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	bump_content_version(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
-	calldata_set_ptr(&cd, "source", source);
-	calldata_set_ptr(&cd, "filter", filter);
+	calldata_add_ptr(&cd, "source", source);
+	calldata_add_ptr(&cd, "filter", filter);
 
 	signal_handler_signal(source->context.signals, "filter_remove", &cd);
 
@@ -2619,8 +3542,10 @@ void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
 	success = move_filter_dir(source, filter, movement);
 	pthread_mutex_unlock(&source->filter_mutex);
 
-	if (success)
+	if (success) {
+		bump_content_version(source);
 		obs_source_dosignal(source, NULL, "reorder_filters");
+	}
 }
 
 obs_data_t *obs_source_get_settings(const obs_source_t *source)
@@ -2646,8 +3571,12 @@ struct obs_source_frame *filter_async_video(obs_source_t *source,
 			continue;
 
 		if (filter->context.data && filter->info.filter_video) {
+			bmem_account_t *prev_account = bmem_set_thread_account(
+				filter->context.mem_account);
+
 			in = filter->info.filter_video(filter->context.data,
 						       in);
+			bmem_set_thread_account(prev_account);
 			if (!in)
 				break;
 		}
@@ -2699,12 +3628,14 @@ static void copy_frame_data(struct obs_source_frame *dst,
 
 	switch (src->format) {
 	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_I010:
 		copy_frame_data_plane(dst, src, 0, dst->height);
 		copy_frame_data_plane(dst, src, 1, dst->height / 2);
 		copy_frame_data_plane(dst, src, 2, dst->height / 2);
 		break;
 
 	case VIDEO_FORMAT_NV12:
+	case VIDEO_FORMAT_P010:
 		copy_frame_data_plane(dst, src, 0, dst->height);
 		copy_frame_data_plane(dst, src, 1, dst->height / 2);
 		break;
@@ -2726,6 +3657,7 @@ static void copy_frame_data(struct obs_source_frame *dst,
 	case VIDEO_FORMAT_Y800:
 	case VIDEO_FORMAT_BGR3:
 	case VIDEO_FORMAT_AYUV:
+	case VIDEO_FORMAT_V210:
 		copy_frame_data_plane(dst, src, 0, dst->height);
 		break;
 
@@ -2764,50 +3696,48 @@ static inline bool async_texture_changed(struct obs_source *source,
 	       source->async_cache_height != frame->height || prev != cur;
 }
 
+/* assumes async_output_mutex */
 static inline void free_async_cache(struct obs_source *source)
 {
 	for (size_t i = 0; i < source->async_cache.num; i++)
 		obs_source_frame_decref(source->async_cache.array[i].frame);
 
 	da_resize(source->async_cache, 0);
-	da_resize(source->async_frames, 0);
-	source->cur_async_frame = NULL;
-	source->prev_async_frame = NULL;
 }
 
 #define MAX_UNUSED_FRAME_DURATION 5
 
-/* frees frame allocations if they haven't been used for a specific period
- * of time */
+/* takes back the frames the graphics thread is done with, and frees frame
+ * allocations if they haven't been used for a specific period of time.
+ * assumes async_output_mutex */
 static void clean_cache(obs_source_t *source)
 {
+	struct obs_source_frame *frame;
+
 	for (size_t i = source->async_cache.num; i > 0; i--) {
 		struct async_frame *af = &source->async_cache.array[i - 1];
-		if (!af->used) {
-			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
-				obs_source_frame_destroy(af->frame);
-				da_erase(source->async_cache, i - 1);
-			}
+		if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
+			obs_source_frame_decref(af->frame);
+			da_erase(source->async_cache, i - 1);
+		}
+	}
+
+	while ((frame = spsc_ring_pop(&source->async_free)) != NULL) {
+		if (async_texture_changed(source, frame)) {
+			obs_source_frame_decref(frame);
+		} else {
+			struct async_frame af = {frame, 0};
+			da_push_back(source->async_cache, &af);
 		}
 	}
 }
 
-#define MAX_ASYNC_FRAMES 30
-//if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
+/* assumes async_output_mutex */
 static inline struct obs_source_frame *
 cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 {
 	struct obs_source_frame *new_frame = NULL;
 
-	pthread_mutex_lock(&source->async_mutex);
-
-	if (source->async_frames.num >= MAX_ASYNC_FRAMES) {
-		free_async_cache(source);
-		source->last_frame_ts = 0;
-		pthread_mutex_unlock(&source->async_mutex);
-		return NULL;
-	}
-
 	if (async_texture_changed(source, frame)) {
 		free_async_cache(source);
 		source->async_cache_width = frame->width;
@@ -2818,36 +3748,19 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 	source->async_cache_format = format;
 	source->async_cache_full_range = frame->full_range;
 
-	for (size_t i = 0; i < source->async_cache.num; i++) {
-		struct async_frame *af = &source->async_cache.array[i];
-		if (!af->used) {
-			new_frame = af->frame;
-			new_frame->format = format;
-			af->used = true;
-			af->unused_count = 0;
-			break;
-		}
-	}
-
 	clean_cache(source);
 
-	if (!new_frame) {
-		struct async_frame new_af;
-
-		new_frame = obs_source_frame_create(format, frame->width,
-						    frame->height);
-		new_af.frame = new_frame;
-		new_af.used = true;
-		new_af.unused_count = 0;
+	if (source->async_cache.num) {
+		size_t idx = source->async_cache.num - 1;
+		new_frame = source->async_cache.array[idx].frame;
+		new_frame->format = format;
+		da_pop_back(source->async_cache);
+	} else {
+		new_frame = async_frame_create(format, frame->width,
+					       frame->height);
 		new_frame->refs = 1;
-
-		da_push_back(source->async_cache, &new_af);
 	}
 
-	os_atomic_inc_long(&new_frame->refs);
-
-	pthread_mutex_unlock(&source->async_mutex);
-
 	copy_frame_data(new_frame, frame);
 
 	return new_frame;
@@ -2865,21 +3778,54 @@ obs_source_output_video_internal(obs_source_t *source,
 		return;
 	}
 
-	struct obs_source_frame *output = !!frame ? cache_video(source, frame)
-						  : NULL;
+	if (os_atomic_load_bool(&source->master_clock))
+		obs_master_clock_sample_source(source, frame->timestamp);
+
+	if (pthread_mutex_trylock(&source->async_output_mutex) != 0) {
+		os_atomic_inc_long(&source->async_contended);
+		pthread_mutex_lock(&source->async_output_mutex);
+	}
+
+	/* the frames cached for the source are its own */
+	bmem_account_t *prev_account =
+		bmem_set_thread_account(source->context.mem_account);
+	struct obs_source_frame *output = cache_video(source, frame);
+	bmem_set_thread_account(prev_account);
 
 	/* ------------------------------------------- */
-	pthread_mutex_lock(&source->async_mutex);
-	if (output) {
-		if (os_atomic_dec_long(&output->refs) == 0) {
-			obs_source_frame_destroy(output);
-			output = NULL;
-		} else {
-			da_push_back(source->async_frames, &output);
-			source->async_active = true;
-		}
+	if (spsc_ring_push(&source->async_queue, output)) {
+		os_atomic_inc_long(&source->async_frames_output);
+		source->async_active = true;
+	} else {
+		struct async_frame af = {output, 0};
+		da_push_back(source->async_cache, &af);
+
+		os_atomic_inc_long(&source->async_frames_dropped);
+		os_atomic_set_bool(&source->async_flush, true);
 	}
-	pthread_mutex_unlock(&source->async_mutex);
+
+	pthread_mutex_unlock(&source->async_output_mutex);
+}
+
+void obs_source_get_async_stats(const obs_source_t *source,
+				struct obs_source_async_stats *stats)
+{
+	if (!obs_ptr_valid(stats, "obs_source_get_async_stats"))
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (!obs_source_valid(source, "obs_source_get_async_stats"))
+		return;
+
+	stats->frames_output = (uint64_t)os_atomic_load_long(
+		&source->async_frames_output);
+	stats->frames_dropped = (uint64_t)os_atomic_load_long(
+		&source->async_frames_dropped);
+	stats->queue_flushes =
+		(uint64_t)os_atomic_load_long(&source->async_flushes);
+	stats->contended =
+		(uint64_t)os_atomic_load_long(&source->async_contended);
 }
 
 void obs_source_output_video(obs_source_t *source,
@@ -3083,7 +4029,7 @@ void obs_source_show_preloaded_video(obs_source_t *source)
 
 	pthread_mutex_lock(&source->audio_buf_mutex);
 	sys_ts = (source->monitoring_type != OBS_MONITORING_TYPE_MONITOR_ONLY)
-			 ? os_gettime_ns()
+			 ? obs_get_clock_ns()
 			 : 0;
 	reset_audio_timing(source, source->last_frame_ts, sys_ts);
 	reset_audio_data(source, sys_ts);
@@ -3177,8 +4123,15 @@ filter_async_audio(obs_source_t *source, struct obs_audio_data *in)
 			continue;
 
 		if (filter->context.data && filter->info.filter_audio) {
+			uint64_t start = os_gettime_ns();
+			bmem_account_t *prev_account = bmem_set_thread_account(
+				filter->context.mem_account);
+
 			in = filter->info.filter_audio(filter->context.data,
 						       in);
+			bmem_set_thread_account(prev_account);
+			obs_source_perf_add(&filter->perf_audio,
+					    os_gettime_ns() - start);
 			if (!in)
 				return NULL;
 		}
@@ -3342,51 +4295,194 @@ static void process_audio(obs_source_t *source,
 		downmix_to_mono_planar(source, frames);
 }
 
+struct queued_audio {
+	uint64_t timestamp;
+	uint64_t os_time;
+	uint32_t frames;
+};
+
+/* assumes filter_mutex */
+static inline bool has_audio_filters(obs_source_t *source)
+{
+	for (size_t i = 0; i < source->filters.num; i++) {
+		struct obs_source *filter = source->filters.array[i];
+		if (filter->enabled && filter->context.data &&
+		    filter->info.filter_audio)
+			return true;
+	}
+
+	return false;
+}
+
+/* filters are run by the audio thread's worker pool when it has one, so that
+ * the filters of sources pushing from the same thread (or of many sources at
+ * once) do not have to share a core.  only sources on the audio source list
+ * are drained by the audio thread, and submixes already output from inside it,
+ * so those are filtered right away */
+static inline bool can_queue_audio(obs_source_t *source)
+{
+	return obs->audio.pool.num_threads && source->prev_next_audio_source &&
+	       (source->info.output_flags & OBS_SOURCE_SUBMIX) == 0;
+}
+
+/* assumes audio_mutex */
+static void queue_audio(obs_source_t *source, uint64_t os_time)
+{
+	size_t planes = audio_output_get_planes(obs->audio.audio);
+	struct obs_audio_data *in = &source->audio_data;
+	size_t size = (size_t)in->frames * sizeof(float);
+	struct queued_audio header = {in->timestamp, os_time, in->frames};
+
+	/* same limit as the input buffers, in case the audio thread stalls */
+	if (source->audio_filter_queue.size + size * planes > MAX_BUF_SIZE) {
+		blog(LOG_DEBUG, "Dropping queued audio of source '%s'",
+		     obs_source_get_name(source));
+		circlebuf_free(&source->audio_filter_queue);
+	}
+
+	circlebuf_push_back(&source->audio_filter_queue, &header,
+			    sizeof(header));
+	for (size_t i = 0; i < planes; i++)
+		circlebuf_push_back(&source->audio_filter_queue, in->data[i],
+				    size);
+}
+
+/* assumes filter_mutex */
+static void filter_and_output_audio(obs_source_t *source,
+				    struct obs_audio_data *in, uint64_t os_time)
+{
+	struct obs_audio_data *output = filter_async_audio(source, in);
+
+	if (output) {
+		struct audio_data data;
+
+		for (int i = 0; i < MAX_AV_PLANES; i++)
+			data.data[i] = output->data[i];
+
+		data.frames = output->frames;
+		data.timestamp = output->timestamp;
+
+		pthread_mutex_lock(&source->audio_mutex);
+		source_output_audio_data(source, &data, os_time);
+		pthread_mutex_unlock(&source->audio_mutex);
+	}
+}
+
 void obs_source_output_audio(obs_source_t *source,
 			     const struct obs_source_audio *audio)
 {
-	struct obs_audio_data *output;
+	bmem_account_t *prev_account;
+	uint64_t os_time;
+	bool queued;
 
 	if (!obs_source_valid(source, "obs_source_output_audio"))
 		return;
 	if (!obs_ptr_valid(audio, "obs_source_output_audio"))
 		return;
 
+	prev_account = bmem_set_thread_account(source->context.mem_account);
 	process_audio(source, audio);
+	os_time = obs_get_clock_ns();
+
+	/* audio behind queued audio has to be queued as well to keep its
+	 * order, even if the filters have been removed in the meantime */
+	pthread_mutex_lock(&source->audio_mutex);
+	queued = source->audio_filter_queue.size != 0;
+	if (queued)
+		queue_audio(source, os_time);
+	pthread_mutex_unlock(&source->audio_mutex);
+
+	if (queued) {
+		bmem_set_thread_account(prev_account);
+		return;
+	}
 
 	pthread_mutex_lock(&source->filter_mutex);
-	output = filter_async_audio(source, &source->audio_data);
 
-	if (output) {
-		struct audio_data data;
+	if (can_queue_audio(source) && has_audio_filters(source)) {
+		pthread_mutex_lock(&source->audio_mutex);
+		queue_audio(source, os_time);
+		pthread_mutex_unlock(&source->audio_mutex);
+	} else {
+		filter_and_output_audio(source, &source->audio_data, os_time);
+	}
 
-		for (int i = 0; i < MAX_AV_PLANES; i++)
-			data.data[i] = output->data[i];
+	pthread_mutex_unlock(&source->filter_mutex);
+	bmem_set_thread_account(prev_account);
+}
 
-		data.frames = output->frames;
-		data.timestamp = output->timestamp;
+bool obs_source_audio_queued(obs_source_t *source)
+{
+	bool queued;
 
-		pthread_mutex_lock(&source->audio_mutex);
-		source_output_audio_data(source, &data);
+	pthread_mutex_lock(&source->audio_mutex);
+	queued = source->audio_filter_queue.size != 0;
+	pthread_mutex_unlock(&source->audio_mutex);
+
+	return queued;
+}
+
+static inline void ensure_filter_storage(obs_source_t *source, size_t planes,
+					 size_t size)
+{
+	if (source->audio_filter_storage_size >= size)
+		return;
+
+	for (size_t i = 0; i < planes; i++) {
+		bfree(source->audio_filter_data.data[i]);
+		source->audio_filter_data.data[i] = bmalloc(size);
+	}
+
+	source->audio_filter_storage_size = size;
+}
+
+/* runs the filters of the audio queued by obs_source_output_audio; called by
+ * the audio thread before it renders the sources */
+void obs_source_filter_queued_audio(obs_source_t *source)
+{
+	size_t planes = audio_output_get_planes(obs->audio.audio);
+	struct obs_audio_data *in = &source->audio_filter_data;
+	struct queued_audio header;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	pthread_mutex_lock(&source->audio_mutex);
+
+	while (source->audio_filter_queue.size) {
+		size_t size;
+
+		circlebuf_pop_front(&source->audio_filter_queue, &header,
+				    sizeof(header));
+
+		size = (size_t)header.frames * sizeof(float);
+		ensure_filter_storage(source, planes, size);
+
+		for (size_t i = 0; i < planes; i++)
+			circlebuf_pop_front(&source->audio_filter_queue,
+					    in->data[i], size);
+
+		in->frames = header.frames;
+		in->timestamp = header.timestamp;
+
+		/* the source may keep queueing while this is filtered */
 		pthread_mutex_unlock(&source->audio_mutex);
+		filter_and_output_audio(source, in, header.os_time);
+		pthread_mutex_lock(&source->audio_mutex);
 	}
 
+	pthread_mutex_unlock(&source->audio_mutex);
 	pthread_mutex_unlock(&source->filter_mutex);
 }
 
+/* hands the frame back for reuse, assumes async_mutex */
 void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 {
-	if (frame)
-		frame->prev_frame = false;
+	if (!frame)
+		return;
 
-	for (size_t i = 0; i < source->async_cache.num; i++) {
-		struct async_frame *f = &source->async_cache.array[i];
+	frame->prev_frame = false;
 
-		if (f->frame == frame) {
-			f->used = false;
-			break;
-		}
-	}
+	if (!spsc_ring_push(&source->async_free, frame))
+		obs_source_frame_decref(frame);
 }
 
 /* #define DEBUG_ASYNC_FRAMES 1 */
@@ -3534,12 +4630,12 @@ void obs_source_release_frame(obs_source_t *source,
 		return;
 
 	if (!source) {
-		obs_source_frame_destroy(frame);
+		async_frame_destroy(frame);
 	} else {
 		pthread_mutex_lock(&source->async_mutex);
 
 		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
+			async_frame_destroy(frame);
 		else
 			remove_async_frame(source, frame);
 
@@ -3562,13 +4658,14 @@ void obs_source_set_name(obs_source_t *source, const char *name)
 	if (!name || !*name || !source->context.name ||
 	    strcmp(name, source->context.name) != 0) {
 		struct calldata data;
+		uint8_t stack[256];
 		char *prev_name = bstrdup(source->context.name);
 		obs_context_data_setname(&source->context, name);
 
-		calldata_init(&data);
-		calldata_set_ptr(&data, "source", source);
-		calldata_set_string(&data, "new_name", source->context.name);
-		calldata_set_string(&data, "prev_name", prev_name);
+		calldata_init_stack(&data, stack, sizeof(stack));
+		calldata_add_ptr(&data, "source", source);
+		calldata_add_string(&data, "new_name", source->context.name);
+		calldata_add_string(&data, "prev_name", prev_name);
 		if (!source->context.private)
 			signal_handler_signal(obs->signals, "source_rename",
 					      &data);
@@ -3697,9 +4794,20 @@ bool obs_source_process_filter_begin(obs_source_t *filter,
 		return false;
 	}
 
+	obs_source_render_filter_input(filter, target, format, cx, cy);
+	return true;
+}
+
+void obs_source_render_filter_input(obs_source_t *filter, obs_source_t *target,
+				    enum gs_color_format format, uint32_t cx,
+				    uint32_t cy)
+{
+	obs_source_t *parent = filter->filter_parent;
+	uint32_t parent_flags = parent->info.output_flags;
+
 	if (!filter->filter_texrender)
 		filter->filter_texrender =
-			gs_texrender_create(format, GS_ZS_NONE);
+			gs_texrender_create_transient(format, GS_ZS_NONE);
 
 	gs_blend_state_push();
 	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
@@ -3722,7 +4830,6 @@ bool obs_source_process_filter_begin(obs_source_t *filter,
 	}
 
 	gs_blend_state_pop();
-	return true;
 }
 
 void obs_source_process_filter_tech_end(obs_source_t *filter,
@@ -3813,23 +4920,25 @@ proc_handler_t *obs_source_get_proc_handler(const obs_source_t *source)
 void obs_source_set_volume(obs_source_t *source, float volume)
 {
 	if (obs_source_valid(source, "obs_source_set_volume")) {
-		struct audio_action action = {.timestamp = os_gettime_ns(),
+		struct audio_action action = {.timestamp = obs_get_clock_ns(),
 					      .type = AUDIO_ACTION_VOL,
 					      .vol = volume};
 
 		struct calldata data;
 		uint8_t stack[128];
+		size_t volume_pos;
 
 		calldata_init_fixed(&data, stack, sizeof(stack));
-		calldata_set_ptr(&data, "source", source);
-		calldata_set_float(&data, "volume", volume);
+		calldata_add_ptr(&data, "source", source);
+		volume_pos = calldata_add_float(&data, "volume", volume);
 
-		signal_handler_signal(source->context.signals, "volume", &data);
+		signal_handler_signal_handle(source->context.signals,
+					     source->volume_signal, &data);
 		if (!source->context.private)
 			signal_handler_signal(obs->signals, "source_volume",
 					      &data);
 
-		volume = (float)calldata_float(&data, "volume");
+		volume = (float)calldata_float_at(&data, volume_pos);
 
 		pthread_mutex_lock(&source->audio_actions_mutex);
 		da_push_back(source->audio_actions, &action);
@@ -3851,15 +4960,16 @@ void obs_source_set_sync_offset(obs_source_t *source, int64_t offset)
 	if (obs_source_valid(source, "obs_source_set_sync_offset")) {
 		struct calldata data;
 		uint8_t stack[128];
+		size_t offset_pos;
 
 		calldata_init_fixed(&data, stack, sizeof(stack));
-		calldata_set_ptr(&data, "source", source);
-		calldata_set_int(&data, "offset", offset);
+		calldata_add_ptr(&data, "source", source);
+		offset_pos = calldata_add_int(&data, "offset", offset);
 
 		signal_handler_signal(source->context.signals, "audio_sync",
 				      &data);
 
-		source->sync_offset = calldata_int(&data, "offset");
+		source->sync_offset = calldata_int_at(&data, offset_pos);
 	}
 }
 
@@ -4042,6 +5152,11 @@ bool obs_source_add_active_child(obs_source_t *parent, obs_source_t *child)
 		obs_source_activate(child, type);
 	}
 
+	for (long i = 0; i < parent->warm_refs; i++) {
+		warm_tree(parent, child, NULL);
+		obs_source_enum_active_tree(child, warm_tree, NULL);
+	}
+
 	return true;
 }
 
@@ -4057,10 +5172,18 @@ void obs_source_remove_active_child(obs_source_t *parent, obs_source_t *child)
 		type = (i < parent->activate_refs) ? MAIN_VIEW : AUX_VIEW;
 		obs_source_deactivate(child, type);
 	}
+
+	for (long i = 0; i < parent->warm_refs; i++) {
+		cool_tree(parent, child, NULL);
+		obs_source_enum_active_tree(child, cool_tree, NULL);
+	}
 }
 
 void obs_source_save(obs_source_t *source)
 {
+	/* nothing but the settings to save until created */
+	if (obs_source_deferred(source))
+		return;
 	if (!data_valid(source, "obs_source_save"))
 		return;
 
@@ -4073,13 +5196,14 @@ void obs_source_save(obs_source_t *source)
 
 void obs_source_load(obs_source_t *source)
 {
+	if (obs_source_deferred(source)) {
+		source->load_pending = true;
+		return;
+	}
 	if (!data_valid(source, "obs_source_load"))
 		return;
-	if (source->info.load)
-		source->info.load(source->context.data,
-				  source->context.settings);
 
-	obs_source_dosignal(source, "source_load", "load");
+	load_source(source);
 }
 
 bool obs_source_active(const obs_source_t *source)
@@ -4102,8 +5226,8 @@ static inline void signal_flags_updated(obs_source_t *source)
 	uint8_t stack[128];
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
-	calldata_set_ptr(&data, "source", source);
-	calldata_set_int(&data, "flags", source->flags);
+	calldata_add_ptr(&data, "source", source);
+	calldata_add_int(&data, "flags", source->flags);
 
 	signal_handler_signal(source->context.signals, "update_flags", &data);
 }
@@ -4137,6 +5261,7 @@ void obs_source_set_audio_mixers(obs_source_t *source, uint32_t mixers)
 {
 	struct calldata data;
 	uint8_t stack[128];
+	size_t mixers_pos;
 
 	if (!obs_source_valid(source, "obs_source_set_audio_mixers"))
 		return;
@@ -4147,12 +5272,12 @@ void obs_source_set_audio_mixers(obs_source_t *source, uint32_t mixers)
 		return;
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
-	calldata_set_ptr(&data, "source", source);
-	calldata_set_int(&data, "mixers", mixers);
+	calldata_add_ptr(&data, "source", source);
+	mixers_pos = calldata_add_int(&data, "mixers", mixers);
 
 	signal_handler_signal(source->context.signals, "audio_mixers", &data);
 
-	mixers = (uint32_t)calldata_int(&data, "mixers");
+	mixers = (uint32_t)calldata_int_at(&data, mixers_pos);
 
 	source->audio_mixers = mixers;
 }
@@ -4266,6 +5391,55 @@ void obs_source_dec_active(obs_source_t *source)
 		obs_source_deactivate(source, MAIN_VIEW);
 }
 
+bool obs_source_inc_warm(obs_source_t *source)
+{
+	long limit;
+
+	if (!obs_source_valid(source, "obs_source_inc_warm"))
+		return false;
+
+	limit = os_atomic_load_long(&obs->data.warm_source_limit);
+	if (limit > 0) {
+		long cost = os_atomic_load_long(&source->warm_refs) ? 0 : 1;
+
+		obs_source_enum_active_tree(source, count_cold_tree, &cost);
+		if (os_atomic_load_long(&obs->data.warm_sources) + cost > limit)
+			return false;
+	}
+
+	warm_tree(NULL, source, NULL);
+	obs_source_enum_active_tree(source, warm_tree, NULL);
+	return true;
+}
+
+void obs_source_dec_warm(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_dec_warm"))
+		return;
+
+	if (os_atomic_load_long(&source->warm_refs) > 0) {
+		cool_tree(NULL, source, NULL);
+		obs_source_enum_active_tree(source, cool_tree, NULL);
+	}
+}
+
+bool obs_source_warm(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_warm")
+		       ? source->warm_refs != 0 && source->activate_refs == 0
+		       : false;
+}
+
+void obs_set_warm_source_limit(size_t limit)
+{
+	os_atomic_set_long(&obs->data.warm_source_limit, (long)limit);
+}
+
+size_t obs_get_warm_source_limit(void)
+{
+	return (size_t)os_atomic_load_long(&obs->data.warm_source_limit);
+}
+
 void obs_source_enum_filters(obs_source_t *source,
 			     obs_source_enum_proc_t callback, void *param)
 {
@@ -4325,10 +5499,11 @@ void obs_source_set_enabled(obs_source_t *source, bool enabled)
 		return;
 
 	source->enabled = enabled;
+	bump_content_version(source);
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
-	calldata_set_ptr(&data, "source", source);
-	calldata_set_bool(&data, "enabled", enabled);
+	calldata_add_ptr(&data, "source", source);
+	calldata_add_bool(&data, "enabled", enabled);
 
 	signal_handler_signal(source->context.signals, "enable", &data);
 }
@@ -4343,7 +5518,7 @@ void obs_source_set_muted(obs_source_t *source, bool muted)
 {
 	struct calldata data;
 	uint8_t stack[128];
-	struct audio_action action = {.timestamp = os_gettime_ns(),
+	struct audio_action action = {.timestamp = obs_get_clock_ns(),
 				      .type = AUDIO_ACTION_MUTE,
 				      .set = muted};
 
@@ -4353,8 +5528,8 @@ void obs_source_set_muted(obs_source_t *source, bool muted)
 	source->user_muted = muted;
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
-	calldata_set_ptr(&data, "source", source);
-	calldata_set_bool(&data, "muted", muted);
+	calldata_add_ptr(&data, "source", source);
+	calldata_add_bool(&data, "muted", muted);
 
 	signal_handler_signal(source->context.signals, "mute", &data);
 
@@ -4370,8 +5545,8 @@ static void source_signal_push_to_changed(obs_source_t *source,
 	uint8_t stack[128];
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
-	calldata_set_ptr(&data, "source", source);
-	calldata_set_bool(&data, "enabled", enabled);
+	calldata_add_ptr(&data, "source", source);
+	calldata_add_bool(&data, "enabled", enabled);
 
 	signal_handler_signal(source->context.signals, signal, &data);
 }
@@ -4383,8 +5558,8 @@ static void source_signal_push_to_delay(obs_source_t *source,
 	uint8_t stack[128];
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
-	calldata_set_ptr(&data, "source", source);
-	calldata_set_bool(&data, "delay", delay);
+	calldata_add_ptr(&data, "source", source);
+	calldata_add_bool(&data, "delay", delay);
 
 	signal_handler_signal(source->context.signals, signal, &data);
 }
@@ -4542,24 +5717,16 @@ static float get_source_volume(obs_source_t *source, uint64_t os_time)
 static inline void multiply_output_audio(obs_source_t *source, size_t mix,
 					 size_t channels, float vol)
 {
-	register float *out = source->audio_output_buf[mix][0];
-	register float *end = out + AUDIO_OUTPUT_FRAMES * channels;
-
-	while (out < end)
-		*(out++) *= vol;
+	audio_mix_scale(source->audio_output_buf[mix][0], vol,
+			AUDIO_OUTPUT_FRAMES * channels);
 }
 
 static inline void multiply_vol_data(obs_source_t *source, size_t mix,
 				     size_t channels, float *vol_data)
 {
-	for (size_t ch = 0; ch < channels; ch++) {
-		register float *out = source->audio_output_buf[mix][ch];
-		register float *end = out + AUDIO_OUTPUT_FRAMES;
-		register float *vol = vol_data;
-
-		while (out < end)
-			*(out++) *= *(vol++);
-	}
+	for (size_t ch = 0; ch < channels; ch++)
+		audio_mix_mul(source->audio_output_buf[mix][ch], vol_data,
+			      AUDIO_OUTPUT_FRAMES);
 }
 
 static inline void apply_audio_action(obs_source_t *source,
@@ -4634,6 +5801,8 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 	bool actions_pending;
 	float vol;
 
+	source->audio_silent = false;
+
 	pthread_mutex_lock(&source->audio_actions_mutex);
 
 	actions_pending = source->audio_actions.num > 0;
@@ -4660,6 +5829,7 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 		memset(source->audio_output_buf[0][0], 0,
 		       AUDIO_OUTPUT_FRAMES * sizeof(float) *
 			       MAX_AUDIO_CHANNELS * MAX_AUDIO_MIXES);
+		source->audio_silent = true;
 		return;
 	}
 
@@ -4802,8 +5972,8 @@ static inline void process_audio_source_tick(obs_source_t *source,
 	source->audio_pending = false;
 }
 
-void obs_source_audio_render(obs_source_t *source, uint32_t mixers,
-			     size_t channels, size_t sample_rate, size_t size)
+static void audio_render(obs_source_t *source, uint32_t mixers,
+			 size_t channels, size_t sample_rate, size_t size)
 {
 	if (!source->audio_output_buf[0][0]) {
 		source->audio_pending = true;
@@ -4831,6 +6001,15 @@ void obs_source_audio_render(obs_source_t *source, uint32_t mixers,
 	process_audio_source_tick(source, mixers, channels, sample_rate, size);
 }
 
+void obs_source_audio_render(obs_source_t *source, uint32_t mixers,
+			     size_t channels, size_t sample_rate, size_t size)
+{
+	uint64_t start = os_gettime_ns();
+
+	audio_render(source, mixers, channels, sample_rate, size);
+	obs_source_perf_add(&source->perf_audio, os_gettime_ns() - start);
+}
+
 bool obs_source_audio_pending(const obs_source_t *source)
 {
 	if (!obs_source_valid(source, "obs_source_audio_pending"))
@@ -191,6 +191,35 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_CEA_708 (1 << 14)
 
+/**
+ * Source type's video_tick callback is thread safe.
+ *
+ * The video_tick callback may be called from a libobs worker thread,
+ * concurrently with the ticks of other sources, but never concurrently with
+ * itself or this source's own video_render.  The worker threads have no
+ * graphics context, so the tick must not call any gs_* functions.
+ */
+#define OBS_SOURCE_PARALLEL_TICK (1 << 15)
+
+/**
+ * Source type's video output only changes when its settings are updated or
+ * when it calls obs_source_content_changed.
+ *
+ * Scenes can then keep the rendered output of the source in a texture and
+ * only render the source again when its content version changes.  Async
+ * video sources should not use this flag.
+ */
+#define OBS_SOURCE_CACHEABLE_VIDEO (1 << 16)
+
+/**
+ * Source type can render its video at a reduced resolution.
+ *
+ * Scene items then tell the source the largest size it is drawn at, see
+ * set_size_hint.  The source keeps reporting its full width and height and
+ * draws a lower resolution render stretched to that size.
+ */
+#define OBS_SOURCE_SIZE_HINT (1 << 17)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -200,6 +229,44 @@ struct obs_source_audio_mix {
 	struct audio_output_data output[MAX_AUDIO_MIXES];
 };
 
+/**
+ * @name Filter fusion flags
+ * @{
+ */
+
+/**
+ * The fusion code samples the input texture around the pixel, so the filter
+ * can only be fused as the first filter applied to the input.
+ */
+#define OBS_FUSION_SAMPLES_INPUT (1 << 0)
+
+/**
+ * The filter is drawn with linear sRGB enabled (see gs_set_linear_srgb).
+ * Only filters that agree on this flag are fused.
+ */
+#define OBS_FUSION_LINEAR_SRGB (1 << 1)
+
+/** @} */
+
+/**
+ * Describes a filter that can be drawn in the same pass as adjacent fusable
+ * filters of the same source, instead of to its own render target.
+ *
+ * The code declares the filter's uniforms and the function
+ *
+ *     float4 $process(float4 rgba, float2 uv)
+ *
+ * which returns the filtered color of the pixel at uv given its input color.
+ * Every '$' is replaced with a prefix that is unique within the fused effect.
+ * The input texture is declared as 'image'; code that samples it must set
+ * OBS_FUSION_SAMPLES_INPUT.  Fusable filters must not change the size of
+ * their input.
+ */
+struct obs_filter_fusion {
+	const char *code;
+	uint32_t flags;
+};
+
 /**
  * Source definition structure
  */
@@ -535,6 +602,66 @@ struct obs_source_info {
 
 	/** Missing files **/
 	obs_missing_files_t *(*missing_files)(void *data);
+
+	/**
+	 * Describes the filter for fusion with adjacent filters, see struct
+	 * obs_filter_fusion.  Called each time before the filter is rendered.
+	 *
+	 * @param       data    Filter data
+	 * @param[out]  fusion  Fusion description of the filter
+	 * @return              false to render the filter normally
+	 */
+	bool (*filter_get_fusion)(void *data, struct obs_filter_fusion *fusion);
+
+	/**
+	 * Called instead of video_render when the filter is drawn as part of
+	 * a fused pass, to set the uniforms declared by its fusion code.
+	 *
+	 * @param  data  Filter data
+	 * @param  pass  Fused pass, see obs_fusion_pass_get_param
+	 */
+	void (*filter_fusion_render)(void *data, obs_fusion_pass_t *pass);
+
+	/**
+	 * Called on the graphics thread before video_tick when the largest
+	 * size the source is drawn at in scenes changes, if the source type
+	 * has the OBS_SOURCE_SIZE_HINT flag.  The size is 0x0 when no scene
+	 * item has drawn the source for a second, in which case the source
+	 * should render at its full size.
+	 *
+	 * @param  data  Source data
+	 * @param  cx    Width the source is drawn at on the canvas
+	 * @param  cy    Height the source is drawn at on the canvas
+	 */
+	void (*set_size_hint)(void *data, uint32_t cx, uint32_t cy);
+
+	/**
+	 * Returns a texture holding what video_render draws, at the size of
+	 * the source, for draws that only need to sample it.  Only return one
+	 * if drawing it with the default effect gives the same output as
+	 * video_render.
+	 *
+	 * @param  data  Source data
+	 * @return       The texture, or NULL to be rendered with video_render
+	 */
+	gs_texture_t *(*video_get_texture)(void *data);
+
+	/**
+	 * Called when the source becomes warm, see obs_source_inc_warm.  The
+	 * source is likely to be activated soon, and can prepare for it by
+	 * opening files or devices, but should not play or output audio.
+	 *
+	 * @param  data  Source data
+	 */
+	void (*warm)(void *data);
+
+	/**
+	 * Called when the source stops being warm, either because it has
+	 * been activated or because it is no longer expected to be.
+	 *
+	 * @param  data  Source data
+	 */
+	void (*cool)(void *data);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
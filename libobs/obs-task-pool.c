@@ -0,0 +1,387 @@
+#include "util/platform.h"
+#include "obs-internal.h"
+
+/*
+ * Shared worker pool.
+ *
+ * Tasks queued from outside the pool go to one queue per priority.  Normal
+ * priority tasks queued by a task that already runs on a worker go to the
+ * queue of that worker instead, which it works through newest first while
+ * idle workers steal the oldest ones, so work forked by a task mostly stays
+ * on the same thread.
+ *
+ * Waiting on a group runs the queued tasks of that group on the waiting
+ * thread, so a task can fork and join without tying up a second worker, and
+ * a group always finishes even when every worker is busy.
+ *
+ * Entries taken from the middle of a queue are only cleared, and skipped
+ * once they reach the end they are popped from.
+ */
+
+#define MAX_POOL_THREADS 16
+
+struct obs_task_group {
+	pthread_mutex_t mutex;
+	os_event_t *done_event;
+	long pending;
+	volatile bool canceled;
+};
+
+static THREAD_LOCAL struct obs_task_worker *cur_worker = NULL;
+
+static inline struct obs_task_pool *get_pool(void)
+{
+	return obs && obs->task_pool.num_workers ? &obs->task_pool : NULL;
+}
+
+static void finish_task(struct obs_task_group *group)
+{
+	pthread_mutex_lock(&group->mutex);
+	if (--group->pending == 0)
+		os_event_signal(group->done_event);
+	pthread_mutex_unlock(&group->mutex);
+}
+
+static void run_task(struct obs_pool_task *task)
+{
+	struct obs_task_group *group = task->group;
+
+	if (!group || !os_atomic_load_bool(&group->canceled))
+		task->task(task->param);
+	if (group)
+		finish_task(group);
+}
+
+/* assumes the lock of the queue */
+static bool take_task(struct circlebuf *queue, bool newest,
+		      struct obs_task_group *group, struct obs_pool_task *out)
+{
+	if (!group) {
+		while (queue->size) {
+			if (newest)
+				circlebuf_pop_back(queue, out, sizeof(*out));
+			else
+				circlebuf_pop_front(queue, out, sizeof(*out));
+			if (out->task)
+				return true;
+		}
+		return false;
+	}
+
+	for (size_t i = 0; i < queue->size; i += sizeof(*out)) {
+		struct obs_pool_task *entry = circlebuf_data(queue, i);
+		if (entry->task && entry->group == group) {
+			*out = *entry;
+			entry->task = NULL;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool take_global(struct obs_task_pool *pool,
+			enum obs_task_priority priority,
+			struct obs_task_group *group, struct obs_pool_task *out)
+{
+	bool found;
+
+	pthread_mutex_lock(&pool->mutex);
+	found = take_task(&pool->queues[priority], false, group, out);
+	pthread_mutex_unlock(&pool->mutex);
+	return found;
+}
+
+static bool take_local(struct obs_task_worker *worker, bool newest,
+		       struct obs_task_group *group, struct obs_pool_task *out)
+{
+	bool found;
+
+	pthread_mutex_lock(&worker->mutex);
+	found = take_task(&worker->tasks, newest, group, out);
+	pthread_mutex_unlock(&worker->mutex);
+	return found;
+}
+
+static bool find_task(struct obs_task_pool *pool, struct obs_task_worker *self,
+		      struct obs_task_group *group, struct obs_pool_task *out)
+{
+	if (take_global(pool, OBS_TASK_PRIORITY_HIGH, group, out))
+		return true;
+	if (self && take_local(self, true, group, out))
+		return true;
+	if (take_global(pool, OBS_TASK_PRIORITY_NORMAL, group, out))
+		return true;
+
+	for (size_t i = 0; i < pool->num_workers; i++) {
+		struct obs_task_worker *worker = &pool->workers[i];
+		if (worker != self && take_local(worker, false, group, out))
+			return true;
+	}
+
+	return take_global(pool, OBS_TASK_PRIORITY_LOW, group, out);
+}
+
+static void *task_worker_thread(void *param)
+{
+	struct obs_task_worker *worker = param;
+	struct obs_task_pool *pool = worker->pool;
+
+	os_set_thread_name("libobs: task worker");
+	cur_worker = worker;
+
+	/* every queued task posts the semaphore once, so there are never more
+	 * queued tasks than posts, only sometimes fewer when another thread
+	 * took a task while waiting for its group */
+	while (os_sem_wait(pool->sem) == 0) {
+		struct obs_pool_task task;
+
+		if (os_atomic_load_bool(&pool->stop))
+			break;
+		if (find_task(pool, worker, NULL, &task))
+			run_task(&task);
+	}
+
+	cur_worker = NULL;
+	return NULL;
+}
+
+bool obs_task_pool_init(struct obs_task_pool *pool)
+{
+	int cores = os_get_logical_cores();
+	size_t num_threads = cores > 1 ? (size_t)cores - 1 : 1;
+
+	memset(pool, 0, sizeof(*pool));
+
+	if (num_threads > MAX_POOL_THREADS)
+		num_threads = MAX_POOL_THREADS;
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&pool->sem, 0) != 0) {
+		pthread_mutex_destroy(&pool->mutex);
+		return false;
+	}
+
+	pool->workers = bzalloc(sizeof(struct obs_task_worker) * num_threads);
+
+	for (size_t i = 0; i < num_threads; i++) {
+		struct obs_task_worker *worker = &pool->workers[i];
+
+		worker->pool = pool;
+		if (pthread_mutex_init(&worker->mutex, NULL) != 0)
+			break;
+		if (pthread_create(&worker->thread, NULL, task_worker_thread,
+				   worker) != 0) {
+			pthread_mutex_destroy(&worker->mutex);
+			blog(LOG_WARNING, "Failed to create task worker %zu",
+			     i);
+			break;
+		}
+		pool->num_workers++;
+	}
+
+	pool->initialized = true;
+
+	if (!pool->num_workers) {
+		obs_task_pool_free(pool);
+		return false;
+	}
+
+	blog(LOG_DEBUG, "Task pool: %zu worker threads", pool->num_workers);
+	return true;
+}
+
+static void drop_tasks(struct circlebuf *queue)
+{
+	struct obs_pool_task task;
+
+	while (take_task(queue, false, NULL, &task)) {
+		if (task.group)
+			finish_task(task.group);
+	}
+
+	circlebuf_free(queue);
+}
+
+void obs_task_pool_free(struct obs_task_pool *pool)
+{
+	size_t num_workers = pool->num_workers;
+
+	if (!pool->initialized)
+		return;
+
+	/* from here on, tasks run on the thread that queues them */
+	pool->num_workers = 0;
+
+	os_atomic_store_bool(&pool->stop, true);
+	for (size_t i = 0; i < num_workers; i++)
+		os_sem_post(pool->sem);
+	for (size_t i = 0; i < num_workers; i++)
+		pthread_join(pool->workers[i].thread, NULL);
+
+	for (size_t i = 0; i < num_workers; i++) {
+		drop_tasks(&pool->workers[i].tasks);
+		pthread_mutex_destroy(&pool->workers[i].mutex);
+	}
+	for (size_t i = 0; i < OBS_TASK_PRIORITIES; i++)
+		drop_tasks(&pool->queues[i]);
+
+	bfree(pool->workers);
+	os_sem_destroy(pool->sem);
+	pthread_mutex_destroy(&pool->mutex);
+	memset(pool, 0, sizeof(*pool));
+}
+
+/* ------------------------------------------------------------------------- */
+
+size_t obs_get_pool_threads(void)
+{
+	struct obs_task_pool *pool = get_pool();
+	return pool ? pool->num_workers : 0;
+}
+
+obs_task_group_t *obs_task_group_create(void)
+{
+	struct obs_task_group *group = bzalloc(sizeof(struct obs_task_group));
+
+	if (pthread_mutex_init(&group->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (os_event_init(&group->done_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail_event;
+
+	os_event_signal(group->done_event);
+	return group;
+
+fail_event:
+	pthread_mutex_destroy(&group->mutex);
+fail_mutex:
+	bfree(group);
+	return NULL;
+}
+
+void obs_task_group_destroy(obs_task_group_t *group)
+{
+	if (!group)
+		return;
+
+	obs_task_group_wait(group);
+
+	os_event_destroy(group->done_event);
+	pthread_mutex_destroy(&group->mutex);
+	bfree(group);
+}
+
+static void queue_task(struct obs_task_pool *pool,
+		       enum obs_task_priority priority,
+		       struct obs_pool_task *task)
+{
+	struct obs_task_worker *worker = cur_worker;
+
+	if (worker && worker->pool == pool &&
+	    priority == OBS_TASK_PRIORITY_NORMAL) {
+		pthread_mutex_lock(&worker->mutex);
+		circlebuf_push_back(&worker->tasks, task, sizeof(*task));
+		pthread_mutex_unlock(&worker->mutex);
+	} else {
+		pthread_mutex_lock(&pool->mutex);
+		circlebuf_push_back(&pool->queues[priority], task,
+				    sizeof(*task));
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	os_sem_post(pool->sem);
+}
+
+void obs_task_group_queue(obs_task_group_t *group,
+			  enum obs_task_priority priority, obs_task_t task,
+			  void *param)
+{
+	struct obs_task_pool *pool = get_pool();
+	struct obs_pool_task pool_task = {task, param, group};
+
+	if (!obs_ptr_valid(task, "obs_task_group_queue"))
+		return;
+
+	if (priority < OBS_TASK_PRIORITY_LOW ||
+	    priority > OBS_TASK_PRIORITY_HIGH)
+		priority = OBS_TASK_PRIORITY_NORMAL;
+
+	if (!pool) {
+		if (!group || !os_atomic_load_bool(&group->canceled))
+			task(param);
+		return;
+	}
+
+	if (group) {
+		pthread_mutex_lock(&group->mutex);
+		if (group->canceled) {
+			pthread_mutex_unlock(&group->mutex);
+			return;
+		}
+		if (group->pending++ == 0)
+			os_event_reset(group->done_event);
+		pthread_mutex_unlock(&group->mutex);
+	}
+
+	queue_task(pool, priority, &pool_task);
+}
+
+void obs_queue_pool_task(enum obs_task_priority priority, obs_task_t task,
+			 void *param)
+{
+	obs_task_group_queue(NULL, priority, task, param);
+}
+
+static inline bool group_done(struct obs_task_group *group)
+{
+	bool done;
+
+	pthread_mutex_lock(&group->mutex);
+	done = group->pending == 0;
+	pthread_mutex_unlock(&group->mutex);
+	return done;
+}
+
+void obs_task_group_wait(obs_task_group_t *group)
+{
+	struct obs_task_pool *pool = get_pool();
+
+	if (!obs_ptr_valid(group, "obs_task_group_wait"))
+		return;
+
+	while (!group_done(group)) {
+		struct obs_pool_task task;
+
+		if (pool && find_task(pool, cur_worker, group, &task))
+			run_task(&task);
+		else
+			os_event_wait(group->done_event);
+	}
+}
+
+/* drops the queued tasks of the group and has running tasks that check
+ * obs_task_group_canceled stop early */
+void obs_task_group_cancel(obs_task_group_t *group)
+{
+	struct obs_task_pool *pool = get_pool();
+	struct obs_pool_task task;
+
+	if (!obs_ptr_valid(group, "obs_task_group_cancel"))
+		return;
+
+	pthread_mutex_lock(&group->mutex);
+	os_atomic_set_bool(&group->canceled, true);
+	pthread_mutex_unlock(&group->mutex);
+
+	if (!pool)
+		return;
+
+	while (find_task(pool, NULL, group, &task))
+		finish_task(group);
+}
+
+bool obs_task_group_canceled(const obs_task_group_t *group)
+{
+	return group ? os_atomic_load_bool(&group->canceled) : false;
+}
@@ -0,0 +1,89 @@
+#include "util/platform.h"
+#include "obs-internal.h"
+
+static inline void release_sources(struct obs_tick_pool *pool)
+{
+	for (size_t i = 0; i < pool->sources.num; i++)
+		obs_source_release(pool->sources.array[i]);
+	da_resize(pool->sources, 0);
+}
+
+/* each thread claims the next unticked source until the list is drained, so
+ * a slow tick on one thread never holds up the rest of the batch */
+static void run_ticks(struct obs_tick_pool *pool)
+{
+	const long count = (long)pool->sources.num;
+	const float seconds = pool->seconds;
+
+	for (;;) {
+		long idx = os_atomic_inc_long(&pool->next_source) - 1;
+		if (idx >= count)
+			break;
+
+		obs_source_t *source = pool->sources.array[idx];
+		obs_source_call_video_tick(source, seconds);
+	}
+}
+
+static void tick_task(void *param)
+{
+	run_ticks(param);
+}
+
+bool obs_tick_pool_init(struct obs_tick_pool *pool)
+{
+	memset(pool, 0, sizeof(*pool));
+
+	pool->num_threads = obs_get_pool_threads();
+	if (!pool->num_threads)
+		return true;
+
+	pool->group = obs_task_group_create();
+	if (!pool->group) {
+		pool->num_threads = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void obs_tick_pool_free(struct obs_tick_pool *pool)
+{
+	obs_task_group_destroy(pool->group);
+
+	release_sources(pool);
+	da_free(pool->sources);
+	memset(pool, 0, sizeof(*pool));
+}
+
+/* ticks every queued source and releases the queued references; returns once
+ * all ticks have finished */
+void obs_tick_pool_run(struct obs_tick_pool *pool, float seconds)
+{
+	size_t count = pool->sources.num;
+	size_t helpers = 0;
+
+	if (!count)
+		return;
+
+	pool->seconds = seconds;
+	os_atomic_store_long(&pool->next_source, 0);
+
+	/* the calling thread takes a share of the work too */
+	if (count > 1)
+		helpers = count - 1 < pool->num_threads ? count - 1
+							: pool->num_threads;
+
+	for (size_t i = 0; i < helpers; i++)
+		obs_task_group_queue(pool->group, OBS_TASK_PRIORITY_HIGH,
+				     tick_task, pool);
+
+	run_ticks(pool);
+
+	/* every helper has to be done before the list is reused, even if it
+	 * started too late to find any work */
+	if (helpers)
+		obs_task_group_wait(pool->group);
+
+	release_sources(pool);
+}
@@ -17,17 +17,17 @@
 
 #include "obs-internal.h"
 
-static void *gpu_encode_thread(void *unused)
+static void *gpu_encode_thread(void *data)
 {
-	struct obs_core_video *video = &obs->video;
-	uint64_t interval = video_output_get_frame_time(obs->video.video);
+	struct obs_core_video_mix *video = data;
+	uint64_t interval = video_output_get_frame_time(video->video);
 	DARRAY(obs_encoder_t *) encoders;
 	int wait_frames = NUM_ENCODE_TEXTURE_FRAMES_TO_WAIT;
 
-	UNUSED_PARAMETER(unused);
 	da_init(encoders);
 
 	os_set_thread_name("obs gpu encode thread");
+	bmem_set_thread_tag(obs->encoder_mem_tag);
 
 	while (os_sem_wait(video->gpu_encode_semaphore) == 0) {
 		struct obs_tex_frame tf;
@@ -98,10 +98,27 @@ static void *gpu_encode_thread(void *unused)
 			else
 				next_key++;
 
-			success = encoder->info.encode_texture(
-				encoder->context.data, tf.handle,
-				encoder->cur_pts, lock_key, &next_key, &pkt,
-				&received);
+			uint64_t encode_start = os_gettime_ns();
+
+			if (encoder->info.encode_texture2) {
+				struct encoder_texture tex = {0};
+
+				tex.handle = tf.handle;
+				tex.tex[0] = tf.tex;
+				tex.tex[1] = tf.tex_uv;
+
+				success = encoder->info.encode_texture2(
+					encoder->context.data, &tex,
+					encoder->cur_pts, lock_key, &next_key,
+					&pkt, &received);
+			} else {
+				success = encoder->info.encode_texture(
+					encoder->context.data, tf.handle,
+					encoder->cur_pts, lock_key, &next_key,
+					&pkt, &received);
+			}
+			obs_histogram_observe(&encoder->encode_hist,
+					      os_gettime_ns() - encode_start);
 			send_off_encoder_packet(encoder, success, received,
 						&pkt);
 
@@ -143,10 +160,12 @@ static void *gpu_encode_thread(void *unused)
 	return NULL;
 }
 
-bool init_gpu_encoding(struct obs_core_video *video)
+bool init_gpu_encoding(struct obs_core_video_mix *video)
 {
-#ifdef _WIN32
 	struct obs_video_info *ovi = &video->ovi;
+#ifndef _WIN32
+	const bool p010 = ovi->output_format == VIDEO_FORMAT_P010;
+#endif
 
 	video->gpu_encode_stop = false;
 
@@ -155,14 +174,35 @@ bool init_gpu_encoding(struct obs_core_video *video)
 		gs_texture_t *tex;
 		gs_texture_t *tex_uv;
 
+#ifdef _WIN32
 		gs_texture_create_nv12(&tex, &tex_uv, ovi->output_width,
 				       ovi->output_height,
 				       GS_RENDER_TARGET | GS_SHARED_KM_TEX);
+#else
+		/* no shared NV12 textures here, so allocate the planes the
+		 * same way the GPU conversion does to allow swapping them */
+		tex = gs_texture_create(ovi->output_width, ovi->output_height,
+					p010 ? GS_R16 : GS_R8, 1, NULL,
+					GS_RENDER_TARGET);
+		tex_uv = gs_texture_create(ovi->output_width / 2,
+					   ovi->output_height / 2,
+					   p010 ? GS_RG16 : GS_R8G8, 1, NULL,
+					   GS_RENDER_TARGET);
+		if (!tex || !tex_uv) {
+			gs_texture_destroy(tex);
+			gs_texture_destroy(tex_uv);
+			tex = NULL;
+		}
+#endif
 		if (!tex) {
 			return false;
 		}
 
+#ifdef _WIN32
 		uint32_t handle = gs_texture_get_shared_handle(tex);
+#else
+		uint32_t handle = GS_INVALID_HANDLE;
+#endif
 
 		struct obs_tex_frame frame = {
 			.tex = tex, .tex_uv = tex_uv, .handle = handle};
@@ -177,20 +217,16 @@ bool init_gpu_encoding(struct obs_core_video *video)
 	    0)
 		return false;
 	if (pthread_create(&video->gpu_encode_thread, NULL, gpu_encode_thread,
-			   NULL) != 0)
+			   video) != 0)
 		return false;
 
 	os_event_signal(video->gpu_encode_inactive);
 
 	video->gpu_encode_thread_initialized = true;
 	return true;
-#else
-	UNUSED_PARAMETER(video);
-	return false;
-#endif
 }
 
-void stop_gpu_encoding_thread(struct obs_core_video *video)
+void stop_gpu_encoding_thread(struct obs_core_video_mix *video)
 {
 	if (video->gpu_encode_thread_initialized) {
 		os_atomic_set_bool(&video->gpu_encode_stop, true);
@@ -200,7 +236,7 @@ void stop_gpu_encoding_thread(struct obs_core_video *video)
 	}
 }
 
-void free_gpu_encoding(struct obs_core_video *video)
+void free_gpu_encoding(struct obs_core_video_mix *video)
 {
 	if (video->gpu_encode_semaphore) {
 		os_sem_destroy(video->gpu_encode_semaphore);
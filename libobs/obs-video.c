@@ -32,13 +32,13 @@
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
 	struct obs_core_data *data = &obs->data;
+	struct obs_tick_pool *pool = &obs->video.tick_pool;
 	struct obs_source *source;
 	uint64_t delta_time;
 	float seconds;
 
 	if (!last_time)
-		last_time = cur_time -
-			    video_output_get_frame_time(obs->video.video);
+		last_time = cur_time - obs->video.video_frame_interval_ns;
 
 	delta_time = cur_time - last_time;
 	seconds = (float)((double)delta_time / 1000000000.0);
@@ -66,14 +66,28 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 		struct obs_source *cur_source = obs_source_get_ref(source);
 		source = (struct obs_source *)source->context.next;
 
-		if (cur_source) {
-			obs_source_video_tick(cur_source, seconds);
+		if (!cur_source)
+			continue;
+
+		/* thread safe ticks keep their reference until the pool has
+		 * run them */
+		if (pool->num_threads &&
+		    obs_source_video_tick_deferred(cur_source, seconds)) {
+			da_push_back(pool->sources, &cur_source);
+		} else {
+			if (!pool->num_threads)
+				obs_source_video_tick(cur_source, seconds);
 			obs_source_release(cur_source);
 		}
 	}
 
 	pthread_mutex_unlock(&data->sources_mutex);
 
+	/* ------------------------------------- */
+	/* run the deferred ticks in parallel    */
+
+	obs_tick_pool_run(pool, seconds);
+
 	return cur_time;
 }
 
@@ -92,12 +106,16 @@ static inline void render_displays(void)
 	/* render extra displays/swaps */
 	pthread_mutex_lock(&obs->data.displays_mutex);
 
+	obs->video.rendering_displays = true;
+
 	display = obs->data.first_display;
 	while (display) {
 		render_display(display);
 		display = display->next;
 	}
 
+	obs->video.rendering_displays = false;
+
 	pthread_mutex_unlock(&obs->data.displays_mutex);
 
 	gs_leave_context();
@@ -112,7 +130,7 @@ static inline void set_render_size(uint32_t width, uint32_t height)
 	gs_set_viewport(0, 0, width, height);
 }
 
-static inline void unmap_last_surface(struct obs_core_video *video)
+static inline void unmap_last_surface(struct obs_core_video_mix *video)
 {
 	for (int c = 0; c < NUM_CHANNELS; ++c) {
 		if (video->mapped_surfaces[c]) {
@@ -123,7 +141,7 @@ static inline void unmap_last_surface(struct obs_core_video *video)
 }
 
 static const char *render_main_texture_name = "render_main_texture";
-static inline void render_main_texture(struct obs_core_video *video)
+static inline void render_main_texture(struct obs_core_video_mix *video)
 {
 	profile_start(render_main_texture_name);
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_MAIN_TEXTURE,
@@ -137,19 +155,22 @@ static inline void render_main_texture(struct obs_core_video *video)
 
 	set_render_size(video->base_width, video->base_height);
 
-	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
+	/* main render callbacks only ever draw into the main canvas */
+	if (video == obs->video.main_mix) {
+		pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
 
-	for (size_t i = obs->data.draw_callbacks.num; i > 0; i--) {
-		struct draw_callback *callback;
-		callback = obs->data.draw_callbacks.array + (i - 1);
+		for (size_t i = obs->data.draw_callbacks.num; i > 0; i--) {
+			struct draw_callback *callback;
+			callback = obs->data.draw_callbacks.array + (i - 1);
 
-		callback->draw(callback->param, video->base_width,
-			       video->base_height);
-	}
+			callback->draw(callback->param, video->base_width,
+				       video->base_height);
+		}
 
-	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+		pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+	}
 
-	obs_view_render(&obs->data.main_view);
+	obs_view_render(video->view);
 
 	video->texture_rendered = true;
 
@@ -158,17 +179,19 @@ static inline void render_main_texture(struct obs_core_video *video)
 }
 
 static inline gs_effect_t *
-get_scale_effect_internal(struct obs_core_video *video)
+get_scale_effect_internal(struct obs_core_video_mix *mix)
 {
+	struct obs_core_video *video = &obs->video;
+
 	/* if the dimension is under half the size of the original image,
 	 * bicubic/lanczos can't sample enough pixels to create an accurate
 	 * image, so use the bilinear low resolution effect instead */
-	if (video->output_width < (video->base_width / 2) &&
-	    video->output_height < (video->base_height / 2)) {
+	if (mix->output_width < (mix->base_width / 2) &&
+	    mix->output_height < (mix->base_height / 2)) {
 		return video->bilinear_lowres_effect;
 	}
 
-	switch (video->scale_type) {
+	switch (mix->scale_type) {
 	case OBS_SCALE_BILINEAR:
 		return video->default_effect;
 	case OBS_SCALE_LANCZOS:
@@ -182,7 +205,7 @@ get_scale_effect_internal(struct obs_core_video *video)
 	return video->bicubic_effect;
 }
 
-static inline bool resolution_close(struct obs_core_video *video,
+static inline bool resolution_close(struct obs_core_video_mix *video,
 				    uint32_t width, uint32_t height)
 {
 	long width_cmp = (long)video->base_width - (long)width;
@@ -191,15 +214,17 @@ static inline bool resolution_close(struct obs_core_video *video,
 	return labs(width_cmp) <= 16 && labs(height_cmp) <= 16;
 }
 
-static inline gs_effect_t *get_scale_effect(struct obs_core_video *video,
+static inline gs_effect_t *get_scale_effect(struct obs_core_video_mix *mix,
 					    uint32_t width, uint32_t height)
 {
-	if (resolution_close(video, width, height)) {
+	struct obs_core_video *video = &obs->video;
+
+	if (resolution_close(mix, width, height)) {
 		return video->default_effect;
 	} else {
 		/* if the scale method couldn't be loaded, use either bicubic
 		 * or bilinear by default */
-		gs_effect_t *effect = get_scale_effect_internal(video);
+		gs_effect_t *effect = get_scale_effect_internal(mix);
 		if (!effect)
 			effect = !!video->bicubic_effect
 					 ? video->bicubic_effect
@@ -209,9 +234,12 @@ static inline gs_effect_t *get_scale_effect(struct obs_core_video *video,
 }
 
 static const char *render_output_texture_name = "render_output_texture";
-static inline gs_texture_t *render_output_texture(struct obs_core_video *video)
+static inline gs_texture_t *
+render_output_texture(struct obs_core_video_mix *video)
 {
-	gs_texture_t *texture = video->render_texture;
+	gs_texture_t *texture = video->source_mix
+					? video->source_mix->render_texture
+					: video->render_texture;
 	gs_texture_t *target = video->output_texture;
 	uint32_t width = gs_texture_get_width(target);
 	uint32_t height = gs_texture_get_height(target);
@@ -222,7 +250,7 @@ static inline gs_texture_t *render_output_texture(struct obs_core_video *video)
 	if (video->ovi.output_format == VIDEO_FORMAT_RGBA) {
 		tech = gs_effect_get_technique(effect, "DrawAlphaDivide");
 	} else {
-		if ((effect == video->default_effect) &&
+		if ((effect == obs->video.default_effect) &&
 		    (width == video->base_width) &&
 		    (height == video->base_height))
 			return texture;
@@ -296,12 +324,12 @@ static void render_convert_plane(gs_effect_t *effect, gs_texture_t *target,
 }
 
 static const char *render_convert_texture_name = "render_convert_texture";
-static void render_convert_texture(struct obs_core_video *video,
+static void render_convert_texture(struct obs_core_video_mix *video,
 				   gs_texture_t *texture)
 {
 	profile_start(render_convert_texture_name);
 
-	gs_effect_t *effect = video->conversion_effect;
+	gs_effect_t *effect = obs->video.conversion_effect;
 	gs_eparam_t *color_vec0 =
 		gs_effect_get_param_by_name(effect, "color_vec0");
 	gs_eparam_t *color_vec1 =
@@ -356,19 +384,19 @@ static void render_convert_texture(struct obs_core_video *video,
 }
 
 static const char *stage_output_texture_name = "stage_output_texture";
-static inline void stage_output_texture(struct obs_core_video *video,
-					int cur_texture)
+static inline void stage_output_texture(struct obs_core_video_mix *video)
 {
-	profile_start(stage_output_texture_name);
+	int cur_texture =
+		(video->staged_head + video->staged_count) % NUM_TEXTURES;
 
-	unmap_last_surface(video);
+	profile_start(stage_output_texture_name);
 
 	if (!video->gpu_conversion) {
 		gs_stagesurf_t *copy = video->copy_surfaces[cur_texture][0];
 		if (copy)
 			gs_stage_texture(copy, video->output_texture);
 
-		video->textures_copied[cur_texture] = true;
+		video->staged_count++;
 	} else if (video->texture_converted) {
 		for (int i = 0; i < NUM_CHANNELS; i++) {
 			gs_stagesurf_t *copy =
@@ -378,14 +406,14 @@ static inline void stage_output_texture(struct obs_core_video *video,
 						 video->convert_textures[i]);
 		}
 
-		video->textures_copied[cur_texture] = true;
+		video->staged_count++;
 	}
 
 	profile_end(stage_output_texture_name);
 }
 
-#ifdef _WIN32
-static inline bool queue_frame(struct obs_core_video *video, bool raw_active,
+static inline bool queue_frame(struct obs_core_video_mix *video,
+			       bool raw_active,
 			       struct obs_vframe_info *vframe_info)
 {
 	bool duplicate =
@@ -410,10 +438,12 @@ static inline bool queue_frame(struct obs_core_video *video, bool raw_active,
 	struct obs_tex_frame tf;
 	circlebuf_pop_front(&video->gpu_encoder_avail_queue, &tf, sizeof(tf));
 
+#ifdef _WIN32
 	if (tf.released) {
 		gs_texture_acquire_sync(tf.tex, tf.lock_key, GS_WAIT_INFINITE);
 		tf.released = false;
 	}
+#endif
 
 	/* the vframe_info->count > 1 case causing a copy can only happen if by
 	 * some chance the very first frame has to be duplicated for whatever
@@ -421,6 +451,10 @@ static inline bool queue_frame(struct obs_core_video *video, bool raw_active,
 	 * will ensure better performance. */
 	if (raw_active || vframe_info->count > 1) {
 		gs_copy_texture(tf.tex, video->convert_textures[0]);
+#ifndef _WIN32
+		/* without shared textures the planes are separate */
+		gs_copy_texture(tf.tex_uv, video->convert_textures[1]);
+#endif
 	} else {
 		gs_texture_t *tex = video->convert_textures[0];
 		gs_texture_t *tex_uv = video->convert_textures[1];
@@ -434,9 +468,13 @@ static inline bool queue_frame(struct obs_core_video *video, bool raw_active,
 
 	tf.count = 1;
 	tf.timestamp = vframe_info->timestamp;
+#ifdef _WIN32
 	tf.released = true;
 	tf.handle = gs_texture_get_shared_handle(tf.tex);
 	gs_texture_release_sync(tf.tex, ++tf.lock_key);
+#else
+	tf.handle = GS_INVALID_HANDLE;
+#endif
 	circlebuf_push_back(&video->gpu_encoder_queue, &tf, sizeof(tf));
 
 	os_sem_post(video->gpu_encode_semaphore);
@@ -447,7 +485,8 @@ finish:
 
 extern void full_stop(struct obs_encoder *encoder);
 
-static inline void encode_gpu(struct obs_core_video *video, bool raw_active,
+static inline void encode_gpu(struct obs_core_video_mix *video,
+			      bool raw_active,
 			      struct obs_vframe_info *vframe_info)
 {
 	while (queue_frame(video, raw_active, vframe_info))
@@ -455,7 +494,8 @@ static inline void encode_gpu(struct obs_core_video *video, bool raw_active,
 }
 
 static const char *output_gpu_encoders_name = "output_gpu_encoders";
-static void output_gpu_encoders(struct obs_core_video *video, bool raw_active)
+static void output_gpu_encoders(struct obs_core_video_mix *video,
+				bool raw_active)
 {
 	profile_start(output_gpu_encoders_name);
 
@@ -475,52 +515,109 @@ static void output_gpu_encoders(struct obs_core_video *video, bool raw_active)
 end:
 	profile_end(output_gpu_encoders_name);
 }
-#endif
 
-static inline void render_video(struct obs_core_video *video, bool raw_active,
-				const bool gpu_active, int cur_texture)
+static inline void render_video(struct obs_core_video_mix *video,
+				bool raw_active, const bool gpu_active)
 {
+	/* only the main canvas is timed on the GPU */
+	const bool timed = video == obs->video.main_mix &&
+			   obs_gpu_timing_begin_frame();
+
 	gs_begin_scene();
 
 	gs_enable_depth_test(false);
 	gs_set_cull_mode(GS_NEITHER);
 
-	render_main_texture(video);
+	obs_gpu_timing_begin(OBS_GPU_STAGE_RENDER_VIDEO);
+
+	/* scaled canvases reuse the texture their source rendered earlier in
+	 * the same tick */
+	if (!video->source_mix) {
+		obs_gpu_timing_begin(OBS_GPU_STAGE_MAIN_TEXTURE);
+		render_main_texture(video);
+		obs_gpu_timing_end(OBS_GPU_STAGE_MAIN_TEXTURE);
+	}
 
 	if (raw_active || gpu_active) {
-		gs_texture_t *texture = render_output_texture(video);
+		gs_texture_t *texture;
+
+		obs_gpu_timing_begin(OBS_GPU_STAGE_OUTPUT_TEXTURE);
+		texture = render_output_texture(video);
+		obs_gpu_timing_end(OBS_GPU_STAGE_OUTPUT_TEXTURE);
 
-#ifdef _WIN32
 		if (gpu_active)
 			gs_flush();
-#endif
 
-		if (video->gpu_conversion)
+		if (video->gpu_conversion) {
+			obs_gpu_timing_begin(OBS_GPU_STAGE_CONVERT_TEXTURE);
 			render_convert_texture(video, texture);
+			obs_gpu_timing_end(OBS_GPU_STAGE_CONVERT_TEXTURE);
+		}
 
-#ifdef _WIN32
 		if (gpu_active) {
 			gs_flush();
+			obs_gpu_timing_begin(OBS_GPU_STAGE_GPU_ENCODERS);
 			output_gpu_encoders(video, raw_active);
+			obs_gpu_timing_end(OBS_GPU_STAGE_GPU_ENCODERS);
 		}
-#endif
 
-		if (raw_active)
-			stage_output_texture(video, cur_texture);
+		if (raw_active) {
+			obs_gpu_timing_begin(OBS_GPU_STAGE_STAGE_OUTPUT);
+			stage_output_texture(video);
+			obs_gpu_timing_end(OBS_GPU_STAGE_STAGE_OUTPUT);
+		}
 	}
 
+	obs_gpu_timing_end(OBS_GPU_STAGE_RENDER_VIDEO);
+
 	gs_set_render_target(NULL, NULL);
 	gs_enable_blending(true);
 
+	if (timed)
+		obs_gpu_timing_end_frame();
+
 	gs_end_scene();
 }
 
-static inline bool download_frame(struct obs_core_video *video,
-				  int prev_texture, struct video_data *frame)
+static inline bool staged_texture_ready(struct obs_core_video_mix *video,
+					int texture)
 {
-	if (!video->textures_copied[prev_texture])
+	for (int channel = 0; channel < NUM_CHANNELS; ++channel) {
+		gs_stagesurf_t *surface = video->copy_surfaces[texture][channel];
+		if (surface && !gs_stagesurface_ready(surface))
+			return false;
+	}
+	return true;
+}
+
+/* whether the oldest staged frame is to be downloaded now */
+static inline bool staged_frame_due(struct obs_core_video_mix *video)
+{
+	if (!video->staged_count)
 		return false;
 
+	if (!staged_texture_ready(video, video->staged_head)) {
+		if (video->staged_count < video->readback_depth)
+			return false;
+
+		/* the GPU is behind by more than the ring allows, so this
+		 * map will stall; allow more frames in flight next time */
+		if (video->readback_depth < NUM_TEXTURES)
+			video->readback_depth++;
+		video->readback_fast_frames = 0;
+	}
+
+	return true;
+}
+
+static inline bool download_frame(struct obs_core_video_mix *video,
+				  struct video_data *frame)
+{
+	int prev_texture = video->staged_head;
+
+	video->staged_head = (prev_texture + 1) % NUM_TEXTURES;
+	video->staged_count--;
+
 	for (int channel = 0; channel < NUM_CHANNELS; ++channel) {
 		gs_stagesurf_t *surface =
 			video->copy_surfaces[prev_texture][channel];
@@ -535,7 +632,103 @@ static inline bool download_frame(struct obs_core_video *video,
 	return true;
 }
 
-static const uint8_t *set_gpu_converted_plane(uint32_t width, uint32_t height,
+/* shrink the ring back down once the GPU has kept up for a while */
+static inline void update_readback_depth(struct obs_core_video_mix *video)
+{
+	if (video->readback_depth <= MIN_READBACK_DEPTH)
+		return;
+
+	if (video->staged_count > 1) {
+		video->readback_fast_frames = 0;
+		return;
+	}
+
+	if (++video->readback_fast_frames >= READBACK_SHRINK_FRAMES) {
+		video->readback_depth--;
+		video->readback_fast_frames = 0;
+	}
+}
+
+/* planes copied line by line are split in parts of at least this size */
+#define COPY_PART_SIZE (2 * 1024 * 1024)
+#define MAX_COPY_PARTS 8
+
+struct row_copy {
+	const uint8_t *in;
+	uint8_t *out;
+	size_t width;
+	uint32_t rows;
+	uint32_t linesize_in;
+	uint32_t linesize_out;
+};
+
+static void copy_rows(const struct row_copy *copy)
+{
+	const uint8_t *in = copy->in;
+	uint8_t *out = copy->out;
+
+	for (uint32_t y = 0; y < copy->rows; y++) {
+		memcpy(out, in, copy->width);
+		out += copy->linesize_out;
+		in += copy->linesize_in;
+	}
+}
+
+static void copy_rows_task(void *param)
+{
+	copy_rows(param);
+}
+
+/* large planes whose lines have to be copied one by one are copied on
+ * several threads of the task pool, which cuts the time a 4K or high bit
+ * depth frame takes to copy by more than half */
+static void copy_plane_rows(struct obs_core_video_mix *video,
+			    const struct row_copy *copy)
+{
+	struct row_copy parts[MAX_COPY_PARTS];
+	size_t size = copy->width * copy->rows;
+	size_t count = size / COPY_PART_SIZE;
+	size_t threads = obs_get_pool_threads() + 1;
+	uint32_t rows_per_part;
+
+	if (count > threads)
+		count = threads;
+	if (count > MAX_COPY_PARTS)
+		count = MAX_COPY_PARTS;
+
+	if (count < 2) {
+		copy_rows(copy);
+		return;
+	}
+
+	if (!video->copy_group)
+		video->copy_group = obs_task_group_create();
+
+	rows_per_part = (copy->rows + (uint32_t)count - 1) / (uint32_t)count;
+
+	for (size_t i = 0; i < count; i++) {
+		uint32_t first = rows_per_part * (uint32_t)i;
+		uint32_t rows = copy->rows - first < rows_per_part
+					? copy->rows - first
+					: rows_per_part;
+
+		parts[i] = *copy;
+		parts[i].in += (size_t)first * copy->linesize_in;
+		parts[i].out += (size_t)first * copy->linesize_out;
+		parts[i].rows = rows;
+
+		if (i > 0)
+			obs_task_group_queue(video->copy_group,
+					     OBS_TASK_PRIORITY_HIGH,
+					     copy_rows_task, &parts[i]);
+	}
+
+	copy_rows(&parts[0]);
+	obs_task_group_wait(video->copy_group);
+}
+
+static const uint8_t *set_gpu_converted_plane(struct obs_core_video_mix *video,
+					      uint32_t width, uint32_t height,
 					      uint32_t linesize_input,
 					      uint32_t linesize_output,
 					      const uint8_t *in, uint8_t *out)
@@ -545,17 +738,21 @@ static const uint8_t *set_gpu_converted_plane(uint32_t width, uint32_t height,
 		memcpy(out, in, total);
 		in += total;
 	} else {
-		for (size_t y = 0; y < height; y++) {
-			memcpy(out, in, width);
-			out += linesize_output;
-			in += linesize_input;
-		}
+		struct row_copy copy = {.in = in,
+					.out = out,
+					.width = width,
+					.rows = height,
+					.linesize_in = linesize_input,
+					.linesize_out = linesize_output};
+
+		copy_plane_rows(video, &copy);
+		in += (size_t)linesize_input * height;
 	}
 
 	return in;
 }
 
-static void set_gpu_converted_data(struct obs_core_video *video,
+static void set_gpu_converted_data(struct obs_core_video_mix *video,
 				   struct video_frame *output,
 				   const struct video_data *input,
 				   const struct video_output_info *info)
@@ -565,20 +762,20 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 		const uint32_t height = info->height;
 
 		const uint8_t *const in_uv = set_gpu_converted_plane(
-			width, height, input->linesize[0], output->linesize[0],
-			input->data[0], output->data[0]);
+			video, width, height, input->linesize[0],
+			output->linesize[0], input->data[0], output->data[0]);
 
 		const uint32_t height_d2 = height / 2;
-		set_gpu_converted_plane(width, height_d2, input->linesize[0],
-					output->linesize[1], in_uv,
-					output->data[1]);
+		set_gpu_converted_plane(video, width, height_d2,
+					input->linesize[0], output->linesize[1],
+					in_uv, output->data[1]);
 	} else {
 		switch (info->format) {
 		case VIDEO_FORMAT_I420: {
 			const uint32_t width = info->width;
 			const uint32_t height = info->height;
 
-			set_gpu_converted_plane(width, height,
+			set_gpu_converted_plane(video, width, height,
 						input->linesize[0],
 						output->linesize[0],
 						input->data[0],
@@ -587,13 +784,13 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 			const uint32_t width_d2 = width / 2;
 			const uint32_t height_d2 = height / 2;
 
-			set_gpu_converted_plane(width_d2, height_d2,
+			set_gpu_converted_plane(video, width_d2, height_d2,
 						input->linesize[1],
 						output->linesize[1],
 						input->data[1],
 						output->data[1]);
 
-			set_gpu_converted_plane(width_d2, height_d2,
+			set_gpu_converted_plane(video, width_d2, height_d2,
 						input->linesize[2],
 						output->linesize[2],
 						input->data[2],
@@ -605,14 +802,14 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 			const uint32_t width = info->width;
 			const uint32_t height = info->height;
 
-			set_gpu_converted_plane(width, height,
+			set_gpu_converted_plane(video, width, height,
 						input->linesize[0],
 						output->linesize[0],
 						input->data[0],
 						output->data[0]);
 
 			const uint32_t height_d2 = height / 2;
-			set_gpu_converted_plane(width, height_d2,
+			set_gpu_converted_plane(video, width, height_d2,
 						input->linesize[1],
 						output->linesize[1],
 						input->data[1],
@@ -624,19 +821,47 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 			const uint32_t width = info->width;
 			const uint32_t height = info->height;
 
-			set_gpu_converted_plane(width, height,
+			set_gpu_converted_plane(video, width, height,
+						input->linesize[0],
+						output->linesize[0],
+						input->data[0],
+						output->data[0]);
+
+			set_gpu_converted_plane(video, width, height,
+						input->linesize[1],
+						output->linesize[1],
+						input->data[1],
+						output->data[1]);
+
+			set_gpu_converted_plane(video, width, height,
+						input->linesize[2],
+						output->linesize[2],
+						input->data[2],
+						output->data[2]);
+
+			break;
+		}
+		case VIDEO_FORMAT_I010: {
+			/* two bytes per sample */
+			const uint32_t width = info->width * 2;
+			const uint32_t height = info->height;
+
+			set_gpu_converted_plane(video, width, height,
 						input->linesize[0],
 						output->linesize[0],
 						input->data[0],
 						output->data[0]);
 
-			set_gpu_converted_plane(width, height,
+			const uint32_t width_d2 = width / 2;
+			const uint32_t height_d2 = height / 2;
+
+			set_gpu_converted_plane(video, width_d2, height_d2,
 						input->linesize[1],
 						output->linesize[1],
 						input->data[1],
 						output->data[1]);
 
-			set_gpu_converted_plane(width, height,
+			set_gpu_converted_plane(video, width_d2, height_d2,
 						input->linesize[2],
 						output->linesize[2],
 						input->data[2],
@@ -644,6 +869,26 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 
 			break;
 		}
+		case VIDEO_FORMAT_P010: {
+			/* two bytes per sample */
+			const uint32_t width = info->width * 2;
+			const uint32_t height = info->height;
+
+			set_gpu_converted_plane(video, width, height,
+						input->linesize[0],
+						output->linesize[0],
+						input->data[0],
+						output->data[0]);
+
+			const uint32_t height_d2 = height / 2;
+			set_gpu_converted_plane(video, width, height_d2,
+						input->linesize[1],
+						output->linesize[1],
+						input->data[1],
+						output->data[1]);
+
+			break;
+		}
 
 		case VIDEO_FORMAT_NONE:
 		case VIDEO_FORMAT_YVYU:
@@ -659,13 +904,15 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 		case VIDEO_FORMAT_I42A:
 		case VIDEO_FORMAT_YUVA:
 		case VIDEO_FORMAT_AYUV:
+		case VIDEO_FORMAT_V210:
 			/* unimplemented */
 			;
 		}
 	}
 }
 
-static inline void copy_rgbx_frame(struct video_frame *output,
+static inline void copy_rgbx_frame(struct obs_core_video_mix *video,
+				   struct video_frame *output,
 				   const struct video_data *input,
 				   const struct video_output_info *info)
 {
@@ -677,22 +924,135 @@ static inline void copy_rgbx_frame(struct video_frame *output,
 		memcpy(out_ptr, in_ptr,
 		       (size_t)input->linesize[0] * (size_t)info->height);
 	} else {
-		const size_t copy_size = (size_t)info->width * 4;
-		for (size_t y = 0; y < info->height; y++) {
-			memcpy(out_ptr, in_ptr, copy_size);
-			in_ptr += input->linesize[0];
-			out_ptr += output->linesize[0];
+		struct row_copy copy = {.in = in_ptr,
+					.out = out_ptr,
+					.width = (size_t)info->width * 4,
+					.rows = info->height,
+					.linesize_in = input->linesize[0],
+					.linesize_out = output->linesize[0]};
+
+		copy_plane_rows(video, &copy);
+	}
+}
+
+static void release_held_frame(void *param)
+{
+	struct obs_held_frame *held = param;
+	os_atomic_set_bool(&held->released, true);
+}
+
+/* assumes graphics context, unmaps the held frames the video output is done
+ * with, whose surfaces are spares for the ring from then on */
+static void recycle_held_frames(struct obs_core_video_mix *video)
+{
+	for (size_t i = 0; i < NUM_HELD_FRAMES; i++) {
+		struct obs_held_frame *held = &video->held_frames[i];
+
+		if (!held->held || !os_atomic_load_bool(&held->released))
+			continue;
+
+		for (size_t c = 0; c < NUM_CHANNELS; c++) {
+			if (held->surfaces[c])
+				gs_stagesurface_unmap(held->surfaces[c]);
 		}
+		held->held = false;
 	}
 }
 
-static inline void output_video_data(struct obs_core_video *video,
-				     struct video_data *input_frame, int count)
+/* the formats whose staged planes can be read by the outputs as they are */
+static inline bool direct_output_enabled(struct obs_core_video_mix *video)
+{
+	if (!video->gpu_conversion)
+		return true;
+
+	switch (video_output_get_format(video->video)) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+	case VIDEO_FORMAT_I444:
+	case VIDEO_FORMAT_I010:
+	case VIDEO_FORMAT_P010:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* assumes graphics context, keeps the surfaces the last frame was mapped
+ * from mapped for the video output, and puts a spare set of surfaces in
+ * their place in the ring.  returns NULL if the frame has to be copied */
+static struct obs_held_frame *
+hold_mapped_frame(struct obs_core_video_mix *video)
+{
+	int slot = (video->staged_head + NUM_TEXTURES - 1) % NUM_TEXTURES;
+	struct obs_held_frame *held = NULL;
+
+	if (!direct_output_enabled(video))
+		return NULL;
+
+	for (size_t i = 0; i < NUM_HELD_FRAMES; i++) {
+		if (!video->held_frames[i].held) {
+			held = &video->held_frames[i];
+			break;
+		}
+	}
+
+	if (!held)
+		return NULL;
+
+	if (!held->surfaces[0] &&
+	    !obs_create_copy_surfaces(video, held->surfaces)) {
+		for (size_t c = 0; c < NUM_CHANNELS; c++) {
+			gs_stagesurface_destroy(held->surfaces[c]);
+			held->surfaces[c] = NULL;
+		}
+		return NULL;
+	}
+
+	for (size_t c = 0; c < NUM_CHANNELS; c++) {
+		gs_stagesurf_t *spare = held->surfaces[c];
+
+		held->surfaces[c] = video->copy_surfaces[slot][c];
+		video->copy_surfaces[slot][c] = spare;
+		video->mapped_surfaces[c] = NULL;
+	}
+
+	os_atomic_set_bool(&held->released, false);
+	held->held = true;
+	return held;
+}
+
+static void output_held_frame(struct obs_core_video_mix *video,
+			      const struct video_data *input_frame, int count,
+			      struct obs_held_frame *held)
+{
+	struct video_data frame = *input_frame;
+
+	/* both planes are in the one surface */
+	if (video->using_nv12_tex) {
+		uint32_t height = video_output_get_height(video->video);
+
+		frame.data[1] =
+			frame.data[0] + (size_t)frame.linesize[0] * height;
+		frame.linesize[1] = frame.linesize[0];
+	}
+
+	video_output_send_external_frame(video->video, &frame, count,
+					 release_held_frame, held);
+}
+
+static inline void output_video_data(struct obs_core_video_mix *video,
+				     struct video_data *input_frame, int count,
+				     struct obs_held_frame *held)
 {
 	const struct video_output_info *info;
 	struct video_frame output_frame;
 	bool locked;
 
+	if (held) {
+		output_held_frame(video, input_frame, count, held);
+		return;
+	}
+
 	info = video_output_get_info(video->video);
 
 	locked = video_output_lock_frame(video->video, &output_frame, count,
@@ -702,23 +1062,81 @@ static inline void output_video_data(struct obs_core_video *video,
 			set_gpu_converted_data(video, &output_frame,
 					       input_frame, info);
 		} else {
-			copy_rgbx_frame(&output_frame, input_frame, info);
+			copy_rgbx_frame(video, &output_frame, input_frame,
+					info);
 		}
 
 		video_output_unlock_frame(video->video);
 	}
 }
 
-static inline void video_sleep(struct obs_core_video *video, bool raw_active,
-			       const bool gpu_active, uint64_t *p_time,
+static void output_video_data_task(void *param)
+{
+	struct obs_core_video_mix *video = param;
+	output_video_data(video, &video->output_data, video->output_count,
+			  video->output_held);
+}
+
+/* while rendering offline, frames wait for room in the outputs instead of
+ * being skipped */
+static bool outputs_ready(struct obs_core_video *video)
+{
+	bool ready = true;
+
+	pthread_mutex_lock(&video->mixes_mutex);
+	for (size_t i = 0; ready && i < video->mixes.num; i++) {
+		struct obs_core_video_mix *mix = video->mixes.array[i];
+
+		if (mix->raw_was_active) {
+			const struct video_output_info *voi =
+				video_output_get_info(mix->video);
+			ready = video_output_get_queued_frames(mix->video) <
+				voi->cache_size;
+		}
+
+		if (ready && mix->gpu_was_active) {
+			pthread_mutex_lock(&mix->gpu_encoder_mutex);
+			ready = mix->gpu_encoder_avail_queue.size != 0;
+			pthread_mutex_unlock(&mix->gpu_encoder_mutex);
+		}
+	}
+	pthread_mutex_unlock(&video->mixes_mutex);
+
+	return ready;
+}
+
+static inline void video_sleep(struct obs_core_video *video, uint64_t *p_time,
 			       uint64_t interval_ns)
 {
 	struct obs_vframe_info vframe_info;
 	uint64_t cur_time = *p_time;
-	uint64_t t = cur_time + interval_ns;
+	bool offline = obs_offline_rendering_active();
+	uint64_t t;
 	int count;
 
-	if (os_sleepto_ns(t)) {
+	/* the clocks can be far apart after switching */
+	if (offline != video->rendering_offline) {
+		video->rendering_offline = offline;
+		if (!offline)
+			cur_time = os_gettime_ns();
+	}
+
+	if (!offline)
+		interval_ns = obs_master_clock_interval(interval_ns);
+	t = cur_time + interval_ns;
+
+	if (offline) {
+		while (!outputs_ready(video) &&
+		       !video_output_stopped(video->main_mix->video))
+			os_sleep_ms(1);
+
+		obs_offline_clock_advance(t);
+		*p_time = t;
+		count = 1;
+
+	} else if (os_sleepto_ns(t)) {
+		obs_histogram_observe(&video->sleep_jitter_hist,
+				      os_gettime_ns() - t);
 		*p_time = t;
 		count = 1;
 	} else {
@@ -728,16 +1146,24 @@ static inline void video_sleep(struct obs_core_video *video, bool raw_active,
 
 	video->total_frames += count;
 	video->lagged_frames += count - 1;
+	if (count > 1)
+		profiler_trace_trigger("lagged frame");
 
 	vframe_info.timestamp = cur_time;
 	vframe_info.count = count;
 
-	if (raw_active)
-		circlebuf_push_back(&video->vframe_info_buffer, &vframe_info,
-				    sizeof(vframe_info));
-	if (gpu_active)
-		circlebuf_push_back(&video->vframe_info_buffer_gpu,
-				    &vframe_info, sizeof(vframe_info));
+	pthread_mutex_lock(&video->mixes_mutex);
+	for (size_t i = 0; i < video->mixes.num; i++) {
+		struct obs_core_video_mix *mix = video->mixes.array[i];
+
+		if (mix->raw_was_active)
+			circlebuf_push_back(&mix->vframe_info_buffer,
+					    &vframe_info, sizeof(vframe_info));
+		if (mix->gpu_was_active)
+			circlebuf_push_back(&mix->vframe_info_buffer_gpu,
+					    &vframe_info, sizeof(vframe_info));
+	}
+	pthread_mutex_unlock(&video->mixes_mutex);
 }
 
 static const char *output_frame_gs_context_name = "gs_context(video->graphics)";
@@ -745,33 +1171,35 @@ static const char *output_frame_render_video_name = "render_video";
 static const char *output_frame_download_frame_name = "download_frame";
 static const char *output_frame_gs_flush_name = "gs_flush";
 static const char *output_frame_output_video_data_name = "output_video_data";
-static inline void output_frame(bool raw_active, const bool gpu_active)
+static inline void output_frame(struct obs_core_video_mix *video,
+				bool raw_active, const bool gpu_active)
 {
-	struct obs_core_video *video = &obs->video;
-	int cur_texture = video->cur_texture;
-	int prev_texture = cur_texture == 0 ? NUM_TEXTURES - 1
-					    : cur_texture - 1;
+	const bool pipelined =
+		os_atomic_load_bool(&obs->video.pipelined_output);
+	struct obs_held_frame *held;
 	struct video_data frame;
-	bool frame_ready = 0;
+	bool frame_ready;
+	bool queued = false;
+
+	if (pipelined && raw_active && !video->output_group)
+		video->output_group = obs_task_group_create();
 
-	memset(&frame, 0, sizeof(struct video_data));
+	/* the copy queued last time ran while the sources ticked; it has to
+	 * be done with its mapping before the ring is staged to again */
+	if (video->output_group)
+		obs_task_group_wait(video->output_group);
 
 	profile_start(output_frame_gs_context_name);
-	gs_enter_context(video->graphics);
+	gs_enter_context(obs->video.graphics);
+	unmap_last_surface(video);
 
 	profile_start(output_frame_render_video_name);
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_RENDER_VIDEO,
 			      output_frame_render_video_name);
-	render_video(video, raw_active, gpu_active, cur_texture);
+	render_video(video, raw_active, gpu_active);
 	GS_DEBUG_MARKER_END();
 	profile_end(output_frame_render_video_name);
 
-	if (raw_active) {
-		profile_start(output_frame_download_frame_name);
-		frame_ready = download_frame(video, prev_texture, &frame);
-		profile_end(output_frame_download_frame_name);
-	}
-
 	profile_start(output_frame_gs_flush_name);
 	gs_flush();
 	profile_end(output_frame_gs_flush_name);
@@ -779,63 +1207,137 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 	gs_leave_context();
 	profile_end(output_frame_gs_context_name);
 
-	if (raw_active && frame_ready) {
+	if (!raw_active)
+		return;
+
+	/* output every staged frame whose copy has completed, oldest
+	 * first; each one matches a queued vframe_info entry */
+	for (;;) {
+		memset(&frame, 0, sizeof(struct video_data));
+		held = NULL;
+
+		profile_start(output_frame_download_frame_name);
+		gs_enter_context(obs->video.graphics);
+		recycle_held_frames(video);
+		frame_ready = video->vframe_info_buffer.size &&
+			      staged_frame_due(video);
+		if (frame_ready) {
+			/* a copy queued by this call still reads from its
+			 * mapping; the last one queued is left running until
+			 * the next call */
+			if (queued)
+				obs_task_group_wait(video->output_group);
+
+			unmap_last_surface(video);
+			frame_ready = download_frame(video, &frame);
+			if (frame_ready)
+				held = hold_mapped_frame(video);
+		}
+		gs_leave_context();
+		profile_end(output_frame_download_frame_name);
+
+		if (!frame_ready)
+			break;
+
 		struct obs_vframe_info vframe_info;
 		circlebuf_pop_front(&video->vframe_info_buffer, &vframe_info,
 				    sizeof(vframe_info));
 
 		frame.timestamp = vframe_info.timestamp;
 		profile_start(output_frame_output_video_data_name);
-		output_video_data(video, &frame, vframe_info.count);
+		if (pipelined && video->output_group) {
+			video->output_data = frame;
+			video->output_count = vframe_info.count;
+			video->output_held = held;
+			obs_task_group_queue(video->output_group,
+					     OBS_TASK_PRIORITY_HIGH,
+					     output_video_data_task, video);
+			queued = true;
+		} else {
+			output_video_data(video, &frame, vframe_info.count,
+					  held);
+		}
 		profile_end(output_frame_output_video_data_name);
 	}
 
-	if (++video->cur_texture == NUM_TEXTURES)
-		video->cur_texture = 0;
+	update_readback_depth(video);
 }
 
-#define NBSP "\xC2\xA0"
-
-static void clear_base_frame_data(void)
+static void clear_base_frame_data(struct obs_core_video_mix *video)
 {
-	struct obs_core_video *video = &obs->video;
 	video->texture_rendered = false;
 	video->texture_converted = false;
 	circlebuf_free(&video->vframe_info_buffer);
-	video->cur_texture = 0;
 }
 
-static void clear_raw_frame_data(void)
+static void clear_raw_frame_data(struct obs_core_video_mix *video)
 {
-	struct obs_core_video *video = &obs->video;
-	memset(video->textures_copied, 0, sizeof(video->textures_copied));
+	video->staged_head = 0;
+	video->staged_count = 0;
+	video->readback_depth = MIN_READBACK_DEPTH;
+	video->readback_fast_frames = 0;
 	circlebuf_free(&video->vframe_info_buffer);
 }
 
-#ifdef _WIN32
-static void clear_gpu_frame_data(void)
+static void clear_gpu_frame_data(struct obs_core_video_mix *video)
 {
-	struct obs_core_video *video = &obs->video;
 	circlebuf_free(&video->vframe_info_buffer_gpu);
 }
-#endif
+
+static inline void output_frames(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	pthread_mutex_lock(&video->mixes_mutex);
+
+	for (size_t i = 0; i < video->mixes.num; i++) {
+		struct obs_core_video_mix *mix = video->mixes.array[i];
+		const bool raw_active = os_atomic_load_long(&mix->raw_active) >
+					0;
+		const bool gpu_active =
+			os_atomic_load_long(&mix->gpu_encoder_active) > 0;
+		const bool active = raw_active || gpu_active;
+
+		if (!mix->was_active && active)
+			clear_base_frame_data(mix);
+		if (!mix->raw_was_active && raw_active)
+			clear_raw_frame_data(mix);
+		if (!mix->gpu_was_active && gpu_active)
+			clear_gpu_frame_data(mix);
+		mix->gpu_was_active = gpu_active;
+		mix->raw_was_active = raw_active;
+		mix->was_active = active;
+
+		/* the main canvas always renders for previews and
+		 * projectors, additional canvases only when something is
+		 * actually consuming their output */
+		if (mix == video->main_mix || active)
+			output_frame(mix, raw_active, gpu_active);
+	}
+
+	pthread_mutex_unlock(&video->mixes_mutex);
+}
+
+#define NBSP "\xC2\xA0"
 
 extern THREAD_LOCAL bool is_graphics_thread;
 
 static void execute_graphics_tasks(void)
 {
 	struct obs_core_video *video = &obs->video;
-	bool tasks_remaining = true;
 
-	while (tasks_remaining) {
+	for (;;) {
+		struct obs_task_info info = {0};
+
+		/* tasks run unlocked so that other threads can queue more */
 		pthread_mutex_lock(&video->task_mutex);
-		if (video->tasks.size) {
-			struct obs_task_info info;
+		if (video->tasks.size)
 			circlebuf_pop_front(&video->tasks, &info, sizeof(info));
-			info.task(info.param);
-		}
-		tasks_remaining = !!video->tasks.size;
 		pthread_mutex_unlock(&video->task_mutex);
+
+		if (!info.task)
+			break;
+		info.task(info.param);
 	}
 }
 
@@ -920,50 +1422,163 @@ static void uninit_winrt_state(struct winrt_state *winrt)
 
 #endif // #ifdef _WIN32
 
+/* frames need to stay within this share of the budget for a second before
+ * low priority sources are rendered again, as leaving them out makes the
+ * frames cheaper */
+#define RENDER_BUDGET_CALM_PERCENT 75
+
+static void update_render_budget(uint64_t frame_time_ns)
+{
+	struct obs_core_video *video = &obs->video;
+	uint64_t budget =
+		(uint64_t)os_atomic_load_long_long(&video->render_budget_ns);
+	uint64_t calm_frames;
+
+	if (!budget) {
+		video->render_budget_exceeded = false;
+		return;
+	}
+
+	if (frame_time_ns > budget) {
+		if (!video->render_budget_exceeded)
+			blog(LOG_DEBUG, "Frame over the render budget, leaving "
+					"low priority sources out of displays");
+		video->render_budget_exceeded = true;
+		video->render_budget_calm_frames = 0;
+		return;
+	}
+
+	if (!video->render_budget_exceeded)
+		return;
+
+	if (frame_time_ns * 100 > budget * RENDER_BUDGET_CALM_PERCENT) {
+		video->render_budget_calm_frames = 0;
+		return;
+	}
+
+	calm_frames = 1000000000ULL / video->video_frame_interval_ns;
+	if (++video->render_budget_calm_frames >= calm_frames)
+		video->render_budget_exceeded = false;
+}
+
 static const char *tick_sources_name = "tick_sources";
 static const char *render_displays_name = "render_displays";
+static void record_telemetry(uint64_t frame_time_ns, uint32_t lagged)
+{
+	struct obs_core_video *video = &obs->video;
+	video_t *output = video->main_mix->video;
+	uint32_t skipped = video_output_get_skipped_frames(output);
+	struct obs_telemetry_sample sample = {
+		.timestamp = os_gettime_ns(),
+		.duration_ns = frame_time_ns,
+		.dropped = lagged + (skipped - video->telemetry_skipped),
+		.queued = (uint32_t)video_output_get_queued_frames(output),
+	};
+
+	/* the skipped frames are reset when the output restarts */
+	if (skipped < video->telemetry_skipped)
+		sample.dropped = lagged;
+	video->telemetry_skipped = skipped;
+
+	obs_telemetry_push(&video->telemetry, &sample);
+}
+
+/* ticks per second while idle */
+#define IDLE_TICK_RATE 5
+
+void obs_video_wake(void)
+{
+	if (obs && obs->video.idle_event)
+		os_event_signal(obs->video.idle_event);
+}
+
+/* graphics thread only; was_active also has to be clear so that
+ * output_frames has reset the frame data of outputs that stopped */
+static bool video_consumers_idle(void)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_display *display;
+	bool idle = true;
+
+	pthread_mutex_lock(&video->mixes_mutex);
+	for (size_t i = 0; i < video->mixes.num; i++) {
+		struct obs_core_video_mix *mix = video->mixes.array[i];
+
+		if (mix->was_active || os_atomic_load_long(&mix->raw_active) ||
+		    os_atomic_load_long(&mix->gpu_encoder_active)) {
+			idle = false;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&video->mixes_mutex);
+
+	if (!idle)
+		return false;
+
+	pthread_mutex_lock(&obs->data.displays_mutex);
+	for (display = obs->data.first_display; display;
+	     display = display->next) {
+		if (display->swap && display->enabled && !display->occluded) {
+			idle = false;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&obs->data.displays_mutex);
+
+	return idle;
+}
+
+static bool update_idle(struct obs_core_video *video)
+{
+	bool idle = os_atomic_load_bool(&video->idle_rendering) &&
+		    video_consumers_idle();
+
+	if (idle != os_atomic_load_bool(&video->idle)) {
+		blog(LOG_INFO, idle ? "Nothing uses video, rendering paused"
+				    : "Video in use, rendering resumed");
+		os_atomic_set_bool(&video->idle, idle);
+	}
+
+	return idle;
+}
+
+/* waits for the next idle tick unless an output or display starts first */
+static void idle_sleep(struct obs_core_video *video)
+{
+	os_event_timedwait(video->idle_event, 1000 / IDLE_TICK_RATE);
+	video->video_time = os_gettime_ns();
+}
+
 static const char *output_frame_name = "output_frame";
 bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 {
 	/* defer loop break to clean up sources */
-	const bool stop_requested = video_output_stopped(obs->video.video);
+	const bool stop_requested =
+		video_output_stopped(obs->video.main_mix->video);
 
+	const bool idle = update_idle(&obs->video);
 	uint64_t frame_start = os_gettime_ns();
 	uint64_t frame_time_ns;
-	bool raw_active = obs->video.raw_active > 0;
-#ifdef _WIN32
-	const bool gpu_active = obs->video.gpu_encoder_active > 0;
-	const bool active = raw_active || gpu_active;
-#else
-	const bool gpu_active = 0;
-	const bool active = raw_active;
-#endif
-
-	if (!context->was_active && active)
-		clear_base_frame_data();
-	if (!context->raw_was_active && raw_active)
-		clear_raw_frame_data();
-#ifdef _WIN32
-	if (!context->gpu_was_active && gpu_active)
-		clear_gpu_frame_data();
-
-	context->gpu_was_active = gpu_active;
-#endif
-	context->raw_was_active = raw_active;
-	context->was_active = active;
+	uint64_t stage_start, stage_end;
 
 	profile_start(context->video_thread_name);
 
 	gs_enter_context(obs->video.graphics);
 	gs_begin_frame();
 	gs_leave_context();
+	obs->video.render_frame++;
 
+	stage_start = os_gettime_ns();
 	profile_start(tick_sources_name);
 	context->last_time =
 		tick_sources(obs->video.video_time, context->last_time);
 	profile_end(tick_sources_name);
+	stage_end = os_gettime_ns();
+	obs_histogram_observe(&obs->video.tick_hist, stage_end - stage_start);
 
 	execute_graphics_tasks();
+	obs_execute_graphics_commands();
+	obs_gpu_memory_tick();
 
 #ifdef _WIN32
 	MSG msg;
@@ -973,22 +1588,43 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	}
 #endif
 
-	profile_start(output_frame_name);
-	output_frame(raw_active, gpu_active);
-	profile_end(output_frame_name);
-
-	profile_start(render_displays_name);
-	render_displays();
-	profile_end(render_displays_name);
+	stage_start = os_gettime_ns();
+	stage_end = stage_start;
+
+	if (!idle) {
+		profile_start(output_frame_name);
+		output_frames();
+		profile_end(output_frame_name);
+		stage_end = os_gettime_ns();
+		obs_histogram_observe(&obs->video.output_frame_hist,
+				      stage_end - stage_start);
+
+		stage_start = stage_end;
+		profile_start(render_displays_name);
+		render_displays();
+		profile_end(render_displays_name);
+		stage_end = os_gettime_ns();
+		obs_histogram_observe(&obs->video.render_displays_hist,
+				      stage_end - stage_start);
+	}
 
-	frame_time_ns = os_gettime_ns() - frame_start;
+	frame_time_ns = stage_end - frame_start;
+	obs_histogram_observe(&obs->video.frame_time_hist, frame_time_ns);
+	update_render_budget(frame_time_ns);
 
 	profile_end(context->video_thread_name);
 
 	profile_reenable_thread();
 
-	video_sleep(&obs->video, raw_active, gpu_active, &obs->video.video_time,
-		    context->interval);
+	if (idle) {
+		idle_sleep(&obs->video);
+	} else {
+		uint32_t lagged = obs->video.lagged_frames;
+		video_sleep(&obs->video, &obs->video.video_time,
+			    context->interval);
+		record_telemetry(frame_time_ns,
+				 obs->video.lagged_frames - lagged);
+	}
 
 	context->frame_time_total_ns += frame_time_ns;
 	context->fps_total_ns += (obs->video.video_time - context->last_time);
@@ -1019,12 +1655,14 @@ void *obs_graphics_thread(void *param)
 
 	is_graphics_thread = true;
 
-	const uint64_t interval = video_output_get_frame_time(obs->video.video);
+	const uint64_t interval =
+		video_output_get_frame_time(obs->video.main_mix->video);
 
 	obs->video.video_time = os_gettime_ns();
 	obs->video.video_frame_interval_ns = interval;
 
 	os_set_thread_name("libobs: graphics thread");
+	bmem_set_thread_tag(bmem_register_tag("video"));
 
 	const char *video_thread_name = profile_store_name(
 		obs_get_profiler_name_store(),
@@ -1034,16 +1672,11 @@ void *obs_graphics_thread(void *param)
 	srand((unsigned int)time(NULL));
 
 	struct obs_graphics_context context;
-	context.interval = video_output_get_frame_time(obs->video.video);
+	context.interval = interval;
 	context.frame_time_total_ns = 0;
 	context.fps_total_ns = 0;
 	context.fps_total_frames = 0;
 	context.last_time = 0;
-#ifdef _WIN32
-	context.gpu_was_active = false;
-#endif
-	context.raw_was_active = false;
-	context.was_active = false;
 	context.video_thread_name = video_thread_name;
 
 #ifdef __APPLE__
@@ -1060,3 +1693,43 @@ void *obs_graphics_thread(void *param)
 	UNUSED_PARAMETER(param);
 	return NULL;
 }
+
+/* audio-only mode: sources and tasks run as usual but nothing is rendered,
+ * each interval only repeats the cover frame */
+void *obs_audio_only_thread(void *param)
+{
+	struct obs_core_video *video = &obs->video;
+	const uint64_t interval =
+		video_output_get_frame_time(video->cover_video);
+	uint64_t last_time = 0;
+
+	is_graphics_thread = true;
+
+	video->video_time = os_gettime_ns();
+	video->video_frame_interval_ns = interval;
+
+	os_set_thread_name("libobs: audio-only thread");
+
+	while (!video_output_stopped(video->cover_video)) {
+		last_time = tick_sources(video->video_time, last_time);
+		execute_graphics_tasks();
+		obs_execute_graphics_commands();
+
+		obs_output_cover_frame(video->video_time);
+		video->total_frames++;
+
+		video->video_time += interval;
+		if (!os_sleepto_ns(video->video_time)) {
+			uint64_t behind = os_gettime_ns() - video->video_time;
+			uint64_t count = behind / interval;
+
+			video->video_time += count * interval;
+			video->lagged_frames += (uint32_t)count;
+			if (count)
+				profiler_trace_trigger("lagged frame");
+		}
+	}
+
+	UNUSED_PARAMETER(param);
+	return NULL;
+}
@@ -65,6 +65,7 @@ void obs_view_free(struct obs_view *view)
 void obs_view_destroy(obs_view_t *view)
 {
 	if (view) {
+		obs_view_remove(view);
 		obs_view_free(view);
 		bfree(view);
 	}
@@ -145,3 +146,197 @@ void obs_view_render(obs_view_t *view)
 
 	pthread_mutex_unlock(&view->channels_mutex);
 }
+
+video_t *obs_view_add(obs_view_t *view)
+{
+	struct obs_core_video_mix *main_mix = obs->video.main_mix;
+
+	if (!main_mix)
+		return NULL;
+
+	return obs_view_add2(view, &main_mix->ovi);
+}
+
+video_t *obs_view_add2(obs_view_t *view, struct obs_video_info *ovi)
+{
+	struct obs_core_video_mix *main_mix = obs->video.main_mix;
+	struct obs_core_video_mix *mix;
+	struct obs_video_info canvas;
+	int errorcode;
+
+	if (!view || !ovi || !main_mix)
+		return NULL;
+	if (view == &obs->data.main_view)
+		return main_mix->video;
+
+	obs_view_remove(view);
+
+	/* all canvases are rendered on the same graphics tick, so they can
+	 * only ever run at the main canvas' frame rate */
+	canvas = *ovi;
+	canvas.fps_num = main_mix->ovi.fps_num;
+	canvas.fps_den = main_mix->ovi.fps_den;
+	canvas.graphics_module = main_mix->ovi.graphics_module;
+	canvas.adapter = main_mix->ovi.adapter;
+
+	/* align to multiple-of-two and SSE alignment sizes */
+	canvas.output_width &= 0xFFFFFFFC;
+	canvas.output_height &= 0xFFFFFFFE;
+
+	mix = bzalloc(sizeof(struct obs_core_video_mix));
+	errorcode = obs_init_video_mix(mix, view, &canvas);
+	if (errorcode != OBS_VIDEO_SUCCESS) {
+		blog(LOG_WARNING, "obs_view_add2: Failed to create canvas (%d)",
+		     errorcode);
+		obs_free_video_mix(mix);
+		return NULL;
+	}
+
+	blog(LOG_INFO, "added canvas: base %ux%u, output %ux%u, format %s",
+	     canvas.base_width, canvas.base_height, canvas.output_width,
+	     canvas.output_height,
+	     get_video_format_name(canvas.output_format));
+
+	pthread_mutex_lock(&obs->video.mixes_mutex);
+	da_push_back(obs->video.mixes, &mix);
+	pthread_mutex_unlock(&obs->video.mixes_mutex);
+
+	return mix->video;
+}
+
+void obs_view_remove(obs_view_t *view)
+{
+	struct obs_core_video_mix *mix = NULL;
+
+	if (!view || !obs)
+		return;
+
+	pthread_mutex_lock(&obs->video.mixes_mutex);
+	for (size_t i = 0; i < obs->video.mixes.num; i++) {
+		struct obs_core_video_mix *cur = obs->video.mixes.array[i];
+
+		if (cur->view == view && cur != obs->video.main_mix &&
+		    !cur->source_mix) {
+			mix = cur;
+			da_erase(obs->video.mixes, i);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&obs->video.mixes_mutex);
+
+	if (!mix)
+		return;
+
+	if (os_atomic_load_long(&mix->raw_active) > 0 ||
+	    os_atomic_load_long(&mix->gpu_encoder_active) > 0)
+		blog(LOG_WARNING, "obs_view_remove: Canvas removed while "
+				  "outputs or encoders were still using it");
+
+	obs_free_video_mix(mix);
+}
+
+video_t *obs_get_scaled_video(video_t *video, uint32_t width, uint32_t height)
+{
+	struct obs_core_video_mix *main_mix = obs->video.main_mix;
+	struct obs_core_video_mix *mix = NULL;
+	struct obs_video_info ovi;
+	int errorcode;
+
+	/* only the main canvas renders every tick regardless of its outputs,
+	 * and canvas sizes have to keep their alignment */
+	if (!main_mix || video != main_mix->video)
+		return NULL;
+	if ((width & 3) != 0 || (height & 1) != 0)
+		return NULL;
+
+	pthread_mutex_lock(&obs->video.mixes_mutex);
+	for (size_t i = 0; i < obs->video.mixes.num; i++) {
+		struct obs_core_video_mix *cur = obs->video.mixes.array[i];
+
+		if (cur->source_mix == main_mix &&
+		    cur->output_width == width &&
+		    cur->output_height == height) {
+			os_atomic_inc_long(&cur->scaled_refs);
+			mix = cur;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&obs->video.mixes_mutex);
+
+	if (mix)
+		return mix->video;
+
+	ovi = main_mix->ovi;
+	ovi.output_width = width;
+	ovi.output_height = height;
+
+	mix = bzalloc(sizeof(struct obs_core_video_mix));
+	errorcode = obs_init_video_mix(mix, &obs->data.main_view, &ovi);
+	if (errorcode != OBS_VIDEO_SUCCESS) {
+		blog(LOG_WARNING,
+		     "obs_get_scaled_video: Failed to create %ux%u canvas (%d)",
+		     width, height, errorcode);
+		obs_free_video_mix(mix);
+		return NULL;
+	}
+
+	mix->source_mix = main_mix;
+	mix->scaled_refs = 1;
+
+	blog(LOG_INFO, "added scaled canvas: output %ux%u", width, height);
+
+	/* appended after the main canvas, so the render texture it scales is
+	 * always up to date when it renders */
+	pthread_mutex_lock(&obs->video.mixes_mutex);
+	da_push_back(obs->video.mixes, &mix);
+	pthread_mutex_unlock(&obs->video.mixes_mutex);
+
+	return mix->video;
+}
+
+void obs_release_scaled_video(video_t *scaled)
+{
+	struct obs_core_video_mix *mix = NULL;
+
+	if (!scaled)
+		return;
+
+	pthread_mutex_lock(&obs->video.mixes_mutex);
+	for (size_t i = 0; i < obs->video.mixes.num; i++) {
+		struct obs_core_video_mix *cur = obs->video.mixes.array[i];
+
+		if (cur->video == scaled && cur->source_mix) {
+			if (os_atomic_dec_long(&cur->scaled_refs) == 0) {
+				mix = cur;
+				da_erase(obs->video.mixes, i);
+			}
+			break;
+		}
+	}
+	pthread_mutex_unlock(&obs->video.mixes_mutex);
+
+	if (mix)
+		obs_free_video_mix(mix);
+}
+
+bool obs_view_get_video_info(obs_view_t *view, struct obs_video_info *ovi)
+{
+	bool found = false;
+
+	if (!view || !ovi)
+		return false;
+
+	pthread_mutex_lock(&obs->video.mixes_mutex);
+	for (size_t i = 0; i < obs->video.mixes.num; i++) {
+		struct obs_core_video_mix *mix = obs->video.mixes.array[i];
+
+		if (mix->view == view) {
+			*ovi = mix->ovi;
+			found = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&obs->video.mixes_mutex);
+
+	return found;
+}
@@ -42,10 +42,10 @@ static inline void make_video_info(struct video_output_info *vi,
 	vi->cache_size = 6;
 }
 
-static inline void calc_gpu_conversion_sizes(const struct obs_video_info *ovi)
+static inline void
+calc_gpu_conversion_sizes(struct obs_core_video_mix *video,
+			  const struct obs_video_info *ovi)
 {
-	struct obs_core_video *video = &obs->video;
-
 	video->conversion_needed = false;
 	video->conversion_techs[0] = NULL;
 	video->conversion_techs[1] = NULL;
@@ -72,14 +72,40 @@ static inline void calc_gpu_conversion_sizes(const struct obs_video_info *ovi)
 		video->conversion_techs[1] = "Planar_U";
 		video->conversion_techs[2] = "Planar_V";
 		break;
+	case VIDEO_FORMAT_I010:
+		video->conversion_needed = true;
+		video->conversion_techs[0] = "I010_Y";
+		video->conversion_techs[1] = "I010_U";
+		video->conversion_techs[2] = "I010_V";
+		video->conversion_width_i = 1.f / (float)ovi->output_width;
+		break;
+	case VIDEO_FORMAT_P010:
+		video->conversion_needed = true;
+		video->conversion_techs[0] = "P010_Y";
+		video->conversion_techs[1] = "P010_UV";
+		video->conversion_width_i = 1.f / (float)ovi->output_width;
+		break;
 	}
 }
 
-static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
+/* the 10-bit formats keep each sample in 16 bits */
+static inline enum gs_color_format
+get_luma_plane_format(enum video_format format)
 {
-	struct obs_core_video *video = &obs->video;
+	switch (format) {
+	case VIDEO_FORMAT_I010:
+	case VIDEO_FORMAT_P010:
+		return GS_R16;
+	default:
+		return GS_R8;
+	}
+}
+
+static bool obs_init_gpu_conversion(struct obs_core_video_mix *video)
+{
+	const struct obs_video_info *ovi = &video->ovi;
 
-	calc_gpu_conversion_sizes(ovi);
+	calc_gpu_conversion_sizes(video, ovi);
 
 	video->using_nv12_tex = ovi->output_format == VIDEO_FORMAT_NV12
 					? gs_nv12_available()
@@ -107,12 +133,14 @@ static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
 				       GS_RENDER_TARGET | GS_SHARED_KM_TEX);
 	} else {
 #endif
-		video->convert_textures[0] =
-			gs_texture_create(ovi->output_width, ovi->output_height,
-					  GS_R8, 1, NULL, GS_RENDER_TARGET);
-
 		const struct video_output_info *info =
 			video_output_get_info(video->video);
+
+		video->convert_textures[0] = gs_texture_create(
+			ovi->output_width, ovi->output_height,
+			get_luma_plane_format(info->format), 1, NULL,
+			GS_RENDER_TARGET);
+
 		switch (info->format) {
 		case VIDEO_FORMAT_I420:
 			video->convert_textures[1] = gs_texture_create(
@@ -139,6 +167,21 @@ static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
 			if (!video->convert_textures[2])
 				return false;
 			break;
+		case VIDEO_FORMAT_I010:
+			video->convert_textures[1] = gs_texture_create(
+				ovi->output_width / 2, ovi->output_height / 2,
+				GS_R16, 1, NULL, GS_RENDER_TARGET);
+			video->convert_textures[2] = gs_texture_create(
+				ovi->output_width / 2, ovi->output_height / 2,
+				GS_R16, 1, NULL, GS_RENDER_TARGET);
+			if (!video->convert_textures[2])
+				return false;
+			break;
+		case VIDEO_FORMAT_P010:
+			video->convert_textures[1] = gs_texture_create(
+				ovi->output_width / 2, ovi->output_height / 2,
+				GS_RG16, 1, NULL, GS_RENDER_TARGET);
+			break;
 		default:
 			break;
 		}
@@ -154,42 +197,60 @@ static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
 	return true;
 }
 
-static bool obs_init_gpu_copy_surfaces(struct obs_video_info *ovi, size_t i)
+static bool obs_init_gpu_copy_surfaces(struct obs_core_video_mix *video,
+				       gs_stagesurf_t **surfaces)
 {
-	struct obs_core_video *video = &obs->video;
+	const struct obs_video_info *ovi = &video->ovi;
+	const struct video_output_info *info =
+		video_output_get_info(video->video);
 
-	video->copy_surfaces[i][0] = gs_stagesurface_create(
-		ovi->output_width, ovi->output_height, GS_R8);
-	if (!video->copy_surfaces[i][0])
+	surfaces[0] = gs_stagesurface_create(
+		ovi->output_width, ovi->output_height,
+		get_luma_plane_format(info->format));
+	if (!surfaces[0])
 		return false;
 
-	const struct video_output_info *info =
-		video_output_get_info(video->video);
 	switch (info->format) {
 	case VIDEO_FORMAT_I420:
-		video->copy_surfaces[i][1] = gs_stagesurface_create(
+		surfaces[1] = gs_stagesurface_create(
 			ovi->output_width / 2, ovi->output_height / 2, GS_R8);
-		if (!video->copy_surfaces[i][1])
+		if (!surfaces[1])
 			return false;
-		video->copy_surfaces[i][2] = gs_stagesurface_create(
+		surfaces[2] = gs_stagesurface_create(
 			ovi->output_width / 2, ovi->output_height / 2, GS_R8);
-		if (!video->copy_surfaces[i][2])
+		if (!surfaces[2])
 			return false;
 		break;
 	case VIDEO_FORMAT_NV12:
-		video->copy_surfaces[i][1] = gs_stagesurface_create(
+		surfaces[1] = gs_stagesurface_create(
 			ovi->output_width / 2, ovi->output_height / 2, GS_R8G8);
-		if (!video->copy_surfaces[i][1])
+		if (!surfaces[1])
 			return false;
 		break;
 	case VIDEO_FORMAT_I444:
-		video->copy_surfaces[i][1] = gs_stagesurface_create(
+		surfaces[1] = gs_stagesurface_create(
 			ovi->output_width, ovi->output_height, GS_R8);
-		if (!video->copy_surfaces[i][1])
+		if (!surfaces[1])
 			return false;
-		video->copy_surfaces[i][2] = gs_stagesurface_create(
+		surfaces[2] = gs_stagesurface_create(
 			ovi->output_width, ovi->output_height, GS_R8);
-		if (!video->copy_surfaces[i][2])
+		if (!surfaces[2])
+			return false;
+		break;
+	case VIDEO_FORMAT_I010:
+		surfaces[1] = gs_stagesurface_create(
+			ovi->output_width / 2, ovi->output_height / 2, GS_R16);
+		if (!surfaces[1])
+			return false;
+		surfaces[2] = gs_stagesurface_create(
+			ovi->output_width / 2, ovi->output_height / 2, GS_R16);
+		if (!surfaces[2])
+			return false;
+		break;
+	case VIDEO_FORMAT_P010:
+		surfaces[1] = gs_stagesurface_create(
+			ovi->output_width / 2, ovi->output_height / 2, GS_RG16);
+		if (!surfaces[1])
 			return false;
 		break;
 	default:
@@ -199,35 +260,34 @@ static bool obs_init_gpu_copy_surfaces(struct obs_video_info *ovi, size_t i)
 	return true;
 }
 
-static bool obs_init_textures(struct obs_video_info *ovi)
+bool obs_create_copy_surfaces(struct obs_core_video_mix *video,
+			      gs_stagesurf_t **surfaces)
 {
-	struct obs_core_video *video = &obs->video;
+	const struct obs_video_info *ovi = &video->ovi;
 
-	for (size_t i = 0; i < NUM_TEXTURES; i++) {
 #ifdef _WIN32
-		if (video->using_nv12_tex) {
-			video->copy_surfaces[i][0] =
-				gs_stagesurface_create_nv12(ovi->output_width,
-							    ovi->output_height);
-			if (!video->copy_surfaces[i][0])
-				return false;
-
-		} else {
-#endif
-			if (video->gpu_conversion) {
-				if (!obs_init_gpu_copy_surfaces(ovi, i))
-					return false;
-			} else {
-				video->copy_surfaces[i][0] =
-					gs_stagesurface_create(
-						ovi->output_width,
-						ovi->output_height, GS_RGBA);
-				if (!video->copy_surfaces[i][0])
-					return false;
-			}
-#ifdef _WIN32
-		}
+	if (video->using_nv12_tex) {
+		surfaces[0] = gs_stagesurface_create_nv12(ovi->output_width,
+							  ovi->output_height);
+		return surfaces[0] != NULL;
+	}
 #endif
+
+	if (video->gpu_conversion)
+		return obs_init_gpu_copy_surfaces(video, surfaces);
+
+	surfaces[0] = gs_stagesurface_create(ovi->output_width,
+					     ovi->output_height, GS_RGBA);
+	return surfaces[0] != NULL;
+}
+
+static bool obs_init_textures(struct obs_core_video_mix *video)
+{
+	const struct obs_video_info *ovi = &video->ovi;
+
+	for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		if (!obs_create_copy_surfaces(video, video->copy_surfaces[i]))
+			return false;
 	}
 
 	video->render_texture = gs_texture_create(ovi->base_width,
@@ -258,6 +318,21 @@ gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file)
 	return *effect;
 }
 
+#ifdef _WIN32
+static void obs_device_loss_release(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static void obs_device_loss_rebuild(void *device, void *data)
+{
+	struct obs_core_video *video = data;
+	os_atomic_inc_long(&video->device_rebuilds);
+
+	UNUSED_PARAMETER(device);
+}
+#endif
+
 static int obs_init_graphics(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
@@ -282,6 +357,23 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 
 	gs_enter_context(video->graphics);
 
+	if (obs->module_config_path) {
+		struct dstr cache_path = {0};
+		dstr_copy(&cache_path, obs->module_config_path);
+		dstr_cat(&cache_path, "/libobs/shader-cache");
+		gs_set_shader_cache_path(cache_path.array);
+		dstr_free(&cache_path);
+	}
+
+#ifdef _WIN32
+	struct gs_device_loss callbacks = {
+		.device_loss_release = obs_device_loss_release,
+		.device_loss_rebuild = obs_device_loss_rebuild,
+		.data = video,
+	};
+	gs_register_loss_callbacks(&callbacks);
+#endif
+
 	char *filename = obs_find_data_file("default.effect");
 	video->default_effect = gs_effect_create_from_file(filename, NULL);
 	bfree(filename);
@@ -360,8 +452,8 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 	return success ? OBS_VIDEO_SUCCESS : OBS_VIDEO_FAIL;
 }
 
-static inline void set_video_matrix(struct obs_core_video *video,
-				    struct obs_video_info *ovi)
+static inline void set_video_matrix(struct obs_core_video_mix *video,
+				    const struct obs_video_info *ovi)
 {
 	struct matrix4 mat;
 	struct vec4 r_row;
@@ -382,14 +474,36 @@ static inline void set_video_matrix(struct obs_core_video *video,
 	memcpy(video->color_matrix, &mat, sizeof(float) * 16);
 }
 
-static int obs_init_video(struct obs_video_info *ovi)
+#define OBS_SIZE_MIN 2
+#define OBS_SIZE_MAX (32 * 1024)
+
+/* SCHED_FIFO priorities for obs_set_realtime_threads, a late audio tick is
+ * audible while a late frame is at worst a repeated one */
+#define AUDIO_THREAD_RT_PRIORITY 20
+#define GRAPHICS_THREAD_RT_PRIORITY 10
+
+static inline bool size_valid(uint32_t width, uint32_t height)
+{
+	return (width >= OBS_SIZE_MIN && height >= OBS_SIZE_MIN &&
+		width <= OBS_SIZE_MAX && height <= OBS_SIZE_MAX);
+}
+
+int obs_init_video_mix(struct obs_core_video_mix *video,
+		       struct obs_view *view, const struct obs_video_info *ovi)
 {
-	struct obs_core_video *video = &obs->video;
 	struct video_output_info vi;
-	pthread_mutexattr_t attr;
 	int errorcode;
 
-	make_video_info(&vi, ovi);
+	pthread_mutex_init_value(&video->gpu_encoder_mutex);
+
+	if (!size_valid(ovi->output_width, ovi->output_height) ||
+	    !size_valid(ovi->base_width, ovi->base_height))
+		return OBS_VIDEO_INVALID_PARAM;
+
+	video->view = view;
+	video->ovi = *ovi;
+
+	make_video_info(&vi, &video->ovi);
 	video->base_width = ovi->base_width;
 	video->base_height = ovi->base_height;
 	video->output_width = ovi->output_width;
@@ -399,6 +513,9 @@ static int obs_init_video(struct obs_video_info *ovi)
 
 	set_video_matrix(video, ovi);
 
+	if (pthread_mutex_init(&video->gpu_encoder_mutex, NULL) < 0)
+		return OBS_VIDEO_FAIL;
+
 	errorcode = video_output_open(&video->video, &vi);
 
 	if (errorcode != VIDEO_OUTPUT_SUCCESS) {
@@ -411,23 +528,51 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 	}
 
-	gs_enter_context(video->graphics);
+	if (obs->thread_affinity)
+		video_output_set_thread_affinity(video->video,
+						 obs->thread_affinity);
 
-	if (ovi->gpu_conversion && !obs_init_gpu_conversion(ovi))
-		return OBS_VIDEO_FAIL;
-	if (!obs_init_textures(ovi))
-		return OBS_VIDEO_FAIL;
+	gs_enter_context(obs->video.graphics);
+
+	bool success = true;
+	if (ovi->gpu_conversion && !obs_init_gpu_conversion(video))
+		success = false;
+	if (success && !obs_init_textures(video))
+		success = false;
 
 	gs_leave_context();
 
+	return success ? OBS_VIDEO_SUCCESS : OBS_VIDEO_FAIL;
+}
+
+static int obs_init_video(struct obs_video_info *ovi)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_core_video_mix *mix;
+	pthread_mutexattr_t attr;
+	int errorcode;
+
+	mix = bzalloc(sizeof(struct obs_core_video_mix));
+	errorcode = obs_init_video_mix(mix, &obs->data.main_view, ovi);
+	if (errorcode != OBS_VIDEO_SUCCESS) {
+		obs_free_video_mix(mix);
+		return errorcode;
+	}
+
+	pthread_mutex_lock(&video->mixes_mutex);
+	video->main_mix = mix;
+	da_insert(video->mixes, 0, &mix);
+	pthread_mutex_unlock(&video->mixes_mutex);
+
 	if (pthread_mutexattr_init(&attr) != 0)
 		return OBS_VIDEO_FAIL;
 	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
 		return OBS_VIDEO_FAIL;
-	if (pthread_mutex_init(&video->gpu_encoder_mutex, NULL) < 0)
-		return OBS_VIDEO_FAIL;
 	if (pthread_mutex_init(&video->task_mutex, NULL) < 0)
 		return OBS_VIDEO_FAIL;
+	if (!obs_tick_pool_init(&video->tick_pool))
+		blog(LOG_WARNING, "Failed to create source tick pool, "
+				  "sources will be ticked serially");
 
 #ifdef __APPLE__
 	errorcode = pthread_create(&video->video_thread, NULL,
@@ -440,36 +585,89 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 
 	video->thread_initialized = true;
-	video->ovi = *ovi;
+	obs_graphics_commands_set_active(&video->commands, true);
+
+	if (obs->thread_affinity)
+		os_set_thread_affinity(video->video_thread,
+				       obs->thread_affinity);
+	if (obs->realtime_threads)
+		os_set_thread_realtime(video->video_thread,
+				       GRAPHICS_THREAD_RT_PRIORITY);
+
+	return OBS_VIDEO_SUCCESS;
+}
+
+static int obs_init_video_audio_only(struct obs_video_info *ovi,
+				     const char *image_path)
+{
+	struct obs_core_video *video = &obs->video;
+	int errorcode;
+
+	errorcode = obs_init_cover_video(ovi, image_path);
+	if (errorcode != OBS_VIDEO_SUCCESS)
+		return errorcode;
+
+	if (pthread_mutex_init(&video->task_mutex, NULL) < 0)
+		return OBS_VIDEO_FAIL;
+	if (!obs_tick_pool_init(&video->tick_pool))
+		blog(LOG_WARNING, "Failed to create source tick pool, "
+				  "sources will be ticked serially");
+
+	errorcode = pthread_create(&video->video_thread, NULL,
+				   obs_audio_only_thread, obs);
+	if (errorcode != 0)
+		return OBS_VIDEO_FAIL;
+
+	video->thread_initialized = true;
+	obs_graphics_commands_set_active(&video->commands, true);
+
+	if (obs->thread_affinity)
+		os_set_thread_affinity(video->video_thread,
+				       obs->thread_affinity);
+
 	return OBS_VIDEO_SUCCESS;
 }
 
 static void stop_video(void)
 {
 	struct obs_core_video *video = &obs->video;
+	video_t *output = video->main_mix ? video->main_mix->video
+					  : video->cover_video;
 	void *thread_retval;
 
-	if (video->video) {
-		video_output_stop(video->video);
+	if (output) {
+		video_output_stop(output);
+		obs_video_wake();
 		if (video->thread_initialized) {
 			pthread_join(video->video_thread, &thread_retval);
 			video->thread_initialized = false;
 		}
 	}
+
+	/* nothing pops the queue until the graphics thread restarts */
+	obs_graphics_commands_set_active(&video->commands, false);
+	obs_execute_graphics_commands();
+
+	obs_tick_pool_free(&video->tick_pool);
 }
 
-static void obs_free_video(void)
+void obs_free_video_mix(struct obs_core_video_mix *video)
 {
-	struct obs_core_video *video = &obs->video;
+	if (!video)
+		return;
+
+	obs_task_group_destroy(video->output_group);
+	video->output_group = NULL;
+	obs_task_group_destroy(video->copy_group);
+	video->copy_group = NULL;
 
 	if (video->video) {
 		video_output_close(video->video);
 		video->video = NULL;
+	}
 
-		if (!video->graphics)
-			return;
-
-		gs_enter_context(video->graphics);
+	if (obs->video.graphics) {
+		gs_enter_context(obs->video.graphics);
 
 		for (size_t c = 0; c < NUM_CHANNELS; c++) {
 			if (video->mapped_surfaces[c]) {
@@ -489,6 +687,22 @@ static void obs_free_video(void)
 			}
 		}
 
+		/* the video output released every held frame when it closed */
+		for (size_t i = 0; i < NUM_HELD_FRAMES; i++) {
+			struct obs_held_frame *held = &video->held_frames[i];
+
+			for (size_t c = 0; c < NUM_CHANNELS; c++) {
+				if (!held->surfaces[c])
+					continue;
+				if (held->held)
+					gs_stagesurface_unmap(
+						held->surfaces[c]);
+				gs_stagesurface_destroy(held->surfaces[c]);
+				held->surfaces[c] = NULL;
+			}
+			held->held = false;
+		}
+
 		gs_texture_destroy(video->render_texture);
 
 		for (size_t c = 0; c < NUM_CHANNELS; c++) {
@@ -498,41 +712,61 @@ static void obs_free_video(void)
 			}
 		}
 
-		for (size_t i = 0; i < NUM_TEXTURES; i++) {
-			for (size_t c = 0; c < NUM_CHANNELS; c++) {
-				if (video->copy_surfaces[i][c]) {
-					gs_stagesurface_destroy(
-						video->copy_surfaces[i][c]);
-					video->copy_surfaces[i][c] = NULL;
-				}
-			}
-		}
-
 		gs_texture_destroy(video->output_texture);
 		video->render_texture = NULL;
 		video->output_texture = NULL;
 
 		gs_leave_context();
+	}
 
-		circlebuf_free(&video->vframe_info_buffer);
-		circlebuf_free(&video->vframe_info_buffer_gpu);
+	circlebuf_free(&video->vframe_info_buffer);
+	circlebuf_free(&video->vframe_info_buffer_gpu);
 
-		video->texture_rendered = false;
-		memset(video->textures_copied, 0,
-		       sizeof(video->textures_copied));
-		video->texture_converted = false;
+	pthread_mutex_destroy(&video->gpu_encoder_mutex);
+	da_free(video->gpu_encoders);
 
-		pthread_mutex_destroy(&video->gpu_encoder_mutex);
-		pthread_mutex_init_value(&video->gpu_encoder_mutex);
-		da_free(video->gpu_encoders);
+	bfree(video);
+}
+
+static void obs_free_video(void)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_core_video_mix *mix = video->main_mix;
+
+	if (!mix && !video->cover_video)
+		return;
 
-		pthread_mutex_destroy(&video->task_mutex);
-		pthread_mutex_init_value(&video->task_mutex);
-		circlebuf_free(&video->tasks);
+	if (mix) {
+		pthread_mutex_lock(&video->mixes_mutex);
+		da_erase_item(video->mixes, &mix);
+		video->main_mix = NULL;
+		pthread_mutex_unlock(&video->mixes_mutex);
 
-		video->gpu_encoder_active = 0;
-		video->cur_texture = 0;
+		obs_free_video_mix(mix);
 	}
+
+	obs_free_cover_video();
+
+	pthread_mutex_destroy(&video->task_mutex);
+	pthread_mutex_init_value(&video->task_mutex);
+	circlebuf_free(&video->tasks);
+}
+
+static void obs_free_video_mixes(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	if (video->mixes.num)
+		blog(LOG_WARNING, "%d canvas(es) were remaining",
+		     (int)video->mixes.num);
+
+	for (size_t i = 0; i < video->mixes.num; i++)
+		obs_free_video_mix(video->mixes.array[i]);
+
+	da_free(video->mixes);
+	pthread_mutex_destroy(&video->mixes_mutex);
+	os_event_destroy(video->idle_event);
+	video->idle_event = NULL;
 }
 
 static void obs_free_graphics(void)
@@ -542,6 +776,10 @@ static void obs_free_graphics(void)
 	if (video->graphics) {
 		gs_enter_context(video->graphics);
 
+#ifdef _WIN32
+		gs_unregister_loss_callbacks(video);
+#endif
+
 		gs_texture_destroy(video->transparent_texture);
 
 		gs_samplerstate_destroy(video->point_sampler);
@@ -558,6 +796,9 @@ static void obs_free_graphics(void)
 		gs_effect_destroy(video->bilinear_lowres_effect);
 		video->default_effect = NULL;
 
+		obs_free_fused_effects();
+		obs_gpu_timing_free();
+
 		gs_leave_context();
 
 		gs_destroy(video->graphics);
@@ -586,10 +827,23 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
 
+	if (!obs_audio_pool_init(&audio->pool))
+		blog(LOG_WARNING, "Failed to create audio pool, audio filters "
+				  "will run on the threads of their sources");
+	if (!obs_meter_service_init(&audio->meters))
+		blog(LOG_WARNING, "Failed to create volume meter thread, "
+				  "meters will run on the audio thread");
+
 	errorcode = audio_output_open(&audio->audio, ai);
-	if (errorcode == AUDIO_OUTPUT_SUCCESS)
+	if (errorcode == AUDIO_OUTPUT_SUCCESS) {
+		if (obs->thread_affinity)
+			audio_output_set_thread_affinity(audio->audio,
+							 obs->thread_affinity);
+		if (obs->realtime_threads)
+			audio_output_set_thread_realtime(
+				audio->audio, AUDIO_THREAD_RT_PRIORITY);
 		return true;
-	else if (errorcode == AUDIO_OUTPUT_INVALIDPARAM)
+	} else if (errorcode == AUDIO_OUTPUT_INVALIDPARAM)
 		blog(LOG_ERROR, "Invalid audio parameters specified");
 	else
 		blog(LOG_ERROR, "Could not open audio output");
@@ -603,6 +857,9 @@ static void obs_free_audio(void)
 	if (audio->audio)
 		audio_output_close(audio->audio);
 
+	obs_audio_pool_free(&audio->pool);
+	obs_meter_service_free(&audio->meters);
+
 	circlebuf_free(&audio->buffered_timestamps);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
@@ -647,6 +904,7 @@ static bool obs_init_data(void)
 		goto fail;
 
 	data->private_data = obs_data_create();
+	data->warm_source_limit = DEFAULT_WARM_SOURCE_LIMIT;
 	data->valid = true;
 
 fail:
@@ -694,6 +952,11 @@ static void obs_free_data(void)
 	FREE_OBS_LINKED_LIST(display);
 	FREE_OBS_LINKED_LIST(service);
 
+	bfree(data->source_index.buckets);
+	bfree(data->output_index.buckets);
+	bfree(data->encoder_index.buckets);
+	bfree(data->service_index.buckets);
+
 	pthread_mutex_destroy(&data->sources_mutex);
 	pthread_mutex_destroy(&data->audio_sources_mutex);
 	pthread_mutex_destroy(&data->displays_mutex);
@@ -851,8 +1114,30 @@ static bool obs_init(const char *locale, const char *module_config_path,
 	obs = bzalloc(sizeof(struct obs_core));
 
 	pthread_mutex_init_value(&obs->audio.monitoring_mutex);
-	pthread_mutex_init_value(&obs->video.gpu_encoder_mutex);
 	pthread_mutex_init_value(&obs->video.task_mutex);
+	pthread_mutex_init_value(&obs->video.mixes_mutex);
+
+	if (!obs_graphics_commands_init(&obs->video.commands))
+		return false;
+	if (pthread_mutex_init(&obs->video.mixes_mutex, NULL) != 0)
+		return false;
+	if (os_event_init(&obs->video.idle_event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+	if (!obs_task_pool_init(&obs->task_pool))
+		return false;
+	if (!obs_frame_arena_init(&obs->frame_arena))
+		return false;
+	if (!obs_packet_pool_init(&obs->packet_pool))
+		return false;
+	obs->encoder_mem_tag = bmem_register_tag("encoders");
+	if (!obs_image_cache_init(&obs->image_cache))
+		return false;
+	if (!obs_gpu_memory_init(&obs->gpu_memory))
+		return false;
+	if (!obs_master_clock_init(&obs->master_clock))
+		return false;
+	if (!obs_offline_clock_init(&obs->offline_clock))
+		return false;
 
 	obs->name_store_owned = !store;
 	obs->name_store = store ? store : profiler_name_store_create();
@@ -1039,8 +1324,17 @@ void obs_shutdown(void)
 	obs_free_audio();
 	obs_free_data();
 	obs_free_video();
+	obs_free_video_mixes();
 	obs_free_hotkeys();
+	obs_image_cache_free(&obs->image_cache);
+	obs_gpu_memory_free(&obs->gpu_memory);
+	obs_task_pool_free(&obs->task_pool);
+	obs_graphics_commands_free(&obs->video.commands);
 	obs_free_graphics();
+	obs_frame_arena_free(&obs->frame_arena);
+	obs_packet_pool_free(&obs->packet_pool);
+	obs_master_clock_free(&obs->master_clock);
+	obs_offline_clock_free(&obs->offline_clock);
 	proc_handler_destroy(obs->procs);
 	signal_handler_destroy(obs->signals);
 	obs->procs = NULL;
@@ -1054,6 +1348,7 @@ void obs_shutdown(void)
 		profiler_name_store_free(obs->name_store);
 
 	bfree(obs->module_config_path);
+	bfree(obs->thread_affinity);
 	bfree(obs->locale);
 	bfree(obs);
 	obs = NULL;
@@ -1102,22 +1397,13 @@ const char *obs_get_locale(void)
 	return obs->locale;
 }
 
-#define OBS_SIZE_MIN 2
-#define OBS_SIZE_MAX (32 * 1024)
-
-static inline bool size_valid(uint32_t width, uint32_t height)
-{
-	return (width >= OBS_SIZE_MIN && height >= OBS_SIZE_MIN &&
-		width <= OBS_SIZE_MAX && height <= OBS_SIZE_MAX);
-}
-
 int obs_reset_video(struct obs_video_info *ovi)
 {
 	if (!obs)
 		return OBS_VIDEO_FAIL;
 
 	/* don't allow changing of video settings if active. */
-	if (obs->video.video && obs_video_active())
+	if (obs_video_active())
 		return OBS_VIDEO_CURRENTLY_ACTIVE;
 
 	if (!size_valid(ovi->output_width, ovi->output_height) ||
@@ -1185,6 +1471,41 @@ int obs_reset_video(struct obs_video_info *ovi)
 	return obs_init_video(ovi);
 }
 
+int obs_reset_video_audio_only(struct obs_video_info *ovi,
+			       const char *image_path)
+{
+	if (!obs)
+		return OBS_VIDEO_FAIL;
+
+	if (obs_video_active())
+		return OBS_VIDEO_CURRENTLY_ACTIVE;
+
+	if (!size_valid(ovi->output_width, ovi->output_height))
+		return OBS_VIDEO_INVALID_PARAM;
+
+	stop_video();
+	obs_free_video();
+
+	ovi->output_width &= 0xFFFFFFFC;
+	ovi->output_height &= 0xFFFFFFFE;
+	ovi->output_format = VIDEO_FORMAT_NV12;
+	if (!size_valid(ovi->base_width, ovi->base_height)) {
+		ovi->base_width = ovi->output_width;
+		ovi->base_height = ovi->output_height;
+	}
+
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO,
+	     "video settings reset (audio-only):\n"
+	     "\toutput resolution: %dx%d\n"
+	     "\tfps:               %d/%d\n"
+	     "\tcover image:       %s",
+	     ovi->output_width, ovi->output_height, ovi->fps_num, ovi->fps_den,
+	     image_path && *image_path ? image_path : "(none)");
+
+	return obs_init_video_audio_only(ovi, image_path);
+}
+
 bool obs_reset_audio(const struct obs_audio_info *oai)
 {
 	struct audio_output_info ai;
@@ -1217,10 +1538,14 @@ bool obs_get_video_info(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
 
-	if (!video->graphics)
+	if (video->cover_video) {
+		*ovi = video->cover_ovi;
+		return true;
+	}
+	if (!video->graphics || !video->main_mix)
 		return false;
 
-	*ovi = video->ovi;
+	*ovi = video->main_mix->ovi;
 	return true;
 }
 
@@ -1241,6 +1566,8 @@ bool obs_get_audio_info(struct obs_audio_info *oai)
 
 bool obs_enum_source_types(size_t idx, const char **id)
 {
+	if (idx == 0)
+		obs_load_deferred_modules();
 	if (idx >= obs->source_types.num)
 		return false;
 	*id = obs->source_types.array[idx].id;
@@ -1249,6 +1576,8 @@ bool obs_enum_source_types(size_t idx, const char **id)
 
 bool obs_enum_input_types(size_t idx, const char **id)
 {
+	if (idx == 0)
+		obs_load_deferred_modules();
 	if (idx >= obs->input_types.num)
 		return false;
 	*id = obs->input_types.array[idx].id;
@@ -1258,6 +1587,8 @@ bool obs_enum_input_types(size_t idx, const char **id)
 bool obs_enum_input_types2(size_t idx, const char **id,
 			   const char **unversioned_id)
 {
+	if (idx == 0)
+		obs_load_deferred_modules();
 	if (idx >= obs->input_types.num)
 		return false;
 	if (id)
@@ -1275,6 +1606,8 @@ const char *obs_get_latest_input_type_id(const char *unversioned_id)
 	if (!unversioned_id)
 		return NULL;
 
+	obs_load_module_for_type(unversioned_id);
+
 	for (size_t i = 0; i < obs->source_types.num; i++) {
 		struct obs_source_info *info = &obs->source_types.array[i];
 		if (strcmp(info->unversioned_id, unversioned_id) == 0 &&
@@ -1293,6 +1626,8 @@ const char *obs_get_latest_input_type_id(const char *unversioned_id)
 
 bool obs_enum_filter_types(size_t idx, const char **id)
 {
+	if (idx == 0)
+		obs_load_deferred_modules();
 	if (idx >= obs->filter_types.num)
 		return false;
 	*id = obs->filter_types.array[idx].id;
@@ -1301,6 +1636,8 @@ bool obs_enum_filter_types(size_t idx, const char **id)
 
 bool obs_enum_transition_types(size_t idx, const char **id)
 {
+	if (idx == 0)
+		obs_load_deferred_modules();
 	if (idx >= obs->transition_types.num)
 		return false;
 	*id = obs->transition_types.array[idx].id;
@@ -1309,6 +1646,8 @@ bool obs_enum_transition_types(size_t idx, const char **id)
 
 bool obs_enum_output_types(size_t idx, const char **id)
 {
+	if (idx == 0)
+		obs_load_deferred_modules();
 	if (idx >= obs->output_types.num)
 		return false;
 	*id = obs->output_types.array[idx].id;
@@ -1317,6 +1656,8 @@ bool obs_enum_output_types(size_t idx, const char **id)
 
 bool obs_enum_encoder_types(size_t idx, const char **id)
 {
+	if (idx == 0)
+		obs_load_deferred_modules();
 	if (idx >= obs->encoder_types.num)
 		return false;
 	*id = obs->encoder_types.array[idx].id;
@@ -1325,6 +1666,8 @@ bool obs_enum_encoder_types(size_t idx, const char **id)
 
 bool obs_enum_service_types(size_t idx, const char **id)
 {
+	if (idx == 0)
+		obs_load_deferred_modules();
 	if (idx >= obs->service_types.num)
 		return false;
 	*id = obs->service_types.array[idx].id;
@@ -1350,7 +1693,8 @@ audio_t *obs_get_audio(void)
 
 video_t *obs_get_video(void)
 {
-	return obs->video.video;
+	return obs->video.main_mix ? obs->video.main_mix->video
+				   : obs->video.cover_video;
 }
 
 /* TODO: optimize this later so it's not just O(N) string lookups */
@@ -1544,23 +1888,51 @@ void obs_enum_services(bool (*enum_proc)(void *, obs_service_t *), void *param)
 		 param);
 }
 
-static inline void *get_context_by_name(void *vfirst, const char *name,
+static inline uint32_t hash_context_name(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name)
+		hash = (hash ^ (uint8_t)*name++) * 16777619u;
+	return hash;
+}
+
+/* assumes the mutex of the list, accept can skip contexts that match */
+static void *find_context(struct obs_context_index *index, const char *name,
+			  bool (*accept)(struct obs_context_data *context))
+{
+	struct obs_context_data *context;
+	uint32_t hash;
+
+	if (!index->num_buckets)
+		return NULL;
+
+	hash = hash_context_name(name);
+	context = index->buckets[hash & (index->num_buckets - 1)];
+
+	while (context) {
+		if (context->name_hash == hash &&
+		    strcmp(context->name, name) == 0 &&
+		    (!accept || accept(context)))
+			return context;
+		context = context->hash_next;
+	}
+
+	return NULL;
+}
+
+static inline void *get_context_by_name(const char *name,
+					struct obs_context_index *index,
 					pthread_mutex_t *mutex,
 					void *(*addref)(void *))
 {
-	struct obs_context_data **first = vfirst;
 	struct obs_context_data *context;
 
 	pthread_mutex_lock(mutex);
 
-	context = *first;
-	while (context) {
-		if (!context->private && strcmp(context->name, name) == 0) {
-			context = addref(context);
-			break;
-		}
-		context = context->next;
-	}
+	context = find_context(index, name, NULL);
+	if (context)
+		context = addref(context);
 
 	pthread_mutex_unlock(mutex);
 	return context;
@@ -1591,30 +1963,45 @@ static inline void *obs_id_(void *data)
 	return data;
 }
 
+/* removed sources live on for as long as they're referenced, which must not
+ * keep a new source of the same name from being found */
+static bool source_not_removed(struct obs_context_data *context)
+{
+	return !((obs_source_t *)context)->removed;
+}
+
 obs_source_t *obs_get_source_by_name(const char *name)
 {
-	return get_context_by_name(&obs->data.first_source, name,
-				   &obs->data.sources_mutex,
-				   obs_source_addref_safe_);
+	struct obs_core_data *data = &obs->data;
+	struct obs_context_data *context;
+
+	pthread_mutex_lock(&data->sources_mutex);
+
+	context = find_context(&data->source_index, name, source_not_removed);
+	if (context)
+		context = obs_source_addref_safe_(context);
+
+	pthread_mutex_unlock(&data->sources_mutex);
+	return (obs_source_t *)context;
 }
 
 obs_output_t *obs_get_output_by_name(const char *name)
 {
-	return get_context_by_name(&obs->data.first_output, name,
+	return get_context_by_name(name, &obs->data.output_index,
 				   &obs->data.outputs_mutex,
 				   obs_output_addref_safe_);
 }
 
 obs_encoder_t *obs_get_encoder_by_name(const char *name)
 {
-	return get_context_by_name(&obs->data.first_encoder, name,
+	return get_context_by_name(name, &obs->data.encoder_index,
 				   &obs->data.encoders_mutex,
 				   obs_encoder_addref_safe_);
 }
 
 obs_service_t *obs_get_service_by_name(const char *name)
 {
-	return get_context_by_name(&obs->data.first_service, name,
+	return get_context_by_name(name, &obs->data.service_index,
 				   &obs->data.services_mutex,
 				   obs_service_addref_safe_);
 }
@@ -1674,13 +2061,13 @@ static void obs_render_main_texture_internal(enum gs_blend_type src_c,
 					     enum gs_blend_type src_a,
 					     enum gs_blend_type dest_a)
 {
-	struct obs_core_video *video;
+	struct obs_core_video_mix *video;
 	gs_texture_t *tex;
 	gs_effect_t *effect;
 	gs_eparam_t *param;
 
-	video = &obs->video;
-	if (!video->texture_rendered)
+	video = obs->video.main_mix;
+	if (!video || !video->texture_rendered)
 		return;
 
 	tex = video->render_texture;
@@ -1711,10 +2098,10 @@ void obs_render_main_texture_src_color_only(void)
 
 gs_texture_t *obs_get_main_texture(void)
 {
-	struct obs_core_video *video;
+	struct obs_core_video_mix *video;
 
-	video = &obs->video;
-	if (!video->texture_rendered)
+	video = obs->video.main_mix;
+	if (!video || !video->texture_rendered)
 		return NULL;
 
 	return video->render_texture;
@@ -1737,7 +2124,8 @@ float obs_get_master_volume(void)
 	return obs->audio.user_volume;
 }
 
-static obs_source_t *obs_load_source_type(obs_data_t *source_data)
+static obs_source_t *obs_load_source_type(obs_data_t *source_data,
+					  bool defer)
 {
 	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
 	obs_source_t *source;
@@ -1762,8 +2150,12 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 	if (!*v_id)
 		v_id = id;
 
-	source = obs_source_create_set_last_ver(v_id, name, settings, hotkeys,
-						prev_ver);
+	if (defer)
+		source = obs_source_create_deferred(v_id, name, settings,
+						    hotkeys, prev_ver);
+	else
+		source = obs_source_create_set_last_ver(v_id, name, settings,
+							hotkeys, prev_ver);
 	if (source->owns_info_id) {
 		bfree((void *)source->info.unversioned_id);
 		source->info.unversioned_id = bstrdup(id);
@@ -1815,6 +2207,9 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 	obs_source_set_push_to_talk_delay(
 		source, obs_data_get_int(source_data, "push-to-talk-delay"));
 
+	obs_source_set_max_render_fps(
+		source, obs_data_get_double(source_data, "max_render_fps"));
+
 	di_mode = (int)obs_data_get_int(source_data, "deinterlace_mode");
 	obs_source_set_deinterlace_mode(source,
 					(enum obs_deinterlace_mode)di_mode);
@@ -1837,6 +2232,10 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 	obs_source_set_monitoring_type(
 		source, (enum obs_monitoring_type)monitoring_type);
 
+	/* monitored audio is heard whether the source is shown or not */
+	if (monitoring_type != OBS_MONITORING_TYPE_NONE)
+		obs_source_instantiate(source);
+
 	obs_data_release(source->private_settings);
 	source->private_settings =
 		obs_data_get_obj(source_data, "private_settings");
@@ -1851,7 +2250,7 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 				obs_data_array_item(filters, i);
 
 			obs_source_t *filter =
-				obs_load_source_type(filter_data);
+				obs_load_source_type(filter_data, false);
 			if (filter) {
 				obs_source_filter_add(source, filter);
 				obs_source_release(filter);
@@ -1870,11 +2269,12 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 
 obs_source_t *obs_load_source(obs_data_t *source_data)
 {
-	return obs_load_source_type(source_data);
+	return obs_load_source_type(source_data, false);
 }
 
-void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
-		      void *private_data)
+void obs_load_sources_deferred(obs_data_array_t *array, obs_load_source_cb cb,
+			       obs_defer_source_cb defer_cb,
+			       void *private_data)
 {
 	struct obs_core_data *data = &obs->data;
 	DARRAY(obs_source_t *) sources;
@@ -1890,7 +2290,8 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 
 	for (i = 0; i < count; i++) {
 		obs_data_t *source_data = obs_data_array_item(array, i);
-		obs_source_t *source = obs_load_source(source_data);
+		bool defer = defer_cb && defer_cb(private_data, source_data);
+		obs_source_t *source = obs_load_source_type(source_data, defer);
 
 		da_push_back(sources, &source);
 
@@ -1924,6 +2325,12 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 	da_free(sources);
 }
 
+void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
+		      void *private_data)
+{
+	obs_load_sources_deferred(array, cb, NULL, private_data);
+}
+
 obs_data_t *obs_save_source(obs_source_t *source)
 {
 	obs_data_array_t *filters = obs_data_array_create();
@@ -1977,6 +2384,9 @@ obs_data_t *obs_save_source(obs_source_t *source)
 	obs_data_set_int(source_data, "push-to-talk-delay", ptt_delay);
 	obs_data_set_obj(source_data, "hotkeys", hotkey_data);
 	obs_data_set_int(source_data, "deinterlace_mode", di_mode);
+	if (source->max_render_fps > 0.0)
+		obs_data_set_double(source_data, "max_render_fps",
+				    source->max_render_fps);
 	obs_data_set_int(source_data, "deinterlace_field_order", di_order);
 	obs_data_set_int(source_data, "monitoring_type", m_type);
 
@@ -2091,6 +2501,7 @@ static inline bool obs_context_data_init_wrap(struct obs_context_data *context,
 	if (!context->procs)
 		return false;
 
+	context->mem_account = bmem_account_create();
 	context->name = dup_name(name, private);
 	context->settings = obs_data_newref(settings);
 	context->hotkey_data = obs_data_newref(hotkey_data);
@@ -2119,6 +2530,7 @@ void obs_context_data_free(struct obs_context_data *context)
 	obs_data_release(context->settings);
 	obs_context_data_remove(context);
 	pthread_mutex_destroy(&context->rename_cache_mutex);
+	bmem_account_release(context->mem_account);
 	bfree(context->name);
 
 	for (size_t i = 0; i < context->rename_cache.num; i++)
@@ -2128,16 +2540,93 @@ void obs_context_data_free(struct obs_context_data *context)
 	memset(context, 0, sizeof(*context));
 }
 
+/* appends so that contexts of the same name keep their order on rehash */
+static void index_link(struct obs_context_index *index,
+		       struct obs_context_data *context, bool append)
+{
+	size_t bucket = context->name_hash & (index->num_buckets - 1);
+	struct obs_context_data **p = &index->buckets[bucket];
+
+	if (append) {
+		while (*p)
+			p = &(*p)->hash_next;
+	}
+
+	context->hash_next = *p;
+	*p = context;
+}
+
+static void index_grow(struct obs_context_index *index)
+{
+	struct obs_context_data **old = index->buckets;
+	size_t old_num = index->num_buckets;
+
+	index->num_buckets = old_num ? old_num * 2 : 64;
+	index->buckets =
+		bzalloc(sizeof(struct obs_context_data *) * index->num_buckets);
+
+	for (size_t i = 0; i < old_num; i++) {
+		struct obs_context_data *context = old[i];
+
+		while (context) {
+			struct obs_context_data *next = context->hash_next;
+			index_link(index, context, true);
+			context = next;
+		}
+	}
+
+	bfree(old);
+}
+
+/* assumes the mutex of the list */
+static void index_add(struct obs_context_index *index,
+		      struct obs_context_data *context)
+{
+	if (context->private || !context->name)
+		return;
+
+	if (index->count >= index->num_buckets)
+		index_grow(index);
+
+	context->name_hash = hash_context_name(context->name);
+	index_link(index, context, false);
+	index->count++;
+}
+
+/* assumes the mutex of the list */
+static void index_remove(struct obs_context_index *index,
+			 struct obs_context_data *context)
+{
+	struct obs_context_data **p;
+
+	if (context->private || !context->name || !index->num_buckets)
+		return;
+
+	p = &index->buckets[context->name_hash & (index->num_buckets - 1)];
+	while (*p) {
+		if (*p == context) {
+			*p = context->hash_next;
+			context->hash_next = NULL;
+			index->count--;
+			break;
+		}
+		p = &(*p)->hash_next;
+	}
+}
+
 void obs_context_data_insert(struct obs_context_data *context,
-			     pthread_mutex_t *mutex, void *pfirst)
+			     pthread_mutex_t *mutex, void *pfirst,
+			     struct obs_context_index *index)
 {
 	struct obs_context_data **first = pfirst;
 
 	assert(context);
 	assert(mutex);
 	assert(first);
+	assert(index);
 
 	context->mutex = mutex;
+	context->index = index;
 
 	pthread_mutex_lock(mutex);
 	context->prev_next = first;
@@ -2145,6 +2634,7 @@ void obs_context_data_insert(struct obs_context_data *context,
 	*first = context;
 	if (context->next)
 		context->next->prev_next = &context->next;
+	index_add(index, context);
 	pthread_mutex_unlock(mutex);
 }
 
@@ -2156,15 +2646,25 @@ void obs_context_data_remove(struct obs_context_data *context)
 			*context->prev_next = context->next;
 		if (context->next)
 			context->next->prev_next = context->prev_next;
+		index_remove(context->index, context);
 		pthread_mutex_unlock(context->mutex);
 
 		context->mutex = NULL;
+		context->index = NULL;
 	}
 }
 
 void obs_context_data_setname(struct obs_context_data *context,
 			      const char *name)
 {
+	pthread_mutex_t *mutex = context->mutex;
+
+	/* the name index is keyed on the name, so it has to be rehashed */
+	if (mutex) {
+		pthread_mutex_lock(mutex);
+		index_remove(context->index, context);
+	}
+
 	pthread_mutex_lock(&context->rename_cache_mutex);
 
 	if (context->name)
@@ -2172,6 +2672,11 @@ void obs_context_data_setname(struct obs_context_data *context,
 	context->name = dup_name(name, context->private);
 
 	pthread_mutex_unlock(&context->rename_cache_mutex);
+
+	if (mutex) {
+		index_add(context->index, context);
+		pthread_mutex_unlock(mutex);
+	}
 }
 
 profiler_name_store_t *obs_get_profiler_name_store(void)
@@ -2199,6 +2704,52 @@ uint64_t obs_get_frame_interval_ns(void)
 	return obs->video.video_frame_interval_ns;
 }
 
+void obs_set_render_budget_ns(uint64_t budget_ns)
+{
+	if (obs)
+		os_atomic_store_long_long(&obs->video.render_budget_ns,
+					  (long long)budget_ns);
+}
+
+uint64_t obs_get_render_budget_ns(void)
+{
+	return obs ? (uint64_t)os_atomic_load_long_long(
+			     &obs->video.render_budget_ns)
+		   : 0;
+}
+
+void obs_set_pipelined_output(bool enable)
+{
+	if (obs)
+		os_atomic_store_bool(&obs->video.pipelined_output, enable);
+}
+
+bool obs_pipelined_output_enabled(void)
+{
+	return obs ? os_atomic_load_bool(&obs->video.pipelined_output)
+		   : false;
+}
+
+void obs_set_idle_rendering(bool enable)
+{
+	if (!obs)
+		return;
+
+	os_atomic_store_bool(&obs->video.idle_rendering, enable);
+	if (!enable)
+		obs_video_wake();
+}
+
+bool obs_idle_rendering_enabled(void)
+{
+	return obs ? os_atomic_load_bool(&obs->video.idle_rendering) : false;
+}
+
+bool obs_video_idle(void)
+{
+	return obs ? os_atomic_load_bool(&obs->video.idle) : false;
+}
+
 enum obs_obj_type obs_obj_get_type(void *obj)
 {
 	struct obs_context_data *context = obj;
@@ -2337,21 +2888,53 @@ uint32_t obs_get_lagged_frames(void)
 	return obs->video.lagged_frames;
 }
 
+uint64_t obs_get_audio_buffering_ns(void)
+{
+	struct obs_core_audio *audio = &obs->audio;
+
+	if (!audio->audio)
+		return 0;
+
+	return audio_frames_to_ns(audio_output_get_sample_rate(audio->audio),
+				  (uint64_t)audio->total_buffering_ticks *
+					  AUDIO_OUTPUT_FRAMES);
+}
+
+struct obs_core_video_mix *get_mix_for_video(video_t *v)
+{
+	struct obs_core_video_mix *result = NULL;
+
+	pthread_mutex_lock(&obs->video.mixes_mutex);
+	for (size_t i = 0; i < obs->video.mixes.num; i++) {
+		struct obs_core_video_mix *mix = obs->video.mixes.array[i];
+		if (mix->video == v) {
+			result = mix;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&obs->video.mixes_mutex);
+
+	return result;
+}
+
 void start_raw_video(video_t *v, const struct video_scale_info *conversion,
 		     void (*callback)(void *param, struct video_data *frame),
 		     void *param)
 {
-	struct obs_core_video *video = &obs->video;
-	os_atomic_inc_long(&video->raw_active);
+	struct obs_core_video_mix *video = get_mix_for_video(v);
+	if (video)
+		os_atomic_inc_long(&video->raw_active);
 	video_output_connect(v, conversion, callback, param);
+	obs_video_wake();
 }
 
 void stop_raw_video(video_t *v,
 		    void (*callback)(void *param, struct video_data *frame),
 		    void *param)
 {
-	struct obs_core_video *video = &obs->video;
-	os_atomic_dec_long(&video->raw_active);
+	struct obs_core_video_mix *video = get_mix_for_video(v);
+	if (video)
+		os_atomic_dec_long(&video->raw_active);
 	video_output_disconnect(v, callback, param);
 }
 
@@ -2360,16 +2943,18 @@ void obs_add_raw_video_callback(const struct video_scale_info *conversion,
 						 struct video_data *frame),
 				void *param)
 {
-	struct obs_core_video *video = &obs->video;
-	start_raw_video(video->video, conversion, callback, param);
+	struct obs_core_video_mix *video = obs->video.main_mix;
+	if (video)
+		start_raw_video(video->video, conversion, callback, param);
 }
 
 void obs_remove_raw_video_callback(void (*callback)(void *param,
 						    struct video_data *frame),
 				   void *param)
 {
-	struct obs_core_video *video = &obs->video;
-	stop_raw_video(video->video, callback, param);
+	struct obs_core_video_mix *video = obs->video.main_mix;
+	if (video)
+		stop_raw_video(video->video, callback, param);
 }
 
 void obs_apply_private_data(obs_data_t *settings)
@@ -2394,15 +2979,18 @@ obs_data_t *obs_get_private_data(void)
 	return private_data;
 }
 
-extern bool init_gpu_encoding(struct obs_core_video *video);
-extern void stop_gpu_encoding_thread(struct obs_core_video *video);
-extern void free_gpu_encoding(struct obs_core_video *video);
+extern bool init_gpu_encoding(struct obs_core_video_mix *video);
+extern void stop_gpu_encoding_thread(struct obs_core_video_mix *video);
+extern void free_gpu_encoding(struct obs_core_video_mix *video);
 
 bool start_gpu_encode(obs_encoder_t *encoder)
 {
-	struct obs_core_video *video = &obs->video;
+	struct obs_core_video_mix *video = get_mix_for_video(encoder->media);
 	bool success = true;
 
+	if (!video)
+		return false;
+
 	obs_enter_graphics();
 	pthread_mutex_lock(&video->gpu_encoder_mutex);
 
@@ -2419,6 +3007,7 @@ bool start_gpu_encode(obs_encoder_t *encoder)
 	if (success) {
 		os_atomic_inc_long(&video->gpu_encoder_active);
 		video_output_inc_texture_encoders(video->video);
+		obs_video_wake();
 	}
 
 	return success;
@@ -2426,9 +3015,12 @@ bool start_gpu_encode(obs_encoder_t *encoder)
 
 void stop_gpu_encode(obs_encoder_t *encoder)
 {
-	struct obs_core_video *video = &obs->video;
+	struct obs_core_video_mix *video = get_mix_for_video(encoder->media);
 	bool call_free = false;
 
+	if (!video)
+		return;
+
 	os_atomic_dec_long(&video->gpu_encoder_active);
 	video_output_dec_texture_encoders(video->video);
 
@@ -2454,15 +3046,98 @@ void stop_gpu_encode(obs_encoder_t *encoder)
 bool obs_video_active(void)
 {
 	struct obs_core_video *video = &obs->video;
+	bool active = false;
+
+	pthread_mutex_lock(&video->mixes_mutex);
+	for (size_t i = 0; i < video->mixes.num; i++) {
+		struct obs_core_video_mix *mix = video->mixes.array[i];
+
+		if (os_atomic_load_long(&mix->raw_active) > 0 ||
+		    os_atomic_load_long(&mix->gpu_encoder_active) > 0) {
+			active = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&video->mixes_mutex);
+
+	if (!active && video->cover_video)
+		active = video_output_active(video->cover_video);
+
+	return active;
+}
+
+bool obs_set_thread_affinity(const char *cpus)
+{
+	struct obs_core_video *video;
+	bool success = true;
+
+	if (!obs)
+		return false;
+
+	bfree(obs->thread_affinity);
+	obs->thread_affinity = cpus && *cpus ? bstrdup(cpus) : NULL;
+
+	video = &obs->video;
 
-	return os_atomic_load_long(&video->raw_active) > 0 ||
-	       os_atomic_load_long(&video->gpu_encoder_active) > 0;
+	if (video->thread_initialized)
+		success = os_set_thread_affinity(video->video_thread, cpus);
+
+	if (success && obs->audio.audio)
+		success = audio_output_set_thread_affinity(obs->audio.audio,
+							   cpus);
+
+	pthread_mutex_lock(&video->mixes_mutex);
+	for (size_t i = 0; success && i < video->mixes.num; i++) {
+		struct obs_core_video_mix *mix = video->mixes.array[i];
+		success = video_output_set_thread_affinity(mix->video, cpus);
+	}
+	pthread_mutex_unlock(&video->mixes_mutex);
+
+	if (!success) {
+		blog(LOG_WARNING, "Failed to set core thread affinity to '%s'",
+		     cpus ? cpus : "");
+		bfree(obs->thread_affinity);
+		obs->thread_affinity = NULL;
+	}
+
+	return success;
+}
+
+bool obs_set_realtime_threads(bool enable)
+{
+	struct obs_core_video *video;
+	bool success = true;
+
+	if (!obs)
+		return false;
+
+	video = &obs->video;
+
+	if (video->thread_initialized)
+		success = os_set_thread_realtime(
+			video->video_thread,
+			enable ? GRAPHICS_THREAD_RT_PRIORITY : 0);
+
+	if (success && obs->audio.audio)
+		success = audio_output_set_thread_realtime(
+			obs->audio.audio,
+			enable ? AUDIO_THREAD_RT_PRIORITY : 0);
+
+	if (!success && enable) {
+		blog(LOG_WARNING, "Failed to switch the core threads to "
+				  "real-time scheduling");
+		obs_set_realtime_threads(false);
+		return false;
+	}
+
+	obs->realtime_threads = enable;
+	return success;
 }
 
 bool obs_nv12_tex_active(void)
 {
-	struct obs_core_video *video = &obs->video;
-	return video->using_nv12_tex;
+	struct obs_core_video_mix *video = obs->video.main_mix;
+	return video ? video->using_nv12_tex : false;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -62,6 +62,9 @@ typedef struct obs_service obs_service_t;
 typedef struct obs_module obs_module_t;
 typedef struct obs_fader obs_fader_t;
 typedef struct obs_volmeter obs_volmeter_t;
+typedef struct obs_image obs_image_t;
+typedef struct obs_gpu_resource obs_gpu_resource_t;
+typedef struct obs_fusion_pass obs_fusion_pass_t;
 
 typedef struct obs_weak_source obs_weak_source_t;
 typedef struct obs_weak_output obs_weak_output_t;
@@ -266,6 +269,95 @@ struct obs_source_frame2 {
 	bool flip;
 };
 
+/** Counters for the asynchronous video frame queue of a source */
+struct obs_source_async_stats {
+	/** Frames queued for rendering */
+	uint64_t frames_output;
+	/** Frames dropped because the queue was full */
+	uint64_t frames_dropped;
+	/** Times the queued frames were dropped to resync timing */
+	uint64_t queue_flushes;
+	/** Outputs that had to wait for another thread outputting frames */
+	uint64_t contended;
+};
+
+/** Statistics of the shared allocator used for async video frames */
+struct obs_frame_arena_stats {
+	/** Frame buffers allocated */
+	uint64_t allocations;
+	/** Allocations served from previously freed buffers */
+	uint64_t reused;
+	/** Buffers newly mapped from the OS */
+	uint64_t mapped;
+	/** Buffers returned to the OS */
+	uint64_t unmapped;
+	/** Buffers mapped while the arena was already at its limit */
+	uint64_t over_limit;
+
+	uint64_t bytes_in_use;
+	uint64_t bytes_cached;
+	uint64_t bytes_limit;
+};
+
+/** Statistics of the buffer pool shared by encoded packets */
+struct obs_packet_pool_stats {
+	/** Packet buffers allocated */
+	uint64_t allocations;
+	/** Allocations served from previously released buffers */
+	uint64_t reused;
+	/** References taken on packets instead of copying them */
+	uint64_t shared_refs;
+
+	uint64_t bytes_in_use;
+	uint64_t bytes_cached;
+};
+
+/** Threads that record a telemetry sample per frame or tick */
+enum obs_telemetry_channel {
+	/** A sample per frame rendered by the graphics thread */
+	OBS_TELEMETRY_VIDEO,
+	/** A sample per tick mixed by the audio thread */
+	OBS_TELEMETRY_AUDIO,
+};
+
+/** A frame or audio tick, as recorded by obs_get_telemetry */
+struct obs_telemetry_sample {
+	/** System time at which the frame or tick was finished */
+	uint64_t timestamp;
+	/** Time it took to render the frame or to mix the tick */
+	uint64_t duration_ns;
+	/**
+	 * Video: frames missed while rendering this one plus frames the
+	 * encoders skipped since the last one.  Audio: always zero.
+	 */
+	uint32_t dropped;
+	/**
+	 * Video: rendered frames still waiting for the encoders.
+	 * Audio: ticks of audio buffering.
+	 */
+	uint32_t queued;
+};
+
+/** Render stages of the main canvas that can be timed on the GPU */
+enum obs_gpu_stage {
+	/** The whole frame, including the stages below */
+	OBS_GPU_STAGE_RENDER_VIDEO,
+	OBS_GPU_STAGE_MAIN_TEXTURE,
+	OBS_GPU_STAGE_OUTPUT_TEXTURE,
+	OBS_GPU_STAGE_CONVERT_TEXTURE,
+	OBS_GPU_STAGE_GPU_ENCODERS,
+	OBS_GPU_STAGE_STAGE_OUTPUT,
+	OBS_GPU_STAGE_COUNT,
+};
+
+/** GPU time of a render stage since GPU timing was last enabled */
+struct obs_gpu_stage_stats {
+	/** Frames in which the stage ran and was measured */
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+};
+
 /** Access to the argc/argv used to start OBS. What you see is what you get. */
 struct obs_cmdline_args {
 	int argc;
@@ -383,6 +475,23 @@ EXPORT profiler_name_store_t *obs_get_profiler_name_store(void);
  */
 EXPORT int obs_reset_video(struct obs_video_info *ovi);
 
+/**
+ * Runs the core without graphics: sources, filters and audio keep running,
+ * but nothing is rendered and no graphics context is created.  Outputs that
+ * need a video track get obs_get_video(), which repeats a single NV12 frame
+ * of the cover image, or black if image_path is NULL or cannot be loaded.
+ *
+ * Only the fps, output size, range and colorspace of ovi are used.  Calling
+ * obs_reset_video afterwards returns to normal rendering.
+ *
+ * @return       OBS_VIDEO_SUCCESS if successful
+ *               OBS_VIDEO_INVALID_PARAM if a parameter is invalid
+ *               OBS_VIDEO_CURRENTLY_ACTIVE if video is currently active
+ *               OBS_VIDEO_FAIL for generic failure
+ */
+EXPORT int obs_reset_video_audio_only(struct obs_video_info *ovi,
+				      const char *image_path);
+
 /**
  * Sets base audio output format/channels/samples/etc
  *
@@ -472,9 +581,18 @@ EXPORT const char *obs_get_module_data_path(obs_module_t *module);
  */
 EXPORT void obs_add_module_path(const char *bin, const char *data);
 
-/** Automatically loads all modules from module paths (convenience function) */
+/**
+ * Automatically loads all modules from module paths (convenience function).
+ * Modules that declare OBS_MODULE_LOAD_THREAD_SAFE are loaded in parallel,
+ * and modules that declare OBS_MODULE_LOAD_DEFERRED are only loaded once
+ * one of their types is needed.
+ */
 EXPORT void obs_load_all_modules(void);
 
+/** Loads all modules whose loading was deferred.  Enumerating types calls
+ * this implicitly. */
+EXPORT void obs_load_deferred_modules(void);
+
 /** Notifies modules that all modules have been loaded.  This function should
  * be called after all modules have been loaded. */
 EXPORT void obs_post_load_modules(void);
@@ -583,6 +701,86 @@ EXPORT video_t *obs_get_video(void);
 /** Returns true if video is active, false otherwise */
 EXPORT bool obs_video_active(void);
 
+/**
+ * Restricts the graphics thread, the audio thread and the video output
+ * threads of all canvases to a list of CPUs such as "0-3,8", keeping them
+ * away from the cores used by encoders.  The setting persists across video
+ * and audio resets, and NULL or an empty list lifts the restriction again.
+ *
+ * Returns false if the list is invalid or thread affinity is not supported
+ * on this platform.
+ */
+EXPORT bool obs_set_thread_affinity(const char *cpus);
+
+/**
+ * Runs the graphics and audio threads with real-time scheduling, so that
+ * other busy processes can't delay their wake-ups, with audio above graphics.
+ * Like the thread affinity, the setting persists across video and audio
+ * resets.
+ *
+ * Only supported on Linux, where the process needs CAP_SYS_NICE or an rtprio
+ * limit.  Returns false if the threads could not be switched.
+ */
+EXPORT bool obs_set_realtime_threads(bool enable);
+
+/**
+ * Returns the current time of an external clock in nanoseconds.  It is
+ * polled by the graphics thread every frame, so it has to return quickly.
+ */
+typedef uint64_t (*obs_clock_get_time_t)(void *param);
+
+/**
+ * Makes the render loop and the audio ticks follow the rate of a master
+ * clock instead of the system clock, such as a PTP disciplined clock or the
+ * reference input of a capture card, so that equipment locked to the same
+ * clock neither drops nor repeats frames over time.  Only the rate is
+ * followed, timestamps remain in system time.
+ *
+ * Passing NULL for get_time goes back to the system clock.
+ */
+EXPORT void obs_set_master_clock(obs_clock_get_time_t get_time, void *param);
+
+/**
+ * Uses the timestamps of the frames of an async video source as the master
+ * clock, for devices that stamp frames with their own clock.  The source is
+ * not referenced, the system clock is used again when it's destroyed.
+ * Sources that don't output async video are ignored.
+ */
+EXPORT void obs_set_master_clock_source(obs_source_t *source);
+
+/** Goes back to the system clock */
+EXPORT void obs_reset_master_clock(void);
+
+/**
+ * Returns how much faster the master clock runs than the system clock in
+ * parts per million, 0 while the system clock is used or until the rate of
+ * the master clock has been measured.
+ */
+EXPORT double obs_get_master_clock_deviation(void);
+
+/**
+ * Renders as fast as the GPU and the outputs allow instead of in real time,
+ * for rendering scenes to files.  Time is then counted in frames: each frame
+ * is rendered once the outputs can take it instead of being skipped, and
+ * the audio thread and media sources follow the frames through
+ * obs_get_clock_ns and obs_sleepto_clock_ns.  Sources that capture in real
+ * time are not slowed down or sped up.
+ *
+ * Can only be switched while no outputs are active, returns false otherwise.
+ */
+EXPORT bool obs_set_offline_rendering(bool enable);
+EXPORT bool obs_offline_rendering_active(void);
+
+/** Returns the system time, or the video time while rendering offline */
+EXPORT uint64_t obs_get_clock_ns(void);
+
+/**
+ * Sleeps until obs_get_clock_ns reaches time_ns.  Returns false if it had
+ * already passed.  While rendering offline, the graphics thread waits for
+ * threads that were woken to sleep again before it renders the next frame.
+ */
+EXPORT bool obs_sleepto_clock_ns(uint64_t time_ns);
+
 /** Sets the primary output source for a channel. */
 EXPORT void obs_set_output_source(uint32_t channel, obs_source_t *source);
 
@@ -705,6 +903,20 @@ typedef void (*obs_load_source_cb)(void *private_data, obs_source_t *source);
 EXPORT void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 			     void *private_data);
 
+typedef bool (*obs_defer_source_cb)(void *private_data,
+				    obs_data_t *source_data);
+
+/**
+ * Loads sources from a data array, but inputs for which defer_cb returns true
+ * are only created when they are shown or activated for the first time (or
+ * when obs_source_instantiate is called).  Until then they exist with their
+ * settings, but without the data of their type, as if creation had failed.
+ */
+EXPORT void obs_load_sources_deferred(obs_data_array_t *array,
+				      obs_load_source_cb cb,
+				      obs_defer_source_cb defer_cb,
+				      void *private_data);
+
 /** Saves sources to a data array */
 EXPORT obs_data_array_t *obs_save_sources(void);
 
@@ -751,6 +963,36 @@ EXPORT void obs_add_raw_video_callback(
 EXPORT void obs_remove_raw_video_callback(
 	void (*callback)(void *param, struct video_data *frame), void *param);
 
+struct obs_frame_export;
+typedef struct obs_frame_export obs_frame_export_t;
+
+struct obs_frame_export_info {
+	/** Size of the exported frames, 0 for the output size */
+	uint32_t width;
+	uint32_t height;
+	/** Frames kept in the ring, 0 for the default of 3 */
+	uint32_t num_frames;
+	/** Exports only every nth output frame, 0 or 1 for every frame */
+	uint32_t frame_divisor;
+};
+
+/**
+ * Publishes the program output to other processes as a ring of NV12 frames
+ * in named shared memory, see obs-frame-export.h for its layout.  Frames are
+ * scaled on the GPU where possible, and readers never block the video
+ * thread: a reader that falls behind simply skips frames.
+ *
+ * Keeps video active until destroyed.  Returns NULL if the name is already
+ * taken or the region can't be created.
+ */
+EXPORT obs_frame_export_t *
+obs_frame_export_create(const char *name,
+			const struct obs_frame_export_info *info);
+EXPORT void obs_frame_export_destroy(obs_frame_export_t *fe);
+
+/** Returns the number of frames exported so far */
+EXPORT uint64_t obs_frame_export_get_frames(const obs_frame_export_t *fe);
+
 EXPORT uint64_t obs_get_video_frame_time(void);
 
 EXPORT double obs_get_active_fps(void);
@@ -760,6 +1002,97 @@ EXPORT uint64_t obs_get_frame_interval_ns(void);
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+/**
+ * Returns how far audio output currently lags behind real time to give late
+ * audio sources time to catch up.  The buffering grows when sources are late
+ * and shrinks again once they have been stable for a while.
+ */
+EXPORT uint64_t obs_get_audio_buffering_ns(void);
+
+/**
+ * Sets how much memory the shared async video frame allocator may keep
+ * mapped.  Freed frame buffers beyond the limit are returned to the OS
+ * instead of being kept for reuse.
+ */
+EXPORT void obs_set_frame_arena_limit(uint64_t bytes);
+EXPORT void obs_get_frame_arena_stats(struct obs_frame_arena_stats *stats);
+
+EXPORT void obs_get_packet_pool_stats(struct obs_packet_pool_stats *stats);
+
+/**
+ * Returns the libobs frame timing histograms, encoder timings and the frame,
+ * output and audio buffering counters in the OpenMetrics text format, for
+ * serving to a metrics scraper.  Free the result with bfree.
+ */
+EXPORT char *obs_get_openmetrics(void);
+
+/**
+ * Copies up to count of the most recent telemetry samples of a channel,
+ * oldest first, and returns how many were copied.  Only the last
+ * OBS_TELEMETRY_SAMPLES are kept.  Reading takes no locks, so this can be
+ * called as often as needed from any thread.
+ */
+#define OBS_TELEMETRY_SAMPLES 1024
+
+EXPORT size_t obs_get_telemetry(enum obs_telemetry_channel channel,
+				struct obs_telemetry_sample *samples,
+				size_t count);
+
+/**
+ * Enables timing of the main canvas' render stages on the GPU with timer
+ * queries.  Results are collected a few frames later without waiting for
+ * the GPU, and frames are skipped if it falls further behind.  Enabling it
+ * resets the statistics.
+ */
+EXPORT void obs_set_gpu_timing_enabled(bool enable);
+EXPORT bool obs_gpu_timing_enabled(void);
+EXPORT void obs_get_gpu_stage_stats(enum obs_gpu_stage stage,
+				    struct obs_gpu_stage_stats *stats);
+
+/** @return The name of the stage, the same as its profiler section */
+EXPORT const char *obs_gpu_stage_name(enum obs_gpu_stage stage);
+
+/**
+ * @return The number of frames whose GPU time has been added to the sources
+ * (see obs_source_get_gpu_time_ns).  It is never reset, so per-frame times
+ * are taken from the difference between two calls.
+ */
+EXPORT uint64_t obs_get_gpu_timed_frames(void);
+
+/**
+ * Sets the time within which a frame should be rendered, 0 to disable (the
+ * default).  While frames take longer than that, sources with the
+ * OBS_SOURCE_FLAG_LOW_RENDER_PRIORITY flag are not rendered in displays
+ * (previews and projectors), until frames have been within budget for a
+ * second.  The output itself is never affected.
+ */
+EXPORT void obs_set_render_budget_ns(uint64_t budget_ns);
+EXPORT uint64_t obs_get_render_budget_ns(void);
+
+/**
+ * Enables pipelined output (disabled by default).  Frames read back from the
+ * GPU are then copied to the raw video outputs on the task pool, overlapping
+ * with the graphics thread ticking and rendering the next frame, at the cost
+ * of handing each frame to the outputs up to one frame later.
+ */
+EXPORT void obs_set_pipelined_output(bool enable);
+EXPORT bool obs_pipelined_output_enabled(void);
+
+/**
+ * Enables idle rendering (disabled by default).  While no output uses video
+ * and no display is enabled and visible, nothing is rendered and sources are
+ * only ticked a few times per second.  Starting an output, or enabling,
+ * creating or uncovering a display resumes rendering right away.
+ *
+ * Rendering done from tick callbacks keeps running when idle, main render
+ * callbacks do not.
+ */
+EXPORT void obs_set_idle_rendering(bool enable);
+EXPORT bool obs_idle_rendering_enabled(void);
+
+/** Returns whether rendering is currently paused by idle rendering */
+EXPORT bool obs_video_idle(void);
+
 EXPORT bool obs_nv12_tex_active(void);
 
 EXPORT void obs_apply_private_data(obs_data_t *settings);
@@ -779,6 +1112,67 @@ EXPORT void obs_queue_task(enum obs_task_type type, obs_task_t task,
 typedef void (*obs_task_handler_t)(obs_task_t task, void *param, bool wait);
 EXPORT void obs_set_ui_task_handler(obs_task_handler_t handler);
 
+/*
+ * Graphics commands run on the graphics thread in the graphics context once
+ * per frame, so threads that create, upload or destroy GPU resources don't
+ * wait in obs_enter_graphics for a frame to finish rendering.  Queuing never
+ * blocks.  If future is not NULL, it receives a future that tells when the
+ * command has run, which must be released with obs_graphics_future_release.
+ */
+typedef struct obs_graphics_future obs_graphics_future_t;
+
+EXPORT void obs_queue_graphics_command(obs_task_t task, void *param,
+				       obs_graphics_future_t **future);
+EXPORT bool obs_graphics_future_done(const obs_graphics_future_t *future);
+EXPORT void obs_graphics_future_wait(obs_graphics_future_t *future);
+EXPORT void obs_graphics_future_release(obs_graphics_future_t *future);
+
+/* ------------------------------------------------------------------------- */
+/* Task pool */
+
+/*
+ * libobs keeps one pool of worker threads, sized to the machine, for core
+ * and plugins alike.  Tasks queued in a group can be waited for, which also
+ * runs the queued tasks of the group on the waiting thread, and canceled.
+ * Tasks a module queued must be done before it unloads, so modules should
+ * queue their tasks in a group and destroy it when they are freed.
+ */
+
+enum obs_task_priority {
+	OBS_TASK_PRIORITY_LOW,
+	OBS_TASK_PRIORITY_NORMAL,
+	OBS_TASK_PRIORITY_HIGH,
+};
+
+typedef struct obs_task_group obs_task_group_t;
+
+/** Returns the number of worker threads, 0 if tasks run when queued */
+EXPORT size_t obs_get_pool_threads(void);
+
+/** Queues a task that is not part of any group */
+EXPORT void obs_queue_pool_task(enum obs_task_priority priority,
+				obs_task_t task, void *param);
+
+EXPORT obs_task_group_t *obs_task_group_create(void);
+
+/** Waits for the tasks of the group and destroys it */
+EXPORT void obs_task_group_destroy(obs_task_group_t *group);
+
+/** Queues a task in a group; tasks queued after a cancel are dropped */
+EXPORT void obs_task_group_queue(obs_task_group_t *group,
+				 enum obs_task_priority priority,
+				 obs_task_t task, void *param);
+
+/** Returns once every task queued in the group has finished */
+EXPORT void obs_task_group_wait(obs_task_group_t *group);
+
+/**
+ * Drops the tasks of the group that have not started yet.  Long running
+ * tasks can check obs_task_group_canceled to stop early.
+ */
+EXPORT void obs_task_group_cancel(obs_task_group_t *group);
+EXPORT bool obs_task_group_canceled(const obs_task_group_t *group);
+
 /* ------------------------------------------------------------------------- */
 /* View context */
 
@@ -803,6 +1197,31 @@ EXPORT obs_source_t *obs_view_get_source(obs_view_t *view, uint32_t channel);
 /** Renders the sources of this view context */
 EXPORT void obs_view_render(obs_view_t *view);
 
+/**
+ * Adds a canvas for this view using the main video settings, and returns
+ * its video output.  The view's sources are rendered into the canvas on the
+ * same graphics tick as the main view, so shared sources are only ticked
+ * once.
+ */
+EXPORT video_t *obs_view_add(obs_view_t *view);
+
+/**
+ * Adds a canvas for this view with its own base/output resolution, format
+ * and color settings.  The frame rate, graphics module and adapter are
+ * always taken from the main video.  Returns NULL on failure.
+ */
+EXPORT video_t *obs_view_add2(obs_view_t *view, struct obs_video_info *ovi);
+
+/**
+ * Removes the canvas of this view.  Any outputs or encoders using its video
+ * output must be stopped first.
+ */
+EXPORT void obs_view_remove(obs_view_t *view);
+
+/** Gets the video settings of the canvas of this view, if any */
+EXPORT bool obs_view_get_video_info(obs_view_t *view,
+				    struct obs_video_info *ovi);
+
 /* ------------------------------------------------------------------------- */
 /* Display context */
 
@@ -845,6 +1264,21 @@ EXPORT void obs_display_remove_draw_callback(
 EXPORT void obs_display_set_enabled(obs_display_t *display, bool enable);
 EXPORT bool obs_display_enabled(obs_display_t *display);
 
+/**
+ * Tells libobs that the window of the display can't be seen (minimized or
+ * covered), so that it isn't rendered.  Unlike disabling the display, this
+ * is meant to follow the window system.
+ */
+EXPORT void obs_display_set_occluded(obs_display_t *display, bool occluded);
+EXPORT bool obs_display_occluded(obs_display_t *display);
+
+/**
+ * Limits how often the display is rendered, 0 to render it every frame (the
+ * default).  Limits at or above the video frame rate have no effect.
+ */
+EXPORT void obs_display_set_max_fps(obs_display_t *display, uint32_t max_fps);
+EXPORT uint32_t obs_display_get_max_fps(obs_display_t *display);
+
 EXPORT void obs_display_set_background_color(obs_display_t *display,
 					     uint32_t color);
 
@@ -922,6 +1356,13 @@ EXPORT bool obs_is_source_configurable(const char *id);
 
 EXPORT bool obs_source_configurable(const obs_source_t *source);
 
+/** Creates a source whose creation was deferred, see
+ * obs_load_sources_deferred.  Call from the UI thread */
+EXPORT void obs_source_instantiate(obs_source_t *source);
+
+/** Returns true if the source has not been created yet */
+EXPORT bool obs_source_deferred(const obs_source_t *source);
+
 /**
  * Returns the properties list for a specific existing source.  Free with
  * obs_properties_destroy
@@ -931,9 +1372,126 @@ EXPORT obs_properties_t *obs_source_properties(const obs_source_t *source);
 /** Updates settings for this source */
 EXPORT void obs_source_update(obs_source_t *source, obs_data_t *settings);
 
+/**
+ * Notifies libobs that the video output of the source has changed outside of
+ * a settings update.  Only needed for OBS_SOURCE_CACHEABLE_VIDEO sources.
+ */
+EXPORT void obs_source_content_changed(obs_source_t *source);
+
 /** Renders a video source. */
 EXPORT void obs_source_video_render(obs_source_t *source);
 
+/**
+ * Returns a texture that holds what the source renders, at the size of the
+ * source, for drawing the source with an effect of one's own without
+ * rendering it to a texture first.  Only sources without filters have one:
+ * async sources whose frame is already in a texture, and sources that
+ * implement video_get_texture.  Only valid on the graphics thread until the
+ * next tick.
+ *
+ * @param  source  The source
+ * @param  flip    Set to whether the texture is drawn flipped vertically
+ * @return         The texture, or NULL if the source has to be rendered
+ */
+EXPORT gs_texture_t *obs_source_get_texture(obs_source_t *source, bool *flip);
+
+/**
+ * Called with the RGBA pixels of a capture, or with NULL data if it failed.
+ * The data is only valid for the duration of the call.
+ */
+typedef void (*obs_source_capture_cb)(void *param, const uint8_t *data,
+				      uint32_t linesize, uint32_t width,
+				      uint32_t height);
+
+/**
+ * Renders a source, or the main texture if source is NULL, into an image of
+ * the given size (0 for the base size) and reads it back without waiting on
+ * the GPU.  The callback runs on a pool thread a few frames later, so
+ * encoding the image there does not hold up rendering.
+ *
+ * Returns false and never calls the callback if the size is invalid.
+ */
+EXPORT bool obs_source_capture_async(obs_source_t *source, uint32_t width,
+				     uint32_t height,
+				     obs_source_capture_cb callback,
+				     void *param);
+
+/** Drops pending captures, waiting for a callback that already runs */
+EXPORT void obs_source_capture_cancel(obs_source_capture_cb callback,
+				      void *param);
+
+/**
+ * Total GPU time the source has spent rendering in frames of the main canvas
+ * timed with obs_set_gpu_timing_enabled, including its filters and, for
+ * scenes and transitions, the sources they render.  For a filter, it
+ * includes the filters after it and the parent source.  It is never reset.
+ */
+/**
+ * Gets a version of the video output of the source, which changes whenever
+ * the output may have changed, to cache renders of the source.  Scenes are
+ * versioned by their items.
+ *
+ * @return false if the output can change at any time, in which case the
+ *         source has to be rendered every frame
+ */
+EXPORT bool obs_source_get_video_version(obs_source_t *source,
+					 uint64_t *version);
+
+/**
+ * Limits how often scene items render the source, 0 for every frame.  Items
+ * composite their last render of the source in between, which skips the
+ * render of the source and its filters, but the source still ticks.
+ */
+EXPORT void obs_source_set_max_render_fps(obs_source_t *source, double fps);
+EXPORT double obs_source_get_max_render_fps(const obs_source_t *source);
+
+/**
+ * Gets the largest size scene items draw the source at, for source types
+ * with the OBS_SOURCE_SIZE_HINT flag.  Returns false if there is no hint,
+ * in which case the source should render at its full size.
+ */
+EXPORT bool obs_source_get_size_hint(const obs_source_t *source, uint32_t *cx,
+				     uint32_t *cy);
+
+EXPORT uint64_t obs_source_get_gpu_time_ns(const obs_source_t *source);
+
+/**
+ * CPU time spent in the callbacks of a source since its creation, the
+ * differences between two calls give the cost over that period.  Like the
+ * GPU time, the render time includes the filters of the source and the
+ * sources rendered by it, and audio filters of async sources are counted
+ * under the filter.
+ */
+struct obs_source_perf_stats {
+	uint64_t tick_count;
+	uint64_t tick_ns;
+	uint64_t render_count;
+	uint64_t render_ns;
+	uint64_t audio_count;
+	uint64_t audio_ns;
+	uint64_t gpu_ns;
+
+	/** renders skipped because the frame was over the render budget */
+	uint64_t skipped_renders;
+};
+
+EXPORT void obs_source_get_perf_stats(const obs_source_t *source,
+				      struct obs_source_perf_stats *stats);
+
+/**
+ * Memory held by a source.  System memory is what was allocated with bmalloc
+ * in the callbacks of the source and is still allocated, including its async
+ * frames, and is only known with the pooled allocator.  GPU memory is that of
+ * its registered GPU resources, see obs_gpu_resource_create.
+ */
+struct obs_memory_usage {
+	uint64_t system_bytes;
+	uint64_t gpu_bytes;
+};
+
+EXPORT void obs_source_get_memory_usage(const obs_source_t *source,
+					struct obs_memory_usage *usage);
+
 /** Gets the width of a source (if it has video) */
 EXPORT uint32_t obs_source_get_width(obs_source_t *source);
 
@@ -1035,6 +1593,11 @@ EXPORT bool obs_source_showing(const obs_source_t *source);
 #define OBS_SOURCE_FLAG_UNUSED_1 (1 << 0)
 /** Specifies to force audio to mono */
 #define OBS_SOURCE_FLAG_FORCE_MONO (1 << 1)
+/**
+ * Specifies that the source may be left out of previews and projectors when
+ * frames take too long to render, see obs_set_render_budget_ns
+ */
+#define OBS_SOURCE_FLAG_LOW_RENDER_PRIORITY (1 << 2)
 
 /**
  * Sets source flags.  Note that these are different from the main output
@@ -1092,6 +1655,31 @@ EXPORT void obs_source_dec_showing(obs_source_t *source);
  */
 EXPORT void obs_source_dec_active(obs_source_t *source);
 
+/**
+ * Increments the 'warm' reference counter of the source and its children to
+ * indicate that they are likely to become active soon, such as the sources of
+ * the preview scene in studio mode.  Sources that are warm and not active get
+ * the 'warm' callback, so they can open files and devices ahead of time
+ * without playing or outputting audio.
+ *
+ * Fails if warming the sources would raise the number of warm sources above
+ * the limit set with obs_set_warm_source_limit.
+ */
+EXPORT bool obs_source_inc_warm(obs_source_t *source);
+
+/**
+ * Decrements the 'warm' reference counter of the source and its children.
+ * Sources that are no longer warm and not active get the 'cool' callback.
+ */
+EXPORT void obs_source_dec_warm(obs_source_t *source);
+
+/** Returns true if the source is warm and not active */
+EXPORT bool obs_source_warm(const obs_source_t *source);
+
+/** Sets the most sources that may be warm at a time, 0 for no limit */
+EXPORT void obs_set_warm_source_limit(size_t limit);
+EXPORT size_t obs_get_warm_source_limit(void);
+
 /** Enumerates filters assigned to the source */
 EXPORT void obs_source_enum_filters(obs_source_t *source,
 				    obs_source_enum_proc_t callback,
@@ -1233,6 +1821,10 @@ EXPORT void obs_source_output_video(obs_source_t *source,
 EXPORT void obs_source_output_video2(obs_source_t *source,
 				     const struct obs_source_frame2 *frame);
 
+/** Gets the counters of the asynchronous video frame queue */
+EXPORT void obs_source_get_async_stats(const obs_source_t *source,
+				       struct obs_source_async_stats *stats);
+
 EXPORT void obs_source_set_async_rotation(obs_source_t *source, long rotation);
 
 EXPORT void obs_source_output_cea708(obs_source_t *source,
@@ -1321,6 +1913,14 @@ EXPORT void obs_source_process_filter_tech_end(obs_source_t *filter,
 /** Skips the filter if the filter is invalid and cannot be rendered */
 EXPORT void obs_source_skip_video_filter(obs_source_t *filter);
 
+/**
+ * Gets a parameter declared by a filter's fusion code in the fused pass
+ * being drawn.  Only valid within the filter_fusion_render callback; the name
+ * is given without the '$' prefix.
+ */
+EXPORT gs_eparam_t *obs_fusion_pass_get_param(obs_fusion_pass_t *pass,
+					      const char *name);
+
 /**
  * Adds an active child source.  Must be called by parent sources on child
  * sources when the child is added and active.  This ensures that the source is
@@ -1387,6 +1987,12 @@ EXPORT bool obs_source_async_unbuffered(const obs_source_t *source);
 EXPORT void obs_source_set_async_decoupled(obs_source_t *source, bool decouple);
 EXPORT bool obs_source_async_decoupled(const obs_source_t *source);
 
+/** Copies async video frames into their textures on a separate thread, where
+ * the graphics backend supports recording uploads outside of the graphics
+ * thread (currently Direct3D 11).  Frames are otherwise uploaded as usual. */
+EXPORT void obs_source_set_async_upload(obs_source_t *source, bool enable);
+EXPORT bool obs_source_async_upload(const obs_source_t *source);
+
 EXPORT void obs_source_set_audio_active(obs_source_t *source, bool show);
 EXPORT bool obs_source_audio_active(const obs_source_t *source);
 
@@ -1464,6 +2070,24 @@ EXPORT void obs_transition_enable_fixed(obs_source_t *transition, bool enable,
 					uint32_t duration_ms);
 EXPORT bool obs_transition_fixed(obs_source_t *transition);
 
+/**
+ * Renders the outgoing source only once, on the first frame of each
+ * transition, and keeps using that frame for the rest of the transition.
+ * This halves the cost of rendering a transition at the expense of the
+ * outgoing source no longer updating while it is transitioned away from.
+ */
+EXPORT void obs_transition_enable_freeze_outgoing(obs_source_t *transition,
+						  bool enable);
+EXPORT bool obs_transition_freeze_outgoing(obs_source_t *transition);
+
+/**
+ * Shows source, without activating it, until the transition starts to it
+ * or another source is prewarmed, so that it has loaded its resources by
+ * the time the transition starts.  Pass NULL to stop prewarming.
+ */
+EXPORT void obs_transition_prewarm(obs_source_t *transition,
+				   obs_source_t *source);
+
 typedef void (*obs_transition_video_render_callback_t)(void *data,
 						       gs_texture_t *a,
 						       gs_texture_t *b, float t,
@@ -1657,11 +2281,33 @@ EXPORT void obs_sceneitem_set_scale_filter(obs_sceneitem_t *item,
 EXPORT enum obs_scale_type
 obs_sceneitem_get_scale_filter(obs_sceneitem_t *item);
 
+/**
+ * Limits how often the item renders its source, 0 for every frame.  The
+ * lower of this and the limit of the source applies.
+ */
+EXPORT void obs_sceneitem_set_max_render_fps(obs_sceneitem_t *item,
+					     double fps);
+EXPORT double obs_sceneitem_get_max_render_fps(const obs_sceneitem_t *item);
+
 EXPORT void obs_sceneitem_force_update_transform(obs_sceneitem_t *item);
 
 EXPORT void obs_sceneitem_defer_update_begin(obs_sceneitem_t *item);
 EXPORT void obs_sceneitem_defer_update_end(obs_sceneitem_t *item);
 
+/**
+ * Batches transform changes of the items of a scene: between the two calls,
+ * changing the position, rotation, scale or alignment of an item only marks
+ * it, the same as changing its crop always does.  The next video tick then
+ * updates every marked item once and emits one "item_transform" signal for
+ * it, however often it was changed.  Until then, the transform getters of a
+ * marked item return its previous transform; use
+ * obs_sceneitem_force_update_transform where the new one is needed
+ * immediately.  Useful when many items are changed at once, such as by an
+ * animation script.
+ */
+EXPORT void obs_scene_defer_transforms_begin(obs_scene_t *scene);
+EXPORT void obs_scene_defer_transforms_end(obs_scene_t *scene);
+
 /** Gets private front-end settings data.  This data is saved/loaded
  * automatically.  Returns an incremented reference. */
 EXPORT obs_data_t *obs_sceneitem_get_private_settings(obs_sceneitem_t *item);
@@ -1756,7 +2402,7 @@ EXPORT void obs_output_stop(obs_output_t *output);
 /**
  * On reconnection, start where it left of on reconnection.  Note however that
  * this option will consume extra memory to continually increase delay while
- * waiting to reconnect.
+ * waiting to reconnect, or disk space with obs_output_set_delay_storage.
  */
 #define OBS_OUTPUT_DELAY_PRESERVE (1 << 0)
 
@@ -1773,6 +2419,18 @@ EXPORT void obs_output_set_delay(obs_output_t *output, uint32_t delay_sec,
 /** Gets the currently set delay value, in seconds. */
 EXPORT uint32_t obs_output_get_delay(const obs_output_t *output);
 
+/**
+ * Keeps the data of delayed packets in files in a directory instead of in
+ * memory, for delays that would otherwise take gigabytes of memory.  The
+ * files are written and read sequentially in segments, which are deleted
+ * once their packets have been sent.  Only packet headers stay in memory.
+ *
+ * NULL or an empty path keeps delayed packets in memory.  If writing to the
+ * directory fails, the output keeps delaying packets in memory.
+ */
+EXPORT void obs_output_set_delay_storage(obs_output_t *output,
+					 const char *path);
+
 /** If delay is active, gets the currently active delay value, in seconds. */
 EXPORT uint32_t obs_output_get_active_delay(const obs_output_t *output);
 
@@ -1891,7 +2549,16 @@ EXPORT obs_service_t *obs_output_get_service(const obs_output_t *output);
 EXPORT void obs_output_set_reconnect_settings(obs_output_t *output,
 					      int retry_count, int retry_sec);
 
+/**
+ * Makes the first reconnect attempt after a disconnection immediate, the
+ * retry wait only applies from the second one.
+ */
+EXPORT void obs_output_set_fast_reconnect(obs_output_t *output, bool enable);
+
 EXPORT uint64_t obs_output_get_total_bytes(const obs_output_t *output);
+
+/** Returns the system memory allocated in the callbacks of the output */
+EXPORT uint64_t obs_output_get_memory_usage(const obs_output_t *output);
 EXPORT int obs_output_get_frames_dropped(const obs_output_t *output);
 EXPORT int obs_output_get_total_frames(const obs_output_t *output);
 
@@ -1923,6 +2590,14 @@ EXPORT void obs_output_output_caption_text2(obs_output_t *output,
 					    const char *text,
 					    double display_duration);
 
+/**
+ * Replaces the caption text that hasn't been sent yet, so any number of
+ * updates between two frames become a single caption on the next frame
+ */
+EXPORT void obs_output_update_caption_text(obs_output_t *output,
+					   const char *text,
+					   double display_duration);
+
 EXPORT float obs_output_get_congestion(obs_output_t *output);
 EXPORT int obs_output_get_connect_time_ms(obs_output_t *output);
 
@@ -2051,10 +2726,19 @@ EXPORT const char *obs_encoder_get_codec(const obs_encoder_t *encoder);
 /** Returns the type of an encoder */
 EXPORT enum obs_encoder_type obs_encoder_get_type(const obs_encoder_t *encoder);
 
+/**
+ * Returns the system memory allocated in the callbacks of the encoder,
+ * including the packets it sent that outputs still hold
+ */
+EXPORT uint64_t obs_encoder_get_memory_usage(const obs_encoder_t *encoder);
+
 /**
  * Sets the scaled resolution for a video encoder.  Set width and height to 0
  * to disable scaling.  If the encoder is active, this function will trigger
- * a warning, and do nothing.
+ * a warning, and do nothing, unless the encoder has
+ * OBS_ENCODER_CAP_DYN_RESOLUTION and receives raw frames.  It then stops
+ * receiving frames while its update callback reconfigures it for the new
+ * size.
  */
 EXPORT void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 					uint32_t height);
@@ -2062,6 +2746,14 @@ EXPORT void obs_encoder_set_scaled_size(obs_encoder_t *encoder, uint32_t width,
 /** For video encoders, returns true if pre-encode scaling is enabled */
 EXPORT bool obs_encoder_scaling_enabled(const obs_encoder_t *encoder);
 
+/**
+ * Returns whether GPU textures of the given format can be passed to this
+ * encoder, i.e. the encoder's video is GPU converted to that format.
+ * Texture encoders use this to fall back to a CPU based encoder.
+ */
+EXPORT bool obs_encoder_video_tex_active(const obs_encoder_t *encoder,
+					 enum video_format format);
+
 /** For video encoders, returns the width of the encoded image */
 EXPORT uint32_t obs_encoder_get_width(const obs_encoder_t *encoder);
 
@@ -2138,6 +2830,37 @@ EXPORT const char *obs_encoder_get_id(const obs_encoder_t *encoder);
 EXPORT uint32_t obs_get_encoder_caps(const char *encoder_id);
 EXPORT uint32_t obs_encoder_get_caps(const obs_encoder_t *encoder);
 
+/** Receives one SEI message, payload_type is the H.264 SEI payload type */
+typedef void (*obs_encoder_sei_cb)(void *param, int payload_type,
+				   const uint8_t *data, size_t size);
+
+/**
+ * For encoders with OBS_ENCODER_CAP_CAPTIONS: passes the caption SEI
+ * messages of the outputs using the encoder that are due at the frame with
+ * this pts to callback, which is called before this returns.  The outputs
+ * then leave their packets as they are instead of copying them to append
+ * the SEI.
+ *
+ * @return true if any messages were passed
+ */
+EXPORT bool obs_encoder_get_caption_sei(obs_encoder_t *encoder, int64_t pts,
+					obs_encoder_sei_cb callback,
+					void *param);
+
+/**
+ * Makes the next frame of the encoder a keyframe (IDR), if it has
+ * OBS_ENCODER_CAP_KEYFRAME_REQUEST.  Outputs attaching to an encoder that is
+ * already running request one so they don't have to wait for the next
+ * scheduled keyframe.
+ */
+EXPORT void obs_encoder_request_keyframe(obs_encoder_t *encoder);
+
+/**
+ * For encoders with OBS_ENCODER_CAP_KEYFRAME_REQUEST: returns true once per
+ * request, the frame being encoded is then to be encoded as a keyframe.
+ */
+EXPORT bool obs_encoder_keyframe_requested(obs_encoder_t *encoder);
+
 #ifndef SWIG
 /** Duplicates an encoder packet */
 OBS_DEPRECATED
@@ -2290,10 +3013,113 @@ static inline void obs_source_frame_destroy(struct obs_source_frame *frame)
 EXPORT void obs_source_frame_copy(struct obs_source_frame *dst,
 				  const struct obs_source_frame *src);
 
+/**
+ * Creates a frame with its planes in the allocator libobs uses for the
+ * frames of async sources.  A video filter can return such a frame in place
+ * of the one it was given, and libobs frees it once it has been displayed;
+ * to free it before that, call obs_source_release_frame.
+ */
+EXPORT struct obs_source_frame *
+obs_source_frame_create_pooled(enum video_format format, uint32_t width,
+			       uint32_t height);
+
 /* ------------------------------------------------------------------------- */
 /* Get source icon type */
 EXPORT enum obs_icon_type obs_source_get_icon_type(const char *id);
 
+/* ------------------------------------------------------------------------- */
+/* Image cache */
+
+/**
+ * Returns a reference to the still image at path, shared by everything that
+ * uses the same file (and modification time).  Decoding always happens on a
+ * worker thread, so the image may not be loaded yet.  Images that are no
+ * longer referenced stay cached until the cache exceeds its memory limit,
+ * least recently used first.
+ */
+EXPORT obs_image_t *obs_image_cache_get(const char *path);
+EXPORT void obs_image_release(obs_image_t *image);
+
+/** Decodes path in the background so that a later obs_image_cache_get
+ * finds it ready, without holding a reference to it. */
+EXPORT void obs_image_cache_prefetch(const char *path);
+
+/** Gets the size of path if it has been decoded before, even if its data
+ * has since been evicted.  Files that failed to decode report 0x0. */
+EXPORT bool obs_image_cache_get_size(const char *path, uint32_t *cx,
+				     uint32_t *cy);
+
+EXPORT void obs_image_cache_set_limit(uint64_t bytes);
+
+/**
+ * Enables block compression of the images decoded from now on, which takes
+ * a quarter to an eighth of the memory, on the CPU and the GPU, at some loss
+ * of quality.  Only images whose width and height are multiples of 4 are
+ * compressed.  disk_path, if not NULL, is a directory where compressed images
+ * are kept so they don't have to be compressed again.
+ */
+EXPORT void obs_image_cache_set_compression(bool enabled,
+					    const char *disk_path);
+
+/** Returns true once decoding has finished, successfully or not. */
+EXPORT bool obs_image_loaded(const obs_image_t *image);
+EXPORT bool obs_image_failed(const obs_image_t *image);
+EXPORT uint32_t obs_image_get_width(const obs_image_t *image);
+EXPORT uint32_t obs_image_get_height(const obs_image_t *image);
+EXPORT uint64_t obs_image_get_memory_usage(const obs_image_t *image);
+
+/** Must be called within the graphics context.  Creates the texture from the
+ * decoded data on first use; NULL until the image has loaded. */
+EXPORT gs_texture_t *obs_image_get_texture(obs_image_t *image);
+
+/* ------------------------------------------------------------------------- */
+/* GPU memory */
+
+/** Resources are evicted in order of priority, then least recently used */
+enum obs_gpu_priority {
+	OBS_GPU_PRIORITY_LOW,
+	OBS_GPU_PRIORITY_NORMAL,
+	OBS_GPU_PRIORITY_HIGH,
+};
+
+/**
+ * Called on the graphics thread, within the graphics context, to free the
+ * GPU memory of a resource.  The owner loads it again the next time it is
+ * needed and reports the new size.  Must not destroy the resource.
+ */
+typedef void (*obs_gpu_evict_cb)(void *param);
+
+/**
+ * Registers GPU memory held by a source, or by something drawing it when the
+ * owner is another source.  Once the total goes over the budget, resources
+ * that have not been drawn for a second are evicted.  The owner is only used
+ * for obs_source_get_gpu_memory_usage, and has to outlive the resource.
+ */
+EXPORT obs_gpu_resource_t *obs_gpu_resource_create(
+	const obs_source_t *owner, enum obs_gpu_priority priority,
+	obs_gpu_evict_cb evict, void *param);
+EXPORT void obs_gpu_resource_destroy(obs_gpu_resource_t *res);
+
+/** Sets the number of bytes the resource holds, 0 once it is freed */
+EXPORT void obs_gpu_resource_set_size(obs_gpu_resource_t *res,
+				      uint64_t bytes);
+
+/** Marks the resource as used by the current frame */
+EXPORT void obs_gpu_resource_touch(obs_gpu_resource_t *res);
+
+/** Returns true if the resource was evicted and has not been reloaded */
+EXPORT bool obs_gpu_resource_evicted(const obs_gpu_resource_t *res);
+
+/** Sets the GPU memory budget in bytes, 0 for no limit (the default) */
+EXPORT void obs_set_gpu_memory_budget(uint64_t bytes);
+EXPORT uint64_t obs_get_gpu_memory_budget(void);
+
+/** Returns the GPU memory held by all registered resources */
+EXPORT uint64_t obs_get_gpu_memory_usage(void);
+
+/** Returns the GPU memory held by the resources owned by the source */
+EXPORT uint64_t obs_source_get_gpu_memory_usage(const obs_source_t *source);
+
 #ifdef __cplusplus
 }
 #endif
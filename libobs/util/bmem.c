@@ -87,8 +87,584 @@ static void a_free(void *ptr)
 #endif
 }
 
+/* ------------------------------------------------------------------------- */
+/* per-thread state                                                          */
+
+/*
+ * Allocations are counted per thread, so that counting doesn't make every
+ * thread in the process write to the same cache line.  A block freed on
+ * another thread than the one that allocated it makes one count go up and
+ * the other down, only the sum means anything.  Counts of threads that exit
+ * are folded into retired_allocs.
+ */
+
+#define MAX_TAGS 32
+#define NUM_CLASSES 20
+
+struct pool_cache {
+	void *head;
+	unsigned int count;
+};
+
+struct bmem_thread {
+	struct bmem_thread *next;
+	struct bmem_thread **prev_next;
+
+	volatile long allocs;
+
+	int tag;
+	struct bmem_account *account;
+	volatile long long tag_allocs[MAX_TAGS];
+	volatile long long tag_bytes[MAX_TAGS];
+
+	struct pool_cache caches[NUM_CLASSES];
+};
+
+static pthread_mutex_t threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct bmem_thread *threads = NULL;
+static volatile long retired_allocs = 0;
+static long long retired_tag_allocs[MAX_TAGS] = {0};
+static long long retired_tag_bytes[MAX_TAGS] = {0};
+
+static const char *tag_names[MAX_TAGS] = {"untagged"};
+static int num_tags = 1;
+
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
+static THREAD_LOCAL struct bmem_thread *cur_thread = NULL;
+
+static void pool_flush_thread(struct bmem_thread *t);
+
+static void thread_exit(void *data)
+{
+	struct bmem_thread *t = data;
+
+	pool_flush_thread(t);
+
+	pthread_mutex_lock(&threads_mutex);
+	*t->prev_next = t->next;
+	if (t->next)
+		t->next->prev_next = t->prev_next;
+
+	retired_allocs += t->allocs;
+	for (int i = 0; i < MAX_TAGS; i++) {
+		retired_tag_allocs[i] += t->tag_allocs[i];
+		retired_tag_bytes[i] += t->tag_bytes[i];
+	}
+	pthread_mutex_unlock(&threads_mutex);
+
+	cur_thread = NULL;
+	free(t);
+}
+
+static void create_thread_key(void)
+{
+	pthread_key_create(&thread_key, thread_exit);
+}
+
+/* the state is allocated with the C allocator, as bmalloc may not be
+ * reentered from here */
+static struct bmem_thread *get_thread(void)
+{
+	struct bmem_thread *t = cur_thread;
+
+	if (t)
+		return t;
+
+	pthread_once(&thread_key_once, create_thread_key);
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return NULL;
+
+	pthread_mutex_lock(&threads_mutex);
+	t->next = threads;
+	t->prev_next = &threads;
+	if (threads)
+		threads->prev_next = &t->next;
+	threads = t;
+	pthread_mutex_unlock(&threads_mutex);
+
+	pthread_setspecific(thread_key, t);
+	cur_thread = t;
+	return t;
+}
+
+static inline void count_alloc(void)
+{
+	struct bmem_thread *t = get_thread();
+
+	if (t)
+		t->allocs++;
+	else
+		os_atomic_inc_long(&retired_allocs);
+}
+
+static inline void count_free(void)
+{
+	struct bmem_thread *t = get_thread();
+
+	if (t)
+		t->allocs--;
+	else
+		os_atomic_dec_long(&retired_allocs);
+}
+
+/* ------------------------------------------------------------------------- */
+/* pooled allocator                                                          */
+
+/*
+ * Every block starts with a header of one alignment unit that holds its size
+ * class, tag and account.  Freed blocks go to a small per-thread free list of
+ * their class, the magazine, and a full magazine passes half of its blocks on
+ * to the shared depot of the class, where other threads refill from.  Blocks
+ * above the largest class go straight to the system allocator.
+ */
+
+#define LARGE_CLASS NUM_CLASSES
+#define MAGAZINE_BYTES 32768
+#define MAX_MAGAZINE 64
+#define DEPOT_BYTES (4 * 1024 * 1024)
+
+struct block_header {
+	uint32_t size_class;
+	uint32_t tag;
+	size_t size;
+	struct bmem_account *account;
+};
+
+/* every block charged to an account holds a reference, so blocks that
+ * outlive the owner of the account can still be discharged */
+struct bmem_account {
+	volatile long refs;
+	volatile long long bytes;
+};
+
+static const size_t class_sizes[NUM_CLASSES] = {
+	32,   64,   96,   128,  192,  256,   384,   512,   768,   1024,
+	1536, 2048, 3072, 4096, 6144, 8192, 12288, 16384, 24576, 32768,
+};
+
+struct pool_depot {
+	pthread_mutex_t mutex;
+	void *head;
+	unsigned int count;
+};
+
+static struct pool_depot depots[NUM_CLASSES];
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static inline struct block_header *get_header(void *ptr)
+{
+	return (struct block_header *)((char *)ptr - ALIGNMENT);
+}
+
+static inline void *get_block(struct block_header *header)
+{
+	return (char *)header + ALIGNMENT;
+}
+
+static inline void *next_block(void *block)
+{
+	return *(void **)block;
+}
+
+static inline void set_next_block(void *block, void *next)
+{
+	*(void **)block = next;
+}
+
+static inline int size_class(size_t size)
+{
+	for (int i = 0; i < NUM_CLASSES; i++) {
+		if (size <= class_sizes[i])
+			return i;
+	}
+
+	return LARGE_CLASS;
+}
+
+static inline unsigned int magazine_size(int cls)
+{
+	size_t count = MAGAZINE_BYTES / class_sizes[cls];
+	if (count > MAX_MAGAZINE)
+		count = MAX_MAGAZINE;
+	return count ? (unsigned int)count : 1;
+}
+
+static inline unsigned int depot_size(int cls)
+{
+	return (unsigned int)(DEPOT_BYTES / class_sizes[cls]);
+}
+
+static void init_pool(void)
+{
+	for (int i = 0; i < NUM_CLASSES; i++)
+		pthread_mutex_init(&depots[i].mutex, NULL);
+}
+
+static void *unlink_blocks(struct pool_cache *cache, unsigned int count,
+			   void **tail)
+{
+	void *head = cache->head;
+	void *block = head;
+
+	for (unsigned int i = 1; i < count; i++)
+		block = next_block(block);
+
+	cache->head = next_block(block);
+	cache->count -= count;
+	*tail = block;
+	return head;
+}
+
+/* moves `count` blocks to the depot, releasing whatever doesn't fit */
+static void flush_blocks(struct pool_cache *cache, int cls, unsigned int count)
+{
+	struct pool_depot *depot = &depots[cls];
+	void *tail;
+	void *head;
+	unsigned int room;
+
+	if (!count)
+		return;
+
+	pthread_mutex_lock(&depot->mutex);
+	room = depot_size(cls) - depot->count;
+	if (count > room) {
+		pthread_mutex_unlock(&depot->mutex);
+
+		for (; count > room; count--) {
+			void *block = cache->head;
+			cache->head = next_block(block);
+			cache->count--;
+			a_free(get_header(block));
+		}
+
+		if (!count)
+			return;
+		pthread_mutex_lock(&depot->mutex);
+	}
+
+	head = unlink_blocks(cache, count, &tail);
+	set_next_block(tail, depot->head);
+	depot->head = head;
+	depot->count += count;
+	pthread_mutex_unlock(&depot->mutex);
+}
+
+static void refill(struct pool_cache *cache, int cls)
+{
+	struct pool_depot *depot = &depots[cls];
+	unsigned int count = (magazine_size(cls) + 1) / 2;
+	struct pool_cache taken;
+	void *tail;
+
+	pthread_mutex_lock(&depot->mutex);
+	if (!depot->count) {
+		pthread_mutex_unlock(&depot->mutex);
+		return;
+	}
+
+	if (count > depot->count)
+		count = depot->count;
+
+	taken.head = depot->head;
+	taken.count = depot->count;
+	cache->head = unlink_blocks(&taken, count, &tail);
+	cache->count = count;
+	set_next_block(tail, NULL);
+	depot->head = taken.head;
+	depot->count = taken.count;
+	pthread_mutex_unlock(&depot->mutex);
+}
+
+static void pool_flush_thread(struct bmem_thread *t)
+{
+	for (int i = 0; i < NUM_CLASSES; i++) {
+		struct pool_cache *cache = &t->caches[i];
+		flush_blocks(cache, i, cache->count);
+	}
+}
+
+static inline void tag_block(struct bmem_thread *t,
+			     struct block_header *header, size_t size)
+{
+	header->size = size;
+	header->tag = t ? (uint32_t)t->tag : 0;
+
+	if (t) {
+		t->tag_allocs[header->tag]++;
+		t->tag_bytes[header->tag] += (long long)size;
+	}
+}
+
+static inline void untag_block(struct bmem_thread *t,
+			       struct block_header *header)
+{
+	if (t) {
+		t->tag_allocs[header->tag]--;
+		t->tag_bytes[header->tag] -= (long long)header->size;
+	}
+}
+
+static inline void charge_block(struct block_header *header,
+				struct bmem_account *account)
+{
+	header->account = account;
+
+	if (account) {
+		os_atomic_inc_long(&account->refs);
+		os_atomic_add_long_long(&account->bytes,
+					(long long)header->size);
+	}
+}
+
+static inline void discharge_block(struct block_header *header)
+{
+	struct bmem_account *account = header->account;
+
+	if (account) {
+		os_atomic_add_long_long(&account->bytes,
+					-(long long)header->size);
+		bmem_account_release(account);
+	}
+}
+
+/* a block keeps its account when resized, whichever thread resizes it */
+static inline void recharge_block(struct block_header *header,
+				  size_t old_size)
+{
+	if (header->account)
+		os_atomic_add_long_long(&header->account->bytes,
+					(long long)header->size -
+						(long long)old_size);
+}
+
+static void *alloc_block(struct bmem_thread *t, size_t size,
+			 struct bmem_account *account)
+{
+	int cls = size_class(size);
+	struct block_header *header = NULL;
+
+	if (cls != LARGE_CLASS && t) {
+		struct pool_cache *cache = &t->caches[cls];
+
+		if (!cache->head)
+			refill(cache, cls);
+		if (cache->head) {
+			void *block = cache->head;
+			cache->head = next_block(block);
+			cache->count--;
+			header = get_header(block);
+		}
+	}
+
+	if (!header) {
+		size_t alloc_size = cls == LARGE_CLASS ? size
+						       : class_sizes[cls];
+
+		header = a_malloc(ALIGNMENT + alloc_size);
+		if (!header)
+			return NULL;
+		header->size_class = (uint32_t)cls;
+	}
+
+	tag_block(t, header, size);
+	charge_block(header, account);
+	return get_block(header);
+}
+
+static void *pool_malloc(size_t size)
+{
+	struct bmem_thread *t = get_thread();
+	return alloc_block(t, size, t ? t->account : NULL);
+}
+
+static void pool_free(void *ptr)
+{
+	struct bmem_thread *t;
+	struct block_header *header;
+	struct pool_cache *cache;
+	int cls;
+
+	if (!ptr)
+		return;
+
+	t = get_thread();
+	header = get_header(ptr);
+	cls = (int)header->size_class;
+	untag_block(t, header);
+	discharge_block(header);
+
+	if (cls == LARGE_CLASS || !t) {
+		a_free(header);
+		return;
+	}
+
+	cache = &t->caches[cls];
+	set_next_block(ptr, cache->head);
+	cache->head = ptr;
+
+	if (++cache->count > magazine_size(cls))
+		flush_blocks(cache, cls, cache->count / 2);
+}
+
+static void *pool_realloc(void *ptr, size_t size)
+{
+	struct bmem_thread *t;
+	struct block_header *header;
+	size_t old_size;
+	void *new_ptr;
+	int cls;
+
+	if (!ptr)
+		return pool_malloc(size);
+
+	t = get_thread();
+	header = get_header(ptr);
+	cls = (int)header->size_class;
+	old_size = header->size;
+
+	/* still fits the block */
+	if (cls != LARGE_CLASS && size <= class_sizes[cls]) {
+		untag_block(t, header);
+		tag_block(t, header, size);
+		recharge_block(header, old_size);
+		return ptr;
+	}
+
+	if (cls == LARGE_CLASS && size_class(size) == LARGE_CLASS) {
+		struct block_header *new_header;
+
+		untag_block(t, header);
+		new_header = a_realloc(header, ALIGNMENT + size);
+		if (!new_header) {
+			tag_block(t, header, old_size);
+			return NULL;
+		}
+
+		tag_block(t, new_header, size);
+		recharge_block(new_header, old_size);
+		return get_block(new_header);
+	}
+
+	new_ptr = alloc_block(t, size, header->account);
+	if (new_ptr) {
+		memcpy(new_ptr, ptr, header->size < size ? header->size : size);
+		pool_free(ptr);
+	}
+	return new_ptr;
+}
+
+void base_get_pooled_allocator(struct base_allocator *defs)
+{
+	pthread_once(&pool_once, init_pool);
+
+	defs->malloc = pool_malloc;
+	defs->realloc = pool_realloc;
+	defs->free = pool_free;
+}
+
+int bmem_register_tag(const char *name)
+{
+	int tag = 0;
+
+	if (!name)
+		return 0;
+
+	pthread_mutex_lock(&threads_mutex);
+	for (int i = 1; i < num_tags; i++) {
+		if (strcmp(tag_names[i], name) == 0) {
+			tag = i;
+			break;
+		}
+	}
+
+	if (!tag && num_tags < MAX_TAGS) {
+		tag = num_tags++;
+		tag_names[tag] = name;
+	}
+	pthread_mutex_unlock(&threads_mutex);
+
+	return tag;
+}
+
+int bmem_set_thread_tag(int tag)
+{
+	struct bmem_thread *t = get_thread();
+	int prev;
+
+	if (!t)
+		return 0;
+
+	prev = t->tag;
+	t->tag = (tag > 0 && tag < MAX_TAGS) ? tag : 0;
+	return prev;
+}
+
+bmem_account_t *bmem_account_create(void)
+{
+	/* not a block of its own, as it would have to be charged somewhere */
+	struct bmem_account *account = calloc(1, sizeof(*account));
+
+	if (account)
+		account->refs = 1;
+	return account;
+}
+
+void bmem_account_release(bmem_account_t *account)
+{
+	if (account && os_atomic_dec_long(&account->refs) == 0)
+		free(account);
+}
+
+bmem_account_t *bmem_set_thread_account(bmem_account_t *account)
+{
+	struct bmem_thread *t = get_thread();
+	struct bmem_account *prev;
+
+	if (!t)
+		return NULL;
+
+	prev = t->account;
+	t->account = account;
+	return prev;
+}
+
+long long bmem_account_get_bytes(const bmem_account_t *account)
+{
+	return account ? os_atomic_load_long_long(&account->bytes) : 0;
+}
+
+void bmem_enum_tags(bmem_enum_tags_cb cb, void *param)
+{
+	long long allocs[MAX_TAGS];
+	long long bytes[MAX_TAGS];
+	const char *names[MAX_TAGS];
+	int count;
+
+	pthread_mutex_lock(&threads_mutex);
+	count = num_tags;
+	for (int i = 0; i < count; i++) {
+		names[i] = tag_names[i];
+		allocs[i] = retired_tag_allocs[i];
+		bytes[i] = retired_tag_bytes[i];
+
+		for (struct bmem_thread *t = threads; t; t = t->next) {
+			allocs[i] += t->tag_allocs[i];
+			bytes[i] += t->tag_bytes[i];
+		}
+	}
+	pthread_mutex_unlock(&threads_mutex);
+
+	for (int i = 0; i < count; i++)
+		cb(param, names[i], allocs[i], bytes[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static struct base_allocator alloc = {a_malloc, a_realloc, a_free};
-static long num_allocs = 0;
 
 void base_set_allocator(struct base_allocator *defs)
 {
@@ -106,14 +682,14 @@ void *bmalloc(size_t size)
 		       (unsigned long)size);
 	}
 
-	os_atomic_inc_long(&num_allocs);
+	count_alloc();
 	return ptr;
 }
 
 void *brealloc(void *ptr, size_t size)
 {
 	if (!ptr)
-		os_atomic_inc_long(&num_allocs);
+		count_alloc();
 
 	ptr = alloc.realloc(ptr, size);
 	if (!ptr && !size)
@@ -130,13 +706,21 @@ void *brealloc(void *ptr, size_t size)
 void bfree(void *ptr)
 {
 	if (ptr)
-		os_atomic_dec_long(&num_allocs);
+		count_free();
 	alloc.free(ptr);
 }
 
 long bnum_allocs(void)
 {
-	return num_allocs;
+	long total;
+
+	pthread_mutex_lock(&threads_mutex);
+	total = os_atomic_load_long(&retired_allocs);
+	for (struct bmem_thread *t = threads; t; t = t->next)
+		total += os_atomic_load_long(&t->allocs);
+	pthread_mutex_unlock(&threads_mutex);
+
+	return total;
 }
 
 int base_get_alignment(void)
@@ -33,6 +33,56 @@ struct base_allocator {
 
 EXPORT void base_set_allocator(struct base_allocator *defs);
 
+/**
+ * Gets the built-in pooled allocator, which keeps freed blocks in per-thread
+ * caches of fixed size classes and passes large blocks to the system
+ * allocator.  It records a tag in every block, see bmem_set_thread_tag().
+ *
+ * Like any allocator, it has to be set before the first allocation.
+ */
+EXPORT void base_get_pooled_allocator(struct base_allocator *defs);
+
+/**
+ * Registers an allocation tag for a subsystem and returns its id, or 0, the
+ * untagged id, once all tags are in use.  Registering a name again returns
+ * the same id.  The name is not copied.
+ */
+EXPORT int bmem_register_tag(const char *name);
+
+/**
+ * Sets the tag of the blocks the calling thread allocates from now on, and
+ * returns the previous tag.  Only the pooled allocator keeps track of tags.
+ */
+EXPORT int bmem_set_thread_tag(int tag);
+
+typedef void (*bmem_enum_tags_cb)(void *param, const char *name,
+				  long long allocs, long long bytes);
+
+/** Calls cb with the live block count and bytes of every tag */
+EXPORT void bmem_enum_tags(bmem_enum_tags_cb cb, void *param);
+
+typedef struct bmem_account bmem_account_t;
+
+/**
+ * Creates an account that the bytes of blocks can be charged to, to find out
+ * how much memory an object holds.  Blocks stay charged to the account they
+ * were allocated under until they are freed, even when resized or freed on
+ * another thread, and keep the account alive until then.
+ */
+EXPORT bmem_account_t *bmem_account_create(void);
+EXPORT void bmem_account_release(bmem_account_t *account);
+
+/**
+ * Sets the account that the blocks the calling thread allocates from now on
+ * are charged to, or NULL for none, and returns the previous account.  The
+ * account is not referenced, it has to stay alive while it is set.  Only the
+ * pooled allocator keeps track of accounts.
+ */
+EXPORT bmem_account_t *bmem_set_thread_account(bmem_account_t *account);
+
+/** Gets the bytes of the live blocks charged to an account */
+EXPORT long long bmem_account_get_bytes(const bmem_account_t *account);
+
 EXPORT void *bmalloc(size_t size);
 EXPORT void *brealloc(void *ptr, size_t size);
 EXPORT void bfree(void *ptr);
@@ -306,6 +306,79 @@ static inline void circlebuf_pop_back(struct circlebuf *cb, void *data,
 		cb->end_pos -= size;
 }
 
+/*
+ * Returns a contiguous window of `size` bytes at the back of the buffer to
+ * write into directly, moving the data if the free space would wrap.  The
+ * bytes only become part of the buffer once they are committed.
+ */
+static inline void *circlebuf_reserve_write(struct circlebuf *cb, size_t size)
+{
+	bool wrapped;
+	size_t free_size;
+
+	if (!cb->size)
+		cb->start_pos = cb->end_pos = 0;
+
+	wrapped = cb->size && cb->end_pos <= cb->start_pos;
+	free_size = wrapped ? cb->start_pos - cb->end_pos
+			    : cb->capacity - cb->end_pos;
+
+	if (free_size < size && !wrapped && cb->start_pos) {
+		memmove(cb->data, (uint8_t *)cb->data + cb->start_pos,
+			cb->size);
+		cb->start_pos = 0;
+		cb->end_pos = cb->size;
+		free_size = cb->capacity - cb->size;
+	}
+
+	if (free_size < size) {
+		size_t new_capacity = cb->capacity * 2;
+		if (cb->size + size > new_capacity)
+			new_capacity = cb->size + size;
+
+		cb->data = brealloc(cb->data, new_capacity);
+		circlebuf_reorder_data(cb, new_capacity);
+		cb->capacity = new_capacity;
+	}
+
+	return (uint8_t *)cb->data + cb->end_pos;
+}
+
+/** Adds `size` bytes written to the last circlebuf_reserve_write window */
+static inline void circlebuf_commit_write(struct circlebuf *cb, size_t size)
+{
+	cb->size += size;
+	cb->end_pos += size;
+}
+
+/*
+ * Returns the first `size` bytes of the buffer as one contiguous block to
+ * read in place, moving the data if they wrap.  The pointer is valid until
+ * the buffer is next changed.
+ */
+static inline void *circlebuf_peek_contiguous(struct circlebuf *cb,
+					      size_t size)
+{
+	size_t front_size = cb->capacity - cb->start_pos;
+
+	assert(size <= cb->size);
+
+	if (size > front_size) {
+		uint8_t *data = (uint8_t *)cb->data;
+		size_t back_size = cb->size - front_size;
+		void *back = bmemdup(data, back_size);
+
+		memmove(data, data + cb->start_pos, front_size);
+		memcpy(data + front_size, back, back_size);
+		bfree(back);
+
+		cb->start_pos = 0;
+		cb->end_pos = cb->size;
+	}
+
+	return (uint8_t *)cb->data + cb->start_pos;
+}
+
 static inline void *circlebuf_data(struct circlebuf *cb, size_t idx)
 {
 	uint8_t *ptr = (uint8_t *)cb->data;
@@ -17,6 +17,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <wchar.h>
+#include <ctype.h>
 #include "config-file.h"
 #include "threading.h"
 #include "platform.h"
@@ -54,11 +55,48 @@ static inline void config_section_free(struct config_section *section)
 	bfree(section->name);
 }
 
+/*
+ * Open addressed hash table of the sections and items of a section list,
+ * keyed case insensitively on the section name and the item name.  Entries
+ * store indices rather than pointers so that they survive the darrays being
+ * reallocated.  When names repeat, the entry points to the first match in
+ * file order, which is what the linear search used to return.  The table is
+ * rebuilt lazily after items are removed or a file is parsed into the list.
+ */
+
+#define INDEX_EMPTY UINT32_MAX
+#define INDEX_SECTION UINT32_MAX
+#define INDEX_MIN_SIZE 64
+
+struct index_entry {
+	uint32_t hash;
+	uint32_t section;
+	uint32_t item; /* INDEX_SECTION for the section itself */
+};
+
+struct config_index {
+	struct index_entry *entries;
+	size_t size;
+	size_t count;
+	bool valid;
+};
+
 struct config_data {
 	char *file;
 	struct darray sections; /* struct config_section */
 	struct darray defaults; /* struct config_section */
+	struct config_index sections_index;
+	struct config_index defaults_index;
 	pthread_mutex_t mutex;
+
+	/* held across serializing and writing so saves land in order */
+	pthread_mutex_t save_mutex;
+	pthread_t save_thread;
+	bool save_thread_active;
+	os_sem_t *save_sem;
+	bool save_exit;
+	char *save_temp_ext;
+	char *save_backup_ext;
 };
 
 static inline bool init_mutex(config_t *config)
@@ -68,7 +106,167 @@ static inline bool init_mutex(config_t *config)
 		return false;
 	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
 		return false;
-	return pthread_mutex_init(&config->mutex, &attr) == 0;
+	if (pthread_mutex_init(&config->mutex, &attr) != 0)
+		return false;
+	if (pthread_mutex_init(&config->save_mutex, NULL) != 0) {
+		pthread_mutex_destroy(&config->mutex);
+		return false;
+	}
+	return true;
+}
+
+static inline uint32_t hash_name(uint32_t hash, const char *name)
+{
+	if (name) {
+		while (*name)
+			hash = (hash ^ (uint8_t)toupper((uint8_t)*name++)) *
+			       16777619u;
+	}
+	return hash;
+}
+
+static inline uint32_t hash_section(const char *section)
+{
+	return hash_name(2166136261u, section);
+}
+
+static inline uint32_t hash_item(uint32_t section_hash, const char *name)
+{
+	return hash_name((section_hash ^ 0xFF) * 16777619u, name);
+}
+
+static inline struct config_section *
+get_section(const struct darray *sections, uint32_t idx)
+{
+	return darray_item(sizeof(struct config_section), sections, idx);
+}
+
+static bool index_entry_matches(const struct index_entry *entry,
+				const struct darray *sections, uint32_t hash,
+				const char *section, const char *name)
+{
+	struct config_section *sec;
+	struct config_item *item;
+
+	if (entry->hash != hash)
+		return false;
+	if ((entry->item == INDEX_SECTION) != !name)
+		return false;
+
+	sec = get_section(sections, entry->section);
+	if (astrcmpi(sec->name, section) != 0)
+		return false;
+	if (!name)
+		return true;
+
+	item = darray_item(sizeof(struct config_item), &sec->items,
+			   entry->item);
+	return astrcmpi(item->name, name) == 0;
+}
+
+/* returns the matching entry, or the empty entry it would be stored in */
+static struct index_entry *index_probe(struct config_index *index,
+				       const struct darray *sections,
+				       uint32_t hash, const char *section,
+				       const char *name)
+{
+	size_t mask = index->size - 1;
+	size_t i = hash & mask;
+
+	while (index->entries[i].section != INDEX_EMPTY) {
+		struct index_entry *entry = &index->entries[i];
+
+		if (index_entry_matches(entry, sections, hash, section, name))
+			return entry;
+		i = (i + 1) & mask;
+	}
+
+	return &index->entries[i];
+}
+
+static void index_insert(struct config_index *index,
+			 const struct darray *sections, uint32_t hash,
+			 uint32_t section, uint32_t item, bool replace)
+{
+	struct config_section *sec = get_section(sections, section);
+	const char *name = NULL;
+	struct index_entry *entry;
+
+	if (item != INDEX_SECTION) {
+		struct config_item *cur = darray_item(
+			sizeof(struct config_item), &sec->items, item);
+		name = cur->name;
+	}
+
+	entry = index_probe(index, sections, hash, sec->name, name);
+	if (entry->section == INDEX_EMPTY)
+		index->count++;
+	else if (!replace)
+		return;
+
+	entry->hash = hash;
+	entry->section = section;
+	entry->item = item;
+}
+
+static void index_build(struct config_index *index,
+			const struct darray *sections)
+{
+	size_t count = sections->num;
+	size_t size = INDEX_MIN_SIZE;
+
+	for (size_t i = 0; i < sections->num; i++)
+		count += get_section(sections, (uint32_t)i)->items.num;
+	while (size < count * 2)
+		size *= 2;
+
+	if (size != index->size) {
+		bfree(index->entries);
+		index->entries = bmalloc(sizeof(struct index_entry) * size);
+		index->size = size;
+	}
+
+	memset(index->entries, 0xFF, sizeof(struct index_entry) * size);
+	index->count = 0;
+
+	for (uint32_t i = 0; i < (uint32_t)sections->num; i++) {
+		struct config_section *sec = get_section(sections, i);
+		uint32_t sec_hash = hash_section(sec->name);
+
+		index_insert(index, sections, sec_hash, i, INDEX_SECTION,
+			     false);
+
+		for (uint32_t j = 0; j < (uint32_t)sec->items.num; j++) {
+			struct config_item *item = darray_item(
+				sizeof(struct config_item), &sec->items, j);
+
+			index_insert(index, sections,
+				     hash_item(sec_hash, item->name), i, j,
+				     false);
+		}
+	}
+
+	index->valid = true;
+}
+
+static inline void index_add(struct config_index *index,
+			     const struct darray *sections, uint32_t hash,
+			     uint32_t section, uint32_t item)
+{
+	if (!index->valid)
+		return;
+
+	if ((index->count + 1) * 2 > index->size)
+		index->valid = false;
+	else
+		index_insert(index, sections, hash, section, item, true);
+}
+
+static inline struct config_index *get_index(config_t *config,
+					     const struct darray *sections)
+{
+	return sections == &config->sections ? &config->sections_index
+					     : &config->defaults_index;
 }
 
 config_t *config_create(const char *file)
@@ -347,45 +545,37 @@ int config_open_string(config_t **config, const char *str)
 
 int config_open_defaults(config_t *config, const char *file)
 {
+	int ret;
+
 	if (!config)
 		return CONFIG_ERROR;
 
-	return config_parse_file(&config->defaults, file, false);
+	pthread_mutex_lock(&config->mutex);
+	ret = config_parse_file(&config->defaults, file, false);
+	config->defaults_index.valid = false;
+	pthread_mutex_unlock(&config->mutex);
+	return ret;
 }
 
-int config_save(config_t *config)
+static void config_serialize(config_t *config, struct dstr *str)
 {
-	FILE *f;
-	struct dstr str, tmp;
+	struct dstr tmp;
 	size_t i, j;
-	int ret = CONFIG_ERROR;
 
-	if (!config)
-		return CONFIG_ERROR;
-	if (!config->file)
-		return CONFIG_ERROR;
-
-	dstr_init(&str);
 	dstr_init(&tmp);
 
 	pthread_mutex_lock(&config->mutex);
 
-	f = os_fopen(config->file, "wb");
-	if (!f) {
-		pthread_mutex_unlock(&config->mutex);
-		return CONFIG_FILENOTFOUND;
-	}
-
 	for (i = 0; i < config->sections.num; i++) {
 		struct config_section *section = darray_item(
 			sizeof(struct config_section), &config->sections, i);
 
 		if (i)
-			dstr_cat(&str, "\n");
+			dstr_cat(str, "\n");
 
-		dstr_cat(&str, "[");
-		dstr_cat(&str, section->name);
-		dstr_cat(&str, "]\n");
+		dstr_cat(str, "[");
+		dstr_cat(str, section->name);
+		dstr_cat(str, "]\n");
 
 		for (j = 0; j < section->items.num; j++) {
 			struct config_item *item = darray_item(
@@ -396,30 +586,57 @@ int config_save(config_t *config)
 			dstr_replace(&tmp, "\r", "\\r");
 			dstr_replace(&tmp, "\n", "\\n");
 
-			dstr_cat(&str, item->name);
-			dstr_cat(&str, "=");
-			dstr_cat(&str, tmp.array);
-			dstr_cat(&str, "\n");
+			dstr_cat(str, item->name);
+			dstr_cat(str, "=");
+			dstr_cat(str, tmp.array);
+			dstr_cat(str, "\n");
 		}
 	}
 
+	pthread_mutex_unlock(&config->mutex);
+
+	dstr_free(&tmp);
+}
+
+static int config_write(const char *file, const struct dstr *str)
+{
+	int ret = CONFIG_ERROR;
+	FILE *f;
+
+	f = os_fopen(file, "wb");
+	if (!f)
+		return CONFIG_FILENOTFOUND;
+
 #ifdef _WIN32
 	if (fwrite("\xEF\xBB\xBF", 3, 1, f) != 1)
 		goto cleanup;
 #endif
-	if (fwrite(str.array, str.len, 1, f) != 1)
+	if (fwrite(str->array, str->len, 1, f) != 1)
 		goto cleanup;
 
 	ret = CONFIG_SUCCESS;
 
 cleanup:
 	fclose(f);
+	return ret;
+}
 
-	pthread_mutex_unlock(&config->mutex);
+int config_save(config_t *config)
+{
+	struct dstr str = {0};
+	int ret;
 
-	dstr_free(&tmp);
-	dstr_free(&str);
+	if (!config)
+		return CONFIG_ERROR;
+	if (!config->file)
+		return CONFIG_ERROR;
 
+	pthread_mutex_lock(&config->save_mutex);
+	config_serialize(config, &str);
+	ret = config_write(config->file, &str);
+	pthread_mutex_unlock(&config->save_mutex);
+
+	dstr_free(&str);
 	return ret;
 }
 
@@ -428,7 +645,8 @@ int config_save_safe(config_t *config, const char *temp_ext,
 {
 	struct dstr temp_file = {0};
 	struct dstr backup_file = {0};
-	char *file = config->file;
+	struct dstr str = {0};
+	const char *file = config->file;
 	int ret;
 
 	if (!temp_ext || !*temp_ext) {
@@ -436,17 +654,18 @@ int config_save_safe(config_t *config, const char *temp_ext,
 				"temporary extension specified");
 		return CONFIG_ERROR;
 	}
+	if (!file)
+		return CONFIG_ERROR;
 
-	pthread_mutex_lock(&config->mutex);
+	pthread_mutex_lock(&config->save_mutex);
 
-	dstr_copy(&temp_file, config->file);
+	dstr_copy(&temp_file, file);
 	if (*temp_ext != '.')
 		dstr_cat(&temp_file, ".");
 	dstr_cat(&temp_file, temp_ext);
 
-	config->file = temp_file.array;
-	ret = config_save(config);
-	config->file = file;
+	config_serialize(config, &str);
+	ret = config_write(temp_file.array, &str);
 
 	if (ret != CONFIG_SUCCESS) {
 		blog(LOG_ERROR,
@@ -457,7 +676,7 @@ int config_save_safe(config_t *config, const char *temp_ext,
 	}
 
 	if (backup_ext && *backup_ext) {
-		dstr_copy(&backup_file, config->file);
+		dstr_copy(&backup_file, file);
 		if (*backup_ext != '.')
 			dstr_cat(&backup_file, ".");
 		dstr_cat(&backup_file, backup_ext);
@@ -467,12 +686,109 @@ int config_save_safe(config_t *config, const char *temp_ext,
 		ret = CONFIG_ERROR;
 
 cleanup:
-	pthread_mutex_unlock(&config->mutex);
+	pthread_mutex_unlock(&config->save_mutex);
 	dstr_free(&temp_file);
 	dstr_free(&backup_file);
+	dstr_free(&str);
+	return ret;
+}
+
+static void *save_thread(void *param)
+{
+	config_t *config = param;
+
+	os_set_thread_name("config: save thread");
+
+	while (os_sem_wait(config->save_sem) == 0) {
+		char *temp_ext, *backup_ext;
+		bool exit;
+
+		pthread_mutex_lock(&config->mutex);
+		temp_ext = config->save_temp_ext;
+		backup_ext = config->save_backup_ext;
+		config->save_temp_ext = NULL;
+		config->save_backup_ext = NULL;
+		exit = config->save_exit;
+		pthread_mutex_unlock(&config->mutex);
+
+		if (temp_ext)
+			config_save_safe(config, temp_ext, backup_ext);
+
+		bfree(temp_ext);
+		bfree(backup_ext);
+
+		if (exit)
+			break;
+	}
+
+	return NULL;
+}
+
+int config_save_safe_async(config_t *config, const char *temp_ext,
+			   const char *backup_ext)
+{
+	bool queued;
+	int ret = CONFIG_SUCCESS;
+
+	if (!config || !config->file)
+		return CONFIG_ERROR;
+	if (!temp_ext || !*temp_ext) {
+		blog(LOG_ERROR, "config_save_safe_async: invalid "
+				"temporary extension specified");
+		return CONFIG_ERROR;
+	}
+
+	pthread_mutex_lock(&config->mutex);
+
+	if (!config->save_thread_active) {
+		if (os_sem_init(&config->save_sem, 0) != 0) {
+			ret = CONFIG_ERROR;
+			goto unlock;
+		}
+		if (pthread_create(&config->save_thread, NULL, save_thread,
+				   config) != 0) {
+			os_sem_destroy(config->save_sem);
+			config->save_sem = NULL;
+			ret = CONFIG_ERROR;
+			goto unlock;
+		}
+		config->save_thread_active = true;
+	}
+
+	/* a save that has not started yet picks the latest values up anyway,
+	 * so only the extensions are replaced */
+	queued = config->save_temp_ext != NULL;
+	bfree(config->save_temp_ext);
+	bfree(config->save_backup_ext);
+	config->save_temp_ext = bstrdup(temp_ext);
+	config->save_backup_ext = backup_ext ? bstrdup(backup_ext) : NULL;
+
+	if (!queued)
+		os_sem_post(config->save_sem);
+
+unlock:
+	pthread_mutex_unlock(&config->mutex);
+
+	if (ret != CONFIG_SUCCESS)
+		ret = config_save_safe(config, temp_ext, backup_ext);
 	return ret;
 }
 
+static void stop_save_thread(config_t *config)
+{
+	if (!config->save_thread_active)
+		return;
+
+	pthread_mutex_lock(&config->mutex);
+	config->save_exit = true;
+	pthread_mutex_unlock(&config->mutex);
+
+	os_sem_post(config->save_sem);
+	pthread_join(config->save_thread, NULL);
+	os_sem_destroy(config->save_sem);
+	config->save_thread_active = false;
+}
+
 void config_close(config_t *config)
 {
 	struct config_section *defaults, *sections;
@@ -481,6 +797,8 @@ void config_close(config_t *config)
 	if (!config)
 		return;
 
+	stop_save_thread(config);
+
 	defaults = config->defaults.array;
 	sections = config->sections.array;
 
@@ -491,8 +809,11 @@ void config_close(config_t *config)
 
 	darray_free(&config->defaults);
 	darray_free(&config->sections);
+	bfree(config->sections_index.entries);
+	bfree(config->defaults_index.entries);
 	bfree(config->file);
 	pthread_mutex_destroy(&config->mutex);
+	pthread_mutex_destroy(&config->save_mutex);
 	bfree(config);
 }
 
@@ -520,70 +841,75 @@ unlock:
 	return name;
 }
 
-static const struct config_item *config_find_item(const struct darray *sections,
-						  const char *section,
-						  const char *name)
+/* assumes the mutex of the config */
+static struct config_item *config_find_item(config_t *config,
+					    const struct darray *sections,
+					    const char *section,
+					    const char *name)
 {
-	size_t i, j;
-
-	for (i = 0; i < sections->num; i++) {
-		const struct config_section *sec =
-			darray_item(sizeof(struct config_section), sections, i);
+	struct config_index *index = get_index(config, sections);
+	struct index_entry *entry;
+	struct config_section *sec;
+	uint32_t hash;
 
-		if (astrcmpi(sec->name, section) == 0) {
-			for (j = 0; j < sec->items.num; j++) {
-				struct config_item *item =
-					darray_item(sizeof(struct config_item),
-						    &sec->items, j);
+	if (!index->valid)
+		index_build(index, sections);
 
-				if (astrcmpi(item->name, name) == 0)
-					return item;
-			}
-		}
-	}
+	hash = hash_item(hash_section(section), name);
+	entry = index_probe(index, sections, hash, section, name);
+	if (entry->section == INDEX_EMPTY)
+		return NULL;
 
-	return NULL;
+	sec = get_section(sections, entry->section);
+	return darray_item(sizeof(struct config_item), &sec->items,
+			   entry->item);
 }
 
 static void config_set_item(config_t *config, struct darray *sections,
 			    const char *section, const char *name, char *value)
 {
-	struct config_section *sec = NULL;
-	struct config_section *array = sections->array;
+	struct config_index *index = get_index(config, sections);
+	struct config_section *sec;
 	struct config_item *item;
-	size_t i, j;
+	struct index_entry *entry;
+	uint32_t sec_hash = hash_section(section);
+	uint32_t item_hash = hash_item(sec_hash, name);
+	uint32_t sec_idx;
 
 	pthread_mutex_lock(&config->mutex);
 
-	for (i = 0; i < sections->num; i++) {
-		struct config_section *cur_sec = array + i;
-		struct config_item *items = cur_sec->items.array;
+	if (!index->valid)
+		index_build(index, sections);
 
-		if (astrcmpi(cur_sec->name, section) == 0) {
-			for (j = 0; j < cur_sec->items.num; j++) {
-				item = items + j;
+	/* values are only ever looked up in the first section of a name */
+	entry = index_probe(index, sections, sec_hash, section, NULL);
 
-				if (astrcmpi(item->name, name) == 0) {
-					bfree(item->value);
-					item->value = value;
-					goto unlock;
-				}
-			}
+	if (entry->section != INDEX_EMPTY) {
+		sec_idx = entry->section;
 
-			sec = cur_sec;
-			break;
+		entry = index_probe(index, sections, item_hash, section, name);
+		if (entry->section == sec_idx) {
+			sec = get_section(sections, sec_idx);
+			item = darray_item(sizeof(struct config_item),
+					   &sec->items, entry->item);
+			bfree(item->value);
+			item->value = value;
+			goto unlock;
 		}
-	}
-
-	if (!sec) {
+	} else {
+		sec_idx = (uint32_t)sections->num;
 		sec = darray_push_back_new(sizeof(struct config_section),
 					   sections);
 		sec->name = bstrdup(section);
+		index_add(index, sections, sec_hash, sec_idx, INDEX_SECTION);
 	}
 
+	sec = get_section(sections, sec_idx);
 	item = darray_push_back_new(sizeof(struct config_item), &sec->items);
 	item->name = bstrdup(name);
 	item->value = value;
+	index_add(index, sections, item_hash, sec_idx,
+		  (uint32_t)sec->items.num - 1);
 
 unlock:
 	pthread_mutex_unlock(&config->mutex);
@@ -682,9 +1008,10 @@ const char *config_get_string(config_t *config, const char *section,
 
 	pthread_mutex_lock(&config->mutex);
 
-	item = config_find_item(&config->sections, section, name);
+	item = config_find_item(config, &config->sections, section, name);
 	if (!item)
-		item = config_find_item(&config->defaults, section, name);
+		item = config_find_item(config, &config->defaults, section,
+					name);
 	if (item)
 		value = item->value;
 
@@ -775,6 +1102,7 @@ bool config_remove_value(config_t *config, const char *section,
 				config_item_free(item);
 				darray_erase(sizeof(struct config_item),
 					     &sec->items, j);
+				config->sections_index.valid = false;
 				success = true;
 				goto unlock;
 			}
@@ -794,7 +1122,7 @@ const char *config_get_default_string(config_t *config, const char *section,
 
 	pthread_mutex_lock(&config->mutex);
 
-	item = config_find_item(&config->defaults, section, name);
+	item = config_find_item(config, &config->defaults, section, name);
 	if (item)
 		value = item->value;
 
@@ -847,7 +1175,8 @@ bool config_has_user_value(config_t *config, const char *section,
 {
 	bool success;
 	pthread_mutex_lock(&config->mutex);
-	success = config_find_item(&config->sections, section, name) != NULL;
+	success = config_find_item(config, &config->sections, section, name) !=
+		  NULL;
 	pthread_mutex_unlock(&config->mutex);
 	return success;
 }
@@ -857,7 +1186,8 @@ bool config_has_default_value(config_t *config, const char *section,
 {
 	bool success;
 	pthread_mutex_lock(&config->mutex);
-	success = config_find_item(&config->defaults, section, name) != NULL;
+	success = config_find_item(config, &config->defaults, section, name) !=
+		  NULL;
 	pthread_mutex_unlock(&config->mutex);
 	return success;
 }
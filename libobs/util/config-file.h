@@ -48,6 +48,12 @@ EXPORT int config_open_string(config_t **config, const char *str);
 EXPORT int config_save(config_t *config);
 EXPORT int config_save_safe(config_t *config, const char *temp_ext,
 			    const char *backup_ext);
+
+/* Same as config_save_safe, but writes the file on a background thread.
+ * Requests made while a save is pending are merged into it, so this can be
+ * called after every change.  config_close waits for a pending save. */
+EXPORT int config_save_safe_async(config_t *config, const char *temp_ext,
+				  const char *backup_ext);
 EXPORT void config_close(config_t *config);
 
 EXPORT size_t config_num_sections(config_t *config);
@@ -80,19 +80,17 @@ static inline void *darray_end(const size_t element_size,
 	return darray_item(element_size, da, da->num - 1);
 }
 
+/* small arrays start out with at least this many bytes, so that the first
+ * few pushes don't each reallocate */
+#define DARRAY_MIN_BYTES 64
+
 static inline void darray_reserve(const size_t element_size, struct darray *dst,
 				  const size_t capacity)
 {
-	void *ptr;
 	if (capacity == 0 || capacity <= dst->capacity)
 		return;
 
-	ptr = bmalloc(element_size * capacity);
-	if (dst->num)
-		memcpy(ptr, dst->array, element_size * dst->num);
-	if (dst->array)
-		bfree(dst->array);
-	dst->array = ptr;
+	dst->array = brealloc(dst->array, element_size * capacity);
 	dst->capacity = capacity;
 }
 
@@ -101,22 +99,75 @@ static inline void darray_ensure_capacity(const size_t element_size,
 					  const size_t new_size)
 {
 	size_t new_cap;
-	void *ptr;
 	if (new_size <= dst->capacity)
 		return;
 
-	new_cap = (!dst->capacity) ? new_size : dst->capacity * 2;
+	new_cap = (!dst->capacity) ? DARRAY_MIN_BYTES / element_size
+				   : dst->capacity * 2;
 	if (new_size > new_cap)
 		new_cap = new_size;
+	dst->array = brealloc(dst->array, element_size * new_cap);
+	dst->capacity = new_cap;
+}
+
+/* releases the capacity beyond the used items */
+static inline void darray_shrink(const size_t element_size, struct darray *dst)
+{
+	if (dst->num == dst->capacity)
+		return;
+
+	if (!dst->num) {
+		darray_free(dst);
+		return;
+	}
+
+	dst->array = brealloc(dst->array, element_size * dst->num);
+	dst->capacity = dst->num;
+}
+
+/*
+ * Inline arrays start out in a buffer that is part of the array itself, and
+ * only move to the heap once they outgrow it.  Any call that grows an inline
+ * array has to go through this first, see the da_inline_* macros.
+ */
+static inline void darray_inline_init(struct darray *dst, void *inline_array,
+				      const size_t count)
+{
+	dst->array = inline_array;
+	dst->num = 0;
+	dst->capacity = count;
+}
+
+static inline void darray_inline_ensure(const size_t element_size,
+					struct darray *dst,
+					const void *inline_array,
+					const size_t new_size)
+{
+	size_t new_cap;
+	void *ptr;
+
+	if (dst->array != inline_array || new_size <= dst->capacity)
+		return;
+
+	new_cap = dst->capacity * 2;
+	if (new_size > new_cap)
+		new_cap = new_size;
+
 	ptr = bmalloc(element_size * new_cap);
-	if (dst->capacity)
-		memcpy(ptr, dst->array, element_size * dst->capacity);
-	if (dst->array)
-		bfree(dst->array);
+	if (dst->num)
+		memcpy(ptr, dst->array, element_size * dst->num);
 	dst->array = ptr;
 	dst->capacity = new_cap;
 }
 
+static inline void darray_inline_free(struct darray *dst,
+				      void *inline_array, const size_t count)
+{
+	if (dst->array != inline_array)
+		bfree(dst->array);
+	darray_inline_init(dst, inline_array, count);
+}
+
 static inline void darray_resize(const size_t element_size, struct darray *dst,
 				 const size_t size)
 {
@@ -475,6 +526,8 @@ static inline void darray_swap(const size_t element_size, struct darray *dst,
 
 #define da_resize(v, size) darray_resize(sizeof(*v.array), &v.da, size)
 
+#define da_shrink(v) darray_shrink(sizeof(*v.array), &v.da)
+
 #define da_copy(dst, src) darray_copy(sizeof(*dst.array), &dst.da, &src.da)
 
 #define da_copy_array(dst, src_array, n) \
@@ -525,6 +578,46 @@ static inline void darray_swap(const size_t element_size, struct darray *dst,
 
 #define da_swap(v, idx1, idx2) darray_swap(sizeof(*v.array), &v.da, idx1, idx2)
 
+/*
+ * Inline arrays, mostly for function locals that rarely hold more than a few
+ * items.  The regular da_* macros can be used on them for anything but
+ * growing them (the ones below) and freeing them.  As the array points into
+ * the variable itself, it must not be copied or moved.
+ */
+
+#define DARRAY_INLINE(type, count)        \
+	struct {                          \
+		DARRAY(type);             \
+		type inline_array[count]; \
+	}
+
+#define da_inline_count(v) (sizeof(v.inline_array) / sizeof(*v.inline_array))
+
+#define da_inline_init(v) \
+	darray_inline_init(&v.da, v.inline_array, da_inline_count(v))
+
+#define da_inline_free(v) \
+	darray_inline_free(&v.da, v.inline_array, da_inline_count(v))
+
+#define da_inline_ensure(v, size) \
+	darray_inline_ensure(sizeof(*v.array), &v.da, v.inline_array, size)
+
+#define da_inline_reserve(v, capacity)         \
+	do {                                   \
+		da_inline_ensure(v, capacity); \
+		da_reserve(v, capacity);       \
+	} while (false)
+
+#define da_inline_push_back(v, item) \
+	(da_inline_ensure(v, v.num + 1), da_push_back(v, item))
+
+#define da_inline_push_back_new(v) \
+	(da_inline_ensure(v, v.num + 1), da_push_back_new(v))
+
+#define da_inline_push_back_array(dst, src_array, n) \
+	(da_inline_ensure(dst, dst.num + (n)),       \
+	 da_push_back_array(dst, src_array, n))
+
 #ifdef __cplusplus
 }
 #endif
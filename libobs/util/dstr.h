@@ -214,13 +214,16 @@ static inline void dstr_move(struct dstr *dst, struct dstr *src)
 	dstr_init_move(dst, src);
 }
 
+/* short strings get a little room to grow before they reallocate */
+#define DSTR_MIN_CAPACITY 32
+
 static inline void dstr_ensure_capacity(struct dstr *dst, const size_t new_size)
 {
 	size_t new_cap;
 	if (new_size <= dst->capacity)
 		return;
 
-	new_cap = (!dst->capacity) ? new_size : dst->capacity * 2;
+	new_cap = (!dst->capacity) ? DSTR_MIN_CAPACITY : dst->capacity * 2;
 	if (new_size > new_cap)
 		new_cap = new_size;
 	dst->array = (char *)brealloc(dst->array, new_cap);
@@ -229,14 +232,14 @@ static inline void dstr_ensure_capacity(struct dstr *dst, const size_t new_size)
 
 static inline void dstr_copy_dstr(struct dstr *dst, const struct dstr *src)
 {
-	if (dst->array)
+	if (!src->len) {
 		dstr_free(dst);
-
-	if (src->len) {
-		dstr_ensure_capacity(dst, src->len + 1);
-		memcpy(dst->array, src->array, src->len + 1);
-		dst->len = src->len;
+		return;
 	}
+
+	dstr_ensure_capacity(dst, src->len + 1);
+	memmove(dst->array, src->array, src->len + 1);
+	dst->len = src->len;
 }
 
 static inline void dstr_reserve(struct dstr *dst, const size_t capacity)
@@ -0,0 +1,479 @@
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* O_DIRECT */
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <string.h>
+
+#include "base.h"
+#include "bmem.h"
+#include "platform.h"
+#include "threading.h"
+#include "file-writer.h"
+
+/* covers the logical sector size of pretty much every disk, and is what
+ * unbuffered I/O requires of buffer addresses, sizes and offsets */
+#define WRITER_ALIGNMENT 4096
+
+#define DEFAULT_BLOCK_SIZE (1024 * 1024)
+#define DEFAULT_NUM_BLOCKS 8
+
+/* ------------------------------------------------------------------------- */
+/* raw file access                                                           */
+
+#ifdef _WIN32
+
+struct raw_file {
+	HANDLE cached;
+	HANDLE direct;
+};
+
+#define INVALID_RAW_HANDLE INVALID_HANDLE_VALUE
+
+static bool raw_open(struct raw_file *file, const char *path)
+{
+	const DWORD share = FILE_SHARE_READ | FILE_SHARE_WRITE;
+	wchar_t *wpath;
+
+	if (!os_utf8_to_wcs_ptr(path, 0, &wpath))
+		return false;
+
+	file->cached = CreateFileW(wpath, GENERIC_WRITE, share, NULL,
+				   CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	file->direct = INVALID_HANDLE_VALUE;
+
+	if (file->cached != INVALID_HANDLE_VALUE)
+		file->direct = CreateFileW(wpath, GENERIC_WRITE, share, NULL,
+					   OPEN_EXISTING,
+					   FILE_FLAG_NO_BUFFERING, NULL);
+
+	bfree(wpath);
+	return file->cached != INVALID_HANDLE_VALUE;
+}
+
+static bool raw_write(HANDLE handle, const uint8_t *data, size_t size,
+		      int64_t offset)
+{
+	while (size) {
+		DWORD to_write = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+		OVERLAPPED ol = {0};
+		DWORD written;
+
+		ol.Offset = (DWORD)offset;
+		ol.OffsetHigh = (DWORD)(offset >> 32);
+
+		if (!WriteFile(handle, data, to_write, &written, &ol) ||
+		    !written)
+			return false;
+
+		data += written;
+		size -= written;
+		offset += written;
+	}
+
+	return true;
+}
+
+static inline void raw_close_handle(HANDLE *handle)
+{
+	if (*handle != INVALID_HANDLE_VALUE) {
+		CloseHandle(*handle);
+		*handle = INVALID_HANDLE_VALUE;
+	}
+}
+
+#else
+
+struct raw_file {
+	int cached;
+	int direct;
+};
+
+#define INVALID_RAW_HANDLE -1
+
+static bool raw_open(struct raw_file *file, const char *path)
+{
+	file->cached = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			    0644);
+	file->direct = -1;
+
+	if (file->cached == -1)
+		return false;
+
+#if defined(O_DIRECT)
+	file->direct = open(path, O_WRONLY | O_DIRECT | O_CLOEXEC);
+#elif defined(F_NOCACHE)
+	file->direct = open(path, O_WRONLY | O_CLOEXEC);
+	if (file->direct != -1 && fcntl(file->direct, F_NOCACHE, 1) == -1) {
+		close(file->direct);
+		file->direct = -1;
+	}
+#endif
+	return true;
+}
+
+static bool raw_write(int fd, const uint8_t *data, size_t size, int64_t offset)
+{
+	while (size) {
+		ssize_t written = pwrite(fd, data, size, (off_t)offset);
+
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+
+		data += written;
+		size -= (size_t)written;
+		offset += written;
+	}
+
+	return true;
+}
+
+static inline void raw_close_handle(int *fd)
+{
+	if (*fd != -1) {
+		close(*fd);
+		*fd = -1;
+	}
+}
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+struct write_job {
+	int64_t offset;
+	size_t size;
+};
+
+struct os_file_writer {
+	struct raw_file file;
+
+	void *mem;
+	uint8_t *blocks;
+	struct write_job *jobs;
+	size_t block_size;
+	size_t num_blocks;
+
+	/* owned by the caller: the block being filled and where it goes */
+	size_t cur;
+	size_t fill;
+	int64_t block_offset;
+	int64_t pos;
+
+	pthread_t thread;
+	bool thread_active;
+	os_sem_t *job_sem;
+	os_sem_t *free_sem;
+
+	volatile long queued;
+	volatile long max_queued;
+	volatile long long stalls;
+	volatile long long stall_ns;
+	volatile long long bytes_written;
+	volatile bool direct_io;
+	volatile bool failed;
+};
+
+static inline uint8_t *get_block(struct os_file_writer *writer, size_t idx)
+{
+	return writer->blocks + idx * writer->block_size;
+}
+
+static void write_job(struct os_file_writer *writer, size_t idx)
+{
+	const struct write_job *job = &writer->jobs[idx];
+	const uint8_t *data = get_block(writer, idx);
+	bool success;
+
+	/* only whole blocks keep the alignment unbuffered I/O needs */
+	if (writer->direct_io && job->size == writer->block_size) {
+		success = raw_write(writer->file.direct, data, job->size,
+				    job->offset);
+		if (success)
+			goto done;
+
+		/* the file system may refuse unbuffered writes after
+		 * accepting the open, so fall back for good */
+		blog(LOG_WARNING, "file-writer: unbuffered write failed, "
+				  "falling back to cached writes");
+		raw_close_handle(&writer->file.direct);
+		os_atomic_set_bool(&writer->direct_io, false);
+	}
+
+	success = raw_write(writer->file.cached, data, job->size, job->offset);
+
+done:
+	if (success)
+		os_atomic_add_long_long(&writer->bytes_written,
+					(long long)job->size);
+	else
+		os_atomic_set_bool(&writer->failed, true);
+}
+
+static void *writer_thread(void *param)
+{
+	struct os_file_writer *writer = param;
+	size_t idx = 0;
+
+	os_set_thread_name("file-writer: write-behind thread");
+
+	for (;;) {
+		os_sem_wait(writer->job_sem);
+
+		/* every job is posted with queued already counting it, so an
+		 * empty queue means the writer is being destroyed */
+		if (os_atomic_load_long(&writer->queued) == 0)
+			break;
+
+		if (!os_atomic_load_bool(&writer->failed))
+			write_job(writer, idx);
+
+		idx = (idx + 1) % writer->num_blocks;
+		os_atomic_dec_long(&writer->queued);
+		os_sem_post(writer->free_sem);
+	}
+
+	return NULL;
+}
+
+/* hands the current block to the writer thread and takes the next one,
+ * waiting for it to be written out if the disk has fallen behind */
+static void queue_block(struct os_file_writer *writer, size_t size)
+{
+	struct write_job *job = &writer->jobs[writer->cur];
+	long queued;
+
+	job->offset = writer->block_offset;
+	job->size = size;
+
+	queued = os_atomic_inc_long(&writer->queued);
+	if (queued > os_atomic_load_long(&writer->max_queued))
+		os_atomic_set_long(&writer->max_queued, queued);
+
+	os_sem_post(writer->job_sem);
+
+	if (queued >= (long)writer->num_blocks) {
+		uint64_t start = os_gettime_ns();
+		os_sem_wait(writer->free_sem);
+		os_atomic_add_long_long(&writer->stalls, 1);
+		os_atomic_add_long_long(&writer->stall_ns,
+					(long long)(os_gettime_ns() - start));
+	} else {
+		os_sem_wait(writer->free_sem);
+	}
+
+	writer->cur = (writer->cur + 1) % writer->num_blocks;
+}
+
+/* waits until every queued block has been written */
+static void drain(struct os_file_writer *writer)
+{
+	for (size_t i = 1; i < writer->num_blocks; i++)
+		os_sem_wait(writer->free_sem);
+	for (size_t i = 1; i < writer->num_blocks; i++)
+		os_sem_post(writer->free_sem);
+}
+
+static void free_writer(struct os_file_writer *writer)
+{
+	raw_close_handle(&writer->file.direct);
+	raw_close_handle(&writer->file.cached);
+	os_sem_destroy(writer->job_sem);
+	os_sem_destroy(writer->free_sem);
+	bfree(writer->jobs);
+	bfree(writer->mem);
+	bfree(writer);
+}
+
+os_file_writer_t *os_file_writer_create(const char *path, size_t block_size,
+					size_t num_blocks)
+{
+	struct os_file_writer *writer;
+	uintptr_t aligned;
+
+	if (!path || !*path)
+		return NULL;
+
+	if (!block_size)
+		block_size = DEFAULT_BLOCK_SIZE;
+	if (!num_blocks)
+		num_blocks = DEFAULT_NUM_BLOCKS;
+	if (num_blocks < 2)
+		num_blocks = 2;
+
+	block_size = (block_size + WRITER_ALIGNMENT - 1) &
+		     ~(size_t)(WRITER_ALIGNMENT - 1);
+
+	writer = bzalloc(sizeof(*writer));
+	writer->file.cached = INVALID_RAW_HANDLE;
+	writer->file.direct = INVALID_RAW_HANDLE;
+	writer->block_size = block_size;
+	writer->num_blocks = num_blocks;
+
+	if (!raw_open(&writer->file, path))
+		goto fail;
+
+	writer->direct_io = writer->file.direct != INVALID_RAW_HANDLE;
+
+	writer->mem = bmalloc(block_size * num_blocks + WRITER_ALIGNMENT);
+	aligned = ((uintptr_t)writer->mem + WRITER_ALIGNMENT - 1) &
+		  ~(uintptr_t)(WRITER_ALIGNMENT - 1);
+	writer->blocks = (uint8_t *)aligned;
+	writer->jobs = bzalloc(sizeof(struct write_job) * num_blocks);
+
+	if (os_sem_init(&writer->job_sem, 0) != 0)
+		goto fail;
+	if (os_sem_init(&writer->free_sem, (int)num_blocks - 1) != 0)
+		goto fail;
+	if (pthread_create(&writer->thread, NULL, writer_thread, writer) != 0)
+		goto fail;
+
+	writer->thread_active = true;
+	return writer;
+
+fail:
+	free_writer(writer);
+	return NULL;
+}
+
+bool os_file_writer_destroy(os_file_writer_t *writer)
+{
+	bool success;
+
+	if (!writer)
+		return false;
+
+	if (writer->fill)
+		queue_block(writer, writer->fill);
+
+	if (writer->thread_active) {
+		drain(writer);
+		os_sem_post(writer->job_sem);
+		pthread_join(writer->thread, NULL);
+	}
+
+	success = !writer->failed;
+	free_writer(writer);
+	return success;
+}
+
+/* writes before the current block go straight to the file once everything
+ * queued has landed, so they cannot be overwritten by an older block */
+static bool write_patch(struct os_file_writer *writer, const uint8_t *data,
+			size_t size)
+{
+	drain(writer);
+
+	if (!raw_write(writer->file.cached, data, size, writer->pos)) {
+		os_atomic_set_bool(&writer->failed, true);
+		return false;
+	}
+
+	os_atomic_add_long_long(&writer->bytes_written, (long long)size);
+	return true;
+}
+
+bool os_file_writer_write(os_file_writer_t *writer, const void *data,
+			  size_t size)
+{
+	const uint8_t *src = data;
+
+	if (!writer || os_atomic_load_bool(&writer->failed))
+		return false;
+
+	while (size) {
+		size_t n;
+
+		if (writer->pos < writer->block_offset) {
+			n = (size_t)(writer->block_offset - writer->pos);
+			if (n > size)
+				n = size;
+			if (!write_patch(writer, src, n))
+				return false;
+
+		} else {
+			size_t at = (size_t)(writer->pos - writer->block_offset);
+			n = writer->block_size - at;
+			if (n > size)
+				n = size;
+
+			memcpy(get_block(writer, writer->cur) + at, src, n);
+			if (at + n > writer->fill)
+				writer->fill = at + n;
+
+			if (writer->fill == writer->block_size) {
+				queue_block(writer, writer->block_size);
+				writer->block_offset += writer->block_size;
+				writer->fill = 0;
+			}
+		}
+
+		writer->pos += n;
+		src += n;
+		size -= n;
+	}
+
+	return !os_atomic_load_bool(&writer->failed);
+}
+
+void os_file_writer_flush(os_file_writer_t *writer)
+{
+	const uint8_t *prev;
+	size_t fill;
+
+	if (!writer || !writer->fill)
+		return;
+
+	/* the old block goes out as is, and filling carries on from a copy
+	 * of it, which later gets written again as a whole block */
+	prev = get_block(writer, writer->cur);
+	fill = writer->fill;
+
+	queue_block(writer, fill);
+	memcpy(get_block(writer, writer->cur), prev, fill);
+}
+
+bool os_file_writer_seek(os_file_writer_t *writer, int64_t offset)
+{
+	if (!writer || offset < 0 || offset > os_file_writer_size(writer))
+		return false;
+
+	writer->pos = offset;
+	return true;
+}
+
+int64_t os_file_writer_tell(const os_file_writer_t *writer)
+{
+	return writer ? writer->pos : -1;
+}
+
+int64_t os_file_writer_size(const os_file_writer_t *writer)
+{
+	return writer ? writer->block_offset + (int64_t)writer->fill : -1;
+}
+
+void os_file_writer_get_stats(os_file_writer_t *writer,
+			      struct os_file_writer_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	if (!writer)
+		return;
+
+	stats->queued = (size_t)os_atomic_load_long(&writer->queued);
+	stats->max_queued = (size_t)os_atomic_load_long(&writer->max_queued);
+	stats->num_blocks = writer->num_blocks;
+	stats->stalls = (uint64_t)os_atomic_load_long_long(&writer->stalls);
+	stats->stall_ns = (uint64_t)os_atomic_load_long_long(&writer->stall_ns);
+	stats->bytes_written =
+		(uint64_t)os_atomic_load_long_long(&writer->bytes_written);
+	stats->direct_io = os_atomic_load_bool(&writer->direct_io);
+}
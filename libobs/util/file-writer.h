@@ -0,0 +1,66 @@
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Write-behind file writer for recordings.  Data is copied into a small set
+ * of large, page-aligned blocks and written out by a dedicated thread, so
+ * the caller only waits on the disk when every block is still in flight.
+ *
+ * Full blocks are written with the OS cache bypassed where the file system
+ * allows it (O_DIRECT, F_NOCACHE or FILE_FLAG_NO_BUFFERING), which keeps a
+ * long recording from evicting everything else from the page cache.
+ * Anything smaller, such as the tail of the file or a header patched after
+ * seeking back, goes through a regular cached handle.
+ */
+
+struct os_file_writer;
+typedef struct os_file_writer os_file_writer_t;
+
+struct os_file_writer_stats {
+	/* blocks queued for or being written by the writer thread */
+	size_t queued;
+	size_t max_queued;
+	size_t num_blocks;
+
+	/* how often and for how long the caller had to wait for a block */
+	uint64_t stalls;
+	uint64_t stall_ns;
+
+	uint64_t bytes_written;
+	bool direct_io;
+};
+
+/** Creates (or truncates) the file at path.  block_size is rounded up to the
+ * page size; 0 for either argument picks a default. */
+EXPORT os_file_writer_t *os_file_writer_create(const char *path,
+					       size_t block_size,
+					       size_t num_blocks);
+/** Writes out everything still buffered and closes the file.  Returns false
+ * if any write failed. */
+EXPORT bool os_file_writer_destroy(os_file_writer_t *writer);
+
+/** Writes at the current position.  Returns false once a write has failed. */
+EXPORT bool os_file_writer_write(os_file_writer_t *writer, const void *data,
+				 size_t size);
+
+/** Queues the partially filled block so it reaches the file without waiting
+ * for it to fill up; the caller does not wait for the write itself. */
+EXPORT void os_file_writer_flush(os_file_writer_t *writer);
+
+/** Moves the write position, which cannot go past the end of the file.
+ * Writing anywhere but the end waits for queued blocks to be written. */
+EXPORT bool os_file_writer_seek(os_file_writer_t *writer, int64_t offset);
+EXPORT int64_t os_file_writer_tell(const os_file_writer_t *writer);
+EXPORT int64_t os_file_writer_size(const os_file_writer_t *writer);
+
+EXPORT void os_file_writer_get_stats(os_file_writer_t *writer,
+				     struct os_file_writer_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
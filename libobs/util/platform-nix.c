@@ -18,6 +18,7 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/statvfs.h>
 #include <dirent.h>
 #include <stdlib.h>
@@ -162,6 +163,18 @@ bool os_sleepto_ns(uint64_t time_target)
 	if (time_target < current)
 		return false;
 
+#if !defined(__APPLE__)
+	/* os_gettime_ns is CLOCK_MONOTONIC, so the target is waited for as an
+	 * absolute time and a wake-up that comes late doesn't shift the next
+	 * one */
+	struct timespec req;
+	req.tv_sec = (time_t)(time_target / 1000000000);
+	req.tv_nsec = (long)(time_target % 1000000000);
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &req, NULL) ==
+	       EINTR)
+		;
+#else
 	time_target -= current;
 
 	struct timespec req, remain;
@@ -174,6 +187,7 @@ bool os_sleepto_ns(uint64_t time_target)
 		req = remain;
 		memset(&remain, 0, sizeof(remain));
 	}
+#endif
 
 	return true;
 }
@@ -893,6 +907,11 @@ int os_get_physical_cores(void)
 	return physical_cores;
 }
 
+int os_getpid(void)
+{
+	return (int)getpid();
+}
+
 int os_get_logical_cores(void)
 {
 	if (!core_count_initialized)
@@ -1020,3 +1039,23 @@ uint64_t os_get_free_disk_space(const char *dir)
 
 	return (uint64_t)info.f_frsize * (uint64_t)info.f_bavail;
 }
+
+void *os_large_alloc(size_t size)
+{
+	void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	/* only a hint, fails harmlessly if transparent huge pages are off */
+	madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+	return ptr;
+}
+
+void os_large_free(void *ptr, size_t size)
+{
+	if (ptr)
+		munmap(ptr, size);
+}
@@ -329,6 +329,44 @@ void os_cpu_usage_info_destroy(os_cpu_usage_info_t *info)
 		bfree(info);
 }
 
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+/* high resolution timers wake up well within this, so only the last stretch
+ * before the target is spent spinning */
+#define HIGH_RES_TIMER_MARGIN_NS 250000ULL
+
+static volatile bool high_res_timer_unsupported = false;
+
+static bool sleep_high_res(uint64_t duration_ns)
+{
+	LARGE_INTEGER due;
+	HANDLE timer;
+	bool success;
+
+	if (high_res_timer_unsupported)
+		return false;
+
+	/* available since windows 10 1803, unlike Sleep it doesn't depend on
+	 * the timer resolution set with timeBeginPeriod */
+	timer = CreateWaitableTimerExW(NULL, NULL,
+				       CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+				       TIMER_ALL_ACCESS);
+	if (!timer) {
+		high_res_timer_unsupported = true;
+		return false;
+	}
+
+	/* negative due times are relative, in 100ns units */
+	due.QuadPart = -(LONGLONG)(duration_ns / 100);
+	success = SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE) &&
+		  WaitForSingleObject(timer, INFINITE) == WAIT_OBJECT_0;
+
+	CloseHandle(timer);
+	return success;
+}
+
 bool os_sleepto_ns(uint64_t time_target)
 {
 	uint64_t t = os_gettime_ns();
@@ -337,9 +375,12 @@ bool os_sleepto_ns(uint64_t time_target)
 	if (t >= time_target)
 		return false;
 
-	milliseconds = (uint32_t)((time_target - t) / 1000000);
-	if (milliseconds > 1)
-		Sleep(milliseconds - 1);
+	if (time_target - t <= HIGH_RES_TIMER_MARGIN_NS ||
+	    !sleep_high_res(time_target - t - HIGH_RES_TIMER_MARGIN_NS)) {
+		milliseconds = (uint32_t)((time_target - t) / 1000000);
+		if (milliseconds > 1)
+			Sleep(milliseconds - 1);
+	}
 
 	for (;;) {
 		t = os_gettime_ns();
@@ -1244,6 +1285,11 @@ int os_get_physical_cores(void)
 	return physical_cores;
 }
 
+int os_getpid(void)
+{
+	return (int)GetCurrentProcessId();
+}
+
 int os_get_logical_cores(void)
 {
 	if (!core_count_initialized)
@@ -1313,3 +1359,17 @@ uint64_t os_get_free_disk_space(const char *dir)
 
 	return success ? free.QuadPart : 0;
 }
+
+void *os_large_alloc(size_t size)
+{
+	return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE,
+			    PAGE_READWRITE);
+}
+
+void os_large_free(void *ptr, size_t size)
+{
+	if (ptr)
+		VirtualFree(ptr, 0, MEM_RELEASE);
+
+	UNUSED_PARAMETER(size);
+}
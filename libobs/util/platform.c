@@ -27,6 +27,10 @@
 #include "dstr.h"
 #include "obs.h"
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
 FILE *os_wfopen(const wchar_t *path, const char *mode)
 {
 	FILE *file = NULL;
@@ -803,3 +807,106 @@ char *os_generate_formatted_filename(const char *extension, bool space,
 
 	return sf.array;
 }
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || \
+	defined(__i386__)
+static bool detect_avx2(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	/* AVX state must be enabled by the OS (OSXSAVE + XCR0) */
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+		return false;
+	if ((_xgetbv(0) & 0x6) != 0x6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+bool os_cpu_has_avx2(void)
+{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || \
+	defined(__i386__)
+	static volatile long state = -1;
+
+	if (state == -1)
+		state = detect_avx2() ? 1 : 0;
+	return state == 1;
+#else
+	return false;
+#endif
+}
+
+static bool parse_cpu_index(const char **list, size_t *index)
+{
+	const char *str = *list;
+	size_t val = 0;
+
+	if (*str < '0' || *str > '9')
+		return false;
+
+	while (*str >= '0' && *str <= '9') {
+		val = val * 10 + (size_t)(*str - '0');
+		if (val > 0xFFFF)
+			return false;
+		str++;
+	}
+
+	*index = val;
+	*list = str;
+	return true;
+}
+
+bool os_parse_cpu_list(const char *list, bool *cpus, size_t count)
+{
+	bool found = false;
+
+	if (!list || !cpus)
+		return false;
+
+	memset(cpus, 0, count * sizeof(*cpus));
+
+	while (*list) {
+		size_t first, last;
+
+		while (*list == ' ')
+			list++;
+		if (!parse_cpu_index(&list, &first))
+			return false;
+
+		last = first;
+		if (*list == '-') {
+			list++;
+			if (!parse_cpu_index(&list, &last) || last < first)
+				return false;
+		}
+
+		while (*list == ' ')
+			list++;
+		if (*list == ',')
+			list++;
+		else if (*list)
+			return false;
+
+		if (last >= count)
+			return false;
+
+		for (size_t i = first; i <= last; i++)
+			cpus[i] = true;
+		found = true;
+	}
+
+	return found;
+}
@@ -185,8 +185,25 @@ EXPORT void os_breakpoint(void);
 EXPORT int os_get_physical_cores(void);
 EXPORT int os_get_logical_cores(void);
 
+/* Parses a list of CPU indices such as "0-3,8,10-11" and sets cpus[i] for
+ * every index in it.  Returns false if the list is empty, malformed or has
+ * an index of count or above. */
+EXPORT bool os_parse_cpu_list(const char *list, bool *cpus, size_t count);
+
+EXPORT int os_getpid(void);
+
+/* Runtime CPU feature checks, used to pick SIMD code paths.  These are safe
+ * to call from any thread and always return false on non-x86 CPUs. */
+EXPORT bool os_cpu_has_avx2(void);
+
 EXPORT uint64_t os_get_sys_free_size(void);
 
+/* Page granular allocations straight from the OS, meant for large buffers
+ * that are reused for a long time.  Where supported, the memory is backed by
+ * transparent huge pages.  Returns NULL on failure. */
+EXPORT void *os_large_alloc(size_t size);
+EXPORT void os_large_free(void *ptr, size_t size);
+
 struct os_proc_memory_usage {
 	uint64_t resident_size;
 	uint64_t virtual_size;
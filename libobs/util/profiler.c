@@ -7,6 +7,7 @@
 #include "threading.h"
 
 #include <math.h>
+#include <time.h>
 
 #include <zlib.h>
 
@@ -263,6 +264,143 @@ static DARRAY(profile_root_entry) root_entries;
 static THREAD_LOCAL profile_call *thread_context = NULL;
 static THREAD_LOCAL bool thread_enabled = true;
 
+/* ------------------------------------------------------------------------- */
+/* Timeline trace recording */
+
+/* duration of markers, which have none */
+#define TRACE_INSTANT UINT64_MAX
+
+/* buffers of exited threads kept for their history before being reused */
+#define TRACE_MAX_EXITED_THREADS 8
+
+struct trace_event {
+	const char *name;
+	uint64_t start;
+	uint64_t duration;
+};
+
+/* written by its own thread, the mutex is only contended by dumps */
+struct trace_thread {
+	pthread_mutex_t mutex;
+	uint64_t id;
+	const char *name;
+	bool exited;
+
+	struct trace_event *events;
+	size_t capacity;
+	uint64_t written;
+};
+
+static volatile bool tracing = false;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct trace_thread *) trace_threads;
+static size_t trace_capacity = 0;
+static uint64_t trace_next_id = 1;
+
+/* changes when the buffers are freed, so that threads drop theirs */
+static volatile long trace_generation = 0;
+
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;
+static THREAD_LOCAL struct trace_thread *thread_trace = NULL;
+static THREAD_LOCAL long thread_trace_generation = 0;
+
+static void reset_trace_thread(struct trace_thread *tt, size_t capacity)
+{
+	pthread_mutex_lock(&tt->mutex);
+	if (tt->capacity != capacity) {
+		tt->events = brealloc(tt->events,
+				      sizeof(struct trace_event) * capacity);
+		tt->capacity = capacity;
+	}
+	tt->written = 0;
+	pthread_mutex_unlock(&tt->mutex);
+}
+
+/* the buffer stays in trace_threads for dumps after its thread is gone */
+static void trace_thread_exit(void *data)
+{
+	struct trace_thread *tt = data;
+
+	pthread_mutex_lock(&trace_mutex);
+	if (da_find(trace_threads, &tt, 0) != DARRAY_INVALID)
+		tt->exited = true;
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+static void create_trace_key(void)
+{
+	pthread_key_create(&trace_key, trace_thread_exit);
+}
+
+/* assumes trace_mutex */
+static struct trace_thread *reuse_exited_trace_thread(void)
+{
+	struct trace_thread *oldest = NULL;
+	size_t exited = 0;
+
+	for (size_t i = 0; i < trace_threads.num; i++) {
+		struct trace_thread *tt = trace_threads.array[i];
+		if (tt->exited) {
+			if (!oldest || tt->id < oldest->id)
+				oldest = tt;
+			exited++;
+		}
+	}
+
+	return exited >= TRACE_MAX_EXITED_THREADS ? oldest : NULL;
+}
+
+static struct trace_thread *get_trace_thread(void)
+{
+	struct trace_thread *tt = thread_trace;
+	long generation = os_atomic_load_long(&trace_generation);
+
+	if (tt && thread_trace_generation == generation)
+		return tt;
+
+	pthread_once(&trace_key_once, create_trace_key);
+
+	pthread_mutex_lock(&trace_mutex);
+	tt = reuse_exited_trace_thread();
+	if (!tt) {
+		tt = bzalloc(sizeof(*tt));
+		pthread_mutex_init(&tt->mutex, NULL);
+		da_push_back(trace_threads, &tt);
+	}
+
+	tt->id = trace_next_id++;
+	tt->name = NULL;
+	tt->exited = false;
+	reset_trace_thread(tt, trace_capacity);
+	pthread_mutex_unlock(&trace_mutex);
+
+	pthread_setspecific(trace_key, tt);
+	thread_trace = tt;
+	thread_trace_generation = generation;
+	return tt;
+}
+
+static void trace_record(const char *name, uint64_t start, uint64_t duration,
+			 bool root)
+{
+	struct trace_thread *tt = get_trace_thread();
+	struct trace_event *event;
+
+	pthread_mutex_lock(&tt->mutex);
+	if (tt->capacity) {
+		event = &tt->events[tt->written++ % tt->capacity];
+		event->name = name;
+		event->start = start;
+		event->duration = duration;
+
+		/* threads are named after the first root they run */
+		if (root && !tt->name)
+			tt->name = name;
+	}
+	pthread_mutex_unlock(&tt->mutex);
+}
+
 void profiler_start(void)
 {
 	pthread_mutex_lock(&root_mutex);
@@ -433,6 +571,10 @@ void profile_end(const char *name)
 	call->overhead_end = os_gettime_ns();
 #endif
 
+	if (os_atomic_load_bool(&tracing))
+		trace_record(call->name, call->start_time,
+			     end - call->start_time, !call->parent);
+
 	if (call->parent)
 		return;
 
@@ -799,6 +941,8 @@ static void free_profile_entry(profile_entry *entry)
 	da_free(entry->children);
 }
 
+static void free_trace(void);
+
 void profiler_free(void)
 {
 	DARRAY(profile_root_entry) old_root_entries = {0};
@@ -825,6 +969,305 @@ void profiler_free(void)
 	}
 
 	da_free(old_root_entries);
+
+	free_trace();
+}
+
+/* ------------------------------------------------------------------------- */
+/* Timeline tracing */
+
+/* triggers wait this long before dumping, to catch what follows too */
+#define TRACE_TRIGGER_DELAY_MS 2000
+/* the least time between two dumps written by triggers */
+#define TRACE_TRIGGER_INTERVAL_MS 30000
+
+static char *trigger_dir = NULL;
+static os_event_t *trigger_event = NULL;
+static os_event_t *trigger_stop_event = NULL;
+static pthread_t trigger_thread;
+static bool trigger_thread_active = false;
+
+struct trace_thread_copy {
+	uint64_t id;
+	const char *name;
+	DARRAY(struct trace_event) events;
+};
+
+static void copy_trace_thread(struct trace_thread *tt,
+			      struct trace_thread_copy *copy)
+{
+	pthread_mutex_lock(&tt->mutex);
+	copy->id = tt->id;
+	copy->name = tt->name;
+
+	if (tt->capacity) {
+		uint64_t count = tt->written < tt->capacity ? tt->written
+							     : tt->capacity;
+
+		for (uint64_t i = tt->written - count; i < tt->written; i++)
+			da_push_back(copy->events,
+				     &tt->events[i % tt->capacity]);
+	}
+	pthread_mutex_unlock(&tt->mutex);
+}
+
+static void trace_cat_string(struct dstr *buffer, const char *str)
+{
+	dstr_cat_ch(buffer, '"');
+
+	for (; *str; str++) {
+		unsigned char ch = (unsigned char)*str;
+
+		if (ch == '"' || ch == '\\') {
+			dstr_cat_ch(buffer, '\\');
+			dstr_cat_ch(buffer, (char)ch);
+		} else if (ch < 0x20) {
+			dstr_catf(buffer, "\\u%04x", ch);
+		} else {
+			dstr_cat_ch(buffer, (char)ch);
+		}
+	}
+
+	dstr_cat_ch(buffer, '"');
+}
+
+static void trace_cat_event(struct dstr *buffer, uint64_t tid,
+			    const struct trace_event *event, uint64_t first)
+{
+	double ts = (double)(event->start - first) / 1000.0;
+
+	dstr_cat(buffer, "{\"name\":");
+	trace_cat_string(buffer, event->name ? event->name : "");
+
+	if (event->duration == TRACE_INSTANT)
+		dstr_catf(buffer,
+			  ",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,"
+			  "\"tid\":%" PRIu64 ",\"ts\":%.3f}",
+			  tid, ts);
+	else
+		dstr_catf(buffer,
+			  ",\"ph\":\"X\",\"pid\":1,\"tid\":%" PRIu64
+			  ",\"ts\":%.3f,\"dur\":%.3f}",
+			  tid, ts, (double)event->duration / 1000.0);
+}
+
+/* Chrome's trace event format, which Perfetto and chrome://tracing load */
+static bool write_trace(FILE *f, struct trace_thread_copy *copies,
+			size_t num_copies)
+{
+	struct dstr buffer = {0};
+	uint64_t first = UINT64_MAX;
+	bool separator = false;
+
+	for (size_t i = 0; i < num_copies; i++) {
+		for (size_t j = 0; j < copies[i].events.num; j++) {
+			uint64_t start = copies[i].events.array[j].start;
+			if (start < first)
+				first = start;
+		}
+	}
+
+	dstr_copy(&buffer, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	for (size_t i = 0; i < num_copies; i++) {
+		struct trace_thread_copy *copy = &copies[i];
+
+		if (copy->name) {
+			if (separator)
+				dstr_cat(&buffer, ",\n");
+			dstr_catf(&buffer,
+				  "{\"name\":\"thread_name\",\"ph\":\"M\","
+				  "\"pid\":1,\"tid\":%" PRIu64
+				  ",\"args\":{\"name\":",
+				  copy->id);
+			trace_cat_string(&buffer, copy->name);
+			dstr_cat(&buffer, "}}");
+			separator = true;
+		}
+
+		for (size_t j = 0; j < copy->events.num; j++) {
+			if (separator)
+				dstr_cat(&buffer, ",\n");
+			trace_cat_event(&buffer, copy->id,
+					&copy->events.array[j], first);
+			separator = true;
+
+			if (buffer.len >= 65536) {
+				fwrite(buffer.array, 1, buffer.len, f);
+				dstr_resize(&buffer, 0);
+			}
+		}
+	}
+
+	dstr_cat(&buffer, "\n]}\n");
+	fwrite(buffer.array, 1, buffer.len, f);
+	dstr_free(&buffer);
+
+	return ferror(f) == 0;
+}
+
+bool profiler_trace_dump(const char *filename)
+{
+	DARRAY(struct trace_thread_copy) copies = {0};
+	bool success = false;
+	FILE *f;
+
+	pthread_mutex_lock(&trace_mutex);
+	da_resize(copies, trace_threads.num);
+	memset(copies.array, 0, sizeof(*copies.array) * copies.num);
+	for (size_t i = 0; i < trace_threads.num; i++)
+		copy_trace_thread(trace_threads.array[i], &copies.array[i]);
+	pthread_mutex_unlock(&trace_mutex);
+
+	f = os_fopen(filename, "wb");
+	if (f) {
+		success = write_trace(f, copies.array, copies.num);
+		fclose(f);
+	}
+
+	for (size_t i = 0; i < copies.num; i++)
+		da_free(copies.array[i].events);
+	da_free(copies);
+	return success;
+}
+
+static void write_trigger_dump(void)
+{
+	struct dstr path = {0};
+	time_t now = time(NULL);
+	char name[64];
+
+	strftime(name, sizeof(name), "trace %Y-%m-%d %H-%M-%S.json",
+		 localtime(&now));
+	dstr_printf(&path, "%s/%s", trigger_dir, name);
+
+	if (profiler_trace_dump(path.array))
+		blog(LOG_INFO, "Saved timeline trace to '%s'", path.array);
+	else
+		blog(LOG_WARNING, "Could not save timeline trace to '%s'",
+		     path.array);
+
+	dstr_free(&path);
+}
+
+static void *trigger_thread_func(void *unused)
+{
+	os_set_thread_name("profiler: trace triggers");
+
+	while (os_event_wait(trigger_event) == 0) {
+		if (os_event_timedwait(trigger_stop_event,
+				       TRACE_TRIGGER_DELAY_MS) != ETIMEDOUT)
+			break;
+
+		write_trigger_dump();
+
+		if (os_event_timedwait(trigger_stop_event,
+				       TRACE_TRIGGER_INTERVAL_MS) != ETIMEDOUT)
+			break;
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+/* assumes trace_mutex */
+static bool start_trigger_thread(const char *dir)
+{
+	if (os_event_init(&trigger_event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+	if (os_event_init(&trigger_stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		return false;
+
+	trigger_dir = bstrdup(dir);
+	trigger_thread_active = pthread_create(&trigger_thread, NULL,
+					       trigger_thread_func, NULL) == 0;
+	return trigger_thread_active;
+}
+
+static void stop_trigger_thread(void)
+{
+	bool active;
+
+	pthread_mutex_lock(&trace_mutex);
+	active = trigger_thread_active;
+	trigger_thread_active = false;
+	if (active) {
+		os_event_signal(trigger_stop_event);
+		os_event_signal(trigger_event);
+	}
+	pthread_mutex_unlock(&trace_mutex);
+
+	if (active)
+		pthread_join(trigger_thread, NULL);
+
+	pthread_mutex_lock(&trace_mutex);
+	os_event_destroy(trigger_event);
+	os_event_destroy(trigger_stop_event);
+	trigger_event = NULL;
+	trigger_stop_event = NULL;
+	bfree(trigger_dir);
+	trigger_dir = NULL;
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+void profiler_trace_start(size_t events_per_thread, const char *dir)
+{
+	profiler_trace_stop();
+
+	pthread_mutex_lock(&trace_mutex);
+	trace_capacity = events_per_thread;
+	for (size_t i = 0; i < trace_threads.num; i++)
+		reset_trace_thread(trace_threads.array[i], events_per_thread);
+
+	if (events_per_thread && dir && *dir && !start_trigger_thread(dir))
+		blog(LOG_WARNING, "Could not start the timeline trace "
+				  "triggers");
+
+	os_atomic_set_bool(&tracing, events_per_thread > 0);
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+void profiler_trace_stop(void)
+{
+	os_atomic_set_bool(&tracing, false);
+	stop_trigger_thread();
+}
+
+bool profiler_trace_active(void)
+{
+	return os_atomic_load_bool(&tracing);
+}
+
+void profiler_trace_trigger(const char *reason)
+{
+	if (!os_atomic_load_bool(&tracing))
+		return;
+
+	trace_record(reason, os_gettime_ns(), TRACE_INSTANT, false);
+
+	pthread_mutex_lock(&trace_mutex);
+	if (trigger_event)
+		os_event_signal(trigger_event);
+	pthread_mutex_unlock(&trace_mutex);
+}
+
+static void free_trace(void)
+{
+	profiler_trace_stop();
+
+	pthread_mutex_lock(&trace_mutex);
+	for (size_t i = 0; i < trace_threads.num; i++) {
+		struct trace_thread *tt = trace_threads.array[i];
+
+		pthread_mutex_destroy(&tt->mutex);
+		bfree(tt->events);
+		bfree(tt);
+	}
+
+	da_free(trace_threads);
+	trace_capacity = 0;
+	os_atomic_inc_long(&trace_generation);
+	pthread_mutex_unlock(&trace_mutex);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -33,6 +33,25 @@ EXPORT void profiler_print_time_between_calls(profiler_snapshot_t *snap);
 
 EXPORT void profiler_free(void);
 
+/* ------------------------------------------------------------------------- */
+/* Timeline tracing */
+
+/*
+ * Records every profile_start/profile_end pair of each thread into a ring of
+ * events_per_thread events, which can be dumped as a Chrome trace.  With a
+ * trigger_dir, triggers also dump the trace into that directory shortly after
+ * they happen.  Events are only recorded while the profiler is running.
+ */
+EXPORT void profiler_trace_start(size_t events_per_thread,
+				 const char *trigger_dir);
+EXPORT void profiler_trace_stop(void);
+EXPORT bool profiler_trace_active(void);
+
+EXPORT bool profiler_trace_dump(const char *filename);
+
+/* marks the timeline, reason must stay valid for as long as the profiler */
+EXPORT void profiler_trace_trigger(const char *reason);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler name storage */
 
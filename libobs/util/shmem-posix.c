@@ -0,0 +1,172 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bmem.h"
+#include "dstr.h"
+#include "shmem.h"
+
+struct os_shmem {
+	char *name;
+	void *data;
+	size_t size;
+	bool owner;
+};
+
+static inline void get_shm_name(struct dstr *out, const char *name)
+{
+	dstr_copy(out, "/");
+	dstr_cat(out, name);
+}
+
+static os_shmem_t *map_shmem(const char *name, size_t size, bool create)
+{
+	struct os_shmem *shm;
+	struct dstr shm_name = {0};
+	void *data;
+	int fd;
+
+	get_shm_name(&shm_name, name);
+
+	fd = create ? shm_open(shm_name.array, O_RDWR | O_CREAT | O_EXCL, 0600)
+		    : shm_open(shm_name.array, O_RDWR, 0600);
+	if (fd == -1)
+		goto fail;
+
+	if (create && ftruncate(fd, (off_t)size) != 0) {
+		close(fd);
+		shm_unlink(shm_name.array);
+		goto fail;
+	}
+
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		if (create)
+			shm_unlink(shm_name.array);
+		goto fail;
+	}
+
+	shm = bzalloc(sizeof(*shm));
+	shm->name = shm_name.array;
+	shm->data = data;
+	shm->size = size;
+	shm->owner = create;
+	return shm;
+
+fail:
+	dstr_free(&shm_name);
+	return NULL;
+}
+
+os_shmem_t *os_shmem_create(const char *name, size_t size)
+{
+	if (!name || !size)
+		return NULL;
+	return map_shmem(name, size, true);
+}
+
+os_shmem_t *os_shmem_open(const char *name, size_t size)
+{
+	if (!name || !size)
+		return NULL;
+	return map_shmem(name, size, false);
+}
+
+os_shmem_t *os_shmem_create_file(const char *path, size_t size)
+{
+	struct os_shmem *shm;
+	void *data;
+	int fd;
+
+	if (!path || !size)
+		return NULL;
+
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd == -1)
+		return NULL;
+
+	/* the open descriptor and the mapping keep the file alive */
+	unlink(path);
+
+	if (ftruncate(fd, (off_t)size) != 0) {
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	shm = bzalloc(sizeof(*shm));
+	shm->data = data;
+	shm->size = size;
+	return shm;
+}
+
+os_shmem_t *os_shmem_map_file(const char *path, size_t size)
+{
+	struct os_shmem *shm;
+	struct stat st;
+	void *data;
+	int fd;
+
+	if (!path || !size)
+		return NULL;
+
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat(fd, &st) != 0 ||
+	    ((uint64_t)st.st_size < size && ftruncate(fd, (off_t)size) != 0)) {
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	shm = bzalloc(sizeof(*shm));
+	shm->data = data;
+	shm->size = size;
+	return shm;
+}
+
+void os_shmem_unlink(os_shmem_t *shm)
+{
+	if (shm && shm->name) {
+		shm_unlink(shm->name);
+		bfree(shm->name);
+		shm->name = NULL;
+	}
+}
+
+void os_shmem_destroy(os_shmem_t *shm)
+{
+	if (!shm)
+		return;
+
+	munmap(shm->data, shm->size);
+	if (shm->owner)
+		os_shmem_unlink(shm);
+	bfree(shm->name);
+	bfree(shm);
+}
+
+void *os_shmem_data(os_shmem_t *shm)
+{
+	return shm ? shm->data : NULL;
+}
+
+size_t os_shmem_size(const os_shmem_t *shm)
+{
+	return shm ? shm->size : 0;
+}
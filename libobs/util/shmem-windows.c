@@ -0,0 +1,162 @@
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include "bmem.h"
+#include "dstr.h"
+#include "platform.h"
+#include "shmem.h"
+
+struct os_shmem {
+	HANDLE handle;
+	void *data;
+	size_t size;
+};
+
+static inline wchar_t *get_shm_name(const char *name)
+{
+	struct dstr full_name = {0};
+	wchar_t *wname = NULL;
+
+	dstr_copy(&full_name, "Local\\");
+	dstr_cat(&full_name, name);
+	os_utf8_to_wcs_ptr(full_name.array, full_name.len, &wname);
+	dstr_free(&full_name);
+	return wname;
+}
+
+static os_shmem_t *map_shmem(HANDLE handle, size_t size)
+{
+	struct os_shmem *shm;
+	void *data;
+
+	data = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!data) {
+		CloseHandle(handle);
+		return NULL;
+	}
+
+	shm = bzalloc(sizeof(*shm));
+	shm->handle = handle;
+	shm->data = data;
+	shm->size = size;
+	return shm;
+}
+
+os_shmem_t *os_shmem_create(const char *name, size_t size)
+{
+	wchar_t *wname;
+	HANDLE handle;
+
+	if (!name || !size)
+		return NULL;
+
+	wname = get_shm_name(name);
+	handle = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+				    (DWORD)((uint64_t)size >> 32),
+				    (DWORD)size, wname);
+	bfree(wname);
+
+	if (!handle)
+		return NULL;
+	if (GetLastError() == ERROR_ALREADY_EXISTS) {
+		CloseHandle(handle);
+		return NULL;
+	}
+
+	return map_shmem(handle, size);
+}
+
+os_shmem_t *os_shmem_open(const char *name, size_t size)
+{
+	wchar_t *wname;
+	HANDLE handle;
+
+	if (!name || !size)
+		return NULL;
+
+	wname = get_shm_name(name);
+	handle = OpenFileMappingW(FILE_MAP_ALL_ACCESS, false, wname);
+	bfree(wname);
+
+	return handle ? map_shmem(handle, size) : NULL;
+}
+
+os_shmem_t *os_shmem_create_file(const char *path, size_t size)
+{
+	wchar_t *wpath = NULL;
+	HANDLE file;
+	HANDLE handle;
+
+	if (!path || !size)
+		return NULL;
+
+	os_utf8_to_wcs_ptr(path, 0, &wpath);
+	file = CreateFileW(wpath, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+			   CREATE_NEW,
+			   FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+			   NULL);
+	bfree(wpath);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	/* the mapping keeps the file open; it is deleted once that closes */
+	handle = CreateFileMappingW(file, NULL, PAGE_READWRITE,
+				    (DWORD)((uint64_t)size >> 32),
+				    (DWORD)size, NULL);
+	CloseHandle(file);
+
+	return handle ? map_shmem(handle, size) : NULL;
+}
+
+os_shmem_t *os_shmem_map_file(const char *path, size_t size)
+{
+	wchar_t *wpath = NULL;
+	HANDLE file;
+	HANDLE handle;
+
+	if (!path || !size)
+		return NULL;
+
+	os_utf8_to_wcs_ptr(path, 0, &wpath);
+	file = CreateFileW(wpath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+			   NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	bfree(wpath);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	/* extends the file if it is smaller than the mapping */
+	handle = CreateFileMappingW(file, NULL, PAGE_READWRITE,
+				    (DWORD)((uint64_t)size >> 32),
+				    (DWORD)size, NULL);
+	CloseHandle(file);
+
+	return handle ? map_shmem(handle, size) : NULL;
+}
+
+/* mappings lose their name once every handle is closed */
+void os_shmem_unlink(os_shmem_t *shm)
+{
+	UNUSED_PARAMETER(shm);
+}
+
+void os_shmem_destroy(os_shmem_t *shm)
+{
+	if (!shm)
+		return;
+
+	UnmapViewOfFile(shm->data);
+	CloseHandle(shm->handle);
+	bfree(shm);
+}
+
+void *os_shmem_data(os_shmem_t *shm)
+{
+	return shm ? shm->data : NULL;
+}
+
+size_t os_shmem_size(const os_shmem_t *shm)
+{
+	return shm ? shm->size : 0;
+}
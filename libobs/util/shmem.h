@@ -0,0 +1,41 @@
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Named shared memory that can be mapped by another process, such as a
+ * helper process started with os_process_pipe_create.  The name should be
+ * short (macOS limits it to 31 characters) and unique to the creator.
+ */
+
+struct os_shmem;
+typedef struct os_shmem os_shmem_t;
+
+/** Creates and maps a new zero-filled region; fails if the name exists */
+EXPORT os_shmem_t *os_shmem_create(const char *name, size_t size);
+/** Maps a region created by another process */
+EXPORT os_shmem_t *os_shmem_open(const char *name, size_t size);
+/** Maps a new private region backed by a temporary file at the given path
+ * rather than by memory, so the OS can page it out.  The file is removed
+ * when the region is destroyed, or right away where the OS allows it. */
+EXPORT os_shmem_t *os_shmem_create_file(const char *path, size_t size);
+/** Maps the file at the given path, creating it or extending it to the given
+ * size if needed.  Writes go to the file, which is kept once the region is
+ * destroyed, so it can serve as a cache that is mapped again later. */
+EXPORT os_shmem_t *os_shmem_map_file(const char *path, size_t size);
+EXPORT void os_shmem_destroy(os_shmem_t *shm);
+
+/** Removes the name so no further process can open the region, while
+ * existing mappings stay valid */
+EXPORT void os_shmem_unlink(os_shmem_t *shm);
+
+EXPORT void *os_shmem_data(os_shmem_t *shm);
+EXPORT size_t os_shmem_size(const os_shmem_t *shm);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "c99defs.h"
+#include <string.h>
+
+#include "bmem.h"
+#include "threading.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bounded lock-free single producer, single consumer ring of pointers.
+ *
+ * Exactly one thread may push and exactly one thread may pop at a time; the
+ * two sides never block each other.  Callers that have several producers or
+ * consumers must serialize each side themselves.
+ */
+
+struct spsc_ring {
+	void **items;
+	size_t capacity;
+
+	/* written by the consumer only */
+	volatile long head;
+	char pad[64];
+	/* written by the producer only */
+	volatile long tail;
+};
+
+static inline void spsc_ring_init(struct spsc_ring *ring, size_t capacity)
+{
+	size_t size = 1;
+	while (size < capacity)
+		size <<= 1;
+
+	memset(ring, 0, sizeof(*ring));
+	ring->items = bzalloc(sizeof(void *) * size);
+	ring->capacity = size;
+}
+
+static inline void spsc_ring_free(struct spsc_ring *ring)
+{
+	bfree(ring->items);
+	memset(ring, 0, sizeof(*ring));
+}
+
+static inline size_t spsc_ring_size(const struct spsc_ring *ring)
+{
+	unsigned long head = (unsigned long)os_atomic_load_long(&ring->head);
+	unsigned long tail = (unsigned long)os_atomic_load_long(&ring->tail);
+	return (size_t)(tail - head);
+}
+
+/* returns false if the ring is full */
+static inline bool spsc_ring_push(struct spsc_ring *ring, void *item)
+{
+	unsigned long head = (unsigned long)os_atomic_load_long(&ring->head);
+	unsigned long tail = (unsigned long)os_atomic_load_long(&ring->tail);
+
+	if ((size_t)(tail - head) >= ring->capacity)
+		return false;
+
+	ring->items[tail & (ring->capacity - 1)] = item;
+	os_atomic_store_long(&ring->tail, (long)(tail + 1));
+	return true;
+}
+
+/* returns NULL if the ring is empty */
+static inline void *spsc_ring_pop(struct spsc_ring *ring)
+{
+	unsigned long head = (unsigned long)os_atomic_load_long(&ring->head);
+	unsigned long tail = (unsigned long)os_atomic_load_long(&ring->tail);
+	void *item;
+
+	if (head == tail)
+		return NULL;
+
+	item = ring->items[head & (ring->capacity - 1)];
+	os_atomic_store_long(&ring->head, (long)(head + 1));
+	return item;
+}
+
+#ifdef __cplusplus
+}
+#endif
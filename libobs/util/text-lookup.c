@@ -14,170 +14,97 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <stdlib.h>
+
 #include "dstr.h"
+#include "darray.h"
 #include "text-lookup.h"
 #include "lexer.h"
 #include "platform.h"
+#include "threading.h"
 
 /* ------------------------------------------------------------------------- */
 
-struct text_leaf {
-	char *lookup, *value;
-};
-
-static inline void text_leaf_destroy(struct text_leaf *leaf)
-{
-	if (leaf) {
-		bfree(leaf->lookup);
-		bfree(leaf->value);
-		bfree(leaf);
-	}
-}
+/* Strings are kept in one block of memory per file, and looked up through a
+ * table of entries sorted by the hash of their (case insensitive) names.
+ * Files are only parsed on the first lookup, so modules whose text is never
+ * used never pay for it. */
 
-/* ------------------------------------------------------------------------- */
+struct text_entry {
+	uint32_t hash;
+	uint32_t order;
+	const char *lookup;
+	const char *value;
+};
 
-struct text_node {
-	struct dstr str;
-	struct text_node *first_subnode;
-	struct text_leaf *leaf;
+struct text_lookup {
+	pthread_mutex_t mutex;
+	volatile bool loaded;
+	uint32_t num_added;
 
-	struct text_node *next;
+	DARRAY(char *) pending;
+	DARRAY(char *) blocks;
+	DARRAY(struct text_entry) entries;
 };
 
-static void text_node_destroy(struct text_node *node)
+static inline char lookup_lower(char ch)
 {
-	struct text_node *subnode;
-
-	if (!node)
-		return;
-
-	subnode = node->first_subnode;
-	while (subnode) {
-		struct text_node *destroy_node = subnode;
-
-		subnode = subnode->next;
-		text_node_destroy(destroy_node);
-	}
-
-	dstr_free(&node->str);
-	if (node->leaf)
-		text_leaf_destroy(node->leaf);
-	bfree(node);
+	return (ch >= 'A' && ch <= 'Z') ? ch + 0x20 : ch;
 }
 
-static struct text_node *text_node_bychar(struct text_node *node, char ch)
+static uint32_t lookup_hash(const char *str, size_t len)
 {
-	struct text_node *subnode = node->first_subnode;
-
-	while (subnode) {
-		if (!dstr_is_empty(&subnode->str) &&
-		    subnode->str.array[0] == ch)
-			return subnode;
+	uint32_t hash = 2166136261u;
 
-		subnode = subnode->next;
+	for (size_t i = 0; i < len && str[i]; i++) {
+		hash ^= (uint8_t)lookup_lower(str[i]);
+		hash *= 16777619u;
 	}
 
-	return NULL;
+	return hash;
 }
 
-static struct text_node *text_node_byname(struct text_node *node,
-					  const char *name)
+static int entry_cmp(const void *a, const void *b)
 {
-	struct text_node *subnode = node->first_subnode;
+	const struct text_entry *e1 = a;
+	const struct text_entry *e2 = b;
+	int val;
 
-	while (subnode) {
-		if (astrcmpi_n(subnode->str.array, name, subnode->str.len) == 0)
-			return subnode;
+	if (e1->hash != e2->hash)
+		return e1->hash < e2->hash ? -1 : 1;
 
-		subnode = subnode->next;
-	}
+	val = astrcmpi(e1->lookup, e2->lookup);
+	if (val != 0)
+		return val;
 
-	return NULL;
+	return e1->order < e2->order ? -1 : (e1->order > e2->order ? 1 : 0);
 }
 
-/* ------------------------------------------------------------------------- */
-
-struct text_lookup {
-	struct dstr language;
-	struct text_node *top;
-};
-
-static void lookup_createsubnode(const char *lookup_val, struct text_leaf *leaf,
-				 struct text_node *node)
+/* sorts the entries and drops all but the last added value of each name,
+ * values of files added later replace those of files added earlier */
+static void lookup_sort(struct text_lookup *lookup)
 {
-	struct text_node *new = bzalloc(sizeof(struct text_node));
-	new->leaf = leaf;
-	new->next = node->first_subnode;
-	dstr_copy(&new->str, lookup_val);
-
-	node->first_subnode = new;
-}
+	struct text_entry *array = lookup->entries.array;
+	size_t num = lookup->entries.num;
+	size_t count = 0;
 
-static void lookup_splitnode(const char *lookup_val, size_t len,
-			     struct text_leaf *leaf, struct text_node *node)
-{
-	struct text_node *split = bzalloc(sizeof(struct text_node));
+	if (!num)
+		return;
 
-	dstr_copy(&split->str, node->str.array + len);
-	split->leaf = node->leaf;
-	split->first_subnode = node->first_subnode;
-	node->first_subnode = split;
+	qsort(array, num, sizeof(*array), entry_cmp);
 
-	dstr_resize(&node->str, len);
+	for (size_t i = 0; i < num; i++) {
+		const struct text_entry *next = array + i + 1;
 
-	if (lookup_val[len] != 0) {
-		node->leaf = NULL;
-		lookup_createsubnode(lookup_val + len, leaf, node);
-	} else {
-		node->leaf = leaf;
+		if (i + 1 == num || array[i].hash != next->hash ||
+		    astrcmpi(array[i].lookup, next->lookup) != 0)
+			array[count++] = array[i];
 	}
-}
 
-static inline void lookup_replaceleaf(struct text_node *node,
-				      struct text_leaf *leaf)
-{
-	text_leaf_destroy(node->leaf);
-	node->leaf = leaf;
+	da_resize(lookup->entries, count);
 }
 
-static void lookup_addstring(const char *lookup_val, struct text_leaf *leaf,
-			     struct text_node *node)
-{
-	struct text_node *child;
-
-	/* value already exists, so replace */
-	if (!lookup_val || !*lookup_val) {
-		lookup_replaceleaf(node, leaf);
-		return;
-	}
-
-	child = text_node_bychar(node, *lookup_val);
-	if (child) {
-		size_t len;
-
-		for (len = 0; len < child->str.len; len++) {
-			char val1 = child->str.array[len],
-			     val2 = lookup_val[len];
-
-			if (val1 >= 'A' && val1 <= 'Z')
-				val1 += 0x20;
-			if (val2 >= 'A' && val2 <= 'Z')
-				val2 += 0x20;
-
-			if (val1 != val2)
-				break;
-		}
-
-		if (len == child->str.len) {
-			lookup_addstring(lookup_val + len, leaf, child);
-			return;
-		} else {
-			lookup_splitnode(lookup_val, len, leaf, child);
-		}
-	} else {
-		lookup_createsubnode(lookup_val, leaf, node);
-	}
-}
+/* ------------------------------------------------------------------------- */
 
 static void lookup_getstringtoken(struct lexer *lex, struct strref *token)
 {
@@ -292,19 +219,37 @@ static char *convert_string(const char *str, size_t len)
 	return out.array;
 }
 
+struct text_offsets {
+	size_t lookup;
+	size_t value;
+};
+
+static void block_add(struct darray *block, const char *str, size_t len)
+{
+	char nul = 0;
+
+	darray_push_back_array(sizeof(char), block, str, len);
+	darray_push_back(sizeof(char), block, &nul);
+}
+
 static void lookup_addfiledata(struct text_lookup *lookup,
 			       const char *file_data)
 {
+	DARRAY(char) block;
+	DARRAY(struct text_offsets) offsets;
 	struct lexer lex;
 	struct strref name, value;
 
+	da_init(block);
+	da_init(offsets);
 	lexer_init(&lex);
 	lexer_start(&lex, file_data);
 	strref_clear(&name);
 	strref_clear(&value);
 
 	while (lookup_gettoken(&lex, &name)) {
-		struct text_leaf *leaf;
+		struct text_offsets *item;
+		char *converted;
 		bool got_eq = false;
 
 		if (*name.array == '\n')
@@ -319,52 +264,129 @@ static void lookup_addfiledata(struct text_lookup *lookup,
 			goto getval;
 		}
 
-		leaf = bmalloc(sizeof(struct text_leaf));
-		leaf->lookup = bstrdup_n(name.array, name.len);
-		leaf->value = convert_string(value.array, value.len);
+		converted = convert_string(value.array, value.len);
 
-		lookup_addstring(leaf->lookup, leaf, lookup->top);
+		item = da_push_back_new(offsets);
+		item->lookup = block.num;
+		block_add(&block.da, name.array, name.len);
+		item->value = block.num;
+		block_add(&block.da, converted, strlen(converted));
+
+		bfree(converted);
 
 		if (!lookup_goto_nextline(&lex))
 			break;
 	}
 
 	lexer_free(&lex);
+
+	if (offsets.num) {
+		da_push_back(lookup->blocks, &block.array);
+
+		for (size_t i = 0; i < offsets.num; i++) {
+			struct text_entry *entry =
+				da_push_back_new(lookup->entries);
+			const char *str = block.array + offsets.array[i].lookup;
+
+			entry->hash = lookup_hash(str, strlen(str));
+			entry->order = lookup->num_added++;
+			entry->lookup = str;
+			entry->value = block.array + offsets.array[i].value;
+		}
+	} else {
+		da_free(block);
+	}
+
+	da_free(offsets);
 }
 
-static inline bool lookup_getstring(const char *lookup_val, const char **out,
-				    struct text_node *node)
+static bool lookup_addfile(struct text_lookup *lookup, const char *path)
 {
-	struct text_node *child;
-	char ch;
-
-	if (!node)
-		return false;
+	struct dstr file_str;
+	char *temp = NULL;
+	FILE *file;
 
-	child = text_node_byname(node, lookup_val);
-	if (!child)
+	file = os_fopen(path, "rb");
+	if (!file)
 		return false;
 
-	lookup_val += child->str.len;
-	ch = *lookup_val;
-	if (ch)
-		return lookup_getstring(lookup_val, out, child);
+	os_fread_utf8(file, &temp);
+	dstr_init_move_array(&file_str, temp);
+	fclose(file);
 
-	if (!child->leaf)
+	if (!file_str.array)
 		return false;
 
-	*out = child->leaf->value;
+	dstr_replace(&file_str, "\r", " ");
+	lookup_addfiledata(lookup, file_str.array);
+	dstr_free(&file_str);
+
 	return true;
 }
 
+static void lookup_load(struct text_lookup *lookup)
+{
+	if (os_atomic_load_bool(&lookup->loaded))
+		return;
+
+	pthread_mutex_lock(&lookup->mutex);
+	if (!lookup->loaded) {
+		for (size_t i = 0; i < lookup->pending.num; i++) {
+			char *path = lookup->pending.array[i];
+
+			if (!lookup_addfile(lookup, path))
+				blog(LOG_WARNING,
+				     "text_lookup: Failed to load '%s'", path);
+			bfree(path);
+		}
+
+		da_free(lookup->pending);
+		lookup_sort(lookup);
+		os_atomic_set_bool(&lookup->loaded, true);
+	}
+	pthread_mutex_unlock(&lookup->mutex);
+}
+
+static bool lookup_getstring(struct text_lookup *lookup, const char *lookup_val,
+			     const char **out)
+{
+	const struct text_entry *array = lookup->entries.array;
+	size_t lo = 0;
+	size_t hi = lookup->entries.num;
+	uint32_t hash = lookup_hash(lookup_val, strlen(lookup_val));
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (array[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < lookup->entries.num && array[lo].hash == hash; lo++) {
+		if (astrcmpi(array[lo].lookup, lookup_val) == 0) {
+			*out = array[lo].value;
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /* ------------------------------------------------------------------------- */
 
 lookup_t *text_lookup_create(const char *path)
 {
 	struct text_lookup *lookup = bzalloc(sizeof(struct text_lookup));
 
-	if (!text_lookup_add(lookup, path)) {
+	if (pthread_mutex_init(&lookup->mutex, NULL) != 0) {
 		bfree(lookup);
+		return NULL;
+	}
+
+	if (!text_lookup_add(lookup, path)) {
+		text_lookup_destroy(lookup);
 		lookup = NULL;
 	}
 
@@ -373,36 +395,36 @@ lookup_t *text_lookup_create(const char *path)
 
 bool text_lookup_add(lookup_t *lookup, const char *path)
 {
-	struct dstr file_str;
-	char *temp = NULL;
-	FILE *file;
-
-	file = os_fopen(path, "rb");
-	if (!file)
-		return false;
-
-	os_fread_utf8(file, &temp);
-	dstr_init_move_array(&file_str, temp);
-	fclose(file);
+	bool success = true;
 
-	if (!file_str.array)
+	if (!path || !os_file_exists(path))
 		return false;
 
-	if (!lookup->top)
-		lookup->top = bzalloc(sizeof(struct text_node));
-
-	dstr_replace(&file_str, "\r", " ");
-	lookup_addfiledata(lookup, file_str.array);
-	dstr_free(&file_str);
+	pthread_mutex_lock(&lookup->mutex);
+	if (lookup->loaded) {
+		success = lookup_addfile(lookup, path);
+		lookup_sort(lookup);
+	} else {
+		char *copy = bstrdup(path);
+		da_push_back(lookup->pending, &copy);
+	}
+	pthread_mutex_unlock(&lookup->mutex);
 
-	return true;
+	return success;
 }
 
 void text_lookup_destroy(lookup_t *lookup)
 {
 	if (lookup) {
-		dstr_free(&lookup->language);
-		text_node_destroy(lookup->top);
+		for (size_t i = 0; i < lookup->pending.num; i++)
+			bfree(lookup->pending.array[i]);
+		for (size_t i = 0; i < lookup->blocks.num; i++)
+			bfree(lookup->blocks.array[i]);
+
+		da_free(lookup->pending);
+		da_free(lookup->blocks);
+		da_free(lookup->entries);
+		pthread_mutex_destroy(&lookup->mutex);
 
 		bfree(lookup);
 	}
@@ -411,7 +433,9 @@ void text_lookup_destroy(lookup_t *lookup)
 bool text_lookup_getstr(lookup_t *lookup, const char *lookup_val,
 			const char **out)
 {
-	if (lookup)
-		return lookup_getstring(lookup_val, out, lookup->top);
-	return false;
+	if (!lookup || !lookup_val)
+		return false;
+
+	lookup_load(lookup);
+	return lookup_getstring(lookup, lookup_val, out);
 }
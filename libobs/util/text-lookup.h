@@ -20,8 +20,9 @@
  * Text Lookup interface
  *
  *   Used for storing and looking up localized strings.  Stores localization
- * strings in a radix/trie tree to efficiently look up associated strings via a
- * unique string identifier name.
+ * strings in a table sorted by the hashes of their unique string identifier
+ * names.  Files are parsed on the first lookup rather than when added, later
+ * files replace the strings of earlier ones.
  */
 
 #include "c99defs.h"
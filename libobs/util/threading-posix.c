@@ -31,6 +31,7 @@
 #endif
 
 #include "bmem.h"
+#include "platform.h"
 #include "threading.h"
 
 struct os_event_data {
@@ -271,3 +272,69 @@ void os_set_thread_name(const char *name)
 	}
 #endif
 }
+
+bool os_set_thread_affinity(pthread_t thread, const char *cpus)
+{
+#if defined(__linux__)
+	bool list[CPU_SETSIZE];
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+
+	if (cpus && *cpus) {
+		if (!os_parse_cpu_list(cpus, list, CPU_SETSIZE))
+			return false;
+
+		for (size_t i = 0; i < CPU_SETSIZE; i++) {
+			if (list[i])
+				CPU_SET(i, &set);
+		}
+	} else {
+		/* the kernel limits this to the CPUs that exist and that the
+		 * process is allowed to use */
+		for (size_t i = 0; i < CPU_SETSIZE; i++)
+			CPU_SET(i, &set);
+	}
+
+	return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+#else
+	UNUSED_PARAMETER(thread);
+	UNUSED_PARAMETER(cpus);
+	return false;
+#endif
+}
+
+bool os_set_thread_realtime(pthread_t thread, int priority)
+{
+#if defined(__linux__)
+	struct sched_param param = {0};
+	int policy = SCHED_OTHER;
+
+	if (priority > 0) {
+		int min = sched_get_priority_min(SCHED_FIFO);
+		int max = sched_get_priority_max(SCHED_FIFO);
+
+		policy = SCHED_FIFO;
+		param.sched_priority = priority < min   ? min
+				       : priority > max ? max
+							: priority;
+	}
+
+	return pthread_setschedparam(thread, policy, &param) == 0;
+#else
+	UNUSED_PARAMETER(thread);
+	UNUSED_PARAMETER(priority);
+	return false;
+#endif
+}
+
+void *os_thread_begin_mmcss(const char *task)
+{
+	UNUSED_PARAMETER(task);
+	return NULL;
+}
+
+void os_thread_end_mmcss(void *handle)
+{
+	UNUSED_PARAMETER(handle);
+}
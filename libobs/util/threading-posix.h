@@ -60,6 +60,23 @@ static inline bool os_atomic_compare_exchange_long(volatile long *val,
 					   __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
 }
 
+static inline long long os_atomic_add_long_long(volatile long long *val,
+						long long add)
+{
+	return __atomic_add_fetch(val, add, __ATOMIC_SEQ_CST);
+}
+
+static inline long long os_atomic_load_long_long(const volatile long long *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+static inline void os_atomic_store_long_long(volatile long long *ptr,
+					     long long val)
+{
+	__atomic_store_n(ptr, val, __ATOMIC_SEQ_CST);
+}
+
 static inline void os_atomic_store_bool(volatile bool *ptr, bool val)
 {
 	__atomic_store_n(ptr, val, __ATOMIC_SEQ_CST);
@@ -79,3 +96,13 @@ static inline bool os_atomic_load_bool(const volatile bool *ptr)
 {
 	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
 }
+
+static inline void *os_atomic_load_ptr(void *const volatile *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+static inline void *os_atomic_exchange_ptr(void *volatile *ptr, void *val)
+{
+	return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
+}
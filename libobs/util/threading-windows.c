@@ -211,3 +211,90 @@ void os_set_thread_name(const char *name)
 	}
 	FreeLibrary(k32);
 }
+
+bool os_set_thread_affinity(pthread_t thread, const char *cpus)
+{
+#ifdef _MSC_VER
+	/* affinity masks only address the processor group of the process */
+	bool list[sizeof(DWORD_PTR) * 8];
+	DWORD_PTR process_mask;
+	DWORD_PTR system_mask;
+	DWORD_PTR mask = 0;
+
+	if (cpus && *cpus) {
+		if (!os_parse_cpu_list(cpus, list, sizeof(DWORD_PTR) * 8))
+			return false;
+
+		for (size_t i = 0; i < sizeof(DWORD_PTR) * 8; i++) {
+			if (list[i])
+				mask |= (DWORD_PTR)1 << i;
+		}
+	} else {
+		if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask,
+					    &system_mask))
+			return false;
+		mask = process_mask;
+	}
+
+	return SetThreadAffinityMask(pthread_getw32threadhandle_np(thread),
+				     mask) != 0;
+#else
+	UNUSED_PARAMETER(thread);
+	UNUSED_PARAMETER(cpus);
+	return false;
+#endif
+}
+
+bool os_set_thread_realtime(pthread_t thread, int priority)
+{
+	UNUSED_PARAMETER(thread);
+	UNUSED_PARAMETER(priority);
+	return false;
+}
+
+typedef HANDLE(WINAPI *set_mm_thread_characteristics_t)(LPCWSTR task,
+							 LPDWORD index);
+typedef BOOL(WINAPI *revert_mm_thread_characteristics_t)(HANDLE handle);
+
+void *os_thread_begin_mmcss(const char *task)
+{
+	set_mm_thread_characteristics_t set_characteristics;
+	HANDLE handle = NULL;
+	wchar_t *wtask;
+	DWORD index = 0;
+
+	HMODULE avrt = LoadLibraryW(L"avrt.dll");
+	if (!avrt)
+		return NULL;
+
+	set_characteristics = (set_mm_thread_characteristics_t)GetProcAddress(
+		avrt, "AvSetMmThreadCharacteristicsW");
+	if (set_characteristics && os_utf8_to_wcs_ptr(task, 0, &wtask)) {
+		handle = set_characteristics(wtask, &index);
+		bfree(wtask);
+	}
+
+	/* the module stays loaded for as long as the thread is registered,
+	 * os_thread_end_mmcss releases it */
+	if (!handle)
+		FreeLibrary(avrt);
+	return handle;
+}
+
+void os_thread_end_mmcss(void *handle)
+{
+	revert_mm_thread_characteristics_t revert_characteristics;
+	HMODULE avrt;
+
+	if (!handle)
+		return;
+
+	avrt = GetModuleHandleW(L"avrt.dll");
+	revert_characteristics =
+		(revert_mm_thread_characteristics_t)GetProcAddress(
+			avrt, "AvRevertMmThreadCharacteristics");
+	if (revert_characteristics)
+		revert_characteristics(handle);
+
+	FreeLibrary(avrt);
+}
@@ -88,6 +88,49 @@ static inline bool os_atomic_compare_exchange_long(volatile long *val,
 	return previous == old_val;
 }
 
+static inline long long os_atomic_add_long_long(volatile long long *val,
+						long long add)
+{
+#if defined(_M_IX86)
+	long long old_val;
+	do {
+		old_val = *val;
+	} while (_InterlockedCompareExchange64(val, old_val + add, old_val) !=
+		 old_val);
+	return old_val + add;
+#else
+	return _InterlockedExchangeAdd64(val, add) + add;
+#endif
+}
+
+static inline long long os_atomic_load_long_long(const volatile long long *ptr)
+{
+#if defined(_M_ARM64)
+	return (long long)__ldar64((volatile unsigned __int64 *)ptr);
+#elif defined(_M_X64)
+	const long long val =
+		__iso_volatile_load64((const volatile __int64 *)ptr);
+	_ReadWriteBarrier();
+	return val;
+#else
+	/* 64-bit loads are not atomic on 32-bit targets */
+	return _InterlockedCompareExchange64((volatile long long *)ptr, 0, 0);
+#endif
+}
+
+static inline void os_atomic_store_long_long(volatile long long *ptr,
+					     long long val)
+{
+#if defined(_M_IX86)
+	long long old_val;
+	do {
+		old_val = *ptr;
+	} while (_InterlockedCompareExchange64(ptr, val, old_val) != old_val);
+#else
+	_InterlockedExchange64(ptr, val);
+#endif
+}
+
 static inline void os_atomic_store_bool(volatile bool *ptr, bool val)
 {
 #if defined(_M_ARM64)
@@ -137,3 +180,29 @@ static inline bool os_atomic_load_bool(const volatile bool *ptr)
 
 	return b;
 }
+
+static inline void *os_atomic_load_ptr(void *const volatile *ptr)
+{
+#if defined(_M_ARM64)
+	return (void *)__ldar64((volatile unsigned __int64 *)ptr);
+#elif defined(_M_X64)
+	void *const val =
+		(void *)__iso_volatile_load64((const volatile __int64 *)ptr);
+	_ReadWriteBarrier();
+	return val;
+#else
+	void *const val =
+		(void *)__iso_volatile_load32((const volatile __int32 *)ptr);
+#if defined(_M_ARM)
+	__dmb(_ARM_BARRIER_ISH);
+#else
+	_ReadWriteBarrier();
+#endif
+	return val;
+#endif
+}
+
+static inline void *os_atomic_exchange_ptr(void *volatile *ptr, void *val)
+{
+	return _InterlockedExchangePointer(ptr, val);
+}
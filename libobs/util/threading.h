@@ -78,6 +78,26 @@ EXPORT int os_sem_wait(os_sem_t *sem);
 
 EXPORT void os_set_thread_name(const char *name);
 
+/* Restricts a thread to the CPUs of a list such as "0-3,8" (see
+ * os_parse_cpu_list), or lets it run on any CPU again if the list is NULL or
+ * empty.  Returns false if the list is invalid or the platform doesn't
+ * support setting the affinity of a thread. */
+EXPORT bool os_set_thread_affinity(pthread_t thread, const char *cpus);
+
+/* Moves a thread to the SCHED_FIFO real-time policy at priority, or back to
+ * the default policy if priority is 0.  Real-time threads preempt everything
+ * else, so this is only for threads that sleep most of the time.  Needs
+ * CAP_SYS_NICE or an rtprio limit, and returns false on platforms other than
+ * Linux. */
+EXPORT bool os_set_thread_realtime(pthread_t thread, int priority);
+
+/* Registers the calling thread with the Windows multimedia class scheduler
+ * under a task such as "Pro Audio", which keeps it from being starved by
+ * other work.  Returns a handle for os_thread_end_mmcss, or NULL on failure
+ * and on other platforms. */
+EXPORT void *os_thread_begin_mmcss(const char *task);
+EXPORT void os_thread_end_mmcss(void *handle);
+
 #ifdef _MSC_VER
 #define THREAD_LOCAL __declspec(thread)
 #else
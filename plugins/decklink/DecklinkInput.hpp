@@ -51,6 +51,7 @@ public:
 	long long id;
 	bool swap = false;
 	bool allow10Bit = false;
+	bool masterClock = false;
 	BMDVideoConnection videoConnection;
 	BMDAudioConnection audioConnection;
 };
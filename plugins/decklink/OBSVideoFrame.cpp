@@ -3,14 +3,29 @@
 OBSVideoFrame::OBSVideoFrame(long width, long height,
 			     BMDPixelFormat pixelFormat)
 {
-	int bpp = 2;
+	switch (pixelFormat) {
+	case bmdFormat10BitYUV:
+		this->rowBytes = (width + 47) / 48 * 128;
+		break;
+	case bmdFormat8BitBGRA:
+		this->rowBytes = width * 4;
+		break;
+	default:
+		this->rowBytes = width * 2;
+		break;
+	}
+
 	this->width = width;
 	this->height = height;
-	this->rowBytes = width * bpp;
-	this->data = new unsigned char[width * height * bpp + 1];
+	this->data = new unsigned char[rowBytes * height + 1];
 	this->pixelFormat = pixelFormat;
 }
 
+OBSVideoFrame::~OBSVideoFrame()
+{
+	delete[] data;
+}
+
 HRESULT OBSVideoFrame::SetFlags(BMDFrameFlags newFlags)
 {
 	flags = newFlags;
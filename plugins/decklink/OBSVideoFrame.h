@@ -16,6 +16,7 @@ private:
 
 public:
 	OBSVideoFrame(long width, long height, BMDPixelFormat pixelFormat);
+	~OBSVideoFrame();
 
 	HRESULT STDMETHODCALLTYPE SetFlags(BMDFrameFlags newFlags) override;
 
@@ -1,22 +1,43 @@
 #pragma once
 
-#include "audio-repack.h"
+#include <obs.h>
+#include <util/bmem.h>
+#include <media-io/audio-repack.h>
 
+/* Repacks 8 channel 16-bit capture frames down to the channels of a speaker
+ * layout, optionally swapping the center and LFE channels. */
 class AudioRepacker {
-	struct audio_repack arepack;
+	uint8_t map[MAX_AUDIO_CHANNELS];
+	size_t channels;
+
+	int16_t *buffer = nullptr;
+	uint32_t bufferFrames = 0;
 
 public:
-	inline AudioRepacker(audio_repack_mode_t repack_mode)
+	inline AudioRepacker(speaker_layout layout, bool swap)
+		: channels(get_audio_channels(layout))
 	{
-		audio_repack_init(&arepack, repack_mode, 16);
+		for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++)
+			map[c] = (uint8_t)c;
+
+		/* only layouts that have both a center and an LFE channel */
+		if (swap && channels >= 5) {
+			map[2] = 3;
+			map[3] = 2;
+		}
 	}
-	inline ~AudioRepacker() { audio_repack_free(&arepack); }
+	inline ~AudioRepacker() { bfree(buffer); }
 
-	inline int repack(const uint8_t *src, uint32_t frame_size)
+	inline const uint8_t *repack(const uint8_t *src, uint32_t frames)
 	{
-		return (*arepack.repack_func)(&arepack, src, frame_size);
-	}
+		if (bufferFrames < frames) {
+			buffer = (int16_t *)brealloc(
+				buffer, frames * channels * sizeof(int16_t));
+			bufferFrames = frames;
+		}
 
-	inline operator struct audio_repack *() { return &arepack; }
-	inline struct audio_repack *operator->() { return &arepack; }
+		audio_remap_s16(buffer, channels, (const int16_t *)src, 8, map,
+				frames);
+		return (const uint8_t *)buffer;
+	}
 };
@@ -23,13 +23,23 @@ static inline enum video_format ConvertPixelFormat(BMDPixelFormat format)
 	case bmdFormat8BitBGRA:
 		return VIDEO_FORMAT_BGRX;
 
+	case bmdFormat10BitYUV:
+		return VIDEO_FORMAT_V210;
+
 	default:
 	case bmdFormat8BitYUV:
-	case bmdFormat10BitYUV:;
 		return VIDEO_FORMAT_UYVY;
 	}
 }
 
+/* formats that are uploaded as they are and unpacked by the GPU, anything
+ * else is converted by the DeckLink API first */
+static inline bool IsNativePixelFormat(BMDPixelFormat format)
+{
+	return format == bmdFormat8BitBGRA || format == bmdFormat8BitYUV ||
+	       format == bmdFormat10BitYUV;
+}
+
 static inline int ConvertChannelFormat(speaker_layout format)
 {
 	switch (format) {
@@ -46,26 +56,6 @@ static inline int ConvertChannelFormat(speaker_layout format)
 	}
 }
 
-static inline audio_repack_mode_t ConvertRepackFormat(speaker_layout format,
-						      bool swap)
-{
-	switch (format) {
-	case SPEAKERS_2POINT1:
-		return repack_mode_8to3ch;
-	case SPEAKERS_4POINT0:
-		return repack_mode_8to4ch;
-	case SPEAKERS_4POINT1:
-		return swap ? repack_mode_8to5ch_swap : repack_mode_8to5ch;
-	case SPEAKERS_5POINT1:
-		return swap ? repack_mode_8to6ch_swap : repack_mode_8to6ch;
-	case SPEAKERS_7POINT1:
-		return swap ? repack_mode_8ch_swap : repack_mode_8ch;
-	default:
-		assert(false && "No repack requested");
-		return (audio_repack_mode_t)-1;
-	}
-}
-
 DeckLinkDeviceInstance::DeckLinkDeviceInstance(DecklinkBase *decklink_,
 					       DeckLinkDevice *device_)
 	: currentFrame(),
@@ -84,6 +74,9 @@ DeckLinkDeviceInstance::~DeckLinkDeviceInstance()
 	if (convertFrame) {
 		delete convertFrame;
 	}
+	if (frameConverter) {
+		frameConverter->Release();
+	}
 }
 
 void DeckLinkDeviceInstance::HandleAudioPacket(
@@ -119,11 +112,8 @@ void DeckLinkDeviceInstance::HandleAudioPacket(
 	     static_cast<DeckLinkInput *>(decklink)->swap) &&
 	    maxdevicechannel >= 8) {
 
-		if (audioRepacker->repack((uint8_t *)bytes, frameCount) < 0) {
-			LOG(LOG_ERROR, "Failed to convert audio packet data");
-			return;
-		}
-		currentPacket.data[0] = (*audioRepacker)->packet_buffer;
+		currentPacket.data[0] =
+			audioRepacker->repack((uint8_t *)bytes, frameCount);
 	} else {
 		currentPacket.data[0] = (uint8_t *)bytes;
 	}
@@ -168,16 +158,20 @@ void DeckLinkDeviceInstance::HandleVideoFrame(
 		packets->Release();
 	}
 
-	IDeckLinkVideoFrame *frame;
-	if (videoFrame->GetPixelFormat() != convertFrame->GetPixelFormat()) {
-		IDeckLinkVideoConversion *frameConverter =
-			CreateVideoConversionInstance();
-
-		frameConverter->ConvertFrame(videoFrame, convertFrame);
+	IDeckLinkVideoFrame *frame = videoFrame;
+	BMDPixelFormat format = videoFrame->GetPixelFormat();
+	if (!IsNativePixelFormat(format)) {
+		if (!frameConverter)
+			frameConverter = CreateVideoConversionInstance();
+		if (!frameConverter ||
+		    frameConverter->ConvertFrame(videoFrame, convertFrame) !=
+			    S_OK) {
+			LOG(LOG_WARNING, "Failed to convert video frame");
+			return;
+		}
 
 		frame = convertFrame;
-	} else {
-		frame = videoFrame;
+		format = convertFrame->GetPixelFormat();
 	}
 
 	void *bytes;
@@ -186,6 +180,7 @@ void DeckLinkDeviceInstance::HandleVideoFrame(
 		return;
 	}
 
+	currentFrame.format = ConvertPixelFormat(format);
 	currentFrame.data[0] = (uint8_t *)bytes;
 	currentFrame.linesize[0] = (uint32_t)frame->GetRowBytes();
 	currentFrame.width = (uint32_t)frame->GetWidth();
@@ -458,9 +453,7 @@ bool DeckLinkDeviceInstance::StartCapture(DeckLinkDeviceMode *mode_,
 		    (channelFormat != SPEAKERS_7POINT1 || swap) &&
 		    maxdevicechannel >= 8) {
 
-			const audio_repack_mode_t repack_mode =
-				ConvertRepackFormat(channelFormat, swap);
-			audioRepacker = new AudioRepacker(repack_mode);
+			audioRepacker = new AudioRepacker(channelFormat, swap);
 		}
 	}
 
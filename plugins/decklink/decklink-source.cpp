@@ -21,6 +21,18 @@ static void decklink_deactivate_when_not_showing(DeckLinkInput *decklink,
 	decklink->dwns = dwns;
 }
 
+static void decklink_set_master_clock(DeckLinkInput *decklink, bool enabled)
+{
+	/* frames are stamped with the stream time of the card, which follows
+	 * the reference input when the card is genlocked */
+	if (enabled && !decklink->masterClock)
+		obs_set_master_clock_source(decklink->GetSource());
+	else if (!enabled && decklink->masterClock)
+		obs_reset_master_clock();
+
+	decklink->masterClock = enabled;
+}
+
 static void *decklink_create(obs_data_t *settings, obs_source_t *source)
 {
 	DeckLinkInput *decklink = new DeckLinkInput(source, deviceEnum);
@@ -71,6 +83,9 @@ static void decklink_update(void *data, obs_data_t *settings)
 	decklink_deactivate_when_not_showing(
 		decklink, obs_data_get_bool(settings, DEACTIVATE_WNS));
 
+	decklink_set_master_clock(decklink,
+				  obs_data_get_bool(settings, MASTER_CLOCK));
+
 	ComPtr<DeckLinkDevice> device;
 	device.Set(deviceEnum->FindByHash(hash));
 
@@ -329,6 +344,10 @@ static obs_properties_t *decklink_get_properties(void *data)
 
 	obs_properties_add_bool(props, ALLOW_10_BIT, TEXT_ALLOW_10_BIT);
 
+	obs_property_t *clock =
+		obs_properties_add_bool(props, MASTER_CLOCK, TEXT_MASTER_CLOCK);
+	obs_property_set_long_description(clock, TEXT_MASTER_CLOCK_TOOLTIP);
+
 	UNUSED_PARAMETER(data);
 	return props;
 }
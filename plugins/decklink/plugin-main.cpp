@@ -3,6 +3,19 @@
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("decklink", "en-US")
+
+/* device discovery starts with the first use of a decklink source or
+ * output, on the thread that uses it (which has COM initialized) */
+OBS_MODULE_LOAD_FLAGS(OBS_MODULE_LOAD_DEFERRED)
+
+static const char *const decklink_types[] = {"decklink-input",
+					     "decklink_output", NULL};
+
+MODULE_EXPORT const char *const *obs_module_types(void)
+{
+	return decklink_types;
+}
+
 MODULE_EXPORT const char *obs_module_description(void)
 {
 	return "Blackmagic DeckLink source";
@@ -0,0 +1,741 @@
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/shmem.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#define blog(log_level, format, ...)                       \
+	blog(log_level, "[image_sequence: '%s'] " format, \
+	     obs_source_get_name(seq->source), ##__VA_ARGS__)
+
+#define debug(format, ...) blog(LOG_DEBUG, format, ##__VA_ARGS__)
+#define info(format, ...) blog(LOG_INFO, format, ##__VA_ARGS__)
+#define warn(format, ...) blog(LOG_WARNING, format, ##__VA_ARGS__)
+
+/*
+ * Plays a directory of numbered images, in the order of their names.
+ *
+ * Frames are decoded on the task pool, several at a time, into a small ring
+ * of frames ahead of the one that is shown.  With the cache enabled, each
+ * frame is decoded once into a raw file of every frame that is memory mapped,
+ * and played from the mapping from then on, which costs a copy per frame
+ * rather than a decode.  Frames are uploaded to a ring of dynamic textures so
+ * that an upload never waits for the GPU to finish drawing the last one.
+ */
+
+#define S_PATH "path"
+#define S_FPS "fps"
+#define S_LOOP "loop"
+#define S_CACHE "cache"
+
+#define T_(text) obs_module_text("ImageSequence." text)
+#define T_NAME obs_module_text("ImageSequence")
+#define T_PATH T_("Path")
+#define T_FPS T_("FPS")
+#define T_LOOP obs_module_text("SlideShow.Loop")
+#define T_CACHE T_("Cache")
+#define T_CACHE_DESC T_("Cache.Description")
+
+#define AHEAD_FRAMES 8
+#define UPLOAD_TEXTURES 3
+
+#define CACHE_MAGIC 0x5153424F /* "OBSQ" */
+#define CACHE_VERSION 1
+/* keeps the frames page aligned */
+#define CACHE_HEADER_SIZE 4096
+
+struct cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint32_t count;
+	uint32_t cx;
+	uint32_t cy;
+	uint32_t format;
+	uint32_t complete;
+};
+
+struct ahead_frame {
+	uint64_t pos;
+	uint8_t *data;
+	bool ready;
+};
+
+struct decode_job {
+	uint64_t pos;
+	size_t index;
+	bool to_cache;
+};
+
+struct image_sequence {
+	obs_source_t *source;
+
+	/* only changed in update, once the tasks are done */
+	char *path;
+	DARRAY(char *) files;
+	uint64_t frame_ns;
+	bool loop;
+	bool use_cache;
+	uint64_t key;
+
+	obs_task_group_t *group;
+	pthread_mutex_t mutex;
+	/* frames due soon are decoded before the frames of the cache */
+	DARRAY(struct decode_job) ahead_jobs;
+	DARRAY(struct decode_job) cache_jobs;
+	struct ahead_frame ahead[AHEAD_FRAMES];
+
+	uint32_t cx;
+	uint32_t cy;
+	enum gs_color_format format;
+	size_t frame_size;
+
+	os_shmem_t *cache;
+	bool *cached;
+	size_t cached_count;
+	/* only warned about the first time */
+	bool *failed;
+
+	/* graphics thread */
+	gs_texture_t *textures[UPLOAD_TEXTURES];
+	size_t cur_texture;
+	bool uploaded;
+	uint64_t shown_pos;
+	uint64_t time_ns;
+	uint64_t late_frames;
+};
+
+static const char *image_sequence_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return T_NAME;
+}
+
+static bool valid_extension(const char *ext)
+{
+	if (!ext)
+		return false;
+	return astrcmpi(ext, ".bmp") == 0 || astrcmpi(ext, ".tga") == 0 ||
+	       astrcmpi(ext, ".png") == 0 || astrcmpi(ext, ".jpeg") == 0 ||
+	       astrcmpi(ext, ".jpg") == 0 || astrcmpi(ext, ".webp") == 0;
+}
+
+static int compare_files(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static inline uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	return hash;
+}
+
+/* the cache is rebuilt once any file is added, removed or modified */
+static uint64_t get_files_key(struct image_sequence *seq)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (size_t i = 0; i < seq->files.num; i++) {
+		const char *file = seq->files.array[i];
+		struct stat st;
+		int64_t stamp[2] = {0};
+
+		if (os_stat(file, &st) == 0) {
+			stamp[0] = (int64_t)st.st_mtime;
+			stamp[1] = (int64_t)st.st_size;
+		}
+
+		hash = hash_bytes(hash, file, strlen(file));
+		hash = hash_bytes(hash, stamp, sizeof(stamp));
+	}
+
+	return hash;
+}
+
+static void load_files(struct image_sequence *seq)
+{
+	os_dir_t *dir = os_opendir(seq->path);
+	struct dstr file = {0};
+	struct os_dirent *ent;
+
+	if (!dir)
+		return;
+
+	while ((ent = os_readdir(dir)) != NULL) {
+		char *copy;
+
+		if (ent->directory ||
+		    !valid_extension(os_get_path_extension(ent->d_name)))
+			continue;
+
+		dstr_copy(&file, seq->path);
+		dstr_cat_ch(&file, '/');
+		dstr_cat(&file, ent->d_name);
+		copy = bstrdup(file.array);
+		da_push_back(seq->files, &copy);
+	}
+
+	dstr_free(&file);
+	os_closedir(dir);
+
+	qsort(seq->files.array, seq->files.num, sizeof(char *), compare_files);
+}
+
+static void get_cache_file(struct image_sequence *seq, struct dstr *file)
+{
+	uint64_t hash = hash_bytes(14695981039346656037ULL, seq->path,
+				   strlen(seq->path));
+	char name[32];
+	char *dir;
+
+	snprintf(name, sizeof(name), "%016" PRIx64 ".raw", hash);
+	dir = obs_module_config_path("sequence-cache");
+	if (dir) {
+		os_mkdirs(dir);
+		dstr_printf(file, "%s/%s", dir, name);
+		bfree(dir);
+	}
+}
+
+static inline struct cache_header *get_cache_header(struct image_sequence *seq)
+{
+	return os_shmem_data(seq->cache);
+}
+
+static inline uint8_t *get_cached_frame(struct image_sequence *seq,
+					size_t index)
+{
+	uint8_t *data = os_shmem_data(seq->cache);
+	return data + CACHE_HEADER_SIZE + seq->frame_size * index;
+}
+
+static inline size_t get_cache_size(const struct image_sequence *seq)
+{
+	return CACHE_HEADER_SIZE + seq->frame_size * seq->files.num;
+}
+
+static inline size_t get_frame_size(enum gs_color_format format, uint32_t cx,
+				    uint32_t cy)
+{
+	return (size_t)cx * cy * gs_get_format_bpp(format) / 8;
+}
+
+/* maps a cache of the current files that was completed before */
+static bool open_cache(struct image_sequence *seq)
+{
+	struct cache_header header;
+	struct dstr file = {0};
+	bool success = false;
+	FILE *f;
+
+	get_cache_file(seq, &file);
+	if (!file.len)
+		return false;
+
+	f = os_fopen(file.array, "rb");
+	if (!f)
+		goto exit;
+
+	success = fread(&header, sizeof(header), 1, f) == 1 &&
+		  header.magic == CACHE_MAGIC &&
+		  header.version == CACHE_VERSION && header.key == seq->key &&
+		  header.count == seq->files.num && header.complete &&
+		  header.cx && header.cy;
+	fclose(f);
+
+	if (!success)
+		goto exit;
+
+	seq->cx = header.cx;
+	seq->cy = header.cy;
+	seq->format = (enum gs_color_format)header.format;
+	seq->frame_size = get_frame_size(seq->format, seq->cx, seq->cy);
+
+	seq->cache = seq->frame_size ? os_shmem_map_file(file.array,
+							 get_cache_size(seq))
+				     : NULL;
+	success = seq->cache != NULL;
+	if (!success) {
+		seq->frame_size = 0;
+	} else {
+		memset(seq->cached, 1, sizeof(bool) * seq->files.num);
+		seq->cached_count = seq->files.num;
+		debug("playing from cache '%s'", file.array);
+	}
+
+exit:
+	dstr_free(&file);
+	return success;
+}
+
+/* assumes mutex, called once the size of the first frame is known */
+static void create_cache(struct image_sequence *seq)
+{
+	struct cache_header *header;
+	struct dstr file = {0};
+
+	get_cache_file(seq, &file);
+	if (file.len)
+		seq->cache = os_shmem_map_file(file.array, get_cache_size(seq));
+	if (!seq->cache) {
+		warn("failed to create cache '%s', frames will not be cached",
+		     file.array ? file.array : "");
+		dstr_free(&file);
+		return;
+	}
+
+	header = get_cache_header(seq);
+	memset(header, 0, sizeof(*header));
+	header->magic = CACHE_MAGIC;
+	header->version = CACHE_VERSION;
+	header->key = seq->key;
+	header->count = (uint32_t)seq->files.num;
+	header->cx = seq->cx;
+	header->cy = seq->cy;
+	header->format = (uint32_t)seq->format;
+
+	debug("caching %zu frames in '%s'", seq->files.num, file.array);
+	dstr_free(&file);
+}
+
+static void decode_task(void *param);
+
+/* assumes mutex */
+static inline void queue_job(struct image_sequence *seq,
+			     const struct decode_job *job)
+{
+	if (job->to_cache)
+		da_push_back(seq->cache_jobs, job);
+	else
+		da_push_back(seq->ahead_jobs, job);
+
+	obs_task_group_queue(seq->group,
+			     job->to_cache ? OBS_TASK_PRIORITY_LOW
+					   : OBS_TASK_PRIORITY_NORMAL,
+			     decode_task, seq);
+}
+
+/* assumes mutex */
+static bool pop_job(struct image_sequence *seq, struct decode_job *job)
+{
+	if (seq->ahead_jobs.num) {
+		*job = seq->ahead_jobs.array[0];
+		da_erase(seq->ahead_jobs, 0);
+		return true;
+	}
+	if (seq->cache_jobs.num) {
+		*job = seq->cache_jobs.array[0];
+		da_erase(seq->cache_jobs, 0);
+		return true;
+	}
+	return false;
+}
+
+/* assumes mutex, returns false if the job is no longer wanted */
+static bool job_wanted(struct image_sequence *seq,
+		       const struct decode_job *job)
+{
+	if (job->to_cache)
+		return !seq->cached[job->index];
+	return seq->ahead[job->pos % AHEAD_FRAMES].pos == job->pos;
+}
+
+/* assumes mutex, frames that fail to decode are tried again the next time
+ * they are due, and keep the cache from being complete */
+static void finish_job(struct image_sequence *seq,
+		       const struct decode_job *job, uint8_t *data)
+{
+	if (data && seq->cache && !seq->cached[job->index]) {
+		memcpy(get_cached_frame(seq, job->index), data,
+		       seq->frame_size);
+		seq->cached[job->index] = true;
+
+		if (++seq->cached_count == seq->files.num) {
+			get_cache_header(seq)->complete = true;
+			debug("cached all %zu frames", seq->files.num);
+		}
+	}
+
+	if (job->to_cache) {
+		bfree(data);
+		return;
+	}
+
+	struct ahead_frame *frame = &seq->ahead[job->pos % AHEAD_FRAMES];
+
+	if (frame->pos == job->pos && !frame->ready) {
+		frame->data = data;
+		frame->ready = true;
+	} else {
+		bfree(data);
+	}
+}
+
+/* every queued job queues one task, which decodes the oldest job left */
+static void decode_task(void *param)
+{
+	struct image_sequence *seq = param;
+	enum gs_color_format format;
+	struct decode_job job;
+	uint32_t cx, cy;
+	uint8_t *data;
+	bool found = false;
+
+	pthread_mutex_lock(&seq->mutex);
+	while (!found && pop_job(seq, &job))
+		found = job_wanted(seq, &job);
+	pthread_mutex_unlock(&seq->mutex);
+
+	if (!found || obs_task_group_canceled(seq->group))
+		return;
+
+	data = gs_create_texture_file_data(seq->files.array[job.index],
+					   &format, &cx, &cy);
+
+	pthread_mutex_lock(&seq->mutex);
+
+	if (data && !seq->frame_size) {
+		seq->cx = cx;
+		seq->cy = cy;
+		seq->format = format;
+		seq->frame_size = get_frame_size(format, cx, cy);
+
+		if (seq->use_cache) {
+			create_cache(seq);
+
+			for (size_t i = 0; i < seq->files.num; i++) {
+				struct decode_job cache_job = {0, i, true};
+				if (i != job.index)
+					queue_job(seq, &cache_job);
+			}
+		}
+	}
+
+	if (data && (cx != seq->cx || cy != seq->cy || format != seq->format)) {
+		if (!seq->failed[job.index])
+			warn("'%s' does not match the size or format of the "
+			     "other images, skipping it",
+			     seq->files.array[job.index]);
+		bfree(data);
+		data = NULL;
+	} else if (!data && !seq->failed[job.index]) {
+		warn("failed to load '%s'", seq->files.array[job.index]);
+	}
+
+	if (!data)
+		seq->failed[job.index] = true;
+
+	finish_job(seq, &job, data);
+	pthread_mutex_unlock(&seq->mutex);
+}
+
+static inline size_t pos_to_index(const struct image_sequence *seq,
+				  uint64_t pos)
+{
+	return (size_t)(pos % seq->files.num);
+}
+
+/* assumes mutex, queues the frames that follow pos that aren't decoded */
+static void queue_ahead(struct image_sequence *seq, uint64_t pos)
+{
+	for (uint64_t i = pos; i < pos + AHEAD_FRAMES; i++) {
+		struct ahead_frame *frame = &seq->ahead[i % AHEAD_FRAMES];
+		struct decode_job job = {i, pos_to_index(seq, i), false};
+
+		if (!seq->loop && i >= seq->files.num)
+			break;
+		if (frame->pos == i || (seq->cache && seq->cached[job.index]))
+			continue;
+
+		bfree(frame->data);
+		frame->data = NULL;
+		frame->ready = false;
+		frame->pos = i;
+		queue_job(seq, &job);
+	}
+}
+
+static void stop_decoding(struct image_sequence *seq)
+{
+	if (seq->group) {
+		obs_task_group_cancel(seq->group);
+		obs_task_group_destroy(seq->group);
+		seq->group = NULL;
+	}
+
+	da_free(seq->ahead_jobs);
+	da_free(seq->cache_jobs);
+	for (size_t i = 0; i < AHEAD_FRAMES; i++) {
+		bfree(seq->ahead[i].data);
+		seq->ahead[i].data = NULL;
+		seq->ahead[i].ready = false;
+		seq->ahead[i].pos = UINT64_MAX;
+	}
+
+	os_shmem_destroy(seq->cache);
+	seq->cache = NULL;
+	bfree(seq->cached);
+	bfree(seq->failed);
+	seq->cached = NULL;
+	seq->failed = NULL;
+	seq->cached_count = 0;
+
+	for (size_t i = 0; i < seq->files.num; i++)
+		bfree(seq->files.array[i]);
+	da_free(seq->files);
+}
+
+static void destroy_textures(struct image_sequence *seq)
+{
+	obs_enter_graphics();
+	for (size_t i = 0; i < UPLOAD_TEXTURES; i++) {
+		gs_texture_destroy(seq->textures[i]);
+		seq->textures[i] = NULL;
+	}
+	obs_leave_graphics();
+
+	seq->uploaded = false;
+}
+
+static void image_sequence_update(void *data, obs_data_t *settings)
+{
+	struct image_sequence *seq = data;
+	const char *path = obs_data_get_string(settings, S_PATH);
+	int fps = (int)obs_data_get_int(settings, S_FPS);
+
+	stop_decoding(seq);
+	destroy_textures(seq);
+
+	bfree(seq->path);
+	seq->path = bstrdup(path);
+	seq->frame_ns = 1000000000ULL / (uint64_t)(fps > 0 ? fps : 30);
+	seq->loop = obs_data_get_bool(settings, S_LOOP);
+	seq->use_cache = obs_data_get_bool(settings, S_CACHE);
+
+	seq->cx = 0;
+	seq->cy = 0;
+	seq->frame_size = 0;
+	seq->time_ns = 0;
+	seq->shown_pos = 0;
+	seq->late_frames = 0;
+
+	if (!*path)
+		return;
+
+	load_files(seq);
+	if (!seq->files.num) {
+		warn("no images found in '%s'", path);
+		return;
+	}
+
+	seq->group = obs_task_group_create();
+	seq->cached = bzalloc(sizeof(bool) * seq->files.num);
+	seq->failed = bzalloc(sizeof(bool) * seq->files.num);
+
+	if (seq->use_cache) {
+		seq->key = get_files_key(seq);
+		open_cache(seq);
+	}
+
+	pthread_mutex_lock(&seq->mutex);
+	queue_ahead(seq, 0);
+	pthread_mutex_unlock(&seq->mutex);
+}
+
+static void image_sequence_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, S_FPS, 30);
+	obs_data_set_default_bool(settings, S_LOOP, true);
+	obs_data_set_default_bool(settings, S_CACHE, false);
+}
+
+static void *image_sequence_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct image_sequence *seq = bzalloc(sizeof(*seq));
+
+	seq->source = source;
+	pthread_mutex_init_value(&seq->mutex);
+	if (pthread_mutex_init(&seq->mutex, NULL) != 0) {
+		bfree(seq);
+		return NULL;
+	}
+
+	image_sequence_update(seq, settings);
+	return seq;
+}
+
+static void image_sequence_destroy(void *data)
+{
+	struct image_sequence *seq = data;
+
+	stop_decoding(seq);
+	destroy_textures(seq);
+	pthread_mutex_destroy(&seq->mutex);
+	bfree(seq->path);
+	bfree(seq);
+}
+
+static uint32_t image_sequence_width(void *data)
+{
+	struct image_sequence *seq = data;
+	return seq->uploaded ? seq->cx : 0;
+}
+
+static uint32_t image_sequence_height(void *data)
+{
+	struct image_sequence *seq = data;
+	return seq->uploaded ? seq->cy : 0;
+}
+
+/* graphics thread, the next texture of the ring is written so the one that
+ * was drawn last can still be in use by the GPU */
+static void upload_frame(struct image_sequence *seq, const uint8_t *data)
+{
+	size_t next = (seq->cur_texture + 1) % UPLOAD_TEXTURES;
+	uint32_t linesize = seq->cx * gs_get_format_bpp(seq->format) / 8;
+
+	if (!seq->textures[next])
+		seq->textures[next] = gs_texture_create(seq->cx, seq->cy,
+							seq->format, 1, NULL,
+							GS_DYNAMIC);
+	if (!seq->textures[next])
+		return;
+
+	gs_texture_set_image(seq->textures[next], data, linesize, false);
+	seq->cur_texture = next;
+	seq->uploaded = true;
+}
+
+/* assumes mutex */
+static bool show_frame(struct image_sequence *seq, uint64_t pos)
+{
+	size_t index = pos_to_index(seq, pos);
+	struct ahead_frame *frame = &seq->ahead[pos % AHEAD_FRAMES];
+
+	if (seq->cache && seq->cached[index]) {
+		upload_frame(seq, get_cached_frame(seq, index));
+		return true;
+	}
+
+	if (frame->pos == pos && frame->ready) {
+		if (frame->data)
+			upload_frame(seq, frame->data);
+		return true;
+	}
+
+	return false;
+}
+
+static void image_sequence_tick(void *data, float seconds)
+{
+	struct image_sequence *seq = data;
+	uint64_t pos;
+
+	if (!seq->files.num || !obs_source_showing(seq->source))
+		return;
+
+	if (seq->uploaded)
+		seq->time_ns += (uint64_t)((double)seconds * 1000000000.0);
+
+	pos = seq->time_ns / seq->frame_ns;
+	if (!seq->loop && pos >= seq->files.num)
+		pos = seq->files.num - 1;
+	if (seq->uploaded && pos == seq->shown_pos)
+		return;
+
+	pthread_mutex_lock(&seq->mutex);
+
+	obs_enter_graphics();
+	if (show_frame(seq, pos)) {
+		seq->shown_pos = pos;
+	} else if (seq->uploaded && ++seq->late_frames % 100 == 1) {
+		debug("%" PRIu64 " frames were not decoded in time",
+		      seq->late_frames);
+	}
+	obs_leave_graphics();
+
+	/* frames that were due are not decoded any more if they are late */
+	queue_ahead(seq, seq->uploaded ? pos + 1 : pos);
+
+	pthread_mutex_unlock(&seq->mutex);
+}
+
+static void image_sequence_render(void *data, gs_effect_t *effect)
+{
+	struct image_sequence *seq = data;
+	gs_texture_t *texture = seq->textures[seq->cur_texture];
+
+	if (!seq->uploaded || !texture)
+		return;
+
+	const bool linear_srgb = gs_get_linear_srgb();
+
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(linear_srgb);
+
+	gs_eparam_t *const param = gs_effect_get_param_by_name(effect, "image");
+	if (linear_srgb)
+		gs_effect_set_texture_srgb(param, texture);
+	else
+		gs_effect_set_texture(param, texture);
+
+	gs_draw_sprite(texture, 0, 0, 0);
+
+	gs_enable_framebuffer_srgb(previous);
+}
+
+static gs_texture_t *image_sequence_get_texture(void *data)
+{
+	struct image_sequence *seq = data;
+	return seq->uploaded ? seq->textures[seq->cur_texture] : NULL;
+}
+
+static void image_sequence_activate(void *data)
+{
+	struct image_sequence *seq = data;
+
+	/* plays from the start every time it is shown in the output */
+	seq->time_ns = 0;
+}
+
+static obs_properties_t *image_sequence_properties(void *data)
+{
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
+
+	obs_properties_add_path(props, S_PATH, T_PATH, OBS_PATH_DIRECTORY,
+				NULL, NULL);
+	obs_properties_add_int(props, S_FPS, T_FPS, 1, 240, 1);
+	obs_properties_add_bool(props, S_LOOP, T_LOOP);
+	p = obs_properties_add_bool(props, S_CACHE, T_CACHE);
+	obs_property_set_long_description(p, T_CACHE_DESC);
+
+	UNUSED_PARAMETER(data);
+	return props;
+}
+
+struct obs_source_info image_sequence_info = {
+	.id = "image_sequence_source",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO,
+	.get_name = image_sequence_get_name,
+	.create = image_sequence_create,
+	.destroy = image_sequence_destroy,
+	.update = image_sequence_update,
+	.get_defaults = image_sequence_defaults,
+	.activate = image_sequence_activate,
+	.get_width = image_sequence_width,
+	.get_height = image_sequence_height,
+	.video_render = image_sequence_render,
+	.video_tick = image_sequence_tick,
+	.video_get_texture = image_sequence_get_texture,
+	.get_properties = image_sequence_properties,
+	.icon_type = OBS_ICON_TYPE_IMAGE,
+};
@@ -22,9 +22,25 @@ struct image_source {
 	uint64_t last_time;
 	bool active;
 
+	/* still images come from the shared cache, animated ones are
+	 * decoded here */
+	obs_image_t *image;
+	bool image_ready;
+
 	gs_image_file2_t if2;
+
+	/* unloaded by libobs when over the GPU memory budget, and loaded
+	 * again once the source is shown */
+	obs_gpu_resource_t *gpu_resource;
+	bool evicted;
 };
 
+static inline bool use_image_cache(const char *file)
+{
+	const char *ext = strrchr(file, '.');
+	return !ext || astrcmpi(ext, ".gif") != 0;
+}
+
 static time_t get_modified_timestamp(const char *filename)
 {
 	struct stat stats;
@@ -39,15 +55,34 @@ static const char *image_source_get_name(void *unused)
 	return obs_module_text("ImageInput");
 }
 
+static uint64_t get_texture_size(const gs_image_file_t *image)
+{
+	return (uint64_t)image->cx * image->cy *
+	       gs_get_format_bpp(image->format) / 8;
+}
+
 static void image_source_load(struct image_source *context)
 {
 	char *file = context->file;
 
+	context->evicted = false;
+
 	obs_enter_graphics();
 	gs_image_file2_free(&context->if2);
 	obs_leave_graphics();
 
-	if (file && *file) {
+	obs_image_release(context->image);
+	context->image = NULL;
+	context->image_ready = false;
+
+	if (file && *file && use_image_cache(file)) {
+		/* decoded in the background, see image_source_tick */
+		debug("loading image '%s'", file);
+		context->file_timestamp = get_modified_timestamp(file);
+		context->image = obs_image_cache_get(file);
+		context->update_time_elapsed = 0;
+
+	} else if (file && *file) {
 		debug("loading texture '%s'", file);
 		context->file_timestamp = get_modified_timestamp(file);
 		gs_image_file2_init(&context->if2, file);
@@ -60,6 +95,10 @@ static void image_source_load(struct image_source *context)
 		if (!context->if2.image.loaded)
 			warn("failed to load texture '%s'", file);
 	}
+
+	obs_gpu_resource_set_size(context->gpu_resource,
+				  get_texture_size(&context->if2.image));
+	obs_source_content_changed(context->source);
 }
 
 static void image_source_unload(struct image_source *context)
@@ -67,6 +106,22 @@ static void image_source_unload(struct image_source *context)
 	obs_enter_graphics();
 	gs_image_file2_free(&context->if2);
 	obs_leave_graphics();
+
+	obs_image_release(context->image);
+	context->image = NULL;
+	context->image_ready = false;
+
+	obs_gpu_resource_set_size(context->gpu_resource, 0);
+	obs_source_content_changed(context->source);
+}
+
+static void image_source_evict(void *data)
+{
+	struct image_source *context = data;
+
+	debug("unloading '%s' to free GPU memory", context->file);
+	image_source_unload(context);
+	context->evicted = true;
 }
 
 static void image_source_update(void *data, obs_data_t *settings)
@@ -112,6 +167,8 @@ static void *image_source_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct image_source *context = bzalloc(sizeof(struct image_source));
 	context->source = source;
+	context->gpu_resource = obs_gpu_resource_create(
+		source, OBS_GPU_PRIORITY_NORMAL, image_source_evict, context);
 
 	image_source_update(context, settings);
 	return context;
@@ -121,6 +178,7 @@ static void image_source_destroy(void *data)
 {
 	struct image_source *context = data;
 
+	obs_gpu_resource_destroy(context->gpu_resource);
 	image_source_unload(context);
 
 	if (context->file)
@@ -131,22 +189,31 @@ static void image_source_destroy(void *data)
 static uint32_t image_source_getwidth(void *data)
 {
 	struct image_source *context = data;
+	if (context->image)
+		return obs_image_get_width(context->image);
 	return context->if2.image.cx;
 }
 
 static uint32_t image_source_getheight(void *data)
 {
 	struct image_source *context = data;
+	if (context->image)
+		return obs_image_get_height(context->image);
 	return context->if2.image.cy;
 }
 
 static void image_source_render(void *data, gs_effect_t *effect)
 {
 	struct image_source *context = data;
+	gs_texture_t *texture = context->if2.image.texture;
 
-	if (!context->if2.image.texture)
+	if (context->image)
+		texture = obs_image_get_texture(context->image);
+	if (!texture)
 		return;
 
+	obs_gpu_resource_touch(context->gpu_resource);
+
 	const bool linear_srgb = gs_get_linear_srgb();
 
 	const bool previous = gs_framebuffer_srgb_enabled();
@@ -154,12 +221,11 @@ static void image_source_render(void *data, gs_effect_t *effect)
 
 	gs_eparam_t *const param = gs_effect_get_param_by_name(effect, "image");
 	if (linear_srgb)
-		gs_effect_set_texture_srgb(param, context->if2.image.texture);
+		gs_effect_set_texture_srgb(param, texture);
 	else
-		gs_effect_set_texture(param, context->if2.image.texture);
+		gs_effect_set_texture(param, texture);
 
-	gs_draw_sprite(context->if2.image.texture, 0, context->if2.image.cx,
-		       context->if2.image.cy);
+	gs_draw_sprite(texture, 0, 0, 0);
 
 	gs_enable_framebuffer_srgb(previous);
 }
@@ -171,6 +237,21 @@ static void image_source_tick(void *data, float seconds)
 
 	context->update_time_elapsed += seconds;
 
+	if (context->image && !context->image_ready &&
+	    obs_image_loaded(context->image)) {
+		context->image_ready = true;
+
+		if (obs_image_failed(context->image))
+			warn("failed to load texture '%s'", context->file);
+		obs_gpu_resource_set_size(
+			context->gpu_resource,
+			obs_image_get_memory_usage(context->image));
+		obs_source_content_changed(context->source);
+	}
+
+	if (context->evicted && obs_source_showing(context->source))
+		image_source_load(context);
+
 	if (obs_source_showing(context->source)) {
 		if (context->update_time_elapsed >= 1.0f) {
 			time_t t = get_modified_timestamp(context->file);
@@ -199,6 +280,7 @@ static void image_source_tick(void *data, float seconds)
 				obs_enter_graphics();
 				gs_image_file2_update_texture(&context->if2);
 				obs_leave_graphics();
+				obs_source_content_changed(context->source);
 			}
 
 			context->active = false;
@@ -215,6 +297,7 @@ static void image_source_tick(void *data, float seconds)
 			obs_enter_graphics();
 			gs_image_file2_update_texture(&context->if2);
 			obs_leave_graphics();
+			obs_source_content_changed(context->source);
 		}
 	}
 
@@ -261,6 +344,8 @@ static obs_properties_t *image_source_properties(void *data)
 uint64_t image_source_get_memory_usage(void *data)
 {
 	struct image_source *s = data;
+	if (s->image)
+		return obs_image_get_memory_usage(s->image);
 	return s->if2.mem_usage;
 }
 
@@ -298,7 +383,7 @@ static obs_missing_files_t *image_source_missingfiles(void *data)
 static struct obs_source_info image_source_info = {
 	.id = "image_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
-	.output_flags = OBS_SOURCE_VIDEO,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CACHEABLE_VIDEO,
 	.get_name = image_source_get_name,
 	.create = image_source_create,
 	.destroy = image_source_destroy,
@@ -317,12 +402,14 @@ static struct obs_source_info image_source_info = {
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("image-source", "en-US")
+OBS_MODULE_LOAD_FLAGS(OBS_MODULE_LOAD_THREAD_SAFE)
 MODULE_EXPORT const char *obs_module_description(void)
 {
 	return "Image/color/slideshow sources";
 }
 
 extern struct obs_source_info slideshow_info;
+extern struct obs_source_info image_sequence_info;
 extern struct obs_source_info color_source_info_v1;
 extern struct obs_source_info color_source_info_v2;
 extern struct obs_source_info color_source_info_v3;
@@ -334,5 +421,6 @@ bool obs_module_load(void)
 	obs_register_source(&color_source_info_v2);
 	obs_register_source(&color_source_info_v3);
 	obs_register_source(&slideshow_info);
+	obs_register_source(&image_sequence_info);
 	return true;
 }
@@ -65,6 +65,8 @@ extern uint64_t image_source_get_memory_usage(void *data);
 
 #define BYTES_TO_MBYTES (1024 * 1024)
 #define MAX_MEM_USAGE (400 * BYTES_TO_MBYTES)
+#define PREFETCH_SLIDES 2
+#define SIZE_POLL_INTERVAL 0.25f
 
 struct image_file_data {
 	char *path;
@@ -102,6 +104,14 @@ struct slideshow {
 	uint32_t cy;
 	uint64_t mem_usage;
 
+	/* the size is filled in as the image cache decodes the files */
+	bool size_pending;
+	float size_poll_elapsed;
+	bool use_auto;
+	bool aspect_only;
+	int cx_in;
+	int cy_in;
+
 	pthread_mutex_t mutex;
 	DARRAY(struct image_file_data) files;
 
@@ -160,13 +170,21 @@ static obs_source_t *get_source(struct darray *array, const char *path)
 	return source;
 }
 
+static inline bool is_gif(const char *file)
+{
+	const char *ext = os_get_path_extension(file);
+	return ext && astrcmpi(ext, ".gif") == 0;
+}
+
 static obs_source_t *create_source_from_file(const char *file)
 {
 	obs_data_t *settings = obs_data_create();
 	obs_source_t *source;
 
+	/* still images are kept by the shared image cache between showings,
+	 * so only animated ones need to stay loaded */
 	obs_data_set_string(settings, "file", file);
-	obs_data_set_bool(settings, "unload", false);
+	obs_data_set_bool(settings, "unload", !is_gif(file));
 	source = obs_source_create_private("image_source", NULL, settings);
 
 	obs_data_release(settings);
@@ -200,7 +218,7 @@ static const char *ss_getname(void *unused)
 }
 
 static void add_file(struct slideshow *ss, struct darray *array,
-		     const char *path, uint32_t *cx, uint32_t *cy)
+		     const char *path)
 {
 	DARRAY(struct image_file_data) new_files;
 	struct image_file_data data;
@@ -218,17 +236,13 @@ static void add_file(struct slideshow *ss, struct darray *array,
 		new_source = create_source_from_file(path);
 
 	if (new_source) {
-		uint32_t new_cx = obs_source_get_width(new_source);
-		uint32_t new_cy = obs_source_get_height(new_source);
-
 		data.path = bstrdup(path);
 		data.source = new_source;
 		da_push_back(new_files, &data);
 
-		if (new_cx > *cx)
-			*cx = new_cx;
-		if (new_cy > *cy)
-			*cy = new_cy;
+		/* decoded in the background so that its size becomes known */
+		if (!is_gif(path))
+			obs_image_cache_prefetch(path);
 
 		void *source_data = obs_obj_get_data(new_source);
 		ss->mem_usage += image_source_get_memory_usage(source_data);
@@ -251,11 +265,90 @@ static inline bool item_valid(struct slideshow *ss)
 	return ss->files.num && ss->cur_item < ss->files.num;
 }
 
+/* true if the size of any file is not known yet */
+static bool get_files_size(struct slideshow *ss, uint32_t *cx, uint32_t *cy)
+{
+	bool pending = false;
+
+	pthread_mutex_lock(&ss->mutex);
+	for (size_t i = 0; i < ss->files.num; i++) {
+		struct image_file_data *file = ss->files.array + i;
+		uint32_t new_cx = obs_source_get_width(file->source);
+		uint32_t new_cy = obs_source_get_height(file->source);
+
+		if (!new_cx && !is_gif(file->path) &&
+		    !obs_image_cache_get_size(file->path, &new_cx, &new_cy))
+			pending = true;
+
+		if (new_cx > *cx)
+			*cx = new_cx;
+		if (new_cy > *cy)
+			*cy = new_cy;
+	}
+	pthread_mutex_unlock(&ss->mutex);
+
+	return pending;
+}
+
+static void update_size(struct slideshow *ss)
+{
+	uint32_t cx = 0;
+	uint32_t cy = 0;
+
+	ss->size_pending = get_files_size(ss, &cx, &cy);
+
+	if (!ss->use_auto) {
+		double cx_f = (double)cx;
+		double cy_f = (double)cy;
+
+		double old_aspect = cx_f / cy_f;
+		double new_aspect = (double)ss->cx_in / (double)ss->cy_in;
+
+		if (ss->aspect_only) {
+			if (fabs(old_aspect - new_aspect) > EPSILON) {
+				if (new_aspect > old_aspect)
+					cx = (uint32_t)(cy_f * new_aspect);
+				else
+					cy = (uint32_t)(cx_f / new_aspect);
+			}
+		} else {
+			cx = (uint32_t)ss->cx_in;
+			cy = (uint32_t)ss->cy_in;
+		}
+	}
+
+	if (cx != ss->cx || cy != ss->cy) {
+		ss->cx = cx;
+		ss->cy = cy;
+		obs_transition_set_size(ss->transition, cx, cy);
+	}
+}
+
+/* lets the image cache decode the upcoming slides while this one shows */
+static void prefetch_next(struct slideshow *ss)
+{
+	if (ss->randomize || !ss->files.num)
+		return;
+
+	for (size_t i = 1; i <= PREFETCH_SLIDES && i < ss->files.num; i++) {
+		size_t next = (ss->cur_item + i) % ss->files.num;
+		const char *path = ss->files.array[next].path;
+
+		if (!ss->loop && next < ss->cur_item)
+			break;
+		if (!is_gif(path))
+			obs_image_cache_prefetch(path);
+	}
+}
+
 static void do_transition(void *data, bool to_null)
 {
 	struct slideshow *ss = data;
 	bool valid = item_valid(ss);
 
+	if (valid && !to_null)
+		prefetch_next(ss);
+
 	if (valid && ss->use_cut) {
 		obs_transition_set(ss->transition,
 				   ss->files.array[ss->cur_item].source);
@@ -284,8 +377,6 @@ static void ss_update(void *data, obs_data_t *settings)
 	const char *tr_name;
 	uint32_t new_duration;
 	uint32_t new_speed;
-	uint32_t cx = 0;
-	uint32_t cy = 0;
 	size_t count;
 	const char *behavior;
 	const char *mode;
@@ -361,8 +452,7 @@ static void ss_update(void *data, obs_data_t *settings)
 				dstr_copy(&dir_path, path);
 				dstr_cat_ch(&dir_path, '/');
 				dstr_cat(&dir_path, ent->d_name);
-				add_file(ss, &new_files.da, dir_path.array, &cx,
-					 &cy);
+				add_file(ss, &new_files.da, dir_path.array);
 
 				if (ss->mem_usage >= MAX_MEM_USAGE)
 					break;
@@ -371,7 +461,7 @@ static void ss_update(void *data, obs_data_t *settings)
 			dstr_free(&dir_path);
 			os_closedir(dir);
 		} else {
-			add_file(ss, &new_files.da, path, &cx, &cy);
+			add_file(ss, &new_files.da, path);
 		}
 
 		obs_data_release(item);
@@ -435,33 +525,20 @@ static void ss_update(void *data, obs_data_t *settings)
 		}
 	}
 
-	if (!use_auto) {
-		double cx_f = (double)cx;
-		double cy_f = (double)cy;
-
-		double old_aspect = cx_f / cy_f;
-		double new_aspect = (double)cx_in / (double)cy_in;
-
-		if (aspect_only) {
-			if (fabs(old_aspect - new_aspect) > EPSILON) {
-				if (new_aspect > old_aspect)
-					cx = (uint32_t)(cy_f * new_aspect);
-				else
-					cy = (uint32_t)(cx_f / new_aspect);
-			}
-		} else {
-			cx = (uint32_t)cx_in;
-			cy = (uint32_t)cy_in;
-		}
-	}
+	ss->use_auto = use_auto;
+	ss->aspect_only = aspect_only;
+	ss->cx_in = cx_in;
+	ss->cy_in = cy_in;
 
 	/* ------------------------- */
 
-	ss->cx = cx;
-	ss->cy = cy;
+	ss->cx = 0;
+	ss->cy = 0;
 	ss->cur_item = 0;
 	ss->elapsed = 0.0f;
-	obs_transition_set_size(ss->transition, cx, cy);
+	ss->size_poll_elapsed = 0.0f;
+	update_size(ss);
+	obs_transition_set_size(ss->transition, ss->cx, ss->cy);
 	obs_transition_set_alignment(ss->transition, OBS_ALIGN_CENTER);
 	obs_transition_set_scale_type(ss->transition,
 				      OBS_TRANSITION_SCALE_ASPECT);
@@ -699,6 +776,14 @@ static void ss_video_tick(void *data, float seconds)
 	if (!ss->transition || !ss->slide_time)
 		return;
 
+	if (ss->size_pending) {
+		ss->size_poll_elapsed += seconds;
+		if (ss->size_poll_elapsed >= SIZE_POLL_INTERVAL) {
+			ss->size_poll_elapsed = 0.0f;
+			update_size(ss);
+		}
+	}
+
 	if (ss->restart_on_activate && ss->use_cut) {
 		ss->elapsed = 0.0f;
 		ss->cur_item = ss->randomize ? random_file(ss) : 0;
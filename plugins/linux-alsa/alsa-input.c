@@ -27,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <alsa/pcm.h>
 
 #include <pthread.h>
+#include <poll.h>
 
 #define blog(level, msg, ...) blog(level, "alsa-input: " msg, ##__VA_ARGS__)
 
@@ -34,6 +35,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define NSEC_PER_MSEC 1000000L
 #define STARTUP_TIMEOUT_NS (500 * NSEC_PER_MSEC)
 #define REOPEN_TIMEOUT 1000UL
+#define POLL_TIMEOUT_MS 100
 #define SHUTDOWN_ON_DEACTIVATE false
 
 struct alsa_data {
@@ -56,6 +58,7 @@ struct alsa_data {
 	snd_pcm_t *handle;
 	snd_pcm_format_t format;
 	snd_pcm_uframes_t period_size;
+	bool mmap;
 
 	unsigned int channels;
 	unsigned int rate;
@@ -432,8 +435,14 @@ bool _alsa_configure(struct alsa_data *data)
 		return false;
 	}
 
+	/* capture straight out of the ring buffer when the device allows
+	 * it, instead of having snd_pcm_readi copy each period out first */
 	err = snd_pcm_hw_params_set_access(data->handle, hwparams,
-					   SND_PCM_ACCESS_RW_INTERLEAVED);
+					   SND_PCM_ACCESS_MMAP_INTERLEAVED);
+	data->mmap = err == 0;
+	if (!data->mmap)
+		err = snd_pcm_hw_params_set_access(
+			data->handle, hwparams, SND_PCM_ACCESS_RW_INTERLEAVED);
 	if (err < 0) {
 		blog(LOG_ERROR, "snd_pcm_hw_params_set_access failed: %s",
 		     snd_strerror(err));
@@ -490,6 +499,8 @@ bool _alsa_configure(struct alsa_data *data)
 	}
 	blog(LOG_INFO, "PCM '%s' channels set to %d", data->device,
 	     data->channels);
+	blog(LOG_INFO, "PCM '%s' using %s access", data->device,
+	     data->mmap ? "mmap" : "read");
 
 	err = snd_pcm_hw_params(data->handle, hwparams);
 	if (err < 0) {
@@ -511,8 +522,9 @@ bool _alsa_configure(struct alsa_data *data)
 		8;
 
 	if (data->buffer)
-		bfree(data->buffer);
-	data->buffer = bzalloc(data->period_size * data->sample_size);
+		bfree(data->buffer), data->buffer = NULL;
+	if (!data->mmap)
+		data->buffer = bzalloc(data->period_size * data->sample_size);
 
 	return true;
 }
@@ -551,10 +563,127 @@ void _alsa_stop_reopen(struct alsa_data *data)
 	os_event_reset(data->abort_event);
 }
 
+static void _alsa_output(struct alsa_data *data, struct obs_source_audio *out)
+{
+	if (!data->first_ts)
+		data->first_ts = out->timestamp + STARTUP_TIMEOUT_NS;
+
+	if (out->timestamp > data->first_ts)
+		obs_source_output_audio(data->source, out);
+}
+
+static bool _alsa_recover(struct alsa_data *data, int err)
+{
+	err = snd_pcm_recover(data->handle, err, 0);
+	if (err < 0)
+		return false;
+
+	/* a recovered capture stream is left prepared, and unlike
+	 * snd_pcm_readi nothing in the mmap path starts it again */
+	if (snd_pcm_state(data->handle) == SND_PCM_STATE_PREPARED)
+		err = snd_pcm_start(data->handle);
+	return err >= 0;
+}
+
+/* Waits until a period is available, returns false on timeout or error */
+static bool _alsa_poll(struct alsa_data *data, struct pollfd *fds, int count)
+{
+	unsigned short revents;
+	int err;
+
+	if (poll(fds, count, POLL_TIMEOUT_MS) <= 0)
+		return false;
+
+	err = snd_pcm_poll_descriptors_revents(data->handle, fds, count,
+					       &revents);
+	if (err < 0)
+		return false;
+	if (revents & POLLERR) {
+		_alsa_recover(data, -EPIPE);
+		return false;
+	}
+	return (revents & POLLIN) != 0;
+}
+
+static void _alsa_read_mmap(struct alsa_data *data,
+			    struct obs_source_audio *out)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, frames;
+	snd_pcm_sframes_t avail, committed;
+	uint64_t now;
+	int err;
+
+	avail = snd_pcm_avail_update(data->handle);
+	if (avail < 0) {
+		_alsa_recover(data, (int)avail);
+		return;
+	}
+
+	now = os_gettime_ns();
+
+	/* the available frames can wrap around the end of the ring, in
+	 * which case they are handed over in two contiguous parts */
+	while (avail > 0) {
+		frames = (snd_pcm_uframes_t)avail;
+		err = snd_pcm_mmap_begin(data->handle, &areas, &offset,
+					 &frames);
+		if (err < 0) {
+			_alsa_recover(data, err);
+			return;
+		}
+
+		out->data[0] = (uint8_t *)areas[0].addr +
+			       (areas[0].first + offset * areas[0].step) / 8;
+		out->frames = (uint32_t)frames;
+		out->timestamp =
+			now - util_mul_div64(avail, NSEC_PER_SEC, data->rate);
+		_alsa_output(data, out);
+
+		committed = snd_pcm_mmap_commit(data->handle, offset, frames);
+		if (committed < 0 || (snd_pcm_uframes_t)committed != frames) {
+			_alsa_recover(data, committed < 0 ? (int)committed
+							  : -EPIPE);
+			return;
+		}
+
+		avail -= frames;
+	}
+}
+
+static void _alsa_listen_mmap(struct alsa_data *data,
+			      struct obs_source_audio *out)
+{
+	struct pollfd *fds;
+	int count;
+
+	count = snd_pcm_poll_descriptors_count(data->handle);
+	if (count <= 0) {
+		blog(LOG_ERROR, "No poll descriptors for '%s'", data->device);
+		return;
+	}
+
+	fds = bmalloc(sizeof(struct pollfd) * count);
+
+	while (os_atomic_load_bool(&data->listen)) {
+		/* the descriptors can change after recovering from xruns */
+		snd_pcm_poll_descriptors(data->handle, fds, count);
+
+		if (!_alsa_poll(data, fds, count))
+			continue;
+		if (!os_atomic_load_bool(&data->listen))
+			break;
+
+		_alsa_read_mmap(data, out);
+	}
+
+	bfree(fds);
+}
+
 void *_alsa_listen(void *attr)
 {
 	struct alsa_data *data = attr;
-	struct obs_source_audio out;
+	struct obs_source_audio out = {0};
 
 	blog(LOG_DEBUG, "Capture thread started.");
 
@@ -565,6 +694,11 @@ void *_alsa_listen(void *attr)
 
 	os_atomic_set_bool(&data->listen, true);
 
+	if (data->mmap) {
+		_alsa_listen_mmap(data, &out);
+		goto done;
+	}
+
 	do {
 		snd_pcm_sframes_t frames = snd_pcm_readi(
 			data->handle, data->buffer, data->period_size);
@@ -585,13 +719,10 @@ void *_alsa_listen(void *attr)
 			os_gettime_ns() -
 			util_mul_div64(frames, NSEC_PER_SEC, data->rate);
 
-		if (!data->first_ts)
-			data->first_ts = out.timestamp + STARTUP_TIMEOUT_NS;
-
-		if (out.timestamp > data->first_ts)
-			obs_source_output_audio(data->source, &out);
+		_alsa_output(data, &out);
 	} while (os_atomic_load_bool(&data->listen));
 
+done:
 	blog(LOG_DEBUG, "Capture thread is about to exit.");
 
 	pthread_exit(NULL);
@@ -21,7 +21,8 @@ OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("linux-xshm", "en-US")
 MODULE_EXPORT const char *obs_module_description(void)
 {
-	return "xcomposite/xshm based window/screen capture for X11";
+	return "xcomposite/xshm based window/screen capture for X11, and "
+	       "PipeWire based window/screen capture through desktop portals";
 }
 
 extern struct obs_source_info xshm_input;
@@ -29,19 +30,44 @@ extern struct obs_source_info xshm_input;
 extern void xcomposite_load(void);
 extern void xcomposite_unload(void);
 
+#ifdef ENABLE_PIPEWIRE
+extern bool pipewire_capture_load(void);
+extern void pipewire_capture_unload(void);
+#endif
+
+static bool xcomposite_loaded = false;
+
 bool obs_module_load(void)
 {
-	if (obs_get_nix_platform() != OBS_NIX_PLATFORM_X11_GLX) {
-		blog(LOG_ERROR, "linux-capture cannot run on EGL platforms");
-		return false;
+	bool loaded = false;
+
+	if (obs_get_nix_platform() == OBS_NIX_PLATFORM_X11_GLX) {
+		obs_register_source(&xshm_input);
+		xcomposite_load();
+		xcomposite_loaded = true;
+		loaded = true;
+	} else {
+		blog(LOG_INFO, "X11 capture sources cannot run on EGL "
+			       "platforms");
 	}
 
-	obs_register_source(&xshm_input);
-	xcomposite_load();
-	return true;
+#ifdef ENABLE_PIPEWIRE
+	if (pipewire_capture_load())
+		loaded = true;
+#endif
+
+	if (!loaded)
+		blog(LOG_ERROR, "linux-capture has no capture sources for "
+				"this platform");
+	return loaded;
 }
 
 void obs_module_unload(void)
 {
-	xcomposite_unload();
+	if (xcomposite_loaded)
+		xcomposite_unload();
+
+#ifdef ENABLE_PIPEWIRE
+	pipewire_capture_unload();
+#endif
 }
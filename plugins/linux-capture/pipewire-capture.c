@@ -0,0 +1,160 @@
+#include <obs-module.h>
+#include <pipewire/pipewire.h>
+
+#include "pipewire.h"
+#include "portal.h"
+
+static bool pipewire_initialized = false;
+
+static void *pipewire_desktop_capture_create(obs_data_t *settings,
+					     obs_source_t *source)
+{
+	return obs_pipewire_create(PORTAL_CAPTURE_TYPE_MONITOR, settings,
+				   source);
+}
+
+static void *pipewire_window_capture_create(obs_data_t *settings,
+					    obs_source_t *source)
+{
+	return obs_pipewire_create(PORTAL_CAPTURE_TYPE_WINDOW, settings,
+				   source);
+}
+
+static void pipewire_capture_destroy(void *data)
+{
+	obs_pipewire_destroy(data);
+}
+
+static const char *pipewire_desktop_capture_get_name(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return obs_module_text("PipeWireDesktopCapture");
+}
+
+static const char *pipewire_window_capture_get_name(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return obs_module_text("PipeWireWindowCapture");
+}
+
+static void pipewire_capture_get_defaults(obs_data_t *settings)
+{
+	obs_pipewire_get_defaults(settings);
+}
+
+static obs_properties_t *pipewire_desktop_capture_get_properties(void *data)
+{
+	return obs_pipewire_get_properties(data, "PipeWireSelectMonitor");
+}
+
+static obs_properties_t *pipewire_window_capture_get_properties(void *data)
+{
+	return obs_pipewire_get_properties(data, "PipeWireSelectWindow");
+}
+
+static void pipewire_capture_update(void *data, obs_data_t *settings)
+{
+	obs_pipewire_update(data, settings);
+}
+
+static void pipewire_capture_show(void *data)
+{
+	obs_pipewire_show(data);
+}
+
+static void pipewire_capture_hide(void *data)
+{
+	obs_pipewire_hide(data);
+}
+
+static uint32_t pipewire_capture_get_width(void *data)
+{
+	return obs_pipewire_get_width(data);
+}
+
+static uint32_t pipewire_capture_get_height(void *data)
+{
+	return obs_pipewire_get_height(data);
+}
+
+static void pipewire_capture_video_render(void *data, gs_effect_t *effect)
+{
+	obs_pipewire_video_render(data, effect);
+}
+
+static struct obs_source_info pipewire_desktop_capture_info = {
+	.id = "pipewire-desktop-capture-source",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_DO_NOT_DUPLICATE,
+	.get_name = pipewire_desktop_capture_get_name,
+	.create = pipewire_desktop_capture_create,
+	.destroy = pipewire_capture_destroy,
+	.get_defaults = pipewire_capture_get_defaults,
+	.get_properties = pipewire_desktop_capture_get_properties,
+	.update = pipewire_capture_update,
+	.show = pipewire_capture_show,
+	.hide = pipewire_capture_hide,
+	.get_width = pipewire_capture_get_width,
+	.get_height = pipewire_capture_get_height,
+	.video_render = pipewire_capture_video_render,
+	.icon_type = OBS_ICON_TYPE_DESKTOP_CAPTURE,
+};
+
+static struct obs_source_info pipewire_window_capture_info = {
+	.id = "pipewire-window-capture-source",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_DO_NOT_DUPLICATE,
+	.get_name = pipewire_window_capture_get_name,
+	.create = pipewire_window_capture_create,
+	.destroy = pipewire_capture_destroy,
+	.get_defaults = pipewire_capture_get_defaults,
+	.get_properties = pipewire_window_capture_get_properties,
+	.update = pipewire_capture_update,
+	.show = pipewire_capture_show,
+	.hide = pipewire_capture_hide,
+	.get_width = pipewire_capture_get_width,
+	.get_height = pipewire_capture_get_height,
+	.video_render = pipewire_capture_video_render,
+	.icon_type = OBS_ICON_TYPE_WINDOW_CAPTURE,
+};
+
+/* returns false if the portal offers nothing to capture */
+bool pipewire_capture_load(void)
+{
+	uint32_t available_capture_types = portal_get_available_capture_types();
+	bool desktop_capture_available =
+		(available_capture_types & PORTAL_CAPTURE_TYPE_MONITOR) != 0;
+	bool window_capture_available =
+		(available_capture_types & PORTAL_CAPTURE_TYPE_WINDOW) != 0;
+
+	if (!available_capture_types) {
+		blog(LOG_INFO, "[pipewire] No capture sources available");
+		return false;
+	}
+
+	blog(LOG_INFO, "[pipewire] Available capture sources:");
+	if (desktop_capture_available)
+		blog(LOG_INFO, "[pipewire]     - Desktop capture");
+	if (window_capture_available)
+		blog(LOG_INFO, "[pipewire]     - Window capture");
+
+	pw_init(NULL, NULL);
+	pipewire_initialized = true;
+
+	if (desktop_capture_available)
+		obs_register_source(&pipewire_desktop_capture_info);
+	if (window_capture_available)
+		obs_register_source(&pipewire_window_capture_info);
+
+	return true;
+}
+
+void pipewire_capture_unload(void)
+{
+	if (pipewire_initialized) {
+		pw_deinit();
+		pipewire_initialized = false;
+	}
+
+	portal_unload();
+}
@@ -0,0 +1,1250 @@
+#include "pipewire.h"
+
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <obs-nix-platform.h>
+
+#include <gio/gunixfdlist.h>
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <pipewire/pipewire.h>
+#include <spa/buffer/meta.h>
+#include <spa/debug/types.h>
+#include <spa/param/video/format-utils.h>
+#include <spa/param/video/type-info.h>
+
+/* copied from drm_fourcc.h, the modifier of buffers whose layout the
+ * driver chooses implicitly */
+#define DRM_FORMAT_MOD_INVALID ((1ULL << 56) - 1)
+
+#define CURSOR_META_SIZE(width, height)                                    \
+	(sizeof(struct spa_meta_cursor) + sizeof(struct spa_meta_bitmap) + \
+	 (width) * (height) * 4)
+
+/* the format pods of a stream; modifier lists of a few dozen entries fit
+ * comfortably */
+#define PARAMS_BUFFER_SIZE 8192
+
+struct format_info {
+	uint32_t spa_format;
+	enum gs_color_format gs_format;
+	DARRAY(uint64_t) modifiers;
+};
+
+static const struct {
+	uint32_t spa_format;
+	enum gs_color_format gs_format;
+} supported_formats[] = {
+	{SPA_VIDEO_FORMAT_BGRA, GS_BGRA},
+	{SPA_VIDEO_FORMAT_RGBA, GS_RGBA},
+	{SPA_VIDEO_FORMAT_BGRx, GS_BGRX},
+};
+
+#define N_SUPPORTED_FORMATS \
+	(sizeof(supported_formats) / sizeof(supported_formats[0]))
+
+struct dbus_call_data {
+	struct obs_pipewire_data *obs_pw;
+	char *request_path;
+	guint signal_id;
+	gulong cancelled_id;
+};
+
+struct obs_pipewire_data {
+	obs_source_t *source;
+	enum portal_capture_type capture_type;
+
+	GCancellable *cancellable;
+	struct dbus_call_data *pending_call;
+	char *session_handle;
+	uint32_t available_cursor_modes;
+
+	uint32_t pipewire_node;
+	int pipewire_fd;
+
+	struct pw_thread_loop *thread_loop;
+	struct pw_context *context;
+	struct pw_core *core;
+	struct spa_hook core_listener;
+	struct pw_stream *stream;
+	struct spa_hook stream_listener;
+	struct spa_source *reneg;
+
+	struct spa_video_info format;
+	struct obs_video_info video_info;
+	bool negotiated;
+
+	/* formats offered to the portal; only touched by the thread of the
+	 * stream once it plays */
+	bool dmabuf_supported;
+	DARRAY(struct format_info) format_info;
+
+	gs_texture_t *texture;
+	bool texture_is_dmabuf;
+
+	struct {
+		bool valid;
+		int x, y;
+		uint32_t width, height;
+	} crop;
+
+	struct {
+		bool visible;
+		bool valid;
+		int x, y;
+		int hotspot_x, hotspot_y;
+		int width, height;
+		gs_texture_t *texture;
+	} cursor;
+
+	bool show_cursor;
+};
+
+/* ------------------------------------------------- */
+
+static bool lookup_format(struct obs_pipewire_data *obs_pw,
+			  uint32_t spa_format, enum gs_color_format *gs_format)
+{
+	for (size_t i = 0; i < obs_pw->format_info.num; i++) {
+		if (obs_pw->format_info.array[i].spa_format == spa_format) {
+			*gs_format = obs_pw->format_info.array[i].gs_format;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* requires the graphics context */
+static void init_format_info(struct obs_pipewire_data *obs_pw)
+{
+	/* GLX can't import dmabufs at all */
+	obs_pw->dmabuf_supported = obs_get_nix_platform() !=
+				   OBS_NIX_PLATFORM_X11_GLX;
+
+	for (size_t i = 0; i < N_SUPPORTED_FORMATS; i++) {
+		const uint64_t implicit = DRM_FORMAT_MOD_INVALID;
+		struct format_info *info;
+		uint64_t *modifiers;
+		size_t n_modifiers;
+
+		info = da_push_back_new(obs_pw->format_info);
+
+		info->spa_format = supported_formats[i].spa_format;
+		info->gs_format = supported_formats[i].gs_format;
+
+		if (!obs_pw->dmabuf_supported)
+			continue;
+
+		if (gs_query_dmabuf_modifiers(info->gs_format, &modifiers,
+					      &n_modifiers)) {
+			da_push_back_array(info->modifiers, modifiers,
+					   n_modifiers);
+			bfree(modifiers);
+		}
+
+		/* buffers without an explicit modifier import as well */
+		da_push_back(info->modifiers, &implicit);
+	}
+}
+
+static void free_format_info(struct obs_pipewire_data *obs_pw)
+{
+	for (size_t i = 0; i < obs_pw->format_info.num; i++)
+		da_free(obs_pw->format_info.array[i].modifiers);
+	da_free(obs_pw->format_info);
+}
+
+/* a modifier whose buffers failed to import isn't offered again */
+static void remove_modifier(struct obs_pipewire_data *obs_pw,
+			    uint32_t spa_format, uint64_t modifier)
+{
+	for (size_t i = 0; i < obs_pw->format_info.num; i++) {
+		struct format_info *info = obs_pw->format_info.array + i;
+
+		if (info->spa_format == spa_format)
+			da_erase_item(info->modifiers, &modifier);
+	}
+}
+
+static struct spa_pod *build_format(struct spa_pod_builder *b,
+				    struct obs_video_info *ovi,
+				    uint32_t format, const uint64_t *modifiers,
+				    size_t modifier_count)
+{
+	struct spa_pod_frame format_frame;
+
+	spa_pod_builder_push_object(b, &format_frame, SPA_TYPE_OBJECT_Format,
+				    SPA_PARAM_EnumFormat);
+	spa_pod_builder_add(b, SPA_FORMAT_mediaType,
+			    SPA_POD_Id(SPA_MEDIA_TYPE_video), 0);
+	spa_pod_builder_add(b, SPA_FORMAT_mediaSubtype,
+			    SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw), 0);
+	spa_pod_builder_add(b, SPA_FORMAT_VIDEO_format, SPA_POD_Id(format), 0);
+
+	/* the producer picks the modifier it can allocate buffers with */
+	if (modifier_count > 0) {
+		struct spa_pod_frame modifier_frame;
+
+		spa_pod_builder_prop(b, SPA_FORMAT_VIDEO_modifier,
+				     SPA_POD_PROP_FLAG_MANDATORY |
+					     SPA_POD_PROP_FLAG_DONT_FIXATE);
+		spa_pod_builder_push_choice(b, &modifier_frame, SPA_CHOICE_Enum,
+					    0);
+
+		/* the first value of an enum choice is the default */
+		spa_pod_builder_long(b, (int64_t)modifiers[0]);
+		for (size_t i = 0; i < modifier_count; i++)
+			spa_pod_builder_long(b, (int64_t)modifiers[i]);
+
+		spa_pod_builder_pop(b, &modifier_frame);
+	}
+
+	spa_pod_builder_add(
+		b, SPA_FORMAT_VIDEO_size,
+		SPA_POD_CHOICE_RANGE_Rectangle(
+			&SPA_RECTANGLE(320, 240), &SPA_RECTANGLE(1, 1),
+			&SPA_RECTANGLE(8192, 4320)),
+		SPA_FORMAT_VIDEO_framerate,
+		SPA_POD_CHOICE_RANGE_Fraction(
+			&SPA_FRACTION(ovi->fps_num, ovi->fps_den),
+			&SPA_FRACTION(0, 1), &SPA_FRACTION(360, 1)),
+		0);
+
+	return spa_pod_builder_pop(b, &format_frame);
+}
+
+/* every format is offered with its modifiers first, and then without any
+ * for buffers in shared memory.  params is freed with bfree */
+static bool build_format_params(struct obs_pipewire_data *obs_pw,
+				struct spa_pod_builder *b,
+				const struct spa_pod ***params,
+				uint32_t *n_params)
+{
+	const size_t max_params = obs_pw->format_info.num * 2;
+	uint32_t count = 0;
+
+	*params = bmalloc(max_params * sizeof(struct spa_pod *));
+
+	for (size_t i = 0; i < obs_pw->format_info.num; i++) {
+		struct format_info *info = obs_pw->format_info.array + i;
+		struct spa_pod *pod;
+
+		if (info->modifiers.num) {
+			pod = build_format(b, &obs_pw->video_info,
+					   info->spa_format,
+					   info->modifiers.array,
+					   info->modifiers.num);
+			if (pod)
+				(*params)[count++] = pod;
+		}
+
+		pod = build_format(b, &obs_pw->video_info, info->spa_format,
+				   NULL, 0);
+		if (pod)
+			(*params)[count++] = pod;
+	}
+
+	if (!count) {
+		blog(LOG_ERROR, "[pipewire] Failed to build format parameters");
+		bfree(*params);
+		*params = NULL;
+		return false;
+	}
+
+	*n_params = count;
+	return true;
+}
+
+/* ------------------------------------------------- */
+
+static void renegotiate_format(void *data, uint64_t expirations)
+{
+	struct obs_pipewire_data *obs_pw = data;
+	const struct spa_pod **params = NULL;
+	uint8_t params_buffer[PARAMS_BUFFER_SIZE];
+	struct spa_pod_builder pod_builder =
+		SPA_POD_BUILDER_INIT(params_buffer, sizeof(params_buffer));
+	uint32_t n_params;
+
+	UNUSED_PARAMETER(expirations);
+
+	blog(LOG_INFO, "[pipewire] Renegotiating stream");
+
+	pw_thread_loop_lock(obs_pw->thread_loop);
+
+	if (build_format_params(obs_pw, &pod_builder, &params, &n_params)) {
+		pw_stream_update_params(obs_pw->stream, params, n_params);
+		bfree(params);
+	}
+
+	pw_thread_loop_unlock(obs_pw->thread_loop);
+}
+
+static void import_dmabuf(struct obs_pipewire_data *obs_pw,
+			  struct spa_buffer *buffer)
+{
+	const uint32_t spa_format = obs_pw->format.info.raw.format;
+	const uint64_t modifier = obs_pw->format.info.raw.modifier;
+	const uint32_t planes = buffer->n_datas;
+	enum gs_color_format gs_format;
+	uint32_t offsets[planes];
+	uint32_t strides[planes];
+	uint64_t modifiers[planes];
+	int fds[planes];
+
+	if (!lookup_format(obs_pw, spa_format, &gs_format)) {
+		blog(LOG_ERROR, "[pipewire] Unsupported DMA buffer format: %d",
+		     spa_format);
+		return;
+	}
+
+	for (uint32_t plane = 0; plane < planes; plane++) {
+		fds[plane] = buffer->datas[plane].fd;
+		offsets[plane] = buffer->datas[plane].chunk->offset;
+		strides[plane] = buffer->datas[plane].chunk->stride;
+		modifiers[plane] = modifier;
+	}
+
+	if (obs_pw->texture) {
+		gs_texture_destroy(obs_pw->texture);
+		obs_pw->texture = NULL;
+	}
+
+	obs_pw->texture = gs_texture_create_from_dmabuf(
+		obs_pw->format.info.raw.size.width,
+		obs_pw->format.info.raw.size.height, gs_format, planes, fds,
+		strides, offsets,
+		modifier != DRM_FORMAT_MOD_INVALID ? modifiers : NULL);
+	obs_pw->texture_is_dmabuf = true;
+
+	if (!obs_pw->texture) {
+		blog(LOG_WARNING,
+		     "[pipewire] Failed to import DMA buffer with modifier "
+		     "0x%" PRIx64 ", renegotiating",
+		     modifier);
+		remove_modifier(obs_pw, spa_format, modifier);
+		pw_loop_signal_event(
+			pw_thread_loop_get_loop(obs_pw->thread_loop),
+			obs_pw->reneg);
+	}
+}
+
+static void upload_buffer(struct obs_pipewire_data *obs_pw,
+			  struct spa_buffer *buffer)
+{
+	const uint32_t spa_format = obs_pw->format.info.raw.format;
+	const uint32_t width = obs_pw->format.info.raw.size.width;
+	const uint32_t height = obs_pw->format.info.raw.size.height;
+	enum gs_color_format gs_format;
+
+	if (!lookup_format(obs_pw, spa_format, &gs_format)) {
+		blog(LOG_ERROR, "[pipewire] Unsupported buffer format: %d",
+		     spa_format);
+		return;
+	}
+
+	/* the texture is reused for as long as the stream keeps its size */
+	if (obs_pw->texture &&
+	    (obs_pw->texture_is_dmabuf ||
+	     gs_texture_get_width(obs_pw->texture) != width ||
+	     gs_texture_get_height(obs_pw->texture) != height ||
+	     gs_texture_get_color_format(obs_pw->texture) != gs_format)) {
+		gs_texture_destroy(obs_pw->texture);
+		obs_pw->texture = NULL;
+	}
+
+	if (!obs_pw->texture) {
+		obs_pw->texture = gs_texture_create(width, height, gs_format, 1,
+						    NULL, GS_DYNAMIC);
+		obs_pw->texture_is_dmabuf = false;
+	}
+
+	if (obs_pw->texture)
+		gs_texture_set_image(obs_pw->texture,
+				     (const uint8_t *)buffer->datas[0].data,
+				     buffer->datas[0].chunk->stride, false);
+}
+
+static void read_metadata(struct obs_pipewire_data *obs_pw,
+			  struct spa_buffer *buffer)
+{
+	struct spa_meta_cursor *cursor;
+	struct spa_meta_region *region;
+
+	region = spa_buffer_find_meta_data(buffer, SPA_META_VideoCrop,
+					   sizeof(*region));
+	if (region && spa_meta_region_is_valid(region)) {
+		obs_pw->crop.x = region->region.position.x;
+		obs_pw->crop.y = region->region.position.y;
+		obs_pw->crop.width = region->region.size.width;
+		obs_pw->crop.height = region->region.size.height;
+		obs_pw->crop.valid = true;
+	} else {
+		obs_pw->crop.valid = false;
+	}
+
+	cursor = spa_buffer_find_meta_data(buffer, SPA_META_Cursor,
+					   sizeof(*cursor));
+	obs_pw->cursor.valid = cursor && spa_meta_cursor_is_valid(cursor);
+	if (!obs_pw->cursor.visible || !obs_pw->cursor.valid)
+		return;
+
+	/* the bitmap is only sent when the cursor changes */
+	if (cursor->bitmap_offset) {
+		struct spa_meta_bitmap *bitmap = SPA_MEMBER(
+			cursor, cursor->bitmap_offset, struct spa_meta_bitmap);
+		enum gs_color_format gs_format;
+
+		if (bitmap->size.width > 0 && bitmap->size.height > 0 &&
+		    lookup_format(obs_pw, bitmap->format, &gs_format)) {
+			const uint8_t *bitmap_data =
+				SPA_MEMBER(bitmap, bitmap->offset, uint8_t);
+
+			obs_pw->cursor.hotspot_x = cursor->hotspot.x;
+			obs_pw->cursor.hotspot_y = cursor->hotspot.y;
+			obs_pw->cursor.width = bitmap->size.width;
+			obs_pw->cursor.height = bitmap->size.height;
+
+			if (obs_pw->cursor.texture)
+				gs_texture_destroy(obs_pw->cursor.texture);
+			obs_pw->cursor.texture = gs_texture_create(
+				obs_pw->cursor.width, obs_pw->cursor.height,
+				gs_format, 1, &bitmap_data, GS_DYNAMIC);
+		}
+	}
+
+	obs_pw->cursor.x = cursor->position.x;
+	obs_pw->cursor.y = cursor->position.y;
+}
+
+static void on_process_cb(void *user_data)
+{
+	struct obs_pipewire_data *obs_pw = user_data;
+	struct spa_buffer *buffer;
+	struct pw_buffer *b = NULL;
+
+	/* only the most recent buffer is of interest */
+	for (;;) {
+		struct pw_buffer *aux;
+
+		aux = pw_stream_dequeue_buffer(obs_pw->stream);
+		if (!aux)
+			break;
+		if (b)
+			pw_stream_queue_buffer(obs_pw->stream, b);
+		b = aux;
+	}
+
+	if (!b) {
+		blog(LOG_DEBUG, "[pipewire] Out of buffers!");
+		return;
+	}
+
+	buffer = b->buffer;
+
+	obs_enter_graphics();
+
+	if (buffer->datas[0].chunk->size != 0) {
+		if (buffer->datas[0].type == SPA_DATA_DmaBuf)
+			import_dmabuf(obs_pw, buffer);
+		else if (buffer->datas[0].data)
+			upload_buffer(obs_pw, buffer);
+	}
+
+	read_metadata(obs_pw, buffer);
+
+	obs_leave_graphics();
+
+	pw_stream_queue_buffer(obs_pw->stream, b);
+}
+
+static void on_param_changed_cb(void *user_data, uint32_t id,
+				const struct spa_pod *param)
+{
+	struct obs_pipewire_data *obs_pw = user_data;
+	struct spa_pod_builder pod_builder;
+	const struct spa_pod *params[3];
+	uint8_t params_buffer[1024];
+	uint32_t buffer_types;
+	bool has_modifier;
+	int result;
+
+	if (!param || id != SPA_PARAM_Format)
+		return;
+
+	result = spa_format_parse(param, &obs_pw->format.media_type,
+				  &obs_pw->format.media_subtype);
+	if (result < 0)
+		return;
+
+	if (obs_pw->format.media_type != SPA_MEDIA_TYPE_video ||
+	    obs_pw->format.media_subtype != SPA_MEDIA_SUBTYPE_raw)
+		return;
+
+	spa_format_video_raw_parse(param, &obs_pw->format.info.raw);
+
+	/* formats with a modifier were offered for dmabufs only */
+	has_modifier = spa_pod_find_prop(param, NULL,
+					 SPA_FORMAT_VIDEO_modifier) != NULL;
+	buffer_types = has_modifier ? 1 << SPA_DATA_DmaBuf
+				    : 1 << SPA_DATA_MemPtr;
+
+	blog(LOG_INFO, "[pipewire] Negotiated format:");
+	blog(LOG_INFO, "[pipewire]     Format: %d (%s)",
+	     obs_pw->format.info.raw.format,
+	     spa_debug_type_find_name(spa_type_video_format,
+				      obs_pw->format.info.raw.format));
+	if (has_modifier)
+		blog(LOG_INFO, "[pipewire]     Modifier: 0x%" PRIx64,
+		     obs_pw->format.info.raw.modifier);
+	blog(LOG_INFO, "[pipewire]     Size: %dx%d",
+	     obs_pw->format.info.raw.size.width,
+	     obs_pw->format.info.raw.size.height);
+	blog(LOG_INFO, "[pipewire]     Framerate: %d/%d",
+	     obs_pw->format.info.raw.framerate.num,
+	     obs_pw->format.info.raw.framerate.denom);
+
+	pod_builder =
+		SPA_POD_BUILDER_INIT(params_buffer, sizeof(params_buffer));
+
+	/* video crop */
+	params[0] = spa_pod_builder_add_object(
+		&pod_builder, SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta,
+		SPA_PARAM_META_type, SPA_POD_Id(SPA_META_VideoCrop),
+		SPA_PARAM_META_size,
+		SPA_POD_Int(sizeof(struct spa_meta_region)));
+
+	/* cursor */
+	params[1] = spa_pod_builder_add_object(
+		&pod_builder, SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta,
+		SPA_PARAM_META_type, SPA_POD_Id(SPA_META_Cursor),
+		SPA_PARAM_META_size,
+		SPA_POD_CHOICE_RANGE_Int(CURSOR_META_SIZE(64, 64),
+					 CURSOR_META_SIZE(1, 1),
+					 CURSOR_META_SIZE(1024, 1024)));
+
+	/* buffer options */
+	params[2] = spa_pod_builder_add_object(
+		&pod_builder, SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+		SPA_PARAM_BUFFERS_dataType, SPA_POD_Int(buffer_types));
+
+	pw_stream_update_params(obs_pw->stream, params, 3);
+
+	obs_pw->negotiated = true;
+}
+
+static void on_state_changed_cb(void *user_data, enum pw_stream_state old,
+				enum pw_stream_state state, const char *error)
+{
+	struct obs_pipewire_data *obs_pw = user_data;
+
+	UNUSED_PARAMETER(old);
+
+	blog(LOG_INFO, "[pipewire] Stream %p state: \"%s\" (error: %s)",
+	     obs_pw->stream, pw_stream_state_as_string(state),
+	     error ? error : "none");
+}
+
+static const struct pw_stream_events stream_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = on_state_changed_cb,
+	.param_changed = on_param_changed_cb,
+	.process = on_process_cb,
+};
+
+static void on_core_error_cb(void *user_data, uint32_t id, int seq, int res,
+			     const char *message)
+{
+	struct obs_pipewire_data *obs_pw = user_data;
+
+	blog(LOG_ERROR, "[pipewire] Error id:%u seq:%d res:%d (%s): %s", id,
+	     seq, res, g_strerror(res), message);
+
+	pw_thread_loop_signal(obs_pw->thread_loop, FALSE);
+}
+
+static const struct pw_core_events core_events = {
+	PW_VERSION_CORE_EVENTS,
+	.error = on_core_error_cb,
+};
+
+static void play_pipewire_stream(struct obs_pipewire_data *obs_pw)
+{
+	const struct spa_pod **params = NULL;
+	uint8_t params_buffer[PARAMS_BUFFER_SIZE];
+	struct spa_pod_builder pod_builder =
+		SPA_POD_BUILDER_INIT(params_buffer, sizeof(params_buffer));
+	uint32_t n_params;
+
+	obs_pw->thread_loop = pw_thread_loop_new("PipeWire thread loop", NULL);
+	obs_pw->context = pw_context_new(
+		pw_thread_loop_get_loop(obs_pw->thread_loop), NULL, 0);
+
+	if (pw_thread_loop_start(obs_pw->thread_loop) < 0) {
+		blog(LOG_WARNING,
+		     "[pipewire] Error starting threaded mainloop");
+		return;
+	}
+
+	pw_thread_loop_lock(obs_pw->thread_loop);
+
+	obs_pw->core = pw_context_connect_fd(
+		obs_pw->context, fcntl(obs_pw->pipewire_fd, F_DUPFD_CLOEXEC, 5),
+		NULL, 0);
+	if (!obs_pw->core) {
+		blog(LOG_WARNING,
+		     "[pipewire] Error creating PipeWire core: %m");
+		pw_thread_loop_unlock(obs_pw->thread_loop);
+		return;
+	}
+
+	pw_core_add_listener(obs_pw->core, &obs_pw->core_listener, &core_events,
+			     obs_pw);
+
+	obs_pw->reneg = pw_loop_add_event(
+		pw_thread_loop_get_loop(obs_pw->thread_loop),
+		renegotiate_format, obs_pw);
+
+	obs_pw->stream = pw_stream_new(
+		obs_pw->core, "OBS Studio",
+		pw_properties_new(PW_KEY_MEDIA_TYPE, "Video",
+				  PW_KEY_MEDIA_CATEGORY, "Capture",
+				  PW_KEY_MEDIA_ROLE, "Screen", NULL));
+	pw_stream_add_listener(obs_pw->stream, &obs_pw->stream_listener,
+			       &stream_events, obs_pw);
+	blog(LOG_INFO, "[pipewire] Created stream %p", obs_pw->stream);
+
+	obs_get_video_info(&obs_pw->video_info);
+
+	if (build_format_params(obs_pw, &pod_builder, &params, &n_params)) {
+		pw_stream_connect(obs_pw->stream, PW_DIRECTION_INPUT,
+				  obs_pw->pipewire_node,
+				  PW_STREAM_FLAG_AUTOCONNECT |
+					  PW_STREAM_FLAG_MAP_BUFFERS,
+				  params, n_params);
+		bfree(params);
+
+		blog(LOG_INFO, "[pipewire] Playing stream %p", obs_pw->stream);
+	}
+
+	pw_thread_loop_unlock(obs_pw->thread_loop);
+}
+
+static void teardown_pipewire(struct obs_pipewire_data *obs_pw)
+{
+	if (obs_pw->thread_loop)
+		pw_thread_loop_stop(obs_pw->thread_loop);
+
+	if (obs_pw->stream) {
+		pw_stream_disconnect(obs_pw->stream);
+		pw_stream_destroy(obs_pw->stream);
+		obs_pw->stream = NULL;
+	}
+
+	if (obs_pw->reneg) {
+		pw_loop_destroy_source(
+			pw_thread_loop_get_loop(obs_pw->thread_loop),
+			obs_pw->reneg);
+		obs_pw->reneg = NULL;
+	}
+
+	if (obs_pw->context) {
+		pw_context_destroy(obs_pw->context);
+		obs_pw->context = NULL;
+		obs_pw->core = NULL;
+	}
+
+	if (obs_pw->thread_loop) {
+		pw_thread_loop_destroy(obs_pw->thread_loop);
+		obs_pw->thread_loop = NULL;
+	}
+
+	if (obs_pw->pipewire_fd > 0) {
+		close(obs_pw->pipewire_fd);
+		obs_pw->pipewire_fd = 0;
+	}
+
+	obs_pw->negotiated = false;
+}
+
+/* ------------------------------------------------- */
+
+static const char *capture_type_to_string(enum portal_capture_type type)
+{
+	switch (type) {
+	case PORTAL_CAPTURE_TYPE_MONITOR:
+		return "desktop";
+	case PORTAL_CAPTURE_TYPE_WINDOW:
+		return "window";
+	}
+	return "unknown";
+}
+
+static void on_cancelled_cb(GCancellable *cancellable, void *data)
+{
+	struct dbus_call_data *call = data;
+
+	UNUSED_PARAMETER(cancellable);
+
+	blog(LOG_INFO, "[pipewire] Screencast session cancelled");
+
+	g_dbus_connection_call(portal_get_dbus_connection(),
+			       "org.freedesktop.portal.Desktop",
+			       call->request_path,
+			       "org.freedesktop.portal.Request", "Close", NULL,
+			       NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL,
+			       NULL);
+}
+
+/* the response of a request arrives as a signal on its own object, which
+ * is subscribed to before the request is made */
+static struct dbus_call_data *subscribe_to_signal(
+	struct obs_pipewire_data *obs_pw, const char *path,
+	GDBusSignalCallback callback)
+{
+	struct dbus_call_data *call = bzalloc(sizeof(struct dbus_call_data));
+
+	call->obs_pw = obs_pw;
+	call->request_path = bstrdup(path);
+	call->cancelled_id =
+		g_signal_connect(obs_pw->cancellable, "cancelled",
+				 G_CALLBACK(on_cancelled_cb), call);
+	call->signal_id = g_dbus_connection_signal_subscribe(
+		portal_get_dbus_connection(), "org.freedesktop.portal.Desktop",
+		"org.freedesktop.portal.Request", "Response",
+		call->request_path, NULL, G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE,
+		callback, call, NULL);
+
+	obs_pw->pending_call = call;
+	return call;
+}
+
+static void dbus_call_data_free(struct dbus_call_data *call)
+{
+	if (!call)
+		return;
+
+	if (call->obs_pw->pending_call == call)
+		call->obs_pw->pending_call = NULL;
+
+	if (call->signal_id)
+		g_dbus_connection_signal_unsubscribe(
+			portal_get_dbus_connection(), call->signal_id);
+
+	if (call->cancelled_id > 0)
+		g_signal_handler_disconnect(call->obs_pw->cancellable,
+					    call->cancelled_id);
+
+	bfree(call->request_path);
+	bfree(call);
+}
+
+static bool check_response(GVariant *parameters, GVariant **result,
+			   const char *what)
+{
+	uint32_t response;
+
+	g_variant_get(parameters, "(u@a{sv})", &response, result);
+
+	if (response != 0) {
+		blog(LOG_WARNING,
+		     "[pipewire] Failed to %s, denied or cancelled by user",
+		     what);
+		g_variant_unref(*result);
+		*result = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+/* method calls whose Response never comes because the call itself failed;
+ * cancelled calls belong to a source that may be gone already */
+static void on_method_called_cb(GObject *source, GAsyncResult *res,
+				gpointer user_data)
+{
+	struct dbus_call_data *call = user_data;
+	GError *error = NULL;
+	GVariant *result;
+
+	result = g_dbus_proxy_call_finish(G_DBUS_PROXY(source), res, &error);
+	if (error) {
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			blog(LOG_ERROR, "[pipewire] Portal call failed: %s",
+			     error->message);
+			dbus_call_data_free(call);
+		}
+		g_error_free(error);
+		return;
+	}
+
+	g_variant_unref(result);
+}
+
+static void on_pipewire_remote_opened_cb(GObject *source, GAsyncResult *res,
+					 void *user_data)
+{
+	struct obs_pipewire_data *obs_pw = user_data;
+	GUnixFDList *fd_list = NULL;
+	GError *error = NULL;
+	GVariant *result;
+	int fd_index;
+
+	result = g_dbus_proxy_call_with_unix_fd_list_finish(
+		G_DBUS_PROXY(source), &fd_list, res, &error);
+	if (error) {
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			blog(LOG_ERROR,
+			     "[pipewire] Error retrieving pipewire fd: %s",
+			     error->message);
+		g_error_free(error);
+		return;
+	}
+
+	g_variant_get(result, "(h)", &fd_index);
+	g_variant_unref(result);
+
+	obs_pw->pipewire_fd = g_unix_fd_list_get(fd_list, fd_index, &error);
+	g_object_unref(fd_list);
+
+	if (error) {
+		blog(LOG_ERROR, "[pipewire] Error retrieving pipewire fd: %s",
+		     error->message);
+		g_error_free(error);
+		return;
+	}
+
+	play_pipewire_stream(obs_pw);
+}
+
+static void open_pipewire_remote(struct obs_pipewire_data *obs_pw)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+
+	g_dbus_proxy_call_with_unix_fd_list(
+		portal_get_screencast_proxy(), "OpenPipeWireRemote",
+		g_variant_new("(oa{sv})", obs_pw->session_handle, &builder),
+		G_DBUS_CALL_FLAGS_NONE, -1, NULL, obs_pw->cancellable,
+		on_pipewire_remote_opened_cb, obs_pw);
+}
+
+static void on_start_response_received_cb(
+	GDBusConnection *connection, const char *sender_name,
+	const char *object_path, const char *interface_name,
+	const char *signal_name, GVariant *parameters, void *user_data)
+{
+	struct dbus_call_data *call = user_data;
+	struct obs_pipewire_data *obs_pw = call->obs_pw;
+	GVariant *stream_properties;
+	GVariant *streams;
+	GVariant *result;
+	GVariantIter iter;
+	size_t n_streams;
+
+	UNUSED_PARAMETER(connection);
+	UNUSED_PARAMETER(sender_name);
+	UNUSED_PARAMETER(object_path);
+	UNUSED_PARAMETER(interface_name);
+	UNUSED_PARAMETER(signal_name);
+
+	dbus_call_data_free(call);
+
+	if (!check_response(parameters, &result, "start screencast"))
+		return;
+
+	streams = g_variant_lookup_value(result, "streams",
+					 G_VARIANT_TYPE_ARRAY);
+	g_variant_unref(result);
+	if (!streams) {
+		blog(LOG_WARNING, "[pipewire] Screencast has no streams");
+		return;
+	}
+
+	g_variant_iter_init(&iter, streams);
+
+	n_streams = g_variant_iter_n_children(&iter);
+	if (n_streams != 1)
+		blog(LOG_WARNING,
+		     "[pipewire] Received more than one stream when only "
+		     "one was expected, using the first one");
+
+	if (g_variant_iter_next(&iter, "(u@a{sv})", &obs_pw->pipewire_node,
+				&stream_properties)) {
+		g_variant_unref(stream_properties);
+
+		blog(LOG_INFO, "[pipewire] %s selected, setting up screencast",
+		     capture_type_to_string(obs_pw->capture_type));
+
+		open_pipewire_remote(obs_pw);
+	}
+
+	g_variant_unref(streams);
+}
+
+static void start(struct obs_pipewire_data *obs_pw)
+{
+	GVariantBuilder builder;
+	char *request_token;
+	char *request_path;
+
+	portal_create_request_path(&request_path, &request_token);
+
+	blog(LOG_INFO, "[pipewire] Asking for %s",
+	     capture_type_to_string(obs_pw->capture_type));
+
+	subscribe_to_signal(obs_pw, request_path,
+			    on_start_response_received_cb);
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&builder, "{sv}", "handle_token",
+			      g_variant_new_string(request_token));
+
+	g_dbus_proxy_call(portal_get_screencast_proxy(), "Start",
+			  g_variant_new("(osa{sv})", obs_pw->session_handle, "",
+					&builder),
+			  G_DBUS_CALL_FLAGS_NONE, -1, obs_pw->cancellable,
+			  on_method_called_cb, obs_pw->pending_call);
+
+	bfree(request_token);
+	bfree(request_path);
+}
+
+static void on_select_source_response_received_cb(
+	GDBusConnection *connection, const char *sender_name,
+	const char *object_path, const char *interface_name,
+	const char *signal_name, GVariant *parameters, void *user_data)
+{
+	struct dbus_call_data *call = user_data;
+	struct obs_pipewire_data *obs_pw = call->obs_pw;
+	GVariant *result;
+
+	UNUSED_PARAMETER(connection);
+	UNUSED_PARAMETER(sender_name);
+	UNUSED_PARAMETER(object_path);
+	UNUSED_PARAMETER(interface_name);
+	UNUSED_PARAMETER(signal_name);
+
+	dbus_call_data_free(call);
+
+	if (!check_response(parameters, &result, "select source"))
+		return;
+
+	g_variant_unref(result);
+	start(obs_pw);
+}
+
+/* the cursor is drawn from the metadata of the stream when possible, so
+ * that it can be shown and hidden without selecting the source again */
+static uint32_t select_cursor_mode(struct obs_pipewire_data *obs_pw)
+{
+	if (obs_pw->available_cursor_modes & PORTAL_CURSOR_MODE_METADATA)
+		return PORTAL_CURSOR_MODE_METADATA;
+
+	if (obs_pw->show_cursor &&
+	    (obs_pw->available_cursor_modes & PORTAL_CURSOR_MODE_EMBEDDED))
+		return PORTAL_CURSOR_MODE_EMBEDDED;
+
+	return PORTAL_CURSOR_MODE_HIDDEN;
+}
+
+static void select_source(struct obs_pipewire_data *obs_pw)
+{
+	GVariantBuilder builder;
+	char *request_token;
+	char *request_path;
+
+	portal_create_request_path(&request_path, &request_token);
+
+	subscribe_to_signal(obs_pw, request_path,
+			    on_select_source_response_received_cb);
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&builder, "{sv}", "types",
+			      g_variant_new_uint32(obs_pw->capture_type));
+	g_variant_builder_add(&builder, "{sv}", "multiple",
+			      g_variant_new_boolean(FALSE));
+	g_variant_builder_add(&builder, "{sv}", "handle_token",
+			      g_variant_new_string(request_token));
+
+	if (obs_pw->available_cursor_modes)
+		g_variant_builder_add(
+			&builder, "{sv}", "cursor_mode",
+			g_variant_new_uint32(select_cursor_mode(obs_pw)));
+
+	g_dbus_proxy_call(portal_get_screencast_proxy(), "SelectSources",
+			  g_variant_new("(oa{sv})", obs_pw->session_handle,
+					&builder),
+			  G_DBUS_CALL_FLAGS_NONE, -1, obs_pw->cancellable,
+			  on_method_called_cb, obs_pw->pending_call);
+
+	bfree(request_token);
+	bfree(request_path);
+}
+
+static void on_create_session_response_received_cb(
+	GDBusConnection *connection, const char *sender_name,
+	const char *object_path, const char *interface_name,
+	const char *signal_name, GVariant *parameters, void *user_data)
+{
+	struct dbus_call_data *call = user_data;
+	struct obs_pipewire_data *obs_pw = call->obs_pw;
+	const char *session_handle;
+	GVariant *result;
+
+	UNUSED_PARAMETER(connection);
+	UNUSED_PARAMETER(sender_name);
+	UNUSED_PARAMETER(object_path);
+	UNUSED_PARAMETER(interface_name);
+	UNUSED_PARAMETER(signal_name);
+
+	dbus_call_data_free(call);
+
+	if (!check_response(parameters, &result, "create session"))
+		return;
+
+	if (g_variant_lookup(result, "session_handle", "&s",
+			     &session_handle)) {
+		blog(LOG_INFO, "[pipewire] Screencast session created");
+
+		bfree(obs_pw->session_handle);
+		obs_pw->session_handle = bstrdup(session_handle);
+		select_source(obs_pw);
+	}
+
+	g_variant_unref(result);
+}
+
+static void create_session(struct obs_pipewire_data *obs_pw)
+{
+	GVariantBuilder builder;
+	char *session_token;
+	char *request_token;
+	char *request_path;
+
+	portal_create_request_path(&request_path, &request_token);
+	portal_create_session_path(NULL, &session_token);
+
+	subscribe_to_signal(obs_pw, request_path,
+			    on_create_session_response_received_cb);
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&builder, "{sv}", "handle_token",
+			      g_variant_new_string(request_token));
+	g_variant_builder_add(&builder, "{sv}", "session_handle_token",
+			      g_variant_new_string(session_token));
+
+	g_dbus_proxy_call(portal_get_screencast_proxy(), "CreateSession",
+			  g_variant_new("(a{sv})", &builder),
+			  G_DBUS_CALL_FLAGS_NONE, -1, obs_pw->cancellable,
+			  on_method_called_cb, obs_pw->pending_call);
+
+	bfree(session_token);
+	bfree(request_token);
+	bfree(request_path);
+}
+
+static bool init_screencast(struct obs_pipewire_data *obs_pw)
+{
+	if (!portal_get_screencast_proxy())
+		return false;
+
+	obs_pw->cancellable = g_cancellable_new();
+	obs_pw->available_cursor_modes = portal_get_available_cursor_modes();
+
+	create_session(obs_pw);
+	return true;
+}
+
+static void destroy_session(struct obs_pipewire_data *obs_pw)
+{
+	if (obs_pw->session_handle) {
+		g_dbus_connection_call(portal_get_dbus_connection(),
+				       "org.freedesktop.portal.Desktop",
+				       obs_pw->session_handle,
+				       "org.freedesktop.portal.Session",
+				       "Close", NULL, NULL,
+				       G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL,
+				       NULL);
+
+		bfree(obs_pw->session_handle);
+		obs_pw->session_handle = NULL;
+	}
+
+	if (obs_pw->cancellable) {
+		/* closes the pending request, whose response then never
+		 * arrives */
+		g_cancellable_cancel(obs_pw->cancellable);
+		dbus_call_data_free(obs_pw->pending_call);
+		g_clear_object(&obs_pw->cancellable);
+	}
+}
+
+static bool reload_session_cb(obs_properties_t *properties,
+			      obs_property_t *property, void *data)
+{
+	struct obs_pipewire_data *obs_pw = data;
+
+	UNUSED_PARAMETER(properties);
+	UNUSED_PARAMETER(property);
+
+	teardown_pipewire(obs_pw);
+	destroy_session(obs_pw);
+
+	init_screencast(obs_pw);
+	return false;
+}
+
+/* ------------------------------------------------- */
+
+struct obs_pipewire_data *
+obs_pipewire_create(enum portal_capture_type capture_type,
+		    obs_data_t *settings, obs_source_t *source)
+{
+	struct obs_pipewire_data *obs_pw =
+		bzalloc(sizeof(struct obs_pipewire_data));
+
+	obs_pw->source = source;
+	obs_pw->capture_type = capture_type;
+	obs_pw->show_cursor = obs_data_get_bool(settings, "show_cursor");
+	obs_pw->cursor.visible = obs_pw->show_cursor;
+
+	obs_enter_graphics();
+	init_format_info(obs_pw);
+	obs_leave_graphics();
+
+	if (!init_screencast(obs_pw)) {
+		free_format_info(obs_pw);
+		bfree(obs_pw);
+		return NULL;
+	}
+
+	return obs_pw;
+}
+
+void obs_pipewire_destroy(struct obs_pipewire_data *obs_pw)
+{
+	if (!obs_pw)
+		return;
+
+	teardown_pipewire(obs_pw);
+	destroy_session(obs_pw);
+
+	obs_enter_graphics();
+	if (obs_pw->texture)
+		gs_texture_destroy(obs_pw->texture);
+	if (obs_pw->cursor.texture)
+		gs_texture_destroy(obs_pw->cursor.texture);
+	obs_leave_graphics();
+
+	free_format_info(obs_pw);
+	bfree(obs_pw);
+}
+
+void obs_pipewire_get_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_bool(settings, "show_cursor", true);
+}
+
+obs_properties_t *obs_pipewire_get_properties(struct obs_pipewire_data *obs_pw,
+					      const char *reload_string_id)
+{
+	obs_properties_t *properties = obs_properties_create();
+
+	obs_properties_add_button2(properties, "reload",
+				   obs_module_text(reload_string_id),
+				   reload_session_cb, obs_pw);
+	obs_properties_add_bool(properties, "show_cursor",
+				obs_module_text("CaptureCursor"));
+
+	return properties;
+}
+
+void obs_pipewire_update(struct obs_pipewire_data *obs_pw,
+			 obs_data_t *settings)
+{
+	obs_pw->show_cursor = obs_data_get_bool(settings, "show_cursor");
+	obs_pw->cursor.visible = obs_pw->show_cursor;
+}
+
+/* hidden sources don't receive frames */
+static void set_stream_active(struct obs_pipewire_data *obs_pw, bool active)
+{
+	if (!obs_pw->stream)
+		return;
+
+	pw_thread_loop_lock(obs_pw->thread_loop);
+	pw_stream_set_active(obs_pw->stream, active);
+	pw_thread_loop_unlock(obs_pw->thread_loop);
+}
+
+void obs_pipewire_show(struct obs_pipewire_data *obs_pw)
+{
+	set_stream_active(obs_pw, true);
+}
+
+void obs_pipewire_hide(struct obs_pipewire_data *obs_pw)
+{
+	set_stream_active(obs_pw, false);
+}
+
+uint32_t obs_pipewire_get_width(struct obs_pipewire_data *obs_pw)
+{
+	if (!obs_pw->negotiated)
+		return 0;
+
+	if (obs_pw->crop.valid)
+		return obs_pw->crop.width;
+
+	return obs_pw->format.info.raw.size.width;
+}
+
+uint32_t obs_pipewire_get_height(struct obs_pipewire_data *obs_pw)
+{
+	if (!obs_pw->negotiated)
+		return 0;
+
+	if (obs_pw->crop.valid)
+		return obs_pw->crop.height;
+
+	return obs_pw->format.info.raw.size.height;
+}
+
+void obs_pipewire_video_render(struct obs_pipewire_data *obs_pw,
+			       gs_effect_t *effect)
+{
+	gs_eparam_t *image;
+
+	if (!obs_pw->texture)
+		return;
+
+	image = gs_effect_get_param_by_name(effect, "image");
+	gs_effect_set_texture(image, obs_pw->texture);
+
+	if (obs_pw->crop.valid)
+		gs_draw_sprite_subregion(obs_pw->texture, 0, obs_pw->crop.x,
+					 obs_pw->crop.y, obs_pw->crop.width,
+					 obs_pw->crop.height);
+	else
+		gs_draw_sprite(obs_pw->texture, 0, 0, 0);
+
+	if (obs_pw->cursor.visible && obs_pw->cursor.valid &&
+	    obs_pw->cursor.texture) {
+		float cursor_x = obs_pw->cursor.x - obs_pw->cursor.hotspot_x;
+		float cursor_y = obs_pw->cursor.y - obs_pw->cursor.hotspot_y;
+
+		gs_matrix_push();
+		gs_matrix_translate3f(cursor_x, cursor_y, 0.0f);
+
+		gs_effect_set_texture(image, obs_pw->cursor.texture);
+		gs_draw_sprite(obs_pw->cursor.texture, 0, obs_pw->cursor.width,
+			       obs_pw->cursor.height);
+
+		gs_matrix_pop();
+	}
+}
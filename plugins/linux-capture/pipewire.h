@@ -0,0 +1,38 @@
+#pragma once
+
+#include <obs-module.h>
+
+#include "portal.h"
+
+/*
+ * Screen and window capture through the ScreenCast portal of
+ * xdg-desktop-portal, which hands out a PipeWire stream of the selected
+ * monitor or window.
+ *
+ * dmabufs of the stream are imported as textures without copies, with the
+ * modifiers the graphics backend supports.  Streams (or modifiers) that
+ * can't be imported fall back to buffers in shared memory, which are
+ * uploaded.
+ */
+
+struct obs_pipewire_data;
+
+extern struct obs_pipewire_data *
+obs_pipewire_create(enum portal_capture_type capture_type,
+		    obs_data_t *settings, obs_source_t *source);
+extern void obs_pipewire_destroy(struct obs_pipewire_data *obs_pw);
+
+extern void obs_pipewire_get_defaults(obs_data_t *settings);
+extern obs_properties_t *
+obs_pipewire_get_properties(struct obs_pipewire_data *obs_pw,
+			    const char *reload_string_id);
+extern void obs_pipewire_update(struct obs_pipewire_data *obs_pw,
+				obs_data_t *settings);
+
+extern void obs_pipewire_show(struct obs_pipewire_data *obs_pw);
+extern void obs_pipewire_hide(struct obs_pipewire_data *obs_pw);
+
+extern uint32_t obs_pipewire_get_width(struct obs_pipewire_data *obs_pw);
+extern uint32_t obs_pipewire_get_height(struct obs_pipewire_data *obs_pw);
+extern void obs_pipewire_video_render(struct obs_pipewire_data *obs_pw,
+				      gs_effect_t *effect);
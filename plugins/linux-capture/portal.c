@@ -0,0 +1,135 @@
+#include "portal.h"
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+
+static GDBusConnection *connection = NULL;
+static GDBusProxy *screencast_proxy = NULL;
+
+static void ensure_screencast_proxy(void)
+{
+	GError *error = NULL;
+
+	if (!connection) {
+		connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+		if (error) {
+			blog(LOG_WARNING,
+			     "[portals] Error retrieving D-Bus connection: %s",
+			     error->message);
+			g_error_free(error);
+			return;
+		}
+	}
+
+	if (!screencast_proxy) {
+		screencast_proxy = g_dbus_proxy_new_sync(
+			connection, G_DBUS_PROXY_FLAGS_NONE, NULL,
+			"org.freedesktop.portal.Desktop",
+			"/org/freedesktop/portal/desktop",
+			"org.freedesktop.portal.ScreenCast", NULL, &error);
+		if (error) {
+			blog(LOG_WARNING,
+			     "[portals] Error retrieving D-Bus proxy: %s",
+			     error->message);
+			g_error_free(error);
+			return;
+		}
+	}
+}
+
+static uint32_t get_uint_property(const char *name)
+{
+	GDBusProxy *proxy = portal_get_screencast_proxy();
+	GVariant *cached;
+	uint32_t value;
+
+	if (!proxy)
+		return 0;
+
+	cached = g_dbus_proxy_get_cached_property(proxy, name);
+	if (!cached)
+		return 0;
+
+	value = g_variant_get_uint32(cached);
+	g_variant_unref(cached);
+	return value;
+}
+
+/* the unique name of the connection without the leading ':' and with
+ * underscores instead of dots, as used in the paths of requests */
+static char *get_sender_name(void)
+{
+	const char *unique_name = g_dbus_connection_get_unique_name(connection);
+	char *sender_name = bstrdup(unique_name + 1);
+
+	for (char *aux = sender_name; *aux; aux++) {
+		if (*aux == '.')
+			*aux = '_';
+	}
+
+	return sender_name;
+}
+
+static void create_path(const char *kind, uint32_t count, char **out_path,
+			char **out_token)
+{
+	struct dstr str = {0};
+
+	if (out_token) {
+		dstr_printf(&str, "obs%u", count);
+		*out_token = str.array;
+		dstr_init(&str);
+	}
+
+	if (out_path) {
+		char *sender_name = get_sender_name();
+
+		dstr_printf(&str, "/org/freedesktop/portal/desktop/%s/%s/obs%u",
+			    kind, sender_name, count);
+		*out_path = str.array;
+		bfree(sender_name);
+	}
+}
+
+uint32_t portal_get_available_capture_types(void)
+{
+	return get_uint_property("AvailableSourceTypes");
+}
+
+uint32_t portal_get_available_cursor_modes(void)
+{
+	return get_uint_property("AvailableCursorModes");
+}
+
+GDBusConnection *portal_get_dbus_connection(void)
+{
+	ensure_screencast_proxy();
+	return connection;
+}
+
+GDBusProxy *portal_get_screencast_proxy(void)
+{
+	ensure_screencast_proxy();
+	return screencast_proxy;
+}
+
+void portal_create_request_path(char **out_path, char **out_token)
+{
+	static uint32_t request_token_count = 0;
+
+	create_path("request", ++request_token_count, out_path, out_token);
+}
+
+void portal_create_session_path(char **out_path, char **out_token)
+{
+	static uint32_t session_token_count = 0;
+
+	create_path("session", ++session_token_count, out_path, out_token);
+}
+
+void portal_unload(void)
+{
+	g_clear_object(&screencast_proxy);
+	g_clear_object(&connection);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <gio/gio.h>
+
+/* the source types and cursor modes of the ScreenCast portal */
+enum portal_capture_type {
+	PORTAL_CAPTURE_TYPE_MONITOR = 1 << 0,
+	PORTAL_CAPTURE_TYPE_WINDOW = 1 << 1,
+};
+
+enum portal_cursor_mode {
+	PORTAL_CURSOR_MODE_HIDDEN = 1 << 0,
+	PORTAL_CURSOR_MODE_EMBEDDED = 1 << 1,
+	PORTAL_CURSOR_MODE_METADATA = 1 << 2,
+};
+
+uint32_t portal_get_available_capture_types(void);
+uint32_t portal_get_available_cursor_modes(void);
+
+GDBusConnection *portal_get_dbus_connection(void);
+GDBusProxy *portal_get_screencast_proxy(void);
+
+/* object paths and handle tokens of new requests and sessions, freed with
+ * bfree */
+void portal_create_request_path(char **out_path, char **out_token);
+void portal_create_session_path(char **out_path, char **out_token);
+
+void portal_unload(void);
@@ -18,6 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <xcb/damage.h>
 #include <xcb/randr.h>
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
@@ -32,6 +33,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+/* more damaged rectangles than this are fetched as a whole screen */
+#define XSHM_MAX_DAMAGE_RECTS 32
+
 struct xshm_data {
 	obs_source_t *source;
 
@@ -49,6 +53,10 @@ struct xshm_data {
 
 	gs_texture_t *texture;
 
+	xcb_damage_damage_t damage;
+	xcb_xfixes_region_t damage_region;
+	bool full_refresh;
+
 	int_fast32_t cut_top;
 	int_fast32_t cut_left;
 	int_fast32_t cut_right;
@@ -98,9 +106,60 @@ static bool xshm_check_extensions(xcb_connection_t *xcb)
 	if (!xcb_get_extension_data(xcb, &xcb_randr_id)->present)
 		blog(LOG_INFO, "Missing Randr extension !");
 
+	if (!xcb_get_extension_data(xcb, &xcb_damage_id)->present)
+		blog(LOG_INFO, "Missing Damage extension !");
+
 	return ok;
 }
 
+/**
+ * Start tracking the damage of the root window
+ *
+ * Without the Damage extension the whole screen is fetched every frame.
+ *
+ * @note requires the xfixes version to be queried already
+ */
+static void xshm_damage_init(struct xshm_data *data)
+{
+	xcb_damage_query_version_cookie_t ver_c;
+	xcb_damage_query_version_reply_t *ver_r;
+
+	if (!xcb_get_extension_data(data->xcb, &xcb_damage_id)->present ||
+	    !xcb_get_extension_data(data->xcb, &xcb_xfixes_id)->present)
+		return;
+
+	ver_c = xcb_damage_query_version_unchecked(data->xcb,
+						   XCB_DAMAGE_MAJOR_VERSION,
+						   XCB_DAMAGE_MINOR_VERSION);
+	ver_r = xcb_damage_query_version_reply(data->xcb, ver_c, NULL);
+	if (!ver_r)
+		return;
+	free(ver_r);
+
+	data->damage = xcb_generate_id(data->xcb);
+	xcb_damage_create(data->xcb, data->damage, data->xcb_screen->root,
+			  XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+
+	data->damage_region = xcb_generate_id(data->xcb);
+	xcb_xfixes_create_region(data->xcb, data->damage_region, 0, NULL);
+
+	blog(LOG_INFO, "Fetching damaged regions only");
+}
+
+/**
+ * Stop tracking the damage of the root window
+ */
+static void xshm_damage_free(struct xshm_data *data)
+{
+	if (!data->damage)
+		return;
+
+	xcb_damage_destroy(data->xcb, data->damage);
+	xcb_xfixes_destroy_region(data->xcb, data->damage_region);
+	data->damage = 0;
+	data->damage_region = 0;
+}
+
 /**
  * Update the capture
  *
@@ -206,6 +265,9 @@ static void xshm_capture_stop(struct xshm_data *data)
 		data->xshm = NULL;
 	}
 
+	if (data->xcb)
+		xshm_damage_free(data);
+
 	if (data->xcb) {
 		xcb_disconnect(data->xcb);
 		data->xcb = NULL;
@@ -252,6 +314,9 @@ static void xshm_capture_start(struct xshm_data *data)
 	data->cursor = xcb_xcursor_init(data->xcb);
 	xcb_xcursor_offset(data->cursor, data->adj_x_org, data->adj_y_org);
 
+	xshm_damage_init(data);
+	data->full_refresh = true;
+
 	obs_enter_graphics();
 
 	xshm_resize_texture(data);
@@ -468,47 +533,191 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 }
 
 /**
- * Prepare the capture data
+ * Clip a rectangle of the root window to the captured area
+ *
+ * @return false if nothing of it is captured
  */
-static void xshm_video_tick(void *vptr, float seconds)
+static bool xshm_clip_rect(struct xshm_data *data, xcb_rectangle_t *rect)
 {
-	UNUSED_PARAMETER(seconds);
-	XSHM_DATA(vptr);
+	int_fast32_t x1 = rect->x;
+	int_fast32_t y1 = rect->y;
+	int_fast32_t x2 = x1 + rect->width;
+	int_fast32_t y2 = y1 + rect->height;
+
+	if (x1 < data->adj_x_org)
+		x1 = data->adj_x_org;
+	if (y1 < data->adj_y_org)
+		y1 = data->adj_y_org;
+	if (x2 > data->adj_x_org + data->adj_width)
+		x2 = data->adj_x_org + data->adj_width;
+	if (y2 > data->adj_y_org + data->adj_height)
+		y2 = data->adj_y_org + data->adj_height;
+
+	if (x2 <= x1 || y2 <= y1)
+		return false;
+
+	rect->x = x1;
+	rect->y = y1;
+	rect->width = x2 - x1;
+	rect->height = y2 - y1;
+	return true;
+}
 
-	if (!data->texture)
-		return;
-	if (!obs_source_showing(data->source))
-		return;
+/**
+ * Fetch and upload the parts of the screen damaged since the last frame
+ *
+ * The rectangles are fetched next to each other into the shm segment, which
+ * always has room for them since they don't overlap.
+ *
+ * @return false if the whole screen has to be fetched instead
+ */
+static bool xshm_update_damaged(struct xshm_data *data)
+{
+	xcb_shm_get_image_cookie_t img_c[XSHM_MAX_DAMAGE_RECTS];
+	xcb_rectangle_t rects[XSHM_MAX_DAMAGE_RECTS];
+	uint32_t offsets[XSHM_MAX_DAMAGE_RECTS];
+	xcb_xfixes_fetch_region_cookie_t reg_c;
+	xcb_xfixes_fetch_region_reply_t *reg_r;
+	xcb_rectangle_t *damaged;
+	size_t count = 0;
+	uint32_t area = 0;
+	bool success = true;
+	int damaged_count;
+
+	xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+			    data->damage_region);
+	reg_c = xcb_xfixes_fetch_region_unchecked(data->xcb,
+						  data->damage_region);
+	reg_r = xcb_xfixes_fetch_region_reply(data->xcb, reg_c, NULL);
+	if (!reg_r)
+		return false;
+
+	damaged = xcb_xfixes_fetch_region_rectangles(reg_r);
+	damaged_count = xcb_xfixes_fetch_region_rectangles_length(reg_r);
+
+	for (int i = 0; i < damaged_count; i++) {
+		xcb_rectangle_t rect = damaged[i];
+
+		if (!xshm_clip_rect(data, &rect))
+			continue;
+
+		if (count == XSHM_MAX_DAMAGE_RECTS) {
+			free(reg_r);
+			return false;
+		}
+
+		offsets[count] = area * 4;
+		rects[count++] = rect;
+		area += (uint32_t)rect.width * rect.height;
+	}
+
+	free(reg_r);
+
+	/* a single request is cheaper once most of the screen changed */
+	if (area > (uint32_t)(data->adj_width * data->adj_height) / 2)
+		return false;
+
+	for (size_t i = 0; i < count; i++)
+		img_c[i] = xcb_shm_get_image_unchecked(
+			data->xcb, data->xcb_screen->root, rects[i].x,
+			rects[i].y, rects[i].width, rects[i].height, ~0,
+			XCB_IMAGE_FORMAT_Z_PIXMAP, data->xshm->seg, offsets[i]);
+
+	for (size_t i = 0; i < count; i++) {
+		xcb_shm_get_image_reply_t *img_r =
+			xcb_shm_get_image_reply(data->xcb, img_c[i], NULL);
+		if (!img_r)
+			success = false;
+		free(img_r);
+	}
+
+	if (!success || !count)
+		return success;
+
+	obs_enter_graphics();
+
+	for (size_t i = 0; i < count && success; i++)
+		success = gs_texture_set_subimage(
+			data->texture, rects[i].x - data->adj_x_org,
+			rects[i].y - data->adj_y_org, rects[i].width,
+			rects[i].height, data->xshm->data + offsets[i],
+			rects[i].width * 4);
+
+	obs_leave_graphics();
 
+	/* the graphics backend can't upload regions, don't try again */
+	if (!success)
+		xshm_damage_free(data);
+
+	return success;
+}
+
+/**
+ * Fetch and upload the whole screen
+ */
+static void xshm_update_full(struct xshm_data *data)
+{
 	xcb_shm_get_image_cookie_t img_c;
 	xcb_shm_get_image_reply_t *img_r;
-	xcb_xfixes_get_cursor_image_cookie_t cur_c;
-	xcb_xfixes_get_cursor_image_reply_t *cur_r;
+
+	/* everything damaged until now is part of this frame */
+	if (data->damage)
+		xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+				    XCB_NONE);
 
 	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
 					    data->adj_x_org, data->adj_y_org,
 					    data->adj_width, data->adj_height,
 					    ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
 					    data->xshm->seg, 0);
-	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
-
 	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
-	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
-
 	if (!img_r)
-		goto exit;
+		return;
 
 	obs_enter_graphics();
-
 	gs_texture_set_image(data->texture, (void *)data->xshm->data,
 			     data->adj_width * 4, false);
-	xcb_xcursor_update(data->cursor, cur_r);
-
 	obs_leave_graphics();
 
-exit:
+	data->full_refresh = false;
 	free(img_r);
-	free(cur_r);
+}
+
+/**
+ * Prepare the capture data
+ */
+static void xshm_video_tick(void *vptr, float seconds)
+{
+	UNUSED_PARAMETER(seconds);
+	XSHM_DATA(vptr);
+
+	if (!data->texture)
+		return;
+	if (!obs_source_showing(data->source))
+		return;
+
+	xcb_xfixes_get_cursor_image_cookie_t cur_c;
+	xcb_xfixes_get_cursor_image_reply_t *cur_r;
+	xcb_generic_event_t *event;
+
+	/* damage notifications aren't used, the region is polled instead */
+	while ((event = xcb_poll_for_event(data->xcb)))
+		free(event);
+
+	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
+
+	if (!data->damage || data->full_refresh || !xshm_update_damaged(data))
+		xshm_update_full(data);
+
+	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
+
+	if (cur_r) {
+		obs_enter_graphics();
+		xcb_xcursor_update(data->cursor, cur_r);
+		obs_leave_graphics();
+
+		free(cur_r);
+	}
 }
 
 /**
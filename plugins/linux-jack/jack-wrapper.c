@@ -86,7 +86,11 @@ int jack_process_callback(jack_nframes_t nframes, void *arg)
 	out.frames = nframes;
 	if (!jack_get_cycle_times(data->jack_client, &current_frames,
 				  &current_usecs, &next_usecs, &period_usecs)) {
-		out.timestamp = now - (int64_t)(period_usecs * 1000);
+		/* the buffers hold the period that ended when this cycle
+		 * started, so date them from the cycle's frame time rather
+		 * than from when the callback happened to be scheduled */
+		jack_time_t elapsed = jack_get_time() - current_usecs;
+		out.timestamp = now - (elapsed + (uint64_t)period_usecs) * 1000;
 	} else {
 		out.timestamp = now - util_mul_div64(nframes, 1000000000ULL,
 						     data->samples_per_sec);
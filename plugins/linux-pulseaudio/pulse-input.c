@@ -35,6 +35,7 @@ struct pulse_data {
 	/* user settings */
 	char *device;
 	bool input;
+	uint_fast32_t fragment_ms;
 
 	/* server info */
 	enum speaker_layout speakers;
@@ -43,6 +44,7 @@ struct pulse_data {
 	uint_fast32_t bytes_per_frame;
 	uint_fast8_t channels;
 	uint64_t first_ts;
+	uint64_t next_ts;
 
 	/* statistics */
 	uint_fast32_t packets;
@@ -170,6 +172,49 @@ static inline uint64_t get_sample_time(size_t frames, uint_fast32_t rate)
 	return os_gettime_ns() - samples_to_ns(frames, rate);
 }
 
+/**
+ * Get the capture time of the first frame in the read buffer
+ *
+ * The stream latency covers the source latency and all data that has not
+ * been dropped yet, so it includes the frames of the current fragment.
+ * Until the first timing update arrives the callback time is used instead.
+ */
+static uint64_t get_stream_time(struct pulse_data *data, size_t frames)
+{
+	pa_usec_t latency;
+	int negative;
+
+	if (pa_stream_get_latency(data->stream, &latency, &negative) < 0)
+		return get_sample_time(frames, data->samples_per_sec);
+
+	uint64_t now = os_gettime_ns();
+	uint64_t latency_ns = negative ? 0 : latency * 1000;
+	return latency_ns < now ? now - latency_ns : 0;
+}
+
+/**
+ * Keep consecutive packets contiguous
+ *
+ * The measured time jitters by a fraction of the fragment size, so packets
+ * that arrive within a fragment of where they are expected are placed right
+ * after the previous one, and anything further off resyncs to the clock.
+ */
+static uint64_t smooth_timestamp(struct pulse_data *data, uint64_t ts,
+				 size_t frames)
+{
+	uint64_t threshold = data->fragment_ms * NSEC_PER_MSEC;
+	uint64_t expected = data->next_ts;
+
+	if (expected) {
+		uint64_t diff = ts > expected ? ts - expected : expected - ts;
+		if (diff < threshold)
+			ts = expected;
+	}
+
+	data->next_ts = ts + samples_to_ns(frames, data->samples_per_sec);
+	return ts;
+}
+
 #define STARTUP_TIMEOUT_NS (500 * NSEC_PER_MSEC)
 
 /**
@@ -208,7 +253,8 @@ static void pulse_stream_read(pa_stream *p, size_t nbytes, void *userdata)
 	out.format = pulse_to_obs_audio_format(data->format);
 	out.data[0] = (uint8_t *)frames;
 	out.frames = bytes / data->bytes_per_frame;
-	out.timestamp = get_sample_time(out.frames, out.samples_per_sec);
+	out.timestamp = smooth_timestamp(
+		data, get_stream_time(data, out.frames), out.frames);
 
 	if (!data->first_ts)
 		data->first_ts = out.timestamp + STARTUP_TIMEOUT_NS;
@@ -322,9 +368,9 @@ skip:
  * We request the default format used by pulse here because the data will be
  * converted and possibly re-sampled by obs anyway.
  *
- * For now we request a buffer length of 25ms although pulse seems to ignore
- * this setting for monitor streams. For "real" input streams this should work
- * fine though.
+ * The fragment size is configurable, pulse may still pick a larger one for
+ * monitor streams. Timing updates are requested so the read callback can
+ * timestamp the data from the stream latency.
  */
 static int_fast32_t pulse_start_recording(struct pulse_data *data)
 {
@@ -372,13 +418,15 @@ static int_fast32_t pulse_start_recording(struct pulse_data *data)
 	pulse_unlock();
 
 	pa_buffer_attr attr;
-	attr.fragsize = pa_usec_to_bytes(25000, &spec);
+	attr.fragsize = pa_usec_to_bytes(data->fragment_ms * 1000, &spec);
 	attr.maxlength = (uint32_t)-1;
 	attr.minreq = (uint32_t)-1;
 	attr.prebuf = (uint32_t)-1;
 	attr.tlength = (uint32_t)-1;
 
-	pa_stream_flags_t flags = PA_STREAM_ADJUST_LATENCY;
+	pa_stream_flags_t flags = PA_STREAM_ADJUST_LATENCY |
+				  PA_STREAM_INTERPOLATE_TIMING |
+				  PA_STREAM_AUTO_TIMING_UPDATE;
 
 	pulse_lock();
 	int_fast32_t ret = pa_stream_connect_record(data->stream, data->device,
@@ -390,7 +438,9 @@ static int_fast32_t pulse_start_recording(struct pulse_data *data)
 		return -1;
 	}
 
-	blog(LOG_INFO, "Started recording from '%s'", data->device);
+	blog(LOG_INFO,
+	     "Started recording from '%s' with %" PRIuFAST32 " ms fragments",
+	     data->device, data->fragment_ms);
 	return 0;
 }
 
@@ -413,6 +463,7 @@ static void pulse_stop_recording(struct pulse_data *data)
 	     data->packets, data->frames);
 
 	data->first_ts = 0;
+	data->next_ts = 0;
 	data->packets = 0;
 	data->frames = 0;
 }
@@ -451,6 +502,10 @@ skip:
 	pulse_signal(0);
 }
 
+#define MIN_FRAGMENT_MS 5
+#define MAX_FRAGMENT_MS 100
+#define DEFAULT_FRAGMENT_MS 25
+
 /**
  * Get plugin properties
  */
@@ -474,6 +529,11 @@ static obs_properties_t *pulse_properties(bool input)
 		obs_property_list_insert_string(
 			devices, 0, obs_module_text("Default"), "default");
 
+	obs_property_t *p = obs_properties_add_int(
+		props, "fragment_ms", obs_module_text("FragmentSize"),
+		MIN_FRAGMENT_MS, MAX_FRAGMENT_MS, 1);
+	obs_property_int_set_suffix(p, " ms");
+
 	return props;
 }
 
@@ -497,6 +557,7 @@ static obs_properties_t *pulse_output_properties(void *unused)
 static void pulse_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_string(settings, "device_id", "default");
+	obs_data_set_default_int(settings, "fragment_ms", DEFAULT_FRAGMENT_MS);
 }
 
 /**
@@ -550,6 +611,15 @@ static void pulse_update(void *vptr, obs_data_t *settings)
 		restart = true;
 	}
 
+	uint_fast32_t fragment_ms =
+		(uint_fast32_t)obs_data_get_int(settings, "fragment_ms");
+	if (fragment_ms < MIN_FRAGMENT_MS)
+		fragment_ms = MIN_FRAGMENT_MS;
+	if (fragment_ms != data->fragment_ms) {
+		data->fragment_ms = fragment_ms;
+		restart = true;
+	}
+
 	if (!restart)
 		return;
 
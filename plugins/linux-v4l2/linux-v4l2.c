@@ -17,6 +17,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <obs-module.h>
 #include <util/platform.h>
 
+#if HAVE_UDEV
+#include "v4l2-udev.h"
+#endif
+
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("linux-v4l2", "en-US")
 MODULE_EXPORT const char *obs_module_description(void)
@@ -27,9 +31,15 @@ MODULE_EXPORT const char *obs_module_description(void)
 extern struct obs_source_info v4l2_input;
 extern struct obs_output_info virtualcam_info;
 extern bool loopback_module_available();
+extern void v4l2_free_device_cache(void);
 
 bool obs_module_load(void)
 {
+#if HAVE_UDEV
+	/* keep watching for hotplug events even while no source exists, so
+	 * that the cached device list never goes stale */
+	v4l2_init_udev();
+#endif
 	obs_register_source(&v4l2_input);
 
 	obs_data_t *obs_settings = obs_data_create();
@@ -48,3 +58,11 @@ bool obs_module_load(void)
 
 	return true;
 }
+
+void obs_module_unload(void)
+{
+#if HAVE_UDEV
+	v4l2_unref_udev();
+#endif
+	v4l2_free_device_cache();
+}
@@ -84,6 +84,37 @@ static inline enum video_format v4l2_to_obs_video_format(uint_fast32_t format)
 	}
 }
 
+/**
+ * Check if a v4l2 pixel format is compressed
+ *
+ * @param format v4l2 format id
+ *
+ * @return true for formats that have to be decoded
+ */
+static inline bool v4l2_is_compressed(uint_fast32_t format)
+{
+	return format == V4L2_PIX_FMT_MJPEG || format == V4L2_PIX_FMT_JPEG;
+}
+
+/**
+ * Check if a v4l2 pixel format can be captured
+ *
+ * Compressed formats are only supported if the plugin was built with the
+ * MJPEG decoder.
+ *
+ * @param format v4l2 format id
+ *
+ * @return true if the format is supported
+ */
+static inline bool v4l2_format_supported(uint_fast32_t format)
+{
+#ifdef HAVE_MJPEG
+	if (v4l2_is_compressed(format))
+		return true;
+#endif
+	return v4l2_to_obs_video_format(format) != VIDEO_FORMAT_NONE;
+}
+
 /**
  * Fixed framesizes for devices that don't support enumerating discrete values.
  *
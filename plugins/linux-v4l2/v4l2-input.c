@@ -32,6 +32,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <util/threading.h>
 #include <util/bmem.h>
 #include <util/dstr.h>
+#include <util/darray.h>
 #include <util/platform.h>
 #include <obs-module.h>
 
@@ -42,6 +43,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "v4l2-udev.h"
 #endif
 
+#ifdef HAVE_MJPEG
+#include "v4l2-mjpeg.h"
+#endif
+
 /* The new dv timing api was introduced in Linux 3.4
  * Currently we simply disable dv timings when this is not defined */
 #if !defined(VIDIOC_ENUM_DV_TIMINGS) || !defined(V4L2_IN_CAP_DV_TIMINGS)
@@ -91,6 +96,20 @@ struct v4l2_data {
 
 	bool auto_reset;
 	int timeout_frames;
+	bool hw_decode;
+
+#ifdef HAVE_MJPEG
+	/* compressed frames are handed to the decode thread, which owns the
+	 * buffer until it is decoded and queued again */
+	struct v4l2_mjpeg_decoder mjpeg;
+	pthread_t decode_thread;
+	pthread_mutex_t decode_mutex;
+	os_sem_t *decode_sem;
+	volatile bool decode_stop;
+	struct v4l2_buffer pending;
+	uint64_t pending_ts;
+	bool has_pending;
+#endif
 };
 
 /* forward declarations */
@@ -113,13 +132,19 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 				struct obs_source_frame *frame,
 				size_t *plane_offsets)
 {
+	enum video_range_type range = data->color_range;
+
 	memset(frame, 0, sizeof(struct obs_source_frame));
 	memset(plane_offsets, 0, sizeof(size_t) * MAX_AV_PLANES);
 
+	/* jpeg is full range unless the user says otherwise */
+	if (v4l2_is_compressed(data->pixfmt) && range == VIDEO_RANGE_DEFAULT)
+		range = VIDEO_RANGE_FULL;
+
 	frame->width = data->width;
 	frame->height = data->height;
 	frame->format = v4l2_to_obs_video_format(data->pixfmt);
-	video_format_get_parameters(VIDEO_CS_DEFAULT, data->color_range,
+	video_format_get_parameters(VIDEO_CS_DEFAULT, range,
 				    frame->color_matrix, frame->color_range_min,
 				    frame->color_range_max);
 
@@ -149,6 +174,120 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 	}
 }
 
+#ifdef HAVE_MJPEG
+/*
+ * Decode thread for compressed formats
+ *
+ * Frames are decoded straight from the mapped buffers, which are only queued
+ * again once they are decoded.
+ */
+static void *v4l2_decode_thread(void *vptr)
+{
+	V4L2_DATA(vptr);
+	struct v4l2_buffer buf;
+	struct obs_source_frame out;
+	size_t plane_offsets[MAX_AV_PLANES];
+	uint64_t timestamp;
+	uint8_t *start;
+	size_t length;
+
+	os_set_thread_name("v4l2: decode");
+	v4l2_prep_obs_frame(data, &out, plane_offsets);
+
+	while (os_sem_wait(data->decode_sem) == 0) {
+		if (os_atomic_load_bool(&data->decode_stop))
+			break;
+
+		pthread_mutex_lock(&data->decode_mutex);
+		if (!data->has_pending) {
+			pthread_mutex_unlock(&data->decode_mutex);
+			continue;
+		}
+		buf = data->pending;
+		timestamp = data->pending_ts;
+		data->has_pending = false;
+		pthread_mutex_unlock(&data->decode_mutex);
+
+		start = (uint8_t *)data->buffers.info[buf.index].start;
+		length = data->buffers.info[buf.index].length;
+
+		if (v4l2_mjpeg_decode(&data->mjpeg, start, buf.bytesused,
+				      length, &out)) {
+			out.timestamp = timestamp;
+			obs_source_output_video(data->source, &out);
+		} else {
+			blog(LOG_DEBUG, "%s: failed to decode frame #%d",
+			     data->device_id, buf.sequence);
+		}
+
+		/* fails harmlessly if the stream was reset in the meantime */
+		pthread_mutex_lock(&data->decode_mutex);
+		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0)
+			blog(LOG_ERROR, "%s: failed to enqueue buffer",
+			     data->device_id);
+		pthread_mutex_unlock(&data->decode_mutex);
+	}
+
+	return NULL;
+}
+
+/*
+ * Hand a dequeued buffer to the decode thread
+ *
+ * If the decoder can't keep up, the frame that is still waiting is dropped
+ * and its buffer queued again, so the device never runs out of buffers.
+ */
+static bool v4l2_queue_decode(struct v4l2_data *data, struct v4l2_buffer *buf,
+			      uint64_t timestamp)
+{
+	bool success = true;
+
+	pthread_mutex_lock(&data->decode_mutex);
+	if (data->has_pending) {
+		blog(LOG_DEBUG, "%s: dropping frame #%d", data->device_id,
+		     data->pending.sequence);
+		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &data->pending) < 0) {
+			blog(LOG_ERROR, "%s: failed to enqueue buffer",
+			     data->device_id);
+			success = false;
+		}
+	}
+	data->pending = *buf;
+	data->pending_ts = timestamp;
+	data->has_pending = true;
+	pthread_mutex_unlock(&data->decode_mutex);
+
+	os_sem_post(data->decode_sem);
+	return success;
+}
+
+static bool v4l2_start_decode(struct v4l2_data *data)
+{
+	data->has_pending = false;
+	os_atomic_set_bool(&data->decode_stop, false);
+
+	if (pthread_create(&data->decode_thread, NULL, v4l2_decode_thread,
+			   data) != 0) {
+		blog(LOG_ERROR, "%s: failed to create decode thread",
+		     data->device_id);
+		return false;
+	}
+
+	return true;
+}
+
+static void v4l2_stop_decode(struct v4l2_data *data)
+{
+	if (!data->decode_thread)
+		return;
+
+	os_atomic_set_bool(&data->decode_stop, true);
+	os_sem_post(data->decode_sem);
+	pthread_join(data->decode_thread, NULL);
+	data->decode_thread = 0;
+}
+#endif
+
 /*
  * Worker thread to get video data
  */
@@ -183,6 +322,11 @@ static void *v4l2_thread(void *vptr)
 	if (v4l2_start_capture(data->dev, &data->buffers) < 0)
 		goto exit;
 
+#ifdef HAVE_MJPEG
+	if (v4l2_is_compressed(data->pixfmt) && !v4l2_start_decode(data))
+		goto exit;
+#endif
+
 	blog(LOG_DEBUG, "%s: new capture started", data->device_id);
 
 	frames = 0;
@@ -219,6 +363,11 @@ static void *v4l2_thread(void *vptr)
 			}
 
 			if (data->auto_reset) {
+#ifdef HAVE_MJPEG
+				/* the reset queues all buffers again */
+				pthread_mutex_lock(&data->decode_mutex);
+				data->has_pending = false;
+#endif
 				if (v4l2_reset_capture(data->dev,
 						       &data->buffers) == 0)
 					blog(LOG_INFO,
@@ -227,6 +376,9 @@ static void *v4l2_thread(void *vptr)
 				else
 					blog(LOG_ERROR, "%s: failed to reset",
 					     data->device_id);
+#ifdef HAVE_MJPEG
+				pthread_mutex_unlock(&data->decode_mutex);
+#endif
 			}
 
 			continue;
@@ -256,6 +408,15 @@ static void *v4l2_thread(void *vptr)
 			first_ts = out.timestamp;
 		out.timestamp -= first_ts;
 
+#ifdef HAVE_MJPEG
+		if (v4l2_is_compressed(data->pixfmt)) {
+			if (!v4l2_queue_decode(data, &buf, out.timestamp))
+				break;
+			frames++;
+			continue;
+		}
+#endif
+
 		start = (uint8_t *)data->buffers.info[buf.index].start;
 		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
 			out.data[i] = start + plane_offsets[i];
@@ -274,6 +435,9 @@ static void *v4l2_thread(void *vptr)
 	     data->device_id, frames);
 
 exit:
+#ifdef HAVE_MJPEG
+	v4l2_stop_decode(data);
+#endif
 	v4l2_stop_capture(data->dev);
 	return NULL;
 }
@@ -296,6 +460,7 @@ static void v4l2_defaults(obs_data_t *settings)
 	obs_data_set_default_bool(settings, "buffering", true);
 	obs_data_set_default_bool(settings, "auto_reset", false);
 	obs_data_set_default_int(settings, "timeout_frames", 5);
+	obs_data_set_default_bool(settings, "hw_decode", false);
 }
 
 /**
@@ -322,17 +487,49 @@ static void v4l2_props_set_enabled(obs_properties_t *props,
 	}
 }
 
+struct v4l2_device_info {
+	char *name;
+	char *path;
+};
+
 /*
- * List available devices
+ * Opening every device node to query it is slow, so the device list is kept
+ * across property refreshes and only rebuilt after udev reported a change.
  */
-static void v4l2_device_list(obs_property_t *prop, obs_data_t *settings)
+static DARRAY(struct v4l2_device_info) device_cache;
+static pthread_mutex_t device_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool device_cache_valid = false;
+#if HAVE_UDEV
+static long device_cache_generation = 0;
+#endif
+
+static void v4l2_clear_device_cache(void)
+{
+	for (size_t i = 0; i < device_cache.num; i++) {
+		bfree(device_cache.array[i].name);
+		bfree(device_cache.array[i].path);
+	}
+	da_free(device_cache);
+	device_cache_valid = false;
+}
+
+void v4l2_free_device_cache(void)
+{
+	pthread_mutex_lock(&device_cache_mutex);
+	v4l2_clear_device_cache();
+	pthread_mutex_unlock(&device_cache_mutex);
+}
+
+/*
+ * Enumerate available devices into the device cache
+ */
+static void v4l2_enum_devices(void)
 {
 	DIR *dirp;
 	struct dirent *dp;
 	struct dstr device;
-	bool cur_device_found;
-	size_t cur_device_index;
-	const char *cur_device_name;
+
+	v4l2_clear_device_cache();
 
 #ifdef __FreeBSD__
 	dirp = opendir("/dev");
@@ -342,11 +539,6 @@ static void v4l2_device_list(obs_property_t *prop, obs_data_t *settings)
 	if (!dirp)
 		return;
 
-	cur_device_found = false;
-	cur_device_name = obs_data_get_string(settings, "device_id");
-
-	obs_property_list_clear(prop);
-
 	dstr_init_copy(&device, "/dev/");
 
 	while ((dp = readdir(dirp)) != NULL) {
@@ -397,27 +589,68 @@ static void v4l2_device_list(obs_property_t *prop, obs_data_t *settings)
 		char unique_device_name[68];
 		sprintf(unique_device_name, "%s (%s)", video_cap.card,
 			video_cap.bus_info);
-		obs_property_list_add_string(prop, unique_device_name,
-					     device.array);
+
+		struct v4l2_device_info *info = da_push_back_new(device_cache);
+		info->name = bstrdup(unique_device_name);
+		info->path = bstrdup(device.array);
 		blog(LOG_INFO, "Found device '%s' at %s", video_cap.card,
 		     device.array);
 
+		v4l2_close(fd);
+	}
+
+	closedir(dirp);
+	dstr_free(&device);
+
+#if HAVE_UDEV
+	device_cache_valid = true;
+#endif
+}
+
+/*
+ * List available devices
+ */
+static void v4l2_device_list(obs_property_t *prop, obs_data_t *settings)
+{
+	bool cur_device_found;
+	size_t cur_device_index;
+	const char *cur_device_name;
+
+	cur_device_found = false;
+	cur_device_name = obs_data_get_string(settings, "device_id");
+
+	obs_property_list_clear(prop);
+
+	pthread_mutex_lock(&device_cache_mutex);
+
+#if HAVE_UDEV
+	long generation = v4l2_get_udev_generation();
+	if (device_cache_generation != generation) {
+		device_cache_generation = generation;
+		device_cache_valid = false;
+	}
+#endif
+	if (!device_cache_valid)
+		v4l2_enum_devices();
+
+	for (size_t i = 0; i < device_cache.num; i++) {
+		struct v4l2_device_info *info = &device_cache.array[i];
+
+		obs_property_list_add_string(prop, info->name, info->path);
+
 		/* check if this is the currently used device */
-		if (cur_device_name && !strcmp(cur_device_name, device.array))
+		if (cur_device_name && !strcmp(cur_device_name, info->path))
 			cur_device_found = true;
-
-		v4l2_close(fd);
 	}
 
+	pthread_mutex_unlock(&device_cache_mutex);
+
 	/* add currently selected device if not present, but disable it ... */
 	if (!cur_device_found && cur_device_name && strlen(cur_device_name)) {
 		cur_device_index = obs_property_list_add_string(
 			prop, cur_device_name, cur_device_name);
 		obs_property_list_item_disable(prop, cur_device_index, true);
 	}
-
-	closedir(dirp);
-	dstr_free(&device);
 }
 
 /*
@@ -456,8 +689,7 @@ static void v4l2_format_list(int dev, obs_property_t *prop)
 		if (fmt.flags & V4L2_FMT_FLAG_EMULATED)
 			dstr_cat(&buffer, " (Emulated)");
 
-		if (v4l2_to_obs_video_format(fmt.pixelformat) !=
-		    VIDEO_FORMAT_NONE) {
+		if (v4l2_format_supported(fmt.pixelformat)) {
 			obs_property_list_add_int(prop, buffer.array,
 						  fmt.pixelformat);
 			blog(LOG_INFO, "Pixelformat: %s (available)",
@@ -862,6 +1094,11 @@ static obs_properties_t *v4l2_properties(void *vptr)
 			       obs_module_text("FramesUntilTimeout"), 2, 120,
 			       1);
 
+#ifdef HAVE_MJPEG
+	obs_properties_add_bool(props, "hw_decode",
+				obs_module_text("HardwareDecode"));
+#endif
+
 	// a group to contain the camera control
 	obs_properties_t *ctrl_props = obs_properties_create();
 	obs_properties_add_group(props, "controls",
@@ -890,6 +1127,9 @@ static void v4l2_terminate(struct v4l2_data *data)
 		data->thread = 0;
 	}
 
+#ifdef HAVE_MJPEG
+	v4l2_mjpeg_free(&data->mjpeg);
+#endif
 	v4l2_destroy_mmap(&data->buffers);
 
 	if (data->dev != -1) {
@@ -919,6 +1159,11 @@ static void v4l2_destroy(void *vptr)
 	v4l2_unref_udev();
 #endif
 
+#ifdef HAVE_MJPEG
+	os_sem_destroy(data->decode_sem);
+	pthread_mutex_destroy(&data->decode_mutex);
+#endif
+
 	bfree(data);
 }
 
@@ -928,6 +1173,7 @@ static void v4l2_destroy(void *vptr)
  * This function:
  * - tries to open the device
  * - sets pixelformat and requested resolution
+ * - creates the decoder for compressed formats
  * - sets the requested framerate
  * - maps the buffers
  * - starts the capture thread
@@ -980,10 +1226,17 @@ static void v4l2_init(struct v4l2_data *data)
 		blog(LOG_ERROR, "Unable to set format");
 		goto fail;
 	}
-	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE) {
+	if (!v4l2_format_supported(data->pixfmt)) {
 		blog(LOG_ERROR, "Selected video format not supported");
 		goto fail;
 	}
+#ifdef HAVE_MJPEG
+	if (v4l2_is_compressed(data->pixfmt) &&
+	    v4l2_mjpeg_init(&data->mjpeg, data->hw_decode) < 0) {
+		blog(LOG_ERROR, "Unable to initialize MJPEG decoder");
+		goto fail;
+	}
+#endif
 	v4l2_unpack_tuple(&data->width, &data->height, data->resolution);
 	blog(LOG_INFO, "Resolution: %dx%d", data->width, data->height);
 	blog(LOG_INFO, "Pixelformat: %s", V4L2_FOURCC_STR(data->pixfmt));
@@ -1071,6 +1324,8 @@ static bool v4l2_settings_changed(struct v4l2_data *data, obs_data_t *settings)
 
 		res |= data->color_range !=
 		       obs_data_get_int(settings, "color_range");
+		res |= data->hw_decode !=
+		       obs_data_get_bool(settings, "hw_decode");
 	} else {
 		res = true;
 	}
@@ -1108,6 +1363,7 @@ static void v4l2_update(void *vptr, obs_data_t *settings)
 	data->color_range = obs_data_get_int(settings, "color_range");
 	data->auto_reset = obs_data_get_bool(settings, "auto_reset");
 	data->timeout_frames = obs_data_get_int(settings, "timeout_frames");
+	data->hw_decode = obs_data_get_bool(settings, "hw_decode");
 
 	v4l2_update_source_flags(data, settings);
 
@@ -1123,6 +1379,11 @@ static void *v4l2_create(obs_data_t *settings, obs_source_t *source)
 	data->resolution_unchanged = false;
 	data->framerate_unchanged = false;
 
+#ifdef HAVE_MJPEG
+	pthread_mutex_init(&data->decode_mutex, NULL);
+	os_sem_init(&data->decode_sem, 0);
+#endif
+
 	/* Bitch about build problems ... */
 #ifndef V4L2_CAP_DEVICE_CAPS
 	blog(LOG_WARNING, "Plugin built without device caps support!");
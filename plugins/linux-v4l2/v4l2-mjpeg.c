@@ -0,0 +1,171 @@
+#include <util/bmem.h>
+
+#include <libavutil/hwcontext.h>
+
+#include "v4l2-mjpeg.h"
+
+#define blog(level, msg, ...) blog(level, "v4l2-mjpeg: " msg, ##__VA_ARGS__)
+
+static bool has_vaapi(const AVCodec *codec)
+{
+	for (int i = 0;; i++) {
+		const AVCodecHWConfig *config = avcodec_get_hw_config(codec, i);
+		if (!config)
+			break;
+
+		if (config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX &&
+		    config->device_type == AV_HWDEVICE_TYPE_VAAPI)
+			return true;
+	}
+
+	return false;
+}
+
+static void init_hw_decoder(struct v4l2_mjpeg_decoder *decoder,
+			    const AVCodec *codec)
+{
+	AVBufferRef *hw_ctx = NULL;
+
+	if (!has_vaapi(codec)) {
+		blog(LOG_INFO, "decoder does not support VAAPI");
+		return;
+	}
+
+	if (av_hwdevice_ctx_create(&hw_ctx, AV_HWDEVICE_TYPE_VAAPI, NULL, NULL,
+				   0) < 0) {
+		blog(LOG_INFO, "unable to open VAAPI device");
+		return;
+	}
+
+	decoder->context->hw_device_ctx = hw_ctx;
+	decoder->hw = true;
+}
+
+int v4l2_mjpeg_init(struct v4l2_mjpeg_decoder *decoder, bool use_hw)
+{
+	const AVCodec *codec;
+	int ret;
+
+	memset(decoder, 0, sizeof(*decoder));
+
+	codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
+	if (!codec) {
+		blog(LOG_ERROR, "failed to find MJPEG decoder");
+		return -1;
+	}
+
+	decoder->context = avcodec_alloc_context3(codec);
+	if (!decoder->context)
+		return -1;
+
+	/* frames are independent, so slice threads don't add latency */
+	decoder->context->thread_count = 0;
+	decoder->context->thread_type = FF_THREAD_SLICE;
+
+	if (use_hw)
+		init_hw_decoder(decoder, codec);
+
+	ret = avcodec_open2(decoder->context, codec, NULL);
+	if (ret < 0) {
+		blog(LOG_ERROR, "failed to open MJPEG decoder");
+		v4l2_mjpeg_free(decoder);
+		return ret;
+	}
+
+	decoder->frame = av_frame_alloc();
+	if (decoder->hw)
+		decoder->hw_frame = av_frame_alloc();
+	if (!decoder->frame || (decoder->hw && !decoder->hw_frame)) {
+		v4l2_mjpeg_free(decoder);
+		return -1;
+	}
+
+	blog(LOG_INFO, "initialized %s MJPEG decoder",
+	     decoder->hw ? "VAAPI" : "software");
+	return 0;
+}
+
+void v4l2_mjpeg_free(struct v4l2_mjpeg_decoder *decoder)
+{
+	av_frame_free(&decoder->hw_frame);
+	av_frame_free(&decoder->frame);
+	avcodec_free_context(&decoder->context);
+	bfree(decoder->packet_buffer);
+
+	memset(decoder, 0, sizeof(*decoder));
+}
+
+static inline enum video_format convert_pixel_format(int f)
+{
+	switch (f) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:
+		return VIDEO_FORMAT_I420;
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUVJ422P:
+		return VIDEO_FORMAT_I422;
+	case AV_PIX_FMT_YUV444P:
+	case AV_PIX_FMT_YUVJ444P:
+		return VIDEO_FORMAT_I444;
+	case AV_PIX_FMT_NV12:
+		return VIDEO_FORMAT_NV12;
+	case AV_PIX_FMT_YUYV422:
+		return VIDEO_FORMAT_YUY2;
+	case AV_PIX_FMT_UYVY422:
+		return VIDEO_FORMAT_UYVY;
+	default:
+		return VIDEO_FORMAT_NONE;
+	}
+}
+
+static uint8_t *padded_data(struct v4l2_mjpeg_decoder *decoder,
+			    uint8_t *data, size_t size, size_t length)
+{
+	if (size + AV_INPUT_BUFFER_PADDING_SIZE <= length) {
+		memset(data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+		return data;
+	}
+
+	if (decoder->packet_size < size + AV_INPUT_BUFFER_PADDING_SIZE) {
+		decoder->packet_size = size + AV_INPUT_BUFFER_PADDING_SIZE;
+		decoder->packet_buffer =
+			brealloc(decoder->packet_buffer, decoder->packet_size);
+	}
+
+	memcpy(decoder->packet_buffer, data, size);
+	memset(decoder->packet_buffer + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+	return decoder->packet_buffer;
+}
+
+bool v4l2_mjpeg_decode(struct v4l2_mjpeg_decoder *decoder, uint8_t *data,
+		       size_t size, size_t length,
+		       struct obs_source_frame *frame)
+{
+	AVFrame *out = decoder->hw ? decoder->hw_frame : decoder->frame;
+	AVPacket packet = {0};
+	int ret;
+
+	av_init_packet(&packet);
+	packet.data = padded_data(decoder, data, size, length);
+	packet.size = (int)size;
+
+	ret = avcodec_send_packet(decoder->context, &packet);
+	if (ret == 0)
+		ret = avcodec_receive_frame(decoder->context, out);
+	if (ret < 0)
+		return false;
+
+	if (decoder->hw) {
+		av_frame_unref(decoder->frame);
+		if (av_hwframe_transfer_data(decoder->frame, out, 0) < 0)
+			return false;
+	}
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame->data[i] = decoder->frame->data[i];
+		frame->linesize[i] = decoder->frame->linesize[i];
+	}
+
+	frame->format = convert_pixel_format(decoder->frame->format);
+	return frame->format != VIDEO_FORMAT_NONE;
+}
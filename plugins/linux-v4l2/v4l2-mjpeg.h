@@ -0,0 +1,66 @@
+#pragma once
+
+#include <obs-module.h>
+
+#include <libavcodec/avcodec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Data structure for the MJPEG decoder
+ */
+struct v4l2_mjpeg_decoder {
+	AVCodecContext *context;
+	AVFrame *frame;
+	AVFrame *hw_frame;
+	bool hw;
+
+	/** padded copy of a buffer that has no room for the padding */
+	uint8_t *packet_buffer;
+	size_t packet_size;
+};
+
+/**
+ * Initialize the MJPEG decoder
+ *
+ * @param decoder the decoder to initialize
+ * @param use_hw try to decode with VAAPI before falling back to software
+ *
+ * @return negative on failure
+ */
+int v4l2_mjpeg_init(struct v4l2_mjpeg_decoder *decoder, bool use_hw);
+
+/**
+ * Free the MJPEG decoder
+ *
+ * @param decoder the decoder to free
+ */
+void v4l2_mjpeg_free(struct v4l2_mjpeg_decoder *decoder);
+
+/**
+ * Decode a compressed frame
+ *
+ * The data is decoded in place if the buffer has room for the padding
+ * libavcodec reads past the end of the data, so buffers that are mapped from
+ * the device aren't copied.
+ *
+ * The plane pointers of the output frame refer to the decoder and stay valid
+ * until the next call.
+ *
+ * @param decoder the decoder
+ * @param data compressed data
+ * @param size size of the compressed data
+ * @param length size of the buffer that holds the data
+ * @param frame frame to fill, only the planes, linesizes and format are set
+ *
+ * @return false if the frame could not be decoded
+ */
+bool v4l2_mjpeg_decode(struct v4l2_mjpeg_decoder *decoder, uint8_t *data,
+		       size_t size, size_t length,
+		       struct obs_source_frame *frame);
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,15 +2,33 @@
 #include <util/platform.h>
 #include <linux/videodev2.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 
 #define MAX_DEVICES 64
+#define MAX_BUFFERS 4
+
+struct mmap_buffer {
+	void *data;
+	size_t length;
+};
 
 struct virtualcam_data {
 	obs_output_t *output;
 	int device;
 	uint32_t frame_size;
+
+	/* frames are written into buffers mapped from the loopback device
+	 * when it supports streaming, and passed through write() otherwise */
+	struct mmap_buffer buffers[MAX_BUFFERS];
+	uint32_t num_buffers;
+	uint32_t next_buffer;
+	bool streaming;
+
+	enum video_format format;
+	uint32_t width;
+	uint32_t height;
 };
 
 static const char *virtualcam_name(void *unused)
@@ -80,6 +98,132 @@ static void *virtualcam_create(obs_data_t *settings, obs_output_t *output)
 	return vcam;
 }
 
+static void unmap_buffers(struct virtualcam_data *vcam)
+{
+	for (uint32_t i = 0; i < vcam->num_buffers; i++)
+		munmap(vcam->buffers[i].data, vcam->buffers[i].length);
+	vcam->num_buffers = 0;
+	vcam->next_buffer = 0;
+}
+
+static bool map_buffers(struct virtualcam_data *vcam)
+{
+	struct v4l2_requestbuffers req = {0};
+
+	req.count = MAX_BUFFERS;
+	req.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	req.memory = V4L2_MEMORY_MMAP;
+
+	if (ioctl(vcam->device, VIDIOC_REQBUFS, &req) < 0 || req.count < 2)
+		return false;
+	if (req.count > MAX_BUFFERS)
+		req.count = MAX_BUFFERS;
+
+	for (uint32_t i = 0; i < req.count; i++) {
+		struct v4l2_buffer buf = {0};
+		void *data;
+
+		buf.index = i;
+		buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+		buf.memory = V4L2_MEMORY_MMAP;
+
+		if (ioctl(vcam->device, VIDIOC_QUERYBUF, &buf) < 0 ||
+		    buf.length < vcam->frame_size)
+			goto fail;
+
+		data = mmap(NULL, buf.length, PROT_READ | PROT_WRITE,
+			    MAP_SHARED, vcam->device, buf.m.offset);
+		if (data == MAP_FAILED)
+			goto fail;
+
+		vcam->buffers[i].data = data;
+		vcam->buffers[i].length = buf.length;
+		vcam->num_buffers++;
+	}
+
+	return true;
+
+fail:
+	unmap_buffers(vcam);
+	return false;
+}
+
+static bool start_streaming(struct virtualcam_data *vcam)
+{
+	int type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+
+	if (!map_buffers(vcam))
+		return false;
+
+	if (ioctl(vcam->device, VIDIOC_STREAMON, &type) < 0) {
+		unmap_buffers(vcam);
+		return false;
+	}
+
+	return true;
+}
+
+static void stop_streaming(struct virtualcam_data *vcam)
+{
+	int type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+
+	if (!vcam->streaming)
+		return;
+
+	ioctl(vcam->device, VIDIOC_STREAMOFF, &type);
+	unmap_buffers(vcam);
+	vcam->streaming = false;
+}
+
+static bool set_format(struct virtualcam_data *vcam,
+		       struct v4l2_format *format, enum video_format video_fmt)
+{
+	uint32_t width = vcam->width;
+	uint32_t height = vcam->height;
+
+	format->fmt.pix.width = width;
+	format->fmt.pix.height = height;
+
+	if (video_fmt == VIDEO_FORMAT_NV12) {
+		vcam->frame_size = width * height * 3 / 2;
+		format->fmt.pix.pixelformat = V4L2_PIX_FMT_NV12;
+		format->fmt.pix.bytesperline = width;
+	} else {
+		vcam->frame_size = width * height * 2;
+		format->fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
+		format->fmt.pix.bytesperline = width * 2;
+	}
+	format->fmt.pix.sizeimage = vcam->frame_size;
+
+	if (ioctl(vcam->device, VIDIOC_S_FMT, format) < 0)
+		return false;
+
+	vcam->format = video_fmt;
+	return true;
+}
+
+/* NV12 is only used when the GPU already converts the output to it and
+ * frames can be written into mapped buffers plane by plane, otherwise
+ * YUYV is written in one piece as before */
+static bool init_frames(struct virtualcam_data *vcam,
+			struct v4l2_format *format,
+			const struct obs_video_info *ovi)
+{
+	if (ovi->output_format == VIDEO_FORMAT_NV12 &&
+	    (vcam->width & 1) == 0 && (vcam->height & 1) == 0 &&
+	    set_format(vcam, format, VIDEO_FORMAT_NV12)) {
+		vcam->streaming = start_streaming(vcam);
+		if (vcam->streaming)
+			return true;
+	}
+
+	if (!set_format(vcam, format, VIDEO_FORMAT_YUY2))
+		return false;
+
+	vcam->streaming = start_streaming(vcam);
+	return true;
+}
+
 static bool try_connect(void *data, int device)
 {
 	struct virtualcam_data *vcam = (struct virtualcam_data *)data;
@@ -90,7 +234,8 @@ static bool try_connect(void *data, int device)
 	uint32_t width = obs_output_get_width(vcam->output);
 	uint32_t height = obs_output_get_height(vcam->output);
 
-	vcam->frame_size = width * height * 2;
+	vcam->width = width;
+	vcam->height = height;
 
 	char new_device[16];
 	if (device < 0 || device >= MAX_DEVICES)
@@ -123,21 +268,18 @@ static bool try_connect(void *data, int device)
 	if (ioctl(vcam->device, VIDIOC_S_PARM, &parm) < 0)
 		return false;
 
-	format.fmt.pix.width = width;
-	format.fmt.pix.height = height;
-	format.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
-	format.fmt.pix.sizeimage = vcam->frame_size;
-
-	if (ioctl(vcam->device, VIDIOC_S_FMT, &format) < 0)
+	if (!init_frames(vcam, &format, &ovi))
 		return false;
 
 	struct video_scale_info vsi = {0};
-	vsi.format = VIDEO_FORMAT_YUY2;
+	vsi.format = vcam->format;
 	vsi.width = width;
 	vsi.height = height;
 	obs_output_set_video_conversion(vcam->output, &vsi);
 
-	blog(LOG_INFO, "Virtual camera started");
+	blog(LOG_INFO, "Virtual camera started (%s, %s)",
+	     get_video_format_name(vcam->format),
+	     vcam->streaming ? "mmap" : "write");
 	obs_output_begin_data_capture(vcam->output, 0);
 
 	return true;
@@ -167,6 +309,7 @@ static void virtualcam_stop(void *data, uint64_t ts)
 {
 	struct virtualcam_data *vcam = (struct virtualcam_data *)data;
 	obs_output_end_data_capture(vcam->output);
+	stop_streaming(vcam);
 	close(vcam->device);
 
 	blog(LOG_INFO, "Virtual camera stopped");
@@ -174,10 +317,65 @@ static void virtualcam_stop(void *data, uint64_t ts)
 	UNUSED_PARAMETER(ts);
 }
 
+static void copy_plane(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src,
+		       uint32_t src_linesize, uint32_t rows)
+{
+	if (dst_linesize == src_linesize) {
+		memcpy(dst, src, (size_t)dst_linesize * rows);
+		return;
+	}
+
+	for (uint32_t y = 0; y < rows; y++) {
+		memcpy(dst, src, dst_linesize);
+		dst += dst_linesize;
+		src += src_linesize;
+	}
+}
+
+static void queue_frame(struct virtualcam_data *vcam, struct video_data *frame)
+{
+	struct v4l2_buffer buf = {0};
+	uint8_t *dst;
+
+	buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	buf.memory = V4L2_MEMORY_MMAP;
+
+	/* every buffer is queued once before they are taken back in turn */
+	if (vcam->next_buffer < vcam->num_buffers) {
+		buf.index = vcam->next_buffer++;
+	} else if (ioctl(vcam->device, VIDIOC_DQBUF, &buf) < 0) {
+		return;
+	}
+
+	dst = vcam->buffers[buf.index].data;
+
+	if (vcam->format == VIDEO_FORMAT_NV12) {
+		copy_plane(dst, vcam->width, frame->data[0], frame->linesize[0],
+			   vcam->height);
+		copy_plane(dst + vcam->width * vcam->height, vcam->width,
+			   frame->data[1], frame->linesize[1],
+			   vcam->height / 2);
+	} else {
+		copy_plane(dst, vcam->width * 2, frame->data[0],
+			   frame->linesize[0], vcam->height);
+	}
+
+	buf.bytesused = vcam->frame_size;
+	buf.timestamp.tv_sec = frame->timestamp / 1000000000;
+	buf.timestamp.tv_usec = frame->timestamp % 1000000000 / 1000;
+
+	ioctl(vcam->device, VIDIOC_QBUF, &buf);
+}
+
 static void virtual_video(void *param, struct video_data *frame)
 {
 	struct virtualcam_data *vcam = (struct virtualcam_data *)param;
 	uint32_t frame_size = vcam->frame_size;
+
+	if (vcam->streaming) {
+		queue_frame(vcam, frame);
+		return;
+	}
 	while (frame_size > 0) {
 		ssize_t written =
 			write(vcam->device, frame->data[0], vcam->frame_size);
@@ -42,6 +42,7 @@ static pthread_t udev_thread;
 static os_event_t *udev_event;
 
 static signal_handler_t *udev_signalhandler = NULL;
+static volatile long udev_generation = 0;
 
 /**
  * udev gives us the device action as string, so we convert it here ...
@@ -82,6 +83,9 @@ static inline void udev_signal_event(struct udev_device *dev)
 
 	calldata_set_string(&data, "device", node);
 
+	if (action != UDEV_ACTION_UNKNOWN)
+		os_atomic_inc_long(&udev_generation);
+
 	switch (action) {
 	case UDEV_ACTION_ADDED:
 		signal_handler_signal(udev_signalhandler, "device_added",
@@ -194,3 +198,8 @@ signal_handler_t *v4l2_get_udev_signalhandler(void)
 {
 	return udev_signalhandler;
 }
+
+long v4l2_get_udev_generation(void)
+{
+	return os_atomic_load_long(&udev_generation);
+}
@@ -42,6 +42,13 @@ void v4l2_unref_udev(void);
  */
 signal_handler_t *v4l2_get_udev_signalhandler(void);
 
+/**
+ * Get the number of device events seen so far
+ *
+ * @return a counter that changes whenever a device was added or removed
+ */
+long v4l2_get_udev_generation(void);
+
 #ifdef __cplusplus
 }
 #endif
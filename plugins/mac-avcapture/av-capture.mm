@@ -15,6 +15,7 @@
 #include <cinttypes>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "left-right.hpp"
@@ -37,6 +38,7 @@ template<> struct default_delete<obs_data_item_t> {
 }
 
 #define TEXT_AVCAPTURE obs_module_text("AVCapture")
+#define TEXT_AVCAPTURE_SURFACE obs_module_text("AVCapture.Surface")
 #define TEXT_DEVICE obs_module_text("Device")
 #define TEXT_USE_PRESET obs_module_text("UsePreset")
 #define TEXT_PRESET obs_module_text("Preset")
@@ -143,6 +145,15 @@ struct av_capture {
 	obs_source_t *source;
 
 	obs_source_frame frame;
+
+	/* frames stay in their IOSurface and are drawn from it directly,
+	 * the newest pixel buffer is kept until the next tick and the one
+	 * bound to the texture until it is replaced */
+	bool surface_output = false;
+	mutex surface_mutex;
+	CVPixelBufferRef pending_buffer = nullptr;
+	CVPixelBufferRef shown_buffer = nullptr;
+	gs_texture_t *tex = nullptr;
 };
 
 static NSString *get_string(obs_data_t *data, char const *name)
@@ -593,6 +604,26 @@ static inline bool update_frame(av_capture *capture, obs_source_frame *frame,
 	return true;
 }
 
+static void output_surface(av_capture *capture,
+			   CMSampleBufferRef sample_buffer)
+{
+	CVImageBufferRef img = CMSampleBufferGetImageBuffer(sample_buffer);
+	if (!img || !CVPixelBufferGetIOSurface(img))
+		return;
+
+	CVPixelBufferRetain(img);
+
+	CVPixelBufferRef prev;
+	{
+		lock_guard<mutex> lock(capture->surface_mutex);
+		prev = capture->pending_buffer;
+		capture->pending_buffer = img;
+	}
+
+	/* replaced before it was shown */
+	CVPixelBufferRelease(prev);
+}
+
 @implementation OBSAVCaptureDelegate
 - (void)captureOutput:(AVCaptureOutput *)out
 	didDropSampleBuffer:(CMSampleBufferRef)sampleBuffer
@@ -614,6 +645,11 @@ static inline bool update_frame(av_capture *capture, obs_source_frame *frame,
 	if (count < 1 || !capture)
 		return;
 
+	if (capture->surface_output) {
+		output_surface(capture, sampleBuffer);
+		return;
+	}
+
 	obs_source_frame *frame = &capture->frame;
 
 	CMTime target_pts =
@@ -661,12 +697,34 @@ static void start_capture(av_capture *capture)
 		[capture->session startRunning];
 }
 
+static void release_surfaces(av_capture *capture)
+{
+	CVPixelBufferRef pending;
+	{
+		lock_guard<mutex> lock(capture->surface_mutex);
+		pending = capture->pending_buffer;
+		capture->pending_buffer = nullptr;
+	}
+	CVPixelBufferRelease(pending);
+
+	obs_enter_graphics();
+	gs_texture_destroy(capture->tex);
+	obs_leave_graphics();
+	capture->tex = nullptr;
+
+	CVPixelBufferRelease(capture->shown_buffer);
+	capture->shown_buffer = nullptr;
+}
+
 static void clear_capture(av_capture *capture)
 {
 	if (capture->session && capture->session.running)
 		[capture->session stopRunning];
 
-	obs_source_output_video(capture->source, nullptr);
+	if (capture->surface_output)
+		release_surfaces(capture);
+	else
+		obs_source_output_video(capture->source, nullptr);
 }
 
 static void remove_device(av_capture *capture)
@@ -685,6 +743,9 @@ static void av_capture_destroy(void *data)
 {
 	auto capture = static_cast<av_capture *>(data);
 
+	if (capture->surface_output)
+		clear_capture(capture);
+
 	delete capture;
 }
 
@@ -771,6 +832,17 @@ static bool init_format(av_capture *capture, AVCaptureDevice *dev)
 		return false;
 	}
 
+	/* only BGRA surfaces can be bound as textures */
+	if (capture->surface_output) {
+		capture->out.videoSettings = @{
+			(__bridge NSString *)kCVPixelBufferPixelFormatTypeKey:
+				@(kCVPixelFormatType_32BGRA),
+			(__bridge NSString *)
+			kCVPixelBufferIOSurfacePropertiesKey: @{},
+		};
+		return true;
+	}
+
 	capture->out.videoSettings = nil;
 	FourCharCode subtype = uint_from_dict(capture->out.videoSettings,
 					      kCVPixelBufferPixelFormatTypeKey);
@@ -1204,7 +1276,9 @@ static bool av_capture_init(av_capture *capture, obs_data_t *settings)
 	return true;
 }
 
-static void *av_capture_create(obs_data_t *settings, obs_source_t *source)
+static void *av_capture_create_internal(obs_data_t *settings,
+					obs_source_t *source,
+					bool surface_output)
 {
 	unique_ptr<av_capture> capture;
 
@@ -1215,6 +1289,7 @@ static void *av_capture_create(obs_data_t *settings, obs_source_t *source)
 	}
 
 	capture->source = source;
+	capture->surface_output = surface_output;
 
 	if (!av_capture_init(capture.get(), settings)) {
 		AVLOG(LOG_ERROR, "av_capture_init failed");
@@ -1227,6 +1302,86 @@ static void *av_capture_create(obs_data_t *settings, obs_source_t *source)
 	return capture.release();
 }
 
+static void *av_capture_create(obs_data_t *settings, obs_source_t *source)
+{
+	return av_capture_create_internal(settings, source, false);
+}
+
+static void *av_capture_surface_create(obs_data_t *settings,
+				       obs_source_t *source)
+{
+	return av_capture_create_internal(settings, source, true);
+}
+
+static const char *av_capture_surface_getname(void *)
+{
+	return TEXT_AVCAPTURE_SURFACE;
+}
+
+static void av_capture_surface_tick(void *data, float)
+{
+	auto capture = static_cast<av_capture *>(data);
+	CVPixelBufferRef buffer;
+
+	{
+		lock_guard<mutex> lock(capture->surface_mutex);
+		buffer = capture->pending_buffer;
+		capture->pending_buffer = nullptr;
+	}
+
+	if (!buffer)
+		return;
+
+	IOSurfaceRef surface = CVPixelBufferGetIOSurface(buffer);
+
+	obs_enter_graphics();
+	if (!gs_texture_rebind_iosurface(capture->tex, surface)) {
+		gs_texture_destroy(capture->tex);
+		capture->tex = gs_texture_create_from_iosurface(surface);
+	}
+	obs_leave_graphics();
+
+	CVPixelBufferRelease(capture->shown_buffer);
+	capture->shown_buffer = buffer;
+}
+
+static void av_capture_surface_render(void *data, gs_effect_t *)
+{
+	auto capture = static_cast<av_capture *>(data);
+
+	if (!capture->tex)
+		return;
+
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT_RECT);
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+
+	const bool linear_srgb = gs_get_linear_srgb();
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(linear_srgb);
+
+	if (linear_srgb)
+		gs_effect_set_texture_srgb(image, capture->tex);
+	else
+		gs_effect_set_texture(image, capture->tex);
+
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(capture->tex, 0, 0, 0);
+
+	gs_enable_framebuffer_srgb(previous);
+}
+
+static uint32_t av_capture_surface_width(void *data)
+{
+	auto capture = static_cast<av_capture *>(data);
+	return capture->tex ? gs_texture_get_width(capture->tex) : 0;
+}
+
+static uint32_t av_capture_surface_height(void *data)
+{
+	auto capture = static_cast<av_capture *>(data);
+	return capture->tex ? gs_texture_get_height(capture->tex) : 0;
+}
+
 static NSArray *presets(void)
 {
 	if (@available(macOS 10.15, *)) {
@@ -2236,5 +2391,19 @@ bool obs_module_load(void)
 	};
 
 	obs_register_source(&av_capture_info);
+
+	obs_source_info av_capture_surface_info = av_capture_info;
+	av_capture_surface_info.id = "av_capture_surface_input";
+	av_capture_surface_info.output_flags = OBS_SOURCE_VIDEO |
+					       OBS_SOURCE_CUSTOM_DRAW |
+					       OBS_SOURCE_DO_NOT_DUPLICATE;
+	av_capture_surface_info.get_name = av_capture_surface_getname;
+	av_capture_surface_info.create = av_capture_surface_create;
+	av_capture_surface_info.video_tick = av_capture_surface_tick;
+	av_capture_surface_info.video_render = av_capture_surface_render;
+	av_capture_surface_info.get_width = av_capture_surface_width;
+	av_capture_surface_info.get_height = av_capture_surface_height;
+
+	obs_register_source(&av_capture_surface_info);
 	return true;
 }
@@ -200,11 +200,18 @@ static bool init_display_stream(struct display_capture *dc)
 	CFBooleanRef show_cursor_cf = dc->hide_cursor ? kCFBooleanFalse
 						      : kCFBooleanTrue;
 
+	/* frames faster than the output are never shown */
+	struct obs_video_info ovi;
+	obs_get_video_info(&ovi);
+	NSNumber *frame_time = @((double)ovi.fps_den / (double)ovi.fps_num);
+
 	NSDictionary *dict = @{
 		(__bridge NSString *)kCGDisplayStreamSourceRect: rect_dict,
 		(__bridge NSString *)kCGDisplayStreamQueueDepth: @5,
 		(__bridge NSString *)
 		kCGDisplayStreamShowCursor: (id)show_cursor_cf,
+		(__bridge NSString *)
+		kCGDisplayStreamMinimumFrameTime: frame_time,
 	};
 
 	os_event_init(&dc->disp_finished, OS_EVENT_TYPE_MANUAL);
@@ -377,10 +384,10 @@ static void display_capture_video_tick(void *data, float seconds)
 	build_sprite_rect(gs_vertexbuffer_get_data(dc->vertbuf), origin.x,
 			  origin.y, end.x, end.y);
 
-	if (dc->tex)
-		gs_texture_rebind_iosurface(dc->tex, dc->prev);
-	else
+	if (!gs_texture_rebind_iosurface(dc->tex, dc->prev)) {
+		gs_texture_destroy(dc->tex);
 		dc->tex = gs_texture_create_from_iosurface(dc->prev);
+	}
 	obs_leave_graphics();
 
 cleanup:
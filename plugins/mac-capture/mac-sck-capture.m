@@ -0,0 +1,535 @@
+#include <obs-module.h>
+#include <util/threading.h>
+#include <pthread.h>
+
+#import <Cocoa/Cocoa.h>
+#import <ScreenCaptureKit/ScreenCaptureKit.h>
+#import <CoreMedia/CMSampleBuffer.h>
+#import <CoreVideo/CVPixelBuffer.h>
+
+#include "window-utils.h"
+
+/*
+ * Display and window capture through ScreenCaptureKit.
+ *
+ * The capture delivers IOSurface backed frames at no more than the output
+ * frame rate.  The newest surface is kept until the next tick, which rebinds
+ * the texture to it, so frames never pass through CPU memory and frames
+ * replaced before a tick are skipped.
+ */
+
+#define SCK_API API_AVAILABLE(macos(12.5))
+
+/* one surface bound to the texture, one waiting for the next tick and two
+ * for the capture to render into */
+#define SCK_QUEUE_DEPTH 4
+
+enum sck_capture_type {
+	SCK_CAPTURE_DISPLAY,
+	SCK_CAPTURE_WINDOW,
+};
+
+struct screen_capture;
+
+SCK_API @interface ScreenCaptureDelegate : NSObject <SCStreamOutput>
+@property struct screen_capture *sc;
+@end
+
+struct screen_capture {
+	obs_source_t *source;
+
+	gs_effect_t *effect;
+	gs_texture_t *tex;
+
+	enum sck_capture_type type;
+	unsigned display;
+	struct cocoa_window window;
+	bool show_cursor;
+
+	SCStream *disp SCK_API;
+	SCStreamConfiguration *config SCK_API;
+	ScreenCaptureDelegate *delegate SCK_API;
+
+	IOSurfaceRef current, prev;
+	pthread_mutex_t mutex;
+};
+
+static inline void release_surface(IOSurfaceRef surface)
+{
+	if (surface) {
+		IOSurfaceDecrementUseCount(surface);
+		CFRelease(surface);
+	}
+}
+
+SCK_API static void resize_to_content(struct screen_capture *sc,
+				      NSDictionary *info)
+{
+	CGRect rect;
+	if (!CGRectMakeWithDictionaryRepresentation(
+		    (CFDictionaryRef)info[SCStreamFrameInfoContentRect], &rect))
+		return;
+
+	CGFloat content_scale =
+		[info[SCStreamFrameInfoContentScale] doubleValue];
+	CGFloat scale = [info[SCStreamFrameInfoScaleFactor] doubleValue];
+	if (content_scale <= 0.0 || scale <= 0.0)
+		return;
+
+	size_t width = (size_t)(rect.size.width / content_scale * scale);
+	size_t height = (size_t)(rect.size.height / content_scale * scale);
+	if (!width || !height)
+		return;
+	if (width == sc->config.width && height == sc->config.height)
+		return;
+
+	sc->config.width = width;
+	sc->config.height = height;
+	[sc->disp updateConfiguration:sc->config
+		    completionHandler:^(NSError *error) {
+			    if (error)
+				    blog(LOG_WARNING,
+					 "[screen-capture] Failed to resize: "
+					 "%s",
+					 error.localizedDescription
+						 .UTF8String);
+		    }];
+}
+
+@implementation ScreenCaptureDelegate
+
+- (void)stream:(SCStream *)stream
+	didOutputSampleBuffer:(CMSampleBufferRef)sample_buffer
+		       ofType:(SCStreamOutputType)type
+{
+	UNUSED_PARAMETER(stream);
+
+	if (type != SCStreamOutputTypeScreen || !sample_buffer ||
+	    !CMSampleBufferIsValid(sample_buffer))
+		return;
+
+	CFArrayRef attachments =
+		CMSampleBufferGetSampleAttachmentsArray(sample_buffer, false);
+	if (!attachments || !CFArrayGetCount(attachments))
+		return;
+
+	NSDictionary *info =
+		(NSDictionary *)CFArrayGetValueAtIndex(attachments, 0);
+	SCFrameStatus status =
+		(SCFrameStatus)[info[SCStreamFrameInfoStatus] integerValue];
+
+	/* idle frames repeat the previous content */
+	if (status != SCFrameStatusComplete)
+		return;
+
+	CVPixelBufferRef pixel_buffer =
+		CMSampleBufferGetImageBuffer(sample_buffer);
+	IOSurfaceRef surface =
+		pixel_buffer ? CVPixelBufferGetIOSurface(pixel_buffer) : NULL;
+	if (!surface)
+		return;
+
+	struct screen_capture *sc = self.sc;
+	IOSurfaceRef prev_current;
+
+	CFRetain(surface);
+	IOSurfaceIncrementUseCount(surface);
+
+	pthread_mutex_lock(&sc->mutex);
+	prev_current = sc->current;
+	sc->current = surface;
+	pthread_mutex_unlock(&sc->mutex);
+
+	release_surface(prev_current);
+
+	if (sc->type == SCK_CAPTURE_WINDOW)
+		resize_to_content(sc, info);
+}
+
+@end
+
+SCK_API static SCShareableContent *get_shareable_content(void)
+{
+	__block SCShareableContent *content = nil;
+	os_event_t *done;
+
+	if (os_event_init(&done, OS_EVENT_TYPE_MANUAL) != 0)
+		return nil;
+
+	[SCShareableContent getShareableContentWithCompletionHandler:^(
+				    SCShareableContent *result,
+				    NSError *error) {
+		if (error)
+			blog(LOG_WARNING,
+			     "[screen-capture] Failed to get shareable "
+			     "content: %s",
+			     error.localizedDescription.UTF8String);
+		content = [result retain];
+		os_event_signal(done);
+	}];
+
+	os_event_wait(done);
+	os_event_destroy(done);
+	return [content autorelease];
+}
+
+SCK_API static SCDisplay *find_display(SCShareableContent *content,
+				       CGDirectDisplayID id)
+{
+	for (SCDisplay *display in content.displays) {
+		if (display.displayID == id)
+			return display;
+	}
+	return nil;
+}
+
+SCK_API static SCWindow *find_sc_window(SCShareableContent *content,
+					CGWindowID id)
+{
+	for (SCWindow *window in content.windows) {
+		if (window.windowID == id)
+			return window;
+	}
+	return nil;
+}
+
+SCK_API static SCContentFilter *create_filter(struct screen_capture *sc,
+					      SCShareableContent *content,
+					      CGSize *size)
+{
+	if (sc->type == SCK_CAPTURE_WINDOW) {
+		if (!find_window(&sc->window, NULL, false))
+			return nil;
+
+		SCWindow *window =
+			find_sc_window(content, sc->window.window_id);
+		if (!window)
+			return nil;
+
+		CGFloat scale = [NSScreen mainScreen].backingScaleFactor;
+		size->width = window.frame.size.width * scale;
+		size->height = window.frame.size.height * scale;
+
+		return [[[SCContentFilter alloc]
+			initWithDesktopIndependentWindow:window] autorelease];
+	}
+
+	if (sc->display >= [NSScreen screens].count)
+		return nil;
+
+	NSScreen *screen = [NSScreen screens][sc->display];
+	NSNumber *screen_num = screen.deviceDescription[@"NSScreenNumber"];
+	SCDisplay *display = find_display(
+		content, (CGDirectDisplayID)screen_num.unsignedIntValue);
+	if (!display)
+		return nil;
+
+	*size = [screen convertRectToBacking:screen.frame].size;
+
+	return [[[SCContentFilter alloc] initWithDisplay:display
+					excludingWindows:@[]] autorelease];
+}
+
+SCK_API static bool init_screen_stream(struct screen_capture *sc)
+{
+	SCShareableContent *content = get_shareable_content();
+	if (!content)
+		return false;
+
+	CGSize size = {0};
+	SCContentFilter *filter = create_filter(sc, content, &size);
+	if (!filter || !size.width || !size.height)
+		return false;
+
+	struct obs_video_info ovi;
+	obs_get_video_info(&ovi);
+
+	sc->config = [[SCStreamConfiguration alloc] init];
+	sc->config.width = (size_t)size.width;
+	sc->config.height = (size_t)size.height;
+	sc->config.pixelFormat = 'BGRA';
+	sc->config.queueDepth = SCK_QUEUE_DEPTH;
+	sc->config.showsCursor = sc->show_cursor;
+	sc->config.minimumFrameInterval =
+		CMTimeMake((int64_t)ovi.fps_den, (int32_t)ovi.fps_num);
+
+	sc->delegate = [[ScreenCaptureDelegate alloc] init];
+	sc->delegate.sc = sc;
+
+	sc->disp = [[SCStream alloc] initWithFilter:filter
+				      configuration:sc->config
+					   delegate:nil];
+
+	NSError *error = nil;
+	if (![sc->disp addStreamOutput:sc->delegate
+				  type:SCStreamOutputTypeScreen
+		    sampleHandlerQueue:nil
+				 error:&error]) {
+		blog(LOG_WARNING, "[screen-capture] Failed to add output: %s",
+		     error.localizedDescription.UTF8String);
+		return false;
+	}
+
+	[sc->disp startCaptureWithCompletionHandler:^(NSError *start_error) {
+		if (start_error)
+			blog(LOG_WARNING,
+			     "[screen-capture] Failed to start capture: %s",
+			     start_error.localizedDescription.UTF8String);
+	}];
+
+	return true;
+}
+
+SCK_API static void destroy_screen_stream(struct screen_capture *sc)
+{
+	if (sc->disp) {
+		os_event_t *stopped;
+
+		os_event_init(&stopped, OS_EVENT_TYPE_MANUAL);
+		[sc->disp stopCaptureWithCompletionHandler:^(NSError *error) {
+			UNUSED_PARAMETER(error);
+			os_event_signal(stopped);
+		}];
+		os_event_wait(stopped);
+		os_event_destroy(stopped);
+
+		[sc->disp release];
+		sc->disp = nil;
+	}
+
+	[sc->delegate release];
+	sc->delegate = nil;
+	[sc->config release];
+	sc->config = nil;
+
+	if (sc->tex) {
+		gs_texture_destroy(sc->tex);
+		sc->tex = NULL;
+	}
+
+	release_surface(sc->current);
+	sc->current = NULL;
+	release_surface(sc->prev);
+	sc->prev = NULL;
+}
+
+SCK_API static void screen_capture_destroy(void *data)
+{
+	struct screen_capture *sc = data;
+
+	if (!sc)
+		return;
+
+	obs_enter_graphics();
+	destroy_screen_stream(sc);
+	obs_leave_graphics();
+
+	destroy_window(&sc->window);
+
+	pthread_mutex_destroy(&sc->mutex);
+	bfree(sc);
+}
+
+SCK_API static void load_settings(struct screen_capture *sc,
+				  obs_data_t *settings)
+{
+	sc->type = (enum sck_capture_type)obs_data_get_int(settings, "type");
+	sc->display = (unsigned)obs_data_get_int(settings, "display");
+	sc->show_cursor = obs_data_get_bool(settings, "show_cursor");
+}
+
+SCK_API static void *screen_capture_create(obs_data_t *settings,
+					   obs_source_t *source)
+{
+	struct screen_capture *sc = bzalloc(sizeof(struct screen_capture));
+
+	sc->source = source;
+	sc->effect = obs_get_base_effect(OBS_EFFECT_DEFAULT_RECT);
+	pthread_mutex_init(&sc->mutex, NULL);
+
+	init_window(&sc->window, settings);
+	load_settings(sc, settings);
+
+	@autoreleasepool {
+		if (!init_screen_stream(sc))
+			blog(LOG_WARNING,
+			     "[screen-capture: '%s'] Failed to start capture",
+			     obs_source_get_name(source));
+	}
+
+	return sc;
+}
+
+SCK_API static void screen_capture_update(void *data, obs_data_t *settings)
+{
+	struct screen_capture *sc = data;
+
+	obs_enter_graphics();
+	destroy_screen_stream(sc);
+	obs_leave_graphics();
+
+	load_settings(sc, settings);
+	if (sc->type == SCK_CAPTURE_WINDOW)
+		update_window(&sc->window, settings);
+
+	@autoreleasepool {
+		init_screen_stream(sc);
+	}
+}
+
+SCK_API static void screen_capture_video_tick(void *data, float seconds)
+{
+	UNUSED_PARAMETER(seconds);
+
+	struct screen_capture *sc = data;
+	IOSurfaceRef prev_prev;
+
+	if (!sc->current || !obs_source_showing(sc->source))
+		return;
+
+	pthread_mutex_lock(&sc->mutex);
+	prev_prev = sc->prev;
+	sc->prev = sc->current;
+	sc->current = NULL;
+	pthread_mutex_unlock(&sc->mutex);
+
+	obs_enter_graphics();
+	if (!gs_texture_rebind_iosurface(sc->tex, sc->prev)) {
+		gs_texture_destroy(sc->tex);
+		sc->tex = gs_texture_create_from_iosurface(sc->prev);
+	}
+	obs_leave_graphics();
+
+	release_surface(prev_prev);
+}
+
+SCK_API static void screen_capture_video_render(void *data,
+						gs_effect_t *effect)
+{
+	UNUSED_PARAMETER(effect);
+
+	struct screen_capture *sc = data;
+
+	if (!sc->tex)
+		return;
+
+	const bool linear_srgb = gs_get_linear_srgb();
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(linear_srgb);
+
+	gs_eparam_t *param = gs_effect_get_param_by_name(sc->effect, "image");
+	if (linear_srgb)
+		gs_effect_set_texture_srgb(param, sc->tex);
+	else
+		gs_effect_set_texture(param, sc->tex);
+
+	while (gs_effect_loop(sc->effect, "Draw"))
+		gs_draw_sprite(sc->tex, 0, 0, 0);
+
+	gs_enable_framebuffer_srgb(previous);
+}
+
+static const char *screen_capture_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("ScreenCapture");
+}
+
+SCK_API static uint32_t screen_capture_getwidth(void *data)
+{
+	struct screen_capture *sc = data;
+	return sc->tex ? gs_texture_get_width(sc->tex) : 0;
+}
+
+SCK_API static uint32_t screen_capture_getheight(void *data)
+{
+	struct screen_capture *sc = data;
+	return sc->tex ? gs_texture_get_height(sc->tex) : 0;
+}
+
+static void screen_capture_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "type", SCK_CAPTURE_DISPLAY);
+	obs_data_set_default_int(settings, "display", 0);
+	obs_data_set_default_bool(settings, "show_cursor", true);
+
+	window_defaults(settings);
+}
+
+static bool switch_capture_type(obs_properties_t *props, obs_property_t *p,
+				obs_data_t *settings)
+{
+	UNUSED_PARAMETER(p);
+
+	bool window = obs_data_get_int(settings, "type") == SCK_CAPTURE_WINDOW;
+
+	obs_property_set_visible(obs_properties_get(props, "display"),
+				 !window);
+	show_window_properties(props, window);
+	return true;
+}
+
+static obs_properties_t *screen_capture_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_property_t *type = obs_properties_add_list(
+		props, "type", obs_module_text("ScreenCapture.Type"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(
+		type, obs_module_text("ScreenCapture.Type.Display"),
+		SCK_CAPTURE_DISPLAY);
+	obs_property_list_add_int(type,
+				  obs_module_text("ScreenCapture.Type.Window"),
+				  SCK_CAPTURE_WINDOW);
+	obs_property_set_modified_callback(type, switch_capture_type);
+
+	obs_property_t *list = obs_properties_add_list(
+		props, "display", obs_module_text("DisplayCapture.Display"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+
+	for (unsigned i = 0; i < [NSScreen screens].count; i++) {
+		char buf[10];
+		sprintf(buf, "%u", i);
+		obs_property_list_add_int(list, buf, i);
+	}
+
+	add_window_properties(props);
+	show_window_properties(props, false);
+
+	obs_properties_add_bool(props, "show_cursor",
+				obs_module_text("DisplayCapture.ShowCursor"));
+
+	return props;
+}
+
+bool screen_capture_available(void)
+{
+	if (@available(macOS 12.5, *))
+		return true;
+	return false;
+}
+
+SCK_API struct obs_source_info screen_capture_info = {
+	.id = "screen_capture",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.get_name = screen_capture_getname,
+
+	.create = screen_capture_create,
+	.destroy = screen_capture_destroy,
+
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
+			OBS_SOURCE_DO_NOT_DUPLICATE,
+	.video_tick = screen_capture_video_tick,
+	.video_render = screen_capture_video_render,
+
+	.get_width = screen_capture_getwidth,
+	.get_height = screen_capture_getheight,
+
+	.get_defaults = screen_capture_defaults,
+	.get_properties = screen_capture_properties,
+	.update = screen_capture_update,
+	.icon_type = OBS_ICON_TYPE_DESKTOP_CAPTURE,
+};
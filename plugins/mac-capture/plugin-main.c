@@ -11,6 +11,9 @@ extern struct obs_source_info coreaudio_input_capture_info;
 extern struct obs_source_info coreaudio_output_capture_info;
 extern struct obs_source_info display_capture_info;
 extern struct obs_source_info window_capture_info;
+extern struct obs_source_info screen_capture_info;
+
+extern bool screen_capture_available(void);
 
 bool obs_module_load(void)
 {
@@ -18,5 +21,7 @@ bool obs_module_load(void)
 	obs_register_source(&coreaudio_output_capture_info);
 	obs_register_source(&display_capture_info);
 	obs_register_source(&window_capture_info);
+	if (screen_capture_available())
+		obs_register_source(&screen_capture_info);
 	return true;
 }
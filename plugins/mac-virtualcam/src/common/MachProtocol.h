@@ -14,4 +14,6 @@ typedef enum {
 	MachMsgIdFrame = 2,
 	//! Indicates the server is going to stop sending frames
 	MachMsgIdStop = 3,
+	//! Message containing the port of an IOSurface that holds a frame
+	MachMsgIdFrameSurface = 4,
 } MachMsgId;
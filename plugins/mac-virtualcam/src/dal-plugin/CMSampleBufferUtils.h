@@ -6,12 +6,19 @@
 //
 
 #include <CoreMediaIO/CMIOSampleBuffer.h>
+#include <IOSurface/IOSurface.h>
 
 OSStatus CMSampleBufferCreateFromData(NSSize size,
 				      CMSampleTimingInfo timingInfo,
 				      UInt64 sequenceNumber, NSData *data,
 				      CMSampleBufferRef *sampleBuffer);
 
+OSStatus CMSampleBufferCreateFromSurface(NSSize size,
+					 CMSampleTimingInfo timingInfo,
+					 UInt64 sequenceNumber,
+					 IOSurfaceRef surface,
+					 CMSampleBufferRef *sampleBuffer);
+
 OSStatus CMSampleBufferCreateFromDataNoCopy(NSSize size,
 					    CMSampleTimingInfo timingInfo,
 					    UInt64 sequenceNumber, NSData *data,
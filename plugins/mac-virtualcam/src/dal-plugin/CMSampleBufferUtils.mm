@@ -81,6 +81,56 @@ OSStatus CMSampleBufferCreateFromData(NSSize size,
 	return noErr;
 }
 
+/*!
+ CMSampleBufferCreateFromSurface
+
+ Creates a CMSampleBuffer whose pixel buffer uses the frame surface shared by
+ OBS directly. The pixel buffer keeps the surface in use until the sample
+ buffer is released, which keeps OBS from writing into it.
+ */
+OSStatus CMSampleBufferCreateFromSurface(NSSize size,
+					 CMSampleTimingInfo timingInfo,
+					 UInt64 sequenceNumber,
+					 IOSurfaceRef surface,
+					 CMSampleBufferRef *sampleBuffer)
+{
+	UNUSED_PARAMETER(size);
+
+	OSStatus err = noErr;
+
+	CVPixelBufferRef pixelBuffer;
+	err = CVPixelBufferCreateWithIOSurface(kCFAllocatorDefault, surface,
+					       nil, &pixelBuffer);
+	if (err != noErr) {
+		DLog(@"CVPixelBufferCreateWithIOSurface err %d", err);
+		return err;
+	}
+
+	CMFormatDescriptionRef format;
+	err = CMVideoFormatDescriptionCreateForImageBuffer(NULL, pixelBuffer,
+							   &format);
+	if (err != noErr) {
+		DLog(@"CMVideoFormatDescriptionCreateForImageBuffer err %d",
+		     err);
+		CFRelease(pixelBuffer);
+		return err;
+	}
+
+	err = CMIOSampleBufferCreateForImageBuffer(kCFAllocatorDefault,
+						   pixelBuffer, format,
+						   &timingInfo, sequenceNumber,
+						   0, sampleBuffer);
+	CFRelease(format);
+	CFRelease(pixelBuffer);
+
+	if (err != noErr) {
+		DLog(@"CMIOSampleBufferCreateForImageBuffer err %d", err);
+		return err;
+	}
+
+	return noErr;
+}
+
 static void releaseNSData(void *o, void *block, size_t size)
 {
 	UNUSED_PARAMETER(block);
@@ -6,6 +6,7 @@
 //
 
 #import <Foundation/Foundation.h>
+#import <IOSurface/IOSurface.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -16,6 +17,11 @@ NS_ASSUME_NONNULL_BEGIN
 		 fpsNumerator:(uint32_t)fpsNumerator
 	       fpsDenominator:(uint32_t)fpsDenominator
 		    frameData:(NSData *)frameData;
+- (void)receivedFrameWithSize:(NSSize)size
+		    timestamp:(uint64_t)timestamp
+		 fpsNumerator:(uint32_t)fpsNumerator
+	       fpsDenominator:(uint32_t)fpsDenominator
+		      surface:(IOSurfaceRef)surface;
 - (void)receivedStop;
 
 @end
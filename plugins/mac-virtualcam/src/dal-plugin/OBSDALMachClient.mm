@@ -126,6 +126,44 @@
 					    frameData:frameData];
 		}
 		break;
+	case MachMsgIdFrameSurface:
+		VLog(@"Received frame surface message");
+		if (components.count >= 6) {
+			CGFloat width;
+			[components[0] getBytes:&width length:sizeof(width)];
+			CGFloat height;
+			[components[1] getBytes:&height length:sizeof(height)];
+			uint64_t timestamp;
+			[components[2] getBytes:&timestamp
+					 length:sizeof(timestamp)];
+			uint32_t fpsNumerator;
+			[components[4] getBytes:&fpsNumerator
+					 length:sizeof(fpsNumerator)];
+			uint32_t fpsDenominator;
+			[components[5] getBytes:&fpsDenominator
+					 length:sizeof(fpsDenominator)];
+
+			// Every message adds a reference to the send right of
+			// the surface port, drop it once the surface is found
+			mach_port_t port =
+				((NSMachPort *)components[3]).machPort;
+			IOSurfaceRef surface =
+				IOSurfaceLookupFromMachPort(port);
+			mach_port_deallocate(mach_task_self(), port);
+			if (surface == NULL) {
+				ELog(@"Unable to look up frame surface");
+				break;
+			}
+
+			[self.delegate
+				receivedFrameWithSize:NSMakeSize(width, height)
+					    timestamp:timestamp
+					 fpsNumerator:fpsNumerator
+				       fpsDenominator:fpsDenominator
+					      surface:surface];
+			CFRelease(surface);
+		}
+		break;
 	case MachMsgIdStop:
 		DLog(@"Received stop message");
 		[self.delegate receivedStop];
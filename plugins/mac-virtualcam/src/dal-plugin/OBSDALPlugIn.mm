@@ -207,11 +207,9 @@ typedef enum {
 
 #pragma mark - MachClientDelegate
 
-- (void)receivedFrameWithSize:(NSSize)size
-		    timestamp:(uint64_t)timestamp
-		 fpsNumerator:(uint32_t)fpsNumerator
-	       fpsDenominator:(uint32_t)fpsDenominator
-		    frameData:(NSData *)frameData
+- (void)frameArrivedWithSize:(NSSize)size
+		fpsNumerator:(uint32_t)fpsNumerator
+	      fpsDenominator:(uint32_t)fpsDenominator
 {
 	dispatch_sync(_stateQueue, ^{
 		if (_state == PlugInStateWaitingForServer) {
@@ -237,6 +235,17 @@ typedef enum {
 		_timeoutTimer,
 		dispatch_time(DISPATCH_TIME_NOW, 5.0 * NSEC_PER_SEC),
 		5.0 * NSEC_PER_SEC, (1ull * NSEC_PER_SEC) / 10);
+}
+
+- (void)receivedFrameWithSize:(NSSize)size
+		    timestamp:(uint64_t)timestamp
+		 fpsNumerator:(uint32_t)fpsNumerator
+	       fpsDenominator:(uint32_t)fpsDenominator
+		    frameData:(NSData *)frameData
+{
+	[self frameArrivedWithSize:size
+		      fpsNumerator:fpsNumerator
+		    fpsDenominator:fpsDenominator];
 
 	[self.stream queueFrameWithSize:size
 			      timestamp:timestamp
@@ -245,6 +254,23 @@ typedef enum {
 			      frameData:frameData];
 }
 
+- (void)receivedFrameWithSize:(NSSize)size
+		    timestamp:(uint64_t)timestamp
+		 fpsNumerator:(uint32_t)fpsNumerator
+	       fpsDenominator:(uint32_t)fpsDenominator
+		      surface:(IOSurfaceRef)surface
+{
+	[self frameArrivedWithSize:size
+		      fpsNumerator:fpsNumerator
+		    fpsDenominator:fpsDenominator];
+
+	[self.stream queueFrameWithSize:size
+			      timestamp:timestamp
+			   fpsNumerator:fpsNumerator
+			 fpsDenominator:fpsDenominator
+				surface:surface];
+}
+
 - (void)receivedStop
 {
 	DLogFunc(@"Restarting connection");
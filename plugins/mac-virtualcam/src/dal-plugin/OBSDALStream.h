@@ -18,6 +18,7 @@
 //  along with obs-mac-virtualcam. If not, see <http://www.gnu.org/licenses/>.
 
 #import <Foundation/Foundation.h>
+#import <IOSurface/IOSurface.h>
 
 #import "OBSDALObjectStore.h"
 
@@ -43,6 +44,12 @@ NS_ASSUME_NONNULL_BEGIN
 	    fpsDenominator:(uint32_t)fpsDenominator
 		 frameData:(NSData *)frameData;
 
+- (void)queueFrameWithSize:(NSSize)size
+		 timestamp:(uint64_t)timestamp
+	      fpsNumerator:(uint32_t)fpsNumerator
+	    fpsDenominator:(uint32_t)fpsDenominator
+		   surface:(IOSurfaceRef)surface;
+
 @end
 
 NS_ASSUME_NONNULL_END
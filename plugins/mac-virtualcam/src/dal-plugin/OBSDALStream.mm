@@ -376,6 +376,46 @@
 	}
 }
 
+- (void)queueFrameWithSize:(NSSize)size
+		 timestamp:(uint64_t)timestamp
+	      fpsNumerator:(uint32_t)fpsNumerator
+	    fpsDenominator:(uint32_t)fpsDenominator
+		   surface:(IOSurfaceRef)surface
+{
+	if (CMSimpleQueueGetFullness(self.queue) >= 1.0) {
+		DLog(@"Queue is full, bailing out");
+		return;
+	}
+	OSStatus err = noErr;
+
+	CMSampleTimingInfo timingInfo = CMSampleTimingInfoForTimestamp(
+		timestamp, fpsNumerator, fpsDenominator);
+
+	err = CMIOStreamClockPostTimingEvent(timingInfo.presentationTimeStamp,
+					     mach_absolute_time(), true,
+					     self.clock);
+	if (err != noErr) {
+		DLog(@"CMIOStreamClockPostTimingEvent err %d", err);
+	}
+
+	self.sequenceNumber = CMIOGetNextSequenceNumber(self.sequenceNumber);
+
+	CMSampleBufferRef sampleBuffer;
+	err = CMSampleBufferCreateFromSurface(size, timingInfo,
+					      self.sequenceNumber, surface,
+					      &sampleBuffer);
+	if (err != noErr) {
+		return;
+	}
+	CMSimpleQueueEnqueue(self.queue, sampleBuffer);
+
+	// Inform the clients that the queue has been altered
+	if (self.alteredProc != NULL) {
+		(self.alteredProc)(self.objectId, sampleBuffer,
+				   self.alteredRefCon);
+	}
+}
+
 - (CMVideoFormatDescriptionRef)getFormatDescription
 {
 	CMVideoFormatDescriptionRef formatDescription;
@@ -6,6 +6,7 @@
 //
 
 #import <Foundation/Foundation.h>
+#import <IOSurface/IOSurface.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -22,6 +23,18 @@ NS_ASSUME_NONNULL_BEGIN
 	   fpsDenominator:(uint32_t)fpsDenominator
 	       frameBytes:(uint8_t *)frameBytes;
 
+/*!
+ Sends the port of a surface holding the frame, so clients map the frame
+ instead of receiving a copy of it
+ */
+- (void)sendFrameWithSize:(NSSize)size
+		timestamp:(uint64_t)timestamp
+	     fpsNumerator:(uint32_t)fpsNumerator
+	   fpsDenominator:(uint32_t)fpsDenominator
+		  surface:(IOSurfaceRef)surface;
+
+- (BOOL)hasClients;
+
 - (void)stop;
 
 @end
@@ -168,6 +168,56 @@
 	}
 }
 
+- (void)sendFrameWithSize:(NSSize)size
+		timestamp:(uint64_t)timestamp
+	     fpsNumerator:(uint32_t)fpsNumerator
+	   fpsDenominator:(uint32_t)fpsDenominator
+		  surface:(IOSurfaceRef)surface
+{
+	if ([self.clientPorts count] <= 0) {
+		return;
+	}
+
+	@autoreleasepool {
+		CGFloat width = size.width;
+		NSData *widthData = [NSData dataWithBytes:&width
+						   length:sizeof(width)];
+		CGFloat height = size.height;
+		NSData *heightData = [NSData dataWithBytes:&height
+						    length:sizeof(height)];
+		NSData *timestampData = [NSData
+			dataWithBytes:&timestamp
+			       length:sizeof(timestamp)];
+		NSData *fpsNumeratorData = [NSData
+			dataWithBytes:&fpsNumerator
+			       length:sizeof(fpsNumerator)];
+		NSData *fpsDenominatorData = [NSData
+			dataWithBytes:&fpsDenominator
+			       length:sizeof(fpsDenominator)];
+
+		// The message carries a send right to the surface, the port
+		// object deallocates ours once it is released
+		mach_port_t surfacePort = IOSurfaceCreateMachPort(surface);
+		NSPort *surfacePortObject = [NSMachPort
+			portWithMachPort:surfacePort
+				 options:NSMachPortDeallocateSendRight];
+
+		[self sendMessageToClientsWithMsgId:MachMsgIdFrameSurface
+					 components:@[
+						 widthData, heightData,
+						 timestampData,
+						 surfacePortObject,
+						 fpsNumeratorData,
+						 fpsDenominatorData
+					 ]];
+	}
+}
+
+- (BOOL)hasClients
+{
+	return [self.clientPorts count] > 0;
+}
+
 - (void)stop
 {
 	blog(LOG_DEBUG, "sending stop message to %lu clients",
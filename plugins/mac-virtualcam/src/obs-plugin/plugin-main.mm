@@ -7,6 +7,8 @@
 #include <obs.h>
 #include <CoreFoundation/CoreFoundation.h>
 #include <AppKit/AppKit.h>
+#include <CoreVideo/CoreVideo.h>
+#include <IOSurface/IOSurface.h>
 #include "OBSDALMachServer.h"
 #include "Defines.h"
 
@@ -21,6 +23,55 @@ obs_output_t *outputRef;
 obs_video_info videoInfo;
 static OBSDALMachServer *sMachServer;
 
+// Frames are written into surfaces shared with the DAL plugin, which only
+// receives their ports. A surface is in use while a client still holds a
+// sample buffer made from it.
+#define SURFACE_POOL_SIZE 4
+static IOSurfaceRef sSurfaces[SURFACE_POOL_SIZE];
+static size_t sNextSurface;
+
+static void release_surfaces()
+{
+	for (size_t i = 0; i < SURFACE_POOL_SIZE; i++) {
+		if (sSurfaces[i]) {
+			CFRelease(sSurfaces[i]);
+			sSurfaces[i] = NULL;
+		}
+	}
+	sNextSurface = 0;
+}
+
+static IOSurfaceRef create_surface(uint32_t width, uint32_t height)
+{
+	NSDictionary *properties = @{
+		(__bridge NSString *)kIOSurfaceWidth: @(width),
+		(__bridge NSString *)kIOSurfaceHeight: @(height),
+		(__bridge NSString *)kIOSurfaceBytesPerElement: @2,
+		(__bridge NSString *)
+		kIOSurfacePixelFormat: @(kCVPixelFormatType_422YpCbCr8),
+	};
+	return IOSurfaceCreate((__bridge CFDictionaryRef)properties);
+}
+
+static IOSurfaceRef next_surface()
+{
+	for (size_t i = 0; i < SURFACE_POOL_SIZE; i++) {
+		size_t idx = (sNextSurface + i) % SURFACE_POOL_SIZE;
+
+		if (!sSurfaces[idx])
+			sSurfaces[idx] =
+				create_surface(videoInfo.output_width,
+					       videoInfo.output_height);
+
+		if (sSurfaces[idx] && !IOSurfaceIsInUse(sSurfaces[idx])) {
+			sNextSurface = idx + 1;
+			return sSurfaces[idx];
+		}
+	}
+
+	return NULL;
+}
+
 static bool check_dal_plugin()
 {
 	NSFileManager *fileManager = [NSFileManager defaultManager];
@@ -131,6 +182,7 @@ static void virtualcam_output_destroy(void *data)
 	UNUSED_PARAMETER(data);
 	blog(LOG_DEBUG, "output_destroy");
 	sMachServer = nil;
+	release_surfaces();
 }
 
 static bool virtualcam_output_start(void *data)
@@ -148,6 +200,7 @@ static bool virtualcam_output_start(void *data)
 	[sMachServer run];
 
 	obs_get_video_info(&videoInfo);
+	release_surfaces();
 
 	struct video_scale_info conversion = {};
 	conversion.format = VIDEO_FORMAT_UYVY;
@@ -175,12 +228,27 @@ static void virtualcam_output_raw_video(void *data, struct video_data *frame)
 {
 	UNUSED_PARAMETER(data);
 
-	uint8_t *outData = frame->data[0];
-	if (frame->linesize[0] != (videoInfo.output_width * 2)) {
-		blog(LOG_ERROR,
-		     "unexpected frame->linesize (expected:%d actual:%d)",
-		     (videoInfo.output_width * 2), frame->linesize[0]);
+	if (![sMachServer hasClients])
+		return;
+
+	// Every surface is still held by a client, so it gets no new frame
+	// until it caught up, the same as when its queue is full
+	IOSurfaceRef surface = next_surface();
+	if (!surface)
+		return;
+
+	uint32_t rowBytes = videoInfo.output_width * 2;
+	size_t dstLinesize = IOSurfaceGetBytesPerRow(surface);
+	const uint8_t *src = frame->data[0];
+
+	IOSurfaceLock(surface, 0, NULL);
+	uint8_t *dst = (uint8_t *)IOSurfaceGetBaseAddress(surface);
+	for (uint32_t y = 0; y < videoInfo.output_height; y++) {
+		memcpy(dst, src, rowBytes);
+		dst += dstLinesize;
+		src += frame->linesize[0];
 	}
+	IOSurfaceUnlock(surface, 0, NULL);
 
 	CGFloat width = videoInfo.output_width;
 	CGFloat height = videoInfo.output_height;
@@ -189,7 +257,7 @@ static void virtualcam_output_raw_video(void *data, struct video_data *frame)
 			     timestamp:frame->timestamp
 			  fpsNumerator:videoInfo.fps_num
 			fpsDenominator:videoInfo.fps_den
-			    frameBytes:outData];
+			       surface:surface];
 }
 
 struct obs_output_info virtualcam_output_info = {
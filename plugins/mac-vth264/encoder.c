@@ -57,6 +57,7 @@ struct vt_h264_encoder {
 	float rc_max_bitrate_window;
 	const char *profile;
 	bool bframes;
+	bool low_latency;
 
 	enum video_format obs_pix_fmt;
 	int vt_pix_fmt;
@@ -235,11 +236,14 @@ void sample_encoded_callback(void *data, void *source, OSStatus status,
 	kVTVideoEncoderSpecification_EnableHardwareAcceleratedVideoEncoder
 #define REQUIRE_HW_ACCEL \
 	kVTVideoEncoderSpecification_RequireHardwareAcceleratedVideoEncoder
+// Spelled out so the encoder still builds against SDKs older than 11.3,
+// systems that don't know the key ignore it
+#define LOW_LATENCY_RC CFSTR("EnableLowLatencyRateControl")
 static inline CFMutableDictionaryRef
-create_encoder_spec(const char *vt_encoder_id)
+create_encoder_spec(const char *vt_encoder_id, bool low_latency)
 {
 	CFMutableDictionaryRef encoder_spec = CFDictionaryCreateMutable(
-		kCFAllocatorDefault, 3, &kCFTypeDictionaryKeyCallBacks,
+		kCFAllocatorDefault, 4, &kCFTypeDictionaryKeyCallBacks,
 		&kCFTypeDictionaryValueCallBacks);
 
 	CFStringRef id =
@@ -250,8 +254,13 @@ create_encoder_spec(const char *vt_encoder_id)
 	CFDictionaryAddValue(encoder_spec, ENABLE_HW_ACCEL, kCFBooleanTrue);
 	CFDictionaryAddValue(encoder_spec, REQUIRE_HW_ACCEL, kCFBooleanFalse);
 
+	if (low_latency)
+		CFDictionaryAddValue(encoder_spec, LOW_LATENCY_RC,
+				     kCFBooleanTrue);
+
 	return encoder_spec;
 }
+#undef LOW_LATENCY_RC
 #undef ENCODER_ID
 #undef REQUIRE_HW_ACCEL
 #undef ENABLE_HW_ACCEL
@@ -260,7 +269,7 @@ static inline CFMutableDictionaryRef
 create_pixbuf_spec(struct vt_h264_encoder *enc)
 {
 	CFMutableDictionaryRef pixbuf_spec = CFDictionaryCreateMutable(
-		kCFAllocatorDefault, 3, &kCFTypeDictionaryKeyCallBacks,
+		kCFAllocatorDefault, 4, &kCFTypeDictionaryKeyCallBacks,
 		&kCFTypeDictionaryValueCallBacks);
 
 	CFNumberRef n =
@@ -276,6 +285,16 @@ create_pixbuf_spec(struct vt_h264_encoder *enc)
 	CFDictionaryAddValue(pixbuf_spec, kCVPixelBufferHeightKey, n);
 	CFRelease(n);
 
+	// Back the pool's buffers with IOSurfaces, which the hardware encoder
+	// reads directly instead of copying every frame into one first
+	CFDictionaryRef surface_props = CFDictionaryCreate(
+		kCFAllocatorDefault, NULL, NULL, 0,
+		&kCFTypeDictionaryKeyCallBacks,
+		&kCFTypeDictionaryValueCallBacks);
+	CFDictionaryAddValue(pixbuf_spec, kCVPixelBufferIOSurfacePropertiesKey,
+			     surface_props);
+	CFRelease(surface_props);
+
 	return pixbuf_spec;
 }
 
@@ -285,7 +304,8 @@ static bool create_encoder(struct vt_h264_encoder *enc)
 
 	VTCompressionSessionRef s;
 
-	CFDictionaryRef encoder_spec = create_encoder_spec(enc->vt_encoder_id);
+	CFDictionaryRef encoder_spec =
+		create_encoder_spec(enc->vt_encoder_id, enc->low_latency);
 	CFDictionaryRef pixbuf_spec = create_pixbuf_spec(enc);
 
 	STATUS_CHECK(VTCompressionSessionCreate(
@@ -319,9 +339,11 @@ static bool create_encoder(struct vt_h264_encoder *enc)
 	STATUS_CHECK(session_set_prop_int(
 		s, kVTCompressionPropertyKey_ExpectedFrameRate,
 		ceil((float)enc->fps_num / enc->fps_den)));
+	// Low latency rate control does not support frame reordering
 	STATUS_CHECK(session_set_prop(
 		s, kVTCompressionPropertyKey_AllowFrameReordering,
-		enc->bframes ? kCFBooleanTrue : kCFBooleanFalse));
+		enc->bframes && !enc->low_latency ? kCFBooleanTrue
+						  : kCFBooleanFalse));
 
 	// This can fail depending on hardware configuration
 	code = session_set_prop(s, kVTCompressionPropertyKey_RealTime,
@@ -448,6 +470,7 @@ static void update_params(struct vt_h264_encoder *enc, obs_data_t *settings)
 	enc->rc_max_bitrate_window =
 		obs_data_get_double(settings, "max_bitrate_window");
 	enc->bframes = obs_data_get_bool(settings, "bframes");
+	enc->low_latency = obs_data_get_bool(settings, "low_latency");
 }
 
 static bool vt_h264_update(void *data, obs_data_t *settings)
@@ -790,6 +813,7 @@ static bool vt_h264_encode(void *data, struct encoder_frame *frame,
 	CMTime pts = CMTimeMultiply(dur, frame->pts);
 
 	CVPixelBufferRef pixbuf = NULL;
+	CFDictionaryRef frame_props = NULL;
 
 	if (!get_cached_pixel_buffer(enc, &pixbuf)) {
 		VT_BLOG(LOG_ERROR, "Unable to create pixel buffer");
@@ -808,6 +832,11 @@ static bool vt_h264_encode(void *data, struct encoder_frame *frame,
 			CVPixelBufferGetBytesPerRowOfPlane(pixbuf, i);
 		size_t plane_height = CVPixelBufferGetHeightOfPlane(pixbuf, i);
 
+		if (plane_linesize == frame->linesize[i]) {
+			memcpy(p, f, plane_linesize * plane_height);
+			continue;
+		}
+
 		for (size_t j = 0; j < plane_height; j++) {
 			memcpy(p, f, frame->linesize[i]);
 			p += plane_linesize;
@@ -817,8 +846,21 @@ static bool vt_h264_encode(void *data, struct encoder_frame *frame,
 
 	STATUS_CHECK(CVPixelBufferUnlockBaseAddress(pixbuf, 0));
 
-	STATUS_CHECK(VTCompressionSessionEncodeFrame(enc->session, pixbuf, pts,
-						     dur, NULL, pixbuf, NULL));
+	if (obs_encoder_keyframe_requested(enc->encoder)) {
+		const void *key = kVTEncodeFrameOptionKey_ForceKeyFrame;
+		const void *value = kCFBooleanTrue;
+
+		frame_props = CFDictionaryCreate(
+			kCFAllocatorDefault, &key, &value, 1,
+			&kCFTypeDictionaryKeyCallBacks,
+			&kCFTypeDictionaryValueCallBacks);
+	}
+
+	code = VTCompressionSessionEncodeFrame(enc->session, pixbuf, pts, dur,
+					       frame_props, pixbuf, NULL);
+	if (frame_props)
+		CFRelease(frame_props);
+	STATUS_CHECK(code);
 
 	CMSampleBufferRef buffer =
 		(CMSampleBufferRef)CMSimpleQueueDequeue(enc->queue);
@@ -867,6 +909,7 @@ static const char *vt_h264_getname_sw(void *unused)
 #define TEXT_NONE obs_module_text("None")
 #define TEXT_DEFAULT obs_module_text("DefaultEncoder")
 #define TEXT_BFRAMES obs_module_text("UseBFrames")
+#define TEXT_LOW_LATENCY obs_module_text("LowLatencyRateControl")
 
 static bool limit_bitrate_modified(obs_properties_t *ppts, obs_property_t *p,
 				   obs_data_t *settings)
@@ -912,6 +955,7 @@ static obs_properties_t *vt_h264_properties(void *unused)
 	obs_property_list_add_string(p, "high", "high");
 
 	obs_properties_add_bool(props, "bframes", TEXT_BFRAMES);
+	obs_properties_add_bool(props, "low_latency", TEXT_LOW_LATENCY);
 
 	return props;
 }
@@ -925,6 +969,7 @@ static void vt_h264_defaults(obs_data_t *settings)
 	obs_data_set_default_int(settings, "keyint_sec", 0);
 	obs_data_set_default_string(settings, "profile", "");
 	obs_data_set_default_bool(settings, "bframes", true);
+	obs_data_set_default_bool(settings, "low_latency", false);
 }
 
 OBS_DECLARE_MODULE()
@@ -990,7 +1035,8 @@ void register_encoders()
 		.get_defaults = vt_h264_defaults,
 		.get_video_info = vt_h264_video_info,
 		.get_extra_data = vt_h264_extra_data,
-		.caps = OBS_ENCODER_CAP_DYN_BITRATE,
+		.caps = OBS_ENCODER_CAP_DYN_BITRATE |
+			OBS_ENCODER_CAP_KEYFRAME_REQUEST,
 	};
 
 	for (size_t i = 0; i < vt_encoders.num; i++) {
@@ -0,0 +1,250 @@
+#include <obs-module.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define close_socket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET -1
+#define close_socket close
+#endif
+
+/*
+ * Serves obs_get_openmetrics() on http://127.0.0.1:<port>/metrics when the
+ * OBS_METRICS_PORT environment variable is set.  Requests are handled one at
+ * a time on a dedicated thread, so a scraper never touches the graphics or
+ * audio threads beyond reading their counters.
+ */
+
+#define POLL_INTERVAL_MS 250
+#define REQUEST_TIMEOUT_MS 2000
+#define MAX_REQUEST_SIZE 4096
+
+#define do_log(level, format, ...) \
+	blog(level, "[metrics-exporter] " format, ##__VA_ARGS__)
+
+OBS_DECLARE_MODULE()
+MODULE_EXPORT const char *obs_module_description(void)
+{
+	return "Local OpenMetrics endpoint for libobs counters";
+}
+
+static socket_t listen_socket = INVALID_SOCKET;
+static pthread_t server_thread;
+static bool server_thread_created = false;
+static volatile bool stopping = false;
+
+static bool wait_readable(socket_t s, int timeout_ms)
+{
+	struct timeval tv;
+	fd_set set;
+
+	FD_ZERO(&set);
+	FD_SET(s, &set);
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+	return select((int)s + 1, &set, NULL, NULL, &tv) > 0;
+}
+
+static bool send_all(socket_t s, const char *data, size_t size)
+{
+	while (size) {
+		int sent = send(s, data, (int)size, 0);
+		if (sent <= 0)
+			return false;
+
+		data += sent;
+		size -= (size_t)sent;
+	}
+
+	return true;
+}
+
+static void send_response(socket_t s, const char *status, const char *type,
+			  const char *body)
+{
+	struct dstr header = {0};
+	size_t size = body ? strlen(body) : 0;
+
+	dstr_printf(&header,
+		    "HTTP/1.0 %s\r\n"
+		    "Content-Type: %s\r\n"
+		    "Content-Length: %zu\r\n"
+		    "Connection: close\r\n\r\n",
+		    status, type, size);
+
+	if (send_all(s, header.array, header.len) && size)
+		send_all(s, body, size);
+
+	dstr_free(&header);
+}
+
+/* only the request line matters, so stop reading once it has arrived */
+static bool read_request_line(socket_t s, struct dstr *line)
+{
+	char buf[512];
+
+	while (line->len < MAX_REQUEST_SIZE) {
+		if (!wait_readable(s, REQUEST_TIMEOUT_MS))
+			return false;
+
+		int received = recv(s, buf, sizeof(buf), 0);
+		if (received <= 0)
+			return false;
+
+		dstr_ncat(line, buf, (size_t)received);
+
+		char *end = strstr(line->array, "\r\n");
+		if (end) {
+			dstr_resize(line, (size_t)(end - line->array));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void handle_client(socket_t s)
+{
+	struct dstr line = {0};
+
+	if (!read_request_line(s, &line))
+		goto done;
+
+	if (astrcmpi_n(line.array, "GET /metrics ", 13) == 0 ||
+	    astrcmpi_n(line.array, "GET /metrics?", 13) == 0) {
+		char *metrics = obs_get_openmetrics();
+		send_response(s, "200 OK",
+			      "application/openmetrics-text; version=1.0.0; "
+			      "charset=utf-8",
+			      metrics);
+		bfree(metrics);
+	} else if (astrcmpi_n(line.array, "GET ", 4) == 0) {
+		send_response(s, "404 Not Found", "text/plain", "Not Found\n");
+	} else {
+		send_response(s, "405 Method Not Allowed", "text/plain",
+			      "Method Not Allowed\n");
+	}
+
+done:
+	dstr_free(&line);
+	close_socket(s);
+}
+
+static void *server_thread_proc(void *param)
+{
+	UNUSED_PARAMETER(param);
+
+	os_set_thread_name("metrics-exporter: server");
+
+	while (!os_atomic_load_bool(&stopping)) {
+		if (!wait_readable(listen_socket, POLL_INTERVAL_MS))
+			continue;
+
+		socket_t client = accept(listen_socket, NULL, NULL);
+		if (client != INVALID_SOCKET)
+			handle_client(client);
+	}
+
+	return NULL;
+}
+
+static void close_listen_socket(void)
+{
+	close_socket(listen_socket);
+	listen_socket = INVALID_SOCKET;
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+static bool open_listen_socket(int port)
+{
+	struct sockaddr_in addr = {0};
+	int reuse = 1;
+
+#ifdef _WIN32
+	WSADATA wsad;
+	WSAStartup(MAKEWORD(2, 2), &wsad);
+#endif
+
+	listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listen_socket == INVALID_SOCKET) {
+		close_listen_socket();
+		return false;
+	}
+
+	setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR,
+		   (const char *)&reuse, sizeof(reuse));
+
+	/* never expose the endpoint beyond the local machine */
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short)port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(listen_socket, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(listen_socket, 4) != 0) {
+		close_listen_socket();
+		return false;
+	}
+
+	return true;
+}
+
+bool obs_module_load(void)
+{
+	const char *port_str = getenv("OBS_METRICS_PORT");
+	int port;
+
+	if (!port_str || !*port_str)
+		return true;
+
+	port = atoi(port_str);
+	if (port <= 0 || port > 65535) {
+		do_log(LOG_WARNING, "Invalid OBS_METRICS_PORT '%s'", port_str);
+		return true;
+	}
+
+	if (!open_listen_socket(port)) {
+		do_log(LOG_WARNING, "Failed to listen on 127.0.0.1:%d", port);
+		return true;
+	}
+
+	if (pthread_create(&server_thread, NULL, server_thread_proc, NULL) !=
+	    0) {
+		do_log(LOG_WARNING, "Failed to create server thread");
+		close_listen_socket();
+		return true;
+	}
+
+	server_thread_created = true;
+	do_log(LOG_INFO, "Serving metrics on http://127.0.0.1:%d/metrics",
+	       port);
+	return true;
+}
+
+void obs_module_unload(void)
+{
+	if (server_thread_created) {
+		os_atomic_set_bool(&stopping, true);
+		pthread_join(server_thread, NULL);
+		server_thread_created = false;
+	}
+
+	if (listen_socket != INVALID_SOCKET)
+		close_listen_socket();
+}
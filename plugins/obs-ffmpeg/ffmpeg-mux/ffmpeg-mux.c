@@ -27,6 +27,10 @@
 #include "ffmpeg-mux.h"
 
 #include <util/dstr.h>
+#include <util/file-writer.h>
+#include <util/platform.h>
+#include <util/shmem.h>
+#include <util/threading.h>
 #include <libavformat/avformat.h>
 
 #define ANSI_COLOR_RED "\x1b[0;91m"
@@ -93,6 +97,13 @@ struct main_params {
 	int color_range;
 	char *acodec;
 	char *muxer_settings;
+	char *ring_name;
+	int ring_size_mb;
+	int write_buffer_mb;
+	int flush_interval_ms;
+	int split_size_mb;
+	int split_time_sec;
+	char *mirror_file;
 };
 
 struct audio_params {
@@ -112,17 +123,60 @@ struct audio_info {
 	AVCodecContext *ctx;
 };
 
-struct ffmpeg_mux {
+struct packet_ring {
+	os_shmem_t *shm;
+	struct ffm_ring_header *header;
+	uint8_t *data;
+	uint64_t capacity;
+};
+
+/* one destination file, with streams and codec parameters of its own so
+ * files can be opened and closed independently of each other */
+struct mux_output {
 	AVFormatContext *output;
 	AVStream *video_stream;
 	AVCodecContext *video_ctx;
 	struct audio_info *audio_infos;
+	int num_audio_streams;
+	bool initialized;
+
+	struct dstr path;
+	struct dstr printable_path;
+
+	/* local files are written behind on a thread of their own, in large
+	 * blocks, so the disk sees few big writes instead of many 32 KB ones
+	 * and a slow disk does not hold up reading packets */
+	os_file_writer_t *file;
+	uint64_t last_flush_ts;
+
+	/* subtracted from every timestamp so each split file starts at 0 */
+	int64_t start_usec;
+};
+
+struct ffmpeg_mux {
+	struct mux_output out;
+	/* optional second copy of the recording, e.g. on a network share */
+	struct mux_output mirror;
+
+	/* the files of the next split are opened ahead of time, so switching
+	 * over on the keyframe costs nothing */
+	struct mux_output next;
+	struct mux_output next_mirror;
+	int file_index;
+	bool split_requested;
+	bool split_failed;
+
+	/* finished files get their trailers written on a thread of their own */
+	pthread_t close_thread;
+	bool close_thread_active;
+	struct mux_output closing;
+	struct mux_output closing_mirror;
+
 	struct main_params params;
 	struct audio_params *audio;
 	struct header video_header;
 	struct header *audio_header;
-	int num_audio_streams;
-	bool initialized;
+	struct packet_ring ring;
 	char error[4096];
 };
 
@@ -131,40 +185,206 @@ static void header_free(struct header *header)
 	free(header->data);
 }
 
-static void free_avformat(struct ffmpeg_mux *ffm)
+/* what the AVIOContext itself buffers before handing data to the writer */
+#define AVIO_BUFFER_SIZE (256 * 1024)
+#define WRITER_BLOCK_SIZE (1024 * 1024)
+
+static int write_buffered_file(void *opaque, uint8_t *buf, int size)
+{
+	os_file_writer_t *file = opaque;
+
+	if (!os_file_writer_write(file, buf, (size_t)size))
+		return AVERROR(EIO);
+
+	return size;
+}
+
+static int64_t seek_buffered_file(void *opaque, int64_t offset, int whence)
+{
+	os_file_writer_t *file = opaque;
+
+	if (whence & AVSEEK_SIZE)
+		return os_file_writer_size(file);
+
+	switch (whence & ~AVSEEK_FORCE) {
+	case SEEK_CUR:
+		offset += os_file_writer_tell(file);
+		break;
+	case SEEK_END:
+		offset += os_file_writer_size(file);
+		break;
+	}
+
+	if (!os_file_writer_seek(file, offset))
+		return AVERROR(EIO);
+
+	return offset;
+}
+
+static bool open_buffered_file(struct ffmpeg_mux *ffm, struct mux_output *mo)
+{
+	size_t num_blocks = (size_t)ffm->params.write_buffer_mb *
+			    (1024 * 1024 / WRITER_BLOCK_SIZE);
+	uint8_t *buffer;
+
+	mo->file = os_file_writer_create(mo->path.array, WRITER_BLOCK_SIZE,
+					 num_blocks);
+	if (!mo->file)
+		return false;
+
+	buffer = av_malloc(AVIO_BUFFER_SIZE);
+	mo->output->pb = avio_alloc_context(buffer, AVIO_BUFFER_SIZE, 1,
+					    mo->file, NULL, write_buffered_file,
+					    seek_buffered_file);
+	if (!mo->output->pb) {
+		av_free(buffer);
+		os_file_writer_destroy(mo->file);
+		mo->file = NULL;
+		return false;
+	}
+
+	mo->last_flush_ts = os_gettime_ns();
+	return true;
+}
+
+static void close_buffered_file(struct mux_output *mo)
+{
+	AVIOContext *pb = mo->output->pb;
+
+	avio_flush(pb);
+	av_freep(&pb->buffer);
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 80, 100)
+	avio_context_free(&pb);
+#else
+	av_freep(&pb);
+#endif
+	mo->output->pb = NULL;
+
+	if (!os_file_writer_destroy(mo->file))
+		fprintf(stderr, "Failed to write '%s'\n",
+			mo->printable_path.array);
+	mo->file = NULL;
+}
+
+/* lets obs show how far behind the disk is */
+static void publish_writer_stats(struct ffmpeg_mux *ffm)
+{
+	struct ffm_ring_header *header = ffm->ring.header;
+	struct os_file_writer_stats stats;
+
+	if (!ffm->out.file || !header)
+		return;
+
+	os_file_writer_get_stats(ffm->out.file, &stats);
+	header->writer_queued = (uint32_t)stats.queued;
+	header->writer_max_queued = (uint32_t)stats.max_queued;
+	header->writer_num_blocks = (uint32_t)stats.num_blocks;
+	header->writer_stalls = (uint32_t)stats.stalls;
+	header->writer_stall_ns = stats.stall_ns;
+}
+
+/* fragmented files only ever receive whole fragments, so pushing the buffer
+ * out leaves a file that plays up to the last fragment flushed */
+static void flush_buffered_file(struct ffmpeg_mux *ffm, struct mux_output *mo)
+{
+	uint64_t interval_ns = (uint64_t)ffm->params.flush_interval_ms *
+			       1000000ULL;
+	uint64_t now;
+
+	if (!mo->file || !ffm->params.flush_interval_ms)
+		return;
+
+	now = os_gettime_ns();
+	if (now - mo->last_flush_ts < interval_ns)
+		return;
+
+	avio_flush(mo->output->pb);
+	os_file_writer_flush(mo->file);
+	mo->last_flush_ts = now;
+}
+
+static void free_avformat(struct mux_output *mo)
 {
-	if (ffm->output) {
+	if (mo->output) {
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
-		avcodec_free_context(&ffm->video_ctx);
+		avcodec_free_context(&mo->video_ctx);
 #endif
 
-		if ((ffm->output->oformat->flags & AVFMT_NOFILE) == 0)
-			avio_close(ffm->output->pb);
+		if (mo->file)
+			close_buffered_file(mo);
+		else if ((mo->output->oformat->flags & AVFMT_NOFILE) == 0)
+			avio_close(mo->output->pb);
 
-		avformat_free_context(ffm->output);
-		ffm->output = NULL;
+		avformat_free_context(mo->output);
+		mo->output = NULL;
 	}
 
-	if (ffm->audio_infos) {
+	if (mo->audio_infos) {
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
-		for (int i = 0; i < ffm->num_audio_streams; ++i)
-			avcodec_free_context(&ffm->audio_infos[i].ctx);
+		for (int i = 0; i < mo->num_audio_streams; ++i)
+			avcodec_free_context(&mo->audio_infos[i].ctx);
 #endif
-		free(ffm->audio_infos);
+		free(mo->audio_infos);
 	}
 
-	ffm->video_stream = NULL;
-	ffm->audio_infos = NULL;
-	ffm->num_audio_streams = 0;
+	mo->video_stream = NULL;
+	mo->audio_infos = NULL;
+	mo->num_audio_streams = 0;
 }
 
-static void ffmpeg_mux_free(struct ffmpeg_mux *ffm)
+static void close_output(struct mux_output *mo)
+{
+	if (mo->initialized)
+		av_write_trailer(mo->output);
+
+	free_avformat(mo);
+	dstr_free(&mo->path);
+	dstr_free(&mo->printable_path);
+	memset(mo, 0, sizeof(*mo));
+}
+
+/* a file opened ahead of a split that never came is removed again */
+static void discard_output(struct mux_output *mo)
+{
+	struct dstr path = {0};
+
+	if (!mo->output)
+		return;
+
+	dstr_move(&path, &mo->path);
+	mo->initialized = false;
+	close_output(mo);
+
+	os_unlink(path.array);
+	dstr_free(&path);
+}
+
+static void *close_thread(void *data)
+{
+	struct ffmpeg_mux *ffm = data;
+
+	os_set_thread_name("ffmpeg-mux: close thread");
+
+	close_output(&ffm->closing);
+	close_output(&ffm->closing_mirror);
+	return NULL;
+}
+
+static void join_close_thread(struct ffmpeg_mux *ffm)
 {
-	if (ffm->initialized) {
-		av_write_trailer(ffm->output);
+	if (ffm->close_thread_active) {
+		pthread_join(ffm->close_thread, NULL);
+		ffm->close_thread_active = false;
 	}
+}
 
-	free_avformat(ffm);
+static void ffmpeg_mux_free(struct ffmpeg_mux *ffm)
+{
+	join_close_thread(ffm);
+	close_output(&ffm->out);
+	close_output(&ffm->mirror);
+	discard_output(&ffm->next);
+	discard_output(&ffm->next_mirror);
 
 	header_free(&ffm->video_header);
 
@@ -182,6 +402,8 @@ static void ffmpeg_mux_free(struct ffmpeg_mux *ffm)
 
 	dstr_free(&ffm->params.printable_file);
 
+	os_shmem_destroy(ffm->ring.shm);
+
 	memset(ffm, 0, sizeof(*ffm));
 }
 
@@ -347,10 +569,31 @@ static bool init_params(int *argc, char ***argv, struct main_params *params,
 
 	get_opt_str(argc, argv, &params->muxer_settings, "muxer settings");
 
+	/* the packet ring is optional */
+	if (*argc >= 2) {
+		get_opt_str(argc, argv, &params->ring_name, "ring name");
+		get_opt_int(argc, argv, &params->ring_size_mb, "ring size");
+	}
+
+	/* so are the file write buffer and the periodic flush */
+	if (*argc >= 2) {
+		get_opt_int(argc, argv, &params->write_buffer_mb,
+			    "write buffer size");
+		get_opt_int(argc, argv, &params->flush_interval_ms,
+			    "flush interval");
+	}
+
+	/* and so are splitting the recording and writing a mirror copy */
+	if (*argc >= 3) {
+		get_opt_int(argc, argv, &params->split_size_mb, "split size");
+		get_opt_int(argc, argv, &params->split_time_sec, "split time");
+		get_opt_str(argc, argv, &params->mirror_file, "mirror file");
+	}
+
 	return true;
 }
 
-static bool new_stream(struct ffmpeg_mux *ffm, AVStream **stream,
+static bool new_stream(struct mux_output *mo, AVStream **stream,
 		       const char *name, AVCodec **codec)
 {
 	const AVCodecDescriptor *desc = avcodec_descriptor_get_by_name(name);
@@ -366,24 +609,24 @@ static bool new_stream(struct ffmpeg_mux *ffm, AVStream **stream,
 		return false;
 	}
 
-	*stream = avformat_new_stream(ffm->output, *codec);
+	*stream = avformat_new_stream(mo->output, *codec);
 	if (!*stream) {
 		fprintf(stderr, "Couldn't create stream for encoder '%s'\n",
 			name);
 		return false;
 	}
 
-	(*stream)->id = ffm->output->nb_streams - 1;
+	(*stream)->id = mo->output->nb_streams - 1;
 	return true;
 }
 
-static void create_video_stream(struct ffmpeg_mux *ffm)
+static void create_video_stream(struct ffmpeg_mux *ffm, struct mux_output *mo)
 {
 	AVCodec *codec;
 	AVCodecContext *context;
 	void *extradata = NULL;
 
-	if (!new_stream(ffm, &ffm->video_stream, ffm->params.vcodec, &codec))
+	if (!new_stream(mo, &mo->video_stream, ffm->params.vcodec, &codec))
 		return;
 
 	if (ffm->video_header.size) {
@@ -394,7 +637,7 @@ static void create_video_stream(struct ffmpeg_mux *ffm)
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
 	context = avcodec_alloc_context3(codec);
 #else
-	context = ffm->video_stream->codec;
+	context = mo->video_stream->codec;
 #endif
 	context->bit_rate = (int64_t)ffm->params.vbitrate * 1000;
 	context->width = ffm->params.width;
@@ -410,31 +653,32 @@ static void create_video_stream(struct ffmpeg_mux *ffm)
 	context->time_base =
 		(AVRational){ffm->params.fps_den, ffm->params.fps_num};
 
-	ffm->video_stream->time_base = context->time_base;
+	mo->video_stream->time_base = context->time_base;
 #if LIBAVFORMAT_VERSION_MAJOR < 59
 	// codec->time_base may still be used if LIBAVFORMAT_VERSION_MAJOR < 59
-	ffm->video_stream->codec->time_base = context->time_base;
+	mo->video_stream->codec->time_base = context->time_base;
 #endif
-	ffm->video_stream->avg_frame_rate = av_inv_q(context->time_base);
+	mo->video_stream->avg_frame_rate = av_inv_q(context->time_base);
 
-	if (ffm->output->oformat->flags & AVFMT_GLOBALHEADER)
+	if (mo->output->oformat->flags & AVFMT_GLOBALHEADER)
 		context->flags |= CODEC_FLAG_GLOBAL_H;
 
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
-	avcodec_parameters_from_context(ffm->video_stream->codecpar, context);
+	avcodec_parameters_from_context(mo->video_stream->codecpar, context);
 #endif
 
-	ffm->video_ctx = context;
+	mo->video_ctx = context;
 }
 
-static void create_audio_stream(struct ffmpeg_mux *ffm, int idx)
+static void create_audio_stream(struct ffmpeg_mux *ffm, struct mux_output *mo,
+				int idx)
 {
 	AVCodec *codec;
 	AVCodecContext *context;
 	AVStream *stream;
 	void *extradata = NULL;
 
-	if (!new_stream(ffm, &stream, ffm->params.acodec, &codec))
+	if (!new_stream(mo, &stream, ffm->params.acodec, &codec))
 		return;
 
 	av_dict_set(&stream->metadata, "title", ffm->audio[idx].name, 0);
@@ -466,32 +710,32 @@ static void create_audio_stream(struct ffmpeg_mux *ffm, int idx)
 	//AVlib default channel layout for 5 channels is 5.0 ; fix for 4.1
 	if (context->channels == 5)
 		context->channel_layout = av_get_channel_layout("4.1");
-	if (ffm->output->oformat->flags & AVFMT_GLOBALHEADER)
+	if (mo->output->oformat->flags & AVFMT_GLOBALHEADER)
 		context->flags |= CODEC_FLAG_GLOBAL_H;
 
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
 	avcodec_parameters_from_context(stream->codecpar, context);
 #endif
 
-	ffm->audio_infos[ffm->num_audio_streams].stream = stream;
-	ffm->audio_infos[ffm->num_audio_streams].ctx = context;
-	ffm->num_audio_streams++;
+	mo->audio_infos[mo->num_audio_streams].stream = stream;
+	mo->audio_infos[mo->num_audio_streams].ctx = context;
+	mo->num_audio_streams++;
 }
 
-static bool init_streams(struct ffmpeg_mux *ffm)
+static bool init_streams(struct ffmpeg_mux *ffm, struct mux_output *mo)
 {
 	if (ffm->params.has_video)
-		create_video_stream(ffm);
+		create_video_stream(ffm, mo);
 
 	if (ffm->params.tracks) {
-		ffm->audio_infos =
-			calloc(ffm->params.tracks, sizeof(*ffm->audio_infos));
+		mo->audio_infos =
+			calloc(ffm->params.tracks, sizeof(*mo->audio_infos));
 
 		for (int i = 0; i < ffm->params.tracks; i++)
-			create_audio_stream(ffm, i);
+			create_audio_stream(ffm, mo, i);
 	}
 
-	if (!ffm->video_stream && !ffm->num_audio_streams)
+	if (!mo->video_stream && !mo->num_audio_streams)
 		return false;
 
 	return true;
@@ -532,24 +776,87 @@ static size_t safe_read(void *vdata, size_t size)
 	return total;
 }
 
-static bool ffmpeg_mux_get_header(struct ffmpeg_mux *ffm)
+static bool open_packet_ring(struct ffmpeg_mux *ffm)
 {
-	struct ffm_packet_info info = {0};
+	struct packet_ring *ring = &ffm->ring;
+	uint64_t capacity = (uint64_t)ffm->params.ring_size_mb * 1024 * 1024;
+
+	ring->shm = os_shmem_open(ffm->params.ring_name,
+				  (size_t)(FFM_RING_HEADER_SIZE + capacity));
+	if (!ring->shm) {
+		fprintf(stderr, "Couldn't open packet ring '%s'\n",
+			ffm->params.ring_name);
+		return false;
+	}
 
-	bool success = safe_read(&info, sizeof(info)) == sizeof(info);
-	if (success) {
-		uint8_t *data = malloc(info.size);
+	/* nothing else needs to find it by name */
+	os_shmem_unlink(ring->shm);
 
-		if (safe_read(data, info.size) == info.size) {
-			ffmpeg_mux_header(ffm, data, &info);
-		} else {
-			success = false;
-		}
+	ring->header = os_shmem_data(ring->shm);
+	ring->data = (uint8_t *)ring->header + FFM_RING_HEADER_SIZE;
+	ring->capacity = capacity;
+
+	if (ring->header->capacity != capacity) {
+		fprintf(stderr, "Packet ring size mismatch\n");
+		return false;
+	}
+
+	return true;
+}
+
+static uint8_t *read_payload(struct ffmpeg_mux *ffm,
+			     struct ffm_packet_info *info, struct resize_buf *rb)
+{
+	struct packet_ring *ring = &ffm->ring;
+
+	if (info->in_ring) {
+		if (!ring->shm || info->size > ring->capacity ||
+		    info->ring_end < info->size)
+			return NULL;
+
+		uint64_t start = (info->ring_end - info->size) % ring->capacity;
+		if (start + info->size > ring->capacity)
+			return NULL;
+
+		return ring->data + start;
+	}
+
+	resize_buf_resize(rb, info->size);
+	if (safe_read(rb->buf, info->size) != info->size)
+		return NULL;
+
+	return rb->buf;
+}
+
+/* hands the ring space of the payload back to obs */
+static void release_payload(struct ffmpeg_mux *ffm,
+			    struct ffm_packet_info *info)
+{
+	struct ffm_ring_header *header = ffm->ring.header;
 
-		free(data);
+	if (info->in_ring && header) {
+		long long read_pos = os_atomic_load_long_long(&header->read_pos);
+		os_atomic_add_long_long(&header->read_pos,
+					(long long)info->ring_end - read_pos);
 	}
+}
+
+static bool ffmpeg_mux_get_header(struct ffmpeg_mux *ffm)
+{
+	struct ffm_packet_info info = {0};
+	struct resize_buf rb = {0};
+	uint8_t *data;
+
+	if (safe_read(&info, sizeof(info)) != sizeof(info))
+		return false;
 
-	return success;
+	data = read_payload(ffm, &info, &rb);
+	if (data)
+		ffmpeg_mux_header(ffm, data, &info);
+
+	release_payload(ffm, &info);
+	resize_buf_free(&rb);
+	return data != NULL;
 }
 
 static inline bool ffmpeg_mux_get_extra_data(struct ffmpeg_mux *ffm)
@@ -573,18 +880,40 @@ static inline bool ffmpeg_mux_get_extra_data(struct ffmpeg_mux *ffm)
 #pragma warning(disable : 4996)
 #endif
 
-static inline int open_output_file(struct ffmpeg_mux *ffm)
+#define SRT_PROTO "srt"
+#define UDP_PROTO "udp"
+#define TCP_PROTO "tcp"
+#define HTTP_PROTO "http"
+
+static bool is_network_path(const char *path)
+{
+	return !strncmp(path, SRT_PROTO, sizeof(SRT_PROTO) - 1) ||
+	       !strncmp(path, UDP_PROTO, sizeof(UDP_PROTO) - 1) ||
+	       !strncmp(path, TCP_PROTO, sizeof(TCP_PROTO) - 1) ||
+	       !strncmp(path, HTTP_PROTO, sizeof(HTTP_PROTO) - 1);
+}
+
+static inline int open_output_file(struct ffmpeg_mux *ffm,
+				   struct mux_output *mo)
 {
-	AVOutputFormat *format = ffm->output->oformat;
+	AVOutputFormat *format = mo->output->oformat;
 	int ret;
 
-	if ((format->flags & AVFMT_NOFILE) == 0) {
-		ret = avio_open(&ffm->output->pb, ffm->params.file,
+	if ((format->flags & AVFMT_NOFILE) == 0 &&
+	    ffm->params.write_buffer_mb > 0 &&
+	    !is_network_path(mo->path.array)) {
+		if (!open_buffered_file(ffm, mo)) {
+			fprintf(stderr, "Couldn't open '%s'\n",
+				mo->printable_path.array);
+			return FFM_ERROR;
+		}
+
+	} else if ((format->flags & AVFMT_NOFILE) == 0) {
+		ret = avio_open(&mo->output->pb, mo->path.array,
 				AVIO_FLAG_WRITE);
 		if (ret < 0) {
 			fprintf(stderr, "Couldn't open '%s', %s\n",
-				ffm->params.printable_file.array,
-				av_err2str(ret));
+				mo->printable_path.array, av_err2str(ret));
 			return FFM_ERROR;
 		}
 	}
@@ -609,10 +938,10 @@ static inline int open_output_file(struct ffmpeg_mux *ffm)
 		printf("\n");
 	}
 
-	ret = avformat_write_header(ffm->output, &dict);
+	ret = avformat_write_header(mo->output, &dict);
 	if (ret < 0) {
 		fprintf(stderr, "Error opening '%s': %s",
-			ffm->params.printable_file.array, av_err2str(ret));
+			mo->printable_path.array, av_err2str(ret));
 
 		av_dict_free(&dict);
 
@@ -624,28 +953,18 @@ static inline int open_output_file(struct ffmpeg_mux *ffm)
 	return FFM_SUCCESS;
 }
 
-#define SRT_PROTO "srt"
-#define UDP_PROTO "udp"
-#define TCP_PROTO "tcp"
-#define HTTP_PROTO "http"
-
-static bool ffmpeg_mux_is_network(struct ffmpeg_mux *ffm)
-{
-	return !strncmp(ffm->params.file, SRT_PROTO, sizeof(SRT_PROTO) - 1) ||
-	       !strncmp(ffm->params.file, UDP_PROTO, sizeof(UDP_PROTO) - 1) ||
-	       !strncmp(ffm->params.file, TCP_PROTO, sizeof(TCP_PROTO) - 1) ||
-	       !strncmp(ffm->params.file, HTTP_PROTO, sizeof(HTTP_PROTO) - 1);
-}
-
-static int ffmpeg_mux_init_context(struct ffmpeg_mux *ffm)
+static int open_output(struct ffmpeg_mux *ffm, struct mux_output *mo,
+		       const char *path, const char *printable_path)
 {
 	AVOutputFormat *output_format;
 	int ret;
 	bool is_http = false;
-	is_http = (strncmp(ffm->params.file, HTTP_PROTO,
-			   sizeof(HTTP_PROTO) - 1) == 0);
+	is_http = (strncmp(path, HTTP_PROTO, sizeof(HTTP_PROTO) - 1) == 0);
 
-	bool is_network = ffmpeg_mux_is_network(ffm);
+	bool is_network = is_network_path(path);
+
+	dstr_copy(&mo->path, path);
+	dstr_copy(&mo->printable_path, printable_path);
 
 	if (is_network) {
 		avformat_network_init();
@@ -654,45 +973,68 @@ static int ffmpeg_mux_init_context(struct ffmpeg_mux *ffm)
 	if (is_network && !is_http)
 		output_format = av_guess_format("mpegts", NULL, "video/M2PT");
 	else
-		output_format = av_guess_format(NULL, ffm->params.file, NULL);
+		output_format = av_guess_format(NULL, path, NULL);
 
 	if (output_format == NULL) {
 		fprintf(stderr, "Couldn't find an appropriate muxer for '%s'\n",
-			ffm->params.printable_file.array);
+			printable_path);
+		close_output(mo);
 		return FFM_ERROR;
 	}
 	printf("info: Output format name and long_name: %s, %s\n",
 	       output_format->name ? output_format->name : "unknown",
 	       output_format->long_name ? output_format->long_name : "unknown");
 
-	ret = avformat_alloc_output_context2(&ffm->output, output_format, NULL,
-					     ffm->params.file);
+	ret = avformat_alloc_output_context2(&mo->output, output_format, NULL,
+					     path);
 	if (ret < 0) {
 		fprintf(stderr, "Couldn't initialize output context: %s\n",
 			av_err2str(ret));
+		close_output(mo);
 		return FFM_ERROR;
 	}
 
-	ffm->output->oformat->video_codec = AV_CODEC_ID_NONE;
-	ffm->output->oformat->audio_codec = AV_CODEC_ID_NONE;
+	mo->output->oformat->video_codec = AV_CODEC_ID_NONE;
+	mo->output->oformat->audio_codec = AV_CODEC_ID_NONE;
 
-	if (!init_streams(ffm)) {
-		free_avformat(ffm);
+	if (!init_streams(ffm, mo)) {
+		close_output(mo);
 		return FFM_ERROR;
 	}
 
-	ret = open_output_file(ffm);
+	ret = open_output_file(ffm, mo);
 	if (ret != FFM_SUCCESS) {
-		free_avformat(ffm);
+		close_output(mo);
 		return ret;
 	}
 
+	mo->initialized = true;
 	return FFM_SUCCESS;
 }
 
+/* a mirror that cannot be written is dropped rather than failing the
+ * recording */
+static void open_mirror(struct ffmpeg_mux *ffm, struct mux_output *mo,
+			int index)
+{
+	char path[FFM_MAX_PATH];
+
+	if (!ffm->params.mirror_file || !*ffm->params.mirror_file)
+		return;
+
+	ffm_get_split_path(path, sizeof(path), ffm->params.mirror_file, index);
+
+	if (open_output(ffm, mo, path, path) != FFM_SUCCESS)
+		fprintf(stderr, "Couldn't open mirror '%s', continuing "
+				"without it\n",
+			path);
+}
+
 static int ffmpeg_mux_init_internal(struct ffmpeg_mux *ffm, int argc,
 				    char *argv[])
 {
+	int ret;
+
 	argc--;
 	argv++;
 	if (!init_params(&argc, &argv, &ffm->params, &ffm->audio))
@@ -707,12 +1049,31 @@ static int ffmpeg_mux_init_internal(struct ffmpeg_mux *ffm, int argc,
 	av_register_all();
 #endif
 
+	if (ffm->params.ring_name && *ffm->params.ring_name &&
+	    ffm->params.ring_size_mb > 0) {
+		if (!open_packet_ring(ffm))
+			return FFM_ERROR;
+	}
+
 	if (!ffmpeg_mux_get_extra_data(ffm))
 		return FFM_ERROR;
 
+	/* splitting and mirroring only make sense for local files */
+	if (is_network_path(ffm->params.file)) {
+		ffm->params.split_size_mb = 0;
+		ffm->params.split_time_sec = 0;
+		ffm->params.mirror_file = NULL;
+	}
+
 	/* ffmpeg does not have a way of telling what's supported
 	 * for a given output format, so we try each possibility */
-	return ffmpeg_mux_init_context(ffm);
+	ret = open_output(ffm, &ffm->out, ffm->params.file,
+			  ffm->params.printable_file.array);
+	if (ret != FFM_SUCCESS)
+		return ret;
+
+	open_mirror(ffm, &ffm->mirror, 0);
+	return FFM_SUCCESS;
 }
 
 static int ffmpeg_mux_init(struct ffmpeg_mux *ffm, int argc, char *argv[])
@@ -723,96 +1084,242 @@ static int ffmpeg_mux_init(struct ffmpeg_mux *ffm, int argc, char *argv[])
 		return ret;
 	}
 
-	ffm->initialized = true;
 	return ret;
 }
 
-static inline int get_index(struct ffmpeg_mux *ffm,
+static inline int get_index(struct mux_output *mo,
 			    struct ffm_packet_info *info)
 {
 	if (info->type == FFM_PACKET_VIDEO) {
-		if (ffm->video_stream) {
-			return ffm->video_stream->id;
+		if (mo->video_stream) {
+			return mo->video_stream->id;
 		}
 	} else {
-		if ((int)info->index < ffm->num_audio_streams) {
-			return ffm->audio_infos[info->index].stream->id;
+		if ((int)info->index < mo->num_audio_streams) {
+			return mo->audio_infos[info->index].stream->id;
 		}
 	}
 
 	return -1;
 }
 
-static AVCodecContext *get_codec_context(struct ffmpeg_mux *ffm,
+static AVCodecContext *get_codec_context(struct mux_output *mo,
 					 struct ffm_packet_info *info)
 {
 	if (info->type == FFM_PACKET_VIDEO) {
-		if (ffm->video_stream) {
-			return ffm->video_ctx;
+		if (mo->video_stream) {
+			return mo->video_ctx;
 		}
 	} else {
-		if ((int)info->index < ffm->num_audio_streams) {
-			return ffm->audio_infos[info->index].ctx;
+		if ((int)info->index < mo->num_audio_streams) {
+			return mo->audio_infos[info->index].ctx;
 		}
 	}
 
 	return NULL;
 }
 
-static inline AVStream *get_stream(struct ffmpeg_mux *ffm, int idx)
+static inline AVStream *get_stream(struct mux_output *mo, int idx)
 {
-	return ffm->output->streams[idx];
+	return mo->output->streams[idx];
 }
 
-static inline int64_t rescale_ts(struct ffmpeg_mux *ffm,
+static inline int64_t rescale_ts(struct mux_output *mo,
 				 AVRational codec_time_base, int64_t val,
 				 int idx)
 {
-	AVStream *stream = get_stream(ffm, idx);
+	AVStream *stream = get_stream(mo, idx);
 
 	return av_rescale_q_rnd(val / codec_time_base.num, codec_time_base,
 				stream->time_base,
 				AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX);
 }
 
-static inline bool ffmpeg_mux_packet(struct ffmpeg_mux *ffm, uint8_t *buf,
-				     struct ffm_packet_info *info)
+/* ------------------------------------------------------------------------- */
+/* file splitting                                                            */
+
+static inline bool split_enabled(struct ffmpeg_mux *ffm)
+{
+	return !ffm->split_failed &&
+	       (ffm->split_requested || ffm->params.split_size_mb > 0 ||
+		ffm->params.split_time_sec > 0);
+}
+
+/* with ahead set, answers whether the split is close enough to open the
+ * next files, which is at 90% of the size or time limit */
+static bool split_due(struct ffmpeg_mux *ffm, int64_t dts_usec, bool ahead)
+{
+	if (ffm->split_requested)
+		return true;
+
+	if (ffm->params.split_size_mb > 0) {
+		int64_t limit = (int64_t)ffm->params.split_size_mb * 1024 * 1024;
+		if (ahead)
+			limit = limit / 10 * 9;
+		if (avio_tell(ffm->out.output->pb) >= limit)
+			return true;
+	}
+
+	if (ffm->params.split_time_sec > 0) {
+		int64_t limit = (int64_t)ffm->params.split_time_sec * 1000000;
+		if (ahead)
+			limit = limit / 10 * 9;
+		if (dts_usec - ffm->out.start_usec >= limit)
+			return true;
+	}
+
+	return false;
+}
+
+static void open_next_files(struct ffmpeg_mux *ffm)
+{
+	char path[FFM_MAX_PATH];
+	int index = ffm->file_index + 1;
+
+	ffm_get_split_path(path, sizeof(path), ffm->params.file, index);
+
+	if (open_output(ffm, &ffm->next, path, path) != FFM_SUCCESS) {
+		fprintf(stderr, "Couldn't open '%s', no longer splitting\n",
+			path);
+		ffm->split_failed = true;
+		return;
+	}
+
+	/* keep mirroring only if the current file is still mirrored */
+	if (ffm->mirror.output)
+		open_mirror(ffm, &ffm->next_mirror, index);
+}
+
+static void switch_files(struct ffmpeg_mux *ffm, int64_t dts_usec)
+{
+	join_close_thread(ffm);
+
+	ffm->closing = ffm->out;
+	ffm->closing_mirror = ffm->mirror;
+	ffm->out = ffm->next;
+	ffm->mirror = ffm->next_mirror;
+	memset(&ffm->next, 0, sizeof(ffm->next));
+	memset(&ffm->next_mirror, 0, sizeof(ffm->next_mirror));
+
+	ffm->out.start_usec = dts_usec;
+	ffm->mirror.start_usec = dts_usec;
+	ffm->file_index++;
+	ffm->split_requested = false;
+
+	if (ffm->ring.header)
+		ffm->ring.header->file_index = (uint32_t)ffm->file_index;
+
+	/* writing the trailer can take a while, the moov atom of a long mp4
+	 * for one, so it must not hold up the new file */
+	if (pthread_create(&ffm->close_thread, NULL, close_thread, ffm) == 0) {
+		ffm->close_thread_active = true;
+	} else {
+		close_output(&ffm->closing);
+		close_output(&ffm->closing_mirror);
+	}
+}
+
+static void check_split(struct ffmpeg_mux *ffm, struct ffm_packet_info *info)
+{
+	AVCodecContext *ctx = get_codec_context(&ffm->out, info);
+	int64_t dts_usec;
+	bool boundary;
+
+	if (!split_enabled(ffm) || !ctx)
+		return;
+
+	dts_usec = av_rescale_q(info->dts / ctx->time_base.num, ctx->time_base,
+				AV_TIME_BASE_Q);
+
+	if (!ffm->next.output && split_due(ffm, dts_usec, true))
+		open_next_files(ffm);
+
+	/* every file has to start on a keyframe to be playable on its own */
+	if (ffm->params.has_video)
+		boundary = info->type == FFM_PACKET_VIDEO && info->keyframe;
+	else
+		boundary = true;
+
+	if (boundary && ffm->next.output && split_due(ffm, dts_usec, false))
+		switch_files(ffm, dts_usec);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int write_to_output(struct ffmpeg_mux *ffm, struct mux_output *mo,
+			   uint8_t *buf, struct ffm_packet_info *info)
 {
-	int idx = get_index(ffm, info);
+	int idx = get_index(mo, info);
 	AVPacket packet = {0};
+	AVStream *stream;
+	int64_t offset;
 
 	/* The muxer might not support video/audio, or multiple audio tracks */
 	if (idx == -1) {
-		return true;
+		return 0;
 	}
 
 	const AVRational codec_time_base =
-		get_codec_context(ffm, info)->time_base;
+		get_codec_context(mo, info)->time_base;
+
+	stream = get_stream(mo, idx);
+	offset = av_rescale_q(mo->start_usec, AV_TIME_BASE_Q,
+			      stream->time_base);
 
 	av_init_packet(&packet);
 
 	packet.data = buf;
 	packet.size = (int)info->size;
 	packet.stream_index = idx;
-	packet.pts = rescale_ts(ffm, codec_time_base, info->pts, idx);
-	packet.dts = rescale_ts(ffm, codec_time_base, info->dts, idx);
+	packet.pts = rescale_ts(mo, codec_time_base, info->pts, idx) - offset;
+	packet.dts = rescale_ts(mo, codec_time_base, info->dts, idx) - offset;
 
 	if (info->keyframe)
 		packet.flags = AV_PKT_FLAG_KEY;
 
-	int ret = av_interleaved_write_frame(ffm->output, &packet);
+	int ret = av_interleaved_write_frame(mo->output, &packet);
 
 	if (ret < 0) {
 		fprintf(stderr, "av_interleaved_write_frame failed: %d: %s\n",
 			ret, av_err2str(ret));
+	} else {
+		flush_buffered_file(ffm, mo);
 	}
 
-	/* Treat "Invalid data found when processing input" and "Invalid argument" as non-fatal */
-	if (ret == AVERROR_INVALIDDATA || ret == -EINVAL) {
-		return true;
+	return ret;
+}
+
+/* Treat "Invalid data found when processing input" and "Invalid argument" as
+ * non-fatal */
+static inline bool is_fatal(int ret)
+{
+	return ret < 0 && ret != AVERROR_INVALIDDATA && ret != -EINVAL;
+}
+
+static inline bool ffmpeg_mux_packet(struct ffmpeg_mux *ffm, uint8_t *buf,
+				     struct ffm_packet_info *info)
+{
+	int ret;
+
+	if (info->split)
+		ffm->split_requested = true;
+
+	check_split(ffm, info);
+
+	ret = write_to_output(ffm, &ffm->out, buf, info);
+	if (ret >= 0)
+		publish_writer_stats(ffm);
+
+	if (ffm->mirror.output &&
+	    is_fatal(write_to_output(ffm, &ffm->mirror, buf, info))) {
+		fprintf(stderr, "Writing mirror '%s' failed, continuing "
+				"without it\n",
+			ffm->mirror.printable_path.array);
+		close_output(&ffm->mirror);
+		discard_output(&ffm->next_mirror);
 	}
 
-	return ret >= 0;
+	return !is_fatal(ret);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -858,13 +1365,15 @@ int main(int argc, char *argv[])
 	}
 
 	while (!fail && safe_read(&info, sizeof(info)) == sizeof(info)) {
-		resize_buf_resize(&rb, info.size);
+		uint8_t *data = read_payload(&ffm, &info, &rb);
 
-		if (safe_read(rb.buf, info.size) == info.size) {
-			fail = !ffmpeg_mux_packet(&ffm, rb.buf, &info);
+		if (data) {
+			fail = !ffmpeg_mux_packet(&ffm, data, &info);
 		} else {
 			fail = true;
 		}
+
+		release_payload(&ffm, &info);
 	}
 
 	ffmpeg_mux_free(&ffm);
@@ -18,6 +18,8 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
 enum ffm_packet_type {
 	FFM_PACKET_VIDEO,
@@ -35,4 +37,64 @@ struct ffm_packet_info {
 	uint32_t index;
 	enum ffm_packet_type type;
 	bool keyframe;
+	/* payload is in the shared ring rather than following on the pipe */
+	bool in_ring;
+	/* ring position just past the payload, when in_ring is set */
+	uint64_t ring_end;
+	/* start a new file at the next keyframe */
+	bool split;
 };
+
+/*
+ * Optional shared memory ring for packet payloads.  Packet info structures
+ * always go through the pipe, which keeps them in order and wakes up the
+ * muxer; a payload that does not fit in the ring follows its info on the
+ * pipe instead.
+ *
+ * Positions only ever increase.  A payload lives at (ring_end - size) modulo
+ * the capacity and never wraps around the end of the buffer, so the writer
+ * skips to the start of the next lap when one would not fit.
+ */
+#define FFM_RING_HEADER_SIZE 64
+
+struct ffm_ring_header {
+	/* written by the muxer once it is done with a payload */
+	volatile long long read_pos;
+	uint64_t capacity;
+
+	/* file writer statistics, refreshed by the muxer after each packet */
+	volatile uint32_t writer_queued;
+	volatile uint32_t writer_max_queued;
+	volatile uint32_t writer_num_blocks;
+	volatile uint32_t writer_stalls;
+	volatile uint64_t writer_stall_ns;
+
+	/* index of the file currently being written, see ffm_get_split_path */
+	volatile uint32_t file_index;
+};
+
+#define FFM_MAX_PATH 4096
+
+/*
+ * Name of the index'th file of a split recording.  The first file keeps the
+ * name it was given and later ones get a counter before the extension, so
+ * "rec.mkv" continues as "rec_002.mkv", "rec_003.mkv" and so on.
+ */
+static inline void ffm_get_split_path(char *dst, size_t size, const char *path,
+				      int index)
+{
+	const char *ext = strrchr(path, '.');
+	const char *slash = strrchr(path, '/');
+	const char *bslash = strrchr(path, '\\');
+
+	if (!index) {
+		snprintf(dst, size, "%s", path);
+		return;
+	}
+
+	if (!ext || (slash && ext < slash) || (bslash && ext < bslash))
+		ext = path + strlen(path);
+
+	snprintf(dst, size, "%.*s_%03d%s", (int)(ext - path), path, index + 1,
+		 ext);
+}
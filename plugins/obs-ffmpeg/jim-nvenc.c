@@ -2,6 +2,8 @@
 #include <util/circlebuf.h>
 #include <util/darray.h>
 #include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
 #include <obs-avc.h>
 #define INITGUID
 #include <dxgi.h>
@@ -11,6 +13,7 @@
 /* ========================================================================= */
 
 #define EXTRA_BUFFERS 5
+#define LOW_LATENCY_BUFFERS 1
 
 #define do_log(level, format, ...)               \
 	blog(level, "[jim-nvenc: '%s'] " format, \
@@ -42,23 +45,37 @@ struct nvenc_data {
 	NV_ENC_INITIALIZE_PARAMS params;
 	NV_ENC_CONFIG config;
 	size_t buf_count;
-	size_t output_delay;
-	size_t buffers_queued;
 	size_t next_bitstream;
 	size_t cur_bitstream;
 	bool encode_started;
 	bool first_packet;
 	bool can_change_bitrate;
 	bool bframes;
+	bool low_latency;
 
 	DARRAY(struct nv_bitstream) bitstreams;
 	DARRAY(struct nv_texture) textures;
 	DARRAY(struct handle_tex) input_textures;
 	struct circlebuf dts_list;
 
+	/* bitstreams are locked on a thread of their own, so that waiting
+	 * for the GPU doesn't hold up the other encoders sharing the GPU
+	 * encode thread.  free_slots counts the buffers that can be
+	 * submitted, submitted wakes the thread for each submitted frame */
+	pthread_t retrieve_thread;
+	bool retrieve_thread_active;
+	os_sem_t *free_slots;
+	os_sem_t *submitted;
+	os_event_t *packet_ready;
+	volatile long queued;
+	volatile bool retrieve_failed;
+
+	/* packets retrieved and not yet returned, a struct nv_packet
+	 * followed by its data each */
+	pthread_mutex_t packets_mutex;
+	struct circlebuf packets;
+
 	DARRAY(uint8_t) packet_data;
-	int64_t packet_pts;
-	bool packet_keyframe;
 
 	ID3D11Device *device;
 	ID3D11DeviceContext *context;
@@ -73,6 +90,12 @@ struct nvenc_data {
 	size_t sei_size;
 };
 
+struct nv_packet {
+	size_t size;
+	int64_t pts;
+	bool keyframe;
+};
+
 /* ------------------------------------------------------------------------- */
 /* Bitstream Buffer                                                          */
 
@@ -94,7 +117,7 @@ static bool nv_bitstream_init(struct nvenc_data *enc, struct nv_bitstream *bs)
 		return false;
 	}
 
-	event = CreateEvent(NULL, true, true, NULL);
+	event = CreateEvent(NULL, false, false, NULL);
 	if (!event) {
 		error("%s: %s", __FUNCTION__, "Failed to create event");
 		goto fail;
@@ -218,14 +241,29 @@ static inline int nv_get_cap(struct nvenc_data *enc, NV_ENC_CAPS cap)
 static bool nvenc_update(void *data, obs_data_t *settings)
 {
 	struct nvenc_data *enc = data;
+	video_t *video = obs_encoder_video(enc->encoder);
+	const struct video_output_info *voi = video_output_get_info(video);
+	int keyint_sec = (int)obs_data_get_int(settings, "keyint_sec");
+	uint32_t gop_size =
+		(keyint_sec) ? keyint_sec * voi->fps_num / voi->fps_den : 250;
+	bool changed = false;
 
-	/* Only support reconfiguration of CBR bitrate */
+	/* the bitrate can only be changed with CBR */
 	if (enc->can_change_bitrate) {
 		int bitrate = (int)obs_data_get_int(settings, "bitrate");
 
 		enc->config.rcParams.averageBitRate = bitrate * 1000;
 		enc->config.rcParams.maxBitRate = bitrate * 1000;
+		changed = true;
+	}
+
+	if (enc->config.gopLength != gop_size) {
+		enc->config.gopLength = gop_size;
+		enc->config.encodeCodecConfig.h264Config.idrPeriod = gop_size;
+		changed = true;
+	}
 
+	if (changed) {
 		NV_ENC_RECONFIGURE_PARAMS params = {0};
 		params.version = NV_ENC_RECONFIGURE_PARAMS_VER;
 		params.reInitEncodeParams = enc->params;
@@ -287,7 +325,12 @@ static bool init_d3d11(struct nvenc_data *enc, obs_data_t *settings)
 		return false;
 	}
 
-	hr = factory->lpVtbl->EnumAdapters(factory, 0, &adapter);
+	/* the input textures are shared by the device OBS renders on, and
+	 * shared handles can only be opened on the same adapter */
+	struct obs_video_info ovi;
+	UINT adapter_idx = obs_get_video_info(&ovi) ? ovi.adapter : 0;
+
+	hr = factory->lpVtbl->EnumAdapters(factory, adapter_idx, &adapter);
 	factory->lpVtbl->Release(factory);
 	if (FAILED(hr)) {
 		error_hr("EnumAdapters failed");
@@ -333,6 +376,8 @@ static bool init_encoder(struct nvenc_data *enc, obs_data_t *settings)
 	bool psycho_aq = obs_data_get_bool(settings, "psycho_aq");
 	bool lookahead = obs_data_get_bool(settings, "lookahead");
 	int bf = (int)obs_data_get_int(settings, "bf");
+	bool low_latency = obs_data_get_bool(settings, "low_latency");
+	bool intra_refresh = false;
 	bool vbr = astrcmpi(rc, "VBR") == 0;
 	NVENCSTATUS err;
 
@@ -434,6 +479,26 @@ static bool init_encoder(struct nvenc_data *enc, obs_data_t *settings)
 		h264_config->outputAUD = 1;
 	}
 
+	/* low latency: every frame comes out as soon as it is encoded, so
+	 * nothing may be held back for reordering or lookahead, and intra
+	 * refresh replaces most keyframes to avoid large bitrate spikes */
+	if (low_latency) {
+		bf = 0;
+		lookahead = false;
+		config->frameIntervalP = 1;
+
+		if (nv_get_cap(enc, NV_ENC_CAPS_SUPPORT_INTRA_REFRESH)) {
+			uint32_t period = voi->fps_num / voi->fps_den;
+			if (period < 2)
+				period = 2;
+
+			h264_config->enableIntraRefresh = 1;
+			h264_config->intraRefreshPeriod = period;
+			h264_config->intraRefreshCnt = period - 1;
+			intra_refresh = true;
+		}
+	}
+
 	vui_params->videoSignalTypePresentFlag = 1;
 	vui_params->videoFullRangeFlag = (voi->range == VIDEO_RANGE_FULL);
 	vui_params->colourDescriptionPresentFlag = 1;
@@ -525,9 +590,15 @@ static bool init_encoder(struct nvenc_data *enc, obs_data_t *settings)
 		return false;
 	}
 
-	enc->buf_count = config->frameIntervalP +
-			 config->rcParams.lookaheadDepth + EXTRA_BUFFERS;
-	enc->output_delay = enc->buf_count - 1;
+	if (low_latency) {
+		enc->buf_count = config->frameIntervalP + LOW_LATENCY_BUFFERS;
+	} else {
+		enc->buf_count = config->frameIntervalP +
+				 config->rcParams.lookaheadDepth +
+				 EXTRA_BUFFERS;
+	}
+
+	enc->low_latency = low_latency;
 
 	info("settings:\n"
 	     "\trate_control: %s\n"
@@ -541,10 +612,13 @@ static bool init_encoder(struct nvenc_data *enc, obs_data_t *settings)
 	     "\t2-pass:       %s\n"
 	     "\tb-frames:     %d\n"
 	     "\tlookahead:    %s\n"
-	     "\tpsycho_aq:    %s\n",
+	     "\tpsycho_aq:    %s\n"
+	     "\tlow_latency:  %s\n"
+	     "\tintra_refresh: %s\n",
 	     rc, bitrate, cqp, gop_size, preset, profile, enc->cx, enc->cy,
 	     twopass ? "true" : "false", bf, lookahead ? "true" : "false",
-	     psycho_aq ? "true" : "false");
+	     psycho_aq ? "true" : "false", low_latency ? "true" : "false",
+	     intra_refresh ? "true" : "false");
 
 	return true;
 }
@@ -579,6 +653,28 @@ static bool init_textures(struct nvenc_data *enc)
 	return true;
 }
 
+static void *retrieve_thread(void *data);
+
+static bool init_retrieve_thread(struct nvenc_data *enc)
+{
+	if (os_sem_init(&enc->free_slots, (int)enc->buf_count) != 0)
+		return false;
+	if (os_sem_init(&enc->submitted, 0) != 0)
+		return false;
+	if (os_event_init(&enc->packet_ready, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+	if (pthread_mutex_init(&enc->packets_mutex, NULL) != 0)
+		return false;
+	if (pthread_create(&enc->retrieve_thread, NULL, retrieve_thread,
+			   enc) != 0) {
+		error("Failed to create retrieve thread");
+		return false;
+	}
+
+	enc->retrieve_thread_active = true;
+	return true;
+}
+
 static void nvenc_destroy(void *data);
 
 static void *nvenc_create(obs_data_t *settings, obs_encoder_t *encoder)
@@ -587,6 +683,7 @@ static void *nvenc_create(obs_data_t *settings, obs_encoder_t *encoder)
 	struct nvenc_data *enc = bzalloc(sizeof(*enc));
 	enc->encoder = encoder;
 	enc->first_packet = true;
+	pthread_mutex_init_value(&enc->packets_mutex);
 
 	/* this encoder requires shared textures, this cannot be used on a
 	 * gpu other than the one OBS is currently running on. */
@@ -614,6 +711,9 @@ static void *nvenc_create(obs_data_t *settings, obs_encoder_t *encoder)
 		goto fail;
 	}
 	if (!init_session(enc)) {
+		/* e.g. OBS rendering on the integrated GPU of a hybrid
+		 * laptop, so frames have to go through system memory */
+		info("rendering adapter can't encode, falling back to ffmpeg");
 		goto fail;
 	}
 	if (!init_encoder(enc, settings)) {
@@ -625,6 +725,9 @@ static void *nvenc_create(obs_data_t *settings, obs_encoder_t *encoder)
 	if (!init_textures(enc)) {
 		goto fail;
 	}
+	if (!init_retrieve_thread(enc)) {
+		goto fail;
+	}
 
 	return enc;
 
@@ -633,8 +736,6 @@ fail:
 	return obs_encoder_create_rerouted(encoder, "ffmpeg_nvenc");
 }
 
-static bool get_encoded_packet(struct nvenc_data *enc, bool finalize);
-
 static void nvenc_destroy(void *data)
 {
 	struct nvenc_data *enc = data;
@@ -647,7 +748,12 @@ static void nvenc_destroy(void *data)
 		params.encodePicFlags = NV_ENC_PIC_FLAG_EOS;
 		params.completionEvent = next_event;
 		nv.nvEncEncodePicture(enc->session, &params);
-		get_encoded_packet(enc, true);
+	}
+	if (enc->retrieve_thread_active) {
+		/* the thread drains the frames still queued before it sees
+		 * this wake-up with nothing queued */
+		os_sem_post(enc->submitted);
+		pthread_join(enc->retrieve_thread, NULL);
 	}
 	for (size_t i = 0; i < enc->textures.num; i++) {
 		nv_texture_free(enc, &enc->textures.array[i]);
@@ -671,9 +777,15 @@ static void nvenc_destroy(void *data)
 		enc->device->lpVtbl->Release(enc->device);
 	}
 
+	os_sem_destroy(enc->free_slots);
+	os_sem_destroy(enc->submitted);
+	os_event_destroy(enc->packet_ready);
+	pthread_mutex_destroy(&enc->packets_mutex);
+
 	bfree(enc->header);
 	bfree(enc->sei);
 	circlebuf_free(&enc->dts_list);
+	circlebuf_free(&enc->packets);
 	da_free(enc->textures);
 	da_free(enc->bitstreams);
 	da_free(enc->input_textures);
@@ -725,80 +837,96 @@ static ID3D11Texture2D *get_tex_from_handle(struct nvenc_data *enc,
 	return input_tex;
 }
 
-static bool get_encoded_packet(struct nvenc_data *enc, bool finalize)
+static bool retrieve_packet(struct nvenc_data *enc, size_t idx)
 {
 	void *s = enc->session;
+	struct nv_bitstream *bs = &enc->bitstreams.array[idx];
+	struct nv_packet pkt;
+	uint8_t *data;
 
-	da_resize(enc->packet_data, 0);
+	WaitForSingleObject(bs->event, INFINITE);
 
-	if (!enc->buffers_queued)
-		return true;
-	if (!finalize && enc->buffers_queued < enc->output_delay)
-		return true;
+	NV_ENC_LOCK_BITSTREAM lock = {NV_ENC_LOCK_BITSTREAM_VER};
+	lock.outputBitstream = bs->ptr;
+	lock.doNotWait = false;
 
-	size_t count = finalize ? enc->buffers_queued : 1;
+	if (NV_FAILED(nv.nvEncLockBitstream(s, &lock))) {
+		return false;
+	}
 
-	for (size_t i = 0; i < count; i++) {
-		size_t cur_bs_idx = enc->cur_bitstream;
-		struct nv_bitstream *bs = &enc->bitstreams.array[cur_bs_idx];
-		struct nv_texture *nvtex = &enc->textures.array[cur_bs_idx];
+	data = lock.bitstreamBufferPtr;
+	pkt.size = lock.bitstreamSizeInBytes;
+	pkt.pts = (int64_t)lock.outputTimeStamp;
+	pkt.keyframe = lock.pictureType == NV_ENC_PIC_TYPE_IDR;
+
+	if (enc->first_packet) {
+		enc->first_packet = false;
+		obs_extract_avc_headers(lock.bitstreamBufferPtr,
+					lock.bitstreamSizeInBytes, &data,
+					&pkt.size, &enc->header,
+					&enc->header_size, &enc->sei,
+					&enc->sei_size);
+	}
 
-		/* ---------------- */
+	pthread_mutex_lock(&enc->packets_mutex);
+	circlebuf_push_back(&enc->packets, &pkt, sizeof(pkt));
+	circlebuf_push_back(&enc->packets, data, pkt.size);
+	pthread_mutex_unlock(&enc->packets_mutex);
 
-		NV_ENC_LOCK_BITSTREAM lock = {NV_ENC_LOCK_BITSTREAM_VER};
-		lock.outputBitstream = bs->ptr;
-		lock.doNotWait = false;
+	if (data != lock.bitstreamBufferPtr)
+		bfree(data);
 
-		if (NV_FAILED(nv.nvEncLockBitstream(s, &lock))) {
-			return false;
-		}
+	if (NV_FAILED(nv.nvEncUnlockBitstream(s, bs->ptr))) {
+		return false;
+	}
 
-		if (enc->first_packet) {
-			uint8_t *new_packet;
-			size_t size;
-
-			enc->first_packet = false;
-			obs_extract_avc_headers(lock.bitstreamBufferPtr,
-						lock.bitstreamSizeInBytes,
-						&new_packet, &size,
-						&enc->header, &enc->header_size,
-						&enc->sei, &enc->sei_size);
-
-			da_copy_array(enc->packet_data, new_packet, size);
-			bfree(new_packet);
-		} else {
-			da_copy_array(enc->packet_data, lock.bitstreamBufferPtr,
-				      lock.bitstreamSizeInBytes);
-		}
+	return true;
+}
 
-		enc->packet_pts = (int64_t)lock.outputTimeStamp;
-		enc->packet_keyframe = lock.pictureType == NV_ENC_PIC_TYPE_IDR;
+static void *retrieve_thread(void *data)
+{
+	struct nvenc_data *enc = data;
 
-		if (NV_FAILED(nv.nvEncUnlockBitstream(s, bs->ptr))) {
-			return false;
-		}
+	os_set_thread_name("nvenc: retrieve packets");
 
-		/* ---------------- */
+	while (os_sem_wait(enc->submitted) == 0) {
+		if (!os_atomic_load_long(&enc->queued))
+			break;
 
-		if (nvtex->mapped_res) {
-			NVENCSTATUS err;
-			err = nv.nvEncUnmapInputResource(s, nvtex->mapped_res);
-			if (nv_failed(enc->encoder, err, __FUNCTION__,
-				      "unmap")) {
-				return false;
-			}
-			nvtex->mapped_res = NULL;
+		if (!retrieve_packet(enc, enc->cur_bitstream)) {
+			os_atomic_set_bool(&enc->retrieve_failed, true);
+			os_sem_post(enc->free_slots);
+			os_event_signal(enc->packet_ready);
+			break;
 		}
 
-		/* ---------------- */
-
 		if (++enc->cur_bitstream == enc->buf_count)
 			enc->cur_bitstream = 0;
 
-		enc->buffers_queued--;
+		os_atomic_dec_long(&enc->queued);
+		os_sem_post(enc->free_slots);
+		os_event_signal(enc->packet_ready);
 	}
 
-	return true;
+	return NULL;
+}
+
+/* returns false if there is no packet ready */
+static bool pop_packet(struct nvenc_data *enc, struct nv_packet *pkt)
+{
+	bool ready = false;
+
+	pthread_mutex_lock(&enc->packets_mutex);
+	if (enc->packets.size) {
+		circlebuf_pop_front(&enc->packets, pkt, sizeof(*pkt));
+		da_resize(enc->packet_data, pkt->size);
+		circlebuf_pop_front(&enc->packets, enc->packet_data.array,
+				    pkt->size);
+		ready = true;
+	}
+	pthread_mutex_unlock(&enc->packets_mutex);
+
+	return ready;
 }
 
 static bool nvenc_encode_tex(void *data, uint32_t handle, int64_t pts,
@@ -814,8 +942,14 @@ static bool nvenc_encode_tex(void *data, uint32_t handle, int64_t pts,
 	IDXGIKeyedMutex *km;
 	struct nv_texture *nvtex;
 	struct nv_bitstream *bs;
+	struct nv_packet pkt;
 	NVENCSTATUS err;
 
+	if (os_atomic_load_bool(&enc->retrieve_failed)) {
+		*next_key = lock_key;
+		return false;
+	}
+
 	if (handle == GS_INVALID_HANDLE) {
 		error("Encode failed: bad texture handle");
 		*next_key = lock_key;
@@ -833,12 +967,27 @@ static bool nvenc_encode_tex(void *data, uint32_t handle, int64_t pts,
 		return false;
 	}
 
-	circlebuf_push_back(&enc->dts_list, &pts, sizeof(pts));
-
 	/* ------------------------------------ */
 	/* wait for output bitstream/tex        */
 
-	WaitForSingleObject(bs->event, INFINITE);
+	os_sem_wait(enc->free_slots);
+
+	if (os_atomic_load_bool(&enc->retrieve_failed)) {
+		*next_key = lock_key;
+		return false;
+	}
+
+	if (nvtex->mapped_res) {
+		err = nv.nvEncUnmapInputResource(enc->session,
+						 nvtex->mapped_res);
+		nvtex->mapped_res = NULL;
+		if (nv_failed(enc->encoder, err, __FUNCTION__, "unmap")) {
+			*next_key = lock_key;
+			return false;
+		}
+	}
+
+	circlebuf_push_back(&enc->dts_list, &pts, sizeof(pts));
 
 	/* ------------------------------------ */
 	/* copy to output tex                   */
@@ -875,6 +1024,9 @@ static bool nvenc_encode_tex(void *data, uint32_t handle, int64_t pts,
 	params.outputBitstream = bs->ptr;
 	params.completionEvent = bs->event;
 
+	if (obs_encoder_keyframe_requested(enc->encoder))
+		params.encodePicFlags |= NV_ENC_PIC_FLAG_FORCEIDR;
+
 	err = nv.nvEncEncodePicture(enc->session, &params);
 	if (err != NV_ENC_SUCCESS && err != NV_ENC_ERR_NEED_MORE_INPUT) {
 		nv_failed(enc->encoder, err, __FUNCTION__,
@@ -883,23 +1035,28 @@ static bool nvenc_encode_tex(void *data, uint32_t handle, int64_t pts,
 	}
 
 	enc->encode_started = true;
-	enc->buffers_queued++;
+	os_atomic_inc_long(&enc->queued);
+	os_sem_post(enc->submitted);
 
 	if (++enc->next_bitstream == enc->buf_count) {
 		enc->next_bitstream = 0;
 	}
 
 	/* ------------------------------------ */
-	/* check for encoded packet and parse   */
+	/* output encoded packet                */
 
-	if (!get_encoded_packet(enc, false)) {
-		return false;
-	}
+	bool ready = pop_packet(enc, &pkt);
 
-	/* ------------------------------------ */
-	/* output encoded packet                */
+	/* low latency waits for the frame that was just submitted rather
+	 * than returning it on a later call, b-frames can't come out in
+	 * submission order so those are never waited for */
+	while (!ready && enc->low_latency && !enc->bframes &&
+	       !os_atomic_load_bool(&enc->retrieve_failed)) {
+		os_event_wait(enc->packet_ready);
+		ready = pop_packet(enc, &pkt);
+	}
 
-	if (enc->packet_data.num) {
+	if (ready) {
 		int64_t dts;
 		circlebuf_pop_front(&enc->dts_list, &dts, sizeof(dts));
 
@@ -911,9 +1068,9 @@ static bool nvenc_encode_tex(void *data, uint32_t handle, int64_t pts,
 		packet->data = enc->packet_data.array;
 		packet->size = enc->packet_data.num;
 		packet->type = OBS_ENCODER_VIDEO;
-		packet->pts = enc->packet_pts;
+		packet->pts = pkt.pts;
 		packet->dts = dts;
-		packet->keyframe = enc->packet_keyframe;
+		packet->keyframe = pkt.keyframe;
 	} else {
 		*received_packet = false;
 	}
@@ -954,7 +1111,8 @@ struct obs_encoder_info nvenc_info = {
 	.id = "jim_nvenc",
 	.codec = "h264",
 	.type = OBS_ENCODER_VIDEO,
-	.caps = OBS_ENCODER_CAP_PASS_TEXTURE | OBS_ENCODER_CAP_DYN_BITRATE,
+	.caps = OBS_ENCODER_CAP_PASS_TEXTURE | OBS_ENCODER_CAP_DYN_BITRATE |
+		OBS_ENCODER_CAP_KEYFRAME_REQUEST,
 	.get_name = nvenc_get_name,
 	.create = nvenc_create,
 	.destroy = nvenc_destroy,
@@ -33,7 +33,7 @@ void ffmpeg_hls_mux_destroy(void *data)
 		da_free(stream->mux_packets);
 		circlebuf_free(&stream->packets);
 
-		os_process_pipe_destroy(stream->pipe);
+		stop_pipe(stream);
 		dstr_free(&stream->path);
 		dstr_free(&stream->printable_path);
 		dstr_free(&stream->stream_key);
@@ -56,6 +56,8 @@ void *ffmpeg_hls_mux_create(obs_data_t *settings, obs_output_t *output)
 	if (os_sem_init(&stream->write_sem, 0) != 0)
 		goto fail;
 
+	ffmpeg_mux_add_signals(output);
+
 	UNUSED_PARAMETER(settings);
 	return stream;
 
@@ -292,7 +294,11 @@ void ffmpeg_hls_mux_data(void *data, struct encoder_packet *packet)
 	}
 
 	if (packet->type == OBS_ENCODER_VIDEO) {
-		obs_parse_avc_packet(&tmp_packet, packet);
+		const char *codec = obs_encoder_get_codec(packet->encoder);
+		if (strcmp(codec, "hevc") == 0)
+			obs_parse_hevc_packet(&tmp_packet, packet);
+		else
+			obs_parse_avc_packet(&tmp_packet, packet);
 		packet->drop_priority = tmp_packet.priority;
 		obs_encoder_packet_release(&tmp_packet);
 	}
@@ -319,7 +325,7 @@ struct obs_output_info ffmpeg_hls_muxer = {
 	.id = "ffmpeg_hls_muxer",
 	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED | OBS_OUTPUT_MULTI_TRACK |
 		 OBS_OUTPUT_SERVICE,
-	.encoded_video_codecs = "h264",
+	.encoded_video_codecs = "h264;hevc",
 	.encoded_audio_codecs = "aac",
 	.get_name = ffmpeg_hls_mux_getname,
 	.create = ffmpeg_hls_mux_create,
@@ -21,6 +21,8 @@
 #include "util/windows/win-version.h"
 #endif
 
+#include <inttypes.h>
+
 #include <libavformat/avformat.h>
 
 #define do_log(level, format, ...)                  \
@@ -30,6 +32,21 @@
 #define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
 #define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
 
+/* default size of the shared packet ring, set "ring_buffer_mb" to 0 to only
+ * use the pipe */
+#define DEFAULT_RING_BUFFER_MB 32
+
+/* files are written in chunks of this size ("write_buffer_mb"), and a
+ * fragmented recording is pushed to disk at least this often
+ * ("fragment_flush_ms") */
+#define DEFAULT_WRITE_BUFFER_MB 4
+#define DEFAULT_FRAGMENT_FLUSH_MS 5000
+
+/* plain mp4/mov only become playable once the trailer is written; with
+ * fragments every flushed moof/mdat pair is playable right away */
+#define FRAGMENTED_MOVFLAGS \
+	"movflags=frag_keyframe+empty_moov+default_base_moof"
+
 static const char *ffmpeg_mux_getname(void *type)
 {
 	UNUSED_PARAMETER(type);
@@ -42,34 +59,55 @@ static const char *ffmpeg_mpegts_mux_getname(void *type)
 	return obs_module_text("FFmpegMpegtsMuxer");
 }
 
+static void free_spill(struct ffmpeg_muxer *stream)
+{
+	os_shmem_destroy(stream->spill);
+	stream->spill = NULL;
+	stream->spill_data = NULL;
+	stream->spill_capacity = 0;
+}
+
 static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 {
 	while (stream->packets.size > 0) {
-		struct encoder_packet pkt;
-		circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
-		obs_encoder_packet_release(&pkt);
+		struct replay_packet rp;
+		circlebuf_pop_front(&stream->packets, &rp, sizeof(rp));
+		if (!rp.spilled)
+			obs_encoder_packet_release(&rp.packet);
 	}
 
 	circlebuf_free(&stream->packets);
+	circlebuf_free(&stream->keyframe_seqs);
 	stream->cur_size = 0;
 	stream->cur_time = 0;
 	stream->max_size = 0;
 	stream->max_time = 0;
 	stream->save_ts = 0;
-	stream->keyframes = 0;
+	stream->first_seq = 0;
+	stream->next_seq = 0;
+	stream->max_mem = 0;
+	stream->mem_size = 0;
+	stream->num_spilled = 0;
+	stream->spill_pos = 0;
+	stream->spill_read = 0;
+
+	/* a save that is still running keeps reading from the spill file, it
+	 * gets freed when the buffer is started again or destroyed */
+	if (!os_atomic_load_bool(&stream->spill_pinned))
+		free_spill(stream);
 }
 
 static void ffmpeg_mux_destroy(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
 
-	replay_buffer_clear(stream);
 	if (stream->mux_thread_joinable)
 		pthread_join(stream->mux_thread, NULL);
+	replay_buffer_clear(stream);
 	da_free(stream->mux_packets);
 	circlebuf_free(&stream->packets);
 
-	os_process_pipe_destroy(stream->pipe);
+	stop_pipe(stream);
 	dstr_free(&stream->path);
 	dstr_free(&stream->printable_path);
 	dstr_free(&stream->stream_key);
@@ -77,14 +115,54 @@ static void ffmpeg_mux_destroy(void *data)
 	bfree(stream);
 }
 
+static void get_writer_stats(void *data, calldata_t *cd)
+{
+	struct ffmpeg_muxer *stream = data;
+
+	calldata_set_int(cd, "queued",
+			 os_atomic_load_long(&stream->writer_queued));
+	calldata_set_int(cd, "max_queued",
+			 os_atomic_load_long(&stream->writer_max_queued));
+	calldata_set_int(cd, "num_blocks",
+			 os_atomic_load_long(&stream->writer_num_blocks));
+	calldata_set_int(cd, "stalls",
+			 os_atomic_load_long(&stream->writer_stalls));
+	calldata_set_float(cd, "stall_ms",
+			   (double)os_atomic_load_long(&stream->writer_stall_ms));
+}
+
+static void split_file_proc(void *data, calldata_t *cd)
+{
+	struct ffmpeg_muxer *stream = data;
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
+
+	os_atomic_set_bool(&stream->split_requested, true);
+
+	/* the split happens on the next keyframe */
+	if (vencoder)
+		obs_encoder_request_keyframe(vencoder);
+	UNUSED_PARAMETER(cd);
+}
+
 static void *ffmpeg_mux_create(obs_data_t *settings, obs_output_t *output)
 {
 	struct ffmpeg_muxer *stream = bzalloc(sizeof(*stream));
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+
 	stream->output = output;
 
 	if (obs_output_get_flags(output) & OBS_OUTPUT_SERVICE)
 		stream->is_network = true;
 
+	ffmpeg_mux_add_signals(output);
+
+	proc_handler_add(ph,
+			 "void get_writer_stats(out int queued, "
+			 "out int max_queued, out int num_blocks, "
+			 "out int stalls, out float stall_ms)",
+			 get_writer_stats, stream);
+	proc_handler_add(ph, "void split_file()", split_file_proc, stream);
+
 	UNUSED_PARAMETER(settings);
 	return stream;
 }
@@ -110,8 +188,6 @@ bool active(struct ffmpeg_muxer *stream)
 	return os_atomic_load_bool(&stream->active);
 }
 
-/* TODO: allow codecs other than h264 whenever we start using them */
-
 static void add_video_encoder_params(struct ffmpeg_muxer *stream,
 				     struct dstr *cmd, obs_encoder_t *vencoder)
 {
@@ -223,6 +299,13 @@ static void add_muxer_params(struct dstr *cmd, struct ffmpeg_muxer *stream)
 		dstr_copy(&mux, stream->muxer_settings.array);
 	}
 
+	if (stream->fragmented && !strstr(mux.array ? mux.array : "",
+					  "movflags")) {
+		if (!dstr_is_empty(&mux))
+			dstr_insert(&mux, 0, " ");
+		dstr_insert(&mux, 0, FRAGMENTED_MOVFLAGS);
+	}
+
 	log_muxer_params(stream, mux.array);
 
 	dstr_replace(&mux, "\"", "\\\"");
@@ -232,6 +315,25 @@ static void add_muxer_params(struct dstr *cmd, struct ffmpeg_muxer *stream)
 	dstr_free(&mux);
 }
 
+static bool is_fragmented(struct ffmpeg_muxer *stream, const char *path)
+{
+	obs_data_t *settings;
+	const char *ext;
+	bool fragmented;
+
+	if (stream->is_network)
+		return false;
+
+	ext = strrchr(path, '.');
+	if (!ext || (astrcmpi(ext, ".mp4") != 0 && astrcmpi(ext, ".mov") != 0))
+		return false;
+
+	settings = obs_output_get_settings(stream->output);
+	fragmented = obs_data_get_bool(settings, "fragmented");
+	obs_data_release(settings);
+	return fragmented;
+}
+
 static void build_command_line(struct ffmpeg_muxer *stream, struct dstr *cmd,
 			       const char *path)
 {
@@ -270,16 +372,136 @@ static void build_command_line(struct ffmpeg_muxer *stream, struct dstr *cmd,
 		}
 	}
 
+	stream->fragmented = is_fragmented(stream, path);
+
 	add_stream_key(cmd, stream);
 	add_muxer_params(cmd, stream);
 }
 
+static void add_file_params(struct ffmpeg_muxer *stream, struct dstr *cmd)
+{
+	obs_data_t *settings = obs_output_get_settings(stream->output);
+	int buffer_mb = DEFAULT_WRITE_BUFFER_MB;
+	int flush_ms = DEFAULT_FRAGMENT_FLUSH_MS;
+
+	if (obs_data_has_user_value(settings, "write_buffer_mb"))
+		buffer_mb = (int)obs_data_get_int(settings, "write_buffer_mb");
+	if (obs_data_has_user_value(settings, "fragment_flush_ms"))
+		flush_ms = (int)obs_data_get_int(settings, "fragment_flush_ms");
+
+	dstr_catf(cmd, "%d %d ", buffer_mb, stream->fragmented ? flush_ms : 0);
+
+	/* splitting (by size, by time or through split_file) and the mirror
+	 * copy are muxer options too, so neither restarts the encoders */
+	struct dstr mirror = {0};
+	dstr_copy(&mirror, obs_data_get_string(settings, "mirror_path"));
+	dstr_replace(&mirror, "\"", "\"\"");
+
+	dstr_catf(cmd, "%d %d \"%s\" ",
+		  (int)obs_data_get_int(settings, "split_file_size_mb"),
+		  (int)obs_data_get_int(settings, "split_file_time_sec"),
+		  mirror.array ? mirror.array : "");
+
+	dstr_free(&mirror);
+	obs_data_release(settings);
+}
+
+void ffmpeg_mux_add_signals(obs_output_t *output)
+{
+	signal_handler_t *sh = obs_output_get_signal_handler(output);
+	signal_handler_add(sh, "void ring_buffer_full()");
+	signal_handler_add(sh, "void file_changed(string next_file)");
+}
+
+static int get_ring_buffer_mb(struct ffmpeg_muxer *stream)
+{
+	obs_data_t *settings = obs_output_get_settings(stream->output);
+	int size_mb = DEFAULT_RING_BUFFER_MB;
+
+	if (obs_data_has_user_value(settings, "ring_buffer_mb"))
+		size_mb = (int)obs_data_get_int(settings, "ring_buffer_mb");
+
+	obs_data_release(settings);
+	return size_mb;
+}
+
+static void free_ring(struct ffmpeg_muxer *stream)
+{
+	if (stream->ring_overflows)
+		info("%" PRIu64 " packets did not fit in the ring buffer "
+		     "and were sent through the pipe",
+		     stream->ring_overflows);
+
+	os_shmem_destroy(stream->ring_shm);
+	stream->ring_shm = NULL;
+	stream->ring = NULL;
+	stream->ring_data = NULL;
+	stream->ring_pos = 0;
+	stream->file_index = 0;
+	stream->ring_full = false;
+	stream->ring_overflows = 0;
+}
+
+/* adds the ring arguments to the command line; without a ring they are
+ * empty and ffmpeg-mux reads everything from the pipe */
+static void create_ring(struct ffmpeg_muxer *stream, struct dstr *cmd)
+{
+	static volatile long ring_id = 0;
+	int size_mb = get_ring_buffer_mb(stream);
+	uint64_t capacity;
+	struct dstr name = {0};
+
+	if (size_mb <= 0)
+		goto no_ring;
+
+	capacity = (uint64_t)size_mb * 1024 * 1024;
+
+	dstr_printf(&name, "obs-mux-%d-%ld", os_getpid(),
+		    os_atomic_inc_long(&ring_id));
+
+	stream->ring_shm = os_shmem_create(
+		name.array, (size_t)(FFM_RING_HEADER_SIZE + capacity));
+	if (!stream->ring_shm) {
+		warn("Failed to create %d MB ring buffer, using the pipe "
+		     "only",
+		     size_mb);
+		dstr_free(&name);
+		goto no_ring;
+	}
+
+	stream->ring = os_shmem_data(stream->ring_shm);
+	stream->ring->capacity = capacity;
+	stream->ring_data = (uint8_t *)stream->ring + FFM_RING_HEADER_SIZE;
+
+	dstr_catf(cmd, "\"%s\" %d ", name.array, size_mb);
+	dstr_free(&name);
+	return;
+
+no_ring:
+	dstr_cat(cmd, "\"\" 0 ");
+}
+
 void start_pipe(struct ffmpeg_muxer *stream, const char *path)
 {
 	struct dstr cmd;
 	build_command_line(stream, &cmd, path);
+	create_ring(stream, &cmd);
+	add_file_params(stream, &cmd);
 	stream->pipe = os_process_pipe_create(cmd.array, "w");
 	dstr_free(&cmd);
+
+	if (!stream->pipe)
+		free_ring(stream);
+}
+
+int stop_pipe(struct ffmpeg_muxer *stream)
+{
+	int ret = os_process_pipe_destroy(stream->pipe);
+	stream->pipe = NULL;
+
+	/* the pipe has closed, so ffmpeg-mux is done with the ring */
+	free_ring(stream);
+	return ret;
 }
 
 static void set_file_not_readable_error(struct ffmpeg_muxer *stream,
@@ -355,6 +577,7 @@ static bool ffmpeg_mux_start(void *data)
 	os_atomic_set_bool(&stream->active, true);
 	os_atomic_set_bool(&stream->capturing, true);
 	stream->total_bytes = 0;
+	os_atomic_set_bool(&stream->split_requested, false);
 	obs_output_begin_data_capture(stream->output, 0);
 
 	info("Writing file '%s'...", stream->path.array);
@@ -375,8 +598,7 @@ int deactivate(struct ffmpeg_muxer *stream, int code)
 	}
 
 	if (active(stream)) {
-		ret = os_process_pipe_destroy(stream->pipe);
-		stream->pipe = NULL;
+		ret = stop_pipe(stream);
 
 		os_atomic_set_bool(&stream->active, false);
 		os_atomic_set_bool(&stream->sent_headers, false);
@@ -456,6 +678,104 @@ static void signal_failure(struct ffmpeg_muxer *stream)
 	os_atomic_set_bool(&stream->capturing, false);
 }
 
+/* reserves contiguous ring space for a payload; returns false when the muxer
+ * has not caught up far enough yet */
+static bool reserve_ring(struct ffmpeg_muxer *stream, size_t size,
+			 uint8_t **data, uint64_t *end)
+{
+	const uint64_t capacity = stream->ring->capacity;
+	uint64_t pos = stream->ring_pos;
+	uint64_t offset = pos % capacity;
+	uint64_t read_pos;
+
+	if (size > capacity)
+		return false;
+
+	/* payloads never wrap, so skip to the start of the next lap */
+	if (offset + size > capacity) {
+		pos += capacity - offset;
+		offset = 0;
+	}
+
+	read_pos = (uint64_t)os_atomic_load_long_long(&stream->ring->read_pos);
+	if (pos + size - read_pos > capacity)
+		return false;
+
+	stream->ring_pos = pos + size;
+	*data = stream->ring_data + offset;
+	*end = pos + size;
+	return true;
+}
+
+static void write_to_ring(struct ffmpeg_muxer *stream,
+			  struct encoder_packet *packet,
+			  struct ffm_packet_info *info)
+{
+	uint8_t *data;
+
+	if (!stream->ring || !packet->size)
+		return;
+
+	if (!reserve_ring(stream, packet->size, &data, &info->ring_end)) {
+		/* the muxer is falling behind, so the pipe (and with it this
+		 * thread) takes the back-pressure until it catches up */
+		if (!stream->ring_full) {
+			calldata_t cd = {0};
+			signal_handler_t *sh =
+				obs_output_get_signal_handler(stream->output);
+
+			warn("Ring buffer full, muxer is falling behind");
+			signal_handler_signal(sh, "ring_buffer_full", &cd);
+			stream->ring_full = true;
+		}
+
+		stream->ring_overflows++;
+		return;
+	}
+
+	memcpy(data, packet->data, packet->size);
+	info->in_ring = true;
+	stream->ring_full = false;
+}
+
+/* the muxer refreshes these after every packet it writes */
+static void read_writer_stats(struct ffmpeg_muxer *stream)
+{
+	struct ffm_ring_header *ring = stream->ring;
+
+	if (!ring)
+		return;
+
+	os_atomic_set_long(&stream->writer_queued, (long)ring->writer_queued);
+	os_atomic_set_long(&stream->writer_max_queued,
+			   (long)ring->writer_max_queued);
+	os_atomic_set_long(&stream->writer_num_blocks,
+			   (long)ring->writer_num_blocks);
+	os_atomic_set_long(&stream->writer_stalls, (long)ring->writer_stalls);
+	os_atomic_set_long(&stream->writer_stall_ms,
+			   (long)(ring->writer_stall_ns / 1000000));
+
+	if (ring->file_index != stream->file_index) {
+		signal_handler_t *sh =
+			obs_output_get_signal_handler(stream->output);
+		obs_data_t *settings = obs_output_get_settings(stream->output);
+		char next_file[FFM_MAX_PATH];
+		calldata_t cd = {0};
+
+		stream->file_index = ring->file_index;
+		ffm_get_split_path(next_file, sizeof(next_file),
+				   obs_data_get_string(settings, "path"),
+				   (int)stream->file_index);
+		obs_data_release(settings);
+
+		info("Continuing in file '%s'", next_file);
+
+		calldata_set_string(&cd, "next_file", next_file);
+		signal_handler_signal(sh, "file_changed", &cd);
+		calldata_free(&cd);
+	}
+}
+
 bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet)
 {
 	bool is_video = packet->type == OBS_ENCODER_VIDEO;
@@ -469,6 +789,13 @@ bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet)
 							: FFM_PACKET_AUDIO,
 				       .keyframe = packet->keyframe};
 
+	if (is_video && os_atomic_load_bool(&stream->split_requested))
+		info.split = os_atomic_exchange_bool(&stream->split_requested,
+						     false);
+
+	write_to_ring(stream, packet, &info);
+	read_writer_stats(stream);
+
 	ret = os_process_pipe_write(stream->pipe, (const uint8_t *)&info,
 				    sizeof(info));
 	if (ret != sizeof(info)) {
@@ -477,6 +804,11 @@ bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet)
 		return false;
 	}
 
+	if (info.in_ring) {
+		stream->total_bytes += packet->size;
+		return true;
+	}
+
 	ret = os_process_pipe_write(stream->pipe, packet->data, packet->size);
 	if (ret != packet->size) {
 		warn("os_process_pipe_write for packet data failed");
@@ -609,7 +941,7 @@ struct obs_output_info ffmpeg_mpegts_muxer = {
 	.id = "ffmpeg_mpegts_muxer",
 	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED | OBS_OUTPUT_MULTI_TRACK |
 		 OBS_OUTPUT_SERVICE,
-	.encoded_video_codecs = "h264",
+	.encoded_video_codecs = "h264;hevc",
 	.encoded_audio_codecs = "aac",
 	.get_name = ffmpeg_mpegts_mux_getname,
 	.create = ffmpeg_mux_create,
@@ -685,6 +1017,7 @@ static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
 
 	signal_handler_t *sh = obs_output_get_signal_handler(output);
 	signal_handler_add(sh, "void saved()");
+	ffmpeg_mux_add_signals(output);
 
 	return stream;
 }
@@ -697,6 +1030,54 @@ static void replay_buffer_destroy(void *data)
 	ffmpeg_mux_destroy(data);
 }
 
+static void create_spill(struct ffmpeg_muxer *stream, obs_data_t *settings)
+{
+	static volatile long spill_id = 0;
+	const char *dir = obs_data_get_string(settings, "spill_directory");
+	struct dstr path = {0};
+
+	if (!stream->max_mem)
+		return;
+
+	/* the size limit is what bounds the spill file */
+	if (!stream->max_size || stream->max_mem >= stream->max_size) {
+		stream->max_mem = 0;
+		return;
+	}
+
+	if (!dir || !*dir)
+		dir = obs_data_get_string(settings, "directory");
+
+	dstr_copy(&path, dir);
+	dstr_replace(&path, "\\", "/");
+	if (path.len && dstr_end(&path) != '/')
+		dstr_cat_ch(&path, '/');
+	os_mkdirs(path.array);
+	dstr_catf(&path, ".obs-replay-%d-%ld.spill", os_getpid(),
+		  os_atomic_inc_long(&spill_id));
+
+	/* leave room for payloads skipped to the start of the next lap */
+	stream->spill_capacity =
+		(uint64_t)stream->max_size + (uint64_t)stream->max_size / 8;
+	stream->spill = os_shmem_create_file(path.array,
+					     (size_t)stream->spill_capacity);
+
+	if (stream->spill) {
+		stream->spill_data = os_shmem_data(stream->spill);
+		info("Keeping %" PRId64 " MB of the replay buffer in memory, "
+		     "the rest in '%s'",
+		     stream->max_mem / (1024 * 1024), path.array);
+	} else {
+		warn("Failed to create spill file '%s', keeping the replay "
+		     "buffer in memory",
+		     path.array);
+		stream->spill_capacity = 0;
+		stream->max_mem = 0;
+	}
+
+	dstr_free(&path);
+}
+
 static bool replay_buffer_start(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -706,9 +1087,18 @@ static bool replay_buffer_start(void *data)
 	if (!obs_output_initialize_encoders(stream->output, 0))
 		return false;
 
+	/* a save from the last session may still be reading the spill file */
+	if (stream->mux_thread_joinable) {
+		pthread_join(stream->mux_thread, NULL);
+		stream->mux_thread_joinable = false;
+	}
+	free_spill(stream);
+
 	obs_data_t *s = obs_output_get_settings(stream->output);
 	stream->max_time = obs_data_get_int(s, "max_time_sec") * 1000000LL;
 	stream->max_size = obs_data_get_int(s, "max_size_mb") * (1024 * 1024);
+	stream->max_mem = obs_data_get_int(s, "max_memory_mb") * (1024 * 1024);
+	create_spill(stream, s);
 	obs_data_release(s);
 
 	os_atomic_set_bool(&stream->active, true);
@@ -721,43 +1111,54 @@ static bool replay_buffer_start(void *data)
 
 static bool purge_front(struct ffmpeg_muxer *stream)
 {
-	struct encoder_packet pkt;
+	struct replay_packet rp;
 	bool keyframe;
 
-	circlebuf_pop_front(&stream->packets, &pkt, sizeof(pkt));
+	circlebuf_pop_front(&stream->packets, &rp, sizeof(rp));
+	stream->first_seq++;
 
-	keyframe = pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe;
+	keyframe = rp.packet.type == OBS_ENCODER_VIDEO && rp.packet.keyframe;
 
 	if (keyframe)
-		stream->keyframes--;
+		circlebuf_pop_front(&stream->keyframe_seqs, NULL,
+				    sizeof(uint64_t));
 
 	if (!stream->packets.size) {
 		stream->cur_size = 0;
 		stream->cur_time = 0;
 	} else {
-		struct encoder_packet first;
-		circlebuf_peek_front(&stream->packets, &first, sizeof(first));
-		stream->cur_time = first.dts_usec;
-		stream->cur_size -= (int64_t)pkt.size;
+		struct replay_packet *first =
+			circlebuf_data(&stream->packets, 0);
+		stream->cur_time = first->packet.dts_usec;
+		stream->cur_size -= (int64_t)rp.packet.size;
+	}
+
+	if (rp.spilled) {
+		stream->spill_read = rp.spill_end;
+		stream->num_spilled--;
+	} else {
+		stream->mem_size -= (int64_t)rp.packet.size;
+		obs_encoder_packet_release(&rp.packet);
 	}
 
-	obs_encoder_packet_release(&pkt);
 	return keyframe;
 }
 
+static inline size_t num_keyframes(struct ffmpeg_muxer *stream)
+{
+	return stream->keyframe_seqs.size / sizeof(uint64_t);
+}
+
+/* drops the oldest group of pictures; the keyframe index tells how far */
 static inline void purge(struct ffmpeg_muxer *stream)
 {
 	if (purge_front(stream)) {
-		struct encoder_packet pkt;
-
-		for (;;) {
-			circlebuf_peek_front(&stream->packets, &pkt,
-					     sizeof(pkt));
-			if (pkt.type == OBS_ENCODER_VIDEO && pkt.keyframe)
-				return;
+		uint64_t next_keyframe;
 
+		circlebuf_peek_front(&stream->keyframe_seqs, &next_keyframe,
+				     sizeof(next_keyframe));
+		while (stream->first_seq < next_keyframe)
 			purge_front(stream);
-		}
 	}
 }
 
@@ -765,7 +1166,7 @@ static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
 				       struct encoder_packet *pkt)
 {
 	if (stream->max_size) {
-		if (!stream->packets.size || stream->keyframes <= 2)
+		if (!stream->packets.size || num_keyframes(stream) <= 2)
 			return;
 
 		while ((stream->cur_size + (int64_t)pkt->size) >
@@ -773,44 +1174,116 @@ static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
 			purge(stream);
 	}
 
-	if (!stream->packets.size || stream->keyframes <= 2)
+	if (!stream->packets.size || num_keyframes(stream) <= 2)
 		return;
 
 	while ((pkt->dts_usec - stream->cur_time) > stream->max_time)
 		purge(stream);
 }
 
-static void insert_packet(struct darray *array, struct encoder_packet *packet,
+/* copies a payload to the spill file and drops its reference; fails when
+ * the file is full because a save is still reading the oldest data */
+static bool spill_packet(struct ffmpeg_muxer *stream, struct replay_packet *rp)
+{
+	const uint64_t capacity = stream->spill_capacity;
+	size_t size = rp->packet.size;
+	uint64_t pos = stream->spill_pos;
+	uint64_t offset = pos % capacity;
+	uint64_t limit = stream->spill_read;
+
+	if (size > capacity)
+		return false;
+
+	/* payloads never wrap, so skip to the start of the next lap */
+	if (offset + size > capacity) {
+		pos += capacity - offset;
+		offset = 0;
+	}
+
+	if (os_atomic_load_bool(&stream->spill_pinned) &&
+	    stream->spill_pin < limit)
+		limit = stream->spill_pin;
+	if (pos + size - limit > capacity)
+		return false;
+
+	memcpy(stream->spill_data + offset, rp->packet.data, size);
+	obs_encoder_packet_release(&rp->packet);
+
+	rp->spilled = true;
+	rp->spill_end = pos + size;
+	stream->spill_pos = pos + size;
+	stream->mem_size -= (int64_t)size;
+	stream->num_spilled++;
+	return true;
+}
+
+static void spill_packets(struct ffmpeg_muxer *stream)
+{
+	const size_t size = sizeof(struct replay_packet);
+	size_t num_packets = stream->packets.size / size;
+
+	while (stream->mem_size > stream->max_mem &&
+	       stream->num_spilled < num_packets) {
+		struct replay_packet *rp = circlebuf_data(
+			&stream->packets, stream->num_spilled * size);
+		if (!spill_packet(stream, rp))
+			break;
+	}
+}
+
+static inline uint8_t *spilled_data(struct ffmpeg_muxer *stream,
+				    const struct replay_packet *rp)
+{
+	uint64_t start = rp->spill_end - rp->packet.size;
+	return stream->spill_data + start % stream->spill_capacity;
+}
+
+static void insert_packet(struct darray *array, struct replay_packet *rp,
 			  int64_t video_offset, int64_t *audio_offsets,
 			  int64_t video_dts_offset, int64_t *audio_dts_offsets)
 {
-	struct encoder_packet pkt;
-	DARRAY(struct encoder_packet) packets;
+	struct replay_packet entry = *rp;
+	struct encoder_packet *pkt = &entry.packet;
+	DARRAY(struct replay_packet) packets;
 	packets.da = *array;
 	size_t idx;
 
-	obs_encoder_packet_ref(&pkt, packet);
+	/* spilled data needs no reference, the save pins the spill file */
+	if (!rp->spilled)
+		obs_encoder_packet_ref(pkt, &rp->packet);
 
-	if (pkt.type == OBS_ENCODER_VIDEO) {
-		pkt.dts_usec -= video_offset;
-		pkt.dts -= video_dts_offset;
-		pkt.pts -= video_dts_offset;
+	if (pkt->type == OBS_ENCODER_VIDEO) {
+		pkt->dts_usec -= video_offset;
+		pkt->dts -= video_dts_offset;
+		pkt->pts -= video_dts_offset;
 	} else {
-		pkt.dts_usec -= audio_offsets[pkt.track_idx];
-		pkt.dts -= audio_dts_offsets[pkt.track_idx];
-		pkt.pts -= audio_dts_offsets[pkt.track_idx];
+		pkt->dts_usec -= audio_offsets[pkt->track_idx];
+		pkt->dts -= audio_dts_offsets[pkt->track_idx];
+		pkt->pts -= audio_dts_offsets[pkt->track_idx];
 	}
 
 	for (idx = packets.num; idx > 0; idx--) {
-		struct encoder_packet *p = packets.array + (idx - 1);
-		if (p->dts_usec < pkt.dts_usec)
+		struct replay_packet *p = packets.array + (idx - 1);
+		if (p->packet.dts_usec < pkt->dts_usec)
 			break;
 	}
 
-	da_insert(packets, idx, &pkt);
+	da_insert(packets, idx, &entry);
 	*array = packets.da;
 }
 
+static void free_mux_packets(struct ffmpeg_muxer *stream)
+{
+	for (size_t i = 0; i < stream->mux_packets.num; i++) {
+		struct replay_packet *rp = &stream->mux_packets.array[i];
+		if (!rp->spilled)
+			obs_encoder_packet_release(&rp->packet);
+	}
+
+	da_free(stream->mux_packets);
+	os_atomic_set_bool(&stream->spill_pinned, false);
+}
+
 static void *replay_buffer_mux_thread(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -832,17 +1305,22 @@ static void *replay_buffer_mux_thread(void *data)
 	}
 
 	for (size_t i = 0; i < stream->mux_packets.num; i++) {
-		struct encoder_packet *pkt = &stream->mux_packets.array[i];
-		write_packet(stream, pkt);
-		obs_encoder_packet_release(pkt);
+		struct replay_packet *rp = &stream->mux_packets.array[i];
+
+		if (rp->spilled) {
+			struct encoder_packet pkt = rp->packet;
+			pkt.data = spilled_data(stream, rp);
+			write_packet(stream, &pkt);
+		} else {
+			write_packet(stream, &rp->packet);
+		}
 	}
 
 	info("Wrote replay buffer to '%s'", stream->path.array);
 
 error:
-	os_process_pipe_destroy(stream->pipe);
-	stream->pipe = NULL;
-	da_free(stream->mux_packets);
+	stop_pipe(stream);
+	free_mux_packets(stream);
 	os_atomic_set_bool(&stream->muxing, false);
 
 	if (!error) {
@@ -857,10 +1335,27 @@ error:
 
 static void replay_buffer_save(struct ffmpeg_muxer *stream)
 {
-	const size_t size = sizeof(struct encoder_packet);
+	const size_t size = sizeof(struct replay_packet);
 	size_t num_packets = stream->packets.size / size;
+	size_t first = 0;
+
+	/* start straight at the oldest keyframe */
+	if (num_keyframes(stream)) {
+		uint64_t keyframe_seq;
+		circlebuf_peek_front(&stream->keyframe_seqs, &keyframe_seq,
+				     sizeof(keyframe_seq));
+		first = (size_t)(keyframe_seq - stream->first_seq);
+	}
 
-	da_reserve(stream->mux_packets, num_packets);
+	da_reserve(stream->mux_packets, num_packets - first);
+
+	/* keep the spill file from overwriting anything being saved */
+	if (first < stream->num_spilled) {
+		struct replay_packet *rp =
+			circlebuf_data(&stream->packets, first * size);
+		stream->spill_pin = rp->spill_end - rp->packet.size;
+		os_atomic_set_bool(&stream->spill_pinned, true);
+	}
 
 	/* ---------------------------- */
 	/* reorder packets */
@@ -872,9 +1367,11 @@ static void replay_buffer_save(struct ffmpeg_muxer *stream)
 	int64_t audio_offsets[MAX_AUDIO_MIXES] = {0};
 	int64_t audio_dts_offsets[MAX_AUDIO_MIXES] = {0};
 
-	for (size_t i = 0; i < num_packets; i++) {
+	for (size_t i = first; i < num_packets; i++) {
+		struct replay_packet *rp;
 		struct encoder_packet *pkt;
-		pkt = circlebuf_data(&stream->packets, i * size);
+		rp = circlebuf_data(&stream->packets, i * size);
+		pkt = &rp->packet;
 
 		if (pkt->type == OBS_ENCODER_VIDEO) {
 			if (!found_video) {
@@ -890,7 +1387,7 @@ static void replay_buffer_save(struct ffmpeg_muxer *stream)
 			}
 		}
 
-		insert_packet(&stream->mux_packets.da, pkt, video_offset,
+		insert_packet(&stream->mux_packets.da, rp, video_offset,
 			      audio_offsets, video_dts_offset,
 			      audio_dts_offsets);
 	}
@@ -928,6 +1425,11 @@ static void replay_buffer_save(struct ffmpeg_muxer *stream)
 	stream->mux_thread_joinable = pthread_create(&stream->mux_thread, NULL,
 						     replay_buffer_mux_thread,
 						     stream) == 0;
+
+	if (!stream->mux_thread_joinable) {
+		free_mux_packets(stream);
+		os_atomic_set_bool(&stream->muxing, false);
+	}
 }
 
 static void deactivate_replay_buffer(struct ffmpeg_muxer *stream, int code)
@@ -947,7 +1449,7 @@ static void deactivate_replay_buffer(struct ffmpeg_muxer *stream, int code)
 static void replay_buffer_data(void *data, struct encoder_packet *packet)
 {
 	struct ffmpeg_muxer *stream = data;
-	struct encoder_packet pkt;
+	struct replay_packet rp = {0};
 
 	if (!active(stream))
 		return;
@@ -965,17 +1467,23 @@ static void replay_buffer_data(void *data, struct encoder_packet *packet)
 		}
 	}
 
-	obs_encoder_packet_ref(&pkt, packet);
-	replay_buffer_purge(stream, &pkt);
+	rp.seq = stream->next_seq++;
+	obs_encoder_packet_ref(&rp.packet, packet);
+	replay_buffer_purge(stream, &rp.packet);
 
 	if (!stream->packets.size)
-		stream->cur_time = pkt.dts_usec;
-	stream->cur_size += pkt.size;
+		stream->cur_time = rp.packet.dts_usec;
+	stream->cur_size += rp.packet.size;
+	stream->mem_size += rp.packet.size;
 
-	circlebuf_push_back(&stream->packets, packet, sizeof(*packet));
+	circlebuf_push_back(&stream->packets, &rp, sizeof(rp));
 
 	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)
-		stream->keyframes++;
+		circlebuf_push_back(&stream->keyframe_seqs, &rp.seq,
+				    sizeof(rp.seq));
+
+	if (stream->spill)
+		spill_packets(stream);
 
 	if (stream->save_ts && packet->sys_dts_usec >= stream->save_ts) {
 		if (os_atomic_load_bool(&stream->muxing))
@@ -995,6 +1503,7 @@ static void replay_buffer_defaults(obs_data_t *s)
 {
 	obs_data_set_default_int(s, "max_time_sec", 15);
 	obs_data_set_default_int(s, "max_size_mb", 500);
+	obs_data_set_default_int(s, "max_memory_mb", 0);
 	obs_data_set_default_string(s, "format", "%CCYY-%MM-%DD %hh-%mm-%ss");
 	obs_data_set_default_string(s, "extension", "mp4");
 	obs_data_set_default_bool(s, "allow_spaces", true);
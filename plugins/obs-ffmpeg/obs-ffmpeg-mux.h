@@ -1,6 +1,9 @@
 #pragma once
 
+#include "ffmpeg-mux/ffmpeg-mux.h"
+
 #include <obs-avc.h>
+#include <obs-hevc.h>
 #include <obs-module.h>
 #include <obs-hotkey.h>
 #include <util/circlebuf.h>
@@ -8,8 +11,18 @@
 #include <util/dstr.h>
 #include <util/pipe.h>
 #include <util/platform.h>
+#include <util/shmem.h>
 #include <util/threading.h>
 
+/* replay buffer entry; once spilled, the payload lives in the spill file
+ * and packet.data no longer holds a reference */
+struct replay_packet {
+	struct encoder_packet packet;
+	uint64_t seq;
+	bool spilled;
+	uint64_t spill_end;
+};
+
 struct ffmpeg_muxer {
 	obs_output_t *output;
 	os_process_pipe_t *pipe;
@@ -24,16 +37,57 @@ struct ffmpeg_muxer {
 	struct dstr muxer_settings;
 	struct dstr stream_key;
 
+	/* fragmented mp4/mov, see add_muxer_params */
+	bool fragmented;
+
+	/* shared memory ring for packet payloads, see ffmpeg-mux.h */
+	os_shmem_t *ring_shm;
+	struct ffm_ring_header *ring;
+	uint8_t *ring_data;
+	uint64_t ring_pos;
+	bool ring_full;
+	uint64_t ring_overflows;
+
+	/* ffmpeg-mux file writer statistics, copied out of the ring header */
+	volatile long writer_queued;
+	volatile long writer_max_queued;
+	volatile long writer_num_blocks;
+	volatile long writer_stalls;
+	volatile long writer_stall_ms;
+
+	/* file splitting, see ffm_get_split_path */
+	volatile bool split_requested;
+	uint32_t file_index;
+
 	/* replay buffer */
 	int64_t cur_size;
 	int64_t cur_time;
 	int64_t max_size;
 	int64_t max_time;
 	int64_t save_ts;
-	int keyframes;
 	obs_hotkey_id hotkey;
 	volatile bool muxing;
-	DARRAY(struct encoder_packet) mux_packets;
+	DARRAY(struct replay_packet) mux_packets;
+
+	/* sequence numbers of the first and next packet, and of every video
+	 * keyframe in the buffer */
+	uint64_t first_seq;
+	uint64_t next_seq;
+	struct circlebuf keyframe_seqs;
+
+	/* payloads beyond the memory budget are moved, oldest first, to a
+	 * file backed mapping that is used as a ring */
+	int64_t max_mem;
+	int64_t mem_size;
+	size_t num_spilled;
+	os_shmem_t *spill;
+	uint8_t *spill_data;
+	uint64_t spill_capacity;
+	uint64_t spill_pos;
+	uint64_t spill_read;
+	/* start of the spilled data a save is still reading */
+	volatile bool spill_pinned;
+	uint64_t spill_pin;
 
 	/* these are accessed both by replay buffer and by HLS */
 	pthread_t mux_thread;
@@ -55,7 +109,9 @@ struct ffmpeg_muxer {
 
 bool stopping(struct ffmpeg_muxer *stream);
 bool active(struct ffmpeg_muxer *stream);
+void ffmpeg_mux_add_signals(obs_output_t *output);
 void start_pipe(struct ffmpeg_muxer *stream, const char *path);
+int stop_pipe(struct ffmpeg_muxer *stream);
 bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet);
 bool send_headers(struct ffmpeg_muxer *stream);
 int deactivate(struct ffmpeg_muxer *stream, int code);
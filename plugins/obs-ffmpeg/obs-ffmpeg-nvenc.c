@@ -21,6 +21,7 @@
 #include <media-io/video-io.h>
 #include <obs-module.h>
 #include <obs-avc.h>
+#include <obs-hevc.h>
 
 #include <libavutil/opt.h>
 #include <libavutil/pixdesc.h>
@@ -55,6 +56,7 @@ struct nvenc_encoder {
 	int height;
 	bool first_packet;
 	bool initialized;
+	bool hevc;
 };
 
 static const char *nvenc_getname(void *unused)
@@ -63,6 +65,12 @@ static const char *nvenc_getname(void *unused)
 	return "NVIDIA NVENC H.264";
 }
 
+static const char *nvenc_hevc_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "NVIDIA NVENC HEVC";
+}
+
 static inline bool valid_format(enum video_format format)
 {
 	return format == VIDEO_FORMAT_I420 || format == VIDEO_FORMAT_NV12 ||
@@ -192,6 +200,11 @@ static bool nvenc_update(void *data, obs_data_t *settings)
 	info.colorspace = voi->colorspace;
 	info.range = voi->range;
 
+	/* settings can come from an H.264 encoder, whose profiles HEVC
+	 * doesn't have */
+	if (enc->hevc && astrcmpi(profile, "main") != 0)
+		profile = "main";
+
 	bool twopass = false;
 
 	if (astrcmpi(preset, "mq") == 0) {
@@ -228,6 +241,7 @@ static bool nvenc_update(void *data, obs_data_t *settings)
 	av_opt_set(enc->context->priv_data, "level", "auto", 0);
 	av_opt_set_int(enc->context->priv_data, "2pass", twopass, 0);
 	av_opt_set_int(enc->context->priv_data, "gpu", gpu, 0);
+	av_opt_set_int(enc->context->priv_data, "forced-idr", true, 0);
 
 	enc->context->bit_rate = bitrate * 1000;
 	enc->context->rc_buffer_size = bitrate * 1000;
@@ -336,7 +350,8 @@ static void nvenc_destroy(void *data)
 	bfree(enc);
 }
 
-static void *nvenc_create(obs_data_t *settings, obs_encoder_t *encoder)
+static void *nvenc_create_internal(obs_data_t *settings,
+				   obs_encoder_t *encoder, bool hevc)
 {
 	struct nvenc_encoder *enc;
 
@@ -346,9 +361,12 @@ static void *nvenc_create(obs_data_t *settings, obs_encoder_t *encoder)
 
 	enc = bzalloc(sizeof(*enc));
 	enc->encoder = encoder;
-	enc->nvenc = avcodec_find_encoder_by_name("h264_nvenc");
+	enc->hevc = hevc;
+	enc->nvenc = avcodec_find_encoder_by_name(hevc ? "hevc_nvenc"
+						      : "h264_nvenc");
 	if (!enc->nvenc)
-		enc->nvenc = avcodec_find_encoder_by_name("nvenc_h264");
+		enc->nvenc = avcodec_find_encoder_by_name(
+			hevc ? "nvenc_hevc" : "nvenc_h264");
 	enc->first_packet = true;
 
 	blog(LOG_INFO, "---------------------------------");
@@ -376,6 +394,16 @@ fail:
 	return NULL;
 }
 
+static void *nvenc_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	return nvenc_create_internal(settings, encoder, false);
+}
+
+static void *nvenc_hevc_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	return nvenc_create_internal(settings, encoder, true);
+}
+
 static inline void copy_data(AVFrame *pic, const struct encoder_frame *frame,
 			     int height, enum AVPixelFormat format)
 {
@@ -415,6 +443,9 @@ static bool nvenc_encode(void *data, struct encoder_frame *frame,
 	copy_data(enc->vframe, frame, enc->height, enc->context->pix_fmt);
 
 	enc->vframe->pts = frame->pts;
+	enc->vframe->pict_type = obs_encoder_keyframe_requested(enc->encoder)
+					 ? AV_PICTURE_TYPE_I
+					 : AV_PICTURE_TYPE_NONE;
 #if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 40, 101)
 	ret = avcodec_send_frame(enc->context, enc->vframe);
 	if (ret == 0)
@@ -439,10 +470,16 @@ static bool nvenc_encode(void *data, struct encoder_frame *frame,
 			size_t size;
 
 			enc->first_packet = false;
-			obs_extract_avc_headers(av_pkt.data, av_pkt.size,
-						&new_packet, &size,
-						&enc->header, &enc->header_size,
-						&enc->sei, &enc->sei_size);
+			if (enc->hevc)
+				obs_extract_hevc_headers(
+					av_pkt.data, av_pkt.size, &new_packet,
+					&size, &enc->header, &enc->header_size,
+					&enc->sei, &enc->sei_size);
+			else
+				obs_extract_avc_headers(
+					av_pkt.data, av_pkt.size, &new_packet,
+					&size, &enc->header, &enc->header_size,
+					&enc->sei, &enc->sei_size);
 
 			da_copy_array(enc->buffer, new_packet, size);
 			bfree(new_packet);
@@ -455,7 +492,12 @@ static bool nvenc_encode(void *data, struct encoder_frame *frame,
 		packet->data = enc->buffer.array;
 		packet->size = enc->buffer.num;
 		packet->type = OBS_ENCODER_VIDEO;
-		packet->keyframe = obs_avc_keyframe(packet->data, packet->size);
+		if (enc->hevc)
+			packet->keyframe =
+				obs_hevc_keyframe(packet->data, packet->size);
+		else
+			packet->keyframe =
+				obs_avc_keyframe(packet->data, packet->size);
 		*received_packet = true;
 	} else {
 		*received_packet = false;
@@ -478,6 +520,13 @@ void nvenc_defaults(obs_data_t *settings)
 	obs_data_set_default_int(settings, "gpu", 0);
 	obs_data_set_default_int(settings, "bf", 2);
 	obs_data_set_default_bool(settings, "repeat_headers", false);
+	obs_data_set_default_bool(settings, "low_latency", false);
+}
+
+static void nvenc_hevc_defaults(obs_data_t *settings)
+{
+	nvenc_defaults(settings);
+	obs_data_set_default_string(settings, "profile", "main");
 }
 
 static bool rate_control_modified(obs_properties_t *ppts, obs_property_t *p,
@@ -577,6 +626,10 @@ obs_properties_t *nvenc_properties_internal(bool ffmpeg)
 			obs_module_text("NVENC.PsychoVisualTuning"));
 		obs_property_set_long_description(
 			p, obs_module_text("NVENC.PsychoVisualTuning.ToolTip"));
+		p = obs_properties_add_bool(props, "low_latency",
+					    obs_module_text("NVENC.LowLatency"));
+		obs_property_set_long_description(
+			p, obs_module_text("NVENC.LowLatency.ToolTip"));
 		p = obs_properties_add_bool(props, "repeat_headers",
 					    "repeat_headers");
 		obs_property_set_visible(p, false);
@@ -602,6 +655,18 @@ obs_properties_t *nvenc_properties_ffmpeg(void *unused)
 	return nvenc_properties_internal(true);
 }
 
+static obs_properties_t *nvenc_hevc_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = nvenc_properties_internal(true);
+	obs_property_t *p = obs_properties_get(props, "profile");
+
+	obs_property_list_clear(p);
+	obs_property_list_add_string(p, "main", "main");
+	return props;
+}
+
 static bool nvenc_extra_data(void *data, uint8_t **extra_data, size_t *size)
 {
 	struct nvenc_encoder *enc = data;
@@ -635,8 +700,26 @@ struct obs_encoder_info nvenc_encoder_info = {
 	.get_sei_data = nvenc_sei_data,
 	.get_video_info = nvenc_video_info,
 #ifdef _WIN32
-	.caps = OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_INTERNAL,
+	.caps = OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_INTERNAL |
+		OBS_ENCODER_CAP_KEYFRAME_REQUEST,
 #else
-	.caps = OBS_ENCODER_CAP_DYN_BITRATE,
+	.caps = OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_KEYFRAME_REQUEST,
 #endif
 };
+
+struct obs_encoder_info nvenc_hevc_encoder_info = {
+	.id = "ffmpeg_nvenc_hevc",
+	.type = OBS_ENCODER_VIDEO,
+	.codec = "hevc",
+	.get_name = nvenc_hevc_getname,
+	.create = nvenc_hevc_create,
+	.destroy = nvenc_destroy,
+	.encode = nvenc_encode,
+	.update = nvenc_reconfigure,
+	.get_defaults = nvenc_hevc_defaults,
+	.get_properties = nvenc_hevc_properties,
+	.get_extra_data = nvenc_extra_data,
+	.get_sei_data = nvenc_sei_data,
+	.get_video_info = nvenc_video_info,
+	.caps = OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_KEYFRAME_REQUEST,
+};
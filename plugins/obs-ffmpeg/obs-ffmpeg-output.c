@@ -15,6 +15,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <inttypes.h>
 #include <obs-module.h>
 #include <util/circlebuf.h>
 #include <util/threading.h>
@@ -26,6 +27,11 @@
 #include "obs-ffmpeg-formats.h"
 #include "obs-ffmpeg-compat.h"
 
+struct ffmpeg_packet {
+	AVPacket packet;
+	uint64_t queue_ts;
+};
+
 struct ffmpeg_output {
 	obs_output_t *output;
 	volatile bool active;
@@ -47,7 +53,21 @@ struct ffmpeg_output {
 	os_sem_t *write_sem;
 	os_event_t *stop_event;
 
-	DARRAY(AVPacket) packets;
+	/* the write thread swaps the queue with the batch and writes all of
+	 * it, so the semaphore is only posted when the queue was empty */
+	DARRAY(struct ffmpeg_packet) packets;
+	DARRAY(struct ffmpeg_packet) batch;
+
+	/* once this many packets are queued, video is dropped up to the next
+	 * keyframe that fits, 0 for no limit.  audio is never dropped */
+	size_t max_queued_packets;
+	bool dropping_video;
+	int dropped_packets;
+
+	size_t max_queue_depth;
+	uint64_t packets_written;
+	uint64_t total_latency_ns;
+	uint64_t max_latency_ns;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -430,6 +450,11 @@ static inline bool open_output_file(struct ffmpeg_data *data)
 		}
 	}
 
+	if (data->config.flush_policy == FFMPEG_FLUSH_PACKET)
+		av_opt_set_int(data->output, "flush_packets", 1, 0);
+	else if (data->config.flush_policy == FFMPEG_FLUSH_BATCH)
+		av_opt_set_int(data->output, "flush_packets", 0, 0);
+
 	ret = avformat_write_header(data->output, &dict);
 	if (ret < 0) {
 		ffmpeg_log_error(LOG_WARNING, data, "Error opening '%s': %s",
@@ -626,6 +651,48 @@ static inline bool stopping(struct ffmpeg_output *output)
 	return os_atomic_load_bool(&output->stopping);
 }
 
+static inline bool is_video_packet(struct ffmpeg_output *output,
+				   const AVPacket *packet)
+{
+	AVStream *video = output->ff_data.video;
+	return video && video->index == packet->stream_index;
+}
+
+static void push_packet(struct ffmpeg_output *output, AVPacket *packet)
+{
+	struct ffmpeg_packet queued = {*packet, os_gettime_ns()};
+	bool wake;
+
+	pthread_mutex_lock(&output->write_mutex);
+
+	if (is_video_packet(output, packet)) {
+		bool full = output->max_queued_packets &&
+			    output->packets.num >= output->max_queued_packets;
+
+		if (full)
+			output->dropping_video = true;
+		else if (packet->flags & AV_PKT_FLAG_KEY)
+			output->dropping_video = false;
+
+		if (output->dropping_video) {
+			output->dropped_packets++;
+			pthread_mutex_unlock(&output->write_mutex);
+			av_free_packet(packet);
+			return;
+		}
+	}
+
+	wake = !output->packets.num;
+	da_push_back(output->packets, &queued);
+	if (output->packets.num > output->max_queue_depth)
+		output->max_queue_depth = output->packets.num;
+
+	pthread_mutex_unlock(&output->write_mutex);
+
+	if (wake)
+		os_sem_post(output->write_sem);
+}
+
 static const char *ffmpeg_output_getname(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -755,10 +822,7 @@ static void receive_video(void *param, struct video_data *frame)
 		packet.data = data->vframe->data[0];
 		packet.size = sizeof(AVPicture);
 
-		pthread_mutex_lock(&output->write_mutex);
-		da_push_back(output->packets, &packet);
-		pthread_mutex_unlock(&output->write_mutex);
-		os_sem_post(output->write_sem);
+		push_packet(output, &packet);
 
 	} else {
 #endif
@@ -794,10 +858,7 @@ static void receive_video(void *param, struct video_data *frame)
 				packet.duration, context->time_base,
 				data->video->time_base);
 
-			pthread_mutex_lock(&output->write_mutex);
-			da_push_back(output->packets, &packet);
-			pthread_mutex_unlock(&output->write_mutex);
-			os_sem_post(output->write_sem);
+			push_packet(output, &packet);
 		} else {
 			ret = 0;
 		}
@@ -874,10 +935,7 @@ static void encode_audio(struct ffmpeg_output *output, int idx,
 				  data->audio_infos[idx].stream->time_base);
 	packet.stream_index = data->audio_infos[idx].stream->index;
 
-	pthread_mutex_lock(&output->write_mutex);
-	da_push_back(output->packets, &packet);
-	pthread_mutex_unlock(&output->write_mutex);
-	os_sem_post(output->write_sem);
+	push_packet(output, &packet);
 }
 
 /* Given a bitmask for the selected tracks and the mix index,
@@ -958,48 +1016,75 @@ static uint64_t get_packet_sys_dts(struct ffmpeg_output *output,
 				      (AVRational){1, 1000000000});
 }
 
-static int process_packet(struct ffmpeg_output *output)
+static int process_packet(struct ffmpeg_output *output, AVPacket *packet,
+			  uint64_t queue_ts)
 {
-	AVPacket packet;
-	bool new_packet = false;
+	uint64_t latency;
 	int ret;
 
-	pthread_mutex_lock(&output->write_mutex);
-	if (output->packets.num) {
-		packet = output->packets.array[0];
-		da_erase(output->packets, 0);
-		new_packet = true;
-	}
-	pthread_mutex_unlock(&output->write_mutex);
-
-	if (!new_packet)
-		return 0;
-
-	/*blog(LOG_DEBUG, "size = %d, flags = %lX, stream = %d, "
-			"packets queued: %lu",
-			packet.size, packet.flags,
-			packet.stream_index, output->packets.num);*/
-
 	if (stopping(output)) {
-		uint64_t sys_ts = get_packet_sys_dts(output, &packet);
-		if (sys_ts >= output->stop_ts)
+		uint64_t sys_ts = get_packet_sys_dts(output, packet);
+		if (sys_ts >= output->stop_ts) {
+			av_free_packet(packet);
 			return 0;
+		}
 	}
 
-	output->total_bytes += packet.size;
+	output->total_bytes += packet->size;
 
-	ret = av_interleaved_write_frame(output->ff_data.output, &packet);
+	ret = av_interleaved_write_frame(output->ff_data.output, packet);
 	if (ret < 0) {
-		av_free_packet(&packet);
+		av_free_packet(packet);
 		ffmpeg_log_error(LOG_WARNING, &output->ff_data,
 				 "process_packet: Error writing packet: %s",
 				 av_err2str(ret));
 		return ret;
 	}
 
+	latency = os_gettime_ns() - queue_ts;
+	output->total_latency_ns += latency;
+	if (latency > output->max_latency_ns)
+		output->max_latency_ns = latency;
+	output->packets_written++;
 	return 0;
 }
 
+static int process_packets(struct ffmpeg_output *output)
+{
+	struct darray swap;
+	AVIOContext *pb = output->ff_data.output->pb;
+	size_t i;
+	int ret = 0;
+
+	/* the two arrays trade places so neither is reallocated */
+	pthread_mutex_lock(&output->write_mutex);
+	swap = output->packets.da;
+	output->packets.da = output->batch.da;
+	output->batch.da = swap;
+	pthread_mutex_unlock(&output->write_mutex);
+
+	for (i = 0; i < output->batch.num; i++) {
+		struct ffmpeg_packet *queued = output->batch.array + i;
+
+		ret = process_packet(output, &queued->packet,
+				     queued->queue_ts);
+		if (ret != 0)
+			break;
+	}
+
+	/* packets left over after an error */
+	for (i = i + 1; i < output->batch.num; i++)
+		av_free_packet(&output->batch.array[i].packet);
+
+	da_resize(output->batch, 0);
+
+	if (ret == 0 && pb &&
+	    output->ff_data.config.flush_policy == FFMPEG_FLUSH_BATCH)
+		avio_flush(pb);
+
+	return ret;
+}
+
 static void *write_thread(void *data)
 {
 	struct ffmpeg_output *output = data;
@@ -1009,7 +1094,7 @@ static void *write_thread(void *data)
 		if (os_event_try(output->stop_event) == 0)
 			break;
 
-		int ret = process_packet(output);
+		int ret = process_packets(output);
 		if (ret != 0) {
 			int code = OBS_OUTPUT_ERROR;
 
@@ -1038,6 +1123,17 @@ static inline const char *get_string_or_null(obs_data_t *settings,
 	return value;
 }
 
+static enum ffmpeg_flush_policy get_flush_policy(obs_data_t *settings)
+{
+	const char *policy = obs_data_get_string(settings, "flush_policy");
+
+	if (astrcmpi(policy, "packet") == 0)
+		return FFMPEG_FLUSH_PACKET;
+	if (astrcmpi(policy, "batch") == 0)
+		return FFMPEG_FLUSH_BATCH;
+	return FFMPEG_FLUSH_AUTO;
+}
+
 static int get_audio_mix_count(int audio_mix_mask)
 {
 	int mix_count = 0;
@@ -1068,6 +1164,7 @@ static bool try_connect(struct ffmpeg_output *output)
 	config.format_mime_type =
 		get_string_or_null(settings, "format_mime_type");
 	config.muxer_settings = obs_data_get_string(settings, "muxer_settings");
+	config.flush_policy = get_flush_policy(settings);
 	config.video_bitrate = (int)obs_data_get_int(settings, "video_bitrate");
 	config.audio_bitrate = (int)obs_data_get_int(settings, "audio_bitrate");
 	config.gop_size = (int)obs_data_get_int(settings, "gop_size");
@@ -1088,6 +1185,9 @@ static bool try_connect(struct ffmpeg_output *output)
 	config.audio_tracks = (int)obs_output_get_mixers(output->output);
 	config.audio_mix_count = get_audio_mix_count(config.audio_tracks);
 
+	output->max_queued_packets =
+		(size_t)obs_data_get_int(settings, "max_queued_packets");
+
 	config.color_range = voi->range == VIDEO_RANGE_FULL ? AVCOL_RANGE_JPEG
 							    : AVCOL_RANGE_MPEG;
 	switch (voi->colorspace) {
@@ -1184,6 +1284,12 @@ static bool ffmpeg_output_start(void *data)
 	output->audio_start_ts = 0;
 	output->video_start_ts = 0;
 	output->total_bytes = 0;
+	output->dropping_video = false;
+	output->dropped_packets = 0;
+	output->max_queue_depth = 0;
+	output->packets_written = 0;
+	output->total_latency_ns = 0;
+	output->max_latency_ns = 0;
 
 	ret = pthread_create(&output->start_thread, NULL, start_thread, output);
 	return (output->connecting = (ret == 0));
@@ -1213,6 +1319,22 @@ static void ffmpeg_output_stop(void *data, uint64_t ts)
 	}
 }
 
+static void log_queue_stats(struct ffmpeg_output *output)
+{
+	uint64_t written = output->packets_written;
+
+	if (!written && !output->dropped_packets)
+		return;
+
+	blog(LOG_INFO,
+	     "ffmpeg output: %" PRIu64 " packets written, %d dropped, "
+	     "queued at most %zu, write latency avg %" PRIu64
+	     " ms, max %" PRIu64 " ms",
+	     written, output->dropped_packets, output->max_queue_depth,
+	     written ? output->total_latency_ns / written / 1000000 : 0,
+	     output->max_latency_ns / 1000000);
+}
+
 static void ffmpeg_deactivate(struct ffmpeg_output *output)
 {
 	if (output->write_thread_active) {
@@ -1225,11 +1347,13 @@ static void ffmpeg_deactivate(struct ffmpeg_output *output)
 	pthread_mutex_lock(&output->write_mutex);
 
 	for (size_t i = 0; i < output->packets.num; i++)
-		av_free_packet(output->packets.array + i);
+		av_free_packet(&output->packets.array[i].packet);
 	da_free(output->packets);
+	da_free(output->batch);
 
 	pthread_mutex_unlock(&output->write_mutex);
 
+	log_queue_stats(output);
 	ffmpeg_data_free(&output->ff_data);
 }
 
@@ -1239,6 +1363,18 @@ static uint64_t ffmpeg_output_total_bytes(void *data)
 	return output->total_bytes;
 }
 
+static int ffmpeg_output_dropped_frames(void *data)
+{
+	struct ffmpeg_output *output = data;
+	int dropped;
+
+	pthread_mutex_lock(&output->write_mutex);
+	dropped = output->dropped_packets;
+	pthread_mutex_unlock(&output->write_mutex);
+
+	return dropped;
+}
+
 struct obs_output_info ffmpeg_output = {
 	.id = "ffmpeg_output",
 	.flags = OBS_OUTPUT_AUDIO | OBS_OUTPUT_VIDEO | OBS_OUTPUT_MULTI_TRACK |
@@ -1251,4 +1387,5 @@ struct obs_output_info ffmpeg_output = {
 	.raw_video = receive_video,
 	.raw_audio2 = receive_audio,
 	.get_total_bytes = ffmpeg_output_total_bytes,
+	.get_dropped_frames = ffmpeg_output_dropped_frames,
 };
@@ -5,11 +5,21 @@
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 
+enum ffmpeg_flush_policy {
+	/* leaves it to the muxer, which flushes unseekable outputs */
+	FFMPEG_FLUSH_AUTO,
+	/* flushes after every packet */
+	FFMPEG_FLUSH_PACKET,
+	/* flushes once all the queued packets have been written */
+	FFMPEG_FLUSH_BATCH,
+};
+
 struct ffmpeg_cfg {
 	const char *url;
 	const char *format_name;
 	const char *format_mime_type;
 	const char *muxer_settings;
+	enum ffmpeg_flush_policy flush_policy;
 	int gop_size;
 	int video_bitrate;
 	int audio_bitrate;
@@ -49,6 +49,7 @@ struct ffmpeg_source {
 	char *input;
 	char *input_format;
 	int buffering_mb;
+	int jitter_buffer_ms;
 	int speed_percent;
 	bool is_looping;
 	bool is_local_file;
@@ -87,6 +88,8 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_t *local_file = obs_properties_get(props, "local_file");
 	obs_property_t *looping = obs_properties_get(props, "looping");
 	obs_property_t *buffering = obs_properties_get(props, "buffering_mb");
+	obs_property_t *jitter_buffer =
+		obs_properties_get(props, "jitter_buffer_ms");
 	obs_property_t *seekable = obs_properties_get(props, "seekable");
 	obs_property_t *speed = obs_properties_get(props, "speed_percent");
 	obs_property_t *reconnect_delay_sec =
@@ -94,6 +97,7 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_set_visible(input, !enabled);
 	obs_property_set_visible(input_format, !enabled);
 	obs_property_set_visible(buffering, !enabled);
+	obs_property_set_visible(jitter_buffer, !enabled);
 	obs_property_set_visible(local_file, enabled);
 	obs_property_set_visible(looping, enabled);
 	obs_property_set_visible(speed, enabled);
@@ -111,6 +115,7 @@ static void ffmpeg_source_defaults(obs_data_t *settings)
 	obs_data_set_default_bool(settings, "restart_on_activate", true);
 	obs_data_set_default_int(settings, "reconnect_delay_sec", 10);
 	obs_data_set_default_int(settings, "buffering_mb", 2);
+	obs_data_set_default_int(settings, "jitter_buffer_ms", 0);
 	obs_data_set_default_int(settings, "speed_percent", 100);
 }
 
@@ -174,6 +179,11 @@ static obs_properties_t *ffmpeg_source_getproperties(void *data)
 					     16, 1);
 	obs_property_int_set_suffix(prop, " MB");
 
+	prop = obs_properties_add_int_slider(props, "jitter_buffer_ms",
+					     obs_module_text("JitterBuffer"), 0,
+					     5000, 100);
+	obs_property_int_set_suffix(prop, " ms");
+
 	obs_properties_add_text(props, "input", obs_module_text("Input"),
 				OBS_TEXT_DEFAULT);
 
@@ -304,6 +314,8 @@ static void ffmpeg_source_open(struct ffmpeg_source *s)
 			.path = s->input,
 			.format = s->input_format,
 			.buffering = s->buffering_mb * 1024 * 1024,
+			.jitter_buffer_ms = s->jitter_buffer_ms,
+			.reconnect_delay_ms = s->reconnect_delay_sec * 1000,
 			.speed = s->speed_percent,
 			.force_range = s->range,
 			.hardware_decoding = s->is_hw_decoding,
@@ -430,6 +442,8 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	s->range = (enum video_range_type)obs_data_get_int(settings,
 							   "color_range");
 	s->buffering_mb = (int)obs_data_get_int(settings, "buffering_mb");
+	s->jitter_buffer_ms =
+		(int)obs_data_get_int(settings, "jitter_buffer_ms");
 	s->speed_percent = (int)obs_data_get_int(settings, "speed_percent");
 	s->is_local_file = is_local_file;
 	s->seekable = obs_data_get_bool(settings, "seekable");
@@ -653,6 +667,25 @@ static void ffmpeg_source_deactivate(void *data)
 	}
 }
 
+static void ffmpeg_source_warm(void *data)
+{
+	struct ffmpeg_source *s = data;
+
+	/* opening the media reads the headers and the first frame now rather
+	 * than when the source is activated */
+	if (s->close_when_inactive && !s->media_valid)
+		ffmpeg_source_open(s);
+}
+
+static void ffmpeg_source_cool(void *data)
+{
+	struct ffmpeg_source *s = data;
+
+	if (s->close_when_inactive && s->media_valid &&
+	    !obs_source_active(s->source))
+		s->destroy_media = true;
+}
+
 static void ffmpeg_source_play_pause(void *data, bool pause)
 {
 	struct ffmpeg_source *s = data;
@@ -771,6 +804,8 @@ struct obs_source_info ffmpeg_source = {
 	.get_properties = ffmpeg_source_getproperties,
 	.activate = ffmpeg_source_activate,
 	.deactivate = ffmpeg_source_deactivate,
+	.warm = ffmpeg_source_warm,
+	.cool = ffmpeg_source_cool,
 	.video_tick = ffmpeg_source_tick,
 	.missing_files = ffmpeg_source_missingfiles,
 	.update = ffmpeg_source_update,
@@ -36,6 +36,13 @@
 #include <libavfilter/avfilter.h>
 
 #include "obs-ffmpeg-formats.h"
+#include "obs-ffmpeg-config.h"
+
+#if HAVE_LIBVA
+#include <libavutil/hwcontext_vaapi.h>
+#include <va/va.h>
+#include <va/va_drmcommon.h>
+#endif
 
 #define do_log(level, format, ...)                          \
 	blog(level, "[FFMPEG VAAPI encoder: '%s'] " format, \
@@ -397,51 +404,21 @@ static inline void copy_data(AVFrame *pic, const struct encoder_frame *frame,
 	}
 }
 
-static bool vaapi_encode(void *data, struct encoder_frame *frame,
-			 struct encoder_packet *packet, bool *received_packet)
+/* takes ownership of hwframe */
+static bool vaapi_send_frame(struct vaapi_encoder *enc, AVFrame *hwframe,
+			     struct encoder_packet *packet,
+			     bool *received_packet)
 {
-	struct vaapi_encoder *enc = data;
-	AVFrame *hwframe = NULL;
 	AVPacket av_pkt;
 	int got_packet;
 	int ret;
 
-	hwframe = av_frame_alloc();
-	if (!hwframe) {
-		warn("vaapi_encode: failed to allocate hw frame");
-		return false;
-	}
-
-	ret = av_hwframe_get_buffer(enc->vaframes_ref, hwframe, 0);
-	if (ret < 0) {
-		warn("vaapi_encode: failed to get buffer for hw frame: %s",
-		     av_err2str(ret));
-		goto fail;
-	}
-
-	copy_data(enc->vframe, frame, enc->height, enc->context->pix_fmt);
-
-	enc->vframe->pts = frame->pts;
-	hwframe->pts = frame->pts;
-	hwframe->width = enc->vframe->width;
-	hwframe->height = enc->vframe->height;
-
-	ret = av_hwframe_transfer_data(hwframe, enc->vframe, 0);
-	if (ret < 0) {
-		warn("vaapi_encode: failed to upload hw frame: %s",
-		     av_err2str(ret));
-		goto fail;
-	}
-
-	ret = av_frame_copy_props(hwframe, enc->vframe);
-	if (ret < 0) {
-		warn("vaapi_encode: failed to copy props to hw frame: %s",
-		     av_err2str(ret));
-		goto fail;
-	}
-
 	av_init_packet(&av_pkt);
 
+	/* libavcodec's vaapi encoder makes forced intra frames IDR frames */
+	if (obs_encoder_keyframe_requested(enc->encoder))
+		hwframe->pict_type = AV_PICTURE_TYPE_I;
+
 #if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 40, 101)
 	ret = avcodec_send_frame(enc->context, hwframe);
 	if (ret == 0)
@@ -456,7 +433,7 @@ static bool vaapi_encode(void *data, struct encoder_frame *frame,
 				    &got_packet);
 #endif
 	if (ret < 0) {
-		warn("vaapi_encode: Error encoding: %s", av_err2str(ret));
+		warn("vaapi_send_frame: Error encoding: %s", av_err2str(ret));
 		goto fail;
 	}
 
@@ -497,6 +474,202 @@ fail:
 	return false;
 }
 
+static bool vaapi_encode(void *data, struct encoder_frame *frame,
+			 struct encoder_packet *packet, bool *received_packet)
+{
+	struct vaapi_encoder *enc = data;
+	AVFrame *hwframe = NULL;
+	int ret;
+
+	hwframe = av_frame_alloc();
+	if (!hwframe) {
+		warn("vaapi_encode: failed to allocate hw frame");
+		return false;
+	}
+
+	ret = av_hwframe_get_buffer(enc->vaframes_ref, hwframe, 0);
+	if (ret < 0) {
+		warn("vaapi_encode: failed to get buffer for hw frame: %s",
+		     av_err2str(ret));
+		goto fail;
+	}
+
+	copy_data(enc->vframe, frame, enc->height, enc->context->pix_fmt);
+
+	enc->vframe->pts = frame->pts;
+	hwframe->pts = frame->pts;
+	hwframe->width = enc->vframe->width;
+	hwframe->height = enc->vframe->height;
+
+	ret = av_hwframe_transfer_data(hwframe, enc->vframe, 0);
+	if (ret < 0) {
+		warn("vaapi_encode: failed to upload hw frame: %s",
+		     av_err2str(ret));
+		goto fail;
+	}
+
+	ret = av_frame_copy_props(hwframe, enc->vframe);
+	if (ret < 0) {
+		warn("vaapi_encode: failed to copy props to hw frame: %s",
+		     av_err2str(ret));
+		goto fail;
+	}
+
+	return vaapi_send_frame(enc, hwframe, packet, received_packet);
+
+fail:
+	av_frame_free(&hwframe);
+	return false;
+}
+
+#if HAVE_LIBVA
+static void *vaapi_create_tex(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	if (!obs_encoder_video_tex_active(encoder, VIDEO_FORMAT_NV12) ||
+	    obs_encoder_scaling_enabled(encoder)) {
+		blog(LOG_INFO, "[FFMPEG VAAPI encoder] GPU texture encoding "
+			       "is not available, falling back to "
+			       "system memory frames");
+		return obs_encoder_create_rerouted(encoder,
+						   "ffmpeg_vaapi_soft");
+	}
+
+	return vaapi_create(settings, encoder);
+}
+
+/* Copies one plane of the OBS output into the layer of the VA surface that
+ * was exported as a dmabuf, so the frame never leaves VRAM. */
+static bool copy_plane_to_layer(struct vaapi_encoder *enc,
+				const VADRMPRIMESurfaceDescriptor *desc,
+				uint32_t layer, gs_texture_t *src)
+{
+	int fds[4];
+	uint32_t strides[4];
+	uint32_t offsets[4];
+	uint64_t modifiers[4];
+	uint32_t n_planes = desc->layers[layer].num_planes;
+	uint32_t width = (uint32_t)enc->context->width;
+	uint32_t height = (uint32_t)enc->context->height;
+	enum gs_color_format format = GS_R8;
+	gs_texture_t *dst;
+
+	if (!src || n_planes > 4)
+		return false;
+
+	for (uint32_t i = 0; i < n_planes; i++) {
+		uint32_t obj = desc->layers[layer].object_index[i];
+
+		fds[i] = desc->objects[obj].fd;
+		strides[i] = desc->layers[layer].pitch[i];
+		offsets[i] = desc->layers[layer].offset[i];
+		modifiers[i] = desc->objects[obj].drm_format_modifier;
+	}
+
+	if (layer > 0) {
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+		format = GS_R8G8;
+	}
+
+	dst = gs_texture_create_from_dmabuf(width, height, format, n_planes,
+					    fds, strides, offsets, modifiers);
+	if (!dst) {
+		warn("copy_plane_to_layer: failed to import layer %u", layer);
+		return false;
+	}
+
+	gs_copy_texture(dst, src);
+	gs_texture_destroy(dst);
+	return true;
+}
+
+static bool vaapi_encode_tex(void *data, struct encoder_texture *texture,
+			     int64_t pts, uint64_t lock_key, uint64_t *next_key,
+			     struct encoder_packet *packet,
+			     bool *received_packet)
+{
+	struct vaapi_encoder *enc = data;
+	AVHWDeviceContext *device_ctx =
+		(AVHWDeviceContext *)enc->vadevice_ref->data;
+	AVVAAPIDeviceContext *vaapi_ctx = device_ctx->hwctx;
+	VADRMPRIMESurfaceDescriptor desc;
+	VASurfaceID surface;
+	AVFrame *hwframe = NULL;
+	VAStatus vas;
+	bool success = true;
+	int ret;
+
+	UNUSED_PARAMETER(lock_key);
+	UNUSED_PARAMETER(next_key);
+
+	hwframe = av_frame_alloc();
+	if (!hwframe) {
+		warn("vaapi_encode_tex: failed to allocate hw frame");
+		return false;
+	}
+
+	ret = av_hwframe_get_buffer(enc->vaframes_ref, hwframe, 0);
+	if (ret < 0) {
+		warn("vaapi_encode_tex: failed to get buffer for hw frame: %s",
+		     av_err2str(ret));
+		goto fail;
+	}
+
+	surface = (VASurfaceID)(uintptr_t)hwframe->data[3];
+
+	vas = vaExportSurfaceHandle(vaapi_ctx->display, surface,
+				    VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
+				    VA_EXPORT_SURFACE_WRITE_ONLY |
+					    VA_EXPORT_SURFACE_SEPARATE_LAYERS,
+				    &desc);
+	if (vas != VA_STATUS_SUCCESS) {
+		warn("vaapi_encode_tex: failed to export surface: %s",
+		     vaErrorStr(vas));
+		goto fail;
+	}
+
+	obs_enter_graphics();
+
+	if (desc.num_layers < 2) {
+		warn("vaapi_encode_tex: unexpected surface layout "
+		     "(%u layers)",
+		     desc.num_layers);
+		success = false;
+	}
+
+	for (uint32_t i = 0; success && i < 2; i++)
+		success = copy_plane_to_layer(enc, &desc, i, texture->tex[i]);
+
+	gs_flush();
+	obs_leave_graphics();
+
+	for (uint32_t i = 0; i < desc.num_objects; i++)
+		close(desc.objects[i].fd);
+
+	if (!success)
+		goto fail;
+
+	vas = vaSyncSurface(vaapi_ctx->display, surface);
+	if (vas != VA_STATUS_SUCCESS) {
+		warn("vaapi_encode_tex: failed to sync surface: %s",
+		     vaErrorStr(vas));
+		goto fail;
+	}
+
+	hwframe->pts = pts;
+	hwframe->width = enc->context->width;
+	hwframe->height = enc->context->height;
+	hwframe->colorspace = enc->context->colorspace;
+	hwframe->color_range = enc->context->color_range;
+
+	return vaapi_send_frame(enc, hwframe, packet, received_packet);
+
+fail:
+	av_frame_free(&hwframe);
+	return false;
+}
+#endif
+
 static void set_visible(obs_properties_t *ppts, const char *name, bool visible)
 {
 	obs_property_t *p = obs_properties_get(ppts, name);
@@ -634,8 +807,17 @@ static bool vaapi_sei_data(void *data, uint8_t **extra_data, size_t *size)
 	return true;
 }
 
+/* With libva available, "ffmpeg_vaapi" is the texture encoder and the
+ * system memory encoder is only reached through rerouting, so existing
+ * profiles keep working unchanged. */
 struct obs_encoder_info vaapi_encoder_info = {
+#if HAVE_LIBVA
+	.id = "ffmpeg_vaapi_soft",
+	.caps = OBS_ENCODER_CAP_INTERNAL | OBS_ENCODER_CAP_KEYFRAME_REQUEST,
+#else
 	.id = "ffmpeg_vaapi",
+	.caps = OBS_ENCODER_CAP_KEYFRAME_REQUEST,
+#endif
 	.type = OBS_ENCODER_VIDEO,
 	.codec = "h264",
 	.get_name = vaapi_getname,
@@ -649,4 +831,22 @@ struct obs_encoder_info vaapi_encoder_info = {
 	.get_video_info = vaapi_video_info,
 };
 
+#if HAVE_LIBVA
+struct obs_encoder_info vaapi_tex_encoder_info = {
+	.id = "ffmpeg_vaapi",
+	.type = OBS_ENCODER_VIDEO,
+	.codec = "h264",
+	.caps = OBS_ENCODER_CAP_PASS_TEXTURE | OBS_ENCODER_CAP_KEYFRAME_REQUEST,
+	.get_name = vaapi_getname,
+	.create = vaapi_create_tex,
+	.destroy = vaapi_destroy,
+	.encode_texture2 = vaapi_encode_tex,
+	.get_defaults = vaapi_defaults,
+	.get_properties = vaapi_properties,
+	.get_extra_data = vaapi_extra_data,
+	.get_sei_data = vaapi_sei_data,
+	.get_video_info = vaapi_video_info,
+};
+#endif
+
 #endif
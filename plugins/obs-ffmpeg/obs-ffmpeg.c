@@ -3,6 +3,7 @@
 #include <libavutil/avutil.h>
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <media-playback/media.h>
 
 #include "obs-ffmpeg-config.h"
 
@@ -28,6 +29,7 @@ extern struct obs_output_info ffmpeg_hls_muxer;
 extern struct obs_encoder_info aac_encoder_info;
 extern struct obs_encoder_info opus_encoder_info;
 extern struct obs_encoder_info nvenc_encoder_info;
+extern struct obs_encoder_info nvenc_hevc_encoder_info;
 
 #if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(55, 27, 100)
 #define LIBAVUTIL_VAAPI_AVAILABLE
@@ -35,6 +37,9 @@ extern struct obs_encoder_info nvenc_encoder_info;
 
 #ifdef LIBAVUTIL_VAAPI_AVAILABLE
 extern struct obs_encoder_info vaapi_encoder_info;
+#if HAVE_LIBVA
+extern struct obs_encoder_info vaapi_tex_encoder_info;
+#endif
 #endif
 
 #ifndef __APPLE__
@@ -207,6 +212,14 @@ finish:
 	return success;
 }
 
+static bool nvenc_hevc_supported(void)
+{
+	AVCodec *nvenc = avcodec_find_encoder_by_name("hevc_nvenc");
+	if (!nvenc)
+		nvenc = avcodec_find_encoder_by_name("nvenc_hevc");
+	return !!nvenc;
+}
+
 #endif
 
 #ifdef LIBAVUTIL_VAAPI_AVAILABLE
@@ -251,11 +264,17 @@ bool obs_module_load(void)
 		}
 #endif
 		obs_register_encoder(&nvenc_encoder_info);
+
+		if (nvenc_hevc_supported())
+			obs_register_encoder(&nvenc_hevc_encoder_info);
 	}
 #if !defined(_WIN32) && defined(LIBAVUTIL_VAAPI_AVAILABLE)
 	if (vaapi_supported()) {
 		blog(LOG_INFO, "FFMPEG VAAPI supported");
 		obs_register_encoder(&vaapi_encoder_info);
+#if HAVE_LIBVA
+		obs_register_encoder(&vaapi_tex_encoder_info);
+#endif
 	}
 #endif
 #endif
@@ -268,6 +287,8 @@ bool obs_module_load(void)
 
 void obs_module_unload(void)
 {
+	mp_media_free_hw_devices();
+
 #if ENABLE_FFMPEG_LOGGING
 	obs_ffmpeg_unload_logging();
 #endif
@@ -1,5 +1,7 @@
 #include <obs-module.h>
+#include <media-io/video-scaler.h>
 #include <util/circlebuf.h>
+#include <util/threading.h>
 #include <util/util_uint64.h>
 
 #ifndef SEC_TO_NSEC
@@ -11,15 +13,43 @@
 #endif
 
 #define SETTING_DELAY_MS "delay_ms"
+#define SETTING_COMPACT "compact"
 
 #define TEXT_DELAY_MS obs_module_text("DelayMs")
+#define TEXT_COMPACT obs_module_text("AsyncDelay.Compact")
+
+/*
+ * The delay line holds on to the frames of the source itself.  In compact
+ * mode, frames of formats larger than NV12 are converted to NV12 on the task
+ * pool as they enter the line, and the frame of the source is handed back
+ * as soon as its conversion is done, so the line only holds NV12 frames.
+ */
+struct delayed_frame {
+	struct async_delay_data *filter;
+	uint64_t timestamp;
+
+	/* frame of the source, held until the conversion is done */
+	struct obs_source_frame *source_frame;
+	/* converted frame, NULL if the frame was not converted */
+	struct obs_source_frame *frame;
+	volatile bool converted;
+	/* queued for conversion, and source_frame not yet released */
+	bool pending;
+};
 
 struct async_delay_data {
 	obs_source_t *context;
 
-	/* contains struct obs_source_frame* */
+	/* contains struct delayed_frame* */
 	struct circlebuf video_frames;
 
+	bool compact;
+	size_t num_pending;
+	obs_task_group_t *group;
+	pthread_mutex_t scaler_mutex;
+	video_scaler_t *scaler;
+	struct video_scale_info scaler_src;
+
 	/* stores the audio data */
 	struct circlebuf audio_frames;
 	struct obs_audio_data audio_output;
@@ -43,13 +73,19 @@ static const char *async_delay_filter_name(void *unused)
 static void free_video_data(struct async_delay_data *filter,
 			    obs_source_t *parent)
 {
-	while (filter->video_frames.size) {
-		struct obs_source_frame *frame;
+	if (filter->video_frames.size)
+		obs_task_group_wait(filter->group);
 
-		circlebuf_pop_front(&filter->video_frames, &frame,
-				    sizeof(struct obs_source_frame *));
-		obs_source_release_frame(parent, frame);
+	while (filter->video_frames.size) {
+		struct delayed_frame *df;
+		circlebuf_pop_front(&filter->video_frames, &df,
+				    sizeof(struct delayed_frame *));
+		obs_source_release_frame(parent, df->source_frame);
+		obs_source_release_frame(parent, df->frame);
+		bfree(df);
 	}
+
+	filter->num_pending = 0;
 }
 
 static inline void free_audio_packet(struct obs_audio_data *audio)
@@ -77,9 +113,13 @@ static void async_delay_filter_update(void *data, obs_data_t *settings)
 		(uint64_t)obs_data_get_int(settings, SETTING_DELAY_MS) *
 		MSEC_TO_NSEC;
 
-	if (new_interval < filter->interval)
+	bool compact = obs_data_get_bool(settings, SETTING_COMPACT);
+
+	if (new_interval < filter->interval || compact != filter->compact)
 		free_video_data(filter, obs_filter_get_parent(filter->context));
 
+	filter->compact = compact;
+
 	filter->reset_audio = true;
 	filter->reset_video = true;
 	filter->interval = new_interval;
@@ -94,6 +134,8 @@ static void *async_delay_filter_create(obs_data_t *settings,
 	struct obs_audio_info oai;
 
 	filter->context = context;
+	filter->group = obs_task_group_create();
+	pthread_mutex_init(&filter->scaler_mutex, NULL);
 	async_delay_filter_update(filter, settings);
 
 	obs_get_audio_info(&oai);
@@ -106,6 +148,10 @@ static void async_delay_filter_destroy(void *data)
 {
 	struct async_delay_data *filter = data;
 
+	obs_task_group_destroy(filter->group);
+	video_scaler_destroy(filter->scaler);
+	pthread_mutex_destroy(&filter->scaler_mutex);
+
 	free_audio_packet(&filter->audio_output);
 	circlebuf_free(&filter->video_frames);
 	circlebuf_free(&filter->audio_frames);
@@ -120,6 +166,8 @@ static obs_properties_t *async_delay_filter_properties(void *data)
 						   TEXT_DELAY_MS, 0, 20000, 1);
 	obs_property_int_set_suffix(p, " ms");
 
+	obs_properties_add_bool(props, SETTING_COMPACT, TEXT_COMPACT);
+
 	UNUSED_PARAMETER(data);
 	return props;
 }
@@ -141,12 +189,150 @@ static inline bool is_timestamp_jump(uint64_t ts, uint64_t prev_ts)
 	return ts < prev_ts || (ts - prev_ts) > SEC_TO_NSEC;
 }
 
+/* formats that take more memory than NV12 and convert to it without losing
+ * anything but chroma resolution and alpha */
+static bool can_compact(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+	case VIDEO_FORMAT_I422:
+	case VIDEO_FORMAT_I444:
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_BGR3:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* assumes scaler_mutex */
+static bool update_scaler(struct async_delay_data *filter,
+			  const struct obs_source_frame *frame, bool yuv)
+{
+	struct video_scale_info src = {
+		.format = frame->format,
+		.width = frame->width,
+		.height = frame->height,
+		.range = frame->full_range ? VIDEO_RANGE_FULL
+					   : VIDEO_RANGE_PARTIAL,
+		.colorspace = VIDEO_CS_709,
+	};
+	struct video_scale_info dst = src;
+
+	dst.format = VIDEO_FORMAT_NV12;
+	if (!yuv)
+		dst.range = VIDEO_RANGE_FULL;
+
+	if (filter->scaler &&
+	    memcmp(&src, &filter->scaler_src, sizeof(src)) == 0)
+		return true;
+
+	video_scaler_destroy(filter->scaler);
+	filter->scaler = NULL;
+	filter->scaler_src = src;
+
+	return video_scaler_create(&filter->scaler, &dst, &src,
+				   VIDEO_SCALE_FAST_BILINEAR) ==
+	       VIDEO_SCALER_SUCCESS;
+}
+
+static struct obs_source_frame *
+compact_frame(struct async_delay_data *filter,
+	      const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *out;
+	bool yuv = format_is_yuv(frame->format);
+	bool success;
+
+	out = obs_source_frame_create_pooled(VIDEO_FORMAT_NV12, frame->width,
+					     frame->height);
+
+	pthread_mutex_lock(&filter->scaler_mutex);
+	success = update_scaler(filter, frame, yuv) &&
+		  video_scaler_scale(filter->scaler, out->data, out->linesize,
+				     (const uint8_t *const *)frame->data,
+				     frame->linesize);
+	pthread_mutex_unlock(&filter->scaler_mutex);
+
+	if (!success) {
+		obs_source_release_frame(NULL, out);
+		return NULL;
+	}
+
+	out->timestamp = frame->timestamp;
+	out->flip = frame->flip;
+
+	/* YUV keeps the values and color parameters of the source, RGB is
+	 * converted to full range BT.709 */
+	if (yuv) {
+		out->full_range = frame->full_range;
+		memcpy(out->color_matrix, frame->color_matrix,
+		       sizeof(out->color_matrix));
+		memcpy(out->color_range_min, frame->color_range_min,
+		       sizeof(out->color_range_min));
+		memcpy(out->color_range_max, frame->color_range_max,
+		       sizeof(out->color_range_max));
+	} else {
+		out->full_range = true;
+		video_format_get_parameters(VIDEO_CS_709, VIDEO_RANGE_FULL,
+					    out->color_matrix,
+					    out->color_range_min,
+					    out->color_range_max);
+	}
+
+	return out;
+}
+
+static void convert_frame(void *param)
+{
+	struct delayed_frame *df = param;
+
+	df->frame = compact_frame(df->filter, df->source_frame);
+	os_atomic_set_bool(&df->converted, true);
+}
+
+/* hands the frames that have been converted back to the source, which has
+ * to happen on the thread that filters its frames.  the frames still being
+ * converted are the newest ones, so only those are looked at */
+static void release_converted(struct async_delay_data *filter,
+			      obs_source_t *parent)
+{
+	size_t num = filter->video_frames.size / sizeof(struct delayed_frame *);
+	size_t pending = filter->num_pending;
+
+	for (size_t i = num; i > 0 && pending; i--) {
+		struct delayed_frame **df_ptr = circlebuf_data(
+			&filter->video_frames, (i - 1) * sizeof(*df_ptr));
+		struct delayed_frame *df = *df_ptr;
+
+		if (!df->pending)
+			continue;
+
+		pending--;
+
+		if (os_atomic_load_bool(&df->converted)) {
+			if (df->frame) {
+				obs_source_release_frame(parent,
+							 df->source_frame);
+				df->source_frame = NULL;
+			}
+			df->pending = false;
+			filter->num_pending--;
+		}
+	}
+}
+
 static struct obs_source_frame *
 async_delay_filter_video(void *data, struct obs_source_frame *frame)
 {
 	struct async_delay_data *filter = data;
 	obs_source_t *parent = obs_filter_get_parent(filter->context);
 	struct obs_source_frame *output;
+	struct delayed_frame *df;
 	uint64_t cur_interval;
 
 	if (filter->reset_video ||
@@ -158,21 +344,51 @@ async_delay_filter_video(void *data, struct obs_source_frame *frame)
 
 	filter->last_video_ts = frame->timestamp;
 
-	circlebuf_push_back(&filter->video_frames, &frame,
-			    sizeof(struct obs_source_frame *));
-	circlebuf_peek_front(&filter->video_frames, &output,
-			     sizeof(struct obs_source_frame *));
+	df = bzalloc(sizeof(*df));
+	df->filter = filter;
+	df->timestamp = frame->timestamp;
+	df->source_frame = frame;
+
+	if (filter->compact && can_compact(frame->format)) {
+		df->pending = true;
+		filter->num_pending++;
+		obs_task_group_queue(filter->group, OBS_TASK_PRIORITY_NORMAL,
+				     convert_frame, df);
+	} else {
+		df->converted = true;
+	}
+
+	circlebuf_push_back(&filter->video_frames, &df,
+			    sizeof(struct delayed_frame *));
 
-	cur_interval = frame->timestamp - output->timestamp;
+	release_converted(filter, parent);
+
+	circlebuf_peek_front(&filter->video_frames, &df,
+			     sizeof(struct delayed_frame *));
+
+	cur_interval = frame->timestamp - df->timestamp;
 	if (!filter->video_delay_reached && cur_interval < filter->interval)
 		return NULL;
 
 	circlebuf_pop_front(&filter->video_frames, NULL,
-			    sizeof(struct obs_source_frame *));
+			    sizeof(struct delayed_frame *));
 
 	if (!filter->video_delay_reached)
 		filter->video_delay_reached = true;
 
+	if (!os_atomic_load_bool(&df->converted))
+		obs_task_group_wait(filter->group);
+	if (df->pending)
+		filter->num_pending--;
+
+	if (df->frame) {
+		obs_source_release_frame(parent, df->source_frame);
+		output = df->frame;
+	} else {
+		output = df->source_frame;
+	}
+
+	bfree(df);
 	return output;
 }
 
@@ -2,6 +2,7 @@
 #include <graphics/matrix4.h>
 #include <graphics/vec2.h>
 #include <graphics/vec4.h>
+#include <util/platform.h>
 
 /* clang-format off */
 
@@ -79,6 +80,8 @@ struct chroma_key_filter_data_v2 {
 	float similarity;
 	float smoothness;
 	float spill;
+
+	char *fusion_code;
 };
 
 static const char *chroma_key_name(void *unused)
@@ -242,6 +245,7 @@ static void chroma_key_destroy_v2(void *data)
 		obs_leave_graphics();
 	}
 
+	bfree(filter->fusion_code);
 	bfree(data);
 }
 
@@ -326,6 +330,10 @@ static void *chroma_key_create_v2(obs_data_t *settings, obs_source_t *context)
 
 	bfree(effect_path);
 
+	char *fusion_path = obs_module_file("chroma_key_fusion.effect");
+	filter->fusion_code = os_quick_read_utf8_file(fusion_path);
+	bfree(fusion_path);
+
 	if (!filter->effect) {
 		chroma_key_destroy_v2(filter);
 		return NULL;
@@ -395,6 +403,39 @@ static void chroma_key_render_v2(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+static bool chroma_key_get_fusion_v2(void *data,
+				     struct obs_filter_fusion *fusion)
+{
+	struct chroma_key_filter_data_v2 *filter = data;
+
+	fusion->code = filter->fusion_code;
+	fusion->flags = OBS_FUSION_LINEAR_SRGB | OBS_FUSION_SAMPLES_INPUT;
+	return filter->fusion_code != NULL;
+}
+
+static void chroma_key_fusion_render_v2(void *data, obs_fusion_pass_t *pass)
+{
+	struct chroma_key_filter_data_v2 *filter = data;
+	obs_source_t *target = obs_filter_get_target(filter->context);
+	uint32_t width = obs_source_get_base_width(target);
+	uint32_t height = obs_source_get_base_height(target);
+	struct vec2 pixel_size;
+
+	vec2_set(&pixel_size, 1.0f / (float)width, 1.0f / (float)height);
+
+#define get_param(name) obs_fusion_pass_get_param(pass, name)
+	gs_effect_set_float(get_param("opacity"), filter->opacity);
+	gs_effect_set_float(get_param("contrast"), filter->contrast);
+	gs_effect_set_float(get_param("brightness"), filter->brightness);
+	gs_effect_set_float(get_param("gamma"), filter->gamma);
+	gs_effect_set_vec2(get_param("chroma_key"), &filter->chroma);
+	gs_effect_set_vec2(get_param("pixel_size"), &pixel_size);
+	gs_effect_set_float(get_param("similarity"), filter->similarity);
+	gs_effect_set_float(get_param("smoothness"), filter->smoothness);
+	gs_effect_set_float(get_param("spill"), filter->spill);
+#undef get_param
+}
+
 static bool key_type_changed(obs_properties_t *props, obs_property_t *p,
 			     obs_data_t *settings)
 {
@@ -518,4 +559,6 @@ struct obs_source_info chroma_key_filter_v2 = {
 	.update = chroma_key_update_v2,
 	.get_properties = chroma_key_properties_v2,
 	.get_defaults = chroma_key_defaults,
+	.filter_get_fusion = chroma_key_get_fusion_v2,
+	.filter_fusion_render = chroma_key_fusion_render_v2,
 };
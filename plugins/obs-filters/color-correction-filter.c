@@ -17,6 +17,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <obs-module.h>
 #include <graphics/matrix4.h>
 #include <graphics/quat.h>
+#include <util/platform.h>
 
 /* clang-format off */
 
@@ -77,6 +78,8 @@ struct color_correction_filter_data_v2 {
 	struct matrix4 final_matrix;
 
 	struct vec3 half_unit;
+
+	char *fusion_code;
 };
 
 static const float root3 = 0.57735f;
@@ -407,6 +410,7 @@ static void color_correction_filter_destroy_v2(void *data)
 		obs_leave_graphics();
 	}
 
+	bfree(filter->fusion_code);
 	bfree(data);
 }
 
@@ -520,6 +524,12 @@ static void *color_correction_filter_create_v2(obs_data_t *settings,
 
 	bfree(effect_path);
 
+	/* Per-pixel form of the effect, for drawing in one pass with other
+	 * filters. */
+	char *fusion_path = obs_module_file("color_correction_fusion.effect");
+	filter->fusion_code = os_quick_read_utf8_file(fusion_path);
+	bfree(fusion_path);
+
 	/*
 	 * If the filter has been removed/deactivated, destroy the filter
 	 * and exit out so we don't crash OBS by telling it to update
@@ -578,6 +588,28 @@ static void color_correction_filter_render_v2(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+static bool color_correction_filter_get_fusion_v2(
+	void *data, struct obs_filter_fusion *fusion)
+{
+	struct color_correction_filter_data_v2 *filter = data;
+
+	fusion->code = filter->fusion_code;
+	fusion->flags = OBS_FUSION_LINEAR_SRGB;
+	return filter->fusion_code != NULL;
+}
+
+/* Same parameters as color_correction_filter_render_v2, for the fused pass. */
+static void color_correction_filter_fusion_render_v2(void *data,
+						     obs_fusion_pass_t *pass)
+{
+	struct color_correction_filter_data_v2 *filter = data;
+
+	gs_effect_set_float(obs_fusion_pass_get_param(pass, SETTING_GAMMA),
+			    filter->gamma);
+	gs_effect_set_matrix4(obs_fusion_pass_get_param(pass, "color_matrix"),
+			      &filter->final_matrix);
+}
+
 /*
  * This function sets the interface. the types (add_*_Slider), the type of
  * data collected (int), the internal name, user-facing name, minimum,
@@ -693,4 +725,6 @@ struct obs_source_info color_filter_v2 = {
 	.update = color_correction_filter_update_v2,
 	.get_properties = color_correction_filter_properties_v2,
 	.get_defaults = color_correction_filter_defaults_v2,
+	.filter_get_fusion = color_correction_filter_get_fusion_v2,
+	.filter_fusion_render = color_correction_filter_fusion_render_v2,
 };
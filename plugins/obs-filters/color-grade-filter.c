@@ -1,8 +1,11 @@
 #include <obs-module.h>
 #include <graphics/half.h>
 #include <graphics/image-file.h>
+#include <util/darray.h>
 #include <util/dstr.h>
 #include <util/platform.h>
+#include <util/threading.h>
+#include <sys/stat.h>
 
 /* clang-format off */
 
@@ -21,23 +24,42 @@ enum clut_dimension {
 	CLUT_3D,
 };
 
+/*
+ * LUTs are shared by every filter that uses the same file, as long as the
+ * file has not been modified since it was loaded.  Files are parsed on the
+ * task pool, and the texture is created by the first render after that, so
+ * updating a filter never blocks the graphics thread.
+ */
+struct clut {
+	char *path;
+	time_t mtime;
+	long refs;
+
+	volatile bool loaded;
+	enum clut_dimension dim;
+	uint32_t width;
+	enum gs_color_format format;
+	void *data;
+	gs_texture_t *texture;
+
+	struct vec3 clut_scale;
+	struct vec3 clut_offset;
+	struct vec3 domain_min;
+	struct vec3 domain_max;
+};
+
+static pthread_mutex_t clut_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct clut *) cluts;
+
 struct lut_filter_data {
 	obs_source_t *context;
 	gs_effect_t *effect;
-	gs_texture_t *target;
+	char *fusion_code[2];
 
-	gs_image_file_t image;
-
-	uint32_t cube_width;
-	void *cube_data;
+	struct clut *clut;
 
 	char *file;
 	float clut_amount;
-	enum clut_dimension clut_dim;
-	struct vec3 clut_scale;
-	struct vec3 clut_offset;
-	struct vec3 domain_min;
-	struct vec3 domain_max;
 };
 
 static const char *color_grade_filter_get_name(void *unused)
@@ -46,10 +68,11 @@ static const char *color_grade_filter_get_name(void *unused)
 	return obs_module_text("ColorGradeFilter");
 }
 
-static gs_texture_t *make_clut_texture_png(const enum gs_color_format format,
-					   const uint32_t image_width,
-					   const uint32_t image_height,
-					   const uint8_t *data)
+/* reorders the slices of a PNG LUT into volume texture order */
+static uint8_t *reorder_clut_png(const enum gs_color_format format,
+				 const uint32_t image_width,
+				 const uint32_t image_height,
+				 const uint8_t *data)
 {
 	if (image_width % LUT_WIDTH != 0)
 		return NULL;
@@ -86,12 +109,7 @@ static gs_texture_t *make_clut_texture_png(const enum gs_color_format format,
 		}
 	}
 
-	gs_texture_t *const texture =
-		gs_voltexture_create(LUT_WIDTH, LUT_WIDTH, LUT_WIDTH, format, 1,
-				     (const uint8_t **)&buffer, 0);
-	bfree(buffer);
-
-	return texture;
+	return buffer;
 }
 
 static bool get_cube_entry(FILE *const file, float *const red,
@@ -237,6 +255,165 @@ static void *load_cube_file(const char *const path, uint32_t *const width,
 	return data;
 }
 
+static void load_png_clut(struct clut *clut)
+{
+	uint32_t cx, cy;
+	uint8_t *data = gs_create_texture_file_data(clut->path, &clut->format,
+						    &cx, &cy);
+
+	if (data) {
+		clut->data = reorder_clut_png(clut->format, cx, cy, data);
+		bfree(data);
+	}
+
+	const float clut_scale = (float)(LUT_WIDTH - 1);
+	vec3_set(&clut->clut_scale, clut_scale, clut_scale, clut_scale);
+	vec3_set(&clut->clut_offset, 0.f, 0.f, 0.f);
+	clut->width = LUT_WIDTH;
+	clut->dim = CLUT_3D;
+}
+
+static void load_cube_clut(struct clut *clut)
+{
+	clut->data = load_cube_file(clut->path, &clut->width,
+				    &clut->domain_min, &clut->domain_max,
+				    &clut->dim);
+	clut->format = GS_RGBA16F;
+	if (!clut->data)
+		return;
+
+	const uint32_t width = clut->width;
+
+	struct vec3 domain_scale;
+	vec3_sub(&domain_scale, &clut->domain_max, &clut->domain_min);
+
+	const float width_minus_one = (float)(width - 1);
+	vec3_set(&clut->clut_scale, width_minus_one, width_minus_one,
+		 width_minus_one);
+	vec3_div(&clut->clut_scale, &clut->clut_scale, &domain_scale);
+
+	vec3_neg(&clut->clut_offset, &clut->domain_min);
+	vec3_mul(&clut->clut_offset, &clut->clut_offset, &clut->clut_scale);
+
+	/* 1D shader wants normalized UVW */
+	if (clut->dim == CLUT_1D) {
+		vec3_divf(&clut->clut_scale, &clut->clut_scale, (float)width);
+
+		vec3_addf(&clut->clut_offset, &clut->clut_offset, 0.5f);
+		vec3_divf(&clut->clut_offset, &clut->clut_offset, (float)width);
+	}
+}
+
+static void clut_release(struct clut *clut)
+{
+	bool last;
+
+	if (!clut)
+		return;
+
+	pthread_mutex_lock(&clut_mutex);
+	last = --clut->refs == 0;
+	if (last) {
+		da_erase_item(cluts, &clut);
+		if (!cluts.num)
+			da_free(cluts);
+	}
+	pthread_mutex_unlock(&clut_mutex);
+
+	if (!last)
+		return;
+
+	if (clut->texture) {
+		obs_enter_graphics();
+		if (clut->dim == CLUT_1D)
+			gs_texture_destroy(clut->texture);
+		else
+			gs_voltexture_destroy(clut->texture);
+		obs_leave_graphics();
+	}
+
+	bfree(clut->data);
+	bfree(clut->path);
+	bfree(clut);
+}
+
+static void clut_load_task(void *param)
+{
+	struct clut *clut = param;
+
+	const char *const ext = os_get_path_extension(clut->path);
+	if (ext && astrcmpi(ext, ".cube") == 0)
+		load_cube_clut(clut);
+	else
+		load_png_clut(clut);
+
+	if (!clut->data)
+		blog(LOG_WARNING, "[Color Grade Filter] Failed to load '%s'",
+		     clut->path);
+
+	os_atomic_set_bool(&clut->loaded, true);
+	clut_release(clut);
+}
+
+static time_t get_mtime(const char *path)
+{
+	struct stat st;
+	return os_stat(path, &st) == 0 ? st.st_mtime : 0;
+}
+
+static struct clut *clut_acquire(const char *path)
+{
+	const time_t mtime = get_mtime(path);
+	struct clut *clut = NULL;
+
+	pthread_mutex_lock(&clut_mutex);
+	for (size_t i = 0; i < cluts.num; i++) {
+		struct clut *entry = cluts.array[i];
+		if (entry->mtime == mtime && strcmp(entry->path, path) == 0) {
+			entry->refs++;
+			pthread_mutex_unlock(&clut_mutex);
+			return entry;
+		}
+	}
+
+	clut = bzalloc(sizeof(struct clut));
+	clut->path = bstrdup(path);
+	clut->mtime = mtime;
+	/* one for the load task */
+	clut->refs = 2;
+	vec3_set(&clut->domain_min, 0.0f, 0.0f, 0.0f);
+	vec3_set(&clut->domain_max, 1.0f, 1.0f, 1.0f);
+	da_push_back(cluts, &clut);
+	pthread_mutex_unlock(&clut_mutex);
+
+	obs_queue_pool_task(OBS_TASK_PRIORITY_NORMAL, clut_load_task, clut);
+	return clut;
+}
+
+/* only called from the graphics thread */
+static gs_texture_t *clut_get_texture(struct clut *clut)
+{
+	if (!clut || !os_atomic_load_bool(&clut->loaded))
+		return NULL;
+	if (clut->texture || !clut->data)
+		return clut->texture;
+
+	const uint32_t width = clut->width;
+	if (clut->dim == CLUT_1D) {
+		clut->texture = gs_texture_create(
+			width, 1, clut->format, 1,
+			(const uint8_t **)&clut->data, 0);
+	} else {
+		clut->texture = gs_voltexture_create(
+			width, width, width, clut->format, 1,
+			(const uint8_t **)&clut->data, 0);
+	}
+
+	bfree(clut->data);
+	clut->data = NULL;
+	return clut->texture;
+}
+
 static void color_grade_filter_update(void *data, obs_data_t *settings)
 {
 	struct lut_filter_data *filter = data;
@@ -254,91 +431,17 @@ static void color_grade_filter_update(void *data, obs_data_t *settings)
 	else
 		filter->file = NULL;
 
-	bfree(filter->cube_data);
-	filter->cube_data = NULL;
-
-	obs_enter_graphics();
-	gs_image_file_free(&filter->image);
-	gs_voltexture_destroy(filter->target);
-	filter->target = NULL;
-	obs_leave_graphics();
-
-	if (path) {
-		vec3_set(&filter->domain_min, 0.0f, 0.0f, 0.0f);
-		vec3_set(&filter->domain_max, 1.0f, 1.0f, 1.0f);
-
-		const char *const ext = os_get_path_extension(path);
-		if (ext && astrcmpi(ext, ".cube") == 0) {
-			filter->cube_data = load_cube_file(
-				path, &filter->cube_width, &filter->domain_min,
-				&filter->domain_max, &filter->clut_dim);
-		} else {
-			gs_image_file_init(&filter->image, path);
-			filter->cube_width = LUT_WIDTH;
-			filter->clut_dim = CLUT_3D;
-		}
-	}
+	/* acquired before the old one is released, so that an unchanged file
+	 * is not loaded again */
+	struct clut *clut = path ? clut_acquire(path) : NULL;
 
 	obs_enter_graphics();
-
-	if (path) {
-		if (filter->image.loaded) {
-			filter->target = make_clut_texture_png(
-				filter->image.format, filter->image.cx,
-				filter->image.cy, filter->image.texture_data);
-			const float clut_scale = (float)(LUT_WIDTH - 1);
-			vec3_set(&filter->clut_scale, clut_scale, clut_scale,
-				 clut_scale);
-			vec3_set(&filter->clut_offset, 0.f, 0.f, 0.f);
-		} else if (filter->cube_data) {
-			const uint32_t width = filter->cube_width;
-			if (filter->clut_dim == CLUT_1D) {
-				filter->target = gs_texture_create(
-					width, 1, GS_RGBA16F, 1,
-					(const uint8_t **)&filter->cube_data,
-					0);
-			} else {
-				filter->target = gs_voltexture_create(
-					width, width, width, GS_RGBA16F, 1,
-					(const uint8_t **)&filter->cube_data,
-					0);
-			}
-
-			struct vec3 domain_scale;
-			vec3_sub(&domain_scale, &filter->domain_max,
-				 &filter->domain_min);
-
-			const float width_minus_one = (float)(width - 1);
-			vec3_set(&filter->clut_scale, width_minus_one,
-				 width_minus_one, width_minus_one);
-			vec3_div(&filter->clut_scale, &filter->clut_scale,
-				 &domain_scale);
-
-			vec3_neg(&filter->clut_offset, &filter->domain_min);
-			vec3_mul(&filter->clut_offset, &filter->clut_offset,
-				 &filter->clut_scale);
-
-			/* 1D shader wants normalized UVW */
-			if (filter->clut_dim == CLUT_1D) {
-				vec3_divf(&filter->clut_scale,
-					  &filter->clut_scale, (float)width);
-
-				vec3_addf(&filter->clut_offset,
-					  &filter->clut_offset, 0.5f);
-				vec3_divf(&filter->clut_offset,
-					  &filter->clut_offset, (float)width);
-			}
-		}
-	}
-
+	struct clut *old_clut = filter->clut;
+	filter->clut = clut;
 	filter->clut_amount = (float)clut_amount;
-
-	char *effect_path = obs_module_file("color_grade_filter.effect");
-	gs_effect_destroy(filter->effect);
-	filter->effect = gs_effect_create_from_file(effect_path, NULL);
-	bfree(effect_path);
-
 	obs_leave_graphics();
+
+	clut_release(old_clut);
 }
 
 static void color_grade_filter_defaults(obs_data_t *settings)
@@ -383,39 +486,60 @@ static obs_properties_t *color_grade_filter_properties(void *data)
 	return props;
 }
 
-static void *color_grade_filter_create(obs_data_t *settings,
-				       obs_source_t *context)
-{
-	struct lut_filter_data *filter =
-		bzalloc(sizeof(struct lut_filter_data));
-	filter->context = context;
-
-	obs_source_update(context, settings);
-	return filter;
-}
-
 static void color_grade_filter_destroy(void *data)
 {
 	struct lut_filter_data *filter = data;
 
 	obs_enter_graphics();
 	gs_effect_destroy(filter->effect);
-	gs_voltexture_destroy(filter->target);
-	gs_image_file_free(&filter->image);
 	obs_leave_graphics();
 
-	bfree(filter->cube_data);
+	clut_release(filter->clut);
+	bfree(filter->fusion_code[CLUT_1D]);
+	bfree(filter->fusion_code[CLUT_3D]);
 	bfree(filter->file);
 	bfree(filter);
 }
 
+static char *read_fusion_code(const char *file)
+{
+	char *path = obs_module_file(file);
+	char *code = os_quick_read_utf8_file(path);
+	bfree(path);
+	return code;
+}
+
+static void *color_grade_filter_create(obs_data_t *settings,
+				       obs_source_t *context)
+{
+	struct lut_filter_data *filter =
+		bzalloc(sizeof(struct lut_filter_data));
+	filter->context = context;
+
+	char *effect_path = obs_module_file("color_grade_filter.effect");
+	obs_enter_graphics();
+	filter->effect = gs_effect_create_from_file(effect_path, NULL);
+	obs_leave_graphics();
+	bfree(effect_path);
+
+	filter->fusion_code[CLUT_1D] =
+		read_fusion_code("color_grade_1d_fusion.effect");
+	filter->fusion_code[CLUT_3D] =
+		read_fusion_code("color_grade_3d_fusion.effect");
+
+	obs_source_update(context, settings);
+	return filter;
+}
+
 static void color_grade_filter_render(void *data, gs_effect_t *effect)
 {
 	struct lut_filter_data *filter = data;
 	obs_source_t *target = obs_filter_get_target(filter->context);
+	struct clut *clut = filter->clut;
+	gs_texture_t *texture = clut_get_texture(clut);
 	gs_eparam_t *param;
 
-	if (!target || !filter->target || !filter->effect) {
+	if (!target || !texture || !filter->effect) {
 		obs_source_skip_video_filter(filter->context);
 		return;
 	}
@@ -426,31 +550,31 @@ static void color_grade_filter_render(void *data, gs_effect_t *effect)
 
 	const char *clut_texture_name = "clut_3d";
 	const char *tech_name = "Draw3D";
-	if (filter->clut_dim == CLUT_1D) {
+	if (clut->dim == CLUT_1D) {
 		clut_texture_name = "clut_1d";
 		tech_name = "Draw1D";
 	}
 
 	param = gs_effect_get_param_by_name(filter->effect, clut_texture_name);
-	gs_effect_set_texture(param, filter->target);
+	gs_effect_set_texture(param, texture);
 
 	param = gs_effect_get_param_by_name(filter->effect, "clut_amount");
 	gs_effect_set_float(param, filter->clut_amount);
 
 	param = gs_effect_get_param_by_name(filter->effect, "clut_scale");
-	gs_effect_set_vec3(param, &filter->clut_scale);
+	gs_effect_set_vec3(param, &clut->clut_scale);
 
 	param = gs_effect_get_param_by_name(filter->effect, "clut_offset");
-	gs_effect_set_vec3(param, &filter->clut_offset);
+	gs_effect_set_vec3(param, &clut->clut_offset);
 
 	param = gs_effect_get_param_by_name(filter->effect, "domain_min");
-	gs_effect_set_vec3(param, &filter->domain_min);
+	gs_effect_set_vec3(param, &clut->domain_min);
 
 	param = gs_effect_get_param_by_name(filter->effect, "domain_max");
-	gs_effect_set_vec3(param, &filter->domain_max);
+	gs_effect_set_vec3(param, &clut->domain_max);
 
 	param = gs_effect_get_param_by_name(filter->effect, "cube_width_i");
-	gs_effect_set_float(param, 1.0f / filter->cube_width);
+	gs_effect_set_float(param, 1.0f / clut->width);
 
 	const bool previous = gs_set_linear_srgb(true);
 	obs_source_process_filter_tech_end(filter->context, filter->effect, 0,
@@ -460,6 +584,45 @@ static void color_grade_filter_render(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+/* not fused until the LUT is ready, the filter is skipped until then */
+static bool color_grade_filter_get_fusion(void *data,
+					  struct obs_filter_fusion *fusion)
+{
+	struct lut_filter_data *filter = data;
+
+	if (!clut_get_texture(filter->clut))
+		return false;
+
+	fusion->code = filter->fusion_code[filter->clut->dim];
+	fusion->flags = OBS_FUSION_LINEAR_SRGB;
+	return fusion->code != NULL;
+}
+
+/* Same parameters as color_grade_filter_render, for the fused pass. */
+static void color_grade_filter_fusion_render(void *data,
+					     obs_fusion_pass_t *pass)
+{
+	struct lut_filter_data *filter = data;
+	struct clut *clut = filter->clut;
+
+	gs_effect_set_texture(obs_fusion_pass_get_param(pass, "clut"),
+			      clut->texture);
+	gs_effect_set_float(obs_fusion_pass_get_param(pass, "amount"),
+			    filter->clut_amount);
+	gs_effect_set_vec3(obs_fusion_pass_get_param(pass, "scale"),
+			   &clut->clut_scale);
+	gs_effect_set_vec3(obs_fusion_pass_get_param(pass, "offset"),
+			   &clut->clut_offset);
+	gs_effect_set_vec3(obs_fusion_pass_get_param(pass, "domain_min"),
+			   &clut->domain_min);
+	gs_effect_set_vec3(obs_fusion_pass_get_param(pass, "domain_max"),
+			   &clut->domain_max);
+
+	if (clut->dim == CLUT_3D)
+		gs_effect_set_float(obs_fusion_pass_get_param(pass, "width_i"),
+				    1.0f / clut->width);
+}
+
 struct obs_source_info color_grade_filter = {
 	.id = "clut_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
@@ -471,4 +634,6 @@ struct obs_source_info color_grade_filter = {
 	.get_defaults = color_grade_filter_defaults,
 	.get_properties = color_grade_filter_properties,
 	.video_render = color_grade_filter_render,
+	.filter_get_fusion = color_grade_filter_get_fusion,
+	.filter_fusion_render = color_grade_filter_fusion_render,
 };
@@ -2,6 +2,7 @@
 #include <graphics/matrix4.h>
 #include <graphics/vec2.h>
 #include <graphics/vec4.h>
+#include <util/platform.h>
 
 /* clang-format off */
 
@@ -71,6 +72,8 @@ struct color_key_filter_data_v2 {
 	struct vec4 key_color;
 	float similarity;
 	float smoothness;
+
+	char *fusion_code;
 };
 
 static const char *color_key_name(void *unused)
@@ -214,6 +217,7 @@ static void color_key_destroy_v2(void *data)
 		obs_leave_graphics();
 	}
 
+	bfree(filter->fusion_code);
 	bfree(data);
 }
 
@@ -290,6 +294,10 @@ static void *color_key_create_v2(obs_data_t *settings, obs_source_t *context)
 
 	bfree(effect_path);
 
+	char *fusion_path = obs_module_file("color_key_fusion.effect");
+	filter->fusion_code = os_quick_read_utf8_file(fusion_path);
+	bfree(fusion_path);
+
 	if (!filter->effect) {
 		color_key_destroy_v2(filter);
 		return NULL;
@@ -343,6 +351,31 @@ static void color_key_render_v2(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+static bool color_key_get_fusion_v2(void *data,
+				    struct obs_filter_fusion *fusion)
+{
+	struct color_key_filter_data_v2 *filter = data;
+
+	fusion->code = filter->fusion_code;
+	fusion->flags = OBS_FUSION_LINEAR_SRGB;
+	return filter->fusion_code != NULL;
+}
+
+static void color_key_fusion_render_v2(void *data, obs_fusion_pass_t *pass)
+{
+	struct color_key_filter_data_v2 *filter = data;
+
+#define get_param(name) obs_fusion_pass_get_param(pass, name)
+	gs_effect_set_float(get_param("opacity"), filter->opacity);
+	gs_effect_set_float(get_param("contrast"), filter->contrast);
+	gs_effect_set_float(get_param("brightness"), filter->brightness);
+	gs_effect_set_float(get_param("gamma"), filter->gamma);
+	gs_effect_set_vec4(get_param("key_color"), &filter->key_color);
+	gs_effect_set_float(get_param("similarity"), filter->similarity);
+	gs_effect_set_float(get_param("smoothness"), filter->smoothness);
+#undef get_param
+}
+
 static bool key_type_changed(obs_properties_t *props, obs_property_t *p,
 			     obs_data_t *settings)
 {
@@ -465,4 +498,6 @@ struct obs_source_info color_key_filter_v2 = {
 	.update = color_key_update_v2,
 	.get_properties = color_key_properties_v2,
 	.get_defaults = color_key_defaults,
+	.filter_get_fusion = color_key_get_fusion_v2,
+	.filter_fusion_render = color_key_fusion_render_v2,
 };
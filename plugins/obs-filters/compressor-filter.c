@@ -7,6 +7,7 @@
 #include <util/platform.h>
 #include <util/circlebuf.h>
 #include <util/threading.h>
+#include "dynamics.h"
 
 /* -------------------------------------------------------- */
 
@@ -33,6 +34,7 @@
 #define S_RELEASE_TIME                  "release_time"
 #define S_OUTPUT_GAIN                   "output_gain"
 #define S_SIDECHAIN_SOURCE              "sidechain_source"
+#define S_LOOKAHEAD_TIME                "lookahead_time"
 
 #define MT_ obs_module_text
 #define TEXT_RATIO                      MT_("Compressor.Ratio")
@@ -41,6 +43,7 @@
 #define TEXT_RELEASE_TIME               MT_("Compressor.ReleaseTime")
 #define TEXT_OUTPUT_GAIN                MT_("Compressor.OutputGain")
 #define TEXT_SIDECHAIN_SOURCE           MT_("Compressor.SidechainSource")
+#define TEXT_LOOKAHEAD_TIME             MT_("Compressor.LookaheadTime")
 
 #define MIN_RATIO                       1.0
 #define MAX_RATIO                       32.0
@@ -51,6 +54,7 @@
 #define MIN_ATK_RLS_MS                  1
 #define MAX_RLS_MS                      1000
 #define MAX_ATK_MS                      500
+#define MAX_LOOKAHEAD_MS                20
 #define DEFAULT_AUDIO_BUF_MS            10
 
 #define MS_IN_S                         1000
@@ -75,6 +79,7 @@ struct compressor_data {
 	size_t sample_rate;
 	float envelope;
 	float slope;
+	struct dyn_lookahead lookahead;
 
 	pthread_mutex_t sidechain_update_mutex;
 	uint64_t sidechain_check_time;
@@ -200,6 +205,8 @@ static void compressor_update(void *data, obs_data_t *s)
 	const float output_gain_db =
 		(float)obs_data_get_double(s, S_OUTPUT_GAIN);
 	const char *sidechain_name = obs_data_get_string(s, S_SIDECHAIN_SOURCE);
+	const size_t lookahead_ms =
+		(size_t)obs_data_get_int(s, S_LOOKAHEAD_TIME);
 
 	cd->ratio = (float)obs_data_get_double(s, S_RATIO);
 	cd->threshold = (float)obs_data_get_double(s, S_THRESHOLD);
@@ -211,6 +218,8 @@ static void compressor_update(void *data, obs_data_t *s)
 	cd->num_channels = num_channels;
 	cd->sample_rate = sample_rate;
 	cd->slope = 1.0f - (1.0f / cd->ratio);
+	dyn_lookahead_set(&cd->lookahead, num_channels,
+			  sample_rate * lookahead_ms / MS_IN_S);
 
 	bool valid_sidechain = *sidechain_name &&
 			       strcmp(sidechain_name, "none") != 0;
@@ -305,6 +314,7 @@ static void compressor_destroy(void *data)
 	pthread_mutex_destroy(&cd->sidechain_mutex);
 	pthread_mutex_destroy(&cd->sidechain_update_mutex);
 
+	dyn_lookahead_free(&cd->lookahead);
 	bfree(cd->sidechain_name);
 	bfree(cd->envelope_buf);
 	bfree(cd);
@@ -317,27 +327,9 @@ static void analyze_envelope(struct compressor_data *cd, float **samples,
 		resize_env_buffer(cd, num_samples);
 	}
 
-	const float attack_gain = cd->attack_gain;
-	const float release_gain = cd->release_gain;
-
-	memset(cd->envelope_buf, 0, num_samples * sizeof(cd->envelope_buf[0]));
-	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
-		if (!samples[chan])
-			continue;
-
-		float *envelope_buf = cd->envelope_buf;
-		float env = cd->envelope;
-		for (uint32_t i = 0; i < num_samples; ++i) {
-			const float env_in = fabsf(samples[chan][i]);
-			if (env < env_in) {
-				env = env_in + attack_gain * (env - env_in);
-			} else {
-				env = env_in + release_gain * (env - env_in);
-			}
-			envelope_buf[i] = fmaxf(envelope_buf[i], env);
-		}
-	}
-	cd->envelope = cd->envelope_buf[num_samples - 1];
+	dyn_peak_envelope(cd->envelope_buf, samples, cd->num_channels,
+			  num_samples, cd->attack_gain, cd->release_gain,
+			  &cd->envelope);
 }
 
 static void analyze_sidechain(struct compressor_data *cd,
@@ -349,45 +341,23 @@ static void analyze_sidechain(struct compressor_data *cd,
 
 	get_sidechain_data(cd, num_samples);
 
-	const float attack_gain = cd->attack_gain;
-	const float release_gain = cd->release_gain;
-	float **sidechain_buf = cd->sidechain_buf;
-
-	memset(cd->envelope_buf, 0, num_samples * sizeof(cd->envelope_buf[0]));
-	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
-		if (!sidechain_buf[chan])
-			continue;
-
-		float *envelope_buf = cd->envelope_buf;
-		float env = cd->envelope;
-		for (uint32_t i = 0; i < num_samples; ++i) {
-			const float env_in = fabsf(sidechain_buf[chan][i]);
-
-			if (env < env_in) {
-				env = env_in + attack_gain * (env - env_in);
-			} else {
-				env = env_in + release_gain * (env - env_in);
-			}
-			envelope_buf[i] = fmaxf(envelope_buf[i], env);
-		}
-	}
-	cd->envelope = cd->envelope_buf[num_samples - 1];
+	dyn_peak_envelope(cd->envelope_buf, cd->sidechain_buf,
+			  cd->num_channels, num_samples, cd->attack_gain,
+			  cd->release_gain, &cd->envelope);
 }
 
-static inline void process_compression(const struct compressor_data *cd,
+static inline void process_compression(struct compressor_data *cd,
 				       float **samples, uint32_t num_samples)
 {
-	for (size_t i = 0; i < num_samples; ++i) {
-		const float env_db = mul_to_db(cd->envelope_buf[i]);
-		float gain = cd->slope * (cd->threshold - env_db);
-		gain = db_to_mul(fminf(0, gain));
-
-		for (size_t c = 0; c < cd->num_channels; ++c) {
-			if (samples[c]) {
-				samples[c][i] *= gain * cd->output_gain;
-			}
-		}
-	}
+	/* the envelope buffer is reused for the gain */
+	float *gain = cd->envelope_buf;
+
+	dyn_lookahead_envelope(&cd->lookahead, gain, num_samples);
+	dyn_compress(gain, gain, num_samples, cd->threshold, cd->slope,
+		     cd->output_gain);
+
+	dyn_lookahead_delay(&cd->lookahead, samples, num_samples);
+	dyn_apply_gain(samples, cd->num_channels, gain, num_samples);
 }
 
 static void compressor_tick(void *data, float seconds)
@@ -471,6 +441,7 @@ static void compressor_defaults(obs_data_t *s)
 	obs_data_set_default_int(s, S_RELEASE_TIME, 60);
 	obs_data_set_default_double(s, S_OUTPUT_GAIN, 0.0f);
 	obs_data_set_default_string(s, S_SIDECHAIN_SOURCE, "none");
+	obs_data_set_default_int(s, S_LOOKAHEAD_TIME, 0);
 }
 
 struct sidechain_prop_info {
@@ -523,6 +494,10 @@ static obs_properties_t *compressor_properties(void *data)
 					    MIN_OUTPUT_GAIN_DB,
 					    MAX_OUTPUT_GAIN_DB, 0.1);
 	obs_property_float_set_suffix(p, " dB");
+	p = obs_properties_add_int_slider(props, S_LOOKAHEAD_TIME,
+					  TEXT_LOOKAHEAD_TIME, 0,
+					  MAX_LOOKAHEAD_MS, 1);
+	obs_property_int_set_suffix(p, " ms");
 
 	obs_property_t *sources = obs_properties_add_list(
 		props, S_SIDECHAIN_SOURCE, TEXT_SIDECHAIN_SOURCE,
@@ -0,0 +1,338 @@
+#include <math.h>
+#include <string.h>
+
+#include <media-io/audio-mixing.h>
+#include <util/sse-intrin.h>
+#include "dynamics.h"
+
+/* 20 * log10(2) and its inverse */
+#define DB_PER_LOG2 6.0205999132796239f
+#define LOG2_PER_DB 0.16609640474436813f
+
+#define LN2 0.69314718055994531f
+#define SQRT2 1.41421356237309505f
+#define MIN_EXP2 -126.0f
+
+/* log2(x) = e + log2(m) with m in [sqrt(0.5), sqrt(2)), and
+ * log2(m) = 2/ln(2) * atanh((m - 1) / (m + 1)), whose series converges to
+ * float precision within four terms on that range */
+static inline float fast_log2(float x)
+{
+	union {
+		float f;
+		uint32_t i;
+	} u = {x};
+	float e = (float)((int)((u.i >> 23) & 0xff) - 127);
+	float t, t2;
+
+	u.i = (u.i & 0x7fffff) | 0x3f800000;
+	if (u.f > SQRT2) {
+		u.f *= 0.5f;
+		e += 1.0f;
+	}
+
+	t = (u.f - 1.0f) / (u.f + 1.0f);
+	t2 = t * t;
+	return e + t * (2.0f / LN2) *
+			   (1.0f +
+			    t2 * (1.0f / 3.0f +
+				  t2 * (1.0f / 5.0f + t2 * (1.0f / 7.0f))));
+}
+
+/* 2^y = 2^i * e^(f * ln(2)) with f in [-0.5, 0.5] */
+static inline float fast_exp2(float y)
+{
+	union {
+		float f;
+		uint32_t i;
+	} u;
+	float i, z, p;
+
+	if (!(y >= MIN_EXP2))
+		return 0.0f;
+	if (y > 127.0f)
+		y = 127.0f;
+
+	i = floorf(y + 0.5f);
+	z = (y - i) * LN2;
+	p = 1.0f +
+	    z * (1.0f +
+		 z * (0.5f +
+		      z * (1.0f / 6.0f +
+			   z * (1.0f / 24.0f +
+				z * (1.0f / 120.0f + z * (1.0f / 720.0f))))));
+
+	u.f = p;
+	u.i += (uint32_t)((int)i << 23);
+	return u.f;
+}
+
+static inline __m128 log2_ps(__m128 x)
+{
+	const __m128i bits = _mm_castps_si128(x);
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128i exp_i = _mm_sub_epi32(
+		_mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xff)),
+		_mm_set1_epi32(127));
+	__m128 m = _mm_castsi128_ps(
+		_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x7fffff)),
+			     _mm_set1_epi32(0x3f800000)));
+	__m128 e = _mm_cvtepi32_ps(exp_i);
+	__m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(SQRT2));
+	__m128 t, t2, p;
+
+	m = _mm_sub_ps(m, _mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f))));
+	e = _mm_add_ps(e, _mm_and_ps(big, one));
+
+	t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+	t2 = _mm_mul_ps(t, t);
+
+	p = _mm_add_ps(_mm_set1_ps(1.0f / 5.0f),
+		       _mm_mul_ps(t2, _mm_set1_ps(1.0f / 7.0f)));
+	p = _mm_add_ps(_mm_set1_ps(1.0f / 3.0f), _mm_mul_ps(t2, p));
+	p = _mm_add_ps(one, _mm_mul_ps(t2, p));
+	p = _mm_mul_ps(_mm_mul_ps(t, _mm_set1_ps(2.0f / LN2)), p);
+	return _mm_add_ps(e, p);
+}
+
+static inline __m128 exp2_ps(__m128 y)
+{
+	const __m128 valid = _mm_cmpge_ps(y, _mm_set1_ps(MIN_EXP2));
+	__m128i i;
+	__m128 z, p;
+
+	y = _mm_min_ps(_mm_max_ps(y, _mm_set1_ps(MIN_EXP2)),
+		       _mm_set1_ps(127.0f));
+
+	/* rounds to nearest */
+	i = _mm_cvtps_epi32(y);
+	z = _mm_mul_ps(_mm_sub_ps(y, _mm_cvtepi32_ps(i)), _mm_set1_ps(LN2));
+
+	p = _mm_add_ps(_mm_set1_ps(1.0f / 120.0f),
+		       _mm_mul_ps(z, _mm_set1_ps(1.0f / 720.0f)));
+	p = _mm_add_ps(_mm_set1_ps(1.0f / 24.0f), _mm_mul_ps(z, p));
+	p = _mm_add_ps(_mm_set1_ps(1.0f / 6.0f), _mm_mul_ps(z, p));
+	p = _mm_add_ps(_mm_set1_ps(0.5f), _mm_mul_ps(z, p));
+	p = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(z, p));
+	p = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(z, p));
+
+	p = _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(p),
+					   _mm_slli_epi32(i, 23)));
+	return _mm_and_ps(p, valid);
+}
+
+void dyn_mul_to_db(float *dst, const float *src, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(DB_PER_LOG2);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(src + i);
+		_mm_storeu_ps(dst + i, _mm_mul_ps(log2_ps(x), scale));
+	}
+	for (; i < count; i++)
+		dst[i] = fast_log2(src[i]) * DB_PER_LOG2;
+}
+
+void dyn_db_to_mul(float *dst, const float *src, size_t count)
+{
+	const __m128 scale = _mm_set1_ps(LOG2_PER_DB);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(src + i);
+		_mm_storeu_ps(dst + i, exp2_ps(_mm_mul_ps(x, scale)));
+	}
+	for (; i < count; i++)
+		dst[i] = fast_exp2(src[i] * LOG2_PER_DB);
+}
+
+static inline __m128 abs_ps(__m128 x)
+{
+	return _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+
+static inline float hmax_ps(__m128 x)
+{
+	x = _mm_max_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 0, 3, 2)));
+	x = _mm_max_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(x);
+}
+
+/* up to four channels are followed at once, one per lane; the arithmetic is
+ * the same as that of the scalar follower */
+static void follow_channels(float *dst, float *const *samples, size_t count,
+			    size_t frames, __m128 attack, __m128 release,
+			    float env)
+{
+	float *ch[4];
+	__m128 e = _mm_set1_ps(env);
+	__m128 lanes;
+
+	for (size_t c = 0; c < 4; c++)
+		ch[c] = c < count ? samples[c] : NULL;
+
+	/* lanes without a channel never rise above 0 */
+	lanes = _mm_castsi128_ps(_mm_set_epi32(ch[3] ? -1 : 0, ch[2] ? -1 : 0,
+					       ch[1] ? -1 : 0, ch[0] ? -1 : 0));
+
+	for (size_t i = 0; i < frames; i++) {
+		__m128 in = _mm_set_ps(ch[3] ? ch[3][i] : 0.0f,
+				       ch[2] ? ch[2][i] : 0.0f,
+				       ch[1] ? ch[1][i] : 0.0f,
+				       ch[0] ? ch[0][i] : 0.0f);
+		__m128 rising, coef;
+
+		in = abs_ps(in);
+		rising = _mm_cmplt_ps(e, in);
+		coef = _mm_or_ps(_mm_and_ps(rising, attack),
+				 _mm_andnot_ps(rising, release));
+		e = _mm_add_ps(in, _mm_mul_ps(coef, _mm_sub_ps(e, in)));
+
+		dst[i] = fmaxf(dst[i], hmax_ps(_mm_and_ps(e, lanes)));
+	}
+}
+
+void dyn_peak_envelope(float *dst, float *const *samples, size_t channels,
+		       size_t frames, float attack_gain, float release_gain,
+		       float *env)
+{
+	const __m128 attack = _mm_set1_ps(attack_gain);
+	const __m128 release = _mm_set1_ps(release_gain);
+
+	if (!frames)
+		return;
+
+	memset(dst, 0, frames * sizeof(float));
+
+	for (size_t c = 0; c < channels; c += 4)
+		follow_channels(dst, samples + c, channels - c, frames, attack,
+				release, *env);
+
+	*env = dst[frames - 1];
+}
+
+void dyn_peak_level(float *dst, float *const *samples, size_t channels,
+		    size_t frames)
+{
+	memset(dst, 0, frames * sizeof(float));
+
+	for (size_t c = 0; c < channels; c++) {
+		const float *src = samples[c];
+		size_t i = 0;
+
+		if (!src)
+			continue;
+
+		for (; i + 4 <= frames; i += 4) {
+			__m128 x = abs_ps(_mm_loadu_ps(src + i));
+			_mm_storeu_ps(dst + i,
+				      _mm_max_ps(_mm_loadu_ps(dst + i), x));
+		}
+		for (; i < frames; i++)
+			dst[i] = fmaxf(dst[i], fabsf(src[i]));
+	}
+}
+
+void dyn_compress(float *gain, const float *env, size_t frames,
+		  float threshold, float slope, float output_gain)
+{
+	dyn_mul_to_db(gain, env, frames);
+
+	for (size_t i = 0; i < frames; i++)
+		gain[i] = fminf(0.0f, slope * (threshold - gain[i]));
+
+	dyn_db_to_mul(gain, gain, frames);
+	if (output_gain != 1.0f)
+		audio_mix_scale(gain, output_gain, frames);
+}
+
+void dyn_apply_gain(float *const *samples, size_t channels, const float *gain,
+		    size_t frames)
+{
+	for (size_t c = 0; c < channels; c++) {
+		if (samples[c])
+			audio_mix_mul(samples[c], gain, frames);
+	}
+}
+
+void dyn_lookahead_set(struct dyn_lookahead *la, size_t channels,
+		       size_t frames)
+{
+	if (la->channels == channels && la->frames == frames)
+		return;
+
+	dyn_lookahead_free(la);
+	la->channels = channels;
+	la->frames = frames;
+
+	if (!frames)
+		return;
+
+	for (size_t c = 0; c < channels; c++)
+		circlebuf_push_back_zero(&la->delay[c], frames * sizeof(float));
+
+	la->win_val = bmalloc((frames + 1) * sizeof(float));
+	la->win_pos = bmalloc((frames + 1) * sizeof(uint64_t));
+}
+
+void dyn_lookahead_envelope(struct dyn_lookahead *la, float *env,
+			    size_t frames)
+{
+	const size_t cap = la->frames + 1;
+
+	if (!la->frames)
+		return;
+
+	for (size_t i = 0; i < frames; i++) {
+		const uint64_t pos = la->pos++;
+		const float val = env[i];
+		size_t back;
+
+		while (la->win_count) {
+			back = (la->win_head + la->win_count - 1) % cap;
+			if (la->win_val[back] > val)
+				break;
+			la->win_count--;
+		}
+
+		back = (la->win_head + la->win_count) % cap;
+		la->win_val[back] = val;
+		la->win_pos[back] = pos;
+		la->win_count++;
+
+		if (la->win_pos[la->win_head] + la->frames < pos) {
+			la->win_head = (la->win_head + 1) % cap;
+			la->win_count--;
+		}
+
+		env[i] = la->win_val[la->win_head];
+	}
+}
+
+void dyn_lookahead_delay(struct dyn_lookahead *la, float *const *samples,
+			 size_t frames)
+{
+	const size_t size = frames * sizeof(float);
+
+	if (!la->frames)
+		return;
+
+	for (size_t c = 0; c < la->channels; c++) {
+		if (!samples[c])
+			continue;
+
+		circlebuf_push_back(&la->delay[c], samples[c], size);
+		circlebuf_pop_front(&la->delay[c], samples[c], size);
+	}
+}
+
+void dyn_lookahead_free(struct dyn_lookahead *la)
+{
+	for (size_t c = 0; c < MAX_AUDIO_CHANNELS; c++)
+		circlebuf_free(&la->delay[c]);
+
+	bfree(la->win_val);
+	bfree(la->win_pos);
+	memset(la, 0, sizeof(*la));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <obs-module.h>
+#include <util/circlebuf.h>
+
+/*
+ * Processing shared by the dynamics filters (compressor, limiter, expander
+ * and noise gate).  Everything works on whole blocks of planar float audio so
+ * that the per-sample work can be vectorized; only the recursive parts (the
+ * envelope and gate state) remain sample by sample.
+ *
+ * Channels that are NULL in a sample array are skipped.
+ */
+
+/* approximations of mul_to_db/db_to_mul for whole buffers, accurate to well
+ * below 0.001 dB.  silence converts to about -765 dB rather than -inf, and
+ * levels below -760 dB convert back to 0.  dst may be src */
+extern void dyn_mul_to_db(float *dst, const float *src, size_t count);
+extern void dyn_db_to_mul(float *dst, const float *src, size_t count);
+
+/* peak envelope of the loudest channel: each channel follows its absolute
+ * level from *env with the given attack and release coefficients, dst gets
+ * the maximum of the channels and *env the last value of dst */
+extern void dyn_peak_envelope(float *dst, float *const *samples,
+			      size_t channels, size_t frames,
+			      float attack_gain, float release_gain,
+			      float *env);
+
+/* absolute level of the loudest channel */
+extern void dyn_peak_level(float *dst, float *const *samples, size_t channels,
+			   size_t frames);
+
+/* turns an envelope into the gain of a downward compressor with the given
+ * threshold (dB) and slope, scaled by the linear output gain.  gain may be
+ * env */
+extern void dyn_compress(float *gain, const float *env, size_t frames,
+			 float threshold, float slope, float output_gain);
+
+/* multiplies every channel by the per-sample gain */
+extern void dyn_apply_gain(float *const *samples, size_t channels,
+			   const float *gain, size_t frames);
+
+/* look-ahead of a given number of frames: the audio is delayed by that many
+ * frames, and the envelope of each delayed frame becomes the maximum of the
+ * envelope over it and the frames that follow it, so that the gain is fully
+ * reduced by the time a peak is output */
+struct dyn_lookahead {
+	struct circlebuf delay[MAX_AUDIO_CHANNELS];
+	size_t channels;
+	size_t frames;
+
+	/* decreasing maxima of the window, oldest first */
+	float *win_val;
+	uint64_t *win_pos;
+	size_t win_head;
+	size_t win_count;
+	uint64_t pos;
+};
+
+extern void dyn_lookahead_set(struct dyn_lookahead *la, size_t channels,
+			      size_t frames);
+extern void dyn_lookahead_envelope(struct dyn_lookahead *la, float *env,
+				   size_t frames);
+extern void dyn_lookahead_delay(struct dyn_lookahead *la,
+				float *const *samples, size_t frames);
+extern void dyn_lookahead_free(struct dyn_lookahead *la);
@@ -7,6 +7,8 @@
 #include <util/platform.h>
 #include <util/circlebuf.h>
 #include <util/threading.h>
+#include <media-io/audio-mixing.h>
+#include "dynamics.h"
 
 /* -------------------------------------------------------- */
 
@@ -278,20 +280,20 @@ static void analyze_envelope(struct expander_data *cd, float **samples,
 		float *env_in = cd->env_in;
 
 		if (cd->detector == RMS_DETECT) {
-			runave[0] =
-				rmscoef * cd->runave[chan] +
-				(1 - rmscoef) * powf(samples[chan][0], 2.0f);
+			runave[0] = rmscoef * cd->runave[chan] +
+				    (1 - rmscoef) * samples[chan][0] *
+					    samples[chan][0];
 			env_in[0] = sqrtf(fmaxf(runave[0], 0));
 			for (uint32_t i = 1; i < num_samples; ++i) {
 				runave[i] =
 					rmscoef * runave[i - 1] +
-					(1 - rmscoef) *
-						powf(samples[chan][i], 2.0f);
+					(1 - rmscoef) * samples[chan][i] *
+						samples[chan][i];
 				env_in[i] = sqrtf(runave[i]);
 			}
 		} else if (cd->detector == PEAK_DETECT) {
 			for (uint32_t i = 0; i < num_samples; ++i) {
-				runave[i] = powf(samples[chan][i], 2);
+				runave[i] = samples[chan][i] * samples[chan][i];
 				env_in[i] = fabsf(samples[chan][i]);
 			}
 		}
@@ -316,46 +318,42 @@ static inline void process_expansion(struct expander_data *cd, float **samples,
 		memset(cd->gaindB[i], 0,
 		       num_samples * sizeof(cd->gaindB[i][0]));
 
+	/* env_in is free once the envelope is analyzed, it holds the envelope
+	 * in dB and then the gain of each channel in turn */
+	float *gain_buf = cd->env_in;
+
 	for (size_t chan = 0; chan < cd->num_channels; chan++) {
+		float *gaindB = cd->gaindB[chan];
+		float prev = cd->gaindB_buf[chan];
+
+		dyn_mul_to_db(gain_buf, cd->envelope_buf[chan], num_samples);
+
 		for (size_t i = 0; i < num_samples; ++i) {
 			// gain stage of expansion
-			float env_db = mul_to_db(cd->envelope_buf[chan][i]);
-			float gain =
-				cd->threshold - env_db > 0.0f
-					? fmaxf(cd->slope * (cd->threshold -
-							     env_db),
-						-60.0f)
-					: 0.0f;
+			const float under = cd->threshold - gain_buf[i];
+			float gain = 0.0f;
+			if (under > 0.0f)
+				gain = fmaxf(cd->slope * under, -60.0f);
 			// ballistics (attack/release)
-			if (i > 0) {
-				if (gain > cd->gaindB[chan][i - 1])
-					cd->gaindB[chan][i] =
-						attack_gain *
-							cd->gaindB[chan][i - 1] +
-						(1.0f - attack_gain) * gain;
-				else
-					cd->gaindB[chan][i] =
-						release_gain *
-							cd->gaindB[chan][i - 1] +
-						(1.0f - release_gain) * gain;
-			} else {
-				if (gain > cd->gaindB_buf[chan])
-					cd->gaindB[chan][i] =
-						attack_gain *
-							cd->gaindB_buf[chan] +
-						(1.0f - attack_gain) * gain;
-				else
-					cd->gaindB[chan][i] =
-						release_gain *
-							cd->gaindB_buf[chan] +
-						(1.0f - release_gain) * gain;
-			}
-
-			gain = db_to_mul(fminf(0, cd->gaindB[chan][i]));
-			if (samples[chan])
-				samples[chan][i] *= gain * cd->output_gain;
+			if (gain > prev)
+				gaindB[i] = attack_gain * prev +
+					    (1.0f - attack_gain) * gain;
+			else
+				gaindB[i] = release_gain * prev +
+					    (1.0f - release_gain) * gain;
+			prev = gaindB[i];
+
+			gain_buf[i] = fminf(0, gaindB[i]);
 		}
-		cd->gaindB_buf[chan] = cd->gaindB[chan][num_samples - 1];
+		cd->gaindB_buf[chan] = prev;
+
+		if (!samples[chan])
+			continue;
+
+		dyn_db_to_mul(gain_buf, gain_buf, num_samples);
+		if (cd->output_gain != 1.0f)
+			audio_mix_scale(gain_buf, cd->output_gain, num_samples);
+		audio_mix_mul(samples[chan], gain_buf, num_samples);
 	}
 }
 
@@ -3,10 +3,16 @@
 #include <util/util_uint64.h>
 
 #define S_DELAY_MS "delay_ms"
+#define S_COMPACT "compact"
 #define T_DELAY_MS obs_module_text("DelayMs")
+#define T_COMPACT obs_module_text("GPUDelay.Compact")
 
+/* compact frames are stored as 4:2:0 luma and chroma in render, the latter
+ * at half size in render_uv, which takes 1.5 bytes per pixel instead of 4
+ * at the cost of chroma resolution and alpha */
 struct frame {
 	gs_texrender_t *render;
+	gs_texrender_t *render_uv;
 	uint64_t ts;
 };
 
@@ -19,6 +25,12 @@ struct gpu_delay_filter_data {
 	uint32_t cy;
 	bool target_valid;
 	bool processed_frame;
+
+	bool compact;
+	gs_texrender_t *scratch;
+	gs_effect_t *effect;
+	gs_eparam_t *image_param;
+	gs_eparam_t *image_uv_param;
 };
 
 static const char *gpu_delay_filter_get_name(void *unused)
@@ -34,6 +46,7 @@ static void free_textures(struct gpu_delay_filter_data *f)
 		struct frame frame;
 		circlebuf_pop_front(&f->frames, &frame, sizeof(frame));
 		gs_texrender_destroy(frame.render);
+		gs_texrender_destroy(frame.render_uv);
 	}
 	circlebuf_free(&f->frames);
 	obs_leave_graphics();
@@ -65,8 +78,15 @@ static void update_interval(struct gpu_delay_filter_data *f,
 		for (size_t i = prev_num; i < num; i++) {
 			struct frame *frame =
 				circlebuf_data(&f->frames, i * sizeof(*frame));
-			frame->render =
-				gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+			if (f->compact) {
+				frame->render =
+					gs_texrender_create(GS_R8, GS_ZS_NONE);
+				frame->render_uv = gs_texrender_create(
+					GS_R8G8, GS_ZS_NONE);
+			} else {
+				frame->render = gs_texrender_create(GS_RGBA,
+								    GS_ZS_NONE);
+			}
 		}
 
 		obs_leave_graphics();
@@ -78,6 +98,7 @@ static void update_interval(struct gpu_delay_filter_data *f,
 			struct frame frame;
 			circlebuf_pop_front(&f->frames, &frame, sizeof(frame));
 			gs_texrender_destroy(frame.render);
+			gs_texrender_destroy(frame.render_uv);
 		}
 
 		obs_leave_graphics();
@@ -136,6 +157,7 @@ static void gpu_delay_filter_update(void *data, obs_data_t *s)
 	struct gpu_delay_filter_data *f = data;
 
 	f->delay_ns = (uint64_t)obs_data_get_int(s, S_DELAY_MS) * 1000000ULL;
+	f->compact = obs_data_get_bool(s, S_COMPACT) && f->effect;
 
 	/* full reset */
 	f->cx = 0;
@@ -152,6 +174,8 @@ static obs_properties_t *gpu_delay_filter_properties(void *data)
 						   T_DELAY_MS, 0, 500, 1);
 	obs_property_int_set_suffix(p, " ms");
 
+	obs_properties_add_bool(props, S_COMPACT, T_COMPACT);
+
 	UNUSED_PARAMETER(data);
 	return props;
 }
@@ -160,8 +184,23 @@ static void *gpu_delay_filter_create(obs_data_t *settings,
 				     obs_source_t *context)
 {
 	struct gpu_delay_filter_data *f = bzalloc(sizeof(*f));
+	char *effect_path = obs_module_file("gpu_delay.effect");
+
 	f->context = context;
 
+	obs_enter_graphics();
+	f->effect = gs_effect_create_from_file(effect_path, NULL);
+	if (f->effect) {
+		f->image_param =
+			gs_effect_get_param_by_name(f->effect, "image");
+		f->image_uv_param =
+			gs_effect_get_param_by_name(f->effect, "image_uv");
+		f->scratch = gs_texrender_create_transient(GS_RGBA, GS_ZS_NONE);
+	}
+	obs_leave_graphics();
+
+	bfree(effect_path);
+
 	obs_source_update(context, settings);
 	return f;
 }
@@ -171,6 +210,12 @@ static void gpu_delay_filter_destroy(void *data)
 	struct gpu_delay_filter_data *f = data;
 
 	free_textures(f);
+
+	obs_enter_graphics();
+	gs_texrender_destroy(f->scratch);
+	gs_effect_destroy(f->effect);
+	obs_leave_graphics();
+
 	bfree(f);
 }
 
@@ -187,11 +232,39 @@ static void gpu_delay_filter_tick(void *data, float t)
 	check_interval(f);
 }
 
+static void draw_compact_frame(struct gpu_delay_filter_data *f,
+			       struct frame *frame)
+{
+	gs_texture_t *tex = gs_texrender_get_texture(frame->render);
+	gs_texture_t *tex_uv = gs_texrender_get_texture(frame->render_uv);
+	if (!tex || !tex_uv)
+		return;
+
+	const bool linear_srgb = gs_get_linear_srgb();
+	const char *tech = linear_srgb ? "UnpackLinear" : "Unpack";
+
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(linear_srgb);
+
+	gs_effect_set_texture(f->image_param, tex);
+	gs_effect_set_texture(f->image_uv_param, tex_uv);
+
+	while (gs_effect_loop(f->effect, tech))
+		gs_draw_sprite(tex, 0, f->cx, f->cy);
+
+	gs_enable_framebuffer_srgb(previous);
+}
+
 static void draw_frame(struct gpu_delay_filter_data *f)
 {
 	struct frame frame;
 	circlebuf_peek_front(&f->frames, &frame, sizeof(frame));
 
+	if (frame.render_uv) {
+		draw_compact_frame(f, &frame);
+		return;
+	}
+
 	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
 	gs_texture_t *tex = gs_texrender_get_texture(frame.render);
 	if (tex) {
@@ -214,6 +287,71 @@ static void draw_frame(struct gpu_delay_filter_data *f)
 	}
 }
 
+static void render_target(struct gpu_delay_filter_data *f,
+			  gs_texrender_t *render, obs_source_t *target,
+			  obs_source_t *parent)
+{
+	if (gs_texrender_begin(render, f->cx, f->cy)) {
+		uint32_t parent_flags = obs_source_get_output_flags(target);
+		bool custom_draw = (parent_flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
+		bool async = (parent_flags & OBS_SOURCE_ASYNC) != 0;
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)f->cx, 0.0f, (float)f->cy, -100.0f,
+			 100.0f);
+
+		if (target == parent && !custom_draw && !async)
+			obs_source_default_render(target);
+		else
+			obs_source_video_render(target);
+
+		gs_texrender_end(render);
+	}
+}
+
+static void pack_plane(struct gpu_delay_filter_data *f, gs_texrender_t *render,
+		       gs_texture_t *tex, const char *tech, uint32_t cx,
+		       uint32_t cy)
+{
+	gs_texrender_reset(render);
+
+	if (gs_texrender_begin(render, cx, cy)) {
+		gs_ortho(0.0f, (float)f->cx, 0.0f, (float)f->cy, -100.0f,
+			 100.0f);
+
+		gs_effect_set_texture(f->image_param, tex);
+		while (gs_effect_loop(f->effect, tech))
+			gs_draw_sprite(tex, 0, f->cx, f->cy);
+
+		gs_texrender_end(render);
+	}
+}
+
+/* the target is rendered at full quality first and then converted, the
+ * stored values stay sRGB encoded just like those of a full frame */
+static void render_compact(struct gpu_delay_filter_data *f,
+			   struct frame *frame, obs_source_t *target,
+			   obs_source_t *parent)
+{
+	gs_texrender_reset(f->scratch);
+	render_target(f, f->scratch, target, parent);
+
+	gs_texture_t *tex = gs_texrender_get_texture(f->scratch);
+	if (!tex)
+		return;
+
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(false);
+
+	pack_plane(f, frame->render, tex, "PackY", f->cx, f->cy);
+	pack_plane(f, frame->render_uv, tex, "PackUV", (f->cx + 1) / 2,
+		   (f->cy + 1) / 2);
+
+	gs_enable_framebuffer_srgb(previous);
+}
+
 static void gpu_delay_filter_render(void *data, gs_effect_t *effect)
 {
 	struct gpu_delay_filter_data *f = data;
@@ -238,24 +376,10 @@ static void gpu_delay_filter_render(void *data, gs_effect_t *effect)
 	gs_blend_state_push();
 	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
 
-	if (gs_texrender_begin(frame.render, f->cx, f->cy)) {
-		uint32_t parent_flags = obs_source_get_output_flags(target);
-		bool custom_draw = (parent_flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
-		bool async = (parent_flags & OBS_SOURCE_ASYNC) != 0;
-		struct vec4 clear_color;
-
-		vec4_zero(&clear_color);
-		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
-		gs_ortho(0.0f, (float)f->cx, 0.0f, (float)f->cy, -100.0f,
-			 100.0f);
-
-		if (target == parent && !custom_draw && !async)
-			obs_source_default_render(target);
-		else
-			obs_source_video_render(target);
-
-		gs_texrender_end(frame.render);
-	}
+	if (frame.render_uv)
+		render_compact(f, &frame, target, parent);
+	else
+		render_target(f, frame.render, target, parent);
 
 	gs_blend_state_pop();
 
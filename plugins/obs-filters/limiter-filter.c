@@ -5,6 +5,7 @@
 #include <obs-module.h>
 #include <media-io/audio-math.h>
 #include <util/platform.h>
+#include "dynamics.h"
 
 /* -------------------------------------------------------- */
 
@@ -27,15 +28,18 @@
 
 #define S_THRESHOLD                     "threshold"
 #define S_RELEASE_TIME                  "release_time"
+#define S_LOOKAHEAD_TIME                "lookahead_time"
 
 #define MT_ obs_module_text
 #define TEXT_THRESHOLD                  MT_("Limiter.Threshold")
 #define TEXT_RELEASE_TIME               MT_("Limiter.ReleaseTime")
+#define TEXT_LOOKAHEAD_TIME             MT_("Limiter.LookaheadTime")
 
 #define MIN_THRESHOLD_DB                -60.0
 #define MAX_THRESHOLD_DB                0.0f
 #define MIN_ATK_RLS_MS                  1
 #define MAX_RLS_MS                      1000
+#define MAX_LOOKAHEAD_MS                20
 #define DEFAULT_AUDIO_BUF_MS            10
 #define ATK_TIME                        0.001f
 #define MS_IN_S                         1000
@@ -59,6 +63,7 @@ struct limiter_data {
 	size_t sample_rate;
 	float envelope;
 	float slope;
+	struct dyn_lookahead lookahead;
 };
 
 /* -------------------------------------------------------- */
@@ -92,6 +97,8 @@ static void limiter_update(void *data, obs_data_t *s)
 	const float release_time_ms =
 		(float)obs_data_get_int(s, S_RELEASE_TIME);
 	const float output_gain_db = 0;
+	const size_t lookahead_ms =
+		(size_t)obs_data_get_int(s, S_LOOKAHEAD_TIME);
 
 	cd->threshold = (float)obs_data_get_double(s, S_THRESHOLD);
 
@@ -103,6 +110,8 @@ static void limiter_update(void *data, obs_data_t *s)
 	cd->num_channels = num_channels;
 	cd->sample_rate = sample_rate;
 	cd->slope = 1.0f;
+	dyn_lookahead_set(&cd->lookahead, num_channels,
+			  sample_rate * lookahead_ms / MS_IN_S);
 
 	size_t sample_len = sample_rate * DEFAULT_AUDIO_BUF_MS / MS_IN_S;
 	if (cd->envelope_buf_len == 0)
@@ -122,6 +131,7 @@ static void limiter_destroy(void *data)
 {
 	struct limiter_data *cd = data;
 
+	dyn_lookahead_free(&cd->lookahead);
 	bfree(cd->envelope_buf);
 	bfree(cd);
 }
@@ -133,43 +143,23 @@ static void analyze_envelope(struct limiter_data *cd, float **samples,
 		resize_env_buffer(cd, num_samples);
 	}
 
-	const float attack_gain = cd->attack_gain;
-	const float release_gain = cd->release_gain;
-
-	memset(cd->envelope_buf, 0, num_samples * sizeof(cd->envelope_buf[0]));
-	for (size_t chan = 0; chan < cd->num_channels; ++chan) {
-		if (!samples[chan])
-			continue;
-
-		float *envelope_buf = cd->envelope_buf;
-		float env = cd->envelope;
-		for (uint32_t i = 0; i < num_samples; ++i) {
-			const float env_in = fabsf(samples[chan][i]);
-			if (env < env_in) {
-				env = env_in + attack_gain * (env - env_in);
-			} else {
-				env = env_in + release_gain * (env - env_in);
-			}
-			envelope_buf[i] = fmaxf(envelope_buf[i], env);
-		}
-	}
-	cd->envelope = cd->envelope_buf[num_samples - 1];
+	dyn_peak_envelope(cd->envelope_buf, samples, cd->num_channels,
+			  num_samples, cd->attack_gain, cd->release_gain,
+			  &cd->envelope);
 }
 
-static inline void process_compression(const struct limiter_data *cd,
+static inline void process_compression(struct limiter_data *cd,
 				       float **samples, uint32_t num_samples)
 {
-	for (size_t i = 0; i < num_samples; ++i) {
-		const float env_db = mul_to_db(cd->envelope_buf[i]);
-		float gain = cd->slope * (cd->threshold - env_db);
-		gain = db_to_mul(fminf(0, gain));
-
-		for (size_t c = 0; c < cd->num_channels; ++c) {
-			if (samples[c]) {
-				samples[c][i] *= gain * cd->output_gain;
-			}
-		}
-	}
+	/* the envelope buffer is reused for the gain */
+	float *gain = cd->envelope_buf;
+
+	dyn_lookahead_envelope(&cd->lookahead, gain, num_samples);
+	dyn_compress(gain, gain, num_samples, cd->threshold, cd->slope,
+		     cd->output_gain);
+
+	dyn_lookahead_delay(&cd->lookahead, samples, num_samples);
+	dyn_apply_gain(samples, cd->num_channels, gain, num_samples);
 }
 
 static struct obs_audio_data *limiter_filter_audio(void *data,
@@ -191,6 +181,7 @@ static void limiter_defaults(obs_data_t *s)
 {
 	obs_data_set_default_double(s, S_THRESHOLD, -6.0f);
 	obs_data_set_default_int(s, S_RELEASE_TIME, 60);
+	obs_data_set_default_int(s, S_LOOKAHEAD_TIME, 0);
 }
 
 static obs_properties_t *limiter_properties(void *data)
@@ -206,6 +197,10 @@ static obs_properties_t *limiter_properties(void *data)
 					  TEXT_RELEASE_TIME, MIN_ATK_RLS_MS,
 					  MAX_RLS_MS, 1);
 	obs_property_int_set_suffix(p, " ms");
+	p = obs_properties_add_int_slider(props, S_LOOKAHEAD_TIME,
+					  TEXT_LOOKAHEAD_TIME, 0,
+					  MAX_LOOKAHEAD_MS, 1);
+	obs_property_int_set_suffix(p, " ms");
 
 	UNUSED_PARAMETER(data);
 	return props;
@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include <inttypes.h>
+#include <string.h>
 
 #include <util/circlebuf.h>
 #include <obs-module.h>
@@ -9,10 +10,8 @@
 #endif
 
 #ifdef LIBRNNOISE_ENABLED
-#ifdef _MSC_VER
-#define ssize_t intptr_t
-#endif
 #include <rnnoise.h>
+#include <media-io/audio-mixing.h>
 #include <media-io/audio-resampler.h>
 #endif
 
@@ -304,6 +303,21 @@ static inline void process_speexdsp(struct noise_suppress_data *ng)
 #endif
 }
 
+#ifdef LIBRNNOISE_ENABLED
+/* copies the last dst_frames of src scaled by gain, zero-filling the start of
+ * dst if src is shorter */
+static inline void copy_tail(float *dst, size_t dst_frames, const float *src,
+			     size_t src_frames, float gain)
+{
+	size_t frames = src_frames < dst_frames ? src_frames : dst_frames;
+	size_t pad = dst_frames - frames;
+
+	memset(dst, 0, pad * sizeof(float));
+	memcpy(dst + pad, src + (src_frames - frames), frames * sizeof(float));
+	audio_mix_scale(dst + pad, gain, frames);
+}
+#endif
+
 static inline void process_rnnoise(struct noise_suppress_data *ng)
 {
 #ifdef LIBRNNOISE_ENABLED
@@ -317,25 +331,15 @@ static inline void process_rnnoise(struct noise_suppress_data *ng)
 					 (const uint8_t **)ng->copy_buffers,
 					 (uint32_t)ng->frames);
 
-		for (size_t i = 0; i < ng->channels; i++) {
-			for (ssize_t j = 0, k = (ssize_t)out_frames -
-						RNNOISE_FRAME_SIZE;
-			     j < RNNOISE_FRAME_SIZE; ++j, ++k) {
-				if (k >= 0) {
-					ng->rnn_segment_buffers[i][j] =
-						output[i][k] * 32768.0f;
-				} else {
-					ng->rnn_segment_buffers[i][j] = 0;
-				}
-			}
-		}
+		for (size_t i = 0; i < ng->channels; i++)
+			copy_tail(ng->rnn_segment_buffers[i],
+				  RNNOISE_FRAME_SIZE, output[i], out_frames,
+				  32768.0f);
 	} else {
-		for (size_t i = 0; i < ng->channels; i++) {
-			for (size_t j = 0; j < RNNOISE_FRAME_SIZE; ++j) {
-				ng->rnn_segment_buffers[i][j] =
-					ng->copy_buffers[i][j] * 32768.0f;
-			}
-		}
+		for (size_t i = 0; i < ng->channels; i++)
+			copy_tail(ng->rnn_segment_buffers[i],
+				  RNNOISE_FRAME_SIZE, ng->copy_buffers[i],
+				  RNNOISE_FRAME_SIZE, 32768.0f);
 	}
 
 	/* Execute */
@@ -355,26 +359,14 @@ static inline void process_rnnoise(struct noise_suppress_data *ng)
 			&ts_offset, (const uint8_t **)ng->rnn_segment_buffers,
 			RNNOISE_FRAME_SIZE);
 
-		for (size_t i = 0; i < ng->channels; i++) {
-			for (ssize_t j = 0,
-				     k = (ssize_t)out_frames - ng->frames;
-			     j < (ssize_t)ng->frames; ++j, ++k) {
-				if (k >= 0) {
-					ng->copy_buffers[i][j] =
-						output[i][k] / 32768.0f;
-				} else {
-					ng->copy_buffers[i][j] = 0;
-				}
-			}
-		}
+		for (size_t i = 0; i < ng->channels; i++)
+			copy_tail(ng->copy_buffers[i], ng->frames, output[i],
+				  out_frames, 1.0f / 32768.0f);
 	} else {
-		for (size_t i = 0; i < ng->channels; i++) {
-			for (size_t j = 0; j < RNNOISE_FRAME_SIZE; ++j) {
-				ng->copy_buffers[i][j] =
-					ng->rnn_segment_buffers[i][j] /
-					32768.0f;
-			}
-		}
+		for (size_t i = 0; i < ng->channels; i++)
+			copy_tail(ng->copy_buffers[i], RNNOISE_FRAME_SIZE,
+				  ng->rnn_segment_buffers[i],
+				  RNNOISE_FRAME_SIZE, 1.0f / 32768.0f);
 	}
 #else
 	UNUSED_PARAMETER(ng);
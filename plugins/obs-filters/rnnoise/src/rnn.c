@@ -30,6 +30,7 @@
 #endif
 
 #include <math.h>
+#include <string.h>
 #include "opus_types.h"
 #include "common.h"
 #include "arch.h"
@@ -76,22 +77,79 @@ static OPUS_INLINE float relu(float x)
    return x < 0 ? 0 : x;
 }
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RNN_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RNN_NEON 1
+#endif
+
+/* sum[i] += weights[j*stride + i]*input[j] for i < N, j < M.  The weights of
+   one input are contiguous across neurons, so four neurons are accumulated at
+   a time; the order of the additions for each neuron is the same as in the
+   scalar loop. */
+static void accumulate(float *sum, const rnn_weight *weights, int stride,
+                       const float *input, int M, int N)
+{
+   int i = 0, j;
+#if defined(RNN_SSE2)
+   for (;i+4<=N;i+=4)
+   {
+      __m128 acc = _mm_loadu_ps(sum + i);
+      for (j=0;j<M;j++)
+      {
+         int packed;
+         __m128i w;
+         memcpy(&packed, weights + j*stride + i, sizeof(packed));
+         w = _mm_cvtsi32_si128(packed);
+         w = _mm_unpacklo_epi8(w, w);
+         w = _mm_unpacklo_epi16(w, w);
+         w = _mm_srai_epi32(w, 24);
+         acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtepi32_ps(w),
+                                          _mm_set1_ps(input[j])));
+      }
+      _mm_storeu_ps(sum + i, acc);
+   }
+#elif defined(RNN_NEON)
+   for (;i+4<=N;i+=4)
+   {
+      float32x4_t acc = vld1q_f32(sum + i);
+      for (j=0;j<M;j++)
+      {
+         int8_t packed[8] = {0};
+         int16x8_t w16;
+         float32x4_t w;
+         memcpy(packed, weights + j*stride + i, 4);
+         w16 = vmovl_s8(vld1_s8(packed));
+         w = vcvtq_f32_s32(vmovl_s16(vget_low_s16(w16)));
+         acc = vaddq_f32(acc, vmulq_n_f32(w, input[j]));
+      }
+      vst1q_f32(sum + i, acc);
+   }
+#endif
+   for (;i<N;i++)
+   {
+      float s = sum[i];
+      for (j=0;j<M;j++)
+         s += weights[j*stride + i]*input[j];
+      sum[i] = s;
+   }
+}
+
 static void compute_dense(const DenseLayer *layer, float *output, const float *input)
 {
-   int i, j;
+   int i;
    int N, M;
    int stride;
    M = layer->nb_inputs;
    N = layer->nb_neurons;
    stride = N;
    for (i=0;i<N;i++)
-   {
-      /* Compute update gate. */
-      float sum = layer->bias[i];
-      for (j=0;j<M;j++)
-         sum += layer->input_weights[j*stride + i]*input[j];
-      output[i] = WEIGHTS_SCALE*sum;
-   }
+      output[i] = layer->bias[i];
+   accumulate(output, layer->input_weights, stride, input, M, N);
+   for (i=0;i<N;i++)
+      output[i] = WEIGHTS_SCALE*output[i];
    if (layer->activation == ACTIVATION_SIGMOID) {
       for (i=0;i<N;i++)
          output[i] = sigmoid_approx(output[i]);
@@ -108,43 +166,41 @@ static void compute_dense(const DenseLayer *layer, float *output, const float *i
 
 static void compute_gru(const GRULayer *gru, float *state, const float *input)
 {
-   int i, j;
+   int i;
    int N, M;
    int stride;
    float z[MAX_NEURONS];
    float r[MAX_NEURONS];
    float h[MAX_NEURONS];
+   float rstate[MAX_NEURONS];
    M = gru->nb_inputs;
    N = gru->nb_neurons;
    stride = 3*N;
+   /* Compute update gate. */
    for (i=0;i<N;i++)
-   {
-      /* Compute update gate. */
-      float sum = gru->bias[i];
-      for (j=0;j<M;j++)
-         sum += gru->input_weights[j*stride + i]*input[j];
-      for (j=0;j<N;j++)
-         sum += gru->recurrent_weights[j*stride + i]*state[j];
-      z[i] = sigmoid_approx(WEIGHTS_SCALE*sum);
-   }
+      z[i] = gru->bias[i];
+   accumulate(z, gru->input_weights, stride, input, M, N);
+   accumulate(z, gru->recurrent_weights, stride, state, N, N);
+   for (i=0;i<N;i++)
+      z[i] = sigmoid_approx(WEIGHTS_SCALE*z[i]);
+   /* Compute reset gate. */
+   for (i=0;i<N;i++)
+      r[i] = gru->bias[N + i];
+   accumulate(r, gru->input_weights + N, stride, input, M, N);
+   accumulate(r, gru->recurrent_weights + N, stride, state, N, N);
    for (i=0;i<N;i++)
    {
-      /* Compute reset gate. */
-      float sum = gru->bias[N + i];
-      for (j=0;j<M;j++)
-         sum += gru->input_weights[N + j*stride + i]*input[j];
-      for (j=0;j<N;j++)
-         sum += gru->recurrent_weights[N + j*stride + i]*state[j];
-      r[i] = sigmoid_approx(WEIGHTS_SCALE*sum);
+      r[i] = sigmoid_approx(WEIGHTS_SCALE*r[i]);
+      rstate[i] = state[i]*r[i];
    }
+   /* Compute output. */
+   for (i=0;i<N;i++)
+      h[i] = gru->bias[2*N + i];
+   accumulate(h, gru->input_weights + 2*N, stride, input, M, N);
+   accumulate(h, gru->recurrent_weights + 2*N, stride, rstate, N, N);
    for (i=0;i<N;i++)
    {
-      /* Compute output. */
-      float sum = gru->bias[2*N + i];
-      for (j=0;j<M;j++)
-         sum += gru->input_weights[2*N + j*stride + i]*input[j];
-      for (j=0;j<N;j++)
-         sum += gru->recurrent_weights[2*N + j*stride + i]*state[j]*r[j];
+      float sum = h[i];
       if (gru->activation == ACTIVATION_SIGMOID) sum = sigmoid_approx(WEIGHTS_SCALE*sum);
       else if (gru->activation == ACTIVATION_TANH) sum = tansig_approx(WEIGHTS_SCALE*sum);
       else if (gru->activation == ACTIVATION_RELU) sum = relu(WEIGHTS_SCALE*sum);
@@ -12,6 +12,8 @@ struct sharpness_data {
 
 	float sharpness;
 	float texwidth, texheight;
+
+	char *fusion_code;
 };
 
 static const char *sharpness_getname(void *unused)
@@ -38,6 +40,7 @@ static void sharpness_destroy(void *data)
 		obs_leave_graphics();
 	}
 
+	bfree(filter->fusion_code);
 	bfree(data);
 }
 
@@ -64,6 +67,10 @@ static void *sharpness_create(obs_data_t *settings, obs_source_t *context)
 
 	bfree(effect_path);
 
+	char *fusion_path = obs_module_file("sharpness_fusion.effect");
+	filter->fusion_code = os_quick_read_utf8_file(fusion_path);
+	bfree(fusion_path);
+
 	if (!filter->effect) {
 		sharpness_destroy(filter);
 		return NULL;
@@ -109,6 +116,32 @@ static void sharpness_render_v2(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+static bool sharpness_get_fusion_v2(void *data,
+				    struct obs_filter_fusion *fusion)
+{
+	struct sharpness_data *filter = data;
+
+	fusion->code = filter->fusion_code;
+	fusion->flags = OBS_FUSION_LINEAR_SRGB | OBS_FUSION_SAMPLES_INPUT;
+	return filter->fusion_code != NULL;
+}
+
+static void sharpness_fusion_render_v2(void *data, obs_fusion_pass_t *pass)
+{
+	struct sharpness_data *filter = data;
+	obs_source_t *target = obs_filter_get_target(filter->context);
+
+	filter->texwidth = (float)obs_source_get_width(target);
+	filter->texheight = (float)obs_source_get_height(target);
+
+	gs_effect_set_float(obs_fusion_pass_get_param(pass, "sharpness"),
+			    filter->sharpness);
+	gs_effect_set_float(obs_fusion_pass_get_param(pass, "texture_width"),
+			    filter->texwidth);
+	gs_effect_set_float(obs_fusion_pass_get_param(pass, "texture_height"),
+			    filter->texheight);
+}
+
 static obs_properties_t *sharpness_properties(void *data)
 {
 	obs_properties_t *props = obs_properties_create();
@@ -151,4 +184,6 @@ struct obs_source_info sharpness_filter_v2 = {
 	.video_render = sharpness_render_v2,
 	.get_properties = sharpness_properties,
 	.get_defaults = sharpness_defaults,
+	.filter_get_fusion = sharpness_get_fusion_v2,
+	.filter_fusion_render = sharpness_fusion_render_v2,
 };
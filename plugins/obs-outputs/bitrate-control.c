@@ -0,0 +1,553 @@
+#include <util/platform.h>
+#include "bitrate-control.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mstcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif
+#endif
+
+#define MSEC_NS 1000000ULL
+#define SEC_NS 1000000000ULL
+
+#define MIN_ESTIMATE_DURATION_MS 1000
+#define MAX_ESTIMATE_DURATION_MS 2000
+
+/* more than this much waiting to be sent means the link can't keep up */
+#define QUEUE_TRIGGER_USEC 200000LL
+
+#define MIN_BITRATE 50
+
+static void log_bitrate(struct bitrate_control *bc, long old_bitrate)
+{
+	blog(LOG_INFO,
+	     "[bitrate-control: %s] bitrate %s from %ld to %ld kbps "
+	     "(throughput %ld kbps)",
+	     bc->estimator->name,
+	     bc->cur_bitrate < old_bitrate ? "decreased" : "increased",
+	     old_bitrate, bc->cur_bitrate, bc->throughput);
+}
+
+static inline long video_throughput(struct bitrate_control *bc)
+{
+	long bitrate;
+
+	if (!bc->throughput)
+		return 0;
+
+	bitrate = bc->throughput - bc->audio_bitrate;
+	return bitrate < MIN_BITRATE ? MIN_BITRATE : bitrate;
+}
+
+static void clear_sends(struct bitrate_control *bc)
+{
+	circlebuf_pop_front(&bc->sends, NULL, bc->sends.size);
+	bc->send_size = 0;
+	bc->throughput = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* delay based: reacts to queueing anywhere between the encoder and the peer
+ * (the output's own queue, the socket's send buffer, rising round trip time
+ * or loss) and backs off to just below the measured throughput.  bitrate is
+ * brought back in small steps once the connection has been clear for a
+ * while */
+
+#define DELAY_UPDATE_INTERVAL_NS (250 * MSEC_NS)
+#define DELAY_DECREASE_INTERVAL_NS (1 * SEC_NS)
+#define DELAY_INCREASE_HOLD_NS (5 * SEC_NS)
+#define DELAY_INCREASE_INTERVAL_NS (1 * SEC_NS)
+#define DELAY_RTT_WINDOW_NS (10 * SEC_NS)
+#define DELAY_MIN_RTT_INFLATION_USEC 50000LL
+#define DELAY_LOSS_TRIGGER 0.02
+
+static void delay_track_rtt(struct bitrate_control *bc,
+			    const struct bitrate_signals *signals,
+			    uint64_t now)
+{
+	if (signals->rtt_usec <= 0)
+		return;
+
+	if (!bc->min_rtt_usec || signals->rtt_usec < bc->min_rtt_usec ||
+	    now - bc->min_rtt_ts > DELAY_RTT_WINDOW_NS) {
+		bc->min_rtt_usec = signals->rtt_usec;
+		bc->min_rtt_ts = now;
+	}
+
+	bc->last_rtt_usec = signals->rtt_usec;
+}
+
+static bool delay_congested(struct bitrate_control *bc,
+			    const struct bitrate_signals *signals,
+			    int64_t *queue_usec)
+{
+	int64_t queued = signals->queue_usec > 0 ? signals->queue_usec : 0;
+
+	/* anything in the socket beyond what the network keeps in flight is
+	 * just as much waiting as the output's own queue */
+	if (signals->send_backlog > 0 && bc->throughput > 0) {
+		int64_t ideal = signals->ideal_backlog > 0
+					? signals->ideal_backlog
+					: 0;
+		int64_t excess = signals->send_backlog - ideal;
+
+		if (excess > 0)
+			queued += excess * 8000 / bc->throughput;
+	}
+
+	*queue_usec = queued;
+
+	if (queued >= QUEUE_TRIGGER_USEC)
+		return true;
+
+	if (signals->rtt_usec > 0 && bc->min_rtt_usec) {
+		int64_t inflation = signals->rtt_usec - bc->min_rtt_usec;
+		int64_t limit = bc->min_rtt_usec > DELAY_MIN_RTT_INFLATION_USEC
+					? bc->min_rtt_usec
+					: DELAY_MIN_RTT_INFLATION_USEC;
+		if (inflation > limit)
+			return true;
+	}
+
+	return signals->loss > DELAY_LOSS_TRIGGER;
+}
+
+static long delay_update(struct bitrate_control *bc,
+			 const struct bitrate_signals *signals, uint64_t now)
+{
+	int64_t queue_usec;
+	long target;
+
+	if (now - bc->last_update_ts < DELAY_UPDATE_INTERVAL_NS)
+		return 0;
+	bc->last_update_ts = now;
+
+	delay_track_rtt(bc, signals, now);
+
+	if (delay_congested(bc, signals, &queue_usec)) {
+		long throughput = video_throughput(bc);
+
+		if (now - bc->last_decrease_ts < DELAY_DECREASE_INTERVAL_NS)
+			return 0;
+
+		target = bc->cur_bitrate * 85 / 100;
+		if (throughput && throughput * 9 / 10 < target)
+			target = throughput * 9 / 10;
+
+		bc->last_decrease_ts = now;
+		bc->next_increase_ts = now + DELAY_INCREASE_HOLD_NS;
+		return target;
+	}
+
+	if (bc->cur_bitrate >= bc->orig_bitrate || now < bc->next_increase_ts ||
+	    queue_usec > QUEUE_TRIGGER_USEC / 4)
+		return 0;
+
+	target = bc->cur_bitrate + bc->orig_bitrate / 20;
+	bc->next_increase_ts = now + DELAY_INCREASE_INTERVAL_NS;
+	return target;
+}
+
+static const struct bitrate_estimator delay_estimator = {
+	.name = "delay",
+	.update = delay_update,
+};
+
+/* ------------------------------------------------------------------------- */
+/* throughput based: the original dynamic bitrate behavior.  drops to the
+ * measured throughput whenever the output queue passes the trigger, and goes
+ * up a tenth of the original bitrate every 30 seconds */
+
+#define THROUGHPUT_INC_TIMER_NS (30 * SEC_NS)
+
+static long throughput_update(struct bitrate_control *bc,
+			      const struct bitrate_signals *signals,
+			      uint64_t now)
+{
+	long throughput = video_throughput(bc);
+	long target;
+
+	if (bc->next_increase_ts && now >= bc->next_increase_ts) {
+		bc->next_increase_ts = 0;
+		bc->prev_bitrate = bc->cur_bitrate;
+
+		target = bc->cur_bitrate + bc->orig_bitrate / 10;
+		if (target < bc->orig_bitrate)
+			bc->next_increase_ts = now + THROUGHPUT_INC_TIMER_NS;
+		return target;
+	}
+
+	if (signals->queue_usec < QUEUE_TRIGGER_USEC)
+		return 0;
+
+	if (throughput && throughput < bc->cur_bitrate) {
+		target = throughput / 100 * 100;
+		if (target < MIN_BITRATE)
+			target = MIN_BITRATE;
+		clear_sends(bc);
+
+	} else if (bc->prev_bitrate) {
+		target = bc->prev_bitrate;
+
+	} else {
+		return 0;
+	}
+
+	if (target == bc->cur_bitrate)
+		return 0;
+
+	bc->prev_bitrate = 0;
+	bc->next_increase_ts = now + THROUGHPUT_INC_TIMER_NS;
+	return target;
+}
+
+static const struct bitrate_estimator throughput_estimator = {
+	.name = "throughput",
+	.update = throughput_update,
+};
+
+/* ------------------------------------------------------------------------- */
+
+static const struct bitrate_estimator *estimators[] = {
+	&delay_estimator,
+	&throughput_estimator,
+};
+
+static const struct bitrate_estimator *find_estimator(const char *name)
+{
+	if (name && *name) {
+		for (size_t i = 0; i < sizeof(estimators) / sizeof(*estimators);
+		     i++) {
+			if (strcmp(estimators[i]->name, name) == 0)
+				return estimators[i];
+		}
+	}
+
+	return estimators[0];
+}
+
+void bitrate_signals_init(struct bitrate_signals *signals)
+{
+	signals->queue_usec = -1;
+	signals->send_backlog = -1;
+	signals->ideal_backlog = -1;
+	signals->rtt_usec = -1;
+	signals->loss = 0.0;
+}
+
+void bitrate_signals_query_socket(struct bitrate_signals *signals,
+				  intptr_t socket)
+{
+#ifdef _WIN32
+	SOCKET s = (SOCKET)socket;
+	ULONG ideal;
+
+	if (s == INVALID_SOCKET)
+		return;
+
+	if (idealsendbacklogquery(s, &ideal) == 0)
+		signals->ideal_backlog = (int64_t)ideal;
+
+#ifdef SIO_TCP_INFO
+	DWORD version = 0;
+	TCP_INFO_v0 info;
+	DWORD bytes;
+
+	if (WSAIoctl(s, SIO_TCP_INFO, &version, sizeof(version), &info,
+		     sizeof(info), &bytes, NULL, NULL) == 0) {
+		signals->rtt_usec = (int64_t)info.RttUs;
+		signals->send_backlog = (int64_t)info.BytesInFlight;
+	}
+#endif
+
+#elif defined(__linux__)
+	int fd = (int)socket;
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+	int queued;
+
+	if (fd < 0)
+		return;
+
+	if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0) {
+		signals->rtt_usec = (int64_t)info.tcpi_rtt;
+		signals->ideal_backlog =
+			(int64_t)info.tcpi_snd_cwnd * info.tcpi_snd_mss;
+	}
+
+	/* unsent plus unacknowledged bytes */
+	if (ioctl(fd, SIOCOUTQ, &queued) == 0)
+		signals->send_backlog = queued;
+
+#elif defined(__APPLE__)
+	int fd = (int)socket;
+	struct tcp_connection_info info;
+	socklen_t len = sizeof(info);
+
+	if (fd < 0)
+		return;
+
+	if (getsockopt(fd, IPPROTO_TCP, TCP_CONNECTION_INFO, &info, &len) ==
+	    0) {
+		signals->rtt_usec = (int64_t)info.tcpi_srtt * 1000;
+		signals->ideal_backlog = (int64_t)info.tcpi_snd_cwnd;
+		signals->send_backlog = (int64_t)info.tcpi_snd_sbbytes;
+	}
+
+#else
+	UNUSED_PARAMETER(signals);
+	UNUSED_PARAMETER(socket);
+#endif
+}
+
+bool bitrate_control_init(struct bitrate_control *bc)
+{
+	memset(bc, 0, sizeof(*bc));
+	bc->estimator = estimators[0];
+	if (pthread_mutex_init(&bc->mutex, NULL) != 0)
+		return false;
+
+	bc->tasks = obs_task_group_create();
+	return true;
+}
+
+void bitrate_control_free(struct bitrate_control *bc)
+{
+	obs_task_group_destroy(bc->tasks);
+	circlebuf_free(&bc->sends);
+	pthread_mutex_destroy(&bc->mutex);
+}
+
+void bitrate_control_start(struct bitrate_control *bc, const char *estimator,
+			   long bitrate, long audio_bitrate)
+{
+	pthread_mutex_lock(&bc->mutex);
+
+	clear_sends(bc);
+	bc->estimator = find_estimator(estimator);
+	bc->orig_bitrate = bitrate;
+	bc->cur_bitrate = bitrate;
+	bc->min_bitrate = bitrate / 10 > MIN_BITRATE ? bitrate / 10
+						     : MIN_BITRATE;
+	bc->audio_bitrate = audio_bitrate;
+	bc->prev_bitrate = 0;
+	bc->min_rtt_usec = 0;
+	bc->min_rtt_ts = 0;
+	bc->last_rtt_usec = 0;
+	bc->last_update_ts = 0;
+	bc->last_decrease_ts = 0;
+	bc->next_increase_ts = 0;
+	bc->started = true;
+
+	pthread_mutex_unlock(&bc->mutex);
+
+	blog(LOG_INFO, "[bitrate-control: %s] started at %ld kbps",
+	     bc->estimator->name, bitrate);
+}
+
+void bitrate_control_add_send(struct bitrate_control *bc, size_t size,
+			      uint64_t send_beg, uint64_t send_end)
+{
+	struct {
+		uint64_t send_beg;
+		uint64_t send_end;
+		size_t size;
+	} back = {send_beg, send_end, size}, front;
+	uint64_t dur;
+
+	pthread_mutex_lock(&bc->mutex);
+
+	circlebuf_push_back(&bc->sends, &back, sizeof(back));
+	circlebuf_peek_front(&bc->sends, &front, sizeof(front));
+
+	bc->send_size += size;
+
+	dur = (back.send_end - front.send_beg) / MSEC_NS;
+
+	if (dur >= MAX_ESTIMATE_DURATION_MS) {
+		bc->send_size -= front.size;
+		circlebuf_pop_front(&bc->sends, NULL, sizeof(front));
+	}
+
+	bc->throughput = (dur >= MIN_ESTIMATE_DURATION_MS)
+				 ? (long)(bc->send_size * 8 / dur)
+				 : 0;
+
+	pthread_mutex_unlock(&bc->mutex);
+}
+
+bool bitrate_control_update(struct bitrate_control *bc,
+			    const struct bitrate_signals *signals)
+{
+	return bitrate_control_update_at(bc, signals, os_gettime_ns());
+}
+
+bool bitrate_control_update_at(struct bitrate_control *bc,
+			       const struct bitrate_signals *signals,
+			       uint64_t now)
+{
+	long old_bitrate;
+	long target;
+	bool changed = false;
+
+	pthread_mutex_lock(&bc->mutex);
+
+	old_bitrate = bc->cur_bitrate;
+	target = bc->estimator->update(bc, signals, now);
+
+	if (target) {
+		if (target > bc->orig_bitrate)
+			target = bc->orig_bitrate;
+		if (target < bc->min_bitrate)
+			target = bc->min_bitrate;
+
+		if (target != bc->cur_bitrate) {
+			bc->cur_bitrate = target;
+			changed = true;
+			log_bitrate(bc, old_bitrate);
+		}
+	}
+
+	pthread_mutex_unlock(&bc->mutex);
+	return changed;
+}
+
+bool bitrate_control_reset(struct bitrate_control *bc)
+{
+	bool changed;
+
+	pthread_mutex_lock(&bc->mutex);
+	changed = bc->cur_bitrate != bc->orig_bitrate;
+	bc->cur_bitrate = bc->orig_bitrate;
+	bc->started = false;
+	pthread_mutex_unlock(&bc->mutex);
+
+	return changed;
+}
+
+struct rescale_task {
+	obs_weak_encoder_t *encoder;
+	uint32_t cx;
+	uint32_t cy;
+};
+
+static void rescale_task(void *param)
+{
+	struct rescale_task *task = param;
+	obs_encoder_t *encoder = obs_weak_encoder_get_encoder(task->encoder);
+
+	if (encoder) {
+		obs_encoder_set_scaled_size(encoder, task->cx, task->cy);
+		obs_encoder_release(encoder);
+	}
+
+	obs_weak_encoder_release(task->encoder);
+	bfree(task);
+}
+
+/* the encoder has to be disconnected from the video output to be rescaled,
+ * which can't be done from the encoder thread the bitrate is applied from */
+static void apply_resolution(struct bitrate_control *bc,
+			     obs_encoder_t *encoder, long bitrate)
+{
+	struct rescale_task *task;
+	uint32_t cx, cy;
+
+	if (!bc->scale_resolution || !bc->tasks || !obs_get_pool_threads())
+		return;
+	if ((obs_get_encoder_caps(obs_encoder_get_id(encoder)) &
+	     OBS_ENCODER_CAP_DYN_RESOLUTION) == 0)
+		return;
+
+	pthread_mutex_lock(&bc->mutex);
+
+	if (!bc->scaled_down && bitrate < bc->orig_bitrate / 2) {
+		bc->base_scaled = obs_encoder_scaling_enabled(encoder);
+		bc->base_cx = obs_encoder_get_width(encoder);
+		bc->base_cy = obs_encoder_get_height(encoder);
+		bc->scaled_down = true;
+
+		cx = (bc->base_cx * 2 / 3) & ~3;
+		cy = (bc->base_cy * 2 / 3) & ~3;
+
+	} else if (bc->scaled_down && bitrate >= bc->orig_bitrate * 3 / 4) {
+		bc->scaled_down = false;
+
+		cx = bc->base_scaled ? bc->base_cx : 0;
+		cy = bc->base_scaled ? bc->base_cy : 0;
+
+	} else {
+		pthread_mutex_unlock(&bc->mutex);
+		return;
+	}
+
+	blog(LOG_INFO, "[bitrate-control: %s] resolution %s at %ld kbps",
+	     bc->estimator->name, bc->scaled_down ? "decreased" : "restored",
+	     bitrate);
+
+	pthread_mutex_unlock(&bc->mutex);
+
+	task = bzalloc(sizeof(struct rescale_task));
+	task->encoder = obs_encoder_get_weak_encoder(encoder);
+	task->cx = cx;
+	task->cy = cy;
+	obs_task_group_queue(bc->tasks, OBS_TASK_PRIORITY_NORMAL, rescale_task,
+			     task);
+}
+
+void bitrate_control_apply(struct bitrate_control *bc, obs_encoder_t *encoder)
+{
+	obs_data_t *settings = obs_encoder_get_settings(encoder);
+	long bitrate = bitrate_control_get_bitrate(bc);
+
+	obs_data_set_int(settings, "bitrate", bitrate);
+	obs_encoder_update(encoder, settings);
+
+	obs_data_release(settings);
+
+	apply_resolution(bc, encoder, bitrate);
+}
+
+long bitrate_control_get_bitrate(struct bitrate_control *bc)
+{
+	long bitrate;
+
+	pthread_mutex_lock(&bc->mutex);
+	bitrate = bc->cur_bitrate;
+	pthread_mutex_unlock(&bc->mutex);
+
+	return bitrate;
+}
+
+static void get_bitrate_estimate(void *data, calldata_t *cd)
+{
+	struct bitrate_control *bc = data;
+
+	pthread_mutex_lock(&bc->mutex);
+	calldata_set_bool(cd, "active", bc->started);
+	calldata_set_string(cd, "estimator", bc->estimator->name);
+	calldata_set_int(cd, "bitrate", bc->cur_bitrate);
+	calldata_set_int(cd, "throughput", bc->throughput);
+	calldata_set_int(cd, "rtt_ms", bc->last_rtt_usec / 1000);
+	pthread_mutex_unlock(&bc->mutex);
+}
+
+void bitrate_control_add_proc(struct bitrate_control *bc, obs_output_t *output)
+{
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+
+	proc_handler_add(ph,
+			 "void get_bitrate_estimate(out bool active, "
+			 "out string estimator, out int bitrate, "
+			 "out int throughput, out int rtt_ms)",
+			 get_bitrate_estimate, bc);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <obs-module.h>
+#include <util/circlebuf.h>
+#include <util/threading.h>
+
+/*
+ * Congestion-aware bitrate control shared by the streaming outputs.
+ *
+ * The output reports what it knows about the connection (how much is queued
+ * in front of the socket, how full the socket itself is, round trip time,
+ * loss) and how long its sends took; an estimator then decides the video
+ * bitrate, which is handed to the encoder with bitrate_control_apply.
+ */
+
+#define OPT_DYN_BITRATE_ESTIMATOR "dyn_bitrate_estimator"
+
+struct bitrate_control;
+
+/* what the output could observe about its connection, -1 where unknown */
+struct bitrate_signals {
+	/* duration of the packets waiting to be sent by the output */
+	int64_t queue_usec;
+	/* bytes handed to the socket that the peer has not acknowledged */
+	int64_t send_backlog;
+	/* bytes the OS considers right to keep in flight */
+	int64_t ideal_backlog;
+	int64_t rtt_usec;
+	/* fraction of data lost or retransmitted, 0 to 1 */
+	double loss;
+};
+
+struct bitrate_estimator {
+	const char *name;
+
+	/* returns the bitrate to switch to in kbps, or 0 to keep the current
+	 * one.  called with the control locked */
+	long (*update)(struct bitrate_control *bc,
+		       const struct bitrate_signals *signals, uint64_t now);
+};
+
+struct bitrate_control {
+	const struct bitrate_estimator *estimator;
+	pthread_mutex_t mutex;
+	bool started;
+
+	long orig_bitrate;
+	long cur_bitrate;
+	long min_bitrate;
+	long audio_bitrate;
+
+	/* throughput of the sends over the last couple of seconds */
+	struct circlebuf sends;
+	size_t send_size;
+	long throughput;
+
+	/* used by the estimators */
+	long prev_bitrate;
+	int64_t min_rtt_usec;
+	uint64_t min_rtt_ts;
+	uint64_t last_update_ts;
+	uint64_t last_decrease_ts;
+	uint64_t next_increase_ts;
+	int64_t last_rtt_usec;
+
+	/* set by outputs that send new headers when the encoder's resolution
+	 * changes, see bitrate_control_apply */
+	bool scale_resolution;
+	bool scaled_down;
+	bool base_scaled;
+	uint32_t base_cx;
+	uint32_t base_cy;
+	obs_task_group_t *tasks;
+};
+
+extern void bitrate_signals_init(struct bitrate_signals *signals);
+
+/* fills in the backlog and rtt of a connected TCP socket where the platform
+ * can tell */
+extern void bitrate_signals_query_socket(struct bitrate_signals *signals,
+					 intptr_t socket);
+
+extern bool bitrate_control_init(struct bitrate_control *bc);
+extern void bitrate_control_free(struct bitrate_control *bc);
+
+/* resets the state for a new connection.  estimator may be NULL or unknown,
+ * in which case the default is used */
+extern void bitrate_control_start(struct bitrate_control *bc,
+				  const char *estimator, long bitrate,
+				  long audio_bitrate);
+
+/* records that `size` bytes took from send_beg to send_end to be sent */
+extern void bitrate_control_add_send(struct bitrate_control *bc, size_t size,
+				     uint64_t send_beg, uint64_t send_end);
+
+/* returns true if the bitrate changed and should be applied */
+extern bool bitrate_control_update(struct bitrate_control *bc,
+				   const struct bitrate_signals *signals);
+
+/* same as bitrate_control_update at a given time, for simulations */
+extern bool bitrate_control_update_at(struct bitrate_control *bc,
+				      const struct bitrate_signals *signals,
+				      uint64_t now);
+
+/* returns true if the bitrate had changed and was put back */
+extern bool bitrate_control_reset(struct bitrate_control *bc);
+
+/* updates the encoder's bitrate.  with scale_resolution set, encoders that
+ * can change their resolution while active are also scaled down to two
+ * thirds when the bitrate falls under half of the original one, and back
+ * once it has recovered to three quarters */
+extern void bitrate_control_apply(struct bitrate_control *bc,
+				  obs_encoder_t *encoder);
+
+extern long bitrate_control_get_bitrate(struct bitrate_control *bc);
+
+/* adds "get_bitrate_estimate" to the output's procedures */
+extern void bitrate_control_add_proc(struct bitrate_control *bc,
+				     obs_output_t *output);
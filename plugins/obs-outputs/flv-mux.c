@@ -44,18 +44,20 @@ static inline double encoder_bitrate(obs_encoder_t *encoder)
 
 #define FLV_INFO_SIZE_OFFSET 42
 
-void write_file_info(FILE *file, int64_t duration_ms, int64_t size)
+void write_file_info(os_file_writer_t *file, int64_t duration_ms,
+		     int64_t size)
 {
 	char buf[64];
 	char *enc = buf;
 	char *end = enc + sizeof(buf);
 
-	fseek(file, FLV_INFO_SIZE_OFFSET, SEEK_SET);
+	if (!os_file_writer_seek(file, FLV_INFO_SIZE_OFFSET))
+		return;
 
 	enc_num_val(&enc, end, "duration", (double)duration_ms / 1000.0);
 	enc_num_val(&enc, end, "fileSize", (double)size);
 
-	fwrite(buf, 1, enc - buf, file);
+	os_file_writer_write(file, buf, enc - buf);
 }
 
 static void build_flv_meta_data(obs_output_t *context, uint8_t **output,
@@ -175,6 +177,8 @@ static void flv_video(struct serializer *s, int32_t dts_offset,
 	int64_t offset = packet->pts - packet->dts;
 	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
 
+	int64_t start = serializer_get_pos(s);
+
 	if (!packet->data || !packet->size)
 		return;
 
@@ -201,7 +205,7 @@ static void flv_video(struct serializer *s, int32_t dts_offset,
 	s_write(s, packet->data, packet->size);
 
 	/* write tag size (starting byte doesn't count) */
-	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
+	s_wb32(s, (uint32_t)(serializer_get_pos(s) - start) - 1);
 }
 
 static void flv_audio(struct serializer *s, int32_t dts_offset,
@@ -209,6 +213,8 @@ static void flv_audio(struct serializer *s, int32_t dts_offset,
 {
 	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
 
+	int64_t start = serializer_get_pos(s);
+
 	if (!packet->data || !packet->size)
 		return;
 
@@ -234,7 +240,31 @@ static void flv_audio(struct serializer *s, int32_t dts_offset,
 	s_write(s, packet->data, packet->size);
 
 	/* write tag size (starting byte doesn't count) */
-	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
+	s_wb32(s, (uint32_t)(serializer_get_pos(s) - start) - 1);
+}
+
+/* the serializer starts out with an empty output, keep the storage around
+ * and append to what is already there */
+static inline void append_serializer_init(struct serializer *s,
+					  struct array_output_data *out)
+{
+	struct array_output_data saved = *out;
+	array_output_serializer_init(s, out);
+	*out = saved;
+}
+
+void flv_packet_mux_append(struct array_output_data *out,
+			   struct encoder_packet *packet, int32_t dts_offset,
+			   bool is_header)
+{
+	struct serializer s;
+
+	append_serializer_init(&s, out);
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		flv_video(&s, dts_offset, packet, is_header);
+	else
+		flv_audio(&s, dts_offset, packet, is_header);
 }
 
 void flv_packet_mux(struct encoder_packet *packet, int32_t dts_offset,
@@ -452,6 +482,7 @@ static void flv_additional_audio(struct serializer *s, int32_t dts_offset,
 				 size_t index)
 {
 	int32_t time_ms = get_ms_time(packet, packet->dts) - dts_offset;
+	int64_t start = serializer_get_pos(s);
 	uint8_t *data;
 	size_t size;
 
@@ -479,7 +510,7 @@ static void flv_additional_audio(struct serializer *s, int32_t dts_offset,
 	serialize(s, data, size);
 	bfree(data);
 
-	s_wb32(s, (uint32_t)serializer_get_pos(s) - 1);
+	s_wb32(s, (uint32_t)(serializer_get_pos(s) - start) - 1);
 }
 
 void flv_additional_packet_mux(struct encoder_packet *packet,
@@ -501,3 +532,20 @@ void flv_additional_packet_mux(struct encoder_packet *packet,
 	*data = out.bytes.array;
 	*size = out.bytes.num;
 }
+
+void flv_additional_packet_mux_append(struct array_output_data *out,
+				      struct encoder_packet *packet,
+				      int32_t dts_offset, bool is_header,
+				      size_t index)
+{
+	struct serializer s;
+
+	append_serializer_init(&s, out);
+
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		//currently unsupported
+		bcrash("who said you could output an additional video packet?");
+	} else {
+		flv_additional_audio(&s, dts_offset, packet, is_header, index);
+	}
+}
@@ -18,6 +18,8 @@
 #pragma once
 
 #include <obs.h>
+#include <util/array-serializer.h>
+#include <util/file-writer.h>
 
 #define MILLISECOND_DEN 1000
 
@@ -26,7 +28,8 @@ static int32_t get_ms_time(struct encoder_packet *packet, int64_t val)
 	return (int32_t)(val * MILLISECOND_DEN / packet->timebase_den);
 }
 
-extern void write_file_info(FILE *file, int64_t duration_ms, int64_t size);
+extern void write_file_info(os_file_writer_t *file, int64_t duration_ms,
+			    int64_t size);
 
 extern void flv_meta_data(obs_output_t *context, uint8_t **output, size_t *size,
 			  bool write_header);
@@ -38,3 +41,13 @@ extern void flv_additional_packet_mux(struct encoder_packet *packet,
 				      int32_t dts_offset, uint8_t **output,
 				      size_t *size, bool is_header,
 				      size_t index);
+
+/* append the tag to `out` instead of allocating a new buffer, so one buffer
+ * can be reused and several tags sent with a single write */
+extern void flv_packet_mux_append(struct array_output_data *out,
+				  struct encoder_packet *packet,
+				  int32_t dts_offset, bool is_header);
+extern void flv_additional_packet_mux_append(struct array_output_data *out,
+					     struct encoder_packet *packet,
+					     int32_t dts_offset,
+					     bool is_header, size_t index);
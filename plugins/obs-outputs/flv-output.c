@@ -34,7 +34,7 @@
 struct flv_output {
 	obs_output_t *output;
 	struct dstr path;
-	FILE *file;
+	os_file_writer_t *file;
 	volatile bool active;
 	volatile bool stopping;
 	uint64_t stop_ts;
@@ -74,12 +74,36 @@ static void flv_output_destroy(void *data)
 	bfree(stream);
 }
 
+static void get_writer_stats(void *data, calldata_t *cd)
+{
+	struct flv_output *stream = data;
+	struct os_file_writer_stats stats;
+
+	pthread_mutex_lock(&stream->mutex);
+	os_file_writer_get_stats(stream->file, &stats);
+	pthread_mutex_unlock(&stream->mutex);
+
+	calldata_set_int(cd, "queued", (long long)stats.queued);
+	calldata_set_int(cd, "max_queued", (long long)stats.max_queued);
+	calldata_set_int(cd, "num_blocks", (long long)stats.num_blocks);
+	calldata_set_int(cd, "stalls", (long long)stats.stalls);
+	calldata_set_float(cd, "stall_ms", (double)stats.stall_ns / 1000000.0);
+}
+
 static void *flv_output_create(obs_data_t *settings, obs_output_t *output)
 {
 	struct flv_output *stream = bzalloc(sizeof(struct flv_output));
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+
 	stream->output = output;
 	pthread_mutex_init(&stream->mutex, NULL);
 
+	proc_handler_add(ph,
+			 "void get_writer_stats(out int queued, "
+			 "out int max_queued, out int num_blocks, "
+			 "out int stalls, out float stall_ms)",
+			 get_writer_stats, stream);
+
 	UNUSED_PARAMETER(settings);
 	return stream;
 }
@@ -95,7 +119,8 @@ static int write_packet(struct flv_output *stream,
 
 	flv_packet_mux(packet, is_header ? 0 : stream->start_dts_offset, &data,
 		       &size, is_header);
-	fwrite(data, 1, size, stream->file);
+	if (!os_file_writer_write(stream->file, data, size))
+		ret = -1;
 	bfree(data);
 
 	return ret;
@@ -107,7 +132,7 @@ static void write_meta_data(struct flv_output *stream)
 	size_t meta_data_size;
 
 	flv_meta_data(stream->output, &meta_data, &meta_data_size, true);
-	fwrite(meta_data, 1, meta_data_size, stream->file);
+	os_file_writer_write(stream->file, meta_data, meta_data_size);
 	bfree(meta_data);
 }
 
@@ -167,7 +192,9 @@ static bool flv_output_start(void *data)
 	dstr_copy(&stream->path, path);
 	obs_data_release(settings);
 
-	stream->file = os_fopen(stream->path.array, "wb");
+	/* written behind on its own thread, so a slow disk only holds up
+	 * packets once every write buffer is in flight */
+	stream->file = os_file_writer_create(stream->path.array, 0, 0);
 	if (!stream->file) {
 		warn("Unable to open FLV file '%s'", stream->path.array);
 		return false;
@@ -194,9 +221,14 @@ static void flv_output_actual_stop(struct flv_output *stream, int code)
 
 	if (stream->file) {
 		write_file_info(stream->file, stream->last_packet_ts,
-				os_ftelli64(stream->file));
+				os_file_writer_size(stream->file));
 
-		fclose(stream->file);
+		if (!os_file_writer_destroy(stream->file) && !code) {
+			warn("Failed to write FLV file '%s'",
+			     stream->path.array);
+			code = OBS_OUTPUT_ERROR;
+		}
+		stream->file = NULL;
 	}
 	if (code) {
 		obs_output_signal_stop(stream->output, code);
@@ -211,6 +243,7 @@ static void flv_output_data(void *data, struct encoder_packet *packet)
 {
 	struct flv_output *stream = data;
 	struct encoder_packet parsed_packet;
+	int ret;
 
 	pthread_mutex_lock(&stream->mutex);
 
@@ -242,10 +275,15 @@ static void flv_output_data(void *data, struct encoder_packet *packet)
 		}
 
 		obs_parse_avc_packet(&parsed_packet, packet);
-		write_packet(stream, &parsed_packet, false);
+		ret = write_packet(stream, &parsed_packet, false);
 		obs_encoder_packet_release(&parsed_packet);
 	} else {
-		write_packet(stream, packet, false);
+		ret = write_packet(stream, packet, false);
+	}
+
+	if (ret < 0) {
+		warn("Failed to write to FLV file '%s'", stream->path.array);
+		flv_output_actual_stop(stream, OBS_OUTPUT_ERROR);
 	}
 
 unlock:
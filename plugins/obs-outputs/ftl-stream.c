@@ -25,6 +25,7 @@
 #include "ftl.h"
 #include "flv-mux.h"
 #include "net-if.h"
+#include "bitrate-control.h"
 
 #ifdef _WIN32
 #include <Iphlpapi.h>
@@ -41,6 +42,7 @@
 #define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
 #define debug(format, ...) do_log(LOG_DEBUG, format, ##__VA_ARGS__)
 
+#define OPT_DYN_BITRATE "dyn_bitrate"
 #define OPT_DROP_THRESHOLD "drop_threshold_ms"
 #define OPT_MAX_SHUTDOWN_TIME_SEC "max_shutdown_time_sec"
 #define OPT_BIND_IP "bind_ip"
@@ -96,6 +98,13 @@ struct ftl_stream {
 	int min_priority;
 	float congestion;
 
+	/* dynamic bitrate, driven by the rtt and nack rate the ingest
+	 * reports since there is no TCP socket to look at */
+	struct bitrate_control dbr;
+	bool dbr_enabled;
+	volatile long rtt_ms;
+	volatile long loss_permille;
+
 	int64_t last_dts_usec;
 
 	uint64_t total_bytes_sent;
@@ -214,6 +223,7 @@ static void ftl_stream_destroy(void *data)
 		os_sem_destroy(stream->send_sem);
 		pthread_mutex_destroy(&stream->packets_mutex);
 		circlebuf_free(&stream->packets);
+		bitrate_control_free(&stream->dbr);
 		bfree(stream);
 	}
 }
@@ -235,6 +245,10 @@ static void *ftl_stream_create(obs_data_t *settings, obs_output_t *output)
 	if (os_event_init(&stream->stop_event, OS_EVENT_TYPE_MANUAL) != 0) {
 		goto fail;
 	}
+	if (!bitrate_control_init(&stream->dbr)) {
+		goto fail;
+	}
+	bitrate_control_add_proc(&stream->dbr, output);
 
 	stream->coded_pic_buffer.total = 0;
 	stream->coded_pic_buffer.complete_frame = 0;
@@ -502,10 +516,17 @@ static void *send_thread(void *data)
 			}
 		}
 
+		uint64_t send_beg = os_gettime_ns();
+		size_t send_size = packet.size;
+
 		if (send_packet(stream, &packet, false) < 0) {
 			os_atomic_set_bool(&stream->disconnected, true);
 			break;
 		}
+
+		if (stream->dbr_enabled)
+			bitrate_control_add_send(&stream->dbr, send_size,
+						 send_beg, os_gettime_ns());
 	}
 
 	bool encode_error = os_atomic_load_bool(&stream->encode_error);
@@ -538,6 +559,14 @@ static void *send_thread(void *data)
 	os_event_reset(stream->stop_event);
 	os_atomic_set_bool(&stream->active, false);
 	stream->sent_headers = false;
+
+	/* reset bitrate on stop */
+	if (stream->dbr_enabled && bitrate_control_reset(&stream->dbr)) {
+		bitrate_control_apply(
+			&stream->dbr,
+			obs_output_get_video_encoder(stream->output));
+	}
+
 	return NULL;
 }
 
@@ -738,6 +767,25 @@ static bool find_first_video_packet(struct ftl_stream *stream,
 	return false;
 }
 
+static void dbr_update(struct ftl_stream *stream, int64_t buffer_duration_usec)
+{
+	struct bitrate_signals signals;
+	long rtt_ms = os_atomic_load_long(&stream->rtt_ms);
+
+	bitrate_signals_init(&signals);
+	signals.queue_usec = buffer_duration_usec;
+	signals.rtt_usec = rtt_ms > 0 ? (int64_t)rtt_ms * 1000 : -1;
+	signals.loss = os_atomic_load_long(&stream->loss_permille) / 1000.0;
+
+	if (bitrate_control_update(&stream->dbr, &signals)) {
+		debug("buffer_duration_msec: %" PRId64,
+		      buffer_duration_usec / 1000);
+		bitrate_control_apply(
+			&stream->dbr,
+			obs_output_get_video_encoder(stream->output));
+	}
+}
+
 static void check_to_drop_frames(struct ftl_stream *stream, bool pframes)
 {
 	struct encoder_packet first;
@@ -750,8 +798,11 @@ static void check_to_drop_frames(struct ftl_stream *stream, bool pframes)
 					 : stream->drop_threshold_usec;
 
 	if (num_packets < 5) {
-		if (!pframes)
+		if (!pframes) {
 			stream->congestion = 0.0f;
+			if (stream->dbr_enabled)
+				dbr_update(stream, 0);
+		}
 		return;
 	}
 
@@ -765,6 +816,8 @@ static void check_to_drop_frames(struct ftl_stream *stream, bool pframes)
 	if (!pframes) {
 		stream->congestion =
 			(float)buffer_duration_usec / (float)drop_threshold;
+		if (stream->dbr_enabled)
+			dbr_update(stream, buffer_duration_usec);
 	}
 
 	if (buffer_duration_usec > drop_threshold) {
@@ -925,10 +978,15 @@ static void *status_thread(void *data)
 			ftl_packet_stats_msg_t *p = &status.msg.pkt_stats;
 
 			// Report nack requests as dropped frames
-			stream->dropped_frames +=
-				p->nack_reqs - stream->last_nack_count;
+			uint64_t nacks = p->nack_reqs - stream->last_nack_count;
+			stream->dropped_frames += nacks;
 			stream->last_nack_count = p->nack_reqs;
 
+			if (p->sent > 0)
+				os_atomic_set_long(
+					&stream->loss_permille,
+					(long)(nacks * 1000 / p->sent));
+
 			int log_level = p->nack_reqs > 0 ? LOG_INFO : LOG_DEBUG;
 
 			blog(log_level,
@@ -943,6 +1001,8 @@ static void *status_thread(void *data)
 
 			int log_level = p->avg_rtt > 20 ? LOG_INFO : LOG_DEBUG;
 
+			os_atomic_set_long(&stream->rtt_ms, p->avg_rtt);
+
 			blog(log_level,
 			     "avg transmit delay %dms "
 			     "(min: %d, max: %d), "
@@ -1104,6 +1164,29 @@ static int init_connect(struct ftl_stream *stream)
 	bind_ip = obs_data_get_string(settings, OPT_BIND_IP);
 	dstr_copy(&stream->bind_ip, bind_ip);
 
+	stream->dbr_enabled = obs_data_get_bool(settings, OPT_DYN_BITRATE) &&
+			      (obs_encoder_get_caps(video_encoder) &
+			       OBS_ENCODER_CAP_DYN_BITRATE) != 0 &&
+			      obs_output_get_delay(stream->output) == 0;
+	os_atomic_set_long(&stream->rtt_ms, 0);
+	os_atomic_set_long(&stream->loss_permille, 0);
+
+	if (stream->dbr_enabled) {
+		obs_encoder_t *audio_encoder =
+			obs_output_get_audio_encoder(stream->output, 0);
+		obs_data_t *audio_settings =
+			obs_encoder_get_settings(audio_encoder);
+
+		info("Dynamic bitrate enabled");
+		bitrate_control_start(
+			&stream->dbr,
+			obs_data_get_string(settings,
+					    OPT_DYN_BITRATE_ESTIMATOR),
+			target_bitrate,
+			(long)obs_data_get_int(audio_settings, "bitrate"));
+		obs_data_release(audio_settings);
+	}
+
 	obs_data_release(settings);
 	obs_data_release(video_settings);
 	return OBS_OUTPUT_SUCCESS;
@@ -0,0 +1,1146 @@
+#include <obs-module.h>
+#include <util/circlebuf.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/dstr.h>
+#include <util/curl/curl-helper.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "mpegts-mux.h"
+
+/*
+ * HLS ingest over HTTP PUT, muxed in-process into MPEG-TS segments.  In low
+ * latency mode every segment is also cut into LL-HLS partial segments that
+ * are uploaded as soon as they are complete, and the playlist advertises the
+ * next part with a preload hint.
+ *
+ * Uploads run on a small pool of workers, each keeping its own curl handle so
+ * the connection (HTTP/1.1 keep-alive, or HTTP/2 where the server offers it)
+ * is reused from one PUT to the next.  The playlist only ever lists media that
+ * finished uploading, so parallel uploads can complete out of order.
+ */
+
+#define do_log(level, format, ...)                \
+	blog(level, "[hls stream: '%s'] " format, \
+	     obs_output_get_name(stream->output), ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+#define debug(format, ...) do_log(LOG_DEBUG, format, ##__VA_ARGS__)
+
+#define OPT_LOW_LATENCY "low_latency"
+#define OPT_PART_DURATION "part_duration_ms"
+#define OPT_UPLOAD_THREADS "upload_threads"
+#define OPT_RETRIES "retries"
+#define OPT_DROP_THRESHOLD "drop_threshold_ms"
+
+#define MAX_UPLOAD_THREADS 8
+#define PLAYLIST_SEGMENTS 6
+#define DEFAULT_SEGMENT_USEC 2000000LL
+#define RETRY_DELAY_MS 100
+#define RETRY_MAX_DELAY_MS 1600
+#define UPLOAD_TIMEOUT_SEC 10L
+
+/* parts are only listed for this many of the newest segments */
+#define PART_SEGMENTS 2
+
+enum upload_type {
+	UPLOAD_SEGMENT,
+	UPLOAD_PART,
+};
+
+struct hls_upload {
+	enum upload_type type;
+	uint64_t seq;
+	size_t part;
+	uint8_t *data;
+	size_t size;
+};
+
+struct hls_part {
+	double duration;
+	bool independent;
+	bool uploaded;
+};
+
+struct hls_segment {
+	uint64_t seq;
+	double duration;
+	bool complete;
+	bool uploaded;
+	DARRAY(struct hls_part) parts;
+};
+
+struct hls_worker {
+	struct hls_stream *stream;
+	pthread_t thread;
+	CURL *curl;
+	struct curl_slist *ts_headers;
+	struct curl_slist *playlist_headers;
+};
+
+struct hls_stream {
+	obs_output_t *output;
+
+	pthread_mutex_t packets_mutex;
+	struct circlebuf packets;
+	bool dropping_video;
+
+	volatile bool active;
+	volatile bool disconnected;
+	pthread_t mux_thread;
+
+	os_sem_t *send_sem;
+	os_event_t *stop_event;
+	uint64_t stop_ts;
+
+	/* the playlist URL is split around its file name, which is replaced
+	 * by the media file names to get their URLs */
+	struct dstr url_prefix;
+	struct dstr url_suffix;
+	struct dstr playlist_name;
+	struct dstr base_name;
+
+	bool low_latency;
+	int64_t part_usec;
+	int64_t segment_usec;
+	int retries;
+	int64_t drop_threshold_usec;
+
+	/* muxing, only touched by the mux thread */
+	struct mpegts_mux mux;
+	bool segment_open;
+	uint64_t segment_seq;
+	int64_t segment_start_usec;
+	int64_t part_start_usec;
+	size_t part_offset;
+	bool part_independent;
+
+	/* playlist state, shared with the workers */
+	pthread_mutex_t state_mutex;
+	DARRAY(struct hls_segment) segments;
+	bool ended;
+	bool playlist_dirty;
+	bool playlist_busy;
+
+	pthread_mutex_t upload_mutex;
+	struct circlebuf uploads;
+	os_sem_t *upload_sem;
+	volatile bool upload_exit;
+	struct hls_worker workers[MAX_UPLOAD_THREADS];
+	size_t num_workers;
+
+	volatile long long total_bytes_sent;
+	int dropped_frames;
+	volatile long failed_uploads;
+};
+
+static inline bool stopping(struct hls_stream *stream)
+{
+	return os_event_try(stream->stop_event) != EAGAIN;
+}
+
+static inline bool active(struct hls_stream *stream)
+{
+	return os_atomic_load_bool(&stream->active);
+}
+
+static inline bool disconnected(struct hls_stream *stream)
+{
+	return os_atomic_load_bool(&stream->disconnected);
+}
+
+/* a stop without a timestamp abandons whatever is still queued */
+static inline bool aborting(struct hls_stream *stream)
+{
+	return disconnected(stream) || (stopping(stream) && !stream->stop_ts);
+}
+
+static void free_packets(struct hls_stream *stream)
+{
+	pthread_mutex_lock(&stream->packets_mutex);
+	while (stream->packets.size) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
+		obs_encoder_packet_release(&packet);
+	}
+	stream->dropping_video = false;
+	pthread_mutex_unlock(&stream->packets_mutex);
+}
+
+static void free_uploads(struct hls_stream *stream)
+{
+	pthread_mutex_lock(&stream->upload_mutex);
+	while (stream->uploads.size) {
+		struct hls_upload *upload;
+		circlebuf_pop_front(&stream->uploads, &upload, sizeof(upload));
+		bfree(upload->data);
+		bfree(upload);
+	}
+	pthread_mutex_unlock(&stream->upload_mutex);
+}
+
+static void free_segments(struct hls_stream *stream)
+{
+	pthread_mutex_lock(&stream->state_mutex);
+	for (size_t i = 0; i < stream->segments.num; i++)
+		da_free(stream->segments.array[i].parts);
+	da_free(stream->segments);
+	stream->ended = false;
+	stream->playlist_dirty = false;
+	pthread_mutex_unlock(&stream->state_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* URLs                                                                      */
+
+static void split_url(struct hls_stream *stream, const char *url)
+{
+	const char *query = strchr(url, '?');
+	const char *file = query ? strstr(query, "file=") : NULL;
+	const char *name;
+	const char *end;
+	const char *ext;
+
+	/* YouTube style URLs carry the file name as a query parameter */
+	if (file && (file[-1] == '?' || file[-1] == '&')) {
+		name = file + 5;
+		end = name + strcspn(name, "&");
+	} else {
+		end = query ? query : url + strlen(url);
+		name = end;
+		while (name > url && name[-1] != '/')
+			name--;
+	}
+
+	dstr_ncopy(&stream->url_prefix, url, name - url);
+	dstr_copy(&stream->url_suffix, end);
+	dstr_ncopy(&stream->playlist_name, name, end - name);
+
+	if (dstr_is_empty(&stream->playlist_name))
+		dstr_copy(&stream->playlist_name, "stream.m3u8");
+
+	ext = strrchr(stream->playlist_name.array, '.');
+	if (ext)
+		dstr_ncopy(&stream->base_name, stream->playlist_name.array,
+			   ext - stream->playlist_name.array);
+	else
+		dstr_copy_dstr(&stream->base_name, &stream->playlist_name);
+}
+
+static void get_media_name(struct hls_stream *stream, struct dstr *name,
+			   enum upload_type type, uint64_t seq, size_t part)
+{
+	if (type == UPLOAD_PART)
+		dstr_printf(name, "%s%" PRIu64 ".%d.ts",
+			    stream->base_name.array, seq, (int)part);
+	else
+		dstr_printf(name, "%s%" PRIu64 ".ts", stream->base_name.array,
+			    seq);
+}
+
+static void get_url(struct hls_stream *stream, struct dstr *url,
+		    const char *name)
+{
+	dstr_copy_dstr(url, &stream->url_prefix);
+	dstr_cat(url, name);
+	dstr_cat_dstr(url, &stream->url_suffix);
+}
+
+/* ------------------------------------------------------------------------- */
+/* playlist                                                                  */
+
+static inline double segment_target(struct hls_stream *stream)
+{
+	double target = (double)stream->segment_usec / 1000000.0;
+
+	for (size_t i = 0; i < stream->segments.num; i++) {
+		double duration = stream->segments.array[i].duration;
+		if (duration > target)
+			target = duration;
+	}
+
+	return ceil(target);
+}
+
+/* lists everything up to the first segment or part that is still uploading,
+ * called with state_mutex held */
+static void build_playlist(struct hls_stream *stream, struct dstr *text)
+{
+	double part_target = (double)stream->part_usec / 1000000.0;
+	size_t first_parts = stream->segments.num > PART_SEGMENTS
+				     ? stream->segments.num - PART_SEGMENTS
+				     : 0;
+	struct dstr name = {0};
+	uint64_t hint_seq = 0;
+	size_t hint_part = 0;
+	bool complete = true;
+
+	dstr_copy(text, "#EXTM3U\n");
+	dstr_catf(text, "#EXT-X-VERSION:%d\n", stream->low_latency ? 6 : 3);
+	dstr_catf(text, "#EXT-X-TARGETDURATION:%d\n",
+		  (int)segment_target(stream));
+
+	if (stream->low_latency) {
+		dstr_catf(text,
+			  "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%.3f\n"
+			  "#EXT-X-PART-INF:PART-TARGET=%.3f\n",
+			  part_target * 3.0, part_target);
+	}
+
+	if (stream->segments.num)
+		dstr_catf(text, "#EXT-X-MEDIA-SEQUENCE:%" PRIu64 "\n",
+			  stream->segments.array[0].seq);
+
+	for (size_t i = 0; i < stream->segments.num && complete; i++) {
+		struct hls_segment *seg = &stream->segments.array[i];
+		size_t parts = 0;
+
+		if (stream->low_latency && i >= first_parts) {
+			for (; parts < seg->parts.num; parts++) {
+				struct hls_part *part =
+					&seg->parts.array[parts];
+
+				if (!part->uploaded)
+					break;
+
+				get_media_name(stream, &name, UPLOAD_PART,
+					       seg->seq, parts);
+				dstr_catf(text,
+					  "#EXT-X-PART:DURATION=%.3f,"
+					  "URI=\"%s\"%s\n",
+					  part->duration, name.array,
+					  part->independent
+						  ? ",INDEPENDENT=YES"
+						  : "");
+			}
+		}
+
+		/* the hint is the part after the last one listed */
+		hint_seq = seg->seq;
+		hint_part = parts;
+
+		if (parts < seg->parts.num || !seg->complete ||
+		    !seg->uploaded) {
+			complete = false;
+		} else {
+			get_media_name(stream, &name, UPLOAD_SEGMENT, seg->seq,
+				       0);
+			dstr_catf(text, "#EXTINF:%.3f,\n%s\n", seg->duration,
+				  name.array);
+			hint_seq = seg->seq + 1;
+			hint_part = 0;
+		}
+	}
+
+	if (stream->low_latency && !stream->ended) {
+		get_media_name(stream, &name, UPLOAD_PART, hint_seq, hint_part);
+		dstr_catf(text, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s\"\n",
+			  name.array);
+	}
+
+	if (complete && stream->ended)
+		dstr_cat(text, "#EXT-X-ENDLIST\n");
+
+	dstr_free(&name);
+}
+
+/* ------------------------------------------------------------------------- */
+/* uploading                                                                 */
+
+static size_t discard_cb(char *ptr, size_t size, size_t nmemb, void *param)
+{
+	UNUSED_PARAMETER(ptr);
+	UNUSED_PARAMETER(param);
+	return size * nmemb;
+}
+
+static bool init_worker(struct hls_worker *worker)
+{
+	CURL *curl = curl_easy_init();
+
+	if (!curl)
+		return false;
+
+	worker->curl = curl;
+	worker->ts_headers =
+		curl_slist_append(NULL, "Content-Type: video/mp2t");
+	worker->playlist_headers = curl_slist_append(
+		NULL, "Content-Type: application/vnd.apple.mpegurl");
+
+	curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+	curl_easy_setopt(curl, CURLOPT_HTTP_VERSION,
+			 (long)CURL_HTTP_VERSION_2TLS);
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT, UPLOAD_TIMEOUT_SEC);
+	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard_cb);
+	curl_obs_set_revoke_setting(curl);
+	return true;
+}
+
+static void free_worker(struct hls_worker *worker)
+{
+	if (worker->curl)
+		curl_easy_cleanup(worker->curl);
+	curl_slist_free_all(worker->ts_headers);
+	curl_slist_free_all(worker->playlist_headers);
+	worker->curl = NULL;
+	worker->ts_headers = NULL;
+	worker->playlist_headers = NULL;
+}
+
+/* PUTs the data, retrying with a doubling delay.  The curl handle keeps the
+ * connection open between calls. */
+static bool put_data(struct hls_worker *worker, const char *name,
+		     const void *data, size_t size, bool playlist)
+{
+	struct hls_stream *stream = worker->stream;
+	struct dstr url = {0};
+	int delay = RETRY_DELAY_MS;
+	bool success = false;
+
+	get_url(stream, &url, name);
+
+	curl_easy_setopt(worker->curl, CURLOPT_URL, url.array);
+	curl_easy_setopt(worker->curl, CURLOPT_HTTPHEADER,
+			 playlist ? worker->playlist_headers
+				  : worker->ts_headers);
+	curl_easy_setopt(worker->curl, CURLOPT_POSTFIELDS, data);
+	curl_easy_setopt(worker->curl, CURLOPT_POSTFIELDSIZE_LARGE,
+			 (curl_off_t)size);
+
+	for (int attempt = 0; attempt <= stream->retries; attempt++) {
+		CURLcode res;
+		long code = 0;
+
+		if (attempt) {
+			os_sleep_ms(delay);
+			if (delay < RETRY_MAX_DELAY_MS)
+				delay *= 2;
+		}
+		if (aborting(stream))
+			break;
+
+		res = curl_easy_perform(worker->curl);
+		if (res == CURLE_OK)
+			curl_easy_getinfo(worker->curl, CURLINFO_RESPONSE_CODE,
+					  &code);
+
+		if (res == CURLE_OK && code >= 200 && code < 300) {
+			os_atomic_add_long_long(&stream->total_bytes_sent,
+						(long long)size);
+			success = true;
+			break;
+		}
+
+		if (res != CURLE_OK)
+			warn("Upload of '%s' failed: %s", name,
+			     curl_easy_strerror(res));
+		else
+			warn("Upload of '%s' failed: HTTP %ld", name, code);
+	}
+
+	dstr_free(&url);
+	return success;
+}
+
+static struct hls_segment *find_segment(struct hls_stream *stream,
+					uint64_t seq)
+{
+	for (size_t i = 0; i < stream->segments.num; i++) {
+		if (stream->segments.array[i].seq == seq)
+			return &stream->segments.array[i];
+	}
+
+	return NULL;
+}
+
+static void mark_uploaded(struct hls_stream *stream,
+			  const struct hls_upload *upload)
+{
+	struct hls_segment *seg = find_segment(stream, upload->seq);
+
+	/* the segment may have scrolled out of the playlist already */
+	if (!seg)
+		return;
+
+	if (upload->type == UPLOAD_SEGMENT)
+		seg->uploaded = true;
+	else if (upload->part < seg->parts.num)
+		seg->parts.array[upload->part].uploaded = true;
+}
+
+/* only one worker uploads the playlist at a time, the others just mark it
+ * dirty and it is uploaded again once the current upload finishes */
+static bool publish_playlist(struct hls_worker *worker)
+{
+	struct hls_stream *stream = worker->stream;
+	struct dstr text = {0};
+	bool success = true;
+
+	pthread_mutex_lock(&stream->state_mutex);
+	stream->playlist_dirty = true;
+
+	if (!stream->playlist_busy) {
+		stream->playlist_busy = true;
+
+		while (stream->playlist_dirty && success) {
+			stream->playlist_dirty = false;
+			build_playlist(stream, &text);
+			pthread_mutex_unlock(&stream->state_mutex);
+
+			success = put_data(worker, stream->playlist_name.array,
+					   text.array, text.len, true);
+
+			pthread_mutex_lock(&stream->state_mutex);
+		}
+
+		stream->playlist_busy = false;
+	}
+
+	pthread_mutex_unlock(&stream->state_mutex);
+	dstr_free(&text);
+	return success;
+}
+
+static void upload_failed(struct hls_stream *stream)
+{
+	os_atomic_inc_long(&stream->failed_uploads);
+
+	if (!aborting(stream)) {
+		os_atomic_set_bool(&stream->disconnected, true);
+		os_sem_post(stream->send_sem);
+	}
+}
+
+static inline struct hls_upload *get_next_upload(struct hls_stream *stream)
+{
+	struct hls_upload *upload = NULL;
+
+	pthread_mutex_lock(&stream->upload_mutex);
+	if (stream->uploads.size)
+		circlebuf_pop_front(&stream->uploads, &upload, sizeof(upload));
+	pthread_mutex_unlock(&stream->upload_mutex);
+
+	return upload;
+}
+
+static void *upload_thread(void *data)
+{
+	struct hls_worker *worker = data;
+	struct hls_stream *stream = worker->stream;
+	struct dstr name = {0};
+
+	os_set_thread_name("hls-stream: upload_thread");
+
+	while (os_sem_wait(stream->upload_sem) == 0) {
+		struct hls_upload *upload = get_next_upload(stream);
+
+		if (!upload) {
+			if (os_atomic_load_bool(&stream->upload_exit))
+				break;
+			continue;
+		}
+
+		get_media_name(stream, &name, upload->type, upload->seq,
+			       upload->part);
+
+		if (!aborting(stream)) {
+			if (put_data(worker, name.array, upload->data,
+				     upload->size, false)) {
+				pthread_mutex_lock(&stream->state_mutex);
+				mark_uploaded(stream, upload);
+				pthread_mutex_unlock(&stream->state_mutex);
+
+				if (!publish_playlist(worker))
+					upload_failed(stream);
+			} else {
+				upload_failed(stream);
+			}
+		}
+
+		bfree(upload->data);
+		bfree(upload);
+	}
+
+	dstr_free(&name);
+	return NULL;
+}
+
+static void queue_upload(struct hls_stream *stream, enum upload_type type,
+			 uint64_t seq, size_t part, const uint8_t *data,
+			 size_t size)
+{
+	struct hls_upload *upload = bzalloc(sizeof(*upload));
+
+	upload->type = type;
+	upload->seq = seq;
+	upload->part = part;
+	upload->data = bmemdup(data, size);
+	upload->size = size;
+
+	pthread_mutex_lock(&stream->upload_mutex);
+	circlebuf_push_back(&stream->uploads, &upload, sizeof(upload));
+	pthread_mutex_unlock(&stream->upload_mutex);
+
+	os_sem_post(stream->upload_sem);
+}
+
+static bool start_workers(struct hls_stream *stream, size_t count)
+{
+	if (os_sem_init(&stream->upload_sem, 0) != 0)
+		return false;
+
+	os_atomic_set_bool(&stream->upload_exit, false);
+
+	for (size_t i = 0; i < count; i++) {
+		struct hls_worker *worker = &stream->workers[i];
+
+		worker->stream = stream;
+		if (!init_worker(worker))
+			return false;
+		if (pthread_create(&worker->thread, NULL, upload_thread,
+				   worker) != 0) {
+			free_worker(worker);
+			return false;
+		}
+
+		stream->num_workers++;
+	}
+
+	return true;
+}
+
+/* workers finish the queue before exiting unless the stream is aborting */
+static void stop_workers(struct hls_stream *stream)
+{
+	os_atomic_set_bool(&stream->upload_exit, true);
+
+	for (size_t i = 0; i < stream->num_workers; i++)
+		os_sem_post(stream->upload_sem);
+	for (size_t i = 0; i < stream->num_workers; i++) {
+		pthread_join(stream->workers[i].thread, NULL);
+		free_worker(&stream->workers[i]);
+	}
+
+	stream->num_workers = 0;
+	free_uploads(stream);
+	os_sem_destroy(stream->upload_sem);
+	stream->upload_sem = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* segmenting                                                                */
+
+static inline double usec_to_sec(int64_t usec)
+{
+	return (double)usec / 1000000.0;
+}
+
+static void close_part(struct hls_stream *stream, int64_t end_usec)
+{
+	struct hls_segment *seg;
+	struct hls_part *part;
+	size_t size = stream->mux.out.num - stream->part_offset;
+	size_t index;
+
+	if (!stream->low_latency || !size)
+		return;
+
+	pthread_mutex_lock(&stream->state_mutex);
+	seg = da_end(stream->segments);
+	index = seg->parts.num;
+	part = da_push_back_new(seg->parts);
+	part->duration = usec_to_sec(end_usec - stream->part_start_usec);
+	part->independent = stream->part_independent;
+	pthread_mutex_unlock(&stream->state_mutex);
+
+	queue_upload(stream, UPLOAD_PART, stream->segment_seq, index,
+		     stream->mux.out.array + stream->part_offset, size);
+
+	stream->part_offset = stream->mux.out.num;
+	stream->part_start_usec = end_usec;
+	stream->part_independent = false;
+}
+
+static void close_segment(struct hls_stream *stream, int64_t end_usec)
+{
+	struct hls_segment *seg;
+
+	close_part(stream, end_usec);
+
+	pthread_mutex_lock(&stream->state_mutex);
+	seg = da_end(stream->segments);
+	seg->duration = usec_to_sec(end_usec - stream->segment_start_usec);
+	seg->complete = true;
+	pthread_mutex_unlock(&stream->state_mutex);
+
+	queue_upload(stream, UPLOAD_SEGMENT, stream->segment_seq, 0,
+		     stream->mux.out.array, stream->mux.out.num);
+
+	mpegts_mux_consume(&stream->mux, stream->mux.out.num);
+	stream->part_offset = 0;
+	stream->segment_open = false;
+	stream->segment_seq++;
+}
+
+static void open_segment(struct hls_stream *stream,
+			 const struct encoder_packet *packet)
+{
+	struct hls_segment *seg;
+
+	pthread_mutex_lock(&stream->state_mutex);
+	while (stream->segments.num >= PLAYLIST_SEGMENTS) {
+		da_free(stream->segments.array[0].parts);
+		da_erase(stream->segments, 0);
+	}
+
+	seg = da_push_back_new(stream->segments);
+	seg->seq = stream->segment_seq;
+	pthread_mutex_unlock(&stream->state_mutex);
+
+	stream->segment_open = true;
+	stream->segment_start_usec = packet->dts_usec;
+	stream->part_start_usec = packet->dts_usec;
+	stream->part_offset = stream->mux.out.num;
+	stream->part_independent = packet->type == OBS_ENCODER_VIDEO &&
+				   packet->keyframe;
+}
+
+/* segments are cut at keyframes once they reach the target duration, parts
+ * at the first video frame past the part target */
+static void mux_packet(struct hls_stream *stream,
+		       const struct encoder_packet *packet)
+{
+	if (!stream->segment_open) {
+		open_segment(stream, packet);
+
+	} else if (packet->type == OBS_ENCODER_VIDEO) {
+		int64_t dts = packet->dts_usec;
+		int64_t segment_min = stream->segment_usec * 9 / 10;
+
+		if (packet->keyframe &&
+		    dts - stream->segment_start_usec >= segment_min) {
+			close_segment(stream, dts);
+			open_segment(stream, packet);
+
+		} else if (stream->low_latency &&
+			   dts - stream->part_start_usec >= stream->part_usec) {
+			close_part(stream, dts);
+			stream->part_independent = packet->keyframe;
+		}
+	}
+
+	mpegts_mux_packet(&stream->mux, packet);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const char *hls_stream_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("HLSStream");
+}
+
+static void hls_stream_destroy(void *data)
+{
+	struct hls_stream *stream = data;
+
+	if (stopping(stream)) {
+		pthread_join(stream->mux_thread, NULL);
+
+	} else if (active(stream)) {
+		stream->stop_ts = 0;
+		os_event_signal(stream->stop_event);
+		os_sem_post(stream->send_sem);
+		obs_output_end_data_capture(stream->output);
+		pthread_join(stream->mux_thread, NULL);
+	}
+
+	free_packets(stream);
+	free_uploads(stream);
+	free_segments(stream);
+	mpegts_mux_free(&stream->mux);
+	dstr_free(&stream->url_prefix);
+	dstr_free(&stream->url_suffix);
+	dstr_free(&stream->playlist_name);
+	dstr_free(&stream->base_name);
+	os_event_destroy(stream->stop_event);
+	os_sem_destroy(stream->send_sem);
+	os_sem_destroy(stream->upload_sem);
+	pthread_mutex_destroy(&stream->packets_mutex);
+	pthread_mutex_destroy(&stream->state_mutex);
+	pthread_mutex_destroy(&stream->upload_mutex);
+	circlebuf_free(&stream->packets);
+	circlebuf_free(&stream->uploads);
+	bfree(stream);
+}
+
+static void *hls_stream_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct hls_stream *stream = bzalloc(sizeof(struct hls_stream));
+
+	stream->output = output;
+	pthread_mutex_init_value(&stream->packets_mutex);
+	pthread_mutex_init_value(&stream->state_mutex);
+	pthread_mutex_init_value(&stream->upload_mutex);
+
+	if (pthread_mutex_init(&stream->packets_mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&stream->state_mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&stream->upload_mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&stream->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+
+	UNUSED_PARAMETER(settings);
+	return stream;
+
+fail:
+	hls_stream_destroy(stream);
+	return NULL;
+}
+
+static void hls_stream_stop(void *data, uint64_t ts)
+{
+	struct hls_stream *stream = data;
+
+	if (stopping(stream) && ts != 0)
+		return;
+
+	stream->stop_ts = ts / 1000ULL;
+
+	if (active(stream)) {
+		os_event_signal(stream->stop_event);
+		if (stream->stop_ts == 0)
+			os_sem_post(stream->send_sem);
+	} else {
+		obs_output_signal_stop(stream->output, OBS_OUTPUT_SUCCESS);
+	}
+}
+
+static inline bool get_next_packet(struct hls_stream *stream,
+				   struct encoder_packet *packet)
+{
+	bool new_packet = false;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+	if (stream->packets.size) {
+		circlebuf_pop_front(&stream->packets, packet,
+				    sizeof(struct encoder_packet));
+		new_packet = true;
+	}
+	pthread_mutex_unlock(&stream->packets_mutex);
+
+	return new_packet;
+}
+
+static void *mux_thread(void *data)
+{
+	struct hls_stream *stream = data;
+	int64_t last_dts_usec = 0;
+
+	os_set_thread_name("hls-stream: mux_thread");
+
+	while (os_sem_wait(stream->send_sem) == 0) {
+		struct encoder_packet packet;
+
+		if (aborting(stream))
+			break;
+		if (!get_next_packet(stream, &packet))
+			continue;
+
+		if (stopping(stream) &&
+		    packet.sys_dts_usec >= (int64_t)stream->stop_ts) {
+			obs_encoder_packet_release(&packet);
+			break;
+		}
+
+		mux_packet(stream, &packet);
+		last_dts_usec = packet.dts_usec;
+		obs_encoder_packet_release(&packet);
+	}
+
+	if (disconnected(stream)) {
+		info("Disconnected, %ld uploads failed",
+		     os_atomic_load_long(&stream->failed_uploads));
+	} else {
+		if (stream->segment_open && !aborting(stream)) {
+			pthread_mutex_lock(&stream->state_mutex);
+			stream->ended = true;
+			pthread_mutex_unlock(&stream->state_mutex);
+
+			close_segment(stream, last_dts_usec);
+		}
+		info("User stopped the stream");
+	}
+
+	stop_workers(stream);
+
+	if (!stopping(stream)) {
+		pthread_detach(stream->mux_thread);
+		obs_output_signal_stop(stream->output, OBS_OUTPUT_DISCONNECTED);
+	} else {
+		obs_output_end_data_capture(stream->output);
+	}
+
+	free_packets(stream);
+	free_segments(stream);
+	mpegts_mux_free(&stream->mux);
+	os_event_reset(stream->stop_event);
+	os_atomic_set_bool(&stream->active, false);
+	return NULL;
+}
+
+static int64_t get_segment_usec(obs_encoder_t *encoder)
+{
+	obs_data_t *settings = obs_encoder_get_settings(encoder);
+	int keyint_sec = (int)obs_data_get_int(settings, "keyint_sec");
+
+	obs_data_release(settings);
+	return keyint_sec ? (int64_t)keyint_sec * 1000000
+			  : DEFAULT_SEGMENT_USEC;
+}
+
+static bool init_stream(struct hls_stream *stream)
+{
+	obs_service_t *service = obs_output_get_service(stream->output);
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
+	obs_encoder_t *aencoder =
+		obs_output_get_audio_encoder(stream->output, 0);
+	struct dstr url = {0};
+	obs_data_t *settings;
+
+	if (!service)
+		return false;
+
+	os_atomic_set_bool(&stream->disconnected, false);
+	free_packets(stream);
+	free_segments(stream);
+
+	dstr_copy(&url, obs_service_get_url(service));
+	dstr_depad(&url);
+	dstr_replace(&url, "{stream_key}", obs_service_get_key(service));
+
+	if (astrcmpi_n(url.array, "http://", 7) != 0 &&
+	    astrcmpi_n(url.array, "https://", 8) != 0) {
+		warn("Unsupported URL, must be http:// or https://");
+		dstr_free(&url);
+		return false;
+	}
+
+	split_url(stream, url.array);
+	dstr_free(&url);
+
+	settings = obs_output_get_settings(stream->output);
+	stream->low_latency = obs_data_get_bool(settings, OPT_LOW_LATENCY);
+	stream->part_usec =
+		(int64_t)obs_data_get_int(settings, OPT_PART_DURATION) * 1000;
+	stream->retries = (int)obs_data_get_int(settings, OPT_RETRIES);
+	stream->drop_threshold_usec =
+		(int64_t)obs_data_get_int(settings, OPT_DROP_THRESHOLD) * 1000;
+	stream->num_workers = 0;
+
+	size_t threads = (size_t)obs_data_get_int(settings, OPT_UPLOAD_THREADS);
+	if (threads < 1)
+		threads = 1;
+	if (threads > MAX_UPLOAD_THREADS)
+		threads = MAX_UPLOAD_THREADS;
+	obs_data_release(settings);
+
+	stream->segment_usec = get_segment_usec(vencoder);
+	if (stream->part_usec <= 0 || stream->part_usec > stream->segment_usec)
+		stream->low_latency = false;
+
+	stream->segment_open = false;
+	stream->segment_seq = 0;
+	stream->total_bytes_sent = 0;
+	stream->dropped_frames = 0;
+	stream->failed_uploads = 0;
+
+	if (!start_workers(stream, threads)) {
+		warn("Failed to start upload threads");
+		stop_workers(stream);
+		return false;
+	}
+
+	mpegts_mux_init(&stream->mux, vencoder, aencoder);
+	return true;
+}
+
+static bool hls_stream_start(void *data)
+{
+	struct hls_stream *stream = data;
+
+	if (!obs_output_can_begin_data_capture(stream->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(stream->output, 0))
+		return false;
+	if (!init_stream(stream))
+		return false;
+
+	os_sem_destroy(stream->send_sem);
+	stream->send_sem = NULL;
+	if (os_sem_init(&stream->send_sem, 0) != 0 ||
+	    pthread_create(&stream->mux_thread, NULL, mux_thread, stream) !=
+		    0) {
+		warn("Failed to create mux thread");
+		stop_workers(stream);
+		mpegts_mux_free(&stream->mux);
+		return false;
+	}
+
+	info("Uploading to '%s%s'%s", stream->url_prefix.array,
+	     stream->playlist_name.array,
+	     stream->low_latency ? " with partial segments" : "");
+
+	os_atomic_set_bool(&stream->active, true);
+	obs_output_begin_data_capture(stream->output, 0);
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* receiving packets                                                         */
+
+static inline bool find_first_video_packet(struct hls_stream *stream,
+					   struct encoder_packet *first)
+{
+	size_t count = stream->packets.size / sizeof(*first);
+
+	for (size_t i = 0; i < count; i++) {
+		struct encoder_packet *cur =
+			circlebuf_data(&stream->packets, i * sizeof(*first));
+		if (cur->type == OBS_ENCODER_VIDEO) {
+			*first = *cur;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool should_drop_video(struct hls_stream *stream,
+			      struct encoder_packet *packet)
+{
+	struct encoder_packet first;
+
+	if (stream->dropping_video) {
+		if (!packet->keyframe)
+			return true;
+		stream->dropping_video = false;
+	}
+
+	if (!stream->drop_threshold_usec ||
+	    !find_first_video_packet(stream, &first))
+		return false;
+
+	if (packet->dts_usec - first.dts_usec > stream->drop_threshold_usec) {
+		debug("Queue at %" PRId64 " ms, dropping video until the "
+		      "next keyframe",
+		      (packet->dts_usec - first.dts_usec) / 1000);
+		stream->dropping_video = !packet->keyframe;
+		return !packet->keyframe;
+	}
+
+	return false;
+}
+
+static void hls_stream_data(void *data, struct encoder_packet *packet)
+{
+	struct hls_stream *stream = data;
+	struct encoder_packet new_packet;
+	bool drop = false;
+
+	if (disconnected(stream) || !active(stream))
+		return;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		drop = should_drop_video(stream, packet);
+
+	if (!drop) {
+		obs_encoder_packet_ref(&new_packet, packet);
+		circlebuf_push_back(&stream->packets, &new_packet,
+				    sizeof(new_packet));
+	} else {
+		stream->dropped_frames++;
+	}
+
+	pthread_mutex_unlock(&stream->packets_mutex);
+
+	if (!drop)
+		os_sem_post(stream->send_sem);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void hls_stream_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_bool(defaults, OPT_LOW_LATENCY, true);
+	obs_data_set_default_int(defaults, OPT_PART_DURATION, 500);
+	obs_data_set_default_int(defaults, OPT_UPLOAD_THREADS, 3);
+	obs_data_set_default_int(defaults, OPT_RETRIES, 3);
+	obs_data_set_default_int(defaults, OPT_DROP_THRESHOLD, 4000);
+}
+
+static obs_properties_t *hls_stream_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
+
+	obs_properties_add_bool(props, OPT_LOW_LATENCY,
+				obs_module_text("HLSStream.LowLatency"));
+	p = obs_properties_add_int(props, OPT_PART_DURATION,
+				   obs_module_text("HLSStream.PartDuration"),
+				   100, 2000, 50);
+	obs_property_int_set_suffix(p, " ms");
+	obs_properties_add_int(props, OPT_UPLOAD_THREADS,
+			       obs_module_text("HLSStream.UploadThreads"), 1,
+			       MAX_UPLOAD_THREADS, 1);
+	obs_properties_add_int(props, OPT_RETRIES,
+			       obs_module_text("HLSStream.Retries"), 0, 10, 1);
+	p = obs_properties_add_int(props, OPT_DROP_THRESHOLD,
+				   obs_module_text("RTMPStream.DropThreshold"),
+				   0, 20000, 100);
+	obs_property_int_set_suffix(p, " ms");
+
+	return props;
+}
+
+static uint64_t hls_stream_total_bytes_sent(void *data)
+{
+	struct hls_stream *stream = data;
+	return (uint64_t)os_atomic_load_long_long(&stream->total_bytes_sent);
+}
+
+static int hls_stream_dropped_frames(void *data)
+{
+	struct hls_stream *stream = data;
+	return stream->dropped_frames;
+}
+
+struct obs_output_info hls_output_info = {
+	.id = "hls_output",
+	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED | OBS_OUTPUT_SERVICE,
+	.encoded_video_codecs = "h264",
+	.encoded_audio_codecs = "aac",
+	.get_name = hls_stream_getname,
+	.create = hls_stream_create,
+	.destroy = hls_stream_destroy,
+	.start = hls_stream_start,
+	.stop = hls_stream_stop,
+	.encoded_packet = hls_stream_data,
+	.get_defaults = hls_stream_defaults,
+	.get_properties = hls_stream_properties,
+	.get_total_bytes = hls_stream_total_bytes_sent,
+	.get_dropped_frames = hls_stream_dropped_frames,
+};
@@ -389,6 +389,8 @@ RTMP_TLS_Init(RTMP *r)
                           (const unsigned char *)pers,
                           strlen(pers));
 
+    mbedtls_ssl_session_init(&r->RTMP_TLS_ctx->ssn);
+
     RTMP_TLS_LoadCerts(r);
 #elif defined(USE_POLARSSL)
     /* Do this regardless of NO_SSL, we use havege for rtmpe too */
@@ -435,6 +437,9 @@ RTMP_TLS_Free(RTMP *r) {
         r->RTMP_TLS_ctx->cacert = NULL;
     }
 
+    mbedtls_ssl_session_free(&r->RTMP_TLS_ctx->ssn);
+    free(r->RTMP_TLS_ctx->out_buf);
+
     // NO mbedtls_net_free() BECAUSE WE SET IT UP BY HAND!
     free(r->RTMP_TLS_ctx);
     r->RTMP_TLS_ctx = NULL;
@@ -443,6 +448,114 @@ RTMP_TLS_Free(RTMP *r) {
 #endif
 }
 
+#if defined(CRYPTO) && !defined(NO_SSL) && defined(USE_MBEDTLS)
+/* encrypted output of one send is staged here and written in one go,
+ * instead of doing a socket write for every 16 KiB record */
+#define RTMP_TLS_OUT_SIZE (256 * 1024)
+
+static int
+TLS_FlushOut(tls_ctx *ctx)
+{
+    while (ctx->out_sent < ctx->out_len)
+    {
+        int ret = mbedtls_net_send(&ctx->net, ctx->out_buf + ctx->out_sent,
+                                   ctx->out_len - ctx->out_sent);
+        if (ret < 0)
+            return ret;
+        ctx->out_sent += ret;
+    }
+
+    ctx->out_len = 0;
+    ctx->out_sent = 0;
+    return 0;
+}
+
+static int
+TLS_BioSend(void *p, const unsigned char *buf, size_t len)
+{
+    tls_ctx *ctx = p;
+    int ret;
+
+    if (ctx->out_coalesce &&
+        len > (size_t)(RTMP_TLS_OUT_SIZE - ctx->out_len))
+    {
+        ret = TLS_FlushOut(ctx);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (ctx->out_coalesce &&
+        len <= (size_t)(RTMP_TLS_OUT_SIZE - ctx->out_len))
+    {
+        memcpy(ctx->out_buf + ctx->out_len, buf, len);
+        ctx->out_len += (int)len;
+        return (int)len;
+    }
+
+    // anything sent outside of RTMPSockBuf_Send must not overtake
+    // records that are still staged
+    ret = TLS_FlushOut(ctx);
+    if (ret < 0)
+        return ret;
+    return mbedtls_net_send(&ctx->net, buf, len);
+}
+
+static int
+TLS_BioRecv(void *p, unsigned char *buf, size_t len)
+{
+    tls_ctx *ctx = p;
+    return mbedtls_net_recv(&ctx->net, buf, len);
+}
+
+static int
+TLS_SendCoalesced(RTMPSockBuf *sb, const char *buf, int len)
+{
+    tls_ctx *ctx = sb->sb_tls_ctx;
+    int sent = 0;
+    int ret;
+
+    if (!ctx->out_buf)
+        ctx->out_buf = malloc(RTMP_TLS_OUT_SIZE);
+    if (!ctx->out_buf)
+        return TLS_write(sb->sb_ssl, buf, len);
+
+    // records that could not be written last time go first
+    ret = TLS_FlushOut(ctx);
+    if (ret < 0)
+        return ret;
+
+    ctx->out_coalesce = 1;
+    while (sent < len)
+    {
+        ret = TLS_write(sb->sb_ssl, buf + sent, len - sent);
+        if (ret <= 0)
+            break;
+        sent += ret;
+    }
+    ctx->out_coalesce = 0;
+
+    if (sent == 0)
+        return ret;
+
+    // on a non-blocking socket the rest stays staged for the next call
+    ret = TLS_FlushOut(ctx);
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+        return ret;
+    return sent;
+}
+
+static void
+TLS_SaveSession(tls_ctx *ctx, mbedtls_ssl_context *ssl, const char *host)
+{
+    mbedtls_ssl_session_free(&ctx->ssn);
+    mbedtls_ssl_session_init(&ctx->ssn);
+
+    ctx->have_ssn = mbedtls_ssl_get_session(ssl, &ctx->ssn) == 0;
+    if (ctx->have_ssn)
+        strcpy(ctx->ssn_host, host);
+}
+#endif
+
 RTMP *
 RTMP_Alloc()
 {
@@ -843,6 +956,22 @@ finish:
     return ret;
 }
 
+int
+RTMP_ResolveHost(AVal *host, int port, int addrlen_hint, RTMP_BINDINFO *addr)
+{
+    socklen_t addrlen = 0;
+    int socket_error = 0;
+
+    memset(addr, 0, sizeof(*addr));
+
+    if (!add_addr_info(&addr->addr, &addrlen, host, port,
+                       (socklen_t)addrlen_hint, &socket_error))
+        return FALSE;
+
+    addr->addrLen = (int)addrlen;
+    return TRUE;
+}
+
 #ifdef _WIN32
 #define E_TIMEDOUT     WSAETIMEDOUT
 #define E_CONNREFUSED  WSAECONNREFUSED
@@ -953,9 +1082,13 @@ RTMP_Connect1(RTMP *r, RTMPPacket *cp)
         TLS_client(r->RTMP_TLS_ctx, r->m_sb.sb_ssl);
 
 #if defined(USE_MBEDTLS)
-        mbedtls_net_context *server_fd = &r->RTMP_TLS_ctx->net;
-        server_fd->fd = r->m_sb.sb_socket;
-        TLS_setfd(r->m_sb.sb_ssl, server_fd);
+        tls_ctx *ctx = r->RTMP_TLS_ctx;
+        ctx->net.fd = r->m_sb.sb_socket;
+        ctx->out_len = 0;
+        ctx->out_sent = 0;
+        mbedtls_ssl_set_bio(r->m_sb.sb_ssl, ctx, TLS_BioSend, TLS_BioRecv,
+                            NULL);
+        r->m_sb.sb_tls_ctx = ctx;
 
         // make sure we verify the certificate hostname
         char hostname[MBEDTLS_SSL_MAX_HOST_NAME_LEN + 1];
@@ -968,6 +1101,10 @@ RTMP_Connect1(RTMP *r, RTMPPacket *cp)
 
         if (mbedtls_ssl_set_hostname(r->m_sb.sb_ssl, hostname))
             return FALSE;
+
+        // resuming skips the certificate exchange and a round trip
+        if (ctx->have_ssn && strcmp(ctx->ssn_host, hostname) == 0)
+            mbedtls_ssl_set_session(r->m_sb.sb_ssl, &ctx->ssn);
 #else
         TLS_setfd(r->m_sb.sb_ssl, r->m_sb.sb_socket);
 #endif
@@ -976,6 +1113,7 @@ RTMP_Connect1(RTMP *r, RTMPPacket *cp)
         if (connect_return < 0)
         {
 #if defined(USE_MBEDTLS)
+            ctx->have_ssn = 0;
             r->last_error_code = connect_return;
             if (connect_return == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED)
             {
@@ -1006,6 +1144,9 @@ RTMP_Connect1(RTMP *r, RTMPPacket *cp)
             RTMP_Close(r);
             return FALSE;
         }
+#if defined(USE_MBEDTLS)
+        TLS_SaveSession(ctx, r->m_sb.sb_ssl, hostname);
+#endif
 #else
         RTMP_Log(RTMP_LOGERROR, "%s, no SSL/TLS support", __FUNCTION__);
         RTMP_Close(r);
@@ -1084,6 +1225,12 @@ RTMP_Connect(RTMP *r, RTMPPacket *cp)
             return FALSE;
         }
     }
+    else if (r->m_connectAddr.addrLen)
+    {
+        /* Connect to an address resolved beforehand */
+        memcpy(&service, &r->m_connectAddr.addr, r->m_connectAddr.addrLen);
+        addrlen = (socklen_t)r->m_connectAddr.addrLen;
+    }
     else
     {
         /* Connect directly */
@@ -1555,7 +1702,7 @@ ReadN(RTMP *r, char *buffer, int n)
 }
 
 static int
-WriteN(RTMP *r, const char *buffer, int n)
+SendN(RTMP *r, const char *buffer, int n)
 {
     const char *ptr = buffer;
 #ifdef CRYPTO
@@ -1616,6 +1763,52 @@ WriteN(RTMP *r, const char *buffer, int n)
     return n == 0;
 }
 
+static int
+FlushBatch(RTMP *r)
+{
+    int len = r->m_batchLen;
+
+    r->m_batchLen = 0;
+    return len ? SendN(r, r->m_batchBuf, len) : TRUE;
+}
+
+/* a batch is sent once it grows this large, even if more data follows */
+#define RTMP_BATCH_FLUSH_SIZE (256 * 1024)
+
+static int
+WriteN(RTMP *r, const char *buffer, int n)
+{
+    if (!r->m_bBatchSend)
+        return SendN(r, buffer, n);
+
+    if (r->m_batchLen + n > r->m_batchSize)
+    {
+        int size = r->m_batchSize ? r->m_batchSize * 2 : 64 * 1024;
+        char *buf;
+
+        while (size < r->m_batchLen + n)
+            size *= 2;
+
+        buf = realloc(r->m_batchBuf, size);
+        if (!buf)
+        {
+            if (!FlushBatch(r))
+                return FALSE;
+            return SendN(r, buffer, n);
+        }
+
+        r->m_batchBuf = buf;
+        r->m_batchSize = size;
+    }
+
+    memcpy(r->m_batchBuf + r->m_batchLen, buffer, n);
+    r->m_batchLen += n;
+
+    if (r->m_batchLen >= RTMP_BATCH_FLUSH_SIZE)
+        return FlushBatch(r);
+    return TRUE;
+}
+
 #define SAVC(x)	static const AVal av_##x = AVC(#x)
 
 SAVC(app);
@@ -4378,10 +4571,16 @@ RTMP_Close(RTMP *r)
     }
 
     memset (&r->m_bindIP, 0, sizeof(r->m_bindIP));
+    memset (&r->m_connectAddr, 0, sizeof(r->m_connectAddr));
     r->m_bCustomSend = 0;
     r->m_customSendFunc = NULL;
     r->m_customSendParam = NULL;
 
+    free(r->m_batchBuf);
+    r->m_batchBuf = NULL;
+    r->m_batchLen = 0;
+    r->m_batchSize = 0;
+
 #if defined(CRYPTO) || defined(USE_ONLY_MD5)
     if (!(r->Link.protocol & RTMP_FEATURE_WRITE) || (r->Link.pFlags & RTMP_PUB_CLEAN))
     {
@@ -4499,6 +4698,11 @@ RTMPSockBuf_Send(RTMPSockBuf *sb, const char *buf, int len)
 #if defined(CRYPTO) && !defined(NO_SSL)
     if (sb->sb_ssl)
     {
+#if defined(USE_MBEDTLS)
+        if (sb->sb_tls_ctx)
+            rc = TLS_SendCoalesced(sb, buf, len);
+        else
+#endif
         rc = TLS_write(sb->sb_ssl, buf, len);
     }
     else
@@ -4519,6 +4723,15 @@ RTMPSockBuf_Close(RTMPSockBuf *sb)
         TLS_close(sb->sb_ssl);
         sb->sb_ssl = NULL;
     }
+#if defined(USE_MBEDTLS)
+    if (sb->sb_tls_ctx)
+    {
+        tls_ctx *ctx = sb->sb_tls_ctx;
+        ctx->out_len = 0;
+        ctx->out_sent = 0;
+        sb->sb_tls_ctx = NULL;
+    }
+#endif
 #endif
     if (sb->sb_socket != INVALID_SOCKET)
         return closesocket(sb->sb_socket);
@@ -5290,8 +5503,8 @@ fail:
     return total;
 }
 
-int
-RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
+static int
+WriteTags(RTMP *r, const char *buf, int size, int streamIdx)
 {
     RTMPPacket *pkt = &r->m_write;
     char *enc;
@@ -5369,3 +5582,20 @@ RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
     }
     return size+s2;
 }
+
+/* every chunk of every tag in buf would otherwise be a separate send, so
+ * collect them and hand them to the socket (or the custom send function)
+ * in as few writes as possible; HTTP tunnels already post whole packets */
+int
+RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
+{
+    int ret;
+
+    r->m_bBatchSend = !(r->Link.protocol & RTMP_FEATURE_HTTP);
+    ret = WriteTags(r, buf, size, streamIdx);
+    r->m_bBatchSend = 0;
+
+    if (!FlushBatch(r) && ret > 0)
+        ret = -1;
+    return ret;
+}
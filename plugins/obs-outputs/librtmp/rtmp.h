@@ -85,6 +85,16 @@ typedef struct tls_ctx
     mbedtls_ssl_session ssn;
     mbedtls_x509_crt *cacert;
     mbedtls_net_context net;
+
+    /* records encrypted by one RTMPSockBuf_Send call, written together */
+    unsigned char *out_buf;
+    int out_len;
+    int out_sent;
+    int out_coalesce;
+
+    /* session of the last handshake, offered again on reconnect */
+    int have_ssn;
+    char ssn_host[MBEDTLS_SSL_MAX_HOST_NAME_LEN + 1];
 } tls_ctx;
 
 typedef tls_ctx *TLS_CTX;
@@ -271,6 +281,7 @@ extern "C"
         char sb_buf[RTMP_BUFFER_CACHE_SIZE];	/* data read from socket */
         int sb_timedout;
         void *sb_ssl;
+        void *sb_tls_ctx;	/* TLS_CTX staging sb_ssl records */
     } RTMPSockBuf;
 
     void RTMPPacket_Reset(RTMPPacket *p);
@@ -419,8 +430,17 @@ extern "C"
         void*   m_customSendParam;
         CUSTOMSEND m_customSendFunc;
 
+        /* while set, chunks are collected in m_batchBuf and sent together */
+        uint8_t m_bBatchSend;
+        char   *m_batchBuf;
+        int     m_batchLen;
+        int     m_batchSize;
+
         RTMP_BINDINFO m_bindIP;
 
+        /* when set, connected to instead of resolving Link.hostname */
+        RTMP_BINDINFO m_connectAddr;
+
         uint8_t m_bSendChunkSizeInfo;
 
         int m_numInvokes;
@@ -486,6 +506,8 @@ extern "C"
                           int dStop, int bLiveStream, long int timeout);
 
     int RTMP_Connect(RTMP *r, RTMPPacket *cp);
+    int RTMP_ResolveHost(AVal *host, int port, int addrlen_hint,
+                         RTMP_BINDINFO *addr);
     struct sockaddr;
     int RTMP_Connect0(RTMP *r, struct sockaddr *svc, socklen_t addrlen);
     int RTMP_Connect1(RTMP *r, RTMPPacket *cp);
@@ -0,0 +1,384 @@
+#include "mpegts-mux.h"
+
+#include <obs-avc.h>
+#include <string.h>
+
+#define PID_PAT 0x0000
+#define PID_PMT 0x1000
+#define PID_VIDEO 0x0100
+#define PID_AUDIO 0x0101
+
+#define STREAM_TYPE_H264 0x1B
+#define STREAM_TYPE_AAC 0x0F
+
+#define STREAM_ID_VIDEO 0xE0
+#define STREAM_ID_AUDIO 0xC0
+
+#define AF_RANDOM_ACCESS 0x40
+#define AF_PCR 0x10
+
+#define TS_PAYLOAD_SIZE (MPEGTS_PACKET_SIZE - 4)
+
+/* all timestamps are in the 90 kHz clock.  PCR starts at PCR_BASE and the
+ * presentation timestamps are this far ahead of it, which is the decoder
+ * buffering time the receiver gets */
+#define CLOCK_RATE 90000
+#define PCR_BASE CLOCK_RATE
+#define MUX_DELAY (CLOCK_RATE * 7 / 10)
+#define PSI_INTERVAL (CLOCK_RATE / 10)
+#define PCR_INTERVAL (CLOCK_RATE / 50)
+#define TS_MASK 0x1FFFFFFFFULL
+
+static const uint8_t aud_nal[] = {0x00, 0x00, 0x00, 0x01, 0x09, 0xF0};
+
+static inline uint8_t *push_bytes(struct darray *da, size_t size)
+{
+	size_t pos = da->num;
+
+	darray_resize(sizeof(uint8_t), da, pos + size);
+	return (uint8_t *)da->array + pos;
+}
+
+static uint32_t crc32_mpeg(const uint8_t *data, size_t size)
+{
+	uint32_t crc = 0xFFFFFFFF;
+
+	for (size_t i = 0; i < size; i++) {
+		crc ^= (uint32_t)data[i] << 24;
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7
+						 : crc << 1;
+	}
+
+	return crc;
+}
+
+void mpegts_mux_init(struct mpegts_mux *mux, obs_encoder_t *vencoder,
+		     obs_encoder_t *aencoder)
+{
+	uint8_t *extra_data = NULL;
+	size_t extra_size = 0;
+
+	memset(mux, 0, sizeof(*mux));
+
+	if (obs_encoder_get_extra_data(vencoder, &extra_data, &extra_size) &&
+	    extra_size) {
+		mux->video_header = bmemdup(extra_data, extra_size);
+		mux->video_header_size = extra_size;
+	}
+
+	if (!aencoder)
+		return;
+
+	/* the ADTS header is built from the AudioSpecificConfig */
+	mux->has_audio = true;
+	mux->aac_profile = 2;
+	mux->aac_freq_index = 3;
+	mux->aac_channels = 2;
+
+	if (obs_encoder_get_extra_data(aencoder, &extra_data, &extra_size) &&
+	    extra_size >= 2) {
+		mux->aac_profile = extra_data[0] >> 3;
+		mux->aac_freq_index =
+			((extra_data[0] & 0x07) << 1) | (extra_data[1] >> 7);
+		mux->aac_channels = (extra_data[1] >> 3) & 0x0F;
+	}
+}
+
+void mpegts_mux_free(struct mpegts_mux *mux)
+{
+	da_free(mux->out);
+	da_free(mux->pes);
+	bfree(mux->video_header);
+	memset(mux, 0, sizeof(*mux));
+}
+
+static inline int64_t to_clock(const struct encoder_packet *packet,
+			       int64_t ts)
+{
+	return ts * CLOCK_RATE * packet->timebase_num / packet->timebase_den;
+}
+
+/* ------------------------------------------------------------------------- */
+/* transport packets                                                         */
+
+static void write_pcr(uint8_t *p, int64_t pcr)
+{
+	uint64_t base = (uint64_t)pcr & TS_MASK;
+
+	p[0] = (uint8_t)(base >> 25);
+	p[1] = (uint8_t)(base >> 17);
+	p[2] = (uint8_t)(base >> 9);
+	p[3] = (uint8_t)(base >> 1);
+	p[4] = (uint8_t)(((base & 1) << 7) | 0x7E);
+	p[5] = 0;
+}
+
+/* writes one TS packet with as much of *data as fits, padding the
+ * adaptation field when the payload does not fill the packet */
+static void write_ts_packet(struct mpegts_mux *mux, uint16_t pid, uint8_t *cc,
+			    bool start, uint8_t af_flags, int64_t pcr,
+			    const uint8_t **data, size_t *size)
+{
+	uint8_t *pkt;
+	uint8_t *p;
+	size_t af_size = 0;
+	size_t payload;
+
+	if (af_flags)
+		af_size = 2 + ((af_flags & AF_PCR) ? 6 : 0);
+
+	payload = *size;
+	if (payload > TS_PAYLOAD_SIZE - af_size)
+		payload = TS_PAYLOAD_SIZE - af_size;
+	af_size = TS_PAYLOAD_SIZE - payload;
+
+	pkt = push_bytes(&mux->out.da, MPEGTS_PACKET_SIZE);
+	pkt[0] = 0x47;
+	pkt[1] = (uint8_t)((start ? 0x40 : 0) | ((pid >> 8) & 0x1F));
+	pkt[2] = (uint8_t)(pid & 0xFF);
+	pkt[3] = (uint8_t)((af_size ? 0x30 : 0x10) | (*cc & 0x0F));
+	*cc = (*cc + 1) & 0x0F;
+
+	p = pkt + 4;
+	if (af_size) {
+		uint8_t *af_end = p + af_size;
+
+		*p++ = (uint8_t)(af_size - 1);
+		if (af_size > 1) {
+			*p++ = af_flags;
+			if (af_flags & AF_PCR) {
+				write_pcr(p, pcr);
+				p += 6;
+			}
+			memset(p, 0xFF, af_end - p);
+			p = af_end;
+		}
+	}
+
+	memcpy(p, *data, payload);
+	*data += payload;
+	*size -= payload;
+}
+
+static void write_section(struct mpegts_mux *mux, uint16_t pid, uint8_t *cc,
+			  uint8_t *section, size_t size)
+{
+	uint8_t buf[TS_PAYLOAD_SIZE];
+	const uint8_t *data = buf;
+	uint32_t crc = crc32_mpeg(section, size);
+
+	/* pointer field, section, CRC, then stuffing with 0xFF */
+	memset(buf, 0xFF, sizeof(buf));
+	buf[0] = 0;
+	memcpy(buf + 1, section, size);
+	buf[1 + size] = (uint8_t)(crc >> 24);
+	buf[2 + size] = (uint8_t)(crc >> 16);
+	buf[3 + size] = (uint8_t)(crc >> 8);
+	buf[4 + size] = (uint8_t)crc;
+
+	size = sizeof(buf);
+	write_ts_packet(mux, pid, cc, true, 0, 0, &data, &size);
+}
+
+static void write_psi(struct mpegts_mux *mux)
+{
+	uint8_t pat[] = {
+		0x00,                       /* table id */
+		0xB0, 13,                   /* section length */
+		0x00, 0x01,                 /* transport stream id */
+		0xC1, 0x00, 0x00,           /* version, section numbers */
+		0x00, 0x01,                 /* program number */
+		0xE0 | (PID_PMT >> 8), PID_PMT & 0xFF,
+	};
+	uint8_t pmt[32];
+	size_t size = 0;
+
+	write_section(mux, PID_PAT, &mux->cc_pat, pat, sizeof(pat));
+
+	pmt[size++] = 0x02;
+	pmt[size++] = 0xB0;
+	pmt[size++] = (uint8_t)(9 + 5 + (mux->has_audio ? 5 : 0) + 4);
+	pmt[size++] = 0x00;
+	pmt[size++] = 0x01;
+	pmt[size++] = 0xC1;
+	pmt[size++] = 0x00;
+	pmt[size++] = 0x00;
+	pmt[size++] = 0xE0 | (PID_VIDEO >> 8);
+	pmt[size++] = PID_VIDEO & 0xFF;
+	pmt[size++] = 0xF0;
+	pmt[size++] = 0x00;
+
+	pmt[size++] = STREAM_TYPE_H264;
+	pmt[size++] = 0xE0 | (PID_VIDEO >> 8);
+	pmt[size++] = PID_VIDEO & 0xFF;
+	pmt[size++] = 0xF0;
+	pmt[size++] = 0x00;
+
+	if (mux->has_audio) {
+		pmt[size++] = STREAM_TYPE_AAC;
+		pmt[size++] = 0xE0 | (PID_AUDIO >> 8);
+		pmt[size++] = PID_AUDIO & 0xFF;
+		pmt[size++] = 0xF0;
+		pmt[size++] = 0x00;
+	}
+
+	write_section(mux, PID_PMT, &mux->cc_pmt, pmt, size);
+}
+
+/* ------------------------------------------------------------------------- */
+/* elementary streams                                                        */
+
+static void push_timestamp(struct mpegts_mux *mux, uint8_t prefix, int64_t ts)
+{
+	uint64_t v = (uint64_t)ts & TS_MASK;
+	uint8_t *p = push_bytes(&mux->pes.da, 5);
+
+	p[0] = (uint8_t)((prefix << 4) | (((v >> 30) & 0x07) << 1) | 1);
+	p[1] = (uint8_t)(v >> 22);
+	p[2] = (uint8_t)((((v >> 15) & 0x7F) << 1) | 1);
+	p[3] = (uint8_t)(v >> 7);
+	p[4] = (uint8_t)(((v & 0x7F) << 1) | 1);
+}
+
+static void begin_pes(struct mpegts_mux *mux, uint8_t stream_id, int64_t pts,
+		      int64_t dts)
+{
+	bool has_dts = pts != dts;
+	uint8_t *p;
+
+	da_resize(mux->pes, 0);
+	p = push_bytes(&mux->pes.da, 9);
+	p[0] = 0x00;
+	p[1] = 0x00;
+	p[2] = 0x01;
+	p[3] = stream_id;
+	/* p[4] and p[5] are the packet length, filled in by end_pes */
+	p[6] = 0x80;
+	p[7] = has_dts ? 0xC0 : 0x80;
+	p[8] = has_dts ? 10 : 5;
+
+	push_timestamp(mux, has_dts ? 0x3 : 0x2, pts);
+	if (has_dts)
+		push_timestamp(mux, 0x1, dts);
+}
+
+static void end_pes(struct mpegts_mux *mux, uint16_t pid, uint8_t *cc,
+		    bool keyframe, bool pcr, int64_t pcr_ts)
+{
+	size_t length = mux->pes.num - 6;
+	const uint8_t *data = mux->pes.array;
+	size_t size = mux->pes.num;
+	uint8_t af_flags = 0;
+
+	/* video may leave the length unbounded */
+	if (length > 0xFFFF)
+		length = 0;
+	mux->pes.array[4] = (uint8_t)(length >> 8);
+	mux->pes.array[5] = (uint8_t)length;
+
+	if (keyframe)
+		af_flags |= AF_RANDOM_ACCESS;
+	if (pcr)
+		af_flags |= AF_PCR;
+
+	write_ts_packet(mux, pid, cc, true, af_flags, pcr_ts, &data, &size);
+	while (size)
+		write_ts_packet(mux, pid, cc, false, 0, 0, &data, &size);
+}
+
+static bool has_parameter_sets(const uint8_t *data, size_t size)
+{
+	const uint8_t *end = data + size;
+	const uint8_t *nal = obs_avc_find_startcode(data, end);
+
+	while (nal < end) {
+		while (nal < end && !*(nal++))
+			;
+		if (nal == end)
+			break;
+
+		if ((*nal & 0x1F) == OBS_NAL_SPS)
+			return true;
+
+		nal = obs_avc_find_startcode(nal, end);
+	}
+
+	return false;
+}
+
+static void mux_video(struct mpegts_mux *mux,
+		      const struct encoder_packet *packet, int64_t pts,
+		      int64_t dts)
+{
+	bool pcr = dts - mux->last_pcr_dts >= PCR_INTERVAL ||
+		   mux->last_pcr_dts == 0;
+
+	begin_pes(mux, STREAM_ID_VIDEO, pts + MUX_DELAY, dts + MUX_DELAY);
+	da_push_back_array(mux->pes, aud_nal, sizeof(aud_nal));
+
+	/* decoders joining mid-stream need the parameter sets in-band */
+	if (packet->keyframe && mux->video_header &&
+	    !has_parameter_sets(packet->data, packet->size))
+		da_push_back_array(mux->pes, mux->video_header,
+				   mux->video_header_size);
+
+	da_push_back_array(mux->pes, packet->data, packet->size);
+
+	if (pcr)
+		mux->last_pcr_dts = dts;
+	end_pes(mux, PID_VIDEO, &mux->cc_video, packet->keyframe, pcr, dts);
+}
+
+static void mux_audio(struct mpegts_mux *mux,
+		      const struct encoder_packet *packet, int64_t pts)
+{
+	size_t frame_size = packet->size + 7;
+	uint8_t *adts;
+
+	begin_pes(mux, STREAM_ID_AUDIO, pts + MUX_DELAY, pts + MUX_DELAY);
+
+	adts = push_bytes(&mux->pes.da, 7);
+	adts[0] = 0xFF;
+	adts[1] = 0xF1;
+	adts[2] = (uint8_t)(((mux->aac_profile - 1) << 6) |
+			    (mux->aac_freq_index << 2) |
+			    (mux->aac_channels >> 2));
+	adts[3] = (uint8_t)(((mux->aac_channels & 3) << 6) |
+			    (frame_size >> 11));
+	adts[4] = (uint8_t)(frame_size >> 3);
+	adts[5] = (uint8_t)(((frame_size & 7) << 5) | 0x1F);
+	adts[6] = 0xFC;
+
+	da_push_back_array(mux->pes, packet->data, packet->size);
+	end_pes(mux, PID_AUDIO, &mux->cc_audio, false, false, 0);
+}
+
+void mpegts_mux_packet(struct mpegts_mux *mux,
+		       const struct encoder_packet *packet)
+{
+	int64_t pts, dts;
+
+	if (packet->type == OBS_ENCODER_AUDIO && !mux->has_audio)
+		return;
+
+	if (!mux->got_first_dts) {
+		mux->dts_offset = to_clock(packet, packet->dts) - PCR_BASE;
+		mux->got_first_dts = true;
+		mux->last_psi_dts = -PSI_INTERVAL;
+	}
+
+	pts = to_clock(packet, packet->pts) - mux->dts_offset;
+	dts = to_clock(packet, packet->dts) - mux->dts_offset;
+
+	if (dts - mux->last_psi_dts >= PSI_INTERVAL ||
+	    (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)) {
+		write_psi(mux);
+		mux->last_psi_dts = dts;
+	}
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		mux_video(mux, packet, pts, dts);
+	else
+		mux_audio(mux, packet, pts);
+}
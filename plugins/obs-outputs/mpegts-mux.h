@@ -0,0 +1,51 @@
+#pragma once
+
+#include <obs.h>
+#include <util/darray.h>
+
+/*
+ * Minimal MPEG transport stream muxer for one H.264 video track and one AAC
+ * audio track.  Packets are muxed straight into `out` as 188 byte TS packets,
+ * ready to be cut into datagrams by the caller.
+ */
+
+#define MPEGTS_PACKET_SIZE 188
+
+/* 7 TS packets per datagram is what SRT and RIST expect */
+#define MPEGTS_DATAGRAM_SIZE (MPEGTS_PACKET_SIZE * 7)
+
+struct mpegts_mux {
+	DARRAY(uint8_t) out;
+	DARRAY(uint8_t) pes;
+
+	uint8_t *video_header;
+	size_t video_header_size;
+
+	bool has_audio;
+	uint8_t aac_profile;
+	uint8_t aac_freq_index;
+	uint8_t aac_channels;
+
+	uint8_t cc_pat;
+	uint8_t cc_pmt;
+	uint8_t cc_video;
+	uint8_t cc_audio;
+
+	bool got_first_dts;
+	int64_t dts_offset;
+	int64_t last_psi_dts;
+	int64_t last_pcr_dts;
+};
+
+extern void mpegts_mux_init(struct mpegts_mux *mux, obs_encoder_t *vencoder,
+			    obs_encoder_t *aencoder);
+extern void mpegts_mux_free(struct mpegts_mux *mux);
+
+/* appends the TS packets for `packet` to mux->out */
+extern void mpegts_mux_packet(struct mpegts_mux *mux,
+			      const struct encoder_packet *packet);
+
+static inline void mpegts_mux_consume(struct mpegts_mux *mux, size_t size)
+{
+	da_erase_range(mux->out, 0, size);
+}
@@ -0,0 +1,1054 @@
+#include <obs-module.h>
+#include <obs-avc.h>
+#include <util/circlebuf.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/dstr.h>
+#include <inttypes.h>
+
+#include "obs-outputs-config.h"
+#include "mpegts-mux.h"
+
+#if COMPILE_SRT
+#include <srt/srt.h>
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#endif
+#endif
+
+#if COMPILE_RIST
+#include <librist/librist.h>
+#endif
+
+/*
+ * MPEG-TS over SRT or RIST, muxed in-process so the datagrams can be paced
+ * to the stream bitrate and the transport's retransmit/loss counters can be
+ * reported back.  srt:// and rist:// URLs pick the protocol.
+ */
+
+#define do_log(level, format, ...)                   \
+	blog(level, "[mpegts stream: '%s'] " format, \
+	     obs_output_get_name(stream->output), ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+#define debug(format, ...) do_log(LOG_DEBUG, format, ##__VA_ARGS__)
+
+#define OPT_LATENCY "latency_ms"
+#define OPT_FEC "fec"
+#define OPT_PACING "pacing"
+#define OPT_DROP_THRESHOLD "drop_threshold_ms"
+
+/* datagrams go out at this multiple of the encoder bitrate, which spreads
+ * keyframes out without letting the queue build up behind them */
+#define PACING_HEADROOM 1.5
+#define PACING_MAX_BURST_NS 5000000ULL
+#define STATS_INTERVAL_NS 1000000000ULL
+
+enum mpegts_protocol {
+	MPEGTS_PROTOCOL_SRT,
+	MPEGTS_PROTOCOL_RIST,
+};
+
+struct transport_stats {
+	double rtt_ms;
+	int latency_ms;
+	uint64_t packets_sent;
+	uint64_t packets_retransmitted;
+	uint64_t packets_lost;
+};
+
+struct mpegts_stream {
+	obs_output_t *output;
+
+	pthread_mutex_t packets_mutex;
+	struct circlebuf packets;
+	bool dropping_video;
+
+	volatile bool connecting;
+	pthread_t connect_thread;
+
+	volatile bool active;
+	volatile bool disconnected;
+	pthread_t send_thread;
+
+	os_sem_t *send_sem;
+	os_event_t *stop_event;
+	uint64_t stop_ts;
+
+	struct dstr url;
+	struct dstr key;
+	enum mpegts_protocol protocol;
+	int latency_ms;
+	struct dstr fec;
+	bool pacing;
+	int64_t drop_threshold_usec;
+
+	struct mpegts_mux mux;
+
+	uint64_t pace_bps;
+	uint64_t pace_ts;
+
+	uint64_t total_bytes_sent;
+	int dropped_frames;
+	int connect_time_ms;
+
+	pthread_mutex_t stats_mutex;
+	struct transport_stats stats;
+	struct transport_stats last_stats;
+	float congestion;
+	uint64_t last_stats_ts;
+
+#if COMPILE_SRT
+	SRTSOCKET srt;
+#endif
+#if COMPILE_RIST
+	struct rist_ctx *rist;
+#endif
+};
+
+/* congestion is the share of packets retransmitted since the last update,
+ * called with stats_mutex held */
+static void update_congestion(struct mpegts_stream *stream)
+{
+	struct transport_stats *cur = &stream->stats;
+	struct transport_stats *last = &stream->last_stats;
+	uint64_t sent = cur->packets_sent - last->packets_sent;
+	uint64_t retransmitted =
+		cur->packets_retransmitted - last->packets_retransmitted;
+
+	if (cur->packets_sent < last->packets_sent)
+		sent = 0;
+
+	if (sent) {
+		float congestion = (float)retransmitted / (float)sent;
+		stream->congestion = congestion > 1.0f ? 1.0f : congestion;
+	}
+
+	*last = *cur;
+}
+
+static inline bool stopping(struct mpegts_stream *stream)
+{
+	return os_event_try(stream->stop_event) != EAGAIN;
+}
+
+static inline bool connecting(struct mpegts_stream *stream)
+{
+	return os_atomic_load_bool(&stream->connecting);
+}
+
+static inline bool active(struct mpegts_stream *stream)
+{
+	return os_atomic_load_bool(&stream->active);
+}
+
+static inline bool disconnected(struct mpegts_stream *stream)
+{
+	return os_atomic_load_bool(&stream->disconnected);
+}
+
+static void free_packets(struct mpegts_stream *stream)
+{
+	pthread_mutex_lock(&stream->packets_mutex);
+	while (stream->packets.size) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
+		obs_encoder_packet_release(&packet);
+	}
+	stream->dropping_video = false;
+	pthread_mutex_unlock(&stream->packets_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* SRT                                                                       */
+
+#if COMPILE_SRT
+static void get_url_option(const char *url, const char *name, struct dstr *val)
+{
+	const char *query = strchr(url, '?');
+	size_t name_len = strlen(name);
+
+	while (query) {
+		query++;
+		if (strncmp(query, name, name_len) == 0 &&
+		    query[name_len] == '=') {
+			const char *start = query + name_len + 1;
+			const char *end = strchr(start, '&');
+
+			if (end)
+				dstr_ncopy(val, start, end - start);
+			else
+				dstr_copy(val, start);
+			return;
+		}
+
+		query = strchr(query, '&');
+	}
+}
+
+static bool parse_srt_url(const char *url, struct dstr *host, int *port)
+{
+	const char *start = url + strlen("srt://");
+	const char *end = start + strcspn(start, "/?");
+	const char *colon;
+
+	/* [v6 address]:port or host:port */
+	if (*start == '[') {
+		const char *close = strchr(start, ']');
+		if (!close || close > end || close[1] != ':')
+			return false;
+		dstr_ncopy(host, start + 1, close - start - 1);
+		colon = close + 1;
+	} else {
+		colon = strchr(start, ':');
+		if (!colon || colon > end)
+			return false;
+		dstr_ncopy(host, start, colon - start);
+	}
+
+	*port = atoi(colon + 1);
+	return !dstr_is_empty(host) && *port > 0 && *port < 65536;
+}
+
+static inline void set_srt_flag(struct mpegts_stream *stream, SRT_SOCKOPT opt,
+				const void *val, int size, const char *name)
+{
+	if (srt_setsockflag(stream->srt, opt, val, size) == SRT_ERROR)
+		warn("Failed to set %s: %s", name, srt_getlasterror_str());
+}
+
+static int srt_connect_stream(struct mpegts_stream *stream)
+{
+	struct addrinfo hints = {0};
+	struct addrinfo *addr = NULL;
+	struct dstr host = {0};
+	struct dstr opt = {0};
+	char port_str[8];
+	int port = 0;
+	int ret = OBS_OUTPUT_CONNECT_FAILED;
+
+	if (!parse_srt_url(stream->url.array, &host, &port)) {
+		warn("Invalid SRT URL");
+		dstr_free(&host);
+		return OBS_OUTPUT_BAD_PATH;
+	}
+
+	snprintf(port_str, sizeof(port_str), "%d", port);
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+
+	if (getaddrinfo(host.array, port_str, &hints, &addr) != 0) {
+		warn("Could not resolve '%s'", host.array);
+		dstr_free(&host);
+		return OBS_OUTPUT_BAD_PATH;
+	}
+
+	stream->srt = srt_create_socket();
+	if (stream->srt == SRT_INVALID_SOCK)
+		goto fail;
+
+	int live = SRTT_LIVE;
+	int yes = 1;
+	int latency = stream->latency_ms;
+
+	/* URL options take precedence over the output settings */
+	get_url_option(stream->url.array, "latency", &opt);
+	if (!dstr_is_empty(&opt))
+		latency = atoi(opt.array);
+
+	set_srt_flag(stream, SRTO_TRANSTYPE, &live, sizeof(live), "transtype");
+	set_srt_flag(stream, SRTO_SENDER, &yes, sizeof(yes), "sender");
+	set_srt_flag(stream, SRTO_LATENCY, &latency, sizeof(latency),
+		     "latency");
+
+	dstr_free(&opt);
+	get_url_option(stream->url.array, "streamid", &opt);
+	if (dstr_is_empty(&opt))
+		dstr_copy_dstr(&opt, &stream->key);
+	if (!dstr_is_empty(&opt))
+		set_srt_flag(stream, SRTO_STREAMID, opt.array, (int)opt.len,
+			     "streamid");
+
+	dstr_free(&opt);
+	get_url_option(stream->url.array, "passphrase", &opt);
+	if (!dstr_is_empty(&opt))
+		set_srt_flag(stream, SRTO_PASSPHRASE, opt.array, (int)opt.len,
+			     "passphrase");
+
+	/* forward error correction through SRT's packet filter, e.g.
+	 * "fec,cols:10,rows:5" */
+	if (!dstr_is_empty(&stream->fec))
+		set_srt_flag(stream, SRTO_PACKETFILTER, stream->fec.array,
+			     (int)stream->fec.len, "packetfilter");
+
+	/* let SRT's own shaper leave room for retransmits on top of the rate
+	 * we already pace to */
+	if (stream->pace_bps) {
+		int64_t input_bw = (int64_t)(stream->pace_bps / 8);
+		int overhead = 25;
+
+		set_srt_flag(stream, SRTO_INPUTBW, &input_bw, sizeof(input_bw),
+			     "inputbw");
+		set_srt_flag(stream, SRTO_OHEADBW, &overhead, sizeof(overhead),
+			     "oheadbw");
+	}
+
+	info("Connecting to SRT URL %s:%d...", host.array, port);
+
+	if (srt_connect(stream->srt, addr->ai_addr, (int)addr->ai_addrlen) ==
+	    SRT_ERROR) {
+		warn("Connection failed: %s", srt_getlasterror_str());
+		goto fail;
+	}
+
+	ret = OBS_OUTPUT_SUCCESS;
+
+fail:
+	if (ret != OBS_OUTPUT_SUCCESS && stream->srt != SRT_INVALID_SOCK) {
+		srt_close(stream->srt);
+		stream->srt = SRT_INVALID_SOCK;
+	}
+
+	freeaddrinfo(addr);
+	dstr_free(&host);
+	dstr_free(&opt);
+	return ret;
+}
+
+static bool srt_send(struct mpegts_stream *stream, const uint8_t *data,
+		     size_t size)
+{
+	if (srt_sendmsg2(stream->srt, (const char *)data, (int)size, NULL) ==
+	    SRT_ERROR) {
+		warn("Send failed: %s", srt_getlasterror_str());
+		return false;
+	}
+
+	return true;
+}
+
+static void srt_update_stats(struct mpegts_stream *stream)
+{
+	SRT_TRACEBSTATS perf;
+
+	if (srt_bstats(stream->srt, &perf, 0) == SRT_ERROR)
+		return;
+
+	pthread_mutex_lock(&stream->stats_mutex);
+	stream->stats.rtt_ms = perf.msRTT;
+	stream->stats.latency_ms = perf.msSndTsbPdDelay;
+	stream->stats.packets_sent = (uint64_t)perf.pktSentTotal;
+	stream->stats.packets_retransmitted = (uint64_t)perf.pktRetransTotal;
+	stream->stats.packets_lost = (uint64_t)perf.pktSndLossTotal;
+	update_congestion(stream);
+	pthread_mutex_unlock(&stream->stats_mutex);
+}
+
+static void srt_close_stream(struct mpegts_stream *stream)
+{
+	if (stream->srt != SRT_INVALID_SOCK) {
+		srt_close(stream->srt);
+		stream->srt = SRT_INVALID_SOCK;
+	}
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* RIST                                                                      */
+
+#if COMPILE_RIST
+static int rist_stats_cb(void *param, const struct rist_stats *stats)
+{
+	struct mpegts_stream *stream = param;
+
+	if (stats->stats_type == RIST_STATS_SENDER_PEER) {
+		const struct rist_stats_sender_peer *peer =
+			&stats->stats.sender_peer;
+
+		pthread_mutex_lock(&stream->stats_mutex);
+		stream->stats.rtt_ms = (double)peer->rtt;
+		stream->stats.packets_sent = peer->sent;
+		stream->stats.packets_retransmitted = peer->retransmitted;
+		stream->stats.packets_lost =
+			(uint64_t)((double)peer->sent *
+				   (100.0 - peer->quality) / 100.0);
+		update_congestion(stream);
+		pthread_mutex_unlock(&stream->stats_mutex);
+	}
+
+	rist_stats_free(stats);
+	return 0;
+}
+
+static int rist_connect_stream(struct mpegts_stream *stream)
+{
+	struct rist_peer_config *config = NULL;
+	struct rist_peer *peer;
+
+	if (rist_sender_create(&stream->rist, RIST_PROFILE_MAIN, 0, NULL) !=
+	    0) {
+		warn("Failed to create RIST sender");
+		return OBS_OUTPUT_ERROR;
+	}
+
+	if (rist_parse_address2(stream->url.array, &config) != 0) {
+		warn("Invalid RIST URL");
+		rist_destroy(stream->rist);
+		stream->rist = NULL;
+		return OBS_OUTPUT_BAD_PATH;
+	}
+
+	/* the receive buffer is the latency RIST can recover losses in */
+	if (!strstr(stream->url.array, "buffer=")) {
+		config->recovery_length_min = (uint32_t)stream->latency_ms;
+		config->recovery_length_max = (uint32_t)stream->latency_ms;
+	}
+
+	if (!dstr_is_empty(&stream->key) && !config->secret[0]) {
+		strncpy(config->secret, stream->key.array,
+			sizeof(config->secret) - 1);
+		config->key_size = 128;
+	}
+
+	stream->stats.latency_ms = (int)config->recovery_length_max;
+
+	info("Connecting to RIST URL %s...", config->address);
+
+	if (rist_peer_create(stream->rist, &peer, config) != 0 ||
+	    rist_stats_callback_set(stream->rist, 1000, rist_stats_cb,
+				    stream) != 0 ||
+	    rist_start(stream->rist) != 0) {
+		warn("Failed to start RIST sender");
+		rist_peer_config_free2(&config);
+		rist_destroy(stream->rist);
+		stream->rist = NULL;
+		return OBS_OUTPUT_CONNECT_FAILED;
+	}
+
+	rist_peer_config_free2(&config);
+	return OBS_OUTPUT_SUCCESS;
+}
+
+static bool rist_send(struct mpegts_stream *stream, const uint8_t *data,
+		      size_t size)
+{
+	struct rist_data_block block = {0};
+
+	block.payload = data;
+	block.payload_len = size;
+
+	if (rist_sender_data_write(stream->rist, &block) < 0) {
+		warn("Send failed");
+		return false;
+	}
+
+	return true;
+}
+
+static void rist_close_stream(struct mpegts_stream *stream)
+{
+	if (stream->rist) {
+		rist_destroy(stream->rist);
+		stream->rist = NULL;
+	}
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* transport                                                                 */
+
+static int transport_connect(struct mpegts_stream *stream)
+{
+#if COMPILE_SRT
+	if (stream->protocol == MPEGTS_PROTOCOL_SRT)
+		return srt_connect_stream(stream);
+#endif
+#if COMPILE_RIST
+	if (stream->protocol == MPEGTS_PROTOCOL_RIST)
+		return rist_connect_stream(stream);
+#endif
+
+	warn("Protocol not supported by this build");
+	return OBS_OUTPUT_BAD_PATH;
+}
+
+static bool transport_send(struct mpegts_stream *stream, const uint8_t *data,
+			   size_t size)
+{
+#if COMPILE_SRT
+	if (stream->protocol == MPEGTS_PROTOCOL_SRT)
+		return srt_send(stream, data, size);
+#endif
+#if COMPILE_RIST
+	if (stream->protocol == MPEGTS_PROTOCOL_RIST)
+		return rist_send(stream, data, size);
+#endif
+
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(size);
+	return false;
+}
+
+static void transport_update_stats(struct mpegts_stream *stream)
+{
+#if COMPILE_SRT
+	if (stream->protocol == MPEGTS_PROTOCOL_SRT)
+		srt_update_stats(stream);
+#endif
+
+	/* RIST reports through its stats callback */
+	UNUSED_PARAMETER(stream);
+}
+
+static void transport_close(struct mpegts_stream *stream)
+{
+#if COMPILE_SRT
+	srt_close_stream(stream);
+#endif
+#if COMPILE_RIST
+	rist_close_stream(stream);
+#endif
+
+	UNUSED_PARAMETER(stream);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void get_transport_stats(void *data, calldata_t *cd)
+{
+	struct mpegts_stream *stream = data;
+	struct transport_stats stats;
+
+	pthread_mutex_lock(&stream->stats_mutex);
+	stats = stream->stats;
+	pthread_mutex_unlock(&stream->stats_mutex);
+
+	calldata_set_bool(cd, "active", active(stream));
+	calldata_set_string(cd, "protocol",
+			    stream->protocol == MPEGTS_PROTOCOL_SRT ? "srt"
+								    : "rist");
+	calldata_set_float(cd, "rtt_ms", stats.rtt_ms);
+	calldata_set_int(cd, "latency_ms", stats.latency_ms);
+	calldata_set_int(cd, "packets_sent", (long long)stats.packets_sent);
+	calldata_set_int(cd, "packets_retransmitted",
+			 (long long)stats.packets_retransmitted);
+	calldata_set_int(cd, "packets_lost", (long long)stats.packets_lost);
+}
+
+static const char *mpegts_stream_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("MPEGTSStream");
+}
+
+static void mpegts_stream_destroy(void *data)
+{
+	struct mpegts_stream *stream = data;
+
+	if (stopping(stream) && !connecting(stream)) {
+		pthread_join(stream->send_thread, NULL);
+
+	} else if (connecting(stream) || active(stream)) {
+		if (stream->connecting)
+			pthread_join(stream->connect_thread, NULL);
+
+		stream->stop_ts = 0;
+		os_event_signal(stream->stop_event);
+
+		if (active(stream)) {
+			os_sem_post(stream->send_sem);
+			obs_output_end_data_capture(stream->output);
+			pthread_join(stream->send_thread, NULL);
+		}
+	}
+
+	transport_close(stream);
+	free_packets(stream);
+	mpegts_mux_free(&stream->mux);
+	dstr_free(&stream->url);
+	dstr_free(&stream->key);
+	dstr_free(&stream->fec);
+	os_event_destroy(stream->stop_event);
+	os_sem_destroy(stream->send_sem);
+	pthread_mutex_destroy(&stream->packets_mutex);
+	pthread_mutex_destroy(&stream->stats_mutex);
+	circlebuf_free(&stream->packets);
+	bfree(stream);
+}
+
+static void *mpegts_stream_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct mpegts_stream *stream = bzalloc(sizeof(struct mpegts_stream));
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+
+	stream->output = output;
+	pthread_mutex_init_value(&stream->packets_mutex);
+	pthread_mutex_init_value(&stream->stats_mutex);
+#if COMPILE_SRT
+	stream->srt = SRT_INVALID_SOCK;
+#endif
+
+	if (pthread_mutex_init(&stream->packets_mutex, NULL) != 0)
+		goto fail;
+	if (pthread_mutex_init(&stream->stats_mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&stream->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+
+	proc_handler_add(ph,
+			 "void get_transport_stats(out bool active, "
+			 "out string protocol, out float rtt_ms, "
+			 "out int latency_ms, out int packets_sent, "
+			 "out int packets_retransmitted, "
+			 "out int packets_lost)",
+			 get_transport_stats, stream);
+
+	UNUSED_PARAMETER(settings);
+	return stream;
+
+fail:
+	mpegts_stream_destroy(stream);
+	return NULL;
+}
+
+static void mpegts_stream_stop(void *data, uint64_t ts)
+{
+	struct mpegts_stream *stream = data;
+
+	if (stopping(stream) && ts != 0)
+		return;
+
+	if (connecting(stream))
+		pthread_join(stream->connect_thread, NULL);
+
+	stream->stop_ts = ts / 1000ULL;
+
+	if (active(stream)) {
+		os_event_signal(stream->stop_event);
+		if (stream->stop_ts == 0)
+			os_sem_post(stream->send_sem);
+	} else {
+		obs_output_signal_stop(stream->output, OBS_OUTPUT_SUCCESS);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* sending                                                                   */
+
+static void pace(struct mpegts_stream *stream, size_t size)
+{
+	uint64_t now = os_gettime_ns();
+
+	if (!stream->pacing || !stream->pace_bps)
+		return;
+
+	/* never let an idle period turn into a burst */
+	if (stream->pace_ts + PACING_MAX_BURST_NS < now)
+		stream->pace_ts = now - PACING_MAX_BURST_NS;
+	else if (stream->pace_ts > now)
+		os_sleepto_ns(stream->pace_ts);
+
+	stream->pace_ts += (uint64_t)size * 8ULL * 1000000000ULL /
+			   stream->pace_bps;
+}
+
+static bool send_datagrams(struct mpegts_stream *stream, bool flush)
+{
+	size_t pos = 0;
+	bool success = true;
+
+	while (stream->mux.out.num - pos >= MPEGTS_DATAGRAM_SIZE ||
+	       (flush && pos < stream->mux.out.num)) {
+		size_t size = stream->mux.out.num - pos;
+		if (size > MPEGTS_DATAGRAM_SIZE)
+			size = MPEGTS_DATAGRAM_SIZE;
+
+		pace(stream, size);
+
+		if (!transport_send(stream, stream->mux.out.array + pos,
+				    size)) {
+			success = false;
+			break;
+		}
+
+		pos += size;
+		stream->total_bytes_sent += size;
+	}
+
+	mpegts_mux_consume(&stream->mux, pos);
+	return success;
+}
+
+static inline bool get_next_packet(struct mpegts_stream *stream,
+				   struct encoder_packet *packet)
+{
+	bool new_packet = false;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+	if (stream->packets.size) {
+		circlebuf_pop_front(&stream->packets, packet,
+				    sizeof(struct encoder_packet));
+		new_packet = true;
+	}
+	pthread_mutex_unlock(&stream->packets_mutex);
+
+	return new_packet;
+}
+
+static void *send_thread(void *data)
+{
+	struct mpegts_stream *stream = data;
+
+	os_set_thread_name("mpegts-stream: send_thread");
+
+	while (os_sem_wait(stream->send_sem) == 0) {
+		struct encoder_packet packet;
+
+		if (stopping(stream) && stream->stop_ts == 0)
+			break;
+		if (!get_next_packet(stream, &packet))
+			continue;
+
+		if (stopping(stream) &&
+		    packet.sys_dts_usec >= (int64_t)stream->stop_ts) {
+			obs_encoder_packet_release(&packet);
+			break;
+		}
+
+		mpegts_mux_packet(&stream->mux, &packet);
+		obs_encoder_packet_release(&packet);
+
+		if (!send_datagrams(stream, false)) {
+			os_atomic_set_bool(&stream->disconnected, true);
+			break;
+		}
+
+		uint64_t now = os_gettime_ns();
+		if (now - stream->last_stats_ts >= STATS_INTERVAL_NS) {
+			transport_update_stats(stream);
+			stream->last_stats_ts = now;
+		}
+	}
+
+	if (disconnected(stream)) {
+		info("Disconnected from %s", stream->url.array);
+	} else {
+		send_datagrams(stream, true);
+		info("User stopped the stream");
+	}
+
+	transport_close(stream);
+
+	if (!stopping(stream)) {
+		pthread_detach(stream->send_thread);
+		obs_output_signal_stop(stream->output, OBS_OUTPUT_DISCONNECTED);
+	} else {
+		obs_output_end_data_capture(stream->output);
+	}
+
+	free_packets(stream);
+	mpegts_mux_free(&stream->mux);
+	os_event_reset(stream->stop_event);
+	os_atomic_set_bool(&stream->active, false);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* connecting                                                                */
+
+static inline long get_bitrate(obs_encoder_t *encoder)
+{
+	obs_data_t *settings = obs_encoder_get_settings(encoder);
+	long bitrate = (long)obs_data_get_int(settings, "bitrate");
+
+	obs_data_release(settings);
+	return bitrate;
+}
+
+static bool init_connect(struct mpegts_stream *stream)
+{
+	obs_service_t *service = obs_output_get_service(stream->output);
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
+	obs_encoder_t *aencoder =
+		obs_output_get_audio_encoder(stream->output, 0);
+	obs_data_t *settings;
+	long bitrate;
+
+	if (!service)
+		return false;
+
+	os_atomic_set_bool(&stream->disconnected, false);
+	free_packets(stream);
+
+	dstr_copy(&stream->url, obs_service_get_url(service));
+	dstr_copy(&stream->key, obs_service_get_key(service));
+	dstr_depad(&stream->url);
+
+	if (astrcmpi_n(stream->url.array, "srt://", 6) == 0) {
+		stream->protocol = MPEGTS_PROTOCOL_SRT;
+	} else if (astrcmpi_n(stream->url.array, "rist://", 7) == 0) {
+		stream->protocol = MPEGTS_PROTOCOL_RIST;
+	} else {
+		warn("Unsupported URL, must be srt:// or rist://");
+		return false;
+	}
+
+	settings = obs_output_get_settings(stream->output);
+	stream->latency_ms = (int)obs_data_get_int(settings, OPT_LATENCY);
+	stream->pacing = obs_data_get_bool(settings, OPT_PACING);
+	stream->drop_threshold_usec =
+		(int64_t)obs_data_get_int(settings, OPT_DROP_THRESHOLD) * 1000;
+	dstr_copy(&stream->fec, obs_data_get_string(settings, OPT_FEC));
+	dstr_depad(&stream->fec);
+	obs_data_release(settings);
+
+	bitrate = get_bitrate(vencoder) + (aencoder ? get_bitrate(aencoder) : 0);
+	stream->pace_bps = (uint64_t)((double)bitrate * 1000.0 * PACING_HEADROOM);
+	stream->pace_ts = 0;
+
+	pthread_mutex_lock(&stream->stats_mutex);
+	memset(&stream->stats, 0, sizeof(stream->stats));
+	memset(&stream->last_stats, 0, sizeof(stream->last_stats));
+	stream->congestion = 0.0f;
+	pthread_mutex_unlock(&stream->stats_mutex);
+	stream->total_bytes_sent = 0;
+	stream->dropped_frames = 0;
+	stream->last_stats_ts = 0;
+
+	mpegts_mux_init(&stream->mux, vencoder, aencoder);
+	return true;
+}
+
+static int init_send(struct mpegts_stream *stream)
+{
+	int ret;
+
+	os_sem_destroy(stream->send_sem);
+	stream->send_sem = NULL;
+	if (os_sem_init(&stream->send_sem, 0) != 0)
+		return OBS_OUTPUT_ERROR;
+
+	ret = pthread_create(&stream->send_thread, NULL, send_thread, stream);
+	if (ret != 0) {
+		transport_close(stream);
+		warn("Failed to create send thread");
+		return OBS_OUTPUT_ERROR;
+	}
+
+	os_atomic_set_bool(&stream->active, true);
+	obs_output_begin_data_capture(stream->output, 0);
+	return OBS_OUTPUT_SUCCESS;
+}
+
+static void *connect_thread(void *data)
+{
+	struct mpegts_stream *stream = data;
+	uint64_t connect_start;
+	int ret;
+
+	os_set_thread_name("mpegts-stream: connect_thread");
+
+	if (!init_connect(stream)) {
+		obs_output_signal_stop(stream->output, OBS_OUTPUT_BAD_PATH);
+		goto done;
+	}
+
+	connect_start = os_gettime_ns();
+	ret = transport_connect(stream);
+	stream->connect_time_ms =
+		(int)((os_gettime_ns() - connect_start) / 1000000);
+
+	if (ret == OBS_OUTPUT_SUCCESS) {
+		info("Connection to %s successful", stream->url.array);
+		ret = init_send(stream);
+	}
+
+	if (ret != OBS_OUTPUT_SUCCESS) {
+		mpegts_mux_free(&stream->mux);
+		obs_output_signal_stop(stream->output, ret);
+		info("Connection to %s failed: %d", stream->url.array, ret);
+	}
+
+done:
+	if (!stopping(stream))
+		pthread_detach(stream->connect_thread);
+
+	os_atomic_set_bool(&stream->connecting, false);
+	return NULL;
+}
+
+static bool mpegts_stream_start(void *data)
+{
+	struct mpegts_stream *stream = data;
+
+	if (!obs_output_can_begin_data_capture(stream->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(stream->output, 0))
+		return false;
+
+	os_atomic_set_bool(&stream->connecting, true);
+	return pthread_create(&stream->connect_thread, NULL, connect_thread,
+			      stream) == 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* receiving packets                                                         */
+
+static inline bool find_first_video_packet(struct mpegts_stream *stream,
+					   struct encoder_packet *first)
+{
+	size_t count = stream->packets.size / sizeof(*first);
+
+	for (size_t i = 0; i < count; i++) {
+		struct encoder_packet *cur =
+			circlebuf_data(&stream->packets, i * sizeof(*first));
+		if (cur->type == OBS_ENCODER_VIDEO) {
+			*first = *cur;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* once the queue holds more than the drop threshold, video is dropped until
+ * the next keyframe; audio is small and always kept */
+static bool should_drop_video(struct mpegts_stream *stream,
+			      struct encoder_packet *packet)
+{
+	struct encoder_packet first;
+
+	if (stream->dropping_video) {
+		if (!packet->keyframe)
+			return true;
+		stream->dropping_video = false;
+	}
+
+	if (!stream->drop_threshold_usec ||
+	    !find_first_video_packet(stream, &first))
+		return false;
+
+	if (packet->dts_usec - first.dts_usec > stream->drop_threshold_usec) {
+		debug("Queue at %" PRId64 " ms, dropping video until the "
+		      "next keyframe",
+		      (packet->dts_usec - first.dts_usec) / 1000);
+		stream->dropping_video = !packet->keyframe;
+		return !packet->keyframe;
+	}
+
+	return false;
+}
+
+static void mpegts_stream_data(void *data, struct encoder_packet *packet)
+{
+	struct mpegts_stream *stream = data;
+	struct encoder_packet new_packet;
+	bool drop = false;
+
+	if (disconnected(stream) || !active(stream))
+		return;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		drop = should_drop_video(stream, packet);
+
+	if (!drop) {
+		obs_encoder_packet_ref(&new_packet, packet);
+		circlebuf_push_back(&stream->packets, &new_packet,
+				    sizeof(new_packet));
+	} else {
+		stream->dropped_frames++;
+	}
+
+	pthread_mutex_unlock(&stream->packets_mutex);
+
+	if (!drop)
+		os_sem_post(stream->send_sem);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void mpegts_stream_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_int(defaults, OPT_LATENCY, 200);
+	obs_data_set_default_string(defaults, OPT_FEC, "");
+	obs_data_set_default_bool(defaults, OPT_PACING, true);
+	obs_data_set_default_int(defaults, OPT_DROP_THRESHOLD, 2000);
+}
+
+static obs_properties_t *mpegts_stream_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
+
+	p = obs_properties_add_int(props, OPT_LATENCY,
+				   obs_module_text("MPEGTSStream.Latency"), 20,
+				   8000, 10);
+	obs_property_int_set_suffix(p, " ms");
+	obs_properties_add_text(props, OPT_FEC,
+				obs_module_text("MPEGTSStream.FEC"),
+				OBS_TEXT_DEFAULT);
+	obs_properties_add_bool(props, OPT_PACING,
+				obs_module_text("MPEGTSStream.Pacing"));
+	p = obs_properties_add_int(props, OPT_DROP_THRESHOLD,
+				   obs_module_text("RTMPStream.DropThreshold"),
+				   0, 10000, 100);
+	obs_property_int_set_suffix(p, " ms");
+
+	return props;
+}
+
+static uint64_t mpegts_stream_total_bytes_sent(void *data)
+{
+	struct mpegts_stream *stream = data;
+	return stream->total_bytes_sent;
+}
+
+static int mpegts_stream_dropped_frames(void *data)
+{
+	struct mpegts_stream *stream = data;
+	return stream->dropped_frames;
+}
+
+static float mpegts_stream_congestion(void *data)
+{
+	struct mpegts_stream *stream = data;
+	float congestion;
+
+	pthread_mutex_lock(&stream->stats_mutex);
+	congestion = stream->congestion;
+	pthread_mutex_unlock(&stream->stats_mutex);
+
+	return congestion;
+}
+
+static int mpegts_stream_connect_time(void *data)
+{
+	struct mpegts_stream *stream = data;
+	return stream->connect_time_ms;
+}
+
+struct obs_output_info mpegts_output_info = {
+	.id = "mpegts_output",
+	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED | OBS_OUTPUT_SERVICE,
+	.encoded_video_codecs = "h264",
+	.encoded_audio_codecs = "aac",
+	.get_name = mpegts_stream_getname,
+	.create = mpegts_stream_create,
+	.destroy = mpegts_stream_destroy,
+	.start = mpegts_stream_start,
+	.stop = mpegts_stream_stop,
+	.encoded_packet = mpegts_stream_data,
+	.get_defaults = mpegts_stream_defaults,
+	.get_properties = mpegts_stream_properties,
+	.get_total_bytes = mpegts_stream_total_bytes_sent,
+	.get_congestion = mpegts_stream_congestion,
+	.get_connect_time_ms = mpegts_stream_connect_time,
+	.get_dropped_frames = mpegts_stream_dropped_frames,
+};
@@ -0,0 +1,235 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include "net-emulator.h"
+
+#define MSEC_NS 1000000ULL
+#define SEC_NS 1000000000ULL
+
+/* a TCP segment */
+#define SEGMENT_SIZE 1448
+
+static inline bool is_key(const char *item, const char *eq, const char *name)
+{
+	size_t len = (size_t)(eq - item);
+	return strlen(name) == len && strncmp(item, name, len) == 0;
+}
+
+static bool parse_value(struct net_emulator_step *step, const char *item)
+{
+	const char *eq = strchr(item, '=');
+	char *end;
+	double value;
+
+	if (!eq)
+		return false;
+
+	value = strtod(eq + 1, &end);
+	if (end == eq + 1 || *end || value < 0.0)
+		return false;
+
+	if (is_key(item, eq, "at"))
+		step->at_ns = (uint64_t)(value * (double)SEC_NS);
+	else if (is_key(item, eq, "kbps"))
+		step->kbps = (long)value;
+	else if (is_key(item, eq, "rtt_ms"))
+		step->rtt_ms = (int)value;
+	else if (is_key(item, eq, "jitter_ms"))
+		step->jitter_ms = (int)value;
+	else if (is_key(item, eq, "loss"))
+		step->loss = value / 100.0;
+	else if (is_key(item, eq, "stall_ms"))
+		step->stall_ms = (int)value;
+	else
+		return false;
+
+	return true;
+}
+
+static bool parse_profile(struct net_emulator *ne, const char *profile)
+{
+	char **steps = strlist_split(profile, ';', false);
+	struct net_emulator_step step = {0};
+	bool success = true;
+
+	for (char **cur = steps; success && *cur; cur++) {
+		char **items = strlist_split(*cur, ',', false);
+
+		step.stall_ms = 0;
+
+		for (char **item = items; *item; item++) {
+			char *str = bstrdup(*item);
+			struct net_emulator_step *prev = da_end(ne->steps);
+
+			/* the seed doesn't belong to any step */
+			if (astrcmp_n(str, "seed=", 5) == 0) {
+				ne->seed = strtoul(str + 5, NULL, 10);
+			} else if (!parse_value(&step, str) ||
+				   (prev && step.at_ns < prev->at_ns)) {
+				blog(LOG_WARNING,
+				     "net emulator: invalid profile entry '%s'",
+				     str);
+				success = false;
+			}
+
+			bfree(str);
+			if (!success)
+				break;
+		}
+
+		da_push_back(ne->steps, &step);
+		strlist_free(items);
+	}
+
+	strlist_free(steps);
+	return success && ne->steps.num;
+}
+
+bool net_emulator_init(struct net_emulator *ne, const char *profile)
+{
+	memset(ne, 0, sizeof(*ne));
+	ne->seed = 1;
+
+	if (!profile || !*profile || !parse_profile(ne, profile)) {
+		da_free(ne->steps);
+		return false;
+	}
+
+	return pthread_mutex_init(&ne->mutex, NULL) == 0;
+}
+
+void net_emulator_free(struct net_emulator *ne)
+{
+	pthread_mutex_destroy(&ne->mutex);
+	da_free(ne->steps);
+}
+
+void net_emulator_start(struct net_emulator *ne, uint64_t now)
+{
+	pthread_mutex_lock(&ne->mutex);
+	ne->start_ts = now;
+	ne->link_free_ts = now;
+	ne->cur_step = 0;
+	ne->random = ne->seed ? ne->seed : 1;
+	if (ne->steps.array[0].stall_ms)
+		ne->link_free_ts += ne->steps.array[0].stall_ms * MSEC_NS;
+	pthread_mutex_unlock(&ne->mutex);
+}
+
+/* xorshift, the same profile and seed always give the same run */
+static inline uint32_t next_random(struct net_emulator *ne)
+{
+	uint32_t x = ne->random;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return ne->random = x;
+}
+
+/* returns the rate the link carries data at in kbps, 0 for no limit */
+static double link_kbps(const struct net_emulator_step *step)
+{
+	double kbps = (double)step->kbps;
+
+	if (step->loss > 0.0) {
+		double rtt_ms = step->rtt_ms ? (double)step->rtt_ms : 1.0;
+
+		/* TCP's throughput under random loss, after Mathis et al. */
+		double tcp_kbps = SEGMENT_SIZE * 8 * 1.22 /
+				  (rtt_ms * sqrt(step->loss));
+		if (!kbps || tcp_kbps < kbps)
+			kbps = tcp_kbps;
+	}
+
+	return kbps;
+}
+
+/* assumes mutex */
+static const struct net_emulator_step *update_step(struct net_emulator *ne,
+						   uint64_t now)
+{
+	while (ne->cur_step + 1 < ne->steps.num) {
+		const struct net_emulator_step *next =
+			&ne->steps.array[ne->cur_step + 1];
+		uint64_t begin = ne->start_ts + next->at_ns;
+
+		if (now < begin)
+			break;
+
+		ne->cur_step++;
+
+		if (next->stall_ms) {
+			uint64_t stall_end = begin + next->stall_ms * MSEC_NS;
+			if (ne->link_free_ts < stall_end)
+				ne->link_free_ts = stall_end;
+		}
+	}
+
+	return &ne->steps.array[ne->cur_step];
+}
+
+uint64_t net_emulator_send(struct net_emulator *ne, size_t size, uint64_t now)
+{
+	const struct net_emulator_step *step;
+	uint64_t rtt_ns, busy_ns = 0, start, done;
+	uint64_t wait = 0;
+	double kbps;
+
+	pthread_mutex_lock(&ne->mutex);
+
+	step = update_step(ne, now);
+	rtt_ns = step->rtt_ms * MSEC_NS;
+	kbps = link_kbps(step);
+
+	if (kbps > 0.0)
+		busy_ns = (uint64_t)((double)size * 8.0 * MSEC_NS / kbps);
+
+	/* jitter delays the data without taking up the link */
+	ne->jitter_ns = 0;
+	if (step->jitter_ms) {
+		uint64_t range = step->jitter_ms * MSEC_NS + 1;
+		ne->jitter_ns = next_random(ne) % range;
+	}
+
+	start = ne->link_free_ts > now ? ne->link_free_ts : now;
+	ne->link_free_ts = start + busy_ns;
+	done = ne->link_free_ts + ne->jitter_ns;
+
+	/* the socket buffer holds about a round trip of data before the
+	 * sender is made to wait */
+	if (done > now + rtt_ns)
+		wait = done - now - rtt_ns;
+
+	pthread_mutex_unlock(&ne->mutex);
+	return wait;
+}
+
+void net_emulator_get_signals(struct net_emulator *ne, uint64_t now,
+			      struct bitrate_signals *signals)
+{
+	const struct net_emulator_step *step;
+	uint64_t queued_ns, rtt_ns;
+	double kbps;
+
+	pthread_mutex_lock(&ne->mutex);
+
+	step = update_step(ne, now);
+	rtt_ns = step->rtt_ms * MSEC_NS;
+	queued_ns = ne->link_free_ts > now ? ne->link_free_ts - now : 0;
+	kbps = link_kbps(step);
+
+	signals->rtt_usec =
+		(int64_t)((rtt_ns + queued_ns + ne->jitter_ns) / 1000);
+	signals->loss = step->loss;
+
+	if (kbps > 0.0) {
+		signals->send_backlog =
+			(int64_t)((double)queued_ns * kbps / 8.0 / MSEC_NS);
+		signals->ideal_backlog =
+			(int64_t)((double)rtt_ns * kbps / 8.0 / MSEC_NS);
+	}
+
+	pthread_mutex_unlock(&ne->mutex);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <util/darray.h>
+#include <util/threading.h>
+#include "bitrate-control.h"
+
+/*
+ * Emulates a constrained link under the streaming outputs' sends, so the
+ * send path and the bitrate estimators can be tried against bad networks
+ * without one.  Nothing is actually delayed or dropped on the wire: each
+ * send is charged the time the emulated link would take, the caller blocks
+ * for whatever exceeds one round trip, and the connection signals are made
+ * to match.
+ *
+ * A profile is a list of steps separated by ';', each made of key=value
+ * pairs separated by ',':
+ *
+ *   at        seconds from the start of the stream the step begins at
+ *   kbps      link capacity, 0 for no limit
+ *   rtt_ms    round trip time
+ *   jitter_ms extra delay of up to this much on each send
+ *   loss      percentage of segments lost, which limits the throughput the
+ *             way TCP's congestion control would
+ *   stall_ms  the link stops for this long when the step begins
+ *   seed      seed of the random numbers, for reproducible runs
+ *
+ * Steps keep the values of the previous one except stall_ms, for example
+ * "kbps=6000,rtt_ms=40;at=30,kbps=1500,loss=2;at=60,stall_ms=3000,kbps=6000"
+ */
+
+#define OPT_NET_EMULATION "net_emulation"
+
+struct net_emulator_step {
+	uint64_t at_ns;
+	long kbps;
+	int rtt_ms;
+	int jitter_ms;
+	double loss;
+	int stall_ms;
+};
+
+struct net_emulator {
+	pthread_mutex_t mutex;
+	DARRAY(struct net_emulator_step) steps;
+	size_t cur_step;
+
+	uint64_t start_ts;
+	/* when the link is done with everything sent so far */
+	uint64_t link_free_ts;
+	uint64_t jitter_ns;
+	uint32_t seed;
+	uint32_t random;
+};
+
+/* returns false if the profile can't be parsed */
+extern bool net_emulator_init(struct net_emulator *ne, const char *profile);
+extern void net_emulator_free(struct net_emulator *ne);
+
+/* starts the profile over, from `now` */
+extern void net_emulator_start(struct net_emulator *ne, uint64_t now);
+
+/* charges a send of `size` bytes at `now` to the link and returns how long
+ * the sender should block, in nanoseconds */
+extern uint64_t net_emulator_send(struct net_emulator *ne, size_t size,
+				  uint64_t now);
+
+/* replaces the round trip, backlog and loss with the emulated ones */
+extern void net_emulator_get_signals(struct net_emulator *ne, uint64_t now,
+				     struct bitrate_signals *signals);
@@ -2,6 +2,10 @@
 
 #include "obs-outputs-config.h"
 
+#if COMPILE_SRT
+#include <srt/srt.h>
+#endif
+
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <winsock2.h>
@@ -12,15 +16,22 @@ OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("obs-outputs", "en-US")
 MODULE_EXPORT const char *obs_module_description(void)
 {
-	return "OBS core RTMP/FLV/null/FTL outputs";
+	return "OBS core RTMP/FLV/null/FTL/SRT/RIST/HLS outputs";
 }
 
 extern struct obs_output_info rtmp_output_info;
+extern struct obs_output_info rtmp_multi_output_info;
 extern struct obs_output_info null_output_info;
 extern struct obs_output_info flv_output_info;
 #if COMPILE_FTL
 extern struct obs_output_info ftl_output_info;
 #endif
+#if COMPILE_SRT || COMPILE_RIST
+extern struct obs_output_info mpegts_output_info;
+#endif
+#if COMPILE_HLS
+extern struct obs_output_info hls_output_info;
+#endif
 
 #if defined(_WIN32) && defined(MBEDTLS_THREADING_ALT)
 void mbed_mutex_init(mbedtls_threading_mutex_t *m)
@@ -66,16 +77,30 @@ bool obs_module_load(void)
 #endif
 
 	obs_register_output(&rtmp_output_info);
+	obs_register_output(&rtmp_multi_output_info);
 	obs_register_output(&null_output_info);
 	obs_register_output(&flv_output_info);
 #if COMPILE_FTL
 	obs_register_output(&ftl_output_info);
+#endif
+#if COMPILE_SRT
+	srt_startup();
+#endif
+#if COMPILE_SRT || COMPILE_RIST
+	obs_register_output(&mpegts_output_info);
+#endif
+#if COMPILE_HLS
+	obs_register_output(&hls_output_info);
 #endif
 	return true;
 }
 
 void obs_module_unload(void)
 {
+#if COMPILE_SRT
+	srt_cleanup();
+#endif
+
 #ifdef _WIN32
 #ifdef MBEDTLS_THREADING_ALT
 	mbedtls_threading_free_alt();
@@ -0,0 +1,993 @@
+#include <obs-module.h>
+#include <obs-avc.h>
+#include <util/platform.h>
+#include <util/circlebuf.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include <inttypes.h>
+#include "librtmp/rtmp.h"
+#include "librtmp/log.h"
+#include "flv-mux.h"
+
+#ifndef _WIN32
+#include <sys/ioctl.h>
+#endif
+
+/*
+ * One encoder to several RTMP ingest servers.  Every packet is muxed to FLV
+ * once, and the muxed tag is shared by reference between the destinations.
+ * Each destination connects, sends and drops frames on its own thread with
+ * its own queue, so a slow or failing ingest never holds back the others.
+ */
+
+#define do_log(level, format, ...)                       \
+	blog(level, "[rtmp multi stream: '%s'] " format, \
+	     obs_output_get_name(stream->output), ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+#define debug(format, ...) do_log(LOG_DEBUG, format, ##__VA_ARGS__)
+
+#define OPT_DESTINATIONS "destinations"
+#define OPT_DROP_THRESHOLD "drop_threshold_ms"
+#define OPT_PFRAME_DROP_THRESHOLD "pframe_drop_threshold_ms"
+#define OPT_RECONNECT_RETRIES "reconnect_retries"
+#define OPT_RECONNECT_DELAY "reconnect_delay_sec"
+
+#define MAX_DESTINATIONS 16
+
+struct multi_tag {
+	volatile long refs;
+	enum obs_encoder_type type;
+	bool keyframe;
+	int priority;
+	int64_t dts_usec;
+	int64_t sys_dts_usec;
+	size_t size;
+	uint8_t data[];
+};
+
+struct multi_destination {
+	struct rtmp_multi_stream *stream;
+	size_t index;
+
+	struct dstr url, key;
+	struct dstr username, password;
+	struct dstr encoder_name;
+
+	RTMP rtmp;
+	pthread_t thread;
+	bool thread_created;
+
+	pthread_mutex_t tags_mutex;
+	struct circlebuf tags;
+	os_sem_t *send_sem;
+
+	volatile bool connected;
+	bool wait_keyframe;
+
+	/* frame drop variables, protected by tags_mutex */
+	int min_priority;
+	int64_t last_dts_usec;
+	float congestion;
+	int dropped_frames;
+
+	volatile long long total_bytes_sent;
+};
+
+struct rtmp_multi_stream {
+	obs_output_t *output;
+
+	struct multi_destination *destinations[MAX_DESTINATIONS];
+	size_t num_destinations;
+
+	/* muxing, only touched by the packet callback */
+	struct array_output_data mux_buf;
+	bool got_first_video;
+	int64_t start_dts_offset;
+
+	volatile bool active;
+	volatile bool capturing;
+	volatile bool encode_error;
+	volatile long running;
+	bool destroying;
+
+	os_event_t *stop_event;
+	uint64_t stop_ts;
+
+	int64_t drop_threshold_usec;
+	int64_t pframe_drop_threshold_usec;
+	int reconnect_retries;
+	int reconnect_delay_sec;
+};
+
+static inline bool stopping(struct rtmp_multi_stream *stream)
+{
+	return os_event_try(stream->stop_event) != EAGAIN;
+}
+
+static inline bool active(struct rtmp_multi_stream *stream)
+{
+	return os_atomic_load_bool(&stream->active);
+}
+
+/* stopping without a timestamp, or after an encoder error, drops whatever
+ * is still queued */
+static inline bool aborting(struct rtmp_multi_stream *stream)
+{
+	return os_atomic_load_bool(&stream->encode_error) ||
+	       (stopping(stream) && stream->stop_ts == 0);
+}
+
+static inline struct multi_tag *ref_tag(struct multi_tag *tag)
+{
+	os_atomic_inc_long(&tag->refs);
+	return tag;
+}
+
+static inline void release_tag(struct multi_tag *tag)
+{
+	if (os_atomic_dec_long(&tag->refs) == 0)
+		bfree(tag);
+}
+
+static void free_tags(struct multi_destination *dest)
+{
+	pthread_mutex_lock(&dest->tags_mutex);
+	while (dest->tags.size) {
+		struct multi_tag *tag;
+		circlebuf_pop_front(&dest->tags, &tag, sizeof(tag));
+		release_tag(tag);
+	}
+	dest->min_priority = 0;
+	dest->congestion = 0.0f;
+	pthread_mutex_unlock(&dest->tags_mutex);
+}
+
+static inline size_t num_buffered_tags(struct multi_destination *dest)
+{
+	return dest->tags.size / sizeof(struct multi_tag *);
+}
+
+static void log_rtmp(int level, const char *format, va_list args)
+{
+	if (level > RTMP_LOGWARNING)
+		return;
+
+	blogva(LOG_INFO, format, args);
+}
+
+/* ------------------------------------------------------------------------- */
+/* destinations                                                              */
+
+static void destination_destroy(struct multi_destination *dest)
+{
+	if (!dest)
+		return;
+
+	free_tags(dest);
+	RTMP_TLS_Free(&dest->rtmp);
+	dstr_free(&dest->url);
+	dstr_free(&dest->key);
+	dstr_free(&dest->username);
+	dstr_free(&dest->password);
+	dstr_free(&dest->encoder_name);
+	os_sem_destroy(dest->send_sem);
+	pthread_mutex_destroy(&dest->tags_mutex);
+	circlebuf_free(&dest->tags);
+	bfree(dest);
+}
+
+static struct multi_destination *
+destination_create(struct rtmp_multi_stream *stream, size_t index,
+		   obs_data_t *settings)
+{
+	struct multi_destination *dest = bzalloc(sizeof(*dest));
+
+	dest->stream = stream;
+	dest->index = index;
+	pthread_mutex_init_value(&dest->tags_mutex);
+
+	if (pthread_mutex_init(&dest->tags_mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&dest->send_sem, 0) != 0)
+		goto fail;
+
+	RTMP_Init(&dest->rtmp);
+
+	dstr_copy(&dest->url, obs_data_get_string(settings, "url"));
+	dstr_copy(&dest->key, obs_data_get_string(settings, "key"));
+	dstr_copy(&dest->username, obs_data_get_string(settings, "username"));
+	dstr_copy(&dest->password, obs_data_get_string(settings, "password"));
+	dstr_depad(&dest->url);
+	dstr_depad(&dest->key);
+	return dest;
+
+fail:
+	destination_destroy(dest);
+	return NULL;
+}
+
+static inline void set_rtmp_dstr(AVal *val, struct dstr *str)
+{
+	bool valid = !dstr_is_empty(str);
+	val->av_val = valid ? str->array : NULL;
+	val->av_len = valid ? (int)str->len : 0;
+}
+
+static bool send_header(struct multi_destination *dest,
+			struct encoder_packet *packet)
+{
+	uint8_t *data;
+	size_t size;
+	bool success;
+
+	flv_packet_mux(packet, 0, &data, &size, true);
+	success = RTMP_Write(&dest->rtmp, (char *)data, (int)size, 0) >= 0;
+	bfree(data);
+
+	return success;
+}
+
+static bool send_headers(struct multi_destination *dest)
+{
+	obs_output_t *output = dest->stream->output;
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(output);
+	obs_encoder_t *aencoder = obs_output_get_audio_encoder(output, 0);
+	uint8_t *header;
+	size_t size;
+	bool success = true;
+
+	flv_meta_data(output, &header, &size, false);
+	success = RTMP_Write(&dest->rtmp, (char *)header, (int)size, 0) >= 0;
+	bfree(header);
+
+	if (success && aencoder) {
+		struct encoder_packet packet = {.type = OBS_ENCODER_AUDIO,
+						.timebase_den = 1};
+
+		obs_encoder_get_extra_data(aencoder, &packet.data,
+					   &packet.size);
+		success = send_header(dest, &packet);
+	}
+
+	if (success) {
+		struct encoder_packet packet = {.type = OBS_ENCODER_VIDEO,
+						.timebase_den = 1,
+						.keyframe = true};
+
+		obs_encoder_get_extra_data(vencoder, &header, &size);
+		packet.size = obs_parse_avc_header(&packet.data, header, size);
+		success = send_header(dest, &packet);
+		bfree(packet.data);
+	}
+
+	return success;
+}
+
+static int destination_connect(struct multi_destination *dest)
+{
+	struct rtmp_multi_stream *stream = dest->stream;
+	RTMP *rtmp = &dest->rtmp;
+
+	if (dstr_is_empty(&dest->url)) {
+		warn("Destination %d: URL is empty", (int)dest->index);
+		return OBS_OUTPUT_BAD_PATH;
+	}
+
+	info("Destination %d: connecting to %s...", (int)dest->index,
+	     dest->url.array);
+
+	/* librtmp keeps state between connections, see try_connect() in
+	 * rtmp-stream.c */
+	RTMP_Reset(rtmp);
+	memset(&rtmp->Link, 0, sizeof(rtmp->Link));
+	rtmp->last_error_code = 0;
+
+	if (!RTMP_SetupURL(rtmp, dest->url.array))
+		return OBS_OUTPUT_BAD_PATH;
+
+	RTMP_EnableWrite(rtmp);
+
+	dstr_copy(&dest->encoder_name, "FMLE/3.0 (compatible; FMSc/1.0)");
+
+	set_rtmp_dstr(&rtmp->Link.pubUser, &dest->username);
+	set_rtmp_dstr(&rtmp->Link.pubPasswd, &dest->password);
+	set_rtmp_dstr(&rtmp->Link.flashVer, &dest->encoder_name);
+	rtmp->Link.swfUrl = rtmp->Link.tcUrl;
+	memset(&rtmp->m_bindIP, 0, sizeof(rtmp->m_bindIP));
+
+	RTMP_AddStream(rtmp, dest->key.array);
+
+	rtmp->m_outChunkSize = 4096;
+	rtmp->m_bSendChunkSizeInfo = true;
+	rtmp->m_bUseNagle = true;
+
+	if (!RTMP_Connect(rtmp, NULL))
+		return OBS_OUTPUT_CONNECT_FAILED;
+	if (!RTMP_ConnectStream(rtmp, 0))
+		return OBS_OUTPUT_INVALID_STREAM;
+
+	if (!send_headers(dest)) {
+		RTMP_Close(rtmp);
+		return OBS_OUTPUT_DISCONNECTED;
+	}
+
+	info("Destination %d: connection to %s successful", (int)dest->index,
+	     dest->url.array);
+	return OBS_OUTPUT_SUCCESS;
+}
+
+/* the server's acknowledgements are never read otherwise, and would fill up
+ * the receive window */
+static bool discard_recv_data(struct multi_destination *dest)
+{
+	RTMP *rtmp = &dest->rtmp;
+	int recv_size = 0;
+	uint8_t buf[512];
+	int ret;
+
+#ifdef _WIN32
+	ret = ioctlsocket(rtmp->m_sb.sb_socket, FIONREAD, (u_long *)&recv_size);
+#else
+	ret = ioctl(rtmp->m_sb.sb_socket, FIONREAD, &recv_size);
+#endif
+
+	while (ret >= 0 && recv_size > 0) {
+		int bytes = recv_size > 512 ? 512 : recv_size;
+
+		ret = (int)recv(rtmp->m_sb.sb_socket, (char *)buf, bytes, 0);
+		if (ret <= 0)
+			return false;
+
+		recv_size -= ret;
+	}
+
+	return true;
+}
+
+static inline struct multi_tag *get_next_tag(struct multi_destination *dest)
+{
+	struct multi_tag *tag = NULL;
+
+	pthread_mutex_lock(&dest->tags_mutex);
+	if (dest->tags.size)
+		circlebuf_pop_front(&dest->tags, &tag, sizeof(tag));
+	pthread_mutex_unlock(&dest->tags_mutex);
+
+	return tag;
+}
+
+/* returns false if the connection was lost */
+static bool send_loop(struct multi_destination *dest)
+{
+	struct rtmp_multi_stream *stream = dest->stream;
+
+	while (os_sem_wait(dest->send_sem) == 0) {
+		struct multi_tag *tag;
+		bool success;
+
+		if (aborting(stream))
+			return true;
+		if (!(tag = get_next_tag(dest)))
+			continue;
+
+		if (stopping(stream) &&
+		    tag->sys_dts_usec >= (int64_t)stream->stop_ts) {
+			release_tag(tag);
+			return true;
+		}
+
+		success = discard_recv_data(dest) &&
+			  RTMP_Write(&dest->rtmp, (char *)tag->data,
+				     (int)tag->size, 0) >= 0;
+
+		if (success)
+			os_atomic_add_long_long(&dest->total_bytes_sent,
+						(long long)tag->size);
+		release_tag(tag);
+
+		if (!success)
+			return false;
+	}
+
+	return true;
+}
+
+/* called by the last destination thread to exit.  The output is marked
+ * inactive before it is signalled, as a reconnect may start it again right
+ * away. */
+static void finish_stream(struct rtmp_multi_stream *stream)
+{
+	bool capturing = os_atomic_set_bool(&stream->capturing, false);
+	bool encode_error = os_atomic_load_bool(&stream->encode_error);
+	bool stopped = stopping(stream);
+
+	os_event_reset(stream->stop_event);
+	os_atomic_set_bool(&stream->active, false);
+
+	if (stream->destroying)
+		return;
+
+	if (encode_error) {
+		info("Encoder error, disconnecting");
+		obs_output_signal_stop(stream->output, OBS_OUTPUT_ENCODE_ERROR);
+	} else if (stopped) {
+		info("User stopped the stream");
+		if (capturing)
+			obs_output_end_data_capture(stream->output);
+		else
+			obs_output_signal_stop(stream->output,
+					       OBS_OUTPUT_SUCCESS);
+	} else {
+		info("All destinations disconnected");
+		obs_output_signal_stop(stream->output,
+				       capturing ? OBS_OUTPUT_DISCONNECTED
+						 : OBS_OUTPUT_CONNECT_FAILED);
+	}
+}
+
+static void *destination_thread(void *data)
+{
+	struct multi_destination *dest = data;
+	struct rtmp_multi_stream *stream = dest->stream;
+	unsigned long delay_ms = (unsigned long)stream->reconnect_delay_sec *
+				 1000;
+	int retries = 0;
+
+	os_set_thread_name("rtmp-multi-stream: destination_thread");
+
+	while (!stopping(stream) && !aborting(stream)) {
+		int ret = destination_connect(dest);
+
+		if (ret == OBS_OUTPUT_SUCCESS) {
+			/* the first destination to connect starts the
+			 * encoders for everyone */
+			if (!os_atomic_set_bool(&stream->capturing, true))
+				obs_output_begin_data_capture(stream->output,
+							      0);
+
+			pthread_mutex_lock(&dest->tags_mutex);
+			dest->wait_keyframe = true;
+			pthread_mutex_unlock(&dest->tags_mutex);
+			os_atomic_set_bool(&dest->connected, true);
+
+			bool lost = !send_loop(dest);
+
+			os_atomic_set_bool(&dest->connected, false);
+			RTMP_Close(&dest->rtmp);
+			free_tags(dest);
+
+			if (!lost)
+				break;
+
+			info("Destination %d: disconnected from %s",
+			     (int)dest->index, dest->url.array);
+			retries = 0;
+		} else {
+			info("Destination %d: connection to %s failed: %d",
+			     (int)dest->index, dest->url.array, ret);
+			RTMP_Close(&dest->rtmp);
+
+			if (ret == OBS_OUTPUT_BAD_PATH)
+				break;
+		}
+
+		if (retries++ >= stream->reconnect_retries)
+			break;
+		if (os_event_timedwait(stream->stop_event, delay_ms) == 0)
+			break;
+	}
+
+	if (os_atomic_dec_long(&stream->running) == 0)
+		finish_stream(stream);
+	return NULL;
+}
+
+static void join_destinations(struct rtmp_multi_stream *stream)
+{
+	for (size_t i = 0; i < stream->num_destinations; i++) {
+		struct multi_destination *dest = stream->destinations[i];
+
+		if (dest->thread_created)
+			pthread_join(dest->thread, NULL);
+		dest->thread_created = false;
+	}
+}
+
+static void free_destinations(struct rtmp_multi_stream *stream)
+{
+	join_destinations(stream);
+
+	for (size_t i = 0; i < stream->num_destinations; i++)
+		destination_destroy(stream->destinations[i]);
+	stream->num_destinations = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const char *rtmp_multi_stream_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("RTMPMultiStream");
+}
+
+static void wake_destinations(struct rtmp_multi_stream *stream)
+{
+	for (size_t i = 0; i < stream->num_destinations; i++)
+		os_sem_post(stream->destinations[i]->send_sem);
+}
+
+static void rtmp_multi_stream_destroy(void *data)
+{
+	struct rtmp_multi_stream *stream = data;
+
+	stream->destroying = true;
+
+	if (active(stream)) {
+		stream->stop_ts = 0;
+		os_event_signal(stream->stop_event);
+		wake_destinations(stream);
+
+		if (os_atomic_set_bool(&stream->capturing, false))
+			obs_output_end_data_capture(stream->output);
+	}
+
+	free_destinations(stream);
+	array_output_serializer_free(&stream->mux_buf);
+	os_event_destroy(stream->stop_event);
+	bfree(stream);
+}
+
+static void get_destination_stats(void *data, calldata_t *cd)
+{
+	struct rtmp_multi_stream *stream = data;
+	int index = (int)calldata_int(cd, "index");
+	struct multi_destination *dest;
+
+	if (index < 0 || (size_t)index >= stream->num_destinations) {
+		calldata_set_bool(cd, "connected", false);
+		return;
+	}
+
+	dest = stream->destinations[index];
+
+	pthread_mutex_lock(&dest->tags_mutex);
+	calldata_set_float(cd, "congestion", dest->congestion);
+	calldata_set_int(cd, "dropped_frames", dest->dropped_frames);
+	pthread_mutex_unlock(&dest->tags_mutex);
+
+	calldata_set_string(cd, "url", dest->url.array);
+	calldata_set_bool(cd, "connected",
+			  os_atomic_load_bool(&dest->connected));
+	calldata_set_int(cd, "bytes_sent",
+			 os_atomic_load_long_long(&dest->total_bytes_sent));
+}
+
+static void *rtmp_multi_stream_create(obs_data_t *settings,
+				      obs_output_t *output)
+{
+	struct rtmp_multi_stream *stream = bzalloc(sizeof(*stream));
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+
+	stream->output = output;
+	RTMP_LogSetCallback(log_rtmp);
+	RTMP_LogSetLevel(RTMP_LOGWARNING);
+
+	if (os_event_init(&stream->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+
+	proc_handler_add(ph,
+			 "void get_destination_stats(in int index, "
+			 "out string url, out bool connected, "
+			 "out int bytes_sent, out int dropped_frames, "
+			 "out float congestion)",
+			 get_destination_stats, stream);
+
+	UNUSED_PARAMETER(settings);
+	return stream;
+
+fail:
+	rtmp_multi_stream_destroy(stream);
+	return NULL;
+}
+
+static void rtmp_multi_stream_stop(void *data, uint64_t ts)
+{
+	struct rtmp_multi_stream *stream = data;
+
+	if (stopping(stream) && ts != 0)
+		return;
+
+	stream->stop_ts = ts / 1000ULL;
+
+	if (active(stream)) {
+		os_event_signal(stream->stop_event);
+		if (stream->stop_ts == 0)
+			wake_destinations(stream);
+	} else {
+		obs_output_signal_stop(stream->output, OBS_OUTPUT_SUCCESS);
+	}
+}
+
+static bool load_destinations(struct rtmp_multi_stream *stream,
+			      obs_data_t *settings)
+{
+	obs_data_array_t *array =
+		obs_data_get_array(settings, OPT_DESTINATIONS);
+	size_t count = obs_data_array_count(array);
+
+	free_destinations(stream);
+
+	if (count > MAX_DESTINATIONS) {
+		warn("Only the first %d destinations are used",
+		     MAX_DESTINATIONS);
+		count = MAX_DESTINATIONS;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(array, i);
+		struct multi_destination *dest =
+			destination_create(stream, i, item);
+
+		obs_data_release(item);
+		if (dest)
+			stream->destinations[stream->num_destinations++] = dest;
+	}
+
+	obs_data_array_release(array);
+	return stream->num_destinations > 0;
+}
+
+static bool rtmp_multi_stream_start(void *data)
+{
+	struct rtmp_multi_stream *stream = data;
+	obs_data_t *settings;
+	int64_t drop_b, drop_p;
+
+	if (!obs_output_can_begin_data_capture(stream->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(stream->output, 0))
+		return false;
+
+	settings = obs_output_get_settings(stream->output);
+	drop_b = (int64_t)obs_data_get_int(settings, OPT_DROP_THRESHOLD);
+	drop_p = (int64_t)obs_data_get_int(settings, OPT_PFRAME_DROP_THRESHOLD);
+	stream->reconnect_retries =
+		(int)obs_data_get_int(settings, OPT_RECONNECT_RETRIES);
+	stream->reconnect_delay_sec =
+		(int)obs_data_get_int(settings, OPT_RECONNECT_DELAY);
+
+	if (!load_destinations(stream, settings)) {
+		warn("No destinations");
+		obs_data_release(settings);
+		return false;
+	}
+	obs_data_release(settings);
+
+	if (drop_p < (drop_b + 200))
+		drop_p = drop_b + 200;
+
+	stream->drop_threshold_usec = 1000 * drop_b;
+	stream->pframe_drop_threshold_usec = 1000 * drop_p;
+	stream->got_first_video = false;
+	stream->stop_ts = 0;
+	os_atomic_set_bool(&stream->encode_error, false);
+	os_atomic_set_bool(&stream->capturing, false);
+	os_atomic_set_bool(&stream->active, true);
+
+	/* counted as running before any thread starts, so that a thread that
+	 * fails right away doesn't finish the stream for the others */
+	os_atomic_set_long(&stream->running, (long)stream->num_destinations);
+
+	for (size_t i = 0; i < stream->num_destinations; i++) {
+		struct multi_destination *dest = stream->destinations[i];
+
+		dest->thread_created = pthread_create(&dest->thread, NULL,
+						      destination_thread,
+						      dest) == 0;
+		if (!dest->thread_created) {
+			warn("Failed to create thread for destination %d",
+			     (int)i);
+			if (os_atomic_dec_long(&stream->running) == 0)
+				finish_stream(stream);
+		}
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* receiving packets                                                         */
+
+static void drop_tags(struct multi_destination *dest, int highest_priority)
+{
+	struct circlebuf new_buf = {0};
+	int num_dropped = 0;
+
+	circlebuf_reserve(&new_buf, sizeof(struct multi_tag *) * 8);
+
+	while (dest->tags.size) {
+		struct multi_tag *tag;
+		circlebuf_pop_front(&dest->tags, &tag, sizeof(tag));
+
+		/* do not drop audio data or video keyframes */
+		if (tag->type == OBS_ENCODER_AUDIO ||
+		    tag->priority >= highest_priority) {
+			circlebuf_push_back(&new_buf, &tag, sizeof(tag));
+		} else {
+			num_dropped++;
+			release_tag(tag);
+		}
+	}
+
+	circlebuf_free(&dest->tags);
+	dest->tags = new_buf;
+
+	if (dest->min_priority < highest_priority)
+		dest->min_priority = highest_priority;
+
+	dest->dropped_frames += num_dropped;
+}
+
+static bool find_first_video_tag(struct multi_destination *dest,
+				 int64_t *dts_usec)
+{
+	size_t count = num_buffered_tags(dest);
+
+	for (size_t i = 0; i < count; i++) {
+		struct multi_tag *cur = *(struct multi_tag **)circlebuf_data(
+			&dest->tags, i * sizeof(cur));
+		if (cur->type == OBS_ENCODER_VIDEO && !cur->keyframe) {
+			*dts_usec = cur->dts_usec;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* the same thresholds as rtmp_output, applied to this destination's queue
+ * only */
+static void check_to_drop_frames(struct rtmp_multi_stream *stream,
+				 struct multi_destination *dest, bool pframes)
+{
+	int priority = pframes ? OBS_NAL_PRIORITY_HIGHEST
+			       : OBS_NAL_PRIORITY_HIGH;
+	int64_t drop_threshold = pframes ? stream->pframe_drop_threshold_usec
+					 : stream->drop_threshold_usec;
+	int64_t first_dts;
+	int64_t buffer_duration_usec;
+
+	if (num_buffered_tags(dest) < 5) {
+		if (!pframes)
+			dest->congestion = 0.0f;
+		return;
+	}
+
+	if (!find_first_video_tag(dest, &first_dts))
+		return;
+
+	buffer_duration_usec = dest->last_dts_usec - first_dts;
+
+	if (!pframes)
+		dest->congestion =
+			(float)buffer_duration_usec / (float)drop_threshold;
+
+	if (buffer_duration_usec > drop_threshold) {
+		debug("Destination %d: buffer_duration_usec: %" PRId64,
+		      (int)dest->index, buffer_duration_usec);
+		drop_tags(dest, priority);
+	}
+}
+
+static bool add_tag(struct rtmp_multi_stream *stream,
+		    struct multi_destination *dest, struct multi_tag *tag)
+{
+	bool added = false;
+
+	if (!os_atomic_load_bool(&dest->connected))
+		return false;
+
+	pthread_mutex_lock(&dest->tags_mutex);
+
+	/* a destination that just (re)connected starts at a keyframe */
+	if (dest->wait_keyframe) {
+		if (tag->type != OBS_ENCODER_VIDEO || !tag->keyframe)
+			goto unlock;
+		dest->wait_keyframe = false;
+	}
+
+	if (tag->type == OBS_ENCODER_VIDEO) {
+		check_to_drop_frames(stream, dest, false);
+		check_to_drop_frames(stream, dest, true);
+
+		if (tag->priority < dest->min_priority) {
+			dest->dropped_frames++;
+			goto unlock;
+		}
+
+		dest->min_priority = 0;
+		dest->last_dts_usec = tag->dts_usec;
+	}
+
+	circlebuf_push_back(&dest->tags, &tag, sizeof(tag));
+	ref_tag(tag);
+	added = true;
+
+unlock:
+	pthread_mutex_unlock(&dest->tags_mutex);
+	return added;
+}
+
+static struct multi_tag *mux_tag(struct rtmp_multi_stream *stream,
+				 struct encoder_packet *packet)
+{
+	struct multi_tag *tag;
+
+	stream->mux_buf.bytes.num = 0;
+	flv_packet_mux_append(&stream->mux_buf, packet,
+			      (int32_t)stream->start_dts_offset, false);
+
+	tag = bmalloc(sizeof(*tag) + stream->mux_buf.bytes.num);
+	tag->refs = 1;
+	tag->type = packet->type;
+	tag->keyframe = packet->keyframe;
+	tag->priority = packet->drop_priority;
+	tag->dts_usec = packet->dts_usec;
+	tag->sys_dts_usec = packet->sys_dts_usec;
+	tag->size = stream->mux_buf.bytes.num;
+	memcpy(tag->data, stream->mux_buf.bytes.array, tag->size);
+	return tag;
+}
+
+static void rtmp_multi_stream_data(void *data, struct encoder_packet *packet)
+{
+	struct rtmp_multi_stream *stream = data;
+	struct encoder_packet parsed;
+	struct multi_tag *tag;
+
+	if (!active(stream))
+		return;
+
+	/* encoder fail */
+	if (!packet) {
+		os_atomic_set_bool(&stream->encode_error, true);
+		wake_destinations(stream);
+		return;
+	}
+
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		if (!stream->got_first_video) {
+			stream->start_dts_offset =
+				get_ms_time(packet, packet->dts);
+			stream->got_first_video = true;
+		}
+
+		obs_parse_avc_packet(&parsed, packet);
+		tag = mux_tag(stream, &parsed);
+		obs_encoder_packet_release(&parsed);
+	} else {
+		tag = mux_tag(stream, packet);
+	}
+
+	for (size_t i = 0; i < stream->num_destinations; i++) {
+		struct multi_destination *dest = stream->destinations[i];
+
+		if (add_tag(stream, dest, tag))
+			os_sem_post(dest->send_sem);
+	}
+
+	release_tag(tag);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void rtmp_multi_stream_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_int(defaults, OPT_DROP_THRESHOLD, 700);
+	obs_data_set_default_int(defaults, OPT_PFRAME_DROP_THRESHOLD, 900);
+	obs_data_set_default_int(defaults, OPT_RECONNECT_RETRIES, 20);
+	obs_data_set_default_int(defaults, OPT_RECONNECT_DELAY, 2);
+}
+
+static obs_properties_t *rtmp_multi_stream_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
+
+	obs_properties_add_int(props, OPT_DROP_THRESHOLD,
+			       obs_module_text("RTMPStream.DropThreshold"), 200,
+			       10000, 100);
+	obs_properties_add_int(props, OPT_RECONNECT_RETRIES,
+			       obs_module_text("RTMPMultiStream.Retries"), 0,
+			       10000, 1);
+	p = obs_properties_add_int(props, OPT_RECONNECT_DELAY,
+				   obs_module_text("RTMPMultiStream.Delay"), 1,
+				   60, 1);
+	obs_property_int_set_suffix(p, " s");
+
+	return props;
+}
+
+static uint64_t rtmp_multi_stream_total_bytes_sent(void *data)
+{
+	struct rtmp_multi_stream *stream = data;
+	uint64_t total = 0;
+
+	for (size_t i = 0; i < stream->num_destinations; i++)
+		total += (uint64_t)os_atomic_load_long_long(
+			&stream->destinations[i]->total_bytes_sent);
+
+	return total;
+}
+
+static int rtmp_multi_stream_dropped_frames(void *data)
+{
+	struct rtmp_multi_stream *stream = data;
+	int dropped = 0;
+
+	for (size_t i = 0; i < stream->num_destinations; i++)
+		dropped += stream->destinations[i]->dropped_frames;
+
+	return dropped;
+}
+
+/* the most congested destination that is still connected */
+static float rtmp_multi_stream_congestion(void *data)
+{
+	struct rtmp_multi_stream *stream = data;
+	float congestion = 0.0f;
+
+	for (size_t i = 0; i < stream->num_destinations; i++) {
+		struct multi_destination *dest = stream->destinations[i];
+		float cur;
+
+		if (!os_atomic_load_bool(&dest->connected))
+			continue;
+
+		pthread_mutex_lock(&dest->tags_mutex);
+		cur = dest->min_priority > 0 ? 1.0f : dest->congestion;
+		pthread_mutex_unlock(&dest->tags_mutex);
+
+		if (cur > congestion)
+			congestion = cur;
+	}
+
+	return congestion;
+}
+
+static int rtmp_multi_stream_connect_time(void *data)
+{
+	struct rtmp_multi_stream *stream = data;
+	int connect_time = 0;
+
+	for (size_t i = 0; i < stream->num_destinations; i++) {
+		int cur = stream->destinations[i]->rtmp.connect_time_ms;
+		if (cur > connect_time)
+			connect_time = cur;
+	}
+
+	return connect_time;
+}
+
+struct obs_output_info rtmp_multi_output_info = {
+	.id = "rtmp_multi_output",
+	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED,
+	.encoded_video_codecs = "h264",
+	.encoded_audio_codecs = "aac",
+	.get_name = rtmp_multi_stream_getname,
+	.create = rtmp_multi_stream_create,
+	.destroy = rtmp_multi_stream_destroy,
+	.start = rtmp_multi_stream_start,
+	.stop = rtmp_multi_stream_stop,
+	.encoded_packet = rtmp_multi_stream_data,
+	.get_defaults = rtmp_multi_stream_defaults,
+	.get_properties = rtmp_multi_stream_properties,
+	.get_total_bytes = rtmp_multi_stream_total_bytes_sent,
+	.get_congestion = rtmp_multi_stream_congestion,
+	.get_connect_time_ms = rtmp_multi_stream_connect_time,
+	.get_dropped_frames = rtmp_multi_stream_dropped_frames,
+};
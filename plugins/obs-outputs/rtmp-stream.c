@@ -29,11 +29,8 @@
 #define MSEC_TO_NSEC 1000000ULL
 #endif
 
-/* dynamic bitrate coefficients */
-#define DBR_INC_TIMER (30ULL * SEC_TO_NSEC)
-#define DBR_TRIGGER_USEC (200ULL * MSEC_TO_USEC)
-#define MIN_ESTIMATE_DURATION_MS 1000
-#define MAX_ESTIMATE_DURATION_MS 2000
+/* most packets that are muxed into one buffer and written at once */
+#define MAX_SEND_BATCH 32
 
 static const char *rtmp_stream_getname(void *unused)
 {
@@ -110,6 +107,10 @@ static void rtmp_stream_destroy(void *data)
 		}
 	}
 
+	obs_task_group_destroy(stream->tasks);
+	pthread_mutex_destroy(&stream->addr_mutex);
+	dstr_free(&stream->addr_host);
+
 	RTMP_TLS_Free(&stream->rtmp);
 	free_packets(stream);
 	dstr_free(&stream->path);
@@ -122,11 +123,14 @@ static void rtmp_stream_destroy(void *data)
 	os_sem_destroy(stream->send_sem);
 	pthread_mutex_destroy(&stream->packets_mutex);
 	circlebuf_free(&stream->packets);
+	array_output_serializer_free(&stream->send_buf);
+	da_free(stream->send_batch);
 #ifdef TEST_FRAMEDROPS
 	circlebuf_free(&stream->droptest_info);
 #endif
-	circlebuf_free(&stream->dbr_frames);
-	pthread_mutex_destroy(&stream->dbr_mutex);
+	bitrate_control_free(&stream->dbr);
+	if (stream->netem_enabled)
+		net_emulator_free(&stream->netem);
 
 	os_event_destroy(stream->buffer_space_available_event);
 	os_event_destroy(stream->buffer_has_data_event);
@@ -144,6 +148,7 @@ static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 	struct rtmp_stream *stream = bzalloc(sizeof(struct rtmp_stream));
 	stream->output = output;
 	pthread_mutex_init_value(&stream->packets_mutex);
+	pthread_mutex_init_value(&stream->addr_mutex);
 
 	RTMP_LogSetCallback(log_rtmp);
 	RTMP_Init(&stream->rtmp);
@@ -153,16 +158,22 @@ static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 		goto fail;
 	if (os_event_init(&stream->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
+	if (pthread_mutex_init(&stream->addr_mutex, NULL) != 0)
+		goto fail;
+
+	stream->tasks = obs_task_group_create();
 
 	if (pthread_mutex_init(&stream->write_buf_mutex, NULL) != 0) {
 		warn("Failed to initialize write buffer mutex");
 		goto fail;
 	}
 
-	if (pthread_mutex_init(&stream->dbr_mutex, NULL) != 0) {
+	if (!bitrate_control_init(&stream->dbr)) {
 		warn("Failed to initialize dbr mutex");
 		goto fail;
 	}
+	bitrate_control_add_proc(&stream->dbr, output);
+	stream->dbr.scale_resolution = true;
 
 	if (os_event_init(&stream->buffer_space_available_event,
 			  OS_EVENT_TYPE_AUTO) != 0) {
@@ -249,6 +260,30 @@ static inline bool get_next_packet(struct rtmp_stream *stream,
 	return new_packet;
 }
 
+/* takes packets that are already queued up behind the first one, as long as
+ * they go to the same stream, so they can be sent together */
+static void get_more_packets(struct rtmp_stream *stream, size_t idx)
+{
+	pthread_mutex_lock(&stream->packets_mutex);
+
+	while (stream->send_batch.num < MAX_SEND_BATCH &&
+	       stream->packets.size) {
+		struct encoder_packet *next =
+			circlebuf_data(&stream->packets, 0);
+		if (next->track_idx != idx)
+			break;
+		/* new headers go out in front of it, see send_thread */
+		if (next->headers_changed)
+			break;
+
+		da_push_back(stream->send_batch, next);
+		circlebuf_pop_front(&stream->packets, NULL,
+				    sizeof(struct encoder_packet));
+	}
+
+	pthread_mutex_unlock(&stream->packets_mutex);
+}
+
 static bool discard_recv_data(struct rtmp_stream *stream, size_t size)
 {
 	RTMP *rtmp = &stream->rtmp;
@@ -398,11 +433,23 @@ retry_send:
 	return len;
 }
 
-static int send_packet(struct rtmp_stream *stream,
-		       struct encoder_packet *packet, bool is_header,
-		       size_t idx)
+/* blocks for as long as the emulated link would, see net-emulator.h */
+static void emulate_send(struct rtmp_stream *stream, size_t size)
+{
+	uint64_t wait = net_emulator_send(&stream->netem, size, os_gettime_ns());
+
+	if (wait >= MSEC_TO_NSEC)
+		os_event_timedwait(stream->stop_event,
+				   (unsigned long)(wait / MSEC_TO_NSEC));
+}
+
+/* muxes all packets into the reused send buffer so librtmp can write their
+ * chunks out together, then releases them */
+static int send_packets(struct rtmp_stream *stream,
+			struct encoder_packet *packets, size_t num,
+			bool is_header, size_t idx)
 {
-	uint8_t *data;
+	int32_t dts_offset = is_header ? 0 : (int32_t)stream->start_dts_offset;
 	size_t size;
 	int recv_size = 0;
 	int ret = 0;
@@ -423,32 +470,51 @@ static int send_packet(struct rtmp_stream *stream,
 		}
 	}
 
-	if (idx > 0) {
-		flv_additional_packet_mux(
-			packet, is_header ? 0 : stream->start_dts_offset, &data,
-			&size, is_header, idx);
-	} else {
-		flv_packet_mux(packet, is_header ? 0 : stream->start_dts_offset,
-			       &data, &size, is_header);
+	stream->send_buf.bytes.num = 0;
+
+	for (size_t i = 0; i < num; i++) {
+		if (idx > 0)
+			flv_additional_packet_mux_append(&stream->send_buf,
+							 &packets[i],
+							 dts_offset, is_header,
+							 idx);
+		else
+			flv_packet_mux_append(&stream->send_buf, &packets[i],
+					      dts_offset, is_header);
 	}
 
+	size = stream->send_buf.bytes.num;
+
 #ifdef TEST_FRAMEDROPS
 	droptest_cap_data_rate(stream, size);
 #endif
+	if (stream->netem_enabled)
+		emulate_send(stream, size);
 
-	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
-	bfree(data);
+	ret = RTMP_Write(&stream->rtmp, (char *)stream->send_buf.bytes.array,
+			 (int)size, 0);
 
-	if (is_header)
-		bfree(packet->data);
-	else
-		obs_encoder_packet_release(packet);
+	for (size_t i = 0; i < num; i++) {
+		if (is_header)
+			bfree(packets[i].data);
+		else
+			obs_encoder_packet_release(&packets[i]);
+	}
 
 	stream->total_bytes_sent += size;
 	return ret;
 }
 
+static inline int send_packet(struct rtmp_stream *stream,
+			      struct encoder_packet *packet, bool is_header,
+			      size_t idx)
+{
+	return send_packets(stream, packet, 1, is_header, idx);
+}
+
 static inline bool send_headers(struct rtmp_stream *stream);
+static bool send_video_header(struct rtmp_stream *stream,
+			      struct encoder_packet *keyframe);
 
 static inline bool can_shutdown_stream(struct rtmp_stream *stream,
 				       struct encoder_packet *packet)
@@ -536,38 +602,122 @@ static void set_output_error(struct rtmp_stream *stream)
 		obs_output_set_last_error(stream->output, msg);
 }
 
-static void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *back)
+/* how long the address of the last connection is used before it is
+ * resolved again */
+#define ADDR_REFRESH_SEC 60
+
+struct resolve_task {
+	struct rtmp_stream *stream;
+	char *host;
+	int port;
+	int addrlen_hint;
+};
+
+static void resolve_task(void *param)
 {
-	struct dbr_frame front;
-	uint64_t dur;
+	struct resolve_task *task = param;
+	struct rtmp_stream *stream = task->stream;
+	AVal host = {task->host, (int)strlen(task->host)};
+	RTMP_BINDINFO addr;
+
+	if (RTMP_ResolveHost(&host, task->port, task->addrlen_hint, &addr)) {
+		pthread_mutex_lock(&stream->addr_mutex);
+		if (dstr_cmp(&stream->addr_host, task->host) == 0 &&
+		    stream->addr_port == task->port)
+			stream->addr = addr;
+		pthread_mutex_unlock(&stream->addr_mutex);
+	}
+
+	bfree(task->host);
+	bfree(task);
+}
 
-	circlebuf_push_back(&stream->dbr_frames, back, sizeof(*back));
-	circlebuf_peek_front(&stream->dbr_frames, &front, sizeof(front));
+/* resolves in the background, the send thread can't wait on DNS */
+static void refresh_addr(struct rtmp_stream *stream)
+{
+	uint64_t now = os_gettime_ns();
+	struct resolve_task *task;
 
-	stream->dbr_data_size += back->size;
+	if (!stream->tasks || !obs_get_pool_threads())
+		return;
 
-	dur = (back->send_end - front.send_beg) / 1000000;
+	pthread_mutex_lock(&stream->addr_mutex);
 
-	if (dur >= MAX_ESTIMATE_DURATION_MS) {
-		stream->dbr_data_size -= front.size;
-		circlebuf_pop_front(&stream->dbr_frames, NULL, sizeof(front));
+	if (dstr_is_empty(&stream->addr_host) ||
+	    now < stream->addr_refresh_ts) {
+		pthread_mutex_unlock(&stream->addr_mutex);
+		return;
 	}
 
-	stream->dbr_est_bitrate =
-		(dur >= MIN_ESTIMATE_DURATION_MS)
-			? (long)(stream->dbr_data_size * 1000 / dur)
-			: 0;
-	stream->dbr_est_bitrate *= 8;
-	stream->dbr_est_bitrate /= 1000;
-
-	if (stream->dbr_est_bitrate) {
-		stream->dbr_est_bitrate -= stream->audio_bitrate;
-		if (stream->dbr_est_bitrate < 50)
-			stream->dbr_est_bitrate = 50;
-	}
+	task = bzalloc(sizeof(struct resolve_task));
+	task->stream = stream;
+	task->host = bstrdup(stream->addr_host.array);
+	task->port = stream->addr_port;
+	task->addrlen_hint = stream->rtmp.m_bindIP.addrLen;
+	stream->addr_refresh_ts = now + ADDR_REFRESH_SEC * SEC_TO_NSEC;
+
+	pthread_mutex_unlock(&stream->addr_mutex);
+
+	obs_task_group_queue(stream->tasks, OBS_TASK_PRIORITY_LOW, resolve_task,
+			     task);
+}
+
+static bool use_cached_addr(struct rtmp_stream *stream)
+{
+	RTMP *r = &stream->rtmp;
+	AVal *host = &r->Link.hostname;
+	bool found;
+
+	memset(&r->m_connectAddr, 0, sizeof(r->m_connectAddr));
+	if (r->Link.socksport)
+		return false;
+
+	pthread_mutex_lock(&stream->addr_mutex);
+
+	found = stream->addr.addrLen && stream->addr_port == r->Link.port &&
+		stream->addr_host.len == (size_t)host->av_len &&
+		strncmp(stream->addr_host.array, host->av_val,
+			host->av_len) == 0 &&
+		(!r->m_bindIP.addrLen ||
+		 r->m_bindIP.addrLen == stream->addr.addrLen);
+	if (found)
+		r->m_connectAddr = stream->addr;
+
+	pthread_mutex_unlock(&stream->addr_mutex);
+	return found;
+}
+
+static void forget_addr(struct rtmp_stream *stream)
+{
+	pthread_mutex_lock(&stream->addr_mutex);
+	memset(&stream->addr, 0, sizeof(stream->addr));
+	pthread_mutex_unlock(&stream->addr_mutex);
 }
 
-static void dbr_set_bitrate(struct rtmp_stream *stream);
+/* keeps the address that was actually connected to */
+static void cache_addr(struct rtmp_stream *stream)
+{
+	RTMP *r = &stream->rtmp;
+	RTMP_BINDINFO addr = {0};
+	socklen_t len = sizeof(addr.addr);
+
+	if (r->Link.socksport)
+		return;
+	if (getpeername(r->m_sb.sb_socket, (struct sockaddr *)&addr.addr,
+			&len) != 0)
+		return;
+
+	addr.addrLen = (int)len;
+
+	pthread_mutex_lock(&stream->addr_mutex);
+	dstr_ncopy(&stream->addr_host, r->Link.hostname.av_val,
+		   r->Link.hostname.av_len);
+	stream->addr_port = r->Link.port;
+	stream->addr = addr;
+	stream->addr_refresh_ts =
+		os_gettime_ns() + ADDR_REFRESH_SEC * SEC_TO_NSEC;
+	pthread_mutex_unlock(&stream->addr_mutex);
+}
 
 static void *send_thread(void *data)
 {
@@ -577,7 +727,8 @@ static void *send_thread(void *data)
 
 	while (os_sem_wait(stream->send_sem) == 0) {
 		struct encoder_packet packet;
-		struct dbr_frame dbr_frame;
+		uint64_t send_beg = 0;
+		size_t send_size = 0;
 
 		if (stopping(stream) && stream->stop_ts == 0) {
 			break;
@@ -593,30 +744,45 @@ static void *send_thread(void *data)
 			}
 		}
 
+		refresh_addr(stream);
+
 		if (!stream->sent_headers) {
 			if (!send_headers(stream)) {
 				os_atomic_set_bool(&stream->disconnected, true);
 				break;
 			}
+		} else if (packet.headers_changed) {
+			info("Video headers changed, sending the new ones");
+			if (!send_video_header(stream, &packet)) {
+				os_atomic_set_bool(&stream->disconnected, true);
+				break;
+			}
 		}
 
+		stream->send_batch.num = 0;
+		da_push_back(stream->send_batch, &packet);
+
+		/* when stopping, each packet has to be checked against the
+		 * stop time */
+		if (!stopping(stream))
+			get_more_packets(stream, packet.track_idx);
+
 		if (stream->dbr_enabled) {
-			dbr_frame.send_beg = os_gettime_ns();
-			dbr_frame.size = packet.size;
+			send_beg = os_gettime_ns();
+			for (size_t i = 0; i < stream->send_batch.num; i++)
+				send_size += stream->send_batch.array[i].size;
 		}
 
-		if (send_packet(stream, &packet, false, packet.track_idx) < 0) {
+		if (send_packets(stream, stream->send_batch.array,
+				 stream->send_batch.num, false,
+				 packet.track_idx) < 0) {
 			os_atomic_set_bool(&stream->disconnected, true);
 			break;
 		}
 
-		if (stream->dbr_enabled) {
-			dbr_frame.send_end = os_gettime_ns();
-
-			pthread_mutex_lock(&stream->dbr_mutex);
-			dbr_add_frame(stream, &dbr_frame);
-			pthread_mutex_unlock(&stream->dbr_mutex);
-		}
+		if (stream->dbr_enabled)
+			bitrate_control_add_send(&stream->dbr, send_size,
+						 send_beg, os_gettime_ns());
 	}
 
 	bool encode_error = os_atomic_load_bool(&stream->encode_error);
@@ -655,11 +821,10 @@ static void *send_thread(void *data)
 	stream->sent_headers = false;
 
 	/* reset bitrate on stop */
-	if (stream->dbr_enabled) {
-		if (stream->dbr_cur_bitrate != stream->dbr_orig_bitrate) {
-			stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
-			dbr_set_bitrate(stream);
-		}
+	if (stream->dbr_enabled && bitrate_control_reset(&stream->dbr)) {
+		bitrate_control_apply(
+			&stream->dbr,
+			obs_output_get_video_encoder(stream->output));
 	}
 
 	return NULL;
@@ -713,7 +878,10 @@ static bool send_audio_header(struct rtmp_stream *stream, size_t idx,
 	return send_packet(stream, &packet, true, idx) >= 0;
 }
 
-static bool send_video_header(struct rtmp_stream *stream)
+/* keyframe is the packet the headers are sent in front of after the encoder
+ * changed them mid-stream, or NULL for the headers at the start */
+static bool send_video_header(struct rtmp_stream *stream,
+			      struct encoder_packet *keyframe)
 {
 	obs_output_t *context = stream->output;
 	obs_encoder_t *vencoder = obs_output_get_video_encoder(context);
@@ -723,6 +891,14 @@ static bool send_video_header(struct rtmp_stream *stream)
 	struct encoder_packet packet = {
 		.type = OBS_ENCODER_VIDEO, .timebase_den = 1, .keyframe = true};
 
+	/* headers are sent without the start offset */
+	if (keyframe) {
+		packet.timebase_den = MILLISECOND_DEN;
+		packet.dts = get_ms_time(keyframe, keyframe->dts) -
+			     stream->start_dts_offset;
+		packet.pts = packet.dts;
+	}
+
 	obs_encoder_get_extra_data(vencoder, &header, &size);
 	packet.size = obs_parse_avc_header(&packet.data, header, size);
 	return send_packet(stream, &packet, true, 0) >= 0;
@@ -736,7 +912,7 @@ static inline bool send_headers(struct rtmp_stream *stream)
 
 	if (!send_audio_header(stream, i++, &next))
 		return false;
-	if (!send_video_header(stream))
+	if (!send_video_header(stream, NULL))
 		return false;
 
 	while (next) {
@@ -785,6 +961,9 @@ static int init_send(struct rtmp_stream *stream)
 
 	reset_semaphore(stream);
 
+	if (stream->netem_enabled)
+		net_emulator_start(&stream->netem, os_gettime_ns());
+
 	ret = pthread_create(&stream->send_thread, NULL, send_thread, stream);
 	if (ret != 0) {
 		RTMP_Close(&stream->rtmp);
@@ -962,6 +1141,8 @@ static void win32_log_interface_type(struct rtmp_stream *stream)
 
 static int try_connect(struct rtmp_stream *stream)
 {
+	bool cached_addr;
+
 	if (dstr_is_empty(&stream->path)) {
 		warn("URL is empty");
 		return OBS_OUTPUT_BAD_PATH;
@@ -1016,11 +1197,20 @@ static int try_connect(struct rtmp_stream *stream)
 	win32_log_interface_type(stream);
 #endif
 
+	cached_addr = use_cached_addr(stream);
+	if (cached_addr)
+		info("Using the address of the previous connection");
+
 	if (!RTMP_Connect(&stream->rtmp, NULL)) {
+		/* resolved again on the next attempt */
+		if (cached_addr)
+			forget_addr(stream);
 		set_output_error(stream);
 		return OBS_OUTPUT_CONNECT_FAILED;
 	}
 
+	cache_addr(stream);
+
 	if (!RTMP_ConnectStream(&stream->rtmp, 0))
 		return OBS_OUTPUT_INVALID_STREAM;
 
@@ -1029,6 +1219,28 @@ static int try_connect(struct rtmp_stream *stream)
 	return init_send(stream);
 }
 
+static void init_net_emulation(struct rtmp_stream *stream,
+			       obs_data_t *settings)
+{
+	const char *profile = obs_data_get_string(settings, OPT_NET_EMULATION);
+
+	if (stream->netem_enabled) {
+		net_emulator_free(&stream->netem);
+		stream->netem_enabled = false;
+	}
+
+	if (!*profile)
+		profile = getenv("OBS_NET_EMULATION");
+	if (!profile || !*profile)
+		return;
+
+	stream->netem_enabled = net_emulator_init(&stream->netem, profile);
+	if (stream->netem_enabled)
+		warn("Emulating network conditions: %s", profile);
+	else
+		warn("Invalid network emulation profile: %s", profile);
+}
+
 static bool init_connect(struct rtmp_stream *stream)
 {
 	obs_service_t *service;
@@ -1072,14 +1284,6 @@ static bool init_connect(struct rtmp_stream *stream)
 	obs_data_t *vsettings = obs_encoder_get_settings(venc);
 	obs_data_t *asettings = obs_encoder_get_settings(aenc);
 
-	circlebuf_free(&stream->dbr_frames);
-	stream->audio_bitrate = (long)obs_data_get_int(asettings, "bitrate");
-	stream->dbr_data_size = 0;
-	stream->dbr_orig_bitrate = (long)obs_data_get_int(vsettings, "bitrate");
-	stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
-	stream->dbr_est_bitrate = 0;
-	stream->dbr_inc_bitrate = stream->dbr_orig_bitrate / 10;
-	stream->dbr_inc_timeout = 0;
 	stream->dbr_enabled = obs_data_get_bool(settings, OPT_DYN_BITRATE);
 
 	caps = obs_encoder_get_caps(venc);
@@ -1093,6 +1297,12 @@ static bool init_connect(struct rtmp_stream *stream)
 
 	if (stream->dbr_enabled) {
 		info("Dynamic bitrate enabled.  Dropped frames begone!");
+		bitrate_control_start(
+			&stream->dbr,
+			obs_data_get_string(settings,
+					    OPT_DYN_BITRATE_ESTIMATOR),
+			(long)obs_data_get_int(vsettings, "bitrate"),
+			(long)obs_data_get_int(asettings, "bitrate"));
 	}
 
 	obs_data_release(vsettings);
@@ -1112,6 +1322,8 @@ static bool init_connect(struct rtmp_stream *stream)
 	stream->low_latency_mode =
 		obs_data_get_bool(settings, OPT_LOWLATENCY_ENABLED);
 
+	init_net_emulation(stream, settings);
+
 	obs_data_release(settings);
 	return true;
 }
@@ -1209,6 +1421,7 @@ static void drop_frames(struct rtmp_stream *stream, const char *name,
 		return;
 
 	stream->dropped_frames += num_frames_dropped;
+	profiler_trace_trigger("dropped frames");
 #ifdef _DEBUG
 	debug("Dropped %s, prev packet count: %d, new packet count: %d", name,
 	      start_packets, (int)num_buffered_packets(stream));
@@ -1232,93 +1445,25 @@ static bool find_first_video_packet(struct rtmp_stream *stream,
 	return false;
 }
 
-static bool dbr_bitrate_lowered(struct rtmp_stream *stream)
-{
-	long prev_bitrate = stream->dbr_prev_bitrate;
-	long est_bitrate = 0;
-	long new_bitrate;
-
-	if (stream->dbr_est_bitrate &&
-	    stream->dbr_est_bitrate < stream->dbr_cur_bitrate) {
-		stream->dbr_data_size = 0;
-		circlebuf_pop_front(&stream->dbr_frames, NULL,
-				    stream->dbr_frames.size);
-		est_bitrate = stream->dbr_est_bitrate / 100 * 100;
-		if (est_bitrate < 50) {
-			est_bitrate = 50;
-		}
-	}
-
-#if 0
-	if (prev_bitrate && est_bitrate) {
-		if (prev_bitrate < est_bitrate) {
-			blog(LOG_INFO, "going back to prev bitrate: "
-					"prev_bitrate (%d) < est_bitrate (%d)",
-					prev_bitrate,
-					est_bitrate);
-			new_bitrate = prev_bitrate;
-		} else {
-			new_bitrate = est_bitrate;
-		}
-		new_bitrate = est_bitrate;
-	} else if (prev_bitrate) {
-		new_bitrate = prev_bitrate;
-		info("going back to prev bitrate");
-
-	} else if (est_bitrate) {
-		new_bitrate = est_bitrate;
-
-	} else {
-		return false;
-	}
-#else
-	if (est_bitrate) {
-		new_bitrate = est_bitrate;
-
-	} else if (prev_bitrate) {
-		new_bitrate = prev_bitrate;
-		info("going back to prev bitrate");
-
-	} else {
-		return false;
-	}
-
-	if (new_bitrate == stream->dbr_cur_bitrate) {
-		return false;
-	}
-#endif
-
-	stream->dbr_prev_bitrate = 0;
-	stream->dbr_cur_bitrate = new_bitrate;
-	stream->dbr_inc_timeout = os_gettime_ns() + DBR_INC_TIMER;
-	info("bitrate decreased to: %ld", stream->dbr_cur_bitrate);
-	return true;
-}
-
-static void dbr_set_bitrate(struct rtmp_stream *stream)
-{
-	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
-	obs_data_t *settings = obs_encoder_get_settings(vencoder);
-
-	obs_data_set_int(settings, "bitrate", stream->dbr_cur_bitrate);
-	obs_encoder_update(vencoder, settings);
-
-	obs_data_release(settings);
-}
-
-static void dbr_inc_bitrate(struct rtmp_stream *stream)
+static void dbr_update(struct rtmp_stream *stream,
+		       int64_t buffer_duration_usec)
 {
-	stream->dbr_prev_bitrate = stream->dbr_cur_bitrate;
-	stream->dbr_cur_bitrate += stream->dbr_inc_bitrate;
-
-	if (stream->dbr_cur_bitrate >= stream->dbr_orig_bitrate) {
-		stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
-		info("bitrate increased to: %ld, done",
-		     stream->dbr_cur_bitrate);
-	} else if (stream->dbr_cur_bitrate < stream->dbr_orig_bitrate) {
-		stream->dbr_inc_timeout = os_gettime_ns() + DBR_INC_TIMER;
-		info("bitrate increased to: %ld, waiting",
-		     stream->dbr_cur_bitrate);
+	struct bitrate_signals signals;
+
+	bitrate_signals_init(&signals);
+	signals.queue_usec = buffer_duration_usec;
+	bitrate_signals_query_socket(&signals,
+				     (intptr_t)stream->rtmp.m_sb.sb_socket);
+	if (stream->netem_enabled)
+		net_emulator_get_signals(&stream->netem, os_gettime_ns(),
+					 &signals);
+
+	if (bitrate_control_update(&stream->dbr, &signals)) {
+		debug("buffer_duration_msec: %" PRId64,
+		      buffer_duration_usec / 1000);
+		bitrate_control_apply(
+			&stream->dbr,
+			obs_output_get_video_encoder(stream->output));
 	}
 }
 
@@ -1333,21 +1478,12 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 	int64_t drop_threshold = pframes ? stream->pframe_drop_threshold_usec
 					 : stream->drop_threshold_usec;
 
-	if (!pframes && stream->dbr_enabled) {
-		if (stream->dbr_inc_timeout) {
-			uint64_t t = os_gettime_ns();
-
-			if (t >= stream->dbr_inc_timeout) {
-				stream->dbr_inc_timeout = 0;
-				dbr_inc_bitrate(stream);
-				dbr_set_bitrate(stream);
-			}
-		}
-	}
-
 	if (num_packets < 5) {
-		if (!pframes)
+		if (!pframes) {
 			stream->congestion = 0.0f;
+			if (stream->dbr_enabled)
+				dbr_update(stream, 0);
+		}
 		return;
 	}
 
@@ -1368,23 +1504,8 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 	 * but let's test without dropping frames
 	 * at all first */
 	if (stream->dbr_enabled) {
-		bool bitrate_changed = false;
-
-		if (pframes) {
-			return;
-		}
-
-		if ((uint64_t)buffer_duration_usec >= DBR_TRIGGER_USEC) {
-			pthread_mutex_lock(&stream->dbr_mutex);
-			bitrate_changed = dbr_bitrate_lowered(stream);
-			pthread_mutex_unlock(&stream->dbr_mutex);
-		}
-
-		if (bitrate_changed) {
-			debug("buffer_duration_msec: %" PRId64,
-			      buffer_duration_usec / 1000);
-			dbr_set_bitrate(stream);
-		}
+		if (!pframes)
+			dbr_update(stream, buffer_duration_usec);
 		return;
 	}
 
@@ -8,6 +8,8 @@
 #include "librtmp/rtmp.h"
 #include "librtmp/log.h"
 #include "flv-mux.h"
+#include "bitrate-control.h"
+#include "net-emulator.h"
 #include "net-if.h"
 
 #ifdef _WIN32
@@ -47,12 +49,6 @@ struct droptest_info {
 };
 #endif
 
-struct dbr_frame {
-	uint64_t send_beg;
-	uint64_t send_end;
-	size_t size;
-};
-
 struct rtmp_stream {
 	obs_output_t *output;
 
@@ -60,6 +56,10 @@ struct rtmp_stream {
 	struct circlebuf packets;
 	bool sent_headers;
 
+	/* reused by every send, see send_packets() */
+	struct array_output_data send_buf;
+	DARRAY(struct encoder_packet) send_batch;
+
 	bool got_first_video;
 	int64_t start_dts_offset;
 
@@ -83,6 +83,16 @@ struct rtmp_stream {
 	struct dstr encoder_name;
 	struct dstr bind_ip;
 
+	/* address of the ingest server, taken from the last connection and
+	 * resolved again in the background while live, so reconnecting does
+	 * not wait on DNS */
+	pthread_mutex_t addr_mutex;
+	struct dstr addr_host;
+	int addr_port;
+	RTMP_BINDINFO addr;
+	uint64_t addr_refresh_ts;
+	obs_task_group_t *tasks;
+
 	/* frame drop variables */
 	int64_t drop_threshold_usec;
 	int64_t pframe_drop_threshold_usec;
@@ -101,18 +111,12 @@ struct rtmp_stream {
 	size_t droptest_size;
 #endif
 
-	pthread_mutex_t dbr_mutex;
-	struct circlebuf dbr_frames;
-	size_t dbr_data_size;
-	uint64_t dbr_inc_timeout;
-	long audio_bitrate;
-	long dbr_est_bitrate;
-	long dbr_orig_bitrate;
-	long dbr_prev_bitrate;
-	long dbr_cur_bitrate;
-	long dbr_inc_bitrate;
+	struct bitrate_control dbr;
 	bool dbr_enabled;
 
+	struct net_emulator netem;
+	bool netem_enabled;
+
 	RTMP rtmp;
 
 	bool new_socket_loop;
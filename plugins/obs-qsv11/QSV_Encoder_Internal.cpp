@@ -80,7 +80,9 @@ QSV_Encoder_Internal::QSV_Encoder_Internal(mfxIMPL &impl, mfxVersion &version)
 	  m_pTaskPool(NULL),
 	  m_nTaskIdx(0),
 	  m_nFirstSyncTask(0),
-	  m_outBitstream()
+	  m_outBitstream(),
+	  m_encodeCtrl(),
+	  m_bForceKeyframe(false)
 {
 	mfxIMPL tempImpl;
 	mfxStatus sts;
@@ -503,6 +505,62 @@ int QSV_Encoder_Internal::GetFreeTaskIndex(Task *pTaskPool, mfxU16 nPoolSize)
 	return MFX_ERR_NOT_FOUND;
 }
 
+mfxStatus QSV_Encoder_Internal::ResetEncoder(qsv_param_t *pParams)
+{
+	mfxStatus sts = Drain();
+	MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+	InitParams(pParams);
+
+	// Start a new sequence, so the new parameters apply from an IDR
+	// frame on
+	mfxExtEncoderResetOption resetOption;
+	memset(&resetOption, 0, sizeof(resetOption));
+	resetOption.Header.BufferId = MFX_EXTBUFF_ENCODER_RESET_OPTION;
+	resetOption.Header.BufferSz = sizeof(resetOption);
+	resetOption.StartNewSequence = MFX_CODINGOPTION_ON;
+
+	mfxExtBuffer *extendedBuffers[4];
+	mfxExtBuffer **pPrevExtParam = m_mfxEncParams.ExtParam;
+	mfxU16 nPrevExtParam = m_mfxEncParams.NumExtParam;
+
+	for (mfxU16 i = 0; i < nPrevExtParam; i++)
+		extendedBuffers[i] = pPrevExtParam[i];
+	extendedBuffers[nPrevExtParam] = (mfxExtBuffer *)&resetOption;
+
+	m_mfxEncParams.ExtParam = extendedBuffers;
+	m_mfxEncParams.NumExtParam = nPrevExtParam + 1;
+
+	sts = m_pmfxENC->Reset(&m_mfxEncParams);
+
+	m_mfxEncParams.ExtParam = pPrevExtParam;
+	m_mfxEncParams.NumExtParam = nPrevExtParam;
+
+	MSDK_IGNORE_MFX_STS(sts, MFX_WRN_INCOMPATIBLE_VIDEO_PARAM);
+	MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
+
+	return GetVideoParam();
+}
+
+void QSV_Encoder_Internal::RequestKeyframe()
+{
+	m_bForceKeyframe = true;
+}
+
+mfxEncodeCtrl *QSV_Encoder_Internal::GetEncodeCtrl()
+{
+	if (!m_bForceKeyframe)
+		return NULL;
+
+	// The control is read when the frame is submitted, so one member
+	// is enough
+	m_bForceKeyframe = false;
+	memset(&m_encodeCtrl, 0, sizeof(m_encodeCtrl));
+	m_encodeCtrl.FrameType = MFX_FRAMETYPE_I | MFX_FRAMETYPE_REF |
+				 MFX_FRAMETYPE_IDR;
+	return &m_encodeCtrl;
+}
+
 mfxStatus QSV_Encoder_Internal::Encode(uint64_t ts, uint8_t *pDataY,
 				       uint8_t *pDataUV, uint32_t strideY,
 				       uint32_t strideUV, mfxBitstream **pBS)
@@ -577,9 +635,11 @@ mfxStatus QSV_Encoder_Internal::Encode(uint64_t ts, uint8_t *pDataY,
 		MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 	}
 
+	mfxEncodeCtrl *pCtrl = GetEncodeCtrl();
+
 	for (;;) {
 		// Encode a frame asynchronously (returns immediately)
-		sts = m_pmfxENC->EncodeFrameAsync(NULL, pSurface,
+		sts = m_pmfxENC->EncodeFrameAsync(pCtrl, pSurface,
 						  &m_pTaskPool[nTaskIdx].mfxBS,
 						  &m_pTaskPool[nTaskIdx].syncp);
 
@@ -641,9 +701,11 @@ mfxStatus QSV_Encoder_Internal::Encode_tex(uint64_t ts, uint32_t tex_handle,
 		MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 	}
 
+	mfxEncodeCtrl *pCtrl = GetEncodeCtrl();
+
 	for (;;) {
 		// Encode a frame asynchronously (returns immediately)
-		sts = m_pmfxENC->EncodeFrameAsync(NULL, pSurface,
+		sts = m_pmfxENC->EncodeFrameAsync(pCtrl, pSurface,
 						  &m_pTaskPool[nTaskIdx].mfxBS,
 						  &m_pTaskPool[nTaskIdx].syncp);
 
@@ -730,7 +792,19 @@ mfxStatus QSV_Encoder_Internal::ClearData()
 
 mfxStatus QSV_Encoder_Internal::Reset(qsv_param_t *pParams)
 {
-	mfxStatus sts = ClearData();
+	mfxStatus sts;
+
+	// Resetting the encoder keeps the session and the surfaces, which
+	// works as long as the frames keep their size
+	if (m_pmfxENC &&
+	    pParams->nWidth == m_mfxEncParams.mfx.FrameInfo.CropW &&
+	    pParams->nHeight == m_mfxEncParams.mfx.FrameInfo.CropH) {
+		sts = ResetEncoder(pParams);
+		if (sts == MFX_ERR_NONE)
+			return sts;
+	}
+
+	sts = ClearData();
 	MSDK_CHECK_RESULT(sts, MFX_ERR_NONE, sts);
 
 	sts = Open(pParams);
@@ -75,6 +75,7 @@ public:
 			     mfxBitstream **pBS);
 	mfxStatus ClearData();
 	mfxStatus Reset(qsv_param_t *pParams);
+	void RequestKeyframe();
 
 protected:
 	bool InitParams(qsv_param_t *pParams);
@@ -86,6 +87,8 @@ protected:
 			   uint32_t strideUV);
 	mfxStatus Drain();
 	int GetFreeTaskIndex(Task *pTaskPool, mfxU16 nPoolSize);
+	mfxEncodeCtrl *GetEncodeCtrl();
+	mfxStatus ResetEncoder(qsv_param_t *pParams);
 
 private:
 	mfxIMPL m_impl;
@@ -110,6 +113,8 @@ private:
 	int m_nTaskIdx;
 	int m_nFirstSyncTask;
 	mfxBitstream m_outBitstream;
+	mfxEncodeCtrl m_encodeCtrl;
+	bool m_bForceKeyframe;
 	bool m_bIsWindows8OrGreater;
 	bool m_bUseD3D11;
 	bool m_bD3D9HACK;
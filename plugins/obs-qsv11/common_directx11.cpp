@@ -27,6 +27,24 @@ typedef struct {
 	mfxU16 rw;
 } CustomMemId;
 
+// Shared encode textures opened from their handles. libobs cycles through a
+// small fixed set of textures, so each handle is only opened once.
+struct SharedTexture {
+	ID3D11Texture2D *tex;
+	IDXGIKeyedMutex *km;
+};
+
+std::map<mfxU32, SharedTexture> sharedTextures;
+
+static void ReleaseSharedTextures()
+{
+	for (auto &it : sharedTextures) {
+		it.second.km->Release();
+		it.second.tex->Release();
+	}
+	sharedTextures.clear();
+}
+
 const struct {
 	mfxIMPL impl;     // actual implementation
 	mfxU32 adapterID; // device adapter number
@@ -123,6 +141,8 @@ void SetHWDeviceContext(CComPtr<ID3D11DeviceContext> devCtx)
 // Free HW device context
 void CleanupHWDevice()
 {
+	ReleaseSharedTextures();
+
 	if (g_pAdapter) {
 		g_pAdapter->Release();
 		g_pAdapter = NULL;
@@ -445,23 +465,35 @@ mfxStatus simple_copytex(mfxHDL pthis, mfxMemId mid, mfxU32 tex_handle,
 	ID3D11Texture2D *input_tex;
 	HRESULT hr;
 
-	hr = g_pD3D11Device->OpenSharedResource((HANDLE)(uintptr_t)tex_handle,
-						IID_ID3D11Texture2D,
-						(void **)&input_tex);
-	if (FAILED(hr)) {
-		return MFX_ERR_INVALID_HANDLE;
+	auto it = sharedTextures.find(tex_handle);
+	if (it != sharedTextures.end()) {
+		input_tex = it->second.tex;
+		km = it->second.km;
+	} else {
+		hr = g_pD3D11Device->OpenSharedResource(
+			(HANDLE)(uintptr_t)tex_handle, IID_ID3D11Texture2D,
+			(void **)&input_tex);
+		if (FAILED(hr)) {
+			return MFX_ERR_INVALID_HANDLE;
+		}
+
+		hr = input_tex->QueryInterface(IID_IDXGIKeyedMutex,
+					       (void **)&km);
+		if (FAILED(hr)) {
+			input_tex->Release();
+			return MFX_ERR_INVALID_HANDLE;
+		}
+
+		input_tex->SetEvictionPriority(DXGI_RESOURCE_PRIORITY_MAXIMUM);
+		sharedTextures[tex_handle] = {input_tex, km};
 	}
 
-	hr = input_tex->QueryInterface(IID_IDXGIKeyedMutex, (void **)&km);
+	hr = km->AcquireSync(lock_key, INFINITE);
 	if (FAILED(hr)) {
-		input_tex->Release();
-		return MFX_ERR_INVALID_HANDLE;
+		*next_key = lock_key;
+		return MFX_ERR_DEVICE_FAILED;
 	}
 
-	input_tex->SetEvictionPriority(DXGI_RESOURCE_PRIORITY_MAXIMUM);
-
-	km->AcquireSync(lock_key, INFINITE);
-
 	D3D11_TEXTURE2D_DESC desc = {0};
 	input_tex->GetDesc(&desc);
 	D3D11_BOX SrcBox = {0, 0, 0, desc.Width, desc.Height, 1};
@@ -601,8 +601,13 @@ static bool obs_qsv_update(void *data, obs_data_t *settings)
 		EnterCriticalSection(&g_QsvCs);
 
 		ret = qsv_encoder_reconfig(obsqsv->context, &obsqsv->params);
-		if (ret != 0)
+		if (ret != 0) {
 			warn("Failed to reconfigure: %d", ret);
+		} else {
+			/* the size may have changed the headers */
+			bfree(obsqsv->extra_data);
+			load_headers(obsqsv);
+		}
 
 		LeaveCriticalSection(&g_QsvCs);
 
@@ -948,6 +953,9 @@ static bool obs_qsv_encode(void *data, struct encoder_frame *frame,
 
 	mfxU64 qsvPTS = frame->pts * 90000 / voi->fps_num;
 
+	if (obs_encoder_keyframe_requested(obsqsv->encoder))
+		qsv_encoder_request_keyframe(obsqsv->context);
+
 	// FIXME: remove null check from the top of this function
 	// if we actually do expect null frames to complete output.
 	if (frame)
@@ -999,6 +1007,9 @@ static bool obs_qsv_encode_tex(void *data, uint32_t handle, int64_t pts,
 
 	mfxU64 qsvPTS = pts * 90000 / voi->fps_num;
 
+	if (obs_encoder_keyframe_requested(obsqsv->encoder))
+		qsv_encoder_request_keyframe(obsqsv->context);
+
 	ret = qsv_encoder_encode_tex(obsqsv->context, qsvPTS, handle, lock_key,
 				     next_key, &pBS);
 
@@ -1029,7 +1040,9 @@ struct obs_encoder_info obs_qsv_encoder = {
 	.get_extra_data = obs_qsv_extra_data,
 	.get_sei_data = obs_qsv_sei,
 	.get_video_info = obs_qsv_video_info,
-	.caps = OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_INTERNAL,
+	.caps = OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_INTERNAL |
+		OBS_ENCODER_CAP_KEYFRAME_REQUEST |
+		OBS_ENCODER_CAP_DYN_RESOLUTION,
 };
 
 struct obs_encoder_info obs_qsv_encoder_tex = {
@@ -1039,7 +1052,8 @@ struct obs_encoder_info obs_qsv_encoder_tex = {
 	.get_name = obs_qsv_getname,
 	.create = obs_qsv_create_tex,
 	.destroy = obs_qsv_destroy,
-	.caps = OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_PASS_TEXTURE,
+	.caps = OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_PASS_TEXTURE |
+		OBS_ENCODER_CAP_KEYFRAME_REQUEST,
 	.encode_texture = obs_qsv_encode_tex,
 	.update = obs_qsv_update,
 	.get_properties = obs_qsv_props,
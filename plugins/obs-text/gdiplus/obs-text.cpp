@@ -9,6 +9,9 @@
 #include <string>
 #include <memory>
 #include <locale>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 using namespace std;
 using namespace Gdiplus;
@@ -218,6 +221,18 @@ struct TextSource {
 	uint32_t cx = 0;
 	uint32_t cy = 0;
 
+	/* text is rasterized on the worker thread when the file changes, and
+	 * the finished bitmap is uploaded by the next Render call, so the
+	 * graphics thread never waits for GDI+ */
+	mutex render_mutex;
+	unique_ptr<uint8_t[]> pending_bits;
+
+	thread worker;
+	mutex worker_mutex;
+	condition_variable worker_cv;
+	bool worker_stop = false;
+	bool worker_load_file = false;
+
 	HDCObj hdc;
 	Graphics graphics;
 
@@ -273,10 +288,18 @@ struct TextSource {
 		  graphics(hdc)
 	{
 		obs_source_update(source, settings);
+		worker = thread([this] { WorkerThread(); });
 	}
 
 	inline ~TextSource()
 	{
+		{
+			lock_guard<mutex> guard(worker_mutex);
+			worker_stop = true;
+		}
+		worker_cv.notify_one();
+		worker.join();
+
 		if (tex) {
 			obs_enter_graphics();
 			gs_texture_destroy(tex);
@@ -292,6 +315,8 @@ struct TextSource {
 	void RenderOutlineText(Graphics &graphics, const GraphicsPath &path,
 			       const Brush &brush);
 	void RenderText();
+	void UploadText();
+	void WorkerThread();
 	void LoadFileText();
 	void TransformText();
 	void SetAntiAliasing(Graphics &graphics_bitmap);
@@ -608,24 +633,56 @@ void TextSource::RenderText()
 		}
 	}
 
-	if (!tex || (LONG)cx != size.cx || (LONG)cy != size.cy) {
-		obs_enter_graphics();
+	pending_bits = move(bits);
+	cx = (uint32_t)size.cx;
+	cy = (uint32_t)size.cy;
+}
+
+void TextSource::UploadText()
+{
+	unique_lock<mutex> guard(render_mutex, try_to_lock);
+	if (!guard.owns_lock() || !pending_bits)
+		return;
+
+	if (!tex || gs_texture_get_width(tex) != cx ||
+	    gs_texture_get_height(tex) != cy) {
 		if (tex)
 			gs_texture_destroy(tex);
 
-		const uint8_t *data = (uint8_t *)bits.get();
-		tex = gs_texture_create(size.cx, size.cy, GS_BGRA, 1, &data,
-					GS_DYNAMIC);
+		const uint8_t *data = pending_bits.get();
+		tex = gs_texture_create(cx, cy, GS_BGRA, 1, &data, GS_DYNAMIC);
+	} else {
+		gs_texture_set_image(tex, pending_bits.get(), cx * 4, false);
+	}
+
+	pending_bits.reset();
+}
+
+void TextSource::WorkerThread()
+{
+	os_set_thread_name("obs-text: rasterize");
+
+	for (;;) {
+		{
+			unique_lock<mutex> guard(worker_mutex);
+			worker_cv.wait(guard, [this] {
+				return worker_stop || worker_load_file;
+			});
+
+			if (worker_stop)
+				break;
+			worker_load_file = false;
+		}
 
-		obs_leave_graphics();
+		lock_guard<mutex> guard(render_mutex);
+		wstring prev_text = text;
 
-		cx = (uint32_t)size.cx;
-		cy = (uint32_t)size.cy;
+		LoadFileText();
+		TransformText();
 
-	} else if (tex) {
-		obs_enter_graphics();
-		gs_texture_set_image(tex, bits.get(), size.cx * 4, false);
-		obs_leave_graphics();
+		/* tickers often rewrite the file with the same text */
+		if (text != prev_text)
+			RenderText();
 	}
 }
 
@@ -707,6 +764,8 @@ void TextSource::SetAntiAliasing(Graphics &graphics_bitmap)
 
 inline void TextSource::Update(obs_data_t *s)
 {
+	lock_guard<mutex> guard(render_mutex);
+
 	const char *new_text = obs_data_get_string(s, S_TEXT);
 	obs_data_t *font_obj = obs_data_get_obj(s, S_FONT);
 	const char *align_str = obs_data_get_string(s, S_ALIGN);
@@ -850,9 +909,11 @@ inline void TextSource::Tick(float seconds)
 		update_time_elapsed = 0.0f;
 
 		if (update_file) {
-			LoadFileText();
-			TransformText();
-			RenderText();
+			{
+				lock_guard<mutex> guard(worker_mutex);
+				worker_load_file = true;
+			}
+			worker_cv.notify_one();
 			update_file = false;
 		}
 
@@ -865,6 +926,7 @@ inline void TextSource::Tick(float seconds)
 
 inline void TextSource::Render()
 {
+	UploadText();
 	if (!tex)
 		return;
 
@@ -879,7 +941,7 @@ inline void TextSource::Render()
 
 	gs_effect_set_texture_srgb(gs_effect_get_param_by_name(effect, "image"),
 				   tex);
-	gs_draw_sprite(tex, 0, cx, cy);
+	gs_draw_sprite(tex, 0, 0, 0);
 
 	gs_technique_end_pass(tech);
 	gs_technique_end(tech);
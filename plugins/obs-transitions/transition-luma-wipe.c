@@ -1,5 +1,4 @@
 #include <obs-module.h>
-#include <graphics/image-file.h>
 #include <util/dstr.h>
 
 /* clang-format off */
@@ -25,7 +24,11 @@ struct luma_wipe_info {
 	gs_eparam_t *ep_invert;
 	gs_eparam_t *ep_softness;
 
-	gs_image_file_t luma_image;
+	/* images come from the shared image cache, which decodes them on a
+	 * worker thread.  A new image replaces the current one once it has
+	 * loaded, so changing the wipe never waits for it. */
+	obs_image_t *luma_image;
+	obs_image_t *pending_image;
 	bool invert_luma;
 	float softness;
 	obs_data_t *wipes_list;
@@ -51,16 +54,26 @@ static void luma_wipe_update(void *data, obs_data_t *settings)
 	dstr_cat(&path, name);
 
 	char *file = obs_module_file(path.array);
+	obs_image_t *image = obs_image_cache_get(file);
+	obs_image_t *old_pending, *old_image = NULL;
 
 	obs_enter_graphics();
-	gs_image_file_free(&lwipe->luma_image);
+	old_pending = lwipe->pending_image;
+	lwipe->pending_image = NULL;
+
+	if (image == lwipe->luma_image) {
+		/* drops the extra reference */
+		old_image = image;
+	} else if (!image || !lwipe->luma_image) {
+		old_image = lwipe->luma_image;
+		lwipe->luma_image = image;
+	} else {
+		lwipe->pending_image = image;
+	}
 	obs_leave_graphics();
 
-	gs_image_file_init(&lwipe->luma_image, file);
-
-	obs_enter_graphics();
-	gs_image_file_init_texture(&lwipe->luma_image);
-	obs_leave_graphics();
+	obs_image_release(old_pending);
+	obs_image_release(old_image);
 
 	bfree(file);
 	dstr_free(&path);
@@ -118,9 +131,8 @@ static void luma_wipe_destroy(void *data)
 {
 	struct luma_wipe_info *lwipe = data;
 
-	obs_enter_graphics();
-	gs_image_file_free(&lwipe->luma_image);
-	obs_leave_graphics();
+	obs_image_release(lwipe->pending_image);
+	obs_image_release(lwipe->luma_image);
 
 	obs_data_release(lwipe->wipes_list);
 
@@ -160,6 +172,17 @@ static void luma_wipe_defaults(obs_data_t *settings)
 	obs_data_set_default_bool(settings, S_LUMA_INV, false);
 }
 
+static gs_texture_t *get_luma_texture(struct luma_wipe_info *lwipe)
+{
+	if (obs_image_loaded(lwipe->pending_image)) {
+		obs_image_release(lwipe->luma_image);
+		lwipe->luma_image = lwipe->pending_image;
+		lwipe->pending_image = NULL;
+	}
+
+	return obs_image_get_texture(lwipe->luma_image);
+}
+
 static void luma_wipe_callback(void *data, gs_texture_t *a, gs_texture_t *b,
 			       float t, uint32_t cx, uint32_t cy)
 {
@@ -170,7 +193,7 @@ static void luma_wipe_callback(void *data, gs_texture_t *a, gs_texture_t *b,
 
 	gs_effect_set_texture_srgb(lwipe->ep_a_tex, a);
 	gs_effect_set_texture_srgb(lwipe->ep_b_tex, b);
-	gs_effect_set_texture(lwipe->ep_l_tex, lwipe->luma_image.texture);
+	gs_effect_set_texture(lwipe->ep_l_tex, get_luma_texture(lwipe));
 	gs_effect_set_float(lwipe->ep_progress, t);
 
 	gs_effect_set_bool(lwipe->ep_invert, lwipe->invert_luma);
@@ -1,4 +1,5 @@
 #include <obs-module.h>
+#include <util/darray.h>
 #include <util/dstr.h>
 
 #define TIMING_TIME 0
@@ -8,8 +9,17 @@
 #define MATTE_LAYOUT_VERTICAL 1
 #define MATTE_LAYOUT_SEPARATE_FILE 2
 
+#define PRELOAD_MAX_BYTES (1024ULL * 1024ULL * 1024ULL)
+
 enum fade_style { FADE_STYLE_FADE_OUT_FADE_IN, FADE_STYLE_CROSS_FADE };
 
+/* one video frame captured ahead of time, at the size of the transition */
+struct preload_frame {
+	gs_texrender_t *color;
+	gs_texrender_t *matte;
+	int64_t time_ms;
+};
+
 struct stinger_info {
 	obs_source_t *source;
 
@@ -42,6 +52,18 @@ struct stinger_info {
 
 	gs_texrender_t *matte_tex;
 
+	/* preloading plays the stinger once, hidden and silent, when it is
+	 * loaded and keeps every frame it produced.  The values below are
+	 * only touched by the graphics thread, except for preload_dirty and
+	 * use_preload. */
+	bool preload;
+	bool preload_dirty;
+	bool capturing;
+	bool preloaded;
+	bool use_preload;
+	uint64_t preload_bytes;
+	DARRAY(struct preload_frame) frames;
+
 	float (*mix_a)(void *data, float t);
 	float (*mix_b)(void *data, float t);
 };
@@ -123,6 +145,10 @@ static void stinger_update(void *data, obs_data_t *settings)
 	s->fade_style =
 		(enum fade_style)obs_data_get_int(settings, "audio_fade_style");
 
+	/* the sources were just recreated, so any frames are stale */
+	s->preload = obs_data_get_bool(settings, "preload");
+	s->preload_dirty = true;
+
 	switch (s->fade_style) {
 	default:
 	case FADE_STYLE_FADE_OUT_FADE_IN:
@@ -176,12 +202,27 @@ static void *stinger_create(obs_data_t *settings, obs_source_t *source)
 	return s;
 }
 
+static void free_preload_frames(struct stinger_info *s)
+{
+	obs_enter_graphics();
+	for (size_t i = 0; i < s->frames.num; i++) {
+		gs_texrender_destroy(s->frames.array[i].color);
+		gs_texrender_destroy(s->frames.array[i].matte);
+	}
+	obs_leave_graphics();
+
+	da_free(s->frames);
+	s->preload_bytes = 0;
+	s->preloaded = false;
+}
+
 static void stinger_destroy(void *data)
 {
 	struct stinger_info *s = data;
 	obs_source_release(s->media_source);
 	obs_source_release(s->matte_source);
 
+	free_preload_frames(s);
 	gs_texrender_destroy(s->matte_tex);
 
 	gs_effect_destroy(s->matte_effect);
@@ -192,6 +233,36 @@ static void stinger_destroy(void *data)
 static void stinger_defaults(obs_data_t *settings)
 {
 	obs_data_set_default_bool(settings, "hw_decode", true);
+	obs_data_set_default_bool(settings, "preload", false);
+}
+
+static inline obs_source_t *get_matte_source(struct stinger_info *s)
+{
+	return s->matte_layout == MATTE_LAYOUT_SEPARATE_FILE ? s->matte_source
+							     : s->media_source;
+}
+
+/* the frame to show at the current point of the transition */
+static struct preload_frame *get_preload_frame(struct stinger_info *s)
+{
+	float t = obs_transition_get_time(s->source);
+	int64_t time_ms =
+		(int64_t)((long double)t * (long double)s->duration_ns /
+			  1000000.0L);
+	size_t lo = 0, hi = s->frames.num;
+
+	if (!s->frames.num)
+		return NULL;
+
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (s->frames.array[mid].time_ms <= time_ms)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return s->frames.array + lo;
 }
 
 static void stinger_matte_render(void *data, gs_texture_t *a, gs_texture_t *b,
@@ -202,10 +273,24 @@ static void stinger_matte_render(void *data, gs_texture_t *a, gs_texture_t *b,
 	struct vec4 background;
 	vec4_zero(&background);
 
-	obs_source_t *matte_source =
-		(s->matte_layout == MATTE_LAYOUT_SEPARATE_FILE
-			 ? s->matte_source
-			 : s->media_source);
+	if (s->use_preload) {
+		struct preload_frame *frame = get_preload_frame(s);
+		if (!frame)
+			return;
+
+		gs_effect_set_texture(s->ep_a_tex, a);
+		gs_effect_set_texture(s->ep_b_tex, b);
+		gs_effect_set_texture(s->ep_matte_tex,
+				      gs_texrender_get_texture(frame->matte));
+		gs_effect_set_bool(s->ep_invert_matte, s->invert_matte);
+
+		while (gs_effect_loop(s->matte_effect,
+				      "StingerMattePreloaded"))
+			gs_draw_sprite(NULL, 0, cx, cy);
+		return;
+	}
+
+	obs_source_t *matte_source = get_matte_source(s);
 
 	float matte_cx = (float)obs_source_get_width(matte_source) /
 			 s->matte_width_factor;
@@ -272,6 +357,26 @@ static void stinger_video_render(void *data, gs_effect_t *effect)
 	float source_cx = (float)obs_source_get_width(s->source);
 	float source_cy = (float)obs_source_get_height(s->source);
 
+	if (s->use_preload) {
+		struct preload_frame *frame = get_preload_frame(s);
+		if (!frame)
+			return;
+
+		/* the captured frames have premultiplied alpha */
+		gs_effect_t *draw = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+		gs_eparam_t *image = gs_effect_get_param_by_name(draw, "image");
+		gs_texture_t *tex = gs_texrender_get_texture(frame->color);
+
+		gs_blend_state_push();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+		gs_effect_set_texture(image, tex);
+		while (gs_effect_loop(draw, "Draw"))
+			gs_draw_sprite(tex, 0, (uint32_t)source_cx,
+				       (uint32_t)source_cy);
+		gs_blend_state_pop();
+		return;
+	}
+
 	uint32_t media_cx = obs_source_get_width(s->media_source);
 	uint32_t media_cy = obs_source_get_height(s->media_source);
 
@@ -296,6 +401,219 @@ static void stinger_video_render(void *data, gs_effect_t *effect)
 	UNUSED_PARAMETER(effect);
 }
 
+/* ------------------------------------------------------------------------- */
+
+static void render_scaled(gs_texrender_t *tr, obs_source_t *source,
+			  uint32_t cx, uint32_t cy, float scale_x,
+			  float scale_y, float offset_x, float offset_y)
+{
+	struct vec4 background;
+	vec4_zero(&background);
+
+	gs_texrender_reset(tr);
+	if (!gs_texrender_begin(tr, cx, cy))
+		return;
+
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+	gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
+
+	gs_blend_state_push();
+	gs_blend_function_separate(GS_BLEND_SRCALPHA, GS_BLEND_INVSRCALPHA,
+				   GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+
+	gs_matrix_push();
+	gs_matrix_scale3f(scale_x, scale_y, 1.0f);
+	gs_matrix_translate3f(offset_x, offset_y, 0.0f);
+	obs_source_video_render(source);
+	gs_matrix_pop();
+
+	gs_blend_state_pop();
+	gs_texrender_end(tr);
+}
+
+static bool capture_matte(struct stinger_info *s, struct preload_frame *frame,
+			  uint32_t cx, uint32_t cy)
+{
+	obs_source_t *matte_source = get_matte_source(s);
+	float matte_cx = (float)obs_source_get_width(matte_source) /
+			 s->matte_width_factor;
+	float matte_cy = (float)obs_source_get_height(matte_source) /
+			 s->matte_height_factor;
+
+	if (matte_cx <= 0.0f || matte_cy <= 0.0f)
+		return false;
+
+	float width_offset = (s->matte_layout == MATTE_LAYOUT_HORIZONTAL
+				      ? (-matte_cx)
+				      : 0.0f);
+	float height_offset =
+		(s->matte_layout == MATTE_LAYOUT_VERTICAL ? (-matte_cy) : 0.0f);
+
+	render_scaled(s->matte_tex, matte_source, cx, cy,
+		      (float)cx / matte_cx, (float)cy / matte_cy, width_offset,
+		      height_offset);
+
+	/* only the luma of the matte is ever used */
+	frame->matte = gs_texrender_create(GS_R8, GS_ZS_NONE);
+	if (!gs_texrender_begin(frame->matte, cx, cy))
+		return false;
+
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+	gs_blend_state_push();
+	gs_enable_blending(false);
+
+	gs_effect_set_texture(s->ep_matte_tex,
+			      gs_texrender_get_texture(s->matte_tex));
+	while (gs_effect_loop(s->matte_effect, "MatteLuma"))
+		gs_draw_sprite(NULL, 0, cx, cy);
+
+	gs_blend_state_pop();
+	gs_texrender_end(frame->matte);
+	return true;
+}
+
+static bool capture_frame(struct stinger_info *s, struct preload_frame *frame,
+			  uint32_t cx, uint32_t cy)
+{
+	float media_cx = (float)obs_source_get_width(s->media_source);
+	float media_cy = (float)obs_source_get_height(s->media_source);
+
+	if (s->track_matte_enabled) {
+		media_cx /= s->matte_width_factor;
+		media_cy /= s->matte_height_factor;
+	}
+
+	frame->color = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	render_scaled(frame->color, s->media_source, cx, cy,
+		      (float)cx / media_cx, (float)cy / media_cy, 0.0f, 0.0f);
+
+	if (s->track_matte_enabled && !capture_matte(s, frame, cx, cy))
+		return false;
+
+	return gs_texrender_get_texture(frame->color) != NULL;
+}
+
+static inline bool media_ended(obs_source_t *source)
+{
+	enum obs_media_state state = obs_source_media_get_state(source);
+	return state == OBS_MEDIA_STATE_ENDED ||
+	       state == OBS_MEDIA_STATE_STOPPED ||
+	       state == OBS_MEDIA_STATE_ERROR;
+}
+
+static void stop_capture(struct stinger_info *s)
+{
+	obs_source_set_monitoring_type(s->media_source, s->monitoring_type);
+	s->capturing = false;
+}
+
+static void start_capture(struct stinger_info *s)
+{
+	free_preload_frames(s);
+
+	if (!s->media_source)
+		return;
+
+	/* played hidden, so it must not be heard either */
+	obs_source_set_monitoring_type(s->media_source,
+				       OBS_MONITORING_TYPE_NONE);
+
+	obs_source_media_restart(s->media_source);
+	if (s->track_matte_enabled && s->matte_source)
+		obs_source_media_restart(s->matte_source);
+
+	s->capturing = true;
+}
+
+static void capture_next(struct stinger_info *s)
+{
+	uint32_t cx = obs_source_get_width(s->source);
+	uint32_t cy = obs_source_get_height(s->source);
+	struct preload_frame frame = {0};
+	uint64_t frame_bytes;
+	bool captured;
+
+	if (media_ended(s->media_source)) {
+		if (!s->frames.num)
+			return;
+
+		stop_capture(s);
+		s->preloaded = true;
+		blog(LOG_INFO,
+		     "[stinger: '%s'] preloaded %zu frames (%.1f MB)",
+		     obs_source_get_name(s->source), s->frames.num,
+		     (double)s->preload_bytes / (1024.0 * 1024.0));
+		return;
+	}
+
+	if (obs_source_media_get_state(s->media_source) !=
+		    OBS_MEDIA_STATE_PLAYING ||
+	    !obs_source_get_width(s->media_source) || !cx || !cy)
+		return;
+
+	frame.time_ms = obs_source_media_get_time(s->media_source);
+	if (s->frames.num && s->frames.array[s->frames.num - 1].time_ms ==
+				     frame.time_ms)
+		return;
+
+	frame_bytes = (uint64_t)cx * cy * (s->track_matte_enabled ? 5 : 4);
+	if (s->preload_bytes + frame_bytes > PRELOAD_MAX_BYTES) {
+		blog(LOG_WARNING,
+		     "[stinger: '%s'] video too large to preload, "
+		     "playing it directly instead",
+		     obs_source_get_name(s->source));
+		stop_capture(s);
+		free_preload_frames(s);
+		return;
+	}
+
+	obs_enter_graphics();
+	captured = capture_frame(s, &frame, cx, cy);
+	if (!captured) {
+		gs_texrender_destroy(frame.color);
+		gs_texrender_destroy(frame.matte);
+	}
+	obs_leave_graphics();
+
+	if (captured) {
+		da_push_back(s->frames, &frame);
+		s->preload_bytes += frame_bytes;
+	}
+}
+
+static void stinger_video_tick(void *data, float seconds)
+{
+	struct stinger_info *s = data;
+
+	if (s->transitioning) {
+		/* cut short by the transition itself, start over after */
+		if (s->capturing) {
+			stop_capture(s);
+			s->preload_dirty = true;
+		}
+		return;
+	}
+
+	if (!s->preload) {
+		if (s->capturing)
+			stop_capture(s);
+		if (s->frames.num)
+			free_preload_frames(s);
+		return;
+	}
+
+	if (s->preload_dirty) {
+		s->preload_dirty = false;
+		start_capture(s);
+	} else if (s->capturing) {
+		capture_next(s);
+	}
+
+	UNUSED_PARAMETER(seconds);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline float calc_fade(float t, float mul)
 {
 	t *= mul;
@@ -437,6 +755,8 @@ static void stinger_transition_start(void *data)
 		obs_source_add_active_child(s->source, s->media_source);
 	}
 
+	/* the media source still plays for its audio either way */
+	s->use_preload = s->preload && s->preloaded && !s->capturing;
 	s->transitioning = true;
 }
 
@@ -450,6 +770,7 @@ static void stinger_transition_stop(void *data)
 	if (s->matte_source)
 		obs_source_remove_active_child(s->source, s->matte_source);
 
+	s->use_preload = false;
 	s->transitioning = false;
 }
 
@@ -554,6 +875,8 @@ static obs_properties_t *stinger_properties(void *data)
 	obs_properties_add_bool(ppts, "hw_decode",
 				obs_module_text("HardwareDecode"));
 #endif
+	obs_properties_add_bool(ppts, "preload",
+				obs_module_text("PreloadStinger"));
 	obs_property_list_add_int(p, obs_module_text("TransitionPointTypeTime"),
 				  TIMING_TIME);
 	obs_property_list_add_int(
@@ -642,6 +965,7 @@ struct obs_source_info stinger_transition = {
 	.update = stinger_update,
 	.get_defaults = stinger_defaults,
 	.video_render = stinger_video_render,
+	.video_tick = stinger_video_tick,
 	.audio_render = stinger_audio_render,
 	.get_properties = stinger_properties,
 	.enum_active_sources = stinger_enum_active_sources,
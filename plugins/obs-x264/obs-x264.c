@@ -21,6 +21,7 @@
 #include <util/dstr.h>
 #include <util/darray.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <obs-module.h>
 #include "obs-x264-options.h"
 
@@ -56,6 +57,12 @@ struct obs_x264 {
 	size_t extra_data_size;
 	size_t sei_size;
 
+	char *cpu_affinity;
+	bool affinity_set;
+
+	/* set by updates that x264_encoder_reconfig can't apply */
+	volatile bool reopen;
+
 	os_performance_token_t *performance_token;
 };
 
@@ -90,6 +97,7 @@ static void obs_x264_destroy(void *data)
 		os_end_high_performance(obsx264->performance_token);
 		clear_data(obsx264);
 		da_free(obsx264->packet_data);
+		bfree(obsx264->cpu_affinity);
 		bfree(obsx264);
 	}
 }
@@ -111,6 +119,8 @@ static void obs_x264_defaults(obs_data_t *settings)
 	obs_data_set_default_string(settings, "tune", "");
 	obs_data_set_default_string(settings, "x264opts", "");
 	obs_data_set_default_bool(settings, "repeat_headers", false);
+	obs_data_set_default_bool(settings, "low_latency", false);
+	obs_data_set_default_string(settings, "cpu_affinity", "");
 }
 
 static inline void add_strings(obs_property_t *list, const char *const *strings)
@@ -133,6 +143,10 @@ static inline void add_strings(obs_property_t *list, const char *const *strings)
 #define TEXT_TUNE obs_module_text("Tune")
 #define TEXT_NONE obs_module_text("None")
 #define TEXT_X264_OPTS obs_module_text("EncoderOptions")
+#define TEXT_LOW_LATENCY obs_module_text("LowLatency")
+#define TEXT_LOW_LATENCY_TOOLTIP obs_module_text("LowLatency.ToolTip")
+#define TEXT_CPU_AFFINITY obs_module_text("CPUAffinity")
+#define TEXT_CPU_AFFINITY_TOOLTIP obs_module_text("CPUAffinity.ToolTip")
 
 static bool use_bufsize_modified(obs_properties_t *ppts, obs_property_t *p,
 				 obs_data_t *settings)
@@ -221,9 +235,16 @@ static obs_properties_t *obs_x264_props(void *unused)
 	obs_properties_add_bool(props, "vfr", TEXT_VFR);
 #endif
 
+	p = obs_properties_add_bool(props, "low_latency", TEXT_LOW_LATENCY);
+	obs_property_set_long_description(p, TEXT_LOW_LATENCY_TOOLTIP);
+
 	obs_properties_add_text(props, "x264opts", TEXT_X264_OPTS,
 				OBS_TEXT_DEFAULT);
 
+	p = obs_properties_add_text(props, "cpu_affinity", TEXT_CPU_AFFINITY,
+				    OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(p, TEXT_CPU_AFFINITY_TOOLTIP);
+
 	headers = obs_properties_add_bool(props, "repeat_headers",
 					  "repeat_headers");
 	obs_property_set_visible(headers, false);
@@ -408,6 +429,7 @@ static void update_params(struct obs_x264 *obsx264, obs_data_t *settings,
 	int bf = (int)obs_data_get_int(settings, "bf");
 	bool use_bufsize = obs_data_get_bool(settings, "use_bufsize");
 	bool cbr_override = obs_data_get_bool(settings, "cbr");
+	bool low_latency = obs_data_get_bool(settings, "low_latency");
 	enum rate_control rc;
 
 #ifdef ENABLE_VFR
@@ -527,6 +549,19 @@ static void update_params(struct obs_x264 *obsx264, obs_data_t *settings,
 	else
 		obsx264->params.i_csp = X264_CSP_NV12;
 
+	/* low latency: nothing is held back for lookahead or reordering, so
+	 * each frame is returned by the same x264_encoder_encode call that
+	 * received it.  applied before the custom options so those can still
+	 * override individual values */
+	if (low_latency) {
+		obsx264->params.rc.i_lookahead = 0;
+		obsx264->params.rc.b_mb_tree = 0;
+		obsx264->params.i_sync_lookahead = 0;
+		obsx264->params.i_bframe = 0;
+		obsx264->params.b_sliced_threads = 1;
+		obsx264->params.b_intra_refresh = 1;
+	}
+
 	for (size_t i = 0; i < options->ignored_word_count; ++i)
 		warn("ignoring invalid x264 option: %s",
 		     options->ignored_words[i]);
@@ -543,11 +578,13 @@ static void update_params(struct obs_x264 *obsx264, obs_data_t *settings,
 		     "\tfps_den:      %d\n"
 		     "\twidth:        %d\n"
 		     "\theight:       %d\n"
-		     "\tkeyint:       %d\n",
+		     "\tkeyint:       %d\n"
+		     "\tlow_latency:  %s\n",
 		     rate_control, obsx264->params.rc.i_vbv_max_bitrate,
 		     obsx264->params.rc.i_vbv_buffer_size,
 		     (int)obsx264->params.rc.f_rf_constant, voi->fps_num,
-		     voi->fps_den, width, height, obsx264->params.i_keyint_max);
+		     voi->fps_den, width, height, obsx264->params.i_keyint_max,
+		     low_latency ? "true" : "false");
 	}
 }
 
@@ -634,6 +671,18 @@ static bool update_settings(struct obs_x264 *obsx264, obs_data_t *settings,
 	return success;
 }
 
+/* the size and keyframe interval can only be changed by opening a new
+ * encoder */
+static inline bool needs_reopen(struct obs_x264 *obsx264)
+{
+	x264_param_t cur;
+
+	x264_encoder_parameters(obsx264->context, &cur);
+	return cur.i_width != obsx264->params.i_width ||
+	       cur.i_height != obsx264->params.i_height ||
+	       cur.i_keyint_max != obsx264->params.i_keyint_max;
+}
+
 static bool obs_x264_update(void *data, obs_data_t *settings)
 {
 	struct obs_x264 *obsx264 = data;
@@ -641,6 +690,12 @@ static bool obs_x264_update(void *data, obs_data_t *settings)
 	int ret;
 
 	if (success) {
+		/* done before the next frame, on the encode thread */
+		if (needs_reopen(obsx264)) {
+			os_atomic_set_bool(&obsx264->reopen, true);
+			return true;
+		}
+
 		ret = x264_encoder_reconfig(obsx264->context, &obsx264->params);
 		if (ret != 0)
 			warn("Failed to reconfigure: %d", ret);
@@ -678,13 +733,68 @@ static void load_headers(struct obs_x264 *obsx264)
 	obsx264->sei_size = sei.num;
 }
 
+static void *open_thread(void *data)
+{
+	struct obs_x264 *obsx264 = data;
+
+	if (!os_set_thread_affinity(pthread_self(), obsx264->cpu_affinity))
+		warn("failed to set CPU affinity to '%s'",
+		     obsx264->cpu_affinity);
+
+	obsx264->context = x264_encoder_open(&obsx264->params);
+	return NULL;
+}
+
+/* x264 starts its frame and lookahead threads while opening the encoder, and
+ * on linux those inherit the affinity of the thread that opens it, so that is
+ * done from a thread restricted to the configured CPUs */
+static void open_encoder(struct obs_x264 *obsx264)
+{
+	pthread_t thread;
+
+	if (obsx264->cpu_affinity &&
+	    pthread_create(&thread, NULL, open_thread, obsx264) == 0) {
+		pthread_join(thread, NULL);
+		return;
+	}
+
+	obsx264->context = x264_encoder_open(&obsx264->params);
+}
+
+/* frames still in the lookahead of the old encoder are lost, the new one
+ * starts on a keyframe with new headers */
+static bool reopen_encoder(struct obs_x264 *obsx264)
+{
+	os_atomic_set_bool(&obsx264->reopen, false);
+	clear_data(obsx264);
+	open_encoder(obsx264);
+
+	if (!obsx264->context) {
+		warn("Failed to reopen the encoder");
+		return false;
+	}
+
+	load_headers(obsx264);
+	info("reopened at %dx%d, keyint %d", obsx264->params.i_width,
+	     obsx264->params.i_height, obsx264->params.i_keyint_max);
+	return true;
+}
+
 static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 {
 	struct obs_x264 *obsx264 = bzalloc(sizeof(struct obs_x264));
+	const char *cpu_affinity;
+
 	obsx264->encoder = encoder;
 
+	cpu_affinity = obs_data_get_string(settings, "cpu_affinity");
+	if (cpu_affinity && *cpu_affinity) {
+		obsx264->cpu_affinity = bstrdup(cpu_affinity);
+		info("cpu affinity: %s", cpu_affinity);
+	}
+
 	if (update_settings(obsx264, settings, false)) {
-		obsx264->context = x264_encoder_open(&obsx264->params);
+		open_encoder(obsx264);
 
 		if (obsx264->context == NULL)
 			warn("x264 failed to load");
@@ -695,6 +805,7 @@ static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 	}
 
 	if (!obsx264->context) {
+		bfree(obsx264->cpu_affinity);
 		bfree(obsx264);
 		return NULL;
 	}
@@ -749,6 +860,30 @@ static inline void init_pic_data(struct obs_x264 *obsx264, x264_picture_t *pic,
 	}
 }
 
+static void add_sei_payload(void *param, int payload_type, const uint8_t *data,
+			    size_t size)
+{
+	x264_sei_t *sei = param;
+	size_t count = (size_t)sei->num_payloads + 1;
+	x264_sei_payload_t *payload;
+
+	sei->payloads =
+		brealloc(sei->payloads, sizeof(x264_sei_payload_t) * count);
+	payload = &sei->payloads[sei->num_payloads++];
+	payload->payload_size = (int)size;
+	payload->payload_type = payload_type;
+	payload->payload = bmemdup(data, size);
+}
+
+/* x264 keeps the picture until it's encoded, which can be many frames later
+ * with lookahead, and frees the payloads with sei_free once it's done */
+static inline void add_captions(struct obs_x264 *obsx264, x264_picture_t *pic)
+{
+	if (obs_encoder_get_caption_sei(obsx264->encoder, pic->i_pts,
+					add_sei_payload, &pic->extra_sei))
+		pic->extra_sei.sei_free = bfree;
+}
+
 static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 			    struct encoder_packet *packet,
 			    bool *received_packet)
@@ -762,8 +897,24 @@ static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 	if (!frame || !packet || !received_packet)
 		return false;
 
-	if (frame)
+	/* every raw encoder is fed from its own video thread, which also
+	 * allocates the frames x264 copies the input pictures into.  keeping
+	 * it on the same CPUs keeps that memory on the same NUMA node */
+	if (obsx264->cpu_affinity && !obsx264->affinity_set) {
+		os_set_thread_affinity(pthread_self(), obsx264->cpu_affinity);
+		obsx264->affinity_set = true;
+	}
+
+	if (os_atomic_load_bool(&obsx264->reopen) && !reopen_encoder(obsx264))
+		return false;
+
+	if (frame) {
 		init_pic_data(obsx264, &pic, frame);
+		add_captions(obsx264, &pic);
+
+		if (obs_encoder_keyframe_requested(obsx264->encoder))
+			pic.i_type = X264_TYPE_IDR;
+	}
 
 	ret = x264_encoder_encode(obsx264->context, &nals, &nal_count,
 				  (frame ? &pic : NULL), &pic_out);
@@ -837,5 +988,7 @@ struct obs_encoder_info obs_x264_encoder = {
 	.get_extra_data = obs_x264_extra_data,
 	.get_sei_data = obs_x264_sei,
 	.get_video_info = obs_x264_video_info,
-	.caps = OBS_ENCODER_CAP_DYN_BITRATE,
+	.caps = OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_CAPTIONS |
+		OBS_ENCODER_CAP_KEYFRAME_REQUEST |
+		OBS_ENCODER_CAP_DYN_RESOLUTION,
 };
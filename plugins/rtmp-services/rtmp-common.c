@@ -1,8 +1,10 @@
 #include <util/platform.h>
+#include <util/threading.h>
 #include <util/dstr.h>
 #include <obs-module.h>
 #include <jansson.h>
 #include <obs-config.h>
+#include <sys/stat.h>
 
 #include "rtmp-format-ver.h"
 #include "twitch.h"
@@ -30,6 +32,7 @@ static const char *rtmp_common_getname(void *unused)
 }
 
 static json_t *open_services_file(void);
+static void close_services_file(json_t *root);
 static inline json_t *find_service(json_t *root, const char *name,
 				   const char **p_new_name);
 static inline bool get_bool_val(json_t *service, const char *key);
@@ -148,7 +151,7 @@ static void rtmp_common_update(void *data, obs_data_t *settings)
 			ensure_valid_url(service, serv, settings);
 		}
 	}
-	json_decref(root);
+	close_services_file(root);
 
 	if (!service->output)
 		service->output = bstrdup("rtmp_output");
@@ -310,16 +313,20 @@ static json_t *open_json_file(const char *file)
 	return list;
 }
 
-static json_t *open_services_file(void)
+/* services.json is large, so the parsed list is kept and only read again
+ * once the updated copy in the config directory changes */
+static pthread_mutex_t services_mutex = PTHREAD_MUTEX_INITIALIZER;
+static json_t *services_cache = NULL;
+static int64_t services_mtime = -1;
+static int64_t services_size = -1;
+
+static json_t *load_services_file(const char *config_file)
 {
-	char *file;
 	json_t *root = NULL;
+	char *file;
 
-	file = obs_module_config_path("services.json");
-	if (file) {
-		root = open_json_file(file);
-		bfree(file);
-	}
+	if (config_file)
+		root = open_json_file(config_file);
 
 	if (!root) {
 		file = obs_module_file("services.json");
@@ -332,6 +339,55 @@ static json_t *open_services_file(void)
 	return root;
 }
 
+static json_t *open_services_file(void)
+{
+	int64_t mtime = -1;
+	int64_t size = -1;
+	struct stat st;
+	json_t *root;
+	char *file;
+
+	file = obs_module_config_path("services.json");
+	if (file && os_stat(file, &st) == 0) {
+		mtime = (int64_t)st.st_mtime;
+		size = (int64_t)st.st_size;
+	}
+
+	pthread_mutex_lock(&services_mutex);
+
+	if (!services_cache || services_mtime != mtime ||
+	    services_size != size) {
+		json_decref(services_cache);
+		services_cache = load_services_file(file);
+		services_mtime = mtime;
+		services_size = size;
+	}
+
+	/* jansson reference counts are not atomic, so they are only ever
+	 * changed with the lock held */
+	root = json_incref(services_cache);
+
+	pthread_mutex_unlock(&services_mutex);
+
+	bfree(file);
+	return root;
+}
+
+static void close_services_file(json_t *root)
+{
+	pthread_mutex_lock(&services_mutex);
+	json_decref(root);
+	pthread_mutex_unlock(&services_mutex);
+}
+
+void free_services_cache(void)
+{
+	pthread_mutex_lock(&services_mutex);
+	json_decref(services_cache);
+	services_cache = NULL;
+	pthread_mutex_unlock(&services_mutex);
+}
+
 static void build_service_list(obs_property_t *list, json_t *root,
 			       bool show_all, const char *cur_service)
 {
@@ -343,7 +399,7 @@ static void properties_data_destroy(void *data)
 {
 	json_t *root = data;
 	if (root)
-		json_decref(root);
+		close_services_file(root);
 }
 
 static bool fill_twitch_servers_locked(obs_property_t *servers_prop)
@@ -636,7 +692,7 @@ static void rtmp_common_apply_settings(void *data, obs_data_t *video_settings,
 	if (root) {
 		initialize_output(service, root, video_settings,
 				  audio_settings);
-		json_decref(root);
+		close_services_file(root);
 	}
 }
 
@@ -755,7 +811,7 @@ static void rtmp_common_get_max_bitrate(void *data, int *video_bitrate,
 	}
 
 fail:
-	json_decref(root);
+	close_services_file(root);
 }
 
 struct obs_service_info rtmp_common_service = {
@@ -54,6 +54,7 @@ static bool confirm_service_file(void *param, struct file_download_data *file)
 extern void init_twitch_data(void);
 extern void load_twitch_data(void);
 extern void unload_twitch_data(void);
+extern void free_services_cache(void);
 extern void twitch_ingests_refresh(int seconds);
 
 static void refresh_callback(void *unused, calldata_t *cd)
@@ -109,5 +110,6 @@ void obs_module_unload(void)
 	update_info_destroy(update_info);
 	unload_twitch_data();
 	free_showroom_data();
+	free_services_cache();
 	dstr_free(&module_name);
 }
@@ -1,6 +1,5 @@
 #include <util/dstr.h>
 #include <util/darray.h>
-#include <util/crc32.h>
 #include "find-font.h"
 #include "text-freetype2.h"
 
@@ -9,9 +8,6 @@
 #include <shellapi.h>
 #include <shlobj.h>
 
-extern DARRAY(struct font_path_info) font_list;
-extern void save_font_list(void);
-
 struct mac_font_mapping {
 	unsigned short encoding_id;
 	unsigned short language_id;
@@ -177,45 +173,6 @@ char *sfnt_name_to_utf8(FT_SfntName *sfnt_name)
 	return utf8_str;
 }
 
-uint32_t get_font_checksum(void)
-{
-	uint32_t checksum = 0;
-	struct dstr path = {0};
-	HANDLE handle;
-	WIN32_FIND_DATAA wfd;
-
-	dstr_reserve(&path, MAX_PATH);
-
-	HRESULT res = SHGetFolderPathA(NULL, CSIDL_FONTS, NULL,
-				       SHGFP_TYPE_CURRENT, path.array);
-	if (res != S_OK) {
-		blog(LOG_WARNING, "Error finding windows font folder");
-		return 0;
-	}
-
-	path.len = strlen(path.array);
-	dstr_cat(&path, "\\*.*");
-
-	handle = FindFirstFileA(path.array, &wfd);
-	if (handle == INVALID_HANDLE_VALUE)
-		goto free_string;
-
-	dstr_resize(&path, path.len - 4);
-
-	do {
-		checksum = calc_crc32(checksum, &wfd.ftLastWriteTime,
-				      sizeof(FILETIME));
-		checksum = calc_crc32(checksum, wfd.cFileName,
-				      strlen(wfd.cFileName));
-	} while (FindNextFileA(handle, &wfd));
-
-	FindClose(handle);
-
-free_string:
-	dstr_free(&path);
-	return checksum;
-}
-
 void load_os_font_list(void)
 {
 	struct dstr path = {0};
@@ -242,9 +199,7 @@ void load_os_font_list(void)
 
 	do {
 		struct dstr full_path = {0};
-		FT_Face face;
-		FT_Long idx = 0;
-		FT_Long max_faces = 1;
+		uint64_t mtime;
 
 		if (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
 			continue;
@@ -253,23 +208,16 @@ void load_os_font_list(void)
 		dstr_cat(&full_path, "\\");
 		dstr_cat(&full_path, wfd.cFileName);
 
-		while (idx < max_faces) {
-			FT_Error ret = FT_New_Face(ft2_lib, full_path.array,
-						   idx, &face);
-			if (ret != 0)
-				break;
-
-			build_font_path_info(face, idx++, full_path.array);
-			max_faces = face->num_faces;
-			FT_Done_Face(face);
-		}
+		mtime = ((uint64_t)wfd.ftLastWriteTime.dwHighDateTime << 32) |
+			wfd.ftLastWriteTime.dwLowDateTime;
+		add_font_file(full_path.array, mtime);
 
 		dstr_free(&full_path);
 	} while (FindNextFileA(handle, &wfd));
 
 	FindClose(handle);
 
-	save_font_list();
+	finish_font_list();
 
 free_string:
 	dstr_free(&path);
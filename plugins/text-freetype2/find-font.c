@@ -3,6 +3,7 @@
 #include <time.h>
 #include <obs-module.h>
 #include "find-font.h"
+#include "text-freetype2.h"
 
 DARRAY(struct font_path_info) font_list;
 
@@ -50,69 +51,108 @@ static bool write_str(struct serializer *s, const char *str)
 	return true;
 }
 
-static bool load_cached_font_list(struct serializer *s)
-{
-	bool success = true;
-	int count;
+/*
+ * The cache keeps the faces of every font file together with the file's
+ * modification time, so when the font list is rebuilt only files that were
+ * added or changed since the last run have to be opened with FreeType.
+ */
+struct font_file {
+	char *path;
+	uint64_t mtime;
+	size_t first;
+	size_t count;
+};
 
-	success = read_var(s, count);
-	if (!success)
-		return false;
+static DARRAY(struct font_file) font_files;
 
-	da_init(font_list);
-	da_resize(font_list, count);
+static DARRAY(struct font_file) cached_files;
+static DARRAY(struct font_path_info) cached_fonts;
+static size_t cached_file_cursor;
+
+static const uint32_t font_cache_ver = 2;
+
+static bool read_font_info(struct serializer *s, struct font_path_info *info,
+			   const char *path)
+{
+	bool success;
 
 #define do_read(var)                \
 	success = read_var(s, var); \
 	if (!success)               \
-	break
+	return false
 
-	for (int i = 0; i < count; i++) {
-		struct font_path_info *info = &font_list.array[i];
+	if (!read_str(s, &info->face_and_style))
+		return false;
 
-		success = read_str(s, &info->face_and_style);
-		if (!success)
-			break;
+	do_read(info->full_len);
+	do_read(info->face_len);
+	do_read(info->is_bitmap);
+	do_read(info->num_sizes);
 
-		do_read(info->full_len);
-		do_read(info->face_len);
-		do_read(info->is_bitmap);
-		do_read(info->num_sizes);
+	info->sizes = bmalloc(sizeof(int) * info->num_sizes);
+	if (!read_data(s, info->sizes, sizeof(int) * info->num_sizes))
+		return false;
 
-		info->sizes = bmalloc(sizeof(int) * info->num_sizes);
-		success = read_data(s, info->sizes,
-				    sizeof(int) * info->num_sizes);
-		if (!success)
-			break;
+	do_read(info->bold);
+	do_read(info->italic);
+	do_read(info->index);
 
-		do_read(info->bold);
+#undef do_read
 
-		success = read_str(s, &info->path);
-		if (!success)
-			break;
+	info->path = bstrdup(path);
+	return true;
+}
 
-		do_read(info->italic);
-		do_read(info->index);
-	}
+static void free_cached_font_list(void)
+{
+	for (size_t i = 0; i < cached_files.num; i++)
+		bfree(cached_files.array[i].path);
+	for (size_t i = 0; i < cached_fonts.num; i++)
+		font_path_info_free(cached_fonts.array + i);
+
+	da_free(cached_files);
+	da_free(cached_fonts);
+	cached_file_cursor = 0;
+}
 
-#undef do_read
+static bool load_cached_font_list(struct serializer *s)
+{
+	uint32_t file_count;
 
-	if (!success) {
-		free_os_font_list();
+	if (!read_var(s, file_count))
 		return false;
+
+	for (uint32_t i = 0; i < file_count; i++) {
+		struct font_file file = {0};
+		uint32_t count;
+
+		if (!read_str(s, &file.path))
+			return false;
+
+		da_push_back(cached_files, &file);
+
+		if (!read_var(s, file.mtime) || !read_var(s, count))
+			return false;
+
+		file.first = cached_fonts.num;
+		file.count = count;
+		cached_files.array[i] = file;
+
+		for (uint32_t j = 0; j < count; j++) {
+			struct font_path_info *info =
+				da_push_back_new(cached_fonts);
+
+			if (!read_font_info(s, info, file.path))
+				return false;
+		}
 	}
 
 	return true;
 }
 
-extern uint32_t get_font_checksum();
-static const uint32_t font_cache_ver = 1;
-
 bool load_cached_os_font_list(void)
 {
 	char *file_name = obs_module_config_path("font_data.bin");
-	uint32_t old_checksum;
-	uint32_t new_checksum;
 	struct serializer s;
 	uint32_t ver;
 	bool success;
@@ -123,89 +163,93 @@ bool load_cached_os_font_list(void)
 	if (!success)
 		return false;
 
-	success = read_data(&s, &ver, sizeof(ver));
+	success = read_var(&s, ver) && ver == font_cache_ver;
+	if (success)
+		success = load_cached_font_list(&s);
+	if (!success)
+		free_cached_font_list();
 
-	if (!success || ver != font_cache_ver) {
-		success = false;
-		goto finish;
-	}
+	file_input_serializer_free(&s);
+	return success;
+}
 
-	success = s_read(&s, &old_checksum, sizeof(old_checksum));
-	new_checksum = get_font_checksum();
+static bool write_font_info(struct serializer *s,
+			    const struct font_path_info *info)
+{
+	bool success;
 
-	if (!success || old_checksum != new_checksum) {
-		success = false;
-		goto finish;
-	}
+#define do_write(var)                \
+	success = write_var(s, var); \
+	if (!success)                \
+	return false
 
-	success = load_cached_font_list(&s);
+	if (!write_str(s, info->face_and_style))
+		return false;
 
-finish:
-	file_input_serializer_free(&s);
-	return success;
+	do_write(info->full_len);
+	do_write(info->face_len);
+	do_write(info->is_bitmap);
+	do_write(info->num_sizes);
+
+	if (!write_data(s, info->sizes, sizeof(int) * info->num_sizes))
+		return false;
+
+	do_write(info->bold);
+	do_write(info->italic);
+	do_write(info->index);
+
+#undef do_write
+
+	return true;
 }
 
-void save_font_list(void)
+static void save_font_list(void)
 {
 	char *file_name = obs_module_config_path("font_data.bin");
-	uint32_t font_checksum = get_font_checksum();
-	int font_count = (int)font_list.num;
+	uint32_t file_count = (uint32_t)font_files.num;
 	struct serializer s;
-	bool success = false;
+	bool success;
 
-	if (font_checksum)
-		success =
-			file_output_serializer_init_safe(&s, file_name, "tmp");
+	success = file_output_serializer_init_safe(&s, file_name, "tmp");
 	bfree(file_name);
 
 	if (!success)
 		return;
 
-	success = write_var(&s, font_cache_ver);
-	if (!success)
-		return;
-	success = write_var(&s, font_checksum);
-	if (!success)
-		return;
-	success = write_var(&s, font_count);
-	if (!success)
-		return;
-
-#define do_write(var)                 \
-	success = write_var(&s, var); \
-	if (!success)                 \
-	break
-
-	for (size_t i = 0; i < font_list.num; i++) {
-		struct font_path_info *info = &font_list.array[i];
-
-		success = write_str(&s, info->face_and_style);
-		if (!success)
-			break;
+	success = write_var(&s, font_cache_ver) && write_var(&s, file_count);
 
-		do_write(info->full_len);
-		do_write(info->face_len);
-		do_write(info->is_bitmap);
-		do_write(info->num_sizes);
+	for (size_t i = 0; success && i < font_files.num; i++) {
+		struct font_file *file = font_files.array + i;
+		uint32_t count = (uint32_t)file->count;
 
-		success = write_data(&s, info->sizes,
-				     sizeof(int) * info->num_sizes);
-		if (!success)
-			break;
+		success = write_str(&s, file->path) &&
+			  write_var(&s, file->mtime) && write_var(&s, count);
 
-		do_write(info->bold);
+		for (size_t j = 0; success && j < file->count; j++) {
+			struct font_path_info *info =
+				font_list.array + file->first + j;
+			success = write_font_info(&s, info);
+		}
+	}
 
-		success = write_str(&s, info->path);
-		if (!success)
-			break;
+	file_output_serializer_free(&s);
+}
 
-		do_write(info->italic);
-		do_write(info->index);
+static struct font_file *find_cached_file(const char *path)
+{
+	/* fonts are usually enumerated in the same order as last time */
+	for (size_t i = cached_file_cursor; i < cached_files.num; i++) {
+		if (strcmp(cached_files.array[i].path, path) == 0) {
+			cached_file_cursor = i + 1;
+			return cached_files.array + i;
+		}
+	}
+	for (size_t i = 0; i < cached_file_cursor; i++) {
+		if (strcmp(cached_files.array[i].path, path) == 0)
+			return cached_files.array + i;
 	}
 
-#undef do_write
-
-	file_output_serializer_free(&s);
+	return NULL;
 }
 
 static void create_bitmap_sizes(struct font_path_info *info, FT_Face face)
@@ -321,11 +365,131 @@ void build_font_path_info(FT_Face face, FT_Long idx, const char *path)
 	da_free(family_names);
 }
 
+void add_font_file(const char *path, uint64_t mtime)
+{
+	struct font_file *cached = find_cached_file(path);
+	struct font_file file = {0};
+
+	file.path = bstrdup(path);
+	file.mtime = mtime;
+	file.first = font_list.num;
+
+	if (cached && cached->mtime == mtime) {
+		/* the cached faces are moved rather than copied */
+		for (size_t i = 0; i < cached->count; i++) {
+			struct font_path_info *info =
+				cached_fonts.array + cached->first + i;
+
+			da_push_back(font_list, info);
+			memset(info, 0, sizeof(*info));
+		}
+		cached->count = 0;
+
+	} else {
+		FT_Long idx = 0;
+		FT_Long max_faces = 1;
+		FT_Face face;
+
+		while (idx < max_faces) {
+			if (FT_New_Face(ft2_lib, path, idx, &face) != 0)
+				break;
+
+			build_font_path_info(face, idx++, path);
+			max_faces = face->num_faces;
+			FT_Done_Face(face);
+		}
+	}
+
+	file.count = font_list.num - file.first;
+	da_push_back(font_files, &file);
+}
+
+/* ------------------------------------------------------------------------- */
+/* family lookup */
+
+/*
+ * A font can only be picked when its whole family name is a prefix of the
+ * requested face and style, so fonts are hashed by their upper case family
+ * name and a lookup only has to check one bucket per prefix of the request.
+ */
+static int *family_buckets;
+static int *family_next;
+static size_t family_mask;
+
+static inline uint32_t hash_step(uint32_t hash, char ch)
+{
+	return (hash ^ (uint8_t)toupper(ch)) * 16777619u;
+}
+
+#define HASH_INIT 2166136261u
+
+static void build_family_index(void)
+{
+	size_t num_buckets = 64;
+
+	while (num_buckets < font_list.num * 2)
+		num_buckets *= 2;
+
+	family_mask = num_buckets - 1;
+	family_buckets = bmalloc(sizeof(int) * num_buckets);
+	family_next = bmalloc(sizeof(int) * (font_list.num + 1));
+
+	for (size_t i = 0; i < num_buckets; i++)
+		family_buckets[i] = -1;
+
+	/* inserted backwards so each bucket stays in list order */
+	for (size_t i = font_list.num; i > 0; i--) {
+		struct font_path_info *info = font_list.array + i - 1;
+		uint32_t hash = HASH_INIT;
+		size_t bucket;
+
+		for (uint32_t j = 0; j < info->face_len; j++)
+			hash = hash_step(hash, info->face_and_style[j]);
+
+		bucket = hash & family_mask;
+		family_next[i - 1] = family_buckets[bucket];
+		family_buckets[bucket] = (int)(i - 1);
+	}
+}
+
+static void free_family_index(void)
+{
+	bfree(family_buckets);
+	bfree(family_next);
+	family_buckets = NULL;
+	family_next = NULL;
+	family_mask = 0;
+}
+
+void finish_font_list(void)
+{
+	size_t reused = 0;
+
+	for (size_t i = 0; i < cached_files.num; i++) {
+		if (!cached_files.array[i].count)
+			reused++;
+	}
+
+	blog(LOG_INFO, "[text-freetype2]: %d fonts in %d files, %d reused "
+		       "from the cache",
+	     (int)font_list.num, (int)font_files.num, (int)reused);
+
+	free_cached_font_list();
+	build_family_index();
+	save_font_list();
+}
+
 void free_os_font_list(void)
 {
 	for (size_t i = 0; i < font_list.num; i++)
 		font_path_info_free(font_list.array + i);
+	for (size_t i = 0; i < font_files.num; i++)
+		bfree(font_files.array[i].path);
 	da_free(font_list);
+	da_free(font_files);
+
+	free_cached_font_list();
+	free_family_index();
 }
 
 static inline size_t get_rating(struct font_path_info *info, struct dstr *cmp)
@@ -352,6 +516,8 @@ const char *get_font_path(const char *family, uint16_t size, const char *style,
 {
 	const char *best_path = NULL;
 	double best_rating = 0.0;
+	int best_index = 0;
+	uint32_t hash = HASH_INIT;
 	struct dstr face_and_style = {0};
 	struct dstr style_str = {0};
 	bool bold = !!(flags & OBS_FONT_BOLD);
@@ -374,36 +540,55 @@ const char *get_font_path(const char *family, uint16_t size, const char *style,
 		dstr_cat_dstr(&face_and_style, &style_str);
 	}
 
-	for (size_t i = 0; i < font_list.num; i++) {
-		struct font_path_info *info = font_list.array + i;
+	if (!family_buckets)
+		goto finish;
 
-		double rating = (double)get_rating(info, &face_and_style);
-		if (rating < info->face_len)
-			continue;
+	for (size_t len = 1; len <= face_and_style.len; len++) {
+		hash = hash_step(hash, face_and_style.array[len - 1]);
 
-		if (info->is_bitmap) {
-			int best_diff = 1000;
-			for (uint32_t j = 0; j < info->num_sizes; j++) {
-				int diff = abs(info->sizes[j] - size);
-				if (diff < best_diff)
-					best_diff = diff;
-			}
+		int i = family_buckets[hash & family_mask];
 
-			rating /= (double)(best_diff + 1.0);
-		}
+		for (; i != -1; i = family_next[i]) {
+			struct font_path_info *info = font_list.array + i;
+			double rating;
+
+			if (info->face_len != len)
+				continue;
 
-		if (info->bold == bold)
-			rating += 1.0;
-		if (info->italic == italic)
-			rating += 1.0;
+			rating = (double)get_rating(info, &face_and_style);
+			if (rating < info->face_len)
+				continue;
 
-		if (rating > best_rating) {
-			best_path = info->path;
-			*idx = info->index;
-			best_rating = rating;
+			if (info->is_bitmap) {
+				int best_diff = 1000;
+				for (uint32_t j = 0; j < info->num_sizes; j++) {
+					int diff = abs(info->sizes[j] - size);
+					if (diff < best_diff)
+						best_diff = diff;
+				}
+
+				rating /= (double)(best_diff + 1.0);
+			}
+
+			if (info->bold == bold)
+				rating += 1.0;
+			if (info->italic == italic)
+				rating += 1.0;
+
+			/* ties go to the font that comes first in the list,
+			 * as they did before the list was hashed */
+			if (rating > best_rating ||
+			    (rating == best_rating && best_path &&
+			     i < best_index)) {
+				best_path = info->path;
+				*idx = info->index;
+				best_rating = rating;
+				best_index = i;
+			}
 		}
 	}
 
+finish:
 	dstr_free(&style_str);
 	dstr_free(&face_and_style);
 	return best_path;
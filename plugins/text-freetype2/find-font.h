@@ -34,6 +34,9 @@ static inline void font_path_info_free(struct font_path_info *info)
 extern void build_font_path_info(FT_Face face, FT_Long idx, const char *path);
 extern char *sfnt_name_to_utf8(FT_SfntName *sfnt_name);
 
+extern void add_font_file(const char *path, uint64_t mtime);
+extern void finish_font_list(void);
+
 extern bool load_cached_os_font_list(void);
 extern void load_os_font_list(void);
 extern void free_os_font_list(void);
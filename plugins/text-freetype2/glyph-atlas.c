@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <string.h>
+#include <util/threading.h>
+#include <util/bmem.h>
+#include "glyph-atlas.h"
+
+#define num_cache_slots 65535
+#define upload_rows 128
+
+extern FT_Library ft2_lib;
+extern uint32_t texbuf_w, texbuf_h;
+
+struct ft2_atlas {
+	struct ft2_atlas *next;
+	long refs;
+
+	char *path;
+	FT_Long index;
+	uint16_t size;
+	bool antialiasing;
+
+	pthread_mutex_t mutex;
+	FT_Face face;
+	struct glyph_info **glyphs;
+
+	uint8_t *texbuf;
+	uint32_t pen_x, pen_y, row_h;
+	bool full;
+
+	/* rows of texbuf not yet uploaded to tex */
+	uint32_t dirty_y, dirty_y2;
+	gs_texture_t *tex;
+	gs_texture_t *upload;
+};
+
+/* also serializes all face creation/destruction on the shared FT_Library */
+static pthread_mutex_t atlas_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ft2_atlas *first_atlas = NULL;
+
+static struct ft2_atlas *atlas_create(const char *path, FT_Long index,
+				      uint16_t size, bool antialiasing)
+{
+	struct ft2_atlas *atlas;
+	FT_Face face;
+
+	if (FT_New_Face(ft2_lib, path, index, &face) != 0)
+		return NULL;
+
+	FT_Set_Pixel_Sizes(face, 0, size);
+	FT_Select_Charmap(face, FT_ENCODING_UNICODE);
+
+	atlas = bzalloc(sizeof(struct ft2_atlas));
+	atlas->refs = 1;
+	atlas->path = bstrdup(path);
+	atlas->index = index;
+	atlas->size = size;
+	atlas->antialiasing = antialiasing;
+	atlas->face = face;
+	atlas->glyphs = bzalloc(sizeof(struct glyph_info *) * num_cache_slots);
+	atlas->texbuf = bzalloc((size_t)texbuf_w * (size_t)texbuf_h);
+	atlas->dirty_y = texbuf_h;
+	pthread_mutex_init(&atlas->mutex, NULL);
+	return atlas;
+}
+
+static void atlas_destroy(struct ft2_atlas *atlas)
+{
+	obs_enter_graphics();
+	gs_texture_destroy(atlas->tex);
+	gs_texture_destroy(atlas->upload);
+	obs_leave_graphics();
+
+	pthread_mutex_lock(&atlas_mutex);
+	FT_Done_Face(atlas->face);
+	pthread_mutex_unlock(&atlas_mutex);
+
+	for (uint32_t i = 0; i < num_cache_slots; i++)
+		bfree(atlas->glyphs[i]);
+	bfree(atlas->glyphs);
+	bfree(atlas->texbuf);
+	bfree(atlas->path);
+	pthread_mutex_destroy(&atlas->mutex);
+	bfree(atlas);
+}
+
+struct ft2_atlas *ft2_atlas_acquire(const char *path, FT_Long index,
+				    uint16_t size, bool antialiasing)
+{
+	struct ft2_atlas *atlas;
+
+	if (!path)
+		return NULL;
+
+	pthread_mutex_lock(&atlas_mutex);
+
+	for (atlas = first_atlas; atlas; atlas = atlas->next) {
+		if (atlas->index == index && atlas->size == size &&
+		    atlas->antialiasing == antialiasing &&
+		    strcmp(atlas->path, path) == 0) {
+			atlas->refs++;
+			break;
+		}
+	}
+
+	if (!atlas) {
+		atlas = atlas_create(path, index, size, antialiasing);
+		if (atlas) {
+			atlas->next = first_atlas;
+			first_atlas = atlas;
+		}
+	}
+
+	pthread_mutex_unlock(&atlas_mutex);
+	return atlas;
+}
+
+void ft2_atlas_release(struct ft2_atlas *atlas)
+{
+	struct ft2_atlas **p_atlas;
+
+	if (!atlas)
+		return;
+
+	pthread_mutex_lock(&atlas_mutex);
+
+	if (--atlas->refs > 0) {
+		pthread_mutex_unlock(&atlas_mutex);
+		return;
+	}
+
+	for (p_atlas = &first_atlas; *p_atlas; p_atlas = &(*p_atlas)->next) {
+		if (*p_atlas == atlas) {
+			*p_atlas = atlas->next;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&atlas_mutex);
+	atlas_destroy(atlas);
+}
+
+void ft2_atlas_lock(struct ft2_atlas *atlas)
+{
+	pthread_mutex_lock(&atlas->mutex);
+}
+
+void ft2_atlas_unlock(struct ft2_atlas *atlas)
+{
+	pthread_mutex_unlock(&atlas->mutex);
+}
+
+FT_Face ft2_atlas_get_face(struct ft2_atlas *atlas)
+{
+	return atlas->face;
+}
+
+struct glyph_info *ft2_atlas_get_glyph(struct ft2_atlas *atlas,
+				       FT_UInt glyph_index)
+{
+	return glyph_index < num_cache_slots ? atlas->glyphs[glyph_index]
+					     : NULL;
+}
+
+static inline FT_Render_Mode get_render_mode(struct ft2_atlas *atlas)
+{
+	return atlas->antialiasing ? FT_RENDER_MODE_NORMAL
+				   : FT_RENDER_MODE_MONO;
+}
+
+static void load_glyph(struct ft2_atlas *atlas, const FT_UInt glyph_index)
+{
+	const FT_Int32 load_mode = atlas->antialiasing ? FT_LOAD_DEFAULT
+						       : FT_LOAD_TARGET_MONO;
+	FT_Load_Glyph(atlas->face, glyph_index, load_mode);
+}
+
+static struct glyph_info *init_glyph(FT_GlyphSlot slot, const uint32_t dx,
+				     const uint32_t dy, const uint32_t g_w,
+				     const uint32_t g_h)
+{
+	struct glyph_info *glyph = bzalloc(sizeof(struct glyph_info));
+	glyph->u = (float)dx / (float)texbuf_w;
+	glyph->u2 = (float)(dx + g_w) / (float)texbuf_w;
+	glyph->v = (float)dy / (float)texbuf_h;
+	glyph->v2 = (float)(dy + g_h) / (float)texbuf_h;
+	glyph->w = g_w;
+	glyph->h = g_h;
+	glyph->yoff = slot->bitmap_top;
+	glyph->xoff = slot->bitmap_left;
+	glyph->xadv = slot->advance.x >> 6;
+
+	return glyph;
+}
+
+static uint8_t get_pixel_value(const unsigned char *buf_row,
+			       FT_Render_Mode render_mode, const uint32_t x)
+{
+	if (render_mode == FT_RENDER_MODE_NORMAL) {
+		return buf_row[x];
+	}
+
+	const uint32_t byte_index = x / 8;
+	const uint8_t bit_index = x % 8;
+	const bool pixel_set = (buf_row[byte_index] >> (7 - bit_index)) & 1;
+	return pixel_set ? 255 : 0;
+}
+
+static void rasterize(struct ft2_atlas *atlas, FT_GlyphSlot slot,
+		      const FT_Render_Mode render_mode, const uint32_t dx,
+		      const uint32_t dy)
+{
+	/**
+	 * The pitch's absolute value is the number of bytes taken by one bitmap
+	 * row, including padding.
+	 *
+	 * Source: https://www.freetype.org/freetype2/docs/reference/ft2-basic_types.html
+	 */
+	const int pitch = abs(slot->bitmap.pitch);
+
+	for (uint32_t y = 0; y < slot->bitmap.rows; y++) {
+		const uint32_t row_start = y * pitch;
+		const uint32_t row = (dy + y) * texbuf_w;
+
+		for (uint32_t x = 0; x < slot->bitmap.width; x++) {
+			const uint32_t row_pixel_position = dx + x;
+			const uint8_t pixel_value =
+				get_pixel_value(&slot->bitmap.buffer[row_start],
+						render_mode, x);
+			atlas->texbuf[row_pixel_position + row] = pixel_value;
+		}
+	}
+
+	if (dy < atlas->dirty_y)
+		atlas->dirty_y = dy;
+	if (dy + slot->bitmap.rows > atlas->dirty_y2)
+		atlas->dirty_y2 = dy + slot->bitmap.rows;
+}
+
+struct glyph_info *ft2_atlas_cache_glyph(struct ft2_atlas *atlas,
+					 FT_UInt glyph_index)
+{
+	const FT_Render_Mode render_mode = get_render_mode(atlas);
+	FT_GlyphSlot slot = atlas->face->glyph;
+	struct glyph_info *glyph;
+
+	if (glyph_index >= num_cache_slots)
+		return NULL;
+	if (atlas->glyphs[glyph_index])
+		return atlas->glyphs[glyph_index];
+
+	load_glyph(atlas, glyph_index);
+	FT_Render_Glyph(slot, render_mode);
+
+	const uint32_t g_w = slot->bitmap.width;
+	const uint32_t g_h = slot->bitmap.rows;
+	uint32_t dx = atlas->pen_x;
+	uint32_t dy = atlas->pen_y;
+
+	if (dx + g_w >= texbuf_w) {
+		dx = 0;
+		dy += atlas->row_h + 1;
+		atlas->row_h = 0;
+	}
+
+	if (dy + g_h >= texbuf_h) {
+		if (!atlas->full)
+			blog(LOG_WARNING,
+			     "Out of space trying to render glyphs");
+		atlas->full = true;
+		return NULL;
+	}
+
+	glyph = init_glyph(slot, dx, dy, g_w, g_h);
+	rasterize(atlas, slot, render_mode, dx, dy);
+	atlas->glyphs[glyph_index] = glyph;
+
+	if (atlas->row_h < g_h)
+		atlas->row_h = g_h;
+
+	atlas->pen_x = dx + g_w + 1;
+	atlas->pen_y = dy;
+	return glyph;
+}
+
+int32_t ft2_atlas_get_advance(struct ft2_atlas *atlas, FT_UInt glyph_index)
+{
+	struct glyph_info *glyph = ft2_atlas_get_glyph(atlas, glyph_index);
+	if (glyph)
+		return glyph->xadv;
+
+	load_glyph(atlas, glyph_index);
+	return atlas->face->glyph->advance.x >> 6;
+}
+
+static void upload_dirty_rows(struct ft2_atlas *atlas)
+{
+	uint32_t y = atlas->dirty_y;
+
+	if (!atlas->upload) {
+		atlas->upload = gs_texture_create(texbuf_w, upload_rows, GS_A8,
+						  1, NULL, GS_DYNAMIC);
+		if (!atlas->upload)
+			return;
+	}
+
+	while (y < atlas->dirty_y2) {
+		uint32_t rows = atlas->dirty_y2 - y;
+		uint32_t linesize;
+		uint8_t *ptr;
+
+		if (rows > upload_rows)
+			rows = upload_rows;
+
+		if (!gs_texture_map(atlas->upload, &ptr, &linesize))
+			return;
+
+		for (uint32_t i = 0; i < rows; i++)
+			memcpy(ptr + (size_t)linesize * i,
+			       atlas->texbuf + (size_t)texbuf_w * (y + i),
+			       texbuf_w);
+
+		gs_texture_unmap(atlas->upload);
+		gs_copy_texture_region(atlas->tex, 0, y, atlas->upload, 0, 0,
+				       texbuf_w, rows);
+		y += rows;
+	}
+
+	atlas->dirty_y = texbuf_h;
+	atlas->dirty_y2 = 0;
+}
+
+gs_texture_t *ft2_atlas_get_texture(struct ft2_atlas *atlas)
+{
+	gs_texture_t *tex;
+
+	ft2_atlas_lock(atlas);
+
+	if (!atlas->tex) {
+		atlas->tex = gs_texture_create(
+			texbuf_w, texbuf_h, GS_A8, 1,
+			(const uint8_t **)&atlas->texbuf, 0);
+		atlas->dirty_y = texbuf_h;
+		atlas->dirty_y2 = 0;
+
+	} else if (atlas->dirty_y < atlas->dirty_y2) {
+		/* only the rows holding glyphs added since the last upload */
+		upload_dirty_rows(atlas);
+	}
+
+	tex = atlas->tex;
+	ft2_atlas_unlock(atlas);
+	return tex;
+}
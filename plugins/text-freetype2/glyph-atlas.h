@@ -0,0 +1,42 @@
+#pragma once
+
+#include <obs-module.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+/*
+ * Glyph atlases are shared by every text source using the same font file,
+ * face index, size and render mode.  Each atlas owns its FT_Face, the glyph
+ * metrics and a single A8 texture to which newly rasterized glyphs are
+ * uploaded incrementally.
+ *
+ * The face and glyph table are only valid while the atlas is locked.  The
+ * lock may be taken while inside the graphics context, but the graphics
+ * context must never be entered while the lock is held.
+ */
+
+struct glyph_info {
+	float u, v, u2, v2;
+	int32_t w, h, xoff, yoff;
+	int32_t xadv;
+};
+
+struct ft2_atlas;
+
+extern struct ft2_atlas *ft2_atlas_acquire(const char *path, FT_Long index,
+					   uint16_t size, bool antialiasing);
+extern void ft2_atlas_release(struct ft2_atlas *atlas);
+
+extern void ft2_atlas_lock(struct ft2_atlas *atlas);
+extern void ft2_atlas_unlock(struct ft2_atlas *atlas);
+
+extern FT_Face ft2_atlas_get_face(struct ft2_atlas *atlas);
+extern struct glyph_info *ft2_atlas_get_glyph(struct ft2_atlas *atlas,
+					      FT_UInt glyph_index);
+extern struct glyph_info *ft2_atlas_cache_glyph(struct ft2_atlas *atlas,
+						FT_UInt glyph_index);
+extern int32_t ft2_atlas_get_advance(struct ft2_atlas *atlas,
+				     FT_UInt glyph_index);
+
+/* graphics context only; uploads any glyphs added since the last call */
+extern gs_texture_t *ft2_atlas_get_texture(struct ft2_atlas *atlas);
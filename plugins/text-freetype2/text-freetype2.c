@@ -17,6 +17,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <obs-module.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include <sys/stat.h>
@@ -39,7 +40,7 @@ static struct obs_source_info freetype2_source_info_v1 = {
 	.id = "text_ft2_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
 	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE |
-			OBS_SOURCE_CUSTOM_DRAW,
+			OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_CACHEABLE_VIDEO,
 	.get_name = ft2_source_get_name,
 	.create = ft2_source_create_v1,
 	.destroy = ft2_source_destroy,
@@ -60,7 +61,7 @@ static struct obs_source_info freetype2_source_info_v2 = {
 #ifdef _WIN32
 			OBS_SOURCE_DEPRECATED |
 #endif
-			OBS_SOURCE_CUSTOM_DRAW,
+			OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_CACHEABLE_VIDEO,
 	.get_name = ft2_source_get_name,
 	.create = ft2_source_create_v2,
 	.destroy = ft2_source_destroy,
@@ -75,12 +76,26 @@ static struct obs_source_info freetype2_source_info_v2 = {
 };
 
 static bool plugin_initialized = false;
+static bool font_list_thread_active = false;
+static pthread_t font_list_thread;
 
-static void init_plugin(void)
+static void *font_list_thread_func(void *unused)
 {
-	if (plugin_initialized)
-		return;
+	os_set_thread_name("text-ft2: load font list");
+
+	/* the cache only saves reopening font files that did not change,
+	 * the font directories are always enumerated again */
+	load_cached_os_font_list();
+	load_os_font_list();
 
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+/* enumerating the system fonts can take seconds, so it is started as soon
+ * as the module loads and only waited for once a source needs a font */
+static void start_loading_fonts(void)
+{
 	FT_Init_FreeType(&ft2_lib);
 
 	if (ft2_lib == NULL) {
@@ -88,8 +103,22 @@ static void init_plugin(void)
 		return;
 	}
 
-	if (!load_cached_os_font_list())
-		load_os_font_list();
+	if (pthread_create(&font_list_thread, NULL, font_list_thread_func,
+			   NULL) == 0)
+		font_list_thread_active = true;
+	else
+		font_list_thread_func(NULL);
+}
+
+static void init_plugin(void)
+{
+	if (plugin_initialized || ft2_lib == NULL)
+		return;
+
+	if (font_list_thread_active) {
+		pthread_join(font_list_thread, NULL);
+		font_list_thread_active = false;
+	}
 
 	plugin_initialized = true;
 }
@@ -105,12 +134,16 @@ bool obs_module_load()
 	obs_register_source(&freetype2_source_info_v1);
 	obs_register_source(&freetype2_source_info_v2);
 
+	start_loading_fonts();
 	return true;
 }
 
 void obs_module_unload(void)
 {
-	if (plugin_initialized) {
+	if (font_list_thread_active)
+		pthread_join(font_list_thread, NULL);
+
+	if (ft2_lib != NULL) {
 		free_os_font_list();
 		FT_Done_FreeType(ft2_lib);
 	}
@@ -192,17 +225,8 @@ static void ft2_source_destroy(void *data)
 {
 	struct ft2_source *srcdata = data;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
-
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
+	ft2_atlas_release(srcdata->atlas);
+	srcdata->atlas = NULL;
 
 	if (srcdata->font_name != NULL)
 		bfree(srcdata->font_name);
@@ -210,8 +234,6 @@ static void ft2_source_destroy(void *data)
 		bfree(srcdata->font_style);
 	if (srcdata->text != NULL)
 		bfree(srcdata->text);
-	if (srcdata->texbuf != NULL)
-		bfree(srcdata->texbuf);
 	if (srcdata->colorbuf != NULL)
 		bfree(srcdata->colorbuf);
 	if (srcdata->text_file != NULL)
@@ -219,10 +241,6 @@ static void ft2_source_destroy(void *data)
 
 	obs_enter_graphics();
 
-	if (srcdata->tex != NULL) {
-		gs_texture_destroy(srcdata->tex);
-		srcdata->tex = NULL;
-	}
 	if (srcdata->vbuf != NULL) {
 		gs_vertexbuffer_destroy(srcdata->vbuf);
 		srcdata->vbuf = NULL;
@@ -243,20 +261,24 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 	if (srcdata == NULL)
 		return;
 
-	if (srcdata->tex == NULL || srcdata->vbuf == NULL)
+	if (srcdata->atlas == NULL || srcdata->vbuf == NULL)
 		return;
 	if (srcdata->text == NULL || *srcdata->text == 0)
 		return;
 
+	gs_texture_t *tex = ft2_atlas_get_texture(srcdata->atlas);
+	if (tex == NULL)
+		return;
+
 	const bool previous = gs_set_linear_srgb(true);
 
 	gs_reset_blend_state();
 	if (srcdata->outline_text)
-		draw_outlines(srcdata);
+		draw_outlines(srcdata, tex);
 	if (srcdata->drop_shadow)
-		draw_drop_shadow(srcdata);
+		draw_drop_shadow(srcdata, tex);
 
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect,
+	draw_uv_vbuffer(srcdata->vbuf, tex, srcdata->draw_effect,
 			(uint32_t)wcslen(srcdata->text) * 6);
 
 	gs_set_linear_srgb(previous);
@@ -285,6 +307,7 @@ static void ft2_video_tick(void *data, float seconds)
 			cache_glyphs(srcdata, srcdata->text);
 			set_up_vertex_buffer(srcdata);
 			srcdata->update_file = false;
+			obs_source_content_changed(srcdata->src);
 		}
 
 		if (srcdata->m_timestamp != t) {
@@ -305,12 +328,20 @@ static bool init_font(struct ft2_source *srcdata)
 	if (!path)
 		return false;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
+	struct ft2_atlas *atlas = ft2_atlas_acquire(
+		path, index, srcdata->font_size, srcdata->antialiasing);
+	if (!atlas)
+		return false;
 
-	return FT_New_Face(ft2_lib, path, index, &srcdata->font_face) == 0;
+	/* swapped inside the graphics context so rendering never sees an
+	 * atlas that is about to be released */
+	obs_enter_graphics();
+	struct ft2_atlas *old_atlas = srcdata->atlas;
+	srcdata->atlas = atlas;
+	obs_leave_graphics();
+
+	ft2_atlas_release(old_atlas);
+	return true;
 }
 
 static void ft2_source_update(void *data, obs_data_t *settings)
@@ -381,8 +412,6 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	if (ft2_lib == NULL)
 		goto error;
 
-	const size_t texbuf_size = (size_t)texbuf_w * (size_t)texbuf_h;
-
 	if (srcdata->draw_effect == NULL) {
 		char *effect_file = NULL;
 		char *error_string = NULL;
@@ -406,13 +435,7 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 
 	const bool new_aa_setting = obs_data_get_bool(settings, "antialiasing");
 	const bool aa_changed = srcdata->antialiasing != new_aa_setting;
-	if (aa_changed) {
-		srcdata->antialiasing = new_aa_setting;
-		if (srcdata->texbuf != NULL) {
-			memset(srcdata->texbuf, 0, texbuf_size);
-		}
-		cache_standard_glyphs(srcdata);
-	}
+	srcdata->antialiasing = new_aa_setting;
 
 	srcdata->file_load_failed = false;
 	srcdata->from_file = from_file;
@@ -421,7 +444,7 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 		if (strcmp(font_name, srcdata->font_name) == 0 &&
 		    strcmp(font_style, srcdata->font_style) == 0 &&
 		    font_flags == srcdata->font_flags &&
-		    font_size == srcdata->font_size)
+		    font_size == srcdata->font_size && !aa_changed)
 			goto skip_font_load;
 
 		bfree(srcdata->font_name);
@@ -437,23 +460,13 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	srcdata->font_size = font_size;
 	srcdata->font_flags = font_flags;
 
-	if (!init_font(srcdata) || srcdata->font_face == NULL) {
+	if (!init_font(srcdata) || srcdata->atlas == NULL) {
 		blog(LOG_WARNING, "FT2-text: Failed to load font %s",
 		     srcdata->font_name);
 		goto error;
-	} else {
-		FT_Set_Pixel_Sizes(srcdata->font_face, 0, srcdata->font_size);
-		FT_Select_Charmap(srcdata->font_face, FT_ENCODING_UNICODE);
-	}
-
-	if (srcdata->texbuf != NULL) {
-		bfree(srcdata->texbuf);
-		srcdata->texbuf = NULL;
 	}
-	srcdata->texbuf = bzalloc(texbuf_size);
 
-	if (srcdata->font_face)
-		cache_standard_glyphs(srcdata);
+	cache_standard_glyphs(srcdata);
 
 skip_font_load:
 	if (from_file) {
@@ -499,7 +512,7 @@ skip_font_load:
 		os_utf8_to_wcs_ptr(tmp, strlen(tmp), &srcdata->text);
 	}
 
-	if (srcdata->font_face) {
+	if (srcdata->atlas) {
 		cache_glyphs(srcdata, srcdata->text);
 		set_up_vertex_buffer(srcdata);
 	}
@@ -19,15 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <obs-module.h>
 #include <ft2build.h>
-
-#define num_cache_slots 65535
-#define src_glyph srcdata->cacheglyphs[glyph_index]
-
-struct glyph_info {
-	float u, v, u2, v2;
-	int32_t w, h, xoff, yoff;
-	int32_t xadv;
-};
+#include "glyph-atlas.h"
 
 struct ft2_source {
 	char *font_name;
@@ -46,20 +38,15 @@ struct ft2_source {
 
 	uint32_t cx, cy, max_h, custom_width;
 	uint32_t outline_width;
-	uint32_t texbuf_x, texbuf_y;
 	uint32_t color[2];
 	uint32_t *colorbuf;
 
 	int32_t cur_scroll, scroll_speed;
 
-	gs_texture_t *tex;
-
-	struct glyph_info *cacheglyphs[num_cache_slots];
-
-	FT_Face font_face;
+	struct ft2_atlas *atlas;
 
-	uint8_t *texbuf;
 	gs_vertbuffer_t *vbuf;
+	uint32_t vbuf_verts;
 
 	gs_effect_t *draw_effect;
 	bool outline_text, drop_shadow;
@@ -78,8 +65,8 @@ static void ft2_source_update(void *data, obs_data_t *settings);
 static void ft2_source_render(void *data, gs_effect_t *effect);
 static void ft2_video_tick(void *data, float seconds);
 
-void draw_outlines(struct ft2_source *srcdata);
-void draw_drop_shadow(struct ft2_source *srcdata);
+void draw_outlines(struct ft2_source *srcdata, gs_texture_t *tex);
+void draw_drop_shadow(struct ft2_source *srcdata, gs_texture_t *tex);
 
 static uint32_t ft2_source_get_width(void *data);
 static uint32_t ft2_source_get_height(void *data);
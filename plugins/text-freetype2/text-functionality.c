@@ -26,9 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 float offsets[16] = {-2.0f, 0.0f, 0.0f, -2.0f, 2.0f,  0.0f, 2.0f,  0.0f,
 		     0.0f,  2.0f, 0.0f, 2.0f,  -2.0f, 0.0f, -2.0f, 0.0f};
 
-extern uint32_t texbuf_w, texbuf_h;
-
-void draw_outlines(struct ft2_source *srcdata)
+void draw_outlines(struct ft2_source *srcdata, gs_texture_t *tex)
 {
 	// Horrible (hopefully temporary) solution for outlines.
 	uint32_t *tmp;
@@ -45,8 +43,7 @@ void draw_outlines(struct ft2_source *srcdata)
 	for (int32_t i = 0; i < 8; i++) {
 		gs_matrix_translate3f(offsets[i * 2], offsets[(i * 2) + 1],
 				      0.0f);
-		draw_uv_vbuffer(srcdata->vbuf, srcdata->tex,
-				srcdata->draw_effect,
+		draw_uv_vbuffer(srcdata->vbuf, tex, srcdata->draw_effect,
 				(uint32_t)wcslen(srcdata->text) * 6);
 	}
 	gs_matrix_identity();
@@ -55,7 +52,7 @@ void draw_outlines(struct ft2_source *srcdata)
 	vdata->colors = tmp;
 }
 
-void draw_drop_shadow(struct ft2_source *srcdata)
+void draw_drop_shadow(struct ft2_source *srcdata, gs_texture_t *tex)
 {
 	// Horrible (hopefully temporary) solution for drop shadow.
 	uint32_t *tmp;
@@ -70,7 +67,7 @@ void draw_drop_shadow(struct ft2_source *srcdata)
 
 	gs_matrix_push();
 	gs_matrix_translate3f(4.0f, 4.0f, 0.0f);
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect,
+	draw_uv_vbuffer(srcdata->vbuf, tex, srcdata->draw_effect,
 			(uint32_t)wcslen(srcdata->text) * 6);
 	gs_matrix_identity();
 	gs_matrix_pop();
@@ -82,9 +79,10 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 {
 	FT_UInt glyph_index = 0;
 	uint32_t x = 0, space_pos = 0, word_width = 0;
+	uint32_t num_verts;
 	size_t len;
 
-	if (!srcdata->text)
+	if (!srcdata->text || !srcdata->atlas)
 		return;
 
 	if (srcdata->custom_width >= 100)
@@ -94,19 +92,27 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 	srcdata->cy = srcdata->max_h;
 
 	obs_enter_graphics();
-	if (srcdata->vbuf != NULL) {
-		gs_vertbuffer_t *tmpvbuf = srcdata->vbuf;
-		srcdata->vbuf = NULL;
-		gs_vertexbuffer_destroy(tmpvbuf);
-	}
 
 	if (*srcdata->text == 0) {
 		obs_leave_graphics();
 		return;
 	}
 
-	srcdata->vbuf =
-		create_uv_vbuffer((uint32_t)wcslen(srcdata->text) * 6, true);
+	/* only recreated when the text outgrows it, fill_vertex_buffer clears
+	 * whatever the current text does not use */
+	num_verts = (uint32_t)wcslen(srcdata->text) * 6;
+	if (srcdata->vbuf == NULL || srcdata->vbuf_verts < num_verts) {
+		if (srcdata->vbuf != NULL) {
+			gs_vertbuffer_t *tmpvbuf = srcdata->vbuf;
+			srcdata->vbuf = NULL;
+			gs_vertexbuffer_destroy(tmpvbuf);
+		}
+
+		srcdata->vbuf = create_uv_vbuffer(num_verts, true);
+		srcdata->vbuf_verts = srcdata->vbuf ? num_verts : 0;
+	}
+
+	ft2_atlas_lock(srcdata->atlas);
 
 	if (srcdata->custom_width <= 100)
 		goto skip_word_wrap;
@@ -138,14 +144,16 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 		if (srcdata->text[i] == L' ')
 			space_pos = i;
 	next_char:;
-		glyph_index =
-			FT_Get_Char_Index(srcdata->font_face, srcdata->text[i]);
-		word_width += src_glyph->xadv;
+		glyph_index = FT_Get_Char_Index(
+			ft2_atlas_get_face(srcdata->atlas), srcdata->text[i]);
+		word_width +=
+			ft2_atlas_get_advance(srcdata->atlas, glyph_index);
 	eos_skip:;
 	}
 
 skip_word_wrap:;
 	fill_vertex_buffer(srcdata);
+	ft2_atlas_unlock(srcdata->atlas);
 	obs_leave_graphics();
 }
 
@@ -158,7 +166,9 @@ void fill_vertex_buffer(struct ft2_source *srcdata)
 	struct vec2 *tvarray = (struct vec2 *)vdata->tvarray[0].array;
 	uint32_t *col = (uint32_t *)vdata->colors;
 
+	FT_Face face = ft2_atlas_get_face(srcdata->atlas);
 	FT_UInt glyph_index = 0;
+	struct glyph_info *glyph;
 
 	uint32_t dx = 0, dy = srcdata->max_h, max_y = dy;
 	uint32_t cur_glyph = 0;
@@ -196,15 +206,15 @@ void fill_vertex_buffer(struct ft2_source *srcdata)
 		if (srcdata->text[i] == L'\r')
 			goto skip_glyph;
 
-		glyph_index =
-			FT_Get_Char_Index(srcdata->font_face, srcdata->text[i]);
-		if (src_glyph == NULL)
+		glyph_index = FT_Get_Char_Index(face, srcdata->text[i]);
+		glyph = ft2_atlas_get_glyph(srcdata->atlas, glyph_index);
+		if (glyph == NULL)
 			goto skip_glyph;
 
 		if (srcdata->custom_width < 100)
 			goto skip_custom_width;
 
-		if (dx + src_glyph->xadv > srcdata->custom_width) {
+		if (dx + glyph->xadv > srcdata->custom_width) {
 			dx = offset;
 			dy += srcdata->max_h + 4;
 		}
@@ -212,187 +222,57 @@ void fill_vertex_buffer(struct ft2_source *srcdata)
 	skip_custom_width:;
 
 		set_v3_rect(vdata->points + (cur_glyph * 6),
-			    (float)dx + (float)src_glyph->xoff,
-			    (float)dy - (float)src_glyph->yoff,
-			    (float)src_glyph->w, (float)src_glyph->h);
-		set_v2_uv(tvarray + (cur_glyph * 6), src_glyph->u, src_glyph->v,
-			  src_glyph->u2, src_glyph->v2);
+			    (float)dx + (float)glyph->xoff,
+			    (float)dy - (float)glyph->yoff, (float)glyph->w,
+			    (float)glyph->h);
+		set_v2_uv(tvarray + (cur_glyph * 6), glyph->u, glyph->v,
+			  glyph->u2, glyph->v2);
 		set_rect_colors2(col + (cur_glyph * 6), srcdata->color[0],
 				 srcdata->color[1]);
-		dx += src_glyph->xadv;
-		if (dy - (float)src_glyph->yoff + src_glyph->h > max_y)
-			max_y = dy - src_glyph->yoff + src_glyph->h;
+		dx += glyph->xadv;
+		if (dy - (float)glyph->yoff + glyph->h > max_y)
+			max_y = dy - glyph->yoff + glyph->h;
 		cur_glyph++;
 	skip_glyph:;
 	}
 
+	/* the buffer may be larger than the text or have skipped glyphs */
+	memset(vdata->points + cur_glyph * 6, 0,
+	       sizeof(struct vec3) * (srcdata->vbuf_verts - cur_glyph * 6));
+
 	srcdata->cy = max_y;
 }
 
 void cache_standard_glyphs(struct ft2_source *srcdata)
 {
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
-
-	srcdata->texbuf_x = 0;
-	srcdata->texbuf_y = 0;
-
 	cache_glyphs(srcdata, L"abcdefghijklmnopqrstuvwxyz"
 			      L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890"
 			      L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0");
 }
 
-FT_Render_Mode get_render_mode(struct ft2_source *srcdata)
-{
-	return srcdata->antialiasing ? FT_RENDER_MODE_NORMAL
-				     : FT_RENDER_MODE_MONO;
-}
-
-void load_glyph(struct ft2_source *srcdata, const FT_UInt glyph_index,
-		const FT_Render_Mode render_mode)
-{
-	const FT_Int32 load_mode = render_mode == FT_RENDER_MODE_MONO
-					   ? FT_LOAD_TARGET_MONO
-					   : FT_LOAD_DEFAULT;
-	FT_Load_Glyph(srcdata->font_face, glyph_index, load_mode);
-}
-
-struct glyph_info *init_glyph(FT_GlyphSlot slot, const uint32_t dx,
-			      const uint32_t dy, const uint32_t g_w,
-			      const uint32_t g_h)
-{
-	struct glyph_info *glyph = bzalloc(sizeof(struct glyph_info));
-	glyph->u = (float)dx / (float)texbuf_w;
-	glyph->u2 = (float)(dx + g_w) / (float)texbuf_w;
-	glyph->v = (float)dy / (float)texbuf_h;
-	glyph->v2 = (float)(dy + g_h) / (float)texbuf_h;
-	glyph->w = g_w;
-	glyph->h = g_h;
-	glyph->yoff = slot->bitmap_top;
-	glyph->xoff = slot->bitmap_left;
-	glyph->xadv = slot->advance.x >> 6;
-
-	return glyph;
-}
-
-uint8_t get_pixel_value(const unsigned char *buf_row,
-			FT_Render_Mode render_mode, const uint32_t x)
-{
-	if (render_mode == FT_RENDER_MODE_NORMAL) {
-		return buf_row[x];
-	}
-
-	const uint32_t byte_index = x / 8;
-	const uint8_t bit_index = x % 8;
-	const bool pixel_set = (buf_row[byte_index] >> (7 - bit_index)) & 1;
-	return pixel_set ? 255 : 0;
-}
-
-void rasterize(struct ft2_source *srcdata, FT_GlyphSlot slot,
-	       const FT_Render_Mode render_mode, const uint32_t dx,
-	       const uint32_t dy)
-{
-	/**
-	 * The pitch's absolute value is the number of bytes taken by one bitmap
-	 * row, including padding.
-	 *
-	 * Source: https://www.freetype.org/freetype2/docs/reference/ft2-basic_types.html
-	 */
-	const int pitch = abs(slot->bitmap.pitch);
-
-	for (uint32_t y = 0; y < slot->bitmap.rows; y++) {
-		const uint32_t row_start = y * pitch;
-		const uint32_t row = (dy + y) * texbuf_w;
-
-		for (uint32_t x = 0; x < slot->bitmap.width; x++) {
-			const uint32_t row_pixel_position = dx + x;
-			const uint8_t pixel_value =
-				get_pixel_value(&slot->bitmap.buffer[row_start],
-						render_mode, x);
-			srcdata->texbuf[row_pixel_position + row] = pixel_value;
-		}
-	}
-}
-
 void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
 {
-	if (!srcdata->font_face || !cache_glyphs)
+	if (!srcdata->atlas || !cache_glyphs)
 		return;
 
-	FT_GlyphSlot slot = srcdata->font_face->glyph;
-
-	uint32_t dx = srcdata->texbuf_x;
-	uint32_t dy = srcdata->texbuf_y;
-
-	int32_t cached_glyphs = 0;
 	const size_t len = wcslen(cache_glyphs);
 
-	const FT_Render_Mode render_mode = get_render_mode(srcdata);
+	/* glyphs already rasterized by any source sharing the atlas are
+	 * reused, new ones are uploaded the next time it is drawn */
+	ft2_atlas_lock(srcdata->atlas);
+	FT_Face face = ft2_atlas_get_face(srcdata->atlas);
 
 	for (size_t i = 0; i < len; i++) {
 		const FT_UInt glyph_index =
-			FT_Get_Char_Index(srcdata->font_face, cache_glyphs[i]);
-
-		if (src_glyph != NULL) {
-			continue;
-		}
-
-		load_glyph(srcdata, glyph_index, render_mode);
-		FT_Render_Glyph(slot, render_mode);
-
-		const uint32_t g_w = slot->bitmap.width;
-		const uint32_t g_h = slot->bitmap.rows;
-
-		if (srcdata->max_h < g_h) {
-			srcdata->max_h = g_h;
-		}
-
-		if (dx + g_w >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h + 1;
-		}
-
-		if (dy + g_h >= texbuf_h) {
-			blog(LOG_WARNING,
-			     "Out of space trying to render glyphs");
-			break;
-		}
+			FT_Get_Char_Index(face, cache_glyphs[i]);
+		const struct glyph_info *glyph =
+			ft2_atlas_cache_glyph(srcdata->atlas, glyph_index);
 
-		src_glyph = init_glyph(slot, dx, dy, g_w, g_h);
-		rasterize(srcdata, slot, render_mode, dx, dy);
-
-		dx += (g_w + 1);
-		if (dx >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h;
-		}
-
-		cached_glyphs++;
+		if (glyph && srcdata->max_h < (uint32_t)glyph->h)
+			srcdata->max_h = glyph->h;
 	}
 
-	srcdata->texbuf_x = dx;
-	srcdata->texbuf_y = dy;
-
-	if (cached_glyphs > 0) {
-
-		obs_enter_graphics();
-
-		if (srcdata->tex != NULL) {
-			gs_texture_t *tmp_texture = srcdata->tex;
-			srcdata->tex = NULL;
-			gs_texture_destroy(tmp_texture);
-		}
-
-		srcdata->tex = gs_texture_create(
-			texbuf_w, texbuf_h, GS_A8, 1,
-			(const uint8_t **)&srcdata->texbuf, 0);
-
-		obs_leave_graphics();
-	}
+	ft2_atlas_unlock(srcdata->atlas);
 }
 
 time_t get_modified_timestamp(char *filename)
@@ -558,27 +438,29 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
 {
-	if (!text) {
+	if (!text || !srcdata->atlas) {
 		return 0;
 	}
 
-	FT_GlyphSlot slot = srcdata->font_face->glyph;
 	uint32_t w = 0, max_w = 0;
 	const size_t len = wcslen(text);
-	for (size_t i = 0; i < len; i++) {
-		const FT_UInt glyph_index =
-			FT_Get_Char_Index(srcdata->font_face, text[i]);
 
-		load_glyph(srcdata, glyph_index, get_render_mode(srcdata));
+	ft2_atlas_lock(srcdata->atlas);
+	FT_Face face = ft2_atlas_get_face(srcdata->atlas);
 
+	for (size_t i = 0; i < len; i++) {
 		if (text[i] == L'\n')
 			w = 0;
 		else {
-			w += slot->advance.x >> 6;
+			const FT_UInt glyph_index =
+				FT_Get_Char_Index(face, text[i]);
+			w += ft2_atlas_get_advance(srcdata->atlas,
+						   glyph_index);
 			if (w > max_w)
 				max_w = w;
 		}
 	}
 
+	ft2_atlas_unlock(srcdata->atlas);
 	return max_w;
 }
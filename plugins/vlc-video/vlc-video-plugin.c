@@ -7,6 +7,16 @@
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("vlc-video", "en-US")
+OBS_MODULE_LOAD_FLAGS(OBS_MODULE_LOAD_THREAD_SAFE | OBS_MODULE_LOAD_DEFERRED)
+
+/* looking for and loading libvlc is only done once the source is used */
+static const char *const vlc_types[] = {"vlc_source", NULL};
+
+MODULE_EXPORT const char *const *obs_module_types(void)
+{
+	return vlc_types;
+}
+
 MODULE_EXPORT const char *obs_module_description(void)
 {
 	return "VLC playlist source";
@@ -25,6 +35,7 @@ LIBVLC_MEDIA_ADD_OPTION libvlc_media_add_option_;
 LIBVLC_MEDIA_RELEASE libvlc_media_release_;
 LIBVLC_MEDIA_RELEASE libvlc_media_retain_;
 LIBVLC_MEDIA_GET_META libvlc_media_get_meta_;
+LIBVLC_MEDIA_PARSE_WITH_OPTIONS libvlc_media_parse_with_options_;
 
 /* libvlc media player */
 LIBVLC_MEDIA_PLAYER_NEW libvlc_media_player_new_;
@@ -103,6 +114,9 @@ static bool load_vlc_funcs(void)
 	LOAD_VLC_FUNC(libvlc_media_retain);
 	LOAD_VLC_FUNC(libvlc_media_get_meta);
 
+	libvlc_media_parse_with_options_ =
+		os_dlsym(libvlc_module, "libvlc_media_parse_with_options");
+
 	/* libvlc media player */
 	LOAD_VLC_FUNC(libvlc_media_player_new);
 	LOAD_VLC_FUNC(libvlc_media_player_new_from_media);
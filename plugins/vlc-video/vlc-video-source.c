@@ -724,18 +724,82 @@ static void vlcs_update(void *data, obs_data_t *settings)
 	obs_data_array_release(array);
 }
 
+/* returns the playlist index of the media that is playing, or -1 */
+static int get_current_index(struct vlc_source *c)
+{
+	libvlc_media_t *media =
+		libvlc_media_player_get_media_(c->media_player);
+	int idx = -1;
+
+	if (!media)
+		return -1;
+
+	for (size_t i = 0; i < c->files.num; i++) {
+		if (c->files.array[i].media == media) {
+			idx = (int)i;
+			break;
+		}
+	}
+
+	libvlc_media_release_(media);
+	return idx;
+}
+
+/* Parses the next playlist item in the background while the current one
+ * plays, so that its demuxer and tracks are already probed when the list
+ * player switches to it. */
+static void preload_next_media(struct vlc_source *c)
+{
+	libvlc_media_parse_flag_t flags = libvlc_media_parse_local |
+					  libvlc_media_parse_network;
+	int idx;
+
+	if (!libvlc_media_parse_with_options_)
+		return;
+
+	pthread_mutex_lock(&c->mutex);
+
+	idx = get_current_index(c);
+	if (idx != -1 && c->files.num > 1) {
+		size_t next = (size_t)idx + 1;
+
+		if (next == c->files.num && c->loop)
+			next = 0;
+		if (next < c->files.num)
+			libvlc_media_parse_with_options_(
+				c->files.array[next].media, flags, -1);
+	}
+
+	pthread_mutex_unlock(&c->mutex);
+}
+
 static void vlcs_started(const struct libvlc_event_t *event, void *data)
 {
 	struct vlc_source *c = data;
 	obs_source_media_started(c->source);
+	preload_next_media(c);
 
 	UNUSED_PARAMETER(event);
 }
 
+static bool is_last_media(struct vlc_source *c)
+{
+	bool last;
+
+	pthread_mutex_lock(&c->mutex);
+	last = get_current_index(c) == (int)c->files.num - 1;
+	pthread_mutex_unlock(&c->mutex);
+
+	return last;
+}
+
 static void vlcs_stopped(const struct libvlc_event_t *event, void *data)
 {
 	struct vlc_source *c = data;
-	if (!c->loop) {
+
+	/* the end of every playlist item is reported, keep showing the last
+	 * frame until the next item starts instead of flashing to nothing */
+	if (!c->loop && is_last_media(c)) {
 		obs_source_output_video(c->source, NULL);
 		obs_source_media_ended(c->source);
 	}
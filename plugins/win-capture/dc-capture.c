@@ -61,6 +61,7 @@ void dc_capture_init(struct dc_capture *capture, int x, int y, uint32_t width,
 			CreateDIBSection(capture->hdc, &bi, DIB_RGB_COLORS,
 					 (void **)&capture->bits, NULL, 0);
 		capture->old_bmp = SelectObject(capture->hdc, capture->bmp);
+		capture->uploaded_bits = bmalloc(width * height * 4);
 	}
 }
 
@@ -72,6 +73,8 @@ void dc_capture_free(struct dc_capture *capture)
 		DeleteObject(capture->bmp);
 	}
 
+	bfree(capture->uploaded_bits);
+
 	obs_enter_graphics();
 	gs_texture_destroy(capture->texture);
 	obs_leave_graphics();
@@ -122,11 +125,48 @@ static inline HDC dc_capture_get_dc(struct dc_capture *capture)
 		return gs_texture_get_dc(capture->texture);
 }
 
+/* compares the new image against the last uploaded one, so that windows that
+ * have not repainted are not uploaded again each tick.  comparing rows from
+ * both ends stops at the first change, which is cheap next to an upload. */
+static bool dc_capture_changed(struct dc_capture *capture)
+{
+	const size_t linesize = (size_t)capture->width * 4;
+	const uint32_t height = capture->height;
+	const BYTE *bits = capture->bits;
+	BYTE *uploaded = capture->uploaded_bits;
+	uint32_t first = 0;
+	uint32_t last = height;
+
+	if (!capture->uploaded) {
+		memcpy(uploaded, bits, linesize * height);
+		capture->uploaded = true;
+		return true;
+	}
+
+	while (first < height && memcmp(bits + first * linesize,
+					uploaded + first * linesize,
+					linesize) == 0)
+		first++;
+
+	if (first == height)
+		return false;
+
+	while (last - 1 > first && memcmp(bits + (last - 1) * linesize,
+					  uploaded + (last - 1) * linesize,
+					  linesize) == 0)
+		last--;
+
+	memcpy(uploaded + first * linesize, bits + first * linesize,
+	       (last - first) * linesize);
+	return true;
+}
+
 static inline void dc_capture_release_dc(struct dc_capture *capture)
 {
 	if (capture->compatibility) {
-		gs_texture_set_image(capture->texture, capture->bits,
-				     capture->width * 4, false);
+		if (dc_capture_changed(capture))
+			gs_texture_set_image(capture->texture, capture->bits,
+					     capture->width * 4, false);
 	} else {
 		gs_texture_release_dc(capture->texture);
 	}
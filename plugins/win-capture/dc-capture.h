@@ -16,6 +16,8 @@ struct dc_capture {
 	HDC hdc;
 	HBITMAP bmp, old_bmp;
 	BYTE *bits;
+	BYTE *uploaded_bits;
+	bool uploaded;
 
 	bool capture_cursor;
 	bool cursor_captured;
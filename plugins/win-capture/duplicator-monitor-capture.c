@@ -88,6 +88,12 @@ struct duplicator_capture {
 	float reset_timeout;
 	struct cursor_data cursor_data;
 
+	/* what was last drawn, to tell the scene when the output changes */
+	uint64_t frame_serial;
+	HCURSOR last_cursor;
+	POINT last_cursor_pos;
+	bool last_cursor_visible;
+
 	bool wgc_supported;
 	void *winrt_module;
 	struct winrt_exports exports;
@@ -344,6 +350,8 @@ static void reset_capture_data(struct duplicator_capture *capture)
 	capture->x = monitor_info.x;
 	capture->y = monitor_info.y;
 	capture->rot = monitor_info.rotation_degrees;
+
+	obs_source_content_changed(capture->source);
 }
 
 static void free_capture_data(struct duplicator_capture *capture)
@@ -366,6 +374,26 @@ static void free_capture_data(struct duplicator_capture *capture)
 	capture->y = 0;
 	capture->rot = 0;
 	capture->reset_timeout = 0.0f;
+
+	obs_source_content_changed(capture->source);
+}
+
+static bool cursor_changed(struct duplicator_capture *capture)
+{
+	const struct cursor_data *cursor = &capture->cursor_data;
+	bool changed = cursor->current_cursor != capture->last_cursor ||
+		       cursor->visible != capture->last_cursor_visible;
+
+	/* the position only matters while the cursor is drawn */
+	if (cursor->visible)
+		changed = changed ||
+			  cursor->cursor_pos.x != capture->last_cursor_pos.x ||
+			  cursor->cursor_pos.y != capture->last_cursor_pos.y;
+
+	capture->last_cursor = cursor->current_cursor;
+	capture->last_cursor_pos = cursor->cursor_pos;
+	capture->last_cursor_visible = cursor->visible;
+	return changed;
 }
 
 static void duplicator_capture_tick(void *data, float seconds)
@@ -419,6 +447,9 @@ static void duplicator_capture_tick(void *data, float seconds)
 			capture->exports.winrt_capture_show_cursor(
 				capture->capture_winrt,
 				capture->capture_cursor);
+
+			/* WGC doesn't say when a new frame arrived */
+			obs_source_content_changed(capture->source);
 		}
 	} else {
 		if (capture->capture_winrt) {
@@ -433,14 +464,19 @@ static void duplicator_capture_tick(void *data, float seconds)
 			if (capture->reset_timeout >= RESET_INTERVAL_SEC) {
 				capture->duplicator = gs_duplicator_create(
 					capture->dxgi_index);
+				capture->frame_serial = 0;
 
 				capture->reset_timeout = 0.0f;
 			}
 		}
 
 		if (capture->duplicator) {
-			if (capture->capture_cursor)
+			bool changed = false;
+
+			if (capture->capture_cursor) {
 				cursor_capture(&capture->cursor_data);
+				changed = cursor_changed(capture);
+			}
 
 			if (!gs_duplicator_update_frame(capture->duplicator)) {
 				free_capture_data(capture);
@@ -448,6 +484,20 @@ static void duplicator_capture_tick(void *data, float seconds)
 			} else if (capture->width == 0) {
 				reset_capture_data(capture);
 			}
+
+			/* new frames of the duplicator, which may be shared
+			 * with other sources */
+			if (capture->duplicator) {
+				const uint64_t serial =
+					gs_duplicator_get_frame_serial(
+						capture->duplicator);
+				changed = changed ||
+					  serial != capture->frame_serial;
+				capture->frame_serial = serial;
+			}
+
+			if (changed)
+				obs_source_content_changed(capture->source);
 		}
 	}
 
@@ -669,7 +719,8 @@ struct obs_source_info duplicator_capture_info = {
 	.id = "monitor_capture",
 	.type = OBS_SOURCE_TYPE_INPUT,
 	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
-			OBS_SOURCE_DO_NOT_DUPLICATE,
+			OBS_SOURCE_DO_NOT_DUPLICATE |
+			OBS_SOURCE_CACHEABLE_VIDEO,
 	.get_name = duplicator_capture_getname,
 	.create = duplicator_capture_create,
 	.destroy = duplicator_capture_destroy,
@@ -7,6 +7,7 @@
 #include <dxgi.h>
 #include <util/sse-intrin.h>
 #include <util/util_uint64.h>
+#include <graphics/vec2.h>
 #include <ipc-util/pipe.h>
 #include "obfuscate.h"
 #include "inject-library.h"
@@ -83,6 +84,7 @@
 
 #define DEFAULT_RETRY_INTERVAL 2.0f
 #define ERROR_RETRY_INTERVAL 4.0f
+#define WINDOW_EVENT_RETRY_INTERVAL 0.1f
 
 enum capture_mode {
 	CAPTURE_MODE_ANY,
@@ -154,6 +156,22 @@ struct game_capture {
 	ipc_pipe_server_t pipe;
 	gs_texture_t *texture;
 	bool supports_srgb;
+
+	/* memory capture frames the hook converted to NV12, unpacked into
+	 * texture on each copy */
+	gs_texture_t *nv12_texture;
+	gs_effect_t *nv12_effect;
+
+	/* shared texture ring of the hook, texture is the one sampled (and
+	 * acquired if the ring has keyed mutexes) once the first arrived */
+	gs_texture_t *ring_textures[SHTEX_RING_SIZE];
+	int ring_tex;
+	long ring_generation;
+	bool ring_keyed_mutex;
+
+	/* window_events_serial() when the window was last searched for */
+	long window_serial;
+
 	struct hook_info *global_hook_info;
 	HANDLE keepalive_mutex;
 	HANDLE hook_init;
@@ -303,6 +321,32 @@ static inline float hook_rate_to_float(enum hook_rate rate)
 	}
 }
 
+static void free_shtex_ring(struct game_capture *gc)
+{
+	if (gc->texture && gc->ring_keyed_mutex)
+		gs_texture_release_sync(gc->texture, 0);
+
+	for (size_t i = 0; i < SHTEX_RING_SIZE; i++) {
+		gs_texture_destroy(gc->ring_textures[i]);
+		gc->ring_textures[i] = NULL;
+	}
+
+	gc->texture = NULL;
+}
+
+/* assumes graphics context */
+static void free_capture_textures(struct game_capture *gc)
+{
+	if (gc->ring_textures[0]) {
+		free_shtex_ring(gc);
+	} else {
+		gs_texture_destroy(gc->texture);
+		gc->texture = NULL;
+		gs_texture_destroy(gc->nv12_texture);
+		gc->nv12_texture = NULL;
+	}
+}
+
 static void stop_capture(struct game_capture *gc)
 {
 	ipc_pipe_server_free(&gc->pipe);
@@ -336,11 +380,10 @@ static void stop_capture(struct game_capture *gc)
 	close_handle(&gc->texture_mutexes[0]);
 	close_handle(&gc->texture_mutexes[1]);
 
-	if (gc->texture) {
+	if (gc->ring_textures[0] || gc->texture) {
 		obs_enter_graphics();
-		gs_texture_destroy(gc->texture);
+		free_capture_textures(gc);
 		obs_leave_graphics();
-		gc->texture = NULL;
 	}
 
 	if (gc->active)
@@ -373,6 +416,7 @@ static void game_capture_destroy(void *data)
 
 	obs_enter_graphics();
 	cursor_data_free(&gc->cursor_data);
+	gs_effect_destroy(gc->nv12_effect);
 	obs_leave_graphics();
 
 	dstr_free(&gc->title);
@@ -452,6 +496,11 @@ static inline bool capture_needs_reset(struct game_capture_config *cfg1,
 	} else if (cfg1->force_shmem != cfg2->force_shmem) {
 		return true;
 
+	} else if (cfg1->allow_transparency != cfg2->allow_transparency) {
+		/* the hook drops the alpha of memory capture frames unless
+		 * transparency is allowed */
+		return true;
+
 	} else if (cfg1->limit_framerate != cfg2->limit_framerate) {
 		return true;
 
@@ -756,6 +805,7 @@ static inline bool init_hook_info(struct game_capture *gc)
 	gc->global_hook_info->allow_srgb_alias = true;
 	gc->global_hook_info->d3d12_use_swap_queue =
 		gc->config.d3d12_use_swap_queue;
+	gc->global_hook_info->shmem_nv12 = !gc->config.allow_transparency;
 	reset_frame_interval(gc);
 
 	obs_enter_graphics();
@@ -763,8 +813,15 @@ static inline bool init_hook_info(struct game_capture *gc)
 		warn("init_hook_info: shared texture capture unavailable");
 		gc->global_hook_info->force_shmem = true;
 	}
+
+	/* the ring's keyed mutexes are only available to Direct3D */
+	gc->global_hook_info->shtex_ring = gs_get_device_type() ==
+					   GS_DEVICE_DIRECT3D_11;
 	obs_leave_graphics();
 
+	/* a hook_ready signal while capturing reopens the textures */
+	gc->global_hook_info->readapt = true;
+
 	return true;
 }
 
@@ -1162,12 +1219,30 @@ static void try_hook(struct game_capture *gc)
 
 		if (!init_hook(gc)) {
 			stop_capture(gc);
+		} else {
+			/* the longer waits of hooking a new process are done */
+			gc->retry_interval =
+				DEFAULT_RETRY_INTERVAL *
+				hook_rate_to_float(gc->config.hook_rate);
 		}
 	} else {
 		gc->active = false;
 	}
 }
 
+/* searches for the window again right away when a window was shown or
+ * brought to the foreground, unless waiting for a new process to start up
+ * or after an error */
+static inline bool window_events_retry(struct game_capture *gc)
+{
+	const float interval = DEFAULT_RETRY_INTERVAL *
+			       hook_rate_to_float(gc->config.hook_rate);
+
+	return gc->window_serial != window_events_serial() &&
+	       gc->retry_interval <= interval &&
+	       gc->retry_time > WINDOW_EVENT_RETRY_INTERVAL;
+}
+
 static inline bool init_events(struct game_capture *gc)
 {
 	if (!gc->hook_restart) {
@@ -1501,11 +1576,54 @@ static inline void copy_16bit_tex(struct game_capture *gc, int cur_texture,
 	}
 }
 
+/* assumes graphics context, converts the NV12 frame into the texture that
+ * is drawn */
+static void unpack_nv12_tex(struct game_capture *gc)
+{
+	gs_effect_t *effect = gc->nv12_effect;
+	gs_texture_t *prev_target = gs_get_render_target();
+	gs_zstencil_t *prev_zstencil = gs_get_zstencil_target();
+	const bool prev_srgb = gs_framebuffer_srgb_enabled();
+	struct vec2 frame_size;
+
+	vec2_set(&frame_size, (float)shmem_nv12_width(gc->cx),
+		 (float)gc->cy);
+
+	gs_viewport_push();
+	gs_projection_push();
+	gs_matrix_push();
+	gs_matrix_identity();
+	gs_blend_state_push();
+	gs_enable_blending(false);
+	gs_enable_framebuffer_srgb(false);
+
+	gs_set_render_target(gc->texture, NULL);
+	gs_set_viewport(0, 0, gc->cx, gc->cy);
+	gs_ortho(0.0f, (float)gc->cx, 0.0f, (float)gc->cy, -100.0f, 100.0f);
+
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
+			      gc->nv12_texture);
+	gs_effect_set_vec2(gs_effect_get_param_by_name(effect, "frame_size"),
+			   &frame_size);
+
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(NULL, 0, gc->cx, gc->cy);
+
+	gs_set_render_target(prev_target, prev_zstencil);
+	gs_enable_framebuffer_srgb(prev_srgb);
+	gs_blend_state_pop();
+	gs_matrix_pop();
+	gs_projection_pop();
+	gs_viewport_pop();
+}
+
 static void copy_shmem_tex(struct game_capture *gc)
 {
 	int cur_texture;
 	HANDLE mutex = NULL;
+	gs_texture_t *texture;
 	uint32_t pitch;
+	uint32_t rows;
 	int next_texture;
 	uint8_t *data;
 
@@ -1530,29 +1648,35 @@ static void copy_shmem_tex(struct game_capture *gc)
 		return;
 	}
 
-	if (gs_texture_map(gc->texture, &data, &pitch)) {
+	texture = gc->nv12_texture ? gc->nv12_texture : gc->texture;
+	rows = gc->nv12_texture ? shmem_nv12_rows(gc->cy) : gc->cy;
+
+	if (gs_texture_map(texture, &data, &pitch)) {
 		if (gc->convert_16bit) {
 			copy_16bit_tex(gc, cur_texture, data, pitch);
 
 		} else if (pitch == gc->pitch) {
 			memcpy(data, gc->texture_buffers[cur_texture],
-			       (size_t)pitch * (size_t)gc->cy);
+			       (size_t)pitch * (size_t)rows);
 		} else {
 			uint8_t *input = gc->texture_buffers[cur_texture];
 			uint32_t best_pitch = pitch < gc->pitch ? pitch
 								: gc->pitch;
 
-			for (size_t y = 0; y < gc->cy; y++) {
+			for (size_t y = 0; y < rows; y++) {
 				uint8_t *line_in = input + gc->pitch * y;
 				uint8_t *line_out = data + pitch * y;
 				memcpy(line_out, line_in, best_pitch);
 			}
 		}
 
-		gs_texture_unmap(gc->texture);
+		gs_texture_unmap(texture);
 	}
 
 	ReleaseMutex(mutex);
+
+	if (gc->nv12_texture)
+		unpack_nv12_tex(gc);
 }
 
 static inline bool is_16bit_format(uint32_t format)
@@ -1561,9 +1685,33 @@ static inline bool is_16bit_format(uint32_t format)
 	       format == DXGI_FORMAT_B5G6R5_UNORM;
 }
 
+/* assumes graphics context */
+static bool init_nv12_textures(struct game_capture *gc)
+{
+	if (!gc->nv12_effect) {
+		char *file = obs_module_file("nv12_unpack.effect");
+		gc->nv12_effect = gs_effect_create_from_file(file, NULL);
+		bfree(file);
+
+		if (!gc->nv12_effect) {
+			warn("init_nv12_textures: failed to load effect");
+			return false;
+		}
+	}
+
+	gs_texture_destroy(gc->nv12_texture);
+	gc->nv12_texture = gs_texture_create(shmem_nv12_width(gc->cx),
+					     shmem_nv12_rows(gc->cy), GS_R8, 1,
+					     NULL, GS_DYNAMIC);
+	gc->texture = gs_texture_create(gc->cx, gc->cy, GS_BGRA, 1, NULL,
+					GS_RENDER_TARGET);
+	return gc->nv12_texture && gc->texture;
+}
+
 static inline bool init_shmem_capture(struct game_capture *gc)
 {
 	enum gs_color_format format;
+	const bool nv12 = gc->global_hook_info->format == DXGI_FORMAT_NV12;
 
 	gc->texture_buffers[0] =
 		(uint8_t *)gc->data + gc->shmem_data->tex1_offset;
@@ -1577,8 +1725,18 @@ static inline bool init_shmem_capture(struct game_capture *gc)
 
 	obs_enter_graphics();
 	gs_texture_destroy(gc->texture);
-	gc->texture =
-		gs_texture_create(gc->cx, gc->cy, format, 1, NULL, GS_DYNAMIC);
+	gc->texture = NULL;
+	if (nv12) {
+		if (!init_nv12_textures(gc)) {
+			gs_texture_destroy(gc->nv12_texture);
+			gc->nv12_texture = NULL;
+			gs_texture_destroy(gc->texture);
+			gc->texture = NULL;
+		}
+	} else {
+		gc->texture = gs_texture_create(gc->cx, gc->cy, format, 1,
+						NULL, GS_DYNAMIC);
+	}
 	obs_leave_graphics();
 
 	if (!gc->texture) {
@@ -1591,10 +1749,98 @@ static inline bool init_shmem_capture(struct game_capture *gc)
 	return true;
 }
 
+/* hands the sampled texture back to the hook for the newest frame */
+static void acquire_shtex_ring(struct game_capture *gc)
+{
+	struct shtex_data *shtex = gc->shtex_data;
+	const bool keyed_mutex = gc->ring_keyed_mutex;
+	const long middle = os_atomic_load_long(&shtex->ring_middle);
+
+	if ((middle & SHTEX_RING_FRESH) == 0)
+		return;
+
+	/* the hook replaced its textures, wait for it to signal ready */
+	if ((middle & ~(SHTEX_RING_INDEX | SHTEX_RING_FRESH)) !=
+	    gc->ring_generation)
+		return;
+
+	/* the hook never waits for the keyed mutex, so it's released before
+	 * the texture is handed over */
+	if (gc->texture && keyed_mutex)
+		gs_texture_release_sync(gc->texture, 0);
+
+	if (!os_atomic_compare_swap_long(&shtex->ring_middle, middle,
+					 gc->ring_generation | gc->ring_tex)) {
+		if (gc->texture && keyed_mutex &&
+		    gs_texture_acquire_sync(gc->texture, 0, 0) != 0)
+			gc->texture = NULL;
+		return;
+	}
+
+	gc->texture = NULL;
+	gc->ring_tex = (int)(middle & SHTEX_RING_INDEX);
+	if (gc->ring_tex >= SHTEX_RING_SIZE)
+		return;
+
+	gs_texture_t *texture = gc->ring_textures[gc->ring_tex];
+	if (keyed_mutex && gs_texture_acquire_sync(texture, 0, 0) != 0)
+		return;
+
+	gc->texture = texture;
+}
+
+static inline bool init_shtex_ring_capture(struct game_capture *gc)
+{
+	const struct shtex_data *shtex = gc->shtex_data;
+	bool success = true;
+
+	obs_enter_graphics();
+	free_capture_textures(gc);
+
+	for (size_t i = 0; i < SHTEX_RING_SIZE; i++) {
+		gc->ring_textures[i] =
+			gs_texture_open_shared(shtex->ring_handles[i]);
+		if (!gc->ring_textures[i])
+			success = false;
+	}
+
+	if (success) {
+		enum gs_color_format format =
+			gs_texture_get_color_format(gc->ring_textures[0]);
+		gc->supports_srgb = gs_is_srgb_format(format);
+	} else {
+		free_shtex_ring(gc);
+	}
+	obs_leave_graphics();
+
+	if (!success) {
+		warn("init_shtex_capture: failed to open shared handles");
+		return false;
+	}
+
+	/* older hooks have no generations */
+	gc->ring_generation =
+		gc->global_hook_info->map_size >= sizeof(struct shtex_data)
+			? shtex_ring_generation_bits(shtex->ring_generation)
+			: 0;
+	gc->ring_tex = 2;
+	gc->ring_keyed_mutex = shtex->keyed_mutex;
+	gc->copy_texture = acquire_shtex_ring;
+	return true;
+}
+
 static inline bool init_shtex_capture(struct game_capture *gc)
 {
+	const size_t ring_map_size =
+		offsetof(struct shtex_data, ring_generation);
+
+	if (gc->global_hook_info->map_size >= ring_map_size &&
+	    gc->shtex_data->ring_size == SHTEX_RING_SIZE)
+		return init_shtex_ring_capture(gc);
+
 	obs_enter_graphics();
-	gs_texture_destroy(gc->texture);
+	free_capture_textures(gc);
+	gc->copy_texture = NULL;
 	gc->texture = gs_texture_open_shared(gc->shtex_data->tex_handle);
 	enum gs_color_format format = gs_texture_get_color_format(gc->texture);
 	gc->supports_srgb = gs_is_srgb_format(format);
@@ -1757,9 +2003,11 @@ static void game_capture_tick(void *data, float seconds)
 
 	if (!gc->active) {
 		if (!gc->error_acquiring &&
-		    gc->retry_time > gc->retry_interval) {
+		    (gc->retry_time > gc->retry_interval ||
+		     window_events_retry(gc))) {
 			if (gc->config.mode == CAPTURE_MODE_ANY ||
 			    gc->activate_hook) {
+				gc->window_serial = window_events_serial();
 				try_hook(gc);
 				gc->retry_time = 0.0f;
 			}
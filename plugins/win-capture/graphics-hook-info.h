@@ -72,10 +72,56 @@ struct shmem_data {
 	uint32_t tex2_offset;
 };
 
+/* memory capture frames in DXGI_FORMAT_NV12 are one plane of a byte per
+ * sample, pitch bytes per row: the luma rows, padded to an even size, then
+ * the rows of interleaved Cb/Cr pairs.  The hook converts with full range
+ * BT.709 */
+static inline uint32_t shmem_nv12_width(uint32_t cx)
+{
+	return (cx + 1) & ~1u;
+}
+
+static inline uint32_t shmem_nv12_rows(uint32_t cy)
+{
+	const uint32_t luma_rows = (cy + 1) & ~1u;
+	return luma_rows + luma_rows / 2;
+}
+
+#define SHTEX_RING_SIZE 3
+#define SHTEX_RING_INDEX 0xFF
+#define SHTEX_RING_FRESH 0x100
+#define SHTEX_RING_GENERATION_SHIFT 16
+
 struct shtex_data {
 	uint32_t tex_handle;
+
+	/* ring of textures, used instead of tex_handle when ring_size is set,
+	 * which the hook only does if game capture asked for it */
+	uint32_t ring_size;
+	uint32_t ring_handles[SHTEX_RING_SIZE];
+
+	/* the ring textures have keyed mutexes, acquired with key 0 */
+	bool keyed_mutex;
+
+	/* the hook copies frames to one texture of the ring and game capture
+	 * samples another.  The third is in the middle: the hook exchanges
+	 * its texture with it after each frame, marked SHTEX_RING_FRESH, and
+	 * game capture exchanges its texture with it when it is fresh.  The
+	 * hook starts on texture 0, game capture on texture 2. */
+	volatile long ring_middle;
+
+	/* bumped when the hook replaces the textures in place, such as after
+	 * the swap chain was resized, and kept in the bits of ring_middle
+	 * above SHTEX_RING_GENERATION_SHIFT so game capture stops exchanging
+	 * textures of the previous generation */
+	uint32_t ring_generation;
 };
 
+static inline long shtex_ring_generation_bits(uint32_t generation)
+{
+	return (long)(generation & 0x7FFF) << SHTEX_RING_GENERATION_SHIFT;
+}
+
 enum capture_type {
 	CAPTURE_TYPE_MEMORY,
 	CAPTURE_TYPE_TEXTURE,
@@ -119,7 +165,18 @@ struct hook_info {
 	/* hook addresses */
 	struct graphics_offsets offsets;
 
-	uint32_t reserved[126];
+	/* game capture can read the shared texture ring of shtex_data */
+	uint32_t shtex_ring;
+
+	/* game capture reopens the textures when the hook signals ready
+	 * again, so the hook can replace them without freeing the capture */
+	uint32_t readapt;
+
+	/* game capture can read memory capture frames in DXGI_FORMAT_NV12,
+	 * which the hook may send instead of opaque 8-bit RGB frames */
+	uint32_t shmem_nv12;
+
+	uint32_t reserved[123];
 };
 static_assert(sizeof(struct hook_info) == 648, "ABI compatibility");
 
@@ -290,20 +290,27 @@ static inline void d3d10_shtex_capture(ID3D10Resource *backbuffer)
 	d3d10_copy_texture(data.texture, backbuffer);
 }
 
-static void d3d10_shmem_capture_copy(int i)
+/* returns false if the GPU hasn't finished copying to the surface yet */
+static bool d3d10_shmem_capture_copy(int i)
 {
 	D3D10_MAPPED_TEXTURE2D map;
 	HRESULT hr;
 
 	if (data.texture_ready[i]) {
-		data.texture_ready[i] = false;
+		hr = data.copy_surfaces[i]->Map(0, D3D10_MAP_READ,
+						D3D10_MAP_FLAG_DO_NOT_WAIT,
+						&map);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+			return false;
 
-		hr = data.copy_surfaces[i]->Map(0, D3D10_MAP_READ, 0, &map);
+		data.texture_ready[i] = false;
 		if (SUCCEEDED(hr)) {
 			data.texture_mapped[i] = true;
 			shmem_copy_data(i, map.pData);
 		}
 	}
+
+	return true;
 }
 
 static inline void d3d10_shmem_capture(ID3D10Resource *backbuffer)
@@ -311,7 +318,10 @@ static inline void d3d10_shmem_capture(ID3D10Resource *backbuffer)
 	int next_tex;
 
 	next_tex = (data.cur_tex + 1) % NUM_BUFFERS;
-	d3d10_shmem_capture_copy(next_tex);
+
+	/* drop the frame instead of stalling on an unfinished readback */
+	if (!d3d10_shmem_capture_copy(next_tex))
+		return;
 
 	if (data.copy_wait < NUM_BUFFERS - 1) {
 		data.copy_wait++;
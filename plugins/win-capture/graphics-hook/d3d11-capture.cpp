@@ -1,4 +1,5 @@
 #include <d3d11.h>
+#include <d3dcompiler.h>
 #include <dxgi.h>
 
 #include "dxgi-helpers.hpp"
@@ -13,6 +14,7 @@ struct d3d11_data {
 	DXGI_FORMAT format;
 	bool using_shtex;
 	bool multisampled;
+	bool resized;
 
 	ID3D11Texture2D *scale_tex;
 	ID3D11ShaderResourceView *scale_resource;
@@ -34,6 +36,13 @@ struct d3d11_data {
 			struct shtex_data *shtex_info;
 			ID3D11Texture2D *texture;
 			HANDLE handle;
+
+			/* keyed mutex textures, if game capture reads the
+			 * shared texture ring */
+			ID3D11Texture2D *ring_textures[SHTEX_RING_SIZE];
+			IDXGIKeyedMutex *ring_mutexes[SHTEX_RING_SIZE];
+			int ring_tex;
+			bool using_ring;
 		};
 		/* shared memory */
 		struct {
@@ -44,12 +53,61 @@ struct d3d11_data {
 			struct shmem_data *shmem_info;
 			int cur_tex;
 			int copy_wait;
+
+			/* frames are converted to NV12 on the game's GPU
+			 * before the readback if game capture can read them */
+			ID3D11Texture2D *nv12_source;
+			ID3D11ShaderResourceView *nv12_source_view;
+			ID3D11Texture2D *nv12_target;
+			ID3D11RenderTargetView *nv12_target_view;
+			bool using_nv12;
 		};
 	};
 };
 
 static struct d3d11_data data = {};
 
+static void d3d11_free_shtex_textures(void)
+{
+	if (data.texture) {
+		data.texture->Release();
+		data.texture = nullptr;
+	}
+
+	for (size_t i = 0; i < SHTEX_RING_SIZE; i++) {
+		if (data.ring_mutexes[i]) {
+			data.ring_mutexes[i]->Release();
+			data.ring_mutexes[i] = nullptr;
+		}
+		if (data.ring_textures[i]) {
+			data.ring_textures[i]->Release();
+			data.ring_textures[i] = nullptr;
+		}
+	}
+}
+
+static void d3d11_free_nv12(void)
+{
+	if (data.nv12_source_view) {
+		data.nv12_source_view->Release();
+		data.nv12_source_view = nullptr;
+	}
+	if (data.nv12_source) {
+		data.nv12_source->Release();
+		data.nv12_source = nullptr;
+	}
+	if (data.nv12_target_view) {
+		data.nv12_target_view->Release();
+		data.nv12_target_view = nullptr;
+	}
+	if (data.nv12_target) {
+		data.nv12_target->Release();
+		data.nv12_target = nullptr;
+	}
+
+	data.using_nv12 = false;
+}
+
 void d3d11_free(void)
 {
 	if (data.scale_tex)
@@ -76,8 +134,7 @@ void d3d11_free(void)
 	capture_free();
 
 	if (data.using_shtex) {
-		if (data.texture)
-			data.texture->Release();
+		d3d11_free_shtex_textures();
 	} else {
 		for (size_t i = 0; i < NUM_BUFFERS; i++) {
 			if (data.copy_surfaces[i]) {
@@ -87,6 +144,8 @@ void d3d11_free(void)
 				data.copy_surfaces[i]->Release();
 			}
 		}
+
+		d3d11_free_nv12();
 	}
 
 	memset(&data, 0, sizeof(data));
@@ -108,6 +167,12 @@ static bool create_d3d11_stage_surface(ID3D11Texture2D **tex)
 	desc.Usage = D3D11_USAGE_STAGING;
 	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 
+	if (data.using_nv12) {
+		desc.Width = shmem_nv12_width(data.cx);
+		desc.Height = shmem_nv12_rows(data.cy);
+		desc.Format = DXGI_FORMAT_R8_UNORM;
+	}
+
 	hr = data.device->CreateTexture2D(&desc, nullptr, tex);
 	if (FAILED(hr)) {
 		hlog_hr("create_d3d11_stage_surface: failed to create texture",
@@ -119,7 +184,7 @@ static bool create_d3d11_stage_surface(ID3D11Texture2D **tex)
 }
 
 static bool create_d3d11_tex(uint32_t cx, uint32_t cy, ID3D11Texture2D **tex,
-			     HANDLE *handle)
+			     HANDLE *handle, bool keyed_mutex)
 {
 	HRESULT hr;
 
@@ -133,7 +198,8 @@ static bool create_d3d11_tex(uint32_t cx, uint32_t cy, ID3D11Texture2D **tex,
 	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 	desc.SampleDesc.Count = 1;
 	desc.Usage = D3D11_USAGE_DEFAULT;
-	desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
+	desc.MiscFlags = keyed_mutex ? D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX
+				     : D3D11_RESOURCE_MISC_SHARED;
 
 	hr = data.device->CreateTexture2D(&desc, nullptr, tex);
 	if (FAILED(hr)) {
@@ -184,6 +250,233 @@ static inline bool d3d11_init_format(IDXGISwapChain *swap, HWND &window)
 	return true;
 }
 
+/* draws a full screen triangle without a vertex buffer */
+static const char nv12_vertex_shader[] =
+	"float4 main(uint id : SV_VertexID) : SV_Position\n"
+	"{\n"
+	"	float2 uv = float2((id << 1) & 2, id & 2);\n"
+	"	return float4(uv * float2(2.0, -2.0) + float2(-1.0, 1.0),\n"
+	"		      0.0, 1.0);\n"
+	"}\n";
+
+/* writes the NV12 layout of shmem_nv12_rows, one byte per texel: full
+ * range BT.709 luma, then Cb/Cr pairs averaged over 2x2 blocks */
+static const char nv12_pixel_shader[] =
+	"Texture2D image : register(t0);\n"
+	"\n"
+	"float3 load(int2 pos, int2 last)\n"
+	"{\n"
+	"	return image.Load(int3(min(pos, last), 0)).rgb;\n"
+	"}\n"
+	"\n"
+	"float main(float4 frag_pos : SV_Position) : SV_Target\n"
+	"{\n"
+	"	uint width, height;\n"
+	"	image.GetDimensions(width, height);\n"
+	"\n"
+	"	int2 pos = int2(frag_pos.xy);\n"
+	"	int2 last = int2(width, height) - 1;\n"
+	"	int luma_rows = int(height + 1) & ~1;\n"
+	"\n"
+	"	if (pos.y < luma_rows) {\n"
+	"		float3 rgb = load(pos, last);\n"
+	"		return dot(rgb, float3(0.2126, 0.7152, 0.0722));\n"
+	"	}\n"
+	"\n"
+	"	int2 block = int2(pos.x & ~1, (pos.y - luma_rows) * 2);\n"
+	"	float3 rgb = (load(block, last) +\n"
+	"		      load(block + int2(1, 0), last) +\n"
+	"		      load(block + int2(0, 1), last) +\n"
+	"		      load(block + int2(1, 1), last)) * 0.25;\n"
+	"\n"
+	"	float3 cb = float3(-0.1146, -0.3854, 0.5);\n"
+	"	float3 cr = float3(0.5, -0.4542, -0.0458);\n"
+	"	return dot(rgb, (pos.x & 1) ? cr : cb) + 0.5;\n"
+	"}\n";
+
+static pD3DCompile get_compiler(void)
+{
+	static pD3DCompile compile = nullptr;
+	static bool loaded = false;
+
+	if (!loaded) {
+		HMODULE module = load_system_library("d3dcompiler_47.dll");
+		if (module)
+			compile = (pD3DCompile)GetProcAddress(module,
+							      "D3DCompile");
+		loaded = true;
+	}
+
+	return compile;
+}
+
+static ID3DBlob *compile_shader(const char *src, const char *target)
+{
+	ID3DBlob *blob = nullptr;
+	ID3DBlob *errors = nullptr;
+	pD3DCompile compile = get_compiler();
+	HRESULT hr;
+
+	if (!compile) {
+		hlog("compile_shader: D3DCompile unavailable");
+		return nullptr;
+	}
+
+	hr = compile(src, strlen(src), nullptr, nullptr, nullptr, "main",
+		     target, D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, &blob, &errors);
+	if (errors) {
+		hlog("compile_shader: %s",
+		     (const char *)errors->GetBufferPointer());
+		errors->Release();
+	}
+	if (FAILED(hr)) {
+		hlog_hr("compile_shader: failed to compile shader", hr);
+		return nullptr;
+	}
+
+	return blob;
+}
+
+static bool d3d11_init_nv12_shaders(void)
+{
+	ID3DBlob *blob;
+	HRESULT hr;
+
+	blob = compile_shader(nv12_vertex_shader, "vs_4_0");
+	if (!blob)
+		return false;
+
+	hr = data.device->CreateVertexShader(blob->GetBufferPointer(),
+					     blob->GetBufferSize(), nullptr,
+					     &data.vertex_shader);
+	blob->Release();
+	if (FAILED(hr)) {
+		hlog_hr("d3d11_init_nv12_shaders: failed to create vertex "
+			"shader",
+			hr);
+		return false;
+	}
+
+	blob = compile_shader(nv12_pixel_shader, "ps_4_0");
+	if (!blob)
+		return false;
+
+	hr = data.device->CreatePixelShader(blob->GetBufferPointer(),
+					    blob->GetBufferSize(), nullptr,
+					    &data.pixel_shader);
+	blob->Release();
+	if (FAILED(hr)) {
+		hlog_hr("d3d11_init_nv12_shaders: failed to create pixel "
+			"shader",
+			hr);
+		return false;
+	}
+
+	return true;
+}
+
+static bool d3d11_init_nv12_states(void)
+{
+	D3D11_BLEND_DESC blend_desc = {};
+	D3D11_DEPTH_STENCIL_DESC zstencil_desc = {};
+	D3D11_RASTERIZER_DESC raster_desc = {};
+	HRESULT hr;
+
+	blend_desc.RenderTarget[0].RenderTargetWriteMask =
+		D3D11_COLOR_WRITE_ENABLE_ALL;
+	hr = data.device->CreateBlendState(&blend_desc, &data.blend_state);
+	if (FAILED(hr)) {
+		hlog_hr("d3d11_init_nv12_states: failed to create blend state",
+			hr);
+		return false;
+	}
+
+	hr = data.device->CreateDepthStencilState(&zstencil_desc,
+						  &data.zstencil_state);
+	if (FAILED(hr)) {
+		hlog_hr("d3d11_init_nv12_states: failed to create "
+			"zstencil state",
+			hr);
+		return false;
+	}
+
+	raster_desc.FillMode = D3D11_FILL_SOLID;
+	raster_desc.CullMode = D3D11_CULL_NONE;
+	raster_desc.DepthClipEnable = true;
+	hr = data.device->CreateRasterizerState(&raster_desc,
+						&data.raster_state);
+	if (FAILED(hr)) {
+		hlog_hr("d3d11_init_nv12_states: failed to create raster "
+			"state",
+			hr);
+		return false;
+	}
+
+	return true;
+}
+
+static bool d3d11_init_nv12_textures(void)
+{
+	D3D11_TEXTURE2D_DESC desc = {};
+	HRESULT hr;
+
+	desc.Width = data.cx;
+	desc.Height = data.cy;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = data.format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	hr = data.device->CreateTexture2D(&desc, nullptr, &data.nv12_source);
+	if (FAILED(hr)) {
+		hlog_hr("d3d11_init_nv12_textures: failed to create source "
+			"texture",
+			hr);
+		return false;
+	}
+
+	hr = data.device->CreateShaderResourceView(data.nv12_source, nullptr,
+						   &data.nv12_source_view);
+	if (FAILED(hr)) {
+		hlog_hr("d3d11_init_nv12_textures: failed to create source "
+			"view",
+			hr);
+		return false;
+	}
+
+	desc.Width = shmem_nv12_width(data.cx);
+	desc.Height = shmem_nv12_rows(data.cy);
+	desc.Format = DXGI_FORMAT_R8_UNORM;
+	desc.BindFlags = D3D11_BIND_RENDER_TARGET;
+
+	hr = data.device->CreateTexture2D(&desc, nullptr, &data.nv12_target);
+	if (FAILED(hr)) {
+		hlog_hr("d3d11_init_nv12_textures: failed to create target "
+			"texture",
+			hr);
+		return false;
+	}
+
+	hr = data.device->CreateRenderTargetView(data.nv12_target, nullptr,
+						 &data.nv12_target_view);
+	if (FAILED(hr)) {
+		hlog_hr("d3d11_init_nv12_textures: failed to create target "
+			"view",
+			hr);
+		return false;
+	}
+
+	return true;
+}
+
+static bool d3d11_init_nv12(void)
+{
+	return d3d11_init_nv12_shaders() && d3d11_init_nv12_states() &&
+	       d3d11_init_nv12_textures();
+}
+
 static bool d3d11_shmem_init_buffers(size_t idx)
 {
 	bool success;
@@ -218,17 +511,80 @@ static bool d3d11_shmem_init(HWND window)
 {
 	data.using_shtex = false;
 
+	if (global_hook_info->shmem_nv12 && nv12_source_format(data.format)) {
+		data.using_nv12 = d3d11_init_nv12();
+		if (!data.using_nv12) {
+			hlog("d3d11_shmem_init: NV12 conversion unavailable, "
+			     "reading back RGB");
+			d3d11_free_nv12();
+		}
+	}
+
 	for (size_t i = 0; i < NUM_BUFFERS; i++) {
 		if (!d3d11_shmem_init_buffers(i)) {
 			return false;
 		}
 	}
 	if (!capture_init_shmem(&data.shmem_info, window, data.cx, data.cy,
-				data.pitch, data.format, false)) {
+				data.pitch,
+				data.using_nv12 ? DXGI_FORMAT_NV12
+						: data.format,
+				false)) {
 		return false;
 	}
 
-	hlog("d3d11 memory capture successful");
+	hlog("d3d11 memory capture successful%s",
+	     data.using_nv12 ? " (NV12)" : "");
+	return true;
+}
+
+static bool d3d11_create_ring_textures(uintptr_t *handles)
+{
+	HRESULT hr;
+
+	for (size_t i = 0; i < SHTEX_RING_SIZE; i++) {
+		HANDLE handle;
+
+		if (!create_d3d11_tex(data.cx, data.cy, &data.ring_textures[i],
+				      &handle, true)) {
+			hlog("d3d11_create_ring_textures: failed to create "
+			     "texture");
+			return false;
+		}
+
+		hr = data.ring_textures[i]->QueryInterface(
+			__uuidof(IDXGIKeyedMutex),
+			(void **)&data.ring_mutexes[i]);
+		if (FAILED(hr)) {
+			hlog_hr("d3d11_create_ring_textures: failed to query "
+				"IDXGIKeyedMutex",
+				hr);
+			return false;
+		}
+
+		handles[i] = (uintptr_t)handle;
+	}
+
+	data.ring_tex = 0;
+	return true;
+}
+
+static bool d3d11_shtex_ring_init(HWND window)
+{
+	uintptr_t handles[SHTEX_RING_SIZE];
+
+	data.using_shtex = true;
+	data.using_ring = true;
+
+	if (!d3d11_create_ring_textures(handles))
+		return false;
+
+	if (!capture_init_shtex_ring(&data.shtex_info, window, data.cx, data.cy,
+				     data.format, false, handles, true)) {
+		return false;
+	}
+
+	hlog("d3d11 shared texture ring capture successful");
 	return true;
 }
 
@@ -236,10 +592,13 @@ static bool d3d11_shtex_init(HWND window)
 {
 	bool success;
 
+	if (capture_use_shtex_ring())
+		return d3d11_shtex_ring_init(window);
+
 	data.using_shtex = true;
 
-	success =
-		create_d3d11_tex(data.cx, data.cy, &data.texture, &data.handle);
+	success = create_d3d11_tex(data.cx, data.cy, &data.texture,
+				   &data.handle, false);
 
 	if (!success) {
 		hlog("d3d11_shtex_init: failed to create texture");
@@ -281,6 +640,53 @@ static void d3d11_init(IDXGISwapChain *swap)
 		d3d11_free();
 }
 
+/* recreates the shared textures for the new size of the swap chain, game
+ * capture keeps the capture and reopens them */
+static bool d3d11_shtex_readapt(IDXGISwapChain *swap)
+{
+	const uint32_t cx = data.cx;
+	const uint32_t cy = data.cy;
+	const DXGI_FORMAT format = data.format;
+	uintptr_t handles[SHTEX_RING_SIZE];
+	HWND window;
+
+	if (!d3d11_init_format(swap, window))
+		return false;
+	if (data.cx == cx && data.cy == cy && data.format == format)
+		return true;
+
+	d3d11_free_shtex_textures();
+
+	if (data.using_ring) {
+		if (!d3d11_create_ring_textures(handles))
+			return false;
+	} else {
+		if (!create_d3d11_tex(data.cx, data.cy, &data.texture,
+				      &data.handle, false)) {
+			hlog("d3d11_shtex_readapt: failed to create texture");
+			return false;
+		}
+		handles[0] = (uintptr_t)data.handle;
+	}
+
+	if (!capture_readapt_shtex(data.shtex_info, window, data.cx, data.cy,
+				   data.format, false, handles))
+		return false;
+
+	hlog("d3d11 shared texture capture readapted to %ux%u", data.cx,
+	     data.cy);
+	return true;
+}
+
+bool d3d11_resize(void)
+{
+	if (!data.using_shtex || !capture_use_readapt())
+		return false;
+
+	data.resized = true;
+	return true;
+}
+
 static inline void d3d11_copy_texture(ID3D11Resource *dst, ID3D11Resource *src)
 {
 	if (data.multisampled) {
@@ -290,26 +696,171 @@ static inline void d3d11_copy_texture(ID3D11Resource *dst, ID3D11Resource *src)
 	}
 }
 
+/* the pipeline state the NV12 conversion changes, restored for the game */
+struct d3d11_state {
+	ID3D11RenderTargetView *render_target;
+	ID3D11DepthStencilView *zstencil_view;
+	ID3D11BlendState *blend_state;
+	float blend_factor[4];
+	UINT sample_mask;
+	ID3D11DepthStencilState *zstencil_state;
+	UINT stencil_ref;
+	ID3D11RasterizerState *raster_state;
+	D3D11_VIEWPORT viewports[D3D11_VIEWPORT_AND_SCISSORRECT_MAX_INDEX + 1];
+	UINT num_viewports;
+	ID3D11InputLayout *vertex_layout;
+	D3D11_PRIMITIVE_TOPOLOGY topology;
+	ID3D11VertexShader *vertex_shader;
+	ID3D11HullShader *hull_shader;
+	ID3D11DomainShader *domain_shader;
+	ID3D11GeometryShader *geom_shader;
+	ID3D11PixelShader *pixel_shader;
+	ID3D11ShaderResourceView *resource;
+};
+
+template<typename T> static inline void release_state(T *&obj)
+{
+	if (obj) {
+		obj->Release();
+		obj = nullptr;
+	}
+}
+
+static void d3d11_save_state(struct d3d11_state *state)
+{
+	ID3D11DeviceContext *context = data.context;
+
+	context->OMGetRenderTargets(1, &state->render_target,
+				    &state->zstencil_view);
+	context->OMGetBlendState(&state->blend_state, state->blend_factor,
+				 &state->sample_mask);
+	context->OMGetDepthStencilState(&state->zstencil_state,
+					&state->stencil_ref);
+	context->RSGetState(&state->raster_state);
+	state->num_viewports = _countof(state->viewports);
+	context->RSGetViewports(&state->num_viewports, state->viewports);
+	context->IAGetInputLayout(&state->vertex_layout);
+	context->IAGetPrimitiveTopology(&state->topology);
+	context->VSGetShader(&state->vertex_shader, nullptr, nullptr);
+	context->HSGetShader(&state->hull_shader, nullptr, nullptr);
+	context->DSGetShader(&state->domain_shader, nullptr, nullptr);
+	context->GSGetShader(&state->geom_shader, nullptr, nullptr);
+	context->PSGetShader(&state->pixel_shader, nullptr, nullptr);
+	context->PSGetShaderResources(0, 1, &state->resource);
+}
+
+static void d3d11_restore_state(struct d3d11_state *state)
+{
+	ID3D11DeviceContext *context = data.context;
+
+	context->OMSetRenderTargets(1, &state->render_target,
+				    state->zstencil_view);
+	context->OMSetBlendState(state->blend_state, state->blend_factor,
+				 state->sample_mask);
+	context->OMSetDepthStencilState(state->zstencil_state,
+					state->stencil_ref);
+	context->RSSetState(state->raster_state);
+	context->RSSetViewports(state->num_viewports, state->viewports);
+	context->IASetInputLayout(state->vertex_layout);
+	context->IASetPrimitiveTopology(state->topology);
+	context->VSSetShader(state->vertex_shader, nullptr, 0);
+	context->HSSetShader(state->hull_shader, nullptr, 0);
+	context->DSSetShader(state->domain_shader, nullptr, 0);
+	context->GSSetShader(state->geom_shader, nullptr, 0);
+	context->PSSetShader(state->pixel_shader, nullptr, 0);
+	context->PSSetShaderResources(0, 1, &state->resource);
+
+	release_state(state->render_target);
+	release_state(state->zstencil_view);
+	release_state(state->blend_state);
+	release_state(state->zstencil_state);
+	release_state(state->raster_state);
+	release_state(state->vertex_layout);
+	release_state(state->vertex_shader);
+	release_state(state->hull_shader);
+	release_state(state->domain_shader);
+	release_state(state->geom_shader);
+	release_state(state->pixel_shader);
+	release_state(state->resource);
+}
+
+/* converts the backbuffer into the NV12 layout of the staging surfaces */
+static void d3d11_convert_nv12(ID3D11Resource *backbuffer)
+{
+	ID3D11DeviceContext *context = data.context;
+	ID3D11ShaderResourceView *unbind = nullptr;
+	struct d3d11_state state = {};
+	D3D11_VIEWPORT viewport = {};
+
+	d3d11_copy_texture(data.nv12_source, backbuffer);
+	d3d11_save_state(&state);
+
+	viewport.Width = (float)shmem_nv12_width(data.cx);
+	viewport.Height = (float)shmem_nv12_rows(data.cy);
+	viewport.MaxDepth = 1.0f;
+
+	context->OMSetRenderTargets(1, &data.nv12_target_view, nullptr);
+	context->OMSetBlendState(data.blend_state, nullptr, 0xFFFFFFFF);
+	context->OMSetDepthStencilState(data.zstencil_state, 0);
+	context->RSSetState(data.raster_state);
+	context->RSSetViewports(1, &viewport);
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->VSSetShader(data.vertex_shader, nullptr, 0);
+	context->HSSetShader(nullptr, nullptr, 0);
+	context->DSSetShader(nullptr, nullptr, 0);
+	context->GSSetShader(nullptr, nullptr, 0);
+	context->PSSetShader(data.pixel_shader, nullptr, 0);
+	context->PSSetShaderResources(0, 1, &data.nv12_source_view);
+	context->Draw(3, 0);
+	context->PSSetShaderResources(0, 1, &unbind);
+
+	d3d11_restore_state(&state);
+}
+
+static inline void d3d11_shtex_ring_capture(ID3D11Resource *backbuffer)
+{
+	IDXGIKeyedMutex *keyed_mutex = data.ring_mutexes[data.ring_tex];
+
+	/* game capture releases its texture before handing it over, drop the
+	 * frame rather than ever waiting for it */
+	if (keyed_mutex->AcquireSync(0, 0) != S_OK)
+		return;
+
+	d3d11_copy_texture(data.ring_textures[data.ring_tex], backbuffer);
+	keyed_mutex->ReleaseSync(0);
+
+	data.ring_tex = shtex_ring_publish(data.shtex_info, data.ring_tex);
+}
+
 static inline void d3d11_shtex_capture(ID3D11Resource *backbuffer)
 {
-	d3d11_copy_texture(data.texture, backbuffer);
+	if (data.using_ring)
+		d3d11_shtex_ring_capture(backbuffer);
+	else
+		d3d11_copy_texture(data.texture, backbuffer);
 }
 
-static void d3d11_shmem_capture_copy(int i)
+/* returns false if the GPU hasn't finished copying to the surface yet */
+static bool d3d11_shmem_capture_copy(int i)
 {
 	D3D11_MAPPED_SUBRESOURCE map;
 	HRESULT hr;
 
 	if (data.texture_ready[i]) {
-		data.texture_ready[i] = false;
-
 		hr = data.context->Map(data.copy_surfaces[i], 0, D3D11_MAP_READ,
-				       0, &map);
+				       D3D11_MAP_FLAG_DO_NOT_WAIT, &map);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+			return false;
+
+		data.texture_ready[i] = false;
 		if (SUCCEEDED(hr)) {
 			data.texture_mapped[i] = true;
 			shmem_copy_data(i, map.pData);
 		}
 	}
+
+	return true;
 }
 
 static inline void d3d11_shmem_capture(ID3D11Resource *backbuffer)
@@ -317,7 +868,12 @@ static inline void d3d11_shmem_capture(ID3D11Resource *backbuffer)
 	int next_tex;
 
 	next_tex = (data.cur_tex + 1) % NUM_BUFFERS;
-	d3d11_shmem_capture_copy(next_tex);
+
+	/* skip frames until the oldest readback is done rather than stalling
+	 * the game on it, which paces the capture to what the GPU (or the
+	 * copy between GPUs) keeps up with */
+	if (!d3d11_shmem_capture_copy(next_tex))
+		return;
 
 	if (data.copy_wait < NUM_BUFFERS - 1) {
 		data.copy_wait++;
@@ -329,8 +885,15 @@ static inline void d3d11_shmem_capture(ID3D11Resource *backbuffer)
 			shmem_texture_data_unlock(data.cur_tex);
 		}
 
-		d3d11_copy_texture(data.copy_surfaces[data.cur_tex],
-				   backbuffer);
+		if (data.using_nv12) {
+			d3d11_convert_nv12(backbuffer);
+			data.context->CopyResource(
+				data.copy_surfaces[data.cur_tex],
+				data.nv12_target);
+		} else {
+			d3d11_copy_texture(data.copy_surfaces[data.cur_tex],
+					   backbuffer);
+		}
 		data.texture_ready[data.cur_tex] = true;
 	}
 
@@ -349,6 +912,11 @@ void d3d11_capture(void *swap_ptr, void *backbuffer_ptr, bool)
 	if (capture_should_init()) {
 		d3d11_init(swap);
 	}
+	if (data.resized) {
+		data.resized = false;
+		if (capture_active() && !d3d11_shtex_readapt(swap))
+			d3d11_free();
+	}
 	if (capture_ready()) {
 		ID3D11Resource *backbuffer;
 
@@ -31,6 +31,10 @@ struct dxgi_swap_data {
 	IDXGISwapChain *swap;
 	void (*capture)(void *, void *, bool);
 	void (*free)(void);
+
+	/* optional, returns false if the capture has to be freed when the
+	 * swap chain is resized */
+	bool (*resize)(void);
 };
 
 static struct dxgi_swap_data data = {};
@@ -50,6 +54,7 @@ static bool setup_dxgi(IDXGISwapChain *swap)
 			data.swap = swap;
 			data.capture = d3d11_capture;
 			data.free = d3d11_free;
+			data.resize = d3d11_resize;
 			return true;
 		}
 	}
@@ -68,6 +73,7 @@ static bool setup_dxgi(IDXGISwapChain *swap)
 		data.swap = swap;
 		data.capture = d3d11_capture;
 		data.free = d3d11_free;
+		data.resize = d3d11_resize;
 		device->Release();
 		return true;
 	}
@@ -101,6 +107,7 @@ static ULONG STDMETHODCALLTYPE hook_release(IUnknown *unknown)
 		data.swap = nullptr;
 		data.free = nullptr;
 		data.capture = nullptr;
+		data.resize = nullptr;
 		dxgi_possible_swap_queue = nullptr;
 		dxgi_present_attempted = false;
 	}
@@ -118,14 +125,22 @@ static HRESULT STDMETHODCALLTYPE hook_resize_buffers(IDXGISwapChain *swap,
 {
 	HRESULT hr;
 
-	if (!!data.free)
-		data.free();
+	/* keep capturing the swap chain if the capture can take the new size
+	 * of its buffers on the next present */
+	const bool readapt = swap == data.swap && !!data.resize &&
+			     data.resize();
+
+	if (!readapt) {
+		if (!!data.free)
+			data.free();
 
-	data.swap = nullptr;
-	data.free = nullptr;
-	data.capture = nullptr;
-	dxgi_possible_swap_queue = nullptr;
-	dxgi_present_attempted = false;
+		data.swap = nullptr;
+		data.free = nullptr;
+		data.capture = nullptr;
+		data.resize = nullptr;
+		dxgi_possible_swap_queue = nullptr;
+		dxgi_present_attempted = false;
+	}
 
 	unhook(&resize_buffers);
 	resize_buffers_t call = (resize_buffers_t)resize_buffers.call_addr;
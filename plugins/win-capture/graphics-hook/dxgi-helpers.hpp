@@ -26,3 +26,17 @@ static inline DXGI_FORMAT apply_dxgi_format_typeless(DXGI_FORMAT format,
 
 	return format;
 }
+
+/* the 8-bit formats memory capture can convert to NV12 without losing
+ * precision it would otherwise keep */
+static inline bool nv12_source_format(DXGI_FORMAT format)
+{
+	switch ((unsigned long)format) {
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+		return true;
+	}
+
+	return false;
+}
@@ -1,4 +1,5 @@
 #include <windows.h>
+#include <dxgiformat.h>
 #include <psapi.h>
 #include <inttypes.h>
 #include "graphics-hook.h"
@@ -6,6 +7,10 @@
 #include "../obfuscate.h"
 #include "../funchook.h"
 
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 #define DEBUG_OUTPUT
 
 #ifdef DEBUG_OUTPUT
@@ -542,18 +547,9 @@ static inline bool init_shared_info(size_t size, HWND window)
 	return true;
 }
 
-bool capture_init_shtex(struct shtex_data **data, HWND window, uint32_t cx,
-			uint32_t cy, uint32_t format, bool flip,
-			uintptr_t handle)
+static bool shtex_signal_ready(HWND window, uint32_t cx, uint32_t cy,
+			       uint32_t format, bool flip)
 {
-	if (!init_shared_info(sizeof(struct shtex_data), window)) {
-		hlog("capture_init_shtex: Failed to initialize memory");
-		return false;
-	}
-
-	*data = shmem_info;
-	(*data)->tex_handle = (uint32_t)handle;
-
 	global_hook_info->hook_ver_major = HOOK_VER_MAJOR;
 	global_hook_info->hook_ver_minor = HOOK_VER_MINOR;
 	global_hook_info->window = (uint32_t)(uintptr_t)window;
@@ -577,6 +573,99 @@ bool capture_init_shtex(struct shtex_data **data, HWND window, uint32_t cx,
 	return true;
 }
 
+bool capture_init_shtex(struct shtex_data **data, HWND window, uint32_t cx,
+			uint32_t cy, uint32_t format, bool flip,
+			uintptr_t handle)
+{
+	if (!init_shared_info(sizeof(struct shtex_data), window)) {
+		hlog("capture_init_shtex: Failed to initialize memory");
+		return false;
+	}
+
+	*data = shmem_info;
+	(*data)->tex_handle = (uint32_t)handle;
+
+	return shtex_signal_ready(window, cx, cy, format, flip);
+}
+
+bool capture_init_shtex_ring(struct shtex_data **data, HWND window,
+			     uint32_t cx, uint32_t cy, uint32_t format,
+			     bool flip, const uintptr_t *handles,
+			     bool keyed_mutex)
+{
+	if (!init_shared_info(sizeof(struct shtex_data), window)) {
+		hlog("capture_init_shtex_ring: Failed to initialize memory");
+		return false;
+	}
+
+	*data = shmem_info;
+	(*data)->tex_handle = (uint32_t)handles[0];
+	(*data)->ring_size = SHTEX_RING_SIZE;
+	for (size_t i = 0; i < SHTEX_RING_SIZE; i++)
+		(*data)->ring_handles[i] = (uint32_t)handles[i];
+	(*data)->keyed_mutex = keyed_mutex;
+	(*data)->ring_middle = 1;
+
+	return shtex_signal_ready(window, cx, cy, format, flip);
+}
+
+/* replaces the textures of a running shared texture capture, keeping the
+ * shared info mapped, and signals game capture to reopen them.  handles
+ * has SHTEX_RING_SIZE entries if the capture uses the ring, one otherwise */
+bool capture_readapt_shtex(struct shtex_data *data, HWND window, uint32_t cx,
+			   uint32_t cy, uint32_t format, bool flip,
+			   const uintptr_t *handles)
+{
+	data->tex_handle = (uint32_t)handles[0];
+
+	if (data->ring_size) {
+		for (size_t i = 0; i < SHTEX_RING_SIZE; i++)
+			data->ring_handles[i] = (uint32_t)handles[i];
+
+		/* textures of the previous generation can still be in the
+		 * middle, game capture only takes the new ones */
+		data->ring_generation++;
+		InterlockedExchange(
+			&data->ring_middle,
+			shtex_ring_generation_bits(data->ring_generation) | 1);
+	}
+
+	return shtex_signal_ready(window, cx, cy, format, flip);
+}
+
+/* game capture reads the frame from another process, streaming stores keep
+ * it from evicting the game's data from the caches */
+static void copy_frame(uint8_t *dst, const uint8_t *src, size_t size)
+{
+#if defined(_M_IX86) || defined(_M_X64)
+	if (((uintptr_t)dst & 15) == 0) {
+		const size_t blocks = size / 64;
+
+		for (size_t i = 0; i < blocks; i++) {
+			const __m128i *in = (const __m128i *)src;
+			__m128i *out = (__m128i *)dst;
+
+			__m128i a = _mm_loadu_si128(in);
+			__m128i b = _mm_loadu_si128(in + 1);
+			__m128i c = _mm_loadu_si128(in + 2);
+			__m128i d = _mm_loadu_si128(in + 3);
+			_mm_stream_si128(out, a);
+			_mm_stream_si128(out + 1, b);
+			_mm_stream_si128(out + 2, c);
+			_mm_stream_si128(out + 3, d);
+
+			src += 64;
+			dst += 64;
+		}
+
+		_mm_sfence();
+		size -= blocks * 64;
+	}
+#endif
+
+	memcpy(dst, src, size);
+}
+
 static DWORD CALLBACK copy_thread(LPVOID unused)
 {
 	uint32_t pitch = thread_data.pitch;
@@ -615,8 +704,9 @@ static DWORD CALLBACK copy_thread(LPVOID unused)
 
 			int lock_id = try_lock_shmem_tex(shmem_id);
 			if (lock_id != -1) {
-				memcpy(thread_data.shmem_textures[lock_id],
-				       cur_data, (size_t)pitch * (size_t)cy);
+				copy_frame(thread_data.shmem_textures[lock_id],
+					   (const uint8_t *)cur_data,
+					   (size_t)pitch * (size_t)cy);
 
 				unlock_shmem_tex(lock_id);
 				((struct shmem_data *)shmem_info)->last_tex =
@@ -722,7 +812,8 @@ static inline bool init_shmem_thread(uint32_t pitch, uint32_t cy)
 bool capture_init_shmem(struct shmem_data **data, HWND window, uint32_t cx,
 			uint32_t cy, uint32_t pitch, uint32_t format, bool flip)
 {
-	uint32_t tex_size = cy * pitch;
+	uint32_t rows = format == DXGI_FORMAT_NV12 ? shmem_nv12_rows(cy) : cy;
+	uint32_t tex_size = rows * pitch;
 	uint32_t aligned_header = ALIGN(sizeof(struct shmem_data), 32);
 	uint32_t aligned_tex = ALIGN(tex_size, 32);
 	uint32_t total_size = aligned_header + aligned_tex * 2 + 32;
@@ -762,7 +853,7 @@ bool capture_init_shmem(struct shmem_data **data, HWND window, uint32_t cx,
 	global_hook_info->UNUSED_base_cx = cx;
 	global_hook_info->UNUSED_base_cy = cy;
 
-	if (!init_shmem_thread(pitch, cy)) {
+	if (!init_shmem_thread(pitch, rows)) {
 		return false;
 	}
 
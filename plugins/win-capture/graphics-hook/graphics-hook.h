@@ -54,6 +54,7 @@ extern void d3d10_capture(void *swap, void *backbuffer, bool capture_overlay);
 extern void d3d10_free(void);
 extern void d3d11_capture(void *swap, void *backbuffer, bool capture_overlay);
 extern void d3d11_free(void);
+extern bool d3d11_resize(void);
 
 #if COMPILE_D3D12_HOOK
 extern void d3d12_capture(void *swap, void *backbuffer, bool capture_overlay);
@@ -65,9 +66,16 @@ extern bool rehook_gl(void);
 extern bool capture_init_shtex(struct shtex_data **data, HWND window,
 			       uint32_t cx, uint32_t cy, uint32_t format,
 			       bool flip, uintptr_t handle);
+extern bool capture_init_shtex_ring(struct shtex_data **data, HWND window,
+				    uint32_t cx, uint32_t cy, uint32_t format,
+				    bool flip, const uintptr_t *handles,
+				    bool keyed_mutex);
 extern bool capture_init_shmem(struct shmem_data **data, HWND window,
 			       uint32_t cx, uint32_t cy, uint32_t pitch,
 			       uint32_t format, bool flip);
+extern bool capture_readapt_shtex(struct shtex_data *data, HWND window,
+				  uint32_t cx, uint32_t cy, uint32_t format,
+				  bool flip, const uintptr_t *handles);
 extern void capture_free(void);
 
 extern struct hook_info *global_hook_info;
@@ -216,6 +224,29 @@ static inline bool capture_should_stop(void)
 	return stop_requested;
 }
 
+/* whether game capture reads the shared texture ring */
+static inline bool capture_use_shtex_ring(void)
+{
+	return global_hook_info->shtex_ring != 0;
+}
+
+/* whether game capture reopens the textures the hook replaced in place */
+static inline bool capture_use_readapt(void)
+{
+	return global_hook_info->readapt != 0;
+}
+
+/* hands the texture of the ring with the newest frame to game capture,
+ * returns the texture to copy the next frame to */
+static inline int shtex_ring_publish(struct shtex_data *data, int tex)
+{
+	const long generation =
+		shtex_ring_generation_bits(data->ring_generation);
+	const long middle = InterlockedExchange(
+		&data->ring_middle, generation | tex | SHTEX_RING_FRESH);
+	return (int)(middle & SHTEX_RING_INDEX);
+}
+
 extern bool init_pipe(void);
 
 static inline bool capture_should_init(void)
@@ -38,21 +38,32 @@ struct vk_obj_list {
 	SRWLOCK mutex;
 };
 
+struct vk_export_tex {
+	VkImage image;
+	bool layout_initialized;
+	VkDeviceMemory mem;
+	HANDLE handle;
+	ID3D11Texture2D *d3d11_tex;
+};
+
 struct vk_swap_data {
 	struct vk_obj_node node;
 
 	VkExtent2D image_extent;
 	VkFormat format;
 	HWND hwnd;
-	VkImage export_image;
-	bool layout_initialized;
-	VkDeviceMemory export_mem;
 	VkImage *swap_images;
 	uint32_t image_count;
 
-	HANDLE handle;
+	/* one texture, or the shared texture ring if game capture reads it */
+	struct vk_export_tex export_texs[SHTEX_RING_SIZE];
+	uint32_t export_count;
+	int export_idx;
+
+	/* signalled once the copy to the ring texture export_idx is done */
+	VkFence pending_fence;
+
 	struct shtex_data *shtex_info;
-	ID3D11Texture2D *d3d11_tex;
 	bool captured;
 };
 
@@ -414,21 +425,30 @@ static void vk_shtex_free(struct vk_data *data)
 
 	while (swap) {
 		VkDevice device = data->device;
-		if (swap->export_image)
-			data->funcs.DestroyImage(device, swap->export_image,
-						 data->ac);
 
-		if (swap->export_mem)
-			data->funcs.FreeMemory(device, swap->export_mem, NULL);
+		for (uint32_t i = 0; i < swap->export_count; i++) {
+			struct vk_export_tex *tex = &swap->export_texs[i];
+
+			if (tex->image)
+				data->funcs.DestroyImage(device, tex->image,
+							 data->ac);
 
-		if (swap->d3d11_tex) {
-			ID3D11Texture2D_Release(swap->d3d11_tex);
+			if (tex->mem)
+				data->funcs.FreeMemory(device, tex->mem, NULL);
+
+			if (tex->d3d11_tex) {
+				ID3D11Texture2D_Release(tex->d3d11_tex);
+			}
+
+			tex->handle = INVALID_HANDLE_VALUE;
+			tex->d3d11_tex = NULL;
+			tex->mem = VK_NULL_HANDLE;
+			tex->image = VK_NULL_HANDLE;
 		}
 
-		swap->handle = INVALID_HANDLE_VALUE;
-		swap->d3d11_tex = NULL;
-		swap->export_mem = VK_NULL_HANDLE;
-		swap->export_image = VK_NULL_HANDLE;
+		swap->export_count = 0;
+		swap->export_idx = 0;
+		swap->pending_fence = VK_NULL_HANDLE;
 
 		swap->captured = false;
 
@@ -611,7 +631,8 @@ static inline bool vk_shtex_init_d3d11(struct vk_data *data)
 }
 
 static inline bool vk_shtex_init_d3d11_tex(struct vk_data *data,
-					   struct vk_swap_data *swap)
+					   struct vk_swap_data *swap,
+					   struct vk_export_tex *tex)
 {
 	IDXGIResource *dxgi_res;
 	HRESULT hr;
@@ -642,20 +663,20 @@ static inline bool vk_shtex_init_d3d11_tex(struct vk_data *data,
 	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 
 	hr = ID3D11Device_CreateTexture2D(data->d3d11_device, &desc, NULL,
-					  &swap->d3d11_tex);
+					  &tex->d3d11_tex);
 	if (FAILED(hr)) {
 		flog_hr("failed to create texture", hr);
 		return false;
 	}
 
-	hr = ID3D11Texture2D_QueryInterface(swap->d3d11_tex, &IID_IDXGIResource,
+	hr = ID3D11Texture2D_QueryInterface(tex->d3d11_tex, &IID_IDXGIResource,
 					    &dxgi_res);
 	if (FAILED(hr)) {
 		flog_hr("failed to get IDXGIResource", hr);
 		return false;
 	}
 
-	hr = IDXGIResource_GetSharedHandle(dxgi_res, &swap->handle);
+	hr = IDXGIResource_GetSharedHandle(dxgi_res, &tex->handle);
 	IDXGIResource_Release(dxgi_res);
 
 	if (FAILED(hr)) {
@@ -667,7 +688,8 @@ static inline bool vk_shtex_init_d3d11_tex(struct vk_data *data,
 }
 
 static inline bool vk_shtex_init_vulkan_tex(struct vk_data *data,
-					    struct vk_swap_data *swap)
+					    struct vk_swap_data *swap,
+					    struct vk_export_tex *tex)
 {
 	struct vk_device_funcs *funcs = &data->funcs;
 	VkExternalMemoryFeatureFlags f =
@@ -705,14 +727,14 @@ static inline bool vk_shtex_init_vulkan_tex(struct vk_data *data,
 	VkDevice device = data->device;
 
 	VkResult res;
-	res = funcs->CreateImage(device, &ici, data->ac, &swap->export_image);
+	res = funcs->CreateImage(device, &ici, data->ac, &tex->image);
 	if (VK_SUCCESS != res) {
 		flog("failed to CreateImage: %s", result_to_str(res));
-		swap->export_image = VK_NULL_HANDLE;
+		tex->image = VK_NULL_HANDLE;
 		return false;
 	}
 
-	swap->layout_initialized = false;
+	tex->layout_initialized = false;
 
 	/* -------------------------------------------------------- */
 	/* get image memory requirements                            */
@@ -733,12 +755,12 @@ static inline bool vk_shtex_init_vulkan_tex(struct vk_data *data,
 		imri2.sType =
 			VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
 		imri2.pNext = NULL;
-		imri2.image = swap->export_image;
+		imri2.image = tex->image;
 
 		funcs->GetImageMemoryRequirements2(device, &imri2, &mr2);
 		mr = mr2.memoryRequirements;
 	} else {
-		funcs->GetImageMemoryRequirements(device, swap->export_image,
+		funcs->GetImageMemoryRequirements(device, tex->image,
 						  &mr);
 	}
 
@@ -764,8 +786,8 @@ static inline bool vk_shtex_init_vulkan_tex(struct vk_data *data,
 
 	if (mem_type_idx == pdmp.memoryTypeCount) {
 		flog("failed to get memory type index");
-		funcs->DestroyImage(device, swap->export_image, data->ac);
-		swap->export_image = VK_NULL_HANDLE;
+		funcs->DestroyImage(device, tex->image, data->ac);
+		tex->image = VK_NULL_HANDLE;
 		return false;
 	}
 
@@ -778,7 +800,7 @@ static inline bool vk_shtex_init_vulkan_tex(struct vk_data *data,
 	imw32hi.name = NULL;
 	imw32hi.handleType =
 		VK_EXTERNAL_MEMORY_HANDLE_TYPE_D3D11_TEXTURE_KMT_BIT;
-	imw32hi.handle = swap->handle;
+	imw32hi.handle = tex->handle;
 
 	VkMemoryAllocateInfo mai;
 	mai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
@@ -793,15 +815,15 @@ static inline bool vk_shtex_init_vulkan_tex(struct vk_data *data,
 
 	if (data->external_mem_props.externalMemoryFeatures &
 	    VK_EXTERNAL_MEMORY_FEATURE_DEDICATED_ONLY_BIT) {
-		mdai.image = swap->export_image;
+		mdai.image = tex->image;
 		imw32hi.pNext = &mdai;
 	}
 
-	res = funcs->AllocateMemory(device, &mai, NULL, &swap->export_mem);
+	res = funcs->AllocateMemory(device, &mai, NULL, &tex->mem);
 	if (VK_SUCCESS != res) {
 		flog("failed to AllocateMemory: %s", result_to_str(res));
-		funcs->DestroyImage(device, swap->export_image, data->ac);
-		swap->export_image = VK_NULL_HANDLE;
+		funcs->DestroyImage(device, tex->image, data->ac);
+		tex->image = VK_NULL_HANDLE;
 		return false;
 	}
 
@@ -813,20 +835,20 @@ static inline bool vk_shtex_init_vulkan_tex(struct vk_data *data,
 	if (use_bi2) {
 		VkBindImageMemoryInfo bimi = {0};
 		bimi.sType = VK_STRUCTURE_TYPE_BIND_IMAGE_MEMORY_INFO;
-		bimi.image = swap->export_image;
-		bimi.memory = swap->export_mem;
+		bimi.image = tex->image;
+		bimi.memory = tex->mem;
 		bimi.memoryOffset = 0;
 		res = funcs->BindImageMemory2(device, 1, &bimi);
 	} else {
-		res = funcs->BindImageMemory(device, swap->export_image,
-					     swap->export_mem, 0);
+		res = funcs->BindImageMemory(device, tex->image,
+					     tex->mem, 0);
 	}
 	if (VK_SUCCESS != res) {
 		flog("%s failed: %s",
 		     use_bi2 ? "BindImageMemory2" : "BindImageMemory",
 		     result_to_str(res));
-		funcs->DestroyImage(device, swap->export_image, data->ac);
-		swap->export_image = VK_NULL_HANDLE;
+		funcs->DestroyImage(device, tex->image, data->ac);
+		tex->image = VK_NULL_HANDLE;
 		return false;
 	}
 	return true;
@@ -835,23 +857,46 @@ static inline bool vk_shtex_init_vulkan_tex(struct vk_data *data,
 static bool vk_shtex_init(struct vk_data *data, HWND window,
 			  struct vk_swap_data *swap)
 {
+	const bool use_ring = capture_use_shtex_ring();
+	uintptr_t handles[SHTEX_RING_SIZE];
+
 	if (!vk_shtex_init_d3d11(data)) {
 		return false;
 	}
-	if (!vk_shtex_init_d3d11_tex(data, swap)) {
-		return false;
-	}
-	if (!vk_shtex_init_vulkan_tex(data, swap)) {
-		return false;
+
+	swap->export_count = use_ring ? SHTEX_RING_SIZE : 1;
+	swap->export_idx = 0;
+	swap->pending_fence = VK_NULL_HANDLE;
+
+	for (uint32_t i = 0; i < swap->export_count; i++) {
+		struct vk_export_tex *tex = &swap->export_texs[i];
+
+		if (!vk_shtex_init_d3d11_tex(data, swap, tex)) {
+			return false;
+		}
+		if (!vk_shtex_init_vulkan_tex(data, swap, tex)) {
+			return false;
+		}
+
+		handles[i] = (uintptr_t)tex->handle;
 	}
 
 	data->cur_swap = swap;
 
-	swap->captured = capture_init_shtex(&swap->shtex_info, window,
-					    swap->image_extent.width,
-					    swap->image_extent.height,
-					    (uint32_t)swap->format, false,
-					    (uintptr_t)swap->handle);
+	/* Vulkan can't use the keyed mutexes without an extension the game
+	 * would have to enable, the ring textures are only handed to game
+	 * capture once their copy completed instead */
+	if (use_ring) {
+		swap->captured = capture_init_shtex_ring(
+			&swap->shtex_info, window, swap->image_extent.width,
+			swap->image_extent.height, (uint32_t)swap->format,
+			false, handles, false);
+	} else {
+		swap->captured = capture_init_shtex(
+			&swap->shtex_info, window, swap->image_extent.width,
+			swap->image_extent.height, (uint32_t)swap->format,
+			false, handles[0]);
+	}
 
 	if (!swap->captured)
 		return false;
@@ -953,6 +998,28 @@ static void vk_shtex_destroy_frame_objects(struct vk_data *data,
 	queue_data->frame_count = 0;
 }
 
+/* hands the ring texture of the last copy to game capture once the copy is
+ * done, returns false while it is still in flight, and the frame is dropped
+ * rather than waiting for it */
+static bool vk_shtex_ring_ready(struct vk_data *data,
+				struct vk_swap_data *swap)
+{
+	if (swap->pending_fence == VK_NULL_HANDLE)
+		return true;
+
+	const VkResult res =
+		data->funcs.GetFenceStatus(data->device, swap->pending_fence);
+	if (res == VK_NOT_READY)
+		return false;
+
+	swap->pending_fence = VK_NULL_HANDLE;
+	if (res == VK_SUCCESS)
+		swap->export_idx =
+			shtex_ring_publish(swap->shtex_info, swap->export_idx);
+
+	return true;
+}
+
 static void vk_shtex_capture(struct vk_data *data,
 			     struct vk_device_funcs *funcs,
 			     struct vk_swap_data *swap, uint32_t idx,
@@ -960,6 +1027,11 @@ static void vk_shtex_capture(struct vk_data *data,
 {
 	VkResult res = VK_SUCCESS;
 
+	if (!vk_shtex_ring_ready(data, swap))
+		return;
+
+	struct vk_export_tex *tex = &swap->export_texs[swap->export_idx];
+
 	VkCommandBufferBeginInfo begin_info;
 	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	begin_info.pNext = NULL;
@@ -1009,7 +1081,7 @@ static void vk_shtex_capture(struct vk_data *data,
 	/* ------------------------------------------------------ */
 	/* transition shared texture if necessary                 */
 
-	if (!swap->layout_initialized) {
+	if (!tex->layout_initialized) {
 		VkImageMemoryBarrier imb;
 		imb.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		imb.pNext = NULL;
@@ -1019,7 +1091,7 @@ static void vk_shtex_capture(struct vk_data *data,
 		imb.newLayout = VK_IMAGE_LAYOUT_GENERAL;
 		imb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		imb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		imb.image = swap->export_image;
+		imb.image = tex->image;
 		imb.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		imb.subresourceRange.baseMipLevel = 0;
 		imb.subresourceRange.levelCount = 1;
@@ -1031,7 +1103,7 @@ static void vk_shtex_capture(struct vk_data *data,
 					  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
 					  0, NULL, 0, NULL, 1, &imb);
 
-		swap->layout_initialized = true;
+		tex->layout_initialized = true;
 	}
 
 	/* ------------------------------------------------------ */
@@ -1063,7 +1135,7 @@ static void vk_shtex_capture(struct vk_data *data,
 	dst_mb->newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 	dst_mb->srcQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
 	dst_mb->dstQueueFamilyIndex = fam_idx;
-	dst_mb->image = swap->export_image;
+	dst_mb->image = tex->image;
 	dst_mb->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	dst_mb->subresourceRange.baseMipLevel = 0;
 	dst_mb->subresourceRange.levelCount = 1;
@@ -1098,8 +1170,8 @@ static void vk_shtex_capture(struct vk_data *data,
 	cpy.extent.depth = 1;
 	funcs->CmdCopyImage(cmd_buffer, cur_backbuffer,
 			    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			    swap->export_image,
-			    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &cpy);
+			    tex->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+			    &cpy);
 
 	/* ------------------------------------------------------ */
 	/* Restore the swap chain image layout to what it was 
@@ -1146,8 +1218,12 @@ static void vk_shtex_capture(struct vk_data *data,
 	debug_res("QueueSubmit", res);
 #endif
 
-	if (res == VK_SUCCESS)
+	if (res == VK_SUCCESS) {
 		frame_data->cmd_buffer_busy = true;
+
+		if (swap->export_count > 1)
+			swap->pending_fence = fence;
+	}
 }
 
 static inline bool valid_rect(struct vk_swap_data *swap)
@@ -1503,6 +1579,7 @@ static VkResult VKAPI_CALL OBS_CreateDevice(VkPhysicalDevice phy_device,
 	GETADDR(CreateFence);
 	GETADDR(DestroyFence);
 	GETADDR(WaitForFences);
+	GETADDR(GetFenceStatus);
 	GETADDR(ResetFences);
 #undef GETADDR
 
@@ -1684,13 +1761,13 @@ OBS_CreateSwapchainKHR(VkDevice device, const VkSwapchainCreateInfoKHR *cinfo,
 			swap_data->format = cinfo->imageFormat;
 			swap_data->hwnd =
 				find_surf_hwnd(data->inst_data, cinfo->surface);
-			swap_data->export_image = VK_NULL_HANDLE;
-			swap_data->layout_initialized = false;
-			swap_data->export_mem = VK_NULL_HANDLE;
+			memset(swap_data->export_texs, 0,
+			       sizeof(swap_data->export_texs));
+			swap_data->export_count = 0;
+			swap_data->export_idx = 0;
+			swap_data->pending_fence = VK_NULL_HANDLE;
 			swap_data->image_count = count;
-			swap_data->handle = INVALID_HANDLE_VALUE;
 			swap_data->shtex_info = NULL;
-			swap_data->d3d11_tex = NULL;
 			swap_data->captured = false;
 		}
 	}
@@ -41,6 +41,7 @@ struct vk_device_funcs {
 	DEF_FUNC(CreateFence);
 	DEF_FUNC(DestroyFence);
 	DEF_FUNC(WaitForFences);
+	DEF_FUNC(GetFenceStatus);
 	DEF_FUNC(ResetFences);
 };
 
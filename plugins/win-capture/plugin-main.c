@@ -67,6 +67,8 @@ void wait_for_hook_initialization(void)
 }
 
 void init_hook_files(void);
+extern void window_events_init(void);
+extern void window_events_free(void);
 
 bool obs_module_load(void)
 {
@@ -98,6 +100,7 @@ bool obs_module_load(void)
 	char *config_path = obs_module_config_path(NULL);
 
 	init_hook_files();
+	window_events_init();
 	init_hooks_thread =
 		CreateThread(NULL, 0, init_hooks, config_path, 0, NULL);
 	obs_register_source(&game_capture_info);
@@ -108,4 +111,5 @@ bool obs_module_load(void)
 void obs_module_unload(void)
 {
 	wait_for_hook_initialization();
+	window_events_free();
 }
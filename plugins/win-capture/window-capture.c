@@ -21,6 +21,7 @@
 #define TEXT_CAPTURE_CURSOR obs_module_text("CaptureCursor")
 #define TEXT_COMPATIBILITY  obs_module_text("Compatibility")
 #define TEXT_CLIENT_AREA    obs_module_text("ClientArea")
+#define TEXT_MAX_FPS        obs_module_text("WindowCapture.MaxFPS")
 
 /* clang-format on */
 
@@ -73,6 +74,7 @@ struct window_capture {
 	bool cursor;
 	bool compatibility;
 	bool client_area;
+	int max_fps;
 	bool use_wildcards; /* TODO */
 
 	struct dc_capture capture;
@@ -86,6 +88,7 @@ struct window_capture {
 	float resize_timer;
 	float check_window_timer;
 	float cursor_check_time;
+	float capture_timer;
 
 	HWND window;
 	RECT last_rect;
@@ -192,6 +195,7 @@ static void update_settings(struct window_capture *wc, obs_data_t *s)
 	wc->use_wildcards = obs_data_get_bool(s, "use_wildcards");
 	wc->compatibility = obs_data_get_bool(s, "compatibility");
 	wc->client_area = obs_data_get_bool(s, "client_area");
+	wc->max_fps = (int)obs_data_get_int(s, "max_fps");
 
 	pthread_mutex_unlock(&wc->update_mutex);
 }
@@ -325,6 +329,7 @@ static void wc_defaults(obs_data_t *defaults)
 	obs_data_set_default_bool(defaults, "cursor", true);
 	obs_data_set_default_bool(defaults, "compatibility", false);
 	obs_data_set_default_bool(defaults, "client_area", true);
+	obs_data_set_default_int(defaults, "max_fps", 0);
 }
 
 static void update_settings_visibility(obs_properties_t *props,
@@ -349,6 +354,9 @@ static void update_settings_visibility(obs_properties_t *props,
 	p = obs_properties_get(props, "client_area");
 	obs_property_set_visible(p, wgc_options);
 
+	p = obs_properties_get(props, "max_fps");
+	obs_property_set_visible(p, bitblt_options);
+
 	pthread_mutex_unlock(&wc->update_mutex);
 }
 
@@ -417,6 +425,9 @@ static obs_properties_t *wc_properties(void *data)
 
 	obs_properties_add_bool(ppts, "client_area", TEXT_CLIENT_AREA);
 
+	p = obs_properties_add_int(ppts, "max_fps", TEXT_MAX_FPS, 0, 240, 1);
+	obs_property_int_set_suffix(p, " FPS");
+
 	return ppts;
 }
 
@@ -435,6 +446,28 @@ static void wc_hide(void *data)
 #define RESIZE_CHECK_TIME 0.2f
 #define CURSOR_CHECK_TIME 0.2f
 
+/* tick times summed as floats can land just short of the capture interval */
+#define CAPTURE_TIMER_SLACK 0.001f
+
+static bool capture_due(struct window_capture *wc, float seconds)
+{
+	float interval;
+
+	if (wc->max_fps <= 0)
+		return true;
+
+	interval = 1.0f / (float)wc->max_fps;
+	wc->capture_timer += seconds;
+
+	if (wc->capture_timer + CAPTURE_TIMER_SLACK < interval)
+		return false;
+
+	wc->capture_timer -= interval;
+	if (wc->capture_timer > interval)
+		wc->capture_timer = 0.0f;
+	return true;
+}
+
 static void wc_tick(void *data, float seconds)
 {
 	struct window_capture *wc = data;
@@ -481,7 +514,9 @@ static void wc_tick(void *data, float seconds)
 		wc->previously_failed = false;
 		reset_capture = true;
 
-	} else if (IsIconic(wc->window)) {
+	} else if (wc->method == METHOD_BITBLT && IsIconic(wc->window)) {
+		/* graphics capture keeps its session, and with it the last
+		 * frame, while the window is minimized */
 		return;
 	}
 
@@ -536,9 +571,11 @@ static void wc_tick(void *data, float seconds)
 					rect.right - rect.left,
 					rect.bottom - rect.top, wc->cursor,
 					wc->compatibility);
+			wc->capture_timer = 0.0f;
+			dc_capture_capture(&wc->capture, wc->window);
+		} else if (capture_due(wc, seconds)) {
+			dc_capture_capture(&wc->capture, wc->window);
 		}
-
-		dc_capture_capture(&wc->capture, wc->window);
 	} else if (wc->method == METHOD_WGC) {
 		if (wc->window && (wc->capture_winrt == NULL)) {
 			if (!wc->previously_failed) {
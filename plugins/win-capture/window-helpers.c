@@ -1,6 +1,7 @@
 #define PSAPI_VERSION 1
 #include <obs.h>
 #include <util/dstr.h>
+#include <util/threading.h>
 
 #include <dwmapi.h>
 #include <psapi.h>
@@ -522,3 +523,94 @@ HWND find_window_top_level(enum window_search_mode mode,
 	EnumWindows(enum_windows_proc, (LPARAM)&data);
 	return data.best_window;
 }
+
+/* ------------------------------------------------------------------------- */
+
+static HANDLE window_events_thread = NULL;
+static DWORD window_events_thread_id = 0;
+static volatile long window_events_count = 0;
+
+static void CALLBACK window_event_proc(HWINEVENTHOOK hook, DWORD event,
+				       HWND hwnd, LONG id_object,
+				       LONG id_child, DWORD thread_id,
+				       DWORD time)
+{
+	if (id_object != OBJID_WINDOW || id_child != CHILDID_SELF || !hwnd)
+		return;
+	if (GetAncestor(hwnd, GA_ROOT) != hwnd)
+		return;
+
+	os_atomic_inc_long(&window_events_count);
+
+	UNUSED_PARAMETER(hook);
+	UNUSED_PARAMETER(event);
+	UNUSED_PARAMETER(thread_id);
+	UNUSED_PARAMETER(time);
+}
+
+static DWORD WINAPI window_events_loop(LPVOID param)
+{
+	HANDLE started = param;
+	HWINEVENTHOOK show_hook;
+	HWINEVENTHOOK foreground_hook;
+	MSG msg;
+
+	/* creates the message queue before anyone can post the quit */
+	PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+	SetEvent(started);
+
+	show_hook = SetWinEventHook(EVENT_OBJECT_SHOW, EVENT_OBJECT_SHOW,
+				    NULL, window_event_proc, 0, 0,
+				    WINEVENT_OUTOFCONTEXT |
+					    WINEVENT_SKIPOWNPROCESS);
+	foreground_hook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND,
+					  EVENT_SYSTEM_FOREGROUND, NULL,
+					  window_event_proc, 0, 0,
+					  WINEVENT_OUTOFCONTEXT |
+						  WINEVENT_SKIPOWNPROCESS);
+	if (!show_hook || !foreground_hook)
+		blog(LOG_WARNING, "window_events_loop: failed to hook window "
+				  "events, searching for windows periodically");
+
+	while (GetMessage(&msg, NULL, 0, 0) > 0) {
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+
+	if (show_hook)
+		UnhookWinEvent(show_hook);
+	if (foreground_hook)
+		UnhookWinEvent(foreground_hook);
+	return 0;
+}
+
+void window_events_init(void)
+{
+	HANDLE started = CreateEvent(NULL, true, false, NULL);
+	if (!started)
+		return;
+
+	window_events_thread =
+		CreateThread(NULL, 0, window_events_loop, started, 0,
+			     &window_events_thread_id);
+	if (window_events_thread)
+		WaitForSingleObject(started, INFINITE);
+
+	CloseHandle(started);
+}
+
+void window_events_free(void)
+{
+	if (!window_events_thread)
+		return;
+
+	PostThreadMessage(window_events_thread_id, WM_QUIT, 0, 0);
+	WaitForSingleObject(window_events_thread, INFINITE);
+	CloseHandle(window_events_thread);
+	window_events_thread = NULL;
+}
+
+long window_events_serial(void)
+{
+	return os_atomic_load_long(&window_events_count);
+}
@@ -35,3 +35,9 @@ extern HWND find_window_top_level(enum window_search_mode mode,
 				  enum window_priority priority,
 				  const char *class, const char *title,
 				  const char *exe);
+
+/* counts the top level windows shown and brought to the foreground, so
+ * sources waiting for a window can search again as soon as one appears */
+extern void window_events_init(void);
+extern void window_events_free(void);
+extern long window_events_serial(void);
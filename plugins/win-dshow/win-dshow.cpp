@@ -11,6 +11,7 @@
 #include "encode-dstr.hpp"
 
 #include <algorithm>
+#include <deque>
 #include <limits>
 #include <set>
 #include <string>
@@ -173,7 +174,19 @@ enum class Action {
 	ConfigCrossbar2,
 };
 
+/* MJPEG frames are independent, so if the decoder falls behind, all but the
+ * newest few are dropped.  H.264 packets can't be dropped. */
+#define MAX_PENDING_MJPEG_PACKETS 2
+
+struct EncodedPacket {
+	enum AVCodecID id;
+	vector<unsigned char> data;
+	long long ts;
+	bool useHW;
+};
+
 static DWORD CALLBACK DShowThread(LPVOID ptr);
+static DWORD CALLBACK DecodeThread(LPVOID ptr);
 
 struct DShowInput {
 	obs_source_t *source;
@@ -188,6 +201,17 @@ struct DShowInput {
 	Decoder audio_decoder;
 	Decoder video_decoder;
 
+	/* encoded video is decoded on its own thread, so the device's
+	 * callback only has to copy the packet */
+	obs_source_frame2 decoded_frame;
+	WinHandle decode_semaphore;
+	WinHandle decode_thread;
+	CriticalSection decode_mutex;
+	CriticalSection decode_busy;
+	deque<EncodedPacket> packets;
+	vector<EncodedPacket> free_packets;
+	bool decode_stop = false;
+
 	VideoConfig videoConfig;
 	AudioConfig audioConfig;
 
@@ -225,6 +249,7 @@ struct DShowInput {
 	{
 		memset(&audio, 0, sizeof(audio));
 		memset(&frame, 0, sizeof(frame));
+		memset(&decoded_frame, 0, sizeof(decoded_frame));
 
 		av_log_set_level(AV_LOG_WARNING);
 		av_log_set_callback(ffmpeg_log);
@@ -237,6 +262,16 @@ struct DShowInput {
 		if (!activated_event)
 			throw "Failed to create activated_event";
 
+		decode_semaphore =
+			CreateSemaphore(nullptr, 0, 0x7FFFFFFF, nullptr);
+		if (!decode_semaphore)
+			throw "Failed to create decode semaphore";
+
+		decode_thread = CreateThread(nullptr, 0, DecodeThread, this, 0,
+					     nullptr);
+		if (!decode_thread)
+			throw "Failed to create decode thread";
+
 		thread =
 			CreateThread(nullptr, 0, DShowThread, this, 0, nullptr);
 		if (!thread)
@@ -265,10 +300,21 @@ struct DShowInput {
 		ReleaseSemaphore(semaphore, 1, nullptr);
 
 		WaitForSingleObject(thread, INFINITE);
+
+		{
+			CriticalScope scope(decode_mutex);
+			decode_stop = true;
+		}
+
+		ReleaseSemaphore(decode_semaphore, 1, nullptr);
+
+		WaitForSingleObject(decode_thread, INFINITE);
 	}
 
-	void OnEncodedVideoData(enum AVCodecID id, unsigned char *data,
-				size_t size, long long ts);
+	void QueueEncodedVideo(enum AVCodecID id, unsigned char *data,
+			       size_t size, long long ts);
+	void FlushEncodedVideo();
+	void DecodeVideo(const EncodedPacket &packet);
 	void OnEncodedAudioData(enum AVCodecID id, unsigned char *data,
 				size_t size, long long ts);
 
@@ -289,6 +335,7 @@ struct DShowInput {
 	inline void SetupBuffering(obs_data_t *settings);
 
 	void DShowLoop();
+	void DecodeLoop();
 };
 
 static DWORD CALLBACK DShowThread(LPVOID ptr)
@@ -303,6 +350,16 @@ static DWORD CALLBACK DShowThread(LPVOID ptr)
 	return 0;
 }
 
+static DWORD CALLBACK DecodeThread(LPVOID ptr)
+{
+	DShowInput *dshowInput = (DShowInput *)ptr;
+
+	os_set_thread_name("win-dshow: DecodeThread");
+
+	dshowInput->DecodeLoop();
+	return 0;
+}
+
 static inline void ProcessMessages()
 {
 	MSG msg;
@@ -478,46 +535,119 @@ static inline enum speaker_layout convert_speaker_layout(uint8_t channels)
 //#define LOG_ENCODED_VIDEO_TS 1
 //#define LOG_ENCODED_AUDIO_TS 1
 
+void DShowInput::DecodeLoop()
+{
+	EncodedPacket packet;
+
+	while (WaitForSingleObject(decode_semaphore, INFINITE) ==
+	       WAIT_OBJECT_0) {
+		{
+			CriticalScope scope(decode_mutex);
+			if (decode_stop)
+				break;
+			if (packets.empty())
+				continue;
+
+			packet = move(packets.front());
+			packets.pop_front();
+		}
+
+		{
+			CriticalScope scope(decode_busy);
+			DecodeVideo(packet);
+		}
+
+		CriticalScope scope(decode_mutex);
+		free_packets.push_back(move(packet));
+	}
+}
+
 #define MAX_SW_RES_INT (1920 * 1080)
 
-void DShowInput::OnEncodedVideoData(enum AVCodecID id, unsigned char *data,
-				    size_t size, long long ts)
+void DShowInput::QueueEncodedVideo(enum AVCodecID id, unsigned char *data,
+				   size_t size, long long ts)
+{
+	EncodedPacket packet;
+
+	{
+		CriticalScope scope(decode_mutex);
+		if (!free_packets.empty()) {
+			packet = move(free_packets.back());
+			free_packets.pop_back();
+		}
+	}
+
+	/* Only use MJPEG hardware decoding on resolutions higher
+	 * than 1920x1080.  The reason why is because we want to strike
+	 * a reasonable balance between hardware and CPU usage. */
+	packet.id = id;
+	packet.data.assign(data, data + size);
+	packet.ts = ts;
+	packet.useHW = videoConfig.format != VideoFormat::MJPEG ||
+		       (videoConfig.cx * videoConfig.cy_abs) > MAX_SW_RES_INT;
+
+	CriticalScope scope(decode_mutex);
+	packets.push_back(move(packet));
+
+	if (id == AV_CODEC_ID_MJPEG) {
+		while (packets.size() > MAX_PENDING_MJPEG_PACKETS) {
+			free_packets.push_back(move(packets.front()));
+			packets.pop_front();
+		}
+	}
+
+	ReleaseSemaphore(decode_semaphore, 1, nullptr);
+}
+
+/* drops the packets that are waiting and waits for the packet that is being
+ * decoded, so nothing is output after the device is stopped */
+void DShowInput::FlushEncodedVideo()
+{
+	{
+		CriticalScope scope(decode_mutex);
+		while (!packets.empty()) {
+			free_packets.push_back(move(packets.front()));
+			packets.pop_front();
+		}
+	}
+
+	CriticalScope scope(decode_busy);
+}
+
+void DShowInput::DecodeVideo(const EncodedPacket &packet)
 {
 	/* If format changes, free and allow it to recreate the decoder */
 	if (ffmpeg_decode_valid(video_decoder) &&
-	    video_decoder->codec->id != id) {
+	    video_decoder->codec->id != packet.id) {
 		ffmpeg_decode_free(video_decoder);
 	}
 
 	if (!ffmpeg_decode_valid(video_decoder)) {
-		/* Only use MJPEG hardware decoding on resolutions higher
-		 * than 1920x1080.  The reason why is because we want to strike
-		 * a reasonable balance between hardware and CPU usage. */
-		bool useHW = videoConfig.format != VideoFormat::MJPEG ||
-			     (videoConfig.cx * videoConfig.cy_abs) >
-				     MAX_SW_RES_INT;
-		if (ffmpeg_decode_init(video_decoder, id, useHW) < 0) {
+		if (ffmpeg_decode_init(video_decoder, packet.id,
+				       packet.useHW) < 0) {
 			blog(LOG_WARNING, "Could not initialize video decoder");
 			return;
 		}
 	}
 
 	bool got_output;
-	bool success = ffmpeg_decode_video(video_decoder, data, size, &ts,
-					   range, &frame, &got_output);
+	long long ts = packet.ts;
+	bool success = ffmpeg_decode_video(
+		video_decoder, (uint8_t *)packet.data.data(),
+		packet.data.size(), &ts, range, &decoded_frame, &got_output);
 	if (!success) {
 		blog(LOG_WARNING, "Error decoding video");
 		return;
 	}
 
 	if (got_output) {
-		frame.timestamp = (uint64_t)ts * 100;
+		decoded_frame.timestamp = (uint64_t)ts * 100;
 		if (flip)
-			frame.flip = !frame.flip;
+			decoded_frame.flip = !decoded_frame.flip;
 #if LOG_ENCODED_VIDEO_TS
-		blog(LOG_DEBUG, "video ts: %llu", frame.timestamp);
+		blog(LOG_DEBUG, "video ts: %llu", decoded_frame.timestamp);
 #endif
-		obs_source_output_video2(source, &frame);
+		obs_source_output_video2(source, &decoded_frame);
 	}
 }
 
@@ -531,12 +661,12 @@ void DShowInput::OnVideoData(const VideoConfig &config, unsigned char *data,
 	}
 
 	if (videoConfig.format == VideoFormat::H264) {
-		OnEncodedVideoData(AV_CODEC_ID_H264, data, size, startTime);
+		QueueEncodedVideo(AV_CODEC_ID_H264, data, size, startTime);
 		return;
 	}
 
 	if (videoConfig.format == VideoFormat::MJPEG) {
-		OnEncodedVideoData(AV_CODEC_ID_MJPEG, data, size, startTime);
+		QueueEncodedVideo(AV_CODEC_ID_MJPEG, data, size, startTime);
 		return;
 	}
 
@@ -1100,6 +1230,8 @@ inline bool DShowInput::Activate(obs_data_t *settings)
 	if (!device.ResetGraph())
 		return false;
 
+	FlushEncodedVideo();
+
 	if (!UpdateVideoConfig(settings)) {
 		blog(LOG_WARNING, "%s: Video configuration failed",
 		     obs_source_get_name(source));
@@ -1139,6 +1271,7 @@ inline bool DShowInput::Activate(obs_data_t *settings)
 inline void DShowInput::Deactivate()
 {
 	device.ResetGraph();
+	FlushEncodedVideo();
 	obs_source_output_video2(source, nullptr);
 }
 
@@ -5,9 +5,120 @@
 #include <util/windows/HRError.hpp>
 #include <util/windows/ComPtr.hpp>
 #include <util/windows/CoTaskMemPtr.hpp>
+#include <util/threading.h>
+
+#include <mutex>
 
 using namespace std;
 
+/* Endpoints are enumerated once per direction and then served from this
+ * cache until the endpoint notification callback reports a change. */
+static mutex cacheMutex;
+static ComPtr<IMMDeviceEnumerator> cacheEnumerator;
+static ComPtr<IMMNotificationClient> cacheNotify;
+static vector<AudioDeviceInfo> cachedDevices[2];
+static bool cacheValid[2] = {false, false};
+
+static void InvalidateDeviceCache()
+{
+	lock_guard<mutex> lock(cacheMutex);
+	cacheValid[0] = false;
+	cacheValid[1] = false;
+}
+
+class DeviceCacheNotify : public IMMNotificationClient {
+	long refs = 0; /* auto-incremented to 1 by ComPtr */
+
+public:
+	STDMETHODIMP_(ULONG) AddRef()
+	{
+		return (ULONG)os_atomic_inc_long(&refs);
+	}
+
+	STDMETHODIMP_(ULONG) STDMETHODCALLTYPE Release()
+	{
+		long val = os_atomic_dec_long(&refs);
+		if (val == 0)
+			delete this;
+		return (ULONG)val;
+	}
+
+	STDMETHODIMP QueryInterface(REFIID riid, void **ptr)
+	{
+		if (riid == IID_IUnknown) {
+			*ptr = (IUnknown *)this;
+		} else if (riid == __uuidof(IMMNotificationClient)) {
+			*ptr = (IMMNotificationClient *)this;
+		} else {
+			*ptr = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		os_atomic_inc_long(&refs);
+		return S_OK;
+	}
+
+	STDMETHODIMP OnDefaultDeviceChanged(EDataFlow, ERole, LPCWSTR)
+	{
+		return S_OK;
+	}
+
+	STDMETHODIMP OnDeviceAdded(LPCWSTR)
+	{
+		InvalidateDeviceCache();
+		return S_OK;
+	}
+
+	STDMETHODIMP OnDeviceRemoved(LPCWSTR)
+	{
+		InvalidateDeviceCache();
+		return S_OK;
+	}
+
+	STDMETHODIMP OnDeviceStateChanged(LPCWSTR, DWORD)
+	{
+		InvalidateDeviceCache();
+		return S_OK;
+	}
+
+	STDMETHODIMP OnPropertyValueChanged(LPCWSTR, const PROPERTYKEY key)
+	{
+		if (key.fmtid == PKEY_Device_FriendlyName.fmtid &&
+		    key.pid == PKEY_Device_FriendlyName.pid)
+			InvalidateDeviceCache();
+		return S_OK;
+	}
+};
+
+/* must be called with cacheMutex held */
+static bool StartDeviceMonitoring()
+{
+	if (cacheNotify)
+		return true;
+
+	ComPtr<IMMDeviceEnumerator> enumerator;
+	HRESULT res = CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL,
+				       CLSCTX_ALL,
+				       __uuidof(IMMDeviceEnumerator),
+				       (void **)enumerator.Assign());
+	if (FAILED(res))
+		return false;
+
+	ComPtr<IMMNotificationClient> notify = new DeviceCacheNotify();
+	res = enumerator->RegisterEndpointNotificationCallback(notify);
+	if (FAILED(res)) {
+		blog(LOG_WARNING,
+		     "[GetWASAPIAudioDevices] Failed to register for device "
+		     "notifications: %lX",
+		     res);
+		return false;
+	}
+
+	cacheEnumerator = enumerator;
+	cacheNotify = notify;
+	return true;
+}
+
 string GetDeviceName(IMMDevice *device)
 {
 	string device_name;
@@ -86,13 +197,51 @@ void GetWASAPIAudioDevices_(vector<AudioDeviceInfo> &devices, bool input)
 
 void GetWASAPIAudioDevices(vector<AudioDeviceInfo> &devices, bool input)
 {
+	lock_guard<mutex> lock(cacheMutex);
+	size_t idx = input ? 1 : 0;
+
+	if (cacheValid[idx]) {
+		devices = cachedDevices[idx];
+		return;
+	}
+
 	devices.clear();
 
+	/* register before enumerating so that no change can fall between
+	 * the two and leave a stale list behind */
+	bool monitoring = StartDeviceMonitoring();
+
 	try {
 		GetWASAPIAudioDevices_(devices, input);
 
 	} catch (HRError &error) {
 		blog(LOG_WARNING, "[GetWASAPIAudioDevices] %s: %lX", error.str,
 		     error.hr);
+		return;
 	}
+
+	if (monitoring) {
+		cachedDevices[idx] = devices;
+		cacheValid[idx] = true;
+	}
+}
+
+void ReleaseWASAPIDeviceCache()
+{
+	ComPtr<IMMDeviceEnumerator> enumerator;
+	ComPtr<IMMNotificationClient> notify;
+
+	{
+		lock_guard<mutex> lock(cacheMutex);
+		enumerator = std::move(cacheEnumerator);
+		notify = std::move(cacheNotify);
+		cachedDevices[0].clear();
+		cachedDevices[1].clear();
+		cacheValid[0] = false;
+		cacheValid[1] = false;
+	}
+
+	/* unregistering waits for callbacks in flight, which take the lock */
+	if (enumerator)
+		enumerator->UnregisterEndpointNotificationCallback(notify);
 }
@@ -9,6 +9,7 @@ MODULE_EXPORT const char *obs_module_description(void)
 
 void RegisterWASAPIInput();
 void RegisterWASAPIOutput();
+void ReleaseWASAPIDeviceCache();
 
 bool obs_module_load(void)
 {
@@ -16,3 +17,8 @@ bool obs_module_load(void)
 	RegisterWASAPIOutput();
 	return true;
 }
+
+void obs_module_unload(void)
+{
+	ReleaseWASAPIDeviceCache();
+}
@@ -11,11 +11,13 @@
 #include <util/util_uint64.h>
 
 #include <thread>
+#include <vector>
 
 using namespace std;
 
 #define OPT_DEVICE_ID "device_id"
 #define OPT_USE_DEVICE_TIMING "use_device_timing"
+#define OPT_LOW_LATENCY "low_latency"
 
 static void GetWASAPIDefaults(obs_data_t *settings);
 
@@ -39,6 +41,7 @@ class WASAPISource {
 	bool isInputDevice;
 	bool useDeviceTiming = false;
 	bool isDefaultDevice = false;
+	bool lowLatency = false;
 
 	bool reconnecting = false;
 	bool previouslyFailed = false;
@@ -53,11 +56,24 @@ class WASAPISource {
 	speaker_layout speakers;
 	audio_format format;
 	uint32_t sampleRate;
+	uint32_t blockAlign;
+
+	/* low latency packets are only a few milliseconds long, they are
+	 * collected to chunks of about the length of a default period */
+	vector<uint8_t> chunk;
+	uint32_t chunkFrames = 0;
+	uint64_t chunkTimestamp = 0;
 
 	static DWORD WINAPI ReconnectThread(LPVOID param);
 	static DWORD WINAPI CaptureThread(LPVOID param);
 
 	bool ProcessCaptureData();
+	uint64_t PacketTimestamp(UINT32 frames, DWORD flags, UINT64 ts);
+	void OutputAudio(const uint8_t *data, uint32_t frames,
+			 uint64_t timestamp);
+	void AddToChunk(const uint8_t *data, uint32_t frames, DWORD flags,
+			uint64_t timestamp);
+	void OutputChunk();
 
 	inline void Start();
 	inline void Stop();
@@ -65,6 +81,7 @@ class WASAPISource {
 
 	bool InitDevice();
 	void InitName();
+	bool InitLowLatencyClient(WAVEFORMATEX *wfex, DWORD flags);
 	void InitClient();
 	void InitRender();
 	void InitFormat(WAVEFORMATEX *wfex);
@@ -189,13 +206,16 @@ void WASAPISource::UpdateSettings(obs_data_t *settings)
 {
 	device_id = obs_data_get_string(settings, OPT_DEVICE_ID);
 	useDeviceTiming = obs_data_get_bool(settings, OPT_USE_DEVICE_TIMING);
+	lowLatency = obs_data_get_bool(settings, OPT_LOW_LATENCY);
 	isDefaultDevice = _strcmpi(device_id.c_str(), "default") == 0;
 }
 
 void WASAPISource::Update(obs_data_t *settings)
 {
 	string newDevice = obs_data_get_string(settings, OPT_DEVICE_ID);
-	bool restart = newDevice.compare(device_id) != 0;
+	bool newLowLatency = obs_data_get_bool(settings, OPT_LOW_LATENCY);
+	bool restart = newDevice.compare(device_id) != 0 ||
+		       newLowLatency != lowLatency;
 
 	if (restart)
 		Stop();
@@ -235,6 +255,41 @@ bool WASAPISource::InitDevice()
 }
 
 #define BUFFER_TIME_100NS (5 * 10000000)
+#define CHUNK_MS 10
+
+/* shared mode streams with the smallest period the engine allows, only for
+ * capture endpoints since loopback streams always use the default period */
+bool WASAPISource::InitLowLatencyClient(WAVEFORMATEX *wfex, DWORD flags)
+{
+	ComPtr<IAudioClient3> client3;
+	UINT32 defaultPeriod, fundamentalPeriod, minPeriod, maxPeriod;
+	HRESULT res;
+
+	res = client->QueryInterface(__uuidof(IAudioClient3),
+				     (void **)client3.Assign());
+	if (FAILED(res))
+		return false;
+
+	res = client3->GetSharedModeEnginePeriod(wfex, &defaultPeriod,
+						 &fundamentalPeriod, &minPeriod,
+						 &maxPeriod);
+	if (FAILED(res))
+		return false;
+
+	res = client3->InitializeSharedAudioStream(flags, minPeriod, wfex,
+						   nullptr);
+	if (FAILED(res)) {
+		blog(LOG_WARNING,
+		     "[WASAPISource::InitLowLatencyClient] "
+		     "Failed to initialize %u frame period: %lX",
+		     minPeriod, res);
+		return false;
+	}
+
+	blog(LOG_INFO, "WASAPI: Device '%s' uses %u frame periods (%u default)",
+	     device_name.c_str(), minPeriod, defaultPeriod);
+	return true;
+}
 
 void WASAPISource::InitClient()
 {
@@ -256,6 +311,9 @@ void WASAPISource::InitClient()
 	if (!isInputDevice)
 		flags |= AUDCLNT_STREAMFLAGS_LOOPBACK;
 
+	if (lowLatency && isInputDevice && InitLowLatencyClient(wfex, flags))
+		return;
+
 	res = client->Initialize(AUDCLNT_SHAREMODE_SHARED, flags,
 				 BUFFER_TIME_100NS, 0, wfex, nullptr);
 	if (FAILED(res))
@@ -335,6 +393,7 @@ void WASAPISource::InitFormat(WAVEFORMATEX *wfex)
 
 	/* WASAPI is always float */
 	sampleRate = wfex->nSamplesPerSec;
+	blockAlign = wfex->nBlockAlign;
 	format = AUDIO_FORMAT_FLOAT;
 	speakers = ConvertSpeakerLayout(layout, wfex->nChannels);
 }
@@ -527,19 +586,12 @@ bool WASAPISource::ProcessCaptureData()
 			return false;
 		}
 
-		obs_source_audio data = {};
-		data.data[0] = (const uint8_t *)buffer;
-		data.frames = (uint32_t)frames;
-		data.speakers = speakers;
-		data.samples_per_sec = sampleRate;
-		data.format = format;
-		data.timestamp = useDeviceTiming ? ts * 100 : os_gettime_ns();
+		uint64_t timestamp = PacketTimestamp(frames, flags, ts);
 
-		if (!useDeviceTiming)
-			data.timestamp -= util_mul_div64(frames, 1000000000ULL,
-							 sampleRate);
-
-		obs_source_output_audio(source, &data);
+		if (lowLatency)
+			AddToChunk(buffer, frames, flags, timestamp);
+		else
+			OutputAudio(buffer, frames, timestamp);
 
 		capture->ReleaseBuffer(frames);
 	}
@@ -547,6 +599,69 @@ bool WASAPISource::ProcessCaptureData()
 	return true;
 }
 
+/* the device position is on the same QPC clock as os_gettime_ns, in low
+ * latency mode it is used whenever the device doesn't flag it as wrong */
+uint64_t WASAPISource::PacketTimestamp(UINT32 frames, DWORD flags, UINT64 ts)
+{
+	bool deviceTiming = useDeviceTiming;
+
+	if (lowLatency && (flags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR) == 0)
+		deviceTiming = true;
+
+	if (deviceTiming)
+		return ts * 100;
+
+	return os_gettime_ns() -
+	       util_mul_div64(frames, 1000000000ULL, sampleRate);
+}
+
+void WASAPISource::OutputAudio(const uint8_t *buffer, uint32_t frames,
+			       uint64_t timestamp)
+{
+	obs_source_audio data = {};
+	data.data[0] = buffer;
+	data.frames = frames;
+	data.speakers = speakers;
+	data.samples_per_sec = sampleRate;
+	data.format = format;
+	data.timestamp = timestamp;
+
+	obs_source_output_audio(source, &data);
+}
+
+void WASAPISource::AddToChunk(const uint8_t *buffer, uint32_t frames,
+			      DWORD flags, uint64_t timestamp)
+{
+	if ((flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) != 0)
+		OutputChunk();
+
+	if (!chunkFrames)
+		chunkTimestamp = timestamp;
+
+	size_t offset = (size_t)chunkFrames * blockAlign;
+	size_t size = (size_t)frames * blockAlign;
+	if (chunk.size() < offset + size)
+		chunk.resize(offset + size);
+
+	if ((flags & AUDCLNT_BUFFERFLAGS_SILENT) != 0)
+		memset(chunk.data() + offset, 0, size);
+	else
+		memcpy(chunk.data() + offset, buffer, size);
+
+	chunkFrames += frames;
+	if (chunkFrames >= sampleRate * CHUNK_MS / 1000)
+		OutputChunk();
+}
+
+void WASAPISource::OutputChunk()
+{
+	if (!chunkFrames)
+		return;
+
+	OutputAudio(chunk.data(), chunkFrames, chunkTimestamp);
+	chunkFrames = 0;
+}
+
 static inline bool WaitForCaptureSignal(DWORD numSignals, const HANDLE *signals,
 					DWORD duration)
 {
@@ -568,6 +683,9 @@ DWORD WINAPI WASAPISource::CaptureThread(LPVOID param)
 
 	os_set_thread_name("win-wasapi: capture thread");
 
+	void *mmcss = source->lowLatency ? os_thread_begin_mmcss("Pro Audio")
+					 : nullptr;
+
 	while (WaitForCaptureSignal(2, sigs, dur)) {
 		if (!source->ProcessCaptureData()) {
 			reconnect = true;
@@ -576,6 +694,9 @@ DWORD WINAPI WASAPISource::CaptureThread(LPVOID param)
 	}
 
 	source->client->Stop();
+	source->chunkFrames = 0;
+
+	os_thread_end_mmcss(mmcss);
 
 	source->captureThread = nullptr;
 	source->active = false;
@@ -634,6 +755,7 @@ static void GetWASAPIDefaultsInput(obs_data_t *settings)
 {
 	obs_data_set_default_string(settings, OPT_DEVICE_ID, "default");
 	obs_data_set_default_bool(settings, OPT_USE_DEVICE_TIMING, false);
+	obs_data_set_default_bool(settings, OPT_LOW_LATENCY, false);
 }
 
 static void GetWASAPIDefaultsOutput(obs_data_t *settings)
@@ -698,6 +820,10 @@ static obs_properties_t *GetWASAPIProperties(bool input)
 	obs_properties_add_bool(props, OPT_USE_DEVICE_TIMING,
 				obs_module_text("UseDeviceTiming"));
 
+	if (input)
+		obs_properties_add_bool(props, OPT_LOW_LATENCY,
+					obs_module_text("LowLatency"));
+
 	return props;
 }
 
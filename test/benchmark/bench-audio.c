@@ -0,0 +1,820 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <obs.h>
+
+/*
+ * Audio pipeline benchmark: builds a graph of synthetic audio sources, each
+ * with a chain of filters, spread over nested scenes and mixed to a number
+ * of tracks, and reports the time the audio thread takes per tick, the time
+ * of each kind of filter and the audio buffering the graph ends up with.
+ * Results are written as JSON.
+ *
+ * Time is virtual: the graph runs under offline rendering, so the audio
+ * thread mixes as fast as it can and a long run takes a fraction of its
+ * length.  Offline rendering is driven by the graphics thread, without
+ * graphics (or with --realtime) the run takes as long as it lasts.
+ *
+ * The "plugin" filter stands in for a third party plugin such as a VST,
+ * running a cascade of biquads over every sample.
+ */
+
+static const char *usage =
+	"usage: bench-audio [options]\n"
+	"  --sources N              audio sources (default 16)\n"
+	"  --filters LIST           filters on each source, of gain,\n"
+	"                           compressor, noise, plugin or source ids,\n"
+	"                           separated by commas, \"\" for none\n"
+	"                           (default gain,compressor,noise,plugin)\n"
+	"  --plugin-passes N        biquads the plugin filter runs\n"
+	"                           (default 8)\n"
+	"  --tracks N               tracks every source is mixed to, 1-6\n"
+	"                           (default 2)\n"
+	"  --depth N                levels of nested scenes (default 2)\n"
+	"  --chunk-ms N             length of the audio the sources output at\n"
+	"                           once (default 10)\n"
+	"  --seconds N              audio to mix (default 30)\n"
+	"  --no-volmeters           don't attach a volume meter to each\n"
+	"                           source\n"
+	"  --realtime               mix in real time instead of offline\n"
+	"  --renderer opengl|d3d11  graphics backend\n"
+	"  --output FILE            write results to FILE instead of stdout\n";
+
+struct bench_config {
+	const char *renderer;
+	int sources;
+	const char *filters;
+	int plugin_passes;
+	int tracks;
+	int depth;
+	int chunk_ms;
+	int seconds;
+	bool volmeters;
+	bool realtime;
+	const char *output;
+};
+
+static const char *filter_ids[][2] = {
+	{"gain", "gain_filter"},
+	{"compressor", "compressor_filter"},
+	{"noise", "noise_suppress_filter"},
+	{"plugin", "bench_plugin_filter"},
+};
+
+static bool parse_args(struct bench_config *cfg, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "--no-volmeters") == 0) {
+			cfg->volmeters = false;
+			continue;
+		} else if (strcmp(arg, "--realtime") == 0) {
+			cfg->realtime = true;
+			continue;
+		}
+		if (!val)
+			return false;
+
+		if (strcmp(arg, "--sources") == 0) {
+			cfg->sources = atoi(val);
+		} else if (strcmp(arg, "--filters") == 0) {
+			cfg->filters = val;
+		} else if (strcmp(arg, "--plugin-passes") == 0) {
+			cfg->plugin_passes = atoi(val);
+		} else if (strcmp(arg, "--tracks") == 0) {
+			cfg->tracks = atoi(val);
+		} else if (strcmp(arg, "--depth") == 0) {
+			cfg->depth = atoi(val);
+		} else if (strcmp(arg, "--chunk-ms") == 0) {
+			cfg->chunk_ms = atoi(val);
+		} else if (strcmp(arg, "--seconds") == 0) {
+			cfg->seconds = atoi(val);
+		} else if (strcmp(arg, "--renderer") == 0) {
+			if (strcmp(val, "opengl") == 0)
+				cfg->renderer = DL_OPENGL;
+#ifdef _WIN32
+			else if (strcmp(val, "d3d11") == 0)
+				cfg->renderer = DL_D3D11;
+#endif
+			else
+				return false;
+		} else if (strcmp(arg, "--output") == 0) {
+			cfg->output = val;
+		} else {
+			return false;
+		}
+
+		i++;
+	}
+
+	return cfg->sources > 0 && cfg->plugin_passes >= 0 &&
+	       cfg->tracks >= 1 && cfg->tracks <= MAX_AUDIO_MIXES &&
+	       cfg->depth >= 0 && cfg->chunk_ms > 0 && cfg->seconds > 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Synthetic source and plugin filter                                        */
+
+static const char *bench_source_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "Benchmark audio source";
+}
+
+static void *bench_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void bench_source_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static struct obs_source_info bench_source_info = {
+	.id = "bench_audio_source",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name = bench_source_name,
+	.create = bench_source_create,
+	.destroy = bench_source_destroy,
+};
+
+struct biquad {
+	float b0, b1, b2, a1, a2;
+	float z1[MAX_AUDIO_CHANNELS];
+	float z2[MAX_AUDIO_CHANNELS];
+};
+
+struct plugin_filter {
+	obs_source_t *context;
+	DARRAY(struct biquad) stages;
+};
+
+static const char *plugin_filter_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "Benchmark plugin filter";
+}
+
+/* a gentle low pass at 18 kHz, so the output stays close to the input */
+static void init_biquad(struct biquad *bq, double sample_rate)
+{
+	double w0 = 2.0 * M_PI * 18000.0 / sample_rate;
+	double alpha = sin(w0) / (2.0 * 0.707);
+	double a0 = 1.0 + alpha;
+	double cw = cos(w0);
+
+	memset(bq, 0, sizeof(*bq));
+	bq->b0 = (float)((1.0 - cw) / 2.0 / a0);
+	bq->b1 = (float)((1.0 - cw) / a0);
+	bq->b2 = bq->b0;
+	bq->a1 = (float)(-2.0 * cw / a0);
+	bq->a2 = (float)((1.0 - alpha) / a0);
+}
+
+static void *plugin_filter_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct plugin_filter *pf = bzalloc(sizeof(*pf));
+	size_t passes = (size_t)obs_data_get_int(settings, "passes");
+	double sample_rate = audio_output_get_sample_rate(obs_get_audio());
+
+	pf->context = source;
+	da_resize(pf->stages, passes);
+	for (size_t i = 0; i < passes; i++)
+		init_biquad(&pf->stages.array[i], sample_rate);
+
+	return pf;
+}
+
+static void plugin_filter_destroy(void *data)
+{
+	struct plugin_filter *pf = data;
+
+	da_free(pf->stages);
+	bfree(pf);
+}
+
+static struct obs_audio_data *plugin_filter_audio(void *data,
+						  struct obs_audio_data *audio)
+{
+	struct plugin_filter *pf = data;
+	size_t channels = audio_output_get_channels(obs_get_audio());
+
+	for (size_t s = 0; s < pf->stages.num; s++) {
+		struct biquad *bq = &pf->stages.array[s];
+
+		for (size_t c = 0; c < channels; c++) {
+			float *samples = (float *)audio->data[c];
+			float z1 = bq->z1[c], z2 = bq->z2[c];
+
+			if (!samples)
+				continue;
+
+			for (uint32_t i = 0; i < audio->frames; i++) {
+				float in = samples[i];
+				float out = bq->b0 * in + z1;
+				z1 = bq->b1 * in - bq->a1 * out + z2;
+				z2 = bq->b2 * in - bq->a2 * out;
+				samples[i] = out;
+			}
+
+			bq->z1[c] = z1;
+			bq->z2[c] = z2;
+		}
+	}
+
+	return audio;
+}
+
+static struct obs_source_info plugin_filter_info = {
+	.id = "bench_plugin_filter",
+	.type = OBS_SOURCE_TYPE_FILTER,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name = plugin_filter_name,
+	.create = plugin_filter_create,
+	.destroy = plugin_filter_destroy,
+	.filter_audio = plugin_filter_audio,
+};
+
+/* ------------------------------------------------------------------------- */
+/* Graph                                                                     */
+
+struct filter_kind {
+	const char *name;
+	const char *id;
+	DARRAY(obs_source_t *) filters;
+	struct obs_source_perf_stats start;
+};
+
+struct graph {
+	DARRAY(obs_source_t *) sources;
+	DARRAY(obs_source_t *) scenes;
+	DARRAY(obs_volmeter_t *) volmeters;
+	DARRAY(struct filter_kind) kinds;
+	obs_source_t *root;
+};
+
+static const char *find_filter_id(const char *name)
+{
+	for (size_t i = 0; i < sizeof(filter_ids) / sizeof(*filter_ids); i++) {
+		if (strcmp(filter_ids[i][0], name) == 0)
+			return filter_ids[i][1];
+	}
+
+	return name;
+}
+
+static void init_kinds(struct graph *graph, const struct bench_config *cfg)
+{
+	char **names = strlist_split(cfg->filters, ',', false);
+
+	for (char **name = names; *name; name++) {
+		struct filter_kind *kind = da_push_back_new(graph->kinds);
+		kind->name = bstrdup(*name);
+		kind->id = bstrdup(find_filter_id(*name));
+	}
+
+	strlist_free(names);
+}
+
+static void add_filters(struct graph *graph, const struct bench_config *cfg,
+			obs_source_t *source, int index)
+{
+	struct dstr name = {0};
+
+	for (size_t i = 0; i < graph->kinds.num; i++) {
+		struct filter_kind *kind = &graph->kinds.array[i];
+		obs_data_t *settings = obs_data_create();
+		obs_source_t *filter;
+
+		obs_data_set_int(settings, "passes", cfg->plugin_passes);
+
+		dstr_printf(&name, "%s %d", kind->name, index);
+		filter = obs_source_create_private(kind->id, name.array,
+						   settings);
+		obs_data_release(settings);
+
+		if (!filter) {
+			if (index == 0)
+				fprintf(stderr,
+					"Filter '%s' is not available\n",
+					kind->id);
+			continue;
+		}
+
+		obs_source_filter_add(source, filter);
+		da_push_back(kind->filters, &filter);
+	}
+
+	dstr_free(&name);
+}
+
+static void volmeter_updated(void *param,
+			     const float magnitude[MAX_AUDIO_CHANNELS],
+			     const float peak[MAX_AUDIO_CHANNELS],
+			     const float input_peak[MAX_AUDIO_CHANNELS])
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(magnitude);
+	UNUSED_PARAMETER(peak);
+	UNUSED_PARAMETER(input_peak);
+}
+
+/* the sources are spread over the levels of scenes, each level holding the
+ * next one, with the top one as the output source */
+static void build_graph(struct graph *graph, const struct bench_config *cfg)
+{
+	uint32_t mixers = (1 << cfg->tracks) - 1;
+	struct dstr name = {0};
+
+	init_kinds(graph, cfg);
+
+	for (int level = 0; level <= cfg->depth; level++) {
+		obs_scene_t *scene;
+
+		dstr_printf(&name, "scene %d", level);
+		scene = obs_scene_create_private(name.array);
+		obs_source_set_audio_mixers(obs_scene_get_source(scene),
+					    mixers);
+
+		if (level > 0) {
+			obs_source_t *parent =
+				graph->scenes.array[level - 1];
+			obs_scene_add(obs_scene_from_source(parent),
+				      obs_scene_get_source(scene));
+		}
+
+		obs_source_t *source = obs_scene_get_source(scene);
+		da_push_back(graph->scenes, &source);
+	}
+
+	for (int i = 0; i < cfg->sources; i++) {
+		obs_source_t *scene = graph->scenes.array[i % (cfg->depth + 1)];
+		obs_source_t *source;
+
+		dstr_printf(&name, "source %d", i);
+		source = obs_source_create_private(bench_source_info.id,
+						   name.array, NULL);
+		obs_source_set_audio_mixers(source, mixers);
+		add_filters(graph, cfg, source, i);
+		obs_scene_add(obs_scene_from_source(scene), source);
+
+		if (cfg->volmeters) {
+			obs_volmeter_t *vm = obs_volmeter_create(OBS_FADER_LOG);
+			obs_volmeter_attach_source(vm, source);
+			obs_volmeter_add_callback(vm, volmeter_updated, NULL);
+			da_push_back(graph->volmeters, &vm);
+		}
+
+		da_push_back(graph->sources, &source);
+	}
+
+	graph->root = graph->scenes.array[0];
+	obs_set_output_source(0, graph->root);
+	dstr_free(&name);
+}
+
+static void free_graph(struct graph *graph)
+{
+	obs_set_output_source(0, NULL);
+
+	for (size_t i = 0; i < graph->volmeters.num; i++)
+		obs_volmeter_destroy(graph->volmeters.array[i]);
+
+	for (size_t i = 0; i < graph->kinds.num; i++) {
+		struct filter_kind *kind = &graph->kinds.array[i];
+
+		for (size_t j = 0; j < kind->filters.num; j++)
+			obs_source_release(kind->filters.array[j]);
+		da_free(kind->filters);
+		bfree((char *)kind->name);
+		bfree((char *)kind->id);
+	}
+
+	for (size_t i = 0; i < graph->sources.num; i++)
+		obs_source_release(graph->sources.array[i]);
+	for (size_t i = graph->scenes.num; i > 0; i--)
+		obs_source_release(graph->scenes.array[i - 1]);
+
+	da_free(graph->volmeters);
+	da_free(graph->kinds);
+	da_free(graph->sources);
+	da_free(graph->scenes);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Feeding the sources                                                       */
+
+struct feeder {
+	const struct bench_config *cfg;
+	struct graph *graph;
+	pthread_t thread;
+	volatile bool stop;
+	uint32_t sample_rate;
+	float *buffers[MAX_AUDIO_CHANNELS];
+};
+
+/* a tone of its own for each source, low enough for the noise suppression
+ * to treat as speech, with the chunks on the clock the audio thread runs on */
+static void *feeder_thread(void *param)
+{
+	struct feeder *f = param;
+	uint32_t frames = f->sample_rate * f->cfg->chunk_ms / 1000;
+	uint64_t chunk_ns = (uint64_t)f->cfg->chunk_ms * 1000000ULL;
+	uint64_t start = obs_get_clock_ns();
+	uint64_t sample = 0;
+
+	os_set_thread_name("bench-audio: feeder");
+
+	for (uint64_t n = 0; !os_atomic_load_bool(&f->stop); n++) {
+		uint64_t ts = start + n * chunk_ns;
+
+		/* the audio of a chunk is output once all of it is there */
+		obs_sleepto_clock_ns(ts + chunk_ns);
+
+		for (size_t i = 0; i < f->graph->sources.num; i++) {
+			obs_source_t *source = f->graph->sources.array[i];
+			double freq = 110.0 * (1.0 + (double)(i % 12) / 4.0);
+			struct obs_source_audio audio = {
+				.frames = frames,
+				.speakers = SPEAKERS_STEREO,
+				.format = AUDIO_FORMAT_FLOAT_PLANAR,
+				.samples_per_sec = f->sample_rate,
+				.timestamp = ts,
+			};
+
+			for (uint32_t s = 0; s < frames; s++) {
+				double t = (double)(sample + s) /
+					   (double)f->sample_rate;
+				float v = (float)(0.25 *
+						  sin(2.0 * M_PI * freq * t));
+				f->buffers[0][s] = v;
+				f->buffers[1][s] = v * 0.5f;
+			}
+
+			audio.data[0] = (uint8_t *)f->buffers[0];
+			audio.data[1] = (uint8_t *)f->buffers[1];
+			obs_source_output_audio(source, &audio);
+		}
+
+		sample += frames;
+	}
+
+	return NULL;
+}
+
+static bool feeder_start(struct feeder *f, const struct bench_config *cfg,
+			 struct graph *graph)
+{
+	memset(f, 0, sizeof(*f));
+	f->cfg = cfg;
+	f->graph = graph;
+	f->sample_rate = audio_output_get_sample_rate(obs_get_audio());
+
+	for (size_t i = 0; i < 2; i++)
+		f->buffers[i] = bzalloc(sizeof(float) * f->sample_rate *
+					cfg->chunk_ms / 1000);
+
+	return pthread_create(&f->thread, NULL, feeder_thread, f) == 0;
+}
+
+/* the thread may be asleep on the clock, which wakes it when offline
+ * rendering is turned off */
+static void feeder_stop(struct feeder *f)
+{
+	os_atomic_set_bool(&f->stop, true);
+	obs_set_offline_rendering(false);
+	pthread_join(f->thread, NULL);
+
+	for (size_t i = 0; i < 2; i++)
+		bfree(f->buffers[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Measurements                                                              */
+
+struct ticks {
+	DARRAY(uint64_t) durations;
+	uint64_t last_ts;
+	uint32_t max_buffering;
+};
+
+static void collect_ticks(struct ticks *ticks)
+{
+	struct obs_telemetry_sample samples[OBS_TELEMETRY_SAMPLES];
+	size_t count = obs_get_telemetry(OBS_TELEMETRY_AUDIO, samples,
+					 OBS_TELEMETRY_SAMPLES);
+
+	for (size_t i = 0; i < count; i++) {
+		if (samples[i].timestamp <= ticks->last_ts)
+			continue;
+
+		da_push_back(ticks->durations, &samples[i].duration_ns);
+		if (samples[i].queued > ticks->max_buffering)
+			ticks->max_buffering = samples[i].queued;
+		ticks->last_ts = samples[i].timestamp;
+	}
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t va = *(const uint64_t *)a;
+	uint64_t vb = *(const uint64_t *)b;
+	return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+static obs_data_t *tick_results(struct ticks *ticks)
+{
+	obs_data_t *results = obs_data_create();
+	uint64_t *values = ticks->durations.array;
+	size_t count = ticks->durations.num;
+	uint64_t total = 0;
+
+	obs_data_set_int(results, "count", (long long)count);
+	if (!count)
+		return results;
+
+	qsort(values, count, sizeof(*values), cmp_u64);
+	for (size_t i = 0; i < count; i++)
+		total += values[i];
+
+	obs_data_set_double(results, "mean_ms",
+			    (double)total / (double)count / 1000000.0);
+	obs_data_set_double(results, "p50_ms",
+			    (double)values[count / 2] / 1000000.0);
+	obs_data_set_double(results, "p95_ms",
+			    (double)values[count * 95 / 100] / 1000000.0);
+	obs_data_set_double(results, "p99_ms",
+			    (double)values[count * 99 / 100] / 1000000.0);
+	obs_data_set_double(results, "max_ms",
+			    (double)values[count - 1] / 1000000.0);
+	return results;
+}
+
+static void sum_perf(obs_source_t **sources, size_t count,
+		     struct obs_source_perf_stats *total)
+{
+	memset(total, 0, sizeof(*total));
+
+	for (size_t i = 0; i < count; i++) {
+		struct obs_source_perf_stats stats;
+
+		obs_source_get_perf_stats(sources[i], &stats);
+		total->audio_count += stats.audio_count;
+		total->audio_ns += stats.audio_ns;
+	}
+}
+
+static obs_data_t *perf_result(const struct obs_source_perf_stats *start,
+			       const struct obs_source_perf_stats *end,
+			       size_t ticks)
+{
+	obs_data_t *result = obs_data_create();
+	uint64_t count = end->audio_count - start->audio_count;
+	uint64_t ns = end->audio_ns - start->audio_ns;
+
+	obs_data_set_int(result, "calls", (long long)count);
+	obs_data_set_double(result, "total_ms", (double)ns / 1000000.0);
+	if (count)
+		obs_data_set_double(result, "mean_us_per_call",
+				    (double)ns / (double)count / 1000.0);
+	if (ticks)
+		obs_data_set_double(result, "mean_us_per_tick",
+				    (double)ns / (double)ticks / 1000.0);
+	return result;
+}
+
+static obs_data_t *filter_results(struct graph *graph, size_t ticks)
+{
+	obs_data_t *results = obs_data_create();
+
+	for (size_t i = 0; i < graph->kinds.num; i++) {
+		struct filter_kind *kind = &graph->kinds.array[i];
+		struct obs_source_perf_stats end;
+		obs_data_t *result;
+
+		if (!kind->filters.num)
+			continue;
+
+		sum_perf(kind->filters.array, kind->filters.num, &end);
+		result = perf_result(&kind->start, &end, ticks);
+		obs_data_set_string(result, "id", kind->id);
+		obs_data_set_obj(results, kind->name, result);
+		obs_data_release(result);
+	}
+
+	return results;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void receive_mix(void *param, size_t mix_idx, struct audio_data *data)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(mix_idx);
+	UNUSED_PARAMETER(data);
+}
+
+static bool reset_video(const struct bench_config *cfg)
+{
+	struct obs_video_info ovi = {0};
+
+	/* nothing is drawn, the frames only advance the clock */
+	ovi.graphics_module = cfg->renderer;
+	ovi.fps_num = 60;
+	ovi.fps_den = 1;
+	ovi.base_width = 64;
+	ovi.base_height = 64;
+	ovi.output_width = 64;
+	ovi.output_height = 64;
+	ovi.output_format = VIDEO_FORMAT_NV12;
+	ovi.colorspace = VIDEO_CS_709;
+	ovi.range = VIDEO_RANGE_PARTIAL;
+	ovi.scale_type = OBS_SCALE_BICUBIC;
+	ovi.gpu_conversion = true;
+
+	return obs_reset_video(&ovi) == OBS_VIDEO_SUCCESS;
+}
+
+static obs_data_t *config_results(const struct bench_config *cfg)
+{
+	obs_data_t *config = obs_data_create();
+
+	obs_data_set_int(config, "sources", cfg->sources);
+	obs_data_set_string(config, "filters", cfg->filters);
+	obs_data_set_int(config, "plugin_passes", cfg->plugin_passes);
+	obs_data_set_int(config, "tracks", cfg->tracks);
+	obs_data_set_int(config, "depth", cfg->depth);
+	obs_data_set_int(config, "chunk_ms", cfg->chunk_ms);
+	obs_data_set_int(config, "seconds", cfg->seconds);
+	obs_data_set_bool(config, "volmeters", cfg->volmeters);
+	return config;
+}
+
+#define WARMUP_NS 1000000000ULL
+#define COLLECT_INTERVAL_NS 1000000000ULL
+
+static bool run(const struct bench_config *cfg, obs_data_t *results)
+{
+	struct obs_audio_info oai = {48000, SPEAKERS_STEREO};
+	struct obs_source_perf_stats sources_start, sources_end;
+	struct obs_source_perf_stats scenes_start, scenes_end;
+	struct graph graph = {0};
+	struct ticks ticks = {0};
+	struct feeder feeder;
+	obs_data_t *stages;
+	uint64_t start, wall_start, end;
+	bool offline = false;
+
+	if (!obs_startup("en-US", NULL, NULL))
+		return false;
+	if (!obs_reset_audio(&oai)) {
+		fprintf(stderr, "obs_reset_audio failed\n");
+		return false;
+	}
+
+	if (!cfg->realtime) {
+		offline = reset_video(cfg) && obs_set_offline_rendering(true);
+		if (!offline)
+			fprintf(stderr, "Graphics are not available, mixing "
+					"in real time\n");
+	}
+
+	obs_load_all_modules();
+	obs_post_load_modules();
+	obs_register_source(&bench_source_info);
+	obs_register_source(&plugin_filter_info);
+
+	build_graph(&graph, cfg);
+
+	for (int i = 0; i < cfg->tracks; i++)
+		audio_output_connect(obs_get_audio(), i, NULL, receive_mix,
+				     NULL);
+
+	if (!feeder_start(&feeder, cfg, &graph)) {
+		free_graph(&graph);
+		return false;
+	}
+
+	/* the main thread waits on the same clock, so it runs in step with
+	 * the audio thread when offline */
+	start = obs_get_clock_ns() + WARMUP_NS;
+	end = start + (uint64_t)cfg->seconds * 1000000000ULL;
+	obs_sleepto_clock_ns(start);
+
+	collect_ticks(&ticks);
+	da_resize(ticks.durations, 0);
+	ticks.max_buffering = 0;
+
+	for (size_t i = 0; i < graph.kinds.num; i++) {
+		struct filter_kind *kind = &graph.kinds.array[i];
+		sum_perf(kind->filters.array, kind->filters.num, &kind->start);
+	}
+	sum_perf(graph.sources.array, graph.sources.num, &sources_start);
+	sum_perf(graph.scenes.array, graph.scenes.num, &scenes_start);
+	wall_start = os_gettime_ns();
+
+	for (uint64_t t = start + COLLECT_INTERVAL_NS; t <= end;
+	     t += COLLECT_INTERVAL_NS) {
+		obs_sleepto_clock_ns(t);
+		collect_ticks(&ticks);
+	}
+
+	obs_data_set_double(results, "wall_ms",
+			    (double)(os_gettime_ns() - wall_start) /
+				    1000000.0);
+	obs_data_set_string(results, "clock", offline ? "offline" : "realtime");
+
+	sum_perf(graph.sources.array, graph.sources.num, &sources_end);
+	sum_perf(graph.scenes.array, graph.scenes.num, &scenes_end);
+
+	stages = tick_results(&ticks);
+	obs_data_set_obj(results, "ticks", stages);
+	obs_data_release(stages);
+
+	stages = filter_results(&graph, ticks.durations.num);
+	obs_data_set_obj(results, "filters", stages);
+	obs_data_release(stages);
+
+	stages = perf_result(&sources_start, &sources_end,
+			     ticks.durations.num);
+	obs_data_set_obj(results, "sources", stages);
+	obs_data_release(stages);
+
+	stages = perf_result(&scenes_start, &scenes_end, ticks.durations.num);
+	obs_data_set_obj(results, "scenes", stages);
+	obs_data_release(stages);
+
+	stages = obs_data_create();
+	obs_data_set_double(stages, "ms",
+			    (double)obs_get_audio_buffering_ns() / 1000000.0);
+	obs_data_set_int(stages, "max_ticks", ticks.max_buffering);
+	obs_data_set_obj(results, "buffering", stages);
+	obs_data_release(stages);
+
+	feeder_stop(&feeder);
+
+	for (int i = 0; i < cfg->tracks; i++)
+		audio_output_disconnect(obs_get_audio(), i, receive_mix, NULL);
+
+	free_graph(&graph);
+	da_free(ticks.durations);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_config cfg = {
+		.renderer = DL_OPENGL,
+		.sources = 16,
+		.filters = "gain,compressor,noise,plugin",
+		.plugin_passes = 8,
+		.tracks = 2,
+		.depth = 2,
+		.chunk_ms = 10,
+		.seconds = 30,
+		.volmeters = true,
+	};
+	obs_data_t *results;
+	obs_data_t *config;
+	bool success;
+
+#ifdef _WIN32
+	cfg.renderer = DL_D3D11;
+#endif
+
+	if (!parse_args(&cfg, argc, argv)) {
+		fprintf(stderr, "%s", usage);
+		return 1;
+	}
+
+	results = obs_data_create();
+	config = config_results(&cfg);
+	obs_data_set_string(results, "version", obs_get_version_string());
+	obs_data_set_obj(results, "config", config);
+	obs_data_release(config);
+
+	success = run(&cfg, results);
+	obs_shutdown();
+
+	if (success) {
+		if (cfg.output)
+			success = obs_data_save_json(results, cfg.output);
+		else
+			printf("%s\n", obs_data_get_json(results));
+	}
+
+	obs_data_release(results);
+	return success ? 0 : 1;
+}
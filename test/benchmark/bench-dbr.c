@@ -0,0 +1,305 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/circlebuf.h>
+#include <bitrate-control.h>
+#include <net-emulator.h>
+
+/*
+ * Runs the dynamic bitrate estimators against emulated networks in simulated
+ * time: an encoder produces frames at the bitrate the estimator picks, the
+ * output queues them and sends them over the emulated link, and frames are
+ * dropped the way the RTMP output drops them once the queue falls behind.
+ * The same profile always gives the same results, in well under a second.
+ *
+ * Usage: bench-dbr [--estimator NAME] [--kbps N] [--seconds N]
+ *                  [--profile PROFILE]...
+ * without any --profile a set of built in ones is run.  See net-emulator.h
+ * for the profile syntax.
+ */
+
+#define MSEC_NS 1000000ULL
+#define SEC_NS 1000000000ULL
+
+#define FPS 60
+#define KEYFRAME_INTERVAL (FPS * 2)
+#define AUDIO_KBPS 160
+#define DROP_THRESHOLD_NS (700 * MSEC_NS)
+#define DBR_INTERVAL_NS (50 * MSEC_NS)
+
+static const char *builtin_profiles[][2] = {
+	{"steady", "kbps=8000,rtt_ms=40"},
+	{"capacity drop",
+	 "kbps=8000,rtt_ms=40;at=20,kbps=2500;at=60,kbps=8000"},
+	{"lossy", "kbps=6000,rtt_ms=80,jitter_ms=20,loss=1"},
+	{"stalls",
+	 "kbps=8000,rtt_ms=40;at=15,stall_ms=2000;at=45,stall_ms=4000"},
+	{"slow", "kbps=3000,rtt_ms=150,jitter_ms=40,loss=0.5"},
+};
+
+struct frame {
+	uint64_t ts;
+	size_t size;
+	bool keyframe;
+};
+
+struct results {
+	int frames;
+	int dropped;
+	uint64_t total_latency_ns;
+	uint64_t max_latency_ns;
+	int sent;
+
+	double bitrate_sum;
+	double bitrate_sq_sum;
+	long min_bitrate;
+	int changes;
+};
+
+struct sim {
+	struct net_emulator ne;
+	struct bitrate_control bc;
+	struct circlebuf queue;
+	uint64_t sender_ready_ts;
+	long bitrate;
+	struct results r;
+};
+
+/* the estimators log every change, only warnings are of interest here */
+static void log_handler(int lvl, const char *format, va_list args, void *param)
+{
+	if (lvl <= LOG_WARNING) {
+		vfprintf(stderr, format, args);
+		fputc('\n', stderr);
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+static size_t frame_size(long kbps, bool keyframe)
+{
+	/* keyframes are four times the size of the other frames, with the
+	 * average staying at the bitrate */
+	double bytes_per_frame = (double)kbps * 1000.0 / 8.0 / FPS;
+	double unit = bytes_per_frame * KEYFRAME_INTERVAL /
+		      (KEYFRAME_INTERVAL + 3);
+	double audio = AUDIO_KBPS * 1000.0 / 8.0 / FPS;
+
+	return (size_t)((keyframe ? unit * 4.0 : unit) + audio);
+}
+
+static void send_frame(struct sim *sim, uint64_t t)
+{
+	struct frame f;
+	uint64_t wait, delivered;
+
+	circlebuf_pop_front(&sim->queue, &f, sizeof(f));
+
+	wait = net_emulator_send(&sim->ne, f.size, t);
+	bitrate_control_add_send(&sim->bc, f.size, t, t + wait);
+	sim->sender_ready_ts = t + wait;
+
+	/* the link only has to carry it to the peer, half a round trip */
+	delivered = sim->ne.link_free_ts + sim->ne.jitter_ns +
+		    sim->ne.steps.array[sim->ne.cur_step].rtt_ms * MSEC_NS / 2;
+
+	sim->r.sent++;
+	sim->r.total_latency_ns += delivered - f.ts;
+	if (delivered - f.ts > sim->r.max_latency_ns)
+		sim->r.max_latency_ns = delivered - f.ts;
+}
+
+/* sends whatever the sender gets to before t */
+static void drain(struct sim *sim, uint64_t t)
+{
+	while (sim->queue.size) {
+		struct frame *front = circlebuf_data(&sim->queue, 0);
+		uint64_t start = sim->sender_ready_ts > front->ts
+					 ? sim->sender_ready_ts
+					 : front->ts;
+		if (start > t)
+			break;
+
+		send_frame(sim, start);
+	}
+}
+
+static uint64_t queue_duration(struct sim *sim)
+{
+	struct frame *front, *back;
+
+	if (!sim->queue.size)
+		return 0;
+
+	front = circlebuf_data(&sim->queue, 0);
+	back = circlebuf_data(&sim->queue, sim->queue.size - sizeof(*back));
+	return back->ts - front->ts;
+}
+
+/* like the RTMP output, drops every queued frame that isn't a keyframe */
+static void check_drops(struct sim *sim)
+{
+	struct circlebuf kept = {0};
+
+	if (queue_duration(sim) <= DROP_THRESHOLD_NS)
+		return;
+
+	while (sim->queue.size) {
+		struct frame f;
+
+		circlebuf_pop_front(&sim->queue, &f, sizeof(f));
+		if (f.keyframe)
+			circlebuf_push_back(&kept, &f, sizeof(f));
+		else
+			sim->r.dropped++;
+	}
+
+	circlebuf_free(&sim->queue);
+	sim->queue = kept;
+}
+
+static void update_bitrate(struct sim *sim, uint64_t t)
+{
+	struct bitrate_signals signals;
+
+	bitrate_signals_init(&signals);
+	signals.queue_usec = (int64_t)(queue_duration(sim) / 1000);
+	net_emulator_get_signals(&sim->ne, t, &signals);
+
+	if (bitrate_control_update_at(&sim->bc, &signals, t)) {
+		sim->bitrate = bitrate_control_get_bitrate(&sim->bc);
+		sim->r.changes++;
+	}
+}
+
+static bool run(const char *name, const char *profile, const char *estimator,
+		long kbps, int seconds)
+{
+	struct sim sim = {0};
+	uint64_t frame_ns = SEC_NS / FPS;
+	uint64_t next_dbr_ts = 0;
+	int frames = seconds * FPS;
+	double mean, stddev;
+
+	if (!net_emulator_init(&sim.ne, profile)) {
+		fprintf(stderr, "invalid profile: %s\n", profile);
+		return false;
+	}
+	if (!bitrate_control_init(&sim.bc)) {
+		net_emulator_free(&sim.ne);
+		return false;
+	}
+
+	/* the clock starts a second in, the estimators treat 0 as unset */
+	net_emulator_start(&sim.ne, SEC_NS);
+	bitrate_control_start(&sim.bc, estimator, kbps, AUDIO_KBPS);
+	sim.bitrate = kbps;
+	sim.r.min_bitrate = kbps;
+
+	for (int i = 0; i < frames; i++) {
+		uint64_t t = SEC_NS + (uint64_t)i * frame_ns;
+		struct frame f = {t, 0, i % KEYFRAME_INTERVAL == 0};
+
+		drain(&sim, t);
+
+		f.size = frame_size(sim.bitrate, f.keyframe);
+		circlebuf_push_back(&sim.queue, &f, sizeof(f));
+		sim.r.frames++;
+
+		check_drops(&sim);
+
+		if (t >= next_dbr_ts) {
+			update_bitrate(&sim, t);
+			next_dbr_ts = t + DBR_INTERVAL_NS;
+		}
+
+		sim.r.bitrate_sum += (double)sim.bitrate;
+		sim.r.bitrate_sq_sum += (double)sim.bitrate * sim.bitrate;
+		if (sim.bitrate < sim.r.min_bitrate)
+			sim.r.min_bitrate = sim.bitrate;
+	}
+
+	mean = sim.r.bitrate_sum / sim.r.frames;
+	stddev = sqrt(fmax(sim.r.bitrate_sq_sum / sim.r.frames - mean * mean,
+			   0.0));
+
+	printf("%-16s %7.2f%% %9.1f %9.1f %8.0f %8.0f %7ld %7d\n", name,
+	       100.0 * sim.r.dropped / sim.r.frames,
+	       sim.r.sent ? (double)sim.r.total_latency_ns / sim.r.sent /
+				    (double)MSEC_NS
+			  : 0.0,
+	       (double)sim.r.max_latency_ns / (double)MSEC_NS, mean, stddev,
+	       sim.r.min_bitrate, sim.r.changes);
+
+	circlebuf_free(&sim.queue);
+	bitrate_control_free(&sim.bc);
+	net_emulator_free(&sim.ne);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *estimator = "delay";
+	long kbps = 6000;
+	int seconds = 90;
+	const char **profiles = NULL;
+	int num_profiles = 0;
+	int ret = 0;
+
+	base_set_log_handler(log_handler, NULL);
+
+	for (int i = 1; i < argc; i++) {
+		bool has_value = i + 1 < argc;
+
+		if (has_value && strcmp(argv[i], "--estimator") == 0) {
+			estimator = argv[++i];
+		} else if (has_value && strcmp(argv[i], "--kbps") == 0) {
+			kbps = strtol(argv[++i], NULL, 10);
+		} else if (has_value && strcmp(argv[i], "--seconds") == 0) {
+			seconds = atoi(argv[++i]);
+		} else if (has_value && strcmp(argv[i], "--profile") == 0) {
+			size_t size = sizeof(*profiles) * (num_profiles + 1);
+			profiles = brealloc(profiles, size);
+			profiles[num_profiles++] = argv[++i];
+		} else {
+			fprintf(stderr, "unknown option '%s'\n", argv[i]);
+			bfree(profiles);
+			return 1;
+		}
+	}
+
+	if (kbps <= 0 || seconds <= 0) {
+		fprintf(stderr, "kbps and seconds must be positive\n");
+		bfree(profiles);
+		return 1;
+	}
+
+	printf("estimator %s, %ld kbps, %d seconds\n", estimator, kbps,
+	       seconds);
+	printf("%-16s %8s %9s %9s %8s %8s %7s %7s\n", "profile", "dropped",
+	       "avg ms", "max ms", "kbps", "stddev", "min", "changes");
+
+	if (num_profiles) {
+		for (int i = 0; i < num_profiles; i++) {
+			char name[32];
+			snprintf(name, sizeof(name), "profile %d", i + 1);
+			if (!run(name, profiles[i], estimator, kbps, seconds))
+				ret = 1;
+		}
+	} else {
+		size_t count =
+			sizeof(builtin_profiles) / sizeof(*builtin_profiles);
+		for (size_t i = 0; i < count; i++) {
+			if (!run(builtin_profiles[i][0], builtin_profiles[i][1],
+				 estimator, kbps, seconds))
+				ret = 1;
+		}
+	}
+
+	bfree(profiles);
+	return ret;
+}
@@ -0,0 +1,1132 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <media-io/video-frame.h>
+#include <obs.h>
+
+#ifdef HAVE_AVCODEC
+#include <libavcodec/avcodec.h>
+#endif
+
+/*
+ * Encoder benchmark for qualifying hardware: feeds synthetic frames, or raw
+ * frames looped from a file, through each requested encoder and reports its
+ * throughput, the latency from submitting each frame to receiving its packet
+ * and the CPU usage of the process.  When built with libavcodec the packets
+ * are decoded afterwards and compared to the source frames for PSNR and SSIM.
+ * Results are written as JSON.
+ *
+ * Frames are submitted in real time on a video output of their own, the way
+ * the video thread submits them, so an encoder that can't keep up has frames
+ * repeated.  Raising --fps until frames are repeated finds its ceiling.
+ */
+
+static const char *usage =
+	"usage: bench-encoder [options]\n"
+	"  --encoder ID[,key=value...]  encoder and settings to run, can be\n"
+	"                           repeated (default every video encoder,\n"
+	"                           x264 at several presets)\n"
+	"  --width N --height N     frame size (default 1920x1080)\n"
+	"  --fps N                  frame rate (default 60)\n"
+	"  --frames N               frames to submit (default 600)\n"
+	"  --bitrate N              bitrate in kbps (default 6000)\n"
+	"  --format nv12|i420       format of the frames (default nv12)\n"
+	"  --input FILE             raw frames of that format and size to\n"
+	"                           loop over instead of synthetic ones\n"
+	"  --quality-interval N     compare every Nth frame to its source,\n"
+	"                           0 to skip (default 10)\n"
+	"  --renderer opengl|d3d11  graphics backend, for encoders that need\n"
+	"                           one\n"
+	"  --output FILE            write results to FILE instead of stdout\n";
+
+static const char *x264_presets[] = {"ultrafast", "veryfast", "fast",
+				     "medium"};
+
+struct bench_config {
+	const char *renderer;
+	uint32_t width;
+	uint32_t height;
+	uint32_t fps;
+	int frames;
+	int bitrate;
+	enum video_format format;
+	const char *input;
+	int quality_interval;
+	const char *output;
+	DARRAY(char *) encoders;
+};
+
+static bool parse_args(struct bench_config *cfg, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (!val)
+			return false;
+
+		if (strcmp(arg, "--encoder") == 0) {
+			char *spec = bstrdup(val);
+			da_push_back(cfg->encoders, &spec);
+		} else if (strcmp(arg, "--width") == 0) {
+			cfg->width = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--height") == 0) {
+			cfg->height = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--fps") == 0) {
+			cfg->fps = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--frames") == 0) {
+			cfg->frames = atoi(val);
+		} else if (strcmp(arg, "--bitrate") == 0) {
+			cfg->bitrate = atoi(val);
+		} else if (strcmp(arg, "--format") == 0) {
+			if (strcmp(val, "nv12") == 0)
+				cfg->format = VIDEO_FORMAT_NV12;
+			else if (strcmp(val, "i420") == 0)
+				cfg->format = VIDEO_FORMAT_I420;
+			else
+				return false;
+		} else if (strcmp(arg, "--input") == 0) {
+			cfg->input = val;
+		} else if (strcmp(arg, "--quality-interval") == 0) {
+			cfg->quality_interval = atoi(val);
+		} else if (strcmp(arg, "--renderer") == 0) {
+			if (strcmp(val, "opengl") == 0)
+				cfg->renderer = DL_OPENGL;
+#ifdef _WIN32
+			else if (strcmp(val, "d3d11") == 0)
+				cfg->renderer = DL_D3D11;
+#endif
+			else
+				return false;
+		} else if (strcmp(arg, "--output") == 0) {
+			cfg->output = val;
+		} else {
+			return false;
+		}
+
+		i++;
+	}
+
+	/* the chroma planes are half the size in both directions */
+	return cfg->width && cfg->height && (cfg->width % 2) == 0 &&
+	       (cfg->height % 2) == 0 && cfg->fps && cfg->frames > 0 &&
+	       cfg->bitrate > 0 && cfg->quality_interval >= 0;
+}
+
+/* adds every video encoder that isn't deprecated or internal, and x264 once
+ * for each of a range of presets */
+static void add_default_encoders(struct bench_config *cfg)
+{
+	const char *id;
+
+	for (size_t i = 0; obs_enum_encoder_types(i, &id); i++) {
+		uint32_t caps = obs_get_encoder_caps(id);
+
+		if (obs_get_encoder_type(id) != OBS_ENCODER_VIDEO)
+			continue;
+		if (caps & (OBS_ENCODER_CAP_DEPRECATED |
+			    OBS_ENCODER_CAP_INTERNAL))
+			continue;
+
+		if (strcmp(id, "obs_x264") == 0) {
+			for (size_t j = 0; j < sizeof(x264_presets) /
+						       sizeof(*x264_presets);
+			     j++) {
+				struct dstr spec = {0};
+				dstr_printf(&spec, "%s,preset=%s", id,
+					    x264_presets[j]);
+				da_push_back(cfg->encoders, &spec.array);
+			}
+		} else {
+			char *spec = bstrdup(id);
+			da_push_back(cfg->encoders, &spec);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* Source frames                                                             */
+
+struct frame_source {
+	const struct bench_config *cfg;
+	FILE *file;
+	uint64_t file_frames;
+	size_t frame_size;
+	uint8_t *buffer;
+
+	/* luma detail twice the width of the frame, scrolled through it */
+	uint8_t *pattern;
+};
+
+static inline uint32_t hash(uint32_t x, uint32_t y)
+{
+	uint32_t h = x * 73856093u ^ y * 19349663u;
+	h ^= h >> 15;
+	h *= 2654435761u;
+	return h ^ (h >> 13);
+}
+
+static void make_pattern(struct frame_source *src)
+{
+	uint32_t width = src->cfg->width * 2;
+	uint32_t height = src->cfg->height;
+
+	src->pattern = bmalloc((size_t)width * height);
+
+	/* coarse shapes with finer noise over them, about as hard to encode
+	 * as detailed game footage */
+	for (uint32_t y = 0; y < height; y++) {
+		uint8_t *row = src->pattern + (size_t)y * width;
+
+		for (uint32_t x = 0; x < width; x++) {
+			uint32_t coarse = hash(x >> 5, y >> 5) & 0xFF;
+			uint32_t fine = hash(x, y) & 0x3F;
+			row[x] = (uint8_t)(16 + coarse * 3 / 4 + fine / 2);
+		}
+	}
+}
+
+static bool frame_source_init(struct frame_source *src,
+			      const struct bench_config *cfg)
+{
+	memset(src, 0, sizeof(*src));
+	src->cfg = cfg;
+	src->frame_size = (size_t)cfg->width * cfg->height * 3 / 2;
+
+	if (!cfg->input) {
+		make_pattern(src);
+		return true;
+	}
+
+	src->file = os_fopen(cfg->input, "rb");
+	if (!src->file) {
+		fprintf(stderr, "Failed to open '%s'\n", cfg->input);
+		return false;
+	}
+
+	src->file_frames = (uint64_t)os_fgetsize(src->file) / src->frame_size;
+	if (!src->file_frames) {
+		fprintf(stderr, "'%s' does not hold a whole frame\n",
+			cfg->input);
+		fclose(src->file);
+		return false;
+	}
+
+	src->buffer = bmalloc(src->frame_size);
+	return true;
+}
+
+static void frame_source_free(struct frame_source *src)
+{
+	if (src->file)
+		fclose(src->file);
+	bfree(src->buffer);
+	bfree(src->pattern);
+}
+
+static inline uint32_t plane_count(enum video_format format)
+{
+	return format == VIDEO_FORMAT_NV12 ? 2 : 3;
+}
+
+static void plane_size(const struct bench_config *cfg, uint32_t plane,
+		       uint32_t *width, uint32_t *height)
+{
+	if (plane == 0) {
+		*width = cfg->width;
+		*height = cfg->height;
+	} else {
+		*width = cfg->format == VIDEO_FORMAT_NV12 ? cfg->width
+							  : cfg->width / 2;
+		*height = cfg->height / 2;
+	}
+}
+
+static bool read_frame(struct frame_source *src, uint64_t index,
+		       uint8_t *data[], const uint32_t linesize[])
+{
+	const struct bench_config *cfg = src->cfg;
+	int64_t offset = (int64_t)((index % src->file_frames) *
+				   src->frame_size);
+	const uint8_t *in = src->buffer;
+
+	if (os_fseeki64(src->file, offset, SEEK_SET) != 0 ||
+	    fread(src->buffer, 1, src->frame_size, src->file) !=
+		    src->frame_size)
+		return false;
+
+	for (uint32_t plane = 0; plane < plane_count(cfg->format); plane++) {
+		uint32_t width, height;
+
+		plane_size(cfg, plane, &width, &height);
+		for (uint32_t y = 0; y < height; y++) {
+			memcpy(data[plane] + (size_t)y * linesize[plane], in,
+			       width);
+			in += width;
+		}
+	}
+
+	return true;
+}
+
+/* the pattern scrolls left under a box of inverted pattern moving the other
+ * way, with the chroma drifting, so no two frames are alike */
+static void make_frame(struct frame_source *src, uint64_t index,
+		       uint8_t *data[], const uint32_t linesize[])
+{
+	const struct bench_config *cfg = src->cfg;
+	uint32_t width = cfg->width;
+	uint32_t height = cfg->height;
+	uint32_t shift = (uint32_t)(index * 3 % width);
+	uint32_t box = height / 4;
+	uint32_t box_x = (uint32_t)(index * 5 % (width - box));
+	uint32_t box_y = (uint32_t)(index * 2 % (height - box));
+	uint32_t drift = (uint32_t)index;
+
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *pattern =
+			src->pattern + (size_t)y * width * 2 + shift;
+		uint8_t *row = data[0] + (size_t)y * linesize[0];
+
+		memcpy(row, pattern, width);
+
+		if (y >= box_y && y < box_y + box) {
+			for (uint32_t x = box_x; x < box_x + box; x++)
+				row[x] = (uint8_t)(255 - row[x]);
+		}
+	}
+
+	for (uint32_t y = 0; y < height / 2; y++) {
+		for (uint32_t x = 0; x < width / 2; x++) {
+			uint8_t u = (uint8_t)(96 + (((x + drift) >> 3) & 63));
+			uint8_t v = (uint8_t)(96 + (((y + drift) >> 3) & 63));
+
+			if (cfg->format == VIDEO_FORMAT_NV12) {
+				uint8_t *uv = data[1] +
+					      (size_t)y * linesize[1] + x * 2;
+				uv[0] = u;
+				uv[1] = v;
+			} else {
+				data[1][(size_t)y * linesize[1] + x] = u;
+				data[2][(size_t)y * linesize[2] + x] = v;
+			}
+		}
+	}
+}
+
+static bool get_frame(struct frame_source *src, uint64_t index,
+		      uint8_t *data[], const uint32_t linesize[])
+{
+	if (src->file)
+		return read_frame(src, index, data, linesize);
+
+	make_frame(src, index, data, linesize);
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Encoding                                                                  */
+
+struct stored_packet {
+	uint8_t *data;
+	size_t size;
+	int64_t pts;
+	int64_t dts;
+	bool keyframe;
+};
+
+struct encoder_run {
+	const struct bench_config *cfg;
+	struct frame_source *src;
+	video_t *video;
+	obs_encoder_t *encoder;
+	obs_output_t *output;
+
+	/* when each frame was submitted, by frame */
+	uint64_t *submit_ts;
+
+	pthread_mutex_t mutex;
+	DARRAY(uint64_t) latencies;
+	DARRAY(struct stored_packet) packets;
+	bool store_packets;
+	uint64_t bytes;
+	uint64_t last_packet_ts;
+};
+
+static const char *bench_output_name(void *type_data)
+{
+	UNUSED_PARAMETER(type_data);
+	return "Encoder benchmark output";
+}
+
+static void *bench_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	UNUSED_PARAMETER(settings);
+	return obs_output_get_type_data(output);
+}
+
+static void bench_output_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+static bool bench_output_start(void *data)
+{
+	struct encoder_run *run = data;
+
+	if (!obs_output_can_begin_data_capture(run->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(run->output, 0))
+		return false;
+
+	return obs_output_begin_data_capture(run->output, 0);
+}
+
+static void bench_output_stop(void *data, uint64_t ts)
+{
+	struct encoder_run *run = data;
+
+	obs_output_end_data_capture(run->output);
+	UNUSED_PARAMETER(ts);
+}
+
+static void bench_output_packet(void *data, struct encoder_packet *packet)
+{
+	struct encoder_run *run = data;
+	uint64_t now = os_gettime_ns();
+	int64_t frame = packet->timebase_num
+				? packet->pts / packet->timebase_num
+				: -1;
+
+	pthread_mutex_lock(&run->mutex);
+
+	if (frame >= 0 && frame < run->cfg->frames && run->submit_ts[frame]) {
+		uint64_t latency = now - run->submit_ts[frame];
+		da_push_back(run->latencies, &latency);
+	}
+
+	if (run->store_packets) {
+		/* decoders read a little past the end of the data */
+		struct stored_packet stored = {
+			.data = bzalloc(packet->size + 64),
+			.size = packet->size,
+			.pts = packet->pts,
+			.dts = packet->dts,
+			.keyframe = packet->keyframe,
+		};
+
+		memcpy(stored.data, packet->data, packet->size);
+		da_push_back(run->packets, &stored);
+	}
+
+	run->bytes += packet->size;
+	run->last_packet_ts = now;
+
+	pthread_mutex_unlock(&run->mutex);
+}
+
+static struct obs_output_info bench_output_info = {
+	.id = "bench_encoder_output",
+	.flags = OBS_OUTPUT_VIDEO | OBS_OUTPUT_ENCODED,
+	.get_name = bench_output_name,
+	.create = bench_output_create,
+	.destroy = bench_output_destroy,
+	.start = bench_output_start,
+	.stop = bench_output_stop,
+	.encoded_packet = bench_output_packet,
+};
+
+/* sets a value of the encoder's settings, typed after its default */
+static void set_value(obs_data_t *settings, obs_data_t *defaults,
+		      const char *name, const char *value)
+{
+	obs_data_item_t *item = obs_data_item_byname(defaults, name);
+	enum obs_data_type type = item ? obs_data_item_gettype(item)
+				       : OBS_DATA_STRING;
+
+	if (type == OBS_DATA_NUMBER &&
+	    obs_data_item_numtype(item) == OBS_DATA_NUM_DOUBLE)
+		obs_data_set_double(settings, name, strtod(value, NULL));
+	else if (type == OBS_DATA_NUMBER)
+		obs_data_set_int(settings, name, strtoll(value, NULL, 10));
+	else if (type == OBS_DATA_BOOLEAN)
+		obs_data_set_bool(settings, name,
+				  strcmp(value, "true") == 0 ||
+					  strcmp(value, "1") == 0);
+	else
+		obs_data_set_string(settings, name, value);
+
+	obs_data_item_release(&item);
+}
+
+static inline bool has_setting(obs_data_t *defaults, const char *name)
+{
+	obs_data_item_t *item = obs_data_item_byname(defaults, name);
+	bool found = item != NULL;
+
+	obs_data_item_release(&item);
+	return found;
+}
+
+/* constant bitrate with a keyframe every two seconds unless the spec says
+ * otherwise, where the encoder has those settings */
+static obs_data_t *create_settings(const struct bench_config *cfg,
+				   const char *id, char **values)
+{
+	obs_data_t *defaults = obs_encoder_defaults(id);
+	obs_data_t *settings = obs_data_create();
+
+	if (has_setting(defaults, "bitrate"))
+		obs_data_set_int(settings, "bitrate", cfg->bitrate);
+	if (has_setting(defaults, "keyint_sec"))
+		obs_data_set_int(settings, "keyint_sec", 2);
+	if (has_setting(defaults, "rate_control"))
+		obs_data_set_string(settings, "rate_control", "CBR");
+
+	for (char **value = values; *value; value++) {
+		char *eq = strchr(*value, '=');
+		if (!eq) {
+			fprintf(stderr, "Ignoring setting '%s'\n", *value);
+			continue;
+		}
+
+		*eq = 0;
+		set_value(settings, defaults, *value, eq + 1);
+		*eq = '=';
+	}
+
+	obs_data_release(defaults);
+	return settings;
+}
+
+static void submit_frames(struct encoder_run *run)
+{
+	const struct bench_config *cfg = run->cfg;
+	uint64_t frame_ns = 1000000000ULL / cfg->fps;
+	uint64_t start = os_gettime_ns();
+
+	for (int i = 0; i < cfg->frames; i++) {
+		uint64_t ts = start + (uint64_t)i * frame_ns;
+		struct video_frame frame;
+
+		os_sleepto_ns(ts);
+
+		/* when the frame cache is full the last frame is repeated,
+		 * which is counted as a skipped frame */
+		if (video_output_lock_frame(run->video, &frame, 1, ts)) {
+			if (!get_frame(run->src, i, frame.data,
+				       frame.linesize))
+				fprintf(stderr, "Failed to read frame %d\n",
+					i);
+			run->submit_ts[i] = os_gettime_ns();
+			video_output_unlock_frame(run->video);
+		} else {
+			run->submit_ts[i] = os_gettime_ns();
+		}
+	}
+}
+
+#define TAIL_TIMEOUT_NS 500000000ULL
+#define STOP_TIMEOUT_MS 10000
+
+/* waits for the encoder to go quiet after the last frame, so the frames it
+ * holds on to for lookahead are received as well */
+static void wait_for_packets(struct encoder_run *run)
+{
+	uint64_t start = os_gettime_ns();
+
+	for (;;) {
+		uint64_t now = os_gettime_ns();
+		uint64_t last;
+
+		pthread_mutex_lock(&run->mutex);
+		last = run->last_packet_ts;
+		pthread_mutex_unlock(&run->mutex);
+
+		if (now - (last > start ? last : start) > TAIL_TIMEOUT_NS)
+			break;
+
+		os_sleep_ms(20);
+	}
+}
+
+static void stop_output(struct encoder_run *run)
+{
+	obs_output_stop(run->output);
+
+	for (int waited = 0;
+	     obs_output_active(run->output) && waited < STOP_TIMEOUT_MS;
+	     waited += 10)
+		os_sleep_ms(10);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t va = *(const uint64_t *)a;
+	uint64_t vb = *(const uint64_t *)b;
+	return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+static obs_data_t *latency_results(struct encoder_run *run)
+{
+	obs_data_t *results = obs_data_create();
+	uint64_t *values = run->latencies.array;
+	size_t count = run->latencies.num;
+	uint64_t total = 0;
+
+	if (!count)
+		return results;
+
+	qsort(values, count, sizeof(*values), cmp_u64);
+	for (size_t i = 0; i < count; i++)
+		total += values[i];
+
+	obs_data_set_double(results, "mean_ms",
+			    (double)total / (double)count / 1000000.0);
+	obs_data_set_double(results, "p50_ms",
+			    (double)values[count / 2] / 1000000.0);
+	obs_data_set_double(results, "p95_ms",
+			    (double)values[count * 95 / 100] / 1000000.0);
+	obs_data_set_double(results, "p99_ms",
+			    (double)values[count * 99 / 100] / 1000000.0);
+	obs_data_set_double(results, "max_ms",
+			    (double)values[count - 1] / 1000000.0);
+	return results;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Quality                                                                   */
+
+#ifdef HAVE_AVCODEC
+
+struct quality {
+	uint64_t sse[3];
+	uint64_t samples[3];
+	double ssim_sum;
+	uint64_t ssim_blocks;
+	int frames;
+};
+
+struct planes {
+	const uint8_t *data[3];
+	int linesize[3];
+	bool nv12;
+};
+
+static inline uint8_t chroma_at(const struct planes *p, int c, uint32_t x,
+				uint32_t y)
+{
+	if (p->nv12)
+		return p->data[1][(size_t)y * p->linesize[1] + x * 2 + c];
+	return p->data[1 + c][(size_t)y * p->linesize[1 + c] + x];
+}
+
+#define SSIM_C1 (0.01 * 255 * 0.01 * 255)
+#define SSIM_C2 (0.03 * 255 * 0.03 * 255)
+
+static double block_ssim(const uint8_t *a, int a_linesize, const uint8_t *b,
+			 int b_linesize)
+{
+	double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+	double ma, mb, va, vb, cov;
+
+	for (int y = 0; y < 8; y++) {
+		for (int x = 0; x < 8; x++) {
+			double pa = a[y * a_linesize + x];
+			double pb = b[y * b_linesize + x];
+			sa += pa;
+			sb += pb;
+			saa += pa * pa;
+			sbb += pb * pb;
+			sab += pa * pb;
+		}
+	}
+
+	ma = sa / 64.0;
+	mb = sb / 64.0;
+	va = saa / 64.0 - ma * ma;
+	vb = sbb / 64.0 - mb * mb;
+	cov = sab / 64.0 - ma * mb;
+
+	return ((2.0 * ma * mb + SSIM_C1) * (2.0 * cov + SSIM_C2)) /
+	       ((ma * ma + mb * mb + SSIM_C1) * (va + vb + SSIM_C2));
+}
+
+/* PSNR of all three planes and SSIM of the luma in 8x8 windows */
+static void compare_frame(struct quality *q, const struct bench_config *cfg,
+			  const struct planes *ref, const struct planes *dec)
+{
+	for (uint32_t y = 0; y < cfg->height; y++) {
+		const uint8_t *a = ref->data[0] + (size_t)y * ref->linesize[0];
+		const uint8_t *b = dec->data[0] + (size_t)y * dec->linesize[0];
+
+		for (uint32_t x = 0; x < cfg->width; x++) {
+			int d = a[x] - b[x];
+			q->sse[0] += (uint64_t)(d * d);
+		}
+	}
+	q->samples[0] += (uint64_t)cfg->width * cfg->height;
+
+	for (uint32_t y = 0; y < cfg->height / 2; y++) {
+		for (uint32_t x = 0; x < cfg->width / 2; x++) {
+			for (int c = 0; c < 2; c++) {
+				int d = chroma_at(ref, c, x, y) -
+					chroma_at(dec, c, x, y);
+				q->sse[1 + c] += (uint64_t)(d * d);
+			}
+		}
+	}
+	q->samples[1] += (uint64_t)cfg->width / 2 * (cfg->height / 2);
+	q->samples[2] = q->samples[1];
+
+	for (uint32_t y = 0; y + 8 <= cfg->height; y += 8) {
+		for (uint32_t x = 0; x + 8 <= cfg->width; x += 8) {
+			q->ssim_sum += block_ssim(
+				ref->data[0] + (size_t)y * ref->linesize[0] + x,
+				ref->linesize[0],
+				dec->data[0] + (size_t)y * dec->linesize[0] + x,
+				dec->linesize[0]);
+			q->ssim_blocks++;
+		}
+	}
+
+	q->frames++;
+}
+
+struct decode_state {
+	struct encoder_run *run;
+	struct quality quality;
+	uint8_t *ref_data[MAX_AV_PLANES];
+	uint32_t ref_linesize[MAX_AV_PLANES];
+	int64_t timebase_num;
+	bool format_mismatch;
+};
+
+static void check_frame(struct decode_state *ds, const AVFrame *frame)
+{
+	const struct bench_config *cfg = ds->run->cfg;
+	struct planes ref = {0}, dec = {0};
+	int64_t index = frame->pts / ds->timebase_num;
+
+	if (index < 0 || index >= cfg->frames ||
+	    index % cfg->quality_interval != 0)
+		return;
+
+	if ((frame->format != AV_PIX_FMT_YUV420P &&
+	     frame->format != AV_PIX_FMT_YUVJ420P &&
+	     frame->format != AV_PIX_FMT_NV12) ||
+	    frame->width != (int)cfg->width ||
+	    frame->height != (int)cfg->height) {
+		ds->format_mismatch = true;
+		return;
+	}
+
+	if (!get_frame(ds->run->src, (uint64_t)index, ds->ref_data,
+		       ds->ref_linesize))
+		return;
+
+	for (int i = 0; i < 3; i++) {
+		ref.data[i] = ds->ref_data[i];
+		ref.linesize[i] = (int)ds->ref_linesize[i];
+		dec.data[i] = frame->data[i];
+		dec.linesize[i] = frame->linesize[i];
+	}
+	ref.nv12 = cfg->format == VIDEO_FORMAT_NV12;
+	dec.nv12 = frame->format == AV_PIX_FMT_NV12;
+
+	compare_frame(&ds->quality, cfg, &ref, &dec);
+}
+
+static void receive_frames(struct decode_state *ds, AVCodecContext *ctx,
+			   AVFrame *frame)
+{
+	while (avcodec_receive_frame(ctx, frame) == 0) {
+		check_frame(ds, frame);
+		av_frame_unref(frame);
+	}
+}
+
+static enum AVCodecID get_codec_id(const char *codec)
+{
+	if (strcmp(codec, "h264") == 0)
+		return AV_CODEC_ID_H264;
+	if (strcmp(codec, "hevc") == 0)
+		return AV_CODEC_ID_HEVC;
+	if (strcmp(codec, "av1") == 0)
+		return AV_CODEC_ID_AV1;
+	return AV_CODEC_ID_NONE;
+}
+
+static bool open_decoder(AVCodecContext **ctx, struct encoder_run *run)
+{
+	const char *codec_name = obs_encoder_get_codec(run->encoder);
+	enum AVCodecID id = get_codec_id(codec_name ? codec_name : "");
+	const AVCodec *codec = avcodec_find_decoder(id);
+	uint8_t *header;
+	size_t size;
+
+	if (!codec)
+		return false;
+
+	*ctx = avcodec_alloc_context3(codec);
+	if (!*ctx)
+		return false;
+
+	/* the parameter sets are only in the extra data with most encoders */
+	if (obs_encoder_get_extra_data(run->encoder, &header, &size) && size) {
+		(*ctx)->extradata =
+			av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+		memcpy((*ctx)->extradata, header, size);
+		(*ctx)->extradata_size = (int)size;
+	}
+
+	if (avcodec_open2(*ctx, codec, NULL) < 0) {
+		avcodec_free_context(ctx);
+		return false;
+	}
+
+	return true;
+}
+
+static obs_data_t *quality_results(struct encoder_run *run)
+{
+	const struct bench_config *cfg = run->cfg;
+	obs_data_t *results = obs_data_create();
+	struct decode_state ds = {.run = run};
+	const char *names[] = {"psnr_y", "psnr_u", "psnr_v"};
+	AVCodecContext *ctx = NULL;
+	AVPacket *pkt;
+	AVFrame *frame;
+
+	if (!open_decoder(&ctx, run)) {
+		obs_data_set_string(results, "error", "no decoder");
+		return results;
+	}
+
+	ds.timebase_num = video_output_get_info(run->video)->fps_den;
+	for (uint32_t plane = 0; plane < plane_count(cfg->format); plane++) {
+		uint32_t width, height;
+
+		plane_size(cfg, plane, &width, &height);
+		ds.ref_data[plane] = bmalloc((size_t)width * height);
+		ds.ref_linesize[plane] = width;
+	}
+
+	pkt = av_packet_alloc();
+	frame = av_frame_alloc();
+
+	for (size_t i = 0; i < run->packets.num; i++) {
+		struct stored_packet *stored = &run->packets.array[i];
+
+		pkt->data = stored->data;
+		pkt->size = (int)stored->size;
+		pkt->pts = stored->pts;
+		pkt->dts = stored->dts;
+		pkt->flags = stored->keyframe ? AV_PKT_FLAG_KEY : 0;
+
+		if (avcodec_send_packet(ctx, pkt) == 0)
+			receive_frames(&ds, ctx, frame);
+	}
+
+	avcodec_send_packet(ctx, NULL);
+	receive_frames(&ds, ctx, frame);
+
+	if (ds.quality.frames) {
+		for (int i = 0; i < 3; i++) {
+			double mse = (double)ds.quality.sse[i] /
+				     (double)ds.quality.samples[i];
+			double psnr = 100.0;
+
+			if (mse > 0.0)
+				psnr = 10.0 * log10(255.0 * 255.0 / mse);
+			obs_data_set_double(results, names[i], psnr);
+		}
+
+		obs_data_set_double(results, "ssim_y",
+				    ds.quality.ssim_sum /
+					    (double)ds.quality.ssim_blocks);
+	} else if (ds.format_mismatch) {
+		obs_data_set_string(results, "error",
+				    "decoded frames are not 8-bit 4:2:0 of "
+				    "the source size");
+	}
+
+	obs_data_set_int(results, "frames", ds.quality.frames);
+
+	av_frame_free(&frame);
+	av_packet_free(&pkt);
+	avcodec_free_context(&ctx);
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		bfree(ds.ref_data[i]);
+	return results;
+}
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+static bool open_video(struct encoder_run *run)
+{
+	const struct bench_config *cfg = run->cfg;
+	struct video_output_info voi = {
+		.name = "bench-encoder",
+		.format = cfg->format,
+		.fps_num = cfg->fps,
+		.fps_den = 1,
+		.width = cfg->width,
+		.height = cfg->height,
+		.cache_size = 6,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_PARTIAL,
+	};
+
+	return video_output_open(&run->video, &voi) == VIDEO_OUTPUT_SUCCESS;
+}
+
+static void encoder_results(struct encoder_run *run, obs_data_t *result,
+			    uint64_t start, double cpu_percent)
+{
+	const struct bench_config *cfg = run->cfg;
+	uint64_t end = run->last_packet_ts > start ? run->last_packet_ts
+						    : start + 1;
+	double seconds = (double)(end - start) / 1000000000.0;
+	double duration = (double)cfg->frames / (double)cfg->fps;
+	obs_data_t *latency;
+
+	obs_data_set_int(result, "frames_submitted", cfg->frames);
+	obs_data_set_int(result, "frames_encoded", run->latencies.num);
+	obs_data_set_int(result, "frames_repeated",
+			 video_output_get_skipped_frames(run->video));
+	obs_data_set_double(result, "wall_ms", seconds * 1000.0);
+	obs_data_set_double(result, "encoded_fps",
+			    (double)run->latencies.num / seconds);
+	obs_data_set_double(result, "kbps",
+			    (double)run->bytes * 8.0 / 1000.0 / duration);
+	obs_data_set_double(result, "cpu_percent", cpu_percent);
+	obs_data_set_double(result, "cpu_cores",
+			    cpu_percent * os_get_logical_cores() / 100.0);
+
+	latency = latency_results(run);
+	obs_data_set_obj(result, "latency", latency);
+	obs_data_release(latency);
+
+#ifdef HAVE_AVCODEC
+	if (run->store_packets) {
+		obs_data_t *quality = quality_results(run);
+		obs_data_set_obj(result, "quality", quality);
+		obs_data_release(quality);
+	}
+#endif
+}
+
+static void run_encoder(const struct bench_config *cfg,
+			struct frame_source *src, struct encoder_run *run,
+			const char *spec, obs_data_t *result)
+{
+	char **values = strlist_split(spec, ',', false);
+	const char *id = values[0];
+	os_cpu_usage_info_t *cpu;
+	obs_data_t *settings;
+	uint64_t start;
+
+	memset(run, 0, sizeof(*run));
+	run->cfg = cfg;
+	run->src = src;
+#ifdef HAVE_AVCODEC
+	run->store_packets = cfg->quality_interval > 0;
+#endif
+
+	obs_data_set_string(result, "encoder", spec);
+	obs_data_set_string(result, "id", id ? id : "");
+
+	if (!id || obs_get_encoder_type(id) != OBS_ENCODER_VIDEO ||
+	    !obs_get_encoder_codec(id)) {
+		obs_data_set_string(result, "error", "not a video encoder");
+		strlist_free(values);
+		return;
+	}
+
+	obs_data_set_string(result, "codec", obs_get_encoder_codec(id));
+
+	if (pthread_mutex_init(&run->mutex, NULL) != 0 || !open_video(run)) {
+		obs_data_set_string(result, "error", "initialization failed");
+		strlist_free(values);
+		return;
+	}
+
+	run->submit_ts = bzalloc(sizeof(uint64_t) * cfg->frames);
+
+	settings = create_settings(cfg, id, values + 1);
+	run->encoder = obs_video_encoder_create(id, spec, settings, NULL);
+	run->output = obs_output_create(bench_output_info.id, spec, NULL,
+					NULL);
+	obs_data_release(settings);
+
+	obs_encoder_set_video(run->encoder, run->video);
+	obs_output_set_video_encoder(run->output, run->encoder);
+
+	cpu = os_cpu_usage_info_start();
+	start = os_gettime_ns();
+
+	if (obs_output_start(run->output)) {
+		submit_frames(run);
+		wait_for_packets(run);
+		stop_output(run);
+		encoder_results(run, result, start,
+				os_cpu_usage_info_query(cpu));
+	} else {
+		const char *error = obs_output_get_last_error(run->output);
+		obs_data_set_string(result, "error",
+				    error ? error : "failed to start");
+	}
+
+	os_cpu_usage_info_destroy(cpu);
+	obs_output_release(run->output);
+	obs_encoder_release(run->encoder);
+	video_output_close(run->video);
+
+	for (size_t i = 0; i < run->packets.num; i++)
+		bfree(run->packets.array[i].data);
+	da_free(run->packets);
+	da_free(run->latencies);
+	bfree(run->submit_ts);
+	pthread_mutex_destroy(&run->mutex);
+	strlist_free(values);
+}
+
+static bool reset_video(const struct bench_config *cfg)
+{
+	struct obs_video_info ovi = {0};
+
+	ovi.graphics_module = cfg->renderer;
+	ovi.fps_num = cfg->fps;
+	ovi.fps_den = 1;
+	ovi.base_width = cfg->width;
+	ovi.base_height = cfg->height;
+	ovi.output_width = cfg->width;
+	ovi.output_height = cfg->height;
+	ovi.output_format = cfg->format;
+	ovi.colorspace = VIDEO_CS_709;
+	ovi.range = VIDEO_RANGE_PARTIAL;
+	ovi.scale_type = OBS_SCALE_BICUBIC;
+	ovi.gpu_conversion = true;
+
+	return obs_reset_video(&ovi) == OBS_VIDEO_SUCCESS;
+}
+
+static obs_data_t *config_results(const struct bench_config *cfg)
+{
+	obs_data_t *config = obs_data_create();
+
+	obs_data_set_int(config, "width", cfg->width);
+	obs_data_set_int(config, "height", cfg->height);
+	obs_data_set_int(config, "fps", cfg->fps);
+	obs_data_set_int(config, "frames", cfg->frames);
+	obs_data_set_int(config, "bitrate", cfg->bitrate);
+	obs_data_set_string(config, "format",
+			    cfg->format == VIDEO_FORMAT_NV12 ? "nv12"
+							     : "i420");
+	obs_data_set_string(config, "input",
+			    cfg->input ? cfg->input : "synthetic");
+	obs_data_set_int(config, "quality_interval", cfg->quality_interval);
+	obs_data_set_int(config, "logical_cores", os_get_logical_cores());
+	obs_data_set_int(config, "physical_cores", os_get_physical_cores());
+	return config;
+}
+
+static bool run(struct bench_config *cfg, obs_data_t *results)
+{
+	obs_data_array_t *encoders;
+	struct frame_source src;
+	struct encoder_run state;
+
+	if (!obs_startup("en-US", NULL, NULL))
+		return false;
+
+	/* encoders that work on textures need the graphics subsystem, the
+	 * others run without it */
+	if (!reset_video(cfg))
+		fprintf(stderr, "Graphics are not available, encoders that "
+				"need them will fail\n");
+
+	obs_load_all_modules();
+	obs_post_load_modules();
+
+	bench_output_info.type_data = &state;
+	obs_register_output(&bench_output_info);
+
+	if (!cfg->encoders.num)
+		add_default_encoders(cfg);
+	if (!frame_source_init(&src, cfg))
+		return false;
+
+	encoders = obs_data_array_create();
+
+	for (size_t i = 0; i < cfg->encoders.num; i++) {
+		obs_data_t *result = obs_data_create();
+
+		run_encoder(cfg, &src, &state, cfg->encoders.array[i], result);
+		obs_data_array_push_back(encoders, result);
+		obs_data_release(result);
+	}
+
+	obs_data_set_array(results, "encoders", encoders);
+	obs_data_array_release(encoders);
+	frame_source_free(&src);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_config cfg = {
+		.renderer = DL_OPENGL,
+		.width = 1920,
+		.height = 1080,
+		.fps = 60,
+		.frames = 600,
+		.bitrate = 6000,
+		.format = VIDEO_FORMAT_NV12,
+		.quality_interval = 10,
+	};
+	obs_data_t *results;
+	obs_data_t *config;
+	bool success;
+
+#ifdef _WIN32
+	cfg.renderer = DL_D3D11;
+#endif
+
+	if (!parse_args(&cfg, argc, argv)) {
+		fprintf(stderr, "%s", usage);
+		return 1;
+	}
+
+	results = obs_data_create();
+	config = config_results(&cfg);
+	obs_data_set_string(results, "version", obs_get_version_string());
+	obs_data_set_obj(results, "config", config);
+	obs_data_release(config);
+
+	success = run(&cfg, results);
+	obs_shutdown();
+
+	if (success) {
+		if (cfg.output)
+			success = obs_data_save_json(results, cfg.output);
+		else
+			printf("%s\n", obs_data_get_json(results));
+	}
+
+	for (size_t i = 0; i < cfg.encoders.num; i++)
+		bfree(cfg.encoders.array[i]);
+	da_free(cfg.encoders);
+	obs_data_release(results);
+	return success ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/format-conversion.h>
+
+/* Times the packed/planar YUV conversions used by async sources and CPU-side
+ * output conversion.  Usage: bench-format-conversion [width height iters] */
+
+struct bench_frame {
+	uint32_t width;
+	uint32_t height;
+
+	uint8_t *packed;
+	uint32_t packed_linesize;
+
+	uint8_t *planes[3];
+	uint32_t linesize[3];
+};
+
+static void fill_random(uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)rand();
+}
+
+static void bench_frame_init(struct bench_frame *f, uint32_t width,
+			     uint32_t height)
+{
+	f->width = width;
+	f->height = height;
+
+	f->packed_linesize = width * 4;
+	f->packed = bmalloc((size_t)f->packed_linesize * height);
+	fill_random(f->packed, (size_t)f->packed_linesize * height);
+
+	for (size_t i = 0; i < 3; i++) {
+		f->linesize[i] = width;
+		f->planes[i] = bmalloc((size_t)width * height);
+		fill_random(f->planes[i], (size_t)width * height);
+	}
+}
+
+static void bench_frame_free(struct bench_frame *f)
+{
+	bfree(f->packed);
+	for (size_t i = 0; i < 3; i++)
+		bfree(f->planes[i]);
+}
+
+static void report(const char *name, uint64_t start, uint64_t end, int iters)
+{
+	double ms = (double)(end - start) / 1000000.0;
+	printf("%-24s %8.3f ms/frame\n", name, ms / (double)iters);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+	int iters = 200;
+	struct bench_frame f;
+	uint64_t start;
+
+	if (argc == 4) {
+		width = (uint32_t)strtoul(argv[1], NULL, 10);
+		height = (uint32_t)strtoul(argv[2], NULL, 10);
+		iters = atoi(argv[3]);
+	}
+
+	if (!width || !height || (width & 7) || (height & 1) || iters <= 0) {
+		fprintf(stderr, "width must be a multiple of 8, height must "
+				"be even, and iters must be positive\n");
+		return 1;
+	}
+
+	bench_frame_init(&f, width, height);
+
+	printf("%ux%u, %d iterations, AVX2: %s\n", width, height, iters,
+	       os_cpu_has_avx2() ? "yes" : "no");
+
+	uint32_t i420_linesize[3] = {width, width / 2, width / 2};
+	uint32_t nv12_linesize[3] = {width, width, 0};
+
+	start = os_gettime_ns();
+	for (int i = 0; i < iters; i++)
+		compress_uyvx_to_i420(f.packed, f.packed_linesize, 0, height,
+				      f.planes, i420_linesize);
+	report("compress_uyvx_to_i420", start, os_gettime_ns(), iters);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < iters; i++)
+		compress_uyvx_to_nv12(f.packed, f.packed_linesize, 0, height,
+				      f.planes, nv12_linesize);
+	report("compress_uyvx_to_nv12", start, os_gettime_ns(), iters);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < iters; i++)
+		convert_uyvx_to_i444(f.packed, f.packed_linesize, 0, height,
+				     f.planes, f.linesize);
+	report("convert_uyvx_to_i444", start, os_gettime_ns(), iters);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < iters; i++)
+		decompress_420((const uint8_t *const *)f.planes,
+			       i420_linesize, 0, height, f.packed,
+			       f.packed_linesize);
+	report("decompress_420", start, os_gettime_ns(), iters);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < iters; i++)
+		decompress_nv12((const uint8_t *const *)f.planes,
+				nv12_linesize, 0, height, f.packed,
+				f.packed_linesize);
+	report("decompress_nv12", start, os_gettime_ns(), iters);
+
+	bench_frame_free(&f);
+	return 0;
+}
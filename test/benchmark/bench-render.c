@@ -0,0 +1,525 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+#include <obs.h>
+
+/*
+ * Headless render throughput benchmark of the video pipeline: renders a
+ * scene of color sources without any display and reports the CPU time of
+ * each render stage from the profiler and its GPU time from libobs' GPU
+ * timing, for a given canvas and output size, output format and scale type.
+ *
+ * The raw frame callback that the CPU encoders receive their frames from is
+ * connected unless --no-output is given, so that scaling, conversion, staging
+ * and download run the same way as while encoding.  Results are written as
+ * JSON.
+ */
+
+static const char *usage =
+	"usage: bench-render [options]\n"
+	"  --renderer opengl|d3d11  graphics backend\n"
+	"  --width N --height N     canvas size (default 1920x1080)\n"
+	"  --output-width N --output-height N\n"
+	"                           output size (default canvas size)\n"
+	"  --format nv12|i420|i444|rgba  output format (default nv12)\n"
+	"  --scale point|bilinear|bicubic|lanczos|area  (default bicubic)\n"
+	"  --cpu-conversion         convert on the CPU instead of the GPU\n"
+	"  --sources N              sources in the scene (default 20)\n"
+	"  --frames N               frames to measure (default 600)\n"
+	"  --fps N                  frame rate (default 60)\n"
+	"  --no-output              only render the canvas\n"
+	"  --output FILE            write results to FILE instead of stdout\n"
+	"OpenGL still needs a display server to create its context.\n";
+
+struct bench_config {
+	const char *renderer;
+	uint32_t width;
+	uint32_t height;
+	uint32_t output_width;
+	uint32_t output_height;
+	enum video_format format;
+	enum obs_scale_type scale_type;
+	bool gpu_conversion;
+	int sources;
+	int frames;
+	uint32_t fps;
+	bool raw;
+	const char *output;
+};
+
+struct name_value {
+	const char *name;
+	int value;
+};
+
+static const struct name_value formats[] = {
+	{"nv12", VIDEO_FORMAT_NV12},
+	{"i420", VIDEO_FORMAT_I420},
+	{"i444", VIDEO_FORMAT_I444},
+	{"rgba", VIDEO_FORMAT_RGBA},
+	{NULL, 0},
+};
+
+static const struct name_value scale_types[] = {
+	{"point", OBS_SCALE_POINT},     {"bilinear", OBS_SCALE_BILINEAR},
+	{"bicubic", OBS_SCALE_BICUBIC}, {"lanczos", OBS_SCALE_LANCZOS},
+	{"area", OBS_SCALE_AREA},       {NULL, 0},
+};
+
+static bool find_value(const struct name_value *list, const char *name,
+		       int *value)
+{
+	for (; list->name; list++) {
+		if (strcmp(list->name, name) == 0) {
+			*value = list->value;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static const char *find_name(const struct name_value *list, int value)
+{
+	for (; list->name; list++) {
+		if (list->value == value)
+			return list->name;
+	}
+
+	return "unknown";
+}
+
+static bool parse_args(struct bench_config *cfg, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+		int value;
+
+		if (strcmp(arg, "--cpu-conversion") == 0) {
+			cfg->gpu_conversion = false;
+			continue;
+		} else if (strcmp(arg, "--no-output") == 0) {
+			cfg->raw = false;
+			continue;
+		}
+		if (!val)
+			return false;
+
+		if (strcmp(arg, "--renderer") == 0) {
+			if (strcmp(val, "opengl") == 0)
+				cfg->renderer = DL_OPENGL;
+#ifdef _WIN32
+			else if (strcmp(val, "d3d11") == 0)
+				cfg->renderer = DL_D3D11;
+#endif
+			else
+				return false;
+		} else if (strcmp(arg, "--width") == 0) {
+			cfg->width = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--height") == 0) {
+			cfg->height = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--output-width") == 0) {
+			cfg->output_width = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--output-height") == 0) {
+			cfg->output_height = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--format") == 0) {
+			if (!find_value(formats, val, &value))
+				return false;
+			cfg->format = (enum video_format)value;
+		} else if (strcmp(arg, "--scale") == 0) {
+			if (!find_value(scale_types, val, &value))
+				return false;
+			cfg->scale_type = (enum obs_scale_type)value;
+		} else if (strcmp(arg, "--sources") == 0) {
+			cfg->sources = atoi(val);
+		} else if (strcmp(arg, "--frames") == 0) {
+			cfg->frames = atoi(val);
+		} else if (strcmp(arg, "--fps") == 0) {
+			cfg->fps = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--output") == 0) {
+			cfg->output = val;
+		} else {
+			return false;
+		}
+
+		i++;
+	}
+
+	if (!cfg->output_width)
+		cfg->output_width = cfg->width;
+	if (!cfg->output_height)
+		cfg->output_height = cfg->height;
+
+	return cfg->width && cfg->height && cfg->output_width &&
+	       cfg->output_height && cfg->sources >= 0 && cfg->frames > 0 &&
+	       cfg->fps;
+}
+
+/* ------------------------------------------------------------------------- */
+/* CPU times from the profiler                                               */
+
+/* the first one is the root of the graphics thread, the names of the others
+ * are matched exactly */
+static const char *cpu_stages[] = {
+	"obs_graphics_thread(",
+	"tick_sources",
+	"output_frame",
+	"render_video",
+	"render_main_texture",
+	"render_output_texture",
+	"render_convert_texture",
+	"stage_output_texture",
+	"download_frame",
+	"output_video_data",
+	"render_displays",
+};
+
+#define NUM_CPU_STAGES (sizeof(cpu_stages) / sizeof(cpu_stages[0]))
+
+struct cpu_times {
+	uint64_t total_us[NUM_CPU_STAGES];
+	uint64_t count[NUM_CPU_STAGES];
+};
+
+static void add_entry(struct cpu_times *times, size_t stage,
+		      profiler_snapshot_entry_t *entry, bool subtract)
+{
+	profiler_time_entries_t *entries = profiler_snapshot_entry_times(entry);
+	uint64_t total = 0;
+	uint64_t count = 0;
+
+	for (size_t i = 0; i < entries->num; i++) {
+		total += entries->array[i].time_delta * entries->array[i].count;
+		count += entries->array[i].count;
+	}
+
+	if (subtract) {
+		times->total_us[stage] -= total;
+		times->count[stage] -= count;
+	} else {
+		times->total_us[stage] += total;
+		times->count[stage] += count;
+	}
+}
+
+struct collect_data {
+	struct cpu_times *times;
+	bool subtract;
+};
+
+/* the stages are nested at different depths, so the whole tree is
+ * searched */
+static bool collect_entry(void *param, profiler_snapshot_entry_t *entry)
+{
+	struct collect_data *data = param;
+	const char *name = profiler_snapshot_entry_name(entry);
+
+	for (size_t i = 0; i < NUM_CPU_STAGES; i++) {
+		if (strncmp(name, cpu_stages[i], strlen(cpu_stages[i])) == 0 &&
+		    (i == 0 || !name[strlen(cpu_stages[i])]))
+			add_entry(data->times, i, entry, data->subtract);
+	}
+
+	profiler_snapshot_enumerate_children(entry, collect_entry, data);
+	return true;
+}
+
+static bool collect_root(void *param, profiler_snapshot_entry_t *entry)
+{
+	const char *name = profiler_snapshot_entry_name(entry);
+
+	if (strncmp(name, cpu_stages[0], strlen(cpu_stages[0])) == 0)
+		collect_entry(param, entry);
+	return true;
+}
+
+static void collect_cpu_times(struct cpu_times *times, bool subtract)
+{
+	profiler_snapshot_t *snap = profile_snapshot_create();
+	struct collect_data data = {times, subtract};
+
+	profiler_snapshot_enumerate_roots(snap, collect_root, &data);
+	profile_snapshot_free(snap);
+}
+
+static obs_data_t *cpu_results(const struct cpu_times *times)
+{
+	obs_data_t *results = obs_data_create();
+
+	for (size_t i = 0; i < NUM_CPU_STAGES; i++) {
+		obs_data_t *stage;
+		const char *name = i == 0 ? "frame" : cpu_stages[i];
+
+		if (!times->count[i])
+			continue;
+
+		stage = obs_data_create();
+		obs_data_set_int(stage, "count", (long long)times->count[i]);
+		obs_data_set_double(stage, "mean_ms",
+				    (double)times->total_us[i] / 1000.0 /
+					    (double)times->count[i]);
+		obs_data_set_obj(results, name, stage);
+		obs_data_release(stage);
+	}
+
+	return results;
+}
+
+static obs_data_t *gpu_results(void)
+{
+	obs_data_t *results = obs_data_create();
+
+	for (int i = 0; i < OBS_GPU_STAGE_COUNT; i++) {
+		struct obs_gpu_stage_stats stats;
+		obs_data_t *stage;
+
+		obs_get_gpu_stage_stats(i, &stats);
+		if (!stats.count)
+			continue;
+
+		stage = obs_data_create();
+		obs_data_set_int(stage, "count", (long long)stats.count);
+		obs_data_set_double(stage, "mean_ms",
+				    (double)stats.total_ns / 1000000.0 /
+					    (double)stats.count);
+		obs_data_set_double(stage, "max_ms",
+				    (double)stats.max_ns / 1000000.0);
+		obs_data_set_obj(results, obs_gpu_stage_name(i), stage);
+		obs_data_release(stage);
+	}
+
+	return results;
+}
+
+/* ------------------------------------------------------------------------- */
+
+#define WARMUP_FRAMES 30
+
+struct frame_wait {
+	os_event_t *done;
+	volatile long remaining;
+};
+
+static void count_frame(void *param, float seconds)
+{
+	struct frame_wait *wait = param;
+
+	if (os_atomic_dec_long(&wait->remaining) == 0)
+		os_event_signal(wait->done);
+
+	UNUSED_PARAMETER(seconds);
+}
+
+static void wait_frames(struct frame_wait *wait, long frames)
+{
+	os_event_reset(wait->done);
+	os_atomic_set_long(&wait->remaining, frames);
+	obs_add_tick_callback(count_frame, wait);
+	os_event_wait(wait->done);
+	obs_remove_tick_callback(count_frame, wait);
+}
+
+static void receive_raw_frame(void *param, struct video_data *frame)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(frame);
+}
+
+static obs_source_t *create_scene(const struct bench_config *cfg)
+{
+	obs_scene_t *scene = obs_scene_create("bench-render");
+	struct dstr name = {0};
+
+	for (int i = 0; i < cfg->sources; i++) {
+		obs_data_t *settings = obs_data_create();
+		obs_source_t *source;
+		obs_sceneitem_t *item;
+		struct vec2 pos;
+
+		obs_data_set_int(settings, "color",
+				 0xFF000000 | (uint32_t)(i * 0x10204F));
+		obs_data_set_int(settings, "width", cfg->width / 4);
+		obs_data_set_int(settings, "height", cfg->height / 4);
+
+		dstr_printf(&name, "color %d", i);
+		source = obs_source_create("color_source", name.array,
+					   settings, NULL);
+		obs_data_release(settings);
+
+		item = obs_scene_add(scene, source);
+		vec2_set(&pos, (float)((i * 97) % cfg->width),
+			 (float)((i * 61) % cfg->height));
+		obs_sceneitem_set_pos(item, &pos);
+		obs_source_release(source);
+	}
+
+	dstr_free(&name);
+
+	/* the reference of the scene is released as its source */
+	return obs_scene_get_source(scene);
+}
+
+static obs_data_t *config_results(const struct bench_config *cfg)
+{
+	obs_data_t *config = obs_data_create();
+
+	obs_data_set_string(config, "renderer", cfg->renderer);
+	obs_data_set_int(config, "width", cfg->width);
+	obs_data_set_int(config, "height", cfg->height);
+	obs_data_set_int(config, "output_width", cfg->output_width);
+	obs_data_set_int(config, "output_height", cfg->output_height);
+	obs_data_set_string(config, "format", find_name(formats, cfg->format));
+	obs_data_set_string(config, "scale_type",
+			    find_name(scale_types, cfg->scale_type));
+	obs_data_set_bool(config, "gpu_conversion", cfg->gpu_conversion);
+	obs_data_set_int(config, "sources", cfg->sources);
+	obs_data_set_int(config, "frames", cfg->frames);
+	obs_data_set_int(config, "fps", cfg->fps);
+	obs_data_set_bool(config, "output", cfg->raw);
+	return config;
+}
+
+static bool run(const struct bench_config *cfg, profiler_name_store_t *store,
+		obs_data_t *results)
+{
+	struct obs_video_info ovi = {0};
+	struct cpu_times times = {0};
+	struct frame_wait wait = {0};
+	obs_data_t *stages;
+	obs_source_t *scene;
+	uint64_t start;
+	int ret;
+
+	if (!obs_startup("en-US", NULL, store))
+		return false;
+
+	ovi.graphics_module = cfg->renderer;
+	ovi.fps_num = cfg->fps;
+	ovi.fps_den = 1;
+	ovi.base_width = cfg->width;
+	ovi.base_height = cfg->height;
+	ovi.output_width = cfg->output_width;
+	ovi.output_height = cfg->output_height;
+	ovi.output_format = cfg->format;
+	ovi.colorspace = VIDEO_CS_709;
+	ovi.range = VIDEO_RANGE_PARTIAL;
+	ovi.scale_type = cfg->scale_type;
+	ovi.gpu_conversion = cfg->gpu_conversion;
+
+	ret = obs_reset_video(&ovi);
+	if (ret != OBS_VIDEO_SUCCESS) {
+		fprintf(stderr, "obs_reset_video failed: %d\n", ret);
+		return false;
+	}
+
+	obs_load_all_modules();
+	obs_post_load_modules();
+
+	scene = create_scene(cfg);
+	if (!scene) {
+		fprintf(stderr, "Failed to create the scene\n");
+		return false;
+	}
+
+	if (os_event_init(&wait.done, OS_EVENT_TYPE_MANUAL) != 0) {
+		obs_source_release(scene);
+		return false;
+	}
+
+	obs_set_output_source(0, scene);
+	if (cfg->raw)
+		obs_add_raw_video_callback(NULL, receive_raw_frame, NULL);
+
+	wait_frames(&wait, WARMUP_FRAMES);
+
+	obs_set_gpu_timing_enabled(true);
+	collect_cpu_times(&times, true);
+	start = os_gettime_ns();
+
+	wait_frames(&wait, cfg->frames);
+
+	obs_data_set_double(results, "wall_ms",
+			    (double)(os_gettime_ns() - start) / 1000000.0);
+	obs_data_set_int(results, "lagged_frames", obs_get_lagged_frames());
+
+	/* lets the last frames finish on the CPU and the GPU */
+	os_sleep_ms(4 * 1000 / cfg->fps + 1);
+	collect_cpu_times(&times, false);
+	obs_set_gpu_timing_enabled(false);
+
+	stages = cpu_results(&times);
+	obs_data_set_obj(results, "cpu", stages);
+	obs_data_release(stages);
+
+	stages = gpu_results();
+	obs_data_set_obj(results, "gpu", stages);
+	obs_data_release(stages);
+
+	if (cfg->raw)
+		obs_remove_raw_video_callback(receive_raw_frame, NULL);
+	obs_set_output_source(0, NULL);
+	obs_source_release(scene);
+	os_event_destroy(wait.done);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_config cfg = {
+		.renderer = DL_OPENGL,
+		.width = 1920,
+		.height = 1080,
+		.format = VIDEO_FORMAT_NV12,
+		.scale_type = OBS_SCALE_BICUBIC,
+		.gpu_conversion = true,
+		.sources = 20,
+		.frames = 600,
+		.fps = 60,
+		.raw = true,
+	};
+	profiler_name_store_t *store;
+	obs_data_t *results;
+	obs_data_t *config;
+	bool success;
+
+#ifdef _WIN32
+	cfg.renderer = DL_D3D11;
+#endif
+
+	if (!parse_args(&cfg, argc, argv)) {
+		fprintf(stderr, "%s", usage);
+		return 1;
+	}
+
+	store = profiler_name_store_create();
+	profiler_start();
+
+	results = obs_data_create();
+	config = config_results(&cfg);
+	obs_data_set_string(results, "version", obs_get_version_string());
+	obs_data_set_obj(results, "config", config);
+	obs_data_release(config);
+
+	success = run(&cfg, store, results);
+	obs_shutdown();
+
+	if (success) {
+		if (cfg.output)
+			success = obs_data_save_json(results, cfg.output);
+		else
+			printf("%s\n", obs_data_get_json(results));
+	}
+
+	obs_data_release(results);
+	profiler_stop();
+	profiler_free();
+	profiler_name_store_free(store);
+	return success ? 0 : 1;
+}
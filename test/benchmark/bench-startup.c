@@ -0,0 +1,654 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+#include <obs.h>
+
+/*
+ * Headless benchmark of libobs startup and rendering: times obs_startup,
+ * the video/audio resets, module loading and the loading of a scene
+ * collection, then renders a number of frames of that collection and reports
+ * the graphics thread's per-frame cost.  The collection is either a scene
+ * collection file saved by the front-end or a synthetic one made of color,
+ * text and image sources in nested scenes with filter chains.
+ *
+ * Results are written as JSON (to stdout by default) so that runs of
+ * different builds can be compared by scripts.
+ */
+
+static const char *usage =
+	"usage: bench-startup [options]\n"
+	"  --sources N          synthetic sources per scene (default 20)\n"
+	"  --depth N            number of nested scenes (default 3)\n"
+	"  --filters N          filters on each source (default 2)\n"
+	"  --image FILE         also add image sources showing FILE\n"
+	"  --collection FILE    load a scene collection file instead\n"
+	"  --frames N           frames to render (default 300)\n"
+	"  --width N --height N canvas size (default 1920x1080)\n"
+	"  --fps N              frame rate (default 60)\n"
+	"  --raw                also output raw frames (CPU conversion)\n"
+	"  --module-path BIN DATA  load modules from these paths\n"
+	"  --output FILE        write results to FILE instead of stdout\n";
+
+struct bench_config {
+	int sources;
+	int depth;
+	int filters;
+	const char *image;
+	const char *collection;
+	int frames;
+	uint32_t width;
+	uint32_t height;
+	uint32_t fps;
+	bool raw;
+	const char *module_bin;
+	const char *module_data;
+	const char *output;
+};
+
+static bool parse_args(struct bench_config *cfg, int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "--raw") == 0) {
+			cfg->raw = true;
+			continue;
+		}
+		if (!val)
+			return false;
+
+		if (strcmp(arg, "--sources") == 0)
+			cfg->sources = atoi(val);
+		else if (strcmp(arg, "--depth") == 0)
+			cfg->depth = atoi(val);
+		else if (strcmp(arg, "--filters") == 0)
+			cfg->filters = atoi(val);
+		else if (strcmp(arg, "--image") == 0)
+			cfg->image = val;
+		else if (strcmp(arg, "--collection") == 0)
+			cfg->collection = val;
+		else if (strcmp(arg, "--frames") == 0)
+			cfg->frames = atoi(val);
+		else if (strcmp(arg, "--width") == 0)
+			cfg->width = (uint32_t)strtoul(val, NULL, 10);
+		else if (strcmp(arg, "--height") == 0)
+			cfg->height = (uint32_t)strtoul(val, NULL, 10);
+		else if (strcmp(arg, "--fps") == 0)
+			cfg->fps = (uint32_t)strtoul(val, NULL, 10);
+		else if (strcmp(arg, "--output") == 0)
+			cfg->output = val;
+		else if (strcmp(arg, "--module-path") == 0 && i + 2 < argc) {
+			cfg->module_bin = val;
+			cfg->module_data = argv[i + 2];
+			i++;
+		} else
+			return false;
+
+		i++;
+	}
+
+	return cfg->sources >= 0 && cfg->depth > 0 && cfg->filters >= 0 &&
+	       cfg->frames > 0 && cfg->width && cfg->height && cfg->fps;
+}
+
+/* ------------------------------------------------------------------------- */
+/* synthetic scene collection                                                */
+
+/* applied in turn, so that chains mix effect and render target filters */
+static const char *filter_ids[] = {"color_filter", "sharpness_filter",
+				   "crop_filter", "scroll_filter"};
+
+#define NUM_FILTER_IDS (sizeof(filter_ids) / sizeof(filter_ids[0]))
+
+static void add_filters(obs_data_t *source, const char *name, int count)
+{
+	obs_data_array_t *filters = obs_data_array_create();
+	struct dstr filter_name = {0};
+
+	for (int i = 0; i < count; i++) {
+		obs_data_t *filter = obs_data_create();
+		obs_data_t *settings = obs_data_create();
+
+		dstr_printf(&filter_name, "%s filter %d", name, i);
+		obs_data_set_string(filter, "name", filter_name.array);
+		obs_data_set_string(filter, "id",
+				    filter_ids[i % NUM_FILTER_IDS]);
+		obs_data_set_obj(filter, "settings", settings);
+		obs_data_array_push_back(filters, filter);
+
+		obs_data_release(settings);
+		obs_data_release(filter);
+	}
+
+	obs_data_set_array(source, "filters", filters);
+	obs_data_array_release(filters);
+	dstr_free(&filter_name);
+}
+
+static void set_source_settings(const struct bench_config *cfg,
+				obs_data_t *source, obs_data_t *settings,
+				int idx)
+{
+	int kinds = cfg->image ? 3 : 2;
+
+	switch (idx % kinds) {
+	case 0:
+		obs_data_set_string(source, "id", "color_source");
+		obs_data_set_int(settings, "color",
+				 0xFF000000 | (uint32_t)(idx * 0x10204F));
+		obs_data_set_int(settings, "width", cfg->width / 4);
+		obs_data_set_int(settings, "height", cfg->height / 4);
+		break;
+	case 1:
+#ifdef _WIN32
+		obs_data_set_string(source, "id", "text_gdiplus");
+#else
+		obs_data_set_string(source, "id", "text_ft2_source");
+#endif
+		obs_data_set_string(settings, "text", "Benchmark text");
+		break;
+	case 2:
+		obs_data_set_string(source, "id", "image_source");
+		obs_data_set_string(settings, "file", cfg->image);
+		break;
+	}
+}
+
+static void add_item(obs_data_array_t *items, const char *name, int idx,
+		     const struct bench_config *cfg)
+{
+	obs_data_t *item = obs_data_create();
+	struct vec2 pos;
+
+	/* spread the items over the canvas so that they don't all overlap */
+	vec2_set(&pos, (float)((idx * 97) % cfg->width),
+		 (float)((idx * 61) % cfg->height));
+
+	obs_data_set_string(item, "name", name);
+	obs_data_set_bool(item, "visible", true);
+	obs_data_set_vec2(item, "pos", &pos);
+	obs_data_array_push_back(items, item);
+	obs_data_release(item);
+}
+
+/* every scene holds its own sources and the previous scene, and the last
+ * scene is the one that is output */
+static obs_data_array_t *create_collection(const struct bench_config *cfg)
+{
+	obs_data_array_t *sources = obs_data_array_create();
+	struct dstr name = {0};
+	struct dstr prev_scene = {0};
+
+	for (int s = 0; s < cfg->depth; s++) {
+		obs_data_array_t *items = obs_data_array_create();
+		obs_data_t *scene = obs_data_create();
+		obs_data_t *scene_settings = obs_data_create();
+
+		for (int i = 0; i < cfg->sources; i++) {
+			obs_data_t *source = obs_data_create();
+			obs_data_t *settings = obs_data_create();
+			int idx = s * cfg->sources + i;
+
+			dstr_printf(&name, "source %d", idx);
+			obs_data_set_string(source, "name", name.array);
+			set_source_settings(cfg, source, settings, idx);
+			obs_data_set_obj(source, "settings", settings);
+			add_filters(source, name.array, cfg->filters);
+			obs_data_array_push_back(sources, source);
+
+			add_item(items, name.array, idx, cfg);
+
+			obs_data_release(settings);
+			obs_data_release(source);
+		}
+
+		if (prev_scene.len)
+			add_item(items, prev_scene.array, s, cfg);
+
+		dstr_printf(&prev_scene, "scene %d", s);
+		obs_data_set_string(scene, "name", prev_scene.array);
+		obs_data_set_string(scene, "id", "scene");
+		obs_data_set_array(scene_settings, "items", items);
+		obs_data_set_obj(scene, "settings", scene_settings);
+		obs_data_array_push_back(sources, scene);
+
+		obs_data_release(scene_settings);
+		obs_data_release(scene);
+		obs_data_array_release(items);
+	}
+
+	dstr_free(&prev_scene);
+	dstr_free(&name);
+	return sources;
+}
+
+/* ------------------------------------------------------------------------- */
+/* frame timing                                                              */
+
+/* the graphics thread's root section and the stages below it, whose times
+ * are taken from the difference of two profiler snapshots */
+enum {
+	STAGE_FRAME,
+	STAGE_TICK,
+	STAGE_OUTPUT,
+	STAGE_DISPLAYS,
+	NUM_STAGES,
+};
+
+static const char *stage_names[NUM_STAGES] = {
+	"obs_graphics_thread(",
+	"tick_sources",
+	"output_frame",
+	"render_displays",
+};
+
+static const char *stage_keys[NUM_STAGES] = {
+	"frame",
+	"tick_sources",
+	"output_frame",
+	"render_displays",
+};
+
+struct stage_times {
+	profiler_time_entries_t entries[NUM_STAGES];
+};
+
+static void add_times(profiler_time_entries_t *dst,
+		      profiler_time_entries_t *src, bool subtract)
+{
+	for (size_t i = 0; i < src->num; i++) {
+		profiler_time_entry_t *entry = src->array + i;
+		size_t j;
+
+		for (j = 0; j < dst->num; j++) {
+			if (dst->array[j].time_delta == entry->time_delta)
+				break;
+		}
+
+		if (j == dst->num) {
+			profiler_time_entry_t added = {entry->time_delta, 0};
+			da_push_back((*dst), &added);
+		}
+
+		if (subtract)
+			dst->array[j].count -= entry->count;
+		else
+			dst->array[j].count += entry->count;
+	}
+}
+
+struct collect_data {
+	struct stage_times *times;
+	bool subtract;
+};
+
+static bool collect_child(void *param, profiler_snapshot_entry_t *entry)
+{
+	struct collect_data *data = param;
+	const char *name = profiler_snapshot_entry_name(entry);
+
+	for (size_t i = STAGE_TICK; i < NUM_STAGES; i++) {
+		if (strcmp(name, stage_names[i]) == 0)
+			add_times(&data->times->entries[i],
+				  profiler_snapshot_entry_times(entry),
+				  data->subtract);
+	}
+
+	return true;
+}
+
+static bool collect_root(void *param, profiler_snapshot_entry_t *entry)
+{
+	struct collect_data *data = param;
+	const char *name = profiler_snapshot_entry_name(entry);
+	const char *prefix = stage_names[STAGE_FRAME];
+
+	if (strncmp(name, prefix, strlen(prefix)) != 0)
+		return true;
+
+	add_times(&data->times->entries[STAGE_FRAME],
+		  profiler_snapshot_entry_times(entry), data->subtract);
+	profiler_snapshot_enumerate_children(entry, collect_child, data);
+	return true;
+}
+
+static void collect_times(struct stage_times *times, bool subtract)
+{
+	profiler_snapshot_t *snap = profile_snapshot_create();
+	struct collect_data data = {times, subtract};
+
+	profiler_snapshot_enumerate_roots(snap, collect_root, &data);
+	profile_snapshot_free(snap);
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+	const profiler_time_entry_t *first = a;
+	const profiler_time_entry_t *second = b;
+
+	if (first->time_delta == second->time_delta)
+		return 0;
+	return first->time_delta < second->time_delta ? -1 : 1;
+}
+
+static double percentile(profiler_time_entries_t *entries, uint64_t total,
+			 double pct)
+{
+	uint64_t target = (uint64_t)((double)total * pct);
+	uint64_t count = 0;
+
+	for (size_t i = 0; i < entries->num; i++) {
+		count += entries->array[i].count;
+		if (count > target)
+			return (double)entries->array[i].time_delta / 1000.0;
+	}
+
+	return 0.0;
+}
+
+/* times are stored in microseconds, the results are in milliseconds */
+static obs_data_t *stage_results(profiler_time_entries_t *entries)
+{
+	obs_data_t *result = obs_data_create();
+	uint64_t total_us = 0;
+	uint64_t count = 0;
+	double max_ms = 0.0;
+
+	qsort(entries->array, entries->num, sizeof(profiler_time_entry_t),
+	      compare_entries);
+
+	for (size_t i = 0; i < entries->num; i++) {
+		profiler_time_entry_t *entry = entries->array + i;
+		if (!entry->count)
+			continue;
+
+		total_us += entry->time_delta * entry->count;
+		count += entry->count;
+		max_ms = (double)entry->time_delta / 1000.0;
+	}
+
+	obs_data_set_int(result, "count", (long long)count);
+	obs_data_set_double(result, "mean_ms",
+			    count ? (double)total_us / 1000.0 / (double)count
+				  : 0.0);
+	obs_data_set_double(result, "p50_ms", percentile(entries, count, 0.5));
+	obs_data_set_double(result, "p95_ms", percentile(entries, count, 0.95));
+	obs_data_set_double(result, "max_ms", max_ms);
+	return result;
+}
+
+#define WARMUP_FRAMES 10
+
+struct frame_wait {
+	os_event_t *done;
+	volatile long remaining;
+};
+
+static void count_frame(void *param, float seconds)
+{
+	struct frame_wait *wait = param;
+
+	if (os_atomic_dec_long(&wait->remaining) == 0)
+		os_event_signal(wait->done);
+
+	UNUSED_PARAMETER(seconds);
+}
+
+static void receive_raw_frame(void *param, struct video_data *frame)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(frame);
+}
+
+static bool render_frames(const struct bench_config *cfg, obs_data_t *results)
+{
+	struct stage_times times = {0};
+	struct frame_wait wait = {0};
+	uint64_t start;
+
+	if (os_event_init(&wait.done, OS_EVENT_TYPE_MANUAL) != 0)
+		return false;
+
+	if (cfg->raw)
+		obs_add_raw_video_callback(NULL, receive_raw_frame, NULL);
+
+	/* the first frames of new sources include their setup */
+	os_atomic_set_long(&wait.remaining, WARMUP_FRAMES);
+	obs_add_tick_callback(count_frame, &wait);
+	os_event_wait(wait.done);
+	obs_remove_tick_callback(count_frame, &wait);
+
+	os_atomic_set_long(&wait.remaining, (long)cfg->frames);
+	os_event_reset(wait.done);
+
+	collect_times(&times, true);
+	start = os_gettime_ns();
+	obs_add_tick_callback(count_frame, &wait);
+	os_event_wait(wait.done);
+	obs_remove_tick_callback(count_frame, &wait);
+	obs_data_set_double(results, "render_wall_ms",
+			    (double)(os_gettime_ns() - start) / 1000000.0);
+	obs_data_set_int(results, "lagged_frames", obs_get_lagged_frames());
+
+	/* another frame may start before the callback is removed */
+	os_sleep_ms(1000 / cfg->fps + 1);
+	collect_times(&times, false);
+
+	if (cfg->raw)
+		obs_remove_raw_video_callback(receive_raw_frame, NULL);
+
+	for (size_t i = 0; i < NUM_STAGES; i++) {
+		obs_data_t *stage = stage_results(&times.entries[i]);
+		obs_data_set_obj(results, stage_keys[i], stage);
+		obs_data_release(stage);
+		da_free(times.entries[i]);
+	}
+
+	os_event_destroy(wait.done);
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline double ms_since(uint64_t start)
+{
+	return (double)(os_gettime_ns() - start) / 1000000.0;
+}
+
+static obs_data_t *config_results(const struct bench_config *cfg)
+{
+	obs_data_t *config = obs_data_create();
+
+	if (cfg->collection) {
+		obs_data_set_string(config, "collection", cfg->collection);
+	} else {
+		obs_data_set_int(config, "sources", cfg->sources);
+		obs_data_set_int(config, "depth", cfg->depth);
+		obs_data_set_int(config, "filters", cfg->filters);
+		obs_data_set_bool(config, "images", cfg->image != NULL);
+	}
+
+	obs_data_set_int(config, "frames", cfg->frames);
+	obs_data_set_int(config, "width", cfg->width);
+	obs_data_set_int(config, "height", cfg->height);
+	obs_data_set_int(config, "fps", cfg->fps);
+	obs_data_set_bool(config, "raw", cfg->raw);
+	return config;
+}
+
+static obs_data_array_t *load_collection_sources(const char *file,
+						 const char **scene_name)
+{
+	obs_data_t *data = obs_data_create_from_json_file_safe(file, "bak");
+	obs_data_array_t *sources;
+
+	if (!data)
+		return NULL;
+
+	sources = obs_data_get_array(data, "sources");
+	*scene_name = bstrdup(obs_data_get_string(data, "current_scene"));
+	obs_data_release(data);
+	return sources;
+}
+
+static bool run(const struct bench_config *cfg, profiler_name_store_t *store,
+		obs_data_t *results)
+{
+	struct obs_video_info ovi = {0};
+	struct obs_audio_info oai = {0};
+	obs_data_t *frames = NULL;
+	obs_data_array_t *sources;
+	obs_source_t *scene = NULL;
+	const char *scene_name = NULL;
+	uint64_t start;
+	int ret;
+
+	start = os_gettime_ns();
+	if (!obs_startup("en-US", NULL, store))
+		return false;
+	obs_data_set_double(results, "startup_ms", ms_since(start));
+
+	ovi.adapter = 0;
+	ovi.fps_num = cfg->fps;
+	ovi.fps_den = 1;
+	ovi.graphics_module = DL_OPENGL;
+#ifdef _WIN32
+	ovi.graphics_module = DL_D3D11;
+#endif
+	ovi.output_format = VIDEO_FORMAT_NV12;
+	ovi.base_width = cfg->width;
+	ovi.base_height = cfg->height;
+	ovi.output_width = cfg->width;
+	ovi.output_height = cfg->height;
+	ovi.colorspace = VIDEO_CS_709;
+	ovi.range = VIDEO_RANGE_PARTIAL;
+	ovi.scale_type = OBS_SCALE_BICUBIC;
+	ovi.gpu_conversion = true;
+
+	start = os_gettime_ns();
+	ret = obs_reset_video(&ovi);
+	if (ret != OBS_VIDEO_SUCCESS) {
+		fprintf(stderr, "obs_reset_video failed: %d\n", ret);
+		return false;
+	}
+	obs_data_set_double(results, "reset_video_ms", ms_since(start));
+
+	oai.samples_per_sec = 48000;
+	oai.speakers = SPEAKERS_STEREO;
+
+	start = os_gettime_ns();
+	if (!obs_reset_audio(&oai)) {
+		fprintf(stderr, "obs_reset_audio failed\n");
+		return false;
+	}
+	obs_data_set_double(results, "reset_audio_ms", ms_since(start));
+
+	if (cfg->module_bin)
+		obs_add_module_path(cfg->module_bin, cfg->module_data);
+
+	start = os_gettime_ns();
+	obs_load_all_modules();
+	obs_post_load_modules();
+	obs_data_set_double(results, "load_modules_ms", ms_since(start));
+
+	if (cfg->collection) {
+		sources = load_collection_sources(cfg->collection, &scene_name);
+		if (!sources) {
+			fprintf(stderr, "Failed to read '%s'\n",
+				cfg->collection);
+			bfree((void *)scene_name);
+			return false;
+		}
+	} else {
+		struct dstr name = {0};
+
+		sources = create_collection(cfg);
+		dstr_printf(&name, "scene %d", cfg->depth - 1);
+		scene_name = name.array;
+	}
+
+	start = os_gettime_ns();
+	obs_load_sources(sources, NULL, NULL);
+	obs_data_set_double(results, "load_collection_ms", ms_since(start));
+	obs_data_array_release(sources);
+
+	scene = obs_get_source_by_name(scene_name);
+	bfree((void *)scene_name);
+	if (!scene) {
+		fprintf(stderr, "No scene to render\n");
+		return false;
+	}
+
+	obs_set_output_source(0, scene);
+
+	frames = obs_data_create();
+	if (!render_frames(cfg, frames)) {
+		obs_data_release(frames);
+		obs_source_release(scene);
+		return false;
+	}
+	obs_data_set_obj(results, "render", frames);
+	obs_data_release(frames);
+
+	obs_set_output_source(0, NULL);
+	obs_source_release(scene);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_config cfg = {
+		.sources = 20,
+		.depth = 3,
+		.filters = 2,
+		.frames = 300,
+		.width = 1920,
+		.height = 1080,
+		.fps = 60,
+	};
+	profiler_name_store_t *store;
+	obs_data_t *results;
+	obs_data_t *config;
+	bool success;
+	uint64_t start;
+
+	if (!parse_args(&cfg, argc, argv)) {
+		fprintf(stderr, "%s", usage);
+		return 1;
+	}
+
+	store = profiler_name_store_create();
+	profiler_start();
+
+	results = obs_data_create();
+	config = config_results(&cfg);
+	obs_data_set_string(results, "version", obs_get_version_string());
+	obs_data_set_obj(results, "config", config);
+	obs_data_release(config);
+
+	success = run(&cfg, store, results);
+
+	start = os_gettime_ns();
+	obs_shutdown();
+	obs_data_set_double(results, "shutdown_ms", ms_since(start));
+
+	if (success) {
+		if (cfg.output)
+			success = obs_data_save_json(results, cfg.output);
+		else
+			printf("%s\n", obs_data_get_json(results));
+	}
+
+	obs_data_release(results);
+	profiler_stop();
+	profiler_free();
+	profiler_name_store_free(store);
+	return success ? 0 : 1;
+}
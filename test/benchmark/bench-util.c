@@ -0,0 +1,910 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <obs-data.h>
+#include <callback/calldata.h>
+#include <callback/proc.h>
+#include <callback/signal.h>
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/circlebuf.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+/*
+ * Times the containers and the callback system the hot paths are built on,
+ * single threaded and under contention.  Nothing needs obs_startup, so the
+ * numbers only depend on libobs/util, libobs/callback and obs-data.
+ *
+ * Each workload runs a fixed number of operations, --repeat times, and the
+ * fastest and the median run are reported in nanoseconds per operation.
+ * The contention tests divide the wall time by the operations of all the
+ * threads.  Compare builds with the same --scale and --threads.
+ */
+
+static const char *usage =
+	"usage: bench-util [options]\n"
+	"  --filter STR    only run the workloads with STR in their name\n"
+	"  --scale N       multiply the operation counts by N (default 1)\n"
+	"  --repeat N      runs of each workload (default 5)\n"
+	"  --threads N     threads of the contention tests\n"
+	"                  (default: logical cores, at most 8)\n"
+	"  --output FILE   also write the results to FILE as JSON\n";
+
+struct bench_config {
+	const char *filter;
+	double scale;
+	int repeat;
+	int threads;
+	const char *output;
+};
+
+struct workload {
+	const char *name;
+	/* runs `count` operations, returns the operations done */
+	uint64_t (*run)(uint64_t count);
+	uint64_t count;
+};
+
+static struct bench_config config;
+
+/* keeps the compiler from dropping results nobody reads */
+static volatile uint64_t sink;
+
+/* ------------------------------------------------------------------------- */
+/* circlebuf */
+
+#define AUDIO_CHUNK 480
+#define AUDIO_TICK 1024
+
+/* an async source's audio: device sized chunks in, ticks worth out */
+static uint64_t bench_circlebuf_audio(uint64_t count)
+{
+	struct circlebuf cb = {0};
+	float in[AUDIO_CHUNK] = {0};
+	float out[AUDIO_TICK];
+
+	for (uint64_t i = 0; i < count; i++) {
+		in[0] = (float)i;
+		circlebuf_push_back(&cb, in, sizeof(in));
+
+		while (cb.size >= sizeof(out)) {
+			circlebuf_pop_front(&cb, out, sizeof(out));
+			sink += (uint64_t)out[0];
+		}
+	}
+
+	circlebuf_free(&cb);
+	return count;
+}
+
+/* the same, written and read in place the way the audio mix does */
+static uint64_t bench_circlebuf_audio_inplace(uint64_t count)
+{
+	struct circlebuf cb = {0};
+
+	for (uint64_t i = 0; i < count; i++) {
+		size_t size = AUDIO_CHUNK * sizeof(float);
+		float *in = circlebuf_reserve_write(&cb, size);
+
+		memset(in, 0, size);
+		in[0] = (float)i;
+		circlebuf_commit_write(&cb, size);
+
+		while (cb.size >= AUDIO_TICK * sizeof(float)) {
+			size = AUDIO_TICK * sizeof(float);
+			float *out = circlebuf_peek_contiguous(&cb, size);
+			sink += (uint64_t)out[0];
+			circlebuf_pop_front(&cb, NULL, size);
+		}
+	}
+
+	circlebuf_free(&cb);
+	return count;
+}
+
+struct packet {
+	uint8_t *data;
+	size_t size;
+	int64_t pts;
+	int64_t dts;
+	int32_t timebase_num;
+	int32_t timebase_den;
+	int type;
+	bool keyframe;
+	int64_t dts_usec;
+	int64_t sys_dts_usec;
+	int priority;
+	int drop_priority;
+	size_t track_idx;
+	void *encoder;
+};
+
+#define PACKET_QUEUE 64
+
+/* an output's interleaving queue: packets pushed, the oldest looked at and
+ * sent once enough are queued */
+static uint64_t bench_circlebuf_packets(uint64_t count)
+{
+	struct circlebuf cb = {0};
+	struct packet pkt = {0};
+
+	for (uint64_t i = 0; i < count; i++) {
+		pkt.dts = (int64_t)i;
+		circlebuf_push_back(&cb, &pkt, sizeof(pkt));
+
+		if (cb.size > PACKET_QUEUE * sizeof(pkt)) {
+			struct packet *last = circlebuf_data(
+				&cb, cb.size - sizeof(*last));
+			struct packet first;
+
+			circlebuf_pop_front(&cb, &first, sizeof(first));
+			sink += (uint64_t)(last->dts - first.dts);
+		}
+	}
+
+	circlebuf_free(&cb);
+	return count;
+}
+
+/* ------------------------------------------------------------------------- */
+/* darray */
+
+static uint64_t bench_darray_push(uint64_t count)
+{
+	DARRAY(int64_t) arr;
+
+	da_init(arr);
+	for (uint64_t i = 0; i < count; i++) {
+		int64_t val = (int64_t)i;
+		da_push_back(arr, &val);
+
+		if (arr.num == 4096) {
+			sink += (uint64_t)arr.array[arr.num - 1];
+			da_resize(arr, 0);
+		}
+	}
+
+	da_free(arr);
+	return count;
+}
+
+/* the source lists: insert in the middle, find, erase */
+static uint64_t bench_darray_insert_erase(uint64_t count)
+{
+	DARRAY(void *) arr;
+
+	da_init(arr);
+	for (uintptr_t i = 0; i < 256; i++) {
+		void *val = (void *)i;
+		da_push_back(arr, &val);
+	}
+
+	for (uint64_t i = 0; i < count; i++) {
+		void *val = (void *)(uintptr_t)(1000 + i);
+		size_t idx;
+
+		da_insert(arr, arr.num / 2, &val);
+		idx = da_find(arr, &val, 0);
+		da_erase(arr, idx);
+		sink += idx;
+	}
+
+	da_free(arr);
+	return count;
+}
+
+/* ------------------------------------------------------------------------- */
+/* dstr */
+
+static uint64_t bench_dstr_printf(uint64_t count)
+{
+	struct dstr str = {0};
+
+	for (uint64_t i = 0; i < count; i++) {
+		dstr_printf(&str, "%s: %d frames, %.2f ms", "source",
+			    (int)(i & 0xFFFF), (double)i * 0.01);
+		sink += str.len;
+	}
+
+	dstr_free(&str);
+	return count;
+}
+
+static uint64_t bench_dstr_cat_replace(uint64_t count)
+{
+	struct dstr str = {0};
+
+	for (uint64_t i = 0; i < count; i++) {
+		dstr_copy(&str, "%APPDATA%/obs-studio");
+		dstr_cat(&str, "/basic/scenes/");
+		dstr_cat(&str, "Untitled.json");
+		dstr_replace(&str, "%APPDATA%", "/home/user/.config");
+		sink += str.len;
+	}
+
+	dstr_free(&str);
+	return count;
+}
+
+/* ------------------------------------------------------------------------- */
+/* calldata */
+
+static inline void set_get_params(calldata_t *cd, uint64_t i)
+{
+	long long ival = 0;
+	void *ptr = NULL;
+	const char *str = NULL;
+	double fval = 0.0;
+
+	calldata_set_ptr(cd, "source", (void *)(uintptr_t)i);
+	calldata_set_int(cd, "volume", (long long)i);
+	calldata_set_string(cd, "name", "Mic/Aux");
+	calldata_set_float(cd, "db", -6.0);
+
+	calldata_get_ptr(cd, "source", &ptr);
+	calldata_get_int(cd, "volume", &ival);
+	calldata_get_string(cd, "name", &str);
+	calldata_get_float(cd, "db", &fval);
+
+	sink += (uint64_t)(uintptr_t)ptr + (uint64_t)ival + (str ? 1 : 0) +
+		(uint64_t)fval;
+}
+
+static uint64_t bench_calldata_heap(uint64_t count)
+{
+	for (uint64_t i = 0; i < count; i++) {
+		calldata_t cd;
+
+		calldata_init(&cd);
+		set_get_params(&cd, i);
+		calldata_free(&cd);
+	}
+
+	return count;
+}
+
+static uint64_t bench_calldata_stack(uint64_t count)
+{
+	for (uint64_t i = 0; i < count; i++) {
+		uint8_t stack[256];
+		calldata_t cd;
+
+		calldata_init_stack(&cd, stack, sizeof(stack));
+		set_get_params(&cd, i);
+		calldata_free(&cd);
+	}
+
+	return count;
+}
+
+/* the same parameters added and read back by position */
+static uint64_t bench_calldata_positions(uint64_t count)
+{
+	for (uint64_t i = 0; i < count; i++) {
+		uint8_t stack[256];
+		calldata_t cd;
+		long long ival = 0;
+		void *ptr = NULL;
+		size_t ptr_pos, int_pos;
+
+		calldata_init_stack(&cd, stack, sizeof(stack));
+		ptr_pos = calldata_add_ptr(&cd, "source", (void *)(uintptr_t)i);
+		int_pos = calldata_add_int(&cd, "volume", (long long)i);
+
+		calldata_get_data_at(&cd, ptr_pos, &ptr, sizeof(ptr));
+		calldata_get_data_at(&cd, int_pos, &ival, sizeof(ival));
+		sink += (uint64_t)(uintptr_t)ptr + (uint64_t)ival;
+		calldata_free(&cd);
+	}
+
+	return count;
+}
+
+/* ------------------------------------------------------------------------- */
+/* signals and procedures */
+
+static void bench_callback(void *data, calldata_t *cd)
+{
+	long long val = 0;
+	calldata_get_int(cd, "value", &val);
+	sink += (uint64_t)val + (uint64_t)(uintptr_t)data;
+}
+
+static signal_handler_t *create_signals(int handlers)
+{
+	signal_handler_t *sh = signal_handler_create();
+
+	signal_handler_add(sh, "void volume(ptr source, int value)");
+	signal_handler_add(sh, "void mute(ptr source, bool muted)");
+	signal_handler_add(sh, "void rename(ptr source, string new_name)");
+
+	for (int i = 0; i < handlers; i++)
+		signal_handler_connect(sh, "volume", bench_callback,
+				       (void *)(uintptr_t)i);
+
+	return sh;
+}
+
+static uint64_t emit_signals(uint64_t count, int handlers, bool by_handle)
+{
+	signal_handler_t *sh = create_signals(handlers);
+	signal_handle_t *handle = signal_handler_get_handle(sh, "volume");
+	uint8_t stack[128];
+	calldata_t cd;
+
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	calldata_set_ptr(&cd, "source", NULL);
+
+	for (uint64_t i = 0; i < count; i++) {
+		calldata_set_int(&cd, "value", (long long)i);
+
+		if (by_handle)
+			signal_handler_signal_handle(sh, handle, &cd);
+		else
+			signal_handler_signal(sh, "volume", &cd);
+	}
+
+	signal_handler_destroy(sh);
+	return count;
+}
+
+static uint64_t bench_signal_emit_0(uint64_t count)
+{
+	return emit_signals(count, 0, false);
+}
+
+static uint64_t bench_signal_emit_1(uint64_t count)
+{
+	return emit_signals(count, 1, false);
+}
+
+static uint64_t bench_signal_emit_16(uint64_t count)
+{
+	return emit_signals(count, 16, false);
+}
+
+static uint64_t bench_signal_emit_256(uint64_t count)
+{
+	return emit_signals(count, 256, false);
+}
+
+static uint64_t bench_signal_handle_16(uint64_t count)
+{
+	return emit_signals(count, 16, true);
+}
+
+/* connecting and disconnecting among 64 other callbacks */
+static uint64_t bench_signal_connect(uint64_t count)
+{
+	signal_handler_t *sh = create_signals(64);
+
+	for (uint64_t i = 0; i < count; i++) {
+		void *data = (void *)(uintptr_t)(1000 + (i & 15));
+
+		signal_handler_connect(sh, "mute", bench_callback, data);
+		signal_handler_disconnect(sh, "mute", bench_callback, data);
+	}
+
+	signal_handler_destroy(sh);
+	return count;
+}
+
+#define PROCS 32
+
+static uint64_t bench_proc_call(uint64_t count)
+{
+	proc_handler_t *ph = proc_handler_create();
+	char names[PROCS][32];
+	uint8_t stack[128];
+	calldata_t cd;
+
+	for (int i = 0; i < PROCS; i++) {
+		struct dstr decl = {0};
+
+		snprintf(names[i], sizeof(names[i]), "proc_%d", i);
+		dstr_printf(&decl, "void %s(int value)", names[i]);
+		proc_handler_add(ph, decl.array, bench_callback, NULL);
+		dstr_free(&decl);
+	}
+
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+
+	for (uint64_t i = 0; i < count; i++) {
+		calldata_set_int(&cd, "value", (long long)i);
+		proc_handler_call(ph, names[i % PROCS], &cd);
+	}
+
+	proc_handler_destroy(ph);
+	return count;
+}
+
+/* ------------------------------------------------------------------------- */
+/* obs_data */
+
+static const char *setting_names[] = {
+	"width",  "height", "fps",   "bitrate", "preset", "profile",
+	"tune",   "x264opts", "url", "key",     "volume", "muted",
+	"locked", "visible",  "name", "id",
+};
+
+#define SETTINGS (sizeof(setting_names) / sizeof(*setting_names))
+
+static uint64_t bench_data_set_get(uint64_t count)
+{
+	obs_data_t *data = obs_data_create();
+
+	for (uint64_t i = 0; i < count; i++) {
+		for (size_t j = 0; j < SETTINGS; j++)
+			obs_data_set_int(data, setting_names[j], (long long)i);
+		for (size_t j = 0; j < SETTINGS; j++)
+			sink += (uint64_t)obs_data_get_int(data,
+							   setting_names[j]);
+	}
+
+	obs_data_release(data);
+	return count * SETTINGS * 2;
+}
+
+#define COLLECTION_ITEMS 2000
+
+/* looks like a scene collection: an array of sources with settings */
+static obs_data_t *create_collection(void)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+
+	for (int i = 0; i < COLLECTION_ITEMS; i++) {
+		obs_data_t *source = obs_data_create();
+		obs_data_t *settings = obs_data_create();
+		char name[32];
+
+		snprintf(name, sizeof(name), "Source %d", i);
+		obs_data_set_string(source, "name", name);
+		obs_data_set_string(source, "id", "image_source");
+		obs_data_set_bool(source, "enabled", true);
+		obs_data_set_double(source, "volume", 1.0);
+		obs_data_set_int(source, "mixers", 255);
+
+		obs_data_set_string(settings, "file", "/tmp/image.png");
+		obs_data_set_int(settings, "width", 1920);
+		obs_data_set_int(settings, "height", 1080);
+		obs_data_set_obj(source, "settings", settings);
+
+		obs_data_array_push_back(sources, source);
+		obs_data_release(settings);
+		obs_data_release(source);
+	}
+
+	obs_data_set_string(data, "name", "Untitled");
+	obs_data_set_array(data, "sources", sources);
+	obs_data_array_release(sources);
+	return data;
+}
+
+static uint64_t bench_data_build(uint64_t count)
+{
+	for (uint64_t i = 0; i < count; i++)
+		obs_data_release(create_collection());
+
+	return count * COLLECTION_ITEMS;
+}
+
+static uint64_t bench_data_save_json(uint64_t count)
+{
+	obs_data_t *data = create_collection();
+
+	for (uint64_t i = 0; i < count; i++) {
+		/* each call serializes the whole collection again */
+		sink += strlen(obs_data_get_json(data));
+	}
+
+	obs_data_release(data);
+	return count * COLLECTION_ITEMS;
+}
+
+static uint64_t bench_data_load_json(uint64_t count)
+{
+	obs_data_t *data = create_collection();
+	char *json = bstrdup(obs_data_get_json(data));
+
+	obs_data_release(data);
+
+	for (uint64_t i = 0; i < count; i++) {
+		data = obs_data_create_from_json(json);
+		obs_data_array_t *sources = obs_data_get_array(data, "sources");
+
+		sink += obs_data_array_count(sources);
+		obs_data_array_release(sources);
+		obs_data_release(data);
+	}
+
+	bfree(json);
+	return count * COLLECTION_ITEMS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* bmem */
+
+#define LIVE_ALLOCS 64
+
+static uint64_t alloc_pattern(uint64_t count, size_t max_size)
+{
+	void *live[LIVE_ALLOCS] = {0};
+	uint32_t random = 1;
+
+	for (uint64_t i = 0; i < count; i++) {
+		size_t slot = i % LIVE_ALLOCS;
+
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+
+		bfree(live[slot]);
+		live[slot] = bmalloc(16 + random % max_size);
+		*(uint8_t *)live[slot] = (uint8_t)i;
+	}
+
+	for (size_t i = 0; i < LIVE_ALLOCS; i++)
+		bfree(live[i]);
+
+	return count;
+}
+
+static uint64_t bench_bmem_small(uint64_t count)
+{
+	return alloc_pattern(count, 256);
+}
+
+static uint64_t bench_bmem_mixed(uint64_t count)
+{
+	return alloc_pattern(count, 64 * 1024);
+}
+
+/* ------------------------------------------------------------------------- */
+/* contention */
+
+struct contention {
+	signal_handler_t *sh;
+	signal_handle_t *handle;
+
+	pthread_mutex_t mutex;
+	struct circlebuf queue;
+	os_sem_t *queued;
+
+	uint64_t ops_per_thread;
+	volatile bool stop;
+	volatile long long ops;
+};
+
+typedef void *(*thread_func_t)(void *);
+
+/* runs the threads to completion, returns the operations done */
+static uint64_t run_threads(struct contention *c, int count,
+			    thread_func_t func, thread_func_t extra)
+{
+	pthread_t *threads = bzalloc(sizeof(pthread_t) * count);
+	pthread_t extra_thread;
+	int started = 0;
+
+	if (extra && pthread_create(&extra_thread, NULL, extra, c) != 0)
+		extra = NULL;
+
+	for (int i = 0; i < count; i++) {
+		if (pthread_create(&threads[i], NULL, func, c) == 0)
+			started++;
+		else
+			break;
+	}
+
+	for (int i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	if (extra) {
+		os_atomic_set_bool(&c->stop, true);
+		pthread_join(extra_thread, NULL);
+	}
+
+	bfree(threads);
+	return (uint64_t)os_atomic_load_long_long(&c->ops);
+}
+
+static void *signal_emitter(void *param)
+{
+	struct contention *c = param;
+	uint8_t stack[128];
+	calldata_t cd;
+
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	calldata_set_ptr(&cd, "source", NULL);
+	calldata_set_int(&cd, "value", 1);
+
+	for (uint64_t i = 0; i < c->ops_per_thread; i++)
+		signal_handler_signal_handle(c->sh, c->handle, &cd);
+
+	os_atomic_add_long_long(&c->ops, (long long)c->ops_per_thread);
+	return NULL;
+}
+
+static void *signal_connector(void *param)
+{
+	struct contention *c = param;
+
+	while (!os_atomic_load_bool(&c->stop)) {
+		signal_handler_connect(c->sh, "volume", bench_callback, c);
+		signal_handler_disconnect(c->sh, "volume", bench_callback, c);
+	}
+
+	return NULL;
+}
+
+/* like sources emitting while the frontend connects and disconnects */
+static uint64_t bench_mt_signal_emit(uint64_t count)
+{
+	struct contention c = {0};
+	uint64_t ops;
+
+	c.sh = create_signals(16);
+	c.handle = signal_handler_get_handle(c.sh, "volume");
+	c.ops_per_thread = count / (uint64_t)config.threads;
+
+	ops = run_threads(&c, config.threads, signal_emitter,
+			  signal_connector);
+
+	signal_handler_destroy(c.sh);
+	return ops;
+}
+
+static void *allocator(void *param)
+{
+	struct contention *c = param;
+	alloc_pattern(c->ops_per_thread, 1024);
+	os_atomic_add_long_long(&c->ops, (long long)c->ops_per_thread);
+	return NULL;
+}
+
+static uint64_t bench_mt_bmem(uint64_t count)
+{
+	struct contention c = {0};
+
+	c.ops_per_thread = count / (uint64_t)config.threads;
+	return run_threads(&c, config.threads, allocator, NULL);
+}
+
+static void *packet_producer(void *param)
+{
+	struct contention *c = param;
+	struct packet pkt = {0};
+
+	for (uint64_t i = 0; i < c->ops_per_thread; i++) {
+		pkt.dts = (int64_t)i;
+
+		pthread_mutex_lock(&c->mutex);
+		circlebuf_push_back(&c->queue, &pkt, sizeof(pkt));
+		pthread_mutex_unlock(&c->mutex);
+
+		os_sem_post(c->queued);
+	}
+
+	return NULL;
+}
+
+static void *packet_consumer(void *param)
+{
+	struct contention *c = param;
+	struct packet pkt;
+
+	for (uint64_t i = 0; i < c->ops_per_thread; i++) {
+		os_sem_wait(c->queued);
+
+		pthread_mutex_lock(&c->mutex);
+		circlebuf_pop_front(&c->queue, &pkt, sizeof(pkt));
+		pthread_mutex_unlock(&c->mutex);
+
+		sink += (uint64_t)pkt.dts;
+	}
+
+	os_atomic_add_long_long(&c->ops, (long long)c->ops_per_thread);
+	return NULL;
+}
+
+/* thread pairs sharing one locked packet queue, as encoders share the
+ * interleaving queue of an output */
+static void *producer_consumer(void *param)
+{
+	struct contention *c = param;
+	pthread_t producer;
+
+	if (pthread_create(&producer, NULL, packet_producer, c) != 0)
+		return NULL;
+
+	packet_consumer(c);
+	pthread_join(producer, NULL);
+	return NULL;
+}
+
+static uint64_t bench_mt_circlebuf(uint64_t count)
+{
+	struct contention c = {0};
+	int pairs = config.threads > 1 ? config.threads / 2 : 1;
+	uint64_t ops = 0;
+
+	if (pthread_mutex_init(&c.mutex, NULL) != 0)
+		return 0;
+	if (os_sem_init(&c.queued, 0) != 0) {
+		pthread_mutex_destroy(&c.mutex);
+		return 0;
+	}
+
+	c.ops_per_thread = count / (uint64_t)pairs;
+	ops = run_threads(&c, pairs, producer_consumer, NULL);
+
+	circlebuf_free(&c.queue);
+	os_sem_destroy(c.queued);
+	pthread_mutex_destroy(&c.mutex);
+	return ops;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const struct workload workloads[] = {
+	{"circlebuf audio", bench_circlebuf_audio, 2000000},
+	{"circlebuf audio in place", bench_circlebuf_audio_inplace, 2000000},
+	{"circlebuf packets", bench_circlebuf_packets, 5000000},
+	{"darray push", bench_darray_push, 20000000},
+	{"darray insert/find/erase", bench_darray_insert_erase, 1000000},
+	{"dstr printf", bench_dstr_printf, 2000000},
+	{"dstr cat/replace", bench_dstr_cat_replace, 2000000},
+	{"calldata heap", bench_calldata_heap, 2000000},
+	{"calldata stack", bench_calldata_stack, 2000000},
+	{"calldata positions", bench_calldata_positions, 5000000},
+	{"signal emit 0 handlers", bench_signal_emit_0, 5000000},
+	{"signal emit 1 handler", bench_signal_emit_1, 5000000},
+	{"signal emit 16 handlers", bench_signal_emit_16, 1000000},
+	{"signal emit 256 handlers", bench_signal_emit_256, 100000},
+	{"signal handle 16 handlers", bench_signal_handle_16, 1000000},
+	{"signal connect/disconnect", bench_signal_connect, 2000000},
+	{"proc call", bench_proc_call, 2000000},
+	{"obs_data set/get", bench_data_set_get, 200000},
+	{"obs_data build", bench_data_build, 20},
+	{"obs_data save json", bench_data_save_json, 20},
+	{"obs_data load json", bench_data_load_json, 20},
+	{"bmem small", bench_bmem_small, 10000000},
+	{"bmem mixed", bench_bmem_mixed, 2000000},
+	{"mt signal emit", bench_mt_signal_emit, 2000000},
+	{"mt bmem", bench_mt_bmem, 10000000},
+	{"mt circlebuf", bench_mt_circlebuf, 2000000},
+};
+
+static int compare_double(const void *a, const void *b)
+{
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+static void run_workload(const struct workload *w, obs_data_array_t *results)
+{
+	uint64_t count = (uint64_t)((double)w->count * config.scale);
+	double *runs = bzalloc(sizeof(double) * config.repeat);
+	double best, median;
+	obs_data_t *result;
+
+	if (!count)
+		count = 1;
+
+	for (int i = 0; i < config.repeat; i++) {
+		uint64_t start = os_gettime_ns();
+		uint64_t ops = w->run(count);
+		uint64_t elapsed = os_gettime_ns() - start;
+
+		runs[i] = ops ? (double)elapsed / (double)ops : 0.0;
+	}
+
+	qsort(runs, config.repeat, sizeof(double), compare_double);
+	best = runs[0];
+	median = runs[config.repeat / 2];
+
+	printf("%-28s %12.1f %12.1f %10.2f\n", w->name, best, median,
+	       best > 0.0 ? 1000.0 / best : 0.0);
+
+	result = obs_data_create();
+	obs_data_set_string(result, "name", w->name);
+	obs_data_set_double(result, "best_ns", best);
+	obs_data_set_double(result, "median_ns", median);
+	obs_data_array_push_back(results, result);
+	obs_data_release(result);
+
+	bfree(runs);
+}
+
+static bool parse_args(int argc, char *argv[])
+{
+	int cores = os_get_logical_cores();
+
+	config.scale = 1.0;
+	config.repeat = 5;
+	config.threads = cores > 8 ? 8 : (cores > 1 ? cores : 2);
+
+	for (int i = 1; i < argc; i++) {
+		bool has_value = i + 1 < argc;
+
+		if (has_value && strcmp(argv[i], "--filter") == 0) {
+			config.filter = argv[++i];
+		} else if (has_value && strcmp(argv[i], "--scale") == 0) {
+			config.scale = atof(argv[++i]);
+		} else if (has_value && strcmp(argv[i], "--repeat") == 0) {
+			config.repeat = atoi(argv[++i]);
+		} else if (has_value && strcmp(argv[i], "--threads") == 0) {
+			config.threads = atoi(argv[++i]);
+		} else if (has_value && strcmp(argv[i], "--output") == 0) {
+			config.output = argv[++i];
+		} else {
+			fprintf(stderr, "unknown option '%s'\n%s", argv[i],
+				usage);
+			return false;
+		}
+	}
+
+	if (config.scale <= 0.0 || config.repeat <= 0 ||
+	    config.threads <= 0) {
+		fprintf(stderr, "scale, repeat and threads must be positive\n");
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	obs_data_t *root, *cfg;
+	obs_data_array_t *results;
+	size_t count = sizeof(workloads) / sizeof(*workloads);
+	int ret = 0;
+
+	if (!parse_args(argc, argv))
+		return 1;
+
+	root = obs_data_create();
+	cfg = obs_data_create();
+	results = obs_data_array_create();
+
+	obs_data_set_double(cfg, "scale", config.scale);
+	obs_data_set_int(cfg, "repeat", config.repeat);
+	obs_data_set_int(cfg, "threads", config.threads);
+
+	printf("scale %g, %d runs, %d threads\n", config.scale, config.repeat,
+	       config.threads);
+	printf("%-28s %12s %12s %10s\n", "workload", "best ns/op",
+	       "median ns/op", "Mops/s");
+
+	for (size_t i = 0; i < count; i++) {
+		if (config.filter && !strstr(workloads[i].name, config.filter))
+			continue;
+		run_workload(&workloads[i], results);
+	}
+
+	obs_data_set_int(root, "version", 1);
+	obs_data_set_obj(root, "config", cfg);
+	obs_data_set_array(root, "results", results);
+
+	if (config.output && !obs_data_save_json(root, config.output)) {
+		fprintf(stderr, "failed to write '%s'\n", config.output);
+		ret = 1;
+	}
+
+	obs_data_array_release(results);
+	obs_data_release(cfg);
+	obs_data_release(root);
+
+	if (bnum_allocs() != 0) {
+		fprintf(stderr, "memory leak: %ld allocations left\n",
+			bnum_allocs());
+		ret = 1;
+	}
+
+	return ret;
+}
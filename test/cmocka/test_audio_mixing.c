@@ -0,0 +1,100 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+
+#include <media-io/audio-mixing.h>
+
+/* odd count so both the vector loop and the scalar tail are exercised */
+#define TEST_SAMPLES 1027
+
+static void fill(float *data, float scale)
+{
+	for (size_t i = 0; i < TEST_SAMPLES; i++)
+		data[i] = scale * (float)((int)(i % 37) - 18) / 9.0f;
+}
+
+/* compilers may contract the reference into FMA, so allow a tiny error */
+static void assert_samples_equal(const float *a, const float *b)
+{
+	for (size_t i = 0; i < TEST_SAMPLES; i++)
+		assert_true(fabsf(a[i] - b[i]) < 1e-6f);
+}
+
+static void mix_add_test(void **state)
+{
+	float dst[TEST_SAMPLES], src[TEST_SAMPLES], gain[TEST_SAMPLES];
+	float expected[TEST_SAMPLES];
+
+	fill(dst, 0.5f);
+	fill(src, 0.25f);
+	fill(gain, 0.125f);
+
+	for (size_t i = 0; i < TEST_SAMPLES; i++)
+		expected[i] = dst[i] + src[i];
+	audio_mix_add(dst, src, TEST_SAMPLES);
+	assert_samples_equal(dst, expected);
+
+	for (size_t i = 0; i < TEST_SAMPLES; i++)
+		expected[i] = dst[i] + src[i] * 0.5f;
+	audio_mix_add_gain(dst, src, 0.5f, TEST_SAMPLES);
+	assert_samples_equal(dst, expected);
+
+	for (size_t i = 0; i < TEST_SAMPLES; i++)
+		expected[i] = dst[i] + src[i] * gain[i];
+	audio_mix_add_mul(dst, src, gain, TEST_SAMPLES);
+	assert_samples_equal(dst, expected);
+
+	(void)state;
+}
+
+static void mix_scale_test(void **state)
+{
+	float data[TEST_SAMPLES], gain[TEST_SAMPLES];
+	float expected[TEST_SAMPLES];
+
+	fill(data, 1.0f);
+	fill(gain, 0.5f);
+
+	for (size_t i = 0; i < TEST_SAMPLES; i++)
+		expected[i] = data[i] * 0.75f;
+	audio_mix_scale(data, 0.75f, TEST_SAMPLES);
+	assert_samples_equal(data, expected);
+
+	for (size_t i = 0; i < TEST_SAMPLES; i++)
+		expected[i] = data[i] * gain[i];
+	audio_mix_mul(data, gain, TEST_SAMPLES);
+	assert_samples_equal(data, expected);
+
+	(void)state;
+}
+
+static void mix_clamp_test(void **state)
+{
+	float data[TEST_SAMPLES];
+
+	fill(data, 2.0f);
+	audio_mix_clamp(data, TEST_SAMPLES);
+
+	for (size_t i = 0; i < TEST_SAMPLES; i++) {
+		float val = 2.0f * (float)((int)(i % 37) - 18) / 9.0f;
+		val = (val > 1.0f) ? 1.0f : val;
+		val = (val < -1.0f) ? -1.0f : val;
+		assert_true(data[i] == val);
+	}
+
+	(void)state;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(mix_add_test),
+		cmocka_unit_test(mix_scale_test),
+		cmocka_unit_test(mix_clamp_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,157 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+
+#include <media-io/audio-repack.h>
+
+/* odd count so both the vector loops and the scalar tails are exercised */
+#define TEST_FRAMES 1027
+
+static void fill(float *data, size_t count, float scale)
+{
+	for (size_t i = 0; i < count; i++)
+		data[i] = scale * (float)((int)(i % 37) - 18) / 9.0f;
+}
+
+static void interleave_test(void **state)
+{
+	static float planes[6][TEST_FRAMES];
+	static float interleaved[6 * TEST_FRAMES];
+	static float out[6][TEST_FRAMES];
+	float *dst[6];
+	const float *src[6];
+
+	for (size_t c = 0; c < 6; c++) {
+		fill(planes[c], TEST_FRAMES, (float)(c + 1) * 0.125f);
+		src[c] = planes[c];
+		dst[c] = out[c];
+	}
+
+	/* stereo has its own vector path, other channel counts don't */
+	for (size_t channels = 1; channels <= 6; channels++) {
+		audio_interleave_float(interleaved, src, channels, TEST_FRAMES);
+
+		for (size_t i = 0; i < TEST_FRAMES; i++)
+			for (size_t c = 0; c < channels; c++)
+				assert_true(interleaved[i * channels + c] ==
+					    planes[c][i]);
+
+		audio_deinterleave_float(dst, interleaved, channels,
+					 TEST_FRAMES);
+
+		for (size_t c = 0; c < channels; c++)
+			for (size_t i = 0; i < TEST_FRAMES; i++)
+				assert_true(out[c][i] == planes[c][i]);
+	}
+
+	(void)state;
+}
+
+static void s16_test(void **state)
+{
+	float src[TEST_FRAMES], back[TEST_FRAMES];
+	int16_t dst[TEST_FRAMES];
+
+	fill(src, TEST_FRAMES, 1.5f);
+	audio_float_to_s16(dst, src, TEST_FRAMES);
+
+	for (size_t i = 0; i < TEST_FRAMES; i++) {
+		float val = src[i];
+		val = (val > 1.0f) ? 1.0f : val;
+		val = (val < -1.0f) ? -1.0f : val;
+
+		long expected = lrintf(val * 32768.0f);
+		expected = expected > 32767 ? 32767 : expected;
+		assert_int_equal(dst[i], expected);
+	}
+
+	audio_s16_to_float(back, dst, TEST_FRAMES);
+
+	for (size_t i = 0; i < TEST_FRAMES; i++)
+		assert_true(back[i] == (float)dst[i] / 32768.0f);
+
+	(void)state;
+}
+
+static void s32_test(void **state)
+{
+	float src[TEST_FRAMES], back[TEST_FRAMES];
+	int32_t dst[TEST_FRAMES];
+
+	fill(src, TEST_FRAMES, 1.5f);
+	audio_float_to_s32(dst, src, TEST_FRAMES);
+
+	for (size_t i = 0; i < TEST_FRAMES; i++) {
+		if (src[i] >= 1.0f)
+			assert_true(dst[i] > 2147483000);
+		else if (src[i] <= -1.0f)
+			assert_true(dst[i] == INT32_MIN);
+		else
+			assert_true(dst[i] == (int32_t)(src[i] * 2147483648.0f));
+	}
+
+	audio_s32_to_float(back, dst, TEST_FRAMES);
+
+	for (size_t i = 0; i < TEST_FRAMES; i++) {
+		float val = src[i];
+		val = (val > 1.0f) ? 1.0f : val;
+		val = (val < -1.0f) ? -1.0f : val;
+		assert_true(fabsf(back[i] - val) < 1e-6f);
+	}
+
+	(void)state;
+}
+
+static void check_remap(const int16_t *src, size_t src_channels,
+			const uint8_t *map, size_t dst_channels)
+{
+	static int16_t dst[8 * TEST_FRAMES];
+
+	audio_remap_s16(dst, dst_channels, src, src_channels, map,
+			TEST_FRAMES);
+
+	for (size_t i = 0; i < TEST_FRAMES; i++)
+		for (size_t c = 0; c < dst_channels; c++)
+			assert_int_equal(dst[i * dst_channels + c],
+					 src[i * src_channels + map[c]]);
+}
+
+static void remap_test(void **state)
+{
+	static int16_t src[8 * TEST_FRAMES];
+	const uint8_t identity[] = {0, 1, 2, 3, 4, 5, 6, 7};
+	const uint8_t swapped[] = {0, 1, 3, 2, 4, 5, 6, 7};
+	const uint8_t reversed[] = {7, 6, 5, 4, 3, 2, 1, 0};
+
+	for (size_t i = 0; i < 8 * TEST_FRAMES; i++)
+		src[i] = (int16_t)(i * 31);
+
+	/* every layout capture cards can carry, with and without the
+	 * center/LFE swap, which take the 8 channel fast path */
+	for (size_t channels = 1; channels <= 8; channels++) {
+		check_remap(src, 8, identity, channels);
+		check_remap(src, 8, reversed, channels);
+		if (channels >= 4)
+			check_remap(src, 8, swapped, channels);
+	}
+
+	check_remap(src, 6, swapped, 6);
+	check_remap(src, 2, reversed + 6, 2);
+
+	(void)state;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(interleave_test),
+		cmocka_unit_test(s16_test),
+		cmocka_unit_test(s32_test),
+		cmocka_unit_test(remap_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
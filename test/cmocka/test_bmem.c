@@ -0,0 +1,219 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/threading.h>
+#include <callback/calldata.h>
+
+static void pool_alignment_test(void **state)
+{
+	void *ptrs[64];
+
+	for (size_t i = 0; i < 64; i++) {
+		ptrs[i] = bmalloc(i * 97 + 1);
+		assert_int_equal((uintptr_t)ptrs[i] % base_get_alignment(), 0);
+		memset(ptrs[i], (int)i, i * 97 + 1);
+	}
+
+	for (size_t i = 0; i < 64; i++) {
+		uint8_t *bytes = ptrs[i];
+		assert_int_equal(bytes[0], (uint8_t)i);
+		assert_int_equal(bytes[i * 97], (uint8_t)i);
+		bfree(ptrs[i]);
+	}
+}
+
+static void pool_realloc_test(void **state)
+{
+	uint8_t *ptr = bmalloc(20);
+	uint8_t *same;
+
+	for (int i = 0; i < 20; i++)
+		ptr[i] = (uint8_t)i;
+
+	/* still in the same size class */
+	same = brealloc(ptr, 30);
+	assert_ptr_equal(same, ptr);
+
+	/* up into another class, then past the largest one */
+	ptr = brealloc(ptr, 1000);
+	ptr = brealloc(ptr, 200000);
+	for (int i = 0; i < 20; i++)
+		assert_int_equal(ptr[i], (uint8_t)i);
+
+	ptr[199999] = 0xAB;
+	ptr = brealloc(ptr, 400000);
+	assert_int_equal(ptr[199999], 0xAB);
+
+	/* and back down */
+	ptr = brealloc(ptr, 10);
+	for (int i = 0; i < 10; i++)
+		assert_int_equal(ptr[i], (uint8_t)i);
+
+	bfree(ptr);
+}
+
+static void pool_reuse_test(void **state)
+{
+	void *ptr = bmalloc(100);
+	bfree(ptr);
+
+	/* the block that was just freed comes back from the magazine */
+	assert_ptr_equal(bmalloc(100), ptr);
+	bfree(ptr);
+}
+
+#define CROSS_BLOCKS 1000
+
+static void *alloc_thread(void *data)
+{
+	void **blocks = data;
+
+	for (int i = 0; i < CROSS_BLOCKS; i++)
+		blocks[i] = bmalloc((size_t)(i % 300) + 1);
+
+	return NULL;
+}
+
+static void pool_cross_thread_test(void **state)
+{
+	void **blocks = bzalloc(sizeof(void *) * CROSS_BLOCKS);
+	long allocs = bnum_allocs();
+	pthread_t thread;
+
+	pthread_create(&thread, NULL, alloc_thread, blocks);
+	pthread_join(thread, NULL);
+
+	assert_int_equal(bnum_allocs(), allocs + CROSS_BLOCKS);
+
+	for (int i = 0; i < CROSS_BLOCKS; i++)
+		bfree(blocks[i]);
+
+	assert_int_equal(bnum_allocs(), allocs);
+	bfree(blocks);
+}
+
+struct tag_result {
+	const char *name;
+	long long allocs;
+	long long bytes;
+};
+
+static void find_tag(void *param, const char *name, long long allocs,
+		     long long bytes)
+{
+	struct tag_result *result = param;
+
+	if (strcmp(name, result->name) == 0) {
+		result->allocs = allocs;
+		result->bytes = bytes;
+	}
+}
+
+static void pool_tag_test(void **state)
+{
+	struct tag_result result = {"test"};
+	int tag = bmem_register_tag("test");
+	int prev;
+	void *a, *b;
+
+	assert_true(tag > 0);
+	assert_int_equal(bmem_register_tag("test"), tag);
+
+	prev = bmem_set_thread_tag(tag);
+	a = bmalloc(100);
+	b = bmalloc(100000);
+	bmem_set_thread_tag(prev);
+
+	bmem_enum_tags(find_tag, &result);
+	assert_int_equal(result.allocs, 2);
+	assert_int_equal(result.bytes, 100100);
+
+	bfree(a);
+	bfree(b);
+
+	bmem_enum_tags(find_tag, &result);
+	assert_int_equal(result.allocs, 0);
+	assert_int_equal(result.bytes, 0);
+}
+
+static void pool_calldata_tag_test(void **state)
+{
+	struct tag_result result = {"calldata"};
+	calldata_t data;
+
+	calldata_init(&data);
+	calldata_set_int(&data, "int", 1);
+	calldata_set_string(&data, "string", "a string long enough to grow "
+					      "the calldata stack past the "
+					      "128 bytes it starts with");
+
+	bmem_enum_tags(find_tag, &result);
+	assert_int_equal(result.allocs, 1);
+	assert_true(result.bytes > 128);
+
+	calldata_free(&data);
+
+	bmem_enum_tags(find_tag, &result);
+	assert_int_equal(result.allocs, 0);
+}
+
+static void *free_thread(void *data)
+{
+	bfree(data);
+	return NULL;
+}
+
+static void pool_account_test(void **state)
+{
+	bmem_account_t *account = bmem_account_create();
+	bmem_account_t *prev;
+	pthread_t thread;
+	void *a, *b, *c;
+
+	prev = bmem_set_thread_account(account);
+	a = bmalloc(100);
+	b = bmalloc(100000);
+	assert_ptr_equal(bmem_set_thread_account(prev), account);
+
+	c = bmalloc(50);
+	assert_int_equal(bmem_account_get_bytes(account), 100100);
+
+	/* resized blocks stay on the account they were allocated under */
+	a = brealloc(a, 200);
+	b = brealloc(b, 50000);
+	assert_int_equal(bmem_account_get_bytes(account), 50200);
+
+	/* and are discharged wherever they are freed */
+	pthread_create(&thread, NULL, free_thread, b);
+	pthread_join(thread, NULL);
+	assert_int_equal(bmem_account_get_bytes(account), 200);
+
+	/* the account lives on until its last block is freed */
+	bmem_account_release(account);
+	bfree(a);
+	bfree(c);
+}
+
+int main()
+{
+	struct base_allocator pooled;
+	base_get_pooled_allocator(&pooled);
+	base_set_allocator(&pooled);
+
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(pool_alignment_test),
+		cmocka_unit_test(pool_realloc_test),
+		cmocka_unit_test(pool_reuse_test),
+		cmocka_unit_test(pool_cross_thread_test),
+		cmocka_unit_test(pool_tag_test),
+		cmocka_unit_test(pool_calldata_tag_test),
+		cmocka_unit_test(pool_account_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,119 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+#include <util/circlebuf.h>
+
+static void push_values(struct circlebuf *cb, uint8_t first, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		uint8_t val = (uint8_t)(first + i);
+		circlebuf_push_back(cb, &val, 1);
+	}
+}
+
+static void check_values(const uint8_t *data, uint8_t first, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		assert_int_equal(data[i], (uint8_t)(first + i));
+}
+
+static void reserve_write_test(void **state)
+{
+	struct circlebuf cb;
+	uint8_t *window;
+
+	circlebuf_init(&cb);
+	circlebuf_reserve(&cb, 16);
+
+	/* leave free space on both sides of the data */
+	push_values(&cb, 0, 12);
+	circlebuf_pop_front(&cb, NULL, 8);
+
+	/* doesn't fit at the back, so the data moves to the front */
+	window = circlebuf_reserve_write(&cb, 10);
+	assert_int_equal(cb.capacity, 16);
+	for (uint8_t i = 0; i < 10; i++)
+		window[i] = (uint8_t)(12 + i);
+	circlebuf_commit_write(&cb, 10);
+
+	assert_int_equal(cb.size, 14);
+	check_values(circlebuf_peek_contiguous(&cb, 14), 8, 14);
+
+	/* and this one only fits in a larger buffer */
+	window = circlebuf_reserve_write(&cb, 8);
+	assert_true(cb.capacity >= 22);
+	for (uint8_t i = 0; i < 8; i++)
+		window[i] = (uint8_t)(22 + i);
+	circlebuf_commit_write(&cb, 8);
+
+	check_values(circlebuf_peek_contiguous(&cb, 22), 8, 22);
+	circlebuf_free(&cb);
+}
+
+static void reserve_write_wrapped_test(void **state)
+{
+	struct circlebuf cb;
+	uint8_t *window;
+
+	circlebuf_init(&cb);
+	circlebuf_reserve(&cb, 16);
+
+	push_values(&cb, 0, 12);
+	circlebuf_pop_front(&cb, NULL, 10);
+	push_values(&cb, 12, 8);
+
+	/* wrapped, with the free space between the end and the start */
+	assert_true(cb.end_pos < cb.start_pos);
+
+	window = circlebuf_reserve_write(&cb, 4);
+	assert_int_equal(cb.capacity, 16);
+	for (uint8_t i = 0; i < 4; i++)
+		window[i] = (uint8_t)(20 + i);
+	circlebuf_commit_write(&cb, 4);
+
+	window = circlebuf_reserve_write(&cb, 8);
+	for (uint8_t i = 0; i < 8; i++)
+		window[i] = (uint8_t)(24 + i);
+	circlebuf_commit_write(&cb, 8);
+
+	assert_int_equal(cb.size, 22);
+	check_values(circlebuf_peek_contiguous(&cb, 22), 10, 22);
+	circlebuf_free(&cb);
+}
+
+static void peek_contiguous_test(void **state)
+{
+	struct circlebuf cb;
+	uint8_t out[6];
+
+	circlebuf_init(&cb);
+	circlebuf_reserve(&cb, 8);
+
+	push_values(&cb, 0, 6);
+	circlebuf_pop_front(&cb, NULL, 4);
+	push_values(&cb, 6, 5);
+
+	check_values(circlebuf_peek_contiguous(&cb, 3), 4, 3);
+	check_values(circlebuf_peek_contiguous(&cb, 7), 4, 7);
+	assert_int_equal(cb.start_pos, 0);
+
+	/* the regular calls still see the same data afterwards */
+	circlebuf_pop_front(&cb, out, 6);
+	check_values(out, 4, 6);
+	assert_int_equal(cb.size, 1);
+	circlebuf_free(&cb);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(reserve_write_test),
+		cmocka_unit_test(reserve_write_wrapped_test),
+		cmocka_unit_test(peek_contiguous_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,137 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+
+#include <util/config-file.h>
+#include <util/platform.h>
+
+#define TEST_FILE "test_config_file.ini"
+
+static const char *test_data = "[General]\n"
+			       "Name=first\n"
+			       "Name=second\n"
+			       "Count=3\n"
+			       "\n"
+			       "[Video]\n"
+			       "Width=1920\n"
+			       "\n"
+			       "[general]\n"
+			       "Name=third\n"
+			       "Extra=yes\n";
+
+static void lookup_test(void **state)
+{
+	config_t *config;
+
+	assert_int_equal(config_open_string(&config, test_data),
+			 CONFIG_SUCCESS);
+
+	/* the first match in file order wins, names are case insensitive */
+	assert_string_equal(config_get_string(config, "general", "NAME"),
+			    "first");
+	assert_string_equal(config_get_string(config, "GENERAL", "extra"),
+			    "yes");
+	assert_int_equal(config_get_int(config, "Video", "Width"), 1920);
+	assert_null(config_get_string(config, "Video", "Height"));
+	assert_null(config_get_string(config, "Audio", "Width"));
+
+	config_set_default_int(config, "Video", "Height", 1080);
+	config_set_default_int(config, "Video", "Width", 1280);
+	assert_int_equal(config_get_int(config, "Video", "Height"), 1080);
+	assert_int_equal(config_get_int(config, "Video", "Width"), 1920);
+	assert_int_equal(config_get_default_int(config, "Video", "Width"),
+			 1280);
+
+	/* values are set in the first section of a name */
+	config_set_string(config, "GENERAL", "Extra", "no");
+	assert_string_equal(config_get_string(config, "General", "Extra"),
+			    "no");
+	assert_string_equal(config_get_section(config, 0), "General");
+	assert_int_equal(config_num_sections(config), 3);
+
+	assert_true(config_remove_value(config, "General", "Name"));
+	assert_string_equal(config_get_string(config, "General", "Name"),
+			    "second");
+	assert_true(config_remove_value(config, "General", "Extra"));
+	assert_string_equal(config_get_string(config, "General", "Extra"),
+			    "yes");
+
+	config_close(config);
+	UNUSED_PARAMETER(state);
+}
+
+static void many_items_test(void **state)
+{
+	config_t *config;
+	char name[32];
+
+	assert_int_equal(config_open_string(&config, ""), CONFIG_SUCCESS);
+
+	/* enough items and sections to grow the index several times */
+	for (int i = 0; i < 1000; i++) {
+		snprintf(name, sizeof(name), "Item%d", i);
+		config_set_int(config, i % 2 ? "Odd" : "Even", name, i);
+
+		snprintf(name, sizeof(name), "Section%d", i % 50);
+		config_set_int(config, name, "Value", i);
+	}
+
+	for (int i = 0; i < 1000; i++) {
+		snprintf(name, sizeof(name), "item%d", i);
+		assert_int_equal(
+			config_get_int(config, i % 2 ? "odd" : "even", name),
+			i);
+		assert_false(config_has_user_value(config, i % 2 ? "Even"
+								 : "Odd",
+						   name));
+	}
+
+	for (int i = 0; i < 50; i++) {
+		snprintf(name, sizeof(name), "Section%d", i);
+		assert_int_equal(config_get_int(config, name, "Value"),
+				 950 + i);
+	}
+
+	assert_int_equal(config_num_sections(config), 52);
+
+	config_close(config);
+	UNUSED_PARAMETER(state);
+}
+
+static void async_save_test(void **state)
+{
+	config_t *config;
+
+	assert_int_equal(config_open(&config, TEST_FILE, CONFIG_OPEN_ALWAYS),
+			 CONFIG_SUCCESS);
+
+	for (int i = 0; i < 100; i++) {
+		config_set_int(config, "General", "Value", i);
+		assert_int_equal(config_save_safe_async(config, "tmp", NULL),
+				 CONFIG_SUCCESS);
+	}
+
+	config_close(config);
+
+	assert_int_equal(config_open(&config, TEST_FILE, CONFIG_OPEN_EXISTING),
+			 CONFIG_SUCCESS);
+	assert_int_equal(config_get_int(config, "General", "Value"), 99);
+	config_close(config);
+
+	os_unlink(TEST_FILE);
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(lookup_test),
+		cmocka_unit_test(many_items_test),
+		cmocka_unit_test(async_save_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,55 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/platform.h>
+
+#define TEST_CPUS 16
+
+static void check_list(const char *list, const char *expected)
+{
+	bool cpus[TEST_CPUS];
+
+	assert_true(os_parse_cpu_list(list, cpus, TEST_CPUS));
+
+	for (size_t i = 0; i < TEST_CPUS; i++)
+		assert_int_equal(cpus[i], expected[i] == '1');
+}
+
+static void valid_list_test(void **state)
+{
+	check_list("0", "1000000000000000");
+	check_list("15", "0000000000000001");
+	check_list("0-3,8", "1111000010000000");
+	check_list("2-2, 4 , 10-11", "0010100000110000");
+	check_list("1,1,0-1", "1100000000000000");
+
+	(void)state;
+}
+
+static void invalid_list_test(void **state)
+{
+	bool cpus[TEST_CPUS];
+
+	assert_false(os_parse_cpu_list(NULL, cpus, TEST_CPUS));
+	assert_false(os_parse_cpu_list("", cpus, TEST_CPUS));
+	assert_false(os_parse_cpu_list("16", cpus, TEST_CPUS));
+	assert_false(os_parse_cpu_list("3-1", cpus, TEST_CPUS));
+	assert_false(os_parse_cpu_list("0-", cpus, TEST_CPUS));
+	assert_false(os_parse_cpu_list("-1", cpus, TEST_CPUS));
+	assert_false(os_parse_cpu_list("1;2", cpus, TEST_CPUS));
+	assert_false(os_parse_cpu_list("a", cpus, TEST_CPUS));
+
+	(void)state;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(valid_list_test),
+		cmocka_unit_test(invalid_list_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
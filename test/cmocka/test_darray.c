@@ -19,10 +19,53 @@ static void array_basic_test(void **state)
 	da_free(testarray);
 }
 
+static void array_shrink_test(void **state)
+{
+	DARRAY(int) testarray;
+	da_init(testarray);
+
+	for (int i = 0; i < 100; i++)
+		da_push_back(testarray, &i);
+
+	da_shrink(testarray);
+	assert_int_equal(testarray.capacity, 100);
+	assert_int_equal(testarray.array[99], 99);
+
+	da_resize(testarray, 0);
+	da_shrink(testarray);
+	assert_null(testarray.array);
+	assert_int_equal(testarray.capacity, 0);
+}
+
+static void array_inline_test(void **state)
+{
+	DARRAY_INLINE(int, 4) testarray;
+	da_inline_init(testarray);
+
+	for (int i = 0; i < 4; i++)
+		da_inline_push_back(testarray, &i);
+
+	assert_ptr_equal(testarray.array, testarray.inline_array);
+
+	for (int i = 4; i < 20; i++)
+		da_inline_push_back(testarray, &i);
+
+	assert_ptr_not_equal(testarray.array, testarray.inline_array);
+	assert_int_equal(testarray.num, 20);
+	for (int i = 0; i < 20; i++)
+		assert_int_equal(testarray.array[i], i);
+
+	da_inline_free(testarray);
+	assert_ptr_equal(testarray.array, testarray.inline_array);
+	assert_int_equal(testarray.num, 0);
+}
+
 int main()
 {
 	const struct CMUnitTest tests[] = {
 		cmocka_unit_test(array_basic_test),
+		cmocka_unit_test(array_shrink_test),
+		cmocka_unit_test(array_inline_test),
 	};
 
 	return cmocka_run_group_tests(tests, NULL, NULL);
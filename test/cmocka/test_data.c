@@ -0,0 +1,129 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <obs-data.h>
+
+#define NUM_ITEMS 200
+
+static void item_name(char *name, int i)
+{
+	/* not added in the order they're sorted in */
+	snprintf(name, 16, "item%03d", (i * 37) % NUM_ITEMS);
+}
+
+static void check_order(obs_data_t *data, size_t expected)
+{
+	obs_data_item_t *item = obs_data_first(data);
+	char prev[64] = "";
+	size_t count = 0;
+
+	for (; item; obs_data_item_next(&item)) {
+		const char *name = obs_data_item_get_name(item);
+		assert_true(strcmp(prev, name) < 0);
+		snprintf(prev, sizeof(prev), "%s", name);
+		count++;
+	}
+
+	assert_int_equal(count, expected);
+}
+
+static void data_lookup_test(void **state)
+{
+	obs_data_t *data = obs_data_create();
+	char name[16];
+
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		item_name(name, i);
+		obs_data_set_int(data, name, (i * 37) % NUM_ITEMS);
+	}
+
+	check_order(data, NUM_ITEMS);
+
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		snprintf(name, sizeof(name), "item%03d", i);
+		assert_int_equal(obs_data_get_int(data, name), i);
+	}
+
+	/* strings that outgrow their item move it */
+	for (int i = 0; i < NUM_ITEMS; i += 3) {
+		snprintf(name, sizeof(name), "item%03d", i);
+		obs_data_set_string(data, name,
+				    "a string long enough to reallocate");
+	}
+
+	for (int i = 0; i < NUM_ITEMS; i += 2) {
+		snprintf(name, sizeof(name), "item%03d", i);
+		obs_data_erase(data, name);
+	}
+
+	check_order(data, NUM_ITEMS / 2);
+
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		snprintf(name, sizeof(name), "item%03d", i);
+		assert_int_equal(obs_data_has_user_value(data, name), i % 2);
+		if (i % 2 && i % 3 == 0)
+			assert_string_equal(
+				obs_data_get_string(data, name),
+				"a string long enough to reallocate");
+		else if (i % 2)
+			assert_int_equal(obs_data_get_int(data, name), i);
+	}
+
+	obs_data_release(data);
+}
+
+static void data_apply_move_test(void **state)
+{
+	obs_data_t *target = obs_data_create();
+	obs_data_t *src = obs_data_create();
+	obs_data_t *obj = obs_data_create();
+	obs_data_t *moved;
+
+	obs_data_set_int(obj, "x", 5);
+	obs_data_set_obj(src, "obj", obj);
+	obs_data_set_string(src, "str", "moved");
+	obs_data_set_int(src, "num", 2);
+	obs_data_set_default_int(src, "def", 3);
+	obs_data_set_int(src, "def", 4);
+
+	obs_data_set_int(target, "num", 1);
+	obs_data_set_int(target, "other", 1);
+
+	obs_data_apply_move(target, src);
+
+	assert_int_equal(obs_data_get_int(target, "num"), 2);
+	assert_int_equal(obs_data_get_int(target, "def"), 4);
+	assert_int_equal(obs_data_get_int(target, "other"), 1);
+	assert_string_equal(obs_data_get_string(target, "str"), "moved");
+	assert_false(obs_data_has_default_value(target, "def"));
+
+	/* handed over, not copied */
+	moved = obs_data_get_obj(target, "obj");
+	assert_ptr_equal(moved, obj);
+	obs_data_release(moved);
+
+	assert_false(obs_data_has_user_value(src, "obj"));
+	assert_false(obs_data_has_user_value(src, "str"));
+	assert_false(obs_data_has_user_value(src, "def"));
+	assert_int_equal(obs_data_get_int(src, "def"), 3);
+
+	check_order(target, 5);
+
+	obs_data_release(obj);
+	obs_data_release(src);
+	obs_data_release(target);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(data_lookup_test),
+		cmocka_unit_test(data_apply_move_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
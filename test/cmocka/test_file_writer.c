@@ -0,0 +1,149 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/file-writer.h>
+#include <util/platform.h>
+
+#define TEST_FILE "test_file_writer.bin"
+
+static unsigned char *read_back(size_t *size)
+{
+	FILE *f = os_fopen(TEST_FILE, "rb");
+	unsigned char *data;
+	long len;
+
+	assert_non_null(f);
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	data = bzalloc(len + 1);
+	assert_int_equal(fread(data, 1, len, f), (size_t)len);
+	fclose(f);
+
+	*size = (size_t)len;
+	return data;
+}
+
+static void fill_pattern(unsigned char *data, size_t size, size_t start)
+{
+	for (size_t i = 0; i < size; i++)
+		data[i] = (unsigned char)((start + i) * 31 + 7);
+}
+
+static void writer_sequential_test(void **state)
+{
+	/* small blocks so the data spans many of them and a partial tail */
+	const size_t total = 4096 * 37 + 123;
+	unsigned char *expected = bmalloc(total);
+	unsigned char *data;
+	size_t size, pos = 0;
+
+	fill_pattern(expected, total, 0);
+
+	os_file_writer_t *writer = os_file_writer_create(TEST_FILE, 4096, 3);
+	assert_non_null(writer);
+
+	while (pos < total) {
+		size_t n = 1000;
+		if (n > total - pos)
+			n = total - pos;
+		assert_true(os_file_writer_write(writer, expected + pos, n));
+		pos += n;
+
+		if (pos % 7000 < 1000)
+			os_file_writer_flush(writer);
+	}
+
+	assert_int_equal(os_file_writer_size(writer), total);
+	assert_true(os_file_writer_destroy(writer));
+
+	data = read_back(&size);
+	assert_int_equal(size, total);
+	assert_memory_equal(data, expected, total);
+
+	bfree(data);
+	bfree(expected);
+	os_unlink(TEST_FILE);
+}
+
+static void writer_seek_test(void **state)
+{
+	const size_t total = 4096 * 5 + 10;
+	unsigned char *expected = bmalloc(total);
+	unsigned char patch[16];
+	unsigned char *data;
+	size_t size;
+
+	fill_pattern(expected, total, 0);
+	memset(patch, 0xAB, sizeof(patch));
+
+	os_file_writer_t *writer = os_file_writer_create(TEST_FILE, 4096, 2);
+	assert_non_null(writer);
+	assert_true(os_file_writer_write(writer, expected, total));
+
+	/* past the end is refused */
+	assert_false(os_file_writer_seek(writer, total + 1));
+
+	/* a header patch long since written out */
+	assert_true(os_file_writer_seek(writer, 8));
+	assert_true(os_file_writer_write(writer, patch, sizeof(patch)));
+	memcpy(expected + 8, patch, sizeof(patch));
+
+	/* a patch straddling the written data and the buffered tail */
+	assert_true(os_file_writer_seek(writer, 4096 * 5 - 4));
+	assert_true(os_file_writer_write(writer, patch, 8));
+	memcpy(expected + 4096 * 5 - 4, patch, 8);
+	assert_int_equal(os_file_writer_tell(writer), 4096 * 5 + 4);
+
+	/* then carry on appending from the end */
+	assert_true(os_file_writer_seek(writer, total));
+	assert_true(os_file_writer_write(writer, patch, sizeof(patch)));
+	assert_true(os_file_writer_destroy(writer));
+
+	data = read_back(&size);
+	assert_int_equal(size, total + sizeof(patch));
+	assert_memory_equal(data, expected, total);
+	assert_memory_equal(data + total, patch, sizeof(patch));
+
+	bfree(data);
+	bfree(expected);
+	os_unlink(TEST_FILE);
+}
+
+static void writer_stats_test(void **state)
+{
+	unsigned char block[4096] = {0};
+	struct os_file_writer_stats stats;
+
+	os_file_writer_t *writer = os_file_writer_create(TEST_FILE, 4096, 2);
+	assert_non_null(writer);
+
+	for (int i = 0; i < 16; i++)
+		assert_true(os_file_writer_write(writer, block, sizeof(block)));
+
+	os_file_writer_get_stats(writer, &stats);
+	assert_int_equal(stats.num_blocks, 2);
+	assert_true(stats.max_queued >= 1);
+	assert_true(stats.max_queued <= 2);
+
+	assert_true(os_file_writer_destroy(writer));
+	os_unlink(TEST_FILE);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(writer_sequential_test),
+		cmocka_unit_test(writer_seek_test),
+		cmocka_unit_test(writer_stats_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
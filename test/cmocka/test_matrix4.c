@@ -0,0 +1,132 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+#include <graphics/matrix4.h>
+
+/* clang-format off */
+static const float matrix_values[16] = {
+	2.0f,  0.5f, -1.0f, 0.0f,
+	0.25f, 3.0f, 1.5f,  0.0f,
+	-2.0f, 1.0f, 4.0f,  0.0f,
+	10.0f, -5.0f, 2.5f, 1.0f,
+};
+/* clang-format on */
+
+static void set_matrix(struct matrix4 *m, const float *values)
+{
+	vec4_set(&m->x, values[0], values[1], values[2], values[3]);
+	vec4_set(&m->y, values[4], values[5], values[6], values[7]);
+	vec4_set(&m->z, values[8], values[9], values[10], values[11]);
+	vec4_set(&m->t, values[12], values[13], values[14], values[15]);
+}
+
+static void reference_mul(float *out, const float *a, const float *b)
+{
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			float sum = 0.0f;
+			for (int k = 0; k < 4; k++)
+				sum += a[i * 4 + k] * b[k * 4 + j];
+			out[i * 4 + j] = sum;
+		}
+	}
+}
+
+static void assert_matrix_near(const struct matrix4 *m, const float *expected)
+{
+	const float *values = (const float *)m;
+
+	for (int i = 0; i < 16; i++)
+		assert_true(fabsf(values[i] - expected[i]) < 0.0001f);
+}
+
+static void matrix_mul_test(void **state)
+{
+	struct matrix4 a, b;
+	float b_values[16];
+	float expected[16];
+
+	for (int i = 0; i < 16; i++)
+		b_values[i] = (float)(i % 5) - 1.5f;
+
+	set_matrix(&a, matrix_values);
+	set_matrix(&b, b_values);
+	reference_mul(expected, matrix_values, b_values);
+
+	matrix4_mul(&a, &a, &b);
+	assert_matrix_near(&a, expected);
+}
+
+static void matrix_inv_test(void **state)
+{
+	struct matrix4 identity;
+	struct matrix4 m, inv;
+
+	matrix4_identity(&identity);
+
+	set_matrix(&m, matrix_values);
+	assert_true(matrix4_inv(&inv, &m));
+	matrix4_mul(&m, &m, &inv);
+	assert_matrix_near(&m, (const float *)&identity);
+
+	/* singular */
+	vec4_zero(&m.z);
+	assert_false(matrix4_inv(&inv, &m));
+	assert_true(fabsf(matrix4_determinant(&m)) < 0.0001f);
+}
+
+static void matrix_translate_scale_test(void **state)
+{
+	struct matrix4 m, op;
+	struct vec3 v;
+	float op_values[16];
+	float expected[16];
+
+	vec3_set(&v, 3.0f, -2.0f, 0.5f);
+
+	/* translation and scale are applied directly, compare them with
+	 * multiplying by the full matrix */
+	matrix4_identity(&op);
+	vec4_set(&op.t, v.x, v.y, v.z, 1.0f);
+	memcpy(op_values, &op, sizeof(op_values));
+
+	set_matrix(&m, matrix_values);
+	reference_mul(expected, matrix_values, op_values);
+	matrix4_translate3v(&m, &m, &v);
+	assert_matrix_near(&m, expected);
+
+	set_matrix(&m, matrix_values);
+	reference_mul(expected, op_values, matrix_values);
+	matrix4_translate3v_i(&m, &v, &m);
+	assert_matrix_near(&m, expected);
+
+	matrix4_identity(&op);
+	op.x.x = v.x;
+	op.y.y = v.y;
+	op.z.z = v.z;
+	memcpy(op_values, &op, sizeof(op_values));
+
+	set_matrix(&m, matrix_values);
+	reference_mul(expected, matrix_values, op_values);
+	matrix4_scale(&m, &m, &v);
+	assert_matrix_near(&m, expected);
+
+	set_matrix(&m, matrix_values);
+	reference_mul(expected, op_values, matrix_values);
+	matrix4_scale_i(&m, &v, &m);
+	assert_matrix_near(&m, expected);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(matrix_mul_test),
+		cmocka_unit_test(matrix_inv_test),
+		cmocka_unit_test(matrix_translate_scale_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,124 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <obs-data.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+
+#define TRACE_FILE "test_profiler_trace.json"
+
+static const char *root_name = "trace_root";
+static const char *child_name = "trace_child";
+static const char *thread_root_name = "trace_thread";
+
+static size_t count_events(obs_data_array_t *events, const char *name,
+			   const char *ph)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < obs_data_array_count(events); i++) {
+		obs_data_t *event = obs_data_array_item(events, i);
+
+		if (strcmp(obs_data_get_string(event, "name"), name) == 0 &&
+		    strcmp(obs_data_get_string(event, "ph"), ph) == 0)
+			count++;
+
+		obs_data_release(event);
+	}
+
+	return count;
+}
+
+static obs_data_array_t *load_events(void)
+{
+	obs_data_t *trace;
+	obs_data_array_t *events;
+
+	assert_true(profiler_trace_dump(TRACE_FILE));
+
+	trace = obs_data_create_from_json_file(TRACE_FILE);
+	assert_non_null(trace);
+
+	events = obs_data_get_array(trace, "traceEvents");
+	assert_non_null(events);
+
+	obs_data_release(trace);
+	os_unlink(TRACE_FILE);
+	return events;
+}
+
+static void record(int count)
+{
+	for (int i = 0; i < count; i++) {
+		profile_start(root_name);
+		profile_start(child_name);
+		profile_end(child_name);
+		profile_end(root_name);
+	}
+}
+
+static void *thread_func(void *unused)
+{
+	profile_start(thread_root_name);
+	profile_end(thread_root_name);
+	return unused;
+}
+
+static void trace_events_test(void **state)
+{
+	obs_data_array_t *events;
+	pthread_t thread;
+
+	profiler_start();
+	profiler_trace_start(64, NULL);
+	assert_true(profiler_trace_active());
+
+	record(3);
+	profiler_trace_trigger("trace_trigger");
+
+	assert_int_equal(pthread_create(&thread, NULL, thread_func, NULL), 0);
+	pthread_join(thread, NULL);
+
+	events = load_events();
+	assert_int_equal(count_events(events, root_name, "X"), 3);
+	assert_int_equal(count_events(events, child_name, "X"), 3);
+	assert_int_equal(count_events(events, "trace_trigger", "i"), 1);
+	assert_int_equal(count_events(events, thread_root_name, "X"), 1);
+	/* both threads are named after their roots */
+	assert_int_equal(count_events(events, "thread_name", "M"), 2);
+	obs_data_array_release(events);
+
+	/* only the most recent events of a thread are kept */
+	record(100);
+	events = load_events();
+	assert_int_equal(count_events(events, root_name, "X") +
+				 count_events(events, child_name, "X") +
+				 count_events(events, "trace_trigger", "i"),
+			 64);
+	obs_data_array_release(events);
+
+	/* stopping keeps what was recorded */
+	profiler_trace_stop();
+	assert_false(profiler_trace_active());
+	record(1);
+	events = load_events();
+	assert_int_equal(count_events(events, thread_root_name, "X"), 1);
+	obs_data_array_release(events);
+
+	profiler_stop();
+	profiler_free();
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(trace_events_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,207 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/platform.h>
+#include <util/threading.h>
+#include <obs.h>
+
+#ifdef _WIN32
+#define GRAPHICS_MODULE DL_D3D11
+#else
+#define GRAPHICS_MODULE DL_OPENGL
+#endif
+
+#define CANVAS_SIZE 64
+#define ITEM_SIZE 8
+
+/* frames before the scene is memoized, and after it is */
+#define DIRECT_FRAME 1
+#define MEMO_FRAME 5
+
+/* ------------------------------------------------------------------------- */
+
+static const char *translucent_name(void *unused)
+{
+	(void)unused;
+	return "translucent";
+}
+
+static void *translucent_create(obs_data_t *settings, obs_source_t *source)
+{
+	(void)settings;
+	return source;
+}
+
+static void translucent_destroy(void *data)
+{
+	(void)data;
+}
+
+static uint32_t translucent_size(void *data)
+{
+	(void)data;
+	return ITEM_SIZE;
+}
+
+static void translucent_render(void *data, gs_effect_t *effect)
+{
+	gs_effect_t *solid = obs_get_base_effect(OBS_EFFECT_SOLID);
+	gs_eparam_t *color = gs_effect_get_param_by_name(solid, "color");
+	struct vec4 value;
+
+	vec4_set(&value, 1.0f, 0.5f, 0.25f, 0.5f);
+	gs_effect_set_vec4(color, &value);
+
+	while (gs_effect_loop(solid, "Solid"))
+		gs_draw_sprite(NULL, 0, ITEM_SIZE, ITEM_SIZE);
+
+	(void)data;
+	(void)effect;
+}
+
+static struct obs_source_info translucent_info = {
+	.id = "test_translucent",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
+	.get_name = translucent_name,
+	.create = translucent_create,
+	.destroy = translucent_destroy,
+	.get_width = translucent_size,
+	.get_height = translucent_size,
+	.video_render = translucent_render,
+};
+
+/* ------------------------------------------------------------------------- */
+
+struct capture {
+	obs_source_t *scene;
+	gs_texrender_t *texrender;
+	gs_stagesurf_t *stagesurf;
+	int frame;
+	uint8_t direct[4];
+	uint8_t memo[4];
+	os_event_t *done;
+};
+
+static void capture_pixel(struct capture *c, uint8_t *out)
+{
+	struct vec4 clear_color;
+	uint8_t *data;
+	uint32_t linesize;
+
+	vec4_zero(&clear_color);
+
+	gs_texrender_reset(c->texrender);
+	if (gs_texrender_begin(c->texrender, CANVAS_SIZE, CANVAS_SIZE)) {
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)CANVAS_SIZE, 0.0f, (float)CANVAS_SIZE,
+			 -100.0f, 100.0f);
+		obs_source_video_render(c->scene);
+		gs_texrender_end(c->texrender);
+	}
+
+	gs_stage_texture(c->stagesurf, gs_texrender_get_texture(c->texrender));
+	if (gs_stagesurface_map(c->stagesurf, &data, &linesize)) {
+		memcpy(out, data + linesize + 4, 4);
+		gs_stagesurface_unmap(c->stagesurf);
+	}
+}
+
+/* the main view draws the scene first, so drawing it again here makes it
+ * drawn twice a frame, which memoizes it from the next frame on */
+static void draw_scene(void *param, uint32_t cx, uint32_t cy)
+{
+	struct capture *c = param;
+
+	c->frame++;
+	if (c->frame == DIRECT_FRAME) {
+		capture_pixel(c, c->direct);
+	} else if (c->frame == MEMO_FRAME) {
+		capture_pixel(c, c->memo);
+		os_event_signal(c->done);
+	} else {
+		obs_source_video_render(c->scene);
+	}
+
+	(void)cx;
+	(void)cy;
+}
+
+static void memo_blend_test(void **state)
+{
+	struct obs_video_info ovi = {
+		.graphics_module = GRAPHICS_MODULE,
+		.fps_num = 30,
+		.fps_den = 1,
+		.base_width = CANVAS_SIZE,
+		.base_height = CANVAS_SIZE,
+		.output_width = CANVAS_SIZE,
+		.output_height = CANVAS_SIZE,
+		.output_format = VIDEO_FORMAT_RGBA,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_FULL,
+		.scale_type = OBS_SCALE_BILINEAR,
+		.gpu_conversion = true,
+	};
+	struct capture c = {0};
+	obs_scene_t *scene;
+	obs_source_t *item_source;
+
+	assert_true(obs_startup("en-US", NULL, NULL));
+
+	if (!*GRAPHICS_MODULE || obs_reset_video(&ovi) != OBS_VIDEO_SUCCESS) {
+		obs_shutdown();
+		skip();
+	}
+
+	obs_register_source(&translucent_info);
+	obs_set_idle_rendering(false);
+
+	scene = obs_scene_create("memo");
+	item_source = obs_source_create("test_translucent", "item", NULL, NULL);
+	obs_scene_add(scene, item_source);
+	c.scene = obs_scene_get_source(scene);
+
+	obs_enter_graphics();
+	c.texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	c.stagesurf = gs_stagesurface_create(CANVAS_SIZE, CANVAS_SIZE, GS_RGBA);
+	obs_leave_graphics();
+
+	assert_int_equal(os_event_init(&c.done, OS_EVENT_TYPE_MANUAL), 0);
+
+	obs_set_output_source(0, c.scene);
+	obs_add_main_render_callback(draw_scene, &c);
+	assert_int_equal(os_event_timedwait(c.done, 5000), 0);
+	obs_remove_main_render_callback(draw_scene, &c);
+	obs_set_output_source(0, NULL);
+
+	/* the half transparent item is blended the same way either way */
+	for (int i = 0; i < 4; i++)
+		assert_true(abs((int)c.direct[i] - (int)c.memo[i]) <= 1);
+	assert_true(c.direct[3] > 100 && c.direct[3] < 156);
+
+	obs_enter_graphics();
+	gs_stagesurface_destroy(c.stagesurf);
+	gs_texrender_destroy(c.texrender);
+	obs_leave_graphics();
+
+	os_event_destroy(c.done);
+	obs_source_release(item_source);
+	obs_scene_release(scene);
+	obs_shutdown();
+	(void)state;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(memo_blend_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,66 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/spsc-ring.h>
+
+static void ring_basic_test(void **state)
+{
+	struct spsc_ring ring;
+	spsc_ring_init(&ring, 3);
+
+	assert_int_equal(ring.capacity, 4);
+	assert_null(spsc_ring_pop(&ring));
+
+	for (uintptr_t i = 1; i <= 4; i++)
+		assert_true(spsc_ring_push(&ring, (void *)i));
+
+	assert_false(spsc_ring_push(&ring, (void *)5));
+	assert_int_equal(spsc_ring_size(&ring), 4);
+
+	for (uintptr_t i = 1; i <= 4; i++)
+		assert_ptr_equal(spsc_ring_pop(&ring), (void *)i);
+
+	assert_null(spsc_ring_pop(&ring));
+	spsc_ring_free(&ring);
+}
+
+static void ring_wrap_test(void **state)
+{
+	struct spsc_ring ring;
+	spsc_ring_init(&ring, 8);
+
+	/* start just below the index wrap point */
+	ring.head = ring.tail = -3;
+
+	for (uintptr_t i = 1; i <= 100; i++) {
+		assert_true(spsc_ring_push(&ring, (void *)i));
+		assert_true(spsc_ring_push(&ring, (void *)(i + 1000)));
+		assert_ptr_equal(spsc_ring_pop(&ring), (void *)i);
+		assert_ptr_equal(spsc_ring_pop(&ring), (void *)(i + 1000));
+	}
+
+	assert_int_equal(spsc_ring_size(&ring), 0);
+	spsc_ring_free(&ring);
+}
+
+static void ring_empty_test(void **state)
+{
+	struct spsc_ring ring = {0};
+
+	/* an uninitialized ring is always full and always empty */
+	assert_false(spsc_ring_push(&ring, (void *)1));
+	assert_null(spsc_ring_pop(&ring));
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(ring_basic_test),
+		cmocka_unit_test(ring_wrap_test),
+		cmocka_unit_test(ring_empty_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
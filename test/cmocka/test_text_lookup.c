@@ -0,0 +1,84 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include <util/text-lookup.h>
+#include <util/platform.h>
+
+#define DEFAULT_FILE "test_text_lookup_en.ini"
+#define LOCALE_FILE "test_text_lookup_de.ini"
+#define EXTRA_FILE "test_text_lookup_extra.ini"
+
+static const char *default_data = "# comment\n"
+				  "Hello=\"Hello\"\n"
+				  "Goodbye=\"Goodbye\"\n"
+				  "Escaped=\"one\\ntwo \\\"quoted\\\"\"\n"
+				  "Repeated=\"first\"\n"
+				  "Repeated=\"second\"\n";
+
+static const char *locale_data = "Hello=\"Hallo\"\n"
+				 "HelloWorld=\"Hallo Welt\"\n";
+
+static const char *extra_data = "Goodbye=\"Tschuess\"\n";
+
+static void lookup_test(void **state)
+{
+	const char *str;
+	lookup_t *lookup;
+
+	assert_true(os_quick_write_utf8_file(DEFAULT_FILE, default_data,
+					     strlen(default_data), false));
+	assert_true(os_quick_write_utf8_file(LOCALE_FILE, locale_data,
+					     strlen(locale_data), false));
+	assert_true(os_quick_write_utf8_file(EXTRA_FILE, extra_data,
+					     strlen(extra_data), false));
+
+	assert_null(text_lookup_create("test_text_lookup_missing.ini"));
+
+	lookup = text_lookup_create(DEFAULT_FILE);
+	assert_non_null(lookup);
+	assert_true(text_lookup_add(lookup, LOCALE_FILE));
+	assert_false(text_lookup_add(lookup, "test_text_lookup_missing.ini"));
+
+	/* the locale replaces the default, which is the fallback */
+	assert_true(text_lookup_getstr(lookup, "Hello", &str));
+	assert_string_equal(str, "Hallo");
+	assert_true(text_lookup_getstr(lookup, "HELLOWORLD", &str));
+	assert_string_equal(str, "Hallo Welt");
+	assert_true(text_lookup_getstr(lookup, "goodbye", &str));
+	assert_string_equal(str, "Goodbye");
+	assert_true(text_lookup_getstr(lookup, "Escaped", &str));
+	assert_string_equal(str, "one\ntwo \"quoted\"");
+	assert_true(text_lookup_getstr(lookup, "Repeated", &str));
+	assert_string_equal(str, "second");
+	assert_false(text_lookup_getstr(lookup, "Hell", &str));
+	assert_false(text_lookup_getstr(lookup, "Missing", &str));
+
+	/* files added after the first lookup are loaded right away, and
+	 * strings returned earlier stay valid */
+	const char *hello = NULL;
+	assert_true(text_lookup_getstr(lookup, "Hello", &hello));
+	assert_true(text_lookup_add(lookup, EXTRA_FILE));
+	assert_true(text_lookup_getstr(lookup, "Goodbye", &str));
+	assert_string_equal(str, "Tschuess");
+	assert_string_equal(hello, "Hallo");
+
+	text_lookup_destroy(lookup);
+
+	os_unlink(DEFAULT_FILE);
+	os_unlink(LOCALE_FILE);
+	os_unlink(EXTRA_FILE);
+	(void)state;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(lookup_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,177 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <cmocka.h>
+
+#include <graphics/texture-compress.h>
+
+#define CX 16
+#define CY 8
+
+static void decode_565(uint16_t v, int *c)
+{
+	int r = (v >> 11) & 31;
+	int g = (v >> 5) & 63;
+	int b = v & 31;
+
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+/* reference decoder of a single pixel, RGBA out */
+static void decode_pixel(const uint8_t *blocks, enum gs_color_format format,
+			 uint32_t x, uint32_t y, int *out)
+{
+	size_t block_size = format == GS_DXT1 ? 8 : 16;
+	const uint8_t *block =
+		blocks + ((y / 4) * (CX / 4) + (x / 4)) * block_size;
+	uint32_t i = (y % 4) * 4 + (x % 4);
+	const uint8_t *color = format == GS_DXT1 ? block : block + 8;
+	int c0[3], c1[3];
+	uint32_t indices;
+	uint32_t idx;
+
+	decode_565((uint16_t)(color[0] | (color[1] << 8)), c0);
+	decode_565((uint16_t)(color[2] | (color[3] << 8)), c1);
+	indices = color[4] | (color[5] << 8) | (color[6] << 16) |
+		  ((uint32_t)color[7] << 24);
+	idx = (indices >> (i * 2)) & 3;
+
+	for (int c = 0; c < 3; c++) {
+		int v[4] = {c0[c], c1[c], (2 * c0[c] + c1[c]) / 3,
+			    (c0[c] + 2 * c1[c]) / 3};
+		out[c] = v[idx];
+	}
+
+	out[3] = 255;
+	if (format == GS_DXT5) {
+		uint64_t bits = 0;
+		int a0 = block[0], a1 = block[1];
+		int pal[8] = {a0, a1};
+
+		for (int j = 0; j < 6; j++)
+			bits |= (uint64_t)block[2 + j] << (j * 8);
+		for (int j = 1; j < 7; j++)
+			pal[j + 1] = ((7 - j) * a0 + j * a1) / 7;
+
+		out[3] = pal[(bits >> (i * 3)) & 7];
+	}
+}
+
+/* the colors of a block lie on a line, as the encoder can only represent
+ * that, with blue falling while red and green rise */
+static void fill_gradient(uint8_t *pixels, bool alpha)
+{
+	for (uint32_t y = 0; y < CY; y++) {
+		for (uint32_t x = 0; x < CX; x++) {
+			uint8_t *px = pixels + (y * CX + x) * 4;
+			px[0] = (uint8_t)(x * 16);
+			px[1] = (uint8_t)(x * 8);
+			px[2] = (uint8_t)(255 - x * 16);
+			px[3] = alpha ? (uint8_t)(x * 8 + y * 16) : 255;
+		}
+	}
+}
+
+static void check_error(const uint8_t *pixels, const uint8_t *blocks,
+			enum gs_color_format format, int max_error)
+{
+	for (uint32_t y = 0; y < CY; y++) {
+		for (uint32_t x = 0; x < CX; x++) {
+			const uint8_t *px = pixels + (y * CX + x) * 4;
+			int dec[4];
+
+			decode_pixel(blocks, format, x, y, dec);
+			for (int c = 0; c < 4; c++)
+				assert_true(abs(dec[c] - px[c]) <= max_error);
+		}
+	}
+}
+
+static void compress_size_test(void **state)
+{
+	assert_true(gs_can_compress_texture(GS_BGRA, 1920, 1080));
+	assert_false(gs_can_compress_texture(GS_BGRA, 1918, 1080));
+	assert_false(gs_can_compress_texture(GS_RGBA16F, 64, 64));
+
+	assert_int_equal(gs_get_compressed_size(GS_DXT1, 1920, 1080),
+			 1920 * 1080 / 2);
+	assert_int_equal(gs_get_compressed_size(GS_DXT5, 1920, 1080),
+			 1920 * 1080);
+}
+
+static void compress_format_test(void **state)
+{
+	uint8_t pixels[CX * CY * 4];
+
+	fill_gradient(pixels, false);
+	assert_int_equal(gs_get_compressed_format(pixels, CX * 4, GS_RGBA, CX,
+						  CY),
+			 GS_DXT1);
+
+	fill_gradient(pixels, true);
+	assert_int_equal(gs_get_compressed_format(pixels, CX * 4, GS_RGBA, CX,
+						  CY),
+			 GS_DXT5);
+}
+
+static void compress_dxt1_test(void **state)
+{
+	uint8_t pixels[CX * CY * 4];
+	uint8_t blocks[CX * CY / 2];
+
+	fill_gradient(pixels, false);
+	assert_true(gs_compress_texture_data(blocks, GS_DXT1, pixels, CX * 4,
+					     GS_RGBA, CX, CY));
+	check_error(pixels, blocks, GS_DXT1, 24);
+}
+
+static void compress_dxt5_test(void **state)
+{
+	uint8_t pixels[CX * CY * 4];
+	uint8_t blocks[CX * CY];
+
+	fill_gradient(pixels, true);
+	assert_true(gs_compress_texture_data(blocks, GS_DXT5, pixels, CX * 4,
+					     GS_RGBA, CX, CY));
+	check_error(pixels, blocks, GS_DXT5, 24);
+}
+
+static void compress_solid_test(void **state)
+{
+	uint8_t pixels[CX * CY * 4];
+	uint8_t blocks[CX * CY / 2];
+
+	for (size_t i = 0; i < CX * CY; i++) {
+		pixels[i * 4 + 0] = 0x10;
+		pixels[i * 4 + 1] = 0x80;
+		pixels[i * 4 + 2] = 0xF0;
+		pixels[i * 4 + 3] = 255;
+	}
+
+	/* BGRA input comes out as RGBA */
+	assert_true(gs_compress_texture_data(blocks, GS_DXT1, pixels, CX * 4,
+					     GS_BGRA, CX, CY));
+	for (size_t i = 0; i < CX * CY; i++) {
+		uint8_t tmp = pixels[i * 4];
+		pixels[i * 4] = pixels[i * 4 + 2];
+		pixels[i * 4 + 2] = tmp;
+	}
+	check_error(pixels, blocks, GS_DXT1, 8);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(compress_size_test),
+		cmocka_unit_test(compress_format_test),
+		cmocka_unit_test(compress_dxt1_test),
+		cmocka_unit_test(compress_dxt5_test),
+		cmocka_unit_test(compress_solid_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
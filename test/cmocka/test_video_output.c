@@ -0,0 +1,253 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <media-io/video-io.h>
+#include <media-io/video-frame.h>
+
+#define WIDTH 64
+#define HEIGHT 4
+/* wider than the frame, like the lines of a mapped staging surface */
+#define EXTERNAL_LINESIZE (WIDTH * 4 + 64)
+
+struct receiver {
+	os_event_t *received;
+	uint8_t *data;
+	uint32_t linesize;
+	uint8_t first_byte;
+};
+
+static void receive_frame(void *param, struct video_data *frame)
+{
+	struct receiver *r = param;
+
+	if (r->data)
+		return;
+
+	r->data = frame->data[0];
+	r->linesize = frame->linesize[0];
+	r->first_byte = frame->data[0][0];
+	os_event_signal(r->received);
+}
+
+static void release_frame(void *param)
+{
+	os_event_signal(param);
+}
+
+static video_t *open_output(void)
+{
+	struct video_output_info info = {
+		.name = "test",
+		.format = VIDEO_FORMAT_RGBA,
+		.fps_num = 30,
+		.fps_den = 1,
+		.width = WIDTH,
+		.height = HEIGHT,
+		.cache_size = 4,
+	};
+	video_t *video = NULL;
+
+	assert_int_equal(video_output_open(&video, &info),
+			 VIDEO_OUTPUT_SUCCESS);
+	return video;
+}
+
+static void external_frame_test(void **state)
+{
+	uint8_t *buffer = bzalloc(EXTERNAL_LINESIZE * HEIGHT);
+	struct video_data frame = {.timestamp = 1};
+	struct receiver r = {0};
+	os_event_t *released;
+	video_t *video = open_output();
+
+	assert_int_equal(os_event_init(&r.received, OS_EVENT_TYPE_MANUAL), 0);
+	assert_int_equal(os_event_init(&released, OS_EVENT_TYPE_MANUAL), 0);
+	assert_true(video_output_connect(video, NULL, receive_frame, &r));
+
+	buffer[0] = 0x5a;
+	frame.data[0] = buffer;
+	frame.linesize[0] = EXTERNAL_LINESIZE;
+	video_output_send_external_frame(video, &frame, 1, release_frame,
+					 released);
+
+	/* the input reads the memory of the caller, not a copy of it */
+	assert_int_equal(os_event_timedwait(r.received, 5000), 0);
+	assert_ptr_equal(r.data, buffer);
+	assert_int_equal(r.linesize, EXTERNAL_LINESIZE);
+	assert_int_equal(r.first_byte, 0x5a);
+
+	assert_int_equal(os_event_timedwait(released, 5000), 0);
+
+	video_output_disconnect(video, receive_frame, &r);
+	video_output_close(video);
+	os_event_destroy(r.received);
+	os_event_destroy(released);
+	bfree(buffer);
+	(void)state;
+}
+
+static void external_frame_no_inputs_test(void **state)
+{
+	uint8_t *buffer = bzalloc(EXTERNAL_LINESIZE * HEIGHT);
+	struct video_data frame = {.timestamp = 1};
+	os_event_t *released;
+	video_t *video = open_output();
+
+	assert_int_equal(os_event_init(&released, OS_EVENT_TYPE_MANUAL), 0);
+
+	frame.data[0] = buffer;
+	frame.linesize[0] = EXTERNAL_LINESIZE;
+	video_output_send_external_frame(video, &frame, 1, release_frame,
+					 released);
+	assert_int_equal(os_event_timedwait(released, 5000), 0);
+
+	/* frames of the output itself still work afterwards */
+	struct video_frame locked;
+	assert_true(video_output_lock_frame(video, &locked, 1, 2));
+	assert_ptr_not_equal(locked.data[0], buffer);
+	assert_int_equal(locked.linesize[0], WIDTH * 4);
+	video_output_unlock_frame(video);
+
+	video_output_close(video);
+	os_event_destroy(released);
+	bfree(buffer);
+	(void)state;
+}
+
+#define NUM_EXTERNAL_FRAMES 64
+
+struct release_counter {
+	volatile long released[NUM_EXTERNAL_FRAMES];
+	volatile long total;
+};
+
+struct counted_frame {
+	struct release_counter *counter;
+	int index;
+};
+
+static void count_release(void *param)
+{
+	struct counted_frame *frame = param;
+
+	os_atomic_inc_long(&frame->counter->released[frame->index]);
+	os_atomic_inc_long(&frame->counter->total);
+}
+
+static void receive_nothing(void *param, struct video_data *frame)
+{
+	(void)param;
+	(void)frame;
+}
+
+static void external_frame_release_test(void **state)
+{
+	uint8_t *buffer = bzalloc(EXTERNAL_LINESIZE * HEIGHT);
+	struct counted_frame frames[NUM_EXTERNAL_FRAMES];
+	struct release_counter counter = {0};
+	video_t *video = open_output();
+
+	assert_true(video_output_connect(video, NULL, receive_nothing, NULL));
+
+	/* with the cache full, each frame takes the entry that was released
+	 * last, which must not release the new frame in its place */
+	for (int i = 0; i < NUM_EXTERNAL_FRAMES; i++) {
+		struct video_data frame = {.timestamp = (uint64_t)i + 1};
+
+		frames[i].counter = &counter;
+		frames[i].index = i;
+		frame.data[0] = buffer;
+		frame.linesize[0] = EXTERNAL_LINESIZE;
+		video_output_send_external_frame(video, &frame, 1,
+						 count_release, &frames[i]);
+		os_sleep_ms(1);
+	}
+
+	for (int i = 0; i < 5000; i++) {
+		if (os_atomic_load_long(&counter.total) == NUM_EXTERNAL_FRAMES)
+			break;
+		os_sleep_ms(1);
+	}
+
+	video_output_disconnect(video, receive_nothing, NULL);
+	video_output_close(video);
+
+	for (int i = 0; i < NUM_EXTERNAL_FRAMES; i++)
+		assert_int_equal(counter.released[i], 1);
+
+	bfree(buffer);
+	(void)state;
+}
+
+static void strided_copy_test(void **state)
+{
+	struct video_frame src = {0}, dst;
+	uint8_t *buffer = bmalloc(EXTERNAL_LINESIZE * HEIGHT);
+
+	memset(buffer, 0xee, EXTERNAL_LINESIZE * HEIGHT);
+	for (uint32_t y = 0; y < HEIGHT; y++)
+		memset(buffer + y * EXTERNAL_LINESIZE, (int)y + 1, WIDTH * 4);
+
+	src.data[0] = buffer;
+	src.linesize[0] = EXTERNAL_LINESIZE;
+	video_frame_init(&dst, VIDEO_FORMAT_RGBA, WIDTH, HEIGHT);
+	video_frame_copy(&dst, &src, VIDEO_FORMAT_RGBA, HEIGHT);
+
+	/* only the pixels of each line are copied, at the line size of the
+	 * destination */
+	for (uint32_t y = 0; y < HEIGHT; y++) {
+		const uint8_t *line = dst.data[0] + y * dst.linesize[0];
+
+		for (uint32_t x = 0; x < WIDTH * 4; x++)
+			assert_int_equal(line[x], y + 1);
+	}
+
+	video_frame_free(&dst);
+	bfree(buffer);
+	(void)state;
+}
+
+static void ten_bit_frame_test(void **state)
+{
+	struct video_frame frame;
+
+	/* every sample takes two bytes */
+	video_frame_init(&frame, VIDEO_FORMAT_P010, WIDTH, HEIGHT);
+	assert_int_equal(frame.linesize[0], WIDTH * 2);
+	assert_int_equal(frame.linesize[1], WIDTH * 2);
+	assert_true(frame.data[1] >= frame.data[0] + WIDTH * 2 * HEIGHT);
+	assert_null(frame.data[2]);
+	video_frame_free(&frame);
+
+	video_frame_init(&frame, VIDEO_FORMAT_I010, WIDTH, HEIGHT);
+	assert_int_equal(frame.linesize[0], WIDTH * 2);
+	assert_int_equal(frame.linesize[1], WIDTH);
+	assert_int_equal(frame.linesize[2], WIDTH);
+	assert_true(frame.data[1] >= frame.data[0] + WIDTH * 2 * HEIGHT);
+	assert_true(frame.data[2] >= frame.data[1] + WIDTH * HEIGHT / 2);
+	video_frame_free(&frame);
+
+	assert_true(format_is_yuv(VIDEO_FORMAT_P010));
+	assert_string_equal(get_video_format_name(VIDEO_FORMAT_I010), "I010");
+	(void)state;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(external_frame_test),
+		cmocka_unit_test(external_frame_no_inputs_test),
+		cmocka_unit_test(external_frame_release_test),
+		cmocka_unit_test(strided_copy_test),
+		cmocka_unit_test(ten_bit_frame_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}